@@ -11,6 +11,9 @@ Item {
     id: root
     objectName: "fileBrowserPage"
 
+    // Full rate while a list scrolls
+    readonly property int frameCap: driveListView.moving || fileListView.moving ? 0 : 30
+
     signal playFile(string filePath)
     signal playFolder(string folderPath)
 
@@ -18,7 +21,7 @@ Item {
     Component {
         id: folderIconComponent
         Image {
-            source: Theme.imgPath + "File.png"
+            source: Theme.icon("File.png")
             fillMode: Image.PreserveAspectFit
         }
     }
@@ -234,7 +237,7 @@ Item {
                             Image {
                                 width: 28
                                 height: 28
-                                source: Theme.imgPath + "USB.png"
+                                source: Theme.icon("USB.png")
                                 fillMode: Image.PreserveAspectFit
                                 anchors.verticalCenter: parent.verticalCenter
                             }
@@ -359,6 +362,33 @@ Item {
                     }
                 }
 
+                // Type-ahead search over the whole volume
+                TextField {
+                    id: searchField
+                    anchors.right: parent.right
+                    anchors.rightMargin: 12
+                    anchors.verticalCenter: parent.verticalCenter
+                    width: Math.min(260, parent.width * 0.4)
+                    height: 36
+                    visible: typeof fileBrowser !== "undefined" && fileBrowser.currentPath !== ""
+                    placeholderText: "Search"
+                    placeholderTextColor: Theme.textMuted
+                    font.pixelSize: Theme.fontSizeSmall
+                    font.family: Theme.fontFamily
+                    color: Theme.textPrimary
+                    inputMethodHints: Qt.ImhNoPredictiveText
+                    background: Rectangle {
+                        radius: 6
+                        color: Qt.rgba(1, 1, 1, 0.05)
+                        border.width: searchField.activeFocus ? 1 : 0
+                        border.color: Theme.primaryColor
+                    }
+                    onTextChanged: {
+                        if (typeof fileBrowser !== "undefined")
+                            fileBrowser.searchQuery = text;
+                    }
+                }
+
                 // Bottom separator
                 Rectangle {
                     anchors.bottom: parent.bottom
@@ -379,7 +409,8 @@ Item {
                 anchors.leftMargin: 8
                 anchors.rightMargin: 8
                 clip: true
-                model: typeof fileBrowser !== "undefined" ? fileBrowser.currentEntries : []
+                readonly property bool searching: typeof fileBrowser !== "undefined" && fileBrowser.searchQuery.trim() !== ""
+                model: typeof fileBrowser === "undefined" ? [] : (searching ? fileBrowser.searchResults : fileBrowser.entries)
 
                 delegate: Rectangle {
                     width: fileListView.width
@@ -408,16 +439,16 @@ Item {
                             width: 32
                             height: 32
                             anchors.verticalCenter: parent.verticalCenter
-                            sourceComponent: modelData.isDir ? folderIconComponent : null
-                            active: modelData.isDir
+                            sourceComponent: model.isDir ? folderIconComponent : null
+                            active: model.isDir
                         }
                         Image {
                             width: 28
                             height: 28
-                            source: Theme.imgPath + "mp3-hot.png"
+                            source: model.art !== "" ? model.art : Theme.icon("mp3-hot.png")
                             fillMode: Image.PreserveAspectFit
                             anchors.verticalCenter: parent.verticalCenter
-                            visible: !modelData.isDir
+                            visible: !model.isDir
                         }
 
                         Column {
@@ -425,7 +456,7 @@ Item {
                             anchors.verticalCenter: parent.verticalCenter
 
                             Text {
-                                text: modelData.name
+                                text: model.name
                                 font.pixelSize: Theme.fontSizeSmall
                                 font.family: Theme.fontFamily
                                 font.weight: Font.Normal
@@ -434,8 +465,8 @@ Item {
 
                             Text {
                                 text: {
-                                    if (modelData.isDir && modelData.audioCount > 0)
-                                        return modelData.audioCount + " audio files";
+                                    if (model.isDir && model.audioCount > 0)
+                                        return model.audioCount + " audio files";
                                     return "";
                                 }
                                 font.pixelSize: Theme.fontSizeXSmall
@@ -450,14 +481,14 @@ Item {
                         id: fileMouseArea
                         anchors.fill: parent
                         onClicked: {
-                            if (modelData.isDir) {
+                            if (model.isDir) {
                                 if (typeof fileBrowser !== "undefined")
-                                    fileBrowser.navigateTo(modelData.path);
-                            } else if (modelData.isAudio) {
+                                    fileBrowser.navigateTo(model.path);
+                            } else if (model.isAudio) {
                                 if (typeof audioPlayer !== "undefined" && typeof fileBrowser !== "undefined") {
                                     var files = fileBrowser.currentAudioFiles();
                                     audioPlayer.setPlaylist(files);
-                                    var idx = files.indexOf(modelData.path);
+                                    var idx = files.indexOf(model.path);
                                     audioPlayer.playIndex(idx >= 0 ? idx : 0);
                                     if (root.StackView.view)
                                         root.StackView.view.pop();
@@ -472,13 +503,17 @@ Item {
             Column {
                 anchors.centerIn: parent
                 spacing: 12
-                visible: typeof fileBrowser === "undefined" || fileBrowser.currentEntries.length === 0
+                visible: typeof fileBrowser === "undefined" || fileListView.model.count === 0
 
                 Text {
                     anchors.horizontalCenter: parent.horizontalCenter
                     text: {
                         if (typeof fileBrowser === "undefined" || fileBrowser.currentPath === "")
                             return "Select a USB drive to browse";
+                        if (fileListView.searching)
+                            return "No matching tracks";
+                        if (fileBrowser.scanning)
+                            return "Loading…";
                         return "No audio files found";
                     }
                     font.pixelSize: Theme.fontSizeMedium
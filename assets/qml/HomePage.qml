@@ -10,6 +10,9 @@ Item {
     id: root
     objectName: "homePage"
 
+    // Only the clock changes: half the panel's rate is plenty
+    readonly property int frameCap: 30
+
     // Gradient background
     Rectangle {
         anchors.fill: parent
@@ -66,6 +69,52 @@ Item {
         }
     }
 
+    // Now playing, from the phone or the local player
+    Row {
+        anchors.horizontalCenter: parent.horizontalCenter
+        anchors.bottom: parent.bottom
+        anchors.bottomMargin: 48
+        spacing: 16
+        visible: typeof backend !== "undefined" && backend.trackTitle !== ""
+
+        Image {
+            width: 64
+            height: 64
+            anchors.verticalCenter: parent.verticalCenter
+            source: typeof backend !== "undefined" ? backend.albumArtPath : ""
+            // The cached thumbnail is already small; decoded off the GUI thread
+            sourceSize.width: 64
+            sourceSize.height: 64
+            asynchronous: true
+            fillMode: Image.PreserveAspectCrop
+            visible: status === Image.Ready
+        }
+
+        Column {
+            anchors.verticalCenter: parent.verticalCenter
+            spacing: 4
+
+            Text {
+                width: Math.min(implicitWidth, root.width * 0.5)
+                text: typeof backend !== "undefined" ? backend.trackTitle : ""
+                font.pixelSize: Theme.fontSizeMedium
+                font.family: Theme.fontFamily
+                color: Theme.textPrimary
+                elide: Text.ElideRight
+            }
+
+            Text {
+                width: Math.min(implicitWidth, root.width * 0.5)
+                text: typeof backend !== "undefined" ? backend.artistName : ""
+                font.pixelSize: Theme.fontSizeSmall
+                font.family: Theme.fontFamily
+                color: Theme.textSecondary
+                elide: Text.ElideRight
+                visible: text !== ""
+            }
+        }
+    }
+
     // Right navigation arrow - goes to music player
     Text {
         anchors.right: parent.right
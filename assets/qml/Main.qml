@@ -10,12 +10,18 @@ import "components"
 ApplicationWindow {
     id: mainWindow
 
-    visible: true
+    // Projection on the overlay plane. If that plane is stacked below the
+    // window, the window stays up cleared to transparent and only the
+    // overlays cover the video; otherwise it is hidden underneath
+    property bool planeVideo: false
+    readonly property bool overVideo: planeVideo && typeof backend !== "undefined" && backend.uiAboveVideo
+
+    visible: !planeVideo || overVideo
     visibility: Window.FullScreen
     //width: 1024
     //height: 600
     title: "OpenAuto - " + width + "x" + height
-    color: Theme.gradientTop
+    color: overVideo ? "transparent" : Theme.gradientTop
 
     // Load Readex Pro static fonts (variable font not supported on Qt 5.15)
     FontLoader {
@@ -37,6 +43,78 @@ ApplicationWindow {
         source: Theme.imgPath + "font/ReadexPro-Bold.ttf"
     }
 
+    // Draws every weight's common characters once, inside a 1 px clip, so
+    // their distance-field glyphs are generated while the home page loads
+    // instead of stalling the first visit to each page; dropped after that
+    Item {
+        width: 1
+        height: 1
+        clip: true
+        // Above the threshold under which the scene graph skips the subtree
+        opacity: 0.01
+
+        Loader {
+            id: glyphWarmup
+            active: true
+            sourceComponent: Column {
+                Repeater {
+                    model: [Font.Thin, Font.ExtraLight, Font.Light, Font.Normal, Font.Medium, Font.DemiBold, Font.Bold]
+
+                    Text {
+                        font.family: Theme.fontFamily
+                        font.weight: modelData
+                        font.pixelSize: Theme.fontSizeMedium
+                        text: {
+                            var printable = "";
+                            for (var c = 0x20; c < 0x7f; c++)
+                                printable += String.fromCharCode(c);
+                            return printable + "…↑–°·äöüÄÖÜßéèêàâçñ";
+                        }
+                    }
+                }
+
+                // And the home clock's digits at their own size
+                Text {
+                    font.family: Theme.fontFamily
+                    font.weight: Font.Bold
+                    font.pixelSize: Theme.fontSizeClock
+                    text: "0123456789: "
+                }
+            }
+        }
+
+        Timer {
+            interval: 2000
+            running: true
+            onTriggered: glyphWarmup.active = false
+        }
+    }
+
+    // Both variants of every icon stay referenced, inside a 1 px clip, so
+    // they are decoded and uploaded once; a day/night flip then only swaps
+    // textures, even above the projection
+    Item {
+        width: 1
+        height: 1
+        clip: true
+        opacity: 0.01
+
+        Repeater {
+            model: Theme.iconNames.length * 2
+
+            Image {
+                source: Theme.iconVariant(Theme.iconNames[Math.floor(index / 2)], index % 2 === 1)
+                asynchronous: true
+            }
+        }
+    }
+
+    Binding {
+        target: Theme
+        property: "night"
+        value: typeof backend !== "undefined" && backend.nightMode
+    }
+
     // No animations - instant transitions for low-end hardware
 
     // Main content area (above dock)
@@ -46,6 +124,8 @@ ApplicationWindow {
         anchors.left: parent.left
         anchors.right: parent.right
         anchors.bottom: bottomDock.top
+        // Covered by composited video: skip drawing it underneath
+        visible: !compositorVideo.active && !mainWindow.overVideo
 
         // Disable all animations for performance
         pushEnter: null
@@ -85,6 +165,7 @@ ApplicationWindow {
         anchors.right: parent.right
         anchors.bottom: parent.bottom
         height: Theme.dockHeight
+        visible: !compositorVideo.active && !mainWindow.overVideo
 
         onHomeClicked: showHomePage()
         onMusicClicked: showMusicPage()
@@ -96,6 +177,15 @@ ApplicationWindow {
         onSettingsClicked: showSettingsPage()
     }
 
+    // Android Auto video in compositor mode; covers the pages and dock but
+    // stays below the overlays declared after it
+    Loader {
+        id: compositorVideo
+        anchors.fill: parent
+        active: false
+        source: "components/CompositorVideo.qml"
+    }
+
     // Volume overlay (floats above dock)
     VolumeOverlay {
         id: volumeOverlay
@@ -104,6 +194,37 @@ ApplicationWindow {
         anchors.bottomMargin: 8
     }
 
+    // Metrics registry, above the video and every page
+    MetricsOverlay {
+        id: metricsOverlay
+    }
+
+    // Frame time of this window, in debug mode
+    FrameTimeHud {
+        id: frameTimeHud
+    }
+
+    // Pages declare the rate they need with a frameCap property, 0 while
+    // something on them moves; pages without one and page changes get the
+    // panel's full rate
+    Binding {
+        target: typeof framePacer !== "undefined" ? framePacer : null
+        property: "frameCap"
+        value: !stackView.busy && stackView.currentItem && stackView.currentItem.frameCap !== undefined
+               ? stackView.currentItem.frameCap : 0
+    }
+    Binding {
+        target: typeof framePacer !== "undefined" ? framePacer : null
+        property: "hudEnabled"
+        value: typeof backend !== "undefined" && backend.debugMode
+    }
+
+    // Phone notifications; the projection shows its own
+    NotificationToasts {
+        id: notificationToasts
+        suppressed: compositorVideo.active || mainWindow.overVideo
+    }
+
     // Home page component
     Component {
         id: homePageComponent
@@ -113,25 +234,9 @@ ApplicationWindow {
         }
     }
 
-    // Music player page component
-    Component {
-        id: musicPageComponent
-        MusicPage {
-            onOpenFileBrowser: showFileBrowserPage()
-        }
-    }
-
-    // Settings page component (loaded on demand)
-    Component {
-        id: settingsPageComponent
-        SettingsPage {}
-    }
-
-    // File browser page component
-    Component {
-        id: fileBrowserPageComponent
-        FileBrowserPage {}
-    }
+    // The other pages are pushed by URL, so each is only compiled and
+    // created the first time it is opened; boot loads just this shell and
+    // the home page
 
     // Functions for navigation (called from backend)
     function showHomePage() {
@@ -144,7 +249,7 @@ ApplicationWindow {
             return;
         if (stackView.depth > 1)
             stackView.pop(null);
-        stackView.push(settingsPageComponent);
+        stackView.push(Qt.resolvedUrl("SettingsPage.qml"));
     }
 
     function showMusicPage() {
@@ -157,13 +262,14 @@ ApplicationWindow {
         }
         if (stackView.depth > 1)
             stackView.pop(null);
-        stackView.push(musicPageComponent);
+        var page = stackView.push(Qt.resolvedUrl("MusicPage.qml"));
+        page.openFileBrowser.connect(showFileBrowserPage);
     }
 
     function showFileBrowserPage() {
         if (stackView.currentItem && stackView.currentItem.objectName === "fileBrowserPage")
             return;
-        stackView.push(fileBrowserPageComponent);
+        stackView.push(Qt.resolvedUrl("FileBrowserPage.qml"));
     }
 
     function goBack() {
@@ -188,14 +294,19 @@ ApplicationWindow {
         }
 
         function onAndroidAutoStarted() {
-            // Hide QML UI when Android Auto projection starts
-            mainWindow.visible = false;
+            // Hide the pages when Android Auto projection starts: the video is
+            // composited into the window or scanned out on its own plane
+            if (backend.videoCompositorImport)
+                compositorVideo.active = true;
+            else
+                planeVideo = true;
         }
 
         function onAndroidAutoStopped() {
             // Show QML UI when Android Auto projection ends
             // Don't navigate — preserve whatever page was active before AA started
-            mainWindow.visible = true;
+            compositorVideo.active = false;
+            planeVideo = false;
         }
     }
 
@@ -9,6 +9,9 @@ Item {
     id: root
     objectName: "musicPage"
 
+    // The progress bar moves once a second: half the panel's rate is plenty
+    readonly property int frameCap: 30
+
     signal openFileBrowser
 
     // Gradient background
@@ -91,7 +94,7 @@ Item {
                 source: {
                     if (typeof audioPlayer !== "undefined" && audioPlayer.albumArtPath !== "")
                         return audioPlayer.albumArtPath;
-                    return Theme.imgPath + "album-hot.png";
+                    return Theme.icon("album-hot.png");
                 }
                 fillMode: Image.PreserveAspectCrop
                 visible: status === Image.Ready
@@ -253,7 +256,7 @@ Item {
         Image {
             width: 48
             height: 48
-            source: Theme.imgPath + "File.png"
+            source: Theme.icon("File.png")
             fillMode: Image.PreserveAspectFit
             anchors.verticalCenter: parent.verticalCenter
             MouseArea {
@@ -273,7 +276,7 @@ Item {
         Image {
             width: 64
             height: 64
-            source: Theme.imgPath + "prev-hot.png"
+            source: Theme.icon("prev-hot.png")
             fillMode: Image.PreserveAspectFit
             anchors.verticalCenter: parent.verticalCenter
             MouseArea {
@@ -296,8 +299,8 @@ Item {
             height: 72
             source: {
                 if (typeof audioPlayer !== "undefined" && audioPlayer.playing)
-                    return Theme.imgPath + "pause-hot.png";
-                return Theme.imgPath + "play-hot.png";
+                    return Theme.icon("pause-hot.png");
+                return Theme.icon("play-hot.png");
             }
             fillMode: Image.PreserveAspectFit
             anchors.verticalCenter: parent.verticalCenter
@@ -319,7 +322,7 @@ Item {
         Image {
             width: 64
             height: 64
-            source: Theme.imgPath + "next-hot.png"
+            source: Theme.icon("next-hot.png")
             fillMode: Image.PreserveAspectFit
             anchors.verticalCenter: parent.verticalCenter
             MouseArea {
@@ -342,8 +345,8 @@ Item {
             height: 48
             source: {
                 if (typeof audioPlayer !== "undefined" && audioPlayer.repeatMode === 2)
-                    return Theme.imgPath + "Repeat1.png";
-                return Theme.imgPath + "Repeat.png";
+                    return Theme.icon("Repeat1.png");
+                return Theme.icon("Repeat.png");
             }
             fillMode: Image.PreserveAspectFit
             anchors.verticalCenter: parent.verticalCenter
@@ -11,6 +11,9 @@ Item {
     id: root
     objectName: "settingsPage"
 
+    // Full rate while the content scrolls
+    readonly property int frameCap: contentFlickable.moving ? 0 : 30
+
     property int selectedCategory: 0
     property var categories: ["General", "Video", "Audio", "Input", "Bluetooth", "WiFi", "System", "About"]
 
@@ -746,6 +749,29 @@ Item {
                 height: Theme.spacing
             }
 
+            Rectangle {
+                width: 180
+                height: 40
+                radius: Theme.buttonRadius
+                color: pairMouseArea.pressed ? Qt.darker(Theme.cardColor, 1.2) : Theme.cardColor
+
+                Text {
+                    anchors.centerIn: parent
+                    text: "Pair New Phone"
+                    font.pixelSize: Theme.fontSizeMedium
+                    color: Theme.textPrimary
+                }
+
+                MouseArea {
+                    id: pairMouseArea
+                    anchors.fill: parent
+                    onClicked: {
+                        if (typeof backend !== "undefined")
+                            backend.pairNewPhone();
+                    }
+                }
+            }
+
             Rectangle {
                 width: 140
                 height: 40
@@ -778,6 +804,10 @@ Item {
             spacing: Theme.spacingSmall
             width: parent.width
 
+            // Telemetry is only sampled while this section is shown
+            Component.onCompleted: if (typeof backend !== "undefined") backend.subscribeTelemetry()
+            Component.onDestruction: if (typeof backend !== "undefined") backend.unsubscribeTelemetry()
+
             SettingRow {
                 label: "Connection"
                 value: typeof backend !== "undefined" ? backend.networkConnectionType : "Not Connected"
@@ -824,6 +854,10 @@ Item {
             spacing: Theme.spacingSmall
             width: parent.width
 
+            // Telemetry is only sampled while this section is shown
+            Component.onCompleted: if (typeof backend !== "undefined") backend.subscribeTelemetry()
+            Component.onDestruction: if (typeof backend !== "undefined") backend.unsubscribeTelemetry()
+
             SettingRow {
                 label: "Free Memory"
                 value: typeof backend !== "undefined" ? backend.freeMemory : "N/A"
@@ -836,6 +870,25 @@ Item {
                 label: "CPU Temperature"
                 value: typeof backend !== "undefined" ? backend.cpuTemperature : "N/A"
             }
+            SettingRow {
+                label: "Video Latency"
+                value: typeof backend !== "undefined" ? backend.videoStats : "N/A"
+                visible: typeof backend !== "undefined" && backend.debugMode
+            }
+            SettingToggle {
+                label: "Record Pipeline Trace"
+                checked: typeof backend !== "undefined" ? backend.pipelineTracing : false
+                visible: typeof backend !== "undefined" && backend.debugMode
+                onToggled: function (value) {
+                    if (typeof backend !== "undefined")
+                        backend.setPipelineTracing(value);
+                }
+            }
+            SettingRow {
+                label: "Last Trace"
+                value: typeof backend !== "undefined" ? backend.traceFile : ""
+                visible: typeof backend !== "undefined" && backend.debugMode && backend.traceFile !== ""
+            }
 
             Item {
                 width: 1
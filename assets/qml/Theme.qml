@@ -8,44 +8,109 @@ QtObject {
     // Designed for touch interfaces with large targets
     // ============================================================================
 
+    // Day and night are two fixed palettes; AmbientLight, GPS night mode
+    // or a script flips `night` (bound in Main.qml) and every colour below
+    // follows in one step. Icons switch to the atlas's pre-built night
+    // variants, which Main.qml keeps decoded, so dusk causes no reload
+    property bool night: false
+    readonly property QtObject palette: night ? nightPalette : dayPalette
+
+    readonly property QtObject dayPalette: QtObject {
+        readonly property color gradientTop: "#00021A"
+        readonly property color gradientBottom: "#001D3F"
+        readonly property color backgroundColor: "#0D0D0D"
+        readonly property color settingsBackground: "#1A1A1A"
+        readonly property color cardColor: "#1A1F2E"
+        readonly property color cardHoverColor: "#242B3D"
+        readonly property color dockColor: "#1A1A1A"
+        readonly property color dockBorderColor: "#333333"
+        readonly property color primaryColor: "#00B4D8"
+        readonly property color secondaryColor: "#0077B6"
+        readonly property color accentBlue: "#4A9FD4"
+        readonly property color textPrimary: "#FFFFFF"
+        readonly property color textSecondary: "#9CA3AF"
+        readonly property color textMuted: "#666666"
+        readonly property color dangerColor: "#E63946"
+        readonly property color successColor: "#10B981"
+        readonly property color warningColor: "#F59E0B"
+        readonly property color borderColor: "#2A3040"
+        readonly property color buttonAndroidAuto: "#0077B6"
+        readonly property color buttonWifi: "#F59E0B"
+        readonly property color buttonSettings: "#10B981"
+        readonly property color buttonDayNight: "#6366F1"
+        readonly property color buttonExit: "#E63946"
+        readonly property color buttonMedia: "#8B5CF6"
+        readonly property color buttonCamera: "#EC4899"
+    }
+
+    // Darker backgrounds and dimmer, less blue text and accents, so the
+    // panel does not glare in the cabin
+    readonly property QtObject nightPalette: QtObject {
+        readonly property color gradientTop: "#000008"
+        readonly property color gradientBottom: "#000B1A"
+        readonly property color backgroundColor: "#050505"
+        readonly property color settingsBackground: "#0C0C0C"
+        readonly property color cardColor: "#0E1118"
+        readonly property color cardHoverColor: "#151A25"
+        readonly property color dockColor: "#0C0C0C"
+        readonly property color dockBorderColor: "#1E1E1E"
+        readonly property color primaryColor: "#00809A"
+        readonly property color secondaryColor: "#005483"
+        readonly property color accentBlue: "#356F94"
+        readonly property color textPrimary: "#C9CBCF"
+        readonly property color textSecondary: "#767B84"
+        readonly property color textMuted: "#4A4A4A"
+        readonly property color dangerColor: "#A82932"
+        readonly property color successColor: "#0B8259"
+        readonly property color warningColor: "#AD6F08"
+        readonly property color borderColor: "#1A1E28"
+        readonly property color buttonAndroidAuto: "#005483"
+        readonly property color buttonWifi: "#AD6F08"
+        readonly property color buttonSettings: "#0B8259"
+        readonly property color buttonDayNight: "#4547A8"
+        readonly property color buttonExit: "#A82932"
+        readonly property color buttonMedia: "#6241AE"
+        readonly property color buttonCamera: "#A63370"
+    }
+
     // Background gradient colors (from original UI)
-    readonly property color gradientTop: "#00021A"
-    readonly property color gradientBottom: "#001D3F"
+    readonly property color gradientTop: palette.gradientTop
+    readonly property color gradientBottom: palette.gradientBottom
 
     // Solid backgrounds
-    readonly property color backgroundColor: "#0D0D0D"
-    readonly property color settingsBackground: "#1A1A1A"
+    readonly property color backgroundColor: palette.backgroundColor
+    readonly property color settingsBackground: palette.settingsBackground
 
     // Card and component colors
-    readonly property color cardColor: "#1A1F2E"
-    readonly property color cardHoverColor: "#242B3D"
-    readonly property color dockColor: "#1A1A1A"
-    readonly property color dockBorderColor: "#333333"
+    readonly property color cardColor: palette.cardColor
+    readonly property color cardHoverColor: palette.cardHoverColor
+    readonly property color dockColor: palette.dockColor
+    readonly property color dockBorderColor: palette.dockBorderColor
 
     // Accent colors
-    readonly property color primaryColor: "#00B4D8"
-    readonly property color secondaryColor: "#0077B6"
-    readonly property color accentBlue: "#4A9FD4"
+    readonly property color primaryColor: palette.primaryColor
+    readonly property color secondaryColor: palette.secondaryColor
+    readonly property color accentBlue: palette.accentBlue
 
     // Text colors
-    readonly property color textPrimary: "#FFFFFF"
-    readonly property color textSecondary: "#9CA3AF"
-    readonly property color textMuted: "#666666"
+    readonly property color textPrimary: palette.textPrimary
+    readonly property color textSecondary: palette.textSecondary
+    readonly property color textMuted: palette.textMuted
 
     // Status colors
-    readonly property color dangerColor: "#E63946"
-    readonly property color successColor: "#10B981"
-    readonly property color warningColor: "#F59E0B"
-    readonly property color borderColor: "#2A3040"
+    readonly property color dangerColor: palette.dangerColor
+    readonly property color successColor: palette.successColor
+    readonly property color warningColor: palette.warningColor
+    readonly property color borderColor: palette.borderColor
 
     // Button-specific colors
-    readonly property color buttonAndroidAuto: "#0077B6"
-    readonly property color buttonWifi: "#F59E0B"
-    readonly property color buttonSettings: "#10B981"
-    readonly property color buttonDayNight: "#6366F1"
-    readonly property color buttonExit: "#E63946"
-    readonly property color buttonMedia: "#8B5CF6"
-    readonly property color buttonCamera: "#EC4899"
+    readonly property color buttonAndroidAuto: palette.buttonAndroidAuto
+    readonly property color buttonWifi: palette.buttonWifi
+    readonly property color buttonSettings: palette.buttonSettings
+    readonly property color buttonDayNight: palette.buttonDayNight
+    readonly property color buttonExit: palette.buttonExit
+    readonly property color buttonMedia: palette.buttonMedia
+    readonly property color buttonCamera: palette.buttonCamera
 
     // Dimensions - Large touch targets for automotive use
     readonly property int buttonHeight: 64
@@ -91,4 +156,22 @@ QtObject {
             return "qrc:/";
         return url + "../";
     }
+
+    // Icons come pre-decoded from the build's texture atlas (IconAtlas), so a
+    // page decodes no PNG when first shown; plain files under qmlscene
+    function icon(name) {
+        return iconVariant(name, night);
+    }
+
+    function iconVariant(name, nightVariant) {
+        if (imgPath !== "qrc:/")
+            return imgPath + name;
+        return "image://icons/" + (nightVariant ? "night/" : "") + name;
+    }
+
+    // Everything the pages show through icon(); Main.qml holds both variants
+    // of each, so the switch only swaps textures that are already uploaded
+    readonly property var iconNames: ["Android_Auto_icon.png", "File.png", "Repeat.png", "Repeat1.png", "USB.png",
+        "album-hot.png", "home-hot.png", "mp3-hot.png", "next-hot.png", "pause-hot.png", "play-hot.png",
+        "prev-hot.png", "settings-hot.png", "volume-hot.png"]
 }
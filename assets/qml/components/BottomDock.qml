@@ -47,7 +47,7 @@ Rectangle {
                 anchors.centerIn: parent
                 width: Theme.dockIconSize
                 height: Theme.dockIconSize
-                source: Theme.imgPath + "home-hot.png"
+                source: Theme.icon("home-hot.png")
                 fillMode: Image.PreserveAspectFit
                 opacity: root.currentIndex === 0 ? 1.0 : 0.7
             }
@@ -77,7 +77,7 @@ Rectangle {
                 anchors.centerIn: parent
                 width: Theme.dockIconSize
                 height: Theme.dockIconSize
-                source: Theme.imgPath + "mp3-hot.png"
+                source: Theme.icon("mp3-hot.png")
                 fillMode: Image.PreserveAspectFit
                 opacity: root.currentIndex === 1 ? 1.0 : 0.7
             }
@@ -107,7 +107,7 @@ Rectangle {
                 anchors.centerIn: parent
                 width: Theme.dockIconSize
                 height: Theme.dockIconSize
-                source: Theme.imgPath + "Android_Auto_icon.png"
+                source: Theme.icon("Android_Auto_icon.png")
                 fillMode: Image.PreserveAspectFit
                 opacity: root.currentIndex === 2 ? 1.0 : 0.7
             }
@@ -137,7 +137,7 @@ Rectangle {
                 anchors.centerIn: parent
                 width: Theme.dockIconSize
                 height: Theme.dockIconSize
-                source: Theme.imgPath + "volume-hot.png"
+                source: Theme.icon("volume-hot.png")
                 fillMode: Image.PreserveAspectFit
                 opacity: root.currentIndex === 3 ? 1.0 : 0.7
             }
@@ -167,7 +167,7 @@ Rectangle {
                 anchors.centerIn: parent
                 width: Theme.dockIconSize
                 height: Theme.dockIconSize
-                source: Theme.imgPath + "settings-hot.png"
+                source: Theme.icon("settings-hot.png")
                 fillMode: Image.PreserveAspectFit
                 opacity: root.currentIndex === 4 ? 1.0 : 0.7
             }
@@ -0,0 +1,14 @@
+import QtQuick 2.15
+import OpenAuto.Video 1.0
+
+// CompositorVideo - Android Auto video drawn by the scene graph
+// Used instead of the KMS overlay plane when Video/CompositorImport is set.
+// Frames arrive as DMA-BUFs, so nothing is copied on the way to the GPU.
+
+Rectangle {
+    color: "black"
+
+    DmaBufVideoItem {
+        anchors.fill: parent
+    }
+}
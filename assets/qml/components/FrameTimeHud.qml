@@ -0,0 +1,28 @@
+import QtQuick 2.15
+import ".."
+
+// FrameTimeHud - UI frame rate and frame time, from FramePacer
+// Debug mode only; bottom-left, clear of the metrics overlay
+
+Rectangle {
+    id: root
+
+    visible: typeof framePacer !== "undefined" && framePacer.hudEnabled && framePacer.frameStats !== ""
+    width: statsText.implicitWidth + 16
+    height: statsText.implicitHeight + 12
+    radius: 6
+    color: Qt.rgba(0, 0, 0, 0.6)
+
+    anchors.bottom: parent.bottom
+    anchors.left: parent.left
+    anchors.margins: 8
+
+    Text {
+        id: statsText
+        anchors.centerIn: parent
+        text: typeof framePacer !== "undefined" ? framePacer.frameStats : ""
+        font.family: "monospace"
+        font.pixelSize: 11
+        color: "#E0FFE0"
+    }
+}
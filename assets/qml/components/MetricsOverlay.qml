@@ -0,0 +1,51 @@
+import QtQuick 2.15
+import ".."
+
+// MetricsOverlay - Live view of the metrics registry for field debugging
+// Shown only with [Metrics] Overlay=true; stays on top of the projection.
+// A long press saves what the video plane shows to /tmp
+
+Rectangle {
+    id: root
+
+    visible: typeof backend !== "undefined" && backend.metricsOverlay
+    width: metricsText.implicitWidth + 16
+    height: metricsText.implicitHeight + 12
+    radius: 6
+    color: Qt.rgba(0, 0, 0, 0.6)
+
+    anchors.top: parent.top
+    anchors.left: parent.left
+    anchors.margins: 8
+
+    property string frameStatus: ""
+
+    Text {
+        id: metricsText
+        anchors.centerIn: parent
+        text: (typeof backend !== "undefined" ? backend.metricsSummary : "")
+              + (root.frameStatus !== "" ? "\n" + root.frameStatus : "")
+        font.family: "monospace"
+        font.pixelSize: 11
+        color: "#E0FFE0"
+    }
+
+    MouseArea {
+        anchors.fill: parent
+        onPressAndHold: backend.saveVideoFrame()
+    }
+
+    Connections {
+        target: typeof backend !== "undefined" ? backend : null
+        function onVideoFrameSaved(path) {
+            root.frameStatus = path !== "" ? "frame: " + path : "frame: nothing on screen"
+            frameStatusTimer.restart()
+        }
+    }
+
+    Timer {
+        id: frameStatusTimer
+        interval: 5000
+        onTriggered: root.frameStatus = ""
+    }
+}
@@ -0,0 +1,65 @@
+import QtQuick 2.15
+import ".."
+
+// NotificationToasts - The phone's notifications, stacked at the top right
+// Each toast is drawn into its own layer, so it is re-rendered only when its
+// text changes; the model leaves unchanged toasts alone
+
+Column {
+    id: root
+
+    // Set while something else already shows the phone's notifications
+    property bool suppressed: false
+
+    visible: !suppressed && typeof notifications !== "undefined" && notifications.count > 0
+    width: Math.min(parent.width * 0.4, 420)
+    spacing: 8
+
+    anchors.top: parent.top
+    anchors.right: parent.right
+    anchors.margins: 12
+
+    Repeater {
+        model: typeof notifications !== "undefined" ? notifications : null
+
+        Rectangle {
+            width: root.width
+            height: toastColumn.implicitHeight + 20
+            radius: 10
+            color: Qt.rgba(0.1, 0.12, 0.18, 0.95)
+            border.width: 1
+            border.color: Qt.rgba(1, 1, 1, 0.15)
+            layer.enabled: true
+
+            Column {
+                id: toastColumn
+                anchors.left: parent.left
+                anchors.right: parent.right
+                anchors.verticalCenter: parent.verticalCenter
+                anchors.leftMargin: 14
+                anchors.rightMargin: 14
+                spacing: 2
+
+                Text {
+                    width: parent.width
+                    text: model.count > 1 ? model.title + "  (" + model.count + ")" : model.title
+                    visible: text !== ""
+                    elide: Text.ElideRight
+                    font.pixelSize: 16
+                    font.weight: Font.Medium
+                    color: Theme.textPrimary
+                }
+
+                Text {
+                    width: parent.width
+                    text: model.text
+                    wrapMode: Text.Wrap
+                    maximumLineCount: 2
+                    elide: Text.ElideRight
+                    font.pixelSize: 14
+                    color: Theme.textSecondary
+                }
+            }
+        }
+    }
+}
@@ -14,6 +14,14 @@ Rectangle {
     property bool bluetoothConnected: false
     property bool wifiConnected: false
 
+    // Phone status; each follows its own backend signal, so a battery tick
+    // does not re-evaluate the signal or call bindings
+    property int phoneSignal: typeof backend !== "undefined" ? backend.phoneSignal : -1
+    property int phoneBattery: typeof backend !== "undefined" ? backend.phoneBattery : -1
+    property bool phoneBatteryCritical: typeof backend !== "undefined" && backend.phoneBatteryCritical
+    property bool phoneInCall: typeof backend !== "undefined" && backend.phoneInCall
+    property string phoneCaller: typeof backend !== "undefined" ? backend.phoneCaller : ""
+
     height: Theme.statusBarHeight
     color: Qt.rgba(0, 0, 0, Theme.overlayOpacity)
 
@@ -43,6 +51,45 @@ Rectangle {
             spacing: Theme.spacing
             Layout.alignment: Qt.AlignVCenter
 
+            // Call in progress
+            Text {
+                text: root.phoneCaller !== "" ? root.phoneCaller : "Call"
+                font.pixelSize: Theme.fontSizeSmall
+                font.family: Theme.fontFamily
+                font.bold: true
+                color: Theme.successColor
+                visible: root.phoneInCall
+                Layout.alignment: Qt.AlignVCenter
+            }
+
+            // Phone signal, as up to four bars
+            Row {
+                spacing: 2
+                visible: root.phoneSignal >= 0
+                Layout.alignment: Qt.AlignVCenter
+
+                Repeater {
+                    model: 4
+
+                    Rectangle {
+                        width: 4
+                        height: 5 + index * 5
+                        anchors.bottom: parent.bottom
+                        color: index < root.phoneSignal ? Theme.textPrimary : Theme.textMuted
+                    }
+                }
+            }
+
+            // Phone battery
+            Text {
+                text: root.phoneBattery + "%"
+                font.pixelSize: Theme.fontSizeSmall
+                font.family: Theme.fontFamily
+                color: root.phoneBatteryCritical ? Theme.dangerColor : Theme.textSecondary
+                visible: root.phoneBattery >= 0
+                Layout.alignment: Qt.AlignVCenter
+            }
+
             // WiFi indicator
             Rectangle {
                 width: 32
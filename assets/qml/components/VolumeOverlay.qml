@@ -54,7 +54,7 @@ Rectangle {
             anchors.verticalCenter: parent.verticalCenter
             width: 28
             height: 28
-            source: Theme.imgPath + "volume-hot.png"
+            source: Theme.icon("volume-hot.png")
             fillMode: Image.PreserveAspectFit
         }
 
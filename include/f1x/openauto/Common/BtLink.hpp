@@ -0,0 +1,175 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace common
+{
+
+// Bluetooth link between btservice and autoapp: one datagram per event on
+// abstract Unix sockets, so nothing touches the filesystem and a process
+// that is not running simply misses the datagram. btservice replays its
+// current state whenever autoapp announces itself with Hello.
+enum class BtLinkMessage : uint8_t
+{
+    Hello = 1,          // autoapp started: replay the current state
+    AdapterState,       // value: QBluetoothLocalDevice::HostMode
+    PairingFinished,    // address; value 1 when paired
+    PhoneConnected,     // address and name of the RFCOMM peer
+    PhoneDisconnected,  // address
+    WifiOffered,        // name: the hotspot SSID sent to the phone
+    WifiStatus,         // value: aaw::Status of the phone's hotspot join
+    PairingRequested,   // autoapp to btservice; value: seconds to stay discoverable
+    ServiceStage        // name: startup stage done, value: ms it took; "ready" last
+};
+
+// ServiceStage names, in the order btservice goes through them
+constexpr const char *cBtServiceStages[] = {"adapter", "listen", "register", "announce", "ready"};
+constexpr const char *cBtServiceReady = "ready";
+
+inline bool isBtServiceStage(const std::string &name)
+{
+    return std::any_of(std::begin(cBtServiceStages), std::end(cBtServiceStages),
+                       [&name](const char *stage) { return name == stage; });
+}
+
+struct BtLinkEvent
+{
+    BtLinkMessage type = BtLinkMessage::Hello;
+    int32_t value = 0;
+    std::string address;
+    std::string name;
+};
+
+constexpr const char *cBtLinkAutoappSocket = "openauto-autoapp";
+constexpr const char *cBtLinkBtserviceSocket = "openauto-btservice";
+constexpr uint8_t cBtLinkVersion = 1;
+// Version, type, value, then the two strings each behind a length byte
+constexpr size_t cBtLinkHeaderSize = 6;
+constexpr size_t cBtLinkMaxSize = cBtLinkHeaderSize + 2 * 256;
+
+inline std::string encodeBtLinkEvent(const BtLinkEvent &event)
+{
+    std::string packet(cBtLinkHeaderSize, '\0');
+    packet[0] = static_cast<char>(cBtLinkVersion);
+    packet[1] = static_cast<char>(event.type);
+    const uint32_t value = static_cast<uint32_t>(event.value);
+    for (int i = 0; i < 4; ++i)
+    {
+        packet[2 + i] = static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+    for (const std::string *text : {&event.address, &event.name})
+    {
+        const size_t size = std::min<size_t>(text->size(), 255);
+        packet.push_back(static_cast<char>(size));
+        packet.append(*text, 0, size);
+    }
+    return packet;
+}
+
+inline bool decodeBtLinkEvent(const char *data, size_t size, BtLinkEvent &event)
+{
+    if (size < cBtLinkHeaderSize || static_cast<uint8_t>(data[0]) != cBtLinkVersion)
+    {
+        return false;
+    }
+    event.type = static_cast<BtLinkMessage>(data[1]);
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(data[2 + i])) << (8 * i);
+    }
+    event.value = static_cast<int32_t>(value);
+    size_t offset = cBtLinkHeaderSize;
+    for (std::string *text : {&event.address, &event.name})
+    {
+        if (offset >= size)
+        {
+            return false;
+        }
+        const size_t length = static_cast<uint8_t>(data[offset++]);
+        if (offset + length > size)
+        {
+            return false;
+        }
+        text->assign(data + offset, length);
+        offset += length;
+    }
+    return true;
+}
+
+inline socklen_t btLinkAddress(const char *name, sockaddr_un &address)
+{
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    // Leading NUL: the abstract namespace, gone with the last descriptor
+    const size_t length = std::min(std::strlen(name), sizeof(address.sun_path) - 2);
+    std::memcpy(address.sun_path + 1, name, length);
+    return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + length);
+}
+
+// Non-blocking datagram socket bound to @p name; -1 with errno set, EADDRINUSE
+// when another instance holds it
+inline int openBtLinkSocket(const char *name)
+{
+    const int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    sockaddr_un address;
+    const socklen_t length = btLinkAddress(name, address);
+    if (bind(fd, reinterpret_cast<const sockaddr *>(&address), length) != 0)
+    {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+// False when nobody listens on @p peer, which is not an error for the caller
+inline bool sendBtLinkEvent(int fd, const char *peer, const BtLinkEvent &event)
+{
+    sockaddr_un address;
+    const socklen_t length = btLinkAddress(peer, address);
+    const std::string packet = encodeBtLinkEvent(event);
+    return sendto(fd, packet.data(), packet.size(), MSG_NOSIGNAL, reinterpret_cast<const sockaddr *>(&address),
+                  length) == static_cast<ssize_t>(packet.size());
+}
+
+}
+}
+}
@@ -0,0 +1,92 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace common
+{
+
+// SIMD extensions of the CPU we run on, as opposed to the one we were built
+// for: an armv7 image boots on boards with and without NEON
+struct CpuFeatures
+{
+    bool neon = false;
+    bool sse2 = false;
+    bool sse41 = false;
+    bool avx2 = false;
+
+    // Detected on first use, from AT_HWCAP on ARM and cpuid on x86.
+    // OPENAUTO_SIMD=off reports none, so every kernel runs its scalar
+    // reference
+    static const CpuFeatures &host();
+    // What the machine has, without the override
+    static CpuFeatures detect();
+
+    // "neon", "sse2 sse4.1 avx2", or "none"
+    std::string describe() const;
+};
+
+// The builds of one kernel. The scalar one is the reference and always
+// there; a vector build is null where this target has none
+template <typename Fn>
+struct KernelVariants
+{
+    Fn scalar = nullptr;
+    Fn neon = nullptr;
+
+    Fn select(const CpuFeatures &features) const
+    {
+        if(neon != nullptr && features.neon)
+        {
+            return neon;
+        }
+        return scalar;
+    }
+};
+
+// Checks of bound kernels against their scalar references. Debug builds run
+// them once at startup; a failing kernel is logged by name
+class KernelSelfTest
+{
+public:
+    typedef std::function<bool()> Check;
+
+    static KernelSelfTest &instance();
+
+    void add(std::string name, Check check);
+    // Runs every check; returns how many failed
+    size_t run() const;
+
+private:
+    std::vector<std::pair<std::string, Check>> checks_;
+};
+
+}
+}
+}
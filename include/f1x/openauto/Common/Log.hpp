@@ -18,7 +18,109 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <boost/log/trivial.hpp>
 
+// Levels below this are compiled out: 0 trace, 1 debug, 2 info, 3 warning,
+// 4 error, 5 fatal
+#ifndef OPENAUTO_MIN_LOG_LEVEL
+#define OPENAUTO_MIN_LOG_LEVEL 0
+#endif
+
+namespace f1x
+{
+namespace openauto
+{
+namespace common
+{
+
+// Lowest level logged at run time. Checked before Boost.Log opens a record,
+// so a disabled statement costs one branch and never formats its stream
+inline std::atomic<int> logThreshold{boost::log::trivial::trace};
+
+template <boost::log::trivial::severity_level Level>
+inline bool logEnabled()
+{
+    if constexpr (Level < OPENAUTO_MIN_LOG_LEVEL)
+    {
+        return false;
+    }
+    else
+    {
+        return Level >= logThreshold.load(std::memory_order_relaxed);
+    }
+}
+
+// Counters of one throttled logging statement
+class LogSite
+{
+public:
+    // Occurrence number on the 1st, n+1th, ... call, otherwise 0
+    uint64_t everyN(uint64_t n)
+    {
+        const uint64_t count = count_.fetch_add(1, std::memory_order_relaxed) + 1;
+        return (count - 1) % n == 0 ? count : 0;
+    }
+
+    // Occurrence number on the first n calls, otherwise 0
+    uint64_t firstN(uint64_t n)
+    {
+        if (count_.load(std::memory_order_relaxed) >= n)
+        {
+            return 0;
+        }
+        const uint64_t count = count_.fetch_add(1, std::memory_order_relaxed) + 1;
+        return count <= n ? count : 0;
+    }
+
+    // Occurrences since the last logged one, at most once per interval,
+    // otherwise 0
+    uint64_t everyMs(int64_t intervalMs)
+    {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t due = nextMs_.load(std::memory_order_relaxed);
+        if (now < due || !nextMs_.compare_exchange_strong(due, now + intervalMs, std::memory_order_relaxed))
+        {
+            return 0;
+        }
+        return pending_.exchange(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> pending_{0};
+    std::atomic<int64_t> nextMs_{0};
+};
+
+}
+}
+}
+
+// A LogSite private to the statement that expands this
+#define OPENAUTO_LOG_SITE \
+    ([]() -> ::f1x::openauto::common::LogSite & { static ::f1x::openauto::common::LogSite site; return site; }())
+
 #define OPENAUTO_LOG_CONTEXT "" //"(" << typeid(*this).name() << "::" << __func__ << ")"
-#define OPENAUTO_LOG(severity) BOOST_LOG_TRIVIAL(severity) << "[OpenAuto] " << OPENAUTO_LOG_CONTEXT
+// A for rather than an if around the record, so an unbraced
+// "if (x) OPENAUTO_LOG(...) << ...; else ..." keeps its else
+#define OPENAUTO_LOG(severity) \
+    for (bool openautoLogOnce_ = ::f1x::openauto::common::logEnabled<::boost::log::trivial::severity>(); \
+         openautoLogOnce_; openautoLogOnce_ = false) \
+        BOOST_LOG_TRIVIAL(severity) << "[OpenAuto] " << OPENAUTO_LOG_CONTEXT
+
+// Throttled variants, each statement counting on its own. The message can
+// stream OPENAUTO_LOG_OCCURRENCES: the occurrence number for EVERY_N and
+// FIRST_N, the occurrences since the previous line for EVERY_MS
+#define OPENAUTO_LOG_OCCURRENCES openautoLogOccurrences_
+#define OPENAUTO_LOG_THROTTLED(severity, check) \
+    for (uint64_t OPENAUTO_LOG_OCCURRENCES = \
+             ::f1x::openauto::common::logEnabled<::boost::log::trivial::severity>() ? OPENAUTO_LOG_SITE.check : 0; \
+         OPENAUTO_LOG_OCCURRENCES != 0; OPENAUTO_LOG_OCCURRENCES = 0) \
+        BOOST_LOG_TRIVIAL(severity) << "[OpenAuto] " << OPENAUTO_LOG_CONTEXT
+#define OPENAUTO_LOG_EVERY_N(severity, n) OPENAUTO_LOG_THROTTLED(severity, everyN(n))
+#define OPENAUTO_LOG_FIRST_N(severity, n) OPENAUTO_LOG_THROTTLED(severity, firstN(n))
+#define OPENAUTO_LOG_EVERY_MS(severity, ms) OPENAUTO_LOG_THROTTLED(severity, everyMs(ms))
@@ -0,0 +1,126 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            class MetricCounter;
+            class MetricGauge;
+
+            /**
+             * @brief Subsystems whose allocations AllocationAccounting counts
+             */
+            enum class AllocationTag
+            {
+                MessageBuffers, // Fresh MessageBufferPool buffers; what it keeps is MemoryPool::Video
+                Protobuf, // MessageArena blocks
+                UiModels, // QVariantList models handed to QML
+                FFmpeg, // Packet buffers given to the decoder
+                Count
+            };
+
+            const char *allocationTagName(AllocationTag tag);
+
+            struct AllocationStats
+            {
+                uint64_t allocations = 0;
+                uint64_t bytes = 0;
+                int64_t liveBytes = 0;
+            };
+
+            /**
+             * @brief Where tagged allocations come from
+             */
+            class AllocatorBackend
+            {
+            public:
+                virtual ~AllocatorBackend() = default;
+                virtual const char *name() const = 0;
+                // nullptr when out of memory; @p alignment is a power of two
+                virtual void *allocate(size_t bytes, size_t alignment) = 0;
+                virtual void deallocate(void *data) = 0;
+            };
+
+            /**
+             * @brief AllocationAccounting - Allocation counts and bytes per subsystem
+             *
+             * Memory taken through allocate() comes from the selected backend:
+             * the system allocator, or mimalloc in builds with USE_MIMALLOC,
+             * picked by OPENAUTO_ALLOCATOR=system|mimalloc before anything is
+             * allocated. Storage a container allocates for itself (aasdk's
+             * Data, Qt's lists) cannot be routed, so its owner reports it with
+             * record() and release(), or countTransient() for a model that is
+             * built, handed over and dropped. Each tag is exported as
+             * openauto_alloc_<tag>_total, _bytes_total and _live_bytes.
+             */
+            class AllocationAccounting
+            {
+            public:
+                static AllocationAccounting &instance();
+
+                /**
+                 * @brief Switches backend; false if @p name is unknown or memory
+                 * was already allocated through the current one
+                 */
+                bool selectBackend(const std::string &name);
+                const char *backendName() const;
+
+                void *allocate(AllocationTag tag, size_t bytes, size_t alignment = alignof(std::max_align_t));
+                void deallocate(AllocationTag tag, void *data, size_t bytes);
+
+                void record(AllocationTag tag, size_t bytes);
+                void release(AllocationTag tag, size_t bytes);
+                void countTransient(AllocationTag tag, size_t bytes);
+
+                AllocationStats stats(AllocationTag tag) const;
+
+                /**
+                 * @brief Single-line human readable summary for logs
+                 */
+                std::string summary() const;
+
+            private:
+                struct Tag
+                {
+                    MetricCounter *allocations = nullptr;
+                    MetricCounter *bytes = nullptr;
+                    MetricGauge *liveBytes = nullptr;
+                };
+
+                AllocationAccounting();
+
+                std::atomic<AllocatorBackend *> backend_;
+                std::atomic<bool> used_{false};
+                std::array<Tag, static_cast<size_t>(AllocationTag::Count)> tags_{};
+            };
+
+        }
+    }
+}
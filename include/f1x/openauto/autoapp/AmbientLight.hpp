@@ -0,0 +1,169 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            // [Sensors] LightDevice, LightNightLux, LightDayLux, LightBacklight
+            struct AmbientLightSettings
+            {
+                // Directory under bus/iio/devices, or "auto" for the first light sensor
+                std::string device;
+                double nightLux = 10.0;
+                double dayLux = 30.0;
+                // Name under class/backlight, "auto" for the first; empty leaves it alone
+                std::string backlight;
+            };
+
+            /**
+             * @brief An IIO scan element's format, from scan_elements/<channel>_type,
+             * e.g. "le:u16/16>>0"
+             */
+            struct IioScanType
+            {
+                bool bigEndian = false;
+                bool isSigned = false;
+                int bits = 0;
+                int storageBits = 0;
+                int shift = 0;
+            };
+
+            /**
+             * @brief LightFilter - Smoothed lux, night mode and backlight level
+             *
+             * Readings go through an exponential average with a cTimeConstantMs
+             * time constant, so headlights sweeping past do not count. Night
+             * starts when the average drops below nightLux and ends when it
+             * rises above dayLux; in between nothing changes. The backlight
+             * follows the average on a log scale from cMinBrightness at
+             * nightLux to full at cFullBrightnessLux.
+             */
+            class LightFilter
+            {
+            public:
+                static constexpr double cTimeConstantMs = 2000.0;
+                static constexpr double cMinBrightness = 0.1;
+                static constexpr double cFullBrightnessLux = 1000.0;
+
+                LightFilter(double nightLux, double dayLux);
+
+                // True when night() changed, and for the first reading
+                bool update(double lux, int64_t atMs);
+
+                bool hasReading() const { return hasReading_; }
+                double lux() const { return lux_; }
+                bool night() const { return night_; }
+                // Share of the backlight's range, cMinBrightness to 1
+                double brightness() const;
+
+            private:
+                const double nightLux_;
+                const double dayLux_;
+                bool hasReading_ = false;
+                int64_t lastMs_ = 0;
+                double lux_ = 0.0;
+                bool night_ = false;
+            };
+
+            /**
+             * @brief AmbientLight - Night mode and backlight from an IIO light sensor
+             *
+             * The sensor's illuminance channel is captured through the IIO
+             * buffer: the only enabled scan element, the device's own trigger
+             * if it has one, and a thread sleeping in poll() on
+             * /dev/iio:deviceN until the driver pushes a sample. Sensors
+             * without a buffer are read from sysfs every cPollMs instead.
+             * When LightFilter crosses a threshold the NightMode flag is set
+             * or cleared on the StateBus, which SensorService forwards to the
+             * phone at once. On the same thread the backlight's brightness
+             * node, opened once, ramps to the filter's level in cRampStepMs
+             * steps, covering the whole range in cRampMs.
+             */
+            class AmbientLight
+            {
+            public:
+                static constexpr int cPollMs = 500;
+                static constexpr int cRampStepMs = 20;
+                static constexpr int cRampMs = 1000;
+                static constexpr int cBufferLength = 16;
+
+                /**
+                 * @param sysfsRoot Holds bus/iio/devices and class/backlight, @p devRoot
+                 * the iio:deviceN nodes; test trees in the unit tests.
+                 */
+                explicit AmbientLight(AmbientLightSettings settings, std::string sysfsRoot = "/sys",
+                                      std::string devRoot = "/dev");
+                ~AmbientLight();
+
+                AmbientLight(const AmbientLight &) = delete;
+                AmbientLight &operator=(const AmbientLight &) = delete;
+
+                // False, with nothing started, when there is no light sensor
+                bool start();
+                void stop();
+
+                static bool parseScanType(const std::string &text, IioScanType &type);
+                // One sample of @p type from @p data, storageBits / 8 bytes
+                static int64_t decode(const uint8_t *data, const IioScanType &type);
+
+            private:
+                std::string resolveDevice() const;
+                bool openBuffer();
+                void closeBuffer();
+                bool openPolled();
+                void openBacklight();
+                void run();
+                void readBuffer();
+                void onLux(double lux);
+                // Moves one step towards the target; false once it is there
+                bool rampStep();
+
+                const AmbientLightSettings settings_;
+                const std::string sysfsRoot_;
+                const std::string devRoot_;
+                std::string directory_;
+                std::string channel_;
+                IioScanType scanType_;
+                double scale_ = 1.0;
+                double offset_ = 0.0;
+                int bufferFd_ = -1;
+                int polledFd_ = -1;
+                int backlightFd_ = -1;
+                int maxBrightness_ = 0;
+                int brightness_ = -1;
+                int targetBrightness_ = -1;
+                LightFilter filter_;
+                int wakeFd_;
+                std::atomic<bool> stopping_{false};
+                std::thread thread_;
+            };
+
+        }
+    }
+}
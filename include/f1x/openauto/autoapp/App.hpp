@@ -19,11 +19,14 @@
 #pragma once
 
 #include <functional>
+#include <boost/asio/steady_timer.hpp>
 #include <aasdk/USB/IUSBHub.hpp>
 #include <aasdk/USB/IConnectedAccessoriesEnumerator.hpp>
 #include <aasdk/USB/USBWrapper.hpp>
 #include <aasdk/TCP/ITCPWrapper.hpp>
 #include <aasdk/TCP/ITCPEndpoint.hpp>
+#include <f1x/openauto/autoapp/ConnectionArbiter.hpp>
+#include <f1x/openauto/autoapp/Configuration/IKnownDevicesList.hpp>
 #include <f1x/openauto/autoapp/Service/IAndroidAutoEntityEventHandler.hpp>
 #include <f1x/openauto/autoapp/Service/IAndroidAutoEntityFactory.hpp>
 
@@ -40,7 +43,8 @@ namespace f1x
                 typedef std::shared_ptr<App> Pointer;
 
                 App(boost::asio::io_service &ioService, aasdk::usb::USBWrapper &usbWrapper, aasdk::tcp::ITCPWrapper &tcpWrapper, service::IAndroidAutoEntityFactory &androidAutoEntityFactory,
-                    aasdk::usb::IUSBHub::Pointer usbHub, aasdk::usb::IConnectedAccessoriesEnumerator::Pointer connectedAccessoriesEnumerator);
+                    aasdk::usb::IUSBHub::Pointer usbHub, aasdk::usb::IConnectedAccessoriesEnumerator::Pointer connectedAccessoriesEnumerator,
+                    configuration::IKnownDevicesList::Pointer knownDevices = nullptr);
 
                 void waitForUSBDevice();
                 void start(aasdk::tcp::ITCPEndpoint::SocketPointer socket);
@@ -59,7 +63,15 @@ namespace f1x
                 void enumerateDevices();
                 void waitForDevice();
                 void aoapDeviceHandler(aasdk::usb::DeviceHandle deviceHandle);
+                // Stops and drops the running entity, if any; @p caller tags the logs
+                void stopEntity(const char *caller);
                 void onUSBHubError(const aasdk::error::Error &error);
+                // Opens a phone from knownDevices_ already in accessory mode, skipping the AOAP query chain
+                bool openKnownAccessory();
+                void rememberDevice(const aasdk::usb::DeviceHandle &deviceHandle);
+                // Samples the wireless client's TCP_INFO until stopEntity()
+                void sampleWirelessLink();
+                static int onUsbDeviceArrived(libusb_context *context, libusb_device *device, libusb_hotplug_event event, void *userData);
 
                 boost::asio::io_service &ioService_;
                 aasdk::usb::USBWrapper &usbWrapper_;
@@ -71,6 +83,12 @@ namespace f1x
                 boost::asio::ip::tcp::acceptor acceptor_;
                 service::IAndroidAutoEntity::Pointer androidAutoEntity_;
                 bool isStopped_;
+                configuration::IKnownDevicesList::Pointer knownDevices_;
+                aasdk::usb::HotplugCallbackHandle arrivalCallback_;
+                ConnectionArbiter arbiter_;
+                // Native handle of the wireless session's socket, -1 without one
+                int wirelessSocket_;
+                boost::asio::steady_timer linkTimer_;
 
                 void startServerSocket();
 
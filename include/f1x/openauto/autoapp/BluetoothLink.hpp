@@ -0,0 +1,97 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <f1x/openauto/Common/BtLink.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            /**
+             * @brief BluetoothLink - btservice's pairing and connection events
+             *
+             * Listens on the abstract socket btservice publishes to, and says
+             * Hello on start so btservice replays what happened before autoapp
+             * came up. Replaces polling files such as /tmp/btdevice: subscribers
+             * hear of a phone within a datagram's latency. Handlers run on the
+             * link thread and must not block.
+             */
+            class BluetoothLink
+            {
+            public:
+                typedef std::function<void(const common::BtLinkEvent &event)> Handler;
+
+                BluetoothLink(std::string socketName, std::string peerName);
+                ~BluetoothLink();
+
+                BluetoothLink(const BluetoothLink &) = delete;
+                BluetoothLink &operator=(const BluetoothLink &) = delete;
+
+                /**
+                 * @brief The link to btservice, started on first use.
+                 */
+                static BluetoothLink &instance();
+
+                bool phoneConnected() const;
+                std::string phoneName() const;
+                std::string phoneAddress() const;
+                // The SSID btservice handed the phone; empty before that
+                std::string hotspotSsid() const;
+                // btservice has its RFCOMM service registered and can take phones
+                bool serviceReady() const;
+
+                // Asks btservice to be discoverable for @p seconds; false when it
+                // is not running
+                bool requestPairing(int seconds);
+
+                int subscribe(Handler handler);
+                void unsubscribe(int id);
+
+            private:
+                void handle(const common::BtLinkEvent &event);
+                void run();
+
+                const std::string peerName_;
+                mutable std::mutex mutex_;
+                bool phoneConnected_;
+                bool serviceReady_;
+                std::string phoneName_;
+                std::string phoneAddress_;
+                std::string hotspotSsid_;
+                std::map<int, Handler> handlers_;
+                int nextHandlerId_;
+                int fd_;
+                int wakeFd_;
+                std::atomic<bool> stopping_;
+                std::thread thread_;
+            };
+
+        }
+    }
+}
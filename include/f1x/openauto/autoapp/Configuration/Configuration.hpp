@@ -22,7 +22,10 @@
 #include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <stdio.h>
 
@@ -31,13 +34,165 @@ namespace openauto {
 namespace autoapp {
 namespace configuration {
 
+/**
+ * Every setting Configuration holds, in one flat copyable block. describe()
+ * lists each field once with its INI group, key and default; the INI
+ * reader and writer, reset() and the binary snapshot all walk that list.
+ */
+struct ConfigurationValues {
+  template <typename Visitor> void describe(Visitor &visitor);
+
+  HandednessOfTrafficType handednessOfTrafficType_;
+  bool showClock_;
+
+  bool showBigClock_;
+  bool oldGUI_;
+  size_t alphaTrans_;
+  bool hideMenuToggle_;
+  bool hideAlpha_;
+  bool showLux_;
+  bool showCursor_;
+  bool hideBrightnessControl_;
+  bool showNetworkinfo_;
+  bool hideWarning_;
+  std::string mp3MasterPath_;
+  std::string mp3SubFolder_;
+  int32_t mp3Track_;
+  bool mp3AutoPlay_;
+  bool showAutoPlay_;
+  bool instantPlay_;
+  std::string sessionRecordingPath_;
+  bool tlsSessionResumption_;
+  std::string tlsCipherPreference_;
+  bool usbFastReconnect_;
+  bool playerReplayGain_;
+  int32_t usbInTransfers_;
+  int32_t usbInTransferKb_;
+  bool outboundPriority_;
+  bool messageBufferPool_;
+
+  aap_protobuf::service::media::sink::message::VideoFrameRateType videoFPS_;
+  aap_protobuf::service::media::sink::message::VideoCodecResolutionType
+      videoResolution_;
+  size_t screenDPI_;
+  int32_t omxLayerIndex_;
+  QRect videoMargins_;
+  bool enableTouchscreen_;
+  bool enablePlayerControl_;
+  IConfiguration::ButtonCodes buttonCodes_;
+  BluetoothAdapterType bluetoothAdapterType_;
+  std::string bluetoothAdapterAddress_;
+  bool wirelessProjectionEnabled_;
+  size_t videoFrameQueueDepth_;
+  bool videoAdaptiveMode_;
+  size_t videoMaxUnacked_;
+  bool videoCompositorImport_;
+  int32_t touchCoalesceMs_;
+  int32_t touchPredictionMs_;
+  std::string touchscreenDevice_;
+  std::string keyDevices_;
+  std::string keyMap_;
+  uint32_t rotaryAccelerationDetents_;
+  std::string videoBackend_;
+  std::string rearCameraDevice_;
+  bool rearCameraHotStandby_;
+  bool rearCameraGuidelines_;
+  bool dashcamEnabled_;
+  std::string dashcamDirectory_;
+  uint32_t dashcamSegmentSeconds_;
+  uint32_t dashcamMaxDiskMb_;
+  uint32_t dashcamBitrateKbps_;
+  std::string clusterOutput_;
+  int32_t videoDisplayRotation_;
+  bool videoDisplayMirror_;
+  bool wirelessTcpNoDelay_;
+  int32_t wirelessTcpReceiveBufferKb_;
+  int32_t wirelessTcpSendBufferKb_;
+  bool wirelessTcpQuickAck_;
+  int32_t wirelessTcpDscp_;
+  int32_t wirelessTcpBusyPollUs_;
+  bool wirelessTcpLinkStats_;
+  std::string wirelessHotspotInterface_;
+  bool wirelessHotspotAutoChannel_;
+  int32_t wirelessHotspotChannelWidthMhz_;
+  bool wirelessHotspotPowerSaveOff_;
+
+  bool _audioChannelEnabledMedia;
+  bool _audioChannelEnabledGuidance;
+  bool _audioChannelEnabledSystem;
+  bool _audioChannelEnabledTelephony;
+
+  std::string audioOutputDeviceName_;
+  std::string audioInputDeviceName_;
+  bool audioLowLatency_;
+  uint32_t audioJitterBufferMs_;
+  bool audioMixerEnabled_;
+  uint32_t audioDuckingPercent_;
+  bool audioVoiceProcessing_;
+  bool audioVoiceProcessingLowCpu_;
+  int32_t audioVoiceProcessingCpu_;
+  uint32_t threadIoWorkers_;
+  std::string threadWorkerCpus_;
+  std::string threadVideoCpus_;
+  std::string threadAudioCpus_;
+  int32_t threadVideoPriority_;
+  int32_t threadAudioPriority_;
+  std::string sensorCanInterface_;
+  std::string sensorCanSignals_;
+  std::string sensorObdDevice_;
+  std::string sensorIioDevice_;
+  std::string sensorLightDevice_;
+  int32_t sensorLightNightLux_;
+  int32_t sensorLightDayLux_;
+  std::string sensorLightBacklight_;
+  bool sensorGpsNightMode_;
+  bool sensorRestrictWhileMoving_;
+  uint32_t metricsHttpPort_;
+  std::string metricsStatsdTarget_;
+  bool metricsOverlay_;
+  uint32_t audioAckBatch_;
+  bool audioMediaAac_;
+  uint32_t audioMicPreRollMs_;
+  std::string radioDevice_;
+  std::string radioAudioDevice_;
+  std::string radioRegion_;
+  bool audioWarmStreams_;
+  bool audioDspEnabled_;
+  std::string audioEqualizerGains_;
+  uint32_t audioLoudnessPercent_;
+  uint32_t audioDspCpuBudgetPercent_;
+  std::string threadPowerProfileProjection_;
+  std::string threadPowerProfileIdle_;
+  std::string threadPowerDevfreqDevices_;
+  bool threadStrandMonitor_;
+  int32_t threadStrandLongTaskMs_;
+};
+
+/**
+ * openauto.ini stays the human-editable source. load() reads it in one pass
+ * and keeps a versioned binary snapshot next to it; on the next start the
+ * snapshot is used as long as the INI has not changed since. save() is
+ * debounced and written off the calling thread with an atomic write-rename;
+ * load() and destruction wait for a pending write.
+ *
+ * The values are read-copy-update: getters read an immutable
+ * ConfigurationValues published through an atomic shared_ptr, so any thread
+ * may call them while the GUI changes settings. Each setter copies the
+ * current values, changes one field and publishes the copy.
+ */
 class Configuration : public IConfiguration {
 public:
+  static const std::string cConfigFileName;
+  static const std::string cSnapshotFileName;
+
   Configuration();
+  ~Configuration() override;
 
   void load() override;
   void reset() override;
   void save() override;
+  size_t subscribe(ChangeHandler handler) override;
+  void unsubscribe(size_t subscription) override;
 
   bool hasTouchScreen() const override;
 
@@ -66,6 +221,22 @@ public:
   bool showNetworkinfo() const override;
   void hideWarning(bool value) override;
   bool hideWarning() const override;
+  std::string getSessionRecordingPath() const override;
+  void setSessionRecordingPath(const std::string &value) override;
+  bool getTlsSessionResumption() const override;
+  void setTlsSessionResumption(bool value) override;
+  std::string getTlsCipherPreference() const override;
+  void setTlsCipherPreference(const std::string &value) override;
+  bool getUsbFastReconnect() const override;
+  void setUsbFastReconnect(bool value) override;
+  int32_t getUsbInTransfers() const override;
+  void setUsbInTransfers(int32_t value) override;
+  int32_t getUsbInTransferKb() const override;
+  void setUsbInTransferKb(int32_t value) override;
+  bool getOutboundPriority() const override;
+  void setOutboundPriority(bool value) override;
+  bool getMessageBufferPool() const override;
+  void setMessageBufferPool(bool value) override;
 
   std::string getMp3MasterPath() const override;
   void setMp3MasterPath(const std::string &value) override;
@@ -79,6 +250,8 @@ public:
   void showAutoPlay(bool value) override;
   bool instantPlay() const override;
   void instantPlay(bool value) override;
+  bool getPlayerReplayGain() const override;
+  void setPlayerReplayGain(bool value) override;
 
   QString getCSValue(QString searchString) const override;
   QString readFileContent(QString fileName) const override;
@@ -101,6 +274,38 @@ public:
   int32_t getOMXLayerIndex() const override;
   void setVideoMargins(QRect value) override;
   QRect getVideoMargins() const override;
+  size_t getVideoFrameQueueDepth() const override;
+  void setVideoFrameQueueDepth(size_t value) override;
+  bool getVideoAdaptiveMode() const override;
+  void setVideoAdaptiveMode(bool value) override;
+  size_t getVideoMaxUnacked() const override;
+  void setVideoMaxUnacked(size_t value) override;
+  bool getVideoCompositorImport() const override;
+  void setVideoCompositorImport(bool value) override;
+  std::string getVideoBackend() const override;
+  void setVideoBackend(const std::string &value) override;
+  std::string getRearCameraDevice() const override;
+  void setRearCameraDevice(const std::string &value) override;
+  bool getRearCameraHotStandby() const override;
+  void setRearCameraHotStandby(bool value) override;
+  bool getRearCameraGuidelines() const override;
+  void setRearCameraGuidelines(bool value) override;
+  bool getDashcamEnabled() const override;
+  void setDashcamEnabled(bool value) override;
+  std::string getDashcamDirectory() const override;
+  void setDashcamDirectory(const std::string &value) override;
+  uint32_t getDashcamSegmentSeconds() const override;
+  void setDashcamSegmentSeconds(uint32_t value) override;
+  uint32_t getDashcamMaxDiskMb() const override;
+  void setDashcamMaxDiskMb(uint32_t value) override;
+  uint32_t getDashcamBitrateKbps() const override;
+  void setDashcamBitrateKbps(uint32_t value) override;
+  std::string getClusterOutput() const override;
+  void setClusterOutput(const std::string &value) override;
+  int32_t getVideoDisplayRotation() const override;
+  void setVideoDisplayRotation(int32_t value) override;
+  bool getVideoDisplayMirror() const override;
+  void setVideoDisplayMirror(bool value) override;
 
   bool getTouchscreenEnabled() const override;
   void setTouchscreenEnabled(bool value) override;
@@ -108,6 +313,18 @@ public:
   void playerButtonControl(bool value) override;
   ButtonCodes getButtonCodes() const override;
   void setButtonCodes(const ButtonCodes &value) override;
+  int32_t getTouchCoalesceMs() const override;
+  void setTouchCoalesceMs(int32_t value) override;
+  int32_t getTouchPredictionMs() const override;
+  void setTouchPredictionMs(int32_t value) override;
+  std::string getTouchscreenDevice() const override;
+  void setTouchscreenDevice(const std::string &value) override;
+  std::string getKeyDevices() const override;
+  void setKeyDevices(const std::string &value) override;
+  std::string getKeyMap() const override;
+  void setKeyMap(const std::string &value) override;
+  uint32_t getRotaryAccelerationDetents() const override;
+  void setRotaryAccelerationDetents(uint32_t value) override;
 
   BluetoothAdapterType getBluetoothAdapterType() const override;
   void setBluetoothAdapterType(BluetoothAdapterType value) override;
@@ -115,6 +332,28 @@ public:
   void setBluetoothAdapterAddress(const std::string &value) override;
   bool getWirelessProjectionEnabled() const override;
   void setWirelessProjectionEnabled(bool value) override;
+  bool getWirelessTcpNoDelay() const override;
+  void setWirelessTcpNoDelay(bool value) override;
+  int32_t getWirelessTcpReceiveBufferKb() const override;
+  void setWirelessTcpReceiveBufferKb(int32_t value) override;
+  int32_t getWirelessTcpSendBufferKb() const override;
+  void setWirelessTcpSendBufferKb(int32_t value) override;
+  bool getWirelessTcpQuickAck() const override;
+  void setWirelessTcpQuickAck(bool value) override;
+  int32_t getWirelessTcpDscp() const override;
+  void setWirelessTcpDscp(int32_t value) override;
+  int32_t getWirelessTcpBusyPollUs() const override;
+  void setWirelessTcpBusyPollUs(int32_t value) override;
+  bool getWirelessTcpLinkStats() const override;
+  void setWirelessTcpLinkStats(bool value) override;
+  std::string getWirelessHotspotInterface() const override;
+  void setWirelessHotspotInterface(const std::string &value) override;
+  bool getWirelessHotspotAutoChannel() const override;
+  void setWirelessHotspotAutoChannel(bool value) override;
+  int32_t getWirelessHotspotChannelWidthMhz() const override;
+  void setWirelessHotspotChannelWidthMhz(int32_t value) override;
+  bool getWirelessHotspotPowerSaveOff() const override;
+  void setWirelessHotspotPowerSaveOff(bool value) override;
 
   bool musicAudioChannelEnabled() const override;
   void setMusicAudioChannelEnabled(bool value) override;
@@ -129,56 +368,110 @@ public:
   void setAudioOutputDeviceName(const std::string &value) override;
   std::string getAudioInputDeviceName() const override;
   void setAudioInputDeviceName(const std::string &value) override;
+  bool getAudioLowLatency() const override;
+  void setAudioLowLatency(bool value) override;
+  uint32_t getAudioJitterBufferMs() const override;
+  void setAudioJitterBufferMs(uint32_t value) override;
+  bool getAudioMixerEnabled() const override;
+  void setAudioMixerEnabled(bool value) override;
+  uint32_t getAudioDuckingPercent() const override;
+  void setAudioDuckingPercent(uint32_t value) override;
+  bool getAudioVoiceProcessing() const override;
+  void setAudioVoiceProcessing(bool value) override;
+  bool getAudioVoiceProcessingLowCpu() const override;
+  void setAudioVoiceProcessingLowCpu(bool value) override;
+  int32_t getAudioVoiceProcessingCpu() const override;
+  void setAudioVoiceProcessingCpu(int32_t value) override;
+  uint32_t getThreadIoWorkers() const override;
+  void setThreadIoWorkers(uint32_t value) override;
+  std::string getThreadWorkerCpus() const override;
+  void setThreadWorkerCpus(const std::string &value) override;
+  std::string getThreadVideoCpus() const override;
+  void setThreadVideoCpus(const std::string &value) override;
+  std::string getThreadAudioCpus() const override;
+  void setThreadAudioCpus(const std::string &value) override;
+  int32_t getThreadVideoPriority() const override;
+  void setThreadVideoPriority(int32_t value) override;
+  int32_t getThreadAudioPriority() const override;
+  void setThreadAudioPriority(int32_t value) override;
+  std::string getSensorCanInterface() const override;
+  void setSensorCanInterface(const std::string &value) override;
+  std::string getSensorCanSignals() const override;
+  void setSensorCanSignals(const std::string &value) override;
+  std::string getSensorObdDevice() const override;
+  void setSensorObdDevice(const std::string &value) override;
+  std::string getSensorIioDevice() const override;
+  void setSensorIioDevice(const std::string &value) override;
+  std::string getSensorLightDevice() const override;
+  void setSensorLightDevice(const std::string &value) override;
+  int32_t getSensorLightNightLux() const override;
+  void setSensorLightNightLux(int32_t value) override;
+  int32_t getSensorLightDayLux() const override;
+  void setSensorLightDayLux(int32_t value) override;
+  std::string getSensorLightBacklight() const override;
+  void setSensorLightBacklight(const std::string &value) override;
+  bool getSensorGpsNightMode() const override;
+  void setSensorGpsNightMode(bool value) override;
+  bool getSensorRestrictWhileMoving() const override;
+  void setSensorRestrictWhileMoving(bool value) override;
+  uint32_t getMetricsHttpPort() const override;
+  void setMetricsHttpPort(uint32_t value) override;
+  std::string getMetricsStatsdTarget() const override;
+  void setMetricsStatsdTarget(const std::string &value) override;
+  bool getMetricsOverlay() const override;
+  void setMetricsOverlay(bool value) override;
+  uint32_t getAudioAckBatch() const override;
+  void setAudioAckBatch(uint32_t value) override;
+  bool getAudioMediaAac() const override;
+  void setAudioMediaAac(bool value) override;
+  uint32_t getAudioMicPreRollMs() const override;
+  void setAudioMicPreRollMs(uint32_t value) override;
+  std::string getRadioDevice() const override;
+  void setRadioDevice(const std::string &value) override;
+  std::string getRadioAudioDevice() const override;
+  void setRadioAudioDevice(const std::string &value) override;
+  std::string getRadioRegion() const override;
+  void setRadioRegion(const std::string &value) override;
+  bool getAudioWarmStreams() const override;
+  void setAudioWarmStreams(bool value) override;
+  bool getAudioDspEnabled() const override;
+  void setAudioDspEnabled(bool value) override;
+  std::string getAudioEqualizerGains() const override;
+  void setAudioEqualizerGains(const std::string &value) override;
+  uint32_t getAudioLoudnessPercent() const override;
+  void setAudioLoudnessPercent(uint32_t value) override;
+  uint32_t getAudioDspCpuBudgetPercent() const override;
+  void setAudioDspCpuBudgetPercent(uint32_t value) override;
+  std::string getThreadPowerProfileProjection() const override;
+  void setThreadPowerProfileProjection(const std::string &value) override;
+  std::string getThreadPowerProfileIdle() const override;
+  void setThreadPowerProfileIdle(const std::string &value) override;
+  std::string getThreadPowerDevfreqDevices() const override;
+  void setThreadPowerDevfreqDevices(const std::string &value) override;
+  bool getThreadStrandMonitor() const override;
+  void setThreadStrandMonitor(bool value) override;
+  int32_t getThreadStrandLongTaskMs() const override;
+  void setThreadStrandLongTaskMs(int32_t value) override;
 
 private:
-  void readButtonCodes(boost::property_tree::ptree &iniConfig);
-  void insertButtonCode(
-      boost::property_tree::ptree &iniConfig, const std::string &buttonCodeKey,
-      aap_protobuf::service::media::sink::message::KeyCode buttonCode);
-  void writeButtonCodes(boost::property_tree::ptree &iniConfig);
+  typedef std::shared_ptr<const ConfigurationValues> Snapshot;
 
-  HandednessOfTrafficType handednessOfTrafficType_;
-  bool showClock_;
+  Snapshot current() const;
+  template <typename T, typename V>
+  void set(T ConfigurationValues::*field, V &&value);
+  void publish(ConfigurationValues values);
+  void notifySubscribers();
+  bool loadSnapshot(ConfigurationValues &values) const;
+  static void writeFiles(ConfigurationValues &values, bool ini);
 
-  bool showBigClock_;
-  bool oldGUI_;
-  size_t alphaTrans_;
-  bool hideMenuToggle_;
-  bool hideAlpha_;
-  bool showLux_;
-  bool showCursor_;
-  bool hideBrightnessControl_;
-  bool showNetworkinfo_;
-  bool hideWarning_;
-  std::string mp3MasterPath_;
-  std::string mp3SubFolder_;
-  int32_t mp3Track_;
-  bool mp3AutoPlay_;
-  bool showAutoPlay_;
-  bool instantPlay_;
+  Snapshot current_;
+  // Serializes writers; readers never take it
+  std::mutex updateMutex_;
+  std::mutex subscribersMutex_;
+  std::vector<std::pair<size_t, ChangeHandler>> subscribers_;
+  size_t nextSubscription_;
 
-  aap_protobuf::service::media::sink::message::VideoFrameRateType videoFPS_;
-  aap_protobuf::service::media::sink::message::VideoCodecResolutionType
-      videoResolution_;
-  size_t screenDPI_;
-  int32_t omxLayerIndex_;
-  QRect videoMargins_;
-  bool enableTouchscreen_;
-  bool enablePlayerControl_;
-  ButtonCodes buttonCodes_;
-  BluetoothAdapterType bluetoothAdapterType_;
-  std::string bluetoothAdapterAddress_;
-  bool wirelessProjectionEnabled_;
-
-  bool _audioChannelEnabledMedia;
-  bool _audioChannelEnabledGuidance;
-  bool _audioChannelEnabledSystem;
-  bool _audioChannelEnabledTelephony;
 
-  std::string audioOutputDeviceName_;
-  std::string audioInputDeviceName_;
-
-  static const std::string cConfigFileName;
 
   static const std::string cGeneralShowClockKey;
 
@@ -24,6 +24,7 @@
 #include <aap_protobuf/service/media/sink/message/VideoFrameRateType.pb.h>
 #include <f1x/openauto/autoapp/Configuration/BluetoothAdapterType.hpp>
 #include <f1x/openauto/autoapp/Configuration/HandednessOfTrafficType.hpp>
+#include <functional>
 #include <string>
 
 namespace f1x {
@@ -43,6 +44,12 @@ public:
   virtual void reset() = 0;
   virtual void save() = 0;
 
+  // Runs after each load(), reset() and save(), on the thread that called
+  // it; for consumers that apply settings once and need to reconfigure
+  typedef std::function<void()> ChangeHandler;
+  virtual size_t subscribe(ChangeHandler handler) = 0;
+  virtual void unsubscribe(size_t subscription) = 0;
+
   virtual bool hasTouchScreen() const = 0;
 
   virtual void setHandednessOfTrafficType(HandednessOfTrafficType value) = 0;
@@ -69,6 +76,22 @@ public:
   virtual bool showNetworkinfo() const = 0;
   virtual void hideWarning(bool value) = 0;
   virtual bool hideWarning() const = 0;
+  virtual std::string getSessionRecordingPath() const = 0;
+  virtual void setSessionRecordingPath(const std::string &value) = 0;
+  virtual bool getTlsSessionResumption() const = 0;
+  virtual void setTlsSessionResumption(bool value) = 0;
+  virtual std::string getTlsCipherPreference() const = 0;
+  virtual void setTlsCipherPreference(const std::string &value) = 0;
+  virtual bool getUsbFastReconnect() const = 0;
+  virtual void setUsbFastReconnect(bool value) = 0;
+  virtual int32_t getUsbInTransfers() const = 0;
+  virtual void setUsbInTransfers(int32_t value) = 0;
+  virtual int32_t getUsbInTransferKb() const = 0;
+  virtual void setUsbInTransferKb(int32_t value) = 0;
+  virtual bool getOutboundPriority() const = 0;
+  virtual void setOutboundPriority(bool value) = 0;
+  virtual bool getMessageBufferPool() const = 0;
+  virtual void setMessageBufferPool(bool value) = 0;
 
   virtual std::string getMp3MasterPath() const = 0;
   virtual void setMp3MasterPath(const std::string &value) = 0;
@@ -82,6 +105,8 @@ public:
   virtual void showAutoPlay(bool value) = 0;
   virtual bool instantPlay() const = 0;
   virtual void instantPlay(bool value) = 0;
+  virtual bool getPlayerReplayGain() const = 0;
+  virtual void setPlayerReplayGain(bool value) = 0;
 
   virtual QString getCSValue(QString searchString) const = 0;
   virtual QString readFileContent(QString fileName) const = 0;
@@ -104,6 +129,38 @@ public:
   virtual int32_t getOMXLayerIndex() const = 0;
   virtual void setVideoMargins(QRect value) = 0;
   virtual QRect getVideoMargins() const = 0;
+  virtual size_t getVideoFrameQueueDepth() const = 0;
+  virtual void setVideoFrameQueueDepth(size_t value) = 0;
+  virtual bool getVideoAdaptiveMode() const = 0;
+  virtual void setVideoAdaptiveMode(bool value) = 0;
+  virtual size_t getVideoMaxUnacked() const = 0;
+  virtual void setVideoMaxUnacked(size_t value) = 0;
+  virtual bool getVideoCompositorImport() const = 0;
+  virtual void setVideoCompositorImport(bool value) = 0;
+  virtual std::string getVideoBackend() const = 0;
+  virtual void setVideoBackend(const std::string &value) = 0;
+  virtual std::string getRearCameraDevice() const = 0;
+  virtual void setRearCameraDevice(const std::string &value) = 0;
+  virtual bool getRearCameraHotStandby() const = 0;
+  virtual void setRearCameraHotStandby(bool value) = 0;
+  virtual bool getRearCameraGuidelines() const = 0;
+  virtual void setRearCameraGuidelines(bool value) = 0;
+  virtual bool getDashcamEnabled() const = 0;
+  virtual void setDashcamEnabled(bool value) = 0;
+  virtual std::string getDashcamDirectory() const = 0;
+  virtual void setDashcamDirectory(const std::string &value) = 0;
+  virtual uint32_t getDashcamSegmentSeconds() const = 0;
+  virtual void setDashcamSegmentSeconds(uint32_t value) = 0;
+  virtual uint32_t getDashcamMaxDiskMb() const = 0;
+  virtual void setDashcamMaxDiskMb(uint32_t value) = 0;
+  virtual uint32_t getDashcamBitrateKbps() const = 0;
+  virtual void setDashcamBitrateKbps(uint32_t value) = 0;
+  virtual std::string getClusterOutput() const = 0;
+  virtual void setClusterOutput(const std::string &value) = 0;
+  virtual int32_t getVideoDisplayRotation() const = 0;
+  virtual void setVideoDisplayRotation(int32_t value) = 0;
+  virtual bool getVideoDisplayMirror() const = 0;
+  virtual void setVideoDisplayMirror(bool value) = 0;
 
   virtual bool getTouchscreenEnabled() const = 0;
   virtual void setTouchscreenEnabled(bool value) = 0;
@@ -111,6 +168,18 @@ public:
   virtual void playerButtonControl(bool value) = 0;
   virtual ButtonCodes getButtonCodes() const = 0;
   virtual void setButtonCodes(const ButtonCodes &value) = 0;
+  virtual int32_t getTouchCoalesceMs() const = 0;
+  virtual void setTouchCoalesceMs(int32_t value) = 0;
+  virtual int32_t getTouchPredictionMs() const = 0;
+  virtual void setTouchPredictionMs(int32_t value) = 0;
+  virtual std::string getTouchscreenDevice() const = 0;
+  virtual void setTouchscreenDevice(const std::string &value) = 0;
+  virtual std::string getKeyDevices() const = 0;
+  virtual void setKeyDevices(const std::string &value) = 0;
+  virtual std::string getKeyMap() const = 0;
+  virtual void setKeyMap(const std::string &value) = 0;
+  virtual uint32_t getRotaryAccelerationDetents() const = 0;
+  virtual void setRotaryAccelerationDetents(uint32_t value) = 0;
 
   virtual BluetoothAdapterType getBluetoothAdapterType() const = 0;
   virtual void setBluetoothAdapterType(BluetoothAdapterType value) = 0;
@@ -118,6 +187,28 @@ public:
   virtual void setBluetoothAdapterAddress(const std::string &value) = 0;
   virtual bool getWirelessProjectionEnabled() const = 0;
   virtual void setWirelessProjectionEnabled(bool value) = 0;
+  virtual bool getWirelessTcpNoDelay() const = 0;
+  virtual void setWirelessTcpNoDelay(bool value) = 0;
+  virtual int32_t getWirelessTcpReceiveBufferKb() const = 0;
+  virtual void setWirelessTcpReceiveBufferKb(int32_t value) = 0;
+  virtual int32_t getWirelessTcpSendBufferKb() const = 0;
+  virtual void setWirelessTcpSendBufferKb(int32_t value) = 0;
+  virtual bool getWirelessTcpQuickAck() const = 0;
+  virtual void setWirelessTcpQuickAck(bool value) = 0;
+  virtual int32_t getWirelessTcpDscp() const = 0;
+  virtual void setWirelessTcpDscp(int32_t value) = 0;
+  virtual int32_t getWirelessTcpBusyPollUs() const = 0;
+  virtual void setWirelessTcpBusyPollUs(int32_t value) = 0;
+  virtual bool getWirelessTcpLinkStats() const = 0;
+  virtual void setWirelessTcpLinkStats(bool value) = 0;
+  virtual std::string getWirelessHotspotInterface() const = 0;
+  virtual void setWirelessHotspotInterface(const std::string &value) = 0;
+  virtual bool getWirelessHotspotAutoChannel() const = 0;
+  virtual void setWirelessHotspotAutoChannel(bool value) = 0;
+  virtual int32_t getWirelessHotspotChannelWidthMhz() const = 0;
+  virtual void setWirelessHotspotChannelWidthMhz(int32_t value) = 0;
+  virtual bool getWirelessHotspotPowerSaveOff() const = 0;
+  virtual void setWirelessHotspotPowerSaveOff(bool value) = 0;
 
   virtual bool musicAudioChannelEnabled() const = 0;
   virtual void setMusicAudioChannelEnabled(bool value) = 0;
@@ -132,6 +223,90 @@ public:
   virtual void setAudioOutputDeviceName(const std::string &value) = 0;
   virtual std::string getAudioInputDeviceName() const = 0;
   virtual void setAudioInputDeviceName(const std::string &value) = 0;
+  virtual bool getAudioLowLatency() const = 0;
+  virtual void setAudioLowLatency(bool value) = 0;
+  virtual uint32_t getAudioJitterBufferMs() const = 0;
+  virtual void setAudioJitterBufferMs(uint32_t value) = 0;
+  virtual bool getAudioMixerEnabled() const = 0;
+  virtual void setAudioMixerEnabled(bool value) = 0;
+  virtual uint32_t getAudioDuckingPercent() const = 0;
+  virtual void setAudioDuckingPercent(uint32_t value) = 0;
+  virtual bool getAudioVoiceProcessing() const = 0;
+  virtual void setAudioVoiceProcessing(bool value) = 0;
+  virtual bool getAudioVoiceProcessingLowCpu() const = 0;
+  virtual void setAudioVoiceProcessingLowCpu(bool value) = 0;
+  virtual int32_t getAudioVoiceProcessingCpu() const = 0;
+  virtual void setAudioVoiceProcessingCpu(int32_t value) = 0;
+  virtual uint32_t getThreadIoWorkers() const = 0;
+  virtual void setThreadIoWorkers(uint32_t value) = 0;
+  virtual std::string getThreadWorkerCpus() const = 0;
+  virtual void setThreadWorkerCpus(const std::string &value) = 0;
+  virtual std::string getThreadVideoCpus() const = 0;
+  virtual void setThreadVideoCpus(const std::string &value) = 0;
+  virtual std::string getThreadAudioCpus() const = 0;
+  virtual void setThreadAudioCpus(const std::string &value) = 0;
+  virtual int32_t getThreadVideoPriority() const = 0;
+  virtual void setThreadVideoPriority(int32_t value) = 0;
+  virtual int32_t getThreadAudioPriority() const = 0;
+  virtual void setThreadAudioPriority(int32_t value) = 0;
+  virtual std::string getSensorCanInterface() const = 0;
+  virtual void setSensorCanInterface(const std::string &value) = 0;
+  virtual std::string getSensorCanSignals() const = 0;
+  virtual void setSensorCanSignals(const std::string &value) = 0;
+  virtual std::string getSensorObdDevice() const = 0;
+  virtual void setSensorObdDevice(const std::string &value) = 0;
+  virtual std::string getSensorIioDevice() const = 0;
+  virtual void setSensorIioDevice(const std::string &value) = 0;
+  virtual std::string getSensorLightDevice() const = 0;
+  virtual void setSensorLightDevice(const std::string &value) = 0;
+  virtual int32_t getSensorLightNightLux() const = 0;
+  virtual void setSensorLightNightLux(int32_t value) = 0;
+  virtual int32_t getSensorLightDayLux() const = 0;
+  virtual void setSensorLightDayLux(int32_t value) = 0;
+  virtual std::string getSensorLightBacklight() const = 0;
+  virtual void setSensorLightBacklight(const std::string &value) = 0;
+  virtual bool getSensorGpsNightMode() const = 0;
+  virtual void setSensorGpsNightMode(bool value) = 0;
+  virtual bool getSensorRestrictWhileMoving() const = 0;
+  virtual void setSensorRestrictWhileMoving(bool value) = 0;
+  virtual uint32_t getMetricsHttpPort() const = 0;
+  virtual void setMetricsHttpPort(uint32_t value) = 0;
+  virtual std::string getMetricsStatsdTarget() const = 0;
+  virtual void setMetricsStatsdTarget(const std::string &value) = 0;
+  virtual bool getMetricsOverlay() const = 0;
+  virtual void setMetricsOverlay(bool value) = 0;
+  virtual uint32_t getAudioAckBatch() const = 0;
+  virtual void setAudioAckBatch(uint32_t value) = 0;
+  virtual bool getAudioMediaAac() const = 0;
+  virtual void setAudioMediaAac(bool value) = 0;
+  virtual uint32_t getAudioMicPreRollMs() const = 0;
+  virtual void setAudioMicPreRollMs(uint32_t value) = 0;
+  virtual std::string getRadioDevice() const = 0;
+  virtual void setRadioDevice(const std::string &value) = 0;
+  virtual std::string getRadioAudioDevice() const = 0;
+  virtual void setRadioAudioDevice(const std::string &value) = 0;
+  virtual std::string getRadioRegion() const = 0;
+  virtual void setRadioRegion(const std::string &value) = 0;
+  virtual bool getAudioWarmStreams() const = 0;
+  virtual void setAudioWarmStreams(bool value) = 0;
+  virtual bool getAudioDspEnabled() const = 0;
+  virtual void setAudioDspEnabled(bool value) = 0;
+  virtual std::string getAudioEqualizerGains() const = 0;
+  virtual void setAudioEqualizerGains(const std::string &value) = 0;
+  virtual uint32_t getAudioLoudnessPercent() const = 0;
+  virtual void setAudioLoudnessPercent(uint32_t value) = 0;
+  virtual uint32_t getAudioDspCpuBudgetPercent() const = 0;
+  virtual void setAudioDspCpuBudgetPercent(uint32_t value) = 0;
+  virtual std::string getThreadPowerProfileProjection() const = 0;
+  virtual void setThreadPowerProfileProjection(const std::string &value) = 0;
+  virtual std::string getThreadPowerProfileIdle() const = 0;
+  virtual void setThreadPowerProfileIdle(const std::string &value) = 0;
+  virtual std::string getThreadPowerDevfreqDevices() const = 0;
+  virtual void setThreadPowerDevfreqDevices(const std::string &value) = 0;
+  virtual bool getThreadStrandMonitor() const = 0;
+  virtual void setThreadStrandMonitor(bool value) = 0;
+  virtual int32_t getThreadStrandLongTaskMs() const = 0;
+  virtual void setThreadStrandLongTaskMs(int32_t value) = 0;
 };
 
 } // namespace configuration
@@ -0,0 +1,63 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace configuration
+{
+
+struct KnownDevice
+{
+    // As the phone enumerates once it is in accessory mode
+    uint16_t vendorId = 0;
+    uint16_t productId = 0;
+    std::string serial;
+    uint64_t sessions = 0;
+};
+
+class IKnownDevicesList
+{
+public:
+    typedef std::shared_ptr<IKnownDevicesList> Pointer;
+    typedef std::deque<KnownDevice> KnownDevices;
+
+    virtual ~IKnownDevicesList() = default;
+
+    virtual void read() = 0;
+    // Moves the device to the front, adding it if new, and saves the list
+    virtual void insertDevice(const KnownDevice& device) = 0;
+    virtual bool contains(const std::string& serial) const = 0;
+    virtual KnownDevices getList() const = 0;
+};
+
+}
+}
+}
+}
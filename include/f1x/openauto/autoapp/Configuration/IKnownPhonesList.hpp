@@ -0,0 +1,63 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace configuration
+{
+
+struct KnownPhone
+{
+    std::string address;
+    // The phone's Android Auto RFCOMM channel from the last SDP lookup; 0
+    // when the phone only ever connected to us
+    uint16_t channel = 0;
+};
+
+class IKnownPhonesList
+{
+public:
+    typedef std::shared_ptr<IKnownPhonesList> Pointer;
+    typedef std::deque<KnownPhone> KnownPhones;
+
+    virtual ~IKnownPhonesList() = default;
+
+    virtual void read() = 0;
+    // Moves the phone to the front, adding it if new; a @p channel of 0 keeps
+    // the one already cached. Saves only when something changed
+    virtual void remember(const std::string& address, uint16_t channel) = 0;
+    // The cached channel proved stale: look it up again next time
+    virtual void forgetChannel(const std::string& address) = 0;
+    virtual KnownPhones getList() const = 0;
+};
+
+}
+}
+}
+}
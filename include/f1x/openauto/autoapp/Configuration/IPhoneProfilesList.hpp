@@ -0,0 +1,77 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <aap_protobuf/service/media/sink/message/VideoCodecResolutionType.pb.h>
+#include <aap_protobuf/service/media/sink/message/VideoFrameRateType.pb.h>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace configuration
+{
+
+// What the head unit learned about one phone over its sessions
+struct PhoneProfile
+{
+    // The phone's model as it names itself in service discovery
+    std::string phone;
+    uint32_t sessions = 0;
+    // The video mode the last session settled on, requested first next time
+    aap_protobuf::service::media::sink::message::VideoCodecResolutionType videoResolution =
+        aap_protobuf::service::media::sink::message::VideoCodecResolutionType::VIDEO_800x480;
+    aap_protobuf::service::media::sink::message::VideoFrameRateType videoFps =
+        aap_protobuf::service::media::sink::message::VideoFrameRateType::VIDEO_FPS_30;
+    // Video ACK window that kept up; 0 for the video output's own
+    uint32_t videoMaxUnacked = 0;
+    // Running averages over the sessions
+    double decodeFps = 0.0;
+    double droppedPermille = 0.0;
+    double streamKbps = 0.0;
+    double rttMs = 0.0;
+};
+
+class IPhoneProfilesList
+{
+public:
+    typedef std::shared_ptr<IPhoneProfilesList> Pointer;
+    typedef std::deque<PhoneProfile> PhoneProfiles;
+
+    virtual ~IPhoneProfilesList() = default;
+
+    virtual void read() = 0;
+    // False if @p phone has no profile yet
+    virtual bool find(const std::string& phone, PhoneProfile& profile) const = 0;
+    // Replaces the phone's profile and moves it to the front; saves
+    virtual void remember(const PhoneProfile& profile) = 0;
+    virtual PhoneProfiles getList() const = 0;
+};
+
+}
+}
+}
+}
@@ -0,0 +1,62 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <f1x/openauto/autoapp/Configuration/IKnownDevicesList.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace configuration
+{
+
+/**
+ * Phones that reached accessory mode before, persisted like the recent
+ * WiFi addresses so a replug can skip straight to opening the accessory.
+ */
+class KnownDevicesList: public IKnownDevicesList
+{
+public:
+    KnownDevicesList(size_t maxListSize);
+
+    void read() override;
+    void insertDevice(const KnownDevice& device) override;
+    bool contains(const std::string& serial) const override;
+    KnownDevices getList() const override;
+
+private:
+    void load();
+    void save();
+
+    size_t maxListSize_;
+    KnownDevices list_;
+
+    static const std::string cConfigFileName;
+    static const std::string cKnownEntriesCount;
+    static const std::string cKnownEntryPrefix;
+};
+
+}
+}
+}
+}
@@ -0,0 +1,62 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <f1x/openauto/autoapp/Configuration/IKnownPhonesList.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace configuration
+{
+
+/**
+ * Phones that completed the Bluetooth hand-off, most recent first, so
+ * btservice can call the last one back on boot instead of waiting in
+ * discovery for it.
+ */
+class KnownPhonesList: public IKnownPhonesList
+{
+public:
+    KnownPhonesList(size_t maxListSize);
+
+    void read() override;
+    void remember(const std::string& address, uint16_t channel) override;
+    void forgetChannel(const std::string& address) override;
+    KnownPhones getList() const override;
+
+private:
+    void load();
+    void save();
+
+    size_t maxListSize_;
+    KnownPhones list_;
+
+    static const std::string cConfigFileName;
+    static const std::string cEntriesCount;
+    static const std::string cEntryPrefix;
+};
+
+}
+}
+}
+}
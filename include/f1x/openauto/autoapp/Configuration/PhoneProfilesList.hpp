@@ -0,0 +1,64 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <f1x/openauto/autoapp/Configuration/IPhoneProfilesList.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace configuration
+{
+
+/**
+ * Per-phone video history in openauto_phone_profiles.ini, most recently
+ * connected first, so a phone that encodes 1080p60 poorly starts its next
+ * session in the mode it ended the last one in. The oldest phone is
+ * forgotten once the list is full.
+ */
+class PhoneProfilesList: public IPhoneProfilesList
+{
+public:
+    PhoneProfilesList(size_t maxListSize);
+
+    void read() override;
+    bool find(const std::string& phone, PhoneProfile& profile) const override;
+    void remember(const PhoneProfile& profile) override;
+    PhoneProfiles getList() const override;
+
+private:
+    void load();
+    void save();
+
+    size_t maxListSize_;
+    PhoneProfiles list_;
+
+    static const std::string cConfigFileName;
+    static const std::string cEntriesCount;
+    static const std::string cEntryPrefix;
+};
+
+}
+}
+}
+}
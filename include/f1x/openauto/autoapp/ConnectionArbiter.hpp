@@ -0,0 +1,74 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <f1x/openauto/autoapp/LinkQuality.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            enum class ConnectionTransport
+            {
+                None,
+                Usb,
+                Wifi
+            };
+
+            enum class ArbiterDecision
+            {
+                Accept,  // nothing running: start the session
+                Replace, // stop the running session for the new one
+                Reject   // keep the running session, drop the new connection
+            };
+
+            const char *connectionTransportName(ConnectionTransport transport);
+
+            /**
+             * @brief ConnectionArbiter - Picks which transport owns the session
+             *
+             * A dual-capable phone may come up over USB and WiFi at once, and a
+             * second phone may try WiFi while one is projecting. USB is
+             * preferred: it replaces a WiFi session, and WiFi never replaces a
+             * USB one. WiFi replaces WiFi only when the running session looks
+             * dead (LinkQuality not good), which is the phone reconnecting after
+             * a dropout; a healthy one is kept.
+             *
+             * Used from the App strand only.
+             */
+            class ConnectionArbiter
+            {
+            public:
+                ArbiterDecision offer(ConnectionTransport incoming, LinkState currentLink) const;
+
+                void started(ConnectionTransport transport) { current_ = transport; }
+                void ended() { current_ = ConnectionTransport::None; }
+                ConnectionTransport current() const { return current_; }
+
+            private:
+                ConnectionTransport current_ = ConnectionTransport::None;
+            };
+
+        }
+    }
+}
@@ -0,0 +1,106 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            // Codes are stored in the ring file; append only
+            enum class FlightEvent : uint16_t
+            {
+                None,
+                ProcessStarted,         // a: pid
+                SessionStarted,         // a: 0 USB, 1 WiFi
+                SessionStopped,
+                ChannelOpened,          // a: service id
+                ChannelError,           // a: service id, 0 for control; b: aasdk error code
+                VideoFocus,             // a: 1 projected, 0 native
+                DecoderError,           // a: FFmpeg error
+                DecoderRecovery,        // a: DecoderRecovery step
+                AudioXrun,              // a: channel count
+                Touch,                  // a: pointer action, b: pointer count
+                Signal                  // a: signal number
+            };
+
+            const char *flightEventName(FlightEvent event);
+
+            /**
+             * @brief FlightRecorder - Last few thousand events, kept across a crash
+             *
+             * A fixed ring of binary events in a shared mapping of a file in
+             * /dev/shm, so whatever the process recorded is in the page cache
+             * when it dies, however it dies. Recording is a relaxed fetch_add,
+             * a clock read and five stores, with no lock; each slot carries its
+             * sequence number so a slot torn by the crash is recognised. open()
+             * first decodes what an earlier run left behind without calling
+             * close(), which is how the next start finds a crash.
+             */
+            class FlightRecorder
+            {
+            public:
+                static constexpr uint32_t cCapacity = 4096; // 128 KB, a power of two
+                static constexpr const char *cDefaultPath = "/dev/shm/openauto-flight";
+
+                static FlightRecorder &instance();
+
+                FlightRecorder() = default;
+                ~FlightRecorder();
+
+                FlightRecorder(const FlightRecorder &) = delete;
+                FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+                // Before any thread records; false leaves recording off
+                bool open(const std::string &path = cDefaultPath);
+                // Marks the ring as a clean exit and unmaps it
+                void close();
+
+                void record(FlightEvent event, int64_t a = 0, int32_t b = 0);
+                // Async-signal-safe: schedules the mapping's write-back
+                void flush();
+
+                // The events an unclean earlier run left, oldest first, one
+                // line each; empty after a clean exit
+                const std::vector<std::string> &previousRun() const { return previousRun_; }
+
+            private:
+                struct Header;
+                struct Slot;
+
+                // Lines for the events @p header holds, oldest first
+                static std::vector<std::string> decode(const Header &header, const Slot *slots);
+
+                Header *header_ = nullptr;
+                Slot *slots_ = nullptr;
+                size_t mappedSize_ = 0;
+                std::vector<std::string> previousRun_;
+            };
+
+        }
+    }
+}
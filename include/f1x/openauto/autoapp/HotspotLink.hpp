@@ -0,0 +1,175 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            // [Wireless] Hotspot* in openauto.ini
+            struct HotspotSettings
+            {
+                std::string interface = "wlan0";
+                std::string hostapdConfig = "/etc/hostapd/hostapd.conf";
+                // Moves hostapd to the least busy 5 GHz channel at startup
+                bool autoChannel = true;
+                // 20, 40 or 80; 80 turns on 802.11ac
+                int channelWidthMhz = 80;
+                // Turns WiFi power save off on the interface while a session runs
+                bool powerSaveOff = true;
+            };
+
+            // One access point heard in a scan
+            struct WifiNeighbour
+            {
+                int frequencyMhz = 0;
+                int signalDbm = -100;
+            };
+
+            // What the driver reports for the phone's association
+            struct StationStats
+            {
+                int64_t txBitrateKbps = 0;
+                int signalDbm = 0;
+                uint64_t txPackets = 0;
+                uint64_t txRetries = 0;
+                uint64_t txFailed = 0;
+            };
+
+            /**
+             * @brief HotspotLink - The WiFi link under wireless projection
+             *
+             * Whether 1080p works over WiFi is decided by the radio more than by
+             * TCP. selectChannel() scans once at startup and rewrites the
+             * channel and HT/VHT width in hostapd.conf to the least congested
+             * non-DFS 5 GHz channel. While a wireless session runs, power save
+             * is off on the interface and sample() reads the phone's station
+             * counters from hostapd's control socket, or with iw as a client;
+             * usableKbps(), the PHY rate less retries and 802.11 overhead, caps
+             * the video mode the phone is asked for. Sessions and samples run
+             * on a thread of the link's own, in the order they were asked for.
+             */
+            class HotspotLink
+            {
+            public:
+                // Called on the link thread; wrap it for a strand
+                typedef std::function<void(int64_t usableKbps)> SampleHandler;
+
+                static constexpr int cSampleIntervalMs = 2000;
+                // Share of the PHY rate one TCP stream gets after ACKs and contention
+                static constexpr int cTcpSharePercent = 50;
+                // Longest wait for an answer on hostapd's control socket
+                static constexpr int cControlTimeoutMs = 500;
+
+                HotspotLink() = default;
+                // Lets the queued work finish
+                ~HotspotLink();
+
+                HotspotLink(const HotspotLink &) = delete;
+                HotspotLink &operator=(const HotspotLink &) = delete;
+
+                static HotspotLink &instance();
+
+                void configure(const HotspotSettings &settings);
+
+                /**
+                 * @brief Scans and moves hostapd to the least congested channel.
+                 * Blocks for the scan (a few seconds); call it off the UI thread.
+                 * @return The channel in use afterwards, 0 if left alone.
+                 */
+                int selectChannel();
+
+                // For the wireless client on socket @p fd; the socket is only
+                // read before this returns
+                void startSession(int fd);
+                void endSession();
+                // Reads the station counters at most every cSampleIntervalMs,
+                // then calls @p handler with usableKbps()
+                void sample(SampleHandler handler);
+
+                // Throughput a video stream can count on; 0 when unknown or not on WiFi
+                int64_t usableKbps() const { return usableKbps_.load(std::memory_order_relaxed); }
+
+                // `iw dev <if> scan` output
+                static std::vector<WifiNeighbour> parseScan(const std::string &output);
+                // `iw dev <if> station get <mac>` or `iw dev <if> link` output
+                static bool parseStation(const std::string &output, StationStats &stats);
+                // Answer of hostapd's control socket to "STA <mac>"
+                static bool parseHostapdStation(const std::string &output, StationStats &stats);
+                /**
+                 * @brief Non-DFS 5 GHz primary channel with the least neighbour
+                 * energy in its @p widthMhz block, 0 without a candidate.
+                 * @param upperBand Whether channels 149-165 are allowed.
+                 */
+                static int leastCongestedChannel(const std::vector<WifiNeighbour> &neighbours, int widthMhz,
+                                                 bool upperBand);
+                // Sets channel and width in a hostapd.conf; false if unchanged or not written
+                static bool applyChannel(const std::string &path, int channel, int widthMhz);
+                // MAC of @p address on @p interface from the ARP table, empty if none
+                static std::string neighbourMac(const std::string &address, const std::string &interface,
+                                                const std::string &arpPath = "/proc/net/arp");
+
+            private:
+                HotspotSettings settings() const;
+                // Runs @p job on the link thread, started on first use
+                void post(std::function<void()> job);
+                void run();
+                // On the link thread
+                void beginSession(const HotspotSettings &settings, const std::string &peerAddress);
+                void closeSession();
+                void readStation();
+
+                mutable std::mutex mutex_;
+                std::condition_variable posted_;
+                HotspotSettings settings_;
+                std::deque<std::function<void()>> jobs_;
+                bool stopping_ = false;
+                std::thread thread_;
+
+                // Link thread only
+                HotspotSettings session_;
+                bool active_ = false;
+                // Empty when we are the client of someone else's access point
+                std::string stationMac_;
+                // hostapd's socket for the interface, empty without one
+                std::string controlPath_;
+                bool restorePowerSave_ = false;
+                StationStats last_;
+                std::chrono::steady_clock::time_point nextSample_;
+
+                std::atomic<int64_t> usableKbps_{0};
+            };
+
+        }
+    }
+}
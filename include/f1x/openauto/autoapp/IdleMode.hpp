@@ -0,0 +1,115 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            // DISCONNECTION_SCREEN_POWEROFF_SECS and _DISABLE
+            struct IdleSettings
+            {
+                int timeoutMs = 60 * 1000;
+                // Without the screen off the UI stays live, so idle is never entered
+                bool screenOff = true;
+            };
+
+            /**
+             * @brief IdleMode - Screen off and no periodic work without a phone
+             *
+             * When no session has run for timeoutMs and nobody has touched the
+             * screen, the backlights under class/backlight are powered down
+             * and the handlers are told to stop their timers. Nothing inside
+             * the process then wakes on its own: the io_service and libusb
+             * threads sleep in epoll/poll, so only USB hotplug, a Bluetooth
+             * connection, reverse gear or a touch end it, through
+             * onSessionStarted() or activity(). On the way out the context
+             * switches of all threads over the idle time give the wakeups per
+             * second, logged against cTargetWakeupsPerSecond.
+             */
+            class IdleMode : public std::enable_shared_from_this<IdleMode>
+            {
+            public:
+                typedef std::shared_ptr<IdleMode> Pointer;
+                // Called on the strand; must not block
+                typedef std::function<void(bool idle)> Handler;
+
+                static constexpr double cTargetWakeupsPerSecond = 1.0;
+
+                /**
+                 * @param sysfsRoot Holds class/backlight; a test tree in the unit tests.
+                 * @param procSelf Holds task/<tid>/status.
+                 */
+                IdleMode(boost::asio::io_service &ioService, std::string sysfsRoot = "/sys",
+                         std::string procSelf = "/proc/self");
+
+                void start(IdleSettings settings, Handler handler);
+                void configure(IdleSettings settings);
+                // Turns the screen back on at once, any thread; the handler is
+                // not called again
+                void stop();
+
+                // From the App's session callbacks, any thread
+                void onSessionStarted();
+                void onSessionStopped();
+                // A touch or a wake event: leaves idle and restarts the countdown
+                void activity(const std::string &reason);
+
+                bool idle() const { return idle_; }
+
+                // voluntary_ctxt_switches plus nonvoluntary_ctxt_switches of a status listing
+                static uint64_t parseContextSwitches(std::istream &in);
+
+            private:
+                void arm();
+                void enter();
+                void leave(const std::string &reason);
+                void setBacklight(bool on);
+                uint64_t contextSwitches() const;
+
+                boost::asio::io_service::strand strand_;
+                boost::asio::steady_timer timer_;
+                const std::string sysfsRoot_;
+                const std::string procSelf_;
+                IdleSettings settings_;
+                Handler handler_;
+                std::vector<std::string> backlights_;
+                bool started_ = false;
+                bool inSession_ = false;
+                std::atomic<bool> idle_{false};
+                std::chrono::steady_clock::time_point enteredAt_;
+                uint64_t switchesAtEntry_ = 0;
+            };
+
+        }
+    }
+}
@@ -0,0 +1,90 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            enum class LinkState
+            {
+                Unknown, // no pong measured yet in this session
+                Good,
+                Degraded,
+                Poor
+            };
+
+            const char *linkStateName(LinkState state);
+
+            /**
+             * @brief LinkQuality - Round trip estimate of the phone link
+             *
+             * Fed by the Pinger with one RTT per pong and smoothed the way TCP
+             * does (RFC 6298: srtt gains 1/8, rttvar 1/4). The video output reads
+             * state() on the decode path to trade buffering for latency, so the
+             * published values are plain atomics.
+             */
+            class LinkQuality
+            {
+            public:
+                static constexpr int64_t cGoodRttUs = 50000;
+                static constexpr int64_t cGoodJitterUs = 20000;
+                static constexpr int64_t cPoorRttUs = 250000;
+                static constexpr int64_t cPoorJitterUs = 100000;
+
+                static LinkQuality &instance();
+
+                /**
+                 * @brief Adds one measured round trip.
+                 * @return true when it spiked well above the smoothed RTT
+                 * (srtt + 4 * rttvar), measured before this sample is folded in.
+                 */
+                bool addSample(int64_t rttUs);
+                // Forgets the estimate, for a new session or link
+                void reset();
+
+                LinkState state() const { return state_.load(std::memory_order_relaxed); }
+                int64_t rttUs() const { return rttUs_.load(std::memory_order_relaxed); }
+                int64_t jitterUs() const { return jitterUs_.load(std::memory_order_relaxed); }
+
+                static LinkState classify(int64_t rttUs, int64_t jitterUs);
+
+            private:
+                void publish(LinkState state, int64_t rttUs, int64_t jitterUs);
+
+                std::mutex mutex_;
+                bool hasSample_ = false;
+                double srttUs_ = 0;
+                double rttvarUs_ = 0;
+
+                std::atomic<LinkState> state_{LinkState::Unknown};
+                std::atomic<int64_t> rttUs_{0};
+                std::atomic<int64_t> jitterUs_{0};
+            };
+
+        }
+    }
+}
@@ -0,0 +1,53 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <string>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            /**
+             * @brief Logging - Sets up where OPENAUTO_LOG records go
+             *
+             * Without a settings file records are formatted and written to
+             * stderr by a sink thread behind a bounded queue, so a statement
+             * on a decode or input path only pays for building its message.
+             * When the queue is full records are dropped rather than stalling
+             * the caller. OPENAUTO_LOG_LEVEL (trace ... fatal) sets the run
+             * time threshold.
+             */
+            class Logging
+            {
+            public:
+                // Uses @p iniPath instead of the default sink when it exists;
+                // its sinks may set Asynchronous=true for the same behaviour
+                static void configure(const std::string &iniPath);
+                // Writes out what is queued and joins the sink thread
+                static void shutdown();
+            };
+
+        }
+    }
+}
@@ -0,0 +1,139 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            class MetricGauge;
+
+            /**
+             * @brief Subsystems whose buffers are counted by MemoryFootprint
+             */
+            enum class MemoryPool
+            {
+                Audio, // Jitter, capture, echo reference and voice processing rings
+                Video, // Packets queued for the decoder, QtVideoOutput's stream
+                Count
+            };
+
+            const char *memoryPoolName(MemoryPool pool);
+
+            /**
+             * @brief VmRSS and RssAnon of a /proc/<pid>/status listing in bytes,
+             * -1 when unknown
+             */
+            struct ProcessMemory
+            {
+                int64_t residentBytes = -1;
+                int64_t anonymousBytes = -1;
+            };
+
+            /**
+             * @brief MemoryFootprint - Memory profile and per-subsystem accounting
+             *
+             * Boards with 1 GB or less (MemTotal, which includes the CMA area) run
+             * the low-memory profile: buffers that are sized from a duration of
+             * audio or video keep a shorter one. Building with LOW_MEMORY_PROFILE
+             * forces the profile everywhere.
+             *
+             * Owners register what they allocate with a MemoryCharge; summary()
+             * puts the counted pools next to the process' resident memory, and
+             * each pool is exported as an openauto_memory_*_bytes gauge.
+             */
+            class MemoryFootprint
+            {
+            public:
+                static constexpr int64_t cLowMemoryTotalBytes = 1024LL * 1024 * 1024;
+
+                static MemoryFootprint &instance();
+
+                /**
+                 * @brief MemTotal of a meminfo listing in bytes, -1 if missing
+                 */
+                static int64_t parseMemTotal(std::istream &in);
+                static ProcessMemory parseStatus(std::istream &in);
+
+                bool lowMemory() const { return lowMemory_; }
+
+                /**
+                 * @brief Bytes for @p ms of a stream of @p bytesPerSecond, or for
+                 * @p lowMemoryMs under the low-memory profile
+                 */
+                size_t bufferBytes(uint64_t bytesPerSecond, uint32_t ms, uint32_t lowMemoryMs) const;
+
+                void add(MemoryPool pool, int64_t bytes);
+                void release(MemoryPool pool, int64_t bytes);
+                int64_t allocatedBytes(MemoryPool pool) const;
+
+                /**
+                 * @brief Reads /proc/self/status and updates the resident gauge
+                 */
+                ProcessMemory process() const;
+
+                /**
+                 * @brief Single-line human readable summary for logs
+                 */
+                std::string summary() const;
+
+            private:
+                MemoryFootprint();
+
+                const bool lowMemory_;
+                std::array<std::atomic<int64_t>, static_cast<size_t>(MemoryPool::Count)> allocated_{};
+                std::array<MetricGauge *, static_cast<size_t>(MemoryPool::Count)> gauges_{};
+                MetricGauge *resident_;
+            };
+
+            /**
+             * @brief Counts @p bytes against a pool for the life of the owner
+             */
+            class MemoryCharge
+            {
+            public:
+                MemoryCharge(MemoryPool pool, int64_t bytes) : pool_(pool), bytes_(bytes)
+                {
+                    MemoryFootprint::instance().add(pool_, bytes_);
+                }
+
+                ~MemoryCharge() { MemoryFootprint::instance().release(pool_, bytes_); }
+
+                MemoryCharge(const MemoryCharge &) = delete;
+                MemoryCharge &operator=(const MemoryCharge &) = delete;
+
+            private:
+                const MemoryPool pool_;
+                const int64_t bytes_;
+            };
+
+        }
+    }
+}
@@ -0,0 +1,140 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            class MetricCounter
+            {
+            public:
+                void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+                uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+            private:
+                std::atomic<uint64_t> value_{0};
+            };
+
+            class MetricGauge
+            {
+            public:
+                void set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+                void add(int64_t delta) { value_.fetch_add(delta, std::memory_order_relaxed); }
+                int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+            private:
+                std::atomic<int64_t> value_{0};
+            };
+
+            /**
+             * @brief Fixed-bucket histogram. Bucket i counts observations at or
+             * below bounds[i]; the last bucket counts everything above.
+             */
+            class MetricHistogram
+            {
+            public:
+                explicit MetricHistogram(std::vector<double> bounds);
+
+                void observe(double value);
+
+                const std::vector<double> &bounds() const { return bounds_; }
+                // Per-bucket (not cumulative) counts, bounds().size() + 1 of them
+                std::vector<uint64_t> counts() const;
+                uint64_t count() const;
+                double sum() const;
+                // Upper bound of the bucket holding the @p q quantile
+                double quantile(double q) const;
+
+            private:
+                const std::vector<double> bounds_;
+                std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+                std::atomic<double> sum_{0.0};
+            };
+
+            /**
+             * @brief Metrics - Process-wide registry of counters, gauges and
+             * histograms
+             *
+             * Registration takes a lock and returns a reference that stays valid
+             * for the life of the process, so callers look a metric up once and
+             * keep it; updating one is a relaxed atomic operation. Registering a
+             * name again returns the existing metric.
+             */
+            class Metrics
+            {
+            public:
+                enum class Type
+                {
+                    Counter,
+                    Gauge,
+                    Histogram
+                };
+
+                struct Sample
+                {
+                    std::string name;
+                    Type type;
+                    double value; // counter or gauge value, histogram sum
+                    uint64_t count; // histogram observations
+                };
+
+                static Metrics &instance();
+
+                MetricCounter &counter(const std::string &name, const std::string &help);
+                MetricGauge &gauge(const std::string &name, const std::string &help);
+                MetricHistogram &histogram(const std::string &name, const std::string &help, std::vector<double> bounds);
+
+                // Prometheus text exposition format, version 0.0.4
+                std::string prometheusText() const;
+                std::vector<Sample> snapshot() const;
+                // One line per metric, histograms as their p50 and p99 buckets
+                std::string summary() const;
+
+            private:
+                struct Entry
+                {
+                    Type type;
+                    std::string help;
+                    std::unique_ptr<MetricCounter> counter;
+                    std::unique_ptr<MetricGauge> gauge;
+                    std::unique_ptr<MetricHistogram> histogram;
+                };
+
+                Entry &entry(const std::string &name, Type type, const std::string &help);
+
+                mutable std::mutex mutex_;
+                std::map<std::string, Entry> entries_;
+            };
+
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            /**
+             * @brief MetricsExporter - Publishes the Metrics registry off the unit
+             *
+             * Serves the Prometheus text format on GET /metrics when an HTTP port
+             * is set, along with a JPEG of the video on screen on GET
+             * /frame.jpg[?width=N], and pushes counters (as deltas), gauges and histogram
+             * averages to a StatsD host:port over UDP when a target is set. Both
+             * run on the given io_service; nothing is opened when both are off.
+             */
+            class MetricsExporter : public std::enable_shared_from_this<MetricsExporter>
+            {
+            public:
+                typedef std::shared_ptr<MetricsExporter> Pointer;
+
+                MetricsExporter(boost::asio::io_service &ioService, uint16_t httpPort, std::string statsdTarget);
+
+                void start();
+                void stop();
+
+            private:
+                static constexpr int cStatsdIntervalMs = 10000;
+                static constexpr int cRequestTimeoutMs = 5000;
+                static constexpr size_t cMaxRequestSize = 4096;
+                // Below the usual path MTU so no datagram is fragmented
+                static constexpr size_t cMaxDatagramSize = 1400;
+                static constexpr uint32_t cMaxFrameWidth = 1920;
+
+                void accept();
+                void serve(std::shared_ptr<boost::asio::ip::tcp::socket> socket);
+                void serveFrame(std::shared_ptr<boost::asio::ip::tcp::socket> socket, const std::string &target);
+                void scheduleStatsd();
+                void pushStatsd();
+
+                boost::asio::io_service &ioService_;
+                boost::asio::io_service::strand strand_;
+                const uint16_t httpPort_;
+                const std::string statsdTarget_;
+                boost::asio::ip::tcp::acceptor acceptor_;
+                boost::asio::ip::udp::socket statsdSocket_;
+                boost::asio::ip::udp::endpoint statsdEndpoint_;
+                boost::asio::steady_timer statsdTimer_;
+                std::map<std::string, std::pair<double, uint64_t>> lastPushed_;
+                bool stopped_;
+            };
+
+        }
+    }
+}
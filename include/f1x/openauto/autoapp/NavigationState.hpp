@@ -0,0 +1,128 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            /**
+             * @brief What the phone's navigation last said: the next manoeuvre
+             * and the distance to it.
+             *
+             * Enum values are the Android Auto wire values. The state travels
+             * over the StateBus as one compact "key=value;" line (see
+             * serialize()), so scripts can read /tmp/navigation_state too.
+             */
+            struct NavigationState
+            {
+                enum class Status
+                {
+                    Unavailable = 0,
+                    Active = 1,
+                    Inactive = 2,
+                    Rerouting = 3
+                };
+
+                enum class Maneuver
+                {
+                    Unknown = 0,
+                    Depart = 1,
+                    NameChange = 2,
+                    SlightTurn = 3,
+                    Turn = 4,
+                    SharpTurn = 5,
+                    UTurn = 6,
+                    OnRamp = 7,
+                    OffRamp = 8,
+                    Fork = 9,
+                    Merge = 10,
+                    RoundaboutEnter = 11,
+                    RoundaboutExit = 12,
+                    RoundaboutEnterAndExit = 13,
+                    Straight = 14,
+                    FerryBoat = 16,
+                    FerryTrain = 17,
+                    Destination = 19
+                };
+
+                enum class Side
+                {
+                    Left = 1,
+                    Right = 2,
+                    Unspecified = 3
+                };
+
+                enum class Unit
+                {
+                    Unknown = 0,
+                    Meters = 1,
+                    Kilometers = 2,
+                    KilometersTenths = 3,
+                    Miles = 4,
+                    MilesTenths = 5,
+                    Feet = 6,
+                    Yards = 7
+                };
+
+                Status status = Status::Unavailable;
+                Maneuver maneuver = Maneuver::Unknown;
+                Side side = Side::Unspecified;
+                int32_t roundaboutExit = 0; // Exit number for roundabouts, 0 if none
+                int32_t turnAngle = 0;      // Degrees, for roundabout exits
+                std::string road;
+                int32_t distanceMeters = -1;
+                int32_t timeToTurnSeconds = -1;
+                int32_t displayDistanceE3 = -1; // Rounded as the phone shows it, x1000
+                Unit displayUnit = Unit::Unknown;
+
+                // Keeps the serialized line within a StateBus value
+                static constexpr size_t cMaxRoadLength = 64;
+
+                bool isActive() const { return status == Status::Active || status == Status::Rerouting; }
+
+                /**
+                 * @brief Distance as the phone would show it, such as "1.2" with
+                 * unit "km"; empty before any distance arrived.
+                 */
+                std::string displayDistance() const;
+                const char *displayUnitName() const;
+
+                std::string serialize() const;
+                /**
+                 * @brief Reads serialize() output; unknown keys are skipped, so
+                 * newer writers stay readable.
+                 * @return false if @p text is not a navigation state.
+                 */
+                static bool parse(const std::string &text, NavigationState &state);
+
+                bool operator==(const NavigationState &other) const;
+                bool operator!=(const NavigationState &other) const { return !(*this == other); }
+            };
+
+        }
+    }
+}
@@ -0,0 +1,97 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            /**
+             * @brief The phone's signal, battery and call, as the status bar
+             * shows them.
+             *
+             * Battery comes from the control channel and the rest from the
+             * phone status channel; update() merges each into one process-wide
+             * snapshot, published over the StateBus only when a field changed.
+             * The line is "signal,battery,critical,call,caller", so scripts
+             * can read /tmp/phone_status as well.
+             */
+            struct PhoneStatus
+            {
+                // Android Auto wire values
+                enum class Call
+                {
+                    None = 0,
+                    InCall = 1,
+                    OnHold = 2,
+                    Inactive = 3,
+                    Incoming = 4,
+                    Conferenced = 5,
+                    Muted = 6
+                };
+
+                // Bits of diff() and update()
+                enum Field : uint32_t
+                {
+                    Signal = 1 << 0,
+                    Battery = 1 << 1,
+                    CallState = 1 << 2, // the call and its caller
+                    All = Signal | Battery | CallState
+                };
+
+                int32_t signalStrength = -1; // Bars as the phone reports them, -1 unknown
+                int32_t batteryLevel = -1;   // Percent, -1 unknown
+                bool batteryCritical = false;
+                Call call = Call::None;
+                std::string caller;
+
+                // Keeps the serialized line within a StateBus value
+                static constexpr size_t cMaxCallerLength = 64;
+
+                // Ringing or talking, as opposed to a call that ended
+                bool inCall() const;
+
+                // Fields that differ from @p other
+                uint32_t diff(const PhoneStatus &other) const;
+
+                std::string serialize() const;
+                // @return false if @p text is not a phone status
+                static bool parse(const std::string &text, PhoneStatus &status);
+
+                /**
+                 * @brief Sets @p fields of the shared snapshot from @p from and
+                 * publishes it if that changed anything. Any thread.
+                 */
+                static void update(uint32_t fields, const PhoneStatus &from);
+                // Forgets the snapshot, for when the phone goes away
+                static void reset();
+
+                bool operator==(const PhoneStatus &other) const { return diff(other) == 0; }
+                bool operator!=(const PhoneStatus &other) const { return diff(other) != 0; }
+            };
+
+        }
+    }
+}
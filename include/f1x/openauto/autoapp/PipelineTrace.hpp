@@ -0,0 +1,137 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            /**
+             * @brief PipelineTrace - Begin/end timing of the media, audio and input paths
+             *
+             * Each thread records into its own ring of cEventsPerThread events,
+             * so a scope costs two monotonic clock reads and one store, with no
+             * lock or allocation after the thread's first event. Nothing is
+             * recorded until start(); dump() writes what the rings still hold
+             * as a Chrome trace, which chrome://tracing and ui.perfetto.dev open.
+             * Built only with -DOPENAUTO_PIPELINE_TRACE (the PIPELINE_TRACE
+             * CMake option); otherwise OPENAUTO_TRACE_SCOPE expands to nothing.
+             */
+            class PipelineTrace
+            {
+            public:
+                // About a second of every instrumented path at 60 fps; 192 KB a thread
+                static constexpr size_t cEventsPerThread = 8192;
+
+                static PipelineTrace &instance();
+
+                // Forgets the events of any earlier trace and starts recording
+                void start();
+                void stop();
+                bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+                /**
+                 * @brief Writes the current trace as Chrome trace JSON.
+                 * Meant for after stop(): a thread still recording may overwrite
+                 * its oldest events while they are copied.
+                 * @return The events written.
+                 */
+                size_t dump(std::ostream &out);
+                bool dump(const std::string &path);
+
+                // CLOCK_MONOTONIC, in nanoseconds
+                static int64_t nowNs();
+                // A complete event on the calling thread; @p name must be a literal
+                void record(const char *name, int64_t startNs, int64_t endNs);
+
+            private:
+                struct Event
+                {
+                    const char *name;
+                    int64_t startNs;
+                    int64_t durationNs;
+                };
+
+                struct ThreadRing;
+                struct RingHolder;
+
+                ThreadRing &ring();
+                void release(ThreadRing *ring);
+
+                std::atomic<bool> enabled_{false};
+                // Bumped by start(); a ring of an older epoch is empty
+                std::atomic<uint64_t> epoch_{0};
+                std::mutex mutex_;
+                std::vector<std::unique_ptr<ThreadRing>> rings_;
+            };
+
+            /**
+             * @brief TraceScope - Records the lifetime of a block while tracing
+             * Whether to record is decided at construction, so a scope open
+             * across stop() still closes.
+             */
+            class TraceScope
+            {
+            public:
+                explicit TraceScope(const char *name)
+                    : name_(PipelineTrace::instance().enabled() ? name : nullptr),
+                      startNs_(name_ != nullptr ? PipelineTrace::nowNs() : 0)
+                {
+                }
+
+                ~TraceScope()
+                {
+                    if (name_ != nullptr)
+                        PipelineTrace::instance().record(name_, startNs_, PipelineTrace::nowNs());
+                }
+
+                TraceScope(const TraceScope &) = delete;
+                TraceScope &operator=(const TraceScope &) = delete;
+
+            private:
+                const char *name_;
+                int64_t startNs_;
+            };
+
+        }
+    }
+}
+
+#ifdef OPENAUTO_PIPELINE_TRACE
+#define OPENAUTO_TRACE_CONCAT_(a, b) a##b
+#define OPENAUTO_TRACE_CONCAT(a, b) OPENAUTO_TRACE_CONCAT_(a, b)
+#define OPENAUTO_TRACE_SCOPE(name) \
+    ::f1x::openauto::autoapp::TraceScope OPENAUTO_TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define OPENAUTO_TRACE_SCOPE(name) \
+    do                             \
+    {                              \
+    } while (false)
+#endif
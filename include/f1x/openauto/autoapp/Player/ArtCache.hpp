@@ -0,0 +1,70 @@
+/*
+ *  ArtCache - Content-addressed cache of album art thumbnails
+ *  Art is keyed by a hash of the picture itself, so an album's tracks share
+ *  one entry, and stored pre-scaled to the sizes the QML pages draw it at
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QThread>
+
+namespace TagLib
+{
+    class File;
+}
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                class ArtCache : public QObject
+                {
+                    Q_OBJECT
+
+                public:
+                    static constexpr int cPlayerSize = 250; // MusicPage album art
+                    static constexpr int cListSize = 28;    // FileBrowserPage file rows
+
+                    explicit ArtCache(QObject *parent = nullptr);
+                    ~ArtCache() override;
+
+                    // file:// URL of the thumbnail, or empty if it is not cached
+                    QString url(const QString &key, int size) const;
+
+                    // Extraction, usable from any thread. Each returns the key of
+                    // the art it stored, or an empty string if there is none
+                    QString folderCover(const QString &dirPath);
+                    QString embeddedCover(TagLib::File *file);
+                    QString store(const QByteArray &image);
+
+                    // Extracts the art of @p filePath on the cache's worker thread
+                    void request(const QString &filePath);
+                    // store() on the worker thread; @p ticket comes back with the key
+                    void storeLater(const QByteArray &image, quint64 ticket);
+
+                signals:
+                    void artReady(const QString &filePath, const QString &key);
+                    void pictureStored(quint64 ticket, const QString &key);
+
+                private:
+                    static constexpr int cJpegQuality = 90;
+
+                    QString thumbnailPath(const QString &key, int size) const;
+
+                    const QString directory_;
+                    QThread *worker_;
+                    QObject *workerContext_; // lives on worker_
+                };
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -12,6 +12,8 @@
 #include <QThread>
 #include <QMutex>
 #include <atomic>
+#include <functional>
+#include <memory>
 
 namespace f1x
 {
@@ -19,9 +21,16 @@ namespace f1x
     {
         namespace autoapp
         {
+            namespace projection
+            {
+                class AudioMixerChannel;
+            }
+
             namespace player
             {
 
+                class MediaLibrary;
+
                 class AudioPlayer : public QObject
                 {
                     Q_OBJECT
@@ -45,9 +54,31 @@ namespace f1x
                     Q_PROPERTY(int playlistCount READ playlistCount NOTIFY playlistChanged)
 
                 public:
+                    // Media channels of the Android Auto audio mixer, for local
+                    // playback during a session; null when the mixer is off
+                    typedef std::function<std::shared_ptr<projection::AudioMixerChannel>()> SharedOutputFactory;
+
                     explicit AudioPlayer(QObject *parent = nullptr);
                     ~AudioPlayer() override;
 
+                    // Track metadata is taken from @p library when indexed
+                    void setLibrary(const MediaLibrary *library);
+
+                    // Per-second positionChanged notifications; off while nothing
+                    // shows the position, one catch-up notification when re-enabled
+                    void setPositionUpdatesEnabled(bool enabled);
+
+                    // While a session runs, tracks play as one more source of the
+                    // session's mixer, ducked under guidance and calls, instead of
+                    // competing with it for the DAC. An empty @p factory returns to
+                    // the exclusive ALSA device and its native rates. A playing
+                    // track moves over at its current position
+                    void setSharedOutput(SharedOutputFactory factory);
+
+                    // Plays indexed tracks at the gain the library stored for
+                    // them, from tags or measured; from the next track on
+                    void setReplayGainEnabled(bool enabled);
+
                     // Repeat modes: 0=off, 1=repeat all, 2=repeat one
                     enum RepeatMode
                     {
@@ -101,13 +132,41 @@ namespace f1x
                     void trackFinished();
 
                 private:
+                    class PcmOutput;
+                    class TrackDecoder;
+
+                    static constexpr int cPrebufferMs = 500;
+                    static constexpr const char *cDefaultAlbumArt = "qrc:/coverlogo.png";
+
                     void startDecodeThread();
                     void stopDecodeThread();
                     void decodeLoop();
                     void loadMetadata(const QString &filePath);
+                    // Linear gain for @p filePath, 1.0 if off or not measured
+                    double trackGain(const QString &filePath) const;
+                    // Sets albumArtPath_ from the art cache, at most a stat
                     void extractAlbumArt(const QString &filePath);
+                    void onArtReady(const QString &filePath, const QString &key);
                     void onTrackFinished();
 
+                    // Decode thread: configures output_ for the track, reusing
+                    // the open device when the format matches
+                    bool startOutput(TrackDecoder &decoder);
+                    // Plays to the end of the track; false if stopped first
+                    bool playTrack(TrackDecoder &decoder);
+
+                    // Gapless handoff: the entry after @p index is opened and
+                    // its first cPrebufferMs decoded on a second thread while
+                    // the current track plays
+                    void startPrefetch(int index);
+                    void stopPrefetch();
+                    // The prefetched track if it is still what follows @p index
+                    std::unique_ptr<TrackDecoder> takePrefetched(int index);
+                    // Entry auto-advance plays after @p index, or -1; mutex_ held
+                    int followingIndex(int index) const;
+                    // Updates the UI state for a track started by the handoff
+                    void announceTrack(int index, const QString &file);
+
                     // Playback state
                     std::atomic<bool> playing_;
                     std::atomic<bool> paused_;
@@ -124,15 +183,32 @@ namespace f1x
                     int sampleRate_;            // output sample rate in Hz
                     int bitDepth_;              // output bit depth (16, 24, 32)
                     bool nativeOffload_;        // true if DAC runs at source rate
+                    const MediaLibrary *library_;
 
                     // Playlist
                     QStringList playlist_;
                     int playlistIndex_;
                     int repeatMode_;
 
+                    // Latest seek request in ms, -1 if none; taken by the decode loop
+                    std::atomic<int> seekTarget_;
+                    std::atomic<bool> positionUpdates_;
+                    std::atomic<bool> replayGain_;
+
                     // Decode thread
                     QThread *decodeThread_;
                     QMutex mutex_;
+
+                    // ALSA device or mixer channel, kept open from track to track
+                    // while the output format stays the same; owned by the decode
+                    // thread while it runs
+                    std::unique_ptr<PcmOutput> output_;
+
+                    // Next track, owned by the prefetch thread until joined
+                    QThread *prefetchThread_;
+                    std::unique_ptr<TrackDecoder> prefetched_;
+                    int prefetchedIndex_;
+                    QString prefetchedFile_;
                 };
 
             } // namespace player
@@ -0,0 +1,84 @@
+/*
+ *  DirectoryModel - List model of one folder for the file browser
+ *  Filled in chunks while the folder is scanned off the GUI thread;
+ *  folder file counts are requested only once a row is displayed
+ */
+
+#pragma once
+
+#include <QAbstractListModel>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                struct DirectoryEntry
+                {
+                    static constexpr int cCountUnknown = -1;
+
+                    QString name;
+                    QString path;
+                    bool isDir = false;
+                    int audioCount = cCountUnknown; // audio files in the folder, for directories
+                    QString art;                    // thumbnail URL, for indexed files with art
+                    mutable bool countRequested = false;
+
+                    bool operator==(const DirectoryEntry &other) const;
+                };
+
+                class DirectoryModel : public QAbstractListModel
+                {
+                    Q_OBJECT
+
+                    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+                public:
+                    enum Roles
+                    {
+                        NameRole = Qt::UserRole + 1,
+                        PathRole,
+                        IsDirRole,
+                        IsAudioRole,
+                        AudioCountRole,
+                        ArtRole
+                    };
+
+                    explicit DirectoryModel(QObject *parent = nullptr);
+
+                    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+                    QVariant data(const QModelIndex &index, int role) const override;
+                    QHash<int, QByteArray> roleNames() const override;
+
+                    int count() const;
+                    QStringList audioFiles() const;
+
+                    void clear();
+                    // Adds a scanned chunk, keeping folders first and names sorted
+                    void insert(QVector<DirectoryEntry> entries);
+                    // Swaps in a complete listing, resetting only if it differs
+                    void replace(QVector<DirectoryEntry> entries);
+                    void setAudioCount(const QString &path, int count);
+
+                signals:
+                    void countChanged();
+                    // A folder row was displayed before its file count was known
+                    void audioCountNeeded(const QString &path);
+
+                private:
+                    static bool lessThan(const DirectoryEntry &a, const DirectoryEntry &b);
+
+                    QVector<DirectoryEntry> entries_;
+                };
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
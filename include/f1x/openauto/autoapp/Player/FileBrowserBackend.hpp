@@ -1,7 +1,9 @@
 /*
  *  FileBrowserBackend - File system browser for USB media
  *  Auto-scans /media for mounted volumes via QStorageInfo
- *  Provides folder/file navigation with audio file filtering
+ *  Provides folder/file navigation with audio file filtering, served from
+ *  the MediaLibrary index of the selected volume once it is available.
+ *  Listing and volume probing run on a worker thread, never the GUI thread
  */
 
 #pragma once
@@ -10,7 +12,10 @@
 #include <QString>
 #include <QStringList>
 #include <QVariantList>
+#include <QVector>
 #include <QFileSystemWatcher>
+#include <QThread>
+#include <atomic>
 
 namespace f1x
 {
@@ -21,6 +26,10 @@ namespace f1x
             namespace player
             {
 
+                class MediaLibrary;
+                class DirectoryModel;
+                struct DirectoryEntry;
+
                 class FileBrowserBackend : public QObject
                 {
                     Q_OBJECT
@@ -28,8 +37,13 @@ namespace f1x
                     Q_PROPERTY(QVariantList mountedVolumes READ mountedVolumes NOTIFY volumesChanged)
                     Q_PROPERTY(QString currentPath READ currentPath NOTIFY pathChanged)
                     Q_PROPERTY(QString currentVolumeName READ currentVolumeName NOTIFY pathChanged)
-                    Q_PROPERTY(QVariantList currentEntries READ currentEntries NOTIFY pathChanged)
+                    Q_PROPERTY(QObject *entries READ entries CONSTANT)
+                    Q_PROPERTY(bool scanning READ isScanning NOTIFY scanningChanged)
                     Q_PROPERTY(QStringList breadcrumb READ breadcrumb NOTIFY pathChanged)
+                    // Type-ahead search of the selected volume; while searchQuery is
+                    // set, searchResults lists the matching tracks
+                    Q_PROPERTY(QString searchQuery READ searchQuery WRITE setSearchQuery NOTIFY searchQueryChanged)
+                    Q_PROPERTY(QObject *searchResults READ searchResults CONSTANT)
 
                 public:
                     explicit FileBrowserBackend(QObject *parent = nullptr);
@@ -38,8 +52,16 @@ namespace f1x
                     QVariantList mountedVolumes() const;
                     QString currentPath() const;
                     QString currentVolumeName() const;
-                    QVariantList currentEntries() const;
+                    QObject *entries() const;
+                    bool isScanning() const;
                     QStringList breadcrumb() const;
+                    QString searchQuery() const;
+                    void setSearchQuery(const QString &query);
+                    QObject *searchResults() const;
+
+                    const MediaLibrary *library() const;
+                    // See MediaLibrary::setLoudnessAnalysis()
+                    void setLoudnessAnalysis(bool enabled);
 
                 public slots:
                     void refreshVolumes();
@@ -49,25 +71,55 @@ namespace f1x
 
                     // Returns all audio files recursively under a path
                     QStringList collectAudioFiles(const QString &path) const;
-                    // Returns audio files in current directory only
+                    // Returns audio files in current directory only, or the search
+                    // results while searching
                     QStringList currentAudioFiles() const;
+                    // Indexed tracks matching title, artist, album or file name;
+                    // empty until the selected volume is indexed
+                    QVariantList search(const QString &query) const;
 
                 signals:
                     void volumesChanged();
                     void pathChanged();
+                    void scanningChanged();
+                    void searchQueryChanged();
                     void fileSelected(const QString &filePath);
 
                 private:
+                    static constexpr int cSearchLimit = 200;
+                    // Entries per model update while a folder is listed
+                    static constexpr int cScanChunk = 64;
+
                     void scanDirectory(const QString &path);
+                    void onIndexChanged();
+                    void updateSearchResults();
+                    void requestAudioCount(const QString &path);
+                    void applyVolumes(const QVariantList &volumes);
                     bool isAudioFile(const QString &fileName) const;
 
+                    // Scan thread; results are handed back tagged with the
+                    // scanGeneration_ they were requested for and dropped if stale
+                    void listDirectory(const QString &path, quint64 generation, bool refresh);
+                    void countAudioFiles(const QString &path, quint64 generation);
+                    void deliver(QVector<DirectoryEntry> entries, quint64 generation, bool refresh, bool done);
+                    static QVariantList probeVolumes();
+
                     QFileSystemWatcher *mediaWatcher_;
                     QString currentPath_;
                     QString volumeRoot_;
                     QString volumeName_;
                     QVariantList mountedVolumes_;
-                    QVariantList currentEntries_;
                     QStringList audioExtensions_;
+                    MediaLibrary *library_;
+                    DirectoryModel *entries_;
+                    DirectoryModel *searchResults_;
+                    QString searchQuery_;
+                    bool scanning_;
+
+                    QThread *scanThread_;
+                    QObject *scanContext_; // lives on scanThread_
+                    std::atomic<quint64> scanGeneration_;
+                    std::atomic<bool> volumeProbePending_;
                 };
 
             } // namespace player
@@ -0,0 +1,67 @@
+/*
+ *  LoudnessMeter - EBU R128 integrated loudness and sample peak of a track
+ *  K-weighted, gated as in ITU-R BS.1770-4, on 48 kHz stereo float. Used by
+ *  the library indexer for tracks without ReplayGain tags, so playback only
+ *  applies a stored gain
+ */
+
+#pragma once
+
+#include <QString>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                class LoudnessMeter
+                {
+                public:
+                    static constexpr int cSampleRate = 48000;
+                    // ReplayGain 2.0 reference level
+                    static constexpr double cReferenceLufs = -18.0;
+
+                    LoudnessMeter();
+
+                    // Interleaved stereo at cSampleRate, in any chunking
+                    void add(const float *samples, size_t frames);
+
+                    // False for a track shorter than one 400 ms block or silent
+                    bool integrated(double &lufs) const;
+                    // Largest absolute sample, 1.0 is full scale
+                    float peak() const;
+
+                    // Decodes @p path with FFmpeg and measures it; false if it
+                    // cannot be decoded or @p cancel was set
+                    static bool measureFile(const QString &path, const std::atomic<bool> &cancel, double &lufs, float &peak);
+
+                private:
+                    struct Biquad
+                    {
+                        double b0, b1, b2, a1, a2;
+                        double z1[2], z2[2];
+                        double run(double x, int channel);
+                    };
+
+                    static constexpr int cStepFrames = cSampleRate / 10; // 100 ms, a quarter block
+
+                    Biquad shelf_;
+                    Biquad highPass_;
+                    // Mean square of each completed 100 ms step, both channels summed
+                    std::vector<double> steps_;
+                    double stepSum_;
+                    int stepFrames_;
+                    float peak_;
+                };
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
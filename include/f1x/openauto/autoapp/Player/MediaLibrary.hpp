@@ -0,0 +1,160 @@
+/*
+ *  MediaLibrary - Persistent index of the audio files on a USB volume
+ *  Keyed by filesystem UUID (libblkid), stored under the cache directory
+ *  and refreshed incrementally by directory/file mtime on a worker thread
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include <f1x/openauto/autoapp/Player/SearchIndex.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                class ArtCache;
+
+                struct LibraryTrack
+                {
+                    // Where gainDb and peak came from
+                    enum Loudness
+                    {
+                        LoudnessPending = 0, // not analysed yet
+                        LoudnessTagged = 1,  // ReplayGain or R128 tags
+                        LoudnessMeasured = 2,
+                        LoudnessUnknown = 3 // could not be decoded
+                    };
+
+                    QString name; // file name within its folder
+                    qint64 mtime = 0;
+                    qint64 size = 0;
+                    int durationMs = 0;
+                    QString title;
+                    QString artist;
+                    QString album;
+                    QString artKey; // ArtCache key, empty if the track has no art
+                    quint8 loudness = LoudnessPending;
+                    float gainDb = 0.0f; // towards the ReplayGain 2.0 level of -18 LUFS
+                    float peak = 0.0f;   // sample peak, 1.0 is full scale; 0 if unknown
+                };
+
+                struct LibraryFolder
+                {
+                    qint64 mtime = 0;
+                    QStringList subdirs;          // names, sorted
+                    QVector<LibraryTrack> tracks; // audio files, sorted by name
+                };
+
+                class MediaLibrary : public QObject
+                {
+                    Q_OBJECT
+
+                public:
+                    explicit MediaLibrary(const QStringList &audioExtensions, QObject *parent = nullptr);
+                    ~MediaLibrary() override;
+
+                    // Serves the stored index of the volume at @p mountPath as soon
+                    // as it is loaded, then rescans what changed in the background
+                    void openVolume(const QString &mountPath);
+                    void closeVolume();
+
+                    // Decodes tracks without ReplayGain tags after each scan to
+                    // measure their loudness; on by default
+                    void setLoudnessAnalysis(bool enabled);
+
+                    bool isReady() const;
+                    bool isScanning() const;
+                    // Filled while indexing; shared with the player
+                    ArtCache *artCache() const;
+
+                    // Lookups by absolute path; false when not (yet) indexed
+                    bool folder(const QString &path, LibraryFolder &out) const;
+                    bool track(const QString &filePath, LibraryTrack &out) const;
+                    // All audio files under @p path, recursively, in browse order
+                    bool tracksUnder(const QString &path, QStringList &out) const;
+                    // Absolute paths of files whose title, artist, album or name
+                    // contains @p query; answered from the SearchIndex once built
+                    QStringList search(const QString &query, int limit) const;
+
+                signals:
+                    void indexChanged();
+                    void scanningChanged();
+
+                private:
+                    // Keyed by folder path relative to the volume root, "" for the root
+                    using Index = QHash<QString, LibraryFolder>;
+
+                    struct Snapshot
+                    {
+                        QString root;
+                        Index folders;
+                        SearchIndex::Pointer search; // of folders; null until built
+                    };
+                    using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+                    struct ScanStats
+                    {
+                        int scannedFolders = 0;
+                        int tagReads = 0;
+                    };
+
+                    static constexpr quint32 cIndexMagic = 0x4f414d4c; // "OAML"
+                    static constexpr quint32 cIndexVersion = 3;
+                    // Progress of the loudness pass is saved and served this often
+                    static constexpr int cLoudnessCheckpointMs = 60000;
+
+                    void stopWorker();
+                    // Worker thread
+                    void run(const QString &root, int generation);
+                    bool scanFolder(const QString &root, const QString &relative, const Index &previous, Index &out, ScanStats &stats) const;
+                    // @p folderArt, the folder's cover if it has one, wins over embedded art
+                    void readTags(const QString &filePath, const QString &folderArt, LibraryTrack &track) const;
+                    bool isAudioFile(const QString &fileName) const;
+                    // Measures the tracks of @p index still pending; runs once the
+                    // scan has been published
+                    void measureLoudness(const QString &root, const QString &file, Index &index, SearchIndex::Pointer search, int generation);
+                    // Hands results to the GUI thread; @p finished ends the scan
+                    void publish(SnapshotPtr snapshot, int generation, bool finished);
+
+                    static QString volumeUuid(const QString &mountPath);
+                    static QString indexPath(const QString &uuid);
+                    static bool loadIndex(const QString &file, Index &out);
+                    static bool saveIndex(const QString &file, const Index &index);
+                    // Maps the search index stored beside @p file if it matches
+                    // @p index, else builds and stores a new one
+                    SearchIndex::Pointer searchIndex(const QString &file, const Index &index) const;
+
+                    SnapshotPtr snapshot() const;
+                    // Splits @p path into the folder key relative to the root
+                    static bool relativeTo(const Snapshot &snapshot, const QString &path, QString &relative);
+
+                    const QStringList audioExtensions_;
+                    ArtCache *artCache_;
+                    mutable QMutex mutex_;
+                    SnapshotPtr snapshot_;
+                    QString root_;
+                    QThread *worker_;
+                    std::atomic<bool> cancel_;
+                    std::atomic<bool> scanning_;
+                    std::atomic<bool> loudnessAnalysis_;
+                    int generation_;
+                };
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
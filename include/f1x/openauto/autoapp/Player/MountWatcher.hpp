@@ -0,0 +1,57 @@
+/*
+ *  MountWatcher - Reports mounts appearing or disappearing under a prefix
+ *  The kernel flags /proc/self/mountinfo with POLLPRI when the mount table
+ *  changes, so an idle system gets no wakeups at all
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+class QSocketNotifier;
+class QTimer;
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                class MountWatcher : public QObject
+                {
+                    Q_OBJECT
+
+                public:
+                    explicit MountWatcher(const QString &prefix, QObject *parent = nullptr);
+                    ~MountWatcher() override;
+
+                    QStringList mountPoints() const;
+
+                signals:
+                    void mountsChanged();
+
+                private:
+                    // Only used when mountinfo cannot be watched
+                    static constexpr int cFallbackPollMs = 3000;
+
+                    void onMountTableChanged();
+                    QStringList readMountPoints() const;
+                    static QByteArray readAll(int fd);
+                    static QString unescape(const QByteArray &field);
+
+                    const QString prefix_;
+                    int fd_;
+                    QSocketNotifier *notifier_;
+                    QTimer *fallbackTimer_;
+                    QStringList mountPoints_;
+                };
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,95 @@
+/*
+ *  PhoneMedia - What the phone is playing, from its media playback status
+ *  Updates arrive on the Android Auto threads and are applied on the GUI
+ *  thread. Album art goes through the ArtCache worker, so the GUI thread
+ *  never decodes the phone's pictures
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                class ArtCache;
+
+                class PhoneMedia : public QObject
+                {
+                    Q_OBJECT
+
+                public:
+                    struct Metadata
+                    {
+                        QString title;
+                        QString artist;
+                        QString album;
+                        int durationSeconds = 0;
+                        QByteArray art; // PNG or JPEG, as the phone sends it
+                    };
+
+                    // Lives on the GUI thread whichever thread asks first
+                    static PhoneMedia &instance();
+
+                    // Phone art is stored in @p cache; ignored until set. GUI thread
+                    void setArtCache(ArtCache *cache);
+
+                    // Any thread
+                    void setMetadata(Metadata metadata);
+                    void setPlayback(bool playing, int positionSeconds);
+                    void clear();
+                    // The phone asked for lasting media focus, e.g. its player started
+                    void requestFocus();
+
+                    // GUI thread. Inactive until the phone sends metadata
+                    bool active() const;
+                    QString title() const;
+                    QString artist() const;
+                    QString album() const;
+                    QString artUrl() const;
+                    bool playing() const;
+                    int durationSeconds() const;
+                    int positionSeconds() const;
+
+                signals:
+                    // Anything but the position changed; the phone reports that
+                    // every second and nothing on screen needs it that often
+                    void changed();
+                    // Local playback should give way to the phone's
+                    void focusRequested();
+
+                private:
+                    static constexpr int cMaxArtBytes = 4 * 1024 * 1024;
+
+                    PhoneMedia();
+
+                    void applyMetadata(const Metadata &metadata);
+                    void applyPlayback(bool playing, int positionSeconds);
+                    void applyClear();
+                    void onPictureStored(quint64 ticket, const QString &key);
+
+                    ArtCache *artCache_;
+                    bool active_;
+                    QString title_;
+                    QString artist_;
+                    QString album_;
+                    int durationSeconds_;
+                    QByteArray art_;
+                    QString artUrl_;
+                    quint64 artTicket_; // Only the latest storeLater() is applied
+                    bool playing_;
+                    int positionSeconds_;
+                };
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
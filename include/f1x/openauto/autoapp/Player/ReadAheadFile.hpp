@@ -0,0 +1,94 @@
+/*
+ *  ReadAheadFile - Sequential file reader with a background read-ahead ring
+ *  A reader thread keeps several MB ahead of the consumer, so cheap USB
+ *  flash stalling for a few hundred ms is absorbed before it reaches the
+ *  decoder. Seeks inside the buffered window, like the short backward
+ *  seeks of container probing, cost nothing; others restart the reader
+ */
+
+#pragma once
+
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                class ReadAheadFile
+                {
+                public:
+                    static constexpr size_t cCapacity = 8 * 1024 * 1024;
+                    static constexpr size_t cLowMemoryCapacity = 2 * 1024 * 1024;
+
+                    // @p capacity 0 picks cCapacity, or cLowMemoryCapacity on
+                    // low-memory boards
+                    explicit ReadAheadFile(size_t capacity = 0);
+                    ~ReadAheadFile();
+
+                    ReadAheadFile(const ReadAheadFile &) = delete;
+                    ReadAheadFile &operator=(const ReadAheadFile &) = delete;
+
+                    bool open(const QString &path);
+                    void close();
+
+                    // Blocks until data is buffered. Returns the bytes copied, 0 at
+                    // the end of the file, -1 on a read error
+                    int read(uint8_t *data, int size);
+                    // Absolute offset; returns it, or -1 if outside the file
+                    int64_t seek(int64_t offset);
+                    int64_t size() const;
+                    int64_t position() const;
+
+                    // Reads that had to wait for the drive since open()
+                    uint64_t stalls() const;
+
+                private:
+                    // Bytes kept behind the consumer for backward seeks
+                    static constexpr size_t cKeepBehind = 256 * 1024;
+                    static constexpr size_t cChunk = 256 * 1024;
+
+                    void readLoop();
+                    // Copies between the ring and @p data at file @p offset, across the wrap
+                    void copyOut(uint8_t *data, int64_t offset, size_t size) const;
+
+                    const size_t capacity_;
+                    std::vector<uint8_t> ring_;
+                    MemoryCharge memory_;
+
+                    int fd_;
+                    int64_t size_;
+                    QThread *reader_;
+
+                    mutable QMutex mutex_;
+                    QWaitCondition dataReady_;
+                    QWaitCondition spaceReady_;
+                    // File offsets: [start_, end_) is buffered, the consumer is at
+                    // position_, and the reader writes at end_
+                    int64_t start_;
+                    int64_t end_;
+                    int64_t position_;
+                    // Bumped by seeks that restart the reader; a read in flight
+                    // for an older generation is discarded
+                    uint64_t generation_;
+                    bool eof_;
+                    bool error_;
+                    bool stopping_;
+                    uint64_t stalls_;
+                };
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,93 @@
+/*
+ *  SearchIndex - Trigram index of the media library for type-ahead search
+ *  Built from the library index after a scan and stored next to it as one
+ *  flat file that is memory-mapped, so 50k tracks cost a few MB of page
+ *  cache rather than heap, and a query intersects a few posting lists
+ *  instead of comparing every title, artist, album and file name
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <cstdint>
+#include <memory>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                struct LibraryFolder;
+
+                class SearchIndex
+                {
+                public:
+                    typedef std::shared_ptr<const SearchIndex> Pointer;
+                    // Keyed by folder path relative to the volume root, as in MediaLibrary
+                    typedef QHash<QString, LibraryFolder> Folders;
+
+                    struct Match
+                    {
+                        QString folder; // key in the library index
+                        int track;      // position in its LibraryFolder::tracks
+                    };
+
+                    // Of the searchable fields only; loudness updates leave it alone
+                    static quint64 fingerprint(const Folders &folders);
+
+                    static Pointer build(const Folders &folders);
+                    // Null if @p file is missing, damaged or was built from a
+                    // library with a different fingerprint
+                    static Pointer map(const QString &file, quint64 fingerprint);
+                    bool save(const QString &file) const;
+
+                    // Up to @p limit tracks whose title, artist, album or file name
+                    // contains @p query, ignoring case and accents, in browse order
+                    QVector<Match> search(const QString &query, int limit) const;
+
+                    int trackCount() const;
+                    qint64 sizeBytes() const;
+
+                    // Folded as the index stores text: compatibility decomposed,
+                    // accents dropped, case-folded, in UTF-8
+                    static QByteArray fold(const QString &text);
+
+                private:
+                    struct Header;
+                    struct TrackRecord;
+
+                    SearchIndex() = default;
+                    // Points the sections into @p data; false if it is no valid index
+                    bool attach(const char *data, qint64 size);
+                    // Candidates for a query of at least three bytes
+                    QVector<uint32_t> candidates(const QByteArray &query) const;
+                    bool contains(uint32_t track, const QByteArray &query) const;
+                    QString folder(uint32_t id) const;
+
+                    // Backing store: built in memory, or the mapped file
+                    QByteArray built_;
+                    std::unique_ptr<QFile> file_;
+                    qint64 size_ = 0;
+
+                    const Header *header_ = nullptr;
+                    const TrackRecord *tracks_ = nullptr;
+                    const uint32_t *folderOffsets_ = nullptr;
+                    const uint32_t *grams_ = nullptr;
+                    const uint32_t *postingOffsets_ = nullptr;
+                    const char *text_ = nullptr;
+                    const char *folderNames_ = nullptr;
+                    const uint8_t *postings_ = nullptr;
+                };
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
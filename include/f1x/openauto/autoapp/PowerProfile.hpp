@@ -0,0 +1,98 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            enum class PowerProfileMode
+            {
+                Default,     // the governors and floors the board booted with
+                Performance, // performance governor
+                Floor,       // booted governors, minimum raised to half the top clock
+                Powersave    // powersave governor
+            };
+
+            const char *powerProfileName(PowerProfileMode mode);
+            // Unknown names fall back to Default and return false
+            bool parsePowerProfile(const std::string &name, PowerProfileMode &mode);
+
+            /**
+             * @brief PowerProfile - Clock policy for projection and idle
+             *
+             * Covers every cpufreq policy and the devfreq devices whose name
+             * contains one of the configured parts (DMC and the video codec by
+             * default). The governor and minimum frequency nodes are opened
+             * once, so switching on a session start costs a few writes; what
+             * they held at construction is written back by Default and by
+             * the destructor.
+             */
+            class PowerProfile
+            {
+            public:
+                /**
+                 * @param devfreqDevices Comma separated parts of devfreq
+                 * device names, e.g. "dmc,vdec".
+                 * @param sysfsRoot Holds devices/system/cpu/cpufreq and
+                 * class/devfreq; a test tree in the unit tests.
+                 */
+                explicit PowerProfile(const std::string &devfreqDevices, std::string sysfsRoot = "/sys");
+                ~PowerProfile();
+
+                PowerProfile(const PowerProfile &) = delete;
+                PowerProfile &operator=(const PowerProfile &) = delete;
+
+                void apply(PowerProfileMode mode);
+                PowerProfileMode mode() const;
+                // Clock domains found, cpufreq policies first
+                std::vector<std::string> domains() const;
+
+            private:
+                struct Domain
+                {
+                    std::string name;
+                    int governorFd;
+                    int minFreqFd;
+                    std::string bootGovernor;
+                    std::string bootMinFreq;
+                    std::string floorFreq; // lowest available at or above half the top clock
+                    std::vector<std::string> governors;
+                };
+
+                void open(const std::string &name, const std::string &directory, const char *governorNode,
+                          const char *governorsNode, const char *minFreqNode, const char *frequenciesNode,
+                          const char *maxFreqNode);
+                void write(const Domain &domain, PowerProfileMode mode);
+
+                mutable std::mutex mutex_;
+                std::vector<Domain> domains_;
+                PowerProfileMode mode_;
+            };
+
+        }
+    }
+}
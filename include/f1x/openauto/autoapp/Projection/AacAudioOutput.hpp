@@ -0,0 +1,138 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <f1x/openauto/autoapp/Projection/IAudioOutput.hpp>
+
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Decodes an AAC-LC media channel into the PCM output beneath.
+         *
+         * 48 kHz stereo PCM is about 1.5 Mbit/s that the link carries and the
+         * Cryptor decrypts next to the video; AAC-LC is a tenth of that. The
+         * channel strand only copies each access unit into a recycled buffer;
+         * a worker thread runs libavcodec's decoder and writes the PCM, with
+         * the packet's timestamp, to the wrapped output, which keeps its
+         * jitter buffer and device. Access units may be raw (with the
+         * AudioSpecificConfig built here from the output format) or carry an
+         * ADTS header. The decode cost is published as a share of the audio's
+         * duration.
+         *
+         * Needs FFmpeg (USE_FFMPEG_DRM); without it isSupported() is false.
+         */
+        class AacAudioOutput : public IAudioOutput
+        {
+        public:
+          // About 340 ms of 1024-sample packets at 48 kHz; older ones are dropped
+          static constexpr size_t cMaxQueuedPackets = 16;
+
+          explicit AacAudioOutput(IAudioOutput::Pointer pcmOutput);
+          ~AacAudioOutput() override;
+
+          AacAudioOutput(const AacAudioOutput &) = delete;
+          AacAudioOutput &operator=(const AacAudioOutput &) = delete;
+
+          /**
+           * @brief True if this build can decode AAC.
+           */
+          static bool isSupported();
+
+          /**
+           * @brief The two-byte AudioSpecificConfig of an AAC-LC stream, empty
+           * for a rate outside the MPEG-4 sampling frequency table.
+           */
+          static std::vector<uint8_t> audioSpecificConfig(uint32_t sampleRate, uint32_t channels);
+
+          /**
+           * @brief Interleaves @p frames frames of planar float samples into
+           * 16-bit PCM, clipping at full scale.
+           */
+          static void interleave(const float *const *planes, uint32_t channels, size_t frames, int16_t *out);
+
+          bool open() override;
+          void write(aasdk::messenger::Timestamp::ValueType timestamp,
+                     const aasdk::common::DataConstBuffer &buffer) override;
+          void start() override;
+          void stop() override;
+          void suspend() override;
+          uint32_t getSampleSize() const override;
+          uint32_t getChannelCount() const override;
+          uint32_t getSampleRate() const override;
+
+          uint64_t decodedPackets() const;
+          uint64_t droppedPackets() const;
+
+        private:
+          struct Packet
+          {
+            aasdk::messenger::Timestamp::ValueType timestamp = 0;
+            std::vector<uint8_t> data;
+          };
+
+          bool openDecoder();
+          void closeDecoder();
+          void decodeLoop();
+          void decode(const Packet &packet);
+
+          IAudioOutput::Pointer pcmOutput_;
+
+          // Worker thread only, apart from open() and stop()
+          AVCodecContext *codecCtx_;
+          AVFrame *frame_;
+          AVPacket *packet_;
+          std::vector<int16_t> pcm_;
+          std::chrono::steady_clock::duration busy_;
+          uint64_t decodedFrames_;
+          uint64_t decodedPacketsSinceReport_;
+
+          mutable std::mutex mutex_;
+          std::condition_variable cond_;
+          std::deque<Packet> queue_;
+          std::vector<std::vector<uint8_t>> freeBuffers_;
+          bool stopping_;
+          uint64_t decoded_;
+          uint64_t dropped_;
+          uint64_t errors_;
+          std::thread thread_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
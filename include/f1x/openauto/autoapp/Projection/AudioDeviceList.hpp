@@ -36,13 +36,46 @@ struct AudioDeviceInfo {
   bool isDefault;
   uint32_t outputChannels;
   uint32_t inputChannels;
+  std::vector<uint32_t> sampleRates;
+  uint32_t preferredSampleRate;
+
+  /**
+   * Whether the device plays or records @p sampleRate without resampling
+   */
+  bool supportsSampleRate(uint32_t sampleRate) const;
+
+  /**
+   * The rate of @p candidates the device plays natively, its preferred
+   * rate first and then in the order given, or @p fallback if none is
+   * (or the device reported no rates)
+   */
+  uint32_t nativeSampleRate(const std::vector<uint32_t> &candidates,
+                            uint32_t fallback) const;
 };
 
 /**
- * Utility class to enumerate audio output/input devices using RTAudio
+ * Process-wide registry of audio output/input devices using RTAudio.
+ * RtAudio probes every PCM, which can take hundreds of milliseconds per
+ * card, so the devices are probed once and the lookups below answer from
+ * that snapshot until refresh() is called, e.g. when a card comes or goes.
+ * IDs are RtAudio's: stable handles with RtAudio 6, indices before that.
  */
 class AudioDeviceList {
 public:
+  /**
+   * Probe the devices again, replacing the snapshot the lookups use.
+   * Blocks for as long as the probe takes: not for the GUI thread.
+   */
+  static void refresh();
+
+  /**
+   * Look up a device of the current snapshot by ID
+   * @param id The device ID
+   * @param info Filled in when found
+   * @return Whether the device is known
+   */
+  static bool findDevice(uint32_t id, AudioDeviceInfo &info);
+
   /**
    * Get a list of all available audio output devices
    * @return Vector of AudioDeviceInfo structs
@@ -0,0 +1,114 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Q15 gain of 1.0 (as close as int16 gets); applyGainQ15()
+         * leaves samples untouched at exactly this gain.
+         */
+        constexpr int16_t cUnityGainQ15 = 32767;
+
+        /**
+         * @brief Converts a 0.0-1.0 gain to Q15.
+         */
+        int16_t gainToQ15(float gain);
+
+        /**
+         * @brief dst[i] = saturate(dst[i] + src[i]); vqaddq_s16 with NEON.
+         */
+        void mixSaturate(int16_t *dst, const int16_t *src, size_t samples);
+
+        /**
+         * @brief Scales interleaved samples by a gain ramping linearly from
+         * @p startGain to @p endGain over @p frames frames (Q15, rounded).
+         */
+        void applyGainQ15(int16_t *samples, size_t frames, uint32_t channels, int16_t startGain,
+                          int16_t endGain);
+
+        /**
+         * @brief Duplicates mono samples into interleaved stereo; vst2q_s16
+         * with NEON. @p dst must not overlap @p src.
+         */
+        void upmixMonoToStereo(int16_t *dst, const int16_t *src, size_t frames);
+
+        /**
+         * @brief Integer-ratio polyphase FIR upsampler for interleaved int16
+         * audio, e.g. 16 kHz voice to the 48 kHz device rate.
+         *
+         * A windowed-sinc low-pass of cTapsPerPhase taps per output phase, in
+         * Q15; each output sample is one 8-tap dot product (a single NEON
+         * multiply-accumulate pass). State carries across calls so a stream
+         * can be processed in arbitrary chunks.
+         */
+        class PolyphaseResampler
+        {
+        public:
+          static constexpr size_t cTapsPerPhase = 8;
+
+          /**
+           * @param maxOutputFrames Largest process() call; buffers are sized
+           * here so processing never allocates.
+           */
+          PolyphaseResampler(uint32_t ratio, uint32_t channels, size_t maxOutputFrames);
+
+          /**
+           * @brief Input frames the next process() call of @p outputFrames
+           * output frames consumes.
+           */
+          size_t inputFramesFor(size_t outputFrames) const;
+
+          /**
+           * @brief Produces @p outputFrames frames from exactly
+           * inputFramesFor(outputFrames) input frames, at most
+           * maxOutputFrames at a time.
+           */
+          void process(const int16_t *input, int16_t *output, size_t outputFrames);
+
+          void reset();
+
+          uint32_t ratio() const;
+
+        private:
+          const uint32_t ratio_;
+          const uint32_t channels_;
+          // Per phase, taps in oldest-to-newest input order
+          std::vector<int16_t> taps_;
+          // Per channel: cTapsPerPhase history frames followed by new input
+          std::vector<std::vector<int16_t>> work_;
+          uint32_t phase_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,144 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
+#include <f1x/openauto/autoapp/Projection/LockFreeRingBuffer.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Counters of an AudioJitterBuffer since it was last cleared.
+         */
+        struct AudioJitterStats
+        {
+          uint64_t underruns = 0;      // Playout ran dry and fell back to prebuffering
+          uint64_t overruns = 0;       // Packets dropped because the buffer was full
+          uint64_t gaps = 0;           // Timestamp jumps filled with silence
+          uint64_t droppedFrames = 0;  // Drift correction: frames skipped
+          uint64_t insertedFrames = 0; // Drift correction: frames repeated
+        };
+
+        /**
+         * @brief Timestamp-aware playout buffer between an AAP audio channel
+         * and the audio device callback.
+         *
+         * Single producer (push(), the channel strand) and single consumer
+         * (pull(), the RT callback), lock-free like the ring underneath.
+         *
+         * The consumer plays silence until targetMs of audio is queued and
+         * goes back to prebuffering after an underrun, so a network stall is
+         * one clean gap instead of a callback-by-callback crackle. While
+         * playing, a smoothed fill level is held at the target by skipping
+         * or repeating a single frame per callback, which absorbs the clock
+         * drift between phone and DAC. Packets are only ever dropped whole,
+         * keeping the stream frame-aligned, and a forward jump in the AAP
+         * timestamps (microseconds) is filled with silence so the rest of
+         * the stream keeps its timing.
+         */
+        class AudioJitterBuffer
+        {
+        public:
+          AudioJitterBuffer(uint32_t frameBytes, uint32_t sampleRate, uint32_t targetMs);
+
+          /**
+           * @brief Queues one packet (producer side).
+           * @param timestamp AAP timestamp in microseconds, 0 if unknown.
+           * @return false if the packet was dropped.
+           */
+          bool push(uint64_t timestamp, const uint8_t *data, size_t size);
+
+          /**
+           * @brief Fills @p frames frames of output (consumer side); always
+           * writes the whole buffer, with silence where nothing is queued.
+           */
+          void pull(void *output, size_t frames);
+
+          /**
+           * @brief Producer side: the next packet begins a new stream, so
+           * the pause before it is not filled as a gap.
+           */
+          void restartTimeline();
+
+          /**
+           * @brief Plays out what is left after the stream ended (consumer
+           * side): queued audio regardless of the prebuffer target, then
+           * silence, without counting the end as an underrun.
+           */
+          void drain(void *output, size_t frames);
+
+          /**
+           * @brief Drops everything queued and resets the counters.
+           * @note Only safe while neither push() nor pull() can run.
+           */
+          void clear();
+
+          /**
+           * @brief True while the consumer is playing queued audio rather
+           * than prebuffering; only meaningful on the consumer side.
+           */
+          bool isPlaying() const;
+
+          AudioJitterStats stats() const;
+          size_t queuedFrames() const;
+          uint32_t targetFrames() const;
+
+        private:
+          // Sized to maxFrames_: 64 KB for 48kHz stereo 16-bit up to a 60 ms target
+          typedef RuntimeRingBuffer Ring;
+
+          void pushSilence(size_t frames);
+          bool readFrames(uint8_t *output, size_t frames);
+
+          const uint32_t frameBytes_;
+          const uint32_t sampleRate_;
+          const uint32_t targetFrames_;
+          const uint32_t maxFrames_;
+          Ring ring_;
+          MemoryCharge memory_;
+
+          // Producer state
+          uint64_t nextTimestamp_;
+
+          // Consumer state
+          bool playing_;
+          double averageFill_;
+
+          std::atomic<uint64_t> underruns_{0};
+          std::atomic<uint64_t> overruns_{0};
+          std::atomic<uint64_t> gaps_{0};
+          std::atomic<uint64_t> droppedFrames_{0};
+          std::atomic<uint64_t> insertedFrames_{0};
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
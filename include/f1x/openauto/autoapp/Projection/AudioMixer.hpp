@@ -0,0 +1,235 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <f1x/openauto/autoapp/Projection/AudioDsp.hpp>
+#include <f1x/openauto/autoapp/Projection/AudioJitterBuffer.hpp>
+#include <f1x/openauto/autoapp/Projection/EchoReference.hpp>
+#include <f1x/openauto/autoapp/Projection/IAudioOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDsp.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        class AudioMixer;
+
+        /**
+         * @brief What an AAP audio channel carries; decides who ducks whom.
+         */
+        enum class AudioMixerRole
+        {
+          Media,
+          // The head unit's own player and radio: media that also gives way
+          // to the phone's transient focus
+          LocalMedia,
+          Guidance,
+          System,
+          Telephony
+        };
+
+        /**
+         * @brief How local media plays next to the phone's audio focus.
+         */
+        enum class LocalMediaFocus
+        {
+          Full,
+          // The phone may duck us: ducking level, as under guidance
+          Ducked,
+          // A transient focus the phone holds alone, e.g. the assistant
+          Muted
+        };
+
+        /**
+         * @brief One AAP audio channel feeding an AudioMixer.
+         *
+         * Behaves like an RtAudioOutput towards its service, but only fills
+         * its own jitter buffer; the mixer's RT callback pulls, converts and
+         * sums all channels into the single device stream.
+         */
+        class AudioMixerChannel : public IAudioOutput
+        {
+        public:
+          typedef std::shared_ptr<AudioMixerChannel> Pointer;
+
+          AudioMixerChannel(std::shared_ptr<AudioMixer> mixer, AudioMixerRole role,
+                            uint32_t channelCount, uint32_t sampleRate, uint32_t jitterBufferMs);
+          ~AudioMixerChannel() override;
+
+          bool open() override;
+          void write(aasdk::messenger::Timestamp::ValueType timestamp,
+                     const aasdk::common::DataConstBuffer &buffer) override;
+          void start() override;
+          void stop() override;
+          void suspend() override;
+          uint32_t getSampleSize() const override;
+          uint32_t getChannelCount() const override;
+          uint32_t getSampleRate() const override;
+
+          /**
+           * @brief Channel volume, 0.0 to 1.0; applied with a ramp over the
+           * next period.
+           */
+          void setGain(float gain);
+
+          AudioMixerRole getRole() const;
+          AudioJitterStats getJitterStats() const;
+          // Frames waiting in the jitter buffer, and the fill it plays at;
+          // for producers that pace themselves rather than follow a phone
+          size_t getQueuedFrames() const;
+          uint32_t getTargetFrames() const;
+
+        private:
+          friend class AudioMixer;
+
+          /**
+           * @brief Adds @p frames frames of 48 kHz stereo into @p mix with
+           * saturation (RT thread only).
+           * @return True if the channel played audio rather than silence.
+           */
+          bool mixInto(int16_t *mix, size_t frames, float duckGain);
+
+          std::shared_ptr<AudioMixer> mixer_;
+          const AudioMixerRole role_;
+          const uint32_t channelCount_;
+          const uint32_t sampleRate_;
+          // Output frames per input frame; the mixer runs at 48 kHz
+          const uint32_t ratio_;
+          AudioJitterBuffer buffer_;
+          std::atomic<bool> active_;
+          std::atomic<float> gain_;
+          bool opened_;
+
+          // RT thread state
+          PolyphaseResampler resampler_;
+          std::vector<int16_t> input_;
+          std::vector<int16_t> resampled_;
+          std::vector<int16_t> stereo_;
+          int16_t appliedGain_;
+        };
+
+        /**
+         * @brief Mixes every AAP audio channel into one device stream.
+         *
+         * One RtAudio stream and one RT wakeup per period regardless of how
+         * many channels are open, instead of one ALSA stream per channel
+         * competing for hw:0,0 or going through dmix. Channels are converted
+         * to 48 kHz stereo with the AudioDsp kernels, scaled by their own
+         * gain, and media is ducked
+         * while guidance or a call is audible; local media also follows the
+         * phone's audio focus. The stream is opened with the
+         * first channel and stopped with the last, and the mixer itself is
+         * kept across phone connections.
+         */
+        class AudioMixer : public std::enable_shared_from_this<AudioMixer>
+        {
+        public:
+          typedef std::shared_ptr<AudioMixer> Pointer;
+
+          static constexpr uint32_t cSampleRate = 48000;
+          static constexpr uint32_t cChannelCount = 2;
+          static constexpr size_t cMaxChannels = 8;
+
+          /**
+           * @param deviceId RtAudio device ID (0 = default device)
+           * @param lowLatency See RtAudioOutput
+           * @param duckingPercent Media level while guidance or a call plays
+           */
+          AudioMixer(uint32_t deviceId, bool lowLatency, uint32_t duckingPercent);
+          ~AudioMixer();
+
+          /**
+           * @brief Creates an output for one AAP channel. Only sample rates
+           * that divide 48 kHz and mono or stereo are supported.
+           */
+          AudioMixerChannel::Pointer createChannel(AudioMixerRole role, uint32_t channelCount,
+                                                   uint32_t sampleRate, uint32_t jitterBufferMs);
+
+          uint32_t getDeviceId() const;
+
+          /**
+           * @brief Changes the media level while ducked; takes effect at the
+           * next period.
+           */
+          void setDuckingPercent(uint32_t duckingPercent);
+
+          /**
+           * @brief Ducks or mutes the LocalMedia channels from the next
+           * period on, ramped within it; any thread. Nothing is restarted.
+           */
+          void setLocalMediaFocus(LocalMediaFocus focus);
+
+          /**
+           * @brief Runs the media EQ and limiter of @p preset on the sum of
+           * the media channels, the phone's and local playback alike, before
+           * guidance and calls are added. Call before the first channel opens.
+           */
+          void setMediaDsp(MediaDspPreset::Pointer preset);
+
+          /**
+           * @brief The mixed output as mono at cSampleRate, written each
+           * period while a voice processing stage is attached.
+           */
+          EchoReference::Pointer getEchoReference() const;
+
+        private:
+          friend class AudioMixerChannel;
+          class DeviceOutput;
+
+          bool acquire();
+          void release();
+          void attach(AudioMixerChannel *channel);
+          void detach(AudioMixerChannel *channel);
+          // Returns once no render() that could still see a detached or
+          // stopped channel is in flight
+          void waitForRender() const;
+          void adaptPeriod();
+
+          void render(int16_t *output, size_t frames);
+
+          std::atomic<float> duckGain_;
+          std::atomic<LocalMediaFocus> localFocus_;
+          std::unique_ptr<DeviceOutput> device_;
+          std::mutex mutex_;
+          size_t users_;
+          const EchoReference::Pointer echoReference_;
+          std::unique_ptr<MediaDsp> mediaDsp_;
+          // Media channels are summed here while the DSP stage is on
+          std::vector<int16_t> mediaBus_;
+
+          std::array<std::atomic<AudioMixerChannel *>, cMaxChannels> channels_;
+          std::atomic<bool> rendering_;
+          bool ducking_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
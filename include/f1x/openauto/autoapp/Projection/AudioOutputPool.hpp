@@ -0,0 +1,82 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <f1x/openauto/autoapp/Projection/RtAudioOutput.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        struct AudioOutputFormat
+        {
+          uint32_t channelCount;
+          uint32_t sampleRate;
+          uint32_t deviceId;
+          bool lowLatency;
+          uint32_t jitterBufferMs;
+          bool keepRunning;
+
+          bool operator==(const AudioOutputFormat &other) const;
+        };
+
+        /**
+         * @brief The RtAudioOutputs of the unmixed audio path, kept for the
+         * life of the process. A session attaches by acquiring an output and
+         * detaches by dropping it; the next session, or a channel set up
+         * again, gets the same device stream back still open, without a
+         * new RtAudio, API probing or ALSA setup. Outputs still held (the
+         * radio's, a session not yet torn down) are never handed out twice.
+         */
+        class AudioOutputPool
+        {
+        public:
+          typedef std::shared_ptr<RtAudioOutput> OutputPointer;
+
+          // A detached output of that format, or else a new one
+          OutputPointer acquire(const AudioOutputFormat &format);
+          // Closes the detached outputs, e.g. to free the device for the mixer
+          void releaseIdle();
+          size_t size() const;
+
+        private:
+          struct Entry
+          {
+            AudioOutputFormat format;
+            OutputPointer output;
+          };
+
+          static bool isDetached(const Entry &entry);
+
+          mutable std::mutex mutex_;
+          std::vector<Entry> entries_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,98 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifdef USE_FFMPEG_DRM
+
+#include <cstdint>
+#include <string>
+
+class QImage;
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief The home screen as it last looked, put on the display before
+         * Qt starts.
+         *
+         * show() runs first thing in main(): it modesets the connector Qt will
+         * use to its preferred mode with a dumb XRGB8888 buffer holding the
+         * frame saveFrame() stored at the previous exit, or the installed
+         * splash. It then drops DRM master so eglfs can take the device, and
+         * keeps the framebuffer alive until release(), called once Qt has
+         * swapped its first frame in. Same mode, so no blank in between.
+         */
+        class BootSplash
+        {
+        public:
+          static constexpr const char *cSplashPath = "/usr/share/openauto/splash.xrgb";
+
+          static BootSplash &instance();
+
+          /**
+           * @brief Nothing happens with OPENAUTO_BOOT_SPLASH=0, without card0,
+           * or with no frame to show.
+           */
+          bool show();
+          void release();
+
+          /**
+           * @brief Stores @p frame for the next start, scaled to the display
+           * the splash went to if it differs.
+           */
+          bool saveFrame(const QImage &frame);
+
+          // $XDG_CACHE_HOME/openauto/last-frame.xrgb, or under ~/.cache
+          static std::string lastFramePath();
+
+        private:
+          BootSplash() = default;
+
+          struct FrameFile
+          {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            std::string pixels; // width * height XRGB8888, rows packed
+          };
+
+          static bool readFrame(const std::string &path, FrameFile &frame);
+          bool modeset(const FrameFile &frame);
+          void destroyBuffer();
+
+          int drmFd_ = -1;
+          uint32_t fbId_ = 0;
+          uint32_t handle_ = 0;
+          uint64_t size_ = 0;
+          uint32_t width_ = 0;
+          uint32_t height_ = 0;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
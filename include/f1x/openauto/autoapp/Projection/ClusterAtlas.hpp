@@ -0,0 +1,131 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <f1x/openauto/autoapp/NavigationState.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Manoeuvre icons and the digits and units of a distance,
+         * rasterised once as 8-bit coverage for one output size.
+         *
+         * Everything is drawn from anti-aliased strokes, triangles and rings,
+         * so no font or image files are needed and a redraw is only blits.
+         */
+        class ClusterAtlas
+        {
+        public:
+          enum class Icon
+          {
+            None,
+            Straight,
+            SlightLeft,
+            SlightRight,
+            Left,
+            Right,
+            SharpLeft,
+            SharpRight,
+            UTurnLeft,
+            UTurnRight,
+            RampLeft,
+            RampRight,
+            ForkLeft,
+            ForkRight,
+            Merge,
+            RoundaboutLeft,
+            RoundaboutRight,
+            Destination,
+            Ferry,
+            Count
+          };
+
+          struct Image
+          {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            std::vector<uint8_t> coverage;
+          };
+
+          /**
+           * @brief Sizes the icons and text for a @p width x @p height
+           * surface.
+           */
+          ClusterAtlas(uint32_t width, uint32_t height);
+
+          static Icon iconFor(const NavigationState &state);
+
+          const Image &icon(Icon icon) const;
+          /**
+           * @brief Distance text glyphs: digits, '.' and the letters of the
+           * unit names. The small set labels roundabout exits.
+           * @return nullptr for characters the font lacks.
+           */
+          const Image *glyph(char c, bool small = false) const;
+          uint32_t textWidth(const std::string &text, bool small = false) const;
+          uint32_t iconSize() const { return iconSize_; }
+          uint32_t textHeight(bool small = false) const { return small ? smallHeight_ : textHeight_; }
+
+          /**
+           * @brief Composites @p image tinted with @p colour (ARGB8888) over
+           * premultiplied ARGB8888 pixels, clipped to the surface.
+           * @param pitch Row length in pixels.
+           */
+          static void blit(const Image &image, uint32_t colour, uint32_t *pixels, uint32_t pitch, uint32_t width,
+                           uint32_t height, int x, int y);
+
+          /**
+           * @brief Draws @p text with its top left at @p x, @p y; characters
+           * the font lacks are skipped.
+           * @return x after the last glyph.
+           */
+          int drawText(const std::string &text, bool small, uint32_t colour, uint32_t *pixels, uint32_t pitch,
+                       uint32_t width, uint32_t height, int x, int y) const;
+
+        private:
+          static constexpr char cCharacters[] = "0123456789.dfikmty";
+          static constexpr size_t cCharacterCount = sizeof(cCharacters) - 1;
+
+          void rasteriseIcons();
+          void rasteriseFont(std::array<Image, cCharacterCount> &glyphs, uint32_t height);
+
+          uint32_t iconSize_;
+          uint32_t textHeight_;
+          uint32_t smallHeight_;
+          std::array<Image, static_cast<size_t>(Icon::Count)> icons_;
+          std::array<Image, cCharacterCount> glyphs_;
+          std::array<Image, cCharacterCount> smallGlyphs_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,124 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
+#include <f1x/openauto/autoapp/NavigationState.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        class ClusterAtlas;
+
+        /**
+         * @brief Next manoeuvre and distance for an instrument cluster, drawn
+         * from the StateBus navigation flag.
+         *
+         * Video/ClusterOutput names a second connector ("HDMI-A-2", "DSI-1"),
+         * which gets the CRTC Qt does not use, or is "overlay" for a panel on
+         * an overlay plane over the top right of the main display. Icons and
+         * digits are rasterised once at startup; a change of manoeuvre or of
+         * the displayed distance is a few blits into the back of two dumb
+         * buffers and one flip. The overlay makes way while reverse is engaged.
+         */
+        class ClusterDisplay
+        {
+        public:
+          explicit ClusterDisplay(configuration::IConfiguration::Pointer configuration);
+          ~ClusterDisplay();
+
+          ClusterDisplay(const ClusterDisplay &) = delete;
+          ClusterDisplay &operator=(const ClusterDisplay &) = delete;
+
+          /**
+           * @brief Sets up the output and starts the cluster thread.
+           * @return false if no output is configured or it is unavailable.
+           */
+          bool start();
+
+          /**
+           * @brief Draws @p state into premultiplied ARGB8888 pixels: the icon
+           * on the left, the distance and its unit beside it, the exit number
+           * inside a roundabout. Only the background when navigation is not
+           * active.
+           * @param pitch Row length in pixels.
+           * @param opaque Black background rather than a translucent panel.
+           */
+          static void render(const ClusterAtlas &atlas, const NavigationState &state, uint32_t *pixels,
+                             uint32_t pitch, uint32_t width, uint32_t height, bool opaque);
+
+        private:
+          struct DumbImage
+          {
+            uint32_t handle = 0;
+            uint32_t fbId = 0;
+            uint32_t pitch = 0;
+            size_t size = 0;
+            uint32_t *pixels = nullptr;
+          };
+
+          bool openOutput();
+          bool openConnector(const std::string &name);
+          bool openOverlay();
+          bool createBuffers();
+          void destroyBuffers();
+          bool present(const NavigationState &state);
+          void hide();
+          void run();
+          void wake();
+
+          configuration::IConfiguration::Pointer configuration_;
+          std::unique_ptr<ClusterAtlas> atlas_;
+          std::thread thread_;
+          std::atomic<bool> stopping_;
+          int wakeFd_;
+          int navigationSubscription_;
+          int reverseSubscription_;
+
+          int drmFd_;
+          bool overlay_;
+          uint32_t connectorId_;
+          uint32_t crtcId_;
+          uint32_t planeId_;
+          uint32_t width_;
+          uint32_t height_;
+          uint32_t x_;          // Panel position on the main display, overlay only
+          uint32_t y_;
+          bool visible_;
+          DumbImage buffers_[2];
+          int front_;
+          std::string drawn_;   // What the front buffer shows
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,160 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <mutex>
+#include <string>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Kinds of contiguous (CMA) buffers the video output allocates or
+         * imports itself. The decoder's own pool is estimated, not counted.
+         */
+        enum class CmaPool
+        {
+          DumbBuffer,  // Software fallback scanout buffers
+          Cursor,      // Hardware cursor image
+          PrimeImport, // Decoder DMA-BUFs imported as framebuffers
+          Camera,      // Rear camera capture buffers and guidelines
+          Cluster,     // Instrument cluster panel buffers
+          Count
+        };
+
+        /**
+         * @brief CmaTotal/CmaFree from /proc/meminfo in bytes, -1 when unknown
+         * (kernel without CMA, or not Linux).
+         */
+        struct CmaMeminfo
+        {
+          int64_t totalBytes = -1;
+          int64_t freeBytes = -1;
+
+          bool valid() const { return freeBytes >= 0; }
+        };
+
+        /**
+         * @brief What the hardware decoder may allocate for one session.
+         */
+        struct CmaPlan
+        {
+          size_t frameQueueDepth = 1; // Frame ring depth that fits into free CMA
+          bool hardwareFits = true;   // False if not even depth 1 fits
+        };
+
+        /**
+         * @brief Process-wide CMA accounting for the video pipeline.
+         *
+         * rkvdec decodes into physically contiguous buffers, so a fragmented or
+         * nearly full CMA area makes the decoder fail once the session has
+         * started. Reading CmaFree before the decoder is opened lets the frame
+         * ring and the advertised resolution be sized to what is actually left,
+         * and the per-pool counters show what this process holds.
+         */
+        class CmaBudget
+        {
+        public:
+          static CmaBudget &instance();
+
+          /**
+           * @brief Parses the CmaTotal and CmaFree lines of a meminfo listing.
+           */
+          static CmaMeminfo parseMeminfo(std::istream &in);
+
+          /**
+           * @brief Bytes of one NV12 frame as rkvdec allocates it (luma rows
+           * padded to 16, stride to 64 bytes).
+           */
+          static int64_t frameBytes(int width, int height);
+
+          /**
+           * @brief Estimated decoder pool for a session: reference and work
+           * surfaces plus the frame ring and the frames on screen.
+           */
+          static int64_t hardwareBytes(int width, int height, size_t frameQueueDepth);
+
+          /**
+           * @brief Largest frame ring depth up to requestedDepth whose decoder
+           * pool fits into freeBytes, keeping cReserveShare back because CmaFree
+           * counts scattered pages, not contiguous ranges.
+           * @param freeBytes CmaFree, or negative when unknown (always fits).
+           */
+          static CmaPlan plan(int64_t freeBytes, int width, int height, size_t requestedDepth);
+
+          /**
+           * @brief Re-reads /proc/meminfo and remembers the result.
+           */
+          CmaMeminfo refresh();
+
+          /**
+           * @brief Result of the last refresh().
+           */
+          CmaMeminfo lastMeminfo() const;
+
+          /**
+           * @brief plan() against the last refresh().
+           */
+          CmaPlan planFor(int width, int height, size_t requestedDepth) const;
+
+          /**
+           * @brief True if hardware decode at this resolution fits the last
+           * reading; used as the resolution ceiling.
+           */
+          bool fits(int width, int height) const;
+
+          void add(CmaPool pool, int64_t bytes);
+          void release(CmaPool pool, int64_t bytes);
+          int64_t allocatedBytes(CmaPool pool) const;
+          int64_t allocatedBytes() const;
+
+          /**
+           * @brief Single-line human readable summary for logs.
+           */
+          std::string summary() const;
+
+        private:
+          CmaBudget() = default;
+
+          // Share of CmaFree kept back for fragmentation and the rest of the system
+          static constexpr double cReserveShare = 0.25;
+          // H.264 reference frames (phones send at most four) plus FFmpeg's four
+          // work surfaces
+          static constexpr int64_t cDecoderSurfaces = 8;
+
+          mutable std::mutex mutex_;
+          CmaMeminfo meminfo_;
+          std::array<std::atomic<int64_t>, static_cast<size_t>(CmaPool::Count)> allocated_{};
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
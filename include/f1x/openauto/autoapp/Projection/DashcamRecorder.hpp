@@ -0,0 +1,154 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
+#include <f1x/openauto/autoapp/Projection/DashcamSegments.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        class Mp4SegmentWriter;
+
+        /**
+         * @brief Loop recording of the rear camera through a V4L2 mem2mem
+         * H.264 encoder (hantro, rkvenc and the like).
+         *
+         * The encoder reads the camera's own capture buffers, imported as
+         * DMA-BUFs, so a frame is never copied; the camera lends it with
+         * submit() and gets it back through the release handler once encoded.
+         * It only ever holds the few buffers it is allowed, and a frame it is
+         * offered with none left is simply not recorded, so the camera never
+         * waits on the recording. Encoded frames go to fragmented MP4 segments
+         * of Video/DashcamSegmentSeconds, one fragment per second, with the
+         * oldest segments deleted to stay under Video/DashcamMaxDiskMB.
+         *
+         * Muxing and file writes run on an idle-priority thread: when
+         * projection needs the CPU or the card, recording falls behind and
+         * drops frames instead.
+         */
+        class DashcamRecorder
+        {
+        public:
+          typedef std::function<void(int index)> ReleaseHandler;
+
+          /**
+           * @brief The camera's capture buffers, as negotiated with the grabber.
+           */
+          struct CaptureFormat
+          {
+            uint32_t pixelFormat = 0; // V4L2 fourcc
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint32_t bytesPerLine = 0;
+            uint32_t fps = 30;
+            std::vector<int> fds; // DMA-BUF of each capture buffer, by index
+            std::vector<size_t> sizes;
+          };
+
+          explicit DashcamRecorder(configuration::IConfiguration::Pointer configuration);
+          ~DashcamRecorder();
+
+          DashcamRecorder(const DashcamRecorder &) = delete;
+          DashcamRecorder &operator=(const DashcamRecorder &) = delete;
+
+          /**
+           * @brief Opens an encoder for @p format and starts recording. Called
+           * from the camera thread once its buffers exist.
+           * @param maxHeld Buffers the encoder may hold at once.
+           * @param release Called from the recorder thread with each buffer
+           * the encoder is done with.
+           * @return false if there is no usable encoder or directory.
+           */
+          bool attach(const CaptureFormat &format, size_t maxHeld, ReleaseHandler release);
+
+          /**
+           * @brief Stops recording and closes the segment. Buffers still held
+           * are released before it returns.
+           */
+          void detach();
+
+          /**
+           * @brief Offers a captured frame. Camera thread.
+           * @return true if the encoder took it; it is released later.
+           */
+          bool submit(int index, int64_t timestampUs);
+
+        private:
+          bool openEncoder(const CaptureFormat &format);
+          bool tryEncoder(const std::string &device, const CaptureFormat &format);
+          bool configureEncoder(const CaptureFormat &format);
+          void closeEncoder();
+          void run();
+          void drainOutput();
+          void drainCapture();
+          bool rotate();
+          void finishSegment();
+          void releaseHeld();
+
+          configuration::IConfiguration::Pointer configuration_;
+          DashcamSegments segments_;
+          ReleaseHandler release_;
+          std::thread thread_;
+          std::atomic<bool> stopping_;
+          int wakeFd_;
+
+          int encoderFd_;
+          uint32_t outputType_;
+          uint32_t captureType_;
+          uint32_t frameBytes_; // Raw frame size the encoder reads
+          uint32_t width_;
+          uint32_t height_;
+          std::vector<int> fds_;
+          std::vector<size_t> sizes_;
+          std::vector<void *> bitstream_; // Mapped capture buffers
+          std::vector<size_t> bitstreamSizes_;
+
+          std::mutex heldMutex_;
+          std::vector<bool> held_;
+          size_t heldCount_;
+          size_t maxHeld_;
+
+          // Recorder thread only. Shared, not unique, as builds without
+          // USE_FFMPEG_DRM have no writer to destroy
+          std::shared_ptr<Mp4SegmentWriter> writer_;
+          uint64_t segmentBytes_;
+
+          static constexpr uint32_t cBitstreamBuffers = 4;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
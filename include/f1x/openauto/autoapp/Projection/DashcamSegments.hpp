@@ -0,0 +1,95 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief The loop recording directory: numbered segment files, the
+         * oldest deleted to keep the whole set under a size limit.
+         *
+         * Files are named dashcam-<sequence>-<YYYYmmdd-HHMMSS>.mp4. The
+         * sequence decides which is oldest, so a clock that restarts at 1970
+         * on boards without an RTC cannot make new recordings go first. Sizes
+         * are allocated blocks, which counts preallocated space too.
+         */
+        class DashcamSegments
+        {
+        public:
+          struct Segment
+          {
+            std::string path;
+            uint64_t sequence = 0;
+            uint64_t bytes = 0;
+          };
+
+          DashcamSegments(std::string directory, uint64_t maxBytes);
+
+          /**
+           * @brief Creates the directory if needed.
+           * @return false if it cannot be created or written to.
+           */
+          bool prepare() const;
+
+          /**
+           * @brief Existing segments, oldest first.
+           */
+          std::vector<Segment> list() const;
+
+          /**
+           * @brief Path for the segment after every existing one.
+           */
+          std::string nextPath(std::time_t now) const;
+
+          /**
+           * @brief Deletes the oldest segments until @p reserveBytes more fit
+           * under the limit. @p keep (the segment being written) is counted
+           * but never deleted.
+           * @return The bytes freed.
+           */
+          uint64_t makeRoom(uint64_t reserveBytes, const std::string &keep = std::string()) const;
+
+          /**
+           * @brief Parses a segment file name.
+           * @return false for anything else in the directory.
+           */
+          static bool parseName(const std::string &name, uint64_t &sequence);
+
+        private:
+          std::string directory_;
+          uint64_t maxBytes_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
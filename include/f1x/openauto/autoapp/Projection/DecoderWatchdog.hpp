@@ -0,0 +1,100 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Recovery steps for a wedged decoder, cheapest first.
+         */
+        enum class DecoderRecovery
+        {
+          None,
+          Flush,         // avcodec_flush_buffers()
+          Reopen,        // A new codec context on the same hw device
+          RecreateDevice // A new hw device context; the DRM plane stays
+        };
+
+        /**
+         * @brief Notices a decoder that takes packets but returns no frames.
+         *
+         * rkvdec can wedge under CMA pressure: every avcodec_receive_frame()
+         * returns EAGAIN, which looks the same as waiting for the next
+         * packet. A hang is cMinPackets slice packets and cHangUs without a
+         * frame. Each hang escalates to the next DecoderRecovery. The first
+         * frame afterwards ends the recovery and reports its duration. Not
+         * thread-safe; the decode thread owns it.
+         */
+        class DecoderWatchdog
+        {
+        public:
+          static constexpr int64_t cHangUs = 400000;
+          static constexpr uint32_t cMinPackets = 4;
+
+          explicit DecoderWatchdog(int64_t hangUs = cHangUs, uint32_t minPackets = cMinPackets);
+
+          /**
+           * @brief A packet with slices went to the decoder at @p nowUs.
+           */
+          void packetSent(int64_t nowUs);
+
+          /**
+           * @brief The decoder returned a frame at @p nowUs.
+           * @return Microseconds from the first unanswered packet of the hang
+           * to this frame if it ends a recovery, otherwise 0.
+           */
+          int64_t frameDecoded(int64_t nowUs);
+
+          /**
+           * @brief The step to take now, if the decoder is hung. Each step is
+           * given cHangUs to bring a frame back before the next one; the last
+           * one repeats.
+           */
+          DecoderRecovery poll(int64_t nowUs);
+
+          /**
+           * @brief Forgets the stream, as at a session start.
+           */
+          void reset();
+
+          bool recovering() const;
+
+        private:
+          const int64_t hangUs_;
+          const uint32_t minPackets_;
+
+          int64_t firstUnansweredUs_; // First packet since the last frame
+          uint32_t unanswered_;
+          int64_t hangStartUs_;       // First unanswered packet of the current hang, 0 if none
+          DecoderRecovery lastStep_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
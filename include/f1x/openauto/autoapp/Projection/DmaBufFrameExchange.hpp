@@ -0,0 +1,133 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+ * DmaBufFrameExchange.hpp
+ *
+ * Hand-off point between FFmpegDrmVideoOutput and the Qt scene graph in
+ * compositor presentation mode. The decode thread publishes DRM PRIME
+ * frames; DmaBufVideoItem picks up the newest one on the render thread and
+ * imports its DMA-BUF as an EGLImage. Only references change hands, the
+ * pixels never leave the decoder's buffers.
+ */
+
+#pragma once
+
+#ifdef USE_FFMPEG_DRM
+
+extern "C"
+{
+#include <libavutil/frame.h>
+}
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <f1x/openauto/autoapp/Projection/ProjectionGeometry.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Single-slot mailbox carrying the newest decoded frame from the
+         * video output to the compositor.
+         *
+         * The scene graph renders at the display refresh, so a frame that has
+         * not been picked up by the time the next one is published is dropped
+         * (counted as superseded) rather than queued.
+         */
+        class DmaBufFrameExchange
+        {
+        public:
+          typedef std::function<void()> FrameAvailableHandler;
+
+          static DmaBufFrameExchange &instance();
+
+          /**
+           * @brief Publishes a frame, replacing one that was not taken yet.
+           * @param frame DRM PRIME frame; the exchange takes its own reference.
+           * @param timing Pipeline timestamps carried to the compositor.
+           * @return false if the frame could not be referenced.
+           */
+          bool publish(const AVFrame *frame, const VideoFrameTiming &timing);
+
+          /**
+           * @brief Takes the newest published frame.
+           * @param timing Receives the frame's pipeline timestamps.
+           * @return Frame owned by the caller (av_frame_free()), or nullptr.
+           */
+          AVFrame *take(VideoFrameTiming &timing);
+
+          /**
+           * @brief Drops the pending frame and tells the consumer to release
+           * the frames it is showing (end of session).
+           */
+          void clear();
+
+          /**
+           * @brief Returns true once after each clear().
+           */
+          bool takeCleared();
+
+          /**
+           * @brief Installs the callback run (on the publishing thread) after a
+           * frame is published or the exchange is cleared. Clearing the handler
+           * waits for a running callback to return.
+           */
+          void setFrameAvailableHandler(FrameAvailableHandler handler);
+
+          uint64_t supersededFrames() const;
+
+          /**
+           * @brief Session geometry, so the compositor crops and letterboxes
+           * the same way as the plane path.
+           */
+          void setGeometry(const ProjectionGeometry &geometry);
+          ProjectionGeometry geometry() const;
+
+        private:
+          DmaBufFrameExchange() = default;
+          ~DmaBufFrameExchange();
+
+          void notify();
+
+          mutable std::mutex mutex_;
+          AVFrame *pending_ = nullptr;
+          VideoFrameTiming pendingTiming_;
+          bool cleared_ = false;
+          uint64_t superseded_ = 0;
+          ProjectionGeometry geometry_;
+
+          std::mutex handlerMutex_;
+          FrameAvailableHandler handler_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
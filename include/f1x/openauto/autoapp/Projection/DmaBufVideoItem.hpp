@@ -0,0 +1,70 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+ * DmaBufVideoItem.hpp
+ *
+ * QML item that shows the FFmpegDrmVideoOutput stream through the Qt scene
+ * graph instead of a KMS overlay plane. Each DRM PRIME frame is imported as
+ * an EGLImage (EGL_EXT_image_dma_buf_import) and sampled from an external
+ * OES texture, so decoding stays zero-copy and QML overlays are composited
+ * over the video by the GPU.
+ *
+ * Used when Video/CompositorImport is set, for boards whose VOP has no
+ * usable overlay plane. Registered for QML as OpenAuto.Video/DmaBufVideoItem.
+ */
+
+#pragma once
+
+#ifdef USE_FFMPEG_DRM
+
+#include <QQuickItem>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        class DmaBufVideoItem : public QQuickItem
+        {
+          Q_OBJECT
+
+        public:
+          explicit DmaBufVideoItem(QQuickItem *parent = nullptr);
+          ~DmaBufVideoItem() override;
+
+          /**
+           * @brief Registers the item with the QML engine.
+           */
+          static void registerQmlType();
+
+        protected:
+          QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
@@ -0,0 +1,86 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#ifdef USE_FFMPEG_DRM
+
+#include <cstdint>
+#include <string>
+#include <xf86drmMode.h>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Helpers for the outputs that put their own planes next to
+         * Qt's: the rear camera and the cluster display.
+         */
+        namespace drmdevice
+        {
+          /**
+           * @brief A new descriptor for the /dev/dri/card0 Qt EGLFS holds, so
+           * the caller shares its DRM master; /dev/dri/card0 opened afresh when
+           * Qt has none. Universal planes are enabled either way.
+           * @return -1 on failure, with errno set.
+           */
+          int openShared();
+
+          /**
+           * @brief The plane's "type" property, DRM_PLANE_TYPE_OVERLAY if it has
+           * none.
+           */
+          uint64_t planeType(int fd, uint32_t planeId);
+
+          bool planeSupports(drmModePlanePtr plane, uint32_t format);
+
+          /**
+           * @brief Connector name as the kernel logs it, such as "HDMI-A-1".
+           */
+          std::string connectorName(drmModeConnectorPtr connector);
+
+          /**
+           * @brief The bit of @p crtcId in possible_crtcs masks, 0 if unknown.
+           */
+          uint32_t crtcMask(int fd, uint32_t crtcId);
+
+          /**
+           * @brief Id of the property @p name of a KMS object, 0 if it has none.
+           */
+          uint32_t propertyId(int fd, uint32_t objectId, uint32_t objectType, const char *name);
+
+          /**
+           * @brief Refresh of a mode in millihertz, from its pixel clock and
+           * totals rather than the rounded vrefresh.
+           */
+          uint32_t refreshMilliHz(const drmModeModeInfo &mode);
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
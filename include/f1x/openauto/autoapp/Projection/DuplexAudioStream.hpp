@@ -0,0 +1,171 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <f1x/openauto/autoapp/Projection/AudioJitterBuffer.hpp>
+#include <f1x/openauto/autoapp/Projection/EchoReference.hpp>
+#include <f1x/openauto/autoapp/Projection/IAudioOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/RtAudioInput.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        class DuplexAudioStream;
+
+        /**
+         * @brief The telephony channel's output, played by a
+         * DuplexAudioStream rather than a stream of its own.
+         */
+        class DuplexAudioOutput : public IAudioOutput
+        {
+        public:
+          DuplexAudioOutput(std::shared_ptr<DuplexAudioStream> stream, uint32_t jitterBufferMs);
+          ~DuplexAudioOutput() override;
+
+          bool open() override;
+          void write(aasdk::messenger::Timestamp::ValueType timestamp,
+                     const aasdk::common::DataConstBuffer &buffer) override;
+          void start() override;
+          void stop() override;
+          void suspend() override;
+          uint32_t getSampleSize() const override;
+          uint32_t getChannelCount() const override;
+          uint32_t getSampleRate() const override;
+          AudioJitterStats getJitterStats() const;
+
+        private:
+          friend class DuplexAudioStream;
+
+          std::shared_ptr<DuplexAudioStream> stream_;
+          AudioJitterBuffer buffer_;
+          // Between start() and suspend(); otherwise the tail plays out
+          std::atomic<bool> active_;
+          bool opened_;
+        };
+
+        /**
+         * @brief The microphone, captured by a DuplexAudioStream. Falls back
+         * to a capture stream of its own when the duplex stream cannot open.
+         */
+        class DuplexAudioInput : public RtAudioInput
+        {
+        public:
+          DuplexAudioInput(boost::asio::io_service &ioService, std::shared_ptr<DuplexAudioStream> stream,
+                           configuration::IConfiguration::Pointer configuration);
+          ~DuplexAudioInput() override;
+
+        protected:
+          bool startDevice() override;
+          void stopDevice() override;
+
+        private:
+          std::shared_ptr<DuplexAudioStream> stream_;
+          bool attached_;
+        };
+
+        /**
+         * @brief One RtAudio stream playing the call and capturing the
+         * microphone, 16 kHz mono both ways.
+         *
+         * Both directions run off the same device clock in the same
+         * callback, with 10 ms periods at SCHED_FIFO, instead of a 32 ms
+         * capture stream drifting against whatever plays the call. Each
+         * period is written to the echo reference just before the
+         * microphone period captured with it, so the canceller sees the two
+         * sample-aligned. The stream runs while either side is open.
+         */
+        class DuplexAudioStream : public std::enable_shared_from_this<DuplexAudioStream>
+        {
+        public:
+          typedef std::shared_ptr<DuplexAudioStream> Pointer;
+
+          static constexpr uint32_t cSampleRate = 16000;
+          static constexpr uint32_t cPeriodFrames = 160;
+
+          /**
+           * @param outputDeviceId RtAudio device IDs (0 = default device)
+           * @param jitterBufferMs Call audio queued before playout starts
+           */
+          DuplexAudioStream(uint32_t outputDeviceId, uint32_t inputDeviceId, uint32_t jitterBufferMs);
+          virtual ~DuplexAudioStream();
+
+          IAudioOutput::Pointer createOutput();
+          std::shared_ptr<RtAudioInput> createInput(boost::asio::io_service &ioService,
+                                                    configuration::IConfiguration::Pointer configuration);
+
+          uint32_t getOutputDeviceId() const;
+          uint32_t getInputDeviceId() const;
+
+          /**
+           * @brief What the call plays, mono at cSampleRate, for the
+           * microphone's voice processing stage.
+           */
+          EchoReference::Pointer getEchoReference() const;
+
+          /**
+           * @brief Body of the RT callback: plays one period of the call into
+           * @p output and captures @p input for the microphone. RT-safe.
+           */
+          void process(int16_t *output, const int16_t *input, unsigned int frames, bool overflowed);
+
+        protected:
+          // Open and start, or stop and close, the device stream, mutex_
+          // held. Overridden by backends without a device, which call
+          // process() themselves
+          virtual bool openStream();
+          virtual void closeStream();
+
+        private:
+          friend class DuplexAudioOutput;
+          friend class DuplexAudioInput;
+
+          bool acquire();
+          void release();
+          // Returns once no process() that could still see a detached side
+          // is in flight
+          void waitForProcess() const;
+          static int rtAudioCallback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames,
+                                     double streamTime, RtAudioStreamStatus status, void *userData);
+
+          const uint32_t outputDeviceId_;
+          const uint32_t inputDeviceId_;
+          const uint32_t jitterBufferMs_;
+          const EchoReference::Pointer echoReference_;
+          std::unique_ptr<RtAudio> dac_;
+          std::mutex mutex_;
+          size_t users_;
+          std::atomic<DuplexAudioOutput *> output_;
+          std::atomic<RtAudioInput *> input_;
+          std::atomic<bool> processing_;
+          std::atomic<uint32_t> xruns_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,101 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
+#include <f1x/openauto/autoapp/Projection/FrameRing.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief What the speakers are about to play, for the microphone's
+         * echo canceller.
+         *
+         * Single producer (the AudioMixer's RT callback, which writes each
+         * mixed period as mono) and single consumer (the voice processing
+         * thread). The mixer only writes while a consumer is attached, so an
+         * idle reference costs the RT callback one atomic load.
+         */
+        class EchoReference
+        {
+        public:
+          typedef std::shared_ptr<EchoReference> Pointer;
+          typedef MonoFrameRing Ring;
+
+          // Queued reference, mono at the mixer rate
+          static constexpr uint32_t cRingMs = 500;
+          static constexpr uint32_t cLowMemoryRingMs = 250;
+
+          explicit EchoReference(uint32_t sampleRate);
+
+          /**
+           * @brief Downmixes @p frames interleaved frames to mono and queues
+           * them; drops what does not fit (RT thread only, never blocks).
+           */
+          void write(const int16_t *samples, size_t frames, uint32_t channels);
+
+          /**
+           * @brief Starts or stops the producer side. On attach the consumer
+           * discards whatever an earlier session left queued.
+           */
+          void attach();
+          void detach();
+          bool isAttached() const;
+
+          /**
+           * @brief Consumer side: mono samples at getSampleRate().
+           */
+          Ring &ring();
+
+          uint32_t getSampleRate() const;
+
+          /**
+           * @brief Samples the producer dropped because the consumer fell
+           * behind, since attach().
+           */
+          uint64_t droppedSamples() const;
+
+        private:
+          static constexpr size_t cScratchSamples = 256;
+
+          const uint32_t sampleRate_;
+          Ring ring_;
+          MemoryCharge memory_;
+          std::atomic<bool> attached_;
+          std::atomic<uint64_t> dropped_;
+          // RT thread only
+          int16_t scratch_[cScratchSamples];
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,152 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <linux/input.h>
+#include <f1x/openauto/autoapp/Projection/IInputDevice.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        class IInputDeviceEventHandler;
+
+        /**
+         * @brief Turns evdev key and rotary events into Android Auto button events.
+         *
+         * Keys go through a Linux key code to AA key code map. Detents of a
+         * rotary encoder (REL_DIAL, REL_WHEEL, REL_HWHEEL or REL_X) that arrive
+         * within cRotaryWindow of the last report are summed into one report
+         * with several steps. Spinning fast enough to fill that window with
+         * accelerationDetents detents doubles the steps.
+         */
+        class EvdevKeyDecoder
+        {
+        public:
+          typedef std::map<uint16_t, aap_protobuf::service::media::sink::message::KeyCode> KeyMap;
+          typedef std::function<void(const ButtonEvent &)> Sink;
+
+          static constexpr InputTimestamp cRotaryWindow{40000};
+
+          /**
+           * @param supportedCodes Codes announced to the phone; others are dropped.
+           * @param accelerationDetents Detents per window that double the steps,
+           * 0 for no acceleration.
+           */
+          EvdevKeyDecoder(KeyMap keyMap, IInputDevice::ButtonCodes supportedCodes, uint32_t accelerationDetents, Sink sink);
+
+          /**
+           * @brief Keys of steering wheel controls, adc-keys ladders and media
+           * keyboards that have an AA counterpart.
+           */
+          static KeyMap defaultKeyMap();
+
+          /**
+           * @brief Adds "linux=aa" pairs, separated by commas, to @p keyMap. Linux
+           * keys are KEY_ names or numbers, AA keys KEYCODE_ names or numbers.
+           * @return False on a malformed entry; earlier entries are kept.
+           */
+          static bool parseKeyMap(const std::string &spec, KeyMap &keyMap);
+
+          /**
+           * @param timestamp When the event happened, on the monotonic base.
+           */
+          void feed(const input_event &event, InputTimestamp timestamp);
+
+          /**
+           * @brief Sends the summed detents once their window has passed.
+           */
+          void flush(InputTimestamp now);
+
+          /**
+           * @brief When flush() has work, or zero if no detents are waiting.
+           */
+          InputTimestamp nextFlush() const;
+
+        private:
+          bool supports(aap_protobuf::service::media::sink::message::KeyCode code) const;
+          void sendRotary(InputTimestamp now);
+
+          KeyMap keyMap_;
+          IInputDevice::ButtonCodes supportedCodes_;
+          uint32_t accelerationDetents_;
+          Sink sink_;
+          int32_t pendingDetents_;
+          InputTimestamp pendingTimestamp_;
+          InputTimestamp lastRotary_;
+        };
+
+        /**
+         * @brief Reads rotary encoders and steering wheel key devices on one
+         * thread while projection is active.
+         *
+         * The devices are grabbed so Qt does not see the same presses a second
+         * time. Nodes that cannot be opened are skipped with a warning.
+         */
+        class EvdevKeyReader
+        {
+        public:
+          EvdevKeyReader(std::vector<std::string> devicePaths, EvdevKeyDecoder::KeyMap keyMap, uint32_t accelerationDetents);
+          ~EvdevKeyReader();
+
+          EvdevKeyReader(const EvdevKeyReader &) = delete;
+          EvdevKeyReader &operator=(const EvdevKeyReader &) = delete;
+
+          /**
+           * @return False if none of the devices could be opened.
+           */
+          bool start(IInputDeviceEventHandler &eventHandler, const IInputDevice::ButtonCodes &supportedCodes);
+          void stop();
+
+        private:
+          struct Device
+          {
+            int fd;
+            bool monotonicTimes;
+          };
+
+          void run(EvdevKeyDecoder decoder);
+          void closeDevices();
+
+          std::vector<std::string> devicePaths_;
+          EvdevKeyDecoder::KeyMap keyMap_;
+          uint32_t accelerationDetents_;
+          std::vector<Device> devices_;
+          int wakeFd_;
+          std::atomic<bool> stopping_;
+          std::thread thread_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
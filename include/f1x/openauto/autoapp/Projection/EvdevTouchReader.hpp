@@ -0,0 +1,159 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <linux/input.h>
+#include <f1x/openauto/autoapp/Projection/InputEvent.hpp>
+#include <f1x/openauto/autoapp/Projection/ProjectionGeometry.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        class IInputDeviceEventHandler;
+
+        /**
+         * @brief Raw coordinate range of a touch panel, as reported by EVIOCGABS.
+         */
+        struct EvdevTouchAxes
+        {
+          int32_t xMin = 0;
+          int32_t xMax = 0;
+          int32_t yMin = 0;
+          int32_t yMax = 0;
+        };
+
+        /**
+         * @brief Turns the kernel's multitouch slot protocol into Android Auto
+         * touch events.
+         *
+         * Contacts are tracked per slot and reported on SYN_REPORT in the order
+         * the phone expects: moves of the contacts already down, then lifts, then
+         * new contacts. The slot number is the pointer id. Panels without slots
+         * are handled as a single contact from ABS_X/ABS_Y and BTN_TOUCH.
+         */
+        class EvdevTouchDecoder
+        {
+        public:
+          typedef std::function<void(const TouchEvent &)> Sink;
+
+          static constexpr size_t cMaxSlots = 10;
+
+          /**
+           * @param axes Raw range, mapped onto the whole display.
+           * @param geometry Maps display pixels to video pixels.
+           * @param multiTouch False for panels without ABS_MT_SLOT.
+           * @param monotonicTimes Whether input_event::time is CLOCK_MONOTONIC
+           * (EVIOCSCLOCKID succeeded); otherwise frames are stamped on arrival.
+           */
+          EvdevTouchDecoder(const EvdevTouchAxes &axes, const ProjectionGeometry &geometry, bool multiTouch,
+                            bool monotonicTimes, Sink sink);
+
+          void feed(const input_event &event);
+
+          /**
+           * @brief Lifts every contact, e.g. when the reader stops mid-gesture.
+           */
+          void releaseAll();
+
+        private:
+          struct Slot
+          {
+            int32_t trackingId = -1; // Kernel state after the current frame
+            bool down = false;       // As last reported to the phone
+            int32_t x = 0;
+            int32_t y = 0;
+            bool moved = false;
+          };
+
+          void commit(InputTimestamp timestamp);
+          void emitEvent(aap_protobuf::service::inputsource::message::PointerAction action, size_t changedSlot);
+          TouchPoint toVideo(size_t slot) const;
+
+          ProjectionGeometry geometry_;
+          bool multiTouch_;
+          bool monotonicTimes_;
+          Sink sink_;
+          // Raw to display pixels, computed once per device
+          double xScale_;
+          double yScale_;
+          int32_t xMin_;
+          int32_t yMin_;
+          std::array<Slot, cMaxSlots> slots_;
+          size_t currentSlot_;
+          bool dropping_;
+          TouchEvent event_; // Reused for every emitted event
+        };
+
+        /**
+         * @brief Reads a touch panel's evdev node on its own thread while
+         * projection is active.
+         *
+         * The device is grabbed, so Qt's input handler sees nothing until stop()
+         * releases it, and touches reach the event handler without waiting for
+         * the GUI thread.
+         */
+        class EvdevTouchReader
+        {
+        public:
+          EvdevTouchReader(std::string devicePath, const ProjectionGeometry &geometry);
+          ~EvdevTouchReader();
+
+          EvdevTouchReader(const EvdevTouchReader &) = delete;
+          EvdevTouchReader &operator=(const EvdevTouchReader &) = delete;
+
+          /**
+           * @brief Opens and grabs the device and starts reading.
+           * @return False if the device cannot be used; Qt input stays in charge.
+           */
+          bool start(IInputDeviceEventHandler &eventHandler);
+
+          /**
+           * @brief Joins the reader, lifting any contact still down, and hands
+           * the device back to Qt.
+           */
+          void stop();
+
+        private:
+          void run(IInputDeviceEventHandler *eventHandler, EvdevTouchAxes axes, bool multiTouch, bool monotonicTimes);
+
+          std::string devicePath_;
+          ProjectionGeometry geometry_;
+          int deviceFd_;
+          int wakeFd_;
+          std::atomic<bool> stopping_;
+          std::thread thread_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -33,6 +33,10 @@
  *
  * Pipeline: H.264 data -> FFmpeg h264 (DRM hwaccel) -> DRM Prime -> KMS display
  *
+ * With Video/CompositorImport the DRM Prime frames are handed to the Qt
+ * scene graph instead (see DmaBufVideoItem), for boards without a free
+ * overlay plane.
+ *
  * Key Features:
  * - Uses native h264 decoder with DRM hardware context
  * - Hardware accelerated decoding via DRM hwaccel framework
@@ -46,6 +50,7 @@
  * - libdrm for DRM/KMS display
  *
  * Tested: 248 FPS (4.18x speed) on 720p60 H.264 stream
+ * (reproduce with the video_bench target on a recorded session)
  *
  * Compile with: -DUSE_FFMPEG_DRM to enable this backend
  */
@@ -70,13 +75,29 @@ extern "C"
 #include <xf86drmMode.h>
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
 #include <f1x/openauto/autoapp/Projection/VideoOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/DecoderWatchdog.hpp>
+#include <f1x/openauto/autoapp/Projection/DmaBufFrameExchange.hpp>
+#include <f1x/openauto/autoapp/Projection/FrameGrabber.hpp>
+#include <f1x/openauto/autoapp/Projection/PacketDropPolicy.hpp>
+#include <f1x/openauto/autoapp/Projection/PresentationPacer.hpp>
+#include <f1x/openauto/autoapp/Projection/RgaTransform.hpp>
+#include <f1x/openauto/autoapp/Projection/V4l2RequestDecoder.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
+#include <f1x/openauto/autoapp/Projection/VpuScheduler.hpp>
 #include <mutex>
 #include <queue>
 #include <string>
 #include <thread>
+#include <tuple>
 
 namespace f1x
 {
@@ -98,13 +119,25 @@ namespace f1x
          * Features:
          * - Hardware accelerated H.264 decoding via DRM hwaccel (rkvdec on RK3229)
          * - Zero-copy DRM Prime path to KMS display
-         * - Minimal internal buffering (decode-on-demand)
+         * - Minimal internal buffering (small bounded packet queue)
+         * - Dedicated decode thread, so write() never blocks the caller's strand
+         * - Vsync-paced presentation thread using atomic page-flip events
          * - DRM hardware cursor support
          * - Thread-safe frame submission
          */
         class FFmpegDrmVideoOutput : public VideoOutput
         {
         public:
+          /**
+           * @brief Pipeline variants for video_bench; the defaults are what
+           * autoapp runs.
+           */
+          struct BenchmarkOptions
+          {
+            bool headless = false;       // Decode only: no display, frames released on arrival
+            bool softwareDecode = false; // Skip the DRM hwaccel
+          };
+
           /**
            * @brief Constructs the FFmpegDrmVideoOutput with the given configuration.
            * @param configuration Pointer to the OpenAuto configuration interface.
@@ -114,6 +147,7 @@ namespace f1x
 
           /**
            * @brief Destructor - ensures proper cleanup of FFmpeg and DRM resources.
+           * Calls shutdown().
            */
           ~FFmpegDrmVideoOutput() override;
 
@@ -123,6 +157,8 @@ namespace f1x
 
           /**
            * @brief Initializes FFmpeg decoder and DRM display.
+           * A context kept warm by a previous session is reused as long as the
+           * configured resolution and frame queue depth still match.
            * @return true if initialization succeeded, false otherwise.
            */
           bool open() override;
@@ -134,7 +170,9 @@ namespace f1x
           bool init() override;
 
           /**
-           * @brief Writes an H.264 video frame for decoding and display.
+           * @brief Queues an H.264 video frame for decoding and display.
+           * The buffer is copied and handed to the decode thread, so this returns
+           * without waiting for the decoder or the display.
            * @param timestamp The presentation timestamp in nanoseconds.
            * @param buffer The raw H.264 frame data to be decoded and displayed.
            */
@@ -142,12 +180,108 @@ namespace f1x
                      const aasdk::common::DataConstBuffer &buffer) override;
 
           /**
-           * @brief Stops the pipeline and releases all resources.
+           * @brief Ends the current session.
+           * Joins the worker threads, flushes the decoder and hides the video
+           * plane. The decoder, hw device context, DRM plane/property IDs and
+           * framebuffer cache stay allocated for the next session.
            */
           void stop() override;
 
+          /**
+           * @brief Registers the handler called when a written frame leaves the
+           * decode queue (taken by the decode thread, dropped, or discarded).
+           * @param handler Called from the aasdk strand or the decode thread;
+           * nullptr unregisters.
+           * @return Always true.
+           */
+          bool setFrameConsumedHandler(FrameConsumedHandler handler) override;
+
+          /**
+           * @brief Registers the handler used to ask the phone for an IDR frame
+           * after the drop policy discarded reference frames.
+           * @param handler Called from the aasdk strand; nullptr unregisters.
+           */
+          void setKeyframeRequestHandler(KeyframeRequestHandler handler) override;
+
+          /**
+           * @brief Sets the session geometry the plane rectangles are built from.
+           * Called before init(), while the presentation thread is stopped.
+           */
+          void setProjectionGeometry(const ProjectionGeometry &geometry) override;
+
+          /**
+           * @brief Sets the stream's frame rate the presentation cadence is
+           * worked out from in init(). Called before init().
+           */
+          void setFrameRate(uint32_t fps) override;
+
+          /**
+           * @brief Frees what the hidden projection holds, or restores it.
+           * In the background the session is stopped as by stop() and the
+           * decoder, frame ring, framebuffers and RGA buffers are released;
+           * the DRM fd, plane and hw device context stay. Back in the
+           * foreground the decoder is reopened and the pipeline restarted,
+           * dropping everything up to the next IDR. Called on the aasdk strand.
+           */
+          void setBackground(bool background) override;
+
+          /**
+           * @brief H.264 always; H.265 only when an HEVC-capable V4L2 stateless
+           * decoder and FFmpeg's DRM hwaccel for it are both present.
+           */
+          bool supportsCodec(
+              aap_protobuf::service::media::shared::message::MediaCodecType codec) const override;
+
+          /**
+           * @brief Switches the decoder to the codec the phone chose. A decoder
+           * opened (or kept warm) for the other codec is rebuilt.
+           * @return false if the codec is unsupported or the decoder failed.
+           */
+          bool setCodec(aap_protobuf::service::media::shared::message::MediaCodecType codec) override;
+
+          /**
+           * @brief Selects a benchmark variant. Call before open().
+           */
+          void setBenchmarkOptions(const BenchmarkOptions &options);
+
+          /**
+           * @brief Decodes H.264 with V4l2RequestDecoder instead of FFmpeg's
+           * hwaccel when a frame-based stateless decoder is present. libavcodec
+           * stays open and takes over for streams the device cannot decode.
+           * Call before open().
+           */
+          void setNativeDecoder(bool enabled);
+
+          /**
+           * @brief Puts the output on the named connector, such as "HDMI-A-2",
+           * instead of the first connected one, and decodes as @p stream in
+           * the VpuScheduler. For a second output next to the main display.
+           * Call before open().
+           */
+          void setDisplay(const std::string &connector, VpuStream stream);
+
+          /**
+           * @brief Whether the DRM hwaccel or the native decoder decoded every
+           * frame since init().
+           * False once the decoder fell back to software, even mid-stream.
+           */
+          bool isHardwareDecoding() const;
+
+          /**
+           * @brief Whether the native decoder (see setNativeDecoder()) decoded
+           * every frame since init().
+           */
+          bool isNativeDecoding() const;
+
+          /**
+           * @brief Stops the pipeline and releases all resources.
+           */
+          void shutdown();
+
           /**
            * @brief Updates the hardware cursor position.
+           * Only records the latest position; the presentation thread moves the
+           * cursor plane at most once per vblank. Safe to call from any thread.
            * @param x X coordinate in screen pixels.
            * @param y Y coordinate in screen pixels.
            */
@@ -155,10 +289,40 @@ namespace f1x
 
           /**
            * @brief Shows or hides the hardware cursor.
+           * Applied by the presentation thread like updateCursorPosition().
            * @param visible true to show cursor, false to hide.
            */
           static void setCursorVisible(bool visible);
 
+          /**
+           * @brief Keeps decoded frames off the video plane while the rear
+           * camera has it; they are still decoded and acknowledged, and the
+           * next one is shown once the plane is handed back. Safe to call from
+           * any thread.
+           */
+          static void lendPlane(bool lent);
+
+          /**
+           * @brief Whether Qt's primary plane is stacked above the video plane
+           * with per-pixel alpha, so a transparent QML window shows the video
+           * through it and the display controller composites overlays drawn
+           * on it. Safe to call from any thread.
+           */
+          static bool uiAboveVideo();
+
+          /**
+           * @brief Called with uiAboveVideo() whenever DRM setup or cleanup
+           * changes it, on the thread opening or closing the output.
+           */
+          static void setStackingHandler(std::function<void(bool uiAboveVideo)> handler);
+
+          /**
+           * @brief Probes once per process for HEVC hardware decode: the hevc
+           * decoder has a DRM hwaccel and a V4L2 device takes HEVC slices.
+           * Called at startup so service discovery answers from the result.
+           */
+          static bool hevcHardwareAvailable();
+
           /**
            * @brief Emergency cleanup for signal handlers.
            * Called on SIGINT/SIGTERM to release DRM resources and prevent CMA leaks.
@@ -167,11 +331,380 @@ namespace f1x
           void emergencyCleanup();
 
         private:
+          /**
+           * @brief Deleter so queued AVBufferRefs are released with the queue entry.
+           */
+          struct BufferRefDeleter
+          {
+            void operator()(AVBufferRef *ref) const { av_buffer_unref(&ref); }
+          };
+          typedef std::unique_ptr<AVBufferRef, BufferRefDeleter> BufferRefPtr;
+
+          /**
+           * @brief A copied H.264 buffer waiting for the decode thread.
+           * The buffer is padded with AV_INPUT_BUFFER_PADDING_SIZE zero bytes so it
+           * can be handed to the decoder by reference.
+           */
+          struct PendingPacket
+          {
+            uint64_t timestamp;
+            BufferRefPtr buffer;
+            int size;
+            int64_t arrivalUs; // VideoTelemetry::nowUs() when write() was called
+            AccessUnitInfo info;
+          };
+
+          /**
+           * @brief Telemetry of a packet between send_packet and receive_frame.
+           */
+          struct InFlightPacket
+          {
+            int64_t pts;
+            int64_t arrivalUs;
+            int64_t sendUs;
+          };
+
+          /**
+           * @brief Packets tracked for decode latency; more than this in flight
+           * means the decoder is not returning frames for them.
+           */
+          static constexpr size_t cMaxInFlightPackets = 16;
+
+          /**
+           * @brief Packets still queued behind the one being decoded from which
+           * the decoder skips non-reference pictures.
+           */
+          static constexpr size_t cSkipBacklogPackets = 2;
+
+          /**
+           * @brief Lifecycle of a decoded frame held by the presentation stage.
+           */
+          enum class FrameSlotState
+          {
+            Released,   // Free, no buffer referenced
+            Decoded,    // Reference taken from the decoder, not yet visible to KMS
+            Queued,     // Waiting for the next vblank
+            ScanningOut // Committed to the plane (on screen or being replaced)
+          };
+
+          /**
+           * @brief One entry of the in-flight frame ring.
+           */
+          struct FrameSlot
+          {
+            AVFrame *frame;
+            FrameSlotState state;
+            uint64_t sequence; // Decode order, used to present queued frames FIFO
+            VideoFrameTiming timing;
+          };
+
+          /**
+           * @brief A mapped dumb buffer used by the software fallback path.
+           */
+          struct DumbBuffer
+          {
+            uint32_t handle = 0;
+            uint32_t fbId = 0;
+            void *map = nullptr;
+            size_t size = 0;
+            uint32_t pitch = 0;        // Stride (64-byte aligned)
+            uint32_t chromaOffset = 0; // UV plane offset for NV12, 0 otherwise
+            int primeFd = -1;          // Exported for the RGA, -1 until needed
+          };
+
+          /**
+           * @brief Number of software fallback buffers (front + back).
+           */
+          static constexpr size_t cSoftwareBufferCount = 2;
+
+          /**
+           * @brief Upper bound for the configured frame queue depth.
+           */
+          static constexpr size_t cMaxFrameQueueDepth = 3;
+
+          /**
+           * @brief Cores left to the io_service/USB workers and the Qt thread
+           * when sizing the software decoder's slice threads.
+           */
+          static constexpr unsigned cReservedDecodeCores = 1;
+
+          /**
+           * @brief Identity of an imported DMA-BUF layout.
+           * The dma-buf inode is unique per buffer object, so it survives FFmpeg
+           * handing us a different fd number for the same pool buffer.
+           */
+          struct FramebufferKey
+          {
+            uint64_t inode;
+            uint32_t format;
+            uint32_t width;
+            uint32_t height;
+            uint32_t pitch0;
+            uint32_t offset1;
+
+            bool operator<(const FramebufferKey &other) const
+            {
+              return std::tie(inode, format, width, height, pitch0, offset1) <
+                     std::tie(other.inode, other.format, other.width, other.height,
+                              other.pitch0, other.offset1);
+            }
+          };
+
+          /**
+           * @brief A persistent framebuffer and the GEM handles it was built from.
+           */
+          struct CachedFramebuffer
+          {
+            uint32_t fbId;
+            std::vector<uint32_t> handles;
+            int64_t bytes; // Imported DMA-BUF size, for CmaBudget
+          };
+
+          /**
+           * @brief Upper bound on cached framebuffers. rkvdec cycles through a small
+           * fixed pool, so hitting this means the pool was reallocated.
+           */
+          static constexpr size_t cMaxCachedFramebuffers = 16;
+
+          /**
+           * @brief Plane SRC (16.16 fixed point) and CRTC rectangles for one
+           * frame size, derived from the session's ProjectionGeometry.
+           */
+          struct PlaneRects
+          {
+            uint32_t frameWidth = 0; // Frame size these were built for
+            uint32_t frameHeight = 0;
+            uint64_t srcX = 0;
+            uint64_t srcY = 0;
+            uint64_t srcW = 0;
+            uint64_t srcH = 0;
+            int32_t crtcX = 0;
+            int32_t crtcY = 0;
+            uint32_t crtcW = 0;
+            uint32_t crtcH = 0;
+          };
+
+          /**
+           * @brief Minimum interval between keyframe requests to the phone.
+           */
+          static constexpr int64_t cKeyframeRequestIntervalUs = 500000;
+
+          /**
+           * @brief Per-frame failures are summarised at most this often, with
+           * how many happened since the last line.
+           */
+          static constexpr int64_t cErrorLogIntervalMs = 1000;
+
+          /**
+           * @brief Longest the presentation thread sleeps while the hardware
+           * cursor is enabled, so pointer moves land within about one vblank
+           * even when no video frame arrives.
+           */
+          static constexpr std::chrono::milliseconds cCursorPollInterval{16};
+
+          /**
+           * @brief Decode thread body - pops queued packets and decodes them until stopped.
+           */
+          void decodeLoop();
+
+          /**
+           * @brief Decodes one queued H.264 buffer and queues the result for display.
+           * Complete access units bypass the parser; fragments go through it.
+           * Runs on the decode thread only.
+           * @param packet The queued buffer to decode.
+           */
+          void decodePacket(const PendingPacket &packet);
+
+          /**
+           * @brief Sends packet_ to the decoder and queues every frame it returns.
+           */
+          void sendPacketToDecoder();
+
+          /**
+           * @brief Takes one DecoderWatchdog step on a libavcodec decoder that
+           * stopped returning frames, then asks the phone for an IDR. Runs on
+           * the decode thread; the DRM display is left alone.
+           */
+          void recoverDecoder(DecoderRecovery step);
+
+          /**
+           * @brief Drops non-IDR packets from now on and asks the phone for an
+           * IDR, bypassing the request rate limit.
+           */
+          void requestKeyframeNow();
+
+          /**
+           * @brief Decodes a complete access unit with requestDecoder_.
+           * @return false if the stream is not supported there; requestDecoder_
+           * is gone and the caller decodes the packet with libavcodec.
+           */
+          bool decodeNative(const PendingPacket &packet);
+
+          /**
+           * @brief Wraps a V4l2RequestDecoder picture in a DRM PRIME frame_ and
+           * queues it like a hwaccel frame.
+           */
+          void queueNativePicture(const V4l2RequestDecoder::Picture &picture, const VideoFrameTiming &timing);
+
+          /**
+           * @brief Finds the telemetry of the packet a decoded frame came from.
+           * Drops that entry and every older one from inFlightPackets_.
+           * @param pts Presentation timestamp of the decoded frame.
+           * @return Timing with arrivalUs/sendUs filled in (zero if unknown).
+           */
+          VideoFrameTiming takeInFlightTiming(int64_t pts);
+
+          /**
+           * @brief Stops the decode thread and discards any queued packets.
+           * Must be called without holding mutex_.
+           */
+          void stopDecodeThread();
+
+          /**
+           * @brief Hands a decoded frame to the presentation thread.
+           * Takes a free slot of the frame ring. When frameQueueDepth_ frames are
+           * already waiting, the oldest one is dropped so latency stays bounded.
+           * @param frame The decoded frame; a new reference is taken.
+           * @param timing Pipeline timestamps collected so far.
+           */
+          void queueFrameForPresentation(AVFrame *frame, VideoFrameTiming timing);
+
+          /**
+           * @brief Returns the index of the oldest Queued slot, or -1 if none.
+           * Caller must hold presentMutex_.
+           */
+          int oldestQueuedSlot() const;
+
+          /**
+           * @brief Drops the frame reference held by a slot and marks it Released.
+           * Caller must hold presentMutex_.
+           * @param index Slot index, ignored if negative.
+           */
+          void releaseFrameSlot(int index);
+
+          /**
+           * @brief Releases every slot of the frame ring.
+           */
+          void releaseAllFrameSlots();
+
+          /**
+           * @brief FrameGrabber source: a reference to the scanout slot's frame,
+           * taken under presentMutex_. Software and compositor frames are not
+           * in the ring as DMA-BUFs and are not offered.
+           */
+          bool grabDisplayedFrame(GrabbedFrame &grabbed);
+
+          /**
+           * @brief Presentation thread body - shows the newest frame once per vblank.
+           */
+          void presentLoop();
+
+          /**
+           * @brief Stops the presentation thread and drops the pending frame.
+           * Must be called after stopDecodeThread().
+           */
+          void stopPresentThread();
+
+          /**
+           * @brief Rebuilds planeRects_ for a new frame size (margins cropped,
+           * letterboxed to the KMS mode, turned to the display orientation).
+           */
+          void updatePlaneRects(uint32_t frameWidth, uint32_t frameHeight);
+
+          /**
+           * @brief Picks how the session's DisplayOrientation reaches the
+           * panel: the video plane's rotation property if it can express it,
+           * otherwise one RGA blit per frame.
+           */
+          void setupOrientation(const DisplayOrientation &orientation);
+
+          /**
+           * @brief Opens rga_ on first use.
+           * @return false if the kernel has no RGA.
+           */
+          bool openRga();
+
+          /**
+           * @brief True while frames go through the RGA before the plane: for
+           * the orientation, a scaling ratio or a layout the plane rejects.
+           */
+          bool needsRga() const;
+
+          /**
+           * @brief Blits a frame as rgaOperation_ describes when needsRga().
+           * @return The framebuffer to scan out: @p fbId as is when no blit is
+           * needed, the RGA's result, or 0 if the blit failed.
+           */
+          uint32_t blitFramebuffer(uint32_t fbId, const RgaTransform::Source &source);
+
+          /**
+           * @brief Hands scaling to the RGA after the plane refused a scaled
+           * commit with @p ret.
+           * @return true if the frame should be dropped and the next one blitted
+           * at the CRTC size.
+           */
+          bool scaleWithRga(int ret);
+
+          /**
+           * @brief Points the video plane at a framebuffer, scaled to the display.
+           * Uses a non-blocking atomic commit with a page-flip event when available,
+           * otherwise the legacy drmModeSetPlane call.
+           * @param fbId Framebuffer to scan out.
+           * @param srcWidth Source width in pixels.
+           * @param srcHeight Source height in pixels.
+           * @return 0 on success, negative errno on failure.
+           */
+          int commitPlane(uint32_t fbId, uint32_t srcWidth, uint32_t srcHeight);
+
+          /**
+           * @brief Returns a framebuffer for a DRM Prime frame, importing it on first use.
+           * @param frame Decoded DRM Prime frame.
+           * @return The framebuffer ID, or 0 if the import failed.
+           */
+          uint32_t getFramebuffer(AVFrame *frame);
+
+          /**
+           * @brief Removes a cached framebuffer and closes its GEM handles.
+           * @param entry Cache entry to release.
+           */
+          void releaseCachedFramebuffer(const CachedFramebuffer &entry);
+
+          /**
+           * @brief Drops every cached framebuffer (resolution change or shutdown).
+           */
+          void clearFramebufferCache();
+
+          /**
+           * @brief libdrm page-flip callback, clears the pending flip.
+           */
+          static void onPageFlip(int fd, unsigned int sequence, unsigned int tvSec,
+                                 unsigned int tvUsec, void *userData);
+
           /**
            * @brief Initializes the FFmpeg decoder with DRM hwaccel.
+           * @param allowNative Also open requestDecoder_ if requested; false
+           * when reopening mid-stream.
            * @return true if decoder initialized successfully.
            */
-          bool initDecoder();
+          bool initDecoder(bool allowNative = true);
+
+          /**
+           * @brief Opens requestDecoder_ if requested and the session can use it.
+           */
+          void initNativeDecoder(bool hardwareFits);
+
+          /**
+           * @brief Number of slice threads for software decoding.
+           * @return Online cores minus cReservedDecodeCores, at least 1.
+           */
+          static int softwareDecodeThreadCount();
+
+          /**
+           * @brief Invokes the frame consumed handler for each released frame.
+           * Must be called without holding queueMutex_.
+           * @param count Number of frames that left the decode queue.
+           */
+          void notifyFramesConsumed(size_t count);
 
           /**
            * @brief Initializes the DRM display for direct output.
@@ -188,9 +721,45 @@ namespace f1x
 
           /**
            * @brief Cleans up FFmpeg resources.
+           * The hw device context is kept; see cleanupHwDevice().
            */
           void cleanupDecoder();
 
+          /**
+           * @brief Frees the codec context, parser, packet and frame only.
+           * Frames in the ring keep their buffers and stay on screen.
+           */
+          void releaseCodec();
+
+          /**
+           * @brief Releases the DRM hw device context.
+           */
+          void cleanupHwDevice();
+
+          /**
+           * @brief Checks whether the open decoder was built for the current
+           * configuration.
+           * @return true if codec, resolution and frame queue depth are unchanged.
+           */
+          bool decoderMatchesConfiguration() const;
+
+          /**
+           * @brief Frame queue depth from the configuration, clamped to
+           * 1..cMaxFrameQueueDepth.
+           */
+          size_t configuredFrameQueueDepth() const;
+
+          /**
+           * @brief Checks whether frames have somewhere to go: the KMS plane,
+           * the Qt scene graph in compositor mode, or nowhere when headless.
+           */
+          bool displayReady() const;
+
+          /**
+           * @brief Turns off the video plane so Qt's UI shows through.
+           */
+          void disablePlane();
+
           /**
            * @brief Cleans up DRM resources.
            */
@@ -208,6 +777,42 @@ namespace f1x
            */
           void setupAtomicProperties();
 
+          /**
+           * @brief Moves the video plane below Qt's primary plane through their
+           * zpos properties and turns on premultiplied per-pixel alpha on the
+           * primary. Leaves the stacking alone if the primary's framebuffer
+           * has no alpha, as it would then hide the video.
+           * @return true if the UI now sits above the video.
+           */
+          bool setupPlaneStacking();
+
+          /**
+           * @brief Puts back the zpos values setupPlaneStacking() changed.
+           */
+          void restorePlaneStacking();
+
+          /**
+           * @brief Session start: configures the pacer for the stream's frame
+           * rate on the CRTC's refresh. A refresh that cannot carry it at a
+           * steady cadence is switched to a same-size connector mode that
+           * can, when there is one and atomic modesetting is available.
+           */
+          void setupPresentationCadence();
+
+          /**
+           * @brief Atomic modeset of our CRTC to @p mode; Qt's primary plane
+           * keeps its framebuffer, so the size must not change.
+           */
+          bool commitCrtcMode(const drmModeModeInfo &mode);
+
+          /**
+           * @brief Puts back the mode setupPresentationCadence() replaced.
+           */
+          void restoreCrtcMode();
+
+          // Stores uiAboveVideo_ and tells the stacking handler if it changed
+          static void publishStacking(bool uiAboveVideo);
+
           /**
            * @brief Gets video width based on configured resolution.
            * @return Video width in pixels.
@@ -231,26 +836,109 @@ namespace f1x
            */
           void cleanupCursor();
 
+          /**
+           * @brief Looks up the cursor plane's atomic property IDs.
+           * Cursor moves then ride along with the video plane's commit.
+           */
+          void setupCursorAtomicProperties();
+
+          /**
+           * @brief Adds the pending cursor state to an atomic request.
+           * @param req Request being built for the next vblank.
+           * @return true if cursor properties were added.
+           */
+          bool addCursorToRequest(drmModeAtomicReqPtr req);
+
+          /**
+           * @brief Applies the pending cursor state when no video frame is
+           * queued; atomic commits are paced by the flip event like video.
+           * @return false if the CRTC was busy and the update is still pending.
+           */
+          bool commitCursor();
+
+          /**
+           * @brief Applies the pending cursor state with drmModeSetPlane.
+           * Used when the atomic API is not available.
+           */
+          void commitCursorLegacy();
+
           /**
            * @brief Waits for VSync/page flip completion.
            * Ensures the previous frame is no longer in use before releasing its buffer.
+           * @param timeoutMs Maximum time to wait for the flip event.
            */
-          void waitForPageFlip();
+          void waitForPageFlip(int timeoutMs);
 
           /**
            * @brief Converts software-decoded frame to displayable format.
+           * YUV420P/NV12 frames are copied into an NV12 dumb buffer (the VOP
+           * does colour conversion and scaling); other formats use swscale.
            * @param frame Source frame (YUV420P or similar)
            * @return true if conversion and display succeeded
            */
           bool displaySoftwareFrame(AVFrame *frame);
 
+          /**
+           * @brief Allocates and maps the software fallback buffer pair.
+           * @param width Frame width in pixels.
+           * @param height Frame height in pixels.
+           * @param drmFormat DRM_FORMAT_NV12 or DRM_FORMAT_XRGB8888.
+           * @return true if both buffers were created.
+           */
+          bool createSoftwareBuffers(int width, int height, uint32_t drmFormat);
+
+          /**
+           * @brief Releases the software fallback buffer pair.
+           */
+          void destroySoftwareBuffers();
+
           // Thread synchronization
           std::mutex mutex_;
 
+          // Decode thread and the bounded packet queue feeding it
+          std::thread decodeThread_;
+          std::mutex queueMutex_;
+          std::condition_variable queueCondition_;
+          std::deque<PendingPacket> packetQueue_;
+          FrameConsumedHandler frameConsumedHandler_; // Guarded by queueMutex_
+          KeyframeRequestHandler keyframeRequestHandler_; // Guarded by queueMutex_
+          PacketDropPolicy dropPolicy_;   // Guarded by queueMutex_
+          int64_t lastKeyframeRequestUs_; // Rate limit for keyframe requests
+
+          // Presentation thread and the in-flight frame ring feeding it.
+          // The ring holds frameQueueDepth_ queued frames plus the frame on screen
+          // and the one it is replacing.
+          std::thread presentThread_;
+          std::mutex presentMutex_;
+          std::condition_variable presentCondition_;
+          std::vector<FrameSlot> frameSlots_;
+          size_t frameQueueDepth_;     // Decoded frames allowed to wait for vblank
+          size_t requestedQueueDepth_; // Configured depth, before the CMA plan
+          uint64_t nextFrameSequence_;
+          int scanoutSlot_;            // Slot currently committed to the plane
+          int retiringSlot_;           // Slot being replaced, released after the flip
+          bool flipPending_;          // Atomic commit issued, flip event not yet seen
+          uint32_t frameRate_;        // Of the session's stream, see setFrameRate()
+          PresentationPacer pacer_;   // Presentation thread and flip handler
+          bool grabSource_;           // Installed as the FrameGrabber's source
+          uint64_t supersededFrames_; // Frames replaced before reaching a vblank
+
           // Pipeline state
           std::atomic<bool> isActive_;
-          uint64_t frameCount_;
-          uint64_t droppedFrames_; // Track frames dropped due to decoder lag
+          bool inBackground_; // setBackground(true) released the pipeline
+          std::atomic<uint64_t> frameCount_;
+          std::atomic<uint64_t> softwareFrames_; // Decoded without DRM PRIME since init()
+          uint64_t droppedFrames_; // Packets dropped by the backlog policy
+          bool parserMode_;        // Fragmented input seen, use av_parser_parse2
+
+          // Decode thread only: telemetry of the packet being decoded and of
+          // packets the decoder has not returned a frame for yet
+          int64_t currentArrivalUs_;
+          std::deque<InFlightPacket> inFlightPackets_;
+          DecoderWatchdog watchdog_;
+          bool baselineStream_;       // The last SPS was Baseline: nothing to reorder
+          int64_t firstKeyframeUs_;   // Arrival of the session's first IDR, 0 before it
+          bool firstFrameShown_;      // Its first frame was queued and measured
 
           // FFmpeg decoder state
           const AVCodec *codec_;
@@ -259,19 +947,27 @@ namespace f1x
           AVPacket *packet_;
           AVFrame *frame_;
           AVBufferRef *hwDeviceCtx_;
+          // Native stateless decoder, see setNativeDecoder(); libavcodec above
+          // stays open as its fallback and is fed the stored parameter sets
+          // when it takes over
+          bool nativeRequested_;
+          std::string connectorName_; // Empty for the first connected one
+          VpuStream vpuStream_;
+          std::unique_ptr<V4l2RequestDecoder> requestDecoder_;
+          std::atomic<bool> nativeDecoding_; // A native picture was shown since init()
+          BufferRefPtr parameterSets_;       // Last SPS/PPS-only packet
+          int parameterSetsSize_;
+          int decoderWidth_;  // Resolution the open decoder was configured for
+          int decoderHeight_;
 
-          // Buffer pooling: Keep reference to displayed frames until DRM is done
-          // This prevents freeing DRM Prime buffers while still in use by display
-          AVFrame *displayedFrame_;         // Currently being displayed
-          AVFrame *previousDisplayedFrame_; // Previous frame (being released)
-
-          // Software fallback state
-          struct SwsContext *swsCtx_; // For YUV->RGB conversion if needed
-          uint32_t swDumbHandle_;     // Dumb buffer handle for SW frames
-          uint32_t swDumbFbId_;       // Framebuffer ID for SW frames
-          void *swDumbMap_;           // Mapped memory for SW frames
-          size_t swDumbSize_;         // Size of mapped memory
-          uint32_t swDumbPitch_;      // Stride of dumb buffer (64-byte aligned)
+          // Software fallback state (double-buffered so we never write the
+          // buffer that is being scanned out)
+          struct SwsContext *swsCtx_;                  // Only for non-4:2:0 formats
+          DumbBuffer swBuffers_[cSoftwareBufferCount]; // Dumb buffers for SW frames
+          size_t swBufferIndex_;                       // Next buffer to write
+          uint32_t swFormat_;                          // DRM fourcc of swBuffers_
+          int swWidth_;
+          int swHeight_;
 
           // DRM display state
           int drmFd_;
@@ -279,15 +975,27 @@ namespace f1x
           uint32_t connectorId_;
           uint32_t crtcId_;
           uint32_t planeId_;
+          uint32_t primaryPlaneId_; // Qt eglfs scans out on it
           drmModeModeInfo mode_;
+          std::vector<drmModeModeInfo> connectorModes_; // Every mode the connector offers
+          drmModeModeInfo replacedMode_; // CRTC mode before a cadence modeset
+          bool modeReplaced_;
           bool drmInitialized_;
           bool usingHwAccel_; // Track if HW accel is working
+          AVCodecID codecId_; // Codec of the current session, see setCodec()
+          // Frames go to DmaBufVideoItem through DmaBufFrameExchange instead of
+          // the overlay plane; needs DRM PRIME frames from the hw decoder
+          bool compositorImport_;
+          BenchmarkOptions benchmark_;
 
-          // Frame buffer tracking for page flipping
+          // Frame buffer tracking for page flipping (owned by fbCache_)
           uint32_t currentFbId_;
           uint32_t previousFbId_;
-          uint32_t currentHandle_;  // GEM handle for cleanup
-          uint32_t previousHandle_; // Previous GEM handle
+
+          // DMA-BUF -> framebuffer cache, avoids per-frame AddFB2/RmFB/GEM_CLOSE
+          std::map<FramebufferKey, CachedFramebuffer> fbCache_;
+          uint32_t fbCacheWidth_;  // Frame size the cache was built for
+          uint32_t fbCacheHeight_;
 
           // Atomic DRM API property IDs (for overlay plane without DRM master)
           uint32_t planePropFbId_;
@@ -302,6 +1010,68 @@ namespace f1x
           uint32_t planePropSrcH_;
           bool atomicSupported_; // True if atomic API is available
 
+          // The video plane's rotation property, 0 if it has none, and the
+          // DRM_MODE_ROTATE_* / DRM_MODE_REFLECT_* bits it accepts
+          uint32_t planePropRotation_;
+          uint64_t planeRotations_;
+
+          // How the display orientation is applied to every frame
+          enum class OrientationPath
+          {
+            None,  // Upright panel
+            Plane, // planeRotation_ in every commit
+            Rga,   // rga_ blits each frame first
+            Unsupported
+          };
+          OrientationPath orientationPath_;
+          DisplayOrientation orientation_; // What orientationPath_ was picked for
+          uint64_t planeRotation_;
+          bool planeRotationRejected_;  // The driver refused planeRotation_ in a commit
+          bool legacyRotationSet_;      // planeRotation_ set for drmModeSetPlane
+          std::unique_ptr<RgaTransform> rga_;
+          RgaTransform::Operation rgaOperation_; // Built by updatePlaneRects()
+          bool rgaScaling_;    // The plane refused the scaling for this geometry
+          bool rgaConversion_; // The plane cannot import frames of this size
+          bool rgaProbed_;
+
+          // A plane's zpos property as found by setupPlaneStacking(); propId
+          // is 0 if the plane has none. value is restored by cleanupDrm()
+          struct PlaneZpos
+          {
+            uint32_t propId = 0;
+            uint64_t value = 0;
+            uint64_t min = 0;
+            uint64_t max = 0;
+            bool immutable = true;
+            bool changed = false;
+          };
+          PlaneZpos videoZpos_;
+          PlaneZpos primaryZpos_;
+
+          // Atomic property IDs of the cursor plane; cursorAtomic_ is false if
+          // any is missing and cursor moves use legacy SetPlane
+          struct CursorPlaneProperties
+          {
+            uint32_t fbId = 0;
+            uint32_t crtcId = 0;
+            uint32_t crtcX = 0;
+            uint32_t crtcY = 0;
+            uint32_t crtcW = 0;
+            uint32_t crtcH = 0;
+            uint32_t srcX = 0;
+            uint32_t srcY = 0;
+            uint32_t srcW = 0;
+            uint32_t srcH = 0;
+          };
+          CursorPlaneProperties cursorProps_;
+          bool cursorAtomic_;
+          bool cursorOnlyFlip_; // The pending flip carries no video frame
+
+          // Session geometry and the plane rectangles cached from it; rebuilt
+          // only when the geometry or the decoded frame size changes
+          ProjectionGeometry geometry_;
+          PlaneRects planeRects_;
+
           // DRM cursor state (static for access from InputDevice)
           // Uses dedicated cursor plane (plane 41 on RK3229, zpos 2)
           static int *cursorDrmFdPtr_; // Pointer to shared drmFd_ (set during init)
@@ -309,15 +1079,22 @@ namespace f1x
           static uint32_t cursorPlaneId_; // Cursor plane ID (41 on RK3229)
           static uint32_t cursorBufferHandle_;
           static uint32_t cursorFbId_;
-          static int cursorX_;      // Current cursor X position
-          static int cursorY_;      // Current cursor Y position
           static int cursorWidth_;  // Cursor buffer width (64)
           static int cursorHeight_; // Cursor buffer height (64)
           static bool cursorInitialized_;
-          static bool cursorVisible_;
-          static bool cursorEnabled_; // Set from configuration - controls if DRM cursor
-                                      // is active
-          static std::mutex cursorMutex_;
+          static bool cursorVisible_; // Plane state, presentation thread only
+          static std::atomic<bool> cursorEnabled_; // Set from configuration - controls
+                                                   // if DRM cursor is active
+          // Latest requested state, written lock-free from the input thread:
+          // x in the high and y in the low 32 bits, plus show/hide
+          static std::atomic<uint64_t> cursorTarget_;
+          static std::atomic<bool> cursorShown_;
+          static std::atomic<bool> cursorDirty_; // Target changed since last commit
+          static std::atomic<bool> planeLent_; // The rear camera owns the video plane
+          static std::atomic<bool> uiAboveVideo_;
+          static std::function<void(bool)> stackingHandler_;
+          static std::mutex stackingMutex_; // Guards stackingHandler_
+          static std::mutex cursorMutex_; // Guards cursor init/cleanup only
         };
 
       } // namespace projection
@@ -0,0 +1,140 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief The NV12 buffer on screen, as a video output hands it over.
+         */
+        struct GrabbedFrame
+        {
+          int fd = -1;           // DMA-BUF holding both planes
+          bool linear = false;   // Tiled layouts cannot be read row by row
+          uint32_t width = 0;
+          uint32_t height = 0;
+          uint32_t lumaOffset = 0;
+          uint32_t lumaPitch = 0;
+          uint32_t chromaOffset = 0;
+          uint32_t chromaPitch = 0;
+          bool fullRange = false;
+          // Keeps the buffer out of the decoder's pool until the grab is done
+          std::shared_ptr<void> hold;
+        };
+
+        /**
+         * @brief Snapshots of what is scanned out, for remote diagnostics and
+         * automated visual checks.
+         *
+         * A grab asks the registered source for a reference to the frame on
+         * screen, which costs the display path one ref-count bump under its
+         * lock. Everything else runs on the grabber's own thread at
+         * background priority: mapping the DMA-BUF, syncing it for CPU reads,
+         * scaling it down and encoding it as JPEG. This reads the decoder's
+         * output, so an RGA rotation or the plane's colour conversion is not
+         * in the picture; setupColorEncoding()'s BT.709 is applied instead.
+         */
+        class FrameGrabber
+        {
+        public:
+          struct Snapshot
+          {
+            std::vector<uint8_t> jpeg; // Empty if nothing could be grabbed
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint32_t sourceWidth = 0;
+            uint32_t sourceHeight = 0;
+            std::string error;
+          };
+          // Called on the grabber's thread
+          typedef std::function<void(const Snapshot &snapshot)> Handler;
+          // Fills in the frame on screen; false if there is none
+          typedef std::function<bool(GrabbedFrame &frame)> Source;
+
+          static constexpr uint32_t cDefaultWidth = 480;
+          static constexpr int cJpegQuality = 85;
+
+          static FrameGrabber &instance();
+
+          /**
+           * @brief Installs the display path's source, or removes it with an
+           * empty one. Removing waits for a running source call to return.
+           */
+          void setSource(Source source);
+
+          /**
+           * @brief Queues a snapshot at most @p maxWidth wide.
+           * @return false if cMaxPending grabs are already waiting; the
+           * handler is not called then.
+           */
+          bool grab(Handler handler, uint32_t maxWidth = cDefaultWidth);
+
+          /**
+           * @brief Grabs into @p path, replacing it only once the JPEG is
+           * complete.
+           */
+          bool grabToFile(const std::string &path, uint32_t maxWidth = cDefaultWidth);
+
+          FrameGrabber(const FrameGrabber &) = delete;
+          FrameGrabber &operator=(const FrameGrabber &) = delete;
+
+        private:
+          static constexpr size_t cMaxPending = 4;
+
+          struct Request
+          {
+            Handler handler;
+            uint32_t maxWidth;
+          };
+
+          FrameGrabber() = default;
+
+          void run();
+          Snapshot capture(uint32_t maxWidth);
+
+          std::mutex sourceMutex_;
+          Source source_;
+
+          std::mutex mutex_;
+          std::condition_variable wake_;
+          std::deque<Request> requests_;
+          std::thread thread_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
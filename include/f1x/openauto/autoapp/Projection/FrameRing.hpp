@@ -0,0 +1,321 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <f1x/openauto/autoapp/Projection/LockFreeRingBuffer.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace projection
+            {
+
+                namespace detail
+                {
+                    /**
+                     * @brief Inline frame memory of a compile-time capacity
+                     */
+                    template <typename T, size_t Channels, size_t Capacity>
+                    class FrameStorage
+                    {
+                    public:
+                        T *frame(size_t index) { return buffer_ + index * Channels; }
+                        const T *frame(size_t index) const { return buffer_ + index * Channels; }
+                        static constexpr size_t frames() { return Capacity; }
+                        static constexpr size_t mask() { return Capacity - 1; }
+
+                    private:
+                        alignas(64) T buffer_[Capacity * Channels];
+                    };
+
+                    /**
+                     * @brief Heap frame memory sized at construction
+                     */
+                    template <typename T, size_t Channels>
+                    class FrameStorage<T, Channels, cRuntimeCapacity>
+                    {
+                    public:
+                        explicit FrameStorage(size_t minimumFrames)
+                            : frames_(roundUp(minimumFrames)), buffer_(new T[frames_ * Channels])
+                        {
+                        }
+
+                        T *frame(size_t index) { return buffer_.get() + index * Channels; }
+                        const T *frame(size_t index) const { return buffer_.get() + index * Channels; }
+                        size_t frames() const { return frames_; }
+                        size_t mask() const { return frames_ - 1; }
+
+                    private:
+                        static size_t roundUp(size_t minimumFrames)
+                        {
+                            size_t frames = 2;
+                            while (frames < minimumFrames)
+                                frames <<= 1;
+                            return frames;
+                        }
+
+                        const size_t frames_;
+                        // Default-initialized: pages are only faulted in once written
+                        std::unique_ptr<T[]> buffer_;
+                    };
+                }
+
+                /**
+                 * @brief Lock-free SPSC ring of whole audio frames
+                 *
+                 * A frame is Channels samples of T, and every size and index here
+                 * counts frames, so neither side can ever see part of one: a full
+                 * ring takes no more, and a reader asking for nBufferFrames gets
+                 * that many or fewer, never a torn sample pair. The indices run
+                 * freely and are masked only to address memory, which leaves no
+                 * slot empty, and with a compile-time capacity the mask and every
+                 * frame offset are constants. Each side caches the other's index
+                 * on its own cache line like LockFreeRingBuffer does.
+                 *
+                 * @tparam Capacity Frames; a power of 2, or cRuntimeCapacity to pass
+                 * the capacity to the constructor
+                 */
+                template <typename T, size_t Channels, size_t Capacity = cRuntimeCapacity>
+                class FrameRing
+                {
+                    static_assert(std::is_trivially_copyable<T>::value, "Samples are moved with memcpy");
+                    static_assert(Channels > 0, "A frame holds at least one sample");
+                    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be power of 2");
+
+                public:
+                    static constexpr size_t cChannels = Channels;
+                    static constexpr size_t cFrameBytes = sizeof(T) * Channels;
+
+                    /**
+                     * @brief Readable frames returned by peekContiguous()
+                     */
+                    struct ReadSpan
+                    {
+                        const T *data;
+                        size_t frames;
+                    };
+
+                    /**
+                     * @brief Writable frames returned by reserveWrite()
+                     */
+                    struct WriteSpan
+                    {
+                        T *data;
+                        size_t frames;
+                    };
+
+                    template <size_t C = Capacity, typename = std::enable_if_t<C != cRuntimeCapacity>>
+                    FrameRing() : head_(0), cachedTail_(0), tail_(0), cachedHead_(0)
+                    {
+                    }
+
+                    /**
+                     * @param minimumFrames Frames that must fit at once; rounded up
+                     * to a power of 2
+                     */
+                    template <size_t C = Capacity, typename = std::enable_if_t<C == cRuntimeCapacity>>
+                    explicit FrameRing(size_t minimumFrames)
+                        : head_(0), cachedTail_(0), tail_(0), cachedHead_(0), storage_(minimumFrames)
+                    {
+                    }
+
+                    /**
+                     * @brief Queues up to @p frames interleaved frames (producer side)
+                     * @return Frames written; fewer if the ring is full
+                     */
+                    size_t write(const T *samples, size_t frames)
+                    {
+                        if (!samples || frames == 0)
+                            return 0;
+
+                        const size_t head = head_.load(std::memory_order_relaxed);
+                        const size_t toWrite = std::min(frames, writableFrom(head, frames));
+                        if (toWrite == 0)
+                            return 0;
+
+                        const size_t headIdx = head & storage_.mask();
+                        const size_t firstPart = std::min(toWrite, storage_.frames() - headIdx);
+                        std::memcpy(storage_.frame(headIdx), samples, firstPart * cFrameBytes);
+                        if (toWrite > firstPart)
+                            std::memcpy(storage_.frame(0), samples + firstPart * Channels, (toWrite - firstPart) * cFrameBytes);
+
+                        head_.store(head + toWrite, std::memory_order_release);
+                        return toWrite;
+                    }
+
+                    /**
+                     * @brief Takes up to @p frames frames into @p samples (consumer side)
+                     * @return Frames read
+                     */
+                    size_t read(T *samples, size_t frames)
+                    {
+                        if (!samples || frames == 0)
+                            return 0;
+
+                        const size_t tail = tail_.load(std::memory_order_relaxed);
+                        const size_t toRead = std::min(frames, readableFrom(tail, frames));
+                        if (toRead == 0)
+                            return 0;
+
+                        const size_t tailIdx = tail & storage_.mask();
+                        const size_t firstPart = std::min(toRead, storage_.frames() - tailIdx);
+                        std::memcpy(samples, storage_.frame(tailIdx), firstPart * cFrameBytes);
+                        if (toRead > firstPart)
+                            std::memcpy(samples + firstPart * Channels, storage_.frame(0), (toRead - firstPart) * cFrameBytes);
+
+                        tail_.store(tail + toRead, std::memory_order_release);
+                        return toRead;
+                    }
+
+                    /**
+                     * @brief Largest run of queued frames that is contiguous in ring
+                     * memory (consumer side); release it with commitRead()
+                     */
+                    ReadSpan peekContiguous()
+                    {
+                        const size_t tail = tail_.load(std::memory_order_relaxed);
+                        const size_t tailIdx = tail & storage_.mask();
+                        const size_t toEnd = storage_.frames() - tailIdx;
+                        return {storage_.frame(tailIdx), std::min(readableFrom(tail, toEnd), toEnd)};
+                    }
+
+                    /**
+                     * @brief Releases @p frames frames; from peekContiguous() or at
+                     * most available()
+                     */
+                    void commitRead(size_t frames)
+                    {
+                        tail_.store(tail_.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+                    }
+
+                    /**
+                     * @brief Largest contiguous run of free frames (producer side);
+                     * fill it and publish with commitWrite()
+                     */
+                    WriteSpan reserveWrite()
+                    {
+                        const size_t head = head_.load(std::memory_order_relaxed);
+                        const size_t headIdx = head & storage_.mask();
+                        const size_t toEnd = storage_.frames() - headIdx;
+                        return {storage_.frame(headIdx), std::min(writableFrom(head, toEnd), toEnd)};
+                    }
+
+                    /**
+                     * @brief Publishes @p frames frames written into the last reserveWrite() span
+                     */
+                    void commitWrite(size_t frames)
+                    {
+                        head_.store(head_.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+                    }
+
+                    /**
+                     * @brief Frames available to read
+                     */
+                    size_t available() const
+                    {
+                        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed);
+                    }
+
+                    /**
+                     * @brief Frames available for writing
+                     */
+                    size_t space() const
+                    {
+                        return storage_.frames() -
+                               (head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire));
+                    }
+
+                    /**
+                     * @brief Drops everything queued
+                     * @note Only safe to call when no reads/writes are in progress
+                     */
+                    void clear()
+                    {
+                        head_.store(0, std::memory_order_relaxed);
+                        tail_.store(0, std::memory_order_relaxed);
+                        cachedTail_ = 0;
+                        cachedHead_ = 0;
+                    }
+
+                    /**
+                     * @brief Frames the ring holds when full
+                     */
+                    size_t capacity() const { return storage_.frames(); }
+
+                    /**
+                     * @brief Bytes of ring memory, for memory accounting
+                     */
+                    size_t memoryBytes() const { return storage_.frames() * cFrameBytes; }
+
+                private:
+                    // Free-running indices: head - tail is the fill level even
+                    // across size_t wrap, as the capacity divides 2^N
+                    size_t writableFrom(size_t head, size_t wanted)
+                    {
+                        size_t available = storage_.frames() - (head - cachedTail_);
+                        if (available < wanted)
+                        {
+                            cachedTail_ = tail_.load(std::memory_order_acquire);
+                            available = storage_.frames() - (head - cachedTail_);
+                        }
+                        return available;
+                    }
+
+                    size_t readableFrom(size_t tail, size_t wanted)
+                    {
+                        size_t available = cachedHead_ - tail;
+                        if (available < wanted)
+                        {
+                            cachedHead_ = head_.load(std::memory_order_acquire);
+                            available = cachedHead_ - tail;
+                        }
+                        return available;
+                    }
+
+                    // Producer line
+                    alignas(64) std::atomic<size_t> head_;
+                    size_t cachedTail_;
+                    // Consumer line
+                    alignas(64) std::atomic<size_t> tail_;
+                    size_t cachedHead_;
+                    // Read-only after construction, shared by both sides
+                    alignas(64) detail::FrameStorage<T, Channels, Capacity> storage_;
+                };
+
+                /**
+                 * @brief 16-bit PCM frame rings, sized from the stream at construction
+                 */
+                typedef FrameRing<int16_t, 1> MonoFrameRing;
+                typedef FrameRing<int16_t, 2> StereoFrameRing;
+
+            } // namespace projection
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,101 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef USE_GSTREAMER
+#pragma once
+
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <f1x/openauto/autoapp/Projection/VideoOutput.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace projection
+{
+
+// Pushes the H.264 stream into appsrc ! h264parse ! decoder ! queue ! sink.
+// Nothing in the pipeline waits on a clock: the queue only ever holds the
+// latency target and drops the oldest frames past it.
+class GstVideoOutput: public VideoOutput
+{
+public:
+    // Decoder probing: fakesink instead of the display
+    struct BenchmarkOptions
+    {
+        bool headless = false;
+    };
+
+    GstVideoOutput(configuration::IConfiguration::Pointer configuration);
+    ~GstVideoOutput() override;
+
+    bool open() override;
+    bool init() override;
+    void write(uint64_t timestamp, const aasdk::common::DataConstBuffer& buffer) override;
+    void stop() override;
+
+    // Call before open()
+    void setBenchmarkOptions(const BenchmarkOptions& options);
+    // Whether the pipeline decodes with a V4L2 hardware decoder
+    bool isHardwareDecoding() const;
+
+private:
+    typedef std::vector<uint8_t> Chunk;
+
+    struct ChunkRelease
+    {
+        GstVideoOutput* owner;
+        Chunk* chunk;
+    };
+
+    GstElement* makeElement(const char* factory, const char* name) const;
+    GstElement* makeDecoder();
+    GstElement* makeSink() const;
+    void destroyPipeline();
+
+    Chunk* acquireChunk(size_t size);
+    void releaseChunk(Chunk* chunk);
+    static void onChunkReleased(gpointer data);
+    static GstBusSyncReply onBusMessage(GstBus* bus, GstMessage* message, gpointer data);
+    static GstPadProbeReturn onFrameDecoded(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+
+    static constexpr guint64 cLatencyTargetMs = 50;
+    static constexpr size_t cChunkPoolSize = 8;
+
+    std::mutex mutex_;
+    GstElement* pipeline_;
+    GstAppSrc* appsrc_;
+    BenchmarkOptions benchmark_;
+    std::atomic<bool> hardwareDecoding_;
+    std::mutex chunksMutex_;
+    std::vector<Chunk*> freeChunks_;
+};
+
+}
+}
+}
+}
+
+#endif
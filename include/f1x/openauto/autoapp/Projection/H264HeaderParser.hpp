@@ -0,0 +1,273 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief One NAL unit of an Annex B buffer, start code stripped.
+         */
+        struct H264NalUnit
+        {
+          const uint8_t *data = nullptr; // Starts at the NAL header byte
+          size_t size = 0;
+          uint8_t type = 0;
+          uint8_t refIdc = 0;
+        };
+
+        /**
+         * @brief Sequence parameter set, with the derived picture size.
+         * Scaling lists are in raster order, as V4L2 stateless decoders take them.
+         */
+        struct H264Sps
+        {
+          uint8_t profileIdc = 0;
+          uint8_t constraintSetFlags = 0; // constraint_set0_flag in bit 0
+          uint8_t levelIdc = 0;
+          uint32_t id = 0;
+          uint32_t chromaFormatIdc = 1;
+          bool separateColourPlane = false;
+          uint32_t bitDepthLumaMinus8 = 0;
+          uint32_t bitDepthChromaMinus8 = 0;
+          bool qpprimeYZeroTransformBypass = false;
+          bool scalingMatrixPresent = false;
+          uint8_t scalingList4x4[6][16] = {};
+          uint8_t scalingList8x8[6][64] = {};
+          uint32_t log2MaxFrameNumMinus4 = 0;
+          uint32_t picOrderCntType = 0;
+          uint32_t log2MaxPicOrderCntLsbMinus4 = 0;
+          bool deltaPicOrderAlwaysZero = false;
+          int32_t offsetForNonRefPic = 0;
+          int32_t offsetForTopToBottomField = 0;
+          uint32_t numRefFramesInPicOrderCntCycle = 0;
+          int32_t offsetForRefFrame[255] = {};
+          uint32_t maxNumRefFrames = 0;
+          bool gapsInFrameNumAllowed = false;
+          uint32_t picWidthInMbsMinus1 = 0;
+          uint32_t picHeightInMapUnitsMinus1 = 0;
+          bool frameMbsOnly = true;
+          bool mbAdaptiveFrameField = false;
+          bool direct8x8Inference = false;
+          // Frame cropping in luma samples
+          uint32_t cropLeft = 0;
+          uint32_t cropRight = 0;
+          uint32_t cropTop = 0;
+          uint32_t cropBottom = 0;
+          // VUI colour description; BT.601 limited range unless signalled
+          bool fullRange = false;
+          uint32_t matrixCoefficients = 2;
+
+          uint32_t codedWidth() const;
+          uint32_t codedHeight() const;
+          uint32_t width() const;
+          uint32_t height() const;
+          uint32_t maxFrameNum() const;
+        };
+
+        /**
+         * @brief Picture parameter set. The scaling lists have the fall-back
+         * rules already applied against the SPS it refers to.
+         */
+        struct H264Pps
+        {
+          uint32_t id = 0;
+          uint32_t spsId = 0;
+          bool entropyCodingMode = false;
+          bool bottomFieldPicOrderInFramePresent = false;
+          uint32_t numSliceGroupsMinus1 = 0;
+          uint32_t sliceGroupMapType = 0;
+          uint32_t sliceGroupChangeRateMinus1 = 0;
+          uint32_t numRefIdxL0DefaultActiveMinus1 = 0;
+          uint32_t numRefIdxL1DefaultActiveMinus1 = 0;
+          bool weightedPred = false;
+          uint32_t weightedBipredIdc = 0;
+          int32_t picInitQpMinus26 = 0;
+          int32_t picInitQsMinus26 = 0;
+          int32_t chromaQpIndexOffset = 0;
+          bool deblockingFilterControlPresent = false;
+          bool constrainedIntraPred = false;
+          bool redundantPicCntPresent = false;
+          bool transform8x8Mode = false;
+          bool scalingMatrixPresent = false; // Non-flat lists apply (SPS or PPS)
+          int32_t secondChromaQpIndexOffset = 0;
+          uint8_t scalingList4x4[6][16] = {};
+          uint8_t scalingList8x8[6][64] = {};
+        };
+
+        /**
+         * @brief memory_management_control_operation of dec_ref_pic_marking().
+         */
+        struct H264MemoryManagementOp
+        {
+          uint32_t operation = 0;
+          uint32_t differenceOfPicNumsMinus1 = 0;
+          uint32_t longTermPicNum = 0;
+          uint32_t longTermFrameIdx = 0;
+          uint32_t maxLongTermFrameIdxPlus1 = 0;
+        };
+
+        /**
+         * @brief Slice header up to slice_data(), plus the bit sizes stateless
+         * decoders need to skip the parts they parse themselves.
+         */
+        struct H264SliceHeader
+        {
+          static constexpr uint32_t cSliceP = 0;
+          static constexpr uint32_t cSliceB = 1;
+          static constexpr uint32_t cSliceI = 2;
+          static constexpr uint32_t cSliceSp = 3;
+          static constexpr uint32_t cSliceSi = 4;
+
+          uint8_t nalUnitType = 0;
+          uint8_t nalRefIdc = 0;
+          uint32_t firstMbInSlice = 0;
+          uint32_t sliceType = 0; // 0..4, the "all slices" offset removed
+          uint32_t ppsId = 0;
+          uint32_t colourPlaneId = 0;
+          uint32_t frameNum = 0;
+          bool fieldPic = false;
+          bool bottomField = false;
+          uint32_t idrPicId = 0;
+          uint32_t picOrderCntLsb = 0;
+          int32_t deltaPicOrderCntBottom = 0;
+          int32_t deltaPicOrderCnt[2] = {0, 0};
+          uint32_t redundantPicCnt = 0;
+          bool directSpatialMvPred = false;
+          uint32_t numRefIdxL0ActiveMinus1 = 0;
+          uint32_t numRefIdxL1ActiveMinus1 = 0;
+          bool noOutputOfPriorPics = false;
+          bool longTermReference = false;
+          bool adaptiveRefPicMarking = false;
+          std::vector<H264MemoryManagementOp> memoryManagementOps;
+          uint32_t cabacInitIdc = 0;
+          int32_t sliceQpDelta = 0;
+          int32_t sliceQsDelta = 0;
+          uint32_t disableDeblockingFilterIdc = 0;
+          int32_t sliceAlphaC0OffsetDiv2 = 0;
+          int32_t sliceBetaOffsetDiv2 = 0;
+          uint32_t sliceGroupChangeCycle = 0;
+
+          uint32_t picOrderCntBitSize = 0;     // pic_order_cnt_lsb .. delta_pic_order_cnt[1]
+          uint32_t decRefPicMarkingBitSize = 0; // dec_ref_pic_marking()
+          uint32_t headerBitSize = 0;           // NAL header to slice_data(), RBSP bits
+
+          bool idr() const { return nalUnitType == 5; }
+        };
+
+        /**
+         * @brief Parses H.264 parameter sets and slice headers.
+         *
+         * Keeps every SPS and PPS seen, so slices are parsed against the
+         * parameter sets they refer to. Only what a frame-based V4L2 stateless
+         * decoder needs is parsed; slice data is left to the hardware.
+         */
+        class H264HeaderParser
+        {
+        public:
+          static constexpr uint8_t cNalSlice = 1;
+          static constexpr uint8_t cNalIdr = 5;
+          static constexpr uint8_t cNalSei = 6;
+          static constexpr uint8_t cNalSps = 7;
+          static constexpr uint8_t cNalPps = 8;
+
+          /**
+           * @brief Splits an Annex B buffer at its 3- and 4-byte start codes.
+           */
+          static std::vector<H264NalUnit> splitAnnexB(const uint8_t *data, size_t size);
+
+          /**
+           * @brief Removes emulation prevention bytes (00 00 03).
+           * @param limit Stop after this many payload bytes.
+           */
+          static void unescape(const uint8_t *data, size_t size, std::vector<uint8_t> &rbsp,
+                               size_t limit = SIZE_MAX);
+
+          /**
+           * @param nal Unit starting at the NAL header byte.
+           * @return false for a malformed or unsupported parameter set; the
+           * previous one with the same id stays in use.
+           */
+          bool parseSps(const H264NalUnit &nal);
+          bool parsePps(const H264NalUnit &nal);
+          bool parseSliceHeader(const H264NalUnit &nal, H264SliceHeader &header) const;
+
+          const H264Sps *sps(uint32_t id) const;
+          const H264Pps *pps(uint32_t id) const;
+
+          /**
+           * @brief Forgets every parameter set (new session).
+           */
+          void reset();
+
+        private:
+          class BitReader
+          {
+          public:
+            BitReader(const std::vector<uint8_t> &bytes, size_t startBit);
+
+            uint32_t u(int count);
+            uint32_t ue();
+            int32_t se();
+            bool flag() { return u(1) != 0; }
+            bool moreRbspData() const;
+            size_t position() const { return position_; }
+            bool failed() const { return failed_; }
+
+          private:
+            const std::vector<uint8_t> &bytes_;
+            size_t position_;
+            bool failed_ = false;
+          };
+
+          static void scalingList(BitReader &reader, uint8_t *list, size_t size, const uint8_t *defaultList,
+                                  const uint8_t *fallback);
+          static void scalingMatrix(BitReader &reader, size_t count8x8, uint8_t list4x4[6][16],
+                                    uint8_t list8x8[6][64], const uint8_t fallback4x4[6][16],
+                                    const uint8_t fallback8x8[6][64]);
+          static void parseVui(BitReader &reader, H264Sps &sps);
+          static bool parseSliceHeader(BitReader &reader, const H264Sps &sps, const H264Pps &pps,
+                                       H264SliceHeader &header);
+
+          static constexpr size_t cMaxSps = 32;
+          static constexpr size_t cMaxPps = 256;
+          // Slice headers fit in this much RBSP; the slice data is never unescaped
+          static constexpr size_t cSliceHeaderBytes = 4096;
+
+          std::array<std::unique_ptr<H264Sps>, cMaxSps> sps_;
+          std::array<std::unique_ptr<H264Pps>, cMaxPps> pps_;
+          mutable std::vector<uint8_t> rbsp_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
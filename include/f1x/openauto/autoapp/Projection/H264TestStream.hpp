@@ -0,0 +1,95 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <aasdk/Common/Data.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Synthesises a short Annex B H.264 stream for decoder probing.
+         *
+         * Constrained Baseline, CAVLC: one IDR of I_PCM macroblocks carrying a
+         * gradient, followed by all-skip P frames. No encoder is needed to build
+         * it and every decoder, hardware or software, has to accept it.
+         */
+        class H264TestStream
+        {
+        public:
+          /**
+           * @param width Luma width; rounded up to whole macroblocks and cropped.
+           * @param height Luma height; rounded up to whole macroblocks and cropped.
+           * @param frames Coded pictures, the IDR included.
+           */
+          H264TestStream(uint32_t width, uint32_t height, size_t frames);
+
+          /**
+           * @brief Units in the order the phone sends them: SPS + PPS first,
+           * then one access unit per picture.
+           */
+          const std::vector<aasdk::common::Data> &units() const;
+
+          /**
+           * @brief Units that decode to a picture (all but the parameter sets).
+           */
+          size_t pictureCount() const;
+
+        private:
+          class BitWriter
+          {
+          public:
+            void bits(uint32_t value, int count);
+            void ue(uint32_t value);
+            void se(int32_t value);
+            void alignZero();
+            void trailing();
+            const std::vector<uint8_t> &bytes() const;
+
+          private:
+            std::vector<uint8_t> bytes_;
+            uint8_t current_ = 0;
+            int used_ = 0;
+          };
+
+          static void appendNal(aasdk::common::Data &unit, uint8_t header, const std::vector<uint8_t> &rbsp);
+          void writeParameterSets(aasdk::common::Data &unit) const;
+          void writeIdr(aasdk::common::Data &unit) const;
+          void writeSkip(aasdk::common::Data &unit, uint32_t frameNum) const;
+
+          uint32_t width_;
+          uint32_t height_;
+          uint32_t widthMbs_;
+          uint32_t heightMbs_;
+          std::vector<aasdk::common::Data> units_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
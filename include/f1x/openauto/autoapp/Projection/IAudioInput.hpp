@@ -48,6 +48,10 @@ public:
     virtual uint32_t getSampleSize() const = 0;
     virtual uint32_t getChannelCount() const = 0;
     virtual uint32_t getSampleRate() const = 0;
+    // Returns a chunk delivered by read() once it has been sent, for reuse
+    virtual void recycle(aasdk::common::Data) {}
+    // The session is over: ends capture that stop() kept running
+    virtual void close() {}
 };
 
 }
@@ -18,12 +18,15 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <QRect>
 #include <aasdk/Common/Data.hpp>
 #include <aasdk/Messenger/Timestamp.hpp>
 #include <aap_protobuf/service/media/sink/message/VideoFrameRateType.pb.h>
 #include <aap_protobuf/service/media/sink/message/VideoCodecResolutionType.pb.h>
+#include <aap_protobuf/service/media/shared/message/MediaCodecType.pb.h>
+#include <f1x/openauto/autoapp/Projection/ProjectionGeometry.hpp>
 
 namespace f1x
 {
@@ -38,6 +41,8 @@ class IVideoOutput
 {
 public:
     typedef std::shared_ptr<IVideoOutput> Pointer;
+    typedef std::function<void()> FrameConsumedHandler;
+    typedef std::function<void()> KeyframeRequestHandler;
 
     IVideoOutput() = default;
     virtual ~IVideoOutput() = default;
@@ -51,6 +56,43 @@ public:
     virtual aap_protobuf::service::media::sink::message::VideoCodecResolutionType getVideoResolution() const = 0;
     virtual size_t getScreenDPI() const = 0;
     virtual QRect getVideoMargins() const = 0;
+    virtual size_t getMaxUnackedFrames() const = 0;
+
+    // Outputs that queue written frames can call the handler once per frame as
+    // it leaves that queue, so the media ACK follows pipeline depth. Returns
+    // false if unsupported; the caller then ACKs as soon as write() returns.
+    virtual bool setFrameConsumedHandler(FrameConsumedHandler /*handler*/) { return false; }
+
+    // Outputs that drop frames to resynchronise call this when they need the
+    // phone to send an IDR frame.
+    virtual void setKeyframeRequestHandler(KeyframeRequestHandler /*handler*/) {}
+
+    // Geometry of the session's video mode, set before init(). Outputs that
+    // scale the video themselves use it to crop the margins and letterbox.
+    virtual void setProjectionGeometry(const ProjectionGeometry & /*geometry*/) {}
+
+    // Frame rate of the session's video mode, set before init(). Outputs that
+    // time their own page flips use it to hold every frame equally long.
+    virtual void setFrameRate(uint32_t /*fps*/) {}
+
+    // While the projection is hidden behind the native UI, outputs can give
+    // back the decoder, frame buffers and plane; the phone stops sending video
+    // until it is shown again. Only called between init() and stop().
+    virtual void setBackground(bool /*background*/) {}
+
+    // Codecs worth advertising to the phone: decoded in hardware, or cheap
+    // enough in software. Every output decodes H.264.
+    virtual bool supportsCodec(aap_protobuf::service::media::shared::message::MediaCodecType codec) const
+    {
+        return codec == aap_protobuf::service::media::shared::message::MediaCodecType::MEDIA_CODEC_VIDEO_H264_BP;
+    }
+
+    // Codec the phone chose in the setup request, set before init(). Returns
+    // false if the output cannot decode it.
+    virtual bool setCodec(aap_protobuf::service::media::shared::message::MediaCodecType codec)
+    {
+        return supportsCodec(codec);
+    }
 
 };
 
@@ -21,9 +21,13 @@
 #include <QObject>
 #include <QKeyEvent>
 #include <QTouchEvent>
-#include <map>
+#include <memory>
 #include <f1x/openauto/autoapp/Projection/IInputDevice.hpp>
 #include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
+#include <f1x/openauto/autoapp/Projection/ProjectionGeometry.hpp>
+#include <f1x/openauto/autoapp/Projection/EvdevKeyReader.hpp>
+#include <f1x/openauto/autoapp/Projection/EvdevTouchReader.hpp>
+#include <f1x/openauto/autoapp/Projection/TouchPointerTable.hpp>
 
 namespace f1x
 {
@@ -39,7 +43,8 @@ class InputDevice: public QObject, public IInputDevice, boost::noncopyable
     Q_OBJECT
 
 public:
-    InputDevice(QObject& parent, configuration::IConfiguration::Pointer configuration, const QRect& touchscreenGeometry, const QRect& videoGeometry);
+    // Touches are mapped through the same geometry the video is displayed with
+    InputDevice(QObject& parent, configuration::IConfiguration::Pointer configuration, const ProjectionGeometry& geometry);
 
     void start(IInputDeviceEventHandler& eventHandler) override;
     void stop() override;
@@ -54,16 +59,22 @@ private:
     void dispatchKeyEvent(ButtonEvent event);
     bool handleTouchEvent(QEvent* event);
     bool handleMultiTouchEvent(QTouchEvent* touchEvent);
-    void translateTouchPoint(const QTouchEvent::TouchPoint& qtPoint, TouchPoint& ourPoint);
+    // False past TouchPointerTable::cMaxPointers contacts
+    bool translateTouchPoint(const QTouchEvent::TouchPoint& qtPoint, TouchPoint& ourPoint);
 
     QObject& parent_;
     configuration::IConfiguration::Pointer configuration_;
-    QRect touchscreenGeometry_;
-    QRect displayGeometry_;
+    ProjectionGeometry geometry_;
     IInputDeviceEventHandler* eventHandler_;
     std::mutex mutex_;
-    std::map<int, uint32_t> touchPointIdMap_; // Maps Qt touch IDs to our sequential IDs
-    uint32_t nextTouchPointId_;
+    TouchPointerTable pointerTable_; // Qt touch IDs to Android pointer IDs
+    TouchTransform touchTransform_;
+    TouchEvent touchEvent_; // Reused for every event, with room for every pointer
+    // Configured panel read directly while projecting; Qt touch is ignored then
+    std::unique_ptr<EvdevTouchReader> touchReader_;
+    bool directTouch_;
+    // Rotary encoders and steering wheel keys read while projecting
+    std::unique_ptr<EvdevKeyReader> keyReader_;
 };
 
 }
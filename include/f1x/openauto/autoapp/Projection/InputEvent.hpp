@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <vector>
 #include <aap_protobuf/service/media/sink/message/KeyCode.pb.h>
 #include <aap_protobuf/service/inputsource/message/PointerAction.pb.h>
@@ -46,11 +47,22 @@ enum class WheelDirection
     RIGHT
 };
 
+// When an input happened on the CLOCK_MONOTONIC base; zero if the source
+// cannot tell and the report should be stamped when it is sent
+typedef std::chrono::microseconds InputTimestamp;
+
+inline InputTimestamp inputTimestampNow()
+{
+    return std::chrono::duration_cast<InputTimestamp>(std::chrono::steady_clock::now().time_since_epoch());
+}
+
 struct ButtonEvent
 {
     ButtonEventType type;
     WheelDirection wheelDirection;
     aap_protobuf::service::media::sink::message::KeyCode code;
+    InputTimestamp timestamp{0};
+    uint32_t wheelSteps{1}; // Rotary detents merged into this event
 };
 
 struct TouchPoint
@@ -65,6 +77,7 @@ struct TouchEvent
     aap_protobuf::service::inputsource::message::PointerAction type;
     std::vector<TouchPoint> pointers;
     uint32_t actionIndex; // Index of the pointer that changed state
+    InputTimestamp timestamp{0};
 };
 
 }
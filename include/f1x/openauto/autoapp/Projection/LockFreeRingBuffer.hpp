@@ -23,6 +23,8 @@
 #include <cstdint>
 #include <cstring>
 #include <algorithm>
+#include <memory>
+#include <type_traits>
 
 namespace f1x
 {
@@ -33,6 +35,59 @@ namespace f1x
             namespace projection
             {
 
+                /**
+                 * @brief Capacity argument for a ring sized at construction
+                 */
+                constexpr size_t cRuntimeCapacity = 0;
+
+                namespace detail
+                {
+                    /**
+                     * @brief Inline ring memory of a compile-time capacity
+                     */
+                    template <size_t Capacity>
+                    class RingStorage
+                    {
+                    public:
+                        uint8_t *data() { return buffer_; }
+                        const uint8_t *data() const { return buffer_; }
+                        static constexpr size_t size() { return Capacity; }
+
+                    private:
+                        alignas(64) uint8_t buffer_[Capacity];
+                    };
+
+                    /**
+                     * @brief Heap ring memory sized at construction
+                     */
+                    template <>
+                    class RingStorage<cRuntimeCapacity>
+                    {
+                    public:
+                        explicit RingStorage(size_t minimumSize)
+                            : size_(roundUp(minimumSize)), buffer_(new uint8_t[size_])
+                        {
+                        }
+
+                        uint8_t *data() { return buffer_.get(); }
+                        const uint8_t *data() const { return buffer_.get(); }
+                        size_t size() const { return size_; }
+
+                    private:
+                        static size_t roundUp(size_t minimumSize)
+                        {
+                            size_t size = 2;
+                            while (size < minimumSize)
+                                size <<= 1;
+                            return size;
+                        }
+
+                        size_t size_;
+                        // Default-initialized: pages are only faulted in once written
+                        std::unique_ptr<uint8_t[]> buffer_;
+                    };
+                }
+
                 /**
                  * @brief Lock-free single-producer single-consumer (SPSC) ring buffer
                  *
@@ -40,19 +95,50 @@ namespace f1x
                  * data and another consumes it. No locks are used - only atomic operations
                  * with proper memory ordering for thread safety.
                  *
-                 * @tparam Capacity Must be a power of 2 for efficient modulo via bitmask
+                 * The memory is not cleared up front: only bytes that were written are
+                 * ever read, so a ring sized for the worst case costs resident memory
+                 * only for what the stream actually fills.
+                 *
+                 * @tparam Capacity Must be a power of 2 for efficient modulo via bitmask,
+                 * or cRuntimeCapacity to pass the capacity to the constructor
                  */
                 template <size_t Capacity>
                 class LockFreeRingBuffer
                 {
                     static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be power of 2");
-                    static_assert(Capacity > 0, "Capacity must be greater than 0");
 
                 public:
-                    LockFreeRingBuffer() : head_(0), tail_(0)
+                    /**
+                     * @brief Readable ring memory returned by peekContiguous()
+                     */
+                    struct ReadSpan
+                    {
+                        const uint8_t *data;
+                        size_t size;
+                    };
+
+                    /**
+                     * @brief Writable ring memory returned by reserveWrite()
+                     */
+                    struct WriteSpan
+                    {
+                        uint8_t *data;
+                        size_t size;
+                    };
+
+                    template <size_t C = Capacity, typename = std::enable_if_t<C != cRuntimeCapacity>>
+                    LockFreeRingBuffer() : head_(0), cachedTail_(0), tail_(0), cachedHead_(0)
+                    {
+                    }
+
+                    /**
+                     * @param minimumCapacity Bytes that must fit at once; rounded up
+                     * to a power of 2 (one byte more is allocated)
+                     */
+                    template <size_t C = Capacity, typename = std::enable_if_t<C == cRuntimeCapacity>>
+                    explicit LockFreeRingBuffer(size_t minimumCapacity)
+                        : head_(0), cachedTail_(0), tail_(0), cachedHead_(0), storage_(minimumCapacity + 1)
                     {
-                        // Zero-initialize buffer
-                        std::memset(buffer_, 0, Capacity);
                     }
 
                     /**
@@ -67,26 +153,26 @@ namespace f1x
                             return 0;
 
                         const size_t head = head_.load(std::memory_order_relaxed);
-                        const size_t tail = tail_.load(std::memory_order_acquire);
 
                         // Calculate available space (leave one slot empty to distinguish full from empty)
-                        const size_t available = (tail - head - 1 + Capacity) & mask_;
+                        const size_t available = writableFrom(head, size);
                         const size_t toWrite = std::min(size, available);
 
                         if (toWrite == 0)
                             return 0;
 
                         const uint8_t *src = static_cast<const uint8_t *>(data);
-                        const size_t headIdx = head & mask_;
+                        uint8_t *buffer = storage_.data();
+                        const size_t headIdx = head & mask();
 
                         // Check if write wraps around
-                        const size_t firstPart = std::min(toWrite, Capacity - headIdx);
-                        std::memcpy(buffer_ + headIdx, src, firstPart);
+                        const size_t firstPart = std::min(toWrite, storage_.size() - headIdx);
+                        std::memcpy(buffer + headIdx, src, firstPart);
 
                         if (toWrite > firstPart)
                         {
                             // Write wrapped portion at beginning
-                            std::memcpy(buffer_, src + firstPart, toWrite - firstPart);
+                            std::memcpy(buffer, src + firstPart, toWrite - firstPart);
                         }
 
                         // Update head with release semantics so consumer sees the data
@@ -107,26 +193,26 @@ namespace f1x
                             return 0;
 
                         const size_t tail = tail_.load(std::memory_order_relaxed);
-                        const size_t head = head_.load(std::memory_order_acquire);
 
                         // Calculate available data
-                        const size_t available = (head - tail) & mask_;
+                        const size_t available = readableFrom(tail, size);
                         const size_t toRead = std::min(size, available);
 
                         if (toRead == 0)
                             return 0;
 
                         uint8_t *dst = static_cast<uint8_t *>(data);
-                        const size_t tailIdx = tail & mask_;
+                        const uint8_t *buffer = storage_.data();
+                        const size_t tailIdx = tail & mask();
 
                         // Check if read wraps around
-                        const size_t firstPart = std::min(toRead, Capacity - tailIdx);
-                        std::memcpy(dst, buffer_ + tailIdx, firstPart);
+                        const size_t firstPart = std::min(toRead, storage_.size() - tailIdx);
+                        std::memcpy(dst, buffer + tailIdx, firstPart);
 
                         if (toRead > firstPart)
                         {
                             // Read wrapped portion from beginning
-                            std::memcpy(dst + firstPart, buffer_, toRead - firstPart);
+                            std::memcpy(dst + firstPart, buffer, toRead - firstPart);
                         }
 
                         // Update tail with release semantics
@@ -135,6 +221,50 @@ namespace f1x
                         return toRead;
                     }
 
+                    /**
+                     * @brief Largest run of queued bytes that is contiguous in ring
+                     * memory (consumer side); bytes past the wrap point follow after
+                     * commitRead(). Lets a consumer build its output straight from the
+                     * ring instead of reading into a scratch buffer first.
+                     */
+                    ReadSpan peekContiguous()
+                    {
+                        const size_t tail = tail_.load(std::memory_order_relaxed);
+                        const size_t tailIdx = tail & mask();
+                        const size_t toEnd = storage_.size() - tailIdx;
+                        const size_t available = readableFrom(tail, toEnd);
+                        return {storage_.data() + tailIdx, std::min(available, toEnd)};
+                    }
+
+                    /**
+                     * @brief Releases @p size bytes of the last peekContiguous() span
+                     */
+                    void commitRead(size_t size)
+                    {
+                        tail_.store(tail_.load(std::memory_order_relaxed) + size, std::memory_order_release);
+                    }
+
+                    /**
+                     * @brief Largest contiguous free region (producer side); fill it and
+                     * publish with commitWrite()
+                     */
+                    WriteSpan reserveWrite()
+                    {
+                        const size_t head = head_.load(std::memory_order_relaxed);
+                        const size_t headIdx = head & mask();
+                        const size_t toEnd = storage_.size() - headIdx;
+                        const size_t available = writableFrom(head, toEnd);
+                        return {storage_.data() + headIdx, std::min(available, toEnd)};
+                    }
+
+                    /**
+                     * @brief Publishes @p size bytes written into the last reserveWrite() span
+                     */
+                    void commitWrite(size_t size)
+                    {
+                        head_.store(head_.load(std::memory_order_relaxed) + size, std::memory_order_release);
+                    }
+
                     /**
                      * @brief Get number of bytes available to read
                      */
@@ -142,7 +272,7 @@ namespace f1x
                     {
                         const size_t head = head_.load(std::memory_order_acquire);
                         const size_t tail = tail_.load(std::memory_order_relaxed);
-                        return (head - tail) & mask_;
+                        return (head - tail) & mask();
                     }
 
                     /**
@@ -152,7 +282,7 @@ namespace f1x
                     {
                         const size_t head = head_.load(std::memory_order_relaxed);
                         const size_t tail = tail_.load(std::memory_order_acquire);
-                        return (tail - head - 1 + Capacity) & mask_;
+                        return (tail - head - 1 + storage_.size()) & mask();
                     }
 
                     /**
@@ -163,21 +293,65 @@ namespace f1x
                     {
                         head_.store(0, std::memory_order_relaxed);
                         tail_.store(0, std::memory_order_relaxed);
+                        cachedTail_ = 0;
+                        cachedHead_ = 0;
                     }
 
                     /**
                      * @brief Get the total capacity
                      */
-                    static constexpr size_t capacity() { return Capacity - 1; }
+                    size_t capacity() const { return storage_.size() - 1; }
+
+                    /**
+                     * @brief Bytes of ring memory, for memory accounting
+                     */
+                    size_t memoryBytes() const { return storage_.size(); }
 
                 private:
-                    static constexpr size_t mask_ = Capacity - 1;
+                    size_t mask() const { return storage_.size() - 1; }
+
+                    // Each side keeps its last view of the other side's index on its own
+                    // cache line and only reloads it when that view looks too full or
+                    // too empty, so the RT thread and the io thread stop bouncing the
+                    // opposite index's line on every call. A stale view only ever
+                    // under-reports space or data.
+                    size_t writableFrom(size_t head, size_t wanted)
+                    {
+                        size_t available = (cachedTail_ - head - 1 + storage_.size()) & mask();
+                        if (available < wanted)
+                        {
+                            cachedTail_ = tail_.load(std::memory_order_acquire);
+                            available = (cachedTail_ - head - 1 + storage_.size()) & mask();
+                        }
+                        return available;
+                    }
 
-                    alignas(64) std::atomic<size_t> head_; // Written by producer
-                    alignas(64) std::atomic<size_t> tail_; // Written by consumer
-                    alignas(64) uint8_t buffer_[Capacity];
+                    size_t readableFrom(size_t tail, size_t wanted)
+                    {
+                        size_t available = (cachedHead_ - tail) & mask();
+                        if (available < wanted)
+                        {
+                            cachedHead_ = head_.load(std::memory_order_acquire);
+                            available = (cachedHead_ - tail) & mask();
+                        }
+                        return available;
+                    }
+
+                    // Producer line
+                    alignas(64) std::atomic<size_t> head_;
+                    size_t cachedTail_;
+                    // Consumer line
+                    alignas(64) std::atomic<size_t> tail_;
+                    size_t cachedHead_;
+                    // Read-only after construction, shared by both sides
+                    alignas(64) detail::RingStorage<Capacity> storage_;
                 };
 
+                /**
+                 * @brief A ring sized from the stream format at construction
+                 */
+                typedef LockFreeRingBuffer<cRuntimeCapacity> RuntimeRingBuffer;
+
             } // namespace projection
         } // namespace autoapp
     } // namespace openauto
@@ -0,0 +1,179 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      class MetricCounter;
+
+      namespace projection
+      {
+
+        /**
+         * @brief What the media DSP stage does; from the Audio settings.
+         */
+        struct MediaDspSettings
+        {
+          static constexpr size_t cEqBands = 5;
+          // Low shelf, three peaking bands, high shelf
+          static constexpr std::array<float, cEqBands> cEqFrequencies{{60.0f, 250.0f, 1000.0f, 4000.0f, 12000.0f}};
+          static constexpr float cMaxEqGainDb = 12.0f;
+
+          bool enabled = false;
+          std::array<float, cEqBands> eqGainsDb{};
+          // Bass and treble lift of the loudness contour at 100
+          uint32_t loudnessPercent = 0;
+          // Share of each period the stage may use before it sheds the EQ
+          uint32_t cpuBudgetPercent = 10;
+
+          /**
+           * @brief Parses AudioEqualizerGains, e.g. "3,0,-2,0,4" in dB, low
+           * band first; gains are clamped to +-cMaxEqGainDb.
+           * @return false, leaving @p gains as is, unless there is one
+           * number per band
+           */
+          static bool parseEqGains(const std::string &text, std::array<float, cEqBands> &gains);
+        };
+
+        /**
+         * @brief The current media DSP design, shared by every stream that
+         * runs one. Settings are turned into biquad coefficients here, off
+         * the RT thread; each MediaDsp picks up a new design at its next
+         * period.
+         */
+        class MediaDspPreset
+        {
+        public:
+          typedef std::shared_ptr<MediaDspPreset> Pointer;
+
+          static constexpr uint32_t cSampleRate = 48000;
+          // EQ bands plus the two loudness shelves
+          static constexpr size_t cMaxStages = MediaDspSettings::cEqBands + 2;
+
+          // Transposed direct form II, normalised so a0 is 1
+          struct Biquad
+          {
+            float b0, b1, b2, a1, a2;
+          };
+
+          struct Design
+          {
+            bool enabled = false;
+            // Only the stages that are not flat
+            std::array<Biquad, cMaxStages> stages{};
+            size_t stageCount = 0;
+            uint32_t cpuBudgetPercent = 10;
+          };
+
+          explicit MediaDspPreset(const MediaDspSettings &settings = MediaDspSettings());
+
+          // Any thread
+          void set(const MediaDspSettings &settings);
+          bool isEnabled() const;
+
+        private:
+          friend class MediaDsp;
+
+          static Design design(const MediaDspSettings &settings);
+
+          // try_lock() only on the RT side, which keeps its design on contention
+          std::mutex mutex_;
+          Design design_;
+          std::atomic<uint64_t> version_;
+          std::atomic<bool> enabled_;
+        };
+
+        /**
+         * @brief Parametric EQ, loudness contour and peak limiter for one
+         * 48 kHz stereo media stream, run in place on its RT thread.
+         *
+         * Biquads run in float with both channels in one NEON register; the
+         * limiter keeps what the EQ and loudness lift adds from clipping.
+         * Each period is timed, and a stream that spends more than the CPU
+         * budget over a second drops to the limiter alone until the design
+         * changes, rather than underrunning the device. The same happens
+         * while the ThermalGovernor reports a hot head unit.
+         */
+        class MediaDsp
+        {
+        public:
+          static constexpr size_t cChannelCount = 2;
+
+          explicit MediaDsp(MediaDspPreset::Pointer preset);
+          ~MediaDsp();
+
+          MediaDsp(const MediaDsp &) = delete;
+          MediaDsp &operator=(const MediaDsp &) = delete;
+
+          /**
+           * @brief Picks up a new design; once per period, before process().
+           * @return false while the preset is disabled, and process() would
+           * leave the samples untouched
+           */
+          bool prepare();
+
+          // Interleaved stereo, any number of frames
+          void process(int16_t *samples, size_t frames);
+
+          // Only the limiter runs, the EQ having gone over budget
+          bool isShedding() const;
+
+        private:
+          static constexpr size_t cChunkFrames = 512;
+
+          void reset();
+          void processChunk(int16_t *samples, size_t frames);
+          // Times the period against the budget, over one-second windows
+          void account(int64_t busyNs);
+
+          const MediaDspPreset::Pointer preset_;
+          MetricCounter &shedCounter_;
+          MediaDspPreset::Design design_;
+          uint64_t version_;
+          bool active_;
+
+          // RT thread state
+          std::vector<float> work_;
+          // z1, z2 per stage, left and right adjacent
+          std::array<std::array<float, 4>, MediaDspPreset::cMaxStages> state_;
+          float limiterGain_;
+          float releaseStep_;
+          int64_t windowBusyNs_;
+          size_t windowFrames_;
+          bool thermalShed_; // EQ off while ThermalLevel::Hot
+          std::atomic<bool> shedding_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
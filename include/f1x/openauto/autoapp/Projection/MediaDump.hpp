@@ -0,0 +1,167 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief On-disk layout of a recorded session, all fields little-endian.
+         *
+         * File header (8 bytes): magic "OAMD", uint32 version.
+         * Each record (24 byte header + payload): uint32 payload size, uint16
+         * channel (aasdk ChannelId), uint16 flags, uint64 media timestamp as
+         * received from the phone, uint64 arrival time in microseconds since
+         * the recording started.
+         */
+        struct MediaDumpFormat
+        {
+          static constexpr char cMagic[4] = {'O', 'A', 'M', 'D'};
+          static constexpr uint32_t cVersion = 1;
+          static constexpr size_t cFileHeaderSize = 8;
+          static constexpr size_t cRecordHeaderSize = 24;
+          // Anything bigger is a corrupt length, not a media message
+          static constexpr uint32_t cMaxPayloadSize = 8 * 1024 * 1024;
+        };
+
+        /**
+         * @brief One media message of a recorded session.
+         */
+        struct MediaDumpRecord
+        {
+          uint16_t channel = 0;
+          uint16_t flags = 0;
+          uint64_t timestamp = 0;
+          int64_t arrivalUs = 0;
+          std::vector<uint8_t> payload;
+        };
+
+        /**
+         * @brief Sequential reader for MediaDumpFormat files.
+         */
+        class MediaDumpReader
+        {
+        public:
+          explicit MediaDumpReader(const std::string &path);
+
+          /**
+           * @brief True if the file exists and has a valid header.
+           */
+          bool isOpen() const;
+
+          /**
+           * @brief Reads the next record.
+           * @return false at the end of the file or at a truncated or corrupt
+           * record (a recording cut short by a crash ends there).
+           */
+          bool next(MediaDumpRecord &record);
+
+          /**
+           * @brief Goes back to the first record.
+           */
+          void rewind();
+
+        private:
+          std::ifstream in_;
+          bool open_;
+        };
+
+        /**
+         * @brief Appends media messages to a MediaDumpFormat file from a
+         * background thread.
+         *
+         * append() only copies the payload into a recycled buffer and hands
+         * it over; the file is written by the writer thread, so a slow SD
+         * card never stalls the channel that is being recorded. When the
+         * writer falls more than cMaxBacklogBytes behind, new records are
+         * dropped and counted instead of growing the queue.
+         */
+        class MediaDumpWriter
+        {
+        public:
+          typedef std::shared_ptr<MediaDumpWriter> Pointer;
+
+          static constexpr size_t cMaxBacklogBytes = 32 * 1024 * 1024;
+
+          explicit MediaDumpWriter(const std::string &path);
+          ~MediaDumpWriter();
+
+          MediaDumpWriter(const MediaDumpWriter &) = delete;
+          MediaDumpWriter &operator=(const MediaDumpWriter &) = delete;
+
+          /**
+           * @brief True if the file was created and its header written.
+           */
+          bool isOpen() const;
+
+          /**
+           * @brief Queues one message; safe to call from any thread.
+           */
+          void append(uint16_t channel, uint64_t timestamp, const uint8_t *data, size_t size);
+
+          /**
+           * @brief Writes out everything queued so far, then closes the file.
+           * Later append() calls are ignored.
+           */
+          void close();
+
+          uint64_t recordCount() const;
+          uint64_t droppedCount() const;
+
+        private:
+          void writerLoop();
+
+          std::ofstream out_;
+          bool open_;
+          const std::chrono::steady_clock::time_point startTime_;
+
+          mutable std::mutex mutex_;
+          std::condition_variable cond_;
+          std::deque<MediaDumpRecord> queue_;
+          std::vector<std::vector<uint8_t>> freeBuffers_;
+          size_t queuedBytes_;
+          bool closing_;
+          bool failed_;
+          uint64_t records_;
+          uint64_t dropped_;
+          std::thread thread_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
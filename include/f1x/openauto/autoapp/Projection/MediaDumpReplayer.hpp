@@ -0,0 +1,80 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <aasdk/Messenger/ChannelId.hpp>
+#include <f1x/openauto/autoapp/Projection/IAudioOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/IVideoOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDump.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Feeds a recorded session (see MediaDumpWriter) back into the
+         * outputs the live services would have driven.
+         *
+         * The outputs must already be opened and started by the caller;
+         * records for channels without an output are skipped.
+         */
+        class MediaDumpReplayer
+        {
+        public:
+          explicit MediaDumpReplayer(const std::string &path);
+
+          bool isOpen() const;
+
+          void setVideoOutput(IVideoOutput::Pointer videoOutput);
+          void setAudioOutput(aasdk::messenger::ChannelId channel, IAudioOutput::Pointer audioOutput);
+
+          /**
+           * @brief Replays the whole file on the calling thread.
+           * @param speed 1.0 keeps the original arrival pacing, 2.0 plays
+           * twice as fast, 0 writes records back to back.
+           * @return Number of records handed to an output.
+           */
+          uint64_t run(double speed = 1.0);
+
+          /**
+           * @brief Makes a running run() return after the current record.
+           */
+          void stop();
+
+        private:
+          MediaDumpReader reader_;
+          IVideoOutput::Pointer videoOutput_;
+          std::map<uint16_t, IAudioOutput::Pointer> audioOutputs_;
+          std::atomic<bool> stopRequested_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
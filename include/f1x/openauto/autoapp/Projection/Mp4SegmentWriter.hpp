@@ -0,0 +1,118 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#ifdef USE_FFMPEG_DRM
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+extern "C"
+{
+#include <libavformat/version.h>
+}
+
+struct AVFormatContext;
+struct AVIOContext;
+struct AVPacket;
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Streams an Annex B H.264 elementary stream into one
+         * fragmented MP4 file.
+         *
+         * Every keyframe starts a fragment, so a file cut short by the power
+         * going off plays up to the last complete one. The file is allocated
+         * to its expected size when opened: the segment lands in one
+         * contiguous run instead of being interleaved with the others on the
+         * card. close() trims what was not used. Written pages are pushed to
+         * the card as they accumulate, not in one long writeback that would
+         * stall other I/O.
+         */
+        class Mp4SegmentWriter
+        {
+        public:
+          Mp4SegmentWriter();
+          ~Mp4SegmentWriter();
+
+          Mp4SegmentWriter(const Mp4SegmentWriter &) = delete;
+          Mp4SegmentWriter &operator=(const Mp4SegmentWriter &) = delete;
+
+          bool open(const std::string &path, uint64_t preallocateBytes, uint32_t width, uint32_t height);
+
+          /**
+           * @brief One encoded frame. Frames before the first keyframe are
+           * dropped: the header needs its SPS and PPS.
+           * @return false on a write error; the segment is then unusable.
+           */
+          bool write(const uint8_t *data, size_t size, int64_t timestampUs, bool keyframe);
+
+          void close();
+
+          bool isOpen() const { return fd_ >= 0; }
+          const std::string &path() const { return path_; }
+          uint64_t bytesWritten() const { return written_; }
+          // From the first frame written, 0 before it
+          int64_t durationUs() const;
+
+        private:
+          bool writeHeader(const uint8_t *data, size_t size);
+          int writeFile(const uint8_t *data, int size);
+          void flushToCard(bool all);
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+          static int writePacket(void *opaque, const uint8_t *data, int size);
+#else
+          static int writePacket(void *opaque, uint8_t *data, int size);
+#endif
+
+          std::string path_;
+          int fd_;
+          uint32_t width_;
+          uint32_t height_;
+          AVFormatContext *context_;
+          AVIOContext *io_;
+          AVPacket *packet_;
+          bool headerWritten_;
+          bool failed_;
+          int64_t firstUs_;
+          int64_t lastUs_;
+          uint64_t written_;
+          uint64_t flushed_;
+
+          // Writeback granularity: small enough to never build a burst
+          static constexpr uint64_t cFlushBytes = 1024 * 1024;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
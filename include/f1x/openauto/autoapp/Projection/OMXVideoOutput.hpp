@@ -26,8 +26,8 @@ extern "C"
 
 #include <mutex>
 #include <condition_variable>
+#include <deque>
 #include <thread>
-#include <boost/circular_buffer.hpp>
 #include <f1x/openauto/autoapp/Projection/VideoOutput.hpp>
 
 namespace f1x
@@ -39,15 +39,32 @@ namespace autoapp
 namespace projection
 {
 
+/**
+ * @brief OMXVideoOutput - H.264 through the VideoCore IL decoder on the Pi
+ *
+ * The decoder's input buffers are slabs of one pool of ours, registered
+ * through OMX_UseBuffer. write() copies the reassembled AAP frame into free
+ * slabs and queues them; a feeder thread hands them to the decoder, so the
+ * media strand never waits on the decoder or the tunnel setup. A frame
+ * counts as consumed once the decoder gave back its last slab. When the
+ * decoder is so far behind that a frame finds no room, frames are dropped
+ * up to the next IDR frame, which the phone is asked for.
+ */
 class OMXVideoOutput: public VideoOutput
 {
 public:
+    // What the input port is asked for; it may settle on more
+    static constexpr uint32_t cInputBuffers = 16;
+    static constexpr uint32_t cInputBufferBytes = 128 * 1024;
+
     OMXVideoOutput(configuration::IConfiguration::Pointer configuration);
 
     bool open() override;
     bool init() override;
     void write(uint64_t timestamp, const aasdk::common::DataConstBuffer& buffer) override;
     void stop() override;
+    bool setFrameConsumedHandler(FrameConsumedHandler handler) override;
+    void setKeyframeRequestHandler(KeyframeRequestHandler handler) override;
 
 private:
     bool createComponents();
@@ -55,6 +72,16 @@ private:
     bool setupTunnels();
     bool enablePortBuffers();
     bool setupDisplayRegion();
+    bool setupOutputTunnels();
+    void feedLoop();
+    // Gives @p frames frames back to the phone's ACK window
+    void frameConsumed(size_t frames);
+
+    // ilclient callbacks: the slabs for OMX_UseBuffer, and a decoder input
+    // buffer given back
+    static void* allocateInputBuffer(void* userdata, VCOS_UNSIGNED size, VCOS_UNSIGNED align, const char* description);
+    static void freeInputBuffer(void* userdata, void* buffer);
+    static void onInputBufferDone(void* userdata, COMPONENT_T* component);
 
     std::mutex mutex_;
     bool isActive_;
@@ -62,6 +89,24 @@ private:
     ILCLIENT_T* client_;
     COMPONENT_T* components_[5];
     TUNNEL_T tunnels_[4];
+
+    uint8_t* inputPool_;
+    size_t inputPoolBytes_;
+    size_t inputPoolUsed_;
+    size_t inputSlabBytes_;
+    bool waitForKeyframe_;
+
+    std::mutex feedMutex_;
+    std::condition_variable feedCondition_;
+    std::thread feeder_;
+    bool feeding_;
+    // Slabs write() may fill, and filled ones waiting for the feeder
+    std::deque<OMX_BUFFERHEADERTYPE*> freeInput_;
+    std::deque<OMX_BUFFERHEADERTYPE*> filledInput_;
+    // Per slab in the decoder, in the order given: whether it ends a frame
+    std::deque<bool> inDecoder_;
+    FrameConsumedHandler frameConsumedHandler_;
+    KeyframeRequestHandler keyframeRequestHandler_;
 };
 
 }
@@ -0,0 +1,228 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief NAL unit summary of one H.264 or HEVC buffer, used by the drop policy.
+         */
+        struct AccessUnitInfo
+        {
+          bool keyframe = false;      // Contains an IDR slice
+          bool parameterSets = false; // Contains SPS/PPS
+          bool hasSlices = false;     // Contains any coded slice
+          bool reference = false;     // A slice has nal_ref_idc != 0
+          uint8_t profileIdc = 0;     // profile_idc of an H.264 SPS in the buffer
+        };
+
+        /**
+         * @brief Checks whether a buffer starts with an Annex-B start code.
+         * @return true for a complete access unit, false for a fragment.
+         */
+        bool hasAnnexBStartCode(const uint8_t *data, size_t size);
+
+        /**
+         * @brief Scans the Annex-B NAL headers of a buffer. Fragments come
+         * back empty, as nothing can be told about them.
+         * @param hevc HEVC NAL headers rather than H.264 ones.
+         */
+        AccessUnitInfo inspectAccessUnit(const uint8_t *data, size_t size, bool hevc);
+
+        /**
+         * @brief Keyframe-aware backlog control of the decoder's packet queue.
+         *
+         * Under backlog, non-reference frames go first because nothing refers
+         * to them. If the queue still fills up, queued frames are thrown away
+         * back to the last IDR, or the newest ones are and everything is
+         * dropped until the next IDR, so the decoder never sees a frame whose
+         * references were dropped. Not thread-safe; FFmpegDrmVideoOutput calls
+         * it with its queue mutex held.
+         */
+        class PacketDropPolicy
+        {
+        public:
+          /**
+           * @brief Maximum number of packets held between write() and the decoder.
+           * Kept small on purpose: if the decoder falls this far behind, packets
+           * are dropped rather than adding latency.
+           */
+          static constexpr size_t cMaxQueuedPackets = 8;
+
+          /**
+           * @brief Queue depth from which non-reference frames are dropped on
+           * arrival; nothing else depends on them, so the picture stays intact.
+           */
+          static constexpr size_t cBacklogThreshold = 4;
+
+          /**
+           * @brief Backlog threshold while LinkQuality reports a degraded or poor
+           * link: late packets arrive in bursts, and draining them quickly keeps
+           * the picture closer to live than smoothing them out would.
+           */
+          static constexpr size_t cDegradedBacklogThreshold = 2;
+
+          /**
+           * @brief Decides on an incoming packet, dropping queued ones to make room.
+           * @param queue Packets waiting for the decoder; each has an info member.
+           * @param info NAL summary of the incoming packet.
+           * @param degradedLink The link is degraded or poor.
+           * @param dropped Incremented for every queued packet dropped.
+           * @param requestKeyframe Set when an IDR should be requested.
+           * @return true if the incoming packet should be queued.
+           */
+          template <typename Packet>
+          bool admit(std::deque<Packet> &queue, const AccessUnitInfo &info, bool degradedLink,
+                     size_t &dropped, bool &requestKeyframe);
+
+          /**
+           * @brief Drops every slice until the next IDR, e.g. when the decoder
+           * lost its references.
+           */
+          void awaitKeyframe();
+
+          bool awaitingKeyframe() const;
+
+          /**
+           * @brief Forgets the stream, as at a session start.
+           */
+          void reset();
+
+        private:
+          // Drops the slices among the first @p count packets
+          template <typename Packet>
+          static void dropSlices(std::deque<Packet> &queue, size_t count, size_t &dropped);
+
+          bool awaitingKeyframe_ = false;
+        };
+
+        template <typename Packet>
+        void PacketDropPolicy::dropSlices(std::deque<Packet> &queue, size_t count, size_t &dropped)
+        {
+          // One erase: erasing inside a deque invalidates every iterator into it
+          const auto end = queue.begin() + static_cast<std::ptrdiff_t>(count);
+          const auto kept = std::remove_if(queue.begin(), end, [](const Packet &p)
+                                           { return p.info.hasSlices; });
+          dropped += static_cast<size_t>(std::distance(kept, end));
+          queue.erase(kept, end);
+        }
+
+        template <typename Packet>
+        bool PacketDropPolicy::admit(std::deque<Packet> &queue, const AccessUnitInfo &info, bool degradedLink,
+                                     size_t &dropped, bool &requestKeyframe)
+        {
+          const auto hasSlices = [](const Packet &p)
+          { return p.info.hasSlices; };
+
+          // SPS/PPS without slices are needed by the next IDR, and fragments
+          // cannot be classified: neither is ever given up for room
+          if (!info.hasSlices)
+          {
+            if (queue.size() < cMaxQueuedPackets)
+            {
+              return true;
+            }
+
+            // A frame nothing refers to, oldest first
+            auto disposable = std::find_if(queue.begin(), queue.end(), [](const Packet &p)
+                                           { return p.info.hasSlices && !p.info.reference; });
+            if (disposable != queue.end())
+            {
+              queue.erase(disposable);
+              dropped++;
+              return true;
+            }
+
+            // Otherwise the newest slice: no slice is queued after it until
+            // the next IDR, so what stays queued still decodes
+            awaitingKeyframe_ = true;
+            requestKeyframe = true;
+            auto newest = std::find_if(queue.rbegin(), queue.rend(), hasSlices);
+            if (newest == queue.rend())
+            {
+              // Nothing but parameter sets and fragments: the stream breaks
+              // here either way, and the IDR asked for repairs it
+              return false;
+            }
+            queue.erase(std::prev(newest.base()));
+            dropped++;
+            return true;
+          }
+
+          if (awaitingKeyframe_)
+          {
+            if (!info.keyframe)
+            {
+              requestKeyframe = true;
+              return false;
+            }
+            awaitingKeyframe_ = false;
+          }
+
+          const size_t backlogThreshold = degradedLink ? cDegradedBacklogThreshold : cBacklogThreshold;
+
+          if (info.keyframe && queue.size() >= backlogThreshold)
+          {
+            // Nothing queued before an IDR is needed to decode what follows it
+            dropSlices(queue, queue.size(), dropped);
+            return true;
+          }
+
+          if (queue.size() >= backlogThreshold && !info.reference)
+          {
+            return false;
+          }
+
+          if (queue.size() >= cMaxQueuedPackets)
+          {
+            // Resume from the newest queued IDR if there is one behind the head
+            auto lastIdr = std::find_if(queue.rbegin(), queue.rend(), [](const Packet &p)
+                                        { return p.info.keyframe; });
+            if (lastIdr != queue.rend() && std::next(lastIdr) != queue.rend())
+            {
+              dropSlices(queue, static_cast<size_t>(std::distance(lastIdr, queue.rend())) - 1, dropped);
+              return true;
+            }
+
+            // Later frames may reference this one, so drop until the next IDR
+            awaitingKeyframe_ = true;
+            requestKeyframe = true;
+            return false;
+          }
+
+          return true;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
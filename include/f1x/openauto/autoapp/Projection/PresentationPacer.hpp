@@ -0,0 +1,127 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Holds each frame on screen for a whole number of vblanks.
+         *
+         * Committing a 30 fps stream as soon as each frame is decoded turns
+         * uneven decode times into 1- and 3-vblank holds on a 60 Hz panel,
+         * which shows as judder while a map scrolls. Configured once per
+         * session with the stream's frame rate and the CRTC refresh, the
+         * pacer gives the earliest time the next frame may be committed so it
+         * flips in cadence vblanks after the last one, or further on when the
+         * phone's timestamps skip a frame. The vblank period is measured from
+         * the page-flip events. A backlog of decoded frames, or a refresh
+         * that is not a multiple of the frame rate, turns pacing off. Not
+         * thread-safe; the presentation thread owns it.
+         */
+        class PresentationPacer
+        {
+        public:
+          // A refresh this close to a multiple of the frame rate still paces,
+          // so 59.94 Hz carries 30 fps
+          static constexpr uint32_t cCadenceTolerancePermille = 5;
+          // Longest timestamp gap, in frames, that is held for in full
+          static constexpr int64_t cMaxHeldFrames = 2;
+
+          PresentationPacer();
+
+          /**
+           * @brief Session start: the stream's frame rate and the refresh of
+           * the mode it is shown in, in millihertz. Forgets earlier flips.
+           */
+          void configure(uint32_t fps, uint32_t refreshMilliHz);
+
+          /**
+           * @brief Vblanks each frame is held for, 0 when not paced.
+           */
+          uint32_t cadence() const;
+
+          /**
+           * @brief The vblank period, measured once flips have been seen.
+           */
+          int64_t vblankPeriodUs() const;
+
+          /**
+           * @brief A flip landed on vblank @p sequence at @p vblankUs
+           * (CLOCK_MONOTONIC).
+           * @return False if the frame it showed replaced the previous one
+           * earlier or later than its cadence asked for.
+           */
+          bool onFlip(uint32_t sequence, int64_t vblankUs);
+
+          /**
+           * @brief Earliest CLOCK_MONOTONIC time to commit the frame with
+           * timestamp @p ptsUs, or 0 to commit it now.
+           * @param queuedFrames Decoded frames waiting, this one included.
+           */
+          int64_t commitNotBeforeUs(int64_t ptsUs, size_t queuedFrames) const;
+
+          /**
+           * @brief The frame with timestamp @p ptsUs was committed.
+           */
+          void onCommit(int64_t ptsUs);
+
+          /**
+           * @brief Vblanks per frame for a refresh rate, 0 if it is not a
+           * multiple of @p fps.
+           */
+          static uint32_t cadenceFor(uint32_t fps, uint32_t refreshMilliHz);
+
+          /**
+           * @brief Index into @p refreshMilliHz of the mode to show @p fps in:
+           * @p current when it paces, otherwise the highest refresh that
+           * does, otherwise @p current.
+           */
+          static size_t chooseRefresh(const std::vector<uint32_t> &refreshMilliHz, size_t current,
+                                      uint32_t fps);
+
+        private:
+          // Vblanks the frame with @p ptsUs should follow the last one by;
+          // 0 for a gap too long to judge
+          uint32_t holdFor(int64_t ptsUs) const;
+
+          uint32_t cadence_;
+          int64_t framePeriodUs_;
+          double vblankPeriodUs_;
+          int64_t nominalPeriodUs_;
+          int64_t lastFlipUs_;    // 0 before the first flip
+          uint32_t lastSequence_;
+          int64_t lastPtsUs_;     // Timestamp of the frame last committed, 0 if none
+          uint32_t expectedHold_; // Vblanks the committed frame should flip after, 0 unjudged
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
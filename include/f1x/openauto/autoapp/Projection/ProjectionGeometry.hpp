@@ -0,0 +1,215 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <QPoint>
+#include <QPointF>
+#include <QRect>
+#include <QSize>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief How the panel is mounted relative to the picture.
+         *
+         * The upright picture, in "view" coordinates, is turned clockwise by
+         * rotation() degrees and then, if mirrored(), flipped left to right to
+         * give the panel's scanout coordinates.
+         */
+        class DisplayOrientation
+        {
+        public:
+          DisplayOrientation();
+
+          /**
+           * @param rotation Clockwise degrees; anything but a multiple of 90 is
+           * taken as 0.
+           * @param mirrored Flip left to right after rotating, as for a head-up
+           * display reflected in the windscreen.
+           */
+          DisplayOrientation(int rotation, bool mirrored);
+
+          int rotation() const;
+          bool mirrored() const;
+          bool isIdentity() const;
+
+          /**
+           * @brief True for 90 and 270 degrees, where the view is the panel on
+           * its side.
+           */
+          bool swapsAxes() const;
+
+          QSize viewSize(const QSize &panelSize) const;
+          QPointF toPanel(const QPointF &viewPoint, const QSize &viewSize) const;
+          QPointF toView(const QPointF &panelPoint, const QSize &panelSize) const;
+          QRect toPanel(const QRect &viewRect, const QSize &viewSize) const;
+
+          bool operator==(const DisplayOrientation &other) const;
+          bool operator!=(const DisplayOrientation &other) const;
+
+        private:
+          int rotation_;
+          bool mirrored_;
+        };
+
+        /**
+         * @brief Where the projected phone UI sits in the video stream and on
+         * the display.
+         *
+         * The phone draws its UI into the codec frame minus the advertised
+         * margins, split evenly between both sides. That area is scaled to the
+         * display with its aspect ratio kept and centred (letterboxed or
+         * pillarboxed). Built once per video mode; the plane rectangles, the
+         * advertised margins and the touch mapping all read the same object,
+         * so what is shown and where touches land cannot disagree.
+         *
+         * With a DisplayOrientation, the UI is fitted to the upright view of
+         * the panel, and display coordinates (destinationRect(), touches) are
+         * still the panel's own.
+         */
+        class ProjectionGeometry
+        {
+        public:
+          ProjectionGeometry();
+
+          /**
+           * @param videoSize Codec frame size of the stream.
+           * @param margins Total horizontal/vertical margin inside the frame.
+           * Zero margins are replaced by fittedMargins(), so the phone UI
+           * matches the display aspect and fills it without bars.
+           * @param displaySize Size of the screen area the projection fills,
+           * in panel pixels.
+           * @param orientation How the panel shows the picture.
+           */
+          ProjectionGeometry(const QSize &videoSize, const QSize &margins,
+                             const QSize &displaySize,
+                             const DisplayOrientation &orientation = DisplayOrientation());
+
+          /**
+           * @brief True without a video or display size; the margins are still
+           * valid when only the display size is missing.
+           */
+          bool isNull() const;
+
+          const QSize &videoSize() const;
+          const QSize &margins() const;
+          const QSize &displaySize() const;
+          const DisplayOrientation &orientation() const;
+
+          /**
+           * @brief Part of the video frame holding the phone UI.
+           */
+          const QRect &sourceRect() const;
+
+          /**
+           * @brief Where sourceRect() lands on the display. It is turned by
+           * orientation() when shown there.
+           */
+          const QRect &destinationRect() const;
+
+          /**
+           * @brief The same projection on a display of another size.
+           */
+          ProjectionGeometry withDisplaySize(const QSize &displaySize) const;
+
+          /**
+           * @brief The same share of margins on a stream of another size.
+           */
+          ProjectionGeometry withVideoSize(const QSize &videoSize) const;
+
+          /**
+           * @brief Maps a display position to video frame coordinates, the space
+           * touch events are reported in. Points in the letterbox bars are
+           * clamped to the edge of the phone UI.
+           */
+          QPoint mapToVideo(const QPointF &displayPoint) const;
+
+          /**
+           * @brief Like mapToVideo(), without rounding or clamping; corners of
+           * destinationRect() map to corners of sourceRect().
+           */
+          QPointF mapToSource(const QPointF &displayPoint) const;
+
+          /**
+           * @brief Margins that give the phone UI the display's aspect ratio.
+           */
+          static QSize fittedMargins(const QSize &videoSize, const QSize &displaySize);
+
+          bool operator==(const ProjectionGeometry &other) const;
+          bool operator!=(const ProjectionGeometry &other) const;
+
+        private:
+          // Letterbox bars this thin are stretched away
+          static constexpr int cSnapPixels = 2;
+
+          QSize videoSize_;
+          QSize margins_;
+          QSize displaySize_;
+          DisplayOrientation orientation_;
+          QRect sourceRect_;
+          QRect destinationRect_;
+          // destinationRect_ in view coordinates, before the orientation
+          QRect viewRect_;
+          // Video pixels per view pixel
+          double scaleX_;
+          double scaleY_;
+        };
+
+        /**
+         * @brief ProjectionGeometry::mapToVideo() as one fixed-point affine
+         * transform, for touch points.
+         *
+         * The orientation, letterbox offset and scale are folded into a 2x3
+         * matrix of 16.16 coefficients when the geometry is set, so mapping a
+         * point costs two multiply-adds per axis and a clamp. Results match
+         * mapToVideo() to within a pixel.
+         */
+        class TouchTransform
+        {
+        public:
+          TouchTransform();
+          explicit TouchTransform(const ProjectionGeometry &geometry);
+
+          QPoint map(const QPointF &displayPoint) const;
+
+        private:
+          // Input points are taken in 1/256 pixel
+          static constexpr int cInputShift = 8;
+          static constexpr int cFractionBits = 16;
+
+          // video = m * (x, y, 1), row-major, 16.16
+          std::array<int64_t, 6> matrix_;
+          bool clamp_;
+          QRect bounds_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
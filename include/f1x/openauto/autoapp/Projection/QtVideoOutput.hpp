@@ -20,7 +20,7 @@
 
 #include <QMediaPlayer>
 #include <QVideoWidget>
-#include <mutex>
+#include <atomic>
 #include <boost/noncopyable.hpp>
 #include <f1x/openauto/autoapp/Projection/VideoOutput.hpp>
 #include <f1x/openauto/autoapp/Projection/SequentialBuffer.hpp>
@@ -63,10 +63,10 @@ private:
     SequentialBuffer videoBuffer_;
     std::unique_ptr<QVideoWidget> videoWidget_;
     std::unique_ptr<QMediaPlayer> mediaPlayer_;
-    bool playerReady_;
-    bool initialBufferingDone_;
-    size_t bytesWritten_;
-    std::mutex writeMutex_;
+    // Read by write() on the io_service, set from the GUI thread
+    std::atomic<bool> playerReady_;
+    std::atomic<bool> initialBufferingDone_;
+    std::atomic<size_t> bytesWritten_;
     static constexpr size_t INITIAL_BUFFER_SIZE = 65536; // 64KB initial buffer before checking state
 };
 
@@ -0,0 +1,187 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
+
+struct v4l2_buffer;
+struct v4l2_plane;
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        class DashcamRecorder;
+
+        /**
+         * @brief Reverse camera shown straight from a V4L2 grabber on a KMS
+         * overlay plane, with no CPU copies.
+         *
+         * prepare() does everything that is slow ahead of time. It opens the
+         * capture device and negotiates YUYV or NV12, allocates the capture
+         * buffers as DRM dumb buffers, and imports them as framebuffers. The
+         * buffers are handed to V4L2 as DMA-BUFs; grabbers that cannot import
+         * them have their own buffers exported instead. It also picks the
+         * overlay plane, and the plane for the guidelines. Engaging reverse
+         * then only starts streaming and points the plane at the first frame;
+         * with hot standby the stream never stops, so the first frame is the
+         * next one the grabber delivers.
+         *
+         * One thread owns the device and the planes. Each frame is put on the
+         * plane with a SetPlane that returns once it is latched, and only then
+         * does the buffer it replaced go back to the grabber. When the only
+         * usable overlay plane is the Android Auto video plane, the video
+         * output is asked to hold its frames while the camera is shown.
+         */
+        class RearCamera
+        {
+        public:
+          explicit RearCamera(configuration::IConfiguration::Pointer configuration);
+          ~RearCamera();
+
+          RearCamera(const RearCamera &) = delete;
+          RearCamera &operator=(const RearCamera &) = delete;
+
+          /**
+           * @brief Also feeds every captured frame to @p recorder, which keeps
+           * the grabber streaming. Before prepare().
+           */
+          void setRecorder(std::shared_ptr<DashcamRecorder> recorder);
+
+          /**
+           * @brief Opens the device and sets up buffers and planes, and starts
+           * the camera thread. The thread retries every few seconds while the
+           * grabber is unplugged.
+           * @return false if no device is configured or DRM is unavailable.
+           */
+          bool prepare();
+
+          /**
+           * @brief Reverse engaged or released; returns at once, the camera
+           * thread does the work. Any thread.
+           */
+          void setShown(bool shown);
+          bool isShown() const;
+
+          /**
+           * @brief Draws parking guidelines into an ARGB8888 image: two lines
+           * converging towards the horizon and red, yellow and green distance
+           * marks. The rest is left transparent.
+           * @param pitch Row length in pixels.
+           */
+          static void drawGuidelines(uint32_t *pixels, uint32_t pitch, uint32_t width,
+                                     uint32_t height);
+
+        private:
+          struct Buffer
+          {
+            uint32_t handle = 0;  // Dumb buffer, 0 for exported grabber buffers
+            uint32_t fbId = 0;
+            int fd = -1;          // DMA-BUF of the buffer
+            size_t size = 0;
+            bool encoding = false; // Lent to the dashcam encoder
+          };
+
+          struct DumbImage
+          {
+            uint32_t handle = 0;
+            uint32_t fbId = 0;
+            size_t size = 0;
+          };
+
+          void run();
+          bool openDisplay();
+          bool findPlanes();
+          bool openCapture();
+          bool allocateBuffers();
+          void releaseBuffers();
+          void closeCapture();
+          bool createGuidelines();
+          bool startStreaming();
+          void stopStreaming();
+          void describeBuffer(int index, struct v4l2_buffer &buffer, struct v4l2_plane &plane) const;
+          bool queueBuffer(int index);
+          void returnBuffer(int index);
+          void attachRecorder();
+          void collectReleased();
+          int dequeueNewest();
+          void engage();
+          void disengage();
+          bool showBuffer(int index);
+          void disablePlanes();
+          void wake();
+
+          configuration::IConfiguration::Pointer configuration_;
+          std::shared_ptr<DashcamRecorder> recorder_;
+          std::thread thread_;
+          std::atomic<bool> stopping_;
+          std::atomic<bool> wantShown_;
+          int wakeFd_;
+
+          // Camera thread only from here on
+          int drmFd_;
+          uint32_t crtcId_;
+          uint32_t displayWidth_;
+          uint32_t displayHeight_;
+          uint32_t planeId_;
+          uint32_t guidelinesPlaneId_;
+          bool sharesVideoPlane_;
+          DumbImage guidelines_;
+
+          int videoFd_;
+          uint32_t bufferType_;  // Single or multi-planar capture
+          uint32_t pixelFormat_; // V4L2 fourcc
+          uint32_t drmFormat_;
+          uint32_t width_;
+          uint32_t height_;
+          uint32_t bytesPerLine_;
+          bool dmabufImport_;    // Dumb buffers queued as V4L2_MEMORY_DMABUF
+          std::vector<Buffer> buffers_;
+          bool streaming_;
+          bool shown_;
+          int onScreen_;         // Buffer on the plane, -1 if none
+          int64_t engagedUs_;    // When reverse was engaged, until the first frame
+          uint32_t fps_;
+          bool recording_;
+
+          // Buffers the encoder is done with, from the recorder thread
+          std::mutex releasedMutex_;
+          std::vector<int> released_;
+
+          static constexpr size_t cBufferCount = 4;
+          static constexpr int cReopenIntervalMs = 3000;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,164 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifdef USE_FFMPEG_DRM
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Crops, scales, converts, turns and mirrors video frames with
+         * the Rockchip RGA, through the kernel's rockchip-rga V4L2 mem2mem
+         * driver.
+         *
+         * For what the video plane cannot do itself: a panel orientation, a
+         * scaling ratio or a frame layout it rejects. Each frame costs one
+         * RGA blit from its DMA-BUF into one of a few capture buffers, which
+         * are exported and imported as framebuffers once; neither the CPU nor
+         * the GPU touches the pixels. Results are NV12 or XRGB8888 with
+         * 64-byte aligned pitches, which every VOP plane scans out. Used from
+         * the presentation thread only.
+         */
+        class RgaTransform
+        {
+        public:
+          /**
+           * @brief A frame in one DMA-BUF object: semi-planar YUV 4:2:0 or
+           * 4:2:2, or 16/32-bit RGB.
+           */
+          struct Source
+          {
+            int fd = -1;
+            size_t size = 0;
+            uint32_t drmFormat = 0;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint32_t pitch = 0;
+            uint32_t chromaOffset = 0; // Semi-planar YUV only
+          };
+
+          /**
+           * @brief One blit. The crop is scaled to width x height after the
+           * clockwise turn by @p rotation degrees, then mirrored left to right.
+           */
+          struct Operation
+          {
+            int rotation = 0;
+            bool mirrored = false;
+            // Part of the frame read; all of it if cropWidth is 0
+            uint32_t cropX = 0;
+            uint32_t cropY = 0;
+            uint32_t cropWidth = 0;
+            uint32_t cropHeight = 0;
+            // The turned crop's size if 0
+            uint32_t width = 0;
+            uint32_t height = 0;
+            // DRM_FORMAT_NV12 or DRM_FORMAT_XRGB8888; 0 keeps the source's if
+            // the plane can show it
+            uint32_t drmFormat = 0;
+          };
+
+          /**
+           * @brief True if the RGA reads frames of @p drmFormat.
+           */
+          static bool canRead(uint32_t drmFormat);
+
+          /**
+           * @brief The format a frame of @p drmFormat is blitted to by
+           * default: NV12 for YUV, XRGB8888 for RGB.
+           */
+          static uint32_t scanoutFormat(uint32_t drmFormat);
+
+          /**
+           * @param drmFd Device the results are imported into; not owned.
+           */
+          explicit RgaTransform(int drmFd);
+          ~RgaTransform();
+
+          RgaTransform(const RgaTransform &) = delete;
+          RgaTransform &operator=(const RgaTransform &) = delete;
+
+          /**
+           * @brief Finds the RGA.
+           * @return false if the kernel has no rockchip-rga device.
+           */
+          bool open();
+          void close();
+          bool isOpen() const;
+
+          /**
+           * @brief Blits @p source as @p operation describes. Blocks until the
+           * RGA is done, typically 2-4 ms for 720p NV12.
+           * @return Framebuffer holding the result; 0 on failure. The buffer
+           * is reused three frames later.
+           */
+          uint32_t transform(const Source &source, const Operation &operation);
+
+        private:
+          static constexpr size_t cMaxDevices = 16;
+          static constexpr size_t cCaptureBuffers = 3;
+          static constexpr int cTimeoutMs = 100;
+
+          struct Capture
+          {
+            int fd = -1;
+            uint32_t handle = 0;
+            uint32_t fbId = 0;
+          };
+
+          // @p operation with every default filled in
+          static Operation resolve(const Source &source, const Operation &operation);
+          static bool sameSource(const Source &a, const Source &b);
+          static bool sameOperation(const Operation &a, const Operation &b);
+
+          // Output and capture formats, controls and buffers for a resolved
+          // @p operation, reused while the stream and operation stay the same
+          bool configure(const Source &source, const Operation &operation);
+          void releaseBuffers();
+
+          const int drmFd_;
+          int videoFd_;
+          std::string deviceName_;
+
+          Source configured_;
+          Operation operation_;
+          bool streaming_;
+          uint32_t outputBytes_; // sizeimage of the source format
+          std::vector<Capture> captures_;
+          size_t next_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
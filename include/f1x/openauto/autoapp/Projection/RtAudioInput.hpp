@@ -1,9 +1,13 @@
 #pragma once
 
 #include <atomic>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
 #include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
 #include <f1x/openauto/autoapp/Projection/IAudioInput.hpp>
 #include <f1x/openauto/autoapp/Projection/LockFreeRingBuffer.hpp>
+#include <f1x/openauto/autoapp/Projection/VoiceProcessingStage.hpp>
 #include <memory>
 #include <mutex>
 #include <rtaudio/RtAudio.h>
@@ -21,7 +25,8 @@ namespace f1x
         class RtAudioInput : public IAudioInput
         {
         public:
-          RtAudioInput(uint32_t channelCount, uint32_t sampleSize, uint32_t sampleRate,
+          RtAudioInput(boost::asio::io_service &ioService, uint32_t channelCount,
+                       uint32_t sampleSize, uint32_t sampleRate,
                        configuration::IConfiguration::Pointer configuration);
           ~RtAudioInput() override;
 
@@ -33,8 +38,54 @@ namespace f1x
           uint32_t getSampleSize() const override;
           uint32_t getChannelCount() const override;
           uint32_t getSampleRate() const override;
+          void recycle(aasdk::common::Data data) override;
+          void close() override;
+
+          /**
+           * @brief Keeps @p ms of capture ready for the next start(). open()
+           * then starts the device, which keeps running after stop() until
+           * close(); start() only switches to live reads, which begin with
+           * the last @p ms captured. 0 is off; set before open().
+           */
+          void setPreRoll(uint32_t ms);
+
+          /**
+           * @brief Routes capture through echo cancellation and noise
+           * suppression; set before start().
+           */
+          void setVoiceProcessing(VoiceProcessingStage::Pointer stage);
+
+          /**
+           * @brief Body of the RT capture callback: queues one period of
+           * interleaved SINT16 frames and wakes a waiting read. RT-safe.
+           */
+          void capture(const void *input, unsigned int frames, bool overflowed);
+
+        protected:
+          // Opens and starts the capture stream, mutex_ held. Overridden by
+          // backends without a device, which feed capture() themselves
+          virtual bool startDevice();
+          // Stops and closes the stream, mutex_ held
+          virtual void stopDevice();
 
         private:
+          bool createRtAudio();
+          // Ends live reads; @p keepDevice leaves it capturing into the pre-roll
+          void stopCapture(bool keepDevice);
+          // RT thread only: keeps the newest preRoll_.size() bytes
+          void keepPreRoll(const uint8_t *data, size_t bytes);
+          // RT thread only: what read() consumes next, stage or buffer_
+          void deliver(const void *data, size_t bytes);
+          // What read() consumes: buffer_, or the stage's processed output
+          VoiceProcessingStage::Ring &source();
+          // Consumer side of source(), mutex_ held
+          aasdk::common::Data takeChunk();
+          // Wakes a waiting read once a chunk is queued; RT-safe, called by
+          // whichever thread produces into source()
+          void signalChunk();
+          // Resolves the pending read once a chunk is queued, mutex_ held
+          void fulfillPendingRead();
+          void armWakeup();
           static int rtAudioCallback(void *outputBuffer, void *inputBuffer,
                                      unsigned int nBufferFrames, double streamTime,
                                      RtAudioStreamStatus status, void *userData);
@@ -45,16 +96,42 @@ namespace f1x
           configuration::IConfiguration::Pointer configuration_;
           std::shared_ptr<RtAudio> rtAudio_;
           ReadPromise::Pointer readPromise_;
-          mutable std::mutex mutex_; // Only for promise state, not buffer access
-          // Lock-free ring buffer for audio input - 64KB capacity
+          // Promise and chunk pool state; io threads only, never the RT callback
+          mutable std::mutex mutex_;
+          // Lock-free ring buffer for audio input, cRingMs of capture
           // Producer: RT callback, Consumer: read() method
-          LockFreeRingBuffer<65536> buffer_;
+          VoiceProcessingStage::Ring buffer_;
+          MemoryCharge memory_;
           bool isActive_;
           std::atomic<bool> isStopping_;
-          std::atomic<bool> dataAvailable_{false}; // Signal from RT callback to main thread
+          // Set while a read waits for data; the RT callback clears it and
+          // wakes the io thread through wakeupFd_ instead of resolving itself
+          std::atomic<bool> readWaiting_{false};
+          std::atomic<uint32_t> overflows_{0};
+          int wakeupFd_;
+          boost::asio::posix::stream_descriptor wakeup_;
+          uint64_t wakeupCount_;
+          // Chunks handed back by the send path, reused instead of reallocated
+          std::vector<aasdk::common::Data> freeChunks_;
+          VoiceProcessingStage::Pointer voiceProcessing_;
+
+          // Pre-roll: the newest capture while no read is live. The ring is
+          // the RT thread's; start() asks it to deliver the ring first
+          std::vector<uint8_t> preRoll_;
+          std::unique_ptr<MemoryCharge> preRollMemory_;
+          size_t preRollWrite_ = 0;
+          size_t preRollFill_ = 0;
+          bool deviceRunning_ = false;
+          std::atomic<bool> prerolling_{false};
+          std::atomic<bool> preRollPending_{false};
+          // Set for the length of capture(); stop() waits it out
+          std::atomic<bool> capturing_{false};
 
           static constexpr size_t cChunkSize =
               2056; // Standard chunk size requested by AA
+          static constexpr size_t cChunkPoolSize = 4;
+          static constexpr uint32_t cRingMs = 1000;
+          static constexpr uint32_t cLowMemoryRingMs = 250;
         };
 
       } // namespace projection
@@ -25,9 +25,11 @@
 #endif
 
 #include <atomic>
+#include <memory>
 #include <mutex>
+#include <f1x/openauto/autoapp/Projection/AudioJitterBuffer.hpp>
 #include <f1x/openauto/autoapp/Projection/IAudioOutput.hpp>
-#include <f1x/openauto/autoapp/Projection/LockFreeRingBuffer.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDsp.hpp>
 
 namespace f1x
 {
@@ -41,15 +43,21 @@ namespace f1x
         class RtAudioOutput : public IAudioOutput
         {
         public:
+
           /**
            * @brief Construct RtAudioOutput
            * @param channelCount Number of audio channels
            * @param sampleSize Sample size in bits
            * @param sampleRate Sample rate in Hz
            * @param deviceId Device ID to use (0 = use default device)
+           * @param lowLatency Start with a short period and grow it only when
+           * the device reports underruns, up to the safe fallback size
+           * @param jitterBufferMs Audio queued before playout starts
            */
           RtAudioOutput(uint32_t channelCount, uint32_t sampleSize, uint32_t sampleRate,
-                        uint32_t deviceId = 0);
+                        uint32_t deviceId = 0, bool lowLatency = false,
+                        uint32_t jitterBufferMs = 60);
+          ~RtAudioOutput() override;
           bool open() override;
           void write(aasdk::messenger::Timestamp::ValueType timestamp,
                      const aasdk::common::DataConstBuffer &buffer) override;
@@ -59,9 +67,87 @@ namespace f1x
           uint32_t getSampleSize() const override;
           uint32_t getChannelCount() const override;
           uint32_t getSampleRate() const override;
+          AudioJitterStats getJitterStats() const;
+          // Frames waiting in the jitter buffer; any thread
+          size_t getQueuedFrames() const;
+          uint32_t getDeviceId() const;
+
+          /**
+           * @brief Keeps the device stream running, playing silence, from
+           * open() until stop(); start() and suspend() then only gate the
+           * jitter buffer. Spares short streams such as guidance prompts the
+           * ALSA start-up that would swallow their first syllable, for one
+           * silent period per wakeup while idle. Call before open().
+           */
+          void setKeepRunning(bool keepRunning);
+
+          /**
+           * @brief Leaves the device open across stop(): the stream is only
+           * stopped, and the next open() restarts it without ALSA setup.
+           * For outputs that outlive the session using them (AudioOutputPool);
+           * the device stays claimed until the output is destroyed.
+           */
+          void setKeepOpen(bool keepOpen);
+
+          /**
+           * @brief Runs the media EQ and limiter of @p preset on what render()
+           * plays; 48 kHz stereo only. An output that already follows
+           * @p preset, e.g. one back from AudioOutputPool, is left as is.
+           * Safe while the stream runs: the old stage is freed once the RT
+           * callback is out of it, so this may wait for one period.
+           */
+          void setMediaDsp(MediaDspPreset::Pointer preset);
+
+          /**
+           * @brief Moves playback to @p deviceId without a gap: the new stream
+           * opens alongside the old one and takes over the jitter buffer at a
+           * period boundary, and only then is the old one closed. A closed
+           * output just opens on the new device next time.
+           * @return false if the new device could not be opened, in which case
+           * the old stream keeps playing
+           */
+          bool switchDevice(uint32_t deviceId);
+
+          /**
+           * @brief switchDevice() on every output in the process, e.g. after
+           * the configured device changed. Blocks while the new streams open:
+           * not for the GUI thread.
+           */
+          static void switchAllDevices(uint32_t deviceId);
+
+        protected:
+          /**
+           * @brief Produces one period of output on the RT thread; plays the
+           * jitter buffer fed by write() unless overridden.
+           */
+          virtual void render(void *output, unsigned int frames);
+
+          /**
+           * @brief Grows the period after repeated underruns in low-latency
+           * mode. Must be called from the producer side, never from render().
+           */
+          void adaptPeriod();
 
         private:
-          void doSuspend();
+          // What the RT callback gets as userData: one per stream, so that it
+          // knows which of two streams it was called for during a switch
+          struct StreamContext
+          {
+            RtAudioOutput *owner;
+            RtAudio *dac;
+          };
+
+          static std::unique_ptr<RtAudio> createDac();
+          bool openStream(uint32_t bufferFrames, uint32_t numberOfBuffers);
+          bool openStream(RtAudio &dac, StreamContext &context, uint32_t deviceId,
+                          uint32_t bufferFrames, uint32_t numberOfBuffers);
+          void closeStream(RtAudio &dac);
+          void doStart(RtAudio &dac);
+          void doSuspend(RtAudio &dac);
+          void growPeriod();
+          uint32_t fallbackPeriodFrames() const;
+          // Spins until the render() pass in progress, if any, has returned
+          void waitForRender() const;
           static int audioBufferReadHandler(void *outputBuffer, void *inputBuffer,
                                             unsigned int nBufferFrames,
                                             double streamTime,
@@ -71,10 +157,31 @@ namespace f1x
           uint32_t sampleSize_;
           uint32_t sampleRate_;
           uint32_t deviceId_;
-          // Lock-free ring buffer for audio - 256KB capacity (power of 2)
-          // Allows ~2.7 seconds of 48kHz stereo 16-bit audio
-          LockFreeRingBuffer<262144> audioBuffer_;
+          bool lowLatency_;
+          // Period granted by the backend for the open stream
+          std::atomic<uint32_t> periodFrames_;
+          // Device underruns reported to the RT callback, and how many of
+          // them the current period size has already answered for
+          std::atomic<uint32_t> xruns_{0};
+          std::atomic<uint32_t> xrunsHandled_;
+          AudioJitterBuffer audioBuffer_;
+          bool keepRunning_;
+          bool keepOpen_;
+          MediaDspPreset::Pointer mediaPreset_;
+          // Owned by mediaStage_, read by render() without the mutex
+          std::atomic<MediaDsp *> mediaDsp_{nullptr};
+          std::unique_ptr<MediaDsp> mediaStage_;
+          // Counted up on entering and leaving render(), so odd inside it
+          std::atomic<uint32_t> renderPasses_{0};
+          // Closed between a stream's suspend() and the next start() while
+          // the device keeps running: render() plays out the tail, then silence
+          std::atomic<bool> gateOpen_{true};
           std::unique_ptr<RtAudio> dac_;
+          std::unique_ptr<StreamContext> context_;
+          // The stream allowed to drain the jitter buffer, and the one taking
+          // over at its next period while switchDevice() runs
+          std::atomic<RtAudio *> activeDac_;
+          std::atomic<RtAudio *> nextDac_{nullptr};
           std::mutex mutex_; // Only for non-RT operations (open/close/start/stop)
           std::atomic<bool> isStopping_{
               false}; // Atomic flag for safe shutdown during USB disconnect
@@ -19,8 +19,8 @@
 #pragma once
 
 #include <QIODevice>
-#include <mutex>
-#include <boost/circular_buffer.hpp>
+#include <array>
+#include <atomic>
 #include <aasdk/Common/Data.hpp>
 
 namespace f1x
@@ -32,10 +32,24 @@ namespace autoapp
 namespace projection
 {
 
+/**
+ * Feeds QMediaPlayer the H.264 stream QtVideoOutput writes. One writer and
+ * one reader without a lock: each write() fills a slot of a ring of chunks,
+ * whose memory is reused once read, and readData() copies straight out of
+ * the slots. readyRead is emitted only when the reader ran dry.
+ *
+ * Slots keep the capacity of the largest chunk they held; under the
+ * low-memory profile a slot far larger than the chunk it is reused for
+ * (the leftover of a key frame) is given back first.
+ */
 class SequentialBuffer: public QIODevice
 {
 public:
+    static constexpr size_t cChunkSlots = 64;
+    static constexpr size_t cTrimSlotBytes = 256 * 1024;
+
     SequentialBuffer();
+    ~SequentialBuffer() override;
     bool isSequential() const override;
     qint64 size() const override;
     qint64 pos() const override;
@@ -51,8 +65,18 @@ protected:
     qint64 writeData(const char *data, qint64 len) override;
 
 private:
-    boost::circular_buffer<aasdk::common::Data::value_type> data_;
-    mutable std::mutex mutex_;
+    // Slots published by the writer, and consumed by the reader
+    std::atomic<size_t> head_;
+    std::atomic<size_t> tail_;
+    std::atomic<size_t> queuedBytes_;
+    // Set by the reader once it found nothing left, cleared by the writer
+    // that then owes it a readyRead
+    std::atomic<bool> readerWaiting_;
+    size_t readOffset_; // reader only: bytes of the tail slot already read
+    size_t dropped_;    // writer only: chunks dropped while the ring was full
+    size_t slotBytes_;  // writer only: capacity of all slots, counted as video memory
+    const bool trimSlots_;
+    std::array<aasdk::common::Data, cChunkSlots> chunks_;
 };
 
 }
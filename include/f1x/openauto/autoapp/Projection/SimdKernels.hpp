@@ -0,0 +1,95 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace common
+    {
+      struct CpuFeatures;
+    }
+
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief SimdKernels - The DSP and pixel kernels, bound once to the
+         * best build the CPU runs.
+         *
+         * The scalar references are in SimdKernels.cpp and the NEON builds in
+         * SimdKernelsNeon.cpp, the only file compiled with -mfpu=neon on
+         * armv7, so a board without NEON runs the references instead of
+         * taking SIGILL. Every kernel covers its whole range, tail included;
+         * callers in hot loops copy the pointer out once.
+         */
+        struct SimdKernels
+        {
+          // AudioDsp
+          void (*mixSaturate)(int16_t *dst, const int16_t *src, size_t samples);
+          void (*applyGainQ15)(int16_t *samples, size_t frames, uint32_t channels, int16_t startGain,
+                               int16_t endGain);
+          void (*upmixMonoToStereo)(int16_t *dst, const int16_t *src, size_t frames);
+          // One polyphase resampler phase: 8 taps by 8 samples
+          int32_t (*dotProduct8)(const int16_t *a, const int16_t *b);
+
+          // YuvCopy: one row of U and V samples to NV12's interleaved UV
+          void (*interleaveChromaRow)(uint8_t *dst, const uint8_t *u, const uint8_t *v, int width);
+
+          // MediaDsp
+          void (*toFloat)(const int16_t *src, float *dst, size_t samples);
+          // Transposed direct form II over interleaved stereo, in place;
+          // coefficients b0 b1 b2 a1 a2, state z1 left, right, z2 left, right
+          void (*biquadStereo)(float *samples, size_t frames, const float *coefficients, float *state);
+
+          // VoiceProcessor
+          float (*dotF32)(const float *a, const float *b, size_t count);
+          // y += scale * x
+          void (*axpyF32)(float *y, const float *x, float scale, size_t count);
+        };
+
+        /**
+         * @brief The table for this CPU, bound on first use from
+         * CpuFeatures::host().
+         */
+        const SimdKernels &simdKernels();
+
+        const SimdKernels &scalarKernels();
+
+        /**
+         * @brief The NEON builds; null where this target has none.
+         */
+        const SimdKernels *neonKernels();
+
+        /**
+         * @brief Picks each kernel's build for @p features.
+         */
+        SimdKernels bindSimdKernels(const common::CpuFeatures &features);
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,144 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Threads whose placement the topology decides.
+         */
+        enum class ThreadRole
+        {
+          UsbEvents,    // UsbEventLoop
+          IoService,    // boost::asio io_service workers
+          MediaLane,    // io_service running the media and input channel handlers
+          Input,        // EvdevTouchReader and EvdevKeyReader
+          VideoDecode,  // FFmpegDrmVideoOutput decode loop, OMXVideoOutput feeder
+          VideoPresent, // FFmpegDrmVideoOutput page flip loop, RearCamera and ClusterDisplay
+          AudioOutput,  // RtAudio playback callback
+          AudioInput,   // RtAudio capture callback
+          Background,   // DashcamRecorder encode and segment writes
+          Count
+        };
+
+        /**
+         * @brief The [Threads] section of openauto.ini. Counts of 0, CPU lists of
+         * "auto" and priorities of -1 are derived from the core count.
+         */
+        struct ThreadTopologySettings
+        {
+          uint32_t ioWorkers = 0;
+          std::string workerCpus = "auto"; // USB event loop and io_service pool
+          std::string videoCpus = "auto";
+          std::string audioCpus = "auto";
+          int32_t videoPriority = -1; // SCHED_FIFO priority, 0 for SCHED_OTHER
+          int32_t audioPriority = -1;
+        };
+
+        /**
+         * @brief Where one role runs: the CPUs it may use (empty for any) and its
+         * SCHED_FIFO priority (0 to stay on SCHED_OTHER). Idle threads run on
+         * SCHED_IDLE with idle I/O priority, only when nothing else wants the
+         * CPU or the disk.
+         */
+        struct ThreadPlacement
+        {
+          std::vector<int> cpus;
+          int fifoPriority = 0;
+          bool idle = false;
+        };
+
+        /**
+         * @brief Process-wide thread counts, affinity and real-time priorities.
+         *
+         * On the 4-core RK3229 the defaults keep video decode on core 3 and the
+         * audio callbacks on core 2, with the USB event loop and io_service pool on
+         * the remaining cores next to the Qt GUI thread, so the latency-critical
+         * threads are never queued behind protocol work.
+         */
+        class ThreadTopology
+        {
+        public:
+          ThreadTopology(const ThreadTopologySettings &settings, unsigned cores);
+
+          /**
+           * @brief The topology in effect; defaults until configure() is called.
+           */
+          static const ThreadTopology &instance();
+
+          /**
+           * @brief Replaces the topology. Call once at startup, before any
+           * thread applies it.
+           */
+          static void configure(const ThreadTopologySettings &settings);
+
+          /**
+           * @brief Parses a CPU list such as "3", "0-1" or "0,2-3". "none" and
+           * the empty string leave threads unpinned.
+           * @return False on malformed input or CPUs beyond @p cores.
+           */
+          static bool parseCpuList(const std::string &list, unsigned cores, std::vector<int> &cpus);
+
+          uint32_t ioWorkers() const { return ioWorkers_; }
+          const ThreadPlacement &placement(ThreadRole role) const;
+
+          /**
+           * @brief Names the calling thread and applies the role's affinity and
+           * scheduling. Failures (usually missing CAP_SYS_NICE) are logged once
+           * per role and otherwise ignored.
+           */
+          void apply(ThreadRole role, const char *name) const;
+
+          /**
+           * @brief Single-line human readable summary for logs.
+           */
+          std::string summary() const;
+
+        private:
+          static constexpr int cDefaultVideoPriority = 50;
+          static constexpr int cDefaultAudioPriority = 70;
+          // Just above SCHED_OTHER: ahead of protocol work, behind the decoder
+          static constexpr int cDefaultMediaLanePriority = 10;
+
+          static ThreadTopology &current();
+          void plan(const ThreadTopologySettings &settings, unsigned cores);
+
+          unsigned cores_;
+          uint32_t ioWorkers_;
+          std::array<ThreadPlacement, static_cast<size_t>(ThreadRole::Count)> placements_;
+          mutable std::array<std::atomic<bool>, static_cast<size_t>(ThreadRole::Count)> warned_{};
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
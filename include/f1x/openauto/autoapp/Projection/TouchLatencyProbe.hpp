@@ -0,0 +1,168 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <QPoint>
+#include <QRect>
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        class IInputDeviceEventHandler;
+
+        /**
+         * @brief Measurement mode for what the driver feels: a synthetic
+         * tap goes in through the input path and the probe waits for the
+         * screen to change under it.
+         *
+         * Every interval, a tap is injected at a fixed video position through
+         * the session's IInputDeviceEventHandler. The video output samples the
+         * mean luma of a small square around that position in every decoded
+         * frame (VideoFrameTiming::probeLuma). When a frame whose luma differs
+         * from the one shown at the tap reaches the screen, its flip time
+         * minus the tap time is one touch-to-photon sample. This works with any
+         * control that visibly reacts to a tap; a phone-side test app that
+         * flips a patch between black and white on every touch down gives the
+         * cleanest edges.
+         *
+         * If the same test app also flashes the patch on its own clock, changes
+         * that no tap explains are timed from the frame's AAP arrival to the
+         * flip. That is the head unit's share of glass-to-glass latency; the
+         * phone's render, encode and send time needs a camera on both screens.
+         *
+         * Off unless OPENAUTO_LATENCY_PROBE is set, e.g. "640,360" or
+         * "640,360,2000" for a tap every 2 s; decode threads pay one relaxed
+         * load per frame otherwise.
+         */
+        class TouchLatencyProbe
+        {
+        public:
+          struct Options
+          {
+            QPoint position;       // Tap and sample point, in video pixels
+            int regionSize = 32;   // Side of the sampled square
+            int intervalMs = 2000; // Between taps
+            int threshold = 24;    // Mean luma change counted as a reaction
+          };
+
+          static TouchLatencyProbe &instance();
+
+          /**
+           * @brief Parses "x,y[,intervalMs]".
+           * @return False for an empty or malformed value.
+           */
+          static bool parseOptions(const std::string &value, Options &options);
+
+          /**
+           * @brief Options from OPENAUTO_LATENCY_PROBE, if it is set and valid.
+           */
+          static bool optionsFromEnvironment(Options &options);
+
+          /**
+           * @brief Mean luma of @p region in an 8-bit luma plane, sampling
+           * every other pixel of every other row.
+           * @param plane First byte of the region's top row.
+           * @param region Region, with top() == 0 at @p plane.
+           */
+          static int meanLuma(const uint8_t *plane, int pitch, const QRect &region);
+
+          TouchLatencyProbe();
+          ~TouchLatencyProbe();
+
+          TouchLatencyProbe(const TouchLatencyProbe &) = delete;
+          TouchLatencyProbe &operator=(const TouchLatencyProbe &) = delete;
+
+          /**
+           * @brief Starts tapping through @p eventHandler, which must outlive
+           * stop(). Restarts if already running.
+           */
+          void start(const Options &options, IInputDeviceEventHandler &eventHandler);
+          void stop();
+
+          /**
+           * @brief Cheap check for the decode path: sample frames only if true.
+           */
+          bool isActive() const;
+
+          /**
+           * @brief The sampled square clipped to a frame of this size; empty
+           * while stopped or if the position lies outside the frame.
+           */
+          QRect region(int frameWidth, int frameHeight) const;
+
+          /**
+           * @brief A tap was injected at @p tapUs (VideoTelemetry::nowUs()).
+           * Used by the tapping thread, and by tests in its place.
+           */
+          void tapped(int64_t tapUs);
+
+          /**
+           * @brief A frame carrying a probeLuma sample reached the screen.
+           * Called by VideoTelemetry::recordFrame() from any presenting thread.
+           */
+          void frameShown(const VideoFrameTiming &timing);
+
+          LatencyStats touchToPhoton() const;
+          LatencyStats arrivalToPhoton() const;
+          // Taps whose reaction never arrived within cReactionTimeoutUs
+          uint64_t missedTaps() const;
+
+        private:
+          // A reaction later than this is a tap the phone ignored
+          static constexpr int64_t cReactionTimeoutUs = 1000000;
+          static constexpr int cTapHoldMs = 50;
+          static constexpr const char *cMissedTapFramePath = "/tmp/openauto_probe_missed.jpg";
+
+          void run(IInputDeviceEventHandler *eventHandler);
+          void expirePendingTap(int64_t nowUs);
+
+          mutable std::mutex mutex_;
+          std::condition_variable wake_;
+          std::atomic<bool> active_;
+          bool stopping_;
+          Options options_;
+          std::thread thread_;
+
+          int lastLuma_;          // Of the newest frame shown, -1 before the first
+          int tapLuma_;           // What was on screen when the pending tap went in
+          int64_t pendingTapUs_;  // 0 while no tap awaits its reaction
+          int64_t lastTapUs_;
+          LatencyWindow touchToPhoton_;
+          LatencyWindow arrivalToPhoton_;
+          uint64_t missedTaps_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
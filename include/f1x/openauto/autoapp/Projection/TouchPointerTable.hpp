@@ -0,0 +1,78 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Android pointer ids for the contacts of a touch source.
+         *
+         * A new contact gets the lowest id not in use, as Android's own input
+         * dispatcher assigns them, so a finger that stays down keeps its id
+         * while others come and go, and the phone's gesture tracking sees the
+         * same ids a phone screen would produce. Fixed capacity, no
+         * allocation; contacts past cMaxPointers are not reported.
+         */
+        class TouchPointerTable
+        {
+        public:
+          static constexpr size_t cMaxPointers = 10;
+
+          /**
+           * @brief The pointer id of @p sourceId, assigning the lowest free one
+           * to a new contact.
+           * @return -1 when every id is taken.
+           */
+          int acquire(int sourceId);
+
+          /**
+           * @return -1 if @p sourceId has no pointer id.
+           */
+          int find(int sourceId) const;
+
+          void release(int sourceId);
+          void clear();
+          size_t size() const;
+
+        private:
+          struct Slot
+          {
+            bool used = false;
+            int sourceId = 0;
+          };
+
+          // Indexed by pointer id
+          std::array<Slot, cMaxPointers> slots_;
+        };
+
+      }
+    }
+  }
+}
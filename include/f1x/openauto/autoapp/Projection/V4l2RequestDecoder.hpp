@@ -0,0 +1,259 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifdef USE_FFMPEG_DRM
+
+#include <linux/v4l2-controls.h>
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <f1x/openauto/autoapp/Projection/H264HeaderParser.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief H.264 decoder driving a V4L2 stateless (request API) device
+         * directly, e.g. rkvdec or hantro.
+         *
+         * Parses SPS, PPS and slice headers itself, keeps the DPB, and submits
+         * V4L2_CID_STATELESS_H264_* controls with each access unit in its own
+         * media request. Decoding is frame-based with Annex B start codes and
+         * synchronous: decode() returns once the picture is in its capture
+         * buffer, so exactly one frame is ever in flight. Capture buffers are
+         * exported as DMA-BUFs once and handed out as NV12 pictures.
+         *
+         * Pictures are output in decode order, like libavcodec with
+         * AV_CODEC_FLAG_LOW_DELAY; Android Auto streams have no B-frames.
+         * Field coding and non-NV12 capture formats are reported as
+         * Unsupported so the caller can fall back to libavcodec.
+         */
+        class V4l2RequestDecoder
+        {
+        public:
+          /**
+           * @brief A decoded picture in one contiguous NV12 DMA-BUF.
+           * The capture buffer stays out of the decoder until every copy of
+           * hold is gone; release it from any thread.
+           */
+          struct Picture
+          {
+            int fd = -1;       // DMA-BUF, owned by the decoder
+            size_t size = 0;
+            uint32_t width = 0; // Cropped picture size
+            uint32_t height = 0;
+            uint32_t pitch = 0;
+            uint32_t chromaOffset = 0;
+            bool fullRange = false;
+            uint32_t matrixCoefficients = 2;
+            int64_t pts = 0;
+            std::shared_ptr<void> hold;
+          };
+
+          enum class Status
+          {
+            Decoded,    // The handler was called with the picture
+            NoPicture,  // Parameter sets or other units without a slice
+            Dropped,    // Lost, see awaitingIdr()
+            Unsupported // The stream or the device cannot be decoded here
+          };
+
+          typedef std::function<void(const Picture &picture)> PictureHandler;
+
+          /**
+           * @param extraPictures Pictures the caller may hold (display queue,
+           * scanout) on top of the DPB.
+           */
+          explicit V4l2RequestDecoder(size_t extraPictures);
+          ~V4l2RequestDecoder();
+
+          V4l2RequestDecoder(const V4l2RequestDecoder &) = delete;
+          V4l2RequestDecoder &operator=(const V4l2RequestDecoder &) = delete;
+
+          /**
+           * @brief Finds a frame-based H.264 stateless decoder and its media
+           * device. Buffers are only allocated once the first SPS arrives.
+           */
+          bool open();
+
+          /**
+           * @brief Decodes one Annex B access unit.
+           * @param handler Called on this thread before returning Decoded.
+           */
+          Status decode(const uint8_t *data, size_t size, int64_t pts, const PictureHandler &handler);
+
+          /**
+           * @brief Drops the DPB and parameter sets before the next session.
+           * Buffers stay allocated for a stream of the same size.
+           */
+          void flush();
+
+          const std::string &deviceName() const;
+
+          /**
+           * @brief Whether pictures are dropped until the next IDR because
+           * references were lost. A dropped non-reference picture leaves the
+           * stream decodable.
+           */
+          bool awaitingIdr() const;
+
+        private:
+          struct CaptureBuffer
+          {
+            int fd = -1;
+            size_t size = 0;
+            bool queued = false;    // With the driver
+            bool reference = false; // In the DPB
+            bool displayed = false; // A Picture::hold is still alive
+          };
+
+          /**
+           * @brief Exported capture buffers, shared with outstanding pictures so
+           * their DMA-BUFs outlive a reconfiguration or the decoder itself.
+           */
+          struct CapturePool
+          {
+            std::mutex mutex;
+            std::condition_variable released;
+            std::vector<CaptureBuffer> buffers;
+
+            ~CapturePool();
+          };
+
+          struct OutputBuffer
+          {
+            void *map = nullptr;
+            size_t length = 0;
+            int requestFd = -1;
+          };
+
+          /**
+           * @brief A reference picture, FrameNumWrap and LongTermFrameIdx as in 8.2.4.
+           */
+          struct DpbEntry
+          {
+            bool used = false;
+            bool longTerm = false;
+            uint32_t frameNum = 0;
+            uint32_t longTermFrameIdx = 0;
+            int32_t topPoc = 0;
+            int32_t bottomPoc = 0;
+            uint64_t timestampNs = 0;
+            int buffer = -1;
+          };
+
+          /**
+           * @brief Picture order count state carried from picture to picture.
+           */
+          struct PocState
+          {
+            int32_t prevPocMsb = 0;
+            uint32_t prevPocLsb = 0;
+            uint32_t prevFrameNum = 0;
+            int32_t prevFrameNumOffset = 0;
+            bool prevMmco5 = false;
+            bool prevMmco5Reference = false;
+            int32_t prevTopPoc = 0; // Of the previous reference picture, after MMCO 5
+          };
+
+          /**
+           * @brief Picture order count of the picture being decoded (8.2.1).
+           */
+          struct PictureOrder
+          {
+            int32_t topPoc = 0;
+            int32_t bottomPoc = 0;
+            int32_t pocMsb = 0;
+            int32_t frameNumOffset = 0;
+          };
+
+          static constexpr size_t cOutputBuffers = 2;
+          static constexpr size_t cMaxDevices = 16;
+          static constexpr int cDecodeTimeoutMs = 500;
+          static constexpr int cBufferWaitMs = 50;
+
+          bool findDevice();
+          bool findMediaDevice(const std::string &busInfo);
+          bool setControl(uint32_t id, int32_t value);
+          bool hasControl(uint32_t id);
+          bool configure(const H264Sps &sps);
+          void teardown();
+          int takeCaptureBuffer();
+          PictureOrder computePoc(const H264Sps &sps, const H264SliceHeader &slice) const;
+          void updatePocState(const H264SliceHeader &slice, const PictureOrder &order, bool mmco5);
+          void fillControls(const H264Sps &sps, const H264Pps &pps, const H264SliceHeader &slice,
+                            const PictureOrder &order);
+          /**
+           * @brief Reference picture marking (8.2.5) for a decoded reference picture.
+           * @return true if it carried memory_management_control_operation 5.
+           */
+          bool markReferences(const H264Sps &sps, const H264SliceHeader &slice, PictureOrder order,
+                              uint64_t timestampNs, int buffer);
+          void dropReference(DpbEntry &entry);
+          void clearDpb();
+          static int32_t frameNumWrap(const DpbEntry &entry, uint32_t currentFrameNum, uint32_t maxFrameNum);
+          bool submit(size_t outputIndex, size_t bytes, uint64_t timestampNs, int &captureIndex);
+
+          size_t extraPictures_;
+          std::string deviceName_;
+          int videoFd_;
+          int mediaFd_;
+          bool scalingMatrixControl_;
+          bool streaming_;
+          uint32_t codedWidth_;
+          uint32_t codedHeight_;
+          uint32_t maxNumRefFrames_;
+          uint32_t capturePitch_;
+          uint32_t captureHeight_;
+          std::shared_ptr<CapturePool> pool_;
+          std::array<OutputBuffer, cOutputBuffers> output_;
+          size_t nextOutput_;
+          uint64_t sequence_; // Source of capture timestamps, see submit()
+          bool awaitingIdr_;  // References were lost; skip to the next IDR
+
+          H264HeaderParser parser_;
+          std::array<DpbEntry, V4L2_H264_NUM_DPB_ENTRIES> dpb_;
+          uint32_t maxLongTermFrameIdxPlus1_; // 0: no long-term frames allowed
+          PocState poc_;
+          v4l2_ctrl_h264_sps spsControl_;
+          v4l2_ctrl_h264_pps ppsControl_;
+          v4l2_ctrl_h264_scaling_matrix scalingControl_;
+          v4l2_ctrl_h264_decode_params decodeControl_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
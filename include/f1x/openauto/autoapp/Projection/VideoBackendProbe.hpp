@@ -0,0 +1,116 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
+#include <f1x/openauto/autoapp/Projection/IVideoOutput.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Video outputs autoapp can be built with, in priority order.
+         */
+        enum class VideoBackend
+        {
+          V4l2Request, // FFmpeg DRM output decoding H.264 on V4l2RequestDecoder
+          FFmpegDrm,   // DRM hwaccel (V4L2 stateless, e.g. rkvdec) + DRM PRIME
+          GStreamer,   // appsrc ! v4l2(sl)h264dec/avdec_h264 ! kmssink
+          Omx,         // Raspberry Pi OpenMAX IL
+          Qt           // QMediaPlayer, always available
+        };
+
+        /**
+         * @brief Outcome of decoding the test stream with one backend.
+         */
+        struct VideoBackendProbeResult
+        {
+          VideoBackend backend = VideoBackend::Qt;
+          bool decoded = false;  // The test pictures came out of the decoder
+          bool hardware = false; // ...and a hardware decoder produced them
+          double fps = 0.0;      // Decoded pictures per second, fed back to back
+          int64_t latencyUs = 0; // Median write() -> decoded frame
+        };
+
+        /**
+         * @brief Chooses the video output at startup.
+         *
+         * Every compiled-in backend that can run headless decodes a short
+         * synthetic stream (H264TestStream). The first one in priority order
+         * that decoded it in hardware wins; OMX, which cannot be run without
+         * the display, comes next; then the fastest software decoder; then Qt.
+         * The choice is stored as VideoBackend in openauto.ini and reused on
+         * later boots; clear it to probe again.
+         */
+        class VideoBackendProbe
+        {
+        public:
+          /**
+           * @brief Backends built into this binary, highest priority first.
+           */
+          static std::vector<VideoBackend> compiledBackends();
+
+          static std::string name(VideoBackend backend);
+          static bool parse(const std::string &name, VideoBackend &backend);
+
+          /**
+           * @brief The stored choice if it is built in, else the highest
+           * priority backend.
+           */
+          static VideoBackend configured(const configuration::IConfiguration &configuration);
+
+          explicit VideoBackendProbe(configuration::IConfiguration::Pointer configuration);
+
+          /**
+           * @brief Returns the stored choice, probing and saving one first
+           * if there is none. Blocks for up to a few seconds on the first boot.
+           */
+          VideoBackend select();
+
+          const std::vector<VideoBackendProbeResult> &results() const;
+
+        private:
+          static bool stored(const configuration::IConfiguration &configuration, VideoBackend &backend);
+          VideoBackendProbeResult probe(VideoBackend backend) const;
+          VideoBackend choose() const;
+
+          static constexpr uint32_t cStreamWidth = 320;
+          static constexpr uint32_t cStreamHeight = 240;
+          static constexpr size_t cStreamFrames = 30;
+          // Decoders may keep the last pictures until more input arrives
+          static constexpr size_t cHeldBackFrames = 2;
+          static constexpr int64_t cFrameTimeoutMs = 500;
+
+          configuration::IConfiguration::Pointer configuration_;
+          std::vector<VideoBackendProbeResult> results_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
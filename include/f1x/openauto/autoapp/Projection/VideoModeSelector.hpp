@@ -0,0 +1,198 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <QSize>
+#include <aap_protobuf/service/media/sink/message/VideoCodecResolutionType.pb.h>
+#include <aap_protobuf/service/media/sink/message/VideoFrameRateType.pb.h>
+#include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
+#include <f1x/openauto/autoapp/Configuration/IPhoneProfilesList.hpp>
+#include <f1x/openauto/autoapp/Projection/ProjectionGeometry.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief One video configuration advertised to the phone.
+         */
+        struct VideoMode
+        {
+          aap_protobuf::service::media::sink::message::VideoCodecResolutionType resolution;
+          aap_protobuf::service::media::sink::message::VideoFrameRateType fps;
+        };
+
+        /**
+         * @brief Picks the video configuration index from measured decode headroom.
+         *
+         * The advertised modes are the configured one followed by every cheaper
+         * mode (lower pixel rate). After each session the decode latency and drop
+         * statistics from VideoTelemetry move the selection one step down when the
+         * decoder could not keep up, or one step back up when it had plenty of
+         * headroom. Lives for the whole process, like the video output.
+         *
+         * With a phone profile list each phone keeps its own selection and
+         * video ACK window: a known phone starts the session where its last
+         * one ended, and the session's decode rate, drops, stream bitrate
+         * and link RTT are folded into its profile at the end.
+         */
+        class VideoModeSelector
+        {
+        public:
+          typedef std::shared_ptr<VideoModeSelector> Pointer;
+
+          /**
+           * @param displaySize Screen the projection is shown on.
+           */
+          VideoModeSelector(configuration::IConfiguration::Pointer configuration,
+                            const QSize &displaySize);
+
+          /**
+           * @brief Modes to advertise, best first. With adaptive mode disabled
+           * only the configured mode is returned.
+           */
+          std::vector<VideoMode> modes() const;
+
+          /**
+           * @brief Index into modes() to request in the channel setup response.
+           * Each ThermalGovernor level above normal moves it one mode down, and
+           * modes whose decoder pool does not fit into free CMA, or whose
+           * stream exceeds HotspotLink::usableKbps(), are skipped.
+           */
+          size_t selectedIndex() const;
+
+          /**
+           * @brief selectedIndex() for this session's channel setup. The index
+           * is kept, so endSession() judges the mode the phone was asked for.
+           */
+          size_t serveSession();
+
+          /**
+           * @brief The ceilings of selectedIndex() on the learned index: one
+           * mode down per thermal step, then past modes whose decoder pool does
+           * not fit @p cmaFreeBytes (negative when unknown) or whose stream
+           * exceeds @p usableKbps (0 when unknown). Never past the last mode.
+           */
+          static size_t applyCeilings(const std::vector<VideoMode> &available, size_t learned,
+                                      size_t thermalSteps, int64_t cmaFreeBytes, int64_t usableKbps);
+
+          /**
+           * @brief Projection geometry of a mode. The configured margins are
+           * scaled so every mode keeps the same share of its frame.
+           */
+          ProjectionGeometry geometry(const VideoMode &mode) const;
+
+          /**
+           * @brief Geometry of the mode at selectedIndex().
+           */
+          ProjectionGeometry selectedGeometry() const;
+
+          /**
+           * @brief Feeds the statistics of the session that just ended.
+           * Ignored while the ThermalGovernor is above normal.
+           * @param snapshot Telemetry collected while the mode of serveSession()
+           * was active.
+           */
+          void endSession(const VideoTelemetrySnapshot &snapshot);
+
+          /**
+           * @brief Where learned per-phone profiles are kept; none by default.
+           */
+          void setPhoneProfiles(configuration::IPhoneProfilesList::Pointer profiles);
+
+          /**
+           * @brief The phone of the next session, named before the services
+           * are advertised. A known phone gets its learned mode back.
+           */
+          void beginSession(const std::string &phone);
+
+          /**
+           * @brief Video ACK window to grant this session: the phone's learned
+           * one, at most @p outputWindow, which the output can hold.
+           */
+          size_t maxUnacked(size_t outputWindow);
+
+          /**
+           * @brief Frame size of a codec resolution in pixels.
+           */
+          static int videoWidth(
+              aap_protobuf::service::media::sink::message::VideoCodecResolutionType resolution);
+          static int videoHeight(
+              aap_protobuf::service::media::sink::message::VideoCodecResolutionType resolution);
+
+          /**
+           * @brief Decoded pixels per second of a mode.
+           */
+          static double pixelRate(const VideoMode &mode);
+
+          /**
+           * @brief Frame interval of a mode in microseconds.
+           */
+          static int64_t frameIntervalUs(const VideoMode &mode);
+
+          /**
+           * @brief Bitrate a phone typically encodes a mode at.
+           */
+          static int64_t streamKbps(const VideoMode &mode);
+
+        private:
+          // Sessions shorter than this say little about sustained decode load
+          static constexpr size_t cMinSamples = 300;
+          // Step down when p99 decode time uses more than this share of a frame
+          static constexpr double cOverloadShare = 0.9;
+          // Step up when p99, scaled to the better mode, stays below this share
+          static constexpr double cHeadroomShare = 0.5;
+          // Phones encode H.264 at roughly 0.15 bit per pixel: 1080p60 is ~19 Mbit/s
+          static constexpr double cStreamBitsPerPixel = 0.15;
+          // Weight of the newest session in a profile's running averages
+          static constexpr double cProfileWeight = 0.5;
+
+          size_t ceilingIndex(const std::vector<VideoMode> &available) const;
+          void adapt(const VideoTelemetrySnapshot &snapshot, const std::vector<VideoMode> &available,
+                     size_t served);
+          void learn(const VideoTelemetrySnapshot &snapshot, const VideoMode &mode);
+
+          configuration::IConfiguration::Pointer configuration_;
+          QSize displaySize_;
+          mutable std::mutex mutex_;
+          size_t selectedIndex_; // Learned, before the ceilings
+          size_t servedIndex_;   // Asked of the phone this session
+          bool served_;
+          configuration::IPhoneProfilesList::Pointer profiles_;
+          std::string phone_;   // Empty while the session's phone is unknown
+          size_t maxUnacked_;   // Granted this session, 0 before setup
+          size_t outputWindow_; // What the output could have held
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -39,6 +39,7 @@ public:
     aap_protobuf::service::media::sink::message::VideoCodecResolutionType getVideoResolution() const override;
     size_t getScreenDPI() const override;
     QRect getVideoMargins() const override;
+    size_t getMaxUnackedFrames() const override;
 
 protected:
     configuration::IConfiguration::Pointer configuration_;
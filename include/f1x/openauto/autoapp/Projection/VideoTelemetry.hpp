@@ -0,0 +1,178 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Pipeline timestamps of one video frame, in microseconds on the
+         * monotonic clock (see VideoTelemetry::nowUs()). 0 means "not reached".
+         */
+        struct VideoFrameTiming
+        {
+          int64_t arrivalUs = 0; // AAP media message handed to write()
+          int64_t sendUs = 0;    // avcodec_send_packet()
+          int64_t receiveUs = 0; // avcodec_receive_frame() returned the frame
+          int64_t commitUs = 0;  // Plane commit issued
+          int64_t flipUs = 0;    // Page flip completed (frame on screen)
+          int probeLuma = -1;    // TouchLatencyProbe sample, -1 when not measuring
+        };
+
+        /**
+         * @brief Percentiles over the samples currently in a LatencyWindow.
+         */
+        struct LatencyStats
+        {
+          int64_t p50Us = 0;
+          int64_t p99Us = 0;
+          size_t samples = 0;
+        };
+
+        /**
+         * @brief Fixed-size window over the most recent latency samples.
+         * Old samples are overwritten, so percentiles follow the current drive
+         * rather than the whole process lifetime.
+         */
+        class LatencyWindow
+        {
+        public:
+          static constexpr size_t cDefaultCapacity = 512;
+
+          explicit LatencyWindow(size_t capacity = cDefaultCapacity);
+
+          void add(int64_t valueUs);
+          void clear();
+          size_t count() const;
+
+          /**
+           * @brief Nearest-rank percentile of the window.
+           * @param percent 0..100.
+           * @return Sample value, or 0 when the window is empty.
+           */
+          int64_t percentile(double percent) const;
+
+          LatencyStats stats() const;
+
+        private:
+          std::vector<int64_t> samples_;
+          size_t next_;
+          size_t count_;
+        };
+
+        /**
+         * @brief Point-in-time copy of the video pipeline statistics.
+         */
+        struct VideoTelemetrySnapshot
+        {
+          LatencyStats decode;   // send_packet -> receive_frame
+          LatencyStats display;  // receive_frame -> page flip
+          LatencyStats endToEnd; // AAP arrival -> page flip
+          uint64_t framesDisplayed = 0;
+          uint64_t packetsDropped = 0;
+          uint64_t bytesReceived = 0; // Encoded video from the phone
+          int64_t receivingUs = 0;    // First packet to the last one
+        };
+
+        /**
+         * @brief Process-wide frame pacing and latency statistics.
+         *
+         * The video output records one VideoFrameTiming per displayed frame from
+         * its presentation thread; UIBackend and exporters read snapshots from
+         * any thread.
+         */
+        class VideoTelemetry
+        {
+        public:
+          static VideoTelemetry &instance();
+
+          /**
+           * @brief Current CLOCK_MONOTONIC time in microseconds, the same clock
+           * DRM uses for page flip event timestamps.
+           */
+          static int64_t nowUs();
+
+          /**
+           * @brief Records a frame that reached the screen.
+           */
+          void recordFrame(const VideoFrameTiming &timing);
+
+          /**
+           * @brief Counts a packet dropped before decode.
+           */
+          void recordDroppedPacket();
+
+          /**
+           * @brief Counts an encoded packet as it arrives from the phone.
+           */
+          void recordPacket(size_t bytes);
+
+          /**
+           * @brief Clears all samples and counters (start of a session).
+           */
+          void reset();
+
+          VideoTelemetrySnapshot snapshot() const;
+
+          /**
+           * @brief Frames recorded since reset(), without computing percentiles.
+           */
+          uint64_t framesDisplayed() const;
+
+          /**
+           * @brief Single-line human readable summary for logs and the debug UI.
+           */
+          std::string summary() const;
+
+          /**
+           * @brief Statistics in Prometheus text exposition format.
+           */
+          std::string exportText() const;
+
+        private:
+          VideoTelemetry() = default;
+
+          mutable std::mutex mutex_;
+          LatencyWindow decode_;
+          LatencyWindow display_;
+          LatencyWindow endToEnd_;
+          uint64_t framesDisplayed_ = 0;
+          uint64_t packetsDropped_ = 0;
+          uint64_t bytesReceived_ = 0;
+          int64_t firstPacketUs_ = 0;
+          int64_t lastPacketUs_ = 0;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,138 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
+#include <f1x/openauto/autoapp/Projection/EchoReference.hpp>
+#include <f1x/openauto/autoapp/Projection/LockFreeRingBuffer.hpp>
+#include <f1x/openauto/autoapp/Projection/VoiceProcessor.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Runs a VoiceProcessor between the capture callback and the
+         * microphone service, on its own thread.
+         *
+         * Capture writes raw samples into input() and calls notify(); the
+         * thread processes whole frames against the mixer's EchoReference
+         * and queues the result in output() for the io thread. All three
+         * hand-offs are SPSC rings, so neither RT callback ever waits on
+         * the DSP. The thread is pinned to one core (the last by default,
+         * leaving the others to video decode and the io_service workers).
+         *
+         * In Full mode the processing time is watched: if it stays above
+         * cCpuBudget of real time the stage drops to LowCpu for the rest of
+         * the session.
+         */
+        class VoiceProcessingStage
+        {
+        public:
+          typedef std::shared_ptr<VoiceProcessingStage> Pointer;
+          typedef RuntimeRingBuffer Ring;
+
+          // Reference held queued ahead of the microphone, and the most
+          // allowed before the excess is discarded
+          static constexpr uint32_t cReferenceLeadMs = 10;
+          static constexpr uint32_t cReferenceMaxLeadMs = 80;
+          static constexpr float cCpuBudget = 0.5f;
+          // Microphone queued on either side of the thread
+          static constexpr uint32_t cRingMs = 1000;
+          static constexpr uint32_t cLowMemoryRingMs = 250;
+
+          /**
+           * @param reference Mixer output, or nullptr for noise suppression only
+           * @param cpu Core to pin the thread to; negative picks the last core
+           */
+          VoiceProcessingStage(uint32_t sampleRate, VoiceProcessingMode mode,
+                               EchoReference::Pointer reference, int32_t cpu);
+          ~VoiceProcessingStage();
+
+          /**
+           * @brief Starts the thread. @p onOutput runs on it after each batch
+           * of frames is queued in output().
+           */
+          bool start(std::function<void()> onOutput);
+          void stop();
+
+          /**
+           * @brief Producer side for the capture callback.
+           */
+          Ring &input();
+
+          /**
+           * @brief Consumer side for the io thread.
+           */
+          Ring &output();
+
+          /**
+           * @brief Wakes the thread; RT-safe (one eventfd write).
+           */
+          void notify();
+
+        private:
+          void processLoop();
+          // Next frame of reference at the microphone rate, or nullptr when
+          // the mixer has produced nothing
+          const int16_t *takeReference();
+          void checkBudget(std::chrono::steady_clock::duration busy);
+          void pinThread();
+
+          VoiceProcessor processor_;
+          EchoReference::Pointer reference_;
+          uint32_t referenceRatio_;
+          const int32_t cpu_;
+          Ring input_;
+          Ring output_;
+          MemoryCharge memory_;
+          int wakeupFd_;
+          std::thread thread_;
+          std::atomic<bool> running_;
+          std::function<void()> onOutput_;
+
+          // Processing thread state
+          std::vector<int16_t> microphone_;
+          std::vector<int16_t> processed_;
+          std::vector<int16_t> referenceInput_;
+          std::vector<int16_t> referenceFrame_;
+          std::chrono::steady_clock::duration busy_;
+          uint32_t budgetFrames_;
+          uint64_t frames_;
+          uint64_t referenceUnderruns_;
+          uint64_t outputOverruns_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
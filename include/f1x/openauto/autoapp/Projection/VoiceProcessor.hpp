@@ -0,0 +1,152 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef USE_SPEEXDSP
+struct SpeexEchoState_;
+struct SpeexPreprocessState_;
+#endif
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief How much CPU the microphone DSP may use.
+         *
+         * Full: 64 ms echo tail adapted every sample. LowCpu (the default on
+         * the A7): 48 ms tail adapted every other sample, which roughly
+         * halves the cost and still covers the mixer's low-latency period
+         * plus the capture period.
+         */
+        enum class VoiceProcessingMode
+        {
+          Full,
+          LowCpu
+        };
+
+        /**
+         * @brief Echo cancellation and noise suppression for 16-bit mono
+         * microphone audio, one frame of cFrameMs at a time.
+         *
+         * The built-in chain is a 100 Hz high-pass (road rumble), a
+         * time-domain NLMS echo canceller with a Geigel-style double-talk
+         * detector, a residual echo suppressor and a noise-floor tracking
+         * suppressor limited to cMaxSuppressionDb. Built with USE_SPEEXDSP, SpeexDSP's
+         * MDF canceller and preprocessor replace everything after the
+         * high-pass. process() never allocates.
+         */
+        class VoiceProcessor
+        {
+        public:
+          static constexpr uint32_t cFrameMs = 10;
+          static constexpr float cMaxSuppressionDb = 15.0f;
+
+          VoiceProcessor(uint32_t sampleRate, VoiceProcessingMode mode);
+          ~VoiceProcessor();
+
+          VoiceProcessor(const VoiceProcessor &) = delete;
+          VoiceProcessor &operator=(const VoiceProcessor &) = delete;
+
+          size_t frameSamples() const;
+          uint32_t getSampleRate() const;
+
+          /**
+           * @brief Switches the echo tail and adaptation rate; learned state
+           * is kept.
+           */
+          void setMode(VoiceProcessingMode mode);
+          VoiceProcessingMode getMode() const;
+
+          /**
+           * @brief Processes one frame.
+           * @param reference frameSamples() of what the speakers played at
+           * the same rate, or nullptr when nothing is playing (echo
+           * cancellation is skipped, noise suppression still runs)
+           * @param output May be the same buffer as @p microphone
+           */
+          void process(const int16_t *microphone, const int16_t *reference, int16_t *output);
+
+          /**
+           * @brief Forgets the echo path and noise estimate.
+           */
+          void reset();
+
+        private:
+          void highPass(const int16_t *input, float *output);
+          // Built-in chain; error_ holds the result in place
+          void cancelEcho(const int16_t *reference);
+          void suppressNoise();
+
+          const uint32_t sampleRate_;
+          const size_t frameSamples_;
+          const size_t maxTaps_;
+          VoiceProcessingMode mode_;
+          size_t taps_;
+          size_t adaptStride_;
+
+          // High-pass biquad (direct form I)
+          float hpB_[3];
+          float hpA_[2];
+          float hpX_[2];
+          float hpY_[2];
+
+          // NLMS: weights, newest-last reference history (mirrored so the
+          // last maxTaps_ samples are always contiguous) and its energy
+          std::vector<float> weights_;
+          std::vector<float> history_;
+          size_t historyPos_;
+          float historyEnergy_;
+          // Per-frame peak |reference| over the echo tail, and the near/far
+          // peak ratio seen without a near-end talker, for double talk
+          std::vector<float> referencePeaks_;
+          size_t peakPos_;
+          uint32_t doubleTalkHold_;
+          float echoReturn_;
+          float echoGain_;
+
+          // Noise floor of the echo-cancelled signal, negative until the
+          // first frame; gains are ramped across each frame
+          float noiseFloor_;
+          float noiseGain_;
+          float appliedGain_;
+          std::vector<float> error_;
+
+#ifdef USE_SPEEXDSP
+          SpeexEchoState_ *echoState_;
+          SpeexPreprocessState_ *preprocessState_;
+          std::vector<int16_t> filtered_;
+          std::vector<int16_t> silence_;
+#endif
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
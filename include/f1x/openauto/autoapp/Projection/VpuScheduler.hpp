@@ -0,0 +1,141 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief The streams that share the hardware decoder.
+         */
+        enum class VpuStream
+        {
+          Main,       // The head unit display
+          RearCamera, // A camera that arrives encoded
+          Cluster,    // Secondary cluster display
+          Count
+        };
+
+        /**
+         * @brief What a stream loses when it is refused a decode.
+         */
+        enum class VpuDropPolicy
+        {
+          Never,        // Always decoded; for the stream whose latency counts
+          UntilKeyFrame // Everything up to the next IDR goes, since later frames reference it
+        };
+
+        struct VpuStreamPolicy
+        {
+          int priority = 0;                 // Lower goes first
+          uint32_t maxSharePermille = 1000; // Decoder time it may take per 1000
+          VpuDropPolicy drop = VpuDropPolicy::UntilKeyFrame;
+        };
+
+        /**
+         * @brief Arbitrates rkvdec between the streams that decode on it.
+         *
+         * rkvdec decodes one picture at a time, so a cluster frame that
+         * starts just before a main frame adds its whole decode time to the
+         * main display's latency. Every decode asks admit() first: a stream
+         * is refused while a stream of higher priority is decoding or while
+         * it is over its share of the last cWindowUs, unless the frame is an
+         * IDR. A refused reference frame sets its stream skipping to the next
+         * IDR; a refused non-reference frame costs nothing else. Streams
+         * with VpuDropPolicy::Never are always admitted. Thread-safe; each
+         * stream's decode thread calls it.
+         */
+        class VpuScheduler
+        {
+        public:
+          static constexpr int64_t cWindowUs = 1000000;
+
+          static VpuScheduler &instance();
+
+          /**
+           * @brief Main first and never dropped, then the rear camera, then
+           * the cluster at a quarter of the decoder.
+           */
+          static VpuStreamPolicy defaultPolicy(VpuStream stream);
+
+          VpuScheduler();
+
+          void setPolicy(VpuStream stream, const VpuStreamPolicy &policy);
+
+          /**
+           * @brief A stream's decoder was opened or closed. Closing forgets
+           * its share and its skip.
+           */
+          void attach(VpuStream stream);
+          void detach(VpuStream stream);
+
+          /**
+           * @brief Whether a picture of @p stream may go to the decoder now.
+           * @param reference False for a picture nothing else is predicted
+           * from, which can go alone.
+           * @return True if it was admitted; finished() must follow.
+           */
+          bool admit(VpuStream stream, bool keyFrame, bool reference, int64_t nowUs);
+
+          /**
+           * @brief The admitted picture of @p stream left the decoder.
+           */
+          void finished(VpuStream stream, int64_t nowUs);
+
+          /**
+           * @brief Decoder time of @p stream over the last cWindowUs, per 1000.
+           */
+          uint32_t sharePermille(VpuStream stream, int64_t nowUs) const;
+
+        private:
+          struct StreamState
+          {
+            VpuStreamPolicy policy;
+            bool attached = false;
+            bool decoding = false;
+            bool awaitingKeyFrame = false;
+            int64_t decodeStartUs = 0;
+            // Decoder time in the current and the previous window
+            int64_t busyUs = 0;
+            int64_t previousBusyUs = 0;
+            int64_t windowStartUs = 0;
+          };
+
+          static void roll(StreamState &state, int64_t nowUs);
+          static uint32_t share(const StreamState &state, int64_t nowUs);
+
+          mutable std::mutex mutex_;
+          std::array<StreamState, static_cast<size_t>(VpuStream::Count)> streams_;
+        };
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,80 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        /**
+         * @brief Copies one image plane row by row between buffers with different strides.
+         * @param dst Destination plane.
+         * @param dstPitch Destination stride in bytes.
+         * @param src Source plane.
+         * @param srcPitch Source stride in bytes.
+         * @param widthBytes Bytes to copy per row.
+         * @param height Number of rows.
+         */
+        void copyPlane(uint8_t *dst, int dstPitch, const uint8_t *src, int srcPitch,
+                       int widthBytes, int height);
+
+        /**
+         * @brief Interleaves separate U and V planes into one NV12 UV plane.
+         * Uses NEON (vst2q_u8) when available, so the VOP can scan out a
+         * software-decoded YUV420P frame without any colour conversion on the CPU.
+         * @param dst Destination UV plane.
+         * @param dstPitch Destination stride in bytes.
+         * @param srcU Source U plane.
+         * @param srcUPitch U plane stride in bytes.
+         * @param srcV Source V plane.
+         * @param srcVPitch V plane stride in bytes.
+         * @param chromaWidth Chroma samples per row (luma width / 2).
+         * @param chromaHeight Chroma rows (luma height / 2).
+         */
+        void interleaveChroma(uint8_t *dst, int dstPitch, const uint8_t *srcU,
+                              int srcUPitch, const uint8_t *srcV, int srcVPitch,
+                              int chromaWidth, int chromaHeight);
+
+        /**
+         * @brief Box-filters an NV12 image down to packed RGB888 with BT.709
+         * coefficients, the encoding setupColorEncoding() gives the plane.
+         * Meant for occasional snapshots, not for the display path.
+         * @param dst Destination, dstWidth * 3 bytes per row.
+         * @param luma Source Y plane.
+         * @param chroma Source interleaved UV plane.
+         * @param width Source width in pixels (even).
+         * @param height Source height in pixels (even).
+         * @param fullRange Source uses 0-255 rather than 16-235 levels.
+         */
+        void downscaleNv12ToRgb(uint8_t *dst, int dstWidth, int dstHeight,
+                                const uint8_t *luma, int lumaPitch,
+                                const uint8_t *chroma, int chromaPitch,
+                                int width, int height, bool fullRange);
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
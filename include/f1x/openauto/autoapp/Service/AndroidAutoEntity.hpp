@@ -19,6 +19,11 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 #include <boost/asio.hpp>
 #include <aasdk/Transport/ITransport.hpp>
 #include <aasdk/Channel/Control/IControlServiceChannel.hpp>
@@ -28,6 +33,7 @@
 #include <f1x/openauto/autoapp/Service/IAndroidAutoEntity.hpp>
 #include <f1x/openauto/autoapp/Service/IService.hpp>
 #include <f1x/openauto/autoapp/Service/IPinger.hpp>
+#include <f1x/openauto/autoapp/Service/ShutdownCoordinator.hpp>
 #include <Transport/ITransport.hpp>
 #include <aap_protobuf/service/control/message/AudioFocusRequestType.pb.h>
 #include <aap_protobuf/service/control/message/AudioFocusStateType.pb.h>
@@ -54,6 +60,14 @@ public:
                       IPinger::Pointer pinger);
     ~AndroidAutoEntity() override;
 
+    typedef std::function<void(aap_protobuf::service::control::message::AudioFocusRequestType)> AudioFocusHandler;
+    // Told each focus request, and a release once the session stops; set before start()
+    void setAudioFocusHandler(AudioFocusHandler handler);
+
+    typedef std::function<void(const std::string& phone)> PhoneIdentityHandler;
+    // Told the phone's model before the services fill in the discovery response
+    void setPhoneIdentityHandler(PhoneIdentityHandler handler);
+
     void start(IAndroidAutoEntityEventHandler& eventHandler) override;
     void stop() override;
     void pause() override;
@@ -77,6 +91,7 @@ private:
     void triggerQuit();
     void schedulePing();
     void sendPing();
+    void onServicesStopped(std::chrono::steady_clock::time_point started, const std::vector<std::string>& overran);
 
     boost::asio::io_service::strand strand_;
     aasdk::messenger::ICryptor::Pointer cryptor_;
@@ -87,8 +102,12 @@ private:
     ServiceList serviceList_;
     IPinger::Pointer pinger_;
     IAndroidAutoEntityEventHandler* eventHandler_;
+    AudioFocusHandler audioFocusHandler_;
+    PhoneIdentityHandler phoneIdentityHandler_;
     // Guard to avoid re-entrant quit handling and spurious error-triggered quits during shutdown
     std::atomic<bool> stopping_{false};
+    // Set by the first stop(); outlives the steps still running past their deadline
+    std::unique_ptr<ShutdownCoordinator> shutdown_;
 };
 
 }
@@ -43,12 +43,20 @@ public:
     IAndroidAutoEntity::Pointer create(aasdk::usb::IAOAPDevice::Pointer aoapDevice) override;
     IAndroidAutoEntity::Pointer create(aasdk::tcp::ITCPEndpoint::Pointer tcpEndpoint) override;
 
+    // Parses the certificate and key and builds the shared SSL_CTX, so the
+    // first phone does not wait for it. Any thread; blocks while it works
+    static void prepareTls(const configuration::IConfiguration& configuration);
+
 private:
-    IAndroidAutoEntity::Pointer create(aasdk::transport::ITransport::Pointer transport);
+    static bool prefersChaCha(const configuration::IConfiguration& configuration);
+
+    IAndroidAutoEntity::Pointer create(aasdk::transport::ITransport::Pointer transport, const std::string& sessionKey);
 
     boost::asio::io_service& ioService_;
     configuration::IConfiguration::Pointer configuration_;
     IServiceFactory& serviceFactory_;
+    // "auto" (the default) prefers ChaCha20 on CPUs without AES instructions
+    const bool preferChaCha_;
 };
 
 }
@@ -0,0 +1,72 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <aasdk/Transport/SSLWrapper.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace service
+{
+
+/**
+ * @brief CachingSSLWrapper - SSLWrapper sharing TLS state across connections
+ *
+ * The headunit certificate and key are parsed, and the SSL_CTX built, once
+ * per process; every Cryptor gets a reference to the same objects, so its
+ * usual free() calls stay balanced. Sessions the phone issues are kept per
+ * @p sessionKey and offered on the next connection, so a reconnect resumes
+ * instead of running a full handshake. A phone that declines simply gets a
+ * full one. The cipher order follows applyCipherPreference().
+ */
+class CachingSSLWrapper: public aasdk::transport::SSLWrapper
+{
+public:
+    // @p preferChaCha takes effect for the process when the shared context is built
+    CachingSSLWrapper(std::string sessionKey, bool resumeSessions, bool preferChaCha);
+
+    X509* readCertificate(const std::string& certificate) override;
+    EVP_PKEY* readPrivateKey(const std::string& privateKey) override;
+    SSL_CTX* createContext(const SSL_METHOD* method) override;
+    bool useCertificate(SSL_CTX* context, X509* certificate) override;
+    bool usePrivateKey(SSL_CTX* context, EVP_PKEY* privateKey) override;
+    SSL* createInstance(SSL_CTX* context) override;
+    int doHandshake(SSL* ssl) override;
+
+private:
+    static int onNewSession(SSL* ssl, SSL_SESSION* session);
+
+    const std::string sessionKey_;
+    const bool resumeSessions_;
+    const bool preferChaCha_;
+    std::chrono::steady_clock::time_point handshakeStart_;
+    bool handshakeDone_;
+};
+
+}
+}
+}
+}
@@ -0,0 +1,76 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <boost/asio/io_service.hpp>
+#include <f1x/openauto/autoapp/Service/IService.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace service
+{
+
+/**
+ * Stands in for a service the first video frame does not depend on. The
+ * real service is built on the io_service once the entity has started,
+ * i.e. while the phone works on the version exchange and TLS handshake,
+ * or at the latest when service discovery needs its features. A session
+ * stopped before then never builds it.
+ */
+class DeferredService: public IService, public std::enable_shared_from_this<DeferredService>
+{
+public:
+    typedef std::function<IService::Pointer()> Factory;
+
+    DeferredService(boost::asio::io_service& ioService, std::string name, Factory factory);
+
+    void start() override;
+    void stop() override;
+    void shutdown(std::function<void()> done) override;
+    bool holdsDevices() const override;
+    std::string name() const override { return name_; }
+    void pause() override;
+    void resume() override;
+    void fillFeatures(aap_protobuf::service::control::message::ServiceDiscoveryResponse& response) override;
+
+private:
+    using std::enable_shared_from_this<DeferredService>::shared_from_this;
+
+    // Builds the service on first use, starting it if the entity already has
+    IService::Pointer get();
+
+    boost::asio::io_service& ioService_;
+    const std::string name_;
+    Factory factory_;
+    mutable std::mutex mutex_;
+    IService::Pointer service_;
+    bool started_;
+};
+
+}
+}
+}
+}
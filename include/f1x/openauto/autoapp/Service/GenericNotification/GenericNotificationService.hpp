@@ -20,7 +20,9 @@
 
 #include <aasdk/Channel/GenericNotification/GenericNotificationService.hpp>
 #include <f1x/openauto/autoapp/Service/IService.hpp>
+#include <f1x/openauto/autoapp/Service/GenericNotification/NotificationQueue.hpp>
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <aasdk/Messenger/IMessenger.hpp>
 
 namespace f1x {
@@ -29,6 +31,13 @@ namespace f1x {
       namespace service {
         namespace genericnotification {
 
+          /**
+           * @brief Shows the phone's notifications as toasts.
+           *
+           * Runs on the general io_service, never a media one: queueing,
+           * coalescing and the rate limit's timer all stay on this service's
+           * strand, and only the settled toasts are handed to the GUI thread.
+           */
           class GenericNotificationService :
               public aasdk::channel::genericnotification::IGenericNotificationServiceEventHandler,
               public IService,
@@ -46,12 +55,22 @@ namespace f1x {
 
             void onChannelError(const aasdk::error::Error &e) override;
 
+            // Any thread. Notifications arriving while stopped are dropped
+            void post(Notification notification);
+            void dismiss(const std::string &id);
 
           private:
             using std::enable_shared_from_this<GenericNotificationService>::shared_from_this;
+
+            void flush();
+            void publish();
+
             boost::asio::io_service::strand strand_;
-            boost::asio::deadline_timer timer_;
+            boost::asio::steady_timer timer_;
+            NotificationQueue::Clock::time_point flushAt_ = NotificationQueue::Clock::time_point::max();
             aasdk::channel::genericnotification::GenericNotificationService::Pointer channel_;
+            NotificationQueue queue_;
+            bool running_ = false;
           };
 
         }
@@ -0,0 +1,96 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace f1x::openauto::autoapp::service::genericnotification {
+
+  struct Notification {
+    std::string id;
+    std::string title;
+    std::string text;
+  };
+
+  /**
+   * @brief Coalesces phone notifications into the few toasts on screen.
+   *
+   * Offers are held, keyed by id, until collect() publishes them; an id that
+   * is offered again replaces its held text instead of queueing another toast.
+   * At most @p burst publishes happen per @p window, so a group chat sending
+   * dozens of messages a second turns into a handful of toast updates. Shown
+   * toasts keep their position when updated and expire after @p lifetime.
+   */
+  class NotificationQueue {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry {
+      Notification notification;
+      uint32_t count = 1;  // offers folded into this toast
+      Clock::time_point shownAt;
+    };
+
+    static constexpr size_t cCapacity = 4;
+    static constexpr size_t cBurst = 3;
+    static constexpr std::chrono::milliseconds cWindow{2000};
+    static constexpr std::chrono::milliseconds cLifetime{8000};
+
+    NotificationQueue(size_t capacity = cCapacity, size_t burst = cBurst,
+                      Clock::duration window = cWindow, Clock::duration lifetime = cLifetime);
+
+    void offer(Notification notification);
+    // Both return true if the shown toasts changed
+    bool dismiss(const std::string &id);
+    bool clear();
+
+    // Publishes what is due at @p now; true if the shown toasts changed
+    bool collect(Clock::time_point now);
+    // When collect() has something to do next; Clock::time_point::max() if never
+    Clock::time_point nextDue() const;
+
+    // Oldest first, at most the capacity
+    const std::vector<Entry> &shown() const;
+    // Offers dropped because more distinct ids were held than fit on screen
+    uint64_t dropped() const;
+
+  private:
+    struct Held {
+      Notification notification;
+      uint32_t count;
+    };
+
+    bool expire(Clock::time_point now);
+    void show(Held held, Clock::time_point now);
+
+    size_t capacity_;
+    size_t burst_;
+    Clock::duration window_;
+    Clock::duration lifetime_;
+    std::vector<Held> held_;
+    std::vector<Entry> shown_;
+    std::deque<Clock::time_point> published_;
+    uint64_t dropped_ = 0;
+  };
+
+}
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <aasdk/IO/Promise.hpp>
 
 namespace f1x
@@ -37,7 +38,9 @@ public:
 
     virtual ~IPinger() = default;
     virtual void ping(Promise::Pointer promise) = 0;
-    virtual void pong() = 0;
+    // The request carrying @p timestamp went out; pong() with the echo measures it
+    virtual void pingSent(int64_t timestamp) = 0;
+    virtual void pong(int64_t timestamp) = 0;
     virtual void cancel() = 0;
 };
 
@@ -18,8 +18,10 @@
 
 #pragma once
 
+#include <functional>
 #include <vector>
 #include <memory>
+#include <string>
 #include <f1x/openauto/Common/Log.hpp>
 #include <aap_protobuf/service/control/message/ServiceDiscoveryResponse.pb.h>
 #include <aap_protobuf/shared/MessageStatus.pb.h>
@@ -42,6 +44,20 @@ namespace f1x::openauto::autoapp::service {
     virtual void resume() = 0;
 
     virtual void fillFeatures(aap_protobuf::service::control::message::ServiceDiscoveryResponse &response) = 0;
+
+    // stop(), then @p done once the service has let go of its resources, on
+    // whichever thread that happens. Services whose stop() posts the work to
+    // their strand call it from there.
+    virtual void shutdown(std::function<void()> done) {
+      stop();
+      if (done) done();
+    }
+
+    // Stopped ahead of the others, as the next session needs these devices
+    virtual bool holdsDevices() const { return false; }
+
+    // For the shutdown report; empty falls back to the class name
+    virtual std::string name() const { return std::string(); }
   };
 
   typedef std::vector<IService::Pointer> ServiceList;
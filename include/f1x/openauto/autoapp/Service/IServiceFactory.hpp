@@ -18,7 +18,9 @@
 
 #pragma once
 
+#include <string>
 #include <aasdk/Messenger/IMessenger.hpp>
+#include <aap_protobuf/service/control/message/AudioFocusRequestType.pb.h>
 #include <f1x/openauto/autoapp/Service/IService.hpp>
 
 namespace f1x
@@ -36,6 +38,10 @@ public:
     virtual ~IServiceFactory() = default;
 
     virtual ServiceList create(aasdk::messenger::IMessenger::Pointer messenger) = 0;
+    // The phone's audio focus requests, and a release when its session ends
+    virtual void onPhoneAudioFocus(aap_protobuf::service::control::message::AudioFocusRequestType) {}
+    // The phone's model from service discovery, before the services are advertised
+    virtual void onPhoneIdentified(const std::string&) {}
 };
 
 }
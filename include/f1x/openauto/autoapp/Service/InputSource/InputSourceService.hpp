@@ -18,11 +18,16 @@
 
 #pragma once
 
+#include <chrono>
+#include <mutex>
+#include <boost/asio/steady_timer.hpp>
 #include <aap_protobuf/service/media/sink/message/KeyCode.pb.h>
+#include <aap_protobuf/service/inputsource/message/InputReport.pb.h>
 #include <aasdk/Channel/InputSource/InputSourceService.hpp>
 #include <f1x/openauto/autoapp/Service/IService.hpp>
 #include <f1x/openauto/autoapp/Projection/IInputDevice.hpp>
 #include <f1x/openauto/autoapp/Projection/IInputDeviceEventHandler.hpp>
+#include <f1x/openauto/autoapp/Service/InputSource/TouchPredictor.hpp>
 
 namespace f1x {
   namespace openauto {
@@ -36,8 +41,14 @@ namespace f1x {
               public projection::IInputDeviceEventHandler,
               public std::enable_shared_from_this<InputSourceService> {
           public:
+            // Moves arriving within touchCoalesceWindow of the last sent one are
+            // merged into a single report; zero sends every move at once.
+            // Drags are sent touchPrediction ahead of the finger; zero is off,
+            // negative follows the measured video latency.
             InputSourceService(boost::asio::io_service &ioService, aasdk::messenger::IMessenger::Pointer messenger,
-                               projection::IInputDevice::Pointer inputDevice);
+                               projection::IInputDevice::Pointer inputDevice,
+                               std::chrono::microseconds touchCoalesceWindow = std::chrono::microseconds::zero(),
+                               std::chrono::microseconds touchPrediction = std::chrono::microseconds::zero());
 
             void start() override;
             void stop() override;
@@ -59,9 +70,43 @@ namespace f1x {
           private:
             using std::enable_shared_from_this<InputSourceService>::shared_from_this;
 
+            void scheduleMoveFlush();
+            void flushPendingMove();
+            // @p mayPredict false sends the real positions of a move
+            void sendTouchEvent(const projection::TouchEvent &event, std::chrono::microseconds timestamp,
+                                bool mayPredict = true);
+            // The head unit's share of the lag: AAP arrival to page flip
+            void updatePredictionHorizon();
+            void scheduleSettle();
+
             boost::asio::io_service::strand strand_;
             aasdk::channel::inputsource::InputSourceService::Pointer channel_;
             projection::IInputDevice::Pointer inputDevice_;
+            std::chrono::microseconds touchCoalesceWindow_;
+            boost::asio::steady_timer moveTimer_;
+            std::chrono::steady_clock::time_point lastMoveSent_;
+
+            // Latest move not yet sent, written by the GUI thread
+            std::mutex pendingMutex_;
+            projection::TouchEvent pendingMove_;
+            std::chrono::microseconds pendingTimestamp_;
+            bool movePending_;
+
+            // Reused on the strand so steady dragging does not allocate per report
+            projection::TouchEvent sendingMove_;
+            aap_protobuf::service::inputsource::message::InputReport touchReport_;
+
+            // Without a move for this long the finger has stopped, and the
+            // real positions go out so the phone is not left at the prediction
+            static constexpr std::chrono::microseconds cSettleDelay{40000};
+            // Percentiles over fewer frames than this are not a latency yet
+            static constexpr size_t cMinLatencySamples = 30;
+
+            TouchPredictor predictor_;
+            const bool autoPrediction_;
+            boost::asio::steady_timer settleTimer_;
+            // Real positions of the last predicted move; strand only
+            projection::TouchEvent realMove_;
           };
 
         }
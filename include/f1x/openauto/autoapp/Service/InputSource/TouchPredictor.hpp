@@ -0,0 +1,98 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <f1x/openauto/autoapp/Projection/InputEvent.hpp>
+
+namespace f1x {
+  namespace openauto {
+    namespace autoapp {
+      namespace service {
+        namespace inputsource {
+
+          /**
+           * @brief Extrapolates dragging fingers ahead by the pipeline's latency.
+           *
+           * Each pointer keeps its last few reported positions. A move is sent
+           * where a least-squares line through them puts the finger horizon()
+           * from now, so a panned map keeps up with the finger instead of
+           * trailing it by the touch-to-photon delay. The lead is capped at
+           * cMaxLeadPx and the result kept on the touchscreen. Downs and ups
+           * always carry the real position, and a finger that just went down
+           * is not predicted until it has cMinSamples positions.
+           */
+          class TouchPredictor {
+          public:
+            // Pointer ids come from 10-slot tables on every touch path
+            static constexpr size_t cMaxPointers = 10;
+            static constexpr size_t cHistory = 6;
+            static constexpr size_t cMinSamples = 3;
+            // Positions older than this, relative to the newest, say nothing
+            // about where the finger is heading
+            static constexpr int64_t cMaxSampleAgeUs = 60000;
+            static constexpr int64_t cMaxHorizonUs = 50000;
+            static constexpr double cMaxLeadPx = 80.0;
+
+            // Zero turns prediction off; capped at cMaxHorizonUs
+            void setHorizon(std::chrono::microseconds horizon);
+            std::chrono::microseconds horizon() const { return horizon_; }
+            bool enabled() const { return horizon_.count() > 0; }
+
+            // Touchscreen size, in the coordinates of the touch events
+            void setBounds(uint32_t width, uint32_t height);
+
+            // Records the real positions of @p event; downs and ups start and
+            // end a pointer's track
+            void observe(const projection::TouchEvent &event, std::chrono::microseconds timestamp);
+
+            // Where @p pointer will be after horizon(); its own position
+            // without enough recent history
+            projection::TouchPoint predict(const projection::TouchPoint &pointer) const;
+
+          private:
+            struct Sample {
+              int64_t atUs = 0;
+              double x = 0.0;
+              double y = 0.0;
+            };
+
+            struct Track {
+              std::array<Sample, cHistory> samples;
+              size_t count = 0;
+              size_t next = 0;
+            };
+
+            void add(uint32_t pointerId, const projection::TouchPoint &point, int64_t atUs);
+            void reset(uint32_t pointerId);
+
+            std::chrono::microseconds horizon_{0};
+            uint32_t width_ = 0;
+            uint32_t height_ = 0;
+            std::array<Track, cMaxPointers> tracks_;
+          };
+
+        }
+      }
+    }
+  }
+}
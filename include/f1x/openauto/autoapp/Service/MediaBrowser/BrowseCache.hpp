@@ -0,0 +1,119 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace f1x::openauto::autoapp::service::mediabrowser {
+
+  struct BrowseItem {
+    std::string path;
+    std::string title;
+    std::string subtitle;
+    bool browsable = false;
+    bool playable = false;
+    uint64_t version = 0;  // the phone's stamp of the listing at path, 0 if it sends none
+    std::string artKey;    // ArtCache key, empty without art
+  };
+
+  struct BrowseNode {
+    std::string path;
+    uint64_t version = 0;
+    std::vector<BrowseItem> items;
+  };
+
+  /**
+   * @brief The phone's media browse tree, as far as it has been visited.
+   *
+   * Nodes are keyed by path within the current phone and kept in a small
+   * in-memory LRU, written through to a per-phone directory that is bounded
+   * the same way, so a revisit, even after a restart, is served locally.
+   * When a listing is stored again, children whose entry changed (stamp,
+   * title, art) are marked stale along with what is cached below them and
+   * returned for re-requesting; unchanged subtrees stay as they are.
+   */
+  class BrowseCache {
+  public:
+    static constexpr size_t cCapacity = 64;
+    static constexpr size_t cDiskCapacity = 1024;
+
+    // An empty @p directory keeps the cache in memory only
+    BrowseCache(std::string directory, size_t capacity = cCapacity, size_t diskCapacity = cDiskCapacity);
+
+    // Until a phone is set nothing is written to disk
+    void setPhone(const std::string &phone);
+    const std::string &phone() const;
+
+    // From memory, else from disk; nullptr if neither has it. The pointer is
+    // valid until the next call that is not const
+    const BrowseNode *find(const std::string &path);
+    // True if the node at @p path is served although it changed on the phone
+    bool stale(const std::string &path) const;
+
+    // Returns the cached paths below @p node whose entries changed and have
+    // to be requested again
+    std::vector<std::string> store(BrowseNode node);
+    // Marks @p path and what is cached below it stale; returns those paths
+    std::vector<std::string> invalidate(const std::string &path);
+    // Drops the current phone's nodes, on disk too
+    void clear();
+
+    size_t size() const;
+    size_t diskSize() const;
+
+    // Changes when anything shown in the item's row or below it changes
+    static uint64_t fingerprint(const BrowseItem &item);
+
+  private:
+    struct Entry {
+      BrowseNode node;
+      bool stale = false;
+    };
+    typedef std::list<Entry> EntryList;
+
+    Entry *peek(const std::string &path);
+    Entry &insert(BrowseNode node, bool stale);
+    void markStale(const std::string &path, std::unordered_set<std::string> &visited,
+                   std::vector<std::string> &paths);
+
+    bool hasDisk() const;
+    std::string nodeFile(const std::string &path) const;
+    void scanDisk();
+    bool readDisk(const std::string &path, BrowseNode &node);
+    void writeDisk(const BrowseNode &node);
+    void eraseDisk(const std::string &path);
+    void touchDisk(const std::string &file);
+
+    std::string directory_;
+    size_t capacity_;
+    size_t diskCapacity_;
+    std::string phone_;
+    std::string phoneDirectory_;
+    EntryList entries_;  // most recent first
+    std::unordered_map<std::string, EntryList::iterator> index_;
+    std::list<std::string> diskOrder_;  // file names, least recent first
+    std::unordered_map<std::string, std::list<std::string>::iterator> diskIndex_;
+  };
+
+}
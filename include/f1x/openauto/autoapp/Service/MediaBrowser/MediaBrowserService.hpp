@@ -20,15 +20,33 @@
 
 #include <aasdk/Channel/MediaBrowser/MediaBrowserService.hpp>
 #include <f1x/openauto/autoapp/Service/IService.hpp>
+#include <f1x/openauto/autoapp/Service/MediaBrowser/BrowseCache.hpp>
 #include <boost/asio/io_service.hpp>
 #include <aasdk/Messenger/IMessenger.hpp>
+#include <QMetaObject>
+#include <QString>
+#include <deque>
+#include <functional>
+#include <unordered_map>
 
 namespace f1x {
   namespace openauto {
     namespace autoapp {
+      namespace player {
+        class ArtCache;
+      }
+
       namespace service {
         namespace mediabrowser {
 
+          /**
+           * @brief The phone's media library, browsed from the head unit.
+           *
+           * Listings go through a BrowseCache, so a revisit is answered from
+           * memory or disk and only changed subtrees are asked for again.
+           * Item art is kept as the phone sent it and handed to the shared
+           * art cache only when a row asks for it.
+           */
           class MediaBrowserService :
               public aasdk::channel::mediabrowser::IMediaBrowserServiceEventHandler,
               public IService,
@@ -46,12 +64,59 @@ namespace f1x {
 
             void onChannelError(const aasdk::error::Error &e) override;
 
+            // Handlers run on this service's strand
+            typedef std::function<void(const BrowseNode &node, bool stale)> BrowseHandler;
+            typedef std::function<void(const std::string &path)> RequestHandler;
+            typedef std::function<void(const QString &url)> ArtHandler;
+
+            // Before start()
+            void setArtCache(player::ArtCache *artCache);
+            // Asks the phone for the listing of a path; it arrives through post()
+            void setRequestHandler(RequestHandler handler);
+
+            // Any thread. Each phone has its own tree
+            void setPhone(std::string phone);
+            // The phone's listing of node.path; @p art holds its items' pictures by item path
+            void post(BrowseNode node, std::unordered_map<std::string, std::string> art);
+            // Answered from the cache when it has the path; a missing or stale
+            // listing is requested and answered again when it arrives
+            void browse(std::string path, BrowseHandler handler);
+            // file:// URL of the item art with @p artKey at @p size, empty if it
+            // is gone; the first ask makes the thumbnails
+            void fetchArt(std::string artKey, int size, ArtHandler handler);
 
           private:
             using std::enable_shared_from_this<MediaBrowserService>::shared_from_this;
+
+            struct ArtRequest {
+              std::string key;
+              int size;
+              std::vector<ArtHandler> handlers;
+            };
+
+            // Art waiting to be asked for, as the phone sent it
+            static constexpr size_t cMaxHeldArtBytes = 8 * 1024 * 1024;
+            // PhoneMedia's tickets count up from 0 on the same signal
+            static constexpr quint64 cTicketBase = quint64(1) << 63;
+
+            void request(const std::string &path);
+            void holdArt(const std::string &key, std::string image);
+            void onPictureStored(quint64 ticket, const QString &key);
+
             boost::asio::io_service::strand strand_;
             boost::asio::deadline_timer timer_;
             aasdk::channel::mediabrowser::MediaBrowserService::Pointer channel_;
+            BrowseCache cache_;
+            std::unordered_map<std::string, std::vector<BrowseHandler>> waiting_;  // requested paths
+            RequestHandler requestHandler_;
+            player::ArtCache *artCache_ = nullptr;
+            QMetaObject::Connection artConnection_;
+            std::unordered_map<std::string, std::string> heldArt_;
+            std::deque<std::string> heldOrder_;
+            size_t heldBytes_ = 0;
+            std::unordered_map<quint64, ArtRequest> artRequests_;
+            quint64 nextTicket_ = cTicketBase;
+            bool running_ = false;
           };
 
         }
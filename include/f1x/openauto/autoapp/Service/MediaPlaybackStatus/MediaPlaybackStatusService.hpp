@@ -43,6 +43,8 @@ namespace f1x {
             void fillFeatures(aap_protobuf::service::control::message::ServiceDiscoveryResponse &response) override;
 
             void onChannelOpenRequest(const aap_protobuf::service::control::message::ChannelOpenRequest &request) override;
+            void onMetadataUpdate(const aap_protobuf::service::mediaplayback::message::MediaPlaybackMetadata &metadata) override;
+            void onPlaybackUpdate(const aap_protobuf::service::mediaplayback::message::MediaPlaybackStatus &playback) override;
 
             void onChannelError(const aasdk::error::Error &e) override;
 
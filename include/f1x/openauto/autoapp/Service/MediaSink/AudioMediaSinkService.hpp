@@ -17,11 +17,14 @@
 */
 
 #pragma once
+#include <boost/asio/deadline_timer.hpp>
 #include <aasdk/Messenger/IMessenger.hpp>
 #include <aasdk/Channel/MediaSink/Audio/IAudioMediaSinkService.hpp>
 #include <aasdk/Channel/MediaSink/Audio/IAudioMediaSinkServiceEventHandler.hpp>
 #include <f1x/openauto/autoapp/Projection/IAudioOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDump.hpp>
 #include <f1x/openauto/autoapp/Service/IService.hpp>
+#include <f1x/openauto/autoapp/Service/MediaSink/MediaAckSender.hpp>
 
 namespace f1x {
   namespace openauto {
@@ -42,6 +45,10 @@ namespace f1x {
 
             void start() override;
             void stop() override;
+            // The audio device is closed before @p done
+            void shutdown(std::function<void()> done) override;
+            bool holdsDevices() const override { return true; }
+            std::string name() const override;
             void pause() override;
             void resume() override;
             void fillFeatures(aap_protobuf::service::control::message::ServiceDiscoveryResponse &response) override;
@@ -64,12 +71,35 @@ namespace f1x {
 
             void onChannelError(const aasdk::error::Error &e) override;
 
+            // Every payload this channel receives is also appended to the recorder
+            void setRecorder(projection::MediaDumpWriter::Pointer recorder);
+
+            // Acknowledge packets @p batch at a time (clamped to 1..cMaxAckBatch),
+            // advertising a window of twice that so the phone never waits on us
+            void setAckBatch(uint32_t batch);
+
+            // Advertise @p codec instead of PCM; the audio output decodes it
+            void setCodec(aap_protobuf::service::media::shared::message::MediaCodecType codec);
+
           protected:
+            static constexpr uint32_t cMaxAckBatch = 4;
+            // A partial batch is acknowledged after this, e.g. when the stream pauses
+            static constexpr uint32_t cAckFlushMs = 60;
+
+            void flushAcks();
+            void cancelAcks();
+
             using std::enable_shared_from_this<AudioMediaSinkService>::shared_from_this;
             boost::asio::io_service::strand strand_;
             aasdk::channel::mediasink::audio::IAudioMediaSinkService::Pointer channel_;
             projection::IAudioOutput::Pointer audioOutput_;
             int32_t session_;
+            projection::MediaDumpWriter::Pointer recorder_;
+            MediaAckSender ackSender_;
+            uint32_t ackBatch_;
+            uint32_t unacked_;
+            aap_protobuf::service::media::shared::message::MediaCodecType codec_;
+            boost::asio::deadline_timer ackTimer_;
           };
         }
       }
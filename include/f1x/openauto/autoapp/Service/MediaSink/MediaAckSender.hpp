@@ -0,0 +1,70 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <aasdk/Channel/Promise.hpp>
+#include <aasdk/Error/Error.hpp>
+#include <aap_protobuf/service/media/source/message/Ack.pb.h>
+#include <boost/asio/io_service.hpp>
+
+namespace f1x {
+  namespace openauto {
+    namespace autoapp {
+      namespace service {
+        namespace mediasink {
+
+          /**
+           * Per-frame media ACKs without per-frame allocations of our own. The
+           * ACK message is built once, and the promise handlers capture only
+           * this sender, so std::function keeps them in its small buffer; the
+           * owning service is held through one reference for as long as any
+           * ACK is in flight instead of one bound copy per ACK.
+           * Used on the owning service's strand only.
+           */
+          class MediaAckSender {
+          public:
+            typedef std::function<void(const aasdk::error::Error &)> ErrorHandler;
+
+            MediaAckSender(boost::asio::io_service::strand &strand, ErrorHandler errorHandler);
+
+            void setSession(int32_t session);
+            // Media packets the next message() acknowledges, 1 by default
+            void setCount(uint32_t count);
+            const aap_protobuf::service::media::source::message::Ack &message() const;
+
+            // The promise for one send of message(); @p owner outlives it
+            aasdk::channel::SendPromise::Pointer promise(std::shared_ptr<void> owner);
+
+          private:
+            void settle();
+
+            boost::asio::io_service::strand &strand_;
+            ErrorHandler errorHandler_;
+            aap_protobuf::service::media::source::message::Ack message_;
+            uint32_t inFlight_;
+            std::shared_ptr<void> owner_;
+          };
+
+        }
+      }
+    }
+  }
+}
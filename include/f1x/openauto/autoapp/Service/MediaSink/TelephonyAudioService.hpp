@@ -32,9 +32,6 @@ namespace f1x {
             TelephonyAudioService(boost::asio::io_service &ioService,
                                   aasdk::messenger::IMessenger::Pointer messenger,
                                   projection::IAudioOutput::Pointer audioOutput);
-
-          protected:
-            projection::IAudioOutput::Pointer audioOutput_;
           };
 
         }
@@ -22,7 +22,10 @@
 #include <aasdk/Channel/MediaSink/Video/IVideoMediaSinkService.hpp>
 #include <aasdk/Channel/MediaSink/Video/IVideoMediaSinkServiceEventHandler.hpp>
 #include <f1x/openauto/autoapp/Projection/IVideoOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDump.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoModeSelector.hpp>
 #include <f1x/openauto/autoapp/Service/IService.hpp>
+#include <f1x/openauto/autoapp/Service/MediaSink/MediaAckSender.hpp>
 
 namespace f1x {
   namespace openauto {
@@ -40,10 +43,15 @@ namespace f1x {
             // General Constructor
             VideoMediaSinkService(boost::asio::io_service& ioService,
                                   aasdk::channel::mediasink::video::IVideoMediaSinkService::Pointer channel,
-                                  projection::IVideoOutput::Pointer videoOutput);
+                                  projection::IVideoOutput::Pointer videoOutput,
+                                  projection::VideoModeSelector::Pointer videoModeSelector);
 
             void start() override;
             void stop() override;
+            // The output's DRM plane and CMA buffers are released before @p done
+            void shutdown(std::function<void()> done) override;
+            bool holdsDevices() const override { return true; }
+            std::string name() const override { return "video"; }
             void pause() override;
             void resume() override;
             void fillFeatures(aap_protobuf::service::control::message::ServiceDiscoveryResponse &response) override;
@@ -66,14 +74,31 @@ namespace f1x {
 
             void onChannelError(const aasdk::error::Error &e) override;
 
+            // Every payload this channel receives is also appended to the recorder
+            void setRecorder(projection::MediaDumpWriter::Pointer recorder);
+
             void onVideoFocusRequest(const aap_protobuf::service::media::video::message::VideoFocusRequestNotification &request) override;
             void sendVideoFocusIndication();
+            void sendMediaAck();
           protected:
+            // Native UI in front: the phone stops streaming and the output
+            // releases its decoder until the projection is shown again.
+            // @p unsolicited is false when answering the phone's focus request
+            void enterBackground(bool unsolicited);
+            void leaveBackground(bool unsolicited);
+            void sendVideoFocus(aap_protobuf::service::media::video::message::VideoFocusMode focus, bool unsolicited);
+
             using std::enable_shared_from_this<VideoMediaSinkService>::shared_from_this;
             boost::asio::io_service::strand strand_;
             aasdk::channel::mediasink::video::IVideoMediaSinkService::Pointer channel_;
             projection::IVideoOutput::Pointer videoOutput_;
+            projection::VideoModeSelector::Pointer videoModeSelector_;
             int32_t session_;
+            projection::MediaDumpWriter::Pointer recorder_;
+            bool deferredAck_; // ACKs are sent when the output dequeues the frame
+            bool hevcConfigs_; // H.265 video configs were listed ahead of the H.264 ones
+            bool background_;  // Focus is native; see enterBackground()
+            MediaAckSender ackSender_;
           };
         }
       }
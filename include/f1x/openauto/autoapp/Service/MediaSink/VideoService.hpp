@@ -31,7 +31,8 @@ namespace f1x {
           public:
             VideoService(boost::asio::io_service &ioService,
                                aasdk::messenger::IMessenger::Pointer messenger,
-                               projection::IVideoOutput::Pointer videoOutput);
+                               projection::IVideoOutput::Pointer videoOutput,
+                               projection::VideoModeSelector::Pointer videoModeSelector);
 
           protected:
             projection::IVideoOutput::Pointer videoOutput;
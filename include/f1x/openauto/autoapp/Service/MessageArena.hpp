@@ -0,0 +1,78 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <google/protobuf/arena.h>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace service
+{
+
+/**
+ * @brief MessageArena - Bump allocation for a burst of outgoing messages
+ *
+ * A service that builds several protobuf messages per burst (a batch of
+ * GPS fixes, a flush of vehicle readings) creates them here instead of on
+ * the heap: each field and repeated element is a pointer bump in an arena
+ * block, and reset() after the burst is sent frees everything at once.
+ * The first cInitialBytes are part of the arena and survive reset(), so a
+ * burst that fits allocates nothing; blocks beyond that come from
+ * AllocationAccounting under AllocationTag::Protobuf.
+ */
+class MessageArena
+{
+public:
+    static constexpr size_t cInitialBytes = 4 * 1024;
+    static constexpr size_t cMaxBlockBytes = 64 * 1024;
+
+    MessageArena();
+
+    MessageArena(const MessageArena &) = delete;
+    MessageArena &operator=(const MessageArena &) = delete;
+
+    // Valid until the next reset()
+    template <typename MessageType>
+    MessageType *create()
+    {
+        return google::protobuf::Arena::CreateMessage<MessageType>(&arena_);
+    }
+
+    // Once the burst's messages are serialized
+    void reset();
+
+    uint64_t bytesAllocated() const { return arena_.SpaceAllocated(); }
+
+private:
+    google::protobuf::ArenaOptions options();
+
+    alignas(std::max_align_t) char initial_[cInitialBytes];
+    google::protobuf::Arena arena_;
+};
+
+}
+}
+}
+}
@@ -22,6 +22,7 @@
 #include <f1x/openauto/autoapp/Service/IService.hpp>
 #include <boost/asio/io_service.hpp>
 #include <aasdk/Messenger/IMessenger.hpp>
+#include <f1x/openauto/autoapp/NavigationState.hpp>
 
 namespace f1x {
   namespace openauto {
@@ -52,6 +53,11 @@ namespace f1x {
 
           private:
             using std::enable_shared_from_this<NavigationStatusService>::shared_from_this;
+            // Puts state_ on the StateBus when it changed; cleared while inactive
+            void publish();
+
+            NavigationState state_;
+            std::string published_;
             boost::asio::io_service::strand strand_;
             boost::asio::deadline_timer timer_;
             aasdk::channel::navigationstatus::NavigationStatusService::Pointer channel_;
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <aasdk/Channel/PhoneStatus/PhoneStatusService.hpp>
+#include <f1x/openauto/autoapp/PhoneStatus.hpp>
 #include <f1x/openauto/autoapp/Service/IService.hpp>
 #include <boost/asio/io_service.hpp>
 #include <aasdk/Messenger/IMessenger.hpp>
@@ -46,6 +47,9 @@ namespace f1x {
 
             void onChannelError(const aasdk::error::Error &e) override;
 
+            // Any thread. Takes the signal and call of @p status; the battery
+            // comes from the control channel
+            void onPhoneStatus(const PhoneStatus &status);
 
           private:
             using std::enable_shared_from_this<PhoneStatusService>::shared_from_this;
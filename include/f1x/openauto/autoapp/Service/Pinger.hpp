@@ -18,6 +18,9 @@
 
 #pragma once
 
+#include <chrono>
+#include <deque>
+#include <utility>
 #include <f1x/openauto/autoapp/Service/IPinger.hpp>
 
 namespace f1x
@@ -29,19 +32,31 @@ namespace autoapp
 namespace service
 {
 
+/**
+ * Paces pings and ends the session when pongs stop. Each pong is timed
+ * against its request and fed to LinkQuality; while the link looks
+ * worse than good, pings go out at a quarter of the base interval so a
+ * failing link is noticed, and charted, sooner.
+ */
 class Pinger: public IPinger, public std::enable_shared_from_this<Pinger>
 {
 public:
     Pinger(boost::asio::io_service& ioService, time_t duration);
 
     void ping(Promise::Pointer promise) override;
-    void pong() override;
+    void pingSent(int64_t timestamp) override;
+    void pong(int64_t timestamp) override;
     void cancel() override;
 
 private:
     using std::enable_shared_from_this<Pinger>::shared_from_this;
 
     void onTimerExceeded(const boost::system::error_code& error);
+    bool hasTimedOut() const;
+
+    typedef std::chrono::steady_clock Clock;
+    static constexpr size_t cMaxTrackedPings = 8;
+    static constexpr time_t cMinInterval = 1000;
 
     boost::asio::io_service::strand strand_;
     boost::asio::deadline_timer timer_;
@@ -50,6 +65,9 @@ private:
     Promise::Pointer promise_;
     int64_t pingsCount_;
     int64_t pongsCount_;
+    time_t interval_;
+    // Unanswered requests, oldest first: echoed timestamp and local send time
+    std::deque<std::pair<int64_t, Clock::time_point>> inFlight_;
 };
 
 }
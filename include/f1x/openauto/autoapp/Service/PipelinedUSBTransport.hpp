@@ -0,0 +1,125 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <aasdk/Error/Error.hpp>
+#include <aasdk/Transport/ITransport.hpp>
+#include <aasdk/USB/IAOAPDevice.hpp>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace service
+{
+
+/**
+ * @brief PipelinedUSBTransport - USB transport keeping several bulk IN
+ * transfers queued at the phone
+ *
+ * aasdk's USBTransport submits the next IN transfer only once the previous
+ * one is handed on, so during every completion the phone has nowhere to
+ * send and a 1080p60 burst backs up in its own buffers. This one keeps
+ * @p transfers transfers of @p transferSize bytes outstanding, from buffers
+ * allocated once, and feeds the completions to receive() in submission
+ * order. A completed buffer is copied out and resubmitted at once, unless
+ * more than the whole pool is already waiting to be read. Sends go out one
+ * at a time, as in aasdk.
+ */
+class PipelinedUSBTransport: public aasdk::transport::ITransport,
+                             public std::enable_shared_from_this<PipelinedUSBTransport>
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static constexpr uint32_t cSendTimeoutMs = 10000;
+
+    PipelinedUSBTransport(boost::asio::io_service& ioService, aasdk::usb::IAOAPDevice::Pointer aoapDevice,
+                          size_t transfers, size_t transferSize);
+
+    void receive(size_t size, ReceivePromise::Pointer promise) override;
+    void send(aasdk::common::Data data, SendPromise::Pointer promise) override;
+    void stop() override;
+
+private:
+    using std::enable_shared_from_this<PipelinedUSBTransport>::shared_from_this;
+
+    enum class SlotState
+    {
+        Idle,
+        InFlight,
+        Done
+    };
+
+    struct Slot
+    {
+        aasdk::common::Data buffer;
+        size_t received = 0;
+        SlotState state = SlotState::Idle;
+    };
+
+    // Submits idle slots, in ring order, while the read-ahead has room
+    void submitIdle();
+    void onReceived(size_t slot, size_t bytes);
+    void onReceiveError(const aasdk::error::Error& error);
+    // Resolves queued receives from pending_, rejecting them after an error
+    void distribute();
+    size_t available() const { return pending_.size() - pendingOffset_; }
+    void sendFront();
+    void onSendError(const aasdk::error::Error& error);
+
+    boost::asio::io_service::strand receiveStrand_;
+    boost::asio::io_service::strand sendStrand_;
+    aasdk::usb::IAOAPDevice::Pointer aoapDevice_;
+    const size_t transferSize_;
+    MemoryCharge memory_;
+
+    // Receive strand only. Slots are submitted and drained in ring order, so
+    // the stream stays in order however the completions are scheduled
+    std::vector<Slot> slots_;
+    size_t nextSubmit_;
+    size_t nextDrain_;
+    size_t inFlight_;
+    Clock::time_point idleSince_;
+    Clock::time_point windowStart_;
+    uint64_t windowBytes_;
+    aasdk::common::Data pending_;
+    size_t pendingOffset_;
+    std::deque<std::pair<size_t, ReceivePromise::Pointer>> receiveQueue_;
+    bool heldBack_;
+    bool receiveFailed_;
+    aasdk::error::Error receiveError_;
+
+    // Send strand only; the front is the one in flight
+    std::deque<std::pair<aasdk::common::Data, SendPromise::Pointer>> sendQueue_;
+    size_t sendOffset_;
+};
+
+}
+}
+}
+}
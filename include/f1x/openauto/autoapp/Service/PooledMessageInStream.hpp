@@ -0,0 +1,121 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <boost/asio.hpp>
+#include <aasdk/Messenger/ChannelId.hpp>
+#include <aasdk/Messenger/FrameType.hpp>
+#include <aasdk/Messenger/ICryptor.hpp>
+#include <aasdk/Messenger/IMessageInStream.hpp>
+#include <aasdk/Messenger/Message.hpp>
+#include <aasdk/Transport/ITransport.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace service
+{
+
+/**
+ * @brief MessageBufferPool - Recycled payload buffers for reassembled messages
+ *
+ * Buffers come in power-of-four size classes from cMinBytes to cMaxBytes,
+ * and up to cPerClass of each are kept. Smaller or larger messages get a
+ * plain allocation. Kept buffers are charged to the video memory pool.
+ */
+class MessageBufferPool
+{
+public:
+    static constexpr size_t cMinBytes = 16 * 1024;
+    static constexpr size_t cMaxBytes = 4 * 1024 * 1024;
+    static constexpr size_t cClasses = 5; // 16K, 64K, 256K, 1M, 4M
+    static constexpr size_t cPerClass = 4;
+
+    ~MessageBufferPool();
+
+    // An empty buffer with room for at least @p bytes
+    aasdk::common::Data acquire(size_t bytes);
+    void release(aasdk::common::Data buffer);
+
+private:
+    std::mutex mutex_;
+    std::array<std::vector<aasdk::common::Data>, cClasses> free_;
+};
+
+/**
+ * @brief PooledMessageInStream - aasdk's message in stream on pooled buffers
+ *
+ * Reads and decrypts AAP frames like aasdk::messenger::MessageInStream.
+ * aasdk grows each message's payload one fragment at a time, so a keyframe
+ * of a few hundred KB is reallocated and copied several times on the way
+ * in. Here the first fragment announces the total size, and the payload
+ * gets a buffer of that size from the pool. Each fragment is then
+ * decrypted straight into place, the only copy. The buffer goes back to
+ * the pool once the message's last reference is gone, i.e. after the video
+ * service has handed the frame to the output.
+ */
+class PooledMessageInStream: public aasdk::messenger::IMessageInStream,
+                             public std::enable_shared_from_this<PooledMessageInStream>
+{
+public:
+    PooledMessageInStream(boost::asio::io_service& ioService, aasdk::transport::ITransport::Pointer transport,
+                          aasdk::messenger::ICryptor::Pointer cryptor);
+
+    void startReceive(aasdk::messenger::ReceivePromise::Pointer promise) override;
+
+private:
+    using std::enable_shared_from_this<PooledMessageInStream>::shared_from_this;
+
+    void receiveFrameHeader();
+    void onFrameHeader(const aasdk::common::Data& data);
+    void onFrameSize(const aasdk::common::Data& data);
+    void onFramePayload(const aasdk::common::Data& data);
+    void onError(const aasdk::error::Error& error);
+    // A message whose payload goes back to the pool when it is destroyed
+    aasdk::messenger::Message::Pointer createMessage(aasdk::messenger::ChannelId channelId,
+                                                     aasdk::messenger::EncryptionType encryptionType,
+                                                     aasdk::messenger::MessageType messageType);
+
+    boost::asio::io_service::strand strand_;
+    aasdk::transport::ITransport::Pointer transport_;
+    aasdk::messenger::ICryptor::Pointer cryptor_;
+    std::shared_ptr<MessageBufferPool> pool_;
+
+    aasdk::messenger::ReceivePromise::Pointer promise_;
+    // Fragments of several channels can interleave
+    std::map<aasdk::messenger::ChannelId, aasdk::messenger::Message::Pointer> pending_;
+    aasdk::messenger::Message::Pointer message_;
+    aasdk::messenger::FrameType frameType_;
+    size_t frameSize_;
+    // A fragment with no message to continue is read and dropped
+    bool validFrame_;
+};
+
+}
+}
+}
+}
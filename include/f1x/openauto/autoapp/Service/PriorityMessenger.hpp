@@ -0,0 +1,107 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <boost/asio.hpp>
+#include <aasdk/Messenger/ChannelId.hpp>
+#include <aasdk/Messenger/IMessenger.hpp>
+#include <aasdk/Messenger/Message.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace service
+{
+
+// Outbound traffic classes, most urgent first
+enum class OutboundClass
+{
+    Input,
+    Control, // pings and focus; the Pinger's RTT must not include media ACKs
+    Video,
+    Audio, // ACKs of the audio sinks and microphone data
+    Sensor,
+    Status, // everything else: playback and phone status, bluetooth, ...
+    Count
+};
+
+const char* outboundClassName(OutboundClass outboundClass);
+OutboundClass outboundClassOf(aasdk::messenger::ChannelId channelId);
+
+/**
+ * @brief PriorityMessenger - Orders what the services send by urgency
+ *
+ * Every service sends through one MessageOutStream, which writes in arrival
+ * order, so a touch report could wait behind a run of audio ACKs and a GPS
+ * batch. This messenger hands one message at a time to the real one and
+ * picks the next by class, so the out stream never holds more than the
+ * write in progress. Each cAgingStepMs of waiting raises a message one
+ * class, so a busy input path cannot starve the rest. A channel's messages
+ * all fall in one class and keep their order.
+ */
+class PriorityMessenger: public aasdk::messenger::IMessenger,
+                         public std::enable_shared_from_this<PriorityMessenger>
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static constexpr int64_t cAgingStepMs = 5;
+
+    PriorityMessenger(boost::asio::io_service& ioService, aasdk::messenger::IMessenger::Pointer messenger);
+
+    void enqueueReceive(aasdk::messenger::ReceivePromise::Pointer promise) override;
+    void enqueueSend(aasdk::messenger::Message message, aasdk::messenger::SendPromise::Pointer promise) override;
+    // Raw sends, i.e. the version request and handshake, go with Control
+    void enqueueSend(aasdk::common::Data data, aasdk::messenger::SendPromise::Pointer promise) override;
+    void cancelActiveTransfers() override;
+    void stop() override;
+
+private:
+    using std::enable_shared_from_this<PriorityMessenger>::shared_from_this;
+
+    struct Pending
+    {
+        std::optional<aasdk::messenger::Message> message;
+        aasdk::common::Data data;
+        aasdk::messenger::SendPromise::Pointer promise;
+        Clock::time_point queued;
+    };
+
+    void enqueue(OutboundClass outboundClass, Pending pending);
+    // Hands the most urgent message on, if none is in flight
+    void sendNext();
+    void rejectQueued();
+
+    boost::asio::io_service::strand strand_;
+    aasdk::messenger::IMessenger::Pointer messenger_;
+    std::array<std::deque<Pending>, static_cast<size_t>(OutboundClass::Count)> queues_;
+    bool sending_;
+};
+
+}
+}
+}
+}
@@ -0,0 +1,86 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace f1x::openauto::autoapp::service::radio {
+
+  /**
+   * @brief The FM band of a region: its limits and channel spacing.
+   */
+  struct RadioBand {
+    uint32_t minKhz = 87500;
+    uint32_t maxKhz = 108000;
+    uint32_t spacingKhz = 100;
+
+    // "EU" (also the rest of ITU region 1), "US" or "JP"; false if unknown
+    static bool forRegion(const std::string &region, RadioBand &band);
+
+    // Nearest channel within the band
+    uint32_t snap(uint32_t khz) const;
+  };
+
+  struct RadioStation {
+    uint32_t frequencyKhz = 0;
+    uint32_t signal = 0; // 0-100
+
+    bool operator==(const RadioStation &other) const {
+      return frequencyKhz == other.frequencyKhz && signal == other.signal;
+    }
+  };
+
+  /**
+   * @brief One broadcast tuner. Calls are serialized by the caller; tuning
+   * may block for the tuner's settle time.
+   */
+  class ITuner {
+  public:
+    typedef std::shared_ptr<ITuner> Pointer;
+
+    virtual ~ITuner() = default;
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    virtual std::string name() const = 0;
+
+    virtual bool tune(uint32_t khz) = 0;
+    // What the tuner is on; 0 if unknown
+    virtual uint32_t frequencyKhz() const = 0;
+    // Signal strength 0-100 at the current frequency, -1 if unreadable
+    virtual int32_t signal() = 0;
+    virtual void setMuted(bool muted) = 0;
+
+    /**
+     * @brief Seeks to the next station up or down from the current one,
+     * within @p band and without wrapping.
+     * @return false if nothing was found or the tuner cannot seek.
+     */
+    virtual bool seek(bool upward, const RadioBand &band, uint32_t &khz) {
+      (void)upward;
+      (void)band;
+      (void)khz;
+      return false;
+    }
+    virtual bool canSeek() const { return false; }
+  };
+
+}
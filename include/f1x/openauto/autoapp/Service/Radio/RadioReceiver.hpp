@@ -0,0 +1,100 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <rtaudio/RtAudio.h>
+#include <f1x/openauto/autoapp/Projection/IAudioOutput.hpp>
+#include <f1x/openauto/autoapp/Service/Radio/ITuner.hpp>
+
+namespace f1x::openauto::autoapp::service::radio {
+
+  /**
+   * @brief The car's FM tuner, its station list and its audio.
+   *
+   * Tuner audio on an ALSA capture device (a USB tuner's sound card, or
+   * a chip on I2S) is copied into @p output, normally a media channel of
+   * the shared AudioMixer, so guidance and calls duck the radio as they
+   * duck phone media. Tuners wired to an analogue input play on their own
+   * and are only tuned. The station list is scanned once per region on a
+   * background thread and cached; the receiver outlives phone sessions.
+   */
+  class RadioReceiver {
+  public:
+    typedef std::shared_ptr<RadioReceiver> Pointer;
+
+    /**
+     * @param audioDevice ALSA capture device of the tuner's audio, empty
+     * when it is wired to an analogue input
+     */
+    RadioReceiver(ITuner::Pointer tuner, RadioBand band, std::string cachePath, std::string audioDevice,
+                  projection::IAudioOutput::Pointer output);
+    ~RadioReceiver();
+
+    RadioReceiver(const RadioReceiver &) = delete;
+    RadioReceiver &operator=(const RadioReceiver &) = delete;
+
+    // Opens the tuner and plays the last station; scans first, in the
+    // background, when no list is cached for the region
+    bool start();
+    void stop();
+
+    bool tune(uint32_t khz);
+    // To the next listed station up or down, wrapping at the band edges
+    bool step(bool upward);
+    void rescan();
+
+    std::vector<RadioStation> stations() const;
+    uint32_t frequencyKhz() const;
+
+  private:
+    static constexpr uint32_t cSampleRate = 48000;
+    static constexpr uint32_t cChannelCount = 2;
+
+    void startScan();
+    void cancelScan();
+    void runScan();
+    bool startAudio();
+    void stopAudio();
+    static int captureCallback(void *outputBuffer, void *inputBuffer, unsigned int frames, double streamTime,
+                               RtAudioStreamStatus status, void *userData);
+
+    ITuner::Pointer tuner_;
+    const RadioBand band_;
+    const std::string cachePath_;
+    const std::string audioDevice_;
+    projection::IAudioOutput::Pointer output_;
+
+    // The tuner, the list and the frequency; a scan holds it throughout
+    mutable std::mutex mutex_;
+    std::vector<RadioStation> stations_;
+    uint32_t frequencyKhz_;
+    bool started_;
+
+    std::thread scanThread_;
+    std::atomic<bool> scanCancelled_;
+    std::unique_ptr<RtAudio> capture_;
+  };
+
+}
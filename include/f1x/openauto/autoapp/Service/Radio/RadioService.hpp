@@ -22,6 +22,7 @@
 #include <f1x/openauto/autoapp/Service/IService.hpp>
 #include <boost/asio/io_service.hpp>
 #include <aasdk/Messenger/IMessenger.hpp>
+#include <f1x/openauto/autoapp/Service/Radio/RadioReceiver.hpp>
 
 namespace f1x {
   namespace openauto {
@@ -34,7 +35,9 @@ namespace f1x {
               public IService,
               public std::enable_shared_from_this<RadioService> {
           public:
-            RadioService(boost::asio::io_service &ioService, aasdk::messenger::IMessenger::Pointer messenger);
+            // The receiver plays while the phone is connected and outlives it
+            RadioService(boost::asio::io_service &ioService, aasdk::messenger::IMessenger::Pointer messenger,
+                         RadioReceiver::Pointer receiver);
 
             void start() override;
             void stop() override;
@@ -52,6 +55,7 @@ namespace f1x {
             boost::asio::io_service::strand strand_;
             boost::asio::deadline_timer timer_;
             aasdk::channel::radio::RadioService::Pointer channel_;
+            RadioReceiver::Pointer receiver_;
           };
 
         }
@@ -0,0 +1,62 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <f1x/openauto/autoapp/Service/Radio/ITuner.hpp>
+
+namespace f1x::openauto::autoapp::service::radio {
+
+  /**
+   * @brief Finds the stations of a band, and keeps the list between runs.
+   *
+   * Tuners that seek in hardware are walked up the band seek by seek;
+   * the others are stepped channel by channel and the list is picked from
+   * the signal levels. A full sweep takes seconds, so lists are cached per
+   * region and only rescanned on request.
+   */
+  class StationScanner {
+  public:
+    static constexpr uint32_t cMinSignal = 30;
+    // RSSI of most FM tuners needs this long after a retune to settle
+    static constexpr std::chrono::milliseconds cSettleTime{60};
+
+    /**
+     * @brief The stations in a stepped sweep: readings of at least
+     * @p minSignal that no adjacent channel beats, so a strong transmitter
+     * is listed once rather than with its neighbours.
+     */
+    static std::vector<RadioStation> pick(const std::vector<RadioStation> &sweep, uint32_t spacingKhz,
+                                          uint32_t minSignal = cMinSignal);
+
+    /**
+     * @brief Scans @p band on @p tuner; returns early, with what was found
+     * so far, once @p cancel is set.
+     */
+    static std::vector<RadioStation> scan(ITuner &tuner, const RadioBand &band, const std::atomic<bool> &cancel);
+
+    static std::string cachePath(const std::string &directory, const std::string &region);
+    static bool load(const std::string &path, std::vector<RadioStation> &stations);
+    static bool save(const std::string &path, const std::vector<RadioStation> &stations);
+  };
+
+}
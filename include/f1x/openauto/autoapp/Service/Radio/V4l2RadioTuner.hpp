@@ -0,0 +1,61 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <f1x/openauto/autoapp/Service/Radio/ITuner.hpp>
+
+namespace f1x::openauto::autoapp::service::radio {
+
+  /**
+   * @brief An FM tuner behind a Linux V4L2 radio device.
+   *
+   * The kernel's radio drivers (radio-si470x for the Si4702/03 on I2C or
+   * USB, radio-si476x, the TEA575x family) do the register work, chip
+   * power-up and RDS; this only tunes, seeks and reads the signal level.
+   */
+  class V4l2RadioTuner : public ITuner {
+  public:
+    explicit V4l2RadioTuner(std::string device);
+    ~V4l2RadioTuner() override;
+
+    bool open() override;
+    void close() override;
+    std::string name() const override;
+
+    bool tune(uint32_t khz) override;
+    uint32_t frequencyKhz() const override;
+    int32_t signal() override;
+    void setMuted(bool muted) override;
+
+    bool seek(bool upward, const RadioBand &band, uint32_t &khz) override;
+    bool canSeek() const override;
+
+  private:
+    uint32_t toUnits(uint32_t khz) const;
+    uint32_t toKhz(uint32_t units) const;
+
+    const std::string device_;
+    int fd_;
+    std::string name_;
+    uint32_t capability_;
+    bool hardwareSeek_;
+  };
+
+}
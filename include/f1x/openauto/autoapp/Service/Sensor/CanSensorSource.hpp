@@ -0,0 +1,72 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <f1x/openauto/autoapp/Service/Sensor/VehicleSensorSource.hpp>
+
+namespace f1x::openauto::autoapp::service::sensor {
+
+  /**
+   * @brief Where one sensor lives in a vehicle's CAN frames.
+   *
+   * Written as sensor@id:byte:length[:scale[:offset]], e.g. "speed@0x3e9:0:2:0.01":
+   * @c length big-endian bytes from @c byte of frame @c id, times @c scale plus
+   * @c offset. Speed is then in km/h, fuel in percent and compass in degrees;
+   * gear is taken as an Android Auto gear code and any non-zero parking brake
+   * value means engaged.
+   */
+  struct CanSignal {
+    VehicleSensor sensor = VehicleSensor::Count;
+    uint32_t id = 0;
+    uint8_t byte = 0;
+    uint8_t length = 1;
+    double scale = 1.0;
+    double offset = 0.0;
+  };
+
+  /**
+   * @brief Reads mapped signals off a SocketCAN interface, with the kernel
+   * filtering out every frame id that is not mapped.
+   */
+  class CanSensorSource : public VehicleSensorSource {
+  public:
+    CanSensorSource(std::string interfaceName, std::vector<CanSignal> signals);
+    ~CanSensorSource() override;
+
+    /**
+     * @brief Parses a comma or space separated list of signal specifications.
+     * @return False if any entry is malformed; @p signals then holds the valid ones.
+     */
+    static bool parseSignals(const std::string &spec, std::vector<CanSignal> &signals);
+    // Reading for @p signal from a frame payload; false if the frame is too short
+    static bool decode(const CanSignal &signal, const uint8_t *data, size_t size, VehicleReading &reading);
+
+    std::vector<VehicleSensor> sensors() const override;
+
+  protected:
+    void run() override;
+
+  private:
+    int openSocket() const;
+
+    const std::string interfaceName_;
+    const std::vector<CanSignal> signals_;
+  };
+
+}
@@ -0,0 +1,59 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <f1x/openauto/autoapp/Service/Sensor/VehicleSensorSource.hpp>
+
+namespace f1x::openauto::autoapp::service::sensor {
+
+  /**
+   * @brief Samples an IIO accelerometer and gyroscope through sysfs, for
+   * dead reckoning between GPS fixes.
+   */
+  class IioSensorSource : public VehicleSensorSource {
+  public:
+    // @p device is a directory under /sys/bus/iio/devices, or "auto" for the
+    // first one with an accelerometer
+    explicit IioSensorSource(std::string device);
+    ~IioSensorSource() override;
+
+    std::vector<VehicleSensor> sensors() const override;
+
+  protected:
+    void run() override;
+
+  private:
+    static constexpr int cSamplePeriodMs = 50;
+
+    struct Channel {
+      VehicleSensor sensor;
+      std::array<int, 3> fds{{-1, -1, -1}};
+      double scale = 1.0;
+    };
+
+    static std::string resolve(const std::string &device);
+    void openChannel(const std::string &prefix, VehicleSensor sensor);
+    bool sample(const Channel &channel, VehicleReading &reading) const;
+    void closeChannels();
+
+    const std::string directory_;
+    std::vector<Channel> channels_;
+  };
+
+}
@@ -0,0 +1,59 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <f1x/openauto/autoapp/Service/Sensor/VehicleSensorSource.hpp>
+
+namespace f1x::openauto::autoapp::service::sensor {
+
+  /**
+   * @brief Polls vehicle speed and fuel level through an ELM327 OBD-II adapter
+   * on a serial or RFCOMM device.
+   */
+  class ObdSensorSource : public VehicleSensorSource {
+  public:
+    explicit ObdSensorSource(std::string device);
+    ~ObdSensorSource() override;
+
+    /**
+     * @brief Extracts the data bytes answering mode 01 @p pid from an adapter
+     * reply such as "41 0D 3C", ignoring echo, spacing and the prompt.
+     */
+    static bool parseResponse(const std::string &reply, uint8_t pid, std::vector<uint8_t> &data);
+
+    std::vector<VehicleSensor> sensors() const override;
+
+  protected:
+    void run() override;
+
+  private:
+    static constexpr int cSpeedPeriodMs = 200;
+    // Fuel moves slowly: one query every this many speed queries
+    static constexpr int cFuelEvery = 50;
+    static constexpr int cReplyTimeoutMs = 1000;
+    static constexpr int cRetryMs = 5000;
+
+    int openDevice() const;
+    // Sends @p command and collects the reply up to the '>' prompt
+    bool query(int fd, const std::string &command, std::string &reply);
+
+    const std::string device_;
+  };
+
+}
@@ -0,0 +1,67 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <vector>
+#include <f1x/openauto/autoapp/Service/Sensor/VehicleSensorSource.hpp>
+
+namespace f1x::openauto::autoapp::service::sensor {
+
+  /**
+   * @brief Paces vehicle readings to the update periods the phone requested.
+   *
+   * Keeps the latest reading per sensor and releases it once the sensor's
+   * period has passed since the last one sent, unless it is still within the
+   * sensor's dead band of that one. Sensors the phone has not started yet
+   * keep their latest reading, which goes out as soon as they are.
+   */
+  class SensorRateLimiter {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    // A period of zero forwards every change as it arrives
+    void request(VehicleSensor sensor, std::chrono::milliseconds period);
+    bool isRequested(VehicleSensor sensor) const;
+
+    void offer(const VehicleReading &reading, Clock::time_point now);
+    // Readings due at @p now, at most one per sensor
+    std::vector<VehicleReading> collect(Clock::time_point now);
+    // When the earliest held reading becomes due; Clock::time_point::max() if none
+    Clock::time_point nextDue() const;
+
+  private:
+    struct Slot {
+      bool requested = false;
+      std::chrono::milliseconds period{0};
+      bool hasPending = false;
+      VehicleReading pending;
+      bool hasSent = false;
+      VehicleReading sent;
+      Clock::time_point sentAt;
+    };
+
+    static int32_t deadBand(VehicleSensor sensor);
+    static bool differs(const VehicleReading &a, const VehicleReading &b);
+
+    std::array<Slot, static_cast<size_t>(VehicleSensor::Count)> slots_;
+  };
+
+}
@@ -24,8 +24,14 @@
 #include <aap_protobuf/service/sensorsource/message/SensorType.pb.h>
 #include <aasdk/Channel/SensorSource/SensorSourceService.hpp>
 #include <f1x/openauto/autoapp/Service/IService.hpp>
+#include <f1x/openauto/autoapp/Service/MessageArena.hpp>
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <aasdk/Messenger/IMessenger.hpp>
+#include <f1x/openauto/autoapp/Service/Sensor/SensorRateLimiter.hpp>
+#include <f1x/openauto/autoapp/Service/Sensor/SunSchedule.hpp>
+#include <f1x/openauto/autoapp/Service/Sensor/VehicleSensorSource.hpp>
 
 
 namespace f1x::openauto::autoapp::service::sensor {
@@ -34,8 +40,14 @@ namespace f1x::openauto::autoapp::service::sensor {
       public IService,
       public std::enable_shared_from_this<SensorService> {
   public:
+    // With @p restrictWhileMoving, driving status follows speed, gear and
+    // parking brake instead of staying unrestricted. With @p nightFromGps,
+    // night mode follows civil twilight at the GPS position.
     SensorService(boost::asio::io_service &ioService,
-                  aasdk::messenger::IMessenger::Pointer messenger);
+                  aasdk::messenger::IMessenger::Pointer messenger,
+                  std::vector<IVehicleSensorSource::Pointer> vehicleSources = {},
+                  bool restrictWhileMoving = false,
+                  bool nightFromGps = false);
 
     bool isNight = false;
     bool previous = false;
@@ -45,6 +57,11 @@ namespace f1x::openauto::autoapp::service::sensor {
 
     void stop() override;
 
+    // The vehicle sources are joined and the GPS closed before @p done
+    void shutdown(std::function<void()> done) override;
+
+    std::string name() const override { return "sensors"; }
+
     void pause() override;
 
     void resume() override;
@@ -61,23 +78,78 @@ namespace f1x::openauto::autoapp::service::sensor {
   private:
     using std::enable_shared_from_this<SensorService>::shared_from_this;
 
-    void sendDrivingStatusUnrestricted();
+    // Connects GPSD, follows night mode and starts the vehicle sources
+    void activate();
+
+    void sendDrivingStatus();
+
+    static bool toVehicleSensor(aap_protobuf::service::sensorsource::message::SensorType type, VehicleSensor &sensor);
+
+    static void addVehicleReading(aap_protobuf::service::sensorsource::message::SensorBatch &batch,
+                                  const VehicleReading &reading);
+
+    void onVehicleReading(const VehicleReading &reading);
+
+    // Sends the readings that are due and arms the timer for the next one
+    void flushVehicleReadings();
 
     void sendNightData();
 
-    void sendGPSLocationData();
+    // Appends the current fix, if it is usable, to @p batch
+    bool addGPSLocation(aap_protobuf::service::sensorsource::message::SensorBatch &batch);
 
-    bool is_file_exist(const char *filename);
+    void onNightModeChanged(bool night);
 
-    void sensorPolling();
+    void waitForGPS();
+
+    void onGPSReadable(const boost::system::error_code &error);
+
+    void closeGPS();
+
+    // Recomputes twilight if the car moved far enough or the day changed
+    void onSunPosition(double latitude, double longitude);
+
+    // Sets the night flag for now and arms the timer for the next transition
+    void scheduleSun();
 
     bool firstRun = true;
+    bool activated_ = false;
+    int nightModeSubscription_ = 0;
 
     boost::asio::io_service::strand strand_;
-    boost::asio::deadline_timer timer_;
+    // Fixes gathered from one readable gpsd socket go out as one batch
+    static constexpr int cMaxFixesPerBatch = 8;
+
+    // Watches gpsData_.gps_fd; released, not closed, as libgps owns the fd
+    boost::asio::posix::stream_descriptor gpsDescriptor_;
     aasdk::channel::sensorsource::SensorSourceService::Pointer channel_;
     struct gps_data_t gpsData_;
     bool gpsEnabled_ = false;
+
+    // Below this, or in park or with the parking brake on, the car is stopped
+    static constexpr int32_t cMovingSpeedE3 = 1500;
+
+    std::vector<IVehicleSensorSource::Pointer> vehicleSources_;
+    SensorRateLimiter rateLimiter_;
+    boost::asio::steady_timer flushTimer_;
+    SensorRateLimiter::Clock::time_point flushAt_ = SensorRateLimiter::Clock::time_point::max();
+    // GPS and vehicle batches are built here and dropped once sent; strand only
+    MessageArena arena_;
+    const bool restrictWhileMoving_;
+    bool drivingStatusRequested_ = false;
+    bool moving_ = false;
+    int32_t speedE3_ = 0;
+    bool inPark_ = false;
+    bool parkingBrake_ = false;
+
+    // Polar day or night: no transition to wait for, check again after this
+    static constexpr int cSunRecheckHours = 6;
+
+    const bool nightFromGps_;
+    SunSchedule sunSchedule_;
+    boost::asio::steady_timer sunTimer_;
+    double sunLatitude_ = 0.0;
+    double sunLongitude_ = 0.0;
   };
 
 }
@@ -0,0 +1,73 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ctime>
+#include <vector>
+
+namespace f1x::openauto::autoapp::service::sensor {
+
+  /**
+   * @brief Civil twilight times at the car's position, for night mode
+   * without a light sensor.
+   *
+   * Night is while the sun is more than 6 degrees below the horizon. The
+   * dawns and dusks around the current solar day are worked out from a fix
+   * only when the position has moved more than cRecomputeKm since the last
+   * time, or the day changed; between those, night() and nextTransition()
+   * just look them up, so callers can sleep on a timer until the next one.
+   */
+  class SunSchedule {
+  public:
+    static constexpr double cRecomputeKm = 25.0;
+    static constexpr double cTwilightDegrees = -6.0;
+
+    // True when the transitions were recomputed
+    bool update(double latitude, double longitude, std::time_t now);
+    bool hasPosition() const { return hasPosition_; }
+
+    bool night(std::time_t now) const;
+    // The next dawn or dusk after @p now; 0 when there is none within a day,
+    // as in polar summer or winter
+    std::time_t nextTransition(std::time_t now) const;
+
+    // Civil dawn and dusk of the solar day @p day (days since the epoch at
+    // @p longitude); false with @p alwaysNight set when the sun never rises
+    // that high or never sets that low
+    static bool twilight(long day, double latitude, double longitude, std::time_t &dawn, std::time_t &dusk,
+                         bool &alwaysNight);
+    static long solarDay(double longitude, std::time_t now);
+    static double distanceKm(double latitudeA, double longitudeA, double latitudeB, double longitudeB);
+
+  private:
+    struct Transition {
+      std::time_t at;
+      bool night;
+    };
+
+    bool hasPosition_ = false;
+    double latitude_ = 0.0;
+    double longitude_ = 0.0;
+    long day_ = 0;
+    // Sorted, over the solar days before and after day_
+    std::vector<Transition> transitions_;
+    bool alwaysNight_ = false;
+  };
+
+}
@@ -0,0 +1,105 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace f1x::openauto::autoapp::service::sensor {
+
+  /**
+   * @brief Vehicle sensors beyond GPS and night mode that SensorService forwards.
+   */
+  enum class VehicleSensor {
+    Speed,         // [0] m/s * 1e3
+    Gear,          // [0] Android Auto gear code: 0 neutral, 1-10, 100 drive, 101 park, 102 reverse
+    ParkingBrake,  // [0] 1 when engaged
+    Fuel,          // [0] level in percent, [1] 1 when low
+    Compass,       // [0] bearing in degrees * 1e6
+    Accelerometer, // [0..2] x, y, z in m/s^2 * 1e3
+    Gyroscope,     // [0..2] x, y, z in rad/s * 1e3
+    Count
+  };
+
+  const char *vehicleSensorName(VehicleSensor sensor);
+
+  struct VehicleReading {
+    VehicleSensor sensor = VehicleSensor::Count;
+    std::array<int32_t, 3> values{};
+  };
+
+  class IVehicleSensorSource {
+  public:
+    typedef std::shared_ptr<IVehicleSensorSource> Pointer;
+    typedef std::function<void(const VehicleReading &reading)> ReadingHandler;
+
+    virtual ~IVehicleSensorSource() = default;
+
+    // Sensors this source can provide, advertised during service discovery
+    virtual std::vector<VehicleSensor> sensors() const = 0;
+    // @p handler is called from the source's own thread
+    virtual void start(ReadingHandler handler) = 0;
+    virtual void stop() = 0;
+  };
+
+  /**
+   * @brief Base of the sources that read a device on a thread of their own.
+   * Only readings that differ from the last one published reach the handler,
+   * so a CAN bus repeating a frame at 100 Hz costs nothing downstream.
+   * Subclasses must call stop() in their destructor.
+   */
+  class VehicleSensorSource : public IVehicleSensorSource {
+  public:
+    ~VehicleSensorSource() override;
+
+    void start(ReadingHandler handler) override;
+    void stop() override;
+
+  protected:
+    enum class WaitResult { Stopped, Timeout, Readable };
+
+    explicit VehicleSensorSource(std::string threadName);
+
+    virtual void run() = 0;
+
+    /**
+     * @brief Sleeps until @p fd is readable (-1 for none), @p timeoutMs passes
+     * (-1 for no limit) or stop() is called.
+     */
+    WaitResult wait(int fd, int timeoutMs);
+    bool stopping() const;
+    void publish(const VehicleReading &reading);
+
+  private:
+    const std::string threadName_;
+    int wakeFd_;
+    std::atomic<bool> stopping_;
+    ReadingHandler handler_;
+    std::array<VehicleReading, static_cast<size_t>(VehicleSensor::Count)> published_;
+    std::array<bool, static_cast<size_t>(VehicleSensor::Count)> hasPublished_{};
+    std::thread thread_;
+  };
+
+}
@@ -18,8 +18,16 @@
 
 #pragma once
 
+#include <mutex>
 #include <f1x/openauto/autoapp/Service/IServiceFactory.hpp>
 #include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
+#include <f1x/openauto/autoapp/Projection/AudioMixer.hpp>
+#include <f1x/openauto/autoapp/Projection/AudioOutputPool.hpp>
+#include <f1x/openauto/autoapp/Projection/DuplexAudioStream.hpp>
+#include <f1x/openauto/autoapp/Projection/IVideoOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDump.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoModeSelector.hpp>
+#include <f1x/openauto/autoapp/Service/Radio/RadioReceiver.hpp>
 
 namespace f1x {
   namespace openauto {
@@ -28,28 +36,85 @@ namespace f1x {
 
         class ServiceFactory : public IServiceFactory {
         public:
-          ServiceFactory(boost::asio::io_service &ioService, configuration::IConfiguration::Pointer configuration);
+          // Media, microphone and input services run on mediaIoService, the
+          // rest on ioService, so background bursts never delay a video frame
+          ServiceFactory(boost::asio::io_service &ioService, boost::asio::io_service &mediaIoService,
+                         configuration::IConfiguration::Pointer configuration);
+          ~ServiceFactory() override;
           ServiceList create(aasdk::messenger::IMessenger::Pointer messenger) override;
 
+          /**
+           * @brief A media source on the session's audio mixer, for playback
+           * that is not from the phone; null while there is no mixer. Any thread.
+           */
+          projection::AudioMixerChannel::Pointer createLocalPlaybackOutput();
+
+          /**
+           * @brief Mutes local media while the phone holds transient focus
+           * and ducks it where the phone allows ducking. Any thread.
+           */
+          void onPhoneAudioFocus(aap_protobuf::service::control::message::AudioFocusRequestType type) override;
+
+          /**
+           * @brief Restores the phone's learned video mode and ACK window.
+           */
+          void onPhoneIdentified(const std::string &phone) override;
+
         private:
+          // The mixer's channel for @p role, or an RtAudioOutput of its own
+          projection::IAudioOutput::Pointer createAudioOutput(projection::AudioMixerRole role, uint32_t channelCount,
+                                                              uint32_t sampleRate);
           IService::Pointer createBluetoothService(aasdk::messenger::IMessenger::Pointer messenger);
           IService::Pointer createGenericNotificationService(aasdk::messenger::IMessenger::Pointer messenger);
+          IService::Pointer createGuidanceAudioService(aasdk::messenger::IMessenger::Pointer messenger,
+                                                       projection::MediaDumpWriter::Pointer recorder);
           IService::Pointer createInputService(aasdk::messenger::IMessenger::Pointer messenger);
           IService::Pointer createMediaBrowserService(aasdk::messenger::IMessenger::Pointer messenger);
           IService::Pointer createMediaPlaybackStatusService(aasdk::messenger::IMessenger::Pointer messenger);
 
-          void createMediaSinkServices(ServiceList &serviceList, aasdk::messenger::IMessenger::Pointer messenger);
-          void createMediaSourceServices(ServiceList &serviceList, aasdk::messenger::IMessenger::Pointer messenger);
+          void createMediaSinkServices(ServiceList &serviceList, aasdk::messenger::IMessenger::Pointer messenger,
+                                       projection::MediaDumpWriter::Pointer recorder);
+          IService::Pointer createMicrophoneService(aasdk::messenger::IMessenger::Pointer messenger);
 
           IService::Pointer createNavigationStatusService(aasdk::messenger::IMessenger::Pointer messenger);
           IService::Pointer createPhoneStatusService(aasdk::messenger::IMessenger::Pointer messenger);
           IService::Pointer createRadioService(aasdk::messenger::IMessenger::Pointer messenger);
+          // Null unless SessionRecordingPath is set
+          projection::MediaDumpWriter::Pointer createSessionRecorder();
           IService::Pointer createSensorService(aasdk::messenger::IMessenger::Pointer messenger);
+          // The output VideoBackendProbe selected; FFmpeg DRM's is kept warm
+          projection::IVideoOutput::Pointer createVideoOutput();
           IService::Pointer createVendorExtensionService(aasdk::messenger::IMessenger::Pointer messenger);
           IService::Pointer createWifiProjectionService(aasdk::messenger::IMessenger::Pointer messenger);
 
           boost::asio::io_service &ioService_;
+          boost::asio::io_service &mediaIoService_;
           configuration::IConfiguration::Pointer configuration_;
+          // Outlives AndroidAutoEntity so the decoder and DRM context stay warm
+          // between phone connections
+          projection::IVideoOutput::Pointer videoOutput_;
+          // One device stream for every connection's audio channels
+          projection::AudioMixer::Pointer audioMixer_;
+          // Guards audioMixer_ against createLocalPlaybackOutput()
+          std::mutex mixerMutex_;
+          uint32_t audioDeviceId_ = 0;
+          // Guidance and system audio, matched to the device with audioDeviceId_
+          uint32_t promptSampleRate_ = 16000;
+          // Or one kept-open stream per channel, without the mixer
+          projection::AudioOutputPool audioOutputs_;
+          // Passes ducking changes from the settings pages to audioMixer_
+          size_t mixerSubscription_ = 0;
+          // EQ, loudness and limiter of the media streams, mixed or not
+          projection::MediaDspPreset::Pointer mediaDsp_;
+          size_t dspSubscription_ = 0;
+          // Telephony and microphone, while TelephonyAudioChannelEnabled is set
+          projection::DuplexAudioStream::Pointer duplexStream_;
+          // Carries measured decode headroom from one session to the next
+          projection::VideoModeSelector::Pointer videoModeSelector_;
+          // Keeps the scanned station list and last frequency between phone
+          // connections; rebuilt when audioMixer_ is
+          radio::RadioReceiver::Pointer radioReceiver_;
+          projection::AudioMixer::Pointer radioMixer_;
         };
 
       }
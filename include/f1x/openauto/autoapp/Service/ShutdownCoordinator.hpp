@@ -0,0 +1,91 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <f1x/openauto/autoapp/Service/IService.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace service
+{
+
+struct ShutdownStep
+{
+    std::string name;
+    int deadlineMs;
+    // Called on a thread of its own; calls its argument when finished
+    std::function<void(std::function<void()>)> run;
+};
+
+/**
+ * @brief ShutdownCoordinator - Stops independent components in parallel
+ *
+ * Each step runs on a thread of its own, so one blocking stop (a sensor
+ * source joining its reader, a GPS close) no longer delays the ones queued
+ * behind it. A step still running at its deadline is logged by name and
+ * counted, and the caller goes on; its thread is still joined, so what it
+ * stops outlives it. stopServices() waits on a thread of its own too, so
+ * the caller's strand is never blocked.
+ */
+class ShutdownCoordinator
+{
+public:
+    typedef std::function<void(std::vector<std::string> overran)> Handler;
+
+    static constexpr int cDeviceDeadlineMs = 300;
+    static constexpr int cServiceDeadlineMs = 500;
+
+    ShutdownCoordinator() = default;
+    // Joins every step, however late
+    ~ShutdownCoordinator();
+
+    ShutdownCoordinator(const ShutdownCoordinator &) = delete;
+    ShutdownCoordinator &operator=(const ShutdownCoordinator &) = delete;
+
+    // Returns once every step is done or past its deadline, with the names
+    // of those that overran
+    std::vector<std::string> run(const std::vector<ShutdownStep>& steps);
+
+    // Returns at once. The services holding the display and audio devices
+    // go first, then the rest, each group in parallel; then @p handler gets
+    // the names of those that overran, on the coordinator's thread, which
+    // goes on to wait for them. Once only.
+    void stopServices(const ServiceList& services, Handler handler);
+
+    static std::string serviceName(const IService& service);
+
+private:
+    void joinSteps();
+
+    std::vector<std::thread> steps_;
+    std::thread supervisor_;
+};
+
+}
+}
+}
+}
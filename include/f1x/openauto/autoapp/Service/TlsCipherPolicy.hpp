@@ -0,0 +1,56 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <openssl/ssl.h>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace service
+{
+
+// TLS 1.2 and 1.3 cipher orders; both keep every suite DEFAULT allows
+extern const char* const cChaChaFirstCipherList;
+extern const char* const cChaChaFirstCipherSuites;
+extern const char* const cAesFirstCipherList;
+extern const char* const cAesFirstCipherSuites;
+
+/**
+ * @brief True when the CPU has AES instructions (ARMv8 crypto extensions,
+ * AES-NI). The RK3229's Cortex-A7 does not.
+ */
+bool cpuHasAesInstructions();
+
+/**
+ * @brief Offers ChaCha20-Poly1305 before AES-GCM when @p preferChaCha is
+ * set. Without AES instructions ChaCha20 is several times cheaper per
+ * byte, and the phone's TLS stack honours the headunit's order.
+ * @return The order applied, for logging.
+ */
+const char* applyCipherPreference(SSL_CTX* context, bool preferChaCha);
+
+}
+}
+}
+}
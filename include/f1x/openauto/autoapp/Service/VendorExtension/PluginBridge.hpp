@@ -0,0 +1,89 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <f1x/openauto/autoapp/Service/VendorExtension/SharedChannel.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace f1x::openauto::autoapp::service::vendorextension {
+
+  /**
+   * @brief Lets an external process serve one vendor extension channel.
+   *
+   * Listens on a unix socket. A plugin that connects is sent the descriptors
+   * of a fresh SharedChannel and talks through its rings from then on; the
+   * socket only stays open so that its hang-up tells us the plugin is gone.
+   * Its rings are dropped then, and the next plugin starts clean. Accepting
+   * and reading run on the bridge's own thread, and send() never waits for
+   * the plugin, so a stuck or crashed plugin cannot hold up a strand.
+   */
+  class PluginBridge {
+  public:
+    // Called on the bridge's thread
+    typedef std::function<void(std::vector<uint8_t> message)> MessageHandler;
+
+    static constexpr int cVersion = 1;
+
+    PluginBridge(std::string socketPath, std::string channelName);
+    ~PluginBridge();
+
+    bool start(MessageHandler handler);
+    void stop();
+
+    // Any thread. False without a plugin or while it is behind
+    bool send(const void *data, size_t size);
+    bool attached() const;
+    // Messages refused by send() since start()
+    uint64_t dropped() const;
+
+    // Plugin side: connects to @p socketPath and attaches @p channel. Returns
+    // the socket to keep open while attached, or -1
+    static int connect(const std::string &socketPath, SharedChannel &channel, std::string *channelName = nullptr);
+
+    // $XDG_RUNTIME_DIR, else /tmp
+    static std::string socketPath(const std::string &channelName);
+
+  private:
+    void run();
+    void accept();
+    void detach();
+
+    const std::string socketPath_;
+    const std::string channelName_;
+    MessageHandler handler_;
+    int listenFd_ = -1;
+    int peerFd_ = -1;   // bridge thread only
+    int wakeFd_ = -1;
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+
+    // The bridge thread swaps the channel; send() is its only producer
+    mutable std::mutex channelMutex_;
+    std::unique_ptr<SharedChannel> channel_;
+    std::atomic<uint64_t> dropped_{0};
+  };
+
+}
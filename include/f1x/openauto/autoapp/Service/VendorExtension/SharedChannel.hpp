@@ -0,0 +1,87 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <f1x/openauto/autoapp/Projection/LockFreeRingBuffer.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace f1x::openauto::autoapp::service::vendorextension {
+
+  /**
+   * @brief The message rings of one vendor channel, shared with a plugin process.
+   *
+   * A sealed memfd holds one LockFreeRingBuffer per direction, laid out as
+   * in process memory, so a message is copied once into the ring and once
+   * out of it. Each side has an eventfd the other signals after queueing.
+   * Messages are length-prefixed and padded to 4 bytes, so a prefix never
+   * straddles the end of the ring. Nothing here waits on the other side: a
+   * full ring refuses the message, and a malformed one marks the channel
+   * broken.
+   */
+  class SharedChannel {
+  public:
+    enum class Side {
+      Host,
+      Plugin
+    };
+
+    static constexpr size_t cRingBytes = 256 * 1024;
+    static constexpr size_t cMaxMessageBytes = cRingBytes / 4;
+
+    SharedChannel() = default;
+    ~SharedChannel();
+    SharedChannel(const SharedChannel &) = delete;
+    SharedChannel &operator=(const SharedChannel &) = delete;
+
+    // Host: a fresh mapping and its eventfds
+    bool create();
+    // Plugin: maps what the host made, from descriptors() in that order;
+    // takes them over, also on failure
+    bool attach(int memoryFd, int hostWakeFd, int pluginWakeFd);
+    void close();
+    bool valid() const;
+    bool broken() const;
+
+    std::array<int, 3> descriptors() const;
+    // Readable while receive() may have something; drain() before reading
+    int wakeFd() const;
+    void drain();
+
+    // False when the other side is that far behind, or gone
+    bool send(const void *data, size_t size);
+    bool receive(std::vector<uint8_t> &message);
+
+  private:
+    typedef projection::LockFreeRingBuffer<cRingBytes> Ring;
+    struct Layout;
+
+    Ring &outgoing();
+    Ring &incoming();
+
+    Side side_ = Side::Host;
+    int memoryFd_ = -1;
+    int hostWakeFd_ = -1;
+    int pluginWakeFd_ = -1;
+    Layout *layout_ = nullptr;
+    bool broken_ = false;
+  };
+
+}
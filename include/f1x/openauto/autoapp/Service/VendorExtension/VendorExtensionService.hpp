@@ -20,18 +20,31 @@
 
 #include <aasdk/Channel/VendorExtension/VendorExtensionService.hpp>
 #include <f1x/openauto/autoapp/Service/IService.hpp>
+#include <f1x/openauto/autoapp/Service/VendorExtension/PluginBridge.hpp>
 #include <boost/asio/io_service.hpp>
 #include <aasdk/Messenger/IMessenger.hpp>
 
 
 namespace f1x::openauto::autoapp::service::vendorextension {
 
+  /**
+   * @brief Hands a vendor extension channel to a plugin process.
+   *
+   * The plugin (a CAN bridge, a dash app) connects to
+   * PluginBridge::socketPath(serviceName) and exchanges the channel's
+   * payloads through shared rings, so neither a slow nor a crashed plugin
+   * can stall this service's strand.
+   */
   class VendorExtensionService :
       public aasdk::channel::vendorextension::IVendorExtensionServiceEventHandler,
       public IService,
       public std::enable_shared_from_this<VendorExtensionService> {
   public:
-    VendorExtensionService(boost::asio::io_service &ioService, aasdk::messenger::IMessenger::Pointer messenger);
+    // Payloads from the plugin, on this service's strand
+    typedef std::function<void(const std::vector<uint8_t> &payload)> PayloadHandler;
+
+    VendorExtensionService(boost::asio::io_service &ioService, aasdk::messenger::IMessenger::Pointer messenger,
+                           std::string serviceName = std::string());
 
     void start() override;
 
@@ -47,12 +60,19 @@ namespace f1x::openauto::autoapp::service::vendorextension {
 
     void onChannelError(const aasdk::error::Error &e) override;
 
+    // Before start()
+    void setPayloadHandler(PayloadHandler handler);
+    // Any thread. A payload from the phone; dropped without a plugin keeping up
+    void deliver(const std::string &payload);
 
   private:
     using std::enable_shared_from_this<VendorExtensionService>::shared_from_this;
     boost::asio::io_service::strand strand_;
     boost::asio::deadline_timer timer_;
     aasdk::channel::vendorextension::VendorExtensionService::Pointer channel_;
+    const std::string serviceName_;
+    PluginBridge bridge_;
+    PayloadHandler payloadHandler_;
   };
 
 }
@@ -0,0 +1,157 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            // OPENAUTO_SOAK=hours[,disconnectMinutes[,warmupMinutes]]
+            struct SoakSettings
+            {
+                double hours = 24.0;
+                // Longest a session runs before it is ended from our side; 0 never
+                int disconnectMinutes = 0;
+                // Samples before this are left out of the trends: caches and pools fill up first
+                int warmupMinutes = 30;
+                int sampleIntervalMs = 60 * 1000;
+                std::string reportPath = "/tmp/openauto_soak.json";
+                // The video on screen at the last sample in a session, to tell a
+                // session that ran from one that stared at a black screen
+                std::string framePath = "/tmp/openauto_soak_frame.jpg";
+
+                // Growth per hour that fails the run
+                int64_t residentBytesPerHour = 2 * 1024 * 1024;
+                int64_t heapBytesPerHour = 1024 * 1024;
+                int64_t fragmentationPermillePerHour = 10;
+                int64_t cmaLossBytesPerHour = 1024 * 1024;
+                double fdsPerHour = 0.5;
+                double framebuffersPerHour = 0.5;
+                int64_t drmBytesPerHour = 1024 * 1024;
+            };
+
+            // One reading; -1 where the source is missing (no debugfs, no CMA, ...)
+            struct SoakSample
+            {
+                int64_t atMs = 0;
+                int64_t residentBytes = -1;
+                // mallinfo2: allocated from the heap and mmap'd chunks
+                int64_t heapInUseBytes = -1;
+                // Free bytes the heap holds on to, per 1000 bytes of heap
+                int64_t heapFragmentationPermille = -1;
+                int64_t cmaFreeBytes = -1;
+                int64_t openFds = -1;
+                // This process' framebuffers in debugfs dri/*/framebuffer
+                int64_t drmFramebuffers = -1;
+                // drm-total-* of this process' DRM clients in fdinfo: its GEM objects
+                int64_t drmBufferBytes = -1;
+                uint64_t sessions = 0;
+            };
+
+            // A resource that kept growing
+            struct SoakFinding
+            {
+                std::string resource;
+                double perHour = 0.0;
+                double limitPerHour = 0.0;
+            };
+
+            /**
+             * @brief SoakMonitor - Resource trends over a long unattended run
+             *
+             * Leaks that matter in a car show up after hours: RSS creep, a heap
+             * that fragments, framebuffers or GEM objects a teardown path
+             * forgot. In soak mode autoapp samples every minute and, with
+             * disconnectMinutes set, ends each session at a random point
+             * through the same path as a phone quitting, so setup and
+             * teardown run hundreds of times. tests/bench/soak_bench plays the
+             * phone from a recorded session. When the run is over each
+             * resource's least-squares slope after the warm-up is checked
+             * against its limit; the samples and findings go to reportPath
+             * and the finished handler gets the verdict.
+             */
+            class SoakMonitor : public std::enable_shared_from_this<SoakMonitor>
+            {
+            public:
+                typedef std::shared_ptr<SoakMonitor> Pointer;
+                typedef std::function<void()> DisconnectHandler;
+                typedef std::function<void(bool passed)> FinishedHandler;
+
+                // Fewer samples than this after the warm-up decide nothing
+                static constexpr size_t cMinTrendSamples = 10;
+
+                static bool parseSpec(const std::string &spec, SoakSettings &settings);
+
+                SoakMonitor(boost::asio::io_service &ioService, SoakSettings settings);
+
+                void start(DisconnectHandler disconnectHandler, FinishedHandler finishedHandler);
+                void stop();
+
+                // From the App's session callbacks, any thread
+                void onSessionStarted();
+                void onSessionStopped();
+
+                static SoakSample sample();
+                static std::vector<SoakFinding> evaluate(const std::vector<SoakSample> &samples,
+                                                         const SoakSettings &settings);
+                // Least-squares slope of @p field per hour, ignoring unknown readings
+                static double slopePerHour(const std::vector<SoakSample> &samples, int64_t SoakSample::*field);
+                // Entries of a debugfs framebuffer listing allocated by one of
+                // @p comms, which are per thread
+                static int64_t parseFramebuffers(std::istream &in, const std::set<std::string> &comms);
+                // drm-total-* (or drm-memory-*) bytes of an fdinfo listing; -1 if none
+                static int64_t parseDrmFdinfo(std::istream &in, std::string &clientId);
+
+            private:
+                void scheduleSample();
+                void scheduleDisconnect();
+                void finish();
+                void writeReport(const std::vector<SoakFinding> &findings) const;
+
+                boost::asio::io_service::strand strand_;
+                boost::asio::steady_timer sampleTimer_;
+                boost::asio::steady_timer disconnectTimer_;
+                const SoakSettings settings_;
+                std::chrono::steady_clock::time_point started_;
+                std::mt19937 random_;
+                DisconnectHandler disconnectHandler_;
+                FinishedHandler finishedHandler_;
+                std::vector<SoakSample> samples_;
+                uint64_t sessions_ = 0;
+                bool inSession_ = false;
+                bool stopped_ = true;
+            };
+
+        }
+    }
+}
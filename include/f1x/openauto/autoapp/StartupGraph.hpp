@@ -0,0 +1,129 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            /**
+             * @brief StartupGraph - Startup steps run beside the GUI thread
+             *
+             * Each task names the tasks it comes after, and runs on the
+             * io_service pool once they are done, while main() goes on
+             * creating the window and loading QML. At most @p concurrency
+             * tasks run at once, so a worker stays free for a phone that is
+             * plugged in meanwhile. A task that throws is logged and the
+             * tasks after it are skipped. When the last task is done every
+             * task's wait and run time is logged, and set as the
+             * openauto_startup_<name>_ms gauge.
+             */
+            class StartupGraph
+            {
+            public:
+                typedef std::function<void()> Task;
+
+                struct Timing
+                {
+                    std::string name;
+                    int64_t readyMs = -1;    // Dependencies done, from start()
+                    int64_t startedMs = -1;  // Picked up by a worker, from start()
+                    int64_t durationMs = -1; // -1 if it did not run
+                    bool failed = false;     // Threw, or a task before it did
+                };
+
+                StartupGraph(boost::asio::io_service &ioService, size_t concurrency);
+                // Waits for the tasks a worker is running; the pool must not
+                // pick up any more once this is destroyed
+                ~StartupGraph();
+
+                StartupGraph(const StartupGraph &) = delete;
+                StartupGraph &operator=(const StartupGraph &) = delete;
+
+                /**
+                 * @brief Adds a task before start(). @p name is lower case
+                 * with underscores, as it names a gauge.
+                 * @param after Tasks added earlier that must finish first
+                 * @return false for a name already taken or an unknown dependency
+                 */
+                bool add(std::string name, std::vector<std::string> after, Task task);
+
+                void start();
+
+                // Blocks until every task is done, or @p timeout passes
+                bool wait(std::chrono::milliseconds timeout = std::chrono::milliseconds(30000));
+
+                std::vector<Timing> timings() const;
+                std::string report() const;
+
+            private:
+                enum class State
+                {
+                    Waiting,
+                    Ready,
+                    Running,
+                    Done,
+                    Failed,
+                    Skipped
+                };
+
+                struct Node
+                {
+                    Timing timing;
+                    Task task;
+                    std::vector<size_t> next;
+                    size_t pending = 0;
+                    State state = State::Waiting;
+                };
+
+                int64_t sinceStart() const;
+                // With mutex_ held
+                void dispatch();
+                void run(size_t index);
+                void finish(size_t index, State state);
+                void publish();
+
+                boost::asio::io_service &ioService_;
+                const size_t concurrency_;
+                mutable std::mutex mutex_;
+                std::condition_variable done_;
+                std::vector<Node> nodes_;
+                std::vector<size_t> ready_;
+                size_t running_;   // Posted to the pool, not finished
+                size_t executing_; // On a worker right now
+                size_t finished_;
+                bool started_;
+                std::chrono::steady_clock::time_point startedAt_;
+            };
+
+        }
+    }
+}
@@ -0,0 +1,55 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            /**
+             * @brief StartupTrace - Timestamps of cold-start phases
+             *
+             * Logs each phase against both process start and system boot, so
+             * time-to-Android-Auto after ignition can be tracked across builds.
+             * Safe to call from any thread.
+             */
+            class StartupTrace
+            {
+            public:
+                static void mark(const char *phase);
+                // Marks @p phase only the first time it is reached
+                static void markOnce(const char *phase);
+
+                /**
+                 * @brief Starts timing a connection, e.g. a phone plugged in.
+                 * Ignored while one started less than a minute ago is pending,
+                 * so a phone re-enumerating in accessory mode keeps its start.
+                 * @param source Static string naming the trigger.
+                 */
+                static void beginConnection(const char *source);
+                // The session showed its first frame: logs and charts the pending connection
+                static void connectionProjected();
+            };
+
+        }
+    }
+}
@@ -0,0 +1,120 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            /**
+             * @brief Flags shared with the system scripts as files in /tmp.
+             */
+            enum class StateFlag
+            {
+                NightMode,        // night_mode_enabled
+                EntityExit,       // entityexit: the phone asked to return to the OS
+                BluetoothDevice,  // btdevice, holding the connected device's name
+                HotspotActive,    // hotspot_active
+                DashcamRecording, // dashcam_is_recording
+                ReverseGear,      // rearcam_enabled, from the reverse gear GPIO
+                Navigation,       // navigation_state, a serialized NavigationState
+                PhoneStatus,      // phone_status, a serialized PhoneStatus
+                Count
+            };
+
+            /**
+             * @brief StateBus - In-process view of the /tmp flag files
+             *
+             * One inotify watch on the directory keeps every flag and its
+             * content cached, and change events go to subscribers from the bus
+             * thread, so readers never touch the filesystem. set() and clear()
+             * still write the file, as the scripts outside the process rely on it.
+             */
+            class StateBus
+            {
+            public:
+                typedef std::function<void(StateFlag flag, bool isSet)> Handler;
+
+                explicit StateBus(std::string directory);
+                ~StateBus();
+
+                StateBus(const StateBus &) = delete;
+                StateBus &operator=(const StateBus &) = delete;
+
+                /**
+                 * @brief The bus watching /tmp, started on first use.
+                 */
+                static StateBus &instance();
+
+                bool isSet(StateFlag flag) const;
+                // File content with surrounding whitespace removed; empty when unset
+                std::string value(StateFlag flag) const;
+
+                void set(StateFlag flag, const std::string &value = std::string());
+                void clear(StateFlag flag);
+
+                /**
+                 * @brief Calls @p handler on the bus thread whenever @p flag or
+                 * its content changes. Handlers must not block.
+                 * @return Id for unsubscribe().
+                 */
+                int subscribe(StateFlag flag, Handler handler);
+                void unsubscribe(int id);
+
+            private:
+                static constexpr size_t cFlagCount = static_cast<size_t>(StateFlag::Count);
+                static constexpr size_t cMaxValueSize = 256;
+
+                struct Entry
+                {
+                    bool isSet = false;
+                    std::string value;
+                };
+
+                std::string path(StateFlag flag) const;
+                void refresh(StateFlag flag);
+                void update(StateFlag flag, bool isSet, std::string value);
+                void run();
+
+                const std::string directory_;
+                mutable std::mutex mutex_;
+                std::array<Entry, cFlagCount> entries_;
+                std::map<int, std::pair<StateFlag, Handler>> handlers_;
+                int nextHandlerId_;
+                int inotifyFd_;
+                int wakeFd_;
+                std::atomic<bool> stopping_;
+                std::thread thread_;
+            };
+
+        }
+    }
+}
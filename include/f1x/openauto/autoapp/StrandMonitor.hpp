@@ -0,0 +1,162 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            // One kind of strand handler, e.g. every video ack dispatch
+            struct StrandSite
+            {
+                const char *name;
+                MetricHistogram &queueMs;
+                MetricHistogram &runMs;
+                MetricCounter &longTasks;
+                common::LogSite log;
+            };
+
+            /**
+             * @brief StrandMonitor - Queueing delay and run time of strand handlers
+             *
+             * Every service runs its handlers on a strand of the shared
+             * io_service pool, so one slow handler (a blocking gps_read, a
+             * synchronous write) delays every other handler queued behind it
+             * on that worker. Handlers wrapped with monitored() or timed by a
+             * StrandTask feed a queue and a run histogram per site; one that
+             * runs past the long-task threshold is counted and logged, at most
+             * once per cLogIntervalMs per site. Off until configure() turns it
+             * on; until then a wrapped handler costs two relaxed loads.
+             */
+            class StrandMonitor
+            {
+            public:
+                typedef std::chrono::steady_clock Clock;
+
+                static constexpr int cLogIntervalMs = 10000;
+
+                static StrandMonitor &instance();
+
+                // [Threads] StrandMonitor and StrandLongTaskMs
+                void configure(bool enabled, int longTaskMs);
+                bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+                // Registers the metrics of @p name once; see OPENAUTO_STRAND_SITE
+                StrandSite &site(const char *name);
+
+                // @p queued is a default time_point when only the run is known
+                void ran(StrandSite &site, Clock::time_point queued, Clock::time_point started,
+                         Clock::time_point finished);
+
+            private:
+                std::atomic<bool> enabled_{false};
+                std::atomic<int64_t> longTaskUs_{20000};
+                MetricCounter &longTasks_;
+                std::mutex mutex_;
+                std::map<std::string, std::unique_ptr<StrandSite>> sites_;
+
+                StrandMonitor();
+            };
+
+            /**
+             * @brief StrandTask - Times the enclosing block as one run of a site
+             * For the handlers aasdk hands the strand, like channel indications,
+             * which have no dispatch of ours to wrap. Also a pipeline trace scope.
+             */
+            class StrandTask
+            {
+            public:
+                explicit StrandTask(StrandSite &site, StrandMonitor::Clock::time_point queued = {});
+                ~StrandTask();
+
+                StrandTask(const StrandTask &) = delete;
+                StrandTask &operator=(const StrandTask &) = delete;
+
+            private:
+                StrandSite &site_;
+                const bool timed_;
+                StrandMonitor::Clock::time_point queued_;
+                StrandMonitor::Clock::time_point started_;
+                int64_t traceStartNs_;
+            };
+
+            template <typename Handler>
+            class MonitoredHandler
+            {
+            public:
+                MonitoredHandler(StrandSite *site, StrandMonitor::Clock::time_point queued, Handler handler)
+                    : site_(site), queued_(queued), handler_(std::move(handler))
+                {
+                }
+
+                template <typename... Args>
+                void operator()(Args &&...args)
+                {
+                    StrandTask task(*site_, queued_);
+                    handler_(std::forward<Args>(args)...);
+                }
+
+            private:
+                StrandSite *site_;
+                StrandMonitor::Clock::time_point queued_;
+                Handler handler_;
+            };
+
+            // For strand dispatch() and post(): the wait for the strand and the run
+            template <typename Handler>
+            MonitoredHandler<std::decay_t<Handler>> monitored(StrandSite &site, Handler &&handler)
+            {
+                const auto queued = StrandMonitor::instance().enabled() ? StrandMonitor::Clock::now()
+                                                                        : StrandMonitor::Clock::time_point();
+                return {&site, queued, std::forward<Handler>(handler)};
+            }
+
+            // For strand wrap() on timers and I/O, whose wait is not the strand's: the run only
+            template <typename Handler>
+            MonitoredHandler<std::decay_t<Handler>> monitoredCompletion(StrandSite &site, Handler &&handler)
+            {
+                return {&site, {}, std::forward<Handler>(handler)};
+            }
+
+        }
+    }
+}
+
+// The site named @p name (a literal), looked up once per call site
+#define OPENAUTO_STRAND_SITE(name)                                                     \
+    ([]() -> ::f1x::openauto::autoapp::StrandSite & {                                  \
+        static ::f1x::openauto::autoapp::StrandSite &site =                            \
+            ::f1x::openauto::autoapp::StrandMonitor::instance().site(name);            \
+        return site;                                                                   \
+    }())
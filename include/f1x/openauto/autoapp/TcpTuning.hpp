@@ -0,0 +1,85 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <mutex>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            // [Wireless] Tcp* in openauto.ini
+            struct TcpTuningSettings
+            {
+                bool noDelay = true;
+                // 0 keeps the kernel's buffer autotuning, which a fixed size turns off
+                int receiveBufferBytes = 1024 * 1024;
+                int sendBufferBytes = 512 * 1024;
+                bool quickAck = true;
+                // AF41, which 802.11 maps to the video access category; -1 leaves IP_TOS alone
+                int dscp = 34;
+                // 0 is off; raising it needs CAP_NET_ADMIN
+                int busyPollUs = 0;
+                // Samples TCP_INFO while a wireless session runs
+                bool linkStats = true;
+            };
+
+            /**
+             * @brief TcpTuning - Socket options of the wireless projection link
+             *
+             * The phone streams video over one TCP connection, so Nagle, a
+             * delayed ACK or a receive window that stops growing shows up as
+             * frame latency. apply() sets the options on each accepted client
+             * and publishes what the kernel actually granted (it doubles and
+             * caps buffer sizes); a refused option is counted and logged, and
+             * the connection goes ahead without it. sample() reads the kernel's
+             * own RTT estimates from TCP_INFO and re-arms TCP_QUICKACK, which
+             * Linux drops again once the connection looks interactive.
+             */
+            class TcpTuning
+            {
+            public:
+                static constexpr int cSampleIntervalMs = 1000;
+
+                static TcpTuning &instance();
+
+                void configure(const TcpTuningSettings &settings);
+                TcpTuningSettings settings() const;
+
+                // Buffer sizes on the listening socket: the window scale is
+                // agreed in the handshake, before apply() can run
+                void applyListener(int fd);
+                // Every option on an accepted client; returns how many were refused
+                int apply(int fd);
+                // false when TCP_INFO could not be read, e.g. the socket is gone
+                bool sample(int fd);
+
+            private:
+                TcpTuning();
+
+                mutable std::mutex mutex_;
+                TcpTuningSettings settings_;
+            };
+
+        }
+    }
+}
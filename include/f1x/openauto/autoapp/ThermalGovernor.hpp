@@ -0,0 +1,109 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            enum class ThermalLevel
+            {
+                Normal,
+                Warm, // a clock is capped, or the hottest zone is past cWarmMilliC
+                Hot   // the hottest zone is past cHotMilliC
+            };
+
+            const char *thermalLevelName(ThermalLevel level);
+
+            struct ThermalReading
+            {
+                int hottestMilliC = 0;
+                // A cpufreq policy or devfreq device (VPU, GPU, DDR) capped below
+                // the maximum it had at the first reading, which the thermal
+                // framework does before anything else
+                bool clocksCapped = false;
+            };
+
+            /**
+             * @brief ThermalGovernor - Heat-driven quality level
+             *
+             * Samples every thermal zone and the frequency caps of the cpufreq
+             * policies and devfreq devices, and moves one level up as soon as a
+             * reading calls for it. Coming back down takes cRecoverySamples
+             * readings in a row cHysteresisMilliC below the level's threshold
+             * with no clock capped, so quality does not flap around a trip
+             * point. The video mode selector, the media EQ and the UI timers
+             * read level(); it is a plain atomic for the audio thread.
+             */
+            class ThermalGovernor
+            {
+            public:
+                typedef std::function<void(ThermalLevel level)> Handler;
+
+                static constexpr int cWarmMilliC = 80000;
+                static constexpr int cHotMilliC = 90000;
+                static constexpr int cHysteresisMilliC = 5000;
+                static constexpr int cRecoverySamples = 6;
+                static constexpr int cSampleIntervalMs = 5000;
+
+                static ThermalGovernor &instance();
+
+                /**
+                 * @param sysfsRoot Holds class/thermal, class/devfreq and
+                 * devices/system/cpu/cpufreq; a test tree in the unit tests.
+                 */
+                explicit ThermalGovernor(std::string sysfsRoot = "/sys");
+
+                // Reads the sysfs nodes and applies the reading; every
+                // cSampleIntervalMs from the UI thread
+                void sample();
+                ThermalLevel update(const ThermalReading &reading);
+                ThermalReading read();
+
+                ThermalLevel level() const { return level_.load(std::memory_order_relaxed); }
+
+                // Called from sample() after each level change
+                void setHandler(Handler handler);
+
+            private:
+                // Whether @p path holds a frequency below its first reading
+                bool capped(const std::string &path);
+
+                std::string sysfsRoot_;
+                std::map<std::string, long> ceilings_; // read() only
+                std::mutex mutex_;
+                Handler handler_;
+                int coolSamples_ = 0;
+                std::atomic<ThermalLevel> level_{ThermalLevel::Normal};
+            };
+
+        }
+    }
+}
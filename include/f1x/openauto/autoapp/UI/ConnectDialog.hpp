@@ -6,6 +6,7 @@
 #include <aasdk/TCP/ITCPEndpoint.hpp>
 #include <aasdk/TCP/ITCPWrapper.hpp>
 #include <f1x/openauto/autoapp/Configuration/IRecentAddressesList.hpp>
+#include <f1x/openauto/autoapp/WifiConnector.hpp>
 
 namespace Ui {
 class ConnectDialog;
@@ -49,6 +50,8 @@ private:
     void insertIpAddress(const std::string& ipAddress);
     void loadRecentList();
     void setControlsEnabledStatus(bool status);
+    // Races @p first, then the recent addresses and hotspot clients
+    void connectToPhone(const std::string& first);
     void connectHandler(const boost::system::error_code& ec, const std::string& ipAddress, aasdk::tcp::ITCPEndpoint::SocketPointer socket);
 
     boost::asio::io_service& ioService_;
@@ -56,6 +59,7 @@ private:
     openauto::autoapp::configuration::IRecentAddressesList& recentAddressesList_;
     Ui::ConnectDialog *ui_;
     QStringListModel recentAddressesModel_;
+    WifiConnector::Pointer connector_;
 };
 
 }
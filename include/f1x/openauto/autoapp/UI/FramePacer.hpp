@@ -0,0 +1,119 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QQuickWindow>
+#include <QString>
+#include <QTimer>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace ui
+            {
+
+                /**
+                 * @brief FramePacer - Frame-rate cap and frame-time HUD of the QML window
+                 *
+                 * With the threaded render loop the scene graph renders and swaps
+                 * on its own thread, and animations advance once per swapped frame,
+                 * so they follow vsync. Pages that only show a clock do not need
+                 * every vblank: Main.qml sets frameCap from the current page, 0
+                 * (the panel's rate) while something moves. A capped frame is held
+                 * on the render thread after the sync, so the GUI thread and its
+                 * touch handling never wait for the hold. The HUD, shown in debug
+                 * mode, counts what was swapped.
+                 */
+                class FramePacer : public QObject
+                {
+                    Q_OBJECT
+
+                    Q_PROPERTY(int frameCap READ frameCap WRITE setFrameCap NOTIFY frameCapChanged)
+                    Q_PROPERTY(bool hudEnabled READ hudEnabled WRITE setHudEnabled NOTIFY hudEnabledChanged)
+                    Q_PROPERTY(QString frameStats READ frameStats NOTIFY frameStatsChanged)
+
+                public:
+                    static constexpr int cHudIntervalMs = 500;
+
+                    explicit FramePacer(QObject *parent = nullptr);
+
+                    /**
+                     * @brief Paces @p window from its next frame on. Called once the
+                     * QML is loaded; the properties can be bound before.
+                     */
+                    void attach(QQuickWindow *window);
+
+                    int frameCap() const;
+                    void setFrameCap(int fps);
+
+                    bool hudEnabled() const;
+                    void setHudEnabled(bool enabled);
+
+                    QString frameStats() const;
+
+                    /**
+                     * @brief Microseconds to hold a frame that is about to render
+                     * @p sinceSwapUs after the last swap, so it swaps on the cap's
+                     * cadence. 0 when uncapped or already due.
+                     */
+                    static int64_t holdUs(int64_t sinceSwapUs, int capFps, int64_t refreshPeriodUs);
+
+                signals:
+                    void frameCapChanged();
+                    void hudEnabledChanged();
+                    void frameStatsChanged();
+
+                private:
+                    struct FrameCounters
+                    {
+                        int frames = 0;
+                        int64_t renderTotalUs = 0; // Hold excluded
+                        int64_t renderWorstUs = 0;
+                    };
+
+                    // Render thread
+                    void beforeRendering();
+                    void frameSwapped();
+
+                    void publishStats();
+
+                    QPointer<QQuickWindow> window_;
+                    QTimer *hudTimer_;
+                    std::atomic<int> frameCap_;
+                    std::atomic<int64_t> refreshPeriodUs_;
+                    std::atomic<bool> hudEnabled_;
+                    int64_t lastSwapUs_;    // Render thread only, 0 before the first frame
+                    int64_t renderStartUs_; // Render thread only
+                    std::mutex countersMutex_;
+                    FrameCounters counters_;
+                    QString frameStats_;
+                };
+
+            } // namespace ui
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,72 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QHash>
+#include <QImage>
+#include <QQuickImageProvider>
+#include <QRect>
+#include <future>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace ui
+            {
+
+                /**
+                 * @brief IconAtlas - The QML icons, served from one pre-baked atlas
+                 *
+                 * scripts/pack_icons.py packs the icons the pages show into one
+                 * premultiplied RGBA image at build time. It is inflated once, off
+                 * the GUI thread, while the QML loads; after that an icon is a copy
+                 * of its rectangle, so showing a page decodes no PNG. Served as
+                 * image://icons/<file name>; icons missing from the atlas (or a
+                 * build without it) are read from the resource file as before.
+                 */
+                class IconAtlas : public QQuickImageProvider
+                {
+                public:
+                    static constexpr const char *cProviderId = "icons";
+
+                    IconAtlas();
+                    ~IconAtlas() override;
+
+                    // Any thread: asynchronous Images ask from the loader thread
+                    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+
+                private:
+                    struct Atlas
+                    {
+                        QImage pixels;
+                        QHash<QString, QRect> icons;
+                    };
+
+                    static Atlas load();
+
+                    std::shared_future<Atlas> atlas_;
+                };
+
+            } // namespace ui
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
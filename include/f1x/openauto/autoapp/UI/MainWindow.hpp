@@ -42,6 +42,7 @@
 #include <taglib/tag.h>
 
 #include <QFileSystemWatcher>
+#include <QTimer>
 #include <QKeyEvent>
 
 #include <QBluetoothLocalDevice>
@@ -180,7 +181,6 @@ private:
     QString bversion;
     QString bdate;
 
-    char nightModeFile[32] = "/tmp/night_mode_enabled";
     char devModeFile[32] = "/tmp/dev_mode_enabled";
     char wifiButtonFile[32] = "/etc/button_wifi_visible";
     char cameraButtonFile[32] = "/etc/button_camera_visible";
@@ -273,8 +273,15 @@ private:
 
     QBluetoothLocalDevice *localDevice;
 
+    // Music folders, playlist and file watchers, set up on the first show
+    void initMedia();
+    QTimer *clockTimer_ = nullptr;
+    bool mediaInitialised_ = false;
+
 protected:
     void keyPressEvent(QKeyEvent *event);
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
 
 };
 
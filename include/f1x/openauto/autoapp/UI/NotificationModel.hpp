@@ -0,0 +1,93 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QAbstractListModel>
+#include <QString>
+#include <QVector>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace ui
+            {
+
+                /**
+                 * @brief NotificationModel - The phone's notification toasts, for QML
+                 *
+                 * The notification service publishes whole snapshots from its own
+                 * thread; they are diffed here on the GUI thread, so a toast whose
+                 * text did not change keeps its delegate (and its cached layer
+                 * texture) untouched.
+                 */
+                class NotificationModel : public QAbstractListModel
+                {
+                    Q_OBJECT
+
+                    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+                public:
+                    struct Toast
+                    {
+                        QString id;
+                        QString title;
+                        QString text;
+                        int count = 1;
+
+                        bool operator==(const Toast &other) const;
+                    };
+
+                    enum Roles
+                    {
+                        IdRole = Qt::UserRole + 1,
+                        TitleRole,
+                        TextRole,
+                        CountRole
+                    };
+
+                    // Lives on the GUI thread whichever thread asks first
+                    static NotificationModel &instance();
+
+                    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+                    QVariant data(const QModelIndex &index, int role) const override;
+                    QHash<int, QByteArray> roleNames() const override;
+
+                    int count() const;
+
+                    // Any thread. Toasts that stay keep their relative order
+                    void publish(QVector<Toast> toasts);
+
+                signals:
+                    void countChanged();
+
+                private:
+                    NotificationModel();
+
+                    void apply(const QVector<Toast> &toasts);
+
+                    QVector<Toast> toasts_;
+                };
+
+            } // namespace ui
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
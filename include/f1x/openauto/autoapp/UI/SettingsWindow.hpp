@@ -97,6 +97,7 @@ public slots:
 
 private:
   void showEvent(QShowEvent *event) override;
+  void hideEvent(QHideEvent *event) override;
   void load();
   void loadButtonCheckBoxes();
   void saveButtonCheckBoxes();
@@ -120,7 +121,9 @@ private:
   Ui::SettingsWindow *ui_;
   configuration::IConfiguration::Pointer configuration_;
   QTimer *audioMeterTimer_;
+  QTimer *refreshTimer_;
   QProcess *audioLevelProcess_;
+  bool audioDevicesListed_ = false;
 
   void getMacMemoryInfo(QString &freeMemory);
 };
@@ -0,0 +1,80 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <vector>
+
+typedef struct _snd_mixer snd_mixer_t;
+typedef struct _snd_mixer_elem snd_mixer_elem_t;
+
+class QSocketNotifier;
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace ui
+            {
+
+                /**
+                 * @brief SystemVolume - ALSA mixer playback control
+                 *
+                 * Reads and writes the control through snd_mixer directly and
+                 * watches the mixer's poll descriptors, so changes made by other
+                 * processes (or the hardware) arrive as percentChanged().
+                 */
+                class SystemVolume : public QObject
+                {
+                    Q_OBJECT
+
+                public:
+                    explicit SystemVolume(const QString &control = "Master", QObject *parent = nullptr);
+                    ~SystemVolume() override;
+
+                    bool isAvailable() const;
+                    /** @brief Volume in percent of the control's range, -1 if unavailable */
+                    int percent() const;
+                    void setPercent(int percent);
+
+                signals:
+                    void percentChanged(int percent);
+
+                private:
+                    static int onElementEvent(snd_mixer_elem_t *element, unsigned int mask);
+                    void onMixerEvent();
+                    void refresh();
+                    int readPercent() const;
+                    void close();
+
+                    snd_mixer_t *mixer_;
+                    snd_mixer_elem_t *element_;
+                    long min_;
+                    long max_;
+                    int percent_;
+                    std::vector<QSocketNotifier *> notifiers_;
+                };
+
+            } // namespace ui
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
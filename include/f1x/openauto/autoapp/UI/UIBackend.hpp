@@ -22,8 +22,11 @@
 #include <QString>
 #include <QStringList>
 #include <QTimer>
+#include <QThread>
 #include <memory>
 #include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
+#include <f1x/openauto/autoapp/PhoneStatus.hpp>
+#include <f1x/openauto/autoapp/ThermalGovernor.hpp>
 
 namespace f1x
 {
@@ -34,6 +37,9 @@ namespace f1x
             namespace ui
             {
 
+                class SystemVolume;
+                class WifiStatus;
+
                 /**
                  * @brief UIBackend - Bridge between QML UI and C++ backend
                  *
@@ -56,6 +62,11 @@ namespace f1x
                     Q_PROPERTY(bool bluetoothConnected READ bluetoothConnected NOTIFY bluetoothChanged)
                     Q_PROPERTY(bool wifiConnected READ wifiConnected NOTIFY networkChanged)
                     Q_PROPERTY(QString wifiIP READ wifiIP NOTIFY networkChanged)
+                    Q_PROPERTY(int phoneSignal READ phoneSignal NOTIFY phoneSignalChanged)
+                    Q_PROPERTY(int phoneBattery READ phoneBattery NOTIFY phoneBatteryChanged)
+                    Q_PROPERTY(bool phoneBatteryCritical READ phoneBatteryCritical NOTIFY phoneBatteryChanged)
+                    Q_PROPERTY(bool phoneInCall READ phoneInCall NOTIFY phoneCallChanged)
+                    Q_PROPERTY(QString phoneCaller READ phoneCaller NOTIFY phoneCallChanged)
 
                     // ========== General Settings ==========
                     Q_PROPERTY(bool showClock READ showClock WRITE setShowClock NOTIFY settingsChanged)
@@ -75,6 +86,7 @@ namespace f1x
                     Q_PROPERTY(int videoMarginWidth READ videoMarginWidth NOTIFY settingsChanged)
                     Q_PROPERTY(int videoMarginHeight READ videoMarginHeight NOTIFY settingsChanged)
                     Q_PROPERTY(int omxLayerIndex READ omxLayerIndex NOTIFY settingsChanged)
+                    Q_PROPERTY(bool videoCompositorImport READ videoCompositorImport NOTIFY settingsChanged)
 
                     // ========== Audio Settings ==========
                     Q_PROPERTY(QString audioOutputDevice READ audioOutputDevice NOTIFY settingsChanged)
@@ -107,6 +119,11 @@ namespace f1x
                     Q_PROPERTY(bool disableShutdown READ disableShutdown WRITE setDisableShutdown NOTIFY settingsChanged)
                     Q_PROPERTY(bool disableScreenOff READ disableScreenOff WRITE setDisableScreenOff NOTIFY settingsChanged)
                     Q_PROPERTY(bool debugMode READ debugMode WRITE setDebugMode NOTIFY settingsChanged)
+                    Q_PROPERTY(QString videoStats READ videoStats NOTIFY systemInfoChanged)
+                    Q_PROPERTY(bool pipelineTracing READ pipelineTracing WRITE setPipelineTracing NOTIFY pipelineTracingChanged)
+                    Q_PROPERTY(QString traceFile READ traceFile NOTIFY pipelineTracingChanged)
+                    Q_PROPERTY(bool metricsOverlay READ metricsOverlay CONSTANT)
+                    Q_PROPERTY(QString metricsSummary READ metricsSummary NOTIFY metricsChanged)
 
                     // ========== About Info ==========
                     Q_PROPERTY(QString versionString READ versionString CONSTANT)
@@ -120,6 +137,13 @@ namespace f1x
                     Q_PROPERTY(QString albumArtPath READ albumArtPath NOTIFY musicChanged)
                     Q_PROPERTY(bool isPlaying READ isPlaying NOTIFY musicChanged)
 
+                    // ========== Projection ==========
+                    Q_PROPERTY(bool projectionActive READ projectionActive NOTIFY projectionActiveChanged)
+                    Q_PROPERTY(bool uiAboveVideo READ uiAboveVideo NOTIFY uiAboveVideoChanged)
+
+                    // ========== Theme ==========
+                    Q_PROPERTY(bool nightMode READ nightMode NOTIFY nightModeChanged)
+
                 public:
                     explicit UIBackend(configuration::IConfiguration::Pointer configuration,
                                        QObject *parent = nullptr);
@@ -137,6 +161,12 @@ namespace f1x
                     bool bluetoothConnected() const;
                     bool wifiConnected() const;
                     QString wifiIP() const;
+                    // From the connected phone; -1 while unknown
+                    int phoneSignal() const;
+                    int phoneBattery() const;
+                    bool phoneBatteryCritical() const;
+                    bool phoneInCall() const;
+                    QString phoneCaller() const;
 
                     // ========== General Settings Getters ==========
                     bool showClock() const;
@@ -156,6 +186,7 @@ namespace f1x
                     int videoMarginWidth() const;
                     int videoMarginHeight() const;
                     int omxLayerIndex() const;
+                    bool videoCompositorImport() const;
 
                     // ========== Audio Settings Getters ==========
                     QString audioOutputDevice() const;
@@ -188,6 +219,13 @@ namespace f1x
                     bool disableShutdown() const;
                     bool disableScreenOff() const;
                     bool debugMode() const;
+                    QString videoStats() const;
+                    // Debug mode only; stopping writes a Chrome trace to traceFile()
+                    bool pipelineTracing() const;
+                    QString traceFile() const;
+                    // [Metrics] Overlay: the registry drawn over everything, projection included
+                    bool metricsOverlay() const;
+                    QString metricsSummary() const;
 
                     // ========== About Getters ==========
                     QString versionString() const;
@@ -201,6 +239,25 @@ namespace f1x
                     QString albumArtPath() const;
                     bool isPlaying() const;
 
+                    // ========== Projection Getters ==========
+                    // True while Android Auto video owns the screen
+                    bool projectionActive() const;
+                    // True while the video plane is stacked below the UI, so a
+                    // transparent window keeps overlays on top of the projection
+                    bool uiAboveVideo() const;
+                    void setUiAboveVideo(bool above);
+                    // The NightMode flag, which Theme.qml switches palettes on
+                    bool nightMode() const;
+                    // Each level above normal halves how often the system info
+                    // and the metrics overlay refresh
+                    void setThermalLevel(ThermalLevel level);
+                    // Screen off without a phone: nothing the timers refresh
+                    // is seen, so they stop until the next touch or session
+                    void setIdle(bool idle);
+                    // Watches the application's presses for the idle countdown;
+                    // the press that ends idle only turns the screen on
+                    bool eventFilter(QObject *watched, QEvent *event) override;
+
                     // ========== Setters (Q_INVOKABLE for QML) ==========
                     Q_INVOKABLE void setUse24HourFormat(bool value);
                     Q_INVOKABLE void setShowClock(bool value);
@@ -230,6 +287,7 @@ namespace f1x
                     Q_INVOKABLE void setDisableShutdown(bool value);
                     Q_INVOKABLE void setDisableScreenOff(bool value);
                     Q_INVOKABLE void setDebugMode(bool value);
+                    Q_INVOKABLE void setPipelineTracing(bool value);
                     Q_INVOKABLE void setVolume(int value);
 
                     // ========== Action Methods ==========
@@ -243,6 +301,16 @@ namespace f1x
                     Q_INVOKABLE void saveSettings();
                     Q_INVOKABLE void resetSettings();
                     Q_INVOKABLE void unpairAll();
+                    // Makes the head unit discoverable for a while to pair a new phone
+                    Q_INVOKABLE void pairNewPhone();
+                    // JPEG of the video on screen into /tmp, for field debugging
+                    Q_INVOKABLE void saveVideoFrame();
+
+                    // ========== Telemetry Subscription ==========
+                    // Pages showing system or network info hold a subscription
+                    // while instantiated; nothing is sampled without one
+                    Q_INVOKABLE void subscribeTelemetry();
+                    Q_INVOKABLE void unsubscribeTelemetry();
 
                     // ========== Music Control Methods ==========
                     Q_INVOKABLE void previousTrack();
@@ -268,12 +336,20 @@ namespace f1x
                     void use24HourFormatChanged();
                     void networkChanged();
                     void bluetoothChanged();
+                    // One per group, so a battery tick leaves the call bindings alone
+                    void phoneSignalChanged();
+                    void phoneBatteryChanged();
+                    void phoneCallChanged();
                     void videoResolutionChanged();
                     void volumeChanged();
                     void settingsChanged();
                     void systemInfoChanged();
                     void audioDevicesChanged();
                     void musicChanged();
+                    void metricsChanged();
+                    void pipelineTracingChanged();
+                    // Empty path if nothing was on screen
+                    void videoFrameSaved(const QString &path);
 
                     // Navigation signals
                     void showSettings();
@@ -282,6 +358,11 @@ namespace f1x
                     // Android Auto lifecycle signals
                     void androidAutoStarted();
                     void androidAutoStopped();
+                    void projectionActiveChanged();
+                    void uiAboveVideoChanged();
+                    void nightModeChanged();
+                    // A touch, click or key press anywhere
+                    void userActivity();
 
                     // Action requests (handled by main app)
                     void requestAndroidAuto(bool usb);
@@ -295,16 +376,38 @@ namespace f1x
                     void requestTogglePlayPause();
                     void requestNextTrack();
                     void requestUnpairAll();
+                    void requestPairing();
 
                 private slots:
                     void updateClock();
                     void updateSystemInfo();
+                    void updateNetwork();
                     void enumerateAudioDevices();
+                    void updateMetrics();
+                    void updatePhoneStatus();
 
                 private:
+                    // ALSA re-creates several /dev/snd nodes per hotplug
+                    static constexpr int cAudioRescanDelayMs = 500;
+                    static constexpr int cSystemInfoIntervalMs = 5000;
+                    static constexpr int cMetricsIntervalMs = 1000;
+
+                    static int openSysfs(const char *path);
+                    static bool readSysfs(int fd, long &value);
+                    void updateTelemetryTimer();
+                    void setProjectionActive(bool active);
+
+                    void applyAudioDevices(const QStringList &outputs, const QStringList &inputs);
+
                     configuration::IConfiguration::Pointer configuration_;
                     QTimer *clockTimer_;
                     QTimer *systemInfoTimer_;
+                    SystemVolume *systemVolume_;
+                    WifiStatus *wifiStatus_;
+                    QTimer *audioRescanTimer_;
+                    QThread *audioScanThread_;
+                    QObject *audioScanContext_; // lives on audioScanThread_
+                    QTimer *metricsTimer_;
 
                     // Cached values
                     QString currentTime_;
@@ -313,6 +416,9 @@ namespace f1x
                     QString wifiIP_;
                     bool bluetoothConnected_;
                     bool wifiConnected_;
+                    PhoneStatus phoneStatus_;
+                    int phoneStatusSubscription_;
+                    int nightModeSubscription_;
                     int volume_;
                     bool use24HourFormat_;
 
@@ -324,6 +430,20 @@ namespace f1x
                     QString freeMemory_;
                     QString cpuFrequency_;
                     QString cpuTemperature_;
+                    QString videoStats_; // Video latency summary, debug mode only
+                    QString metricsSummary_;
+
+                    // Telemetry sampling: raw values are compared before formatting
+                    int cpuFreqFd_;
+                    int thermalFd_;
+                    long freeMemoryMB_;
+                    long cpuFrequencyMHz_;
+                    long cpuTemperatureC_;
+                    int telemetrySubscribers_;
+                    bool projecting_;
+                    bool uiAboveVideo_;
+                    bool nightMode_;
+                    bool idle_;
 
                     // System settings cache (read from crankshaft env)
                     int disconnectTimeout_;
@@ -331,6 +451,7 @@ namespace f1x
                     bool disableShutdown_;
                     bool disableScreenOff_;
                     bool debugMode_;
+                    QString traceFile_;
                     bool hotspotEnabled_;
                     bool bluetoothAutoPair_;
 
@@ -0,0 +1,126 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QUrl>
+#include <f1x/openauto/autoapp/UpdateStream.hpp>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QThread;
+class QTimer;
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace ui
+            {
+
+                /**
+                 * @brief UpdateDownloader - Fetches a system update in the background
+                 *
+                 * Reads the manifest, then streams the package through an
+                 * UpdateStream into the staging directory or an inactive slot, so
+                 * there is no second pass to unpack or check it. Resumes with HTTP
+                 * ranges from the last verified block, after a dropped connection
+                 * or a restart alike. Runs on its own thread at background
+                 * priority, and while a phone is projecting it also caps its
+                 * bandwidth, so the download never competes with the session.
+                 */
+                class UpdateDownloader : public QObject
+                {
+                    Q_OBJECT
+
+                public:
+                    static constexpr qint64 cThrottledBytesPerSecond = 512 * 1024;
+
+                    static UpdateDownloader &instance();
+
+                    /**
+                     * Any thread. @p target is a directory, which receives the
+                     * package under its own name, or a block device. @p readyFlag
+                     * is created once the package is in place.
+                     */
+                    void start(const QUrl &manifestUrl, const QString &target, const QString &readyFlag);
+                    // Any thread; drops the partial package
+                    void cancel();
+                    bool active() const;
+
+                    static void setProjectionActive(bool active);
+
+                signals:
+                    void progress(qint64 verified, qint64 total);
+                    void finished(bool ok, const QString &message);
+
+                private:
+                    static constexpr int cReadBufferBytes = 256 * 1024;
+                    static constexpr int cPumpMs = 100;
+                    static constexpr int cMaxRetries = 20;
+                    static constexpr int cMaxBadBlocks = 3;
+
+                    UpdateDownloader();
+
+                    void onThreadStarted();
+                    void fetchManifest();
+                    void onManifestFinished();
+                    void requestPackage();
+                    void onPackageHeaders();
+                    void pump();
+                    void onPackageFinished();
+                    void retry(const QString &reason);
+                    void complete();
+                    void fail(const QString &message);
+                    void dropReply();
+                    qint64 budget();
+
+                    QThread *thread_;
+                    QNetworkAccessManager *network_ = nullptr;
+                    QTimer *pumpTimer_ = nullptr;
+                    QTimer *retryTimer_ = nullptr;
+                    QNetworkReply *reply_ = nullptr;
+
+                    QUrl manifestUrl_;
+                    QUrl packageUrl_;
+                    QString target_;
+                    QString readyFlag_;
+                    std::unique_ptr<UpdateStream> stream_;
+                    std::vector<uint8_t> buffer_;
+                    qint64 skip_ = 0;
+                    bool headersSeen_ = false;
+                    int retries_ = 0;
+                    qint64 tokens_ = 0;
+                    QElapsedTimer refill_;
+                    std::atomic<bool> active_{false};
+
+                    static std::atomic<bool> projectionActive_;
+                };
+
+            } // namespace ui
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
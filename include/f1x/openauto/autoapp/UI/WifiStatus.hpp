@@ -0,0 +1,79 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+
+class QSocketNotifier;
+class QTimer;
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace ui
+            {
+
+                /**
+                 * @brief WifiStatus - SSID of the station interface from wpa_supplicant
+                 *
+                 * Talks to the supplicant's control socket: one STATUS request when
+                 * it attaches, then again only on CTRL-EVENT-(DIS)CONNECTED, so the
+                 * SSID is change-notified instead of polled.
+                 */
+                class WifiStatus : public QObject
+                {
+                    Q_OBJECT
+
+                public:
+                    explicit WifiStatus(const QString &interface = "wlan0", QObject *parent = nullptr);
+                    ~WifiStatus() override;
+
+                    /** @brief SSID while associated, empty otherwise */
+                    QString ssid() const;
+
+                signals:
+                    void ssidChanged(const QString &ssid);
+
+                private:
+                    // wpa_supplicant may start (or restart) after us
+                    static constexpr int cReconnectMs = 10000;
+
+                    void connectToSupplicant();
+                    void disconnectFromSupplicant();
+                    void onReadable();
+                    void send(const char *command);
+                    void parseStatus(const QString &reply);
+                    void setSsid(const QString &ssid);
+
+                    const QString serverPath_;
+                    QString localPath_;
+                    int fd_;
+                    QSocketNotifier *notifier_;
+                    QTimer *reconnectTimer_;
+                    QString ssid_;
+                };
+
+            } // namespace ui
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,130 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+typedef struct evp_md_ctx_st EVP_MD_CTX;
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            /**
+             * @brief What an update server publishes next to a package:
+             *
+             *   version 2026.10
+             *   url openauto-2026.10.zip   (absolute, or relative to the manifest)
+             *   size 734003200
+             *   block 1048576
+             *   sha256 <hex of block 0>
+             *   sha256 <hex of block 1> ...
+             */
+            struct UpdateManifest
+            {
+                static constexpr uint32_t cMinBlockBytes = 64 * 1024;
+                static constexpr uint32_t cMaxBlockBytes = 16 * 1024 * 1024;
+
+                std::string version;
+                std::string url;
+                uint64_t size = 0;
+                uint32_t blockSize = 0;
+                std::vector<std::string> blockHashes; // lowercase hex
+
+                // False unless every block has its hash
+                static bool parse(std::istream &in, UpdateManifest &manifest);
+                // Hex SHA-256 over the block hashes; names the package for resuming
+                std::string id() const;
+            };
+
+            /**
+             * @brief UpdateStream - Writes a package in place as it downloads
+             *
+             * Bytes go straight to their final offset in the target, a staging
+             * file or an inactive slot's block device, and into the running
+             * hash of their block. A block counts once its hash matches the
+             * manifest and it is synced; only then does the state file move
+             * forward, so a power cut or a dropped hotspot resumes from the
+             * last verified block. The package is written once and never read
+             * back. A block that fails its hash puts the stream back to that
+             * block's start, to be downloaded again.
+             */
+            class UpdateStream
+            {
+            public:
+                enum class Status
+                {
+                    Ok,
+                    BadBlock, // Resend from verified()
+                    Failed    // The target cannot be written
+                };
+
+                /**
+                 * @param target A block device is written as is; a file path gets
+                 * "<target>.part", renamed by finish().
+                 * @param statePath Where the verified length survives restarts.
+                 */
+                UpdateStream(UpdateManifest manifest, std::string target, std::string statePath);
+                ~UpdateStream();
+                UpdateStream(const UpdateStream &) = delete;
+                UpdateStream &operator=(const UpdateStream &) = delete;
+
+                // Picks up an earlier run of the same package; download from offset()
+                bool open();
+
+                // The package's bytes at offset()
+                Status write(const uint8_t *data, size_t size);
+
+                uint64_t offset() const { return offset_; }
+                uint64_t verified() const { return verified_; }
+                bool complete() const { return verified_ == manifest_.size; }
+                uint64_t badBlocks() const { return badBlocks_; }
+                const UpdateManifest &manifest() const { return manifest_; }
+
+                // Moves the completed package into place
+                bool finish();
+                // Drops the partial package and its state
+                void discard();
+
+            private:
+                void close();
+                void restartBlock();
+                void saveState();
+
+                const UpdateManifest manifest_;
+                const std::string target_;
+                const std::string statePath_;
+                std::string writePath_;
+                bool blockDevice_ = false;
+                int fd_ = -1;
+                EVP_MD_CTX *hash_ = nullptr;
+                uint64_t offset_ = 0;
+                uint64_t verified_ = 0;
+                uint64_t badBlocks_ = 0;
+            };
+
+        }
+    }
+}
@@ -0,0 +1,70 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <libusb.h>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            /**
+             * @brief UsbEventLoop - The one thread that services libusb events
+             *
+             * Sleeps in poll() on libusb's own descriptors instead of cycling
+             * libusb_handle_events_timeout_completed(), so an idle session costs
+             * no wakeups and a completion is handled as soon as its fd fires.
+             * An eventfd joins the poll set, letting stop() and descriptor
+             * changes interrupt the wait immediately.
+             */
+            class UsbEventLoop
+            {
+            public:
+                explicit UsbEventLoop(libusb_context *context);
+                ~UsbEventLoop();
+
+                UsbEventLoop(const UsbEventLoop &) = delete;
+                UsbEventLoop &operator=(const UsbEventLoop &) = delete;
+
+                void start();
+                // Wakes the loop and joins it; returns once libusb is idle
+                void stop();
+
+            private:
+                static void onPollfdAdded(int fd, short events, void *userData);
+                static void onPollfdRemoved(int fd, void *userData);
+
+                void run();
+                void wake();
+
+                libusb_context *context_;
+                int wakeFd_;
+                std::atomic<bool> stopping_;
+                std::atomic<bool> pollfdsChanged_;
+                std::thread thread_;
+            };
+
+        }
+    }
+}
@@ -0,0 +1,102 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <aasdk/TCP/ITCPEndpoint.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            /**
+             * @brief WifiConnector - Races TCP connects to a phone's candidate addresses
+             *
+             * Happy-eyeballs style: the first address is tried at once and each
+             * further one a stagger later, without waiting for the earlier ones
+             * to fail. The first connect to complete wins and the rest are
+             * closed, so a stale recent address costs one stagger instead of a
+             * whole connect timeout.
+             */
+            class WifiConnector : public std::enable_shared_from_this<WifiConnector>
+            {
+            public:
+                typedef std::shared_ptr<WifiConnector> Pointer;
+                // On the io_service; the socket is null unless @p error is clear
+                typedef std::function<void(const boost::system::error_code &error,
+                                           aasdk::tcp::ITCPEndpoint::SocketPointer socket,
+                                           const std::string &address)>
+                    Handler;
+
+                static constexpr int cStaggerMs = 250;
+                static constexpr int cTimeoutMs = 5000;
+                static constexpr const char *cLeasesPath = "/tmp/dnsmasq.leases";
+
+                WifiConnector(boost::asio::io_service &ioService, uint16_t port, int staggerMs = cStaggerMs,
+                              int timeoutMs = cTimeoutMs);
+
+                // Duplicates and unparseable addresses are skipped
+                void connect(const std::vector<std::string> &addresses, Handler handler);
+                // The handler is called with operation_aborted unless a connect already won
+                void cancel();
+
+                // Clients of our hotspot, from dnsmasq's lease file
+                static std::vector<std::string> hotspotLeases(const std::string &path = cLeasesPath);
+
+            private:
+                struct Attempt
+                {
+                    std::string address;
+                    boost::asio::ip::tcp::endpoint endpoint;
+                    aasdk::tcp::ITCPEndpoint::SocketPointer socket;
+                    bool finished = false;
+                };
+
+                void startNext();
+                void onConnected(uint64_t generation, size_t index, const boost::system::error_code &error);
+                void finish(const boost::system::error_code &error, size_t winner);
+
+                boost::asio::io_service &ioService_;
+                boost::asio::io_service::strand strand_;
+                const uint16_t port_;
+                const int staggerMs_;
+                const int timeoutMs_;
+                boost::asio::steady_timer staggerTimer_;
+                boost::asio::steady_timer deadline_;
+                std::vector<Attempt> attempts_;
+                // Counted up by connect(); a completion of another race is dropped
+                uint64_t generation_;
+                size_t started_;
+                size_t failed_;
+                std::chrono::steady_clock::time_point startedAt_;
+                Handler handler_;
+            };
+
+        }
+    }
+}
@@ -0,0 +1,41 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace f1x::openauto::bench {
+
+/**
+ * @brief ioctl calls made by the process since start, by subsystem.
+ *
+ * video_bench exports its own ioctl() (ENABLE_EXPORTS), so calls from libdrm
+ * and FFmpeg land in the counter before going on to libc.
+ */
+struct IoctlCounts {
+  uint64_t total = 0;
+  uint64_t drm = 0;   // DRM/KMS ('d')
+  uint64_t v4l2 = 0;  // V4L2 and the media request API ('V', '|')
+};
+
+IoctlCounts ioctlCounts();
+
+IoctlCounts operator-(const IoctlCounts &lhs, const IoctlCounts &rhs);
+
+}  // namespace f1x::openauto::bench
@@ -21,8 +21,12 @@
 #include <stdint.h>
 #include <memory>
 #include <QBluetoothServer>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <f1x/openauto/btservice/BtLinkPublisher.hpp>
 #include <f1x/openauto/btservice/IAndroidBluetoothServer.hpp>
 #include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
+#include <f1x/openauto/autoapp/Configuration/KnownPhonesList.hpp>
 #include <aasdk/Messenger/Message.hpp>
 #include <aap_protobuf/aaw/MessageId.pb.h>
 #include <aap_protobuf/aaw/Status.pb.h>
@@ -40,10 +44,14 @@ namespace f1x::openauto::btservice {
   Q_OBJECT
 
   public:
-    AndroidBluetoothServer(autoapp::configuration::IConfiguration::Pointer configuration);
+    // @p link, if given, hears about RFCOMM connections and the hotspot hand-off
+    AndroidBluetoothServer(autoapp::configuration::IConfiguration::Pointer configuration,
+                           BtLinkPublisher *link = nullptr);
 
     uint16_t start(const QBluetoothAddress &address) override;
 
+    bool reconnectKnownPhone() override;
+
   private slots:
 
     void onClientConnected();
@@ -53,25 +61,52 @@ namespace f1x::openauto::btservice {
     std::unique_ptr<QBluetoothServer> rfcommServer_;
     QBluetoothSocket *socket = nullptr;
     autoapp::configuration::IConfiguration::Pointer configuration_;
+    BtLinkPublisher *link_;
+    autoapp::configuration::KnownPhonesList knownPhones_;
+    // Our call to a known phone, until it connects or fails
+    QBluetoothSocket *outgoing_ = nullptr;
+
+    // Takes over a connected RFCOMM socket, either direction, and starts the hand-off
+    void attachSocket(QBluetoothSocket *connected);
+    // @p channel 0 finds the phone's channel through SDP first
+    void connectToPhone(const QBluetoothAddress &address, quint16 channel);
+    void dropOutgoing();
+
+    // Frames are a big-endian uint16 payload length and message id
+    static constexpr int cFrameHeaderSize = 4;
 
     void readSocket();
 
+    // Received bytes; frames still to be handled lie in [bufferStart_, bufferEnd_)
     QByteArray buffer;
+    int bufferStart_ = 0;
+    int bufferEnd_ = 0;
+
+    aap_protobuf::aaw::WifiInfoResponse wifiInfo_;
+    QDateTime wifiInfoModified_;
+    QElapsedTimer connectTimer_;
+
+    void handleMessage(aap_protobuf::aaw::MessageId messageId, const char *data, uint16_t length);
+
+    void handleWifiInfoRequest(const char *data, uint16_t length);
+
+    const aap_protobuf::aaw::WifiInfoResponse &wifiInfo();
 
-    void handleWifiInfoRequest(QByteArray &buffer, uint16_t length);
+    // Logs a step of the wireless bring-up, timed from the RFCOMM connection
+    void markStage(const char *stage);
 
-    void handleWifiVersionResponse(QByteArray &buffer, uint16_t length);
+    void handleWifiVersionResponse(const char *data, uint16_t length);
 
-    void handleWifiConnectionStatus(QByteArray &buffer, uint16_t length);
+    void handleWifiConnectionStatus(const char *data, uint16_t length);
 
-    void handleWifiStartResponse(QByteArray &buffer, uint16_t length);
+    void handleWifiStartResponse(const char *data, uint16_t length);
 
     void sendMessage(const google::protobuf::Message &message, uint16_t type);
 
 
     const ::std::string getIP4_(const QString intf);
 
-    void DecodeProtoMessage(const std::string &proto_data);
+    void DecodeProtoMessage(const char *data, int length);
   };
 
 }
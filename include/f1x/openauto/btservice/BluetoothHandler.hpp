@@ -5,17 +5,34 @@
 #ifndef OPENAUTO_BLUETOOTHHANDLER_HPP
 #define OPENAUTO_BLUETOOTHHANDLER_HPP
 
+#include <f1x/openauto/btservice/BtLinkPublisher.hpp>
 #include <f1x/openauto/btservice/IBluetoothHandler.hpp>
 #include <f1x/openauto/btservice/IAndroidBluetoothServer.hpp>
 #include <f1x/openauto/btservice/IAndroidBluetoothService.hpp>
 #include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
+#include <QElapsedTimer>
 #include <QObject>
+#include <QTimer>
 
 namespace f1x::openauto::btservice {
 
+  /**
+   * Brings the adapter and the Android Auto service up in stages, each a
+   * step of the event loop: adapter valid and powered, RFCOMM listening,
+   * SDP record registered, then the known phone called back. BlueZ may still
+   * be initialising the adapter at boot, so a stage that fails is retried
+   * with backoff rather than ending the process, and the link to autoapp
+   * answers meanwhile. Each stage's time goes to autoapp through the link,
+   * "ready" last.
+   */
   class BluetoothHandler : public QObject, public IBluetoothHandler {
     Q_OBJECT
   public:
+    static constexpr int cFirstRetryMs = 250;
+    static constexpr int cMaxRetryMs = 8000;
+    // BlueZ answers powerOn() with a host mode change; none by then is a retry
+    static constexpr int cPowerOnTimeoutMs = 3000;
+
     BluetoothHandler(btservice::IAndroidBluetoothService::Pointer androidBluetoothService,
                      autoapp::configuration::IConfiguration::Pointer configuration);
 
@@ -32,12 +49,41 @@ namespace f1x::openauto::btservice {
 
     void onHostModeStateChanged(QBluetoothLocalDevice::HostMode state);
 
+    // Discoverable for @p seconds, then back to connectable only
+    void onPairingRequested(int seconds);
+
 
   private:
+    enum class Stage { Adapter, Listen, Register, Announce, Ready };
+
+    void runStage();
+    void openAdapter();
+    void announce();
+    // Reports the stage done and queues the next one
+    void advance();
+    void retry(const char *reason);
+    bool ready() const;
+
     std::unique_ptr<QBluetoothLocalDevice> localDevice_;
     autoapp::configuration::IConfiguration::Pointer configuration_;
     btservice::IAndroidBluetoothService::Pointer androidBluetoothService_;
+    // Ahead of the server, which holds a pointer to it
+    std::unique_ptr<BtLinkPublisher> link_;
     btservice::IAndroidBluetoothServer::Pointer androidBluetoothServer_;
+    // ENABLE_PAIRABLE=1, or no phone paired yet: discoverable throughout
+    bool alwaysDiscoverable_;
+    QTimer pairingTimer_;
+
+    QBluetoothAddress address_;
+    uint16_t portNumber_;
+    Stage stage_;
+    bool poweringOn_;
+    int attempts_;
+    int retryMs_;
+    // Runs the current stage, straight away or after a retry's delay
+    QTimer stageTimer_;
+    QElapsedTimer startup_;
+    QElapsedTimer stageClock_;
   };
 }
 
@@ -0,0 +1,72 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QSocketNotifier>
+#include <QString>
+#include <memory>
+#include <vector>
+#include <f1x/openauto/Common/BtLink.hpp>
+
+namespace f1x::openauto::btservice {
+
+  /**
+   * @brief Pushes pairing, connection and hotspot hand-off events to autoapp
+   * as they happen, over the abstract socket in Common/BtLink.hpp. The last
+   * state is kept and resent when autoapp (re)starts and says Hello.
+   */
+  class BtLinkPublisher : public QObject {
+  Q_OBJECT
+
+  public:
+    explicit BtLinkPublisher(QObject *parent = nullptr);
+    ~BtLinkPublisher() override;
+
+  signals:
+    // autoapp asked for a pairing window of @p seconds
+    void pairingRequested(int seconds);
+
+  public slots:
+    void adapterStateChanged(int hostMode);
+    void pairingFinished(const QString &address, bool paired);
+    void phoneConnected(const QString &address, const QString &name);
+    void phoneDisconnected(const QString &address);
+    void wifiOffered(const QString &ssid);
+    void wifiStatus(int status);
+    // A startup stage finished after @p ms; kept for autoapp's Hello
+    void serviceStage(const QString &stage, int ms);
+
+  private:
+    void onReadable();
+    void publish(const common::BtLinkEvent &event);
+    void replay();
+
+    int fd_;
+    std::unique_ptr<QSocketNotifier> notifier_;
+
+    common::BtLinkEvent adapter_;
+    common::BtLinkEvent phone_;
+    common::BtLinkEvent wifi_;
+    common::BtLinkEvent wifiStatus_;
+    std::vector<common::BtLinkEvent> stages_;
+    bool wifiStatusKnown_;
+  };
+
+}
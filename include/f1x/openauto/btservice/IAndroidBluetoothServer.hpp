@@ -30,6 +30,10 @@ namespace f1x::openauto::btservice {
     virtual ~IAndroidBluetoothServer() = default;
 
     virtual uint16_t start(const QBluetoothAddress &address) = 0;
+
+    // Calls the most recent known phone back instead of waiting for it;
+    // false when no phone is known
+    virtual bool reconnectKnownPhone() = 0;
   };
 
 }
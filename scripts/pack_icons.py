@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""Packs the icons the QML pages show into one texture atlas.
+
+    pack_icons.py OUTPUT_DIR ICON.png...
+
+Writes OUTPUT_DIR/icons.rgba, premultiplied RGBA8888 pixels after a 16-byte
+header (magic "OAIA", version, width, height, little endian), and
+OUTPUT_DIR/icons.txt with one "name x y width height" line per icon. Every
+icon also gets a dimmed night variant, named "night/<name>", for Theme.qml's
+night palette. The UI serves the icons straight out of the compiled-in atlas
+(see IconAtlas), so showing a page or switching to night decodes no PNG. Only
+the standard library is needed, so the step runs on any build host, cross
+builds included.
+"""
+
+import os
+import struct
+import sys
+import zlib
+
+ATLAS_WIDTH = 1024
+# Transparent gap between icons, so linear filtering at an icon's edge
+# never samples its neighbour
+PADDING = 2
+MAGIC = 0x4149414f  # "OAIA"
+VERSION = 1
+# Night variants keep this share of each colour channel; IconAtlas applies
+# the same factor to icons that are missing from the atlas
+NIGHT_LEVEL = 72  # percent
+NIGHT_PREFIX = 'night/'
+
+
+def read_png(path):
+    """Returns (width, height, rows of straight RGBA bytes) of an 8-bit PNG."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:8] != b'\x89PNG\r\n\x1a\n':
+        raise ValueError('%s: not a PNG' % path)
+
+    pos = 8
+    idat = b''
+    palette = b''
+    transparency = b''
+    while pos < len(data):
+        length, kind = struct.unpack('>I4s', data[pos:pos + 8])
+        body = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b'IHDR':
+            width, height, depth, colour, _, _, interlace = struct.unpack('>IIBBBBB', body)
+        elif kind == b'PLTE':
+            palette = body
+        elif kind == b'tRNS':
+            transparency = body
+        elif kind == b'IDAT':
+            idat += body
+        elif kind == b'IEND':
+            break
+
+    if depth != 8 or interlace != 0:
+        raise ValueError('%s: only 8-bit non-interlaced PNGs are supported' % path)
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[colour]
+
+    raw = zlib.decompress(idat)
+    stride = width * channels
+    rows = []
+    previous = bytearray(stride)
+    at = 0
+    for _ in range(height):
+        kind = raw[at]
+        row = bytearray(raw[at + 1:at + 1 + stride])
+        at += 1 + stride
+        for i in range(stride):
+            left = row[i - channels] if i >= channels else 0
+            up = previous[i]
+            corner = previous[i - channels] if i >= channels else 0
+            if kind == 1:
+                row[i] = (row[i] + left) & 0xff
+            elif kind == 2:
+                row[i] = (row[i] + up) & 0xff
+            elif kind == 3:
+                row[i] = (row[i] + ((left + up) >> 1)) & 0xff
+            elif kind == 4:
+                p = left + up - corner
+                pa, pb, pc = abs(p - left), abs(p - up), abs(p - corner)
+                predictor = left if pa <= pb and pa <= pc else (up if pb <= pc else corner)
+                row[i] = (row[i] + predictor) & 0xff
+        previous = row
+
+        rgba = bytearray(width * 4)
+        for x in range(width):
+            if colour == 0:
+                g = row[x]
+                pixel = (g, g, g, 255)
+            elif colour == 2:
+                pixel = (row[3 * x], row[3 * x + 1], row[3 * x + 2], 255)
+            elif colour == 3:
+                index = row[x]
+                alpha = transparency[index] if index < len(transparency) else 255
+                pixel = (palette[3 * index], palette[3 * index + 1], palette[3 * index + 2], alpha)
+            elif colour == 4:
+                g = row[2 * x]
+                pixel = (g, g, g, row[2 * x + 1])
+            else:
+                pixel = tuple(row[4 * x:4 * x + 4])
+            rgba[4 * x:4 * x + 4] = bytes(pixel)
+        rows.append(rgba)
+    return width, height, rows
+
+
+def night_variant(icon):
+    """The icon with its colour scaled to NIGHT_LEVEL, alpha untouched."""
+    width, height, rows = icon
+    dimmed = []
+    for row in rows:
+        row = bytearray(row)
+        for i in range(0, len(row), 4):
+            for c in range(3):
+                row[i + c] = (row[i + c] * NIGHT_LEVEL + 50) // 100
+        dimmed.append(row)
+    return width, height, dimmed
+
+
+def pack(sizes):
+    """Shelf packing, tallest first. Returns ({name: (x, y)}, atlas height)."""
+    placed = {}
+    x = y = shelf = 0
+    for name, (width, height) in sorted(sizes.items(), key=lambda item: (-item[1][1], item[0])):
+        if width + PADDING > ATLAS_WIDTH:
+            raise ValueError('%s is wider than the atlas' % name)
+        if x + width + PADDING > ATLAS_WIDTH:
+            x = 0
+            y += shelf
+            shelf = 0
+        placed[name] = (x + PADDING, y + PADDING)
+        x += width + PADDING
+        shelf = max(shelf, height + PADDING)
+    # Rows a multiple of 4, as texture uploads prefer
+    return placed, (y + shelf + PADDING + 3) & ~3
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+    out_dir = sys.argv[1]
+    icons = {}
+    for path in sys.argv[2:]:
+        icon = read_png(path)
+        icons[os.path.basename(path)] = icon
+        icons[NIGHT_PREFIX + os.path.basename(path)] = night_variant(icon)
+
+    placed, height = pack({name: icon[:2] for name, icon in icons.items()})
+    pixels = bytearray(ATLAS_WIDTH * height * 4)
+    for name, (width, icon_height, rows) in icons.items():
+        left, top = placed[name]
+        for row_index, row in enumerate(rows):
+            premultiplied = bytearray(row)
+            for i in range(0, len(row), 4):
+                alpha = row[i + 3]
+                if alpha != 255:
+                    for c in range(3):
+                        premultiplied[i + c] = (row[i + c] * alpha + 127) // 255
+            at = ((top + row_index) * ATLAS_WIDTH + left) * 4
+            pixels[at:at + width * 4] = premultiplied
+
+    os.makedirs(out_dir, exist_ok=True)
+    with open(os.path.join(out_dir, 'icons.rgba'), 'wb') as f:
+        f.write(struct.pack('<IIII', MAGIC, VERSION, ATLAS_WIDTH, height))
+        f.write(pixels)
+    with open(os.path.join(out_dir, 'icons.txt'), 'w') as f:
+        for name in sorted(placed):
+            width, icon_height, _ = icons[name]
+            f.write('%s %d %d %d %d\n' % (name, placed[name][0], placed[name][1], width, icon_height))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,200 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstdlib>
+#include <sstream>
+#ifdef USE_MIMALLOC
+#include <mimalloc.h>
+#endif
+#include <f1x/openauto/autoapp/Allocation.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            namespace
+            {
+                class SystemBackend : public AllocatorBackend
+                {
+                public:
+                    const char *name() const override { return "system"; }
+
+                    void *allocate(size_t bytes, size_t alignment) override
+                    {
+                        if (alignment <= alignof(std::max_align_t))
+                            return std::malloc(bytes);
+                        // aligned_alloc wants a whole number of alignments
+                        return std::aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment);
+                    }
+
+                    void deallocate(void *data) override { std::free(data); }
+                };
+
+#ifdef USE_MIMALLOC
+                class MimallocBackend : public AllocatorBackend
+                {
+                public:
+                    const char *name() const override { return "mimalloc"; }
+
+                    void *allocate(size_t bytes, size_t alignment) override
+                    {
+                        return mi_malloc_aligned(bytes, alignment);
+                    }
+
+                    void deallocate(void *data) override { mi_free(data); }
+                };
+#endif
+
+                AllocatorBackend *findBackend(const std::string &name)
+                {
+                    static SystemBackend system;
+                    if (name == system.name())
+                        return &system;
+#ifdef USE_MIMALLOC
+                    static MimallocBackend mimalloc;
+                    if (name == mimalloc.name())
+                        return &mimalloc;
+#endif
+                    return nullptr;
+                }
+            }
+
+            const char *allocationTagName(AllocationTag tag)
+            {
+                switch (tag)
+                {
+                case AllocationTag::MessageBuffers:
+                    return "message_buffers";
+                case AllocationTag::Protobuf:
+                    return "protobuf";
+                case AllocationTag::UiModels:
+                    return "ui_models";
+                case AllocationTag::FFmpeg:
+                    return "ffmpeg";
+                case AllocationTag::Count:
+                    break;
+                }
+                return "unknown";
+            }
+
+            AllocationAccounting &AllocationAccounting::instance()
+            {
+                static AllocationAccounting accounting;
+                return accounting;
+            }
+
+            AllocationAccounting::AllocationAccounting()
+                : backend_(findBackend("system"))
+            {
+                for (size_t i = 0; i < tags_.size(); i++)
+                {
+                    const std::string name = allocationTagName(static_cast<AllocationTag>(i));
+                    tags_[i].allocations = &Metrics::instance().counter("openauto_alloc_" + name + "_total",
+                                                                        "Allocations for " + name);
+                    tags_[i].bytes = &Metrics::instance().counter("openauto_alloc_" + name + "_bytes_total",
+                                                                  "Bytes allocated for " + name);
+                    tags_[i].liveBytes = &Metrics::instance().gauge("openauto_alloc_" + name + "_live_bytes",
+                                                                    "Bytes allocated for " + name + " and not freed");
+                }
+            }
+
+            bool AllocationAccounting::selectBackend(const std::string &name)
+            {
+                AllocatorBackend *backend = findBackend(name);
+                if (backend == nullptr)
+                    return false;
+                // Freeing has to go to the backend that allocated
+                if (used_.load(std::memory_order_acquire))
+                    return backend == backend_.load(std::memory_order_acquire);
+                backend_.store(backend, std::memory_order_release);
+                return true;
+            }
+
+            const char *AllocationAccounting::backendName() const
+            {
+                return backend_.load(std::memory_order_acquire)->name();
+            }
+
+            void *AllocationAccounting::allocate(AllocationTag tag, size_t bytes, size_t alignment)
+            {
+                used_.store(true, std::memory_order_release);
+                void *data = backend_.load(std::memory_order_acquire)->allocate(bytes, alignment);
+                if (data != nullptr)
+                    record(tag, bytes);
+                return data;
+            }
+
+            void AllocationAccounting::deallocate(AllocationTag tag, void *data, size_t bytes)
+            {
+                if (data == nullptr)
+                    return;
+                backend_.load(std::memory_order_acquire)->deallocate(data);
+                release(tag, bytes);
+            }
+
+            void AllocationAccounting::record(AllocationTag tag, size_t bytes)
+            {
+                const Tag &counters = tags_[static_cast<size_t>(tag)];
+                counters.allocations->add();
+                counters.bytes->add(bytes);
+                counters.liveBytes->add(static_cast<int64_t>(bytes));
+            }
+
+            void AllocationAccounting::release(AllocationTag tag, size_t bytes)
+            {
+                tags_[static_cast<size_t>(tag)].liveBytes->add(-static_cast<int64_t>(bytes));
+            }
+
+            void AllocationAccounting::countTransient(AllocationTag tag, size_t bytes)
+            {
+                const Tag &counters = tags_[static_cast<size_t>(tag)];
+                counters.allocations->add();
+                counters.bytes->add(bytes);
+            }
+
+            AllocationStats AllocationAccounting::stats(AllocationTag tag) const
+            {
+                const Tag &counters = tags_[static_cast<size_t>(tag)];
+                AllocationStats stats;
+                stats.allocations = counters.allocations->value();
+                stats.bytes = counters.bytes->value();
+                stats.liveBytes = counters.liveBytes->value();
+                return stats;
+            }
+
+            std::string AllocationAccounting::summary() const
+            {
+                std::ostringstream out;
+                out << "allocator " << backendName();
+                for (size_t i = 0; i < tags_.size(); i++)
+                {
+                    const AllocationStats tagStats = stats(static_cast<AllocationTag>(i));
+                    out << ", " << allocationTagName(static_cast<AllocationTag>(i)) << " " << tagStats.allocations
+                        << " allocations, " << tagStats.liveBytes / 1024 << " kB live";
+                }
+                return out.str();
+            }
+
+        }
+    }
+}
@@ -0,0 +1,544 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <vector>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/AmbientLight.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/StateBus.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    struct LightMetrics
+    {
+      MetricGauge &lux = Metrics::instance().gauge(
+          "openauto_ambient_lux", "Smoothed ambient light of the IIO light sensor");
+      MetricCounter &switches = Metrics::instance().counter(
+          "openauto_ambient_night_switches_total", "Day and night changes from the light sensor");
+      MetricGauge &backlight = Metrics::instance().gauge(
+          "openauto_backlight_level", "Brightness written to the backlight");
+    };
+
+    LightMetrics &metrics()
+    {
+      static LightMetrics instance;
+      return instance;
+    }
+
+    const char *cIlluminance = "in_illuminance";
+
+    bool startsWith(const std::string &value, const std::string &prefix)
+    {
+      return value.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    bool endsWith(const std::string &value, const std::string &suffix)
+    {
+      return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // Sorted, so "auto" picks the same device on every boot
+    std::vector<std::string> listDirectory(const std::string &path)
+    {
+      std::vector<std::string> entries;
+      if (DIR *dir = opendir(path.c_str()))
+      {
+        while (const dirent *entry = readdir(dir))
+        {
+          if (entry->d_name[0] != '.')
+            entries.push_back(entry->d_name);
+        }
+        closedir(dir);
+      }
+      std::sort(entries.begin(), entries.end());
+      return entries;
+    }
+
+    bool readFile(const std::string &path, std::string &value)
+    {
+      std::ifstream in(path);
+      if (!in || !std::getline(in, value))
+        return false;
+      value.erase(value.find_last_not_of(" \t\r\n") + 1);
+      return true;
+    }
+
+    bool readNumber(const std::string &path, double &value)
+    {
+      std::string text;
+      if (!readFile(path, text))
+        return false;
+      char *end = nullptr;
+      value = std::strtod(text.c_str(), &end);
+      return end != text.c_str();
+    }
+
+    bool writeFile(const std::string &path, const std::string &value)
+    {
+      std::ofstream out(path);
+      return static_cast<bool>(out << value << std::flush);
+    }
+
+    bool readNumber(int fd, double &value)
+    {
+      char buffer[32];
+      const ssize_t size = pread(fd, buffer, sizeof(buffer) - 1, 0);
+      if (size <= 0)
+        return false;
+      buffer[size] = '\0';
+      char *end = nullptr;
+      value = std::strtod(buffer, &end);
+      return end != buffer;
+    }
+
+    int64_t nowMs()
+    {
+      return std::chrono::duration_cast<std::chrono::milliseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    }
+  }
+
+  LightFilter::LightFilter(double nightLux, double dayLux)
+      : nightLux_(nightLux), dayLux_(std::max(dayLux, nightLux))
+  {
+  }
+
+  bool LightFilter::update(double lux, int64_t atMs)
+  {
+    if (!hasReading_)
+    {
+      hasReading_ = true;
+      lastMs_ = atMs;
+      lux_ = lux;
+      night_ = lux_ < nightLux_;
+      return true;
+    }
+
+    const double elapsedMs = static_cast<double>(std::max<int64_t>(0, atMs - lastMs_));
+    lastMs_ = atMs;
+    lux_ += (1.0 - std::exp(-elapsedMs / cTimeConstantMs)) * (lux - lux_);
+
+    if (!night_ && lux_ < nightLux_)
+      night_ = true;
+    else if (night_ && lux_ > dayLux_)
+      night_ = false;
+    else
+      return false;
+    return true;
+  }
+
+  double LightFilter::brightness() const
+  {
+    // A night threshold of 0 lux would put the whole curve below 1 lux
+    const double low = std::max(nightLux_, 1.0);
+    if (lux_ <= low)
+      return cMinBrightness;
+    if (lux_ >= cFullBrightnessLux)
+      return 1.0;
+    return cMinBrightness + (1.0 - cMinBrightness) * std::log(lux_ / low) / std::log(cFullBrightnessLux / low);
+  }
+
+  AmbientLight::AmbientLight(AmbientLightSettings settings, std::string sysfsRoot, std::string devRoot)
+      : settings_(std::move(settings)), sysfsRoot_(std::move(sysfsRoot)), devRoot_(std::move(devRoot)),
+        filter_(settings_.nightLux, settings_.dayLux), wakeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+  {
+  }
+
+  AmbientLight::~AmbientLight()
+  {
+    this->stop();
+    if (wakeFd_ >= 0)
+      close(wakeFd_);
+  }
+
+  bool AmbientLight::start()
+  {
+    if (thread_.joinable())
+      return true;
+
+    directory_ = this->resolveDevice();
+    if (directory_.empty())
+    {
+      OPENAUTO_LOG(warning) << "[AmbientLight] No IIO light sensor '" << settings_.device << "'";
+      return false;
+    }
+    if (this->openBuffer())
+    {
+      OPENAUTO_LOG(info) << "[AmbientLight] " << directory_ << ": buffered " << channel_ << ", night below "
+                         << settings_.nightLux << " lux, day above " << settings_.dayLux << " lux";
+    }
+    else if (this->openPolled())
+    {
+      OPENAUTO_LOG(info) << "[AmbientLight] " << directory_ << " has no usable buffer, reading " << channel_
+                         << " every " << cPollMs << " ms";
+    }
+    else
+    {
+      OPENAUTO_LOG(warning) << "[AmbientLight] " << directory_ << " has no illuminance channel";
+      return false;
+    }
+    this->openBacklight();
+
+    stopping_ = false;
+    thread_ = std::thread([this]()
+                          {
+      pthread_setname_np(pthread_self(), "oa-light");
+      this->run(); });
+    return true;
+  }
+
+  void AmbientLight::stop()
+  {
+    if (thread_.joinable())
+    {
+      stopping_ = true;
+      const uint64_t one = 1;
+      (void)write(wakeFd_, &one, sizeof(one));
+      thread_.join();
+      uint64_t count;
+      (void)read(wakeFd_, &count, sizeof(count));
+    }
+    this->closeBuffer();
+    if (polledFd_ >= 0)
+      close(polledFd_);
+    polledFd_ = -1;
+    if (backlightFd_ >= 0)
+      close(backlightFd_);
+    backlightFd_ = -1;
+  }
+
+  std::string AmbientLight::resolveDevice() const
+  {
+    const std::string root = sysfsRoot_ + "/bus/iio/devices/";
+    if (settings_.device != "auto")
+    {
+      const std::string directory =
+          settings_.device.find('/') == std::string::npos ? root + settings_.device : settings_.device;
+      return access(directory.c_str(), R_OK) == 0 ? directory : std::string();
+    }
+
+    for (const auto &name : listDirectory(root))
+    {
+      const std::string directory = root + name;
+      std::vector<std::string> files = listDirectory(directory);
+      const auto scanElements = listDirectory(directory + "/scan_elements");
+      files.insert(files.end(), scanElements.begin(), scanElements.end());
+      for (const auto &file : files)
+      {
+        if (startsWith(file, cIlluminance) && (endsWith(file, "_en") || endsWith(file, "_raw") || endsWith(file, "_input")))
+          return directory;
+      }
+    }
+    return std::string();
+  }
+
+  bool AmbientLight::openBuffer()
+  {
+    const std::string scanElements = directory_ + "/scan_elements/";
+    const auto elements = listDirectory(scanElements);
+    const auto found = std::find_if(elements.begin(), elements.end(), [](const std::string &file)
+                                    { return startsWith(file, cIlluminance) && endsWith(file, "_en"); });
+    if (found == elements.end())
+      return false;
+    const std::string channel = found->substr(0, found->size() - 3);
+
+    std::string type;
+    if (!readFile(scanElements + channel + "_type", type) || !parseScanType(type, scanType_))
+    {
+      OPENAUTO_LOG(warning) << "[AmbientLight] Unknown scan type '" << type << "' of " << channel;
+      return false;
+    }
+    scale_ = 1.0;
+    offset_ = 0.0;
+    if (!readNumber(directory_ + "/" + channel + "_scale", scale_))
+      readNumber(directory_ + "/in_illuminance_scale", scale_);
+    if (!readNumber(directory_ + "/" + channel + "_offset", offset_))
+      readNumber(directory_ + "/in_illuminance_offset", offset_);
+
+    // The scan layout only changes while the buffer is off. With one element
+    // enabled, each record is exactly one sample.
+    writeFile(directory_ + "/buffer/enable", "0");
+    for (const auto &element : elements)
+    {
+      if (endsWith(element, "_en"))
+        writeFile(scanElements + element, element == *found ? "1" : "0");
+    }
+
+    // Sensors with a data-ready interrupt register it as "<name>-devN"
+    const std::string currentTrigger = directory_ + "/trigger/current_trigger";
+    std::string trigger;
+    if (access(currentTrigger.c_str(), F_OK) == 0 && (!readFile(currentTrigger, trigger) || trigger.empty()))
+    {
+      std::string name;
+      readFile(directory_ + "/name", name);
+      const std::string root = sysfsRoot_ + "/bus/iio/devices/";
+      for (const auto &entry : listDirectory(root))
+      {
+        std::string triggerName;
+        if (startsWith(entry, "trigger") && readFile(root + entry + "/name", triggerName) && !name.empty() &&
+            startsWith(triggerName, name))
+        {
+          trigger = triggerName;
+          break;
+        }
+      }
+      if (trigger.empty() || !writeFile(currentTrigger, trigger))
+        return false;
+    }
+
+    const std::string node = devRoot_ + "/" + directory_.substr(directory_.find_last_of('/') + 1);
+    writeFile(directory_ + "/buffer/length", std::to_string(cBufferLength));
+    bufferFd_ = open(node.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (bufferFd_ < 0 || !writeFile(directory_ + "/buffer/enable", "1"))
+    {
+      OPENAUTO_LOG(warning) << "[AmbientLight] Cannot start the buffer of " << node << ": " << std::strerror(errno);
+      this->closeBuffer();
+      return false;
+    }
+    channel_ = channel;
+    return true;
+  }
+
+  void AmbientLight::closeBuffer()
+  {
+    if (bufferFd_ < 0)
+      return;
+    writeFile(directory_ + "/buffer/enable", "0");
+    close(bufferFd_);
+    bufferFd_ = -1;
+  }
+
+  bool AmbientLight::openPolled()
+  {
+    // A processed reading in lux if the driver offers one
+    for (const char *suffix : {"_input", "_raw"})
+    {
+      for (const auto &file : listDirectory(directory_))
+      {
+        if (!startsWith(file, cIlluminance) || !endsWith(file, suffix))
+          continue;
+        polledFd_ = open((directory_ + "/" + file).c_str(), O_RDONLY | O_CLOEXEC);
+        if (polledFd_ < 0)
+          continue;
+        channel_ = file;
+        scale_ = 1.0;
+        offset_ = 0.0;
+        if (std::strcmp(suffix, "_raw") == 0)
+        {
+          const std::string prefix = directory_ + "/" + file.substr(0, file.size() - 4);
+          if (!readNumber(prefix + "_scale", scale_))
+            readNumber(directory_ + "/in_illuminance_scale", scale_);
+          if (!readNumber(prefix + "_offset", offset_))
+            readNumber(directory_ + "/in_illuminance_offset", offset_);
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void AmbientLight::openBacklight()
+  {
+    if (settings_.backlight.empty())
+      return;
+    const std::string root = sysfsRoot_ + "/class/backlight/";
+    std::string name = settings_.backlight;
+    if (name == "auto")
+    {
+      const auto backlights = listDirectory(root);
+      name = backlights.empty() ? std::string() : backlights.front();
+    }
+    double maxBrightness = 0;
+    double current = 0;
+    if (name.empty() || !readNumber(root + name + "/max_brightness", maxBrightness) || maxBrightness < 1)
+    {
+      OPENAUTO_LOG(warning) << "[AmbientLight] No backlight '" << settings_.backlight << "'";
+      return;
+    }
+    backlightFd_ = open((root + name + "/brightness").c_str(), O_RDWR | O_CLOEXEC);
+    if (backlightFd_ < 0)
+    {
+      OPENAUTO_LOG(warning) << "[AmbientLight] Cannot open " << root << name << "/brightness: " << std::strerror(errno);
+      return;
+    }
+    maxBrightness_ = static_cast<int>(maxBrightness);
+    brightness_ = readNumber(backlightFd_, current) ? static_cast<int>(current) : -1;
+    OPENAUTO_LOG(info) << "[AmbientLight] Driving " << name << ", 0-" << maxBrightness_;
+  }
+
+  void AmbientLight::run()
+  {
+    int64_t nextPollMs = nowMs();
+    while (!stopping_)
+    {
+      const bool ramping = targetBrightness_ >= 0 && brightness_ != targetBrightness_;
+      int timeoutMs = ramping ? cRampStepMs : -1;
+      if (bufferFd_ < 0)
+      {
+        const int untilPoll = static_cast<int>(std::max<int64_t>(0, nextPollMs - nowMs()));
+        timeoutMs = timeoutMs < 0 ? untilPoll : std::min(timeoutMs, untilPoll);
+      }
+
+      pollfd fds[2] = {{wakeFd_, POLLIN, 0}, {bufferFd_, POLLIN, 0}};
+      const int ready = poll(fds, bufferFd_ >= 0 ? 2 : 1, timeoutMs);
+      if (ready < 0 && errno == EINTR)
+        continue;
+      if (ready < 0)
+      {
+        OPENAUTO_LOG(error) << "[AmbientLight] poll failed: " << std::strerror(errno);
+        return;
+      }
+      if (stopping_)
+        return;
+
+      if (bufferFd_ >= 0 && (fds[1].revents & POLLIN))
+      {
+        this->readBuffer();
+      }
+      else if (bufferFd_ < 0 && nowMs() >= nextPollMs)
+      {
+        nextPollMs = nowMs() + cPollMs;
+        double raw = 0;
+        if (readNumber(polledFd_, raw))
+          this->onLux((raw + offset_) * scale_);
+      }
+
+      if (ramping)
+        this->rampStep();
+    }
+  }
+
+  void AmbientLight::readBuffer()
+  {
+    const size_t recordBytes = static_cast<size_t>(scanType_.storageBits / 8);
+    uint8_t records[cBufferLength * 8];
+    const ssize_t size = read(bufferFd_, records, std::min(sizeof(records), recordBytes * cBufferLength));
+    if (size <= 0)
+    {
+      if (size < 0 && errno != EAGAIN)
+        OPENAUTO_LOG(warning) << "[AmbientLight] Buffer read failed: " << std::strerror(errno);
+      return;
+    }
+    // What queued up since the last wakeup arrives together: one reading
+    const size_t count = static_cast<size_t>(size) / recordBytes;
+    if (count == 0)
+      return;
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++)
+      sum += static_cast<double>(decode(records + i * recordBytes, scanType_));
+    this->onLux((sum / count + offset_) * scale_);
+  }
+
+  void AmbientLight::onLux(double lux)
+  {
+    if (filter_.update(lux, nowMs()))
+    {
+      const bool night = filter_.night();
+      OPENAUTO_LOG(info) << "[AmbientLight] " << (night ? "Night" : "Day") << " at " << filter_.lux() << " lux";
+      metrics().switches.add();
+      // SensorService follows the flag and tells the phone right away
+      if (night)
+        StateBus::instance().set(StateFlag::NightMode);
+      else
+        StateBus::instance().clear(StateFlag::NightMode);
+    }
+    metrics().lux.set(static_cast<int64_t>(std::lround(filter_.lux())));
+
+    if (backlightFd_ < 0)
+      return;
+    const int level = std::max(1, static_cast<int>(std::lround(filter_.brightness() * maxBrightness_)));
+    // Sensor noise moves the average a little all the time; the panel only
+    // follows changes of 2% or more
+    if (targetBrightness_ < 0 || std::abs(level - targetBrightness_) >= std::max(1, maxBrightness_ / 50))
+      targetBrightness_ = level;
+  }
+
+  bool AmbientLight::rampStep()
+  {
+    if (brightness_ == targetBrightness_)
+      return false;
+    const int step = std::max(1, maxBrightness_ * cRampStepMs / cRampMs);
+    if (brightness_ < 0)
+      brightness_ = targetBrightness_;
+    else if (brightness_ < targetBrightness_)
+      brightness_ = std::min(targetBrightness_, brightness_ + step);
+    else
+      brightness_ = std::max(targetBrightness_, brightness_ - step);
+
+    const std::string value = std::to_string(brightness_);
+    if (pwrite(backlightFd_, value.data(), value.size(), 0) < 0)
+      OPENAUTO_LOG(warning) << "[AmbientLight] Backlight write failed: " << std::strerror(errno);
+    metrics().backlight.set(brightness_);
+    return brightness_ != targetBrightness_;
+  }
+
+  bool AmbientLight::parseScanType(const std::string &text, IioScanType &type)
+  {
+    char endian[3] = {};
+    char sign = 0;
+    int bits = 0;
+    int storageBits = 0;
+    int shift = 0;
+    // Repeated elements ("X4") are not light readings
+    if (text.find('X') != std::string::npos ||
+        std::sscanf(text.c_str(), "%2[bel]:%c%d/%d>>%d", endian, &sign, &bits, &storageBits, &shift) != 5)
+      return false;
+    if ((std::strcmp(endian, "be") != 0 && std::strcmp(endian, "le") != 0) || (sign != 's' && sign != 'u') ||
+        bits <= 0 || storageBits % 8 != 0 || storageBits > 64 || bits + shift > storageBits)
+      return false;
+    type.bigEndian = endian[0] == 'b';
+    type.isSigned = sign == 's';
+    type.bits = bits;
+    type.storageBits = storageBits;
+    type.shift = shift;
+    return true;
+  }
+
+  int64_t AmbientLight::decode(const uint8_t *data, const IioScanType &type)
+  {
+    const int bytes = type.storageBits / 8;
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+      value |= static_cast<uint64_t>(data[type.bigEndian ? i : bytes - 1 - i]) << (8 * (bytes - 1 - i));
+    value >>= type.shift;
+    if (type.bits < 64)
+      value &= (uint64_t(1) << type.bits) - 1;
+    if (type.isSigned && type.bits < 64 && (value & (uint64_t(1) << (type.bits - 1))))
+      value |= ~((uint64_t(1) << type.bits) - 1);
+    return static_cast<int64_t>(value);
+  }
+
+}
@@ -20,26 +20,108 @@
 #include <aasdk/USB/AOAPDevice.hpp>
 #include <aasdk/TCP/TCPEndpoint.hpp>
 #include <f1x/openauto/autoapp/App.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/StartupTrace.hpp>
+#include <f1x/openauto/autoapp/StrandMonitor.hpp>
+#include <f1x/openauto/autoapp/HotspotLink.hpp>
+#include <f1x/openauto/autoapp/TcpTuning.hpp>
 #include <f1x/openauto/Common/Log.hpp>
 
 namespace f1x::openauto::autoapp
 {
 
+  namespace
+  {
+    struct AppMetrics
+    {
+      MetricCounter &usbConnections = Metrics::instance().counter(
+          "openauto_usb_connections_total", "Phones that came up in accessory mode over USB");
+      MetricCounter &wifiConnections = Metrics::instance().counter(
+          "openauto_wifi_connections_total", "Wireless projection clients accepted");
+      MetricCounter &entityErrors = Metrics::instance().counter(
+          "openauto_entity_create_errors_total", "Connections that failed before a session could start");
+      MetricCounter &usbHubErrors = Metrics::instance().counter(
+          "openauto_usb_hub_errors_total", "USB hub failures while waiting for a phone");
+      MetricCounter &rejectedConnections = Metrics::instance().counter(
+          "openauto_connections_rejected_total", "Connections dropped to keep the running session");
+      MetricCounter &replacedSessions = Metrics::instance().counter(
+          "openauto_sessions_replaced_total", "Sessions stopped for a preferred transport");
+      MetricCounter &fastReconnects = Metrics::instance().counter(
+          "openauto_usb_fast_reconnects_total", "Known phones opened in accessory mode without the AOAP query chain");
+    };
+
+    AppMetrics &metrics()
+    {
+      static AppMetrics instance;
+      return instance;
+    }
+
+    // What a phone enumerates as once in accessory mode (AOAP 2.0, with and without adb)
+    constexpr uint16_t cGoogleVendorId = 0x18D1;
+    constexpr uint16_t cAccessoryProductIdFirst = 0x2D00;
+    constexpr uint16_t cAccessoryProductIdLast = 0x2D05;
+
+    bool isAccessoryMode(const libusb_device_descriptor &descriptor)
+    {
+      return descriptor.idVendor == cGoogleVendorId && descriptor.idProduct >= cAccessoryProductIdFirst &&
+             descriptor.idProduct <= cAccessoryProductIdLast;
+    }
+
+    std::string serialNumber(libusb_device_handle *handle, const libusb_device_descriptor &descriptor)
+    {
+      unsigned char serial[128];
+      if (descriptor.iSerialNumber == 0 ||
+          libusb_get_string_descriptor_ascii(handle, descriptor.iSerialNumber, serial, sizeof(serial)) <= 0)
+        return std::string();
+      return reinterpret_cast<const char *>(serial);
+    }
+  }
+
   App::App(boost::asio::io_service &ioService, aasdk::usb::USBWrapper &usbWrapper, aasdk::tcp::ITCPWrapper &tcpWrapper,
            service::IAndroidAutoEntityFactory &androidAutoEntityFactory,
            aasdk::usb::IUSBHub::Pointer usbHub,
-           aasdk::usb::IConnectedAccessoriesEnumerator::Pointer connectedAccessoriesEnumerator)
+           aasdk::usb::IConnectedAccessoriesEnumerator::Pointer connectedAccessoriesEnumerator,
+           configuration::IKnownDevicesList::Pointer knownDevices)
       : ioService_(ioService), usbWrapper_(usbWrapper), tcpWrapper_(tcpWrapper), strand_(ioService_),
         androidAutoEntityFactory_(androidAutoEntityFactory), usbHub_(std::move(usbHub)),
         connectedAccessoriesEnumerator_(std::move(connectedAccessoriesEnumerator)),
-        acceptor_(ioService, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), 5000)), isStopped_(false)
+        acceptor_(ioService, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), 5000)), isStopped_(false),
+        knownDevices_(std::move(knownDevices)), wirelessSocket_(-1), linkTimer_(ioService_)
+  {
+    // Listed by the exporter from the start, not after the first connection
+    metrics();
+    TcpTuning::instance().applyListener(acceptor_.native_handle());
+
+    // Any arrival starts the time-to-projection clock; the phone's second
+    // arrival in accessory mode keeps the first one's start
+    arrivalCallback_ = usbWrapper_.hotplugRegisterCallback(
+        LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED, LIBUSB_HOTPLUG_NO_FLAGS, LIBUSB_HOTPLUG_MATCH_ANY,
+        LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, &App::onUsbDeviceArrived, nullptr);
+  }
+
+  int App::onUsbDeviceArrived(libusb_context *, libusb_device *, libusb_hotplug_event, void *)
   {
+    StartupTrace::beginConnection("usb arrival");
+    return 0;
   }
 
   void App::waitForUSBDevice()
   {
-    strand_.dispatch([this, self = this->shared_from_this()]()
+    strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("app.wait_usb"), [this, self = this->shared_from_this()]()
                      {
+                       try
+                       {
+                         if (this->openKnownAccessory())
+                         {
+                           this->startServerSocket();
+                           return;
+                         }
+                       }
+                       catch (...)
+                       {
+                         OPENAUTO_LOG(error) << "[App] waitForUSBDevice() exception caused by this->openKnownAccessory()";
+                       }
                        try
                        {
                          this->waitForDevice();
@@ -56,50 +138,58 @@ namespace f1x::openauto::autoapp
                        {
                          OPENAUTO_LOG(error) << "[App] waitForUSBDevice() exception caused by this->enumerateDevices()";
                        }
-                     });
+                     }));
   }
 
   void App::start(aasdk::tcp::ITCPEndpoint::SocketPointer socket)
   {
-    strand_.dispatch([this, self = this->shared_from_this(), socket = std::move(socket)]() mutable
+    strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("app.start_wifi"), [this, self = this->shared_from_this(), socket = std::move(socket)]() mutable
                      {
       OPENAUTO_LOG(info) << "Start from socket";
-      if (androidAutoEntity_ != nullptr) {
-//            tcpWrapper_.close(*socket);
-//            OPENAUTO_LOG(warning) << "[App] android auto entity is still running.";
-//            return;
-        try {
-          androidAutoEntity_->stop();
-        } catch (...) {
-          OPENAUTO_LOG(error) << "[App] onAndroidAutoQuit: exception caused by androidAutoEntity_->stop();";
-        }
-        try {
-          androidAutoEntity_.reset();
-        } catch (...) {
-          OPENAUTO_LOG(error) << "[App] onAndroidAutoQuit: exception caused by androidAutoEntity_.reset();";
-        }
+      const auto decision = arbiter_.offer(ConnectionTransport::Wifi, LinkQuality::instance().state());
+      if (decision == ArbiterDecision::Reject) {
+        OPENAUTO_LOG(warning) << "[App] Keeping the running " << connectionTransportName(arbiter_.current())
+                              << " session, closing the WiFi client.";
+        metrics().rejectedConnections.add();
+        tcpWrapper_.close(*socket);
+        this->startServerSocket();
+        return;
       }
+      if (decision == ArbiterDecision::Replace) {
+        OPENAUTO_LOG(info) << "[App] WiFi client replaces the " << connectionTransportName(arbiter_.current())
+                           << " session.";
+        metrics().replacedSessions.add();
+      }
+      this->stopEntity("start");
 
       try {
 //            usbHub_->cancel();
 //            connectedAccessoriesEnumerator_->cancel();
 
+        metrics().wifiConnections.add();
+        const int nativeSocket = socket->native_handle();
         auto tcpEndpoint(std::make_shared<aasdk::tcp::TCPEndpoint>(tcpWrapper_, std::move(socket)));
         androidAutoEntity_ = androidAutoEntityFactory_.create(std::move(tcpEndpoint));
         androidAutoEntity_->start(*this);
+        arbiter_.started(ConnectionTransport::Wifi);
+        FlightRecorder::instance().record(FlightEvent::SessionStarted, 1);
+        wirelessSocket_ = nativeSocket;
+        HotspotLink::instance().startSession(nativeSocket);
+        this->sampleWirelessLink();
         if (onAAStarted) onAAStarted();
       }
       catch (const aasdk::error::Error &error) {
         OPENAUTO_LOG(error) << "[App] TCP AndroidAutoEntity create error: " << error.what();
+        metrics().entityErrors.add();
 
         //androidAutoEntity_.reset();
         this->waitForDevice();
-      } });
+      } }));
   }
 
   void App::stop()
   {
-    strand_.dispatch([this, self = this->shared_from_this()]()
+    strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("app.stop"), [this, self = this->shared_from_this()]()
                      {
       isStopped_ = true;
       try {
@@ -113,18 +203,37 @@ namespace f1x::openauto::autoapp
         OPENAUTO_LOG(error) << "[App] stop: exception caused by usbHub_->cancel();";
       }
 
-      if (androidAutoEntity_ != nullptr) {
-        try {
-          androidAutoEntity_->stop();
-        } catch (...) {
-          OPENAUTO_LOG(error) << "[App] stop: exception caused by androidAutoEntity_->stop();";
-        }
-        try {
-          androidAutoEntity_.reset();
-        } catch (...) {
-          OPENAUTO_LOG(error) << "[App] stop: exception caused by androidAutoEntity_.reset();";
-        }
-      } });
+      this->stopEntity("stop"); }));
+  }
+
+  void App::stopEntity(const char *caller)
+  {
+    arbiter_.ended();
+    // Before the entity closes the socket and its descriptor can be reused
+    if (wirelessSocket_ >= 0)
+      HotspotLink::instance().endSession();
+    wirelessSocket_ = -1;
+    linkTimer_.cancel();
+    if (androidAutoEntity_ == nullptr)
+      return;
+    FlightRecorder::instance().record(FlightEvent::SessionStopped);
+
+    try
+    {
+      androidAutoEntity_->stop();
+    }
+    catch (...)
+    {
+      OPENAUTO_LOG(error) << "[App] " << caller << ": exception caused by androidAutoEntity_->stop();";
+    }
+    try
+    {
+      androidAutoEntity_.reset();
+    }
+    catch (...)
+    {
+      OPENAUTO_LOG(error) << "[App] " << caller << ": exception caused by androidAutoEntity_.reset();";
+    }
   }
 
   void App::aoapDeviceHandler(aasdk::usb::DeviceHandle deviceHandle)
@@ -133,8 +242,17 @@ namespace f1x::openauto::autoapp
 
     if (androidAutoEntity_ != nullptr)
     {
-      OPENAUTO_LOG(warning) << "[App] android auto entity is still running.";
-      return;
+      // USB comes up seconds after WiFi on a dual-capable phone, and wins
+      if (arbiter_.offer(ConnectionTransport::Usb, LinkQuality::instance().state()) != ArbiterDecision::Replace ||
+          disableAutostartEntity)
+      {
+        OPENAUTO_LOG(warning) << "[App] android auto entity is still running.";
+        metrics().rejectedConnections.add();
+        return;
+      }
+      OPENAUTO_LOG(info) << "[App] USB replaces the " << connectionTransportName(arbiter_.current()) << " session.";
+      metrics().replacedSessions.add();
+      this->stopEntity("aoapDeviceHandler");
     }
 
     try
@@ -145,9 +263,13 @@ namespace f1x::openauto::autoapp
         OPENAUTO_LOG(info) << "[App] Start Android Auto allowed - let's go.";
         connectedAccessoriesEnumerator_->cancel();
 
+        metrics().usbConnections.add();
+        this->rememberDevice(deviceHandle);
         auto aoapDevice(aasdk::usb::AOAPDevice::create(usbWrapper_, ioService_, deviceHandle));
         androidAutoEntity_ = androidAutoEntityFactory_.create(std::move(aoapDevice));
         androidAutoEntity_->start(*this);
+        arbiter_.started(ConnectionTransport::Usb);
+        FlightRecorder::instance().record(FlightEvent::SessionStarted, 0);
         if (onAAStarted)
           onAAStarted();
       }
@@ -159,6 +281,7 @@ namespace f1x::openauto::autoapp
     catch (const aasdk::error::Error &error)
     {
       OPENAUTO_LOG(error) << "[App] USB AndroidAutoEntity create error: " << error.what();
+      metrics().entityErrors.add();
 
       androidAutoEntity_.reset();
       this->waitForDevice();
@@ -178,6 +301,59 @@ namespace f1x::openauto::autoapp
     connectedAccessoriesEnumerator_->enumerate(std::move(promise));
   }
 
+  bool App::openKnownAccessory()
+  {
+    if (knownDevices_ == nullptr || knownDevices_->getList().empty() || androidAutoEntity_ != nullptr ||
+        disableAutostartEntity)
+      return false;
+
+    aasdk::usb::DeviceListHandle deviceList;
+    if (usbWrapper_.getDeviceList(deviceList) < 0)
+      return false;
+
+    for (auto *device : *deviceList)
+    {
+      libusb_device_descriptor descriptor;
+      if (usbWrapper_.getDeviceDescriptor(device, descriptor) != 0 || !isAccessoryMode(descriptor))
+        continue;
+
+      // A phone left in accessory mode does not arrive again, so the hub
+      // would not see it; opening it directly also skips the query chain
+      aasdk::usb::DeviceHandle handle;
+      if (usbWrapper_.open(device, handle) != 0 || handle == nullptr)
+        continue;
+
+      const std::string serial = serialNumber(handle.get(), descriptor);
+      if (!knownDevices_->contains(serial))
+        continue;
+
+      OPENAUTO_LOG(info) << "[App] Known phone " << serial << " already in accessory mode, opening it directly.";
+      StartupTrace::beginConnection("known accessory");
+      metrics().fastReconnects.add();
+      // On failure the handler falls back to waiting on the hub itself
+      this->aoapDeviceHandler(std::move(handle));
+      return true;
+    }
+    return false;
+  }
+
+  void App::rememberDevice(const aasdk::usb::DeviceHandle &deviceHandle)
+  {
+    if (knownDevices_ == nullptr)
+      return;
+
+    libusb_device_descriptor descriptor;
+    if (usbWrapper_.getDeviceDescriptor(libusb_get_device(deviceHandle.get()), descriptor) != 0)
+      return;
+
+    configuration::KnownDevice device;
+    device.vendorId = descriptor.idVendor;
+    device.productId = descriptor.idProduct;
+    device.serial = serialNumber(deviceHandle.get(), descriptor);
+    if (!device.serial.empty())
+      knownDevices_->insertDevice(device);
+  }
+
   void App::waitForDevice()
   {
     OPENAUTO_LOG(info) << "[App] Waiting for device...";
@@ -191,14 +367,15 @@ namespace f1x::openauto::autoapp
 
   void App::startServerSocket()
   {
-    strand_.dispatch([this, self = this->shared_from_this()]()
+    strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("app.listen"), [this, self = this->shared_from_this()]()
                      {
       OPENAUTO_LOG(info) << "startServerSocket() - Listening for WIFI Clients on Port 5000";
+      StartupTrace::markOnce("wifi listener armed");
       auto socket = std::make_shared<boost::asio::ip::tcp::socket>(ioService_);
       acceptor_.async_accept(
           *socket,
           std::bind(&App::handleNewClient, this, socket, std::placeholders::_1)
-      ); });
+      ); }));
   }
 
   void
@@ -207,50 +384,62 @@ namespace f1x::openauto::autoapp
     OPENAUTO_LOG(info) << "handleNewClient() - Handle WIFI Client Connection";
     if (!err)
     {
+      StartupTrace::beginConnection("wifi client");
+      TcpTuning::instance().apply(socket->native_handle());
       start(std::move(socket));
     }
   }
 
+  void App::sampleWirelessLink()
+  {
+    linkTimer_.expires_from_now(std::chrono::milliseconds(TcpTuning::cSampleIntervalMs));
+    linkTimer_.async_wait(strand_.wrap(monitoredCompletion(
+        OPENAUTO_STRAND_SITE("app.link_sample"), [this, self = this->shared_from_this()](const boost::system::error_code &error)
+        {
+          if (error || wirelessSocket_ < 0)
+            return;
+          if (!TcpTuning::instance().sample(wirelessSocket_))
+            return;
+          // The station counters come from hostapd or iw on the link's
+          // thread; the next sample is armed once they are in
+          HotspotLink::instance().sample(strand_.wrap(monitoredCompletion(
+              OPENAUTO_STRAND_SITE("app.link_sampled"), [this, self](int64_t)
+              {
+                if (wirelessSocket_ >= 0)
+                  this->sampleWirelessLink();
+              })));
+        })));
+  }
+
   void App::pause()
   {
-    strand_.dispatch([this, self = this->shared_from_this()]()
+    strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("app.pause"), [this, self = this->shared_from_this()]()
                      {
       OPENAUTO_LOG(info) << "[App] pause...";
-      androidAutoEntity_->pause(); });
+      androidAutoEntity_->pause(); }));
   }
 
   void App::resume()
   {
-    strand_.dispatch([this, self = this->shared_from_this()]()
+    strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("app.resume"), [this, self = this->shared_from_this()]()
                      {
       if (androidAutoEntity_ != nullptr) {
         OPENAUTO_LOG(info) << "[App] resume...";
         androidAutoEntity_->resume();
       } else {
         OPENAUTO_LOG(info) << "[App] Ignore resume -> no androidAutoEntity_ ...";
-      } });
+      } }));
   }
 
   void App::onAndroidAutoQuit()
   {
-    strand_.dispatch([this, self = this->shared_from_this()]()
+    strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("app.quit"), [this, self = this->shared_from_this()]()
                      {
       OPENAUTO_LOG(info) << "[App] onAndroidAutoQuit()";
 
       //acceptor_.close();
 
-      if (androidAutoEntity_ != nullptr) {
-        try {
-          androidAutoEntity_->stop();
-        } catch (...) {
-          OPENAUTO_LOG(error) << "[App] onAndroidAutoQuit: exception caused by androidAutoEntity_->stop();";
-        }
-        try {
-          androidAutoEntity_.reset();
-        } catch (...) {
-          OPENAUTO_LOG(error) << "[App] onAndroidAutoQuit: exception caused by androidAutoEntity_.reset();";
-        }
-      }
+      this->stopEntity("onAndroidAutoQuit");
 
       if (onAAStopped) onAAStopped();
 
@@ -260,12 +449,13 @@ namespace f1x::openauto::autoapp
         } catch (...) {
           OPENAUTO_LOG(error) << "[App] onAndroidAutoQuit: exception caused by this->waitForDevice();";
         }
-      } });
+      } }));
   }
 
   void App::onUSBHubError(const aasdk::error::Error &error)
   {
     OPENAUTO_LOG(error) << "[App] onUSBHubError(): " << error.what();
+    metrics().usbHubErrors.add();
 
     //    if(error != aasdk::error::ErrorCode::OPERATION_ABORTED &&
     //       error != aasdk::error::ErrorCode::OPERATION_IN_PROGRESS)
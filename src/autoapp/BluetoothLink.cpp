@@ -0,0 +1,204 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <f1x/openauto/autoapp/BluetoothLink.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  BluetoothLink::BluetoothLink(std::string socketName, std::string peerName)
+      : peerName_(std::move(peerName)), phoneConnected_(false), serviceReady_(false), nextHandlerId_(1),
+        fd_(common::openBtLinkSocket(socketName.c_str())), wakeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+        stopping_(false)
+  {
+    if (fd_ < 0)
+    {
+      OPENAUTO_LOG(error) << "[BluetoothLink] Cannot listen for btservice: " << std::strerror(errno);
+      return;
+    }
+    // Not running yet is fine: btservice sends everything as it starts up
+    common::BtLinkEvent hello;
+    hello.type = common::BtLinkMessage::Hello;
+    common::sendBtLinkEvent(fd_, peerName_.c_str(), hello);
+
+    if (wakeFd_ >= 0)
+    {
+      thread_ = std::thread(&BluetoothLink::run, this);
+    }
+  }
+
+  BluetoothLink::~BluetoothLink()
+  {
+    stopping_ = true;
+    if (thread_.joinable())
+    {
+      const uint64_t one = 1;
+      (void)write(wakeFd_, &one, sizeof(one));
+      thread_.join();
+    }
+    for (int fd : {fd_, wakeFd_})
+    {
+      if (fd >= 0)
+      {
+        close(fd);
+      }
+    }
+  }
+
+  BluetoothLink &BluetoothLink::instance()
+  {
+    static BluetoothLink link(common::cBtLinkAutoappSocket, common::cBtLinkBtserviceSocket);
+    return link;
+  }
+
+  bool BluetoothLink::phoneConnected() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return phoneConnected_;
+  }
+
+  std::string BluetoothLink::phoneName() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return phoneName_;
+  }
+
+  std::string BluetoothLink::phoneAddress() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return phoneAddress_;
+  }
+
+  std::string BluetoothLink::hotspotSsid() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hotspotSsid_;
+  }
+
+  bool BluetoothLink::serviceReady() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return serviceReady_;
+  }
+
+  bool BluetoothLink::requestPairing(int seconds)
+  {
+    common::BtLinkEvent request;
+    request.type = common::BtLinkMessage::PairingRequested;
+    request.value = seconds;
+    return fd_ >= 0 && common::sendBtLinkEvent(fd_, peerName_.c_str(), request);
+  }
+
+  int BluetoothLink::subscribe(Handler handler)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int id = nextHandlerId_++;
+    handlers_.emplace(id, std::move(handler));
+    return id;
+  }
+
+  void BluetoothLink::unsubscribe(int id)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    handlers_.erase(id);
+  }
+
+  void BluetoothLink::handle(const common::BtLinkEvent &event)
+  {
+    std::vector<Handler> handlers;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      switch (event.type)
+      {
+      case common::BtLinkMessage::PhoneConnected:
+        phoneConnected_ = true;
+        phoneName_ = event.name;
+        phoneAddress_ = event.address;
+        break;
+      case common::BtLinkMessage::PhoneDisconnected:
+        phoneConnected_ = false;
+        phoneName_.clear();
+        phoneAddress_.clear();
+        break;
+      case common::BtLinkMessage::WifiOffered:
+        hotspotSsid_ = event.name;
+        break;
+      case common::BtLinkMessage::ServiceStage:
+        if (event.name == common::cBtServiceReady)
+          serviceReady_ = true;
+        break;
+      default:
+        break;
+      }
+      for (const auto &handler : handlers_)
+      {
+        handlers.push_back(handler.second);
+      }
+    }
+
+    // Outside the lock: handlers may read the link or unsubscribe
+    for (const auto &handler : handlers)
+    {
+      handler(event);
+    }
+  }
+
+  void BluetoothLink::run()
+  {
+    pollfd fds[2] = {{fd_, POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+    char packet[common::cBtLinkMaxSize];
+
+    while (!stopping_)
+    {
+      if (poll(fds, 2, -1) < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        OPENAUTO_LOG(error) << "[BluetoothLink] poll failed: " << std::strerror(errno);
+        return;
+      }
+      if (!(fds[0].revents & POLLIN))
+      {
+        continue;
+      }
+
+      ssize_t size;
+      while ((size = recv(fd_, packet, sizeof(packet), 0)) > 0)
+      {
+        common::BtLinkEvent event;
+        if (!common::decodeBtLinkEvent(packet, static_cast<size_t>(size), event))
+        {
+          OPENAUTO_LOG(warning) << "[BluetoothLink] Dropped a malformed " << size << " byte message";
+          continue;
+        }
+        OPENAUTO_LOG(debug) << "[BluetoothLink] Event " << static_cast<int>(event.type) << " " << event.address;
+        this->handle(event);
+      }
+    }
+  }
+
+}
@@ -16,8 +16,19 @@
 *  along with openauto. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <QSaveFile>
 #include <QSettings>
 #include <QTouchDevice>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
+#include <pthread.h>
+#include <sys/stat.h>
 #include <f1x/openauto/Common/Log.hpp>
 #include <f1x/openauto/autoapp/Configuration/Configuration.hpp>
 
@@ -108,248 +119,673 @@ const std::string Configuration::cInputBackButtonKey = "Input.BackButton";
 const std::string Configuration::cInputEnterButtonKey = "Input.EnterButton";
 const std::string Configuration::cInputNavButtonKey = "Input.NavButton";
 
-Configuration::Configuration() { this->load(); }
+const std::string Configuration::cSnapshotFileName = "openauto.snapshot";
+
+namespace {
+
+typedef IConfiguration::ButtonCodes ButtonCodes;
+typedef aap_protobuf::service::media::sink::message::KeyCode KeyCode;
+
+constexpr uint32_t cSnapshotMagic = 0x5343414f; // "OACS"
+constexpr uint32_t cSnapshotVersion = 1;
+// Settings pages save on every change: write once they settle, and at
+// least every cSaveMaxDelay while changes keep coming
+constexpr std::chrono::milliseconds cSaveDebounce(500);
+constexpr std::chrono::milliseconds cSaveMaxDelay(2000);
+
+// Not deduced, so a literal default converts to the field's type
+template <typename T> using Fallback = typename std::common_type<T>::type;
+
+QString iniKey(const char *group, const char *key) {
+  return QString::fromLatin1(group) + '/' + QString::fromLatin1(key);
+}
+
+uint64_t fnv1a(const void *data, size_t size,
+               uint64_t hash = 14695981039346656037ULL) {
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+class IniReader {
+public:
+  explicit IniReader(QSettings &settings) : settings_(settings) {}
+
+  template <typename T>
+  void operator()(const char *group, const char *key, T &value,
+                  const Fallback<T> &fallback) {
+    const QString name = iniKey(group, key);
+    if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, QRect>) {
+      value = qvariant_cast<T>(settings_.value(name, fallback));
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      value = settings_.value(name, QString::fromStdString(fallback))
+                  .toString()
+                  .toStdString();
+    } else if constexpr (std::is_enum_v<T>) {
+      value = static_cast<T>(
+          settings_.value(name, static_cast<int>(fallback)).toInt());
+    } else if constexpr (std::is_signed_v<T>) {
+      value = static_cast<T>(
+          settings_.value(name, static_cast<qlonglong>(fallback)).toLongLong());
+    } else {
+      value = static_cast<T>(
+          settings_.value(name, static_cast<qulonglong>(fallback))
+              .toULongLong());
+    }
+  }
+
+  void operator()(const char *group, const char *key, ButtonCodes &value,
+                  const ButtonCodes &) {
+    value.clear();
+    const int size = settings_.beginReadArray(iniKey(group, key));
+    for (int i = 0; i < size; ++i) {
+      settings_.setArrayIndex(i);
+      value.push_back(static_cast<KeyCode>(settings_.value("KeyCode").toInt()));
+    }
+    settings_.endArray();
+  }
+
+private:
+  QSettings &settings_;
+};
+
+class IniWriter {
+public:
+  explicit IniWriter(QSettings &settings) : settings_(settings) {}
+
+  template <typename T>
+  void operator()(const char *group, const char *key, const T &value,
+                  const Fallback<T> &) {
+    const QString name = iniKey(group, key);
+    if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, QRect>) {
+      settings_.setValue(name, value);
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      settings_.setValue(name, QString::fromStdString(value));
+    } else if constexpr (std::is_enum_v<T>) {
+      settings_.setValue(name, static_cast<int>(value));
+    } else if constexpr (std::is_signed_v<T>) {
+      settings_.setValue(name, static_cast<qlonglong>(value));
+    } else {
+      settings_.setValue(name, static_cast<qulonglong>(value));
+    }
+  }
+
+  void operator()(const char *group, const char *key, const ButtonCodes &value,
+                  const ButtonCodes &) {
+    settings_.beginWriteArray(iniKey(group, key));
+    for (unsigned int i = 0; i < value.size(); ++i) {
+      settings_.setArrayIndex(i);
+      settings_.setValue("KeyCode", static_cast<int>(value[i]));
+    }
+    settings_.endArray();
+  }
+
+private:
+  QSettings &settings_;
+};
+
+struct DefaultsWriter {
+  template <typename T>
+  void operator()(const char *, const char *, T &value,
+                  const Fallback<T> &fallback) {
+    value = fallback;
+  }
+};
+
+// Changes whenever a field is added, removed, renamed or retyped, so a
+// snapshot written by another build is never misread
+struct SchemaSignature {
+  uint64_t hash = fnv1a(nullptr, 0);
+
+  template <typename T>
+  void operator()(const char *group, const char *key, const T &,
+                  const Fallback<T> &) {
+    const char *type = typeid(T).name();
+    hash = fnv1a(group, strlen(group) + 1, hash);
+    hash = fnv1a(key, strlen(key) + 1, hash);
+    hash = fnv1a(type, strlen(type) + 1, hash);
+  }
+};
+
+// Host byte order: the snapshot never leaves the board that wrote it
+class SnapshotWriter {
+public:
+  explicit SnapshotWriter(std::string &out) : out_(out) {}
+
+  template <typename T> void put(T value) {
+    out_.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  template <typename T>
+  void operator()(const char *, const char *, const T &value,
+                  const Fallback<T> &) {
+    if constexpr (std::is_same_v<T, std::string>) {
+      put(static_cast<uint32_t>(value.size()));
+      out_.append(value);
+    } else if constexpr (std::is_same_v<T, QRect>) {
+      put<int32_t>(value.x());
+      put<int32_t>(value.y());
+      put<int32_t>(value.width());
+      put<int32_t>(value.height());
+    } else {
+      put(static_cast<int64_t>(value));
+    }
+  }
+
+  void operator()(const char *, const char *, const ButtonCodes &value,
+                  const ButtonCodes &) {
+    put(static_cast<uint32_t>(value.size()));
+    for (const auto code : value) {
+      put(static_cast<int32_t>(code));
+    }
+  }
+
+private:
+  std::string &out_;
+};
+
+class SnapshotReader {
+public:
+  SnapshotReader(const char *data, size_t size)
+      : pos_(data), end_(data + size), ok_(true) {}
+
+  bool complete() const { return ok_ && pos_ == end_; }
+
+  template <typename T> bool get(T &value) {
+    if (!ok_ || static_cast<size_t>(end_ - pos_) < sizeof(value)) {
+      ok_ = false;
+      return false;
+    }
+    memcpy(&value, pos_, sizeof(value));
+    pos_ += sizeof(value);
+    return true;
+  }
+
+  template <typename T>
+  void operator()(const char *, const char *, T &value, const Fallback<T> &) {
+    if constexpr (std::is_same_v<T, std::string>) {
+      uint32_t size = 0;
+      if (!get(size) || static_cast<size_t>(end_ - pos_) < size) {
+        ok_ = false;
+        return;
+      }
+      value.assign(pos_, size);
+      pos_ += size;
+    } else if constexpr (std::is_same_v<T, QRect>) {
+      int32_t x = 0, y = 0, width = 0, height = 0;
+      if (get(x) && get(y) && get(width) && get(height)) {
+        value = QRect(x, y, width, height);
+      }
+    } else {
+      int64_t raw = 0;
+      if (get(raw)) {
+        value = static_cast<T>(raw);
+      }
+    }
+  }
+
+  void operator()(const char *, const char *, ButtonCodes &value,
+                  const ButtonCodes &) {
+    uint32_t count = 0;
+    if (!get(count) ||
+        static_cast<size_t>(end_ - pos_) / sizeof(int32_t) < count) {
+      ok_ = false;
+      return;
+    }
+    value.clear();
+    for (uint32_t i = 0; i < count; i++) {
+      int32_t code = 0;
+      get(code);
+      value.push_back(static_cast<KeyCode>(code));
+    }
+  }
+
+private:
+  const char *pos_;
+  const char *end_;
+  bool ok_;
+};
+
+// Size and modification time of the INI the snapshot was taken from
+struct FileIdentity {
+  int64_t size = -1;
+  int64_t modifiedNs = -1;
+
+  static FileIdentity of(const std::string &path) {
+    FileIdentity identity;
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0) {
+      identity.size = info.st_size;
+      identity.modifiedNs =
+          static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000LL +
+          info.st_mtim.tv_nsec;
+    }
+    return identity;
+  }
+};
+
+uint64_t schemaSignature() {
+  static const uint64_t signature = []() {
+    ConfigurationValues values{};
+    SchemaSignature visitor;
+    values.describe(visitor);
+    return visitor.hash;
+  }();
+  return signature;
+}
+
+/**
+ * One thread for all Configuration instances: they share the file. Only
+ * the newest scheduled job runs; flush() runs it now and waits.
+ */
+class DeferredWriter {
+public:
+  static DeferredWriter &instance() {
+    static DeferredWriter writer;
+    return writer;
+  }
+
+  ~DeferredWriter() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    changed_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  void schedule(std::function<void()> job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = std::chrono::steady_clock::now();
+    if (!job_) {
+      firstScheduled_ = now;
+    }
+    job_ = std::move(job);
+    due_ = std::min(now + cSaveDebounce, firstScheduled_ + cSaveMaxDelay);
+    if (!thread_.joinable()) {
+      thread_ = std::thread(&DeferredWriter::run, this);
+    }
+    changed_.notify_all();
+  }
+
+  void flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    due_ = std::chrono::steady_clock::now();
+    changed_.notify_all();
+    idle_.wait(lock, [this]() { return !job_ && !writing_; });
+  }
+
+private:
+  DeferredWriter() = default;
+
+  void run() {
+    pthread_setname_np(pthread_self(), "oa-config");
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      if (!job_) {
+        if (stopping_) {
+          return;
+        }
+        changed_.wait(lock);
+      } else if (!stopping_ && std::chrono::steady_clock::now() < due_) {
+        changed_.wait_until(lock, due_);
+      } else {
+        std::function<void()> job = std::move(job_);
+        job_ = nullptr;
+        writing_ = true;
+        lock.unlock();
+        job();
+        lock.lock();
+        writing_ = false;
+        idle_.notify_all();
+      }
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::condition_variable idle_;
+  std::thread thread_;
+  std::function<void()> job_;
+  std::chrono::steady_clock::time_point firstScheduled_;
+  std::chrono::steady_clock::time_point due_;
+  bool writing_ = false;
+  bool stopping_ = false;
+};
+
+} // namespace
+
+template <typename Visitor>
+void ConfigurationValues::describe(Visitor &visitor) {
+  namespace media = aap_protobuf::service::media::sink::message;
+
+  visitor("Video", "FPS", videoFPS_, media::VideoFrameRateType::VIDEO_FPS_60);
+  visitor("Video", "Resolution", videoResolution_,
+          media::VideoCodecResolutionType::VIDEO_800x480);
+  visitor("Video", "DPI", screenDPI_, 160);
+  visitor("Video", "OMXLayerIndex", omxLayerIndex_, 2);
+  visitor("Video", "Margins", videoMargins_, QRect(0, 0, 0, 0));
+  visitor("Video", "FrameQueueDepth", videoFrameQueueDepth_, 1);
+  visitor("Video", "AdaptiveMode", videoAdaptiveMode_, true);
+  visitor("Video", "MaxUnacked", videoMaxUnacked_, 2);
+  visitor("Video", "CompositorImport", videoCompositorImport_, false);
+  visitor("Video", "VideoBackend", videoBackend_, "");
+  visitor("Video", "RearCameraDevice", rearCameraDevice_, "");
+  visitor("Video", "RearCameraHotStandby", rearCameraHotStandby_, false);
+  visitor("Video", "RearCameraGuidelines", rearCameraGuidelines_, true);
+  visitor("Video", "DashcamEnabled", dashcamEnabled_, false);
+  visitor("Video", "DashcamDirectory", dashcamDirectory_, "/home/pi/Dashcam");
+  visitor("Video", "DashcamSegmentSeconds", dashcamSegmentSeconds_, 60);
+  visitor("Video", "DashcamMaxDiskMB", dashcamMaxDiskMb_, 4096);
+  visitor("Video", "DashcamBitrateKbps", dashcamBitrateKbps_, 4000);
+  visitor("Video", "ClusterOutput", clusterOutput_, "");
+  visitor("Video", "DisplayRotation", videoDisplayRotation_, 0);
+  visitor("Video", "DisplayMirror", videoDisplayMirror_, false);
+
+  visitor("General", "ShowClock", showClock_, false);
+  visitor("General", "ShowBigClock", showBigClock_, false);
+  visitor("General", "OldGUI", oldGUI_, false);
+  visitor("General", "AlphaTrans", alphaTrans_, 200);
+  visitor("General", "HideMenuToggle", hideMenuToggle_, false);
+  visitor("General", "HideAlpha", hideAlpha_, false);
+  visitor("General", "ShowLux", showLux_, false);
+  visitor("General", "ShowCursor", showCursor_, true);
+  visitor("General", "HideBrightnessControl", hideBrightnessControl_, false);
+  visitor("General", "ShowNetworkinfo", showNetworkinfo_, false);
+  visitor("General", "HideWarning", hideWarning_, false);
+  visitor("General", "HandednessOfTraffic", handednessOfTrafficType_,
+          HandednessOfTrafficType::RIGHT_HAND_DRIVE);
+  visitor("General", "SessionRecordingPath", sessionRecordingPath_, "");
+  visitor("General", "TlsSessionResumption", tlsSessionResumption_, true);
+  visitor("General", "TlsCipherPreference", tlsCipherPreference_, "auto");
+  visitor("General", "UsbFastReconnect", usbFastReconnect_, true);
+  visitor("General", "UsbInTransfers", usbInTransfers_, 4);
+  visitor("General", "UsbInTransferKb", usbInTransferKb_, 64);
+  visitor("General", "OutboundPriority", outboundPriority_, true);
+  visitor("General", "MessageBufferPool", messageBufferPool_, true);
+
+  visitor("Audio", "MusicAudioChannelEnabled", _audioChannelEnabledMedia, true);
+  visitor("Audio", "GuidanceAudioChannelEnabled", _audioChannelEnabledGuidance,
+          true);
+  visitor("Audio", "SystemAudioChannelEnabled", _audioChannelEnabledSystem,
+          true);
+  visitor("Audio", "TelephonyAudioChannelEnabled",
+          _audioChannelEnabledTelephony, false);
+  visitor("Audio", "AudioOutputDeviceName", audioOutputDeviceName_, "");
+  visitor("Audio", "AudioInputDeviceName", audioInputDeviceName_, "");
+  visitor("Audio", "AudioLowLatency", audioLowLatency_, true);
+  visitor("Audio", "AudioJitterBufferMs", audioJitterBufferMs_, 60);
+  visitor("Audio", "AudioMixerEnabled", audioMixerEnabled_, true);
+  visitor("Audio", "AudioDuckingPercent", audioDuckingPercent_, 30);
+  visitor("Audio", "AudioVoiceProcessing", audioVoiceProcessing_, false);
+  visitor("Audio", "AudioVoiceProcessingLowCpu", audioVoiceProcessingLowCpu_,
+          true);
+  visitor("Audio", "AudioVoiceProcessingCpu", audioVoiceProcessingCpu_, -1);
+  visitor("Audio", "AudioAckBatch", audioAckBatch_, 1);
+  visitor("Audio", "AudioMediaAac", audioMediaAac_, false);
+  visitor("Audio", "AudioMicPreRollMs", audioMicPreRollMs_, 0);
+  visitor("Audio", "RadioDevice", radioDevice_, "");
+  visitor("Audio", "RadioAudioDevice", radioAudioDevice_, "");
+  visitor("Audio", "RadioRegion", radioRegion_, "EU");
+  visitor("Audio", "AudioWarmStreams", audioWarmStreams_, true);
+  visitor("Audio", "AudioDspEnabled", audioDspEnabled_, false);
+  visitor("Audio", "AudioEqualizerGains", audioEqualizerGains_, "0,0,0,0,0");
+  visitor("Audio", "AudioLoudnessPercent", audioLoudnessPercent_, 0);
+  visitor("Audio", "AudioDspCpuBudgetPercent", audioDspCpuBudgetPercent_, 10);
+
+  visitor("Threads", "IoWorkers", threadIoWorkers_, 0);
+  visitor("Threads", "WorkerCpus", threadWorkerCpus_, "auto");
+  visitor("Threads", "VideoCpus", threadVideoCpus_, "auto");
+  visitor("Threads", "AudioCpus", threadAudioCpus_, "auto");
+  visitor("Threads", "VideoPriority", threadVideoPriority_, -1);
+  visitor("Threads", "AudioPriority", threadAudioPriority_, -1);
+  visitor("Threads", "PowerProfileProjection", threadPowerProfileProjection_,
+          "performance");
+  visitor("Threads", "PowerProfileIdle", threadPowerProfileIdle_, "default");
+  visitor("Threads", "PowerDevfreqDevices", threadPowerDevfreqDevices_,
+          "dmc,vdec,vpu");
+  visitor("Threads", "StrandMonitor", threadStrandMonitor_, false);
+  visitor("Threads", "StrandLongTaskMs", threadStrandLongTaskMs_, 20);
+
+  visitor("Sensors", "CanInterface", sensorCanInterface_, "");
+  visitor("Sensors", "CanSignals", sensorCanSignals_, "");
+  visitor("Sensors", "ObdDevice", sensorObdDevice_, "");
+  visitor("Sensors", "IioDevice", sensorIioDevice_, "");
+  visitor("Sensors", "LightDevice", sensorLightDevice_, "");
+  visitor("Sensors", "LightNightLux", sensorLightNightLux_, 10);
+  visitor("Sensors", "LightDayLux", sensorLightDayLux_, 30);
+  visitor("Sensors", "LightBacklight", sensorLightBacklight_, "");
+  visitor("Sensors", "GpsNightMode", sensorGpsNightMode_, false);
+  visitor("Sensors", "RestrictWhileMoving", sensorRestrictWhileMoving_, false);
+
+  visitor("Metrics", "HttpPort", metricsHttpPort_, 0);
+  visitor("Metrics", "StatsdTarget", metricsStatsdTarget_, "");
+  visitor("Metrics", "Overlay", metricsOverlay_, false);
+
+  visitor("Input", "TouchscreenEnabled", enableTouchscreen_, true);
+  visitor("Input", "PlayerButtonControl", enablePlayerControl_, false);
+  visitor("Input", "Buttons", buttonCodes_, ButtonCodes());
+  visitor("Input", "TouchCoalesceMs", touchCoalesceMs_, -1);
+  visitor("Input", "TouchPredictionMs", touchPredictionMs_, 0);
+  visitor("Input", "TouchscreenDevice", touchscreenDevice_, "");
+  visitor("Input", "KeyDevices", keyDevices_, "");
+  visitor("Input", "KeyMap", keyMap_, "");
+  visitor("Input", "RotaryAccelerationDetents", rotaryAccelerationDetents_, 0);
+
+  visitor("Bluetooth", "AdapterType", bluetoothAdapterType_,
+          BluetoothAdapterType::LOCAL);
+  visitor("Bluetooth", "AdapterAddress", bluetoothAdapterAddress_, "");
+
+  visitor("Wireless", "WirelessEnabled", wirelessProjectionEnabled_, false);
+  visitor("Wireless", "TcpNoDelay", wirelessTcpNoDelay_, true);
+  visitor("Wireless", "TcpReceiveBufferKb", wirelessTcpReceiveBufferKb_, 1024);
+  visitor("Wireless", "TcpSendBufferKb", wirelessTcpSendBufferKb_, 512);
+  visitor("Wireless", "TcpQuickAck", wirelessTcpQuickAck_, true);
+  visitor("Wireless", "TcpDscp", wirelessTcpDscp_, 34);
+  visitor("Wireless", "TcpBusyPollUs", wirelessTcpBusyPollUs_, 0);
+  visitor("Wireless", "TcpLinkStats", wirelessTcpLinkStats_, true);
+  visitor("Wireless", "HotspotInterface", wirelessHotspotInterface_, "wlan0");
+  visitor("Wireless", "HotspotAutoChannel", wirelessHotspotAutoChannel_, true);
+  visitor("Wireless", "HotspotChannelWidthMhz", wirelessHotspotChannelWidthMhz_, 80);
+  visitor("Wireless", "HotspotPowerSaveOff", wirelessHotspotPowerSaveOff_, true);
+
+  visitor("Media", "Mp3MasterPath", mp3MasterPath_, "/home/pi/Music/");
+  visitor("Media", "Mp3SubFolder", mp3SubFolder_, "Music/");
+  visitor("Media", "Mp3Track", mp3Track_, 0);
+  visitor("Media", "Mp3AutoPlay", mp3AutoPlay_, false);
+  visitor("Media", "ShowAutoPlay", showAutoPlay_, false);
+  visitor("Media", "InstantPlay", instantPlay_, false);
+  visitor("Media", "PlayerReplayGain", playerReplayGain_, true);
+}
+
+Configuration::Configuration() : nextSubscription_(0) { this->load(); }
+
+Configuration::~Configuration() { DeferredWriter::instance().flush(); }
 
 void Configuration::load() {
-  boost::property_tree::ptree iniConfig;
-
-  try {
-    boost::property_tree::ini_parser::read_ini(cConfigFileName, iniConfig);
-
-    handednessOfTrafficType_ =
-        static_cast<HandednessOfTrafficType>(iniConfig.get<uint32_t>(
-            cGeneralHandednessOfTrafficTypeKey,
-            static_cast<uint32_t>(HandednessOfTrafficType::LEFT_HAND_DRIVE)));
-    showClock_ = iniConfig.get<bool>(cGeneralShowClockKey, true);
-    showBigClock_ = iniConfig.get<bool>(cGeneralShowBigClockKey, false);
-    oldGUI_ = iniConfig.get<bool>(cGeneralOldGUIKey, false);
-    alphaTrans_ = iniConfig.get<size_t>(cGeneralAlphaTransKey, 50);
-    hideMenuToggle_ = iniConfig.get<bool>(cGeneralHideMenuToggleKey, false);
-    hideAlpha_ = iniConfig.get<bool>(cGeneralHideAlphaKey, false);
-    showLux_ = iniConfig.get<bool>(cGeneralShowLuxKey, false);
-    showCursor_ = iniConfig.get<bool>(cGeneralShowCursorKey, true);
-    hideBrightnessControl_ =
-        iniConfig.get<bool>(cGeneralHideBrightnessControlKey, false);
-  } catch (const std::exception &e) {
-    OPENAUTO_LOG(warning)
-        << "[Configuration] Failed to load INI configuration from boost: "
-        << e.what();
+  // A save still in flight is what this has to read back
+  DeferredWriter::instance().flush();
+  ConfigurationValues values{};
+  if (this->loadSnapshot(values)) {
+    this->publish(std::move(values));
+    this->notifySubscribers();
+    return;
   }
 
   QSettings settings(QString::fromStdString(cConfigFileName),
                      QSettings::IniFormat);
+  IniReader reader(settings);
+  values.describe(reader);
+
+  // Older files store the margins as two sizes
+  if (settings.contains("Video/MarginHeight") ||
+      settings.contains("Video/MarginWidth")) {
+    int h = settings.value("Video/MarginHeight", 0).toInt();
+    int w = settings.value("Video/MarginWidth", 0).toInt();
+    values.videoMargins_ = QRect(w, h, w, h);
+  }
+  if (settings.status() != QSettings::NoError) {
+    OPENAUTO_LOG(warning) << "[Configuration] Could not parse "
+                          << cConfigFileName << ", using defaults";
+  }
 
-  settings.beginGroup("Video");
-  videoFPS_ = static_cast<
-      aap_protobuf::service::media::sink::message::VideoFrameRateType>(
-      settings
-          .value("FPS",
-                 static_cast<int>(aap_protobuf::service::media::sink::message::
-                                      VideoFrameRateType::VIDEO_FPS_60))
-          .toInt());
-  videoResolution_ = static_cast<
-      aap_protobuf::service::media::sink::message::VideoCodecResolutionType>(
-      settings
-          .value("Resolution",
-                 static_cast<int>(aap_protobuf::service::media::sink::message::
-                                      VideoCodecResolutionType::VIDEO_800x480))
-          .toInt());
-  screenDPI_ = settings.value("DPI", 160).toUInt();
-  omxLayerIndex_ = settings.value("OMXLayerIndex", 2).toInt();
-  if (settings.contains("MarginHeight") || settings.contains("MarginWidth")) {
-    int h = settings.value("MarginHeight", 0).toInt();
-    int w = settings.value("MarginWidth", 0).toInt();
-    videoMargins_ = QRect(w, h, w, h);
-  } else {
-    videoMargins_ = settings.value("Margins", QRect(0, 0, 0, 0)).toRect();
-  }
-  settings.endGroup();
-
-  settings.beginGroup("General");
-  showClock_ = settings.value("ShowClock", false).toBool();
-  showBigClock_ = settings.value("ShowBigClock", false).toBool();
-  oldGUI_ = settings.value("OldGUI", false).toBool();
-  alphaTrans_ = settings.value("AlphaTrans", 200).toInt();
-  hideMenuToggle_ = settings.value("HideMenuToggle", false).toBool();
-  hideAlpha_ = settings.value("HideAlpha", false).toBool();
-  showLux_ = settings.value("ShowLux", false).toBool();
-  showCursor_ = settings.value("ShowCursor", true).toBool();
-  hideBrightnessControl_ =
-      settings.value("HideBrightnessControl", false).toBool();
-  showNetworkinfo_ = settings.value("ShowNetworkinfo", false).toBool();
-  hideWarning_ = settings.value("HideWarning", false).toBool();
-  handednessOfTrafficType_ = static_cast<HandednessOfTrafficType>(
-      settings
-          .value("HandednessOfTraffic",
-                 static_cast<int>(HandednessOfTrafficType::RIGHT_HAND_DRIVE))
-          .toInt());
-  settings.endGroup();
-
-  settings.beginGroup("Audio");
-  _audioChannelEnabledMedia =
-      settings.value("MusicAudioChannelEnabled", true).toBool();
-  _audioChannelEnabledGuidance =
-      settings.value("GuidanceAudioChannelEnabled", true).toBool();
-  _audioChannelEnabledSystem =
-      settings.value("SystemAudioChannelEnabled", true).toBool();
-  _audioChannelEnabledTelephony =
-      settings.value("TelephonyAudioChannelEnabled", false).toBool();
-  audioOutputDeviceName_ =
-      settings.value("AudioOutputDeviceName", "").toString().toStdString();
-  audioInputDeviceName_ =
-      settings.value("AudioInputDeviceName", "").toString().toStdString();
-  settings.endGroup();
-
-  settings.beginGroup("Input");
-  enableTouchscreen_ = settings.value("TouchscreenEnabled", true).toBool();
-  enablePlayerControl_ = settings.value("PlayerButtonControl", false).toBool();
-
-  int size = settings.beginReadArray("Buttons");
-  for (int i = 0; i < size; ++i) {
-    settings.setArrayIndex(i);
-    buttonCodes_.push_back(
-        static_cast<aap_protobuf::service::media::sink::message::KeyCode>(
-            settings.value("KeyCode").toInt()));
-  }
-  settings.endArray();
-  settings.endGroup();
-
-  settings.beginGroup("Bluetooth");
-  bluetoothAdapterType_ = static_cast<BluetoothAdapterType>(
-      settings
-          .value("AdapterType", static_cast<int>(BluetoothAdapterType::LOCAL))
-          .toInt());
-  bluetoothAdapterAddress_ =
-      settings.value("AdapterAddress", "").toString().toStdString();
-  settings.endGroup();
-
-  settings.beginGroup("Wireless");
-  wirelessProjectionEnabled_ =
-      settings.value("WirelessEnabled", false).toBool();
-  settings.endGroup();
-
-  settings.beginGroup("Media");
-  mp3MasterPath_ = settings.value("Mp3MasterPath", "/home/pi/Music/")
-                       .toString()
-                       .toStdString();
-  mp3SubFolder_ =
-      settings.value("Mp3SubFolder", "Music/").toString().toStdString();
-  mp3Track_ = settings.value("Mp3Track", 0).toInt();
-  mp3AutoPlay_ = settings.value("Mp3AutoPlay", false).toBool();
-  showAutoPlay_ = settings.value("ShowAutoPlay", false).toBool();
-  instantPlay_ = settings.value("InstantPlay", false).toBool();
-  settings.endGroup();
+  this->publish(values);
+  this->notifySubscribers();
+
+  // Taken off the boot path: the next start reads the snapshot instead
+  DeferredWriter::instance().schedule(
+      [values]() mutable { writeFiles(values, false); });
+}
+
+bool Configuration::loadSnapshot(ConfigurationValues &values) const {
+  std::ifstream in(cSnapshotFileName, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  const std::string data((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+
+  SnapshotReader header(data.data(), data.size());
+  uint32_t magic = 0, version = 0, payloadSize = 0;
+  uint64_t signature = 0, payloadHash = 0;
+  FileIdentity source;
+  if (!header.get(magic) || !header.get(version) || !header.get(signature) ||
+      !header.get(source.size) || !header.get(source.modifiedNs) ||
+      !header.get(payloadSize) || !header.get(payloadHash) ||
+      magic != cSnapshotMagic || version != cSnapshotVersion ||
+      signature != schemaSignature() || payloadSize > data.size()) {
+    return false;
+  }
+
+  const FileIdentity ini = FileIdentity::of(cConfigFileName);
+  if (ini.size != source.size || ini.modifiedNs != source.modifiedNs) {
+    // Edited by hand since: the INI wins
+    return false;
+  }
+
+  const char *payload = data.data() + data.size() - payloadSize;
+  if (fnv1a(payload, payloadSize) != payloadHash) {
+    OPENAUTO_LOG(warning) << "[Configuration] Ignoring corrupt "
+                          << cSnapshotFileName;
+    return false;
+  }
+
+  SnapshotReader reader(payload, payloadSize);
+  values.describe(reader);
+  return reader.complete();
+}
+
+void Configuration::writeFiles(ConfigurationValues &values, bool ini) {
+  if (ini) {
+    QSettings settings(QString::fromStdString(cConfigFileName),
+                       QSettings::IniFormat);
+    // Written to a temporary file and renamed over the old one
+    settings.setAtomicSyncRequired(true);
+    IniWriter writer(settings);
+    values.describe(writer);
+    settings.sync();
+    if (settings.status() != QSettings::NoError) {
+      OPENAUTO_LOG(error) << "[Configuration] Could not write "
+                          << cConfigFileName;
+      return;
+    }
+  }
+
+  const FileIdentity source = FileIdentity::of(cConfigFileName);
+  if (source.size < 0) {
+    // Nothing on disk to tell a stale snapshot by
+    return;
+  }
+
+  std::string payload;
+  SnapshotWriter writer(payload);
+  values.describe(writer);
+
+  std::string data;
+  SnapshotWriter header(data);
+  header.put(cSnapshotMagic);
+  header.put(cSnapshotVersion);
+  header.put(schemaSignature());
+  header.put(source.size);
+  header.put(source.modifiedNs);
+  header.put(static_cast<uint32_t>(payload.size()));
+  header.put(fnv1a(payload.data(), payload.size()));
+  data.append(payload);
+
+  QSaveFile out(QString::fromStdString(cSnapshotFileName));
+  if (!out.open(QIODevice::WriteOnly) ||
+      out.write(data.data(), data.size()) != static_cast<qint64>(data.size()) ||
+      !out.commit()) {
+    OPENAUTO_LOG(warning) << "[Configuration] Could not write "
+                          << cSnapshotFileName;
+  }
 }
 
 void Configuration::reset() {
-  videoFPS_ = aap_protobuf::service::media::sink::message::VideoFrameRateType::
-      VIDEO_FPS_60;
-  videoResolution_ = aap_protobuf::service::media::sink::message::
-      VideoCodecResolutionType::VIDEO_800x480;
-  screenDPI_ = 160;
-  omxLayerIndex_ = 2;
-  videoMargins_ = QRect(0, 0, 0, 0);
-  handednessOfTrafficType_ = HandednessOfTrafficType::RIGHT_HAND_DRIVE;
-  enableTouchscreen_ = true;
-  bluetoothAdapterType_ = BluetoothAdapterType::LOCAL;
-  bluetoothAdapterAddress_ = "";
-  wirelessProjectionEnabled_ = false;
-  _audioChannelEnabledMedia = true;
-  _audioChannelEnabledGuidance = true;
-  _audioChannelEnabledSystem = true;
-  _audioChannelEnabledTelephony = false;
-  buttonCodes_.clear();
-  showClock_ = false;
-  showBigClock_ = false;
-  oldGUI_ = false;
-  alphaTrans_ = 200;
-  hideMenuToggle_ = false;
-  hideAlpha_ = false;
-  showLux_ = false;
-  showCursor_ = true;
-  hideBrightnessControl_ = false;
-  showNetworkinfo_ = false;
-  hideWarning_ = false;
-  mp3MasterPath_ = "/home/pi/Music/";
-  mp3SubFolder_ = "Music/";
-  mp3Track_ = 0;
-  mp3AutoPlay_ = false;
-  showAutoPlay_ = false;
-  instantPlay_ = false;
-  audioOutputDeviceName_ = "";
-  audioInputDeviceName_ = "";
+  ConfigurationValues values{};
+  DefaultsWriter defaults;
+  values.describe(defaults);
+  this->publish(std::move(values));
+  this->notifySubscribers();
 }
 
 void Configuration::save() {
-  QSettings settings(QString::fromStdString(cConfigFileName),
-                     QSettings::IniFormat);
+  ConfigurationValues values = *this->current();
+  DeferredWriter::instance().schedule(
+      [values]() mutable { writeFiles(values, true); });
+  this->notifySubscribers();
+}
+
+size_t Configuration::subscribe(ChangeHandler handler) {
+  std::lock_guard<std::mutex> lock(subscribersMutex_);
+  subscribers_.emplace_back(++nextSubscription_, std::move(handler));
+  return nextSubscription_;
+}
 
-  settings.beginGroup("Video");
-  settings.setValue("FPS", static_cast<int>(videoFPS_));
-  settings.setValue("Resolution", static_cast<int>(videoResolution_));
-  settings.setValue("DPI", static_cast<unsigned int>(screenDPI_));
-  settings.setValue("OMXLayerIndex", static_cast<int>(omxLayerIndex_));
-  settings.setValue("Margins", videoMargins_);
-  settings.endGroup();
-
-  settings.beginGroup("General");
-  settings.setValue("HandednessOfTraffic",
-                    static_cast<int>(handednessOfTrafficType_));
-  settings.setValue("ShowClock", showClock_);
-  settings.setValue("ShowBigClock", showBigClock_);
-  settings.setValue("OldGUI", oldGUI_);
-  settings.setValue("AlphaTrans", static_cast<int>(alphaTrans_));
-  settings.setValue("HideMenuToggle", hideMenuToggle_);
-  settings.setValue("HideAlpha", hideAlpha_);
-  settings.setValue("ShowLux", showLux_);
-  settings.setValue("ShowCursor", showCursor_);
-  settings.setValue("HideBrightnessControl", hideBrightnessControl_);
-  settings.setValue("ShowNetworkinfo", showNetworkinfo_);
-  settings.setValue("HideWarning", hideWarning_);
-  settings.endGroup();
-
-  settings.beginGroup("Audio");
-  settings.setValue("MusicAudioChannelEnabled", _audioChannelEnabledMedia);
-  settings.setValue("GuidanceAudioChannelEnabled",
-                    _audioChannelEnabledGuidance);
-  settings.setValue("SystemAudioChannelEnabled", _audioChannelEnabledSystem);
-  settings.setValue("TelephonyAudioChannelEnabled",
-                    _audioChannelEnabledTelephony);
-  settings.setValue("AudioOutputDeviceName",
-                    QString::fromStdString(audioOutputDeviceName_));
-  settings.setValue("AudioInputDeviceName",
-                    QString::fromStdString(audioInputDeviceName_));
-  settings.endGroup();
-
-  settings.beginGroup("Input");
-  settings.setValue("TouchscreenEnabled", enableTouchscreen_);
-  settings.setValue("PlayerButtonControl", enablePlayerControl_);
-  settings.beginWriteArray("Buttons");
-  for (unsigned int i = 0; i < buttonCodes_.size(); ++i) {
-    settings.setArrayIndex(i);
-    settings.setValue("KeyCode", static_cast<int>(buttonCodes_[i]));
-  }
-  settings.endArray();
-  settings.endGroup();
-
-  settings.beginGroup("Bluetooth");
-  settings.setValue("AdapterType", static_cast<int>(bluetoothAdapterType_));
-  settings.setValue("AdapterAddress",
-                    QString::fromStdString(bluetoothAdapterAddress_));
-  settings.endGroup();
-
-  settings.beginGroup("Wireless");
-  settings.setValue("WirelessEnabled", wirelessProjectionEnabled_);
-  settings.endGroup();
-
-  settings.beginGroup("Media");
-  settings.setValue("Mp3MasterPath", QString::fromStdString(mp3MasterPath_));
-  settings.setValue("Mp3SubFolder", QString::fromStdString(mp3SubFolder_));
-  settings.setValue("Mp3Track", mp3Track_);
-  settings.setValue("Mp3AutoPlay", mp3AutoPlay_);
-  settings.setValue("ShowAutoPlay", showAutoPlay_);
-  settings.setValue("InstantPlay", instantPlay_);
-  settings.endGroup();
+void Configuration::unsubscribe(size_t subscription) {
+  std::lock_guard<std::mutex> lock(subscribersMutex_);
+  subscribers_.erase(
+      std::remove_if(subscribers_.begin(), subscribers_.end(),
+                     [subscription](const auto &subscriber) {
+                       return subscriber.first == subscription;
+                     }),
+      subscribers_.end());
+}
+
+Configuration::Snapshot Configuration::current() const {
+  return std::atomic_load(&current_);
+}
+
+template <typename T, typename V>
+void Configuration::set(T ConfigurationValues::*field, V &&value) {
+  std::lock_guard<std::mutex> lock(updateMutex_);
+  auto next = std::make_shared<ConfigurationValues>(*this->current());
+  (*next).*field = std::forward<V>(value);
+  std::atomic_store(&current_, Snapshot(std::move(next)));
+}
+
+void Configuration::publish(ConfigurationValues values) {
+  std::lock_guard<std::mutex> lock(updateMutex_);
+  std::atomic_store(&current_, Snapshot(std::make_shared<ConfigurationValues>(
+                                   std::move(values))));
+}
+
+void Configuration::notifySubscribers() {
+  std::vector<ChangeHandler> handlers;
+  {
+    std::lock_guard<std::mutex> lock(subscribersMutex_);
+    for (const auto &subscriber : subscribers_) {
+      handlers.push_back(subscriber.second);
+    }
+  }
+  // Outside the lock: a handler may unsubscribe itself
+  for (const auto &handler : handlers) {
+    handler();
+  }
 }
 
 bool Configuration::hasTouchScreen() const {
@@ -370,212 +806,932 @@ bool Configuration::hasTouchScreen() const {
 }
 
 void Configuration::setHandednessOfTrafficType(HandednessOfTrafficType value) {
-  handednessOfTrafficType_ = value;
+  set(&ConfigurationValues::handednessOfTrafficType_, value);
 }
 
 HandednessOfTrafficType Configuration::getHandednessOfTrafficType() const {
-  return handednessOfTrafficType_;
+  return current()->handednessOfTrafficType_;
 }
 
-void Configuration::showClock(bool value) { showClock_ = value; }
+void Configuration::showClock(bool value) {
+  set(&ConfigurationValues::showClock_, value);
+}
 
-bool Configuration::showClock() const { return showClock_; }
+bool Configuration::showClock() const { return current()->showClock_; }
 
-void Configuration::showBigClock(bool value) { showBigClock_ = value; }
+void Configuration::showBigClock(bool value) {
+  set(&ConfigurationValues::showBigClock_, value);
+}
 
-bool Configuration::showBigClock() const { return showBigClock_; }
+bool Configuration::showBigClock() const { return current()->showBigClock_; }
 
-void Configuration::oldGUI(bool value) { oldGUI_ = value; }
+void Configuration::oldGUI(bool value) {
+  set(&ConfigurationValues::oldGUI_, value);
+}
 
-bool Configuration::oldGUI() const { return oldGUI_; }
+bool Configuration::oldGUI() const { return current()->oldGUI_; }
 
-size_t Configuration::getAlphaTrans() const { return alphaTrans_; }
+size_t Configuration::getAlphaTrans() const { return current()->alphaTrans_; }
 
-void Configuration::setAlphaTrans(size_t value) { alphaTrans_ = value; }
+void Configuration::setAlphaTrans(size_t value) {
+  set(&ConfigurationValues::alphaTrans_, value);
+}
 
-void Configuration::hideMenuToggle(bool value) { hideMenuToggle_ = value; }
+void Configuration::hideMenuToggle(bool value) {
+  set(&ConfigurationValues::hideMenuToggle_, value);
+}
 
-bool Configuration::hideMenuToggle() const { return hideMenuToggle_; }
+bool Configuration::hideMenuToggle() const {
+  return current()->hideMenuToggle_;
+}
 
-void Configuration::hideAlpha(bool value) { hideAlpha_ = value; }
+void Configuration::hideAlpha(bool value) {
+  set(&ConfigurationValues::hideAlpha_, value);
+}
 
-bool Configuration::hideAlpha() const { return hideAlpha_; }
+bool Configuration::hideAlpha() const { return current()->hideAlpha_; }
 
-void Configuration::showLux(bool value) { showLux_ = value; }
+void Configuration::showLux(bool value) {
+  set(&ConfigurationValues::showLux_, value);
+}
 
-bool Configuration::showLux() const { return showLux_; }
+bool Configuration::showLux() const { return current()->showLux_; }
 
-void Configuration::showCursor(bool value) { showCursor_ = value; }
+void Configuration::showCursor(bool value) {
+  set(&ConfigurationValues::showCursor_, value);
+}
 
-bool Configuration::showCursor() const { return showCursor_; }
+bool Configuration::showCursor() const { return current()->showCursor_; }
 
 void Configuration::hideBrightnessControl(bool value) {
-  hideBrightnessControl_ = value;
+  set(&ConfigurationValues::hideBrightnessControl_, value);
 }
 
 bool Configuration::hideBrightnessControl() const {
-  return hideBrightnessControl_;
+  return current()->hideBrightnessControl_;
 }
 
-void Configuration::hideWarning(bool value) { hideWarning_ = value; }
+void Configuration::hideWarning(bool value) {
+  set(&ConfigurationValues::hideWarning_, value);
+}
 
-bool Configuration::hideWarning() const { return hideWarning_; }
+bool Configuration::hideWarning() const { return current()->hideWarning_; }
 
-void Configuration::showNetworkinfo(bool value) { showNetworkinfo_ = value; }
+void Configuration::showNetworkinfo(bool value) {
+  set(&ConfigurationValues::showNetworkinfo_, value);
+}
 
-bool Configuration::showNetworkinfo() const { return showNetworkinfo_; }
+bool Configuration::showNetworkinfo() const {
+  return current()->showNetworkinfo_;
+}
 
-std::string Configuration::getMp3MasterPath() const { return mp3MasterPath_; }
+std::string Configuration::getMp3MasterPath() const {
+  return current()->mp3MasterPath_;
+}
 
 void Configuration::setMp3MasterPath(const std::string &value) {
-  mp3MasterPath_ = value;
+  set(&ConfigurationValues::mp3MasterPath_, value);
 }
 
-std::string Configuration::getMp3SubFolder() const { return mp3SubFolder_; }
+std::string Configuration::getMp3SubFolder() const {
+  return current()->mp3SubFolder_;
+}
 
-void Configuration::setMp3Track(int32_t value) { mp3Track_ = value; }
+void Configuration::setMp3Track(int32_t value) {
+  set(&ConfigurationValues::mp3Track_, value);
+}
 
 void Configuration::setMp3SubFolder(const std::string &value) {
-  mp3SubFolder_ = value;
+  set(&ConfigurationValues::mp3SubFolder_, value);
 }
 
-int32_t Configuration::getMp3Track() const { return mp3Track_; }
+int32_t Configuration::getMp3Track() const { return current()->mp3Track_; }
 
-void Configuration::mp3AutoPlay(bool value) { mp3AutoPlay_ = value; }
+void Configuration::mp3AutoPlay(bool value) {
+  set(&ConfigurationValues::mp3AutoPlay_, value);
+}
 
-bool Configuration::mp3AutoPlay() const { return mp3AutoPlay_; }
+bool Configuration::mp3AutoPlay() const { return current()->mp3AutoPlay_; }
 
-void Configuration::showAutoPlay(bool value) { showAutoPlay_ = value; }
+void Configuration::showAutoPlay(bool value) {
+  set(&ConfigurationValues::showAutoPlay_, value);
+}
 
-bool Configuration::showAutoPlay() const { return showAutoPlay_; }
+bool Configuration::showAutoPlay() const { return current()->showAutoPlay_; }
 
-void Configuration::instantPlay(bool value) { instantPlay_ = value; }
+void Configuration::instantPlay(bool value) {
+  set(&ConfigurationValues::instantPlay_, value);
+}
 
-bool Configuration::instantPlay() const { return instantPlay_; }
+bool Configuration::instantPlay() const { return current()->instantPlay_; }
 
 aap_protobuf::service::media::sink::message::VideoFrameRateType
 Configuration::getVideoFPS() const {
-  return videoFPS_;
+  return current()->videoFPS_;
 }
 
 void Configuration::setVideoFPS(
     aap_protobuf::service::media::sink::message::VideoFrameRateType value) {
-  videoFPS_ = value;
+  set(&ConfigurationValues::videoFPS_, value);
 }
 
 aap_protobuf::service::media::sink::message::VideoCodecResolutionType
 Configuration::getVideoResolution() const {
-  return videoResolution_;
+  return current()->videoResolution_;
 }
 
 void Configuration::setVideoResolution(
     aap_protobuf::service::media::sink::message::VideoCodecResolutionType
         value) {
-  videoResolution_ = value;
+  set(&ConfigurationValues::videoResolution_, value);
 }
 
-size_t Configuration::getScreenDPI() const { return screenDPI_; }
+size_t Configuration::getScreenDPI() const { return current()->screenDPI_; }
 
-void Configuration::setScreenDPI(size_t value) { screenDPI_ = value; }
+void Configuration::setScreenDPI(size_t value) {
+  set(&ConfigurationValues::screenDPI_, value);
+}
 
-void Configuration::setOMXLayerIndex(int32_t value) { omxLayerIndex_ = value; }
+void Configuration::setOMXLayerIndex(int32_t value) {
+  set(&ConfigurationValues::omxLayerIndex_, value);
+}
 
-int32_t Configuration::getOMXLayerIndex() const { return omxLayerIndex_; }
+int32_t Configuration::getOMXLayerIndex() const {
+  return current()->omxLayerIndex_;
+}
 
-void Configuration::setVideoMargins(QRect value) { videoMargins_ = value; }
+void Configuration::setVideoMargins(QRect value) {
+  set(&ConfigurationValues::videoMargins_, value);
+}
 
-QRect Configuration::getVideoMargins() const { return videoMargins_; }
+QRect Configuration::getVideoMargins() const {
+  return current()->videoMargins_;
+}
 
-bool Configuration::getTouchscreenEnabled() const { return enableTouchscreen_; }
+bool Configuration::getTouchscreenEnabled() const {
+  return current()->enableTouchscreen_;
+}
 
 void Configuration::setTouchscreenEnabled(bool value) {
-  enableTouchscreen_ = value;
+  set(&ConfigurationValues::enableTouchscreen_, value);
 }
 
-bool Configuration::playerButtonControl() const { return enablePlayerControl_; }
+bool Configuration::playerButtonControl() const {
+  return current()->enablePlayerControl_;
+}
 
 void Configuration::playerButtonControl(bool value) {
-  enablePlayerControl_ = value;
+  set(&ConfigurationValues::enablePlayerControl_, value);
 }
 
 Configuration::ButtonCodes Configuration::getButtonCodes() const {
-  return buttonCodes_;
+  return current()->buttonCodes_;
 }
 
 void Configuration::setButtonCodes(const ButtonCodes &value) {
-  buttonCodes_ = value;
+  set(&ConfigurationValues::buttonCodes_, value);
 }
 
 BluetoothAdapterType Configuration::getBluetoothAdapterType() const {
-  return bluetoothAdapterType_;
+  return current()->bluetoothAdapterType_;
 }
 
 void Configuration::setBluetoothAdapterType(BluetoothAdapterType value) {
-  bluetoothAdapterType_ = value;
+  set(&ConfigurationValues::bluetoothAdapterType_, value);
 }
 
 std::string Configuration::getBluetoothAdapterAddress() const {
-  return bluetoothAdapterAddress_;
+  return current()->bluetoothAdapterAddress_;
 }
 
 void Configuration::setBluetoothAdapterAddress(const std::string &value) {
-  bluetoothAdapterAddress_ = value;
+  set(&ConfigurationValues::bluetoothAdapterAddress_, value);
 }
 
 bool Configuration::getWirelessProjectionEnabled() const {
-  return wirelessProjectionEnabled_;
+  return current()->wirelessProjectionEnabled_;
 }
 
 void Configuration::setWirelessProjectionEnabled(bool value) {
-  wirelessProjectionEnabled_ = value;
+  set(&ConfigurationValues::wirelessProjectionEnabled_, value);
 }
 
 bool Configuration::musicAudioChannelEnabled() const {
-  return _audioChannelEnabledMedia;
+  return current()->_audioChannelEnabledMedia;
 }
 
 void Configuration::setMusicAudioChannelEnabled(bool value) {
-  _audioChannelEnabledMedia = value;
+  set(&ConfigurationValues::_audioChannelEnabledMedia, value);
 }
 
 bool Configuration::guidanceAudioChannelEnabled() const {
-  return _audioChannelEnabledGuidance;
+  return current()->_audioChannelEnabledGuidance;
 }
 
 void Configuration::setGuidanceAudioChannelEnabled(bool value) {
-  _audioChannelEnabledGuidance = value;
+  set(&ConfigurationValues::_audioChannelEnabledGuidance, value);
 }
 
 bool Configuration::systemAudioChannelEnabled() const {
-  return _audioChannelEnabledSystem;
+  return current()->_audioChannelEnabledSystem;
 }
 
 void Configuration::setSystemAudioChannelEnabled(bool value) {
-  _audioChannelEnabledSystem = value;
+  set(&ConfigurationValues::_audioChannelEnabledSystem, value);
 }
 
 bool Configuration::telephonyAudioChannelEnabled() const {
-  return _audioChannelEnabledTelephony;
+  return current()->_audioChannelEnabledTelephony;
 }
 
 void Configuration::setTelephonyAudioChannelEnabled(bool value) {
-  _audioChannelEnabledTelephony = value;
+  set(&ConfigurationValues::_audioChannelEnabledTelephony, value);
 }
 
 std::string Configuration::getAudioOutputDeviceName() const {
-  return audioOutputDeviceName_;
+  return current()->audioOutputDeviceName_;
 }
 
 void Configuration::setAudioOutputDeviceName(const std::string &value) {
-  audioOutputDeviceName_ = value;
+  set(&ConfigurationValues::audioOutputDeviceName_, value);
 }
 
 std::string Configuration::getAudioInputDeviceName() const {
-  return audioInputDeviceName_;
+  return current()->audioInputDeviceName_;
 }
 
 void Configuration::setAudioInputDeviceName(const std::string &value) {
-  audioInputDeviceName_ = value;
+  set(&ConfigurationValues::audioInputDeviceName_, value);
+}
+
+size_t Configuration::getVideoFrameQueueDepth() const {
+  return current()->videoFrameQueueDepth_;
+}
+
+void Configuration::setVideoFrameQueueDepth(size_t value) {
+  set(&ConfigurationValues::videoFrameQueueDepth_, value);
+}
+
+bool Configuration::getVideoAdaptiveMode() const {
+  return current()->videoAdaptiveMode_;
+}
+
+void Configuration::setVideoAdaptiveMode(bool value) {
+  set(&ConfigurationValues::videoAdaptiveMode_, value);
+}
+
+size_t Configuration::getVideoMaxUnacked() const {
+  return current()->videoMaxUnacked_;
+}
+
+void Configuration::setVideoMaxUnacked(size_t value) {
+  set(&ConfigurationValues::videoMaxUnacked_, value);
+}
+
+bool Configuration::getVideoCompositorImport() const {
+  return current()->videoCompositorImport_;
+}
+
+void Configuration::setVideoCompositorImport(bool value) {
+  set(&ConfigurationValues::videoCompositorImport_, value);
+}
+
+std::string Configuration::getSessionRecordingPath() const {
+  return current()->sessionRecordingPath_;
+}
+
+void Configuration::setSessionRecordingPath(const std::string &value) {
+  set(&ConfigurationValues::sessionRecordingPath_, value);
+}
+
+bool Configuration::getAudioLowLatency() const {
+  return current()->audioLowLatency_;
+}
+
+void Configuration::setAudioLowLatency(bool value) {
+  set(&ConfigurationValues::audioLowLatency_, value);
+}
+
+uint32_t Configuration::getAudioJitterBufferMs() const {
+  return current()->audioJitterBufferMs_;
+}
+
+void Configuration::setAudioJitterBufferMs(uint32_t value) {
+  set(&ConfigurationValues::audioJitterBufferMs_, value);
+}
+
+bool Configuration::getAudioMixerEnabled() const {
+  return current()->audioMixerEnabled_;
+}
+
+void Configuration::setAudioMixerEnabled(bool value) {
+  set(&ConfigurationValues::audioMixerEnabled_, value);
+}
+
+uint32_t Configuration::getAudioDuckingPercent() const {
+  return current()->audioDuckingPercent_;
+}
+
+void Configuration::setAudioDuckingPercent(uint32_t value) {
+  set(&ConfigurationValues::audioDuckingPercent_, value);
+}
+
+bool Configuration::getAudioVoiceProcessing() const {
+  return current()->audioVoiceProcessing_;
+}
+
+void Configuration::setAudioVoiceProcessing(bool value) {
+  set(&ConfigurationValues::audioVoiceProcessing_, value);
+}
+
+bool Configuration::getAudioVoiceProcessingLowCpu() const {
+  return current()->audioVoiceProcessingLowCpu_;
+}
+
+void Configuration::setAudioVoiceProcessingLowCpu(bool value) {
+  set(&ConfigurationValues::audioVoiceProcessingLowCpu_, value);
+}
+
+int32_t Configuration::getAudioVoiceProcessingCpu() const {
+  return current()->audioVoiceProcessingCpu_;
+}
+
+void Configuration::setAudioVoiceProcessingCpu(int32_t value) {
+  set(&ConfigurationValues::audioVoiceProcessingCpu_, value);
+}
+
+uint32_t Configuration::getThreadIoWorkers() const {
+  return current()->threadIoWorkers_;
+}
+
+void Configuration::setThreadIoWorkers(uint32_t value) {
+  set(&ConfigurationValues::threadIoWorkers_, value);
+}
+
+std::string Configuration::getThreadWorkerCpus() const {
+  return current()->threadWorkerCpus_;
+}
+
+void Configuration::setThreadWorkerCpus(const std::string &value) {
+  set(&ConfigurationValues::threadWorkerCpus_, value);
+}
+
+std::string Configuration::getThreadVideoCpus() const {
+  return current()->threadVideoCpus_;
+}
+
+void Configuration::setThreadVideoCpus(const std::string &value) {
+  set(&ConfigurationValues::threadVideoCpus_, value);
+}
+
+std::string Configuration::getThreadAudioCpus() const {
+  return current()->threadAudioCpus_;
+}
+
+void Configuration::setThreadAudioCpus(const std::string &value) {
+  set(&ConfigurationValues::threadAudioCpus_, value);
+}
+
+int32_t Configuration::getThreadVideoPriority() const {
+  return current()->threadVideoPriority_;
+}
+
+void Configuration::setThreadVideoPriority(int32_t value) {
+  set(&ConfigurationValues::threadVideoPriority_, value);
+}
+
+int32_t Configuration::getThreadAudioPriority() const {
+  return current()->threadAudioPriority_;
+}
+
+void Configuration::setThreadAudioPriority(int32_t value) {
+  set(&ConfigurationValues::threadAudioPriority_, value);
+}
+
+std::string Configuration::getSensorCanInterface() const {
+  return current()->sensorCanInterface_;
+}
+
+void Configuration::setSensorCanInterface(const std::string &value) {
+  set(&ConfigurationValues::sensorCanInterface_, value);
+}
+
+std::string Configuration::getSensorCanSignals() const {
+  return current()->sensorCanSignals_;
+}
+
+void Configuration::setSensorCanSignals(const std::string &value) {
+  set(&ConfigurationValues::sensorCanSignals_, value);
+}
+
+std::string Configuration::getSensorObdDevice() const {
+  return current()->sensorObdDevice_;
+}
+
+void Configuration::setSensorObdDevice(const std::string &value) {
+  set(&ConfigurationValues::sensorObdDevice_, value);
+}
+
+std::string Configuration::getSensorIioDevice() const {
+  return current()->sensorIioDevice_;
+}
+
+void Configuration::setSensorIioDevice(const std::string &value) {
+  set(&ConfigurationValues::sensorIioDevice_, value);
+}
+
+std::string Configuration::getSensorLightDevice() const {
+  return current()->sensorLightDevice_;
+}
+
+void Configuration::setSensorLightDevice(const std::string &value) {
+  set(&ConfigurationValues::sensorLightDevice_, value);
+}
+
+int32_t Configuration::getSensorLightNightLux() const {
+  return current()->sensorLightNightLux_;
+}
+
+void Configuration::setSensorLightNightLux(int32_t value) {
+  set(&ConfigurationValues::sensorLightNightLux_, value);
+}
+
+int32_t Configuration::getSensorLightDayLux() const {
+  return current()->sensorLightDayLux_;
+}
+
+void Configuration::setSensorLightDayLux(int32_t value) {
+  set(&ConfigurationValues::sensorLightDayLux_, value);
+}
+
+std::string Configuration::getSensorLightBacklight() const {
+  return current()->sensorLightBacklight_;
+}
+
+void Configuration::setSensorLightBacklight(const std::string &value) {
+  set(&ConfigurationValues::sensorLightBacklight_, value);
+}
+
+bool Configuration::getSensorGpsNightMode() const {
+  return current()->sensorGpsNightMode_;
+}
+
+void Configuration::setSensorGpsNightMode(bool value) {
+  set(&ConfigurationValues::sensorGpsNightMode_, value);
+}
+
+bool Configuration::getSensorRestrictWhileMoving() const {
+  return current()->sensorRestrictWhileMoving_;
+}
+
+void Configuration::setSensorRestrictWhileMoving(bool value) {
+  set(&ConfigurationValues::sensorRestrictWhileMoving_, value);
+}
+
+int32_t Configuration::getTouchCoalesceMs() const {
+  return current()->touchCoalesceMs_;
+}
+
+void Configuration::setTouchCoalesceMs(int32_t value) {
+  set(&ConfigurationValues::touchCoalesceMs_, value);
+}
+
+int32_t Configuration::getTouchPredictionMs() const {
+  return current()->touchPredictionMs_;
+}
+
+void Configuration::setTouchPredictionMs(int32_t value) {
+  set(&ConfigurationValues::touchPredictionMs_, value);
+}
+
+std::string Configuration::getTouchscreenDevice() const {
+  return current()->touchscreenDevice_;
+}
+
+void Configuration::setTouchscreenDevice(const std::string &value) {
+  set(&ConfigurationValues::touchscreenDevice_, value);
+}
+
+std::string Configuration::getKeyDevices() const {
+  return current()->keyDevices_;
+}
+
+void Configuration::setKeyDevices(const std::string &value) {
+  set(&ConfigurationValues::keyDevices_, value);
+}
+
+std::string Configuration::getKeyMap() const { return current()->keyMap_; }
+
+void Configuration::setKeyMap(const std::string &value) {
+  set(&ConfigurationValues::keyMap_, value);
+}
+
+uint32_t Configuration::getRotaryAccelerationDetents() const {
+  return current()->rotaryAccelerationDetents_;
+}
+
+void Configuration::setRotaryAccelerationDetents(uint32_t value) {
+  set(&ConfigurationValues::rotaryAccelerationDetents_, value);
+}
+
+uint32_t Configuration::getMetricsHttpPort() const {
+  return current()->metricsHttpPort_;
+}
+
+void Configuration::setMetricsHttpPort(uint32_t value) {
+  set(&ConfigurationValues::metricsHttpPort_, value);
+}
+
+std::string Configuration::getMetricsStatsdTarget() const {
+  return current()->metricsStatsdTarget_;
+}
+
+void Configuration::setMetricsStatsdTarget(const std::string &value) {
+  set(&ConfigurationValues::metricsStatsdTarget_, value);
+}
+
+bool Configuration::getMetricsOverlay() const {
+  return current()->metricsOverlay_;
+}
+
+void Configuration::setMetricsOverlay(bool value) {
+  set(&ConfigurationValues::metricsOverlay_, value);
+}
+
+bool Configuration::getTlsSessionResumption() const {
+  return current()->tlsSessionResumption_;
+}
+
+void Configuration::setTlsSessionResumption(bool value) {
+  set(&ConfigurationValues::tlsSessionResumption_, value);
+}
+
+std::string Configuration::getTlsCipherPreference() const {
+  return current()->tlsCipherPreference_;
+}
+
+void Configuration::setTlsCipherPreference(const std::string &value) {
+  set(&ConfigurationValues::tlsCipherPreference_, value);
+}
+
+bool Configuration::getUsbFastReconnect() const {
+  return current()->usbFastReconnect_;
+}
+
+void Configuration::setUsbFastReconnect(bool value) {
+  set(&ConfigurationValues::usbFastReconnect_, value);
+}
+
+uint32_t Configuration::getAudioAckBatch() const {
+  return current()->audioAckBatch_;
+}
+
+void Configuration::setAudioAckBatch(uint32_t value) {
+  set(&ConfigurationValues::audioAckBatch_, value);
+}
+
+bool Configuration::getAudioMediaAac() const {
+  return current()->audioMediaAac_;
+}
+
+void Configuration::setAudioMediaAac(bool value) {
+  set(&ConfigurationValues::audioMediaAac_, value);
+}
+
+uint32_t Configuration::getAudioMicPreRollMs() const {
+  return current()->audioMicPreRollMs_;
+}
+
+void Configuration::setAudioMicPreRollMs(uint32_t value) {
+  set(&ConfigurationValues::audioMicPreRollMs_, value);
+}
+
+std::string Configuration::getVideoBackend() const {
+  return current()->videoBackend_;
+}
+
+void Configuration::setVideoBackend(const std::string &value) {
+  set(&ConfigurationValues::videoBackend_, value);
+}
+
+std::string Configuration::getRearCameraDevice() const {
+  return current()->rearCameraDevice_;
+}
+
+void Configuration::setRearCameraDevice(const std::string &value) {
+  set(&ConfigurationValues::rearCameraDevice_, value);
+}
+
+bool Configuration::getRearCameraHotStandby() const {
+  return current()->rearCameraHotStandby_;
+}
+
+void Configuration::setRearCameraHotStandby(bool value) {
+  set(&ConfigurationValues::rearCameraHotStandby_, value);
+}
+
+bool Configuration::getRearCameraGuidelines() const {
+  return current()->rearCameraGuidelines_;
+}
+
+void Configuration::setRearCameraGuidelines(bool value) {
+  set(&ConfigurationValues::rearCameraGuidelines_, value);
+}
+
+bool Configuration::getDashcamEnabled() const {
+  return current()->dashcamEnabled_;
+}
+
+void Configuration::setDashcamEnabled(bool value) {
+  set(&ConfigurationValues::dashcamEnabled_, value);
+}
+
+std::string Configuration::getDashcamDirectory() const {
+  return current()->dashcamDirectory_;
+}
+
+void Configuration::setDashcamDirectory(const std::string &value) {
+  set(&ConfigurationValues::dashcamDirectory_, value);
+}
+
+uint32_t Configuration::getDashcamSegmentSeconds() const {
+  return current()->dashcamSegmentSeconds_;
+}
+
+void Configuration::setDashcamSegmentSeconds(uint32_t value) {
+  set(&ConfigurationValues::dashcamSegmentSeconds_, value);
+}
+
+uint32_t Configuration::getDashcamMaxDiskMb() const {
+  return current()->dashcamMaxDiskMb_;
+}
+
+void Configuration::setDashcamMaxDiskMb(uint32_t value) {
+  set(&ConfigurationValues::dashcamMaxDiskMb_, value);
+}
+
+uint32_t Configuration::getDashcamBitrateKbps() const {
+  return current()->dashcamBitrateKbps_;
+}
+
+void Configuration::setDashcamBitrateKbps(uint32_t value) {
+  set(&ConfigurationValues::dashcamBitrateKbps_, value);
+}
+
+std::string Configuration::getClusterOutput() const {
+  return current()->clusterOutput_;
+}
+
+void Configuration::setClusterOutput(const std::string &value) {
+  set(&ConfigurationValues::clusterOutput_, value);
+}
+
+std::string Configuration::getRadioDevice() const {
+  return current()->radioDevice_;
+}
+
+void Configuration::setRadioDevice(const std::string &value) {
+  set(&ConfigurationValues::radioDevice_, value);
+}
+
+std::string Configuration::getRadioAudioDevice() const {
+  return current()->radioAudioDevice_;
+}
+
+void Configuration::setRadioAudioDevice(const std::string &value) {
+  set(&ConfigurationValues::radioAudioDevice_, value);
+}
+
+std::string Configuration::getRadioRegion() const {
+  return current()->radioRegion_;
+}
+
+void Configuration::setRadioRegion(const std::string &value) {
+  set(&ConfigurationValues::radioRegion_, value);
+}
+
+bool Configuration::getAudioWarmStreams() const {
+  return current()->audioWarmStreams_;
+}
+
+void Configuration::setAudioWarmStreams(bool value) {
+  set(&ConfigurationValues::audioWarmStreams_, value);
+}
+
+bool Configuration::getAudioDspEnabled() const {
+  return current()->audioDspEnabled_;
+}
+
+void Configuration::setAudioDspEnabled(bool value) {
+  set(&ConfigurationValues::audioDspEnabled_, value);
+}
+
+std::string Configuration::getAudioEqualizerGains() const {
+  return current()->audioEqualizerGains_;
+}
+
+void Configuration::setAudioEqualizerGains(const std::string &value) {
+  set(&ConfigurationValues::audioEqualizerGains_, value);
+}
+
+uint32_t Configuration::getAudioLoudnessPercent() const {
+  return current()->audioLoudnessPercent_;
+}
+
+void Configuration::setAudioLoudnessPercent(uint32_t value) {
+  set(&ConfigurationValues::audioLoudnessPercent_, value);
+}
+
+uint32_t Configuration::getAudioDspCpuBudgetPercent() const {
+  return current()->audioDspCpuBudgetPercent_;
+}
+
+void Configuration::setAudioDspCpuBudgetPercent(uint32_t value) {
+  set(&ConfigurationValues::audioDspCpuBudgetPercent_, value);
+}
+
+bool Configuration::getPlayerReplayGain() const {
+  return current()->playerReplayGain_;
+}
+
+void Configuration::setPlayerReplayGain(bool value) {
+  set(&ConfigurationValues::playerReplayGain_, value);
+}
+
+int32_t Configuration::getVideoDisplayRotation() const {
+  return current()->videoDisplayRotation_;
+}
+
+void Configuration::setVideoDisplayRotation(int32_t value) {
+  set(&ConfigurationValues::videoDisplayRotation_, value);
+}
+
+bool Configuration::getVideoDisplayMirror() const {
+  return current()->videoDisplayMirror_;
+}
+
+void Configuration::setVideoDisplayMirror(bool value) {
+  set(&ConfigurationValues::videoDisplayMirror_, value);
+}
+
+std::string Configuration::getThreadPowerProfileProjection() const {
+  return current()->threadPowerProfileProjection_;
+}
+
+void Configuration::setThreadPowerProfileProjection(const std::string &value) {
+  set(&ConfigurationValues::threadPowerProfileProjection_, value);
+}
+
+std::string Configuration::getThreadPowerProfileIdle() const {
+  return current()->threadPowerProfileIdle_;
+}
+
+void Configuration::setThreadPowerProfileIdle(const std::string &value) {
+  set(&ConfigurationValues::threadPowerProfileIdle_, value);
+}
+
+std::string Configuration::getThreadPowerDevfreqDevices() const {
+  return current()->threadPowerDevfreqDevices_;
+}
+
+void Configuration::setThreadPowerDevfreqDevices(const std::string &value) {
+  set(&ConfigurationValues::threadPowerDevfreqDevices_, value);
+}
+
+bool Configuration::getThreadStrandMonitor() const {
+  return current()->threadStrandMonitor_;
+}
+
+void Configuration::setThreadStrandMonitor(bool value) {
+  set(&ConfigurationValues::threadStrandMonitor_, value);
+}
+
+int32_t Configuration::getThreadStrandLongTaskMs() const {
+  return current()->threadStrandLongTaskMs_;
+}
+
+void Configuration::setThreadStrandLongTaskMs(int32_t value) {
+  set(&ConfigurationValues::threadStrandLongTaskMs_, value);
+}
+
+bool Configuration::getWirelessTcpNoDelay() const {
+  return current()->wirelessTcpNoDelay_;
+}
+
+void Configuration::setWirelessTcpNoDelay(bool value) {
+  set(&ConfigurationValues::wirelessTcpNoDelay_, value);
+}
+
+int32_t Configuration::getWirelessTcpReceiveBufferKb() const {
+  return current()->wirelessTcpReceiveBufferKb_;
+}
+
+void Configuration::setWirelessTcpReceiveBufferKb(int32_t value) {
+  set(&ConfigurationValues::wirelessTcpReceiveBufferKb_, value);
+}
+
+int32_t Configuration::getWirelessTcpSendBufferKb() const {
+  return current()->wirelessTcpSendBufferKb_;
+}
+
+void Configuration::setWirelessTcpSendBufferKb(int32_t value) {
+  set(&ConfigurationValues::wirelessTcpSendBufferKb_, value);
+}
+
+bool Configuration::getWirelessTcpQuickAck() const {
+  return current()->wirelessTcpQuickAck_;
+}
+
+void Configuration::setWirelessTcpQuickAck(bool value) {
+  set(&ConfigurationValues::wirelessTcpQuickAck_, value);
+}
+
+int32_t Configuration::getWirelessTcpDscp() const {
+  return current()->wirelessTcpDscp_;
+}
+
+void Configuration::setWirelessTcpDscp(int32_t value) {
+  set(&ConfigurationValues::wirelessTcpDscp_, value);
+}
+
+int32_t Configuration::getWirelessTcpBusyPollUs() const {
+  return current()->wirelessTcpBusyPollUs_;
+}
+
+void Configuration::setWirelessTcpBusyPollUs(int32_t value) {
+  set(&ConfigurationValues::wirelessTcpBusyPollUs_, value);
+}
+
+bool Configuration::getWirelessTcpLinkStats() const {
+  return current()->wirelessTcpLinkStats_;
+}
+
+void Configuration::setWirelessTcpLinkStats(bool value) {
+  set(&ConfigurationValues::wirelessTcpLinkStats_, value);
+}
+
+std::string Configuration::getWirelessHotspotInterface() const {
+  return current()->wirelessHotspotInterface_;
+}
+
+void Configuration::setWirelessHotspotInterface(const std::string &value) {
+  set(&ConfigurationValues::wirelessHotspotInterface_, value);
+}
+
+bool Configuration::getWirelessHotspotAutoChannel() const {
+  return current()->wirelessHotspotAutoChannel_;
+}
+
+void Configuration::setWirelessHotspotAutoChannel(bool value) {
+  set(&ConfigurationValues::wirelessHotspotAutoChannel_, value);
+}
+
+int32_t Configuration::getWirelessHotspotChannelWidthMhz() const {
+  return current()->wirelessHotspotChannelWidthMhz_;
+}
+
+void Configuration::setWirelessHotspotChannelWidthMhz(int32_t value) {
+  set(&ConfigurationValues::wirelessHotspotChannelWidthMhz_, value);
+}
+
+bool Configuration::getWirelessHotspotPowerSaveOff() const {
+  return current()->wirelessHotspotPowerSaveOff_;
+}
+
+void Configuration::setWirelessHotspotPowerSaveOff(bool value) {
+  set(&ConfigurationValues::wirelessHotspotPowerSaveOff_, value);
+}
+
+int32_t Configuration::getUsbInTransfers() const {
+  return current()->usbInTransfers_;
+}
+
+void Configuration::setUsbInTransfers(int32_t value) {
+  set(&ConfigurationValues::usbInTransfers_, value);
+}
+
+int32_t Configuration::getUsbInTransferKb() const {
+  return current()->usbInTransferKb_;
+}
+
+void Configuration::setUsbInTransferKb(int32_t value) {
+  set(&ConfigurationValues::usbInTransferKb_, value);
+}
+
+bool Configuration::getOutboundPriority() const {
+  return current()->outboundPriority_;
+}
+
+void Configuration::setOutboundPriority(bool value) {
+  set(&ConfigurationValues::outboundPriority_, value);
+}
+
+bool Configuration::getMessageBufferPool() const {
+  return current()->messageBufferPool_;
+}
+
+void Configuration::setMessageBufferPool(bool value) {
+  set(&ConfigurationValues::messageBufferPool_, value);
 }
 
 QString Configuration::getCSValue(QString searchString) const {
@@ -713,157 +1869,4 @@ QString Configuration::readFileContent(QString fileName) const {
   }
 }
 
-void Configuration::readButtonCodes(boost::property_tree::ptree &iniConfig) {
-  this->insertButtonCode(
-      iniConfig, cInputPlayButtonKey,
-      aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_MEDIA_PLAY);
-  this->insertButtonCode(iniConfig, cInputPauseButtonKey,
-                         aap_protobuf::service::media::sink::message::KeyCode::
-                             KEYCODE_MEDIA_PAUSE);
-  this->insertButtonCode(iniConfig, cInputTogglePlayButtonKey,
-                         aap_protobuf::service::media::sink::message::KeyCode::
-                             KEYCODE_MEDIA_PLAY_PAUSE);
-  this->insertButtonCode(
-      iniConfig, cInputNextTrackButtonKey,
-      aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_MEDIA_NEXT);
-  this->insertButtonCode(iniConfig, cInputPreviousTrackButtonKey,
-                         aap_protobuf::service::media::sink::message::KeyCode::
-                             KEYCODE_MEDIA_PREVIOUS);
-  this->insertButtonCode(
-      iniConfig, cInputHomeButtonKey,
-      aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_HOME);
-  this->insertButtonCode(
-      iniConfig, cInputPhoneButtonKey,
-      aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_CALL);
-  this->insertButtonCode(
-      iniConfig, cInputCallEndButtonKey,
-      aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_ENDCALL);
-  this->insertButtonCode(
-      iniConfig, cInputVoiceCommandButtonKey,
-      aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_SEARCH);
-  this->insertButtonCode(
-      iniConfig, cInputLeftButtonKey,
-      aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_DPAD_LEFT);
-  this->insertButtonCode(
-      iniConfig, cInputRightButtonKey,
-      aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_DPAD_RIGHT);
-  this->insertButtonCode(
-      iniConfig, cInputUpButtonKey,
-      aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_DPAD_UP);
-  this->insertButtonCode(
-      iniConfig, cInputDownButtonKey,
-      aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_DPAD_DOWN);
-  this->insertButtonCode(iniConfig, cInputScrollWheelButtonKey,
-                         aap_protobuf::service::media::sink::message::KeyCode::
-                             KEYCODE_ROTARY_CONTROLLER);
-  this->insertButtonCode(
-      iniConfig, cInputBackButtonKey,
-      aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_BACK);
-  this->insertButtonCode(iniConfig, cInputEnterButtonKey,
-                         aap_protobuf::service::media::sink::message::KeyCode::
-                             KEYCODE_DPAD_CENTER);
-  this->insertButtonCode(
-      iniConfig, cInputNavButtonKey,
-      aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_NAVIGATION);
-}
-
-void Configuration::insertButtonCode(
-    boost::property_tree::ptree &iniConfig, const std::string &buttonCodeKey,
-    aap_protobuf::service::media::sink::message::KeyCode buttonCode) {
-  if (iniConfig.get<bool>(buttonCodeKey, false)) {
-    buttonCodes_.push_back(buttonCode);
-  }
-}
-
-void Configuration::writeButtonCodes(boost::property_tree::ptree &iniConfig) {
-  iniConfig.put<bool>(cInputPlayButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_MEDIA_PLAY) !=
-                          buttonCodes_.end());
-  iniConfig.put<bool>(cInputPauseButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_MEDIA_PAUSE) !=
-                          buttonCodes_.end());
-  iniConfig.put<bool>(cInputTogglePlayButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_MEDIA_PLAY_PAUSE) !=
-                          buttonCodes_.end());
-  iniConfig.put<bool>(cInputNextTrackButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_MEDIA_NEXT) !=
-                          buttonCodes_.end());
-  iniConfig.put<bool>(cInputPreviousTrackButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_MEDIA_PREVIOUS) !=
-                          buttonCodes_.end());
-  iniConfig.put<bool>(
-      cInputHomeButtonKey,
-      std::find(
-          buttonCodes_.begin(), buttonCodes_.end(),
-          aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_HOME) !=
-          buttonCodes_.end());
-  iniConfig.put<bool>(
-      cInputPhoneButtonKey,
-      std::find(
-          buttonCodes_.begin(), buttonCodes_.end(),
-          aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_CALL) !=
-          buttonCodes_.end());
-  iniConfig.put<bool>(cInputCallEndButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_ENDCALL) !=
-                          buttonCodes_.end());
-  iniConfig.put<bool>(cInputVoiceCommandButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_SEARCH) !=
-                          buttonCodes_.end());
-  iniConfig.put<bool>(cInputLeftButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_DPAD_LEFT) !=
-                          buttonCodes_.end());
-  iniConfig.put<bool>(cInputRightButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_DPAD_RIGHT) !=
-                          buttonCodes_.end());
-  iniConfig.put<bool>(cInputUpButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_DPAD_UP) !=
-                          buttonCodes_.end());
-  iniConfig.put<bool>(cInputDownButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_DPAD_DOWN) !=
-                          buttonCodes_.end());
-  iniConfig.put<bool>(cInputScrollWheelButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_ROTARY_CONTROLLER) !=
-                          buttonCodes_.end());
-  iniConfig.put<bool>(
-      cInputBackButtonKey,
-      std::find(
-          buttonCodes_.begin(), buttonCodes_.end(),
-          aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_BACK) !=
-          buttonCodes_.end());
-  iniConfig.put<bool>(cInputEnterButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_DPAD_CENTER) !=
-                          buttonCodes_.end());
-  iniConfig.put<bool>(cInputNavButtonKey,
-                      std::find(buttonCodes_.begin(), buttonCodes_.end(),
-                                aap_protobuf::service::media::sink::message::
-                                    KeyCode::KEYCODE_NAVIGATION) !=
-                          buttonCodes_.end());
-}
-
 } // namespace f1x::openauto::autoapp::configuration
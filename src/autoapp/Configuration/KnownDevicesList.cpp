@@ -0,0 +1,151 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <boost/property_tree/ini_parser.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Configuration/KnownDevicesList.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace configuration
+{
+
+const std::string KnownDevicesList::cConfigFileName = "openauto_usb_known.ini";
+const std::string KnownDevicesList::cKnownEntriesCount = "Known.EntriesCount";
+const std::string KnownDevicesList::cKnownEntryPrefix = "Known.Entry_";
+
+KnownDevicesList::KnownDevicesList(size_t maxListSize)
+    : maxListSize_(maxListSize)
+{
+
+}
+
+void KnownDevicesList::read()
+{
+    this->load();
+}
+
+void KnownDevicesList::insertDevice(const KnownDevice& device)
+{
+    if(device.serial.empty())
+    {
+        return;
+    }
+
+    KnownDevice entry = device;
+    auto it = std::find_if(list_.begin(), list_.end(), [&](const KnownDevice& known) { return known.serial == device.serial; });
+    if(it != list_.end())
+    {
+        entry.sessions = it->sessions + 1;
+        list_.erase(it);
+    }
+    else
+    {
+        entry.sessions = 1;
+        if(list_.size() >= maxListSize_)
+        {
+            list_.pop_back();
+        }
+    }
+
+    list_.push_front(entry);
+    this->save();
+}
+
+bool KnownDevicesList::contains(const std::string& serial) const
+{
+    return !serial.empty() &&
+           std::any_of(list_.begin(), list_.end(), [&](const KnownDevice& known) { return known.serial == serial; });
+}
+
+KnownDevicesList::KnownDevices KnownDevicesList::getList() const
+{
+    return list_;
+}
+
+void KnownDevicesList::load()
+{
+    boost::property_tree::ptree iniConfig;
+
+    try
+    {
+        boost::property_tree::ini_parser::read_ini(cConfigFileName, iniConfig);
+
+        const auto listSize = std::min(maxListSize_, iniConfig.get<size_t>(cKnownEntriesCount, 0));
+
+        for(size_t i = 0; i < listSize; ++i)
+        {
+            const auto prefix = cKnownEntryPrefix + std::to_string(i);
+            KnownDevice device;
+            device.vendorId = iniConfig.get<uint16_t>(prefix + "_VendorId", 0);
+            device.productId = iniConfig.get<uint16_t>(prefix + "_ProductId", 0);
+            device.serial = iniConfig.get<std::string>(prefix + "_Serial", std::string());
+            device.sessions = iniConfig.get<uint64_t>(prefix + "_Sessions", 0);
+
+            if(!device.serial.empty())
+            {
+                list_.push_back(device);
+            }
+        }
+    }
+    catch(const boost::property_tree::ptree_error& e)
+    {
+        OPENAUTO_LOG(warning) << "[KnownDevicesList] failed to read configuration file: " << cConfigFileName
+                            << ", error: " << e.what()
+                            << ". Empty list will be used.";
+    }
+}
+
+void KnownDevicesList::save()
+{
+    boost::property_tree::ptree iniConfig;
+
+    const auto entriesCount = std::min(maxListSize_, list_.size());
+    iniConfig.put<size_t>(cKnownEntriesCount, entriesCount);
+
+    for(size_t i = 0; i < entriesCount; ++i)
+    {
+        const auto prefix = cKnownEntryPrefix + std::to_string(i);
+        const auto& device = list_.at(i);
+        iniConfig.put<uint16_t>(prefix + "_VendorId", device.vendorId);
+        iniConfig.put<uint16_t>(prefix + "_ProductId", device.productId);
+        iniConfig.put<std::string>(prefix + "_Serial", device.serial);
+        iniConfig.put<uint64_t>(prefix + "_Sessions", device.sessions);
+    }
+
+    try
+    {
+        boost::property_tree::ini_parser::write_ini(cConfigFileName, iniConfig);
+    }
+    catch(const boost::property_tree::ini_parser_error& e)
+    {
+        OPENAUTO_LOG(warning) << "[KnownDevicesList] failed to write configuration file: " << cConfigFileName
+                            << ", error: " << e.what();
+    }
+}
+
+}
+}
+}
+}
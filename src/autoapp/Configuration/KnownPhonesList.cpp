@@ -0,0 +1,149 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <boost/property_tree/ini_parser.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Configuration/KnownPhonesList.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace configuration
+{
+
+const std::string KnownPhonesList::cConfigFileName = "openauto_bt_phones.ini";
+const std::string KnownPhonesList::cEntriesCount = "Phones.EntriesCount";
+const std::string KnownPhonesList::cEntryPrefix = "Phones.Entry_";
+
+KnownPhonesList::KnownPhonesList(size_t maxListSize)
+    : maxListSize_(maxListSize)
+{
+
+}
+
+void KnownPhonesList::read()
+{
+    this->load();
+}
+
+void KnownPhonesList::remember(const std::string& address, uint16_t channel)
+{
+    auto it = std::find_if(list_.begin(), list_.end(), [&](const KnownPhone& known) { return known.address == address; });
+    KnownPhone phone{address, channel};
+    if(it != list_.end())
+    {
+        if(channel == 0)
+        {
+            phone.channel = it->channel;
+        }
+        if(it == list_.begin() && it->channel == phone.channel)
+        {
+            return;
+        }
+        list_.erase(it);
+    }
+    else if(list_.size() >= maxListSize_)
+    {
+        list_.pop_back();
+    }
+
+    list_.push_front(phone);
+    this->save();
+}
+
+void KnownPhonesList::forgetChannel(const std::string& address)
+{
+    for(auto& phone : list_)
+    {
+        if(phone.address == address && phone.channel != 0)
+        {
+            phone.channel = 0;
+            this->save();
+            return;
+        }
+    }
+}
+
+KnownPhonesList::KnownPhones KnownPhonesList::getList() const
+{
+    return list_;
+}
+
+void KnownPhonesList::load()
+{
+    boost::property_tree::ptree iniConfig;
+
+    try
+    {
+        boost::property_tree::ini_parser::read_ini(cConfigFileName, iniConfig);
+
+        const auto listSize = std::min(maxListSize_, iniConfig.get<size_t>(cEntriesCount, 0));
+
+        for(size_t i = 0; i < listSize; ++i)
+        {
+            const auto prefix = cEntryPrefix + std::to_string(i);
+            KnownPhone phone;
+            phone.address = iniConfig.get<std::string>(prefix + "_Address", std::string());
+            phone.channel = iniConfig.get<uint16_t>(prefix + "_Channel", 0);
+
+            if(!phone.address.empty())
+            {
+                list_.push_back(phone);
+            }
+        }
+    }
+    catch(const boost::property_tree::ptree_error& e)
+    {
+        OPENAUTO_LOG(warning) << "[KnownPhonesList] failed to read configuration file: " << cConfigFileName
+                            << ", error: " << e.what()
+                            << ". Empty list will be used.";
+    }
+}
+
+void KnownPhonesList::save()
+{
+    boost::property_tree::ptree iniConfig;
+
+    const auto entriesCount = std::min(maxListSize_, list_.size());
+    iniConfig.put<size_t>(cEntriesCount, entriesCount);
+
+    for(size_t i = 0; i < entriesCount; ++i)
+    {
+        const auto prefix = cEntryPrefix + std::to_string(i);
+        iniConfig.put<std::string>(prefix + "_Address", list_.at(i).address);
+        iniConfig.put<uint16_t>(prefix + "_Channel", list_.at(i).channel);
+    }
+
+    try
+    {
+        boost::property_tree::ini_parser::write_ini(cConfigFileName, iniConfig);
+    }
+    catch(const boost::property_tree::ini_parser_error& e)
+    {
+        OPENAUTO_LOG(warning) << "[KnownPhonesList] failed to write " << cConfigFileName << ": " << e.what();
+    }
+}
+
+}
+}
+}
+}
@@ -0,0 +1,160 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <boost/property_tree/ini_parser.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Configuration/PhoneProfilesList.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace configuration
+{
+
+const std::string PhoneProfilesList::cConfigFileName = "openauto_phone_profiles.ini";
+const std::string PhoneProfilesList::cEntriesCount = "Profiles.EntriesCount";
+const std::string PhoneProfilesList::cEntryPrefix = "Profiles.Entry_";
+
+PhoneProfilesList::PhoneProfilesList(size_t maxListSize)
+    : maxListSize_(maxListSize)
+{
+
+}
+
+void PhoneProfilesList::read()
+{
+    this->load();
+}
+
+bool PhoneProfilesList::find(const std::string& phone, PhoneProfile& profile) const
+{
+    auto it = std::find_if(list_.begin(), list_.end(), [&](const PhoneProfile& known) { return known.phone == phone; });
+    if(it == list_.end())
+    {
+        return false;
+    }
+    profile = *it;
+    return true;
+}
+
+void PhoneProfilesList::remember(const PhoneProfile& profile)
+{
+    auto it = std::find_if(list_.begin(), list_.end(), [&](const PhoneProfile& known) { return known.phone == profile.phone; });
+    if(it != list_.end())
+    {
+        list_.erase(it);
+    }
+    else if(list_.size() >= maxListSize_)
+    {
+        list_.pop_back();
+    }
+
+    list_.push_front(profile);
+    this->save();
+}
+
+PhoneProfilesList::PhoneProfiles PhoneProfilesList::getList() const
+{
+    return list_;
+}
+
+void PhoneProfilesList::load()
+{
+    namespace message = aap_protobuf::service::media::sink::message;
+    boost::property_tree::ptree iniConfig;
+
+    try
+    {
+        boost::property_tree::ini_parser::read_ini(cConfigFileName, iniConfig);
+
+        const auto listSize = std::min(maxListSize_, iniConfig.get<size_t>(cEntriesCount, 0));
+
+        for(size_t i = 0; i < listSize; ++i)
+        {
+            const auto prefix = cEntryPrefix + std::to_string(i);
+            PhoneProfile profile;
+            profile.phone = iniConfig.get<std::string>(prefix + "_Phone", std::string());
+            profile.sessions = iniConfig.get<uint32_t>(prefix + "_Sessions", 0);
+            const auto resolution = iniConfig.get<int>(prefix + "_VideoResolution", profile.videoResolution);
+            const auto fps = iniConfig.get<int>(prefix + "_VideoFPS", profile.videoFps);
+            profile.videoMaxUnacked = iniConfig.get<uint32_t>(prefix + "_VideoMaxUnacked", 0);
+            profile.decodeFps = iniConfig.get<double>(prefix + "_DecodeFPS", 0.0);
+            profile.droppedPermille = iniConfig.get<double>(prefix + "_DroppedPermille", 0.0);
+            profile.streamKbps = iniConfig.get<double>(prefix + "_StreamKbps", 0.0);
+            profile.rttMs = iniConfig.get<double>(prefix + "_RttMs", 0.0);
+
+            // An edited or stale entry names a mode this build does not have
+            if(profile.phone.empty() || !message::VideoCodecResolutionType_IsValid(resolution) ||
+               !message::VideoFrameRateType_IsValid(fps))
+            {
+                continue;
+            }
+            profile.videoResolution = static_cast<message::VideoCodecResolutionType>(resolution);
+            profile.videoFps = static_cast<message::VideoFrameRateType>(fps);
+            list_.push_back(profile);
+        }
+    }
+    catch(const boost::property_tree::ptree_error& e)
+    {
+        OPENAUTO_LOG(warning) << "[PhoneProfilesList] failed to read configuration file: " << cConfigFileName
+                            << ", error: " << e.what()
+                            << ". Empty list will be used.";
+    }
+}
+
+void PhoneProfilesList::save()
+{
+    boost::property_tree::ptree iniConfig;
+
+    const auto entriesCount = std::min(maxListSize_, list_.size());
+    iniConfig.put<size_t>(cEntriesCount, entriesCount);
+
+    for(size_t i = 0; i < entriesCount; ++i)
+    {
+        const auto prefix = cEntryPrefix + std::to_string(i);
+        const auto& profile = list_.at(i);
+        iniConfig.put<std::string>(prefix + "_Phone", profile.phone);
+        iniConfig.put<uint32_t>(prefix + "_Sessions", profile.sessions);
+        iniConfig.put<int>(prefix + "_VideoResolution", profile.videoResolution);
+        iniConfig.put<int>(prefix + "_VideoFPS", profile.videoFps);
+        iniConfig.put<uint32_t>(prefix + "_VideoMaxUnacked", profile.videoMaxUnacked);
+        iniConfig.put<double>(prefix + "_DecodeFPS", profile.decodeFps);
+        iniConfig.put<double>(prefix + "_DroppedPermille", profile.droppedPermille);
+        iniConfig.put<double>(prefix + "_StreamKbps", profile.streamKbps);
+        iniConfig.put<double>(prefix + "_RttMs", profile.rttMs);
+    }
+
+    try
+    {
+        boost::property_tree::ini_parser::write_ini(cConfigFileName, iniConfig);
+    }
+    catch(const boost::property_tree::ini_parser_error& e)
+    {
+        OPENAUTO_LOG(warning) << "[PhoneProfilesList] failed to write " << cConfigFileName << ": " << e.what();
+    }
+}
+
+}
+}
+}
+}
@@ -0,0 +1,54 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/ConnectionArbiter.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  const char *connectionTransportName(ConnectionTransport transport)
+  {
+    switch (transport)
+    {
+    case ConnectionTransport::Usb:
+      return "USB";
+    case ConnectionTransport::Wifi:
+      return "WiFi";
+    default:
+      return "none";
+    }
+  }
+
+  ArbiterDecision ConnectionArbiter::offer(ConnectionTransport incoming, LinkState currentLink) const
+  {
+    if (current_ == ConnectionTransport::None)
+      return ArbiterDecision::Accept;
+
+    if (incoming == ConnectionTransport::Usb)
+    {
+      // A second cable-attached phone has nowhere to go
+      return current_ == ConnectionTransport::Wifi ? ArbiterDecision::Replace : ArbiterDecision::Reject;
+    }
+
+    if (current_ == ConnectionTransport::Wifi && currentLink != LinkState::Good)
+      return ArbiterDecision::Replace;
+    return ArbiterDecision::Reject;
+  }
+
+}
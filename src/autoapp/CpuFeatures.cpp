@@ -0,0 +1,111 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstdlib>
+#include <cstring>
+#include <sys/auxv.h>
+#include <f1x/openauto/Common/CpuFeatures.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+#if defined(__arm__) || defined(__aarch64__)
+#include <asm/hwcap.h>
+#endif
+
+namespace f1x
+{
+namespace openauto
+{
+namespace common
+{
+
+CpuFeatures CpuFeatures::detect()
+{
+    CpuFeatures features;
+#if defined(__aarch64__)
+    // Advanced SIMD is part of the base ARMv8-A profile
+    features.neon = true;
+#elif defined(__arm__)
+    features.neon = (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    features.sse2 = __builtin_cpu_supports("sse2");
+    features.sse41 = __builtin_cpu_supports("sse4.1");
+    features.avx2 = __builtin_cpu_supports("avx2");
+#endif
+    return features;
+}
+
+const CpuFeatures &CpuFeatures::host()
+{
+    static const CpuFeatures features = []() {
+        const char *simd = std::getenv("OPENAUTO_SIMD");
+        if(simd != nullptr && std::strcmp(simd, "off") == 0)
+        {
+            return CpuFeatures();
+        }
+        return detect();
+    }();
+    return features;
+}
+
+std::string CpuFeatures::describe() const
+{
+    std::string text;
+    auto append = [&text](bool present, const char *name) {
+        if(present)
+        {
+            text += text.empty() ? name : std::string(" ") + name;
+        }
+    };
+    append(neon, "neon");
+    append(sse2, "sse2");
+    append(sse41, "sse4.1");
+    append(avx2, "avx2");
+    return text.empty() ? "none" : text;
+}
+
+KernelSelfTest &KernelSelfTest::instance()
+{
+    static KernelSelfTest selfTest;
+    return selfTest;
+}
+
+void KernelSelfTest::add(std::string name, Check check)
+{
+    checks_.emplace_back(std::move(name), std::move(check));
+}
+
+size_t KernelSelfTest::run() const
+{
+    size_t failed = 0;
+    for(const auto &check : checks_)
+    {
+        if(!check.second())
+        {
+            OPENAUTO_LOG(error) << "[CpuFeatures] Kernel " << check.first
+                                << " disagrees with its scalar reference";
+            failed++;
+        }
+    }
+    return failed;
+}
+
+}
+}
+}
@@ -0,0 +1,250 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    constexpr char cMagic[8] = {'O', 'A', 'F', 'L', 'I', 'G', 'H', 'T'};
+    constexpr uint32_t cVersion = 1;
+    // Lines of an unclean earlier run that go to the log; the rest to the text file
+    constexpr size_t cLoggedEvents = 64;
+
+    int64_t clockNs(clockid_t clock)
+    {
+      timespec now{};
+      clock_gettime(clock, &now);
+      return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+    }
+
+    uint16_t threadId()
+    {
+      thread_local const uint16_t tid = static_cast<uint16_t>(syscall(SYS_gettid));
+      return tid;
+    }
+  }
+
+  struct FlightRecorder::Header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t capacity;
+    int32_t pid;
+    // Set by close(); a ring found without it belongs to a run that crashed
+    uint32_t clean;
+    // The two clocks at open(), to put wall-clock times on the events
+    int64_t realtimeNs;
+    int64_t monotonicNs;
+    std::atomic<uint64_t> head;
+    uint8_t padding[16];
+  };
+
+  struct FlightRecorder::Slot
+  {
+    // Index + 1 once the slot is complete; 0 while it is written
+    std::atomic<uint64_t> sequence;
+    int64_t timeNs;
+    int64_t a;
+    int32_t b;
+    uint16_t event;
+    uint16_t tid;
+  };
+
+  static_assert(sizeof(std::atomic<uint64_t>) == 8, "the ring layout needs plain 64-bit atomics");
+
+  const char *flightEventName(FlightEvent event)
+  {
+    switch (event)
+    {
+    case FlightEvent::None:
+      return "none";
+    case FlightEvent::ProcessStarted:
+      return "process-started";
+    case FlightEvent::SessionStarted:
+      return "session-started";
+    case FlightEvent::SessionStopped:
+      return "session-stopped";
+    case FlightEvent::ChannelOpened:
+      return "channel-opened";
+    case FlightEvent::ChannelError:
+      return "channel-error";
+    case FlightEvent::VideoFocus:
+      return "video-focus";
+    case FlightEvent::DecoderError:
+      return "decoder-error";
+    case FlightEvent::DecoderRecovery:
+      return "decoder-recovery";
+    case FlightEvent::AudioXrun:
+      return "audio-xrun";
+    case FlightEvent::Touch:
+      return "touch";
+    case FlightEvent::Signal:
+      return "signal";
+    }
+    return "unknown";
+  }
+
+  FlightRecorder &FlightRecorder::instance()
+  {
+    // Never destroyed: threads may still record while static destructors run
+    static FlightRecorder *recorder = new FlightRecorder();
+    return *recorder;
+  }
+
+  FlightRecorder::~FlightRecorder()
+  {
+    close();
+    if (header_ != nullptr)
+      munmap(header_, mappedSize_);
+  }
+
+  bool FlightRecorder::open(const std::string &path)
+  {
+    const size_t size = sizeof(Header) + cCapacity * sizeof(Slot);
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+      OPENAUTO_LOG(warning) << "[FlightRecorder] Cannot open " << path << ": " << std::strerror(errno);
+      return false;
+    }
+    struct stat info;
+    const bool sameSize = fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) == size;
+    if (!sameSize && ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+      OPENAUTO_LOG(warning) << "[FlightRecorder] Cannot size " << path << ": " << std::strerror(errno);
+      ::close(fd);
+      return false;
+    }
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+      OPENAUTO_LOG(warning) << "[FlightRecorder] Cannot map " << path << ": " << std::strerror(errno);
+      return false;
+    }
+
+    auto *header = static_cast<Header *>(mapping);
+    auto *slots = reinterpret_cast<Slot *>(static_cast<char *>(mapping) + sizeof(Header));
+    if (sameSize && std::memcmp(header->magic, cMagic, sizeof(cMagic)) == 0 && header->version == cVersion &&
+        header->capacity == cCapacity && header->clean == 0)
+    {
+      previousRun_ = decode(*header, slots);
+      OPENAUTO_LOG(warning) << "[FlightRecorder] The last run (pid " << header->pid
+                            << ") did not exit cleanly; its last " << previousRun_.size() << " events follow";
+      const size_t from = previousRun_.size() - std::min(previousRun_.size(), cLoggedEvents);
+      for (size_t i = from; i < previousRun_.size(); ++i)
+        OPENAUTO_LOG(warning) << "[FlightRecorder] " << previousRun_[i];
+
+      std::ofstream text(path + ".last-crash.txt", std::ios::trunc);
+      text << "pid " << header->pid << '\n';
+      for (const auto &line : previousRun_)
+        text << line << '\n';
+    }
+
+    std::memset(mapping, 0, size);
+    header = new (mapping) Header();
+    std::memcpy(header->magic, cMagic, sizeof(cMagic));
+    header->version = cVersion;
+    header->capacity = cCapacity;
+    header->pid = static_cast<int32_t>(getpid());
+    header->realtimeNs = clockNs(CLOCK_REALTIME);
+    header->monotonicNs = clockNs(CLOCK_MONOTONIC);
+
+    if (header_ != nullptr)
+      munmap(header_, mappedSize_);
+    header_ = header;
+    slots_ = slots;
+    mappedSize_ = size;
+    return true;
+  }
+
+  void FlightRecorder::close()
+  {
+    if (slots_ == nullptr)
+      return;
+    // The mapping stays: a thread that already read slots_ may still write
+    slots_ = nullptr;
+    header_->clean = 1;
+    msync(header_, mappedSize_, MS_SYNC);
+  }
+
+  void FlightRecorder::record(FlightEvent event, int64_t a, int32_t b)
+  {
+    Slot *slots = slots_;
+    if (slots == nullptr)
+      return;
+    const uint64_t index = header_->head.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = slots[index & (cCapacity - 1)];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    slot.timeNs = clockNs(CLOCK_MONOTONIC);
+    slot.a = a;
+    slot.b = b;
+    slot.event = static_cast<uint16_t>(event);
+    slot.tid = threadId();
+    slot.sequence.store(index + 1, std::memory_order_release);
+  }
+
+  void FlightRecorder::flush()
+  {
+    if (header_ != nullptr)
+      msync(header_, mappedSize_, MS_ASYNC);
+  }
+
+  std::vector<std::string> FlightRecorder::decode(const Header &header, const Slot *slots)
+  {
+    const uint64_t head = header.head.load(std::memory_order_acquire);
+    const uint64_t count = std::min<uint64_t>(head, cCapacity);
+    std::vector<std::string> lines;
+    lines.reserve(count);
+    for (uint64_t index = head - count; index < head; ++index)
+    {
+      const Slot &slot = slots[index & (cCapacity - 1)];
+      // Overwritten by a later lap, or still being written when the process died
+      if (slot.sequence.load(std::memory_order_acquire) != index + 1)
+        continue;
+
+      const int64_t wallNs = header.realtimeNs + (slot.timeNs - header.monotonicNs);
+      const time_t seconds = static_cast<time_t>(wallNs / 1000000000);
+      tm local{};
+      localtime_r(&seconds, &local);
+      char line[128];
+      const size_t length = strftime(line, sizeof(line), "%Y-%m-%d %H:%M:%S", &local);
+      snprintf(line + length, sizeof(line) - length, ".%03d tid %u %s %lld %d",
+               static_cast<int>(wallNs / 1000000 % 1000), static_cast<unsigned>(slot.tid),
+               flightEventName(static_cast<FlightEvent>(slot.event)), static_cast<long long>(slot.a), slot.b);
+      lines.emplace_back(line);
+    }
+    return lines;
+  }
+
+}
@@ -0,0 +1,618 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <poll.h>
+#include <pthread.h>
+#include <set>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/HotspotLink.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    struct HotspotMetrics
+    {
+      MetricGauge &channel = Metrics::instance().gauge(
+          "openauto_wifi_channel", "Channel selectChannel() left hostapd on, 0 unchanged");
+      MetricGauge &txBitrate = Metrics::instance().gauge(
+          "openauto_wifi_tx_bitrate_kbps", "PHY rate towards the phone");
+      MetricGauge &signal = Metrics::instance().gauge(
+          "openauto_wifi_signal_dbm", "Signal of the phone's frames");
+      MetricGauge &retryPercent = Metrics::instance().gauge(
+          "openauto_wifi_tx_retry_percent", "Frames to the phone that needed a retry, last sample");
+      MetricGauge &txFailed = Metrics::instance().gauge(
+          "openauto_wifi_tx_failed", "Frames to the phone dropped after all retries");
+      MetricGauge &usable = Metrics::instance().gauge(
+          "openauto_wifi_usable_kbps", "Throughput the video mode selection assumes, 0 unknown");
+    };
+
+    HotspotMetrics &metrics()
+    {
+      static HotspotMetrics instance;
+      return instance;
+    }
+
+    const int cLowerBand[] = {36, 40, 44, 48};
+    const int cUpperBand[] = {149, 153, 157, 161, 165};
+    // Regulatory domains that allow an access point on 149-165
+    const std::set<std::string> cUpperBandCountries{"US", "CA", "AU", "NZ", "CN", "IN", "KR", "TW", "SG", "MX", "BR"};
+
+    // Interface names end up in shell commands
+    bool safeName(const std::string &name)
+    {
+      return !name.empty() && std::all_of(name.begin(), name.end(), [](char c)
+                                          { return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.' || c == ':'; });
+    }
+
+    std::string shell(const std::string &command)
+    {
+      std::string output;
+      FILE *pipe = popen((command + " 2>/dev/null").c_str(), "r");
+      if (pipe == nullptr)
+        return output;
+      char buffer[512];
+      size_t size;
+      while ((size = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+        output.append(buffer, size);
+      pclose(pipe);
+      return output;
+    }
+
+    std::string trim(const std::string &value)
+    {
+      const auto begin = value.find_first_not_of(" \t");
+      if (begin == std::string::npos)
+        return "";
+      return value.substr(begin, value.find_last_not_of(" \t\r") - begin + 1);
+    }
+
+    // "key: value" lines of iw; false for other lines
+    bool field(const std::string &line, std::string &key, std::string &value)
+    {
+      const auto colon = line.find(':');
+      if (colon == std::string::npos)
+        return false;
+      key = trim(line.substr(0, colon));
+      value = trim(line.substr(colon + 1));
+      return true;
+    }
+
+    // First channel of the @p widthMhz block holding @p channel
+    int blockBase(int channel, int widthMhz)
+    {
+      const int bandBase = channel >= 149 ? 149 : 36;
+      const int span = widthMhz >= 80 ? 16 : widthMhz >= 40 ? 8 : 4;
+      return bandBase + (channel - bandBase) / span * span;
+    }
+
+    std::string hostapdValue(const std::string &path, const std::string &key)
+    {
+      std::ifstream file(path);
+      std::string line;
+      while (std::getline(file, line))
+      {
+        if (line.compare(0, key.size() + 1, key + "=") == 0)
+          return trim(line.substr(key.size() + 1));
+      }
+      return "";
+    }
+
+    // hostapd's control socket for the interface; ctrl_interface names its
+    // directory, plainly or as "DIR=<path> GROUP=<group>"
+    std::string controlPath(const HotspotSettings &settings)
+    {
+      std::string directory = hostapdValue(settings.hostapdConfig, "ctrl_interface");
+      if (directory.compare(0, 4, "DIR=") == 0)
+        directory = directory.substr(4, directory.find(' ') - 4);
+      if (directory.empty())
+        return "";
+      return directory + "/" + settings.interface;
+    }
+
+    // One request on hostapd's control socket; false without an answer,
+    // which may be empty
+    bool controlRequest(const std::string &path, const std::string &command, std::string &reply)
+    {
+      reply.clear();
+      sockaddr_un remote{};
+      if (path.empty() || path.size() >= sizeof(remote.sun_path))
+        return false;
+      remote.sun_family = AF_UNIX;
+      std::memcpy(remote.sun_path, path.data(), path.size());
+
+      const int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+      if (fd < 0)
+        return false;
+      // hostapd answers to the sender's address, so the socket needs a name
+      sockaddr_un local{};
+      local.sun_family = AF_UNIX;
+      std::snprintf(local.sun_path, sizeof(local.sun_path), "/tmp/openauto_hostapd_%d", static_cast<int>(getpid()));
+      unlink(local.sun_path);
+
+      bool answered = false;
+      if (bind(fd, reinterpret_cast<sockaddr *>(&local), sizeof(local)) == 0)
+      {
+        pollfd ready{fd, POLLIN, 0};
+        char buffer[4096];
+        if (connect(fd, reinterpret_cast<sockaddr *>(&remote), sizeof(remote)) == 0 &&
+            send(fd, command.data(), command.size(), 0) == static_cast<ssize_t>(command.size()) &&
+            poll(&ready, 1, HotspotLink::cControlTimeoutMs) > 0)
+        {
+          const ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+          if (size >= 0)
+          {
+            reply.assign(buffer, static_cast<size_t>(size));
+            answered = reply.compare(0, 4, "FAIL") != 0;
+          }
+        }
+        unlink(local.sun_path);
+      }
+      close(fd);
+      return answered;
+    }
+  }
+
+  HotspotLink::~HotspotLink()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      // What a queued sample hands back would go to a strand that is gone
+      stopping_ = true;
+      jobs_.clear();
+    }
+    posted_.notify_all();
+    if (thread_.joinable())
+      thread_.join();
+  }
+
+  HotspotLink &HotspotLink::instance()
+  {
+    static HotspotLink instance;
+    return instance;
+  }
+
+  void HotspotLink::configure(const HotspotSettings &settings)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    settings_ = settings;
+  }
+
+  HotspotSettings HotspotLink::settings() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return settings_;
+  }
+
+  std::vector<WifiNeighbour> HotspotLink::parseScan(const std::string &output)
+  {
+    std::vector<WifiNeighbour> neighbours;
+    std::istringstream lines(output);
+    std::string line, key, value;
+    while (std::getline(lines, line))
+    {
+      if (line.compare(0, 4, "BSS ") == 0)
+      {
+        neighbours.emplace_back();
+      }
+      else if (!neighbours.empty() && field(line, key, value))
+      {
+        // Newer iw prints "freq: 5180.0"
+        if (key == "freq")
+          neighbours.back().frequencyMhz = static_cast<int>(std::atof(value.c_str()));
+        else if (key == "signal")
+          neighbours.back().signalDbm = static_cast<int>(std::lround(std::atof(value.c_str())));
+      }
+    }
+    return neighbours;
+  }
+
+  bool HotspotLink::parseStation(const std::string &output, StationStats &stats)
+  {
+    StationStats parsed;
+    bool hasBitrate = false;
+    std::istringstream lines(output);
+    std::string line, key, value;
+    while (std::getline(lines, line))
+    {
+      if (!field(line, key, value))
+        continue;
+      if (key == "tx bitrate")
+      {
+        // "866.7 MBit/s VHT-MCS 9 80MHz short GI VHT-NSS 2"
+        parsed.txBitrateKbps = static_cast<int64_t>(std::atof(value.c_str()) * 1000);
+        hasBitrate = true;
+      }
+      else if (key == "signal")
+        parsed.signalDbm = std::atoi(value.c_str());
+      else if (key == "tx packets")
+        parsed.txPackets = std::strtoull(value.c_str(), nullptr, 10);
+      else if (key == "tx retries")
+        parsed.txRetries = std::strtoull(value.c_str(), nullptr, 10);
+      else if (key == "tx failed")
+        parsed.txFailed = std::strtoull(value.c_str(), nullptr, 10);
+    }
+    if (hasBitrate)
+      stats = parsed;
+    return hasBitrate;
+  }
+
+  bool HotspotLink::parseHostapdStation(const std::string &output, StationStats &stats)
+  {
+    StationStats parsed;
+    bool hasBitrate = false;
+    std::istringstream lines(output);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+      const auto equals = line.find('=');
+      if (equals == std::string::npos)
+        continue;
+      const std::string key = line.substr(0, equals);
+      const std::string value = trim(line.substr(equals + 1));
+      if (key == "tx_rate_info")
+      {
+        // "8667 vhtmcs 9 vhtnss 2 shortGI", in 100 kbit/s
+        parsed.txBitrateKbps = std::atoll(value.c_str()) * 100;
+        hasBitrate = true;
+      }
+      else if (key == "signal")
+        parsed.signalDbm = std::atoi(value.c_str());
+      else if (key == "tx_packets")
+        parsed.txPackets = std::strtoull(value.c_str(), nullptr, 10);
+      // Only printed by newer hostapd; without them retries count as none
+      else if (key == "tx_retry_count")
+        parsed.txRetries = std::strtoull(value.c_str(), nullptr, 10);
+      else if (key == "tx_retry_failed")
+        parsed.txFailed = std::strtoull(value.c_str(), nullptr, 10);
+    }
+    if (hasBitrate)
+      stats = parsed;
+    return hasBitrate;
+  }
+
+  int HotspotLink::leastCongestedChannel(const std::vector<WifiNeighbour> &neighbours, int widthMhz, bool upperBand)
+  {
+    std::vector<int> candidates(std::begin(cLowerBand), std::end(cLowerBand));
+    if (upperBand)
+    {
+      // 165 has no 40 or 80 MHz partner
+      candidates.insert(candidates.end(), std::begin(cUpperBand), std::end(cUpperBand) - (widthMhz > 20 ? 1 : 0));
+    }
+
+    int best = 0;
+    double bestCost = 0;
+    for (const int channel : candidates)
+    {
+      const int base = blockBase(channel, widthMhz);
+      const int last = base + std::max(widthMhz / 5 - 4, 0);
+      // Energy in mW: one loud neighbour outweighs several at the noise floor.
+      // Sharing the primary costs twice, as both then contend for every frame
+      double cost = 0;
+      for (const auto &neighbour : neighbours)
+      {
+        if (neighbour.frequencyMhz < 5000 || neighbour.frequencyMhz > 5900)
+          continue;
+        const int neighbourChannel = (neighbour.frequencyMhz - 5000) / 5;
+        const double power = std::pow(10.0, neighbour.signalDbm / 10.0);
+        if (neighbourChannel >= base && neighbourChannel <= last)
+          cost += power;
+        if (neighbourChannel == channel)
+          cost += power;
+      }
+      if (best == 0 || cost < bestCost)
+      {
+        best = channel;
+        bestCost = cost;
+      }
+    }
+    return best;
+  }
+
+  bool HotspotLink::applyChannel(const std::string &path, int channel, int widthMhz)
+  {
+    std::vector<std::string> lines;
+    {
+      std::ifstream file(path);
+      if (!file)
+        return false;
+      std::string line;
+      while (std::getline(file, line))
+        lines.push_back(line);
+    }
+
+    // HT40+ when the secondary channel is above the primary
+    std::string htCapab;
+    for (const auto &line : lines)
+    {
+      if (line.compare(0, 9, "ht_capab=") == 0)
+        htCapab = line.substr(9);
+    }
+    for (const char *flag : {"[HT40+]", "[HT40-]"})
+    {
+      const auto at = htCapab.find(flag);
+      if (at != std::string::npos)
+        htCapab.erase(at, 7);
+    }
+    if (widthMhz >= 40)
+      htCapab += (channel - blockBase(channel, 40)) == 0 ? "[HT40+]" : "[HT40-]";
+
+    const int center = widthMhz >= 80 ? blockBase(channel, 80) + 6 : widthMhz >= 40 ? blockBase(channel, 40) + 2 : channel;
+    std::vector<std::pair<std::string, std::string>> wanted{
+        {"hw_mode", "a"},
+        {"channel", std::to_string(channel)},
+        {"ieee80211n", "1"},
+        {"ht_capab", htCapab},
+        {"vht_oper_chwidth", widthMhz >= 80 ? "1" : "0"},
+        {"vht_oper_centr_freq_seg0_idx", std::to_string(center)}};
+    if (widthMhz >= 80)
+      wanted.emplace_back("ieee80211ac", "1");
+
+    bool changed = false;
+    for (const auto &entry : wanted)
+    {
+      const std::string prefix = entry.first + "=";
+      const std::string wantedLine = prefix + entry.second;
+      auto line = std::find_if(lines.begin(), lines.end(), [&prefix](const std::string &line)
+                               { return line.compare(0, prefix.size(), prefix) == 0; });
+      if (line == lines.end())
+      {
+        lines.push_back(wantedLine);
+        changed = true;
+      }
+      else if (*line != wantedLine)
+      {
+        *line = wantedLine;
+        changed = true;
+      }
+    }
+    if (!changed)
+      return false;
+
+    // hostapd may be reading it when it restarts
+    const std::string temporary = path + ".tmp";
+    {
+      std::ofstream file(temporary, std::ios::trunc);
+      for (const auto &line : lines)
+        file << line << '\n';
+      if (!file.flush())
+      {
+        std::remove(temporary.c_str());
+        return false;
+      }
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+  }
+
+  std::string HotspotLink::neighbourMac(const std::string &address, const std::string &interface,
+                                        const std::string &arpPath)
+  {
+    // IP address, HW type, Flags, HW address, Mask, Device
+    std::ifstream file(arpPath);
+    std::string line;
+    std::getline(file, line);
+    while (std::getline(file, line))
+    {
+      std::istringstream fields(line);
+      std::string ip, type, flags, mac, mask, device;
+      if (fields >> ip >> type >> flags >> mac >> mask >> device && ip == address && device == interface &&
+          mac != "00:00:00:00:00:00")
+        return mac;
+    }
+    return "";
+  }
+
+  int HotspotLink::selectChannel()
+  {
+    const HotspotSettings settings = this->settings();
+    if (!settings.autoChannel || !safeName(settings.interface))
+      return 0;
+
+    // Without a country hostapd cannot start an access point on 5 GHz at all
+    const std::string country = hostapdValue(settings.hostapdConfig, "country_code");
+    if (country.empty())
+    {
+      OPENAUTO_LOG(info) << "[HotspotLink] No country_code in " << settings.hostapdConfig << ", keeping its channel";
+      return 0;
+    }
+
+    // An interface already in AP mode only scans when forced to
+    const bool running = static_cast<bool>(std::ifstream("/tmp/hotspot_active"));
+    const std::string command = "iw dev " + settings.interface + " scan";
+    const auto neighbours = parseScan(shell(command + (running ? " ap-force" : "")));
+    const int channel = leastCongestedChannel(neighbours, settings.channelWidthMhz, cUpperBandCountries.count(country) > 0);
+    OPENAUTO_LOG(info) << "[HotspotLink] " << neighbours.size() << " access points heard, channel " << channel << " at "
+                       << settings.channelWidthMhz << " MHz is the least busy";
+    if (channel == 0)
+      return 0;
+
+    if (applyChannel(settings.hostapdConfig, channel, settings.channelWidthMhz))
+    {
+      // Reloading drops associated clients; a phone that already joined
+      // keeps the old channel until the next hotspot start
+      const std::string control = controlPath(settings);
+      std::string reply;
+      if (running && controlRequest(control, "STA-FIRST", reply) && reply.empty())
+        controlRequest(control, "RELOAD", reply);
+      OPENAUTO_LOG(info) << "[HotspotLink] Moved hostapd to channel " << channel;
+    }
+    metrics().channel.set(channel);
+    return channel;
+  }
+
+  void HotspotLink::post(std::function<void()> job)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_)
+      return;
+    jobs_.push_back(std::move(job));
+    if (!thread_.joinable())
+      thread_ = std::thread(&HotspotLink::run, this);
+    posted_.notify_all();
+  }
+
+  void HotspotLink::run()
+  {
+    pthread_setname_np(pthread_self(), "oa-hotspot");
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+      posted_.wait(lock, [this]()
+                   { return stopping_ || !jobs_.empty(); });
+      if (jobs_.empty())
+        return;
+      auto job = std::move(jobs_.front());
+      jobs_.pop_front();
+      lock.unlock();
+      job();
+      lock.lock();
+    }
+  }
+
+  void HotspotLink::startSession(int fd)
+  {
+    usableKbps_.store(0, std::memory_order_relaxed);
+
+    // Here: the descriptor may be closed and reused once this returns
+    sockaddr_in peer{};
+    socklen_t length = sizeof(peer);
+    char address[INET_ADDRSTRLEN] = {};
+    std::string peerAddress;
+    if (getpeername(fd, reinterpret_cast<sockaddr *>(&peer), &length) == 0 && peer.sin_family == AF_INET &&
+        inet_ntop(AF_INET, &peer.sin_addr, address, sizeof(address)) != nullptr)
+      peerAddress = address;
+
+    this->post([this, settings = this->settings(), peerAddress]()
+               { this->beginSession(settings, peerAddress); });
+  }
+
+  void HotspotLink::endSession()
+  {
+    usableKbps_.store(0, std::memory_order_relaxed);
+    this->post([this]()
+               { this->closeSession(); });
+  }
+
+  void HotspotLink::sample(SampleHandler handler)
+  {
+    this->post([this, handler = std::move(handler)]()
+               {
+      this->readStation();
+      if (handler)
+        handler(this->usableKbps()); });
+  }
+
+  void HotspotLink::beginSession(const HotspotSettings &settings, const std::string &peerAddress)
+  {
+    session_ = settings;
+    active_ = safeName(session_.interface);
+    stationMac_.clear();
+    controlPath_.clear();
+    restorePowerSave_ = false;
+    last_ = StationStats();
+    nextSample_ = std::chrono::steady_clock::now();
+    usableKbps_.store(0, std::memory_order_relaxed);
+    if (!active_)
+      return;
+
+    if (!peerAddress.empty())
+      stationMac_ = neighbourMac(peerAddress, session_.interface);
+    if (!safeName(stationMac_))
+      stationMac_.clear();
+    if (!stationMac_.empty())
+      controlPath_ = controlPath(session_);
+
+    // Power save holds frames for the phone until its next beacon wakeup
+    const std::string device = "iw dev " + session_.interface;
+    if (session_.powerSaveOff && shell(device + " get power_save").find(": on") != std::string::npos)
+    {
+      shell(device + " set power_save off");
+      restorePowerSave_ = true;
+    }
+    OPENAUTO_LOG(info) << "[HotspotLink] Session on " << session_.interface
+                       << (stationMac_.empty() ? " as a client" : " with station " + stationMac_)
+                       << (restorePowerSave_ ? ", power save off" : "");
+  }
+
+  void HotspotLink::closeSession()
+  {
+    if (restorePowerSave_)
+      shell("iw dev " + session_.interface + " set power_save on");
+    restorePowerSave_ = false;
+    active_ = false;
+    usableKbps_.store(0, std::memory_order_relaxed);
+    metrics().usable.set(0);
+  }
+
+  void HotspotLink::readStation()
+  {
+    const auto now = std::chrono::steady_clock::now();
+    if (!active_ || now < nextSample_)
+      return;
+    nextSample_ = now + std::chrono::milliseconds(cSampleIntervalMs);
+
+    // hostapd's counters on our own hotspot; iw's without its control
+    // socket, and as a client, where the link is the station
+    StationStats stats;
+    std::string reply;
+    bool read = controlRequest(controlPath_, "STA " + stationMac_, reply) && parseHostapdStation(reply, stats);
+    if (!read)
+    {
+      const std::string device = "iw dev " + session_.interface;
+      read = parseStation(shell(stationMac_.empty() ? device + " link" : device + " station get " + stationMac_), stats);
+    }
+    if (!read)
+    {
+      usableKbps_.store(0, std::memory_order_relaxed);
+      return;
+    }
+
+    int64_t retryPercent = 0;
+    if (stats.txPackets > last_.txPackets && last_.txPackets > 0)
+    {
+      const uint64_t retries = stats.txRetries >= last_.txRetries ? stats.txRetries - last_.txRetries : 0;
+      retryPercent = std::min<int64_t>(static_cast<int64_t>(retries * 100 / (stats.txPackets - last_.txPackets)), 100);
+    }
+    last_ = stats;
+
+    const int64_t usable = stats.txBitrateKbps * (100 - retryPercent) / 100 * cTcpSharePercent / 100;
+    usableKbps_.store(usable, std::memory_order_relaxed);
+
+    auto &m = metrics();
+    m.txBitrate.set(stats.txBitrateKbps);
+    m.signal.set(stats.signalDbm);
+    m.retryPercent.set(retryPercent);
+    m.txFailed.set(static_cast<int64_t>(stats.txFailed));
+    m.usable.set(usable);
+  }
+
+}
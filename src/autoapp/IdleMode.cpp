@@ -0,0 +1,231 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/IdleMode.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    struct IdleMetrics
+    {
+      MetricGauge &idle = Metrics::instance().gauge(
+          "openauto_idle", "1 while the screen is off and the periodic work stopped");
+      MetricCounter &entries = Metrics::instance().counter(
+          "openauto_idle_entries_total", "Times idle mode was entered");
+      MetricGauge &wakeupsPerMinute = Metrics::instance().gauge(
+          "openauto_idle_wakeups_per_minute", "Context switches of all threads per minute, last idle period");
+    };
+
+    IdleMetrics &metrics()
+    {
+      static IdleMetrics instance;
+      return instance;
+    }
+
+    // FB_BLANK_UNBLANK and FB_BLANK_POWERDOWN
+    constexpr const char *cBacklightOn = "0";
+    constexpr const char *cBacklightOff = "4";
+
+    std::vector<std::string> listDirectory(const std::string &path)
+    {
+      std::vector<std::string> entries;
+      if (DIR *dir = opendir(path.c_str()))
+      {
+        while (const dirent *entry = readdir(dir))
+        {
+          if (entry->d_name[0] != '.')
+            entries.push_back(entry->d_name);
+        }
+        closedir(dir);
+      }
+      return entries;
+    }
+  }
+
+  IdleMode::IdleMode(boost::asio::io_service &ioService, std::string sysfsRoot, std::string procSelf)
+      : strand_(ioService), timer_(ioService), sysfsRoot_(std::move(sysfsRoot)), procSelf_(std::move(procSelf))
+  {
+    for (const auto &name : listDirectory(sysfsRoot_ + "/class/backlight"))
+      backlights_.push_back(sysfsRoot_ + "/class/backlight/" + name + "/bl_power");
+  }
+
+  void IdleMode::start(IdleSettings settings, Handler handler)
+  {
+    strand_.dispatch([this, self = this->shared_from_this(), settings, handler = std::move(handler)]() mutable
+                     {
+      settings_ = settings;
+      handler_ = std::move(handler);
+      started_ = true;
+      OPENAUTO_LOG(info) << "[IdleMode] Screen off " << settings_.timeoutMs / 1000 << " s after the last session"
+                         << (settings_.screenOff ? "" : " disabled") << ", " << backlights_.size() << " backlights";
+      this->arm(); });
+  }
+
+  void IdleMode::configure(IdleSettings settings)
+  {
+    strand_.dispatch([this, self = this->shared_from_this(), settings]()
+                     {
+      settings_ = settings;
+      if (!started_)
+        return;
+      if (!settings_.screenOff)
+        this->leave("screen off disabled");
+      this->arm(); });
+  }
+
+  void IdleMode::stop()
+  {
+    // Right away: the io_service is usually stopped next, and the panel must
+    // not stay dark after exit
+    if (idle_.exchange(false))
+    {
+      metrics().idle.set(0);
+      this->setBacklight(true);
+    }
+    strand_.dispatch([this, self = this->shared_from_this()]()
+                     {
+      started_ = false;
+      timer_.cancel(); });
+  }
+
+  void IdleMode::onSessionStarted()
+  {
+    strand_.dispatch([this, self = this->shared_from_this()]()
+                     {
+      inSession_ = true;
+      timer_.cancel();
+      this->leave("session"); });
+  }
+
+  void IdleMode::onSessionStopped()
+  {
+    strand_.dispatch([this, self = this->shared_from_this()]()
+                     {
+      inSession_ = false;
+      this->arm(); });
+  }
+
+  void IdleMode::activity(const std::string &reason)
+  {
+    strand_.dispatch([this, self = this->shared_from_this(), reason]()
+                     {
+      this->leave(reason);
+      this->arm(); });
+  }
+
+  void IdleMode::arm()
+  {
+    timer_.cancel();
+    if (!started_ || inSession_ || idle_ || !settings_.screenOff)
+      return;
+    timer_.expires_from_now(std::chrono::milliseconds(std::max(0, settings_.timeoutMs)));
+    timer_.async_wait(strand_.wrap([this, self = this->shared_from_this()](const boost::system::error_code &error)
+                                   {
+      if (!error)
+        this->enter(); }));
+  }
+
+  void IdleMode::enter()
+  {
+    if (!started_ || inSession_ || idle_)
+      return;
+    idle_ = true;
+    metrics().idle.set(1);
+    metrics().entries.add();
+    OPENAUTO_LOG(info) << "[IdleMode] No session for " << settings_.timeoutMs / 1000 << " s: screen off, timers stopped";
+    // The handlers' own work is not part of the idle period
+    if (handler_)
+      handler_(true);
+    this->setBacklight(false);
+    enteredAt_ = std::chrono::steady_clock::now();
+    switchesAtEntry_ = this->contextSwitches();
+  }
+
+  void IdleMode::leave(const std::string &reason)
+  {
+    if (!idle_)
+      return;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - enteredAt_).count();
+    // Threads that exited meanwhile take their counts with them
+    const uint64_t now = this->contextSwitches();
+    const uint64_t switches = now > switchesAtEntry_ ? now - switchesAtEntry_ : 0;
+    const double perSecond = seconds > 0.0 ? switches / seconds : 0.0;
+    idle_ = false;
+    metrics().idle.set(0);
+    metrics().wakeupsPerMinute.set(static_cast<int64_t>(perSecond * 60.0));
+
+    std::ostringstream rate;
+    rate << std::fixed << std::setprecision(2) << perSecond;
+    if (perSecond > cTargetWakeupsPerSecond)
+      OPENAUTO_LOG(warning) << "[IdleMode] Woken by " << reason << " after " << static_cast<int64_t>(seconds)
+                            << " s idle: " << rate.str() << " wakeups/s, target " << cTargetWakeupsPerSecond;
+    else
+      OPENAUTO_LOG(info) << "[IdleMode] Woken by " << reason << " after " << static_cast<int64_t>(seconds)
+                         << " s idle: " << rate.str() << " wakeups/s";
+
+    this->setBacklight(true);
+    if (handler_)
+      handler_(false);
+  }
+
+  void IdleMode::setBacklight(bool on)
+  {
+    for (const auto &path : backlights_)
+    {
+      std::ofstream node(path);
+      if (!(node << (on ? cBacklightOn : cBacklightOff)))
+        OPENAUTO_LOG(warning) << "[IdleMode] Cannot write " << path;
+    }
+  }
+
+  uint64_t IdleMode::contextSwitches() const
+  {
+    uint64_t total = 0;
+    for (const auto &task : listDirectory(procSelf_ + "/task"))
+    {
+      std::ifstream status(procSelf_ + "/task/" + task + "/status");
+      total += parseContextSwitches(status);
+    }
+    return total;
+  }
+
+  uint64_t IdleMode::parseContextSwitches(std::istream &in)
+  {
+    uint64_t total = 0;
+    std::string line;
+    while (std::getline(in, line))
+    {
+      std::istringstream fields(line);
+      std::string key;
+      uint64_t value = 0;
+      if (fields >> key >> value && (key == "voluntary_ctxt_switches:" || key == "nonvoluntary_ctxt_switches:"))
+        total += value;
+    }
+    return total;
+  }
+
+}
@@ -0,0 +1,123 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <f1x/openauto/autoapp/LinkQuality.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    struct LinkMetrics
+    {
+      MetricGauge &rtt = Metrics::instance().gauge(
+          "openauto_link_rtt_us", "Smoothed round trip of the phone link");
+      MetricGauge &jitter = Metrics::instance().gauge(
+          "openauto_link_jitter_us", "Round trip variation of the phone link");
+      MetricGauge &state = Metrics::instance().gauge(
+          "openauto_link_state", "Link quality: 0 unknown, 1 good, 2 degraded, 3 poor");
+    };
+
+    LinkMetrics &metrics()
+    {
+      static LinkMetrics instance;
+      return instance;
+    }
+  }
+
+  const char *linkStateName(LinkState state)
+  {
+    switch (state)
+    {
+    case LinkState::Good:
+      return "good";
+    case LinkState::Degraded:
+      return "degraded";
+    case LinkState::Poor:
+      return "poor";
+    default:
+      return "unknown";
+    }
+  }
+
+  LinkQuality &LinkQuality::instance()
+  {
+    static LinkQuality instance;
+    return instance;
+  }
+
+  LinkState LinkQuality::classify(int64_t rttUs, int64_t jitterUs)
+  {
+    if (rttUs > cPoorRttUs || jitterUs > cPoorJitterUs)
+      return LinkState::Poor;
+    if (rttUs < cGoodRttUs && jitterUs < cGoodJitterUs)
+      return LinkState::Good;
+    return LinkState::Degraded;
+  }
+
+  bool LinkQuality::addSample(int64_t rttUs)
+  {
+    if (rttUs < 0)
+      return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const double rtt = static_cast<double>(rttUs);
+    bool spike = false;
+    if (!hasSample_)
+    {
+      // RFC 6298 2.2: the first measurement seeds both estimates
+      srttUs_ = rtt;
+      rttvarUs_ = rtt / 2;
+      hasSample_ = true;
+    }
+    else
+    {
+      spike = rtt > srttUs_ + 4 * rttvarUs_;
+      rttvarUs_ += (std::fabs(srttUs_ - rtt) - rttvarUs_) / 4;
+      srttUs_ += (rtt - srttUs_) / 8;
+    }
+
+    const auto srtt = static_cast<int64_t>(srttUs_);
+    const auto rttvar = static_cast<int64_t>(rttvarUs_);
+    publish(classify(srtt, rttvar), srtt, rttvar);
+    return spike;
+  }
+
+  void LinkQuality::reset()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    hasSample_ = false;
+    srttUs_ = 0;
+    rttvarUs_ = 0;
+    publish(LinkState::Unknown, 0, 0);
+  }
+
+  void LinkQuality::publish(LinkState state, int64_t rttUs, int64_t jitterUs)
+  {
+    rttUs_.store(rttUs, std::memory_order_relaxed);
+    jitterUs_.store(jitterUs, std::memory_order_relaxed);
+    state_.store(state, std::memory_order_relaxed);
+
+    metrics().rtt.set(rttUs);
+    metrics().jitter.set(jitterUs);
+    metrics().state.set(static_cast<int64_t>(state));
+  }
+
+}
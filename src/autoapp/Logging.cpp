@@ -0,0 +1,121 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <boost/core/null_deleter.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/sinks/async_frontend.hpp>
+#include <boost/log/sinks/bounded_fifo_queue.hpp>
+#include <boost/log/sinks/drop_on_overflow.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
+#include <boost/log/support/date_time.hpp>
+#include <boost/log/utility/setup.hpp>
+#include <f1x/openauto/autoapp/Logging.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    // Records queued for the sink thread; a burst beyond this is dropped
+    constexpr size_t cQueueDepth = 4096;
+
+    typedef boost::log::sinks::asynchronous_sink<
+        boost::log::sinks::text_ostream_backend,
+        boost::log::sinks::bounded_fifo_queue<cQueueDepth, boost::log::sinks::drop_on_overflow>>
+        ConsoleSink;
+
+    boost::shared_ptr<ConsoleSink> consoleSink;
+
+    void applyLevelFromEnvironment()
+    {
+      const char *level = std::getenv("OPENAUTO_LOG_LEVEL");
+      if (level == nullptr)
+      {
+        return;
+      }
+
+      boost::log::trivial::severity_level threshold;
+      if (boost::log::trivial::from_string(level, std::char_traits<char>::length(level), threshold))
+      {
+        common::logThreshold = threshold;
+      }
+      else
+      {
+        OPENAUTO_LOG(warning) << "[Logging] Unknown OPENAUTO_LOG_LEVEL " << level;
+      }
+    }
+  }
+
+  void Logging::configure(const std::string &iniPath)
+  {
+    std::ifstream settings(iniPath);
+    if (settings.good())
+    {
+      try
+      {
+        // For boost < 1.71 the severity types are not automatically parsed so
+        // lets register them.
+        boost::log::register_simple_filter_factory<boost::log::trivial::severity_level>("Severity");
+        boost::log::register_simple_formatter_factory<boost::log::trivial::severity_level, char>("Severity");
+        boost::log::init_from_stream(settings);
+        applyLevelFromEnvironment();
+        return;
+      }
+      catch (std::exception const &e)
+      {
+        OPENAUTO_LOG(warning) << "[Logging] " << iniPath << " was provided but was not valid.";
+      }
+    }
+
+    namespace expr = boost::log::expressions;
+    auto backend = boost::make_shared<boost::log::sinks::text_ostream_backend>();
+    backend->add_stream(boost::shared_ptr<std::ostream>(&std::clog, boost::null_deleter()));
+    backend->auto_flush(true);
+
+    consoleSink = boost::make_shared<ConsoleSink>(backend);
+    // Same layout as Boost.Log's default sink
+    consoleSink->set_formatter(
+        expr::stream << "[" << expr::format_date_time<boost::posix_time::ptime>("TimeStamp", "%Y-%m-%d %H:%M:%S.%f")
+                     << "] [" << expr::attr<boost::log::attributes::current_thread_id::value_type>("ThreadID")
+                     << "] [" << boost::log::trivial::severity << "] " << expr::smessage);
+
+    boost::log::add_common_attributes();
+    boost::log::core::get()->add_sink(consoleSink);
+    applyLevelFromEnvironment();
+  }
+
+  void Logging::shutdown()
+  {
+    if (!consoleSink)
+    {
+      return;
+    }
+
+    boost::log::core::get()->remove_sink(consoleSink);
+    consoleSink->stop();
+    consoleSink->flush();
+    consoleSink.reset();
+  }
+
+}
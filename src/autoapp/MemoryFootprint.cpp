@@ -0,0 +1,171 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <fstream>
+#include <sstream>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+
+            namespace
+            {
+                std::string megabytes(int64_t bytes)
+                {
+                    std::ostringstream out;
+                    out.setf(std::ios::fixed);
+                    out.precision(1);
+                    out << bytes / (1024.0 * 1024.0) << " MB";
+                    return out.str();
+                }
+
+                bool detectLowMemory()
+                {
+#ifdef OPENAUTO_LOW_MEMORY
+                    return true;
+#else
+                    std::ifstream meminfo("/proc/meminfo");
+                    const int64_t total = meminfo ? MemoryFootprint::parseMemTotal(meminfo) : -1;
+                    return total > 0 && total <= MemoryFootprint::cLowMemoryTotalBytes;
+#endif
+                }
+            }
+
+            const char *memoryPoolName(MemoryPool pool)
+            {
+                switch (pool)
+                {
+                case MemoryPool::Audio:
+                    return "audio";
+                case MemoryPool::Video:
+                    return "video";
+                case MemoryPool::Count:
+                    break;
+                }
+                return "unknown";
+            }
+
+            MemoryFootprint &MemoryFootprint::instance()
+            {
+                static MemoryFootprint footprint;
+                return footprint;
+            }
+
+            MemoryFootprint::MemoryFootprint()
+                : lowMemory_(detectLowMemory()),
+                  resident_(&Metrics::instance().gauge("openauto_memory_resident_bytes",
+                                                       "Resident memory of the process (VmRSS)"))
+            {
+                for (size_t i = 0; i < gauges_.size(); i++)
+                {
+                    const std::string name = memoryPoolName(static_cast<MemoryPool>(i));
+                    gauges_[i] = &Metrics::instance().gauge("openauto_memory_" + name + "_bytes",
+                                                            "Bytes allocated for " + name + " buffers");
+                }
+            }
+
+            int64_t MemoryFootprint::parseMemTotal(std::istream &in)
+            {
+                std::string line;
+                while (std::getline(in, line))
+                {
+                    std::istringstream fields(line);
+                    std::string key;
+                    int64_t value = 0;
+                    // Values are in kB
+                    if (fields >> key >> value && key == "MemTotal:")
+                        return value * 1024;
+                }
+                return -1;
+            }
+
+            ProcessMemory MemoryFootprint::parseStatus(std::istream &in)
+            {
+                ProcessMemory memory;
+                std::string line;
+                while (std::getline(in, line))
+                {
+                    std::istringstream fields(line);
+                    std::string key;
+                    int64_t value = 0;
+                    if (!(fields >> key >> value))
+                        continue;
+                    if (key == "VmRSS:")
+                        memory.residentBytes = value * 1024;
+                    else if (key == "RssAnon:")
+                        memory.anonymousBytes = value * 1024;
+                }
+                return memory;
+            }
+
+            size_t MemoryFootprint::bufferBytes(uint64_t bytesPerSecond, uint32_t ms, uint32_t lowMemoryMs) const
+            {
+                return static_cast<size_t>(bytesPerSecond * (lowMemory_ ? lowMemoryMs : ms) / 1000);
+            }
+
+            void MemoryFootprint::add(MemoryPool pool, int64_t bytes)
+            {
+                const size_t index = static_cast<size_t>(pool);
+                allocated_[index].fetch_add(bytes, std::memory_order_relaxed);
+                gauges_[index]->add(bytes);
+            }
+
+            void MemoryFootprint::release(MemoryPool pool, int64_t bytes)
+            {
+                add(pool, -bytes);
+            }
+
+            int64_t MemoryFootprint::allocatedBytes(MemoryPool pool) const
+            {
+                return allocated_[static_cast<size_t>(pool)].load(std::memory_order_relaxed);
+            }
+
+            ProcessMemory MemoryFootprint::process() const
+            {
+                std::ifstream status("/proc/self/status");
+                const ProcessMemory memory = status ? parseStatus(status) : ProcessMemory();
+                if (memory.residentBytes >= 0)
+                    resident_->set(memory.residentBytes);
+                return memory;
+            }
+
+            std::string MemoryFootprint::summary() const
+            {
+                const ProcessMemory memory = process();
+                std::ostringstream out;
+                out << (lowMemory_ ? "Low-memory profile, resident " : "Resident ")
+                    << (memory.residentBytes >= 0 ? megabytes(memory.residentBytes) : "unknown");
+                if (memory.anonymousBytes >= 0)
+                    out << " (anonymous " << megabytes(memory.anonymousBytes) << ")";
+                for (size_t i = 0; i < allocated_.size(); i++)
+                {
+                    out << ", " << memoryPoolName(static_cast<MemoryPool>(i)) << " buffers "
+                        << megabytes(allocated_[i].load(std::memory_order_relaxed));
+                }
+                return out.str();
+            }
+
+        }
+    }
+}
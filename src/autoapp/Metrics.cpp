@@ -0,0 +1,245 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    // Locale-independent, and short enough for the overlay
+    std::string number(double value)
+    {
+      char buffer[32];
+      std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+      return buffer;
+    }
+
+    std::vector<double> sorted(std::vector<double> bounds)
+    {
+      std::sort(bounds.begin(), bounds.end());
+      bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+      return bounds;
+    }
+  }
+
+  MetricHistogram::MetricHistogram(std::vector<double> bounds)
+      : bounds_(sorted(std::move(bounds))),
+        counts_(new std::atomic<uint64_t>[bounds_.size() + 1])
+  {
+    for (size_t i = 0; i <= bounds_.size(); ++i)
+      counts_[i].store(0, std::memory_order_relaxed);
+  }
+
+  void MetricHistogram::observe(double value)
+  {
+    const size_t bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+    counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    double sum = sum_.load(std::memory_order_relaxed);
+    while (!sum_.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  std::vector<uint64_t> MetricHistogram::counts() const
+  {
+    std::vector<uint64_t> result(bounds_.size() + 1);
+    for (size_t i = 0; i < result.size(); ++i)
+      result[i] = counts_[i].load(std::memory_order_relaxed);
+    return result;
+  }
+
+  uint64_t MetricHistogram::count() const
+  {
+    uint64_t total = 0;
+    for (size_t i = 0; i <= bounds_.size(); ++i)
+      total += counts_[i].load(std::memory_order_relaxed);
+    return total;
+  }
+
+  double MetricHistogram::sum() const
+  {
+    return sum_.load(std::memory_order_relaxed);
+  }
+
+  double MetricHistogram::quantile(double q) const
+  {
+    const auto buckets = counts();
+    uint64_t total = 0;
+    for (auto n : buckets)
+      total += n;
+    if (total == 0)
+      return 0.0;
+
+    const auto rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bounds_.size(); ++i)
+    {
+      seen += buckets[i];
+      if (seen >= rank)
+        return bounds_[i];
+    }
+    // Beyond the last bound: the best we can say is "more than that"
+    return bounds_.empty() ? 0.0 : bounds_.back();
+  }
+
+  Metrics &Metrics::instance()
+  {
+    static Metrics metrics;
+    return metrics;
+  }
+
+  Metrics::Entry &Metrics::entry(const std::string &name, Type type, const std::string &help)
+  {
+    auto &entry = entries_[name];
+    if (entry.counter == nullptr && entry.gauge == nullptr && entry.histogram == nullptr)
+    {
+      entry.type = type;
+      entry.help = help;
+    }
+    else if (entry.type != type)
+    {
+      throw std::logic_error("metric " + name + " registered with two types");
+    }
+    return entry;
+  }
+
+  MetricCounter &Metrics::counter(const std::string &name, const std::string &help)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &e = entry(name, Type::Counter, help);
+    if (e.counter == nullptr)
+      e.counter = std::make_unique<MetricCounter>();
+    return *e.counter;
+  }
+
+  MetricGauge &Metrics::gauge(const std::string &name, const std::string &help)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &e = entry(name, Type::Gauge, help);
+    if (e.gauge == nullptr)
+      e.gauge = std::make_unique<MetricGauge>();
+    return *e.gauge;
+  }
+
+  MetricHistogram &Metrics::histogram(const std::string &name, const std::string &help, std::vector<double> bounds)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &e = entry(name, Type::Histogram, help);
+    if (e.histogram == nullptr)
+      e.histogram = std::make_unique<MetricHistogram>(std::move(bounds));
+    return *e.histogram;
+  }
+
+  std::string Metrics::prometheusText() const
+  {
+    std::ostringstream out;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &[name, e] : entries_)
+    {
+      out << "# HELP " << name << ' ' << e.help << '\n';
+      switch (e.type)
+      {
+      case Type::Counter:
+        out << "# TYPE " << name << " counter\n"
+            << name << ' ' << e.counter->value() << '\n';
+        break;
+      case Type::Gauge:
+        out << "# TYPE " << name << " gauge\n"
+            << name << ' ' << e.gauge->value() << '\n';
+        break;
+      case Type::Histogram:
+      {
+        out << "# TYPE " << name << " histogram\n";
+        const auto &bounds = e.histogram->bounds();
+        const auto buckets = e.histogram->counts();
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < bounds.size(); ++i)
+        {
+          cumulative += buckets[i];
+          out << name << "_bucket{le=\"" << number(bounds[i]) << "\"} " << cumulative << '\n';
+        }
+        cumulative += buckets.back();
+        out << name << "_bucket{le=\"+Inf\"} " << cumulative << '\n'
+            << name << "_sum " << number(e.histogram->sum()) << '\n'
+            << name << "_count " << cumulative << '\n';
+        break;
+      }
+      }
+    }
+    return out.str();
+  }
+
+  std::vector<Metrics::Sample> Metrics::snapshot() const
+  {
+    std::vector<Sample> samples;
+    std::lock_guard<std::mutex> lock(mutex_);
+    samples.reserve(entries_.size());
+    for (const auto &[name, e] : entries_)
+    {
+      switch (e.type)
+      {
+      case Type::Counter:
+        samples.push_back({name, e.type, static_cast<double>(e.counter->value()), 0});
+        break;
+      case Type::Gauge:
+        samples.push_back({name, e.type, static_cast<double>(e.gauge->value()), 0});
+        break;
+      case Type::Histogram:
+        samples.push_back({name, e.type, e.histogram->sum(), e.histogram->count()});
+        break;
+      }
+    }
+    return samples;
+  }
+
+  std::string Metrics::summary() const
+  {
+    std::ostringstream out;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &[name, e] : entries_)
+    {
+      // The openauto_ prefix only costs overlay width
+      out << (name.rfind("openauto_", 0) == 0 ? name.substr(9) : name) << ' ';
+      switch (e.type)
+      {
+      case Type::Counter:
+        out << e.counter->value();
+        break;
+      case Type::Gauge:
+        out << e.gauge->value();
+        break;
+      case Type::Histogram:
+        out << "p50<=" << number(e.histogram->quantile(0.5))
+            << " p99<=" << number(e.histogram->quantile(0.99))
+            << " n=" << e.histogram->count();
+        break;
+      }
+      out << '\n';
+    }
+    return out.str();
+  }
+
+}
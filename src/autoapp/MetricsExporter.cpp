@@ -0,0 +1,278 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/MetricsExporter.hpp>
+#include <f1x/openauto/autoapp/Projection/FrameGrabber.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  MetricsExporter::MetricsExporter(boost::asio::io_service &ioService, uint16_t httpPort, std::string statsdTarget)
+      : ioService_(ioService), strand_(ioService), httpPort_(httpPort), statsdTarget_(std::move(statsdTarget)),
+        acceptor_(ioService), statsdSocket_(ioService), statsdTimer_(ioService), stopped_(false)
+  {
+  }
+
+  void MetricsExporter::start()
+  {
+    strand_.dispatch([this, self = this->shared_from_this()]()
+                     {
+      boost::system::error_code ec;
+      if (httpPort_ != 0)
+      {
+        const boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::tcp::v4(), httpPort_);
+        acceptor_.open(endpoint.protocol(), ec);
+        if (!ec)
+          acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
+        if (!ec)
+          acceptor_.bind(endpoint, ec);
+        if (!ec)
+          acceptor_.listen(boost::asio::socket_base::max_connections, ec);
+
+        if (ec)
+        {
+          OPENAUTO_LOG(error) << "[MetricsExporter] Cannot listen on port " << httpPort_ << ": " << ec.message();
+          acceptor_.close(ec);
+        }
+        else
+        {
+          OPENAUTO_LOG(info) << "[MetricsExporter] Serving /metrics on port " << httpPort_;
+          this->accept();
+        }
+      }
+
+      if (!statsdTarget_.empty())
+      {
+        const auto colon = statsdTarget_.rfind(':');
+        const std::string host = statsdTarget_.substr(0, colon);
+        const std::string port = colon == std::string::npos ? "8125" : statsdTarget_.substr(colon + 1);
+
+        // Resolved once: the collector is expected to sit at a fixed address
+        boost::asio::ip::udp::resolver resolver(ioService_);
+        const auto results = resolver.resolve(boost::asio::ip::udp::resolver::query(boost::asio::ip::udp::v4(), host, port), ec);
+        if (!ec && results != boost::asio::ip::udp::resolver::iterator())
+        {
+          statsdEndpoint_ = *results;
+          statsdSocket_.open(boost::asio::ip::udp::v4(), ec);
+        }
+
+        if (ec)
+        {
+          OPENAUTO_LOG(error) << "[MetricsExporter] Cannot reach StatsD at " << statsdTarget_ << ": " << ec.message();
+        }
+        else
+        {
+          OPENAUTO_LOG(info) << "[MetricsExporter] Pushing to StatsD at " << statsdEndpoint_;
+          this->scheduleStatsd();
+        }
+      } });
+  }
+
+  void MetricsExporter::stop()
+  {
+    strand_.dispatch([this, self = this->shared_from_this()]()
+                     {
+      stopped_ = true;
+      boost::system::error_code ec;
+      acceptor_.close(ec);
+      statsdTimer_.cancel();
+      statsdSocket_.close(ec); });
+  }
+
+  void MetricsExporter::accept()
+  {
+    auto socket = std::make_shared<boost::asio::ip::tcp::socket>(ioService_);
+    acceptor_.async_accept(*socket, strand_.wrap([this, self = this->shared_from_this(), socket](const boost::system::error_code &ec)
+                                                 {
+      if (ec == boost::asio::error::operation_aborted || stopped_)
+        return;
+      if (!ec)
+        this->serve(socket);
+      this->accept(); }));
+  }
+
+  void MetricsExporter::serve(std::shared_ptr<boost::asio::ip::tcp::socket> socket)
+  {
+    // A client that never finishes its request must not hold the socket forever
+    auto deadline = std::make_shared<boost::asio::steady_timer>(ioService_);
+    deadline->expires_from_now(std::chrono::milliseconds(cRequestTimeoutMs));
+    deadline->async_wait([socket](const boost::system::error_code &ec)
+                         {
+      if (!ec)
+      {
+        boost::system::error_code ignored;
+        socket->close(ignored);
+      } });
+
+    auto request = std::make_shared<boost::asio::streambuf>(cMaxRequestSize);
+    boost::asio::async_read_until(*socket, *request, "\r\n\r\n",
+                                  [this, self = this->shared_from_this(), socket, request, deadline](const boost::system::error_code &ec, size_t)
+                                  {
+      deadline->cancel();
+      if (ec)
+        return;
+
+      std::istream in(request.get());
+      std::string method, target;
+      in >> method >> target;
+
+      if (method == "GET" && (target == "/frame.jpg" || target.rfind("/frame.jpg?", 0) == 0))
+      {
+        this->serveFrame(socket, target);
+        return;
+      }
+
+      auto response = std::make_shared<std::string>();
+      if (method == "GET" && (target == "/metrics" || target.rfind("/metrics?", 0) == 0))
+      {
+        // Resident memory is sampled per scrape rather than on a timer
+        MemoryFootprint::instance().process();
+        const std::string body = Metrics::instance().prometheusText();
+        *response = "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                    "Connection: close\r\n\r\n" + body;
+      }
+      else
+      {
+        *response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+      }
+
+      boost::asio::async_write(*socket, boost::asio::buffer(*response),
+                               [socket, response](const boost::system::error_code &, size_t)
+                               {
+        boost::system::error_code ignored;
+        socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+        socket->close(ignored); }); });
+  }
+
+  void MetricsExporter::serveFrame(std::shared_ptr<boost::asio::ip::tcp::socket> socket, const std::string &target)
+  {
+    // /frame.jpg?width=N; the grab and the encoding stay off the io_service
+    uint32_t width = projection::FrameGrabber::cDefaultWidth;
+    const auto query = target.find("width=");
+    if (query != std::string::npos)
+      width = static_cast<uint32_t>(std::strtoul(target.c_str() + query + 6, nullptr, 10));
+
+    const auto respond = [this, self = this->shared_from_this(), socket](const projection::FrameGrabber::Snapshot &snapshot)
+    {
+      auto response = std::make_shared<std::string>();
+      if (snapshot.jpeg.empty())
+      {
+        *response = "HTTP/1.1 503 Service Unavailable\r\n"
+                    "Content-Type: text/plain\r\n"
+                    "Content-Length: " + std::to_string(snapshot.error.size()) + "\r\n"
+                    "Connection: close\r\n\r\n" + snapshot.error;
+      }
+      else
+      {
+        *response = "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: image/jpeg\r\n"
+                    "Content-Length: " + std::to_string(snapshot.jpeg.size()) + "\r\n"
+                    "Cache-Control: no-store\r\n"
+                    "Connection: close\r\n\r\n";
+        response->append(snapshot.jpeg.begin(), snapshot.jpeg.end());
+      }
+      strand_.post([socket, response]()
+                   { boost::asio::async_write(*socket, boost::asio::buffer(*response),
+                                              [socket, response](const boost::system::error_code &, size_t)
+                                              {
+                     boost::system::error_code ignored;
+                     socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+                     socket->close(ignored); }); });
+    };
+
+    if (!projection::FrameGrabber::instance().grab(respond, std::min<uint32_t>(std::max<uint32_t>(width, 16), cMaxFrameWidth)))
+    {
+      projection::FrameGrabber::Snapshot busy;
+      busy.error = "snapshot queue full";
+      respond(busy);
+    }
+  }
+
+  void MetricsExporter::scheduleStatsd()
+  {
+    statsdTimer_.expires_from_now(std::chrono::milliseconds(cStatsdIntervalMs));
+    statsdTimer_.async_wait(strand_.wrap([this, self = this->shared_from_this()](const boost::system::error_code &ec)
+                                         {
+      if (ec == boost::asio::error::operation_aborted || stopped_)
+        return;
+      this->pushStatsd();
+      this->scheduleStatsd(); }));
+  }
+
+  void MetricsExporter::pushStatsd()
+  {
+    std::string datagram;
+    const auto send = [this, &datagram]()
+    {
+      if (datagram.empty())
+        return;
+      boost::system::error_code ec;
+      // Fire and forget: a missing collector must not stall anything
+      statsdSocket_.send_to(boost::asio::buffer(datagram), statsdEndpoint_, 0, ec);
+      datagram.clear();
+    };
+    const auto append = [&datagram, &send](const std::string &line)
+    {
+      if (datagram.size() + line.size() + 1 > cMaxDatagramSize)
+        send();
+      if (!datagram.empty())
+        datagram += '\n';
+      datagram += line;
+    };
+
+    char value[32];
+    for (const auto &sample : Metrics::instance().snapshot())
+    {
+      auto &last = lastPushed_[sample.name];
+      switch (sample.type)
+      {
+      case Metrics::Type::Counter:
+        std::snprintf(value, sizeof(value), "%.0f", sample.value - last.first);
+        append(sample.name + ':' + value + "|c");
+        break;
+      case Metrics::Type::Gauge:
+        std::snprintf(value, sizeof(value), "%.0f", sample.value);
+        append(sample.name + ':' + value + "|g");
+        break;
+      case Metrics::Type::Histogram:
+      {
+        const uint64_t observations = sample.count - last.second;
+        append(sample.name + ".count:" + std::to_string(observations) + "|c");
+        if (observations > 0)
+        {
+          std::snprintf(value, sizeof(value), "%.3f", (sample.value - last.first) / observations);
+          append(sample.name + ".avg:" + value + "|g");
+        }
+        break;
+      }
+      }
+      last = {sample.value, sample.count};
+    }
+    send();
+  }
+
+}
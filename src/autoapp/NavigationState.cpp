@@ -0,0 +1,212 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/NavigationState.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    // Road names are free text: the separators are escaped away
+    std::string escaped(const std::string &text)
+    {
+      // Cut at a character boundary, not inside a UTF-8 sequence
+      size_t length = std::min(text.size(), NavigationState::cMaxRoadLength);
+      while (length < text.size() && length > 0 && (static_cast<uint8_t>(text[length]) & 0xc0) == 0x80)
+      {
+        length--;
+      }
+
+      std::string result;
+      for (const char c : text.substr(0, length))
+      {
+        if (c == ';' || c == '=' || c == '\\' || c == '\n')
+        {
+          result += '\\';
+          result += c == '\n' ? 'n' : c;
+        }
+        else
+        {
+          result += c;
+        }
+      }
+      return result;
+    }
+
+    bool toInt(const std::string &text, int32_t &value)
+    {
+      if (text.empty())
+      {
+        return false;
+      }
+      char *end = nullptr;
+      const long parsed = std::strtol(text.c_str(), &end, 10);
+      if (*end != '\0')
+      {
+        return false;
+      }
+      value = static_cast<int32_t>(parsed);
+      return true;
+    }
+  }
+
+  std::string NavigationState::displayDistance() const
+  {
+    if (displayDistanceE3 >= 0)
+    {
+      // Tenths units and anything under 10 keep one decimal, as the phone does
+      const bool tenths = displayUnit == Unit::KilometersTenths || displayUnit == Unit::MilesTenths ||
+                          (displayDistanceE3 < 10000 && displayDistanceE3 % 1000 != 0);
+      char text[16];
+      if (tenths)
+      {
+        snprintf(text, sizeof(text), "%d.%d", displayDistanceE3 / 1000, (displayDistanceE3 % 1000) / 100);
+      }
+      else
+      {
+        snprintf(text, sizeof(text), "%d", (displayDistanceE3 + 500) / 1000);
+      }
+      return text;
+    }
+    if (distanceMeters >= 0)
+    {
+      char text[16];
+      if (distanceMeters >= 1000)
+      {
+        snprintf(text, sizeof(text), "%d.%d", distanceMeters / 1000, (distanceMeters % 1000) / 100);
+      }
+      else
+      {
+        snprintf(text, sizeof(text), "%d", distanceMeters);
+      }
+      return text;
+    }
+    return std::string();
+  }
+
+  const char *NavigationState::displayUnitName() const
+  {
+    switch (displayDistanceE3 >= 0 ? displayUnit : Unit::Unknown)
+    {
+    case Unit::Meters:
+      return "m";
+    case Unit::Kilometers:
+    case Unit::KilometersTenths:
+      return "km";
+    case Unit::Miles:
+    case Unit::MilesTenths:
+      return "mi";
+    case Unit::Feet:
+      return "ft";
+    case Unit::Yards:
+      return "yd";
+    default:
+      return distanceMeters >= 1000 ? "km" : "m";
+    }
+  }
+
+  std::string NavigationState::serialize() const
+  {
+    std::ostringstream out;
+    out << "nav=1;status=" << static_cast<int>(status) << ";maneuver=" << static_cast<int>(maneuver)
+        << ";side=" << static_cast<int>(side) << ";exit=" << roundaboutExit << ";angle=" << turnAngle
+        << ";meters=" << distanceMeters << ";seconds=" << timeToTurnSeconds << ";display=" << displayDistanceE3
+        << ";unit=" << static_cast<int>(displayUnit) << ";road=" << escaped(road);
+    return out.str();
+  }
+
+  bool NavigationState::parse(const std::string &text, NavigationState &state)
+  {
+    state = NavigationState();
+    bool valid = false;
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+      // One key=value pair, honouring escapes in the value
+      const size_t equals = text.find('=', pos);
+      if (equals == std::string::npos)
+      {
+        break;
+      }
+      const std::string key = text.substr(pos, equals - pos);
+      std::string value;
+      pos = equals + 1;
+      while (pos < text.size() && text[pos] != ';')
+      {
+        if (text[pos] == '\\' && pos + 1 < text.size())
+        {
+          pos++;
+          value += text[pos] == 'n' ? '\n' : text[pos];
+        }
+        else
+        {
+          value += text[pos];
+        }
+        pos++;
+      }
+      pos++;
+
+      int32_t number = 0;
+      if (key == "nav")
+      {
+        valid = value == "1";
+      }
+      else if (key == "road")
+      {
+        state.road = value;
+      }
+      else if (toInt(value, number))
+      {
+        if (key == "status")
+          state.status = static_cast<Status>(number);
+        else if (key == "maneuver")
+          state.maneuver = static_cast<Maneuver>(number);
+        else if (key == "side")
+          state.side = static_cast<Side>(number);
+        else if (key == "exit")
+          state.roundaboutExit = number;
+        else if (key == "angle")
+          state.turnAngle = number;
+        else if (key == "meters")
+          state.distanceMeters = number;
+        else if (key == "seconds")
+          state.timeToTurnSeconds = number;
+        else if (key == "display")
+          state.displayDistanceE3 = number;
+        else if (key == "unit")
+          state.displayUnit = static_cast<Unit>(number);
+      }
+    }
+    return valid;
+  }
+
+  bool NavigationState::operator==(const NavigationState &other) const
+  {
+    return status == other.status && maneuver == other.maneuver && side == other.side &&
+           roundaboutExit == other.roundaboutExit && turnAngle == other.turnAngle && road == other.road &&
+           distanceMeters == other.distanceMeters && timeToTurnSeconds == other.timeToTurnSeconds &&
+           displayDistanceE3 == other.displayDistanceE3 && displayUnit == other.displayUnit;
+  }
+
+}
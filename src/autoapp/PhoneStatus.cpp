@@ -0,0 +1,153 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/autoapp/PhoneStatus.hpp>
+#include <f1x/openauto/autoapp/StateBus.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    std::mutex snapshotMutex;
+    PhoneStatus snapshot;
+    std::string published;
+
+    // Caller IDs are free text: the line ends at the first control character
+    std::string printable(const std::string &text)
+    {
+      std::string result;
+      for (const char c : text)
+      {
+        if (static_cast<uint8_t>(c) < 0x20)
+        {
+          break;
+        }
+        result += c;
+      }
+
+      // Cut at a character boundary, not inside a UTF-8 sequence
+      size_t length = std::min(result.size(), PhoneStatus::cMaxCallerLength);
+      while (length < result.size() && length > 0 && (static_cast<uint8_t>(result[length]) & 0xc0) == 0x80)
+      {
+        length--;
+      }
+      return result.substr(0, length);
+    }
+  }
+
+  bool PhoneStatus::inCall() const
+  {
+    return call != Call::None && call != Call::Inactive;
+  }
+
+  uint32_t PhoneStatus::diff(const PhoneStatus &other) const
+  {
+    uint32_t fields = 0;
+    if (signalStrength != other.signalStrength)
+    {
+      fields |= Signal;
+    }
+    if (batteryLevel != other.batteryLevel || batteryCritical != other.batteryCritical)
+    {
+      fields |= Battery;
+    }
+    if (call != other.call || caller != other.caller)
+    {
+      fields |= CallState;
+    }
+    return fields;
+  }
+
+  std::string PhoneStatus::serialize() const
+  {
+    char numbers[64];
+    snprintf(numbers, sizeof(numbers), "%d,%d,%d,%d,", signalStrength, batteryLevel, batteryCritical ? 1 : 0,
+             static_cast<int>(call));
+    return numbers + printable(caller);
+  }
+
+  bool PhoneStatus::parse(const std::string &text, PhoneStatus &status)
+  {
+    status = PhoneStatus();
+    int32_t values[4];
+    const char *pos = text.c_str();
+    for (auto &value : values)
+    {
+      char *end = nullptr;
+      const long parsed = std::strtol(pos, &end, 10);
+      if (end == pos || *end != ',')
+      {
+        return false;
+      }
+      value = static_cast<int32_t>(parsed);
+      pos = end + 1;
+    }
+
+    status.signalStrength = values[0];
+    status.batteryLevel = values[1];
+    status.batteryCritical = values[2] != 0;
+    status.call = static_cast<Call>(values[3]);
+    status.caller = pos;
+    return true;
+  }
+
+  void PhoneStatus::update(uint32_t fields, const PhoneStatus &from)
+  {
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    if (fields & Signal)
+    {
+      snapshot.signalStrength = from.signalStrength;
+    }
+    if (fields & Battery)
+    {
+      snapshot.batteryLevel = from.batteryLevel;
+      snapshot.batteryCritical = from.batteryCritical;
+    }
+    if (fields & CallState)
+    {
+      snapshot.call = from.call;
+      snapshot.caller = printable(from.caller);
+    }
+
+    // The bus drops unchanged values, but each set() still writes the file
+    const std::string line = snapshot.serialize();
+    if (line == published)
+    {
+      return;
+    }
+    published = line;
+    StateBus::instance().set(StateFlag::PhoneStatus, line);
+  }
+
+  void PhoneStatus::reset()
+  {
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    snapshot = PhoneStatus();
+    if (!published.empty())
+    {
+      published.clear();
+      StateBus::instance().clear(StateFlag::PhoneStatus);
+    }
+  }
+
+}
@@ -0,0 +1,206 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/PipelineTrace.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  struct PipelineTrace::ThreadRing
+  {
+    pthread_t thread = pthread_self();
+    long tid = syscall(SYS_gettid);
+    char name[16] = {};
+    bool released = false;
+    std::atomic<uint64_t> epoch{0};
+    // Events ever written in this epoch; the ring holds the last cEventsPerThread
+    std::atomic<uint64_t> written{0};
+    std::vector<Event> events = std::vector<Event>(cEventsPerThread);
+  };
+
+  // Hands the ring back when its thread exits
+  struct PipelineTrace::RingHolder
+  {
+    ThreadRing *ring = nullptr;
+
+    ~RingHolder()
+    {
+      if (ring != nullptr)
+        PipelineTrace::instance().release(ring);
+    }
+  };
+
+  namespace
+  {
+    // Names are literals from the call sites; only the unusual need escaping
+    void writeString(std::ostream &out, const char *text)
+    {
+      out << '"';
+      for (const char *c = text; *c != '\0'; ++c)
+      {
+        if (*c == '"' || *c == '\\')
+          out << '\\';
+        if (static_cast<unsigned char>(*c) >= 0x20)
+          out << *c;
+      }
+      out << '"';
+    }
+
+    // Chrome traces count in microseconds; three decimals keep the nanoseconds
+    void writeMicros(std::ostream &out, int64_t ns)
+    {
+      out << ns / 1000 << '.' << static_cast<char>('0' + ns / 100 % 10)
+          << static_cast<char>('0' + ns / 10 % 10) << static_cast<char>('0' + ns % 10);
+    }
+  }
+
+  PipelineTrace &PipelineTrace::instance()
+  {
+    static PipelineTrace trace;
+    return trace;
+  }
+
+  int64_t PipelineTrace::nowNs()
+  {
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+  }
+
+  void PipelineTrace::start()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      // Threads gone since the last trace have nothing left to show
+      for (auto it = rings_.begin(); it != rings_.end();)
+        it = (*it)->released ? rings_.erase(it) : it + 1;
+      epoch_.fetch_add(1, std::memory_order_release);
+    }
+    enabled_.store(true, std::memory_order_relaxed);
+    OPENAUTO_LOG(info) << "[PipelineTrace] Recording";
+  }
+
+  void PipelineTrace::stop()
+  {
+    if (enabled_.exchange(false, std::memory_order_relaxed))
+      OPENAUTO_LOG(info) << "[PipelineTrace] Stopped";
+  }
+
+  PipelineTrace::ThreadRing &PipelineTrace::ring()
+  {
+    thread_local RingHolder holder;
+    if (holder.ring == nullptr)
+    {
+      auto ring = std::make_unique<ThreadRing>();
+      pthread_getname_np(ring->thread, ring->name, sizeof(ring->name));
+      holder.ring = ring.get();
+      std::lock_guard<std::mutex> lock(mutex_);
+      rings_.push_back(std::move(ring));
+    }
+    return *holder.ring;
+  }
+
+  void PipelineTrace::release(ThreadRing *ring)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ring->released = true;
+  }
+
+  void PipelineTrace::record(const char *name, int64_t startNs, int64_t endNs)
+  {
+    ThreadRing &ring = this->ring();
+    const uint64_t epoch = epoch_.load(std::memory_order_acquire);
+    uint64_t written = ring.written.load(std::memory_order_relaxed);
+    if (ring.epoch.load(std::memory_order_relaxed) != epoch)
+    {
+      written = 0;
+      ring.epoch.store(epoch, std::memory_order_relaxed);
+    }
+    ring.events[written % cEventsPerThread] = Event{name, startNs, endNs - startNs};
+    ring.written.store(written + 1, std::memory_order_release);
+  }
+
+  size_t PipelineTrace::dump(std::ostream &out)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t epoch = epoch_.load(std::memory_order_acquire);
+    const long pid = getpid();
+    size_t count = 0;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto &ring : rings_)
+    {
+      const uint64_t written = ring->written.load(std::memory_order_acquire);
+      if (ring->epoch.load(std::memory_order_relaxed) != epoch || written == 0)
+        continue;
+
+      // Threads name themselves after their first event, e.g. on ThreadTopology::apply()
+      if (!ring->released)
+        pthread_getname_np(ring->thread, ring->name, sizeof(ring->name));
+      out << (first ? "" : ",") << "\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+          << ",\"tid\":" << ring->tid << ",\"args\":{\"name\":";
+      writeString(out, ring->name[0] != '\0' ? ring->name : "thread");
+      out << "}}";
+      first = false;
+
+      const uint64_t kept = std::min<uint64_t>(written, cEventsPerThread);
+      for (uint64_t i = written - kept; i < written; ++i)
+      {
+        const Event &event = ring->events[i % cEventsPerThread];
+        out << ",\n{\"ph\":\"X\",\"name\":";
+        writeString(out, event.name);
+        out << ",\"pid\":" << pid << ",\"tid\":" << ring->tid << ",\"ts\":";
+        writeMicros(out, event.startNs);
+        out << ",\"dur\":";
+        writeMicros(out, event.durationNs);
+        out << '}';
+        ++count;
+      }
+    }
+    out << "\n]}\n";
+    return count;
+  }
+
+  bool PipelineTrace::dump(const std::string &path)
+  {
+    std::ofstream out(path);
+    if (!out)
+    {
+      OPENAUTO_LOG(error) << "[PipelineTrace] Cannot write " << path;
+      return false;
+    }
+    const size_t count = this->dump(static_cast<std::ostream &>(out));
+    out.close();
+    if (!out)
+    {
+      OPENAUTO_LOG(error) << "[PipelineTrace] Cannot write " << path;
+      return false;
+    }
+    OPENAUTO_LOG(info) << "[PipelineTrace] " << count << " events written to " << path;
+    return true;
+  }
+
+}
@@ -0,0 +1,176 @@
+/*
+ *  ArtCache - Content-addressed cache of album art thumbnails
+ */
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QBuffer>
+#include <QImage>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <f1x/openauto/autoapp/Player/ArtCache.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+#include <taglib/fileref.h>
+#include <taglib/mpegfile.h>
+#include <taglib/flacfile.h>
+#include <taglib/id3v2tag.h>
+#include <taglib/id3v2frame.h>
+#include <taglib/attachedpictureframe.h>
+#include <taglib/flacpicture.h>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                ArtCache::ArtCache(QObject *parent)
+                    : QObject(parent), directory_(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/art"),
+                      worker_(new QThread(this)), workerContext_(new QObject())
+                {
+                    QDir().mkpath(directory_);
+                    workerContext_->moveToThread(worker_);
+                    worker_->setObjectName("oa-artcache");
+                    worker_->start(QThread::LowPriority);
+                }
+
+                ArtCache::~ArtCache()
+                {
+                    worker_->quit();
+                    worker_->wait();
+                    delete workerContext_;
+                }
+
+                QString ArtCache::thumbnailPath(const QString &key, int size) const
+                {
+                    return directory_ + '/' + key + '-' + QString::number(size) + ".jpg";
+                }
+
+                QString ArtCache::url(const QString &key, int size) const
+                {
+                    if (key.isEmpty())
+                        return QString();
+                    const QString path = thumbnailPath(key, size);
+                    return QFileInfo::exists(path) ? "file://" + path : QString();
+                }
+
+                QString ArtCache::folderCover(const QString &dirPath)
+                {
+                    static const QStringList coverNames = {"folder.png", "folder.jpg", "cover.png", "cover.jpg", "front.png", "front.jpg"};
+
+                    const QDir dir(dirPath);
+                    for (const auto &name : coverNames)
+                    {
+                        QFile cover(dir.absoluteFilePath(name));
+                        if (cover.open(QIODevice::ReadOnly))
+                            return store(cover.readAll());
+                    }
+                    return QString();
+                }
+
+                QString ArtCache::embeddedCover(TagLib::File *file)
+                {
+                    if (auto *flacFile = dynamic_cast<TagLib::FLAC::File *>(file))
+                    {
+                        const auto pictures = flacFile->pictureList();
+                        if (!pictures.isEmpty())
+                        {
+                            const auto &data = pictures.front()->data();
+                            return store(QByteArray(data.data(), static_cast<int>(data.size())));
+                        }
+                    }
+                    else if (auto *mpegFile = dynamic_cast<TagLib::MPEG::File *>(file))
+                    {
+                        if (mpegFile->ID3v2Tag())
+                        {
+                            const auto frames = mpegFile->ID3v2Tag()->frameList("APIC");
+                            if (!frames.isEmpty())
+                            {
+                                const auto *picFrame = static_cast<TagLib::ID3v2::AttachedPictureFrame *>(frames.front());
+                                const auto data = picFrame->picture();
+                                return store(QByteArray(data.data(), static_cast<int>(data.size())));
+                            }
+                        }
+                    }
+                    return QString();
+                }
+
+                QString ArtCache::store(const QByteArray &image)
+                {
+                    if (image.isEmpty())
+                        return QString();
+
+                    const QString key = QString::fromLatin1(QCryptographicHash::hash(image, QCryptographicHash::Sha1).toHex());
+                    // The small thumbnail is written last: if it exists, both do
+                    if (QFileInfo::exists(thumbnailPath(key, cListSize)))
+                        return key;
+
+                    QBuffer buffer;
+                    buffer.setData(image);
+                    QImageReader reader(&buffer);
+                    const QSize original = reader.size();
+                    if (original.isValid())
+                    {
+                        // Let the JPEG decoder skip detail we would scale away at
+                        // once; a 3000x3000 cover decodes at a fraction of the cost
+                        reader.setScaledSize(original.scaled(cPlayerSize, cPlayerSize, Qt::KeepAspectRatioByExpanding));
+                    }
+
+                    QImage decoded = reader.read();
+                    if (decoded.isNull())
+                    {
+                        OPENAUTO_LOG(warning) << "[ArtCache] Undecodable picture: " << reader.errorString().toStdString();
+                        return QString();
+                    }
+
+                    // Square crop, as MusicPage fills with PreserveAspectCrop
+                    const QImage scaled = decoded.scaled(cPlayerSize, cPlayerSize, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+                    const QImage large = scaled.copy((scaled.width() - cPlayerSize) / 2, (scaled.height() - cPlayerSize) / 2, cPlayerSize, cPlayerSize);
+                    const QImage small = large.scaled(cListSize, cListSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+                    // Renamed into place: readers never see a partial file, and two
+                    // workers storing the same art just race harmlessly
+                    const auto write = [this, &key](int size, const QImage &thumbnail)
+                    {
+                        QSaveFile out(thumbnailPath(key, size));
+                        if (out.open(QIODevice::WriteOnly) && thumbnail.save(&out, "JPG", cJpegQuality) && out.commit())
+                            return true;
+                        OPENAUTO_LOG(warning) << "[ArtCache] Could not write " << out.fileName().toStdString();
+                        return false;
+                    };
+                    if (!write(cPlayerSize, large) || !write(cListSize, small))
+                        return QString();
+                    return key;
+                }
+
+                void ArtCache::request(const QString &filePath)
+                {
+                    QMetaObject::invokeMethod(workerContext_, [this, filePath]()
+                                              {
+                        QString key = folderCover(QFileInfo(filePath).absolutePath());
+                        if (key.isEmpty())
+                        {
+                            TagLib::FileRef file(filePath.toUtf8().constData(), false);
+                            if (!file.isNull())
+                                key = embeddedCover(file.file());
+                        }
+                        emit artReady(filePath, key); }, Qt::QueuedConnection);
+                }
+
+                void ArtCache::storeLater(const QByteArray &image, quint64 ticket)
+                {
+                    QMetaObject::invokeMethod(workerContext_, [this, image, ticket]()
+                                              { emit pictureStored(ticket, store(image)); }, Qt::QueuedConnection);
+                }
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
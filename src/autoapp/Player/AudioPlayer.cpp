@@ -1,15 +1,30 @@
 /*
  *  AudioPlayer - FFmpeg decode → ALSA output music player
  *  Supports DSD (.dsf/.dff), FLAC, WAV, MP3, AAC, OGG
+ *  Gapless: the next playlist entry is pre-decoded and the ALSA device is
+ *  kept open while the output format stays the same
+ *  Decode runs ahead into a PCM ring; a real-time output thread moves whole
+ *  periods from it to the device as ALSA asks for them
+ *  During an Android Auto session tracks go to the session's audio mixer
  */
 
 #include <QFileInfo>
-#include <QDir>
-#include <QImage>
-#include <QBuffer>
-#include <QStandardPaths>
 #include <f1x/openauto/autoapp/Player/AudioPlayer.hpp>
+#include <f1x/openauto/autoapp/Player/MediaLibrary.hpp>
+#include <f1x/openauto/autoapp/Player/ReadAheadFile.hpp>
+#include <f1x/openauto/autoapp/Player/ArtCache.hpp>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
+#include <f1x/openauto/autoapp/Projection/AudioMixer.hpp>
+#include <f1x/openauto/autoapp/Projection/LockFreeRingBuffer.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
 #include <f1x/openauto/Common/Log.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <poll.h>
 
 extern "C"
 {
@@ -23,13 +38,6 @@ extern "C"
 #include <alsa/asoundlib.h>
 #include <taglib/fileref.h>
 #include <taglib/tag.h>
-#include <taglib/tpropertymap.h>
-#include <taglib/mpegfile.h>
-#include <taglib/flacfile.h>
-#include <taglib/id3v2tag.h>
-#include <taglib/id3v2frame.h>
-#include <taglib/attachedpictureframe.h>
-#include <taglib/flacpicture.h>
 
 namespace f1x
 {
@@ -40,8 +48,880 @@ namespace f1x
             namespace player
             {
 
+                namespace
+                {
+                    // What the DAC accepts; probed once, on the first open
+                    struct DacCaps
+                    {
+                        bool valid = false;
+                        unsigned int minRate = 0;
+                        unsigned int maxRate = 0;
+                        bool s32 = false;
+                        bool s24 = false;
+                    };
+
+                    // Device configuration for one track. Consecutive tracks with
+                    // equal formats play through the same open PCM
+                    struct OutputFormat
+                    {
+                        unsigned int rate = 0;
+                        snd_pcm_format_t alsaFormat = SND_PCM_FORMAT_S16_LE;
+                        AVSampleFormat sampleFormat = AV_SAMPLE_FMT_S16;
+                        int bytesPerSample = 2;
+                        bool nativeOffload = true;
+
+                        bool operator==(const OutputFormat &other) const
+                        {
+                            return rate == other.rate && alsaFormat == other.alsaFormat;
+                        }
+                    };
+
+                    // ========== DAC capability probe + audio offload ==========
+                    // Try to pass native sample rate (up to 192kHz) directly to DAC.
+                    // Only resample if the hardware can't handle the source rate.
+                    OutputFormat chooseFormat(const DacCaps &caps, int srcSampleRate, int bitsPerRawSample)
+                    {
+                        OutputFormat format;
+
+                        // Cap at 192kHz (anything above, e.g. raw DSD bitstream rates, must resample)
+                        unsigned int outSampleRate = static_cast<unsigned int>(std::min(srcSampleRate, 192000));
+
+                        // If DAC can't handle the source rate, downsample to nearest standard rate it supports
+                        if (caps.valid && outSampleRate > caps.maxRate)
+                        {
+                            format.nativeOffload = false;
+                            // Pick highest standard rate the DAC supports
+                            static const unsigned int standardRates[] = {192000, 176400, 96000, 88200, 48000, 44100};
+                            outSampleRate = 44100; // fallback
+                            for (unsigned int sr : standardRates)
+                            {
+                                if (sr <= caps.maxRate && sr >= caps.minRate)
+                                {
+                                    outSampleRate = sr;
+                                    break;
+                                }
+                            }
+                        }
+                        format.rate = outSampleRate;
+
+                        // Best sample format: prefer S32 > S24_3LE > S16 for hi-res content.
+                        // S24_3LE DACs get S32 too; ALSA plug converts
+                        if ((bitsPerRawSample > 16 || outSampleRate > 48000) && (caps.s32 || caps.s24))
+                        {
+                            format.alsaFormat = SND_PCM_FORMAT_S32_LE;
+                            format.sampleFormat = AV_SAMPLE_FMT_S32;
+                            format.bytesPerSample = 4;
+                        }
+                        return format;
+                    }
+
+                    // What the mixer takes: everything is resampled to its rate
+                    OutputFormat mixerFormat()
+                    {
+                        OutputFormat format;
+                        format.rate = projection::AudioMixer::cSampleRate;
+                        format.nativeOffload = false;
+                        return format;
+                    }
+
+                    // 10 ms per write, as an AAP media packet
+                    constexpr int cMixerPeriodFrames = 480;
+                    // A mixer that stopped pulling (device gone) does not hang the decoder
+                    constexpr auto cMixerStallTimeout = std::chrono::milliseconds(500);
+                    // Decoded ahead of the ALSA device, so a slow frame (a large
+                    // FLAC block, a read-ahead refill) is absorbed before it can
+                    // reach the DAC as an xrun
+                    constexpr uint32_t cDecodeAheadMs = 500;
+                    constexpr uint32_t cLowMemoryDecodeAheadMs = 250;
+                }
+
+                // ========== ALSA Output ==========
+                class AudioPlayer::PcmOutput
+                {
+                public:
+                    ~PcmOutput() { close(false); }
+
+                    // Opens the device on first use to probe it; the handle is then
+                    // kept for configure()
+                    const DacCaps &caps()
+                    {
+                        if (!caps_.valid && !handle_)
+                            openDevice();
+                        return caps_;
+                    }
+
+                    // Takes mixer channels from @p factory instead of opening the
+                    // device; only while closed
+                    void setShared(SharedOutputFactory factory)
+                    {
+                        sharedFactory_ = std::move(factory);
+                    }
+
+                    bool isShared() const { return static_cast<bool>(sharedFactory_); }
+
+                    OutputFormat choose(int sourceRate, int bitsPerRawSample)
+                    {
+                        return isShared() ? mixerFormat() : chooseFormat(caps(), sourceRate, bitsPerRawSample);
+                    }
+
+                    bool configure(const OutputFormat &format)
+                    {
+                        if (configured_ && format == format_)
+                        {
+                            OPENAUTO_LOG(debug) << "[AudioPlayer] Same output format, keeping ALSA device open";
+                            return true;
+                        }
+
+                        // Format change: the previous track plays out before the reopen
+                        if (configured_)
+                            close(true);
+                        if (isShared() && openChannel(format))
+                            return true;
+                        if (!handle_ && !openDevice())
+                            return false;
+
+                        snd_pcm_hw_params_t *hwParams;
+                        snd_pcm_hw_params_alloca(&hwParams);
+                        snd_pcm_hw_params_any(handle_, hwParams);
+                        // mmap lets the output thread copy from the ring straight
+                        // into the DMA buffer; plugins that can't do it take writei
+                        mmap_ = snd_pcm_hw_params_set_access(handle_, hwParams, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+                        if (!mmap_)
+                            snd_pcm_hw_params_set_access(handle_, hwParams, SND_PCM_ACCESS_RW_INTERLEAVED);
+                        snd_pcm_hw_params_set_format(handle_, hwParams, format.alsaFormat);
+                        snd_pcm_hw_params_set_channels(handle_, hwParams, 2);
+
+                        unsigned int alsaRate = format.rate;
+                        snd_pcm_hw_params_set_rate_near(handle_, hwParams, &alsaRate, nullptr);
+                        // Confirm the actual rate ALSA accepted
+                        if (alsaRate != format.rate)
+                        {
+                            OPENAUTO_LOG(info) << "[AudioPlayer] ALSA adjusted rate from " << format.rate << " to " << alsaRate << "Hz";
+                        }
+
+                        // Scale buffer sizes for high sample rates to avoid underruns
+                        // At 192kHz we need ~4x the buffer vs 44.1kHz
+                        unsigned int rateMultiplier = (alsaRate + 44099) / 44100;
+                        snd_pcm_uframes_t bufferSize = 8192 * rateMultiplier;
+                        snd_pcm_uframes_t periodSize = 2048 * rateMultiplier;
+                        snd_pcm_hw_params_set_buffer_size_near(handle_, hwParams, &bufferSize);
+                        snd_pcm_hw_params_set_period_size_near(handle_, hwParams, &periodSize, nullptr);
+
+                        int err = snd_pcm_hw_params(handle_, hwParams);
+                        if (err < 0)
+                        {
+                            OPENAUTO_LOG(error) << "[AudioPlayer] ALSA hw_params failed: " << snd_strerror(err);
+                            close(false);
+                            return false;
+                        }
+
+                        snd_pcm_hw_params_get_period_size(hwParams, &periodSize, nullptr);
+                        snd_pcm_hw_params_get_buffer_size(hwParams, &bufferSize);
+
+                        // Woken once a whole period is free; playback starts once
+                        // the whole periods the buffer holds are written
+                        snd_pcm_sw_params_t *swParams;
+                        snd_pcm_sw_params_alloca(&swParams);
+                        snd_pcm_sw_params_current(handle_, swParams);
+                        snd_pcm_sw_params_set_avail_min(handle_, swParams, periodSize);
+                        snd_pcm_sw_params_set_start_threshold(handle_, swParams, bufferSize - bufferSize % std::max<snd_pcm_uframes_t>(periodSize, 1));
+                        snd_pcm_sw_params(handle_, swParams);
+
+                        snd_pcm_prepare(handle_);
+                        format_ = format;
+                        rate_ = alsaRate;
+                        periodFrames_ = static_cast<int>(periodSize);
+                        bufferFrames_ = static_cast<int>(bufferSize);
+                        bytesPerFrame_ = 2 * format.bytesPerSample;
+
+                        // Never less than two device buffers, so the ring can
+                        // always hand over a whole period while decode refills it
+                        const size_t ringBytes = std::max<size_t>(
+                            MemoryFootprint::instance().bufferBytes(static_cast<uint64_t>(alsaRate) * bytesPerFrame_, cDecodeAheadMs, cLowMemoryDecodeAheadMs),
+                            static_cast<size_t>(bufferFrames_) * 2 * bytesPerFrame_);
+                        ring_ = std::make_unique<projection::RuntimeRingBuffer>(ringBytes);
+                        ringMemory_ = std::make_unique<MemoryCharge>(MemoryPool::Audio, static_cast<int64_t>(ring_->memoryBytes()));
+                        configured_ = true;
+                        startOutputThread();
+                        OPENAUTO_LOG(info) << "[AudioPlayer] ALSA " << (mmap_ ? "mmap" : "writei") << ", " << periodFrames_
+                                           << "-frame periods, " << bufferFrames_ << "-frame buffer, "
+                                           << ring_->capacity() / bytesPerFrame_ << " frames decoded ahead";
+                        return true;
+                    }
+
+                    // Queues whole frames for the output thread, waiting while the
+                    // ring is full; gives up only if the output thread stopped
+                    // draining it (device gone)
+                    void write(const uint8_t *data, int frames)
+                    {
+                        const int bytesPerFrame = 2 * format_.bytesPerSample;
+                        if (channel_)
+                        {
+                            writeChannel(data, frames, bytesPerFrame);
+                            return;
+                        }
+                        if (!ring_)
+                            return;
+
+                        // A free period takes periodFrames_ / rate to open up
+                        const auto pollInterval = std::chrono::microseconds(
+                            std::max<int64_t>(1000, static_cast<int64_t>(periodFrames_) * 1000000 / std::max(rate_, 1u) / 4));
+                        auto deadline = std::chrono::steady_clock::now() + cMixerStallTimeout;
+                        while (frames > 0)
+                        {
+                            const int room = static_cast<int>(ring_->space() / bytesPerFrame);
+                            if (room == 0)
+                            {
+                                if (!outputRunning_ || std::chrono::steady_clock::now() >= deadline)
+                                    return;
+                                std::this_thread::sleep_for(pollInterval);
+                                continue;
+                            }
+                            const int chunk = std::min(frames, room);
+                            ring_->write(data, static_cast<size_t>(chunk) * bytesPerFrame);
+                            data += chunk * bytesPerFrame;
+                            frames -= chunk;
+                            deadline = std::chrono::steady_clock::now() + cMixerStallTimeout;
+                        }
+                    }
+
+                    // Decoded audio not yet handed to the device, in ms
+                    int queuedMs() const
+                    {
+                        if (!ring_ || rate_ == 0)
+                            return 0;
+                        return static_cast<int>(static_cast<uint64_t>(ring_->available() / bytesPerFrame_) * 1000 / rate_);
+                    }
+
+                    // Discards queued audio at once (skip, stop); the device stays
+                    // open and ready for the next track
+                    void drop()
+                    {
+                        if (channel_)
+                        {
+                            channel_->stop();
+                            channel_->open();
+                            channel_->start();
+                        }
+                        if (handle_)
+                        {
+                            stopOutputThread();
+                            snd_pcm_drop(handle_);
+                            snd_pcm_prepare(handle_);
+                            if (ring_)
+                            {
+                                ring_->clear();
+                                startOutputThread();
+                            }
+                        }
+                    }
+
+                    void close(bool drain)
+                    {
+                        if (channel_)
+                        {
+                            const auto deadline = std::chrono::steady_clock::now() + cMixerStallTimeout;
+                            while (drain && channel_->getQueuedFrames() > 0 && std::chrono::steady_clock::now() < deadline)
+                                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                            channel_->stop();
+                            channel_.reset();
+                        }
+                        if (handle_)
+                        {
+                            if (drain && configured_ && ring_)
+                            {
+                                // The output thread writes out what is queued,
+                                // the last partial period included
+                                flush_ = true;
+                                const auto deadline = std::chrono::steady_clock::now() + cMixerStallTimeout +
+                                                      std::chrono::milliseconds(static_cast<int64_t>(queuedMs()));
+                                while (outputRunning_ && ring_->available() > 0 && std::chrono::steady_clock::now() < deadline)
+                                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                            }
+                            stopOutputThread();
+                            if (drain && configured_)
+                                snd_pcm_drain(handle_);
+                            snd_pcm_close(handle_);
+                            handle_ = nullptr;
+                        }
+                        ring_.reset();
+                        ringMemory_.reset();
+                        configured_ = false;
+                    }
+
+                    const OutputFormat &format() const { return format_; }
+                    unsigned int rate() const { return rate_; }
+                    int periodFrames() const { return periodFrames_; }
+
+                private:
+                    bool openChannel(const OutputFormat &format)
+                    {
+                        channel_ = sharedFactory_();
+                        if (!channel_ || !channel_->open())
+                        {
+                            OPENAUTO_LOG(warning) << "[AudioPlayer] No mixer channel, playing to the ALSA device";
+                            channel_.reset();
+                            return false;
+                        }
+                        channel_->start();
+                        format_ = format;
+                        rate_ = format.rate;
+                        periodFrames_ = cMixerPeriodFrames;
+                        configured_ = true;
+                        OPENAUTO_LOG(info) << "[AudioPlayer] Playing through the Android Auto mixer";
+                        return true;
+                    }
+
+                    // Paced by the mixer's callback: its jitter buffer holds the
+                    // target fill and would skip anything above as clock drift
+                    void writeChannel(const uint8_t *data, int frames, int bytesPerFrame)
+                    {
+                        while (frames > 0)
+                        {
+                            const auto deadline = std::chrono::steady_clock::now() + cMixerStallTimeout;
+                            while (channel_->getQueuedFrames() >= channel_->getTargetFrames())
+                            {
+                                if (std::chrono::steady_clock::now() >= deadline)
+                                    return;
+                                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                            }
+                            const int chunk = std::min(frames, cMixerPeriodFrames);
+                            channel_->write(0, aasdk::common::DataConstBuffer(data, static_cast<size_t>(chunk) * bytesPerFrame));
+                            data += chunk * bytesPerFrame;
+                            frames -= chunk;
+                        }
+                    }
+
+                    void startOutputThread()
+                    {
+                        flush_ = false;
+                        outputRunning_ = true;
+                        outputThread_ = std::thread([this]()
+                                                    { outputLoop(); });
+                    }
+
+                    void stopOutputThread()
+                    {
+                        outputRunning_ = false;
+                        if (outputThread_.joinable())
+                            outputThread_.join();
+                    }
+
+                    // Output thread: sleeps in poll() until the device has a
+                    // period free, then fills it from the ring. Only whole
+                    // periods go out until close() flushes the remainder
+                    void outputLoop()
+                    {
+                        projection::ThreadTopology::instance().apply(projection::ThreadRole::AudioOutput, "oa-player-out");
+
+                        std::vector<pollfd> fds(static_cast<size_t>(std::max(snd_pcm_poll_descriptors_count(handle_), 0)));
+                        if (fds.empty() || snd_pcm_poll_descriptors(handle_, fds.data(), static_cast<unsigned int>(fds.size())) < 0)
+                        {
+                            OPENAUTO_LOG(error) << "[AudioPlayer] No ALSA poll descriptors";
+                            outputRunning_ = false;
+                            return;
+                        }
+                        const auto period = static_cast<snd_pcm_uframes_t>(std::max(periodFrames_, 1));
+                        const int bufferMs = static_cast<int>(static_cast<uint64_t>(bufferFrames_) * 1000 / std::max(rate_, 1u));
+                        const auto idleWait = std::chrono::microseconds(std::max<int64_t>(1000, static_cast<int64_t>(period) * 1000000 / std::max(rate_, 1u) / 4));
+
+                        while (outputRunning_)
+                        {
+                            const auto queued = static_cast<snd_pcm_uframes_t>(ring_->available() / bytesPerFrame_);
+                            if (queued == 0 || (queued < period && !flush_))
+                            {
+                                // Decode is behind or paused: the device may run dry,
+                                // and recovers once audio is back
+                                std::this_thread::sleep_for(idleWait);
+                                continue;
+                            }
+
+                            const snd_pcm_sframes_t avail = snd_pcm_avail_update(handle_);
+                            if (avail < 0)
+                            {
+                                if (snd_pcm_recover(handle_, static_cast<int>(avail), 1) < 0)
+                                {
+                                    OPENAUTO_LOG(error) << "[AudioPlayer] ALSA device lost: " << snd_strerror(static_cast<int>(avail));
+                                    outputRunning_ = false;
+                                }
+                                continue;
+                            }
+
+                            snd_pcm_uframes_t frames = std::min(static_cast<snd_pcm_uframes_t>(avail), queued);
+                            if (!flush_)
+                                frames -= frames % period;
+                            if (frames == 0)
+                            {
+                                // Running with the buffer full: wait for the next period
+                                if (snd_pcm_state(handle_) == SND_PCM_STATE_RUNNING)
+                                {
+                                    ::poll(fds.data(), static_cast<nfds_t>(fds.size()), bufferMs + 10);
+                                    unsigned short revents = 0;
+                                    snd_pcm_poll_descriptors_revents(handle_, fds.data(), static_cast<unsigned int>(fds.size()), &revents);
+                                }
+                                else
+                                {
+                                    std::this_thread::sleep_for(idleWait);
+                                }
+                                continue;
+                            }
+
+                            const int err = mmap_ ? writeMmap(frames) : writeInterleaved(frames);
+                            if (err < 0 && snd_pcm_recover(handle_, err, 1) < 0)
+                            {
+                                OPENAUTO_LOG(error) << "[AudioPlayer] ALSA write failed: " << snd_strerror(err);
+                                outputRunning_ = false;
+                            }
+                        }
+                    }
+
+                    // Copies @p frames from the ring into the mapped DMA buffer,
+                    // one contiguous run of each at a time
+                    int writeMmap(snd_pcm_uframes_t frames)
+                    {
+                        while (frames > 0)
+                        {
+                            const snd_pcm_channel_area_t *areas;
+                            snd_pcm_uframes_t offset;
+                            snd_pcm_uframes_t mapped = frames;
+                            int err = snd_pcm_mmap_begin(handle_, &areas, &offset, &mapped);
+                            if (err < 0)
+                                return err;
+
+                            auto *dst = static_cast<uint8_t *>(areas[0].addr) + (areas[0].first + offset * areas[0].step) / 8;
+                            const size_t bytes = ring_->read(dst, static_cast<size_t>(mapped) * bytesPerFrame_);
+                            const snd_pcm_sframes_t committed = snd_pcm_mmap_commit(handle_, offset, bytes / bytesPerFrame_);
+                            if (committed < 0)
+                                return static_cast<int>(committed);
+                            frames -= static_cast<snd_pcm_uframes_t>(committed);
+                        }
+                        return 0;
+                    }
+
+                    // writei straight from ring memory; never blocks, as no more
+                    // than snd_pcm_avail_update() reported is written
+                    int writeInterleaved(snd_pcm_uframes_t frames)
+                    {
+                        while (frames > 0)
+                        {
+                            const auto span = ring_->peekContiguous();
+                            const snd_pcm_uframes_t run = std::min<snd_pcm_uframes_t>(frames, span.size / bytesPerFrame_);
+                            if (run == 0)
+                                return 0;
+                            const snd_pcm_sframes_t written = snd_pcm_writei(handle_, span.data, run);
+                            if (written < 0)
+                                return static_cast<int>(written);
+                            ring_->commitRead(static_cast<size_t>(written) * bytesPerFrame_);
+                            frames -= static_cast<snd_pcm_uframes_t>(written);
+                        }
+                        return 0;
+                    }
+
+                    bool openDevice()
+                    {
+                        int err = snd_pcm_open(&handle_, "default", SND_PCM_STREAM_PLAYBACK, 0);
+                        if (err < 0)
+                        {
+                            OPENAUTO_LOG(error) << "[AudioPlayer] ALSA open failed: " << snd_strerror(err);
+                            handle_ = nullptr;
+                            return false;
+                        }
+
+                        if (!caps_.valid)
+                        {
+                            snd_pcm_hw_params_t *hwParams;
+                            snd_pcm_hw_params_alloca(&hwParams);
+                            snd_pcm_hw_params_any(handle_, hwParams);
+                            snd_pcm_hw_params_set_access(handle_, hwParams, SND_PCM_ACCESS_RW_INTERLEAVED);
+                            snd_pcm_hw_params_get_rate_max(hwParams, &caps_.maxRate, nullptr);
+                            snd_pcm_hw_params_get_rate_min(hwParams, &caps_.minRate, nullptr);
+                            caps_.s32 = snd_pcm_hw_params_test_format(handle_, hwParams, SND_PCM_FORMAT_S32_LE) == 0;
+                            caps_.s24 = snd_pcm_hw_params_test_format(handle_, hwParams, SND_PCM_FORMAT_S24_3LE) == 0;
+                            caps_.valid = true;
+                            OPENAUTO_LOG(info) << "[AudioPlayer] DAC rate range: " << caps_.minRate << " - " << caps_.maxRate << " Hz"
+                                               << (caps_.s32 ? ", S32_LE" : "") << (caps_.s24 ? ", S24_3LE" : "");
+                        }
+                        return true;
+                    }
+
+                    snd_pcm_t *handle_ = nullptr;
+                    SharedOutputFactory sharedFactory_;
+                    std::shared_ptr<projection::AudioMixerChannel> channel_;
+                    DacCaps caps_;
+                    OutputFormat format_;
+                    unsigned int rate_ = 0;
+                    int periodFrames_ = 0;
+                    bool configured_ = false;
+
+                    // ALSA path: the decode thread fills ring_, the output
+                    // thread drains it into the device
+                    std::unique_ptr<projection::RuntimeRingBuffer> ring_;
+                    std::unique_ptr<MemoryCharge> ringMemory_;
+                    std::thread outputThread_;
+                    std::atomic<bool> outputRunning_{false};
+                    std::atomic<bool> flush_{false};
+                    bool mmap_ = false;
+                    int bufferFrames_ = 0;
+                    int bytesPerFrame_ = 4;
+                };
+
+                // ========== FFmpeg Track Decoder ==========
+                class AudioPlayer::TrackDecoder
+                {
+                public:
+                    ~TrackDecoder()
+                    {
+                        if (packet_)
+                            av_packet_free(&packet_);
+                        if (frame_)
+                            av_frame_free(&frame_);
+                        if (swrCtx_)
+                            swr_free(&swrCtx_);
+                        if (codecCtx_)
+                            avcodec_free_context(&codecCtx_);
+                        if (formatCtx_)
+                            avformat_close_input(&formatCtx_);
+                        // Custom I/O is left to its owner by avformat_close_input()
+                        if (ioCtx_)
+                        {
+                            av_freep(&ioCtx_->buffer);
+                            avio_context_free(&ioCtx_);
+                        }
+                    }
+
+                    bool open(const QString &file)
+                    {
+                        // libavformat reads through the read-ahead ring, never the
+                        // drive itself, so flash stalls do not reach the decode loop
+                        if (!file_.open(file))
+                            return false;
+                        auto *ioBuffer = static_cast<unsigned char *>(av_malloc(cIoBufferSize));
+                        if (ioBuffer)
+                            ioCtx_ = avio_alloc_context(ioBuffer, cIoBufferSize, 0, &file_, &TrackDecoder::readPacket, nullptr, &TrackDecoder::seekPacket);
+                        formatCtx_ = avformat_alloc_context();
+                        if (!ioCtx_ || !formatCtx_)
+                        {
+                            if (!ioCtx_)
+                                av_free(ioBuffer);
+                            OPENAUTO_LOG(error) << "[AudioPlayer] Failed to allocate I/O context";
+                            return false;
+                        }
+                        formatCtx_->pb = ioCtx_;
+                        formatCtx_->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+                        // Open input file; the path is only a hint for format probing
+                        if (avformat_open_input(&formatCtx_, file.toUtf8().constData(), nullptr, nullptr) < 0)
+                        {
+                            OPENAUTO_LOG(error) << "[AudioPlayer] Failed to open: " << file.toStdString();
+                            return false;
+                        }
+
+                        if (avformat_find_stream_info(formatCtx_, nullptr) < 0)
+                        {
+                            OPENAUTO_LOG(error) << "[AudioPlayer] Failed to find stream info";
+                            return false;
+                        }
+
+                        // Find audio stream
+                        for (unsigned int i = 0; i < formatCtx_->nb_streams; i++)
+                        {
+                            if (formatCtx_->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+                            {
+                                streamIdx_ = i;
+                                break;
+                            }
+                        }
+
+                        if (streamIdx_ < 0)
+                        {
+                            OPENAUTO_LOG(error) << "[AudioPlayer] No audio stream found";
+                            return false;
+                        }
+
+                        AVStream *audioStream = formatCtx_->streams[streamIdx_];
+                        timeBase_ = audioStream->time_base;
+
+                        // Find decoder
+                        codec_ = avcodec_find_decoder(audioStream->codecpar->codec_id);
+                        if (!codec_)
+                        {
+                            OPENAUTO_LOG(error) << "[AudioPlayer] Unsupported codec";
+                            return false;
+                        }
+
+                        codecCtx_ = avcodec_alloc_context3(codec_);
+                        avcodec_parameters_to_context(codecCtx_, audioStream->codecpar);
+
+                        if (avcodec_open2(codecCtx_, codec_, nullptr) < 0)
+                        {
+                            OPENAUTO_LOG(error) << "[AudioPlayer] Failed to open codec";
+                            return false;
+                        }
+
+                        frame_ = av_frame_alloc();
+                        packet_ = av_packet_alloc();
+                        return frame_ && packet_;
+                    }
+
+                    // ReplayGain, applied by the resampler's rematrix at no extra
+                    // cost; 1.0 leaves the samples untouched. Before setOutput()
+                    void setGain(double gain) { gain_ = gain; }
+
+                    int sourceRate() const { return codecCtx_->sample_rate; }
+                    int bitsPerRawSample() const { return codecCtx_->bits_per_raw_sample; }
+                    const char *codecName() const { return codec_->name; }
+
+                    // Setup resampler (even for native offload, we may need format conversion)
+                    bool setOutput(const OutputFormat &format, unsigned int rate)
+                    {
+                        if (swrCtx_)
+                            swr_free(&swrCtx_);
+                        swrCtx_ = swr_alloc();
+                        if (!swrCtx_)
+                        {
+                            OPENAUTO_LOG(error) << "[AudioPlayer] Failed to allocate resampler";
+                            return false;
+                        }
+
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+                        AVChannelLayout outLayout = AV_CHANNEL_LAYOUT_STEREO;
+                        swr_alloc_set_opts2(&swrCtx_,
+                                            &outLayout, format.sampleFormat, static_cast<int>(rate),
+                                            &codecCtx_->ch_layout, codecCtx_->sample_fmt, codecCtx_->sample_rate,
+                                            0, nullptr);
+#else
+                        int64_t inChannelLayout = codecCtx_->channel_layout ? codecCtx_->channel_layout : av_get_default_channel_layout(codecCtx_->channels);
+                        av_opt_set_int(swrCtx_, "in_channel_layout", inChannelLayout, 0);
+                        av_opt_set_int(swrCtx_, "in_sample_rate", codecCtx_->sample_rate, 0);
+                        av_opt_set_sample_fmt(swrCtx_, "in_sample_fmt", codecCtx_->sample_fmt, 0);
+                        av_opt_set_int(swrCtx_, "out_channel_layout", AV_CH_LAYOUT_STEREO, 0);
+                        av_opt_set_int(swrCtx_, "out_sample_rate", rate, 0);
+                        av_opt_set_sample_fmt(swrCtx_, "out_sample_fmt", format.sampleFormat, 0);
+#endif
+                        if (gain_ != 1.0)
+                            av_opt_set_double(swrCtx_, "rematrix_volume", gain_, 0);
+
+                        if (swr_init(swrCtx_) < 0)
+                        {
+                            OPENAUTO_LOG(error) << "[AudioPlayer] Failed to init resampler";
+                            swr_free(&swrCtx_);
+                            return false;
+                        }
+
+                        format_ = format;
+                        rate_ = rate;
+                        bytesPerFrame_ = 2 * format.bytesPerSample;
+                        return true;
+                    }
+
+                    bool hasOutput() const { return swrCtx_ != nullptr; }
+                    const OutputFormat &format() const { return format_; }
+                    unsigned int rate() const { return rate_; }
+                    int bytesPerFrame() const { return bytesPerFrame_; }
+                    int positionMs() const { return positionMs_; }
+
+                    // Decodes and converts until at least one frame is produced,
+                    // appending at byte @p used of @p out. @p out only grows, so a
+                    // caller reusing it stops allocating after the first frames.
+                    // Returns the frame count, 0 once the decoder and the resampler
+                    // are drained
+                    int decode(std::vector<uint8_t> &out, size_t used)
+                    {
+                        while (true)
+                        {
+                            int ret = avcodec_receive_frame(codecCtx_, frame_);
+                            if (ret >= 0)
+                            {
+                                const int64_t pts = frame_->best_effort_timestamp;
+                                int skip = 0;
+                                if (trimPts_ != AV_NOPTS_VALUE && pts != AV_NOPTS_VALUE)
+                                {
+                                    // After a seek: decoding restarted at the packet before
+                                    // the target, drop samples up to the exact target pts
+                                    const int64_t early = av_rescale_q(trimPts_ - pts, timeBase_, AVRational{1, codecCtx_->sample_rate});
+                                    if (early >= frame_->nb_samples)
+                                    {
+                                        av_frame_unref(frame_);
+                                        continue;
+                                    }
+                                    skip = static_cast<int>(std::max<int64_t>(early, 0));
+                                    trimPts_ = AV_NOPTS_VALUE;
+                                }
+                                else if (pts != AV_NOPTS_VALUE)
+                                {
+                                    // Calculate position from pts
+                                    positionMs_ = static_cast<int>(pts * av_q2d(timeBase_) * 1000.0);
+                                }
+
+                                int converted = convert(frameData(skip), frame_->nb_samples - skip, out, used);
+                                av_frame_unref(frame_);
+                                if (converted > 0)
+                                    return converted;
+                                continue;
+                            }
+
+                            if (ret != AVERROR(EAGAIN))
+                            {
+                                // Decoder drained: the resampler still holds its filter delay,
+                                // which is the start of the gap between tracks otherwise
+                                if (!swrFlushed_)
+                                {
+                                    swrFlushed_ = true;
+                                    int converted = convert(nullptr, 0, out, used);
+                                    if (converted > 0)
+                                        return converted;
+                                }
+                                return 0;
+                            }
+
+                            if (av_read_frame(formatCtx_, packet_) < 0)
+                            {
+                                // End of file: drain the frames the codec holds back
+                                avcodec_send_packet(codecCtx_, nullptr);
+                                continue;
+                            }
+
+                            if (packet_->stream_index == streamIdx_)
+                                avcodec_send_packet(codecCtx_, packet_);
+                            av_packet_unref(packet_);
+                        }
+                    }
+
+                    // Decodes the first @p ms of the track into preroll
+                    void prebuffer(int ms, const std::atomic<bool> &cancel)
+                    {
+                        const size_t target = static_cast<size_t>(rate_) * ms / 1000 * bytesPerFrame_;
+                        preroll.reserve(target);
+                        size_t used = 0;
+                        while (!cancel && used < target)
+                        {
+                            int frames = decode(preroll, used);
+                            if (frames <= 0)
+                                break;
+                            used += static_cast<size_t>(frames) * bytesPerFrame_;
+                        }
+                        preroll.resize(used);
+                    }
+
+                    // Repositions to @p ms, sample-accurate: the demuxer goes back to
+                    // the packet at or before the target and decode() trims the rest
+                    bool seek(int ms)
+                    {
+                        preroll.clear();
+                        const int64_t target = av_rescale_q(ms, AVRational{1, 1000}, timeBase_);
+                        if (av_seek_frame(formatCtx_, streamIdx_, target, AVSEEK_FLAG_BACKWARD) < 0 &&
+                            avformat_seek_file(formatCtx_, streamIdx_, INT64_MIN, target, target, 0) < 0)
+                        {
+                            OPENAUTO_LOG(warning) << "[AudioPlayer] Seek to " << ms << "ms failed";
+                            return false;
+                        }
+
+                        avcodec_flush_buffers(codecCtx_);
+                        // The resampler's delay line holds audio from before the seek
+                        if (swrCtx_)
+                        {
+                            swr_close(swrCtx_);
+                            swr_init(swrCtx_);
+                        }
+                        swrFlushed_ = false;
+                        positionMs_ = ms;
+                        trimPts_ = target;
+                        return true;
+                    }
+
+                    // Converted audio decoded ahead of playback
+                    std::vector<uint8_t> preroll;
+
+                private:
+                    // Input planes of frame_ starting @p skip samples in
+                    const uint8_t **frameData(int skip)
+                    {
+                        const uint8_t **data = const_cast<const uint8_t **>(frame_->extended_data);
+                        if (skip == 0)
+                            return data;
+
+                        const AVSampleFormat format = static_cast<AVSampleFormat>(frame_->format);
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+                        const int channels = frame_->ch_layout.nb_channels;
+#else
+                        const int channels = frame_->channels;
+#endif
+                        const int bytesPerSample = av_get_bytes_per_sample(format);
+                        if (av_sample_fmt_is_planar(format))
+                        {
+                            planes_.assign(data, data + channels);
+                            for (auto &plane : planes_)
+                                plane += skip * bytesPerSample;
+                        }
+                        else
+                        {
+                            planes_.assign(1, data[0] + skip * bytesPerSample * channels);
+                        }
+                        return planes_.data();
+                    }
+
+                    int convert(const uint8_t **input, int samples, std::vector<uint8_t> &out, size_t used)
+                    {
+                        int outSamples = swr_get_out_samples(swrCtx_, samples);
+                        if (outSamples <= 0)
+                            return 0;
+                        const size_t needed = used + static_cast<size_t>(outSamples) * bytesPerFrame_;
+                        if (out.size() < needed)
+                            out.resize(needed);
+                        uint8_t *outBuf = out.data() + used;
+                        return swr_convert(swrCtx_, &outBuf, outSamples, input, samples);
+                    }
+
+                    static int readPacket(void *opaque, uint8_t *buffer, int size)
+                    {
+                        const int read = static_cast<ReadAheadFile *>(opaque)->read(buffer, size);
+                        return read > 0 ? read : (read == 0 ? AVERROR_EOF : AVERROR(EIO));
+                    }
+
+                    static int64_t seekPacket(void *opaque, int64_t offset, int whence)
+                    {
+                        auto *file = static_cast<ReadAheadFile *>(opaque);
+                        switch (whence & ~AVSEEK_FORCE)
+                        {
+                        case AVSEEK_SIZE:
+                            return file->size();
+                        case SEEK_SET:
+                            return file->seek(offset);
+                        case SEEK_CUR:
+                            return file->seek(file->position() + offset);
+                        case SEEK_END:
+                            return file->seek(file->size() + offset);
+                        default:
+                            return -1;
+                        }
+                    }
+
+                    static constexpr int cIoBufferSize = 64 * 1024;
+
+                    // Read through ioCtx_, which the destructor frees first
+                    ReadAheadFile file_;
+                    AVIOContext *ioCtx_ = nullptr;
+                    AVFormatContext *formatCtx_ = nullptr;
+                    AVCodecContext *codecCtx_ = nullptr;
+                    const AVCodec *codec_ = nullptr;
+                    SwrContext *swrCtx_ = nullptr;
+                    AVFrame *frame_ = nullptr;
+                    AVPacket *packet_ = nullptr;
+                    int streamIdx_ = -1;
+                    AVRational timeBase_ = {1, 1};
+                    // Pending sample-accurate trim after a seek
+                    int64_t trimPts_ = AV_NOPTS_VALUE;
+                    std::vector<const uint8_t *> planes_;
+                    OutputFormat format_;
+                    unsigned int rate_ = 0;
+                    int bytesPerFrame_ = 4;
+                    int positionMs_ = 0;
+                    bool swrFlushed_ = false;
+                    double gain_ = 1.0;
+                };
+
                 AudioPlayer::AudioPlayer(QObject *parent)
-                    : QObject(parent), playing_(false), paused_(false), stopRequested_(false), duration_(0), position_(0), sampleRate_(0), bitDepth_(16), nativeOffload_(false), playlistIndex_(-1), repeatMode_(RepeatOff), decodeThread_(nullptr)
+                    : QObject(parent), playing_(false), paused_(false), stopRequested_(false), duration_(0), position_(0), sampleRate_(0), bitDepth_(16), nativeOffload_(false), library_(nullptr), playlistIndex_(-1), repeatMode_(RepeatOff), seekTarget_(-1), positionUpdates_(true), replayGain_(true), decodeThread_(nullptr), output_(std::make_unique<PcmOutput>()), prefetchThread_(nullptr), prefetchedIndex_(-1)
                 {
                     OPENAUTO_LOG(info) << "[AudioPlayer] Initialized (FFmpeg → ALSA)";
                 }
@@ -51,6 +931,49 @@ namespace f1x
                     stopDecodeThread();
                 }
 
+                void AudioPlayer::setLibrary(const MediaLibrary *library)
+                {
+                    if (library_)
+                        disconnect(library_->artCache(), nullptr, this, nullptr);
+                    library_ = library;
+                    if (library_)
+                        connect(library_->artCache(), &ArtCache::artReady, this, &AudioPlayer::onArtReady);
+                }
+
+                void AudioPlayer::setReplayGainEnabled(bool enabled)
+                {
+                    replayGain_ = enabled;
+                }
+
+                void AudioPlayer::setPositionUpdatesEnabled(bool enabled)
+                {
+                    if (positionUpdates_.exchange(enabled) == enabled)
+                        return;
+                    if (enabled)
+                        emit positionChanged();
+                }
+
+                void AudioPlayer::setSharedOutput(SharedOutputFactory factory)
+                {
+                    const bool wasPlaying = playing_;
+                    const bool wasPaused = paused_;
+                    const int position = position_;
+
+                    // The decode thread owns the output while it runs
+                    stopDecodeThread();
+                    output_->close(false);
+                    output_->setShared(std::move(factory));
+                    OPENAUTO_LOG(info) << "[AudioPlayer] Output: " << (output_->isShared() ? "Android Auto mixer" : "ALSA device");
+
+                    if (wasPlaying)
+                    {
+                        startDecodeThread();
+                        seek(position);
+                        if (wasPaused)
+                            pause();
+                    }
+                }
+
                 // ========== Getters ==========
                 bool AudioPlayer::isPlaying() const { return playing_ && !paused_; }
                 QString AudioPlayer::currentFile() const { return currentFile_; }
@@ -135,6 +1058,7 @@ namespace f1x
                 void AudioPlayer::stop()
                 {
                     stopDecodeThread();
+                    output_->close(false);
                     playing_ = false;
                     paused_ = false;
                     position_ = 0;
@@ -219,8 +1143,10 @@ namespace f1x
 
                 void AudioPlayer::seek(int positionMs)
                 {
-                    // Seek is handled in the decode loop by checking position_
-                    // For now this is a simplified implementation
+                    // Picked up by the decode loop before its next write. Only the
+                    // latest request is kept: a scrub sends many and wants the last
+                    if (playing_)
+                        seekTarget_ = std::max(positionMs, 0);
                     position_ = positionMs;
                     emit positionChanged();
                 }
@@ -247,6 +1173,17 @@ namespace f1x
                     artistName_ = "";
                     duration_ = 0;
 
+                    LibraryTrack indexed;
+                    if (library_ && library_->track(filePath, indexed))
+                    {
+                        if (!indexed.title.isEmpty())
+                            trackTitle_ = indexed.title;
+                        albumName_ = indexed.album;
+                        artistName_ = indexed.artist;
+                        duration_ = indexed.durationMs;
+                        return;
+                    }
+
                     TagLib::FileRef file(filePath.toUtf8().constData());
                     if (!file.isNull() && file.tag())
                     {
@@ -262,71 +1199,55 @@ namespace f1x
                     }
                 }
 
+                double AudioPlayer::trackGain(const QString &filePath) const
+                {
+                    LibraryTrack indexed;
+                    if (!replayGain_ || !library_ || !library_->track(filePath, indexed) ||
+                        (indexed.loudness != LibraryTrack::LoudnessTagged && indexed.loudness != LibraryTrack::LoudnessMeasured))
+                        return 1.0;
+
+                    // Boosts only as far as the known peak allows: the integer
+                    // rematrix paths wrap rather than clip
+                    const double gain = std::pow(10.0, indexed.gainDb / 20.0);
+                    const double ceiling = indexed.peak > 0.0f ? 1.0 / indexed.peak : 1.0;
+                    return std::min(gain, ceiling);
+                }
+
                 void AudioPlayer::extractAlbumArt(const QString &filePath)
                 {
-                    albumArtPath_ = "";
+                    albumArtPath_ = cDefaultAlbumArt;
+                    if (!library_)
+                        return;
 
-                    // Check for folder.png/jpg in the same directory
-                    QFileInfo fi(filePath);
-                    QDir dir = fi.absoluteDir();
-                    QStringList coverNames = {"folder.png", "folder.jpg", "cover.png", "cover.jpg", "front.png", "front.jpg"};
-                    for (const auto &name : coverNames)
+                    // Indexed: the art, or its absence, is already known
+                    ArtCache *cache = library_->artCache();
+                    LibraryTrack indexed;
+                    if (library_->track(filePath, indexed))
                     {
-                        QString coverPath = dir.absoluteFilePath(name);
-                        if (QFileInfo::exists(coverPath))
+                        const QString url = cache->url(indexed.artKey, ArtCache::cPlayerSize);
+                        if (!url.isEmpty() || indexed.artKey.isEmpty())
                         {
-                            albumArtPath_ = "file://" + coverPath;
+                            if (!url.isEmpty())
+                                albumArtPath_ = url;
                             return;
                         }
                     }
 
-                    // Try to extract embedded art
-                    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
-                    QDir().mkpath(cacheDir);
-                    QString artCachePath = cacheDir + "/current_albumart.jpg";
-
-                    // Try FLAC pictures
-                    TagLib::FLAC::File flacFile(filePath.toUtf8().constData());
-                    if (flacFile.isValid())
-                    {
-                        auto pictures = flacFile.pictureList();
-                        if (!pictures.isEmpty())
-                        {
-                            auto pic = pictures.front();
-                            QByteArray data(pic->data().data(), pic->data().size());
-                            QFile out(artCachePath);
-                            if (out.open(QIODevice::WriteOnly))
-                            {
-                                out.write(data);
-                                out.close();
-                                albumArtPath_ = "file://" + artCachePath;
-                                return;
-                            }
-                        }
-                    }
+                    // Not indexed yet, or the thumbnail was evicted: extracted in
+                    // the background and applied by onArtReady
+                    cache->request(filePath);
+                }
 
-                    // Try MP3 ID3v2
-                    TagLib::MPEG::File mpegFile(filePath.toUtf8().constData());
-                    if (mpegFile.isValid() && mpegFile.ID3v2Tag())
-                    {
-                        auto frames = mpegFile.ID3v2Tag()->frameList("APIC");
-                        if (!frames.isEmpty())
-                        {
-                            auto *picFrame = static_cast<TagLib::ID3v2::AttachedPictureFrame *>(frames.front());
-                            QByteArray data(picFrame->picture().data(), picFrame->picture().size());
-                            QFile out(artCachePath);
-                            if (out.open(QIODevice::WriteOnly))
-                            {
-                                out.write(data);
-                                out.close();
-                                albumArtPath_ = "file://" + artCachePath;
-                                return;
-                            }
-                        }
-                    }
+                void AudioPlayer::onArtReady(const QString &filePath, const QString &key)
+                {
+                    if (filePath != currentFile_ || key.isEmpty())
+                        return;
 
-                    // Fallback to default cover
-                    albumArtPath_ = "qrc:/coverlogo.png";
+                    const QString url = library_->artCache()->url(key, ArtCache::cPlayerSize);
+                    if (url.isEmpty() || url == albumArtPath_)
+                        return;
+                    albumArtPath_ = url;
+                    emit trackChanged();
                 }
 
                 // ========== Thread Management ==========
@@ -338,6 +1259,7 @@ namespace f1x
                     playing_ = true;
                     paused_ = false;
                     position_ = 0;
+                    seekTarget_ = -1;
 
                     decodeThread_ = QThread::create([this]()
                                                     { decodeLoop(); });
@@ -383,256 +1305,211 @@ namespace f1x
                     }
                 }
 
-                // ========== FFmpeg → ALSA Decode Loop ==========
-                void AudioPlayer::decodeLoop()
+                // ========== Gapless Handoff ==========
+                int AudioPlayer::followingIndex(int index) const
                 {
-                    AVFormatContext *formatCtx = nullptr;
-                    AVCodecContext *codecCtx = nullptr;
-                    SwrContext *swrCtx = nullptr;
-                    snd_pcm_t *pcmHandle = nullptr;
-                    AVFrame *frame = nullptr;
-                    AVPacket *packet = nullptr;
-
-                    auto cleanup = [&]()
-                    {
-                        if (packet)
-                            av_packet_free(&packet);
-                        if (frame)
-                            av_frame_free(&frame);
-                        if (swrCtx)
-                            swr_free(&swrCtx);
-                        if (codecCtx)
-                            avcodec_free_context(&codecCtx);
-                        if (formatCtx)
-                            avformat_close_input(&formatCtx);
-                        if (pcmHandle)
-                        {
-                            snd_pcm_drain(pcmHandle);
-                            snd_pcm_close(pcmHandle);
-                        }
-                    };
+                    if (index < 0 || index >= playlist_.size())
+                        return -1;
+                    if (repeatMode_ == RepeatOne)
+                        return index;
+                    if (index + 1 < playlist_.size())
+                        return index + 1;
+                    return repeatMode_ == RepeatAll ? 0 : -1;
+                }
 
-                    // Open input file
-                    if (avformat_open_input(&formatCtx, currentFile_.toUtf8().constData(), nullptr, nullptr) < 0)
-                    {
-                        OPENAUTO_LOG(error) << "[AudioPlayer] Failed to open: " << currentFile_.toStdString();
-                        QMetaObject::invokeMethod(this, [this]()
-                                                  { emit playbackError("Failed to open file"); }, Qt::QueuedConnection);
-                        cleanup();
+                void AudioPlayer::startPrefetch(int index)
+                {
+                    QMutexLocker locker(&mutex_);
+                    prefetchedIndex_ = followingIndex(index);
+                    if (prefetchedIndex_ < 0)
                         return;
-                    }
+                    prefetchedFile_ = playlist_.at(prefetchedIndex_);
+                    locker.unlock();
 
-                    if (avformat_find_stream_info(formatCtx, nullptr) < 0)
-                    {
-                        OPENAUTO_LOG(error) << "[AudioPlayer] Failed to find stream info";
-                        cleanup();
-                        return;
-                    }
+                    // Converted for the current device when the format matches, so
+                    // the handoff is a plain write
+                    const bool shared = output_->isShared();
+                    const DacCaps caps = shared ? DacCaps() : output_->caps();
+                    const OutputFormat current = output_->format();
+                    const unsigned int currentRate = output_->rate();
+                    const QString file = prefetchedFile_;
+                    prefetchThread_ = QThread::create([this, file, shared, caps, current, currentRate]()
+                                                      {
+                        auto decoder = std::make_unique<TrackDecoder>();
+                        if (!decoder->open(file))
+                            return;
+                        decoder->setGain(trackGain(file));
+                        const OutputFormat format = shared ? mixerFormat() : chooseFormat(caps, decoder->sourceRate(), decoder->bitsPerRawSample());
+                        if (!decoder->setOutput(format, format == current ? currentRate : format.rate))
+                            return;
+                        decoder->prebuffer(cPrebufferMs, stopRequested_);
+                        prefetched_ = std::move(decoder); });
+                    prefetchThread_->start();
+                }
 
-                    // Find audio stream
-                    int audioStreamIdx = -1;
-                    for (unsigned int i = 0; i < formatCtx->nb_streams; i++)
+                void AudioPlayer::stopPrefetch()
+                {
+                    // stopRequested_ also cancels the prebuffer
+                    if (prefetchThread_)
                     {
-                        if (formatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
-                        {
-                            audioStreamIdx = i;
-                            break;
-                        }
+                        prefetchThread_->wait();
+                        delete prefetchThread_;
+                        prefetchThread_ = nullptr;
                     }
+                    prefetched_.reset();
+                }
 
-                    if (audioStreamIdx < 0)
+                std::unique_ptr<AudioPlayer::TrackDecoder> AudioPlayer::takePrefetched(int index)
+                {
+                    if (prefetchThread_)
                     {
-                        OPENAUTO_LOG(error) << "[AudioPlayer] No audio stream found";
-                        cleanup();
-                        return;
+                        prefetchThread_->wait();
+                        delete prefetchThread_;
+                        prefetchThread_ = nullptr;
                     }
 
-                    AVStream *audioStream = formatCtx->streams[audioStreamIdx];
-
-                    // Find decoder
-                    const AVCodec *codec = avcodec_find_decoder(audioStream->codecpar->codec_id);
-                    if (!codec)
+                    // The playlist or repeat mode may have changed while it played
+                    QMutexLocker locker(&mutex_);
+                    const int next = followingIndex(index);
+                    if (!prefetched_ || next != prefetchedIndex_ || playlist_.at(next) != prefetchedFile_)
                     {
-                        OPENAUTO_LOG(error) << "[AudioPlayer] Unsupported codec";
-                        cleanup();
-                        return;
+                        prefetched_.reset();
+                        return nullptr;
                     }
+                    return std::move(prefetched_);
+                }
 
-                    codecCtx = avcodec_alloc_context3(codec);
-                    avcodec_parameters_to_context(codecCtx, audioStream->codecpar);
+                void AudioPlayer::announceTrack(int index, const QString &file)
+                {
+                    QMetaObject::invokeMethod(this, [this, index, file]()
+                                              {
+                        {
+                            QMutexLocker locker(&mutex_);
+                            playlistIndex_ = index;
+                        }
+                        currentFile_ = file;
+                        loadMetadata(file);
+                        extractAlbumArt(file);
+                        emit trackFinished();
+                        emit trackChanged();
+                        emit positionChanged(); }, Qt::QueuedConnection);
+                }
 
-                    if (avcodec_open2(codecCtx, codec, nullptr) < 0)
+                // ========== FFmpeg → ALSA Decode Loop ==========
+                void AudioPlayer::decodeLoop()
+                {
+                    int index;
                     {
-                        OPENAUTO_LOG(error) << "[AudioPlayer] Failed to open codec";
-                        cleanup();
-                        return;
+                        QMutexLocker locker(&mutex_);
+                        index = playlistIndex_;
                     }
 
-                    // ========== DAC capability probe + audio offload ==========
-                    // Try to pass native sample rate (up to 192kHz) directly to DAC.
-                    // Only resample if the hardware can't handle the source rate.
-                    int srcSampleRate = codecCtx->sample_rate;
-                    int outSampleRate = srcSampleRate;
-
-                    // Cap at 192kHz (anything above, e.g. raw DSD bitstream rates, must resample)
-                    if (outSampleRate > 192000)
-                        outSampleRate = 192000;
-
-                    // Open ALSA PCM first so we can probe hardware capabilities
-                    int err = snd_pcm_open(&pcmHandle, "default", SND_PCM_STREAM_PLAYBACK, 0);
-                    if (err < 0)
+                    auto decoder = std::make_unique<TrackDecoder>();
+                    if (!decoder->open(currentFile_))
                     {
-                        OPENAUTO_LOG(error) << "[AudioPlayer] ALSA open failed: " << snd_strerror(err);
-                        cleanup();
+                        QMetaObject::invokeMethod(this, [this]()
+                                                  { emit playbackError("Failed to open file"); }, Qt::QueuedConnection);
+                        output_->close(false);
                         return;
                     }
+                    decoder->setGain(trackGain(currentFile_));
 
-                    snd_pcm_hw_params_t *hwParams;
-                    snd_pcm_hw_params_alloca(&hwParams);
-                    snd_pcm_hw_params_any(pcmHandle, hwParams);
-                    snd_pcm_hw_params_set_access(pcmHandle, hwParams, SND_PCM_ACCESS_RW_INTERLEAVED);
-
-                    // Probe max sample rate the DAC supports
-                    unsigned int dacMaxRate = 0;
-                    snd_pcm_hw_params_get_rate_max(hwParams, &dacMaxRate, nullptr);
-                    unsigned int dacMinRate = 0;
-                    snd_pcm_hw_params_get_rate_min(hwParams, &dacMinRate, nullptr);
-                    OPENAUTO_LOG(info) << "[AudioPlayer] DAC rate range: " << dacMinRate << " - " << dacMaxRate << " Hz";
-
-                    // If DAC can't handle the source rate, downsample to nearest standard rate it supports
-                    bool nativeOffload = true;
-                    if (static_cast<unsigned int>(outSampleRate) > dacMaxRate)
+                    while (true)
                     {
-                        nativeOffload = false;
-                        // Pick highest standard rate the DAC supports
-                        static const unsigned int standardRates[] = {192000, 176400, 96000, 88200, 48000, 44100};
-                        outSampleRate = 44100; // fallback
-                        for (unsigned int sr : standardRates)
+                        if (!startOutput(*decoder))
                         {
-                            if (sr <= dacMaxRate && sr >= dacMinRate)
-                            {
-                                outSampleRate = static_cast<int>(sr);
-                                break;
-                            }
+                            output_->close(false);
+                            return;
                         }
-                        OPENAUTO_LOG(info) << "[AudioPlayer] Source " << srcSampleRate << "Hz exceeds DAC max " << dacMaxRate << "Hz, resampling to " << outSampleRate << "Hz";
-                    }
-                    else
-                    {
-                        OPENAUTO_LOG(info) << "[AudioPlayer] DAC supports " << outSampleRate << "Hz — native offload active";
-                    }
-
-                    // Probe best sample format: prefer S32 > S24_3LE > S16 for hi-res content
-                    snd_pcm_format_t alsaFormat = SND_PCM_FORMAT_S16_LE;
-                    AVSampleFormat swrOutFmt = AV_SAMPLE_FMT_S16;
-                    int outBytesPerSample = 2;
 
-                    if (codecCtx->bits_per_raw_sample > 16 || outSampleRate > 48000)
-                    {
-                        // Try 32-bit first (works for most USB DACs)
-                        if (snd_pcm_hw_params_test_format(pcmHandle, hwParams, SND_PCM_FORMAT_S32_LE) == 0)
-                        {
-                            alsaFormat = SND_PCM_FORMAT_S32_LE;
-                            swrOutFmt = AV_SAMPLE_FMT_S32;
-                            outBytesPerSample = 4;
-                            OPENAUTO_LOG(info) << "[AudioPlayer] Using S32_LE output format";
-                        }
-                        else if (snd_pcm_hw_params_test_format(pcmHandle, hwParams, SND_PCM_FORMAT_S24_3LE) == 0)
-                        {
-                            // S24_3LE — 24-bit packed, use S32 in swresample then we'll handle packing
-                            // For simplicity, stay with S32 → ALSA will handle format mismatch via plug
-                            alsaFormat = SND_PCM_FORMAT_S32_LE;
-                            swrOutFmt = AV_SAMPLE_FMT_S32;
-                            outBytesPerSample = 4;
-                            OPENAUTO_LOG(info) << "[AudioPlayer] DAC prefers S24_3LE, using S32_LE (ALSA plug converts)";
-                        }
-                        else
+                        startPrefetch(index);
+                        if (!playTrack(*decoder))
                         {
-                            OPENAUTO_LOG(info) << "[AudioPlayer] DAC only supports S16_LE";
+                            // Skip or stop: the device stays open for whatever plays next
+                            stopPrefetch();
+                            output_->drop();
+                            return;
                         }
-                    }
 
-                    snd_pcm_hw_params_set_format(pcmHandle, hwParams, alsaFormat);
-                    snd_pcm_hw_params_set_channels(pcmHandle, hwParams, 2);
+                        // Track ended: continue straight into the prefetched one
+                        auto next = takePrefetched(index);
+                        if (!next)
+                            break;
 
-                    unsigned int alsaRate = static_cast<unsigned int>(outSampleRate);
-                    snd_pcm_hw_params_set_rate_near(pcmHandle, hwParams, &alsaRate, nullptr);
-                    // Confirm the actual rate ALSA accepted
-                    if (alsaRate != static_cast<unsigned int>(outSampleRate))
-                    {
-                        OPENAUTO_LOG(info) << "[AudioPlayer] ALSA adjusted rate from " << outSampleRate << " to " << alsaRate << "Hz";
-                        outSampleRate = static_cast<int>(alsaRate);
+                        index = prefetchedIndex_;
+                        decoder = std::move(next);
+                        position_ = 0;
+                        announceTrack(index, prefetchedFile_);
+                        OPENAUTO_LOG(info) << "[AudioPlayer] Gapless handoff to " << prefetchedFile_.toStdString();
                     }
 
-                    // Scale buffer sizes for high sample rates to avoid underruns
-                    // At 192kHz we need ~4x the buffer vs 44.1kHz
-                    unsigned int rateMultiplier = (static_cast<unsigned int>(outSampleRate) + 44099) / 44100;
-                    snd_pcm_uframes_t bufferSize = 8192 * rateMultiplier;
-                    snd_pcm_uframes_t periodSize = 2048 * rateMultiplier;
-                    snd_pcm_hw_params_set_buffer_size_near(pcmHandle, hwParams, &bufferSize);
-                    snd_pcm_hw_params_set_period_size_near(pcmHandle, hwParams, &periodSize, nullptr);
+                    output_->close(true);
 
-                    err = snd_pcm_hw_params(pcmHandle, hwParams);
-                    if (err < 0)
+                    if (!stopRequested_)
                     {
-                        OPENAUTO_LOG(error) << "[AudioPlayer] ALSA hw_params failed: " << snd_strerror(err);
-                        cleanup();
-                        return;
+                        onTrackFinished();
                     }
+                }
 
-                    snd_pcm_prepare(pcmHandle);
-
-                    // Store playback quality info for UI display
-                    sampleRate_ = outSampleRate;
-                    bitDepth_ = outBytesPerSample * 8;
-                    nativeOffload_ = nativeOffload;
-
-                    // Setup resampler (even for native offload, we may need format conversion)
-                    swrCtx = swr_alloc();
-                    if (!swrCtx)
+                bool AudioPlayer::startOutput(TrackDecoder &decoder)
+                {
+                    const OutputFormat format = decoder.hasOutput()
+                                                    ? decoder.format()
+                                                    : output_->choose(decoder.sourceRate(), decoder.bitsPerRawSample());
+                    if (!output_->configure(format))
+                        return false;
+
+                    // A prefetched track converted for another rate starts over
+                    if (decoder.hasOutput() && decoder.rate() != output_->rate())
+                        decoder.seek(0);
+                    if (!decoder.hasOutput() || decoder.rate() != output_->rate())
                     {
-                        OPENAUTO_LOG(error) << "[AudioPlayer] Failed to allocate resampler";
-                        cleanup();
-                        return;
+                        if (!decoder.setOutput(format, output_->rate()))
+                            return false;
                     }
 
-#if LIBAVUTIL_VERSION_MAJOR >= 57
-                    AVChannelLayout outLayout = AV_CHANNEL_LAYOUT_STEREO;
-                    swr_alloc_set_opts2(&swrCtx,
-                                        &outLayout, swrOutFmt, outSampleRate,
-                                        &codecCtx->ch_layout, codecCtx->sample_fmt, codecCtx->sample_rate,
-                                        0, nullptr);
-#else
-                    int64_t inChannelLayout = codecCtx->channel_layout ? codecCtx->channel_layout : av_get_default_channel_layout(codecCtx->channels);
-                    av_opt_set_int(swrCtx, "in_channel_layout", inChannelLayout, 0);
-                    av_opt_set_int(swrCtx, "in_sample_rate", codecCtx->sample_rate, 0);
-                    av_opt_set_sample_fmt(swrCtx, "in_sample_fmt", codecCtx->sample_fmt, 0);
-                    av_opt_set_int(swrCtx, "out_channel_layout", AV_CH_LAYOUT_STEREO, 0);
-                    av_opt_set_int(swrCtx, "out_sample_rate", outSampleRate, 0);
-                    av_opt_set_sample_fmt(swrCtx, "out_sample_fmt", swrOutFmt, 0);
-#endif
+                    // Store playback quality info for UI display
+                    sampleRate_ = static_cast<int>(output_->rate());
+                    bitDepth_ = format.bytesPerSample * 8;
+                    nativeOffload_ = format.nativeOffload;
+
+                    OPENAUTO_LOG(info) << "[AudioPlayer] Playing (source: " << decoder.sourceRate() << "Hz"
+                                       << ", output: " << output_->rate() << "Hz"
+                                       << ", " << (format.bytesPerSample * 8) << "-bit"
+                                       << ", codec: " << decoder.codecName()
+                                       << ", offload: " << (format.nativeOffload ? "yes" : "no") << ")";
+                    return true;
+                }
 
-                    if (swr_init(swrCtx) < 0)
+                bool AudioPlayer::playTrack(TrackDecoder &decoder)
+                {
+                    const int bytesPerFrame = decoder.bytesPerFrame();
+                    if (!decoder.preroll.empty())
                     {
-                        OPENAUTO_LOG(error) << "[AudioPlayer] Failed to init resampler";
-                        cleanup();
-                        return;
+                        output_->write(decoder.preroll.data(), static_cast<int>(decoder.preroll.size() / bytesPerFrame));
+                        decoder.preroll.clear();
+                        decoder.preroll.shrink_to_fit();
                     }
 
-                    OPENAUTO_LOG(info) << "[AudioPlayer] Playing: " << currentFile_.toStdString()
-                                       << " (source: " << srcSampleRate << "Hz"
-                                       << ", output: " << outSampleRate << "Hz"
-                                       << ", " << (outBytesPerSample * 8) << "-bit"
-                                       << ", codec: " << codec->name
-                                       << ", offload: " << (nativeOffload ? "yes" : "no") << ")";
-
-                    // Decode loop
-                    frame = av_frame_alloc();
-                    packet = av_packet_alloc();
+                    // Decoded frames are collected up to one ALSA period and written
+                    // in a single call
+                    std::vector<uint8_t> batch;
+                    size_t used = 0;
+                    const size_t batchBytes = static_cast<size_t>(std::max(output_->periodFrames(), 1)) * bytesPerFrame;
                     int lastReportedSec = -1;
-
                     while (!stopRequested_)
                     {
+                        // Seeks apply while paused too, so resume starts at the target
+                        const int seekTarget = seekTarget_.exchange(-1);
+                        if (seekTarget >= 0)
+                        {
+                            // Queued audio is from before the target: drop, don't drain
+                            used = 0;
+                            output_->drop();
+                            decoder.seek(seekTarget);
+                            lastReportedSec = -1;
+                        }
+
                         // Handle pause
                         if (paused_)
                         {
@@ -640,76 +1517,33 @@ namespace f1x
                             continue;
                         }
 
-                        int readRet = av_read_frame(formatCtx, packet);
-                        if (readRet < 0)
+                        int frames = decoder.decode(batch, used);
+                        if (frames <= 0)
                         {
-                            // End of file or error
-                            break;
+                            if (used > 0)
+                                output_->write(batch.data(), static_cast<int>(used / bytesPerFrame));
+                            return true;
                         }
+                        used += static_cast<size_t>(frames) * bytesPerFrame;
 
-                        if (packet->stream_index != audioStreamIdx)
+                        // The decoder runs ahead of the speakers by the decode-ahead ring
+                        int posMs = std::max(decoder.positionMs() - output_->queuedMs(), 0);
+                        position_ = posMs;
+                        int currentSec = posMs / 1000;
+                        if (currentSec != lastReportedSec && positionUpdates_)
                         {
-                            av_packet_unref(packet);
-                            continue;
+                            lastReportedSec = currentSec;
+                            QMetaObject::invokeMethod(this, [this]()
+                                                      { emit positionChanged(); }, Qt::QueuedConnection);
                         }
 
-                        int sendRet = avcodec_send_packet(codecCtx, packet);
-                        av_packet_unref(packet);
-
-                        if (sendRet < 0)
-                            continue;
-
-                        while (!stopRequested_ && avcodec_receive_frame(codecCtx, frame) >= 0)
+                        if (used >= batchBytes)
                         {
-                            // Calculate position from pts
-                            if (frame->pts != AV_NOPTS_VALUE)
-                            {
-                                double timeBase = av_q2d(audioStream->time_base);
-                                int posMs = static_cast<int>(frame->pts * timeBase * 1000.0);
-                                position_ = posMs;
-
-                                int currentSec = posMs / 1000;
-                                if (currentSec != lastReportedSec)
-                                {
-                                    lastReportedSec = currentSec;
-                                    QMetaObject::invokeMethod(this, [this]()
-                                                              { emit positionChanged(); }, Qt::QueuedConnection);
-                                }
-                            }
-
-                            // Resample / format-convert to ALSA output format
-                            int outSamples = swr_get_out_samples(swrCtx, frame->nb_samples);
-                            uint8_t *outBuf = nullptr;
-                            av_samples_alloc(&outBuf, nullptr, 2, outSamples, swrOutFmt, 0);
-
-                            int converted = swr_convert(swrCtx, &outBuf, outSamples,
-                                                        (const uint8_t **)frame->data, frame->nb_samples);
-
-                            if (converted > 0)
-                            {
-                                snd_pcm_sframes_t written = snd_pcm_writei(pcmHandle, outBuf, converted);
-                                if (written < 0)
-                                {
-                                    snd_pcm_recover(pcmHandle, written, 0);
-                                }
-                            }
-
-                            if (outBuf)
-                                av_freep(&outBuf);
-
-                            av_frame_unref(frame);
-
-                            if (paused_)
-                                break;
+                            output_->write(batch.data(), static_cast<int>(used / bytesPerFrame));
+                            used = 0;
                         }
                     }
-
-                    cleanup();
-
-                    if (!stopRequested_)
-                    {
-                        onTrackFinished();
-                    }
+                    return false;
                 }
 
             } // namespace player
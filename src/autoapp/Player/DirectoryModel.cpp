@@ -0,0 +1,170 @@
+/*
+ *  DirectoryModel - List model of one folder for the file browser
+ */
+
+#include <f1x/openauto/autoapp/Player/DirectoryModel.hpp>
+#include <algorithm>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                bool DirectoryEntry::operator==(const DirectoryEntry &other) const
+                {
+                    return name == other.name && path == other.path && isDir == other.isDir && audioCount == other.audioCount && art == other.art;
+                }
+
+                DirectoryModel::DirectoryModel(QObject *parent)
+                    : QAbstractListModel(parent)
+                {
+                }
+
+                int DirectoryModel::rowCount(const QModelIndex &parent) const
+                {
+                    return parent.isValid() ? 0 : entries_.size();
+                }
+
+                QVariant DirectoryModel::data(const QModelIndex &index, int role) const
+                {
+                    if (!index.isValid() || index.row() >= entries_.size())
+                        return QVariant();
+
+                    const DirectoryEntry &entry = entries_.at(index.row());
+                    switch (role)
+                    {
+                    case NameRole:
+                        return entry.name;
+                    case PathRole:
+                        return entry.path;
+                    case IsDirRole:
+                        return entry.isDir;
+                    case IsAudioRole:
+                        return !entry.isDir;
+                    case AudioCountRole:
+                        if (entry.isDir && entry.audioCount == DirectoryEntry::cCountUnknown)
+                        {
+                            // Counting means a readdir per folder: only for rows on screen
+                            if (!entry.countRequested)
+                            {
+                                entry.countRequested = true;
+                                emit const_cast<DirectoryModel *>(this)->audioCountNeeded(entry.path);
+                            }
+                            return 0;
+                        }
+                        return std::max(entry.audioCount, 0);
+                    case ArtRole:
+                        return entry.art;
+                    default:
+                        return QVariant();
+                    }
+                }
+
+                QHash<int, QByteArray> DirectoryModel::roleNames() const
+                {
+                    return {
+                        {NameRole, "name"},
+                        {PathRole, "path"},
+                        {IsDirRole, "isDir"},
+                        {IsAudioRole, "isAudio"},
+                        {AudioCountRole, "audioCount"},
+                        {ArtRole, "art"}};
+                }
+
+                int DirectoryModel::count() const
+                {
+                    return entries_.size();
+                }
+
+                QStringList DirectoryModel::audioFiles() const
+                {
+                    QStringList result;
+                    for (const auto &entry : entries_)
+                    {
+                        if (!entry.isDir)
+                            result << entry.path;
+                    }
+                    return result;
+                }
+
+                void DirectoryModel::clear()
+                {
+                    if (entries_.isEmpty())
+                        return;
+
+                    beginResetModel();
+                    entries_.clear();
+                    endResetModel();
+                    emit countChanged();
+                }
+
+                bool DirectoryModel::lessThan(const DirectoryEntry &a, const DirectoryEntry &b)
+                {
+                    if (a.isDir != b.isDir)
+                        return a.isDir;
+                    return a.name.compare(b.name, Qt::CaseInsensitive) < 0;
+                }
+
+                void DirectoryModel::insert(QVector<DirectoryEntry> entries)
+                {
+                    if (entries.isEmpty())
+                        return;
+
+                    std::sort(entries.begin(), entries.end(), lessThan);
+
+                    // Sorted sources (the library index) arrive in order: one append
+                    if (entries_.isEmpty() || !lessThan(entries.front(), entries_.back()))
+                    {
+                        beginInsertRows(QModelIndex(), entries_.size(), entries_.size() + entries.size() - 1);
+                        entries_ += entries;
+                        endInsertRows();
+                    }
+                    else
+                    {
+                        for (auto &entry : entries)
+                        {
+                            const int row = std::upper_bound(entries_.begin(), entries_.end(), entry, lessThan) - entries_.begin();
+                            beginInsertRows(QModelIndex(), row, row);
+                            entries_.insert(row, std::move(entry));
+                            endInsertRows();
+                        }
+                    }
+                    emit countChanged();
+                }
+
+                void DirectoryModel::replace(QVector<DirectoryEntry> entries)
+                {
+                    std::sort(entries.begin(), entries.end(), lessThan);
+                    if (entries == entries_)
+                        return;
+
+                    const bool countDiffers = entries.size() != entries_.size();
+                    beginResetModel();
+                    entries_ = std::move(entries);
+                    endResetModel();
+                    if (countDiffers)
+                        emit countChanged();
+                }
+
+                void DirectoryModel::setAudioCount(const QString &path, int count)
+                {
+                    for (int row = 0; row < entries_.size(); ++row)
+                    {
+                        if (entries_[row].isDir && entries_[row].path == path)
+                        {
+                            entries_[row].audioCount = count;
+                            const QModelIndex changed = index(row);
+                            emit dataChanged(changed, changed, {AudioCountRole});
+                            return;
+                        }
+                    }
+                }
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
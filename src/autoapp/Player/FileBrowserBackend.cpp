@@ -8,8 +8,12 @@
 #include <QStorageInfo>
 #include <QVariantMap>
 #include <QDirIterator>
-#include <QTimer>
+#include <f1x/openauto/autoapp/Allocation.hpp>
 #include <f1x/openauto/autoapp/Player/FileBrowserBackend.hpp>
+#include <f1x/openauto/autoapp/Player/DirectoryModel.hpp>
+#include <f1x/openauto/autoapp/Player/MediaLibrary.hpp>
+#include <f1x/openauto/autoapp/Player/MountWatcher.hpp>
+#include <f1x/openauto/autoapp/Player/ArtCache.hpp>
 #include <f1x/openauto/Common/Log.hpp>
 
 namespace f1x
@@ -21,8 +25,31 @@ namespace f1x
             namespace player
             {
 
+                namespace
+                {
+                    // Rough heap size of a list of flat QVariantMaps: a node and a
+                    // QVariant per entry and value, the strings' characters
+                    size_t modelBytes(const QVariantList &list)
+                    {
+                        size_t bytes = static_cast<size_t>(list.size()) * sizeof(QVariant);
+                        for (const auto &item : list)
+                        {
+                            const QVariantMap map = item.toMap();
+                            for (auto it = map.cbegin(); it != map.cend(); ++it)
+                            {
+                                bytes += 3 * sizeof(void *) + sizeof(QVariant) +
+                                         static_cast<size_t>(it.key().size()) * sizeof(QChar);
+                                if (it.value().type() == QVariant::String)
+                                    bytes += static_cast<size_t>(it.value().toString().size()) * sizeof(QChar);
+                            }
+                        }
+                        return bytes;
+                    }
+                }
+
                 FileBrowserBackend::FileBrowserBackend(QObject *parent)
-                    : QObject(parent), mediaWatcher_(new QFileSystemWatcher(this))
+                    : QObject(parent), mediaWatcher_(new QFileSystemWatcher(this)), library_(nullptr), entries_(new DirectoryModel(this)), searchResults_(new DirectoryModel(this)), scanning_(false),
+                      scanThread_(new QThread(this)), scanContext_(new QObject()), scanGeneration_(0), volumeProbePending_(false)
                 {
                     audioExtensions_ << "mp3"
                                      << "flac"
@@ -38,6 +65,14 @@ namespace f1x
                                      << "aiff"
                                      << "aif";
 
+                    library_ = new MediaLibrary(audioExtensions_, this);
+                    connect(library_, &MediaLibrary::indexChanged, this, &FileBrowserBackend::onIndexChanged);
+                    connect(entries_, &DirectoryModel::audioCountNeeded, this, &FileBrowserBackend::requestAudioCount);
+
+                    scanContext_->moveToThread(scanThread_);
+                    scanThread_->setObjectName("oa-filebrowser");
+                    scanThread_->start(QThread::LowPriority);
+
                     // Watch /media for USB mount changes
                     if (QDir("/media").exists())
                         mediaWatcher_->addPath("/media");
@@ -49,17 +84,34 @@ namespace f1x
                     connect(mediaWatcher_, &QFileSystemWatcher::directoryChanged,
                             this, &FileBrowserBackend::refreshVolumes);
 
-                    // udevil/devmon mounts may not trigger QFileSystemWatcher reliably
-                    // so also poll every 3 seconds for mount changes
-                    auto *pollTimer = new QTimer(this);
-                    connect(pollTimer, &QTimer::timeout, this, &FileBrowserBackend::refreshVolumes);
-                    pollTimer->start(3000);
+                    // udevil/devmon mounts may not trigger QFileSystemWatcher reliably;
+                    // the mount table itself does, without polling
+                    auto *mountWatcher = new MountWatcher("/media/", this);
+                    connect(mountWatcher, &MountWatcher::mountsChanged, this, &FileBrowserBackend::refreshVolumes);
 
                     refreshVolumes();
-                    OPENAUTO_LOG(info) << "[FileBrowser] Initialized, watching /media for USB drives (polling every 3s)";
+                    OPENAUTO_LOG(info) << "[FileBrowser] Initialized, watching /media for USB drives";
+                }
+
+                FileBrowserBackend::~FileBrowserBackend()
+                {
+                    // A scan in progress stops at its next entry
+                    ++scanGeneration_;
+                    scanThread_->quit();
+                    scanThread_->wait();
+                    delete scanContext_;
+                    AllocationAccounting::instance().release(AllocationTag::UiModels, modelBytes(mountedVolumes_));
                 }
 
-                FileBrowserBackend::~FileBrowserBackend() = default;
+                const MediaLibrary *FileBrowserBackend::library() const
+                {
+                    return library_;
+                }
+
+                void FileBrowserBackend::setLoudnessAnalysis(bool enabled)
+                {
+                    library_->setLoudnessAnalysis(enabled);
+                }
 
                 QVariantList FileBrowserBackend::mountedVolumes() const
                 {
@@ -76,9 +128,33 @@ namespace f1x
                     return volumeName_;
                 }
 
-                QVariantList FileBrowserBackend::currentEntries() const
+                QObject *FileBrowserBackend::entries() const
+                {
+                    return entries_;
+                }
+
+                QString FileBrowserBackend::searchQuery() const
+                {
+                    return searchQuery_;
+                }
+
+                void FileBrowserBackend::setSearchQuery(const QString &query)
+                {
+                    if (query == searchQuery_)
+                        return;
+                    searchQuery_ = query;
+                    updateSearchResults();
+                    emit searchQueryChanged();
+                }
+
+                QObject *FileBrowserBackend::searchResults() const
                 {
-                    return currentEntries_;
+                    return searchResults_;
+                }
+
+                bool FileBrowserBackend::isScanning() const
+                {
+                    return scanning_;
                 }
 
                 QStringList FileBrowserBackend::breadcrumb() const
@@ -100,6 +176,20 @@ namespace f1x
                 }
 
                 void FileBrowserBackend::refreshVolumes()
+                {
+                    // Bursts of watcher events must not pile up behind a long folder scan
+                    if (volumeProbePending_.exchange(true))
+                        return;
+
+                    QMetaObject::invokeMethod(scanContext_, [this]()
+                                              {
+                        QVariantList volumes = probeVolumes();
+                        volumeProbePending_ = false;
+                        QMetaObject::invokeMethod(this, [this, volumes]()
+                                                  { applyVolumes(volumes); }, Qt::QueuedConnection); }, Qt::QueuedConnection);
+                }
+
+                QVariantList FileBrowserBackend::probeVolumes()
                 {
                     QVariantList newVolumes;
 
@@ -142,9 +232,10 @@ namespace f1x
                             }
                             if (!found)
                             {
-                                // Check if it has files (is actually mounted)
-                                QDir subDir(subPath);
-                                if (subDir.count() > 2) // more than . and ..
+                                // Check if it has files (is actually mounted); one
+                                // entry is enough, no need to read the whole root
+                                QDirIterator subDir(subPath, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden);
+                                if (subDir.hasNext())
                                 {
                                     QVariantMap entry;
                                     entry["name"] = sub;
@@ -157,6 +248,13 @@ namespace f1x
                         }
                     }
 
+                    return newVolumes;
+                }
+
+                void FileBrowserBackend::applyVolumes(const QVariantList &newVolumes)
+                {
+                    QDir mediaDir("/media");
+
                     // Only emit if the volume list actually changed
                     bool changed = (newVolumes.size() != mountedVolumes_.size());
                     if (!changed)
@@ -173,7 +271,23 @@ namespace f1x
 
                     if (changed)
                     {
+                        AllocationAccounting::instance().release(AllocationTag::UiModels, modelBytes(mountedVolumes_));
                         mountedVolumes_ = newVolumes;
+                        AllocationAccounting::instance().record(AllocationTag::UiModels, modelBytes(mountedVolumes_));
+
+                        // Selected volume was unplugged: stop indexing it
+                        bool selectedMounted = false;
+                        for (const auto &v : mountedVolumes_)
+                        {
+                            if (v.toMap()["path"].toString() == volumeRoot_)
+                            {
+                                selectedMounted = true;
+                                break;
+                            }
+                        }
+                        if (!selectedMounted)
+                            library_->closeVolume();
+
                         OPENAUTO_LOG(info) << "[FileBrowser] Found " << mountedVolumes_.size() << " mounted volumes";
 
                         // Re-add any new /media subdirectories to the watcher
@@ -205,6 +319,8 @@ namespace f1x
                             break;
                         }
                     }
+                    library_->openVolume(mountPath);
+                    updateSearchResults();
                     navigateTo(mountPath);
                 }
 
@@ -233,50 +349,148 @@ namespace f1x
 
                 void FileBrowserBackend::scanDirectory(const QString &path)
                 {
-                    currentEntries_.clear();
+                    // Supersedes (and so cancels) whatever the scan thread is doing
+                    const quint64 generation = ++scanGeneration_;
+                    entries_->clear();
+                    if (!scanning_)
+                    {
+                        scanning_ = true;
+                        emit scanningChanged();
+                    }
 
-                    QDir dir(path);
-                    if (!dir.exists())
+                    QMetaObject::invokeMethod(scanContext_, [this, path, generation]()
+                                              { listDirectory(path, generation, false); }, Qt::QueuedConnection);
+                }
+
+                void FileBrowserBackend::onIndexChanged()
+                {
+                    updateSearchResults();
+                    if (currentPath_.isEmpty())
                         return;
 
-                    // Get directories first
-                    const auto dirs = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name | QDir::IgnoreCase);
-                    for (const auto &d : dirs)
+                    // Re-list in one piece so the view is left alone when the
+                    // new index changed nothing in this folder
+                    const quint64 generation = ++scanGeneration_;
+                    const QString path = currentPath_;
+                    QMetaObject::invokeMethod(scanContext_, [this, path, generation]()
+                                              { listDirectory(path, generation, true); }, Qt::QueuedConnection);
+                }
+
+                void FileBrowserBackend::requestAudioCount(const QString &path)
+                {
+                    const quint64 generation = scanGeneration_;
+                    QMetaObject::invokeMethod(scanContext_, [this, path, generation]()
+                                              { countAudioFiles(path, generation); }, Qt::QueuedConnection);
+                }
+
+                void FileBrowserBackend::listDirectory(const QString &path, quint64 generation, bool refresh)
+                {
+                    if (generation != scanGeneration_)
+                        return;
+
+                    QVector<DirectoryEntry> chunk;
+                    const QString base = QDir::cleanPath(path);
+
+                    LibraryFolder folder;
+                    if (library_->folder(base, folder))
                     {
-                        QVariantMap entry;
-                        entry["name"] = d;
-                        entry["path"] = dir.absoluteFilePath(d);
-                        entry["isDir"] = true;
-                        entry["isAudio"] = false;
-
-                        // Count audio files in subfolder
-                        QDir subDir(dir.absoluteFilePath(d));
-                        int audioCount = 0;
-                        const auto subFiles = subDir.entryList(QDir::Files);
-                        for (const auto &sf : subFiles)
+                        // Indexed: no I/O, and folder counts are known up front
+                        for (const auto &d : folder.subdirs)
+                        {
+                            DirectoryEntry entry;
+                            entry.name = d;
+                            entry.path = base + '/' + d;
+                            entry.isDir = true;
+                            LibraryFolder sub;
+                            if (library_->folder(entry.path, sub))
+                                entry.audioCount = sub.tracks.size();
+                            chunk.append(entry);
+                        }
+                        for (const auto &track : folder.tracks)
                         {
-                            if (isAudioFile(sf))
-                                audioCount++;
+                            DirectoryEntry entry;
+                            entry.name = track.name;
+                            entry.path = base + '/' + track.name;
+                            entry.art = library_->artCache()->url(track.artKey, ArtCache::cListSize);
+                            chunk.append(entry);
                         }
-                        entry["audioCount"] = audioCount;
-                        currentEntries_.append(entry);
+                        deliver(std::move(chunk), generation, refresh, true);
+                        return;
                     }
 
-                    // Then audio files
-                    const auto files = dir.entryList(QDir::Files, QDir::Name | QDir::IgnoreCase);
-                    for (const auto &f : files)
+                    // Streams readdir instead of collecting and sorting it all
+                    // first; the model keeps the order as chunks arrive
+                    QDirIterator it(base, QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+                    while (it.hasNext())
                     {
-                        if (isAudioFile(f))
+                        if (generation != scanGeneration_)
+                            return;
+
+                        it.next();
+                        const QFileInfo info = it.fileInfo();
+                        DirectoryEntry entry;
+                        entry.isDir = info.isDir();
+                        if (!entry.isDir && !isAudioFile(info.fileName()))
+                            continue;
+                        entry.name = info.fileName();
+                        entry.path = info.absoluteFilePath();
+                        chunk.append(entry);
+
+                        if (!refresh && chunk.size() >= cScanChunk)
                         {
-                            QVariantMap entry;
-                            entry["name"] = f;
-                            entry["path"] = dir.absoluteFilePath(f);
-                            entry["isDir"] = false;
-                            entry["isAudio"] = true;
-                            entry["audioCount"] = 0;
-                            currentEntries_.append(entry);
+                            deliver(std::move(chunk), generation, false, false);
+                            chunk = QVector<DirectoryEntry>();
                         }
                     }
+                    deliver(std::move(chunk), generation, refresh, true);
+                }
+
+                void FileBrowserBackend::countAudioFiles(const QString &path, quint64 generation)
+                {
+                    if (generation != scanGeneration_)
+                        return;
+
+                    int count = 0;
+                    LibraryFolder folder;
+                    if (library_->folder(path, folder))
+                    {
+                        count = folder.tracks.size();
+                    }
+                    else
+                    {
+                        QDirIterator it(path, QDir::Files);
+                        while (it.hasNext())
+                        {
+                            if (generation != scanGeneration_)
+                                return;
+                            it.next();
+                            if (isAudioFile(it.fileName()))
+                                count++;
+                        }
+                    }
+
+                    QMetaObject::invokeMethod(this, [this, path, count, generation]()
+                                              {
+                        if (generation == scanGeneration_)
+                            entries_->setAudioCount(path, count); }, Qt::QueuedConnection);
+                }
+
+                void FileBrowserBackend::deliver(QVector<DirectoryEntry> entries, quint64 generation, bool refresh, bool done)
+                {
+                    QMetaObject::invokeMethod(this, [this, entries, generation, refresh, done]()
+                                              {
+                        // The user navigated on since this was listed
+                        if (generation != scanGeneration_)
+                            return;
+                        if (refresh)
+                            entries_->replace(entries);
+                        else
+                            entries_->insert(entries);
+                        if (done && scanning_)
+                        {
+                            scanning_ = false;
+                            emit scanningChanged();
+                        } }, Qt::QueuedConnection);
                 }
 
                 bool FileBrowserBackend::isAudioFile(const QString &fileName) const
@@ -288,6 +502,9 @@ namespace f1x
                 QStringList FileBrowserBackend::collectAudioFiles(const QString &path) const
                 {
                     QStringList result;
+                    if (library_->tracksUnder(path, result))
+                        return result;
+
                     QDirIterator it(path, QDir::Files, QDirIterator::Subdirectories);
                     while (it.hasNext())
                     {
@@ -299,18 +516,60 @@ namespace f1x
                     return result;
                 }
 
-                QStringList FileBrowserBackend::currentAudioFiles() const
+                QVariantList FileBrowserBackend::search(const QString &query) const
                 {
-                    QStringList result;
-                    for (const auto &entry : currentEntries_)
+                    QVariantList result;
+                    for (const auto &filePath : library_->search(query, cSearchLimit))
                     {
-                        QVariantMap map = entry.toMap();
-                        if (map["isAudio"].toBool())
-                            result << map["path"].toString();
+                        LibraryTrack track;
+                        if (!library_->track(filePath, track))
+                            continue;
+
+                        QVariantMap entry;
+                        entry["name"] = track.name;
+                        entry["path"] = filePath;
+                        entry["title"] = track.title.isEmpty() ? QFileInfo(track.name).completeBaseName() : track.title;
+                        entry["artist"] = track.artist;
+                        entry["album"] = track.album;
+                        entry["durationMs"] = track.durationMs;
+                        entry["isDir"] = false;
+                        entry["isAudio"] = true;
+                        entry["audioCount"] = 0;
+                        result.append(entry);
                     }
+                    // QML owns the list from here
+                    AllocationAccounting::instance().countTransient(AllocationTag::UiModels, modelBytes(result));
                     return result;
                 }
 
+                void FileBrowserBackend::updateSearchResults()
+                {
+                    // Answered from the mapped search index in well under a frame,
+                    // so this stays on the GUI thread and runs per keystroke
+                    QVector<DirectoryEntry> results;
+                    if (!searchQuery_.trimmed().isEmpty())
+                    {
+                        for (const auto &filePath : library_->search(searchQuery_, cSearchLimit))
+                        {
+                            LibraryTrack track;
+                            if (!library_->track(filePath, track))
+                                continue;
+
+                            DirectoryEntry entry;
+                            entry.name = track.title.isEmpty() ? QFileInfo(track.name).completeBaseName() : track.title;
+                            entry.path = filePath;
+                            entry.art = library_->artCache()->url(track.artKey, ArtCache::cListSize);
+                            results.append(entry);
+                        }
+                    }
+                    searchResults_->replace(std::move(results));
+                }
+
+                QStringList FileBrowserBackend::currentAudioFiles() const
+                {
+                    return searchQuery_.trimmed().isEmpty() ? entries_->audioFiles() : searchResults_->audioFiles();
+                }
+
             } // namespace player
         } // namespace autoapp
     } // namespace openauto
@@ -0,0 +1,245 @@
+/*
+ *  LoudnessMeter - EBU R128 integrated loudness and sample peak of a track
+ */
+
+#include <f1x/openauto/autoapp/Player/LoudnessMeter.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#include <algorithm>
+#include <cmath>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+#include <libavutil/channel_layout.h>
+#include <libswresample/swresample.h>
+}
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                namespace
+                {
+                    constexpr double cAbsoluteGateLufs = -70.0;
+                    constexpr double cRelativeGateLu = -10.0;
+                    constexpr int cStepsPerBlock = 4;
+
+                    double toLufs(double meanSquare)
+                    {
+                        return -0.691 + 10.0 * std::log10(meanSquare);
+                    }
+
+                    double fromLufs(double lufs)
+                    {
+                        return std::pow(10.0, (lufs + 0.691) / 10.0);
+                    }
+                }
+
+                constexpr int LoudnessMeter::cSampleRate;
+                constexpr double LoudnessMeter::cReferenceLufs;
+
+                double LoudnessMeter::Biquad::run(double x, int channel)
+                {
+                    const double y = b0 * x + z1[channel];
+                    z1[channel] = b1 * x - a1 * y + z2[channel];
+                    z2[channel] = b2 * x - a2 * y;
+                    return y;
+                }
+
+                // BS.1770-4 K-weighting coefficients for 48 kHz
+                LoudnessMeter::LoudnessMeter()
+                    : shelf_{1.53512485958697, -2.69169618940638, 1.19839281085285, -1.69065929318241, 0.73248077421585, {0, 0}, {0, 0}},
+                      highPass_{1.0, -2.0, 1.0, -1.99004745483398, 0.99007225036621, {0, 0}, {0, 0}},
+                      stepSum_(0), stepFrames_(0), peak_(0)
+                {
+                }
+
+                void LoudnessMeter::add(const float *samples, size_t frames)
+                {
+                    for (size_t i = 0; i < frames; i++)
+                    {
+                        for (int channel = 0; channel < 2; channel++)
+                        {
+                            const float sample = samples[2 * i + channel];
+                            peak_ = std::max(peak_, std::fabs(sample));
+                            const double weighted = highPass_.run(shelf_.run(sample, channel), channel);
+                            stepSum_ += weighted * weighted;
+                        }
+                        if (++stepFrames_ == cStepFrames)
+                        {
+                            steps_.push_back(stepSum_ / cStepFrames);
+                            stepSum_ = 0;
+                            stepFrames_ = 0;
+                        }
+                    }
+                }
+
+                bool LoudnessMeter::integrated(double &lufs) const
+                {
+                    // 400 ms blocks overlapping by 75%: four consecutive steps each
+                    std::vector<double> blocks;
+                    for (size_t i = 0; i + cStepsPerBlock <= steps_.size(); i++)
+                    {
+                        double sum = 0;
+                        for (int step = 0; step < cStepsPerBlock; step++)
+                            sum += steps_[i + step];
+                        const double meanSquare = sum / cStepsPerBlock;
+                        if (meanSquare > 0 && toLufs(meanSquare) > cAbsoluteGateLufs)
+                            blocks.push_back(meanSquare);
+                    }
+                    if (blocks.empty())
+                        return false;
+
+                    double sum = 0;
+                    for (double block : blocks)
+                        sum += block;
+                    const double relativeGate = fromLufs(toLufs(sum / blocks.size()) + cRelativeGateLu);
+
+                    double gatedSum = 0;
+                    size_t gated = 0;
+                    for (double block : blocks)
+                    {
+                        if (block > relativeGate)
+                        {
+                            gatedSum += block;
+                            ++gated;
+                        }
+                    }
+                    if (gated == 0)
+                        return false;
+                    lufs = toLufs(gatedSum / gated);
+                    return true;
+                }
+
+                float LoudnessMeter::peak() const
+                {
+                    return peak_;
+                }
+
+                bool LoudnessMeter::measureFile(const QString &path, const std::atomic<bool> &cancel, double &lufs, float &peak)
+                {
+                    AVFormatContext *formatCtx = nullptr;
+                    AVCodecContext *codecCtx = nullptr;
+                    SwrContext *swrCtx = nullptr;
+                    AVFrame *frame = av_frame_alloc();
+                    AVPacket *packet = av_packet_alloc();
+                    std::vector<float> converted;
+                    LoudnessMeter meter;
+                    bool decoded = false;
+
+                    int streamIdx = -1;
+                    const AVCodec *codec = nullptr;
+                    if (frame && packet &&
+                        avformat_open_input(&formatCtx, path.toUtf8().constData(), nullptr, nullptr) >= 0 &&
+                        avformat_find_stream_info(formatCtx, nullptr) >= 0)
+                    {
+                        streamIdx = av_find_best_stream(formatCtx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+                        if (streamIdx >= 0)
+                            codec = avcodec_find_decoder(formatCtx->streams[streamIdx]->codecpar->codec_id);
+                    }
+                    if (streamIdx >= 0 && codec)
+                    {
+                        codecCtx = avcodec_alloc_context3(codec);
+                        if (codecCtx && (avcodec_parameters_to_context(codecCtx, formatCtx->streams[streamIdx]->codecpar) < 0 ||
+                                         avcodec_open2(codecCtx, codec, nullptr) < 0))
+                            avcodec_free_context(&codecCtx);
+                    }
+                    if (codecCtx)
+                    {
+                        // Same stereo downmix as playback, at the rate the
+                        // K-weighting coefficients are for
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+                        AVChannelLayout outLayout = AV_CHANNEL_LAYOUT_STEREO;
+                        swr_alloc_set_opts2(&swrCtx, &outLayout, AV_SAMPLE_FMT_FLT, cSampleRate,
+                                            &codecCtx->ch_layout, codecCtx->sample_fmt, codecCtx->sample_rate, 0, nullptr);
+#else
+                        swrCtx = swr_alloc();
+                        if (swrCtx)
+                        {
+                            const int64_t inLayout = codecCtx->channel_layout ? codecCtx->channel_layout : av_get_default_channel_layout(codecCtx->channels);
+                            av_opt_set_int(swrCtx, "in_channel_layout", inLayout, 0);
+                            av_opt_set_int(swrCtx, "in_sample_rate", codecCtx->sample_rate, 0);
+                            av_opt_set_sample_fmt(swrCtx, "in_sample_fmt", codecCtx->sample_fmt, 0);
+                            av_opt_set_int(swrCtx, "out_channel_layout", AV_CH_LAYOUT_STEREO, 0);
+                            av_opt_set_int(swrCtx, "out_sample_rate", cSampleRate, 0);
+                            av_opt_set_sample_fmt(swrCtx, "out_sample_fmt", AV_SAMPLE_FMT_FLT, 0);
+                        }
+#endif
+                        if (swrCtx && swr_init(swrCtx) < 0)
+                            swr_free(&swrCtx);
+                    }
+
+                    auto convert = [&](const uint8_t **input, int samples)
+                    {
+                        const int outSamples = swr_get_out_samples(swrCtx, samples);
+                        if (outSamples <= 0)
+                            return;
+                        converted.resize(static_cast<size_t>(outSamples) * 2);
+                        uint8_t *out = reinterpret_cast<uint8_t *>(converted.data());
+                        const int produced = swr_convert(swrCtx, &out, outSamples, input, samples);
+                        if (produced > 0)
+                            meter.add(converted.data(), static_cast<size_t>(produced));
+                    };
+
+                    if (swrCtx)
+                    {
+                        bool draining = false;
+                        while (!cancel)
+                        {
+                            const int ret = avcodec_receive_frame(codecCtx, frame);
+                            if (ret >= 0)
+                            {
+                                convert(const_cast<const uint8_t **>(frame->extended_data), frame->nb_samples);
+                                av_frame_unref(frame);
+                                continue;
+                            }
+                            if (ret != AVERROR(EAGAIN))
+                            {
+                                convert(nullptr, 0);
+                                decoded = true;
+                                break;
+                            }
+                            if (draining)
+                                break;
+                            if (av_read_frame(formatCtx, packet) < 0)
+                            {
+                                avcodec_send_packet(codecCtx, nullptr);
+                                draining = true;
+                                continue;
+                            }
+                            if (packet->stream_index == streamIdx)
+                                avcodec_send_packet(codecCtx, packet);
+                            av_packet_unref(packet);
+                        }
+                    }
+                    else
+                    {
+                        OPENAUTO_LOG(debug) << "[LoudnessMeter] Cannot decode " << path.toStdString();
+                    }
+
+                    if (swrCtx)
+                        swr_free(&swrCtx);
+                    if (codecCtx)
+                        avcodec_free_context(&codecCtx);
+                    if (formatCtx)
+                        avformat_close_input(&formatCtx);
+                    av_packet_free(&packet);
+                    av_frame_free(&frame);
+
+                    if (!decoded || !meter.integrated(lufs))
+                        return false;
+                    peak = meter.peak();
+                    return true;
+                }
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,651 @@
+/*
+ *  MediaLibrary - Persistent index of the audio files on a USB volume
+ */
+
+#include <QDir>
+#include <QFileInfo>
+#include <QStorageInfo>
+#include <QStandardPaths>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <f1x/openauto/autoapp/Player/MediaLibrary.hpp>
+#include <f1x/openauto/autoapp/Player/ArtCache.hpp>
+#include <f1x/openauto/autoapp/Player/LoudnessMeter.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#include <cstdlib>
+
+#include <blkid.h>
+#include <taglib/fileref.h>
+#include <taglib/tag.h>
+#include <taglib/tpropertymap.h>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                QDataStream &operator<<(QDataStream &stream, const LibraryTrack &track)
+                {
+                    return stream << track.name << track.mtime << track.size << qint32(track.durationMs)
+                                  << track.title << track.artist << track.album << track.artKey
+                                  << track.loudness << track.gainDb << track.peak;
+                }
+
+                QDataStream &operator>>(QDataStream &stream, LibraryTrack &track)
+                {
+                    qint32 durationMs = 0;
+                    stream >> track.name >> track.mtime >> track.size >> durationMs >> track.title >> track.artist >> track.album >> track.artKey >> track.loudness >> track.gainDb >> track.peak;
+                    track.durationMs = durationMs;
+                    return stream;
+                }
+
+                QDataStream &operator<<(QDataStream &stream, const LibraryFolder &folder)
+                {
+                    return stream << folder.mtime << folder.subdirs << folder.tracks;
+                }
+
+                QDataStream &operator>>(QDataStream &stream, LibraryFolder &folder)
+                {
+                    return stream >> folder.mtime >> folder.subdirs >> folder.tracks;
+                }
+
+                namespace
+                {
+                    QString joinPath(const QString &root, const QString &relative)
+                    {
+                        return relative.isEmpty() ? root : root + '/' + relative;
+                    }
+
+                    const LibraryTrack *findTrack(const LibraryFolder &folder, const QString &name)
+                    {
+                        for (const auto &track : folder.tracks)
+                        {
+                            if (track.name == name)
+                                return &track;
+                        }
+                        return nullptr;
+                    }
+
+                    // First value of @p key as a number, e.g. "-6.54 dB"
+                    bool tagNumber(const TagLib::PropertyMap &properties, const char *key, float &out)
+                    {
+                        const auto it = properties.find(key);
+                        if (it == properties.end() || it->second.isEmpty())
+                            return false;
+                        const std::string text = it->second.front().to8Bit();
+                        char *end = nullptr;
+                        out = std::strtof(text.c_str(), &end);
+                        return end != text.c_str();
+                    }
+
+                    void readLoudnessTags(const TagLib::PropertyMap &properties, LibraryTrack &track)
+                    {
+                        float value = 0;
+                        if (tagNumber(properties, "REPLAYGAIN_TRACK_GAIN", value))
+                        {
+                            track.gainDb = value;
+                        }
+                        else if (tagNumber(properties, "R128_TRACK_GAIN", value))
+                        {
+                            // Opus: Q7.8 dB towards -23 LUFS
+                            track.gainDb = value / 256.0f + static_cast<float>(LoudnessMeter::cReferenceLufs + 23.0);
+                        }
+                        else
+                        {
+                            return;
+                        }
+                        track.loudness = LibraryTrack::LoudnessTagged;
+                        if (tagNumber(properties, "REPLAYGAIN_TRACK_PEAK", value))
+                            track.peak = value;
+                    }
+                }
+
+                MediaLibrary::MediaLibrary(const QStringList &audioExtensions, QObject *parent)
+                    : QObject(parent), audioExtensions_(audioExtensions), artCache_(new ArtCache(this)), worker_(nullptr), cancel_(false), scanning_(false), loudnessAnalysis_(true), generation_(0)
+                {
+                }
+
+                MediaLibrary::~MediaLibrary()
+                {
+                    stopWorker();
+                }
+
+                // ========== Volume ==========
+                void MediaLibrary::openVolume(const QString &mountPath)
+                {
+                    const QString root = QDir::cleanPath(mountPath);
+                    if (root == root_)
+                        return;
+
+                    closeVolume();
+                    root_ = root;
+
+                    cancel_ = false;
+                    scanning_ = true;
+                    const int generation = generation_;
+                    worker_ = QThread::create([this, root, generation]()
+                                              { run(root, generation); });
+                    worker_->start(QThread::LowPriority);
+                    emit scanningChanged();
+                }
+
+                void MediaLibrary::closeVolume()
+                {
+                    stopWorker();
+                    // Drops results the worker queued before it was stopped
+                    ++generation_;
+                    root_.clear();
+
+                    bool hadIndex;
+                    {
+                        QMutexLocker locker(&mutex_);
+                        hadIndex = snapshot_ != nullptr;
+                        snapshot_.reset();
+                    }
+                    if (hadIndex)
+                        emit indexChanged();
+                }
+
+                void MediaLibrary::stopWorker()
+                {
+                    if (!worker_)
+                        return;
+
+                    cancel_ = true;
+                    worker_->wait();
+                    delete worker_;
+                    worker_ = nullptr;
+
+                    if (scanning_.exchange(false))
+                        emit scanningChanged();
+                }
+
+                void MediaLibrary::setLoudnessAnalysis(bool enabled)
+                {
+                    loudnessAnalysis_ = enabled;
+                }
+
+                bool MediaLibrary::isReady() const
+                {
+                    return snapshot() != nullptr;
+                }
+
+                bool MediaLibrary::isScanning() const
+                {
+                    return scanning_;
+                }
+
+                ArtCache *MediaLibrary::artCache() const
+                {
+                    return artCache_;
+                }
+
+                // ========== Lookups ==========
+                MediaLibrary::SnapshotPtr MediaLibrary::snapshot() const
+                {
+                    QMutexLocker locker(&mutex_);
+                    return snapshot_;
+                }
+
+                bool MediaLibrary::relativeTo(const Snapshot &snapshot, const QString &path, QString &relative)
+                {
+                    const QString clean = QDir::cleanPath(path);
+                    if (clean == snapshot.root)
+                    {
+                        relative.clear();
+                        return true;
+                    }
+
+                    const QString prefix = snapshot.root.endsWith('/') ? snapshot.root : snapshot.root + '/';
+                    if (!clean.startsWith(prefix))
+                        return false;
+                    relative = clean.mid(prefix.length());
+                    return true;
+                }
+
+                bool MediaLibrary::folder(const QString &path, LibraryFolder &out) const
+                {
+                    const SnapshotPtr current = snapshot();
+                    QString relative;
+                    if (!current || !relativeTo(*current, path, relative))
+                        return false;
+
+                    const auto it = current->folders.constFind(relative);
+                    if (it == current->folders.cend())
+                        return false;
+                    out = it.value();
+                    return true;
+                }
+
+                bool MediaLibrary::track(const QString &filePath, LibraryTrack &out) const
+                {
+                    const SnapshotPtr current = snapshot();
+                    const QFileInfo info(filePath);
+                    QString relative;
+                    if (!current || !relativeTo(*current, info.path(), relative))
+                        return false;
+
+                    const auto it = current->folders.constFind(relative);
+                    if (it == current->folders.cend())
+                        return false;
+
+                    const LibraryTrack *found = findTrack(it.value(), info.fileName());
+                    if (!found)
+                        return false;
+                    out = *found;
+                    return true;
+                }
+
+                bool MediaLibrary::tracksUnder(const QString &path, QStringList &out) const
+                {
+                    const SnapshotPtr current = snapshot();
+                    QString relative;
+                    if (!current || !relativeTo(*current, path, relative))
+                        return false;
+
+                    QStringList result;
+                    QStringList pending{relative};
+                    while (!pending.isEmpty())
+                    {
+                        const QString folderPath = pending.takeLast();
+                        const auto it = current->folders.constFind(folderPath);
+                        // A stored index from an interrupted scan may lack folders
+                        if (it == current->folders.cend())
+                            return false;
+
+                        const QString absolute = joinPath(current->root, folderPath);
+                        for (const auto &track : it->tracks)
+                            result << absolute + '/' + track.name;
+                        for (const auto &sub : it->subdirs)
+                            pending << (folderPath.isEmpty() ? sub : folderPath + '/' + sub);
+                    }
+
+                    result.sort(Qt::CaseInsensitive);
+                    out = result;
+                    return true;
+                }
+
+                QStringList MediaLibrary::search(const QString &query, int limit) const
+                {
+                    QStringList result;
+                    const SnapshotPtr current = snapshot();
+                    if (!current || query.isEmpty())
+                        return result;
+
+                    if (current->search)
+                    {
+                        for (const auto &match : current->search->search(query, limit))
+                        {
+                            const auto it = current->folders.constFind(match.folder);
+                            if (it != current->folders.cend() && match.track < it->tracks.size())
+                                result << joinPath(current->root, match.folder) + '/' + it->tracks[match.track].name;
+                        }
+                        result.sort(Qt::CaseInsensitive);
+                        return result;
+                    }
+
+                    for (auto it = current->folders.cbegin(); it != current->folders.cend() && result.size() < limit; ++it)
+                    {
+                        for (const auto &track : it->tracks)
+                        {
+                            if (track.title.contains(query, Qt::CaseInsensitive) ||
+                                track.artist.contains(query, Qt::CaseInsensitive) ||
+                                track.album.contains(query, Qt::CaseInsensitive) ||
+                                track.name.contains(query, Qt::CaseInsensitive))
+                            {
+                                result << joinPath(current->root, it.key()) + '/' + track.name;
+                                if (result.size() >= limit)
+                                    break;
+                            }
+                        }
+                    }
+
+                    result.sort(Qt::CaseInsensitive);
+                    return result;
+                }
+
+                // ========== Worker ==========
+                void MediaLibrary::run(const QString &root, int generation)
+                {
+                    QElapsedTimer timer;
+                    timer.start();
+
+                    const QString uuid = volumeUuid(root);
+                    const QString file = indexPath(uuid);
+
+                    // Serve the stored index right away; the rescan below only
+                    // replaces it once it is complete
+                    Index previous;
+                    SearchIndex::Pointer search;
+                    if (loadIndex(file, previous))
+                    {
+                        OPENAUTO_LOG(info) << "[MediaLibrary] Loaded index of volume " << uuid.toStdString()
+                                           << " (" << previous.size() << " folders)";
+                        search = searchIndex(file, previous);
+                        publish(std::make_shared<const Snapshot>(Snapshot{root, previous, search}), generation, false);
+                    }
+
+                    Index fresh;
+                    ScanStats stats;
+                    const bool complete = scanFolder(root, QString(), previous, fresh, stats);
+                    const bool changed = stats.scannedFolders > 0 || fresh.size() != previous.size();
+
+                    if (!complete)
+                    {
+                        // Every folder record is revalidated by its mtime, so the
+                        // folders finished so far are kept for the next attempt
+                        for (auto it = previous.cbegin(); it != previous.cend(); ++it)
+                        {
+                            if (!fresh.contains(it.key()))
+                                fresh.insert(it.key(), it.value());
+                        }
+                        if (stats.scannedFolders > 0)
+                            saveIndex(file, fresh);
+                        OPENAUTO_LOG(info) << "[MediaLibrary] Scan of " << root.toStdString() << " cancelled";
+                        return;
+                    }
+
+                    if (changed && !saveIndex(file, fresh))
+                        OPENAUTO_LOG(warning) << "[MediaLibrary] Could not write " << file.toStdString();
+
+                    int tracks = 0;
+                    for (const auto &folder : fresh)
+                        tracks += folder.tracks.size();
+                    OPENAUTO_LOG(info) << "[MediaLibrary] Indexed " << tracks << " tracks in " << fresh.size()
+                                       << " folders in " << timer.elapsed() << "ms (rescanned " << stats.scannedFolders
+                                       << " folders, read " << stats.tagReads << " tags)";
+
+                    if (changed || !search)
+                        search = searchIndex(file, fresh);
+
+                    scanning_ = false;
+                    publish(changed || previous.isEmpty() ? std::make_shared<const Snapshot>(Snapshot{root, fresh, search}) : nullptr,
+                            generation, true);
+                    measureLoudness(root, file, fresh, search, generation);
+                }
+
+                bool MediaLibrary::scanFolder(const QString &root, const QString &relative, const Index &previous, Index &out, ScanStats &stats) const
+                {
+                    if (cancel_)
+                        return false;
+
+                    const QString absolute = joinPath(root, relative);
+                    const qint64 mtime = QFileInfo(absolute).lastModified().toMSecsSinceEpoch();
+
+                    const auto known = previous.constFind(relative);
+                    LibraryFolder folder;
+                    if (known != previous.cend() && known->mtime == mtime)
+                    {
+                        // Same listing as last time: no readdir and no tag reads.
+                        // A file rewritten in place keeps the folder mtime, that
+                        // case is picked up once anything else in the folder changes
+                        folder = known.value();
+                    }
+                    else
+                    {
+                        ++stats.scannedFolders;
+                        folder.mtime = mtime;
+
+                        const QDir dir(absolute);
+                        folder.subdirs = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks, QDir::Name | QDir::IgnoreCase);
+                        const QFileInfoList files = dir.entryInfoList(QDir::Files, QDir::Name | QDir::IgnoreCase);
+                        // Read once for the whole folder; the tracks share its key
+                        const QString folderArt = artCache_->folderCover(absolute);
+                        for (const auto &info : files)
+                        {
+                            if (!isAudioFile(info.fileName()))
+                                continue;
+                            if (cancel_)
+                                return false;
+
+                            LibraryTrack track;
+                            track.name = info.fileName();
+                            track.mtime = info.lastModified().toMSecsSinceEpoch();
+                            track.size = info.size();
+
+                            const LibraryTrack *old = known != previous.cend() ? findTrack(known.value(), track.name) : nullptr;
+                            if (old && old->mtime == track.mtime && old->size == track.size)
+                            {
+                                track = *old;
+                                // A cover added to the folder is what changed its mtime
+                                if (!folderArt.isEmpty())
+                                    track.artKey = folderArt;
+                            }
+                            else
+                            {
+                                readTags(info.absoluteFilePath(), folderArt, track);
+                                ++stats.tagReads;
+                            }
+                            folder.tracks.append(track);
+                        }
+                    }
+
+                    out.insert(relative, folder);
+                    for (const auto &sub : folder.subdirs)
+                    {
+                        if (!scanFolder(root, relative.isEmpty() ? sub : relative + '/' + sub, previous, out, stats))
+                            return false;
+                    }
+                    return true;
+                }
+
+                void MediaLibrary::readTags(const QString &filePath, const QString &folderArt, LibraryTrack &track) const
+                {
+                    track.artKey = folderArt;
+                    TagLib::FileRef file(filePath.toUtf8().constData(), true, TagLib::AudioProperties::Fast);
+                    if (file.isNull())
+                        return;
+
+                    if (TagLib::Tag *tag = file.tag())
+                    {
+                        track.title = QString::fromStdWString(tag->title().toWString());
+                        track.artist = QString::fromStdWString(tag->artist().toWString());
+                        track.album = QString::fromStdWString(tag->album().toWString());
+                    }
+                    if (file.audioProperties())
+                        track.durationMs = file.audioProperties()->lengthInMilliseconds();
+                    if (file.file())
+                        readLoudnessTags(file.file()->properties(), track);
+                    // Taken from the file already open for the tags
+                    if (track.artKey.isEmpty())
+                        track.artKey = artCache_->embeddedCover(file.file());
+                }
+
+                void MediaLibrary::measureLoudness(const QString &root, const QString &file, Index &index, SearchIndex::Pointer search, int generation)
+                {
+                    if (!loudnessAnalysis_)
+                        return;
+
+                    QElapsedTimer timer;
+                    timer.start();
+                    qint64 checkpoint = 0;
+                    int measured = 0;
+                    int unsaved = 0;
+                    for (auto it = index.begin(); it != index.end() && !cancel_; ++it)
+                    {
+                        const QString folder = joinPath(root, it.key());
+                        for (auto &track : it.value().tracks)
+                        {
+                            if (track.loudness != LibraryTrack::LoudnessPending)
+                                continue;
+
+                            double lufs = 0;
+                            float peak = 0;
+                            if (LoudnessMeter::measureFile(folder + '/' + track.name, cancel_, lufs, peak))
+                            {
+                                track.loudness = LibraryTrack::LoudnessMeasured;
+                                track.gainDb = static_cast<float>(LoudnessMeter::cReferenceLufs - lufs);
+                                track.peak = peak;
+                            }
+                            else if (cancel_)
+                            {
+                                break;
+                            }
+                            else
+                            {
+                                // Not retried until the file changes
+                                track.loudness = LibraryTrack::LoudnessUnknown;
+                            }
+                            ++measured;
+                            ++unsaved;
+
+                            if (timer.elapsed() - checkpoint >= cLoudnessCheckpointMs)
+                            {
+                                saveIndex(file, index);
+                                publish(std::make_shared<const Snapshot>(Snapshot{root, index, search}), generation, false);
+                                checkpoint = timer.elapsed();
+                                unsaved = 0;
+                            }
+                        }
+                    }
+
+                    if (unsaved > 0)
+                    {
+                        saveIndex(file, index);
+                        publish(std::make_shared<const Snapshot>(Snapshot{root, index, search}), generation, false);
+                    }
+                    if (measured > 0)
+                        OPENAUTO_LOG(info) << "[MediaLibrary] Measured the loudness of " << measured << " tracks in "
+                                           << timer.elapsed() << "ms" << (cancel_ ? " (cancelled)" : "");
+                }
+
+                bool MediaLibrary::isAudioFile(const QString &fileName) const
+                {
+                    return audioExtensions_.contains(QFileInfo(fileName).suffix().toLower());
+                }
+
+                void MediaLibrary::publish(SnapshotPtr snapshot, int generation, bool finished)
+                {
+                    QMetaObject::invokeMethod(this, [this, snapshot, generation, finished]()
+                                              {
+                        // The volume was closed or switched since the worker queued this
+                        if (generation != generation_)
+                            return;
+                        if (snapshot)
+                        {
+                            {
+                                QMutexLocker locker(&mutex_);
+                                snapshot_ = snapshot;
+                            }
+                            emit indexChanged();
+                        }
+                        if (finished)
+                            emit scanningChanged(); }, Qt::QueuedConnection);
+                }
+
+                // ========== Storage ==========
+                QString MediaLibrary::volumeUuid(const QString &mountPath)
+                {
+                    const QByteArray device = QStorageInfo(mountPath).device();
+                    if (!device.isEmpty())
+                    {
+                        // Answered from the blkid cache, or by probing the device
+                        if (char *uuid = blkid_get_tag_value(nullptr, "UUID", device.constData()))
+                        {
+                            const QString result = QString::fromLatin1(uuid);
+                            free(uuid);
+                            return result;
+                        }
+
+                        // Probing needs read access to the device; udev's links don't
+                        const QString canonicalDevice = QFileInfo(QString::fromLocal8Bit(device)).canonicalFilePath();
+                        const QFileInfoList links = QDir("/dev/disk/by-uuid").entryInfoList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot);
+                        for (const auto &link : links)
+                        {
+                            if (link.canonicalFilePath() == canonicalDevice)
+                                return link.fileName();
+                        }
+                    }
+
+                    // No filesystem UUID: key by the mount point instead
+                    return "mount-" + QString::fromLatin1(QCryptographicHash::hash(mountPath.toUtf8(), QCryptographicHash::Md5).toHex());
+                }
+
+                QString MediaLibrary::indexPath(const QString &uuid)
+                {
+                    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/medialibrary/" + uuid + ".idx";
+                }
+
+                bool MediaLibrary::loadIndex(const QString &file, Index &out)
+                {
+                    QFile in(file);
+                    if (!in.open(QIODevice::ReadOnly))
+                        return false;
+
+                    QDataStream stream(&in);
+                    stream.setVersion(QDataStream::Qt_5_9);
+                    quint32 magic = 0;
+                    quint32 version = 0;
+                    stream >> magic >> version;
+                    if (magic != cIndexMagic || version != cIndexVersion)
+                        return false;
+
+                    Index index;
+                    stream >> index;
+                    if (stream.status() != QDataStream::Ok)
+                    {
+                        OPENAUTO_LOG(warning) << "[MediaLibrary] Ignoring corrupt index " << file.toStdString();
+                        return false;
+                    }
+                    out = std::move(index);
+                    return true;
+                }
+
+                SearchIndex::Pointer MediaLibrary::searchIndex(const QString &file, const Index &index) const
+                {
+                    // Beside the library index, as <uuid>.search
+                    const QString path = file.left(file.lastIndexOf('.')) + ".search";
+                    const quint64 fingerprint = SearchIndex::fingerprint(index);
+                    if (SearchIndex::Pointer mapped = SearchIndex::map(path, fingerprint))
+                        return mapped;
+                    if (cancel_)
+                        return nullptr;
+
+                    QElapsedTimer timer;
+                    timer.start();
+                    SearchIndex::Pointer built = SearchIndex::build(index);
+                    if (!built)
+                        return nullptr;
+                    OPENAUTO_LOG(info) << "[MediaLibrary] Built the search index of " << built->trackCount() << " tracks ("
+                                       << built->sizeBytes() / 1024 << " KB) in " << timer.elapsed() << "ms";
+
+                    // Mapped back, it lives in the page cache rather than the heap
+                    if (built->save(path))
+                    {
+                        if (SearchIndex::Pointer mapped = SearchIndex::map(path, fingerprint))
+                            return mapped;
+                    }
+                    else
+                    {
+                        OPENAUTO_LOG(warning) << "[MediaLibrary] Could not write " << path.toStdString();
+                    }
+                    return built;
+                }
+
+                bool MediaLibrary::saveIndex(const QString &file, const Index &index)
+                {
+                    QDir().mkpath(QFileInfo(file).path());
+
+                    // Written aside and renamed over, so a power cut mid-write
+                    // leaves the previous index intact
+                    QSaveFile out(file);
+                    if (!out.open(QIODevice::WriteOnly))
+                        return false;
+
+                    QDataStream stream(&out);
+                    stream.setVersion(QDataStream::Qt_5_9);
+                    stream << cIndexMagic << cIndexVersion << index;
+                    return stream.status() == QDataStream::Ok && out.commit();
+                }
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
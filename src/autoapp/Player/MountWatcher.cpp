@@ -0,0 +1,142 @@
+/*
+ *  MountWatcher - Reports mounts appearing or disappearing under a prefix
+ */
+
+#include <QSocketNotifier>
+#include <QTimer>
+#include <f1x/openauto/autoapp/Player/MountWatcher.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                MountWatcher::MountWatcher(const QString &prefix, QObject *parent)
+                    : QObject(parent), prefix_(prefix), fd_(-1), notifier_(nullptr), fallbackTimer_(nullptr)
+                {
+                    fd_ = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+                    mountPoints_ = readMountPoints();
+
+                    if (fd_ >= 0)
+                    {
+                        // Exceptional condition == POLLPRI: raised once per mount table change
+                        notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Exception, this);
+                        connect(notifier_, &QSocketNotifier::activated, this, &MountWatcher::onMountTableChanged);
+                        OPENAUTO_LOG(info) << "[MountWatcher] Watching mounts under " << prefix_.toStdString();
+                    }
+                    else
+                    {
+                        fallbackTimer_ = new QTimer(this);
+                        connect(fallbackTimer_, &QTimer::timeout, this, &MountWatcher::onMountTableChanged);
+                        fallbackTimer_->start(cFallbackPollMs);
+                        OPENAUTO_LOG(warning) << "[MountWatcher] /proc/self/mountinfo unavailable, polling every "
+                                              << cFallbackPollMs << "ms";
+                    }
+                }
+
+                MountWatcher::~MountWatcher()
+                {
+                    delete notifier_;
+                    if (fd_ >= 0)
+                        ::close(fd_);
+                }
+
+                QStringList MountWatcher::mountPoints() const
+                {
+                    return mountPoints_;
+                }
+
+                void MountWatcher::onMountTableChanged()
+                {
+                    // Mounts elsewhere (tmpfs, the SD card, containers) also raise
+                    // the event: only report changes under the prefix
+                    const QStringList current = readMountPoints();
+                    if (current == mountPoints_)
+                        return;
+
+                    OPENAUTO_LOG(info) << "[MountWatcher] Mounts under " << prefix_.toStdString() << ": "
+                                       << mountPoints_.size() << " -> " << current.size();
+                    mountPoints_ = current;
+                    emit mountsChanged();
+                }
+
+                QStringList MountWatcher::readMountPoints() const
+                {
+                    QByteArray table;
+                    if (fd_ >= 0)
+                    {
+                        // Rewound and re-read every time; the kernel re-arms the
+                        // event on its own, the read is only for the contents
+                        if (::lseek(fd_, 0, SEEK_SET) < 0)
+                            return mountPoints_;
+                        table = readAll(fd_);
+                    }
+                    else
+                    {
+                        const int fd = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+                        if (fd < 0)
+                            return mountPoints_;
+                        table = readAll(fd);
+                        ::close(fd);
+                    }
+
+                    // "36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw"
+                    // field 5 is the mount point, with space, tab, newline and
+                    // backslash as octal escapes
+                    QStringList result;
+                    for (const QByteArray &line : table.split('\n'))
+                    {
+                        const QList<QByteArray> fields = line.split(' ');
+                        if (fields.size() < 5)
+                            continue;
+                        const QString mountPoint = unescape(fields.at(4));
+                        if (mountPoint.startsWith(prefix_))
+                            result << mountPoint;
+                    }
+                    result.sort();
+                    return result;
+                }
+
+                QByteArray MountWatcher::readAll(int fd)
+                {
+                    QByteArray result;
+                    char buffer[4096];
+                    ssize_t bytes;
+                    while ((bytes = ::read(fd, buffer, sizeof(buffer))) > 0)
+                        result.append(buffer, static_cast<int>(bytes));
+                    return result;
+                }
+
+                QString MountWatcher::unescape(const QByteArray &field)
+                {
+                    QByteArray result;
+                    result.reserve(field.size());
+                    for (int i = 0; i < field.size(); ++i)
+                    {
+                        if (field.at(i) == '\\' && i + 3 < field.size())
+                        {
+                            bool ok = false;
+                            const int value = field.mid(i + 1, 3).toInt(&ok, 8);
+                            if (ok)
+                            {
+                                result.append(static_cast<char>(value));
+                                i += 3;
+                                continue;
+                            }
+                        }
+                        result.append(field.at(i));
+                    }
+                    return QString::fromUtf8(result);
+                }
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
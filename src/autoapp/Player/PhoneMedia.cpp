@@ -0,0 +1,184 @@
+/*
+ *  PhoneMedia - What the phone is playing, from its media playback status
+ */
+
+#include <QCoreApplication>
+#include <QThread>
+#include <f1x/openauto/autoapp/Player/ArtCache.hpp>
+#include <f1x/openauto/autoapp/Player/PhoneMedia.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                PhoneMedia &PhoneMedia::instance()
+                {
+                    static PhoneMedia media;
+                    return media;
+                }
+
+                PhoneMedia::PhoneMedia()
+                    : artCache_(nullptr), active_(false), durationSeconds_(0), artTicket_(0), playing_(false), positionSeconds_(0)
+                {
+                    // Queued updates need the GUI thread's event loop, even when
+                    // a service thread made the first call
+                    if (QCoreApplication::instance() && thread() != QCoreApplication::instance()->thread())
+                        moveToThread(QCoreApplication::instance()->thread());
+                }
+
+                void PhoneMedia::setArtCache(ArtCache *cache)
+                {
+                    if (artCache_)
+                        disconnect(artCache_, nullptr, this, nullptr);
+                    artCache_ = cache;
+                    if (artCache_)
+                        connect(artCache_, &ArtCache::pictureStored, this, &PhoneMedia::onPictureStored);
+                }
+
+                void PhoneMedia::setMetadata(Metadata metadata)
+                {
+                    QMetaObject::invokeMethod(this, [this, metadata = std::move(metadata)]()
+                                              { applyMetadata(metadata); }, Qt::QueuedConnection);
+                }
+
+                void PhoneMedia::setPlayback(bool playing, int positionSeconds)
+                {
+                    QMetaObject::invokeMethod(this, [this, playing, positionSeconds]()
+                                              { applyPlayback(playing, positionSeconds); }, Qt::QueuedConnection);
+                }
+
+                void PhoneMedia::clear()
+                {
+                    QMetaObject::invokeMethod(this, [this]()
+                                              { applyClear(); }, Qt::QueuedConnection);
+                }
+
+                void PhoneMedia::requestFocus()
+                {
+                    QMetaObject::invokeMethod(this, [this]()
+                                              { emit focusRequested(); }, Qt::QueuedConnection);
+                }
+
+                bool PhoneMedia::active() const
+                {
+                    return active_;
+                }
+
+                QString PhoneMedia::title() const
+                {
+                    return title_;
+                }
+
+                QString PhoneMedia::artist() const
+                {
+                    return artist_;
+                }
+
+                QString PhoneMedia::album() const
+                {
+                    return album_;
+                }
+
+                QString PhoneMedia::artUrl() const
+                {
+                    return artUrl_;
+                }
+
+                bool PhoneMedia::playing() const
+                {
+                    return playing_;
+                }
+
+                int PhoneMedia::durationSeconds() const
+                {
+                    return durationSeconds_;
+                }
+
+                int PhoneMedia::positionSeconds() const
+                {
+                    return positionSeconds_;
+                }
+
+                void PhoneMedia::applyMetadata(const Metadata &metadata)
+                {
+                    const bool trackChanged = metadata.title != title_ || metadata.artist != artist_ || metadata.album != album_;
+                    bool notify = !active_ || trackChanged || metadata.durationSeconds != durationSeconds_;
+                    active_ = true;
+                    title_ = metadata.title;
+                    artist_ = metadata.artist;
+                    album_ = metadata.album;
+                    durationSeconds_ = metadata.durationSeconds;
+
+                    // Phones repeat the same picture with every update: only new
+                    // bytes go to the cache, which skips the decode if it has them
+                    const bool hasArt = !metadata.art.isEmpty() && metadata.art.size() <= cMaxArtBytes;
+                    if (metadata.art.size() > cMaxArtBytes)
+                        OPENAUTO_LOG(warning) << "[PhoneMedia] Ignoring " << metadata.art.size() << " bytes of album art";
+                    if ((hasArt && metadata.art != art_) || (!hasArt && trackChanged))
+                    {
+                        art_ = hasArt ? metadata.art : QByteArray();
+                        ++artTicket_;
+                        if (!artUrl_.isEmpty())
+                        {
+                            // No stale cover under the new title while the new one is stored
+                            artUrl_.clear();
+                            notify = true;
+                        }
+                        if (hasArt && artCache_)
+                            artCache_->storeLater(art_, artTicket_);
+                    }
+
+                    if (notify)
+                        emit changed();
+                }
+
+                void PhoneMedia::applyPlayback(bool playing, int positionSeconds)
+                {
+                    positionSeconds_ = positionSeconds;
+                    if (playing_ != playing)
+                    {
+                        playing_ = playing;
+                        emit changed();
+                    }
+                }
+
+                void PhoneMedia::applyClear()
+                {
+                    const bool wasActive = active_;
+                    active_ = false;
+                    title_.clear();
+                    artist_.clear();
+                    album_.clear();
+                    durationSeconds_ = 0;
+                    art_.clear();
+                    artUrl_.clear();
+                    ++artTicket_;
+                    playing_ = false;
+                    positionSeconds_ = 0;
+                    if (wasActive)
+                        emit changed();
+                }
+
+                void PhoneMedia::onPictureStored(quint64 ticket, const QString &key)
+                {
+                    if (ticket != artTicket_ || key.isEmpty())
+                        return;
+
+                    const QString url = artCache_->url(key, ArtCache::cPlayerSize);
+                    if (url != artUrl_)
+                    {
+                        artUrl_ = url;
+                        emit changed();
+                    }
+                }
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,207 @@
+/*
+ *  ReadAheadFile - Sequential file reader with a background read-ahead ring
+ */
+
+#include <f1x/openauto/autoapp/Player/ReadAheadFile.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                namespace
+                {
+                    size_t chooseCapacity(size_t capacity)
+                    {
+                        if (capacity > 0)
+                            return capacity;
+                        return MemoryFootprint::instance().lowMemory() ? ReadAheadFile::cLowMemoryCapacity : ReadAheadFile::cCapacity;
+                    }
+                }
+
+                ReadAheadFile::ReadAheadFile(size_t capacity)
+                    : capacity_(chooseCapacity(capacity)), ring_(capacity_), memory_(MemoryPool::Audio, static_cast<int64_t>(capacity_)), fd_(-1), size_(0), reader_(nullptr), start_(0), end_(0), position_(0), generation_(0), eof_(false), error_(false), stopping_(false), stalls_(0)
+                {
+                }
+
+                ReadAheadFile::~ReadAheadFile()
+                {
+                    close();
+                }
+
+                bool ReadAheadFile::open(const QString &path)
+                {
+                    close();
+
+                    fd_ = ::open(path.toUtf8().constData(), O_RDONLY | O_CLOEXEC);
+                    if (fd_ < 0)
+                    {
+                        OPENAUTO_LOG(error) << "[ReadAheadFile] Cannot open " << path.toStdString() << ": " << std::strerror(errno);
+                        return false;
+                    }
+                    struct stat info;
+                    size_ = fstat(fd_, &info) == 0 ? static_cast<int64_t>(info.st_size) : 0;
+                    // Larger kernel read-ahead on top of ours, and pages dropped sooner
+                    posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+                    start_ = end_ = position_ = 0;
+                    eof_ = error_ = stopping_ = false;
+                    stalls_ = 0;
+                    reader_ = QThread::create([this]()
+                                              { readLoop(); });
+                    reader_->start();
+                    return true;
+                }
+
+                void ReadAheadFile::close()
+                {
+                    if (reader_)
+                    {
+                        {
+                            QMutexLocker locker(&mutex_);
+                            stopping_ = true;
+                            spaceReady_.wakeAll();
+                            dataReady_.wakeAll();
+                        }
+                        reader_->wait();
+                        delete reader_;
+                        reader_ = nullptr;
+                        if (stalls_ > 0)
+                            OPENAUTO_LOG(info) << "[ReadAheadFile] " << stalls_ << " reads waited for the drive";
+                    }
+                    if (fd_ >= 0)
+                    {
+                        ::close(fd_);
+                        fd_ = -1;
+                    }
+                }
+
+                void ReadAheadFile::readLoop()
+                {
+                    QMutexLocker locker(&mutex_);
+                    while (!stopping_)
+                    {
+                        const size_t ahead = static_cast<size_t>(end_ - position_);
+                        if (eof_ || error_ || ahead + cKeepBehind >= capacity_)
+                        {
+                            spaceReady_.wait(&mutex_);
+                            continue;
+                        }
+
+                        // The bytes about to be overwritten leave the window first,
+                        // so no seek lands on them while the read runs unlocked
+                        const int64_t offset = end_;
+                        const uint64_t generation = generation_;
+                        const size_t length = std::min(cChunk, capacity_ - cKeepBehind - ahead);
+                        start_ = std::max(start_, offset + static_cast<int64_t>(length) - static_cast<int64_t>(capacity_));
+
+                        // Up to the wrap only; the rest is the next chunk
+                        const size_t at = static_cast<size_t>(offset % static_cast<int64_t>(capacity_));
+                        const size_t contiguous = std::min(length, capacity_ - at);
+                        locker.unlock();
+                        const ssize_t got = pread(fd_, ring_.data() + at, contiguous, offset);
+                        const int readError = errno;
+                        locker.relock();
+
+                        if (generation != generation_)
+                            continue;
+                        if (got < 0)
+                        {
+                            if (readError == EINTR)
+                                continue;
+                            OPENAUTO_LOG(error) << "[ReadAheadFile] Read failed at " << offset << ": " << std::strerror(readError);
+                            error_ = true;
+                        }
+                        else if (got == 0)
+                        {
+                            eof_ = true;
+                        }
+                        else
+                        {
+                            end_ += got;
+                        }
+                        dataReady_.wakeAll();
+                    }
+                }
+
+                void ReadAheadFile::copyOut(uint8_t *data, int64_t offset, size_t size) const
+                {
+                    const size_t at = static_cast<size_t>(offset % static_cast<int64_t>(capacity_));
+                    const size_t first = std::min(size, capacity_ - at);
+                    std::memcpy(data, ring_.data() + at, first);
+                    std::memcpy(data + first, ring_.data(), size - first);
+                }
+
+                int ReadAheadFile::read(uint8_t *data, int size)
+                {
+                    if (size <= 0)
+                        return 0;
+
+                    QMutexLocker locker(&mutex_);
+                    if (position_ >= end_ && !eof_ && !error_ && !stopping_)
+                    {
+                        ++stalls_;
+                        while (position_ >= end_ && !eof_ && !error_ && !stopping_)
+                            dataReady_.wait(&mutex_);
+                    }
+                    if (position_ >= end_)
+                        return error_ ? -1 : 0;
+
+                    // Reads in flight only write past end_, never below it
+                    const size_t length = std::min(static_cast<size_t>(size), static_cast<size_t>(end_ - position_));
+                    copyOut(data, position_, length);
+                    position_ += static_cast<int64_t>(length);
+                    spaceReady_.wakeOne();
+                    return static_cast<int>(length);
+                }
+
+                int64_t ReadAheadFile::seek(int64_t offset)
+                {
+                    if (offset < 0 || offset > size_)
+                        return -1;
+
+                    QMutexLocker locker(&mutex_);
+                    if (offset < start_ || offset > end_)
+                    {
+                        // Outside the window: the reader starts over at the target
+                        ++generation_;
+                        start_ = end_ = offset;
+                        eof_ = error_ = false;
+                    }
+                    position_ = offset;
+                    spaceReady_.wakeOne();
+                    return offset;
+                }
+
+                int64_t ReadAheadFile::size() const
+                {
+                    return size_;
+                }
+
+                int64_t ReadAheadFile::position() const
+                {
+                    QMutexLocker locker(&mutex_);
+                    return position_;
+                }
+
+                uint64_t ReadAheadFile::stalls() const
+                {
+                    QMutexLocker locker(&mutex_);
+                    return stalls_;
+                }
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,433 @@
+/*
+ *  SearchIndex - Trigram index of the media library for type-ahead search
+ */
+
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStringList>
+#include <f1x/openauto/autoapp/Player/SearchIndex.hpp>
+#include <f1x/openauto/autoapp/Player/MediaLibrary.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace player
+            {
+
+                // The file is a cache private to this board, so sections are in
+                // native byte order and each starts 4-byte aligned:
+                //   Header
+                //   TrackRecord[trackCount]
+                //   uint32 folderOffsets[folderCount + 1]  into the folder names
+                //   uint32 grams[gramCount]                sorted trigram keys
+                //   uint32 postingOffsets[gramCount + 1]   into the postings
+                //   folded track text, folder names (UTF-8)
+                //   postings: per gram, ascending track ids as varint deltas
+                struct SearchIndex::Header
+                {
+                    uint32_t magic;
+                    uint32_t version;
+                    uint64_t fingerprint;
+                    uint32_t trackCount;
+                    uint32_t folderCount;
+                    uint32_t gramCount;
+                    uint32_t textBytes;
+                    uint32_t folderBytes;
+                    uint32_t postingBytes;
+                };
+
+                struct SearchIndex::TrackRecord
+                {
+                    uint32_t folder;
+                    uint32_t track;
+                    // Title, artist, album and file name without its extension,
+                    // folded and separated by cFieldSeparator
+                    uint32_t text;
+                    uint32_t length;
+                };
+
+                namespace
+                {
+                    constexpr uint32_t cMagic = 0x4f415349; // "OASI"
+                    constexpr uint32_t cVersion = 1;
+                    // Never part of a folded query, so no match spans two fields
+                    constexpr char cFieldSeparator = '\x1f';
+
+                    size_t padded(size_t bytes)
+                    {
+                        return (bytes + 3) & ~size_t(3);
+                    }
+
+                    uint32_t gram(const char *at)
+                    {
+                        return uint32_t(uint8_t(at[0])) << 16 | uint32_t(uint8_t(at[1])) << 8 | uint8_t(at[2]);
+                    }
+
+                    // Distinct trigrams of @p text, sorted; none across a separator
+                    void gramsOf(const char *text, size_t length, std::vector<uint32_t> &out)
+                    {
+                        out.clear();
+                        for (size_t i = 0; i + 3 <= length; ++i)
+                        {
+                            if (text[i] == cFieldSeparator || text[i + 1] == cFieldSeparator || text[i + 2] == cFieldSeparator)
+                                continue;
+                            out.push_back(gram(text + i));
+                        }
+                        std::sort(out.begin(), out.end());
+                        out.erase(std::unique(out.begin(), out.end()), out.end());
+                    }
+
+                    void putVarint(std::string &out, uint32_t value)
+                    {
+                        while (value >= 0x80)
+                        {
+                            out.push_back(char(value | 0x80));
+                            value >>= 7;
+                        }
+                        out.push_back(char(value));
+                    }
+
+                    bool getVarint(const uint8_t *&at, const uint8_t *end, uint32_t &value)
+                    {
+                        value = 0;
+                        for (int shift = 0; shift < 35 && at < end; shift += 7)
+                        {
+                            const uint8_t byte = *at++;
+                            value |= uint32_t(byte & 0x7f) << shift;
+                            if (!(byte & 0x80))
+                                return true;
+                        }
+                        return false;
+                    }
+
+                    void hashIn(uint64_t &hash, const QString &text)
+                    {
+                        // FNV-1a over the UTF-16 units, then a separator
+                        for (const QChar c : text)
+                        {
+                            hash ^= c.unicode();
+                            hash *= 0x100000001b3ull;
+                        }
+                        hash ^= 0xffff;
+                        hash *= 0x100000001b3ull;
+                    }
+
+                    QStringList sortedKeys(const SearchIndex::Folders &folders)
+                    {
+                        QStringList keys = folders.keys();
+                        keys.sort(Qt::CaseInsensitive);
+                        return keys;
+                    }
+                }
+
+                QByteArray SearchIndex::fold(const QString &text)
+                {
+                    const QString decomposed = text.normalized(QString::NormalizationForm_KD);
+                    QString stripped;
+                    stripped.reserve(decomposed.size());
+                    for (const QChar c : decomposed)
+                    {
+                        if (c.category() != QChar::Mark_NonSpacing && c.unicode() >= 0x20)
+                            stripped.append(c);
+                    }
+                    return stripped.toCaseFolded().toUtf8();
+                }
+
+                quint64 SearchIndex::fingerprint(const Folders &folders)
+                {
+                    uint64_t hash = 0xcbf29ce484222325ull;
+                    for (const QString &key : sortedKeys(folders))
+                    {
+                        hashIn(hash, key);
+                        for (const auto &track : folders.value(key).tracks)
+                        {
+                            hashIn(hash, track.name);
+                            hashIn(hash, track.title);
+                            hashIn(hash, track.artist);
+                            hashIn(hash, track.album);
+                        }
+                    }
+                    return hash;
+                }
+
+                SearchIndex::Pointer SearchIndex::build(const Folders &folders)
+                {
+                    struct Posting
+                    {
+                        std::string bytes;
+                        uint32_t last = 0;
+                    };
+
+                    std::vector<TrackRecord> tracks;
+                    std::vector<uint32_t> folderOffsets{0};
+                    std::string text;
+                    std::string folderNames;
+                    std::unordered_map<uint32_t, Posting> postings;
+                    std::vector<uint32_t> grams;
+
+                    const QStringList keys = sortedKeys(folders);
+                    for (int f = 0; f < keys.size(); ++f)
+                    {
+                        folderNames += keys[f].toStdString();
+                        folderOffsets.push_back(static_cast<uint32_t>(folderNames.size()));
+
+                        const auto &folderTracks = folders.value(keys[f]).tracks;
+                        for (int t = 0; t < folderTracks.size(); ++t)
+                        {
+                            const LibraryTrack &track = folderTracks[t];
+                            const QByteArray folded = fold(track.title) + cFieldSeparator + fold(track.artist) + cFieldSeparator +
+                                                      fold(track.album) + cFieldSeparator + fold(QFileInfo(track.name).completeBaseName());
+
+                            const uint32_t id = static_cast<uint32_t>(tracks.size());
+                            tracks.push_back({static_cast<uint32_t>(f), static_cast<uint32_t>(t), static_cast<uint32_t>(text.size()),
+                                              static_cast<uint32_t>(folded.size())});
+                            text.append(folded.constData(), folded.size());
+
+                            gramsOf(folded.constData(), folded.size(), grams);
+                            for (const uint32_t key : grams)
+                            {
+                                Posting &posting = postings[key];
+                                putVarint(posting.bytes, id - posting.last);
+                                posting.last = id;
+                            }
+                        }
+                    }
+
+                    std::vector<uint32_t> gramKeys;
+                    gramKeys.reserve(postings.size());
+                    for (const auto &posting : postings)
+                        gramKeys.push_back(posting.first);
+                    std::sort(gramKeys.begin(), gramKeys.end());
+
+                    std::vector<uint32_t> postingOffsets{0};
+                    std::string postingBytes;
+                    for (const uint32_t key : gramKeys)
+                    {
+                        postingBytes += postings[key].bytes;
+                        postingOffsets.push_back(static_cast<uint32_t>(postingBytes.size()));
+                    }
+                    postings.clear();
+
+                    Header header{cMagic, cVersion, fingerprint(folders), static_cast<uint32_t>(tracks.size()), static_cast<uint32_t>(keys.size()),
+                                  static_cast<uint32_t>(gramKeys.size()), static_cast<uint32_t>(text.size()), static_cast<uint32_t>(folderNames.size()),
+                                  static_cast<uint32_t>(postingBytes.size())};
+
+                    std::shared_ptr<SearchIndex> index(new SearchIndex());
+                    QByteArray &out = index->built_;
+                    const auto section = [&out](const void *data, size_t bytes)
+                    {
+                        out.append(static_cast<const char *>(data), static_cast<int>(bytes));
+                        out.append(static_cast<int>(padded(bytes) - bytes), '\0');
+                    };
+                    section(&header, sizeof(header));
+                    section(tracks.data(), tracks.size() * sizeof(TrackRecord));
+                    section(folderOffsets.data(), folderOffsets.size() * sizeof(uint32_t));
+                    section(gramKeys.data(), gramKeys.size() * sizeof(uint32_t));
+                    section(postingOffsets.data(), postingOffsets.size() * sizeof(uint32_t));
+                    section(text.data(), text.size());
+                    section(folderNames.data(), folderNames.size());
+                    section(postingBytes.data(), postingBytes.size());
+
+                    if (!index->attach(out.constData(), out.size()))
+                        return nullptr;
+                    return index;
+                }
+
+                SearchIndex::Pointer SearchIndex::map(const QString &file, quint64 fingerprint)
+                {
+                    std::unique_ptr<QFile> in(new QFile(file));
+                    if (!in->open(QIODevice::ReadOnly) || in->size() < qint64(sizeof(Header)))
+                        return nullptr;
+
+                    const uchar *data = in->map(0, in->size());
+                    if (!data)
+                        return nullptr;
+
+                    std::shared_ptr<SearchIndex> index(new SearchIndex());
+                    if (!index->attach(reinterpret_cast<const char *>(data), in->size()))
+                    {
+                        OPENAUTO_LOG(warning) << "[SearchIndex] Ignoring corrupt " << file.toStdString();
+                        return nullptr;
+                    }
+                    if (index->header_->fingerprint != fingerprint)
+                        return nullptr;
+                    index->file_ = std::move(in);
+                    return index;
+                }
+
+                bool SearchIndex::save(const QString &file) const
+                {
+                    QSaveFile out(file);
+                    if (!out.open(QIODevice::WriteOnly))
+                        return false;
+                    return out.write(reinterpret_cast<const char *>(header_), size_) == size_ && out.commit();
+                }
+
+                bool SearchIndex::attach(const char *data, qint64 size)
+                {
+                    if (size < qint64(sizeof(Header)))
+                        return false;
+                    const Header *header = reinterpret_cast<const Header *>(data);
+                    if (header->magic != cMagic || header->version != cVersion)
+                        return false;
+
+                    // Section sizes summed in 64 bits, so no count can wrap them
+                    const uint64_t tracksAt = padded(sizeof(Header));
+                    const uint64_t folderOffsetsAt = tracksAt + padded(uint64_t(header->trackCount) * sizeof(TrackRecord));
+                    const uint64_t gramsAt = folderOffsetsAt + (uint64_t(header->folderCount) + 1) * sizeof(uint32_t);
+                    const uint64_t postingOffsetsAt = gramsAt + uint64_t(header->gramCount) * sizeof(uint32_t);
+                    const uint64_t textAt = postingOffsetsAt + (uint64_t(header->gramCount) + 1) * sizeof(uint32_t);
+                    const uint64_t folderNamesAt = textAt + padded(header->textBytes);
+                    const uint64_t postingsAt = folderNamesAt + padded(header->folderBytes);
+                    if (postingsAt + padded(header->postingBytes) != uint64_t(size))
+                        return false;
+
+                    const TrackRecord *tracks = reinterpret_cast<const TrackRecord *>(data + tracksAt);
+                    const uint32_t *folderOffsets = reinterpret_cast<const uint32_t *>(data + folderOffsetsAt);
+                    const uint32_t *postingOffsets = reinterpret_cast<const uint32_t *>(data + postingOffsetsAt);
+
+                    // Checked once here so lookups can trust every offset
+                    for (uint32_t i = 0; i < header->trackCount; ++i)
+                    {
+                        if (tracks[i].folder >= header->folderCount || uint64_t(tracks[i].text) + tracks[i].length > header->textBytes)
+                            return false;
+                    }
+                    if (folderOffsets[0] != 0 || folderOffsets[header->folderCount] != header->folderBytes ||
+                        !std::is_sorted(folderOffsets, folderOffsets + header->folderCount + 1))
+                        return false;
+                    if (postingOffsets[0] != 0 || postingOffsets[header->gramCount] != header->postingBytes ||
+                        !std::is_sorted(postingOffsets, postingOffsets + header->gramCount + 1))
+                        return false;
+
+                    size_ = size;
+                    header_ = header;
+                    tracks_ = tracks;
+                    folderOffsets_ = folderOffsets;
+                    grams_ = reinterpret_cast<const uint32_t *>(data + gramsAt);
+                    postingOffsets_ = postingOffsets;
+                    text_ = data + textAt;
+                    folderNames_ = data + folderNamesAt;
+                    postings_ = reinterpret_cast<const uint8_t *>(data + postingsAt);
+                    return true;
+                }
+
+                int SearchIndex::trackCount() const
+                {
+                    return static_cast<int>(header_->trackCount);
+                }
+
+                qint64 SearchIndex::sizeBytes() const
+                {
+                    return size_;
+                }
+
+                QString SearchIndex::folder(uint32_t id) const
+                {
+                    return QString::fromUtf8(folderNames_ + folderOffsets_[id], static_cast<int>(folderOffsets_[id + 1] - folderOffsets_[id]));
+                }
+
+                bool SearchIndex::contains(uint32_t track, const QByteArray &query) const
+                {
+                    const std::string_view text(text_ + tracks_[track].text, tracks_[track].length);
+                    return text.find(std::string_view(query.constData(), static_cast<size_t>(query.size()))) != std::string_view::npos;
+                }
+
+                QVector<uint32_t> SearchIndex::candidates(const QByteArray &query) const
+                {
+                    std::vector<uint32_t> keys;
+                    gramsOf(query.constData(), query.size(), keys);
+
+                    // Each posting as [begin, end) in the postings section
+                    std::vector<std::pair<uint32_t, uint32_t>> lists;
+                    const uint32_t *gramsEnd = grams_ + header_->gramCount;
+                    for (const uint32_t key : keys)
+                    {
+                        const uint32_t *found = std::lower_bound(grams_, gramsEnd, key);
+                        if (found == gramsEnd || *found != key)
+                            return {};
+                        const size_t at = found - grams_;
+                        lists.emplace_back(postingOffsets_[at], postingOffsets_[at + 1]);
+                    }
+                    // Shortest first, so the running intersection only shrinks
+                    std::sort(lists.begin(), lists.end(), [](const std::pair<uint32_t, uint32_t> &a, const std::pair<uint32_t, uint32_t> &b)
+                              { return a.second - a.first < b.second - b.first; });
+
+                    QVector<uint32_t> result;
+                    for (size_t l = 0; l < lists.size(); ++l)
+                    {
+                        const uint8_t *at = postings_ + lists[l].first;
+                        const uint8_t *end = postings_ + lists[l].second;
+                        QVector<uint32_t> next;
+                        next.reserve(l == 0 ? 64 : result.size());
+                        int keep = 0;
+                        uint32_t id = 0;
+                        uint32_t delta = 0;
+                        while (at < end && getVarint(at, end, delta))
+                        {
+                            id += delta;
+                            if (id >= header_->trackCount)
+                                break;
+                            if (l == 0)
+                            {
+                                next.append(id);
+                                continue;
+                            }
+                            while (keep < result.size() && result[keep] < id)
+                                ++keep;
+                            if (keep == result.size())
+                                break;
+                            if (result[keep] == id)
+                                next.append(id);
+                        }
+                        result = std::move(next);
+                        if (result.isEmpty())
+                            break;
+                    }
+                    return result;
+                }
+
+                QVector<SearchIndex::Match> SearchIndex::search(const QString &query, int limit) const
+                {
+                    QVector<Match> result;
+                    const QByteArray folded = fold(query.trimmed());
+                    if (folded.isEmpty() || limit <= 0)
+                        return result;
+
+                    const auto add = [this, &result, limit, &folded](uint32_t track)
+                    {
+                        if (!contains(track, folded))
+                            return true;
+                        result.append({folder(tracks_[track].folder), static_cast<int>(tracks_[track].track)});
+                        return result.size() < limit;
+                    };
+
+                    // One or two letters fit no trigram: these are rare and the
+                    // folded text is a few MB at most, so compare it all
+                    if (folded.size() < 3)
+                    {
+                        for (uint32_t track = 0; track < header_->trackCount && add(track); ++track)
+                            ;
+                    }
+                    else
+                    {
+                        for (const uint32_t track : candidates(folded))
+                        {
+                            if (!add(track))
+                                break;
+                        }
+                    }
+                    return result;
+                }
+
+            } // namespace player
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,241 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/PowerProfile.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    std::string readNode(int fd)
+    {
+      char buffer[512];
+      const ssize_t length = fd >= 0 ? pread(fd, buffer, sizeof(buffer) - 1, 0) : -1;
+      if (length <= 0)
+        return "";
+      std::string value(buffer, static_cast<size_t>(length));
+      value.erase(value.find_last_not_of(" \n") + 1);
+      return value;
+    }
+
+    std::vector<std::string> words(const std::string &path)
+    {
+      std::ifstream in(path);
+      std::vector<std::string> result;
+      std::string word;
+      while (in >> word)
+        result.push_back(word);
+      return result;
+    }
+
+    std::vector<std::string> entries(const std::string &directory)
+    {
+      std::vector<std::string> result;
+      if (DIR *dir = opendir(directory.c_str()))
+      {
+        while (const dirent *entry = readdir(dir))
+        {
+          if (entry->d_name[0] != '.')
+            result.push_back(entry->d_name);
+        }
+        closedir(dir);
+      }
+      std::sort(result.begin(), result.end());
+      return result;
+    }
+
+    std::string floorOf(const std::vector<std::string> &available, const std::string &max)
+    {
+      std::vector<long long> frequencies;
+      for (const auto &word : available)
+        frequencies.push_back(std::atoll(word.c_str()));
+      if (frequencies.empty())
+        frequencies.push_back(std::atoll(max.c_str()));
+      std::sort(frequencies.begin(), frequencies.end());
+
+      const long long half = frequencies.back() / 2;
+      const auto floor = std::lower_bound(frequencies.begin(), frequencies.end(), half);
+      return floor != frequencies.end() && *floor > 0 ? std::to_string(*floor) : "";
+    }
+  }
+
+  const char *powerProfileName(PowerProfileMode mode)
+  {
+    switch (mode)
+    {
+    case PowerProfileMode::Performance:
+      return "performance";
+    case PowerProfileMode::Floor:
+      return "floor";
+    case PowerProfileMode::Powersave:
+      return "powersave";
+    default:
+      return "default";
+    }
+  }
+
+  bool parsePowerProfile(const std::string &name, PowerProfileMode &mode)
+  {
+    for (const auto candidate : {PowerProfileMode::Default, PowerProfileMode::Performance,
+                                 PowerProfileMode::Floor, PowerProfileMode::Powersave})
+    {
+      if (name == powerProfileName(candidate))
+      {
+        mode = candidate;
+        return true;
+      }
+    }
+    mode = PowerProfileMode::Default;
+    return false;
+  }
+
+  PowerProfile::PowerProfile(const std::string &devfreqDevices, std::string sysfsRoot)
+      : mode_(PowerProfileMode::Default)
+  {
+    const std::string cpufreq = sysfsRoot + "/devices/system/cpu/cpufreq";
+    for (const auto &policy : entries(cpufreq))
+    {
+      if (policy.compare(0, 6, "policy") == 0)
+        open(policy, cpufreq + "/" + policy, "scaling_governor", "scaling_available_governors",
+             "scaling_min_freq", "scaling_available_frequencies", "cpuinfo_max_freq");
+    }
+
+    std::vector<std::string> parts;
+    std::stringstream list(devfreqDevices);
+    for (std::string part; std::getline(list, part, ',');)
+    {
+      if (!part.empty())
+        parts.push_back(part);
+    }
+    const std::string devfreq = sysfsRoot + "/class/devfreq";
+    for (const auto &device : entries(devfreq))
+    {
+      const bool wanted = std::any_of(parts.begin(), parts.end(), [&device](const std::string &part)
+                                      { return device.find(part) != std::string::npos; });
+      if (wanted)
+        open(device, devfreq + "/" + device, "governor", "available_governors", "min_freq",
+             "available_frequencies", "max_freq");
+    }
+  }
+
+  PowerProfile::~PowerProfile()
+  {
+    apply(PowerProfileMode::Default);
+    for (const auto &domain : domains_)
+    {
+      ::close(domain.governorFd);
+      if (domain.minFreqFd >= 0)
+        ::close(domain.minFreqFd);
+    }
+  }
+
+  void PowerProfile::open(const std::string &name, const std::string &directory, const char *governorNode,
+                          const char *governorsNode, const char *minFreqNode, const char *frequenciesNode,
+                          const char *maxFreqNode)
+  {
+    Domain domain;
+    domain.name = name;
+    domain.governorFd = ::open((directory + "/" + governorNode).c_str(), O_RDWR | O_CLOEXEC);
+    if (domain.governorFd < 0)
+    {
+      // Read-only unless running as root, which the images do
+      OPENAUTO_LOG(debug) << "[PowerProfile] Cannot open " << directory << "/" << governorNode << ": "
+                          << std::strerror(errno);
+      return;
+    }
+    domain.minFreqFd = ::open((directory + "/" + minFreqNode).c_str(), O_RDWR | O_CLOEXEC);
+    domain.bootGovernor = readNode(domain.governorFd);
+    domain.bootMinFreq = readNode(domain.minFreqFd);
+    domain.governors = words(directory + "/" + governorsNode);
+
+    std::ifstream max(directory + "/" + maxFreqNode);
+    std::string maxFreq;
+    max >> maxFreq;
+    domain.floorFreq = floorOf(words(directory + "/" + frequenciesNode), maxFreq);
+    domains_.push_back(std::move(domain));
+  }
+
+  void PowerProfile::write(const Domain &domain, PowerProfileMode mode)
+  {
+    const auto writeNode = [&domain](int fd, const std::string &value)
+    {
+      if (fd < 0 || value.empty())
+        return;
+      // As echo writes it; sysfs takes one value per write at offset 0
+      const std::string line = value + "\n";
+      if (pwrite(fd, line.data(), line.size(), 0) < 0)
+        OPENAUTO_LOG(warning) << "[PowerProfile] " << domain.name << ": cannot write " << value << ": "
+                              << std::strerror(errno);
+    };
+
+    std::string governor = domain.bootGovernor;
+    if (mode == PowerProfileMode::Performance || mode == PowerProfileMode::Powersave)
+    {
+      const std::string wanted = powerProfileName(mode);
+      if (std::find(domain.governors.begin(), domain.governors.end(), wanted) != domain.governors.end())
+        governor = wanted;
+      else
+        OPENAUTO_LOG(warning) << "[PowerProfile] " << domain.name << " has no " << wanted << " governor";
+    }
+
+    // Minimum first: a floor above the old one must not wait for the governor
+    writeNode(domain.minFreqFd, mode == PowerProfileMode::Floor ? domain.floorFreq : domain.bootMinFreq);
+    writeNode(domain.governorFd, governor);
+  }
+
+  void PowerProfile::apply(PowerProfileMode mode)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (mode == mode_)
+      return;
+
+    for (const auto &domain : domains_)
+      write(domain, mode);
+    if (!domains_.empty())
+      OPENAUTO_LOG(info) << "[PowerProfile] " << powerProfileName(mode_) << " -> " << powerProfileName(mode)
+                         << " on " << domains_.size() << " clock domains";
+    mode_ = mode;
+  }
+
+  PowerProfileMode PowerProfile::mode() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return mode_;
+  }
+
+  std::vector<std::string> PowerProfile::domains() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> names;
+    for (const auto &domain : domains_)
+      names.push_back(domain.name);
+    return names;
+  }
+
+}
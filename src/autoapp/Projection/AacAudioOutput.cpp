@@ -0,0 +1,424 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/Projection/AacAudioOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+
+#ifdef USE_FFMPEG_DRM
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/mem.h>
+}
+#endif
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        constexpr size_t AacAudioOutput::cMaxQueuedPackets;
+
+        namespace
+        {
+          struct AacMetrics
+          {
+            MetricGauge &decodePermille = Metrics::instance().gauge(
+                "openauto_audio_aac_decode_permille", "AAC decode time per 1000 units of media audio decoded");
+            MetricCounter &errors = Metrics::instance().counter(
+                "openauto_audio_aac_decode_errors_total", "AAC access units the decoder rejected");
+            MetricCounter &dropped = Metrics::instance().counter(
+                "openauto_audio_aac_dropped_total", "AAC access units dropped because decode fell behind");
+          };
+
+          AacMetrics &metrics()
+          {
+            static AacMetrics instance;
+            return instance;
+          }
+
+          // MPEG-4 sampling frequency index order
+          constexpr uint32_t cSamplingFrequencies[] = {96000, 88200, 64000, 48000, 44100, 32000, 24000,
+                                                      22050, 16000, 12000, 11025, 8000,  7350};
+          constexpr uint8_t cObjectTypeAacLc = 2;
+          // The decode share is republished every this many packets
+          constexpr uint64_t cBudgetWindowPackets = 100;
+        }
+
+        AacAudioOutput::AacAudioOutput(IAudioOutput::Pointer pcmOutput)
+            : pcmOutput_(std::move(pcmOutput)), codecCtx_(nullptr), frame_(nullptr), packet_(nullptr),
+              busy_(0), decodedFrames_(0), decodedPacketsSinceReport_(0), stopping_(false), decoded_(0), dropped_(0), errors_(0)
+        {
+        }
+
+        AacAudioOutput::~AacAudioOutput()
+        {
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+          }
+          cond_.notify_one();
+          if (thread_.joinable())
+          {
+            thread_.join();
+          }
+          closeDecoder();
+        }
+
+        std::vector<uint8_t> AacAudioOutput::audioSpecificConfig(uint32_t sampleRate, uint32_t channels)
+        {
+          const auto *begin = std::begin(cSamplingFrequencies);
+          const auto *found = std::find(begin, std::end(cSamplingFrequencies), sampleRate);
+          if (found == std::end(cSamplingFrequencies) || channels == 0 || channels > 7)
+          {
+            return {};
+          }
+          // objectType:5 frequencyIndex:4 channelConfiguration:4, then
+          // frameLength, dependsOnCoreCoder and extension flags all 0
+          const auto index = static_cast<uint8_t>(found - begin);
+          return {static_cast<uint8_t>((cObjectTypeAacLc << 3) | (index >> 1)),
+                  static_cast<uint8_t>(((index & 1) << 7) | (channels << 3))};
+        }
+
+        void AacAudioOutput::interleave(const float *const *planes, uint32_t channels, size_t frames, int16_t *out)
+        {
+          for (size_t i = 0; i < frames; i++)
+          {
+            for (uint32_t c = 0; c < channels; c++)
+            {
+              const float sample = std::max(-1.0f, std::min(planes[c][i], 1.0f));
+              *out++ = static_cast<int16_t>(std::lrint(sample * 32767.0f));
+            }
+          }
+        }
+
+        bool AacAudioOutput::open()
+        {
+          if (!pcmOutput_->open())
+          {
+            return false;
+          }
+          if (thread_.joinable())
+          {
+            return true;
+          }
+          if (!openDecoder())
+          {
+            return false;
+          }
+
+          busy_ = std::chrono::steady_clock::duration::zero();
+          decodedFrames_ = 0;
+          decodedPacketsSinceReport_ = 0;
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = false;
+            decoded_ = 0;
+            dropped_ = 0;
+            errors_ = 0;
+          }
+          thread_ = std::thread(&AacAudioOutput::decodeLoop, this);
+          OPENAUTO_LOG(info) << "[AacAudioOutput] Decoding AAC-LC to " << getSampleRate() << " Hz, "
+                             << getChannelCount() << " channels";
+          return true;
+        }
+
+        void AacAudioOutput::write(aasdk::messenger::Timestamp::ValueType timestamp,
+                                   const aasdk::common::DataConstBuffer &buffer)
+        {
+          if (buffer.size == 0)
+          {
+            return;
+          }
+
+          std::vector<uint8_t> data;
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_ || !thread_.joinable())
+            {
+              return;
+            }
+            if (!freeBuffers_.empty())
+            {
+              data = std::move(freeBuffers_.back());
+              freeBuffers_.pop_back();
+            }
+          }
+
+          // Copied outside the lock; the worker only waits on it for the queue
+          data.assign(buffer.cdata, buffer.cdata + buffer.size);
+
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.size() >= cMaxQueuedPackets)
+            {
+              // The oldest is the one the jitter buffer could least use
+              freeBuffers_.push_back(std::move(queue_.front().data));
+              queue_.pop_front();
+              dropped_++;
+              metrics().dropped.add(1);
+            }
+            queue_.push_back(Packet{timestamp, std::move(data)});
+          }
+          cond_.notify_one();
+        }
+
+        void AacAudioOutput::start()
+        {
+          pcmOutput_->start();
+        }
+
+        void AacAudioOutput::stop()
+        {
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+          }
+          cond_.notify_one();
+          if (thread_.joinable())
+          {
+            thread_.join();
+            const double audioSeconds = getSampleRate() ? static_cast<double>(decodedFrames_) / getSampleRate() : 0.0;
+            OPENAUTO_LOG(info) << "[AacAudioOutput] Decoded " << decodedPackets() << " packets ("
+                               << audioSeconds << " s) in "
+                               << std::chrono::duration_cast<std::chrono::milliseconds>(busy_).count() << " ms, "
+                               << droppedPackets() << " dropped, " << errors_ << " rejected";
+          }
+          closeDecoder();
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto &packet : queue_)
+            {
+              freeBuffers_.push_back(std::move(packet.data));
+            }
+            queue_.clear();
+          }
+          pcmOutput_->stop();
+        }
+
+        void AacAudioOutput::suspend()
+        {
+          {
+            // What the phone sent before the stop is not played after it
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto &packet : queue_)
+            {
+              freeBuffers_.push_back(std::move(packet.data));
+            }
+            queue_.clear();
+          }
+          pcmOutput_->suspend();
+        }
+
+        uint32_t AacAudioOutput::getSampleSize() const { return pcmOutput_->getSampleSize(); }
+
+        uint32_t AacAudioOutput::getChannelCount() const { return pcmOutput_->getChannelCount(); }
+
+        uint32_t AacAudioOutput::getSampleRate() const { return pcmOutput_->getSampleRate(); }
+
+        uint64_t AacAudioOutput::decodedPackets() const
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          return decoded_;
+        }
+
+        uint64_t AacAudioOutput::droppedPackets() const
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          return dropped_;
+        }
+
+        void AacAudioOutput::decodeLoop()
+        {
+          ThreadTopology::instance().apply(ThreadRole::MediaLane, "oa-aac-decode");
+
+          std::unique_lock<std::mutex> lock(mutex_);
+          while (true)
+          {
+            cond_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+            if (stopping_)
+            {
+              return;
+            }
+            Packet packet = std::move(queue_.front());
+            queue_.pop_front();
+
+            lock.unlock();
+            decode(packet);
+            lock.lock();
+
+            decoded_++;
+            if (freeBuffers_.size() < cMaxQueuedPackets)
+            {
+              freeBuffers_.push_back(std::move(packet.data));
+            }
+          }
+        }
+
+#ifdef USE_FFMPEG_DRM
+
+        bool AacAudioOutput::isSupported()
+        {
+          return avcodec_find_decoder(AV_CODEC_ID_AAC) != nullptr;
+        }
+
+        bool AacAudioOutput::openDecoder()
+        {
+          const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_AAC);
+          const auto config = audioSpecificConfig(getSampleRate(), getChannelCount());
+          if (codec == nullptr || config.empty())
+          {
+            OPENAUTO_LOG(error) << "[AacAudioOutput] No AAC decoder for " << getSampleRate() << " Hz";
+            return false;
+          }
+
+          codecCtx_ = avcodec_alloc_context3(codec);
+          if (codecCtx_ == nullptr)
+          {
+            return false;
+          }
+          codecCtx_->sample_rate = static_cast<int>(getSampleRate());
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+          av_channel_layout_default(&codecCtx_->ch_layout, static_cast<int>(getChannelCount()));
+#else
+          codecCtx_->channels = static_cast<int>(getChannelCount());
+#endif
+          // Describes raw access units; ADTS ones are recognised by their header
+          codecCtx_->extradata = static_cast<uint8_t *>(av_mallocz(config.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+          if (codecCtx_->extradata != nullptr)
+          {
+            memcpy(codecCtx_->extradata, config.data(), config.size());
+            codecCtx_->extradata_size = static_cast<int>(config.size());
+          }
+
+          frame_ = av_frame_alloc();
+          packet_ = av_packet_alloc();
+          if (avcodec_open2(codecCtx_, codec, nullptr) < 0 || frame_ == nullptr || packet_ == nullptr)
+          {
+            OPENAUTO_LOG(error) << "[AacAudioOutput] Cannot open the AAC decoder";
+            closeDecoder();
+            return false;
+          }
+          return true;
+        }
+
+        void AacAudioOutput::closeDecoder()
+        {
+          if (packet_)
+            av_packet_free(&packet_);
+          if (frame_)
+            av_frame_free(&frame_);
+          if (codecCtx_)
+            avcodec_free_context(&codecCtx_);
+        }
+
+        void AacAudioOutput::decode(const Packet &packet)
+        {
+          const auto started = std::chrono::steady_clock::now();
+          packet_->data = const_cast<uint8_t *>(packet.data.data());
+          packet_->size = static_cast<int>(packet.data.size());
+          packet_->pts = static_cast<int64_t>(packet.timestamp);
+          const int sent = avcodec_send_packet(codecCtx_, packet_);
+          av_packet_unref(packet_);
+          if (sent < 0)
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            errors_++;
+            metrics().errors.add(1);
+            return;
+          }
+
+          const uint32_t channels = getChannelCount();
+          while (avcodec_receive_frame(codecCtx_, frame_) >= 0)
+          {
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+            const int decodedChannels = frame_->ch_layout.nb_channels;
+#else
+            const int decodedChannels = frame_->channels;
+#endif
+            if (frame_->format != AV_SAMPLE_FMT_FLTP || decodedChannels <= 0)
+            {
+              av_frame_unref(frame_);
+              continue;
+            }
+
+            // A mono stream fills every output channel
+            const float *planes[8];
+            for (uint32_t c = 0; c < channels && c < 8; c++)
+            {
+              planes[c] = reinterpret_cast<const float *>(
+                  frame_->extended_data[std::min<int>(static_cast<int>(c), decodedChannels - 1)]);
+            }
+            const auto frames = static_cast<size_t>(frame_->nb_samples);
+            pcm_.resize(frames * channels);
+            interleave(planes, std::min<uint32_t>(channels, 8), frames, pcm_.data());
+
+            const auto timestamp = frame_->pts != AV_NOPTS_VALUE ? static_cast<uint64_t>(frame_->pts) : packet.timestamp;
+            pcmOutput_->write(timestamp, aasdk::common::DataConstBuffer(pcm_.data(), pcm_.size() * sizeof(int16_t)));
+            decodedFrames_ += frames;
+            av_frame_unref(frame_);
+          }
+
+          busy_ += std::chrono::steady_clock::now() - started;
+          if (++decodedPacketsSinceReport_ >= cBudgetWindowPackets && decodedFrames_ > 0)
+          {
+            decodedPacketsSinceReport_ = 0;
+            const double busyUs = std::chrono::duration<double, std::micro>(busy_).count();
+            const double audioUs = static_cast<double>(decodedFrames_) * 1e6 / getSampleRate();
+            metrics().decodePermille.set(static_cast<int64_t>(busyUs * 1000.0 / audioUs));
+          }
+        }
+
+#else
+
+        bool AacAudioOutput::isSupported()
+        {
+          return false;
+        }
+
+        bool AacAudioOutput::openDecoder()
+        {
+          OPENAUTO_LOG(error) << "[AacAudioOutput] Built without FFmpeg, cannot decode AAC";
+          return false;
+        }
+
+        void AacAudioOutput::closeDecoder()
+        {
+        }
+
+        void AacAudioOutput::decode(const Packet &)
+        {
+        }
+
+#endif // USE_FFMPEG_DRM
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -26,126 +26,189 @@
 #endif
 
 #include <algorithm>
+#include <memory>
+#include <mutex>
 
 namespace f1x::openauto::autoapp::projection {
 
-std::vector<AudioDeviceInfo> AudioDeviceList::getOutputDevices() {
+namespace {
+
+struct Registry {
+  std::mutex probeMutex; // one probe at a time
+  std::mutex mutex;      // guards the snapshot below
+  bool probed = false;
   std::vector<AudioDeviceInfo> devices;
+  uint32_t defaultOutput = 0;
+  uint32_t defaultInput = 0;
+};
 
-  try {
-    // Prefer ALSA backend for lower latency
-    std::vector<RtAudio::Api> apis;
-    RtAudio::getCompiledApi(apis);
-
-    std::unique_ptr<RtAudio> dac;
-    if (std::find(apis.begin(), apis.end(), RtAudio::LINUX_ALSA) !=
-        apis.end()) {
-      dac = std::make_unique<RtAudio>(RtAudio::LINUX_ALSA);
-    } else {
-      dac = std::make_unique<RtAudio>();
-    }
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
 
-    uint32_t deviceCount = dac->getDeviceCount();
-    uint32_t defaultDevice = dac->getDefaultOutputDevice();
+std::unique_ptr<RtAudio> createRtAudio() {
+  // Prefer ALSA backend for lower latency
+  std::vector<RtAudio::Api> apis;
+  RtAudio::getCompiledApi(apis);
 
-    OPENAUTO_LOG(info) << "[AudioDeviceList] Found " << deviceCount
-                       << " audio devices";
+  if (std::find(apis.begin(), apis.end(), RtAudio::LINUX_ALSA) !=
+      apis.end()) {
+    return std::make_unique<RtAudio>(RtAudio::LINUX_ALSA);
+  }
+  return std::make_unique<RtAudio>();
+}
+
+AudioDeviceInfo toDeviceInfo(uint32_t id, const RtAudio::DeviceInfo &info) {
+  AudioDeviceInfo deviceInfo;
+  deviceInfo.id = id;
+  deviceInfo.name = info.name;
+  deviceInfo.isDefault = false;
+  deviceInfo.outputChannels = info.outputChannels;
+  deviceInfo.inputChannels = info.inputChannels;
+  deviceInfo.sampleRates.assign(info.sampleRates.begin(),
+                                info.sampleRates.end());
+  deviceInfo.preferredSampleRate = info.preferredSampleRate;
+  return deviceInfo;
+}
+
+// Caller holds probeMutex; the snapshot is swapped in under mutex
+void probe(Registry &r) {
+  std::vector<AudioDeviceInfo> devices;
+  uint32_t defaultOutput = 0;
+  uint32_t defaultInput = 0;
+
+  try {
+    auto dac = createRtAudio();
+    defaultOutput = dac->getDefaultOutputDevice();
+    defaultInput = dac->getDefaultInputDevice();
 
-    for (uint32_t i = 0; i < deviceCount; i++) {
 #if defined(RTAUDIO_VERSION_MAJOR) && (RTAUDIO_VERSION_MAJOR >= 6)
-      RtAudio::DeviceInfo info = dac->getDeviceInfo(i);
+    for (unsigned int id : dac->getDeviceIds()) {
+      devices.push_back(toDeviceInfo(id, dac->getDeviceInfo(id)));
+    }
 #else
-      RtAudio::DeviceInfo info;
+    uint32_t deviceCount = dac->getDeviceCount();
+    for (uint32_t i = 0; i < deviceCount; i++) {
       try {
-        info = dac->getDeviceInfo(i);
+        devices.push_back(toDeviceInfo(i, dac->getDeviceInfo(i)));
       } catch (const RtAudioError &e) {
         OPENAUTO_LOG(warning) << "[AudioDeviceList] Error getting device " << i
                               << " info: " << e.what();
-        continue;
-      }
-#endif
-
-      // Only include devices that support output
-      if (info.outputChannels > 0) {
-        AudioDeviceInfo deviceInfo;
-        deviceInfo.id = i;
-        deviceInfo.name = info.name;
-        deviceInfo.isDefault = (i == defaultDevice);
-        deviceInfo.outputChannels = info.outputChannels;
-        deviceInfo.inputChannels = info.inputChannels;
-
-        OPENAUTO_LOG(debug)
-            << "[AudioDeviceList] Output Device " << i << ": " << info.name
-            << " (outputs: " << info.outputChannels << ")"
-            << (deviceInfo.isDefault ? " [DEFAULT]" : "");
-
-        devices.push_back(deviceInfo);
       }
     }
+#endif
   } catch (const std::exception &e) {
     OPENAUTO_LOG(error) << "[AudioDeviceList] Error enumerating devices: "
                         << e.what();
   }
 
-  return devices;
+  OPENAUTO_LOG(info) << "[AudioDeviceList] Found " << devices.size()
+                     << " audio devices";
+  for (const auto &device : devices) {
+    OPENAUTO_LOG(debug) << "[AudioDeviceList] Device " << device.id << ": "
+                        << device.name
+                        << " (outputs: " << device.outputChannels
+                        << ", inputs: " << device.inputChannels
+                        << ", preferred rate: " << device.preferredSampleRate
+                        << ")"
+                        << (device.id == defaultOutput ? " [DEFAULT OUT]" : "")
+                        << (device.id == defaultInput ? " [DEFAULT IN]" : "");
+  }
+
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.devices = std::move(devices);
+  r.defaultOutput = defaultOutput;
+  r.defaultInput = defaultInput;
+  r.probed = true;
 }
 
-std::vector<AudioDeviceInfo> AudioDeviceList::getInputDevices() {
-  std::vector<AudioDeviceInfo> devices;
+// The registry, probed first if it never was; a refresh under way does not
+// hold up lookups, which answer from the previous snapshot meanwhile
+Registry &probedRegistry() {
+  auto &r = registry();
+  {
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.probed) {
+      return r;
+    }
+  }
 
-  try {
-    std::vector<RtAudio::Api> apis;
-    RtAudio::getCompiledApi(apis);
-
-    std::unique_ptr<RtAudio> dac;
-    if (std::find(apis.begin(), apis.end(), RtAudio::LINUX_ALSA) !=
-        apis.end()) {
-      dac = std::make_unique<RtAudio>(RtAudio::LINUX_ALSA);
-    } else {
-      dac = std::make_unique<RtAudio>();
+  std::lock_guard<std::mutex> probeLock(r.probeMutex);
+  bool probed;
+  {
+    std::lock_guard<std::mutex> lock(r.mutex);
+    probed = r.probed; // another caller may have probed meanwhile
+  }
+  if (!probed) {
+    probe(r);
+  }
+  return r;
+}
+
+// The snapshot's devices with outputs, or with inputs
+std::vector<AudioDeviceInfo> devicesFor(bool output) {
+  auto &r = probedRegistry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  const uint32_t defaultDevice = output ? r.defaultOutput : r.defaultInput;
+
+  std::vector<AudioDeviceInfo> devices;
+  for (const auto &device : r.devices) {
+    if ((output ? device.outputChannels : device.inputChannels) > 0) {
+      devices.push_back(device);
+      devices.back().isDefault = (device.id == defaultDevice);
     }
+  }
+  return devices;
+}
 
-    uint32_t deviceCount = dac->getDeviceCount();
-    uint32_t defaultDevice = dac->getDefaultInputDevice();
+} // namespace
 
-    OPENAUTO_LOG(info) << "[AudioDeviceList] Found " << deviceCount
-                       << " audio devices";
+bool AudioDeviceInfo::supportsSampleRate(uint32_t sampleRate) const {
+  return std::find(sampleRates.begin(), sampleRates.end(), sampleRate) !=
+         sampleRates.end();
+}
 
-    for (uint32_t i = 0; i < deviceCount; i++) {
-#if defined(RTAUDIO_VERSION_MAJOR) && (RTAUDIO_VERSION_MAJOR >= 6)
-      RtAudio::DeviceInfo info = dac->getDeviceInfo(i);
-#else
-      RtAudio::DeviceInfo info;
-      try {
-        info = dac->getDeviceInfo(i);
-      } catch (const RtAudioError &e) {
-        continue;
-      }
-#endif
+uint32_t AudioDeviceInfo::nativeSampleRate(
+    const std::vector<uint32_t> &candidates, uint32_t fallback) const {
+  if (std::find(candidates.begin(), candidates.end(), preferredSampleRate) !=
+          candidates.end() &&
+      supportsSampleRate(preferredSampleRate)) {
+    return preferredSampleRate;
+  }
+  for (uint32_t rate : candidates) {
+    if (supportsSampleRate(rate)) {
+      return rate;
+    }
+  }
+  return fallback;
+}
 
-      // Only include devices that support input
-      if (info.inputChannels > 0) {
-        AudioDeviceInfo deviceInfo;
-        deviceInfo.id = i;
-        deviceInfo.name = info.name;
-        deviceInfo.isDefault = (i == defaultDevice);
-        deviceInfo.outputChannels = info.outputChannels;
-        deviceInfo.inputChannels = info.inputChannels;
-
-        OPENAUTO_LOG(debug)
-            << "[AudioDeviceList] Input Device " << i << ": " << info.name
-            << " (inputs: " << info.inputChannels << ")"
-            << (deviceInfo.isDefault ? " [DEFAULT]" : "");
-
-        devices.push_back(deviceInfo);
-      }
+void AudioDeviceList::refresh() {
+  auto &r = registry();
+  std::lock_guard<std::mutex> probeLock(r.probeMutex);
+  probe(r);
+}
+
+bool AudioDeviceList::findDevice(uint32_t id, AudioDeviceInfo &info) {
+  auto &r = probedRegistry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (const auto &device : r.devices) {
+    if (device.id == id) {
+      info = device;
+      info.isDefault = (id == r.defaultOutput || id == r.defaultInput);
+      return true;
     }
-  } catch (const std::exception &e) {
-    OPENAUTO_LOG(error) << "[AudioDeviceList] Error enumerating input devices: "
-                        << e.what();
   }
+  return false;
+}
 
-  return devices;
+std::vector<AudioDeviceInfo> AudioDeviceList::getOutputDevices() {
+  return devicesFor(true);
+}
+
+std::vector<AudioDeviceInfo> AudioDeviceList::getInputDevices() {
+  return devicesFor(false);
 }
 
 uint32_t AudioDeviceList::findOutputDeviceByName(const std::string &name) {
@@ -187,46 +250,15 @@ uint32_t AudioDeviceList::findInputDeviceByName(const std::string &name) {
 }
 
 uint32_t AudioDeviceList::getDefaultOutputDeviceId() {
-  try {
-    std::vector<RtAudio::Api> apis;
-    RtAudio::getCompiledApi(apis);
-
-    std::unique_ptr<RtAudio> dac;
-    if (std::find(apis.begin(), apis.end(), RtAudio::LINUX_ALSA) !=
-        apis.end()) {
-      dac = std::make_unique<RtAudio>(RtAudio::LINUX_ALSA);
-    } else {
-      dac = std::make_unique<RtAudio>();
-    }
-
-    return dac->getDefaultOutputDevice();
-  } catch (const std::exception &e) {
-    OPENAUTO_LOG(error)
-        << "[AudioDeviceList] Error getting default output device: "
-        << e.what();
-    return 0;
-  }
+  auto &r = probedRegistry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  return r.defaultOutput;
 }
 
 uint32_t AudioDeviceList::getDefaultInputDeviceId() {
-  try {
-    std::vector<RtAudio::Api> apis;
-    RtAudio::getCompiledApi(apis);
-
-    std::unique_ptr<RtAudio> dac;
-    if (std::find(apis.begin(), apis.end(), RtAudio::LINUX_ALSA) !=
-        apis.end()) {
-      dac = std::make_unique<RtAudio>(RtAudio::LINUX_ALSA);
-    } else {
-      dac = std::make_unique<RtAudio>();
-    }
-
-    return dac->getDefaultInputDevice();
-  } catch (const std::exception &e) {
-    OPENAUTO_LOG(error)
-        << "[AudioDeviceList] Error getting default input device: " << e.what();
-    return 0;
-  }
+  auto &r = probedRegistry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  return r.defaultInput;
 }
 
 } // namespace f1x::openauto::autoapp::projection
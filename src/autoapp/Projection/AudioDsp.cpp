@@ -0,0 +1,171 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+ * AudioDsp.cpp
+ *
+ * Sample kernels for the audio mixer's RT callback. The per-sample loops
+ * are SimdKernels, NEON where the CPU has it.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <f1x/openauto/autoapp/Projection/AudioDsp.hpp>
+#include <f1x/openauto/autoapp/Projection/SimdKernels.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          int16_t saturate(int32_t sample)
+          {
+            return static_cast<int16_t>(std::min<int32_t>(std::max<int32_t>(sample, -32768), 32767));
+          }
+        }
+
+        static_assert(PolyphaseResampler::cTapsPerPhase == 8, "one dotProduct8 per phase");
+
+        int16_t gainToQ15(float gain)
+        {
+          return static_cast<int16_t>(std::lround(std::min(std::max(gain, 0.0f), 1.0f) * cUnityGainQ15));
+        }
+
+        void mixSaturate(int16_t *dst, const int16_t *src, size_t samples)
+        {
+          simdKernels().mixSaturate(dst, src, samples);
+        }
+
+        void applyGainQ15(int16_t *samples, size_t frames, uint32_t channels, int16_t startGain,
+                          int16_t endGain)
+        {
+          if (frames == 0 || (startGain == cUnityGainQ15 && endGain == cUnityGainQ15))
+          {
+            return;
+          }
+          simdKernels().applyGainQ15(samples, frames, channels, startGain, endGain);
+        }
+
+        void upmixMonoToStereo(int16_t *dst, const int16_t *src, size_t frames)
+        {
+          simdKernels().upmixMonoToStereo(dst, src, frames);
+        }
+
+        // ============================================================================
+        // PolyphaseResampler
+        // ============================================================================
+
+        constexpr size_t PolyphaseResampler::cTapsPerPhase;
+
+        PolyphaseResampler::PolyphaseResampler(uint32_t ratio, uint32_t channels, size_t maxOutputFrames)
+            : ratio_(std::max<uint32_t>(ratio, 1)), channels_(channels), taps_(ratio_ * cTapsPerPhase),
+              work_(channels, std::vector<int16_t>(cTapsPerPhase + maxOutputFrames / ratio_ + 1, 0)),
+              phase_(0)
+        {
+          // Blackman-windowed sinc cutting off just below the input Nyquist,
+          // with a gain of ratio_ to make up for the zero-stuffing
+          const size_t length = ratio_ * cTapsPerPhase;
+          const double cutoff = 0.45 / ratio_;
+          const double centre = (length - 1) / 2.0;
+          std::vector<double> filter(length);
+          for (size_t n = 0; n < length; n++)
+          {
+            const double x = n - centre;
+            const double sinc = x == 0 ? 2 * cutoff : std::sin(2 * M_PI * cutoff * x) / (M_PI * x);
+            const double window = 0.42 - 0.5 * std::cos(2 * M_PI * n / (length - 1)) +
+                                  0.08 * std::cos(4 * M_PI * n / (length - 1));
+            filter[n] = ratio_ * sinc * window;
+          }
+
+          // Output phase p of input frame i is sum over k of h[p + k * ratio]
+          // * x[i - k]; stored oldest input first to match the work buffer
+          for (uint32_t p = 0; p < ratio_; p++)
+          {
+            for (size_t j = 0; j < cTapsPerPhase; j++)
+            {
+              const double tap = filter[p + (cTapsPerPhase - 1 - j) * ratio_];
+              taps_[p * cTapsPerPhase + j] = saturate(static_cast<int32_t>(std::lround(tap * 32768)));
+            }
+          }
+        }
+
+        size_t PolyphaseResampler::inputFramesFor(size_t outputFrames) const
+        {
+          // One input frame each time the phase wraps to 0
+          const uint32_t first = (ratio_ - phase_) % ratio_;
+          return first < outputFrames ? (outputFrames - first + ratio_ - 1) / ratio_ : 0;
+        }
+
+        void PolyphaseResampler::process(const int16_t *input, int16_t *output, size_t outputFrames)
+        {
+          const size_t inputFrames = inputFramesFor(outputFrames);
+          const auto dotProduct = simdKernels().dotProduct8;
+
+          for (uint32_t c = 0; c < channels_; c++)
+          {
+            auto &work = work_[c];
+            for (size_t i = 0; i < inputFrames; i++)
+            {
+              work[cTapsPerPhase + i] = input[i * channels_ + c];
+            }
+
+            // Newest input frame the current phase interpolates towards
+            size_t newest = cTapsPerPhase - 1;
+            uint32_t phase = phase_;
+            for (size_t i = 0; i < outputFrames; i++)
+            {
+              if (phase == 0)
+              {
+                newest++;
+              }
+              const int32_t acc = dotProduct(&taps_[phase * cTapsPerPhase], &work[newest + 1 - cTapsPerPhase]);
+              output[i * channels_ + c] = saturate((acc + (1 << 14)) >> 15);
+              phase = (phase + 1) % ratio_;
+            }
+
+            std::copy(work.begin() + inputFrames, work.begin() + inputFrames + cTapsPerPhase, work.begin());
+          }
+
+          phase_ = static_cast<uint32_t>((phase_ + outputFrames) % ratio_);
+        }
+
+        void PolyphaseResampler::reset()
+        {
+          for (auto &work : work_)
+          {
+            std::fill(work.begin(), work.end(), 0);
+          }
+          phase_ = 0;
+        }
+
+        uint32_t PolyphaseResampler::ratio() const
+        {
+          return ratio_;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
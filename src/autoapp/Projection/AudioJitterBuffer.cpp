@@ -0,0 +1,230 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/Projection/AudioJitterBuffer.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          // Timestamps may run this far ahead of the audio already received
+          // before the difference is treated as missing audio
+          constexpr uint64_t cGapToleranceUs = 20000;
+          // Larger jumps are a new stream, not a gap to fill
+          constexpr uint64_t cMaxGapUs = 1000000;
+          // Per-callback weight of the newest fill level sample
+          constexpr double cFillSmoothing = 1.0 / 32;
+          constexpr size_t cMaxFrameBytes = 16;
+        }
+
+        AudioJitterBuffer::AudioJitterBuffer(uint32_t frameBytes, uint32_t sampleRate, uint32_t targetMs)
+            : frameBytes_(std::min<uint32_t>(std::max<uint32_t>(frameBytes, 1), cMaxFrameBytes)),
+              sampleRate_(sampleRate),
+              targetFrames_(static_cast<uint32_t>(static_cast<uint64_t>(sampleRate) * targetMs / 1000)),
+              // Beyond four times the target (at least 250 ms) packets are
+              // dropped instead of letting latency grow without bound
+              maxFrames_(std::max(targetFrames_ * 4, sampleRate / 4)),
+              ring_(static_cast<size_t>(maxFrames_) * frameBytes_),
+              memory_(MemoryPool::Audio, static_cast<int64_t>(ring_.memoryBytes())),
+              nextTimestamp_(0), playing_(false), averageFill_(0)
+        {
+        }
+
+        bool AudioJitterBuffer::push(uint64_t timestamp, const uint8_t *data, size_t size)
+        {
+          const size_t frames = size / frameBytes_;
+          if (data == nullptr || frames == 0)
+          {
+            return false;
+          }
+
+          if (timestamp != 0)
+          {
+            if (nextTimestamp_ != 0 && timestamp > nextTimestamp_ + cGapToleranceUs &&
+                timestamp - nextTimestamp_ < cMaxGapUs)
+            {
+              const uint64_t gapFrames = (timestamp - nextTimestamp_) * sampleRate_ / 1000000;
+              gaps_.fetch_add(1, std::memory_order_relaxed);
+              pushSilence(std::min<uint64_t>(gapFrames, targetFrames_));
+            }
+            nextTimestamp_ = timestamp + static_cast<uint64_t>(frames) * 1000000 / sampleRate_;
+          }
+
+          if (queuedFrames() + frames > maxFrames_)
+          {
+            overruns_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+          }
+
+          ring_.write(data, frames * frameBytes_);
+          return true;
+        }
+
+        void AudioJitterBuffer::pushSilence(size_t frames)
+        {
+          size_t bytes = std::min(frames, maxFrames_ - std::min<size_t>(queuedFrames(), maxFrames_)) * frameBytes_;
+          // Zeroed in place in ring memory, at most two spans around the wrap
+          while (bytes > 0)
+          {
+            const auto span = ring_.reserveWrite();
+            const size_t size = std::min(bytes, span.size);
+            if (size == 0)
+            {
+              break;
+            }
+            memset(span.data, 0, size);
+            ring_.commitWrite(size);
+            bytes -= size;
+          }
+        }
+
+        void AudioJitterBuffer::pull(void *output, size_t frames)
+        {
+          auto *out = static_cast<uint8_t *>(output);
+          if (out == nullptr || frames == 0)
+          {
+            return;
+          }
+
+          const size_t available = queuedFrames();
+          if (!playing_)
+          {
+            if (available < targetFrames_ + frames)
+            {
+              memset(out, 0, frames * frameBytes_);
+              return;
+            }
+            playing_ = true;
+            averageFill_ = static_cast<double>(available - frames);
+          }
+
+          if (available < frames)
+          {
+            readFrames(out, available);
+            memset(out + available * frameBytes_, 0, (frames - available) * frameBytes_);
+            underruns_.fetch_add(1, std::memory_order_relaxed);
+            playing_ = false;
+            return;
+          }
+
+          averageFill_ += (static_cast<double>(available - frames) - averageFill_) * cFillSmoothing;
+          const double error = averageFill_ - targetFrames_;
+          const double hysteresis = std::max(targetFrames_ / 4.0, 1.0);
+
+          if (error > hysteresis && available > frames)
+          {
+            // Ahead of the DAC: skip one frame mid-buffer
+            uint8_t skipped[cMaxFrameBytes];
+            const size_t half = frames / 2;
+            readFrames(out, half);
+            readFrames(skipped, 1);
+            readFrames(out + half * frameBytes_, frames - half);
+            droppedFrames_.fetch_add(1, std::memory_order_relaxed);
+          }
+          else if (error < -hysteresis && frames > 1)
+          {
+            // Behind: repeat the last frame
+            readFrames(out, frames - 1);
+            memcpy(out + (frames - 1) * frameBytes_, out + (frames - 2) * frameBytes_, frameBytes_);
+            insertedFrames_.fetch_add(1, std::memory_order_relaxed);
+          }
+          else
+          {
+            readFrames(out, frames);
+          }
+        }
+
+        void AudioJitterBuffer::restartTimeline()
+        {
+          nextTimestamp_ = 0;
+        }
+
+        void AudioJitterBuffer::drain(void *output, size_t frames)
+        {
+          auto *out = static_cast<uint8_t *>(output);
+          if (out == nullptr || frames == 0)
+          {
+            return;
+          }
+
+          const size_t played = std::min(queuedFrames(), frames);
+          readFrames(out, played);
+          memset(out + played * frameBytes_, 0, (frames - played) * frameBytes_);
+          // The next stream prebuffers again
+          playing_ = false;
+        }
+
+        bool AudioJitterBuffer::readFrames(uint8_t *output, size_t frames)
+        {
+          return ring_.read(output, frames * frameBytes_) == frames * frameBytes_;
+        }
+
+        void AudioJitterBuffer::clear()
+        {
+          ring_.clear();
+          nextTimestamp_ = 0;
+          playing_ = false;
+          averageFill_ = 0;
+          underruns_ = 0;
+          overruns_ = 0;
+          gaps_ = 0;
+          droppedFrames_ = 0;
+          insertedFrames_ = 0;
+        }
+
+        bool AudioJitterBuffer::isPlaying() const
+        {
+          return playing_;
+        }
+
+        AudioJitterStats AudioJitterBuffer::stats() const
+        {
+          AudioJitterStats stats;
+          stats.underruns = underruns_.load(std::memory_order_relaxed);
+          stats.overruns = overruns_.load(std::memory_order_relaxed);
+          stats.gaps = gaps_.load(std::memory_order_relaxed);
+          stats.droppedFrames = droppedFrames_.load(std::memory_order_relaxed);
+          stats.insertedFrames = insertedFrames_.load(std::memory_order_relaxed);
+          return stats;
+        }
+
+        size_t AudioJitterBuffer::queuedFrames() const
+        {
+          return ring_.available() / frameBytes_;
+        }
+
+        uint32_t AudioJitterBuffer::targetFrames() const
+        {
+          return targetFrames_;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,423 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/Projection/AudioMixer.hpp>
+#include <f1x/openauto/autoapp/Projection/RtAudioOutput.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+#include <algorithm>
+#include <thread>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          // Longer periods are mixed in chunks so scratch buffers are
+          // allocated once, outside the RT thread
+          constexpr size_t cMaxChunkFrames = 1024;
+        }
+
+        constexpr uint32_t AudioMixer::cSampleRate;
+        constexpr uint32_t AudioMixer::cChannelCount;
+        constexpr size_t AudioMixer::cMaxChannels;
+
+        // ============================================================================
+        // Device stream
+        // ============================================================================
+
+        /**
+         * @brief The one RtAudio stream, rendering the mix instead of a
+         * jitter buffer of its own.
+         */
+        class AudioMixer::DeviceOutput : public RtAudioOutput
+        {
+        public:
+          DeviceOutput(AudioMixer &mixer, uint32_t deviceId, bool lowLatency)
+              : RtAudioOutput(AudioMixer::cChannelCount, 16, AudioMixer::cSampleRate, deviceId, lowLatency),
+                mixer_(mixer)
+          {
+          }
+
+          void adapt()
+          {
+            this->adaptPeriod();
+          }
+
+        protected:
+          void render(void *output, unsigned int frames) override
+          {
+            mixer_.render(static_cast<int16_t *>(output), frames);
+          }
+
+        private:
+          AudioMixer &mixer_;
+        };
+
+        // ============================================================================
+        // AudioMixer
+        // ============================================================================
+
+        AudioMixer::AudioMixer(uint32_t deviceId, bool lowLatency, uint32_t duckingPercent)
+            : duckGain_(std::min<uint32_t>(duckingPercent, 100) / 100.0f), localFocus_(LocalMediaFocus::Full),
+              device_(std::make_unique<DeviceOutput>(*this, deviceId, lowLatency)), users_(0),
+              echoReference_(std::make_shared<EchoReference>(cSampleRate)),
+              mediaBus_(cMaxChunkFrames * cChannelCount), rendering_(false),
+              ducking_(false)
+        {
+          for (auto &channel : channels_)
+          {
+            channel.store(nullptr);
+          }
+        }
+
+        AudioMixer::~AudioMixer()
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (users_ > 0)
+          {
+            device_->stop();
+          }
+        }
+
+        AudioMixerChannel::Pointer AudioMixer::createChannel(AudioMixerRole role, uint32_t channelCount,
+                                                             uint32_t sampleRate, uint32_t jitterBufferMs)
+        {
+          if (sampleRate == 0 || cSampleRate % sampleRate != 0 || channelCount < 1 || channelCount > 2)
+          {
+            OPENAUTO_LOG(error) << "[AudioMixer] Unsupported channel format: " << channelCount << " x "
+                                << sampleRate << " Hz";
+            return nullptr;
+          }
+          return std::make_shared<AudioMixerChannel>(this->shared_from_this(), role, channelCount, sampleRate,
+                                                     jitterBufferMs);
+        }
+
+        uint32_t AudioMixer::getDeviceId() const
+        {
+          // Follows RtAudioOutput::switchAllDevices()
+          return device_->getDeviceId();
+        }
+
+        void AudioMixer::setDuckingPercent(uint32_t duckingPercent)
+        {
+          duckGain_.store(std::min<uint32_t>(duckingPercent, 100) / 100.0f, std::memory_order_relaxed);
+        }
+
+        void AudioMixer::setLocalMediaFocus(LocalMediaFocus focus)
+        {
+          localFocus_.store(focus, std::memory_order_relaxed);
+        }
+
+        void AudioMixer::setMediaDsp(MediaDspPreset::Pointer preset)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          mediaDsp_ = preset ? std::make_unique<MediaDsp>(std::move(preset)) : nullptr;
+        }
+
+        EchoReference::Pointer AudioMixer::getEchoReference() const
+        {
+          return echoReference_;
+        }
+
+        bool AudioMixer::acquire()
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (users_ == 0)
+          {
+            if (!device_->open())
+            {
+              return false;
+            }
+            device_->start();
+            OPENAUTO_LOG(info) << "[AudioMixer] Device stream started";
+          }
+          users_++;
+          return true;
+        }
+
+        void AudioMixer::release()
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (users_ > 0 && --users_ == 0)
+          {
+            device_->stop();
+            OPENAUTO_LOG(info) << "[AudioMixer] Device stream stopped";
+          }
+        }
+
+        void AudioMixer::attach(AudioMixerChannel *channel)
+        {
+          for (auto &slot : channels_)
+          {
+            AudioMixerChannel *expected = nullptr;
+            if (slot.compare_exchange_strong(expected, channel))
+            {
+              return;
+            }
+          }
+          OPENAUTO_LOG(error) << "[AudioMixer] More than " << cMaxChannels << " channels, one will be silent";
+        }
+
+        void AudioMixer::detach(AudioMixerChannel *channel)
+        {
+          for (auto &slot : channels_)
+          {
+            AudioMixerChannel *expected = channel;
+            slot.compare_exchange_strong(expected, nullptr);
+          }
+          this->waitForRender();
+        }
+
+        void AudioMixer::waitForRender() const
+        {
+          while (rendering_.load())
+          {
+            std::this_thread::yield();
+          }
+        }
+
+        void AudioMixer::adaptPeriod()
+        {
+          device_->adapt();
+        }
+
+        void AudioMixer::render(int16_t *output, size_t frames)
+        {
+          // Paired with the slot and active_ stores in detach()/stop(): either
+          // they see this flag or this pass sees the channel gone
+          rendering_.store(true);
+
+          const float mediaGain = ducking_ ? duckGain_.load(std::memory_order_relaxed) : 1.0f;
+          // The phone's focus on top, but not ducked twice over
+          float localGain = mediaGain;
+          switch (localFocus_.load(std::memory_order_relaxed))
+          {
+          case LocalMediaFocus::Muted:
+            localGain = 0.0f;
+            break;
+          case LocalMediaFocus::Ducked:
+            localGain = std::min(mediaGain, duckGain_.load(std::memory_order_relaxed));
+            break;
+          case LocalMediaFocus::Full:
+            break;
+          }
+          bool ducking = false;
+          // Bypassed, media is mixed straight into the output as before
+          const bool shaping = mediaDsp_ && mediaDsp_->prepare();
+
+          while (frames > 0)
+          {
+            const size_t chunk = std::min(frames, cMaxChunkFrames);
+            std::fill(output, output + chunk * cChannelCount, 0);
+            if (shaping)
+            {
+              std::fill(mediaBus_.begin(), mediaBus_.begin() + chunk * cChannelCount, 0);
+            }
+
+            for (auto &slot : channels_)
+            {
+              AudioMixerChannel *channel = slot.load();
+              if (channel == nullptr || !channel->active_.load())
+              {
+                continue;
+              }
+
+              const bool local = channel->role_ == AudioMixerRole::LocalMedia;
+              const bool media = local || channel->role_ == AudioMixerRole::Media;
+              int16_t *target = media && shaping ? mediaBus_.data() : output;
+              const bool playing =
+                  channel->mixInto(target, chunk, local ? localGain : (media ? mediaGain : 1.0f));
+              if (playing && (channel->role_ == AudioMixerRole::Guidance ||
+                              channel->role_ == AudioMixerRole::Telephony))
+              {
+                ducking = true;
+              }
+            }
+
+            if (shaping)
+            {
+              mediaDsp_->process(mediaBus_.data(), chunk);
+              mixSaturate(output, mediaBus_.data(), chunk * cChannelCount);
+            }
+
+            if (echoReference_->isAttached())
+            {
+              echoReference_->write(output, chunk, cChannelCount);
+            }
+
+            output += chunk * cChannelCount;
+            frames -= chunk;
+          }
+
+          // Takes effect next period, ramped like any other gain change
+          ducking_ = ducking;
+          rendering_.store(false);
+        }
+
+        // ============================================================================
+        // AudioMixerChannel
+        // ============================================================================
+
+        AudioMixerChannel::AudioMixerChannel(std::shared_ptr<AudioMixer> mixer, AudioMixerRole role,
+                                             uint32_t channelCount, uint32_t sampleRate, uint32_t jitterBufferMs)
+            : mixer_(std::move(mixer)), role_(role), channelCount_(channelCount), sampleRate_(sampleRate),
+              ratio_(AudioMixer::cSampleRate / sampleRate), buffer_(channelCount * 2, sampleRate, jitterBufferMs),
+              active_(false), gain_(1.0f), opened_(false),
+              resampler_(ratio_, channelCount, cMaxChunkFrames), input_(cMaxChunkFrames * channelCount),
+              resampled_(cMaxChunkFrames * channelCount), stereo_(cMaxChunkFrames * AudioMixer::cChannelCount),
+              appliedGain_(cUnityGainQ15)
+        {
+          mixer_->attach(this);
+        }
+
+        AudioMixerChannel::~AudioMixerChannel()
+        {
+          this->stop();
+          mixer_->detach(this);
+        }
+
+        bool AudioMixerChannel::open()
+        {
+          if (!opened_)
+          {
+            opened_ = mixer_->acquire();
+          }
+          return opened_;
+        }
+
+        void AudioMixerChannel::write(aasdk::messenger::Timestamp::ValueType timestamp,
+                                      const aasdk::common::DataConstBuffer &buffer)
+        {
+          if (!opened_)
+          {
+            return;
+          }
+          buffer_.push(timestamp, buffer.cdata, buffer.size);
+          mixer_->adaptPeriod();
+        }
+
+        void AudioMixerChannel::start()
+        {
+          active_.store(true);
+        }
+
+        void AudioMixerChannel::stop()
+        {
+          active_.store(false);
+          mixer_->waitForRender();
+
+          if (!opened_)
+          {
+            return;
+          }
+
+          const auto stats = buffer_.stats();
+          OPENAUTO_LOG(info) << "[AudioMixer] Channel " << channelCount_ << " x " << sampleRate_
+                             << " Hz: underruns " << stats.underruns << ", overruns " << stats.overruns
+                             << ", gaps " << stats.gaps << ", drift -" << stats.droppedFrames << "/+"
+                             << stats.insertedFrames << " frames";
+
+          buffer_.clear();
+          resampler_.reset();
+          opened_ = false;
+          mixer_->release();
+        }
+
+        void AudioMixerChannel::suspend()
+        {
+          // The stream just ended; whatever is queued still plays out
+        }
+
+        uint32_t AudioMixerChannel::getSampleSize() const { return 16; }
+
+        uint32_t AudioMixerChannel::getChannelCount() const { return channelCount_; }
+
+        uint32_t AudioMixerChannel::getSampleRate() const { return sampleRate_; }
+
+        void AudioMixerChannel::setGain(float gain)
+        {
+          gain_.store(std::min(std::max(gain, 0.0f), 1.0f));
+        }
+
+        AudioMixerRole AudioMixerChannel::getRole() const
+        {
+          return role_;
+        }
+
+        AudioJitterStats AudioMixerChannel::getJitterStats() const
+        {
+          return buffer_.stats();
+        }
+
+        size_t AudioMixerChannel::getQueuedFrames() const
+        {
+          return buffer_.queuedFrames();
+        }
+
+        uint32_t AudioMixerChannel::getTargetFrames() const
+        {
+          return buffer_.targetFrames();
+        }
+
+        bool AudioMixerChannel::mixInto(int16_t *mix, size_t frames, float duckGain)
+        {
+          int16_t *samples = input_.data();
+          if (ratio_ > 1)
+          {
+            const size_t needed = resampler_.inputFramesFor(frames);
+            if (needed > 0)
+            {
+              buffer_.pull(input_.data(), needed);
+            }
+            resampler_.process(input_.data(), resampled_.data(), frames);
+            samples = resampled_.data();
+          }
+          else
+          {
+            buffer_.pull(input_.data(), frames);
+          }
+          const bool playing = buffer_.isPlaying();
+
+          // Stereo input is scaled in place
+          int16_t *stereo = samples;
+          if (channelCount_ == 1)
+          {
+            stereo = stereo_.data();
+            upmixMonoToStereo(stereo, samples, frames);
+          }
+
+          const int16_t targetGain = gainToQ15(gain_.load(std::memory_order_relaxed) * duckGain);
+          applyGainQ15(stereo, frames, AudioMixer::cChannelCount, appliedGain_, targetGain);
+          appliedGain_ = targetGain;
+
+          mixSaturate(mix, stereo, frames * AudioMixer::cChannelCount);
+          return playing;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
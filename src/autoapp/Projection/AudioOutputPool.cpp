@@ -0,0 +1,101 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Projection/AudioOutputPool.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        bool AudioOutputFormat::operator==(const AudioOutputFormat &other) const
+        {
+          return channelCount == other.channelCount && sampleRate == other.sampleRate &&
+                 deviceId == other.deviceId && lowLatency == other.lowLatency &&
+                 jitterBufferMs == other.jitterBufferMs && keepRunning == other.keepRunning;
+        }
+
+        bool AudioOutputPool::isDetached(const Entry &entry)
+        {
+          // Only the pool holds it, and only the pool can hand it out again
+          return entry.output.use_count() == 1;
+        }
+
+        AudioOutputPool::OutputPointer AudioOutputPool::acquire(const AudioOutputFormat &format)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+
+          // switchAllDevices() may have moved an output since it was created
+          auto current = [&format](const Entry &entry) {
+            AudioOutputFormat actual = entry.format;
+            actual.deviceId = entry.output->getDeviceId();
+            return actual == format;
+          };
+
+          // Detached outputs left on another device or with other settings
+          // would only keep the device claimed
+          auto stale = [&format](const Entry &entry) {
+            return entry.output->getDeviceId() != format.deviceId ||
+                   entry.format.lowLatency != format.lowLatency ||
+                   entry.format.jitterBufferMs != format.jitterBufferMs;
+          };
+          entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                        [&stale](const Entry &entry) { return isDetached(entry) && stale(entry); }),
+                         entries_.end());
+
+          for (const auto &entry : entries_)
+          {
+            if (isDetached(entry) && current(entry))
+            {
+              return entry.output;
+            }
+          }
+
+          auto output = std::make_shared<RtAudioOutput>(format.channelCount, 16, format.sampleRate,
+                                                        format.deviceId, format.lowLatency,
+                                                        format.jitterBufferMs);
+          output->setKeepRunning(format.keepRunning);
+          output->setKeepOpen(true);
+          entries_.push_back({format, output});
+          OPENAUTO_LOG(info) << "[AudioOutputPool] New " << format.sampleRate << " Hz output, "
+                             << entries_.size() << " in the pool";
+          return output;
+        }
+
+        void AudioOutputPool::releaseIdle()
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          entries_.erase(std::remove_if(entries_.begin(), entries_.end(), isDetached), entries_.end());
+        }
+
+        size_t AudioOutputPool::size() const
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          return entries_.size();
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
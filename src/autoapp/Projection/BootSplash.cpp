@@ -0,0 +1,308 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/Projection/BootSplash.hpp>
+
+#ifdef USE_FFMPEG_DRM
+#include <QDir>
+#include <QImage>
+#include <drm_fourcc.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <f1x/openauto/autoapp/Projection/CmaBudget.hpp>
+#include <f1x/openauto/autoapp/Projection/DrmDevice.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          constexpr char cMagic[4] = {'O', 'A', 'S', 'P'};
+          // Larger than any panel these boards drive
+          constexpr uint32_t cMaxDimension = 4096;
+        }
+
+        BootSplash &BootSplash::instance()
+        {
+          static BootSplash splash;
+          return splash;
+        }
+
+        std::string BootSplash::lastFramePath()
+        {
+          const char *cache = getenv("XDG_CACHE_HOME");
+          if (cache && cache[0] != '\0')
+          {
+            return std::string(cache) + "/openauto/last-frame.xrgb";
+          }
+          const char *home = getenv("HOME");
+          return std::string(home ? home : "") + "/.cache/openauto/last-frame.xrgb";
+        }
+
+        bool BootSplash::readFrame(const std::string &path, FrameFile &frame)
+        {
+          std::ifstream file(path, std::ios::binary);
+          char magic[4] = {};
+          if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, cMagic, sizeof(magic)) != 0 ||
+              !file.read(reinterpret_cast<char *>(&frame.width), sizeof(frame.width)) ||
+              !file.read(reinterpret_cast<char *>(&frame.height), sizeof(frame.height)) ||
+              frame.width == 0 || frame.height == 0 || frame.width > cMaxDimension ||
+              frame.height > cMaxDimension)
+          {
+            return false;
+          }
+          frame.pixels.resize(static_cast<size_t>(frame.width) * frame.height * 4);
+          return static_cast<bool>(file.read(&frame.pixels[0], static_cast<std::streamsize>(frame.pixels.size())));
+        }
+
+        bool BootSplash::show()
+        {
+          const char *enabled = getenv("OPENAUTO_BOOT_SPLASH");
+          if (drmFd_ >= 0 || (enabled && strcmp(enabled, "0") == 0))
+          {
+            return false;
+          }
+
+          FrameFile frame;
+          if (!readFrame(lastFramePath(), frame) && !readFrame(cSplashPath, frame))
+          {
+            return false;
+          }
+
+          drmFd_ = drmdevice::openShared();
+          if (drmFd_ < 0)
+          {
+            return false;
+          }
+          if (!this->modeset(frame))
+          {
+            this->release();
+            return false;
+          }
+          // eglfs needs master for its own modeset; the framebuffer stays ours
+          drmDropMaster(drmFd_);
+          OPENAUTO_LOG(info) << "[BootSplash] " << width_ << "x" << height_ << " frame on screen";
+          return true;
+        }
+
+        bool BootSplash::modeset(const FrameFile &frame)
+        {
+          drmModeRes *resources = drmModeGetResources(drmFd_);
+          if (!resources)
+          {
+            return false;
+          }
+
+          // The connector eglfs picks by default: the first connected one
+          drmModeConnector *connector = nullptr;
+          for (int i = 0; i < resources->count_connectors && !connector; i++)
+          {
+            connector = drmModeGetConnector(drmFd_, resources->connectors[i]);
+            if (connector && (connector->connection != DRM_MODE_CONNECTED || connector->count_modes == 0))
+            {
+              drmModeFreeConnector(connector);
+              connector = nullptr;
+            }
+          }
+          if (!connector)
+          {
+            drmModeFreeResources(resources);
+            return false;
+          }
+
+          // The mode Qt will set, so its modeset changes nothing on the wire
+          drmModeModeInfo mode = connector->modes[0];
+          for (int i = 0; i < connector->count_modes; i++)
+          {
+            if (connector->modes[i].type & DRM_MODE_TYPE_PREFERRED)
+            {
+              mode = connector->modes[i];
+              break;
+            }
+          }
+
+          uint32_t crtcId = 0;
+          if (drmModeEncoder *encoder = connector->encoder_id ? drmModeGetEncoder(drmFd_, connector->encoder_id) : nullptr)
+          {
+            crtcId = encoder->crtc_id;
+            drmModeFreeEncoder(encoder);
+          }
+          for (int e = 0; e < connector->count_encoders && crtcId == 0; e++)
+          {
+            drmModeEncoder *encoder = drmModeGetEncoder(drmFd_, connector->encoders[e]);
+            for (int i = 0; encoder && i < resources->count_crtcs && crtcId == 0; i++)
+            {
+              if (encoder->possible_crtcs & (1u << i))
+              {
+                crtcId = resources->crtcs[i];
+              }
+            }
+            drmModeFreeEncoder(encoder);
+          }
+          uint32_t connectorId = connector->connector_id;
+          drmModeFreeConnector(connector);
+          drmModeFreeResources(resources);
+          if (crtcId == 0)
+          {
+            return false;
+          }
+
+          width_ = mode.hdisplay;
+          height_ = mode.vdisplay;
+          struct drm_mode_create_dumb create = {};
+          create.width = width_;
+          create.height = height_;
+          create.bpp = 32;
+          if (ioctl(drmFd_, DRM_IOCTL_MODE_CREATE_DUMB, &create) < 0)
+          {
+            OPENAUTO_LOG(warning) << "[BootSplash] Failed to allocate " << width_ << "x" << height_
+                                  << " buffer: " << strerror(errno);
+            return false;
+          }
+          handle_ = create.handle;
+          size_ = create.size;
+          CmaBudget::instance().add(CmaPool::DumbBuffer, static_cast<int64_t>(size_));
+
+          // Written once and unmapped: only the framebuffer has to outlive show()
+          struct drm_mode_map_dumb map = {};
+          map.handle = handle_;
+          void *pixels = ioctl(drmFd_, DRM_IOCTL_MODE_MAP_DUMB, &map) < 0
+                             ? MAP_FAILED
+                             : mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, drmFd_, map.offset);
+          if (pixels == MAP_FAILED)
+          {
+            return false;
+          }
+          // Centred when the panel changed since the frame was saved
+          auto *target = static_cast<uint8_t *>(pixels);
+          std::memset(target, 0, size_);
+          const uint32_t columns = std::min(frame.width, width_);
+          const uint32_t rows = std::min(frame.height, height_);
+          const uint32_t sourceX = (frame.width - columns) / 2;
+          const uint32_t sourceY = (frame.height - rows) / 2;
+          const uint32_t targetX = (width_ - columns) / 2;
+          const uint32_t targetY = (height_ - rows) / 2;
+          for (uint32_t y = 0; y < rows; y++)
+          {
+            std::memcpy(target + (targetY + y) * create.pitch + targetX * 4,
+                        frame.pixels.data() + ((sourceY + y) * static_cast<size_t>(frame.width) + sourceX) * 4,
+                        columns * 4);
+          }
+          munmap(pixels, size_);
+
+          uint32_t handles[4] = {handle_, 0, 0, 0};
+          uint32_t pitches[4] = {create.pitch, 0, 0, 0};
+          uint32_t offsets[4] = {0, 0, 0, 0};
+          if (drmModeAddFB2(drmFd_, width_, height_, DRM_FORMAT_XRGB8888, handles, pitches, offsets, &fbId_, 0) != 0 ||
+              drmModeSetCrtc(drmFd_, crtcId, fbId_, 0, 0, &connectorId, 1, &mode) != 0)
+          {
+            OPENAUTO_LOG(warning) << "[BootSplash] Failed to show the frame: " << strerror(errno);
+            return false;
+          }
+          return true;
+        }
+
+        void BootSplash::destroyBuffer()
+        {
+          if (fbId_)
+          {
+            drmModeRmFB(drmFd_, fbId_);
+            fbId_ = 0;
+          }
+          if (handle_)
+          {
+            struct drm_mode_destroy_dumb destroy = {};
+            destroy.handle = handle_;
+            ioctl(drmFd_, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+            CmaBudget::instance().release(CmaPool::DumbBuffer, static_cast<int64_t>(size_));
+            handle_ = 0;
+          }
+        }
+
+        void BootSplash::release()
+        {
+          if (drmFd_ < 0)
+          {
+            return;
+          }
+          this->destroyBuffer();
+          close(drmFd_);
+          drmFd_ = -1;
+        }
+
+        bool BootSplash::saveFrame(const QImage &frame)
+        {
+          if (frame.isNull())
+          {
+            return false;
+          }
+          // XRGB8888 in memory on the little-endian boards this runs on
+          QImage image = frame.convertToFormat(QImage::Format_RGB32);
+          if (width_ != 0 && height_ != 0 && (image.width() != static_cast<int>(width_) ||
+                                              image.height() != static_cast<int>(height_)))
+          {
+            image = image.scaled(static_cast<int>(width_), static_cast<int>(height_), Qt::IgnoreAspectRatio,
+                                 Qt::SmoothTransformation);
+          }
+
+          const std::string path = lastFramePath();
+          QDir().mkpath(QString::fromStdString(path.substr(0, path.rfind('/'))));
+          // Through a temporary, so a power cut mid-write leaves the old frame
+          const std::string temporary = path + ".tmp";
+          {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            const uint32_t width = static_cast<uint32_t>(image.width());
+            const uint32_t height = static_cast<uint32_t>(image.height());
+            file.write(cMagic, sizeof(cMagic));
+            file.write(reinterpret_cast<const char *>(&width), sizeof(width));
+            file.write(reinterpret_cast<const char *>(&height), sizeof(height));
+            for (int y = 0; y < image.height(); y++)
+            {
+              file.write(reinterpret_cast<const char *>(image.constScanLine(y)), image.width() * 4);
+            }
+            if (!file.flush())
+            {
+              OPENAUTO_LOG(warning) << "[BootSplash] Cannot write " << temporary;
+              return false;
+            }
+          }
+          return rename(temporary.c_str(), path.c_str()) == 0;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
@@ -0,0 +1,467 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/Projection/ClusterAtlas.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        constexpr char ClusterAtlas::cCharacters[];
+
+        namespace
+        {
+          struct Point
+          {
+            float x;
+            float y;
+          };
+
+          // Shapes are given in their own units, scaled and optionally mirrored
+          // into the image; coverage only ever grows, so shapes overlap cleanly
+          class Canvas
+          {
+          public:
+            Canvas(ClusterAtlas::Image &image, float scale, float offset, bool mirror)
+                : image_(image), scale_(scale), offset_(offset), mirror_(mirror)
+            {
+            }
+
+            Point map(Point p) const
+            {
+              return {offset_ + (mirror_ ? 1.0f - p.x : p.x) * scale_, offset_ + p.y * scale_};
+            }
+
+            float scale() const { return scale_; }
+
+            template <typename Coverage>
+            void fill(float left, float top, float right, float bottom, Coverage coverage)
+            {
+              const int x0 = std::max(0, static_cast<int>(std::floor(left)));
+              const int y0 = std::max(0, static_cast<int>(std::floor(top)));
+              const int x1 = std::min(static_cast<int>(image_.width), static_cast<int>(std::ceil(right)) + 1);
+              const int y1 = std::min(static_cast<int>(image_.height), static_cast<int>(std::ceil(bottom)) + 1);
+              for (int y = y0; y < y1; y++)
+              {
+                for (int x = x0; x < x1; x++)
+                {
+                  const float c = std::min(1.0f, std::max(0.0f, coverage(x + 0.5f, y + 0.5f)));
+                  uint8_t &out = image_.coverage[static_cast<size_t>(y) * image_.width + x];
+                  out = std::max(out, static_cast<uint8_t>(c * 255.0f + 0.5f));
+                }
+              }
+            }
+
+          private:
+            ClusterAtlas::Image &image_;
+            float scale_;
+            float offset_;
+            bool mirror_;
+          };
+
+          void stroke(Canvas &canvas, Point from, Point to, float width)
+          {
+            const Point a = canvas.map(from);
+            const Point b = canvas.map(to);
+            const float half = width * canvas.scale() / 2;
+            const float dx = b.x - a.x;
+            const float dy = b.y - a.y;
+            const float lengthSquared = dx * dx + dy * dy;
+            canvas.fill(std::min(a.x, b.x) - half - 1, std::min(a.y, b.y) - half - 1, std::max(a.x, b.x) + half + 1,
+                        std::max(a.y, b.y) + half + 1,
+                        [&](float x, float y)
+                        {
+                          float t = lengthSquared > 0 ? ((x - a.x) * dx + (y - a.y) * dy) / lengthSquared : 0;
+                          t = std::min(1.0f, std::max(0.0f, t));
+                          return half + 0.5f - std::hypot(x - a.x - t * dx, y - a.y - t * dy);
+                        });
+          }
+
+          void polyline(Canvas &canvas, std::initializer_list<Point> points, float width)
+          {
+            for (auto it = points.begin(); it + 1 < points.end(); ++it)
+            {
+              stroke(canvas, *it, *(it + 1), width);
+            }
+          }
+
+          void triangle(Canvas &canvas, Point p0, Point p1, Point p2)
+          {
+            Point v[3] = {canvas.map(p0), canvas.map(p1), canvas.map(p2)};
+            // Clockwise on screen, which mirroring reverses
+            if ((v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x) < 0)
+            {
+              std::swap(v[1], v[2]);
+            }
+            canvas.fill(std::min({v[0].x, v[1].x, v[2].x}) - 1, std::min({v[0].y, v[1].y, v[2].y}) - 1,
+                        std::max({v[0].x, v[1].x, v[2].x}) + 1, std::max({v[0].y, v[1].y, v[2].y}) + 1,
+                        [&](float x, float y)
+                        {
+                          float inside = 1e9f;
+                          for (int i = 0; i < 3; i++)
+                          {
+                            const Point &a = v[i];
+                            const Point &b = v[(i + 1) % 3];
+                            const float length = std::hypot(b.x - a.x, b.y - a.y);
+                            if (length > 0)
+                            {
+                              inside = std::min(inside, ((b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x)) / length);
+                            }
+                          }
+                          return inside + 0.5f;
+                        });
+          }
+
+          void ring(Canvas &canvas, Point centre, float radius, float width)
+          {
+            const Point c = canvas.map(centre);
+            const float r = radius * canvas.scale();
+            const float half = width * canvas.scale() / 2;
+            canvas.fill(c.x - r - half - 1, c.y - r - half - 1, c.x + r + half + 1, c.y + r + half + 1,
+                        [&](float x, float y)
+                        { return half + 0.5f - std::fabs(std::hypot(x - c.x, y - c.y) - r); });
+          }
+
+          // Polyline ending in an arrowhead at its last point
+          void arrow(Canvas &canvas, std::initializer_list<Point> points, float width)
+          {
+            const Point tip = *(points.end() - 1);
+            const Point from = *(points.end() - 2);
+            const float length = std::hypot(tip.x - from.x, tip.y - from.y);
+            const float ux = (tip.x - from.x) / length;
+            const float uy = (tip.y - from.y) / length;
+            const float headLength = width * 2.2f;
+            const float headHalfWidth = width * 1.6f;
+            const Point base = {tip.x - ux * headLength, tip.y - uy * headLength};
+
+            for (auto it = points.begin(); it + 2 < points.end(); ++it)
+            {
+              stroke(canvas, *it, *(it + 1), width);
+            }
+            // The shaft stops inside the head so its round cap stays hidden
+            stroke(canvas, from, {base.x + ux * width * 0.5f, base.y + uy * width * 0.5f}, width);
+            triangle(canvas, tip, {base.x - uy * headHalfWidth, base.y + ux * headHalfWidth},
+                     {base.x + uy * headHalfWidth, base.y - ux * headHalfWidth});
+          }
+
+          constexpr float cIconStroke = 0.11f;
+
+          // Left-handed forms; the right ones are their mirror images
+          void drawIcon(Canvas &canvas, ClusterAtlas::Icon icon)
+          {
+            const float w = cIconStroke;
+            switch (icon)
+            {
+            case ClusterAtlas::Icon::Straight:
+              arrow(canvas, {{0.5f, 0.92f}, {0.5f, 0.08f}}, w);
+              break;
+            case ClusterAtlas::Icon::SlightLeft:
+            case ClusterAtlas::Icon::SlightRight:
+              arrow(canvas, {{0.6f, 0.92f}, {0.6f, 0.55f}, {0.28f, 0.12f}}, w);
+              break;
+            case ClusterAtlas::Icon::Left:
+            case ClusterAtlas::Icon::Right:
+              arrow(canvas, {{0.66f, 0.92f}, {0.66f, 0.42f}, {0.08f, 0.42f}}, w);
+              break;
+            case ClusterAtlas::Icon::SharpLeft:
+            case ClusterAtlas::Icon::SharpRight:
+              arrow(canvas, {{0.66f, 0.92f}, {0.66f, 0.2f}, {0.14f, 0.72f}}, w);
+              break;
+            case ClusterAtlas::Icon::UTurnLeft:
+            case ClusterAtlas::Icon::UTurnRight:
+            {
+              // Up the right leg, over the top and back down the left
+              const float r = 0.18f;
+              Point previous = {0.68f, 0.38f};
+              stroke(canvas, {0.68f, 0.92f}, previous, w);
+              for (int step = 1; step <= 8; step++)
+              {
+                const float angle = static_cast<float>(M_PI) * step / 8;
+                const Point next = {0.5f + r * std::cos(angle), 0.38f - r * std::sin(angle)};
+                stroke(canvas, previous, next, w);
+                previous = next;
+              }
+              arrow(canvas, {previous, {0.32f, 0.78f}}, w);
+              break;
+            }
+            case ClusterAtlas::Icon::RampLeft:
+            case ClusterAtlas::Icon::RampRight:
+              polyline(canvas, {{0.62f, 0.92f}, {0.62f, 0.08f}}, w * 0.5f);
+              arrow(canvas, {{0.62f, 0.92f}, {0.62f, 0.62f}, {0.22f, 0.16f}}, w);
+              break;
+            case ClusterAtlas::Icon::ForkLeft:
+            case ClusterAtlas::Icon::ForkRight:
+              polyline(canvas, {{0.5f, 0.58f}, {0.8f, 0.18f}}, w * 0.5f);
+              arrow(canvas, {{0.5f, 0.92f}, {0.5f, 0.58f}, {0.2f, 0.12f}}, w);
+              break;
+            case ClusterAtlas::Icon::Merge:
+              polyline(canvas, {{0.2f, 0.92f}, {0.5f, 0.5f}}, w * 0.5f);
+              arrow(canvas, {{0.8f, 0.92f}, {0.5f, 0.5f}, {0.5f, 0.08f}}, w);
+              break;
+            case ClusterAtlas::Icon::RoundaboutLeft:
+            case ClusterAtlas::Icon::RoundaboutRight:
+              // Room in the ring for the exit number
+              ring(canvas, {0.5f, 0.5f}, 0.22f, w);
+              stroke(canvas, {0.5f, 0.96f}, {0.5f, 0.72f}, w);
+              arrow(canvas, {{0.35f, 0.35f}, {0.1f, 0.08f}}, w);
+              break;
+            case ClusterAtlas::Icon::Destination:
+              ring(canvas, {0.5f, 0.34f}, 0.17f, w * 1.2f);
+              triangle(canvas, {0.3f, 0.44f}, {0.7f, 0.44f}, {0.5f, 0.92f});
+              break;
+            case ClusterAtlas::Icon::Ferry:
+              stroke(canvas, {0.22f, 0.68f}, {0.78f, 0.68f}, w * 2);
+              polyline(canvas, {{0.32f, 0.58f}, {0.32f, 0.38f}, {0.68f, 0.38f}, {0.68f, 0.58f}}, w);
+              polyline(canvas, {{0.5f, 0.38f}, {0.5f, 0.14f}}, w);
+              polyline(canvas, {{0.08f, 0.92f}, {0.92f, 0.92f}}, w * 0.6f);
+              break;
+            default:
+              break;
+            }
+          }
+
+          bool isMirrored(ClusterAtlas::Icon icon)
+          {
+            switch (icon)
+            {
+            case ClusterAtlas::Icon::SlightRight:
+            case ClusterAtlas::Icon::Right:
+            case ClusterAtlas::Icon::SharpRight:
+            case ClusterAtlas::Icon::UTurnRight:
+            case ClusterAtlas::Icon::RampRight:
+            case ClusterAtlas::Icon::ForkRight:
+            case ClusterAtlas::Icon::RoundaboutRight:
+              return true;
+            default:
+              return false;
+            }
+          }
+
+          // A boxy stroke font on a 4 x 6 grid, y down; a zero-length stroke
+          // is a dot
+          struct GlyphShape
+          {
+            char character;
+            float width;
+            std::vector<std::pair<Point, Point>> strokes;
+          };
+
+          const GlyphShape cGlyphShapes[] = {
+              {'0', 4, {{{0, 0}, {4, 0}}, {{4, 0}, {4, 6}}, {{4, 6}, {0, 6}}, {{0, 6}, {0, 0}}}},
+              {'1', 2, {{{0, 1}, {1, 0}}, {{1, 0}, {1, 6}}, {{0, 6}, {2, 6}}}},
+              {'2', 4, {{{0, 0}, {4, 0}}, {{4, 0}, {4, 3}}, {{4, 3}, {0, 3}}, {{0, 3}, {0, 6}}, {{0, 6}, {4, 6}}}},
+              {'3', 4, {{{0, 0}, {4, 0}}, {{4, 0}, {4, 6}}, {{4, 6}, {0, 6}}, {{1, 3}, {4, 3}}}},
+              {'4', 4, {{{0, 0}, {0, 3}}, {{0, 3}, {4, 3}}, {{4, 0}, {4, 6}}}},
+              {'5', 4, {{{4, 0}, {0, 0}}, {{0, 0}, {0, 3}}, {{0, 3}, {4, 3}}, {{4, 3}, {4, 6}}, {{4, 6}, {0, 6}}}},
+              {'6', 4, {{{4, 0}, {0, 0}}, {{0, 0}, {0, 6}}, {{0, 6}, {4, 6}}, {{4, 6}, {4, 3}}, {{4, 3}, {0, 3}}}},
+              {'7', 4, {{{0, 0}, {4, 0}}, {{4, 0}, {4, 6}}}},
+              {'8', 4, {{{0, 0}, {4, 0}}, {{4, 0}, {4, 6}}, {{4, 6}, {0, 6}}, {{0, 6}, {0, 0}}, {{0, 3}, {4, 3}}}},
+              {'9', 4, {{{4, 3}, {0, 3}}, {{0, 3}, {0, 0}}, {{0, 0}, {4, 0}}, {{4, 0}, {4, 6}}, {{4, 6}, {0, 6}}}},
+              {'.', 0, {{{0, 6}, {0, 6}}}},
+              {'d', 4, {{{4, 0}, {4, 6}}, {{4, 6}, {0, 6}}, {{0, 6}, {0, 3}}, {{0, 3}, {4, 3}}}},
+              {'f', 3, {{{1, 6}, {1, 0}}, {{1, 0}, {3, 0}}, {{0, 3}, {2.5f, 3}}}},
+              {'i', 0, {{{0, 3}, {0, 6}}, {{0, 1.2f}, {0, 1.2f}}}},
+              {'k', 3, {{{0, 0}, {0, 6}}, {{0, 4.5f}, {3, 3}}, {{1.2f, 3.9f}, {3, 6}}}},
+              {'m', 4, {{{0, 6}, {0, 3}}, {{0, 3}, {4, 3}}, {{4, 3}, {4, 6}}, {{2, 3}, {2, 6}}}},
+              {'t', 3, {{{1, 0.5f}, {1, 6}}, {{1, 6}, {3, 6}}, {{0, 3}, {3, 3}}}},
+              {'y', 3, {{{0, 3}, {0, 4.5f}}, {{0, 4.5f}, {3, 4.5f}}, {{3, 3}, {3, 6}}, {{3, 6}, {0, 6}}}},
+          };
+
+          constexpr float cGlyphStroke = 0.9f;
+        }
+
+        ClusterAtlas::ClusterAtlas(uint32_t width, uint32_t height)
+        {
+          iconSize_ = std::max<uint32_t>(16, std::min(height * 4 / 5, width * 2 / 5));
+          textHeight_ = std::max<uint32_t>(8, iconSize_ * 9 / 20);
+          smallHeight_ = std::max<uint32_t>(6, iconSize_ / 5);
+          this->rasteriseIcons();
+          this->rasteriseFont(glyphs_, textHeight_);
+          this->rasteriseFont(smallGlyphs_, smallHeight_);
+        }
+
+        ClusterAtlas::Icon ClusterAtlas::iconFor(const NavigationState &state)
+        {
+          typedef NavigationState::Maneuver Maneuver;
+          if (!state.isActive())
+          {
+            return Icon::None;
+          }
+          const bool left = state.side == NavigationState::Side::Left;
+          const bool right = state.side == NavigationState::Side::Right;
+          switch (state.maneuver)
+          {
+          case Maneuver::SlightTurn:
+            return left ? Icon::SlightLeft : right ? Icon::SlightRight : Icon::Straight;
+          case Maneuver::Turn:
+            return left ? Icon::Left : right ? Icon::Right : Icon::Straight;
+          case Maneuver::SharpTurn:
+            return left ? Icon::SharpLeft : right ? Icon::SharpRight : Icon::Straight;
+          case Maneuver::UTurn:
+            return right ? Icon::UTurnRight : Icon::UTurnLeft;
+          case Maneuver::OnRamp:
+          case Maneuver::OffRamp:
+            return left ? Icon::RampLeft : Icon::RampRight;
+          case Maneuver::Fork:
+            return left ? Icon::ForkLeft : Icon::ForkRight;
+          case Maneuver::Merge:
+            return Icon::Merge;
+          case Maneuver::RoundaboutEnter:
+          case Maneuver::RoundaboutExit:
+          case Maneuver::RoundaboutEnterAndExit:
+            // The side is the direction of travel: clockwise where traffic
+            // keeps left
+            return left ? Icon::RoundaboutLeft : Icon::RoundaboutRight;
+          case Maneuver::FerryBoat:
+          case Maneuver::FerryTrain:
+            return Icon::Ferry;
+          case Maneuver::Destination:
+            return Icon::Destination;
+          default:
+            return state.maneuver == Maneuver::Unknown && state.distanceMeters < 0 ? Icon::None : Icon::Straight;
+          }
+        }
+
+        const ClusterAtlas::Image &ClusterAtlas::icon(Icon icon) const
+        {
+          return icons_[static_cast<size_t>(icon)];
+        }
+
+        const ClusterAtlas::Image *ClusterAtlas::glyph(char c, bool small) const
+        {
+          const char *found = c != '\0' ? std::strchr(cCharacters, c) : nullptr;
+          if (!found)
+          {
+            return nullptr;
+          }
+          return &(small ? smallGlyphs_ : glyphs_)[static_cast<size_t>(found - cCharacters)];
+        }
+
+        uint32_t ClusterAtlas::textWidth(const std::string &text, bool small) const
+        {
+          const uint32_t gap = this->textHeight(small) / 6;
+          uint32_t width = 0;
+          for (char c : text)
+          {
+            if (const Image *image = this->glyph(c, small))
+            {
+              width += (width ? gap : 0) + image->width;
+            }
+          }
+          return width;
+        }
+
+        void ClusterAtlas::blit(const Image &image, uint32_t colour, uint32_t *pixels, uint32_t pitch, uint32_t width,
+                                uint32_t height, int x, int y)
+        {
+          const uint32_t alpha = colour >> 24;
+          for (uint32_t row = 0; row < image.height; row++)
+          {
+            const int64_t outY = static_cast<int64_t>(y) + row;
+            if (outY < 0 || outY >= height)
+            {
+              continue;
+            }
+            for (uint32_t column = 0; column < image.width; column++)
+            {
+              const int64_t outX = static_cast<int64_t>(x) + column;
+              const uint32_t coverage = image.coverage[row * image.width + column];
+              if (outX < 0 || outX >= width || coverage == 0)
+              {
+                continue;
+              }
+              // Source over destination, both premultiplied
+              const uint32_t a = alpha * coverage / 255;
+              uint32_t &out = pixels[static_cast<size_t>(outY) * pitch + static_cast<size_t>(outX)];
+              uint32_t result = 0;
+              for (int shift = 0; shift < 32; shift += 8)
+              {
+                const uint32_t source = shift == 24 ? a : ((colour >> shift) & 0xff) * a / 255;
+                const uint32_t destination = (out >> shift) & 0xff;
+                result |= std::min<uint32_t>(255, source + destination * (255 - a) / 255) << shift;
+              }
+              out = result;
+            }
+          }
+        }
+
+        int ClusterAtlas::drawText(const std::string &text, bool small, uint32_t colour, uint32_t *pixels,
+                                   uint32_t pitch, uint32_t width, uint32_t height, int x, int y) const
+        {
+          const int gap = static_cast<int>(this->textHeight(small) / 6);
+          bool first = true;
+          for (char c : text)
+          {
+            if (const Image *image = this->glyph(c, small))
+            {
+              x += first ? 0 : gap;
+              blit(*image, colour, pixels, pitch, width, height, x, y);
+              x += static_cast<int>(image->width);
+              first = false;
+            }
+          }
+          return x;
+        }
+
+        void ClusterAtlas::rasteriseIcons()
+        {
+          for (size_t i = 1; i < icons_.size(); i++)
+          {
+            Image &image = icons_[i];
+            image.width = iconSize_;
+            image.height = iconSize_;
+            image.coverage.assign(static_cast<size_t>(iconSize_) * iconSize_, 0);
+            Canvas canvas(image, static_cast<float>(iconSize_), 0, isMirrored(static_cast<Icon>(i)));
+            drawIcon(canvas, static_cast<Icon>(i));
+          }
+        }
+
+        void ClusterAtlas::rasteriseFont(std::array<Image, cCharacterCount> &glyphs, uint32_t height)
+        {
+          // Grid units to pixels, leaving half a stroke around the glyph
+          const float scale = height / (6 + cGlyphStroke);
+          const float margin = cGlyphStroke / 2 * scale;
+          for (const GlyphShape &shape : cGlyphShapes)
+          {
+            Image &image = glyphs[static_cast<size_t>(std::strchr(cCharacters, shape.character) - cCharacters)];
+            image.width = static_cast<uint32_t>(std::ceil((shape.width + cGlyphStroke) * scale));
+            image.height = height;
+            image.coverage.assign(static_cast<size_t>(image.width) * image.height, 0);
+            Canvas canvas(image, scale, margin, false);
+            for (const auto &segment : shape.strokes)
+            {
+              stroke(canvas, segment.first, segment.second, cGlyphStroke);
+            }
+          }
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
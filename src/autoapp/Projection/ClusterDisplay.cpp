@@ -0,0 +1,587 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/Projection/ClusterDisplay.hpp>
+#include <f1x/openauto/autoapp/Projection/ClusterAtlas.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+#include <algorithm>
+
+#ifdef USE_FFMPEG_DRM
+#include <drm_fourcc.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <f1x/openauto/autoapp/StateBus.hpp>
+#include <f1x/openauto/autoapp/Projection/CmaBudget.hpp>
+#include <f1x/openauto/autoapp/Projection/DrmDevice.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
+#endif
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          constexpr uint32_t cTextColour = 0xffffffff;
+          constexpr uint32_t cUnitColour = 0xffb0b0b0;
+          constexpr uint32_t cExitColour = 0xff4fc3f7;
+
+          bool isRoundabout(ClusterAtlas::Icon icon)
+          {
+            return icon == ClusterAtlas::Icon::RoundaboutLeft || icon == ClusterAtlas::Icon::RoundaboutRight;
+          }
+
+#ifdef USE_FFMPEG_DRM
+          // The camera takes its planes down when reverse is released; showing
+          // the overlay again before that would lose it
+          constexpr int64_t cReverseSettleUs = 500000;
+
+          // What render() would draw, to skip redraws that change nothing
+          std::string renderKey(const NavigationState &state)
+          {
+            const ClusterAtlas::Icon icon = ClusterAtlas::iconFor(state);
+            std::string key = std::to_string(static_cast<int>(icon));
+            if (icon != ClusterAtlas::Icon::None)
+            {
+              key += ';' + state.displayDistance() + state.displayUnitName();
+              if (isRoundabout(icon))
+              {
+                key += ';' + std::to_string(state.roundaboutExit);
+              }
+            }
+            return key;
+          }
+#endif
+        }
+
+        ClusterDisplay::ClusterDisplay(configuration::IConfiguration::Pointer configuration)
+            : configuration_(std::move(configuration)), stopping_(false), wakeFd_(-1), navigationSubscription_(0),
+              reverseSubscription_(0), drmFd_(-1), overlay_(false), connectorId_(0), crtcId_(0), planeId_(0),
+              width_(0), height_(0), x_(0), y_(0), visible_(false), front_(0)
+        {
+        }
+
+        void ClusterDisplay::render(const ClusterAtlas &atlas, const NavigationState &state, uint32_t *pixels,
+                                    uint32_t pitch, uint32_t width, uint32_t height, bool opaque)
+        {
+          // Premultiplied black, translucent over the main display
+          const uint32_t background = opaque ? 0xff000000 : 0xb0000000;
+          for (uint32_t y = 0; y < height; y++)
+          {
+            std::fill(pixels + static_cast<size_t>(y) * pitch, pixels + static_cast<size_t>(y) * pitch + width,
+                      background);
+          }
+
+          const ClusterAtlas::Icon icon = ClusterAtlas::iconFor(state);
+          if (icon == ClusterAtlas::Icon::None)
+          {
+            return;
+          }
+
+          const int size = static_cast<int>(atlas.iconSize());
+          const int margin = std::max(0, (static_cast<int>(height) - size) / 2);
+          ClusterAtlas::blit(atlas.icon(icon), cTextColour, pixels, pitch, width, height, margin, margin);
+
+          if (isRoundabout(icon) && state.roundaboutExit > 0)
+          {
+            const std::string exit = std::to_string(state.roundaboutExit);
+            atlas.drawText(exit, true, cExitColour, pixels, pitch, width, height,
+                           margin + (size - static_cast<int>(atlas.textWidth(exit, true))) / 2,
+                           margin + (size - static_cast<int>(atlas.textHeight(true))) / 2);
+          }
+
+          const std::string distance = state.displayDistance();
+          if (!distance.empty())
+          {
+            const int textY = (static_cast<int>(height) - static_cast<int>(atlas.textHeight())) / 2;
+            int x = atlas.drawText(distance, false, cTextColour, pixels, pitch, width, height,
+                                   margin * 2 + size, textY);
+            x += static_cast<int>(atlas.textHeight()) / 3;
+            atlas.drawText(state.displayUnitName(), false, cUnitColour, pixels, pitch, width, height, x, textY);
+          }
+        }
+
+#ifndef USE_FFMPEG_DRM
+
+        ClusterDisplay::~ClusterDisplay() = default;
+
+        bool ClusterDisplay::start()
+        {
+          if (!configuration_->getClusterOutput().empty())
+          {
+            OPENAUTO_LOG(warning) << "[ClusterDisplay] Needs a build with USE_FFMPEG_DRM, cluster disabled";
+          }
+          return false;
+        }
+
+#else
+
+        ClusterDisplay::~ClusterDisplay()
+        {
+          auto &stateBus = StateBus::instance();
+          if (navigationSubscription_ != 0)
+          {
+            stateBus.unsubscribe(navigationSubscription_);
+          }
+          if (reverseSubscription_ != 0)
+          {
+            stateBus.unsubscribe(reverseSubscription_);
+          }
+          if (thread_.joinable())
+          {
+            stopping_ = true;
+            this->wake();
+            thread_.join();
+          }
+          if (drmFd_ >= 0)
+          {
+            // Removing the framebuffers also turns off a cluster CRTC
+            this->hide();
+            this->destroyBuffers();
+            close(drmFd_);
+          }
+          if (wakeFd_ >= 0)
+          {
+            close(wakeFd_);
+          }
+        }
+
+        bool ClusterDisplay::start()
+        {
+          if (thread_.joinable())
+          {
+            return true;
+          }
+          if (configuration_->getClusterOutput().empty() || !this->openOutput())
+          {
+            return false;
+          }
+
+          wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+          if (wakeFd_ < 0)
+          {
+            OPENAUTO_LOG(error) << "[ClusterDisplay] eventfd failed: " << strerror(errno);
+            return false;
+          }
+          atlas_.reset(new ClusterAtlas(width_, height_));
+
+          // Handlers run on the bus thread: they only wake the cluster thread,
+          // which reads the state itself
+          auto &stateBus = StateBus::instance();
+          navigationSubscription_ =
+              stateBus.subscribe(StateFlag::Navigation, [this](StateFlag, bool) { this->wake(); });
+          if (overlay_)
+          {
+            reverseSubscription_ =
+                stateBus.subscribe(StateFlag::ReverseGear, [this](StateFlag, bool) { this->wake(); });
+          }
+
+          thread_ = std::thread(&ClusterDisplay::run, this);
+          return true;
+        }
+
+        void ClusterDisplay::wake()
+        {
+          if (wakeFd_ >= 0)
+          {
+            const uint64_t one = 1;
+            if (::write(wakeFd_, &one, sizeof(one)) < 0)
+            {
+              // Already signalled
+            }
+          }
+        }
+
+        bool ClusterDisplay::openOutput()
+        {
+          drmFd_ = drmdevice::openShared();
+          if (drmFd_ < 0)
+          {
+            OPENAUTO_LOG(error) << "[ClusterDisplay] Failed to open /dev/dri/card0: " << strerror(errno);
+            return false;
+          }
+
+          const std::string output = configuration_->getClusterOutput();
+          overlay_ = output == "overlay";
+          if (!(overlay_ ? this->openOverlay() : this->openConnector(output)))
+          {
+            this->destroyBuffers();
+            close(drmFd_);
+            drmFd_ = -1;
+            return false;
+          }
+          OPENAUTO_LOG(info) << "[ClusterDisplay] " << width_ << "x" << height_ << " on "
+                             << (overlay_ ? std::string("an overlay plane") : output);
+          return true;
+        }
+
+        bool ClusterDisplay::openConnector(const std::string &name)
+        {
+          drmModeRes *resources = drmModeGetResources(drmFd_);
+          if (!resources)
+          {
+            OPENAUTO_LOG(error) << "[ClusterDisplay] Failed to get DRM resources";
+            return false;
+          }
+
+          drmModeConnector *connector = nullptr;
+          for (int i = 0; i < resources->count_connectors && !connector; i++)
+          {
+            connector = drmModeGetConnector(drmFd_, resources->connectors[i]);
+            if (connector && drmdevice::connectorName(connector) != name)
+            {
+              drmModeFreeConnector(connector);
+              connector = nullptr;
+            }
+          }
+          if (!connector || connector->connection != DRM_MODE_CONNECTED || connector->count_modes == 0)
+          {
+            OPENAUTO_LOG(error) << "[ClusterDisplay] Connector " << name << " is not connected";
+            drmModeFreeConnector(connector);
+            drmModeFreeResources(resources);
+            return false;
+          }
+          connectorId_ = connector->connector_id;
+
+          drmModeModeInfo mode = connector->modes[0];
+          for (int i = 0; i < connector->count_modes; i++)
+          {
+            if (connector->modes[i].type & DRM_MODE_TYPE_PREFERRED)
+            {
+              mode = connector->modes[i];
+              break;
+            }
+          }
+
+          // A CRTC the connector can reach that nothing scans out from, or
+          // the one already driving it
+          uint32_t currentCrtc = 0;
+          if (drmModeEncoder *encoder = connector->encoder_id ? drmModeGetEncoder(drmFd_, connector->encoder_id) : nullptr)
+          {
+            currentCrtc = encoder->crtc_id;
+            drmModeFreeEncoder(encoder);
+          }
+          for (int e = 0; e < connector->count_encoders && crtcId_ == 0; e++)
+          {
+            drmModeEncoder *encoder = drmModeGetEncoder(drmFd_, connector->encoders[e]);
+            for (int i = 0; encoder && i < resources->count_crtcs && crtcId_ == 0; i++)
+            {
+              if (!(encoder->possible_crtcs & (1u << i)))
+              {
+                continue;
+              }
+              drmModeCrtc *crtc = drmModeGetCrtc(drmFd_, resources->crtcs[i]);
+              if (crtc && (crtc->buffer_id == 0 || crtc->crtc_id == currentCrtc))
+              {
+                crtcId_ = crtc->crtc_id;
+              }
+              drmModeFreeCrtc(crtc);
+            }
+            drmModeFreeEncoder(encoder);
+          }
+          drmModeFreeConnector(connector);
+          drmModeFreeResources(resources);
+          if (crtcId_ == 0)
+          {
+            OPENAUTO_LOG(error) << "[ClusterDisplay] No free CRTC for " << name;
+            return false;
+          }
+
+          width_ = mode.hdisplay;
+          height_ = mode.vdisplay;
+          if (!this->createBuffers())
+          {
+            return false;
+          }
+          // Fresh dumb buffers are black, so the modeset shows nothing yet
+          if (drmModeSetCrtc(drmFd_, crtcId_, buffers_[0].fbId, 0, 0, &connectorId_, 1, &mode) != 0)
+          {
+            OPENAUTO_LOG(error) << "[ClusterDisplay] Modeset on " << name << " failed: " << strerror(errno);
+            return false;
+          }
+          visible_ = true;
+
+          // Later frames go to the CRTC's primary plane, which needs no mode
+          const uint32_t crtcMask = drmdevice::crtcMask(drmFd_, crtcId_);
+          drmModePlaneResPtr planeRes = drmModeGetPlaneResources(drmFd_);
+          for (uint32_t i = 0; planeRes && i < planeRes->count_planes && planeId_ == 0; i++)
+          {
+            drmModePlanePtr plane = drmModeGetPlane(drmFd_, planeRes->planes[i]);
+            if (plane && (plane->possible_crtcs & crtcMask) &&
+                drmdevice::planeType(drmFd_, plane->plane_id) == DRM_PLANE_TYPE_PRIMARY)
+            {
+              planeId_ = plane->plane_id;
+            }
+            drmModeFreePlane(plane);
+          }
+          drmModeFreePlaneResources(planeRes);
+          if (planeId_ == 0)
+          {
+            OPENAUTO_LOG(error) << "[ClusterDisplay] No primary plane on " << name;
+            return false;
+          }
+          return true;
+        }
+
+        bool ClusterDisplay::openOverlay()
+        {
+          drmModeRes *resources = drmModeGetResources(drmFd_);
+          if (!resources)
+          {
+            OPENAUTO_LOG(error) << "[ClusterDisplay] Failed to get DRM resources";
+            return false;
+          }
+          for (int i = 0; i < resources->count_connectors && crtcId_ == 0; i++)
+          {
+            drmModeConnector *connector = drmModeGetConnector(drmFd_, resources->connectors[i]);
+            if (connector && connector->connection == DRM_MODE_CONNECTED && connector->encoder_id)
+            {
+              if (drmModeEncoder *encoder = drmModeGetEncoder(drmFd_, connector->encoder_id))
+              {
+                crtcId_ = encoder->crtc_id;
+                drmModeFreeEncoder(encoder);
+              }
+            }
+            drmModeFreeConnector(connector);
+          }
+          drmModeFreeResources(resources);
+
+          drmModeCrtc *crtc = crtcId_ ? drmModeGetCrtc(drmFd_, crtcId_) : nullptr;
+          if (!crtc || !crtc->mode_valid)
+          {
+            OPENAUTO_LOG(error) << "[ClusterDisplay] No active display";
+            drmModeFreeCrtc(crtc);
+            return false;
+          }
+          const uint32_t displayWidth = crtc->mode.hdisplay;
+          const uint32_t displayHeight = crtc->mode.vdisplay;
+          drmModeFreeCrtc(crtc);
+
+          // A third of the width in the top right corner, clear of the
+          // Android Auto status bar on the left
+          width_ = (displayWidth / 3) & ~1u;
+          height_ = std::max<uint32_t>(48, width_ * 3 / 10) & ~1u;
+          const uint32_t margin = displayHeight / 40;
+          x_ = displayWidth - width_ - margin;
+          y_ = margin;
+
+          // From the end, like the camera: the video output takes the first
+          const uint32_t crtcMask = drmdevice::crtcMask(drmFd_, crtcId_);
+          drmModePlaneResPtr planeRes = drmModeGetPlaneResources(drmFd_);
+          for (uint32_t i = planeRes ? planeRes->count_planes : 0; i > 0 && planeId_ == 0; i--)
+          {
+            drmModePlanePtr plane = drmModeGetPlane(drmFd_, planeRes->planes[i - 1]);
+            if (plane && (plane->possible_crtcs & crtcMask) &&
+                drmdevice::planeType(drmFd_, plane->plane_id) == DRM_PLANE_TYPE_OVERLAY &&
+                drmdevice::planeSupports(plane, DRM_FORMAT_ARGB8888))
+            {
+              planeId_ = plane->plane_id;
+            }
+            drmModeFreePlane(plane);
+          }
+          drmModeFreePlaneResources(planeRes);
+          if (planeId_ == 0)
+          {
+            OPENAUTO_LOG(error) << "[ClusterDisplay] No ARGB8888 overlay plane";
+            return false;
+          }
+          return this->createBuffers();
+        }
+
+        bool ClusterDisplay::createBuffers()
+        {
+          const uint32_t format = overlay_ ? DRM_FORMAT_ARGB8888 : DRM_FORMAT_XRGB8888;
+          for (DumbImage &image : buffers_)
+          {
+            struct drm_mode_create_dumb create = {};
+            create.width = width_;
+            create.height = height_;
+            create.bpp = 32;
+            if (ioctl(drmFd_, DRM_IOCTL_MODE_CREATE_DUMB, &create) < 0)
+            {
+              OPENAUTO_LOG(error) << "[ClusterDisplay] Failed to allocate " << width_ << "x" << height_
+                                  << " buffer: " << strerror(errno);
+              return false;
+            }
+            image.handle = create.handle;
+            image.pitch = create.pitch;
+            image.size = create.size;
+            CmaBudget::instance().add(CmaPool::Cluster, static_cast<int64_t>(create.size));
+
+            // Mapped for good: every redraw writes straight into the back buffer
+            struct drm_mode_map_dumb map = {};
+            map.handle = create.handle;
+            void *pixels = ioctl(drmFd_, DRM_IOCTL_MODE_MAP_DUMB, &map) < 0
+                               ? MAP_FAILED
+                               : mmap(nullptr, create.size, PROT_READ | PROT_WRITE, MAP_SHARED, drmFd_, map.offset);
+            uint32_t handles[4] = {create.handle, 0, 0, 0};
+            uint32_t pitches[4] = {create.pitch, 0, 0, 0};
+            uint32_t offsets[4] = {0, 0, 0, 0};
+            if (pixels == MAP_FAILED ||
+                drmModeAddFB2(drmFd_, width_, height_, format, handles, pitches, offsets, &image.fbId, 0) != 0)
+            {
+              OPENAUTO_LOG(error) << "[ClusterDisplay] Failed to set up a framebuffer: " << strerror(errno);
+              if (pixels != MAP_FAILED)
+              {
+                munmap(pixels, create.size);
+              }
+              return false;
+            }
+            image.pixels = static_cast<uint32_t *>(pixels);
+          }
+          return true;
+        }
+
+        void ClusterDisplay::destroyBuffers()
+        {
+          for (DumbImage &image : buffers_)
+          {
+            if (image.pixels)
+            {
+              munmap(image.pixels, image.size);
+            }
+            if (image.fbId)
+            {
+              drmModeRmFB(drmFd_, image.fbId);
+            }
+            if (image.handle)
+            {
+              struct drm_mode_destroy_dumb destroy = {};
+              destroy.handle = image.handle;
+              ioctl(drmFd_, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+              CmaBudget::instance().release(CmaPool::Cluster, static_cast<int64_t>(image.size));
+            }
+            image = DumbImage();
+          }
+        }
+
+        bool ClusterDisplay::present(const NavigationState &state)
+        {
+          const std::string key = renderKey(state);
+          if (visible_ && key == drawn_)
+          {
+            return true;
+          }
+
+          // The front buffer may still be scanned out; SetPlane returns once
+          // the back one is latched, so the next redraw can reuse the old front
+          DumbImage &back = buffers_[front_ ^ 1];
+          render(*atlas_, state, back.pixels, back.pitch / 4, width_, height_, !overlay_);
+          if (drmModeSetPlane(drmFd_, planeId_, crtcId_, back.fbId, 0, static_cast<int32_t>(x_),
+                              static_cast<int32_t>(y_), width_, height_, 0, 0, width_ << 16, height_ << 16) != 0)
+          {
+            OPENAUTO_LOG_EVERY_MS(warning, 10000) << "[ClusterDisplay] SetPlane failed: " << strerror(errno);
+            return false;
+          }
+          front_ ^= 1;
+          drawn_ = key;
+          visible_ = true;
+          return true;
+        }
+
+        void ClusterDisplay::hide()
+        {
+          if (!visible_ || !overlay_)
+          {
+            return;
+          }
+          // Only while the plane still shows the panel: the camera may have
+          // taken it for reverse already
+          drmModePlanePtr plane = drmModeGetPlane(drmFd_, planeId_);
+          if (plane && (plane->fb_id == buffers_[0].fbId || plane->fb_id == buffers_[1].fbId))
+          {
+            drmModeSetPlane(drmFd_, planeId_, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+          }
+          drmModeFreePlane(plane);
+          visible_ = false;
+          drawn_.clear();
+        }
+
+        void ClusterDisplay::run()
+        {
+          ThreadTopology::instance().apply(ThreadRole::VideoPresent, "oa-cluster");
+          auto &stateBus = StateBus::instance();
+          bool reversing = false;
+          int64_t showAtUs = 0;
+
+          while (!stopping_.load())
+          {
+            NavigationState state;
+            if (!NavigationState::parse(stateBus.value(StateFlag::Navigation), state))
+            {
+              state = NavigationState();
+            }
+            const bool reverse = overlay_ && stateBus.isSet(StateFlag::ReverseGear);
+            if (reversing && !reverse)
+            {
+              showAtUs = VideoTelemetry::nowUs() + cReverseSettleUs;
+            }
+            reversing = reverse;
+
+            int timeoutMs = -1;
+            const int64_t waitUs = showAtUs - VideoTelemetry::nowUs();
+            if (overlay_ && (reversing || !state.isActive()))
+            {
+              this->hide();
+            }
+            else if (waitUs > 0)
+            {
+              timeoutMs = static_cast<int>(waitUs / 1000) + 1;
+            }
+            else
+            {
+              this->present(state);
+            }
+
+            struct pollfd fds[1] = {{wakeFd_, POLLIN, 0}};
+            if (poll(fds, 1, timeoutMs) < 0 && errno != EINTR)
+            {
+              break;
+            }
+            if (fds[0].revents & POLLIN)
+            {
+              uint64_t count;
+              if (::read(wakeFd_, &count, sizeof(count)) < 0)
+              {
+                // Spurious wakeup
+              }
+            }
+          }
+        }
+
+#endif
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,187 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/autoapp/Projection/CmaBudget.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          std::string megabytes(int64_t bytes)
+          {
+            std::ostringstream out;
+            out.setf(std::ios::fixed);
+            out.precision(1);
+            out << bytes / (1024.0 * 1024.0) << " MB";
+            return out.str();
+          }
+        }
+
+        CmaBudget &CmaBudget::instance()
+        {
+          static CmaBudget budget;
+          return budget;
+        }
+
+        CmaMeminfo CmaBudget::parseMeminfo(std::istream &in)
+        {
+          CmaMeminfo info;
+          std::string key;
+          int64_t value = 0;
+          std::string line;
+          while (std::getline(in, line))
+          {
+            std::istringstream fields(line);
+            if (!(fields >> key >> value))
+            {
+              continue;
+            }
+            // Values are in kB
+            if (key == "CmaTotal:")
+            {
+              info.totalBytes = value * 1024;
+            }
+            else if (key == "CmaFree:")
+            {
+              info.freeBytes = value * 1024;
+            }
+          }
+          return info;
+        }
+
+        int64_t CmaBudget::frameBytes(int width, int height)
+        {
+          const int64_t stride = (static_cast<int64_t>(std::max(width, 0)) + 63) & ~63;
+          const int64_t rows = (static_cast<int64_t>(std::max(height, 0)) + 15) & ~15;
+          return stride * rows * 3 / 2;
+        }
+
+        int64_t CmaBudget::hardwareBytes(int width, int height, size_t frameQueueDepth)
+        {
+          // Same frame count as extra_hw_frames: queued + on screen + retiring
+          const int64_t frames = cDecoderSurfaces + static_cast<int64_t>(frameQueueDepth) + 2;
+          return frames * frameBytes(width, height);
+        }
+
+        CmaPlan CmaBudget::plan(int64_t freeBytes, int width, int height, size_t requestedDepth)
+        {
+          CmaPlan result;
+          result.frameQueueDepth = std::max<size_t>(requestedDepth, 1);
+          if (freeBytes < 0)
+          {
+            return result;
+          }
+
+          const auto usable = static_cast<int64_t>(freeBytes * (1.0 - cReserveShare));
+          while (result.frameQueueDepth > 1 &&
+                 hardwareBytes(width, height, result.frameQueueDepth) > usable)
+          {
+            result.frameQueueDepth--;
+          }
+          result.hardwareFits = hardwareBytes(width, height, result.frameQueueDepth) <= usable;
+          return result;
+        }
+
+        CmaMeminfo CmaBudget::refresh()
+        {
+          std::ifstream meminfo("/proc/meminfo");
+          CmaMeminfo info = meminfo ? parseMeminfo(meminfo) : CmaMeminfo();
+
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          meminfo_ = info;
+          return info;
+        }
+
+        CmaMeminfo CmaBudget::lastMeminfo() const
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          return meminfo_;
+        }
+
+        CmaPlan CmaBudget::planFor(int width, int height, size_t requestedDepth) const
+        {
+          return plan(lastMeminfo().freeBytes, width, height, requestedDepth);
+        }
+
+        bool CmaBudget::fits(int width, int height) const
+        {
+          return planFor(width, height, 1).hardwareFits;
+        }
+
+        void CmaBudget::add(CmaPool pool, int64_t bytes)
+        {
+          allocated_[static_cast<size_t>(pool)].fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        void CmaBudget::release(CmaPool pool, int64_t bytes)
+        {
+          allocated_[static_cast<size_t>(pool)].fetch_sub(bytes, std::memory_order_relaxed);
+        }
+
+        int64_t CmaBudget::allocatedBytes(CmaPool pool) const
+        {
+          return allocated_[static_cast<size_t>(pool)].load(std::memory_order_relaxed);
+        }
+
+        int64_t CmaBudget::allocatedBytes() const
+        {
+          int64_t total = 0;
+          for (const auto &pool : allocated_)
+          {
+            total += pool.load(std::memory_order_relaxed);
+          }
+          return total;
+        }
+
+        std::string CmaBudget::summary() const
+        {
+          const CmaMeminfo info = lastMeminfo();
+
+          std::ostringstream out;
+          if (info.valid())
+          {
+            out << "CMA free " << megabytes(info.freeBytes) << " of "
+                << megabytes(info.totalBytes);
+          }
+          else
+          {
+            out << "CMA size unknown";
+          }
+          out << ", held: dumb " << megabytes(allocatedBytes(CmaPool::DumbBuffer))
+              << ", cursor " << megabytes(allocatedBytes(CmaPool::Cursor)) << ", imported "
+              << megabytes(allocatedBytes(CmaPool::PrimeImport)) << ", camera "
+              << megabytes(allocatedBytes(CmaPool::Camera)) << ", cluster "
+              << megabytes(allocatedBytes(CmaPool::Cluster));
+          return out.str();
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
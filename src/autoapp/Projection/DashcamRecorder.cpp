@@ -0,0 +1,653 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Projection/DashcamRecorder.hpp>
+
+#ifdef USE_FFMPEG_DRM
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/StateBus.hpp>
+#include <f1x/openauto/autoapp/Projection/Mp4SegmentWriter.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+#endif
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+#ifdef USE_FFMPEG_DRM
+
+        namespace
+        {
+          struct RecorderMetrics
+          {
+            MetricCounter &frames = Metrics::instance().counter(
+                "openauto_dashcam_frames_total", "Camera frames encoded into the dashcam recording");
+            MetricCounter &droppedFrames = Metrics::instance().counter(
+                "openauto_dashcam_dropped_frames_total", "Camera frames not recorded, the encoder being behind");
+            MetricCounter &segments = Metrics::instance().counter(
+                "openauto_dashcam_segments_total", "Dashcam segment files started");
+            MetricCounter &writeErrors = Metrics::instance().counter(
+                "openauto_dashcam_write_errors_total", "Dashcam segments abandoned on a write error");
+          };
+
+          RecorderMetrics &metrics()
+          {
+            static RecorderMetrics instance;
+            return instance;
+          }
+
+          int xioctl(int fd, unsigned long request, void *arg)
+          {
+            int ret;
+            do
+            {
+              ret = ioctl(fd, request, arg);
+            } while (ret < 0 && errno == EINTR);
+            return ret;
+          }
+
+          bool offersFormat(int fd, uint32_t type, uint32_t pixelFormat)
+          {
+            struct v4l2_fmtdesc desc = {};
+            desc.type = type;
+            for (desc.index = 0; xioctl(fd, VIDIOC_ENUM_FMT, &desc) == 0; desc.index++)
+            {
+              if (desc.pixelformat == pixelFormat)
+              {
+                return true;
+              }
+            }
+            return false;
+          }
+
+          void setControl(int fd, uint32_t id, int32_t value, const char *name)
+          {
+            struct v4l2_control control = {};
+            control.id = id;
+            control.value = value;
+            if (xioctl(fd, VIDIOC_S_CTRL, &control) < 0)
+            {
+              OPENAUTO_LOG(debug) << "[DashcamRecorder] Encoder ignores " << name << ": " << strerror(errno);
+            }
+          }
+
+          // Bitrate headroom: the encoder overshoots on busy scenes
+          uint64_t segmentEstimate(uint32_t bitrateKbps, uint32_t seconds)
+          {
+            return static_cast<uint64_t>(bitrateKbps) * 1000 / 8 * seconds * 5 / 4;
+          }
+        }
+
+        DashcamRecorder::DashcamRecorder(configuration::IConfiguration::Pointer configuration)
+            : configuration_(std::move(configuration)),
+              segments_(configuration_->getDashcamDirectory(),
+                        static_cast<uint64_t>(configuration_->getDashcamMaxDiskMb()) * 1024 * 1024),
+              stopping_(false), wakeFd_(-1), encoderFd_(-1), outputType_(0), captureType_(0), frameBytes_(0),
+              width_(0), height_(0), heldCount_(0), maxHeld_(0), segmentBytes_(0)
+        {
+        }
+
+        DashcamRecorder::~DashcamRecorder()
+        {
+          this->detach();
+        }
+
+        bool DashcamRecorder::attach(const CaptureFormat &format, size_t maxHeld, ReleaseHandler release)
+        {
+          this->detach();
+          if (!segments_.prepare() || !this->openEncoder(format))
+          {
+            return false;
+          }
+
+          release_ = std::move(release);
+          fds_ = format.fds;
+          sizes_ = format.sizes;
+          held_.assign(fds_.size(), false);
+          heldCount_ = 0;
+          maxHeld_ = maxHeld;
+          segmentBytes_ = segmentEstimate(configuration_->getDashcamBitrateKbps(),
+                                          std::max(configuration_->getDashcamSegmentSeconds(), 1u));
+          metrics();
+
+          wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+          stopping_ = false;
+          thread_ = std::thread(&DashcamRecorder::run, this);
+          return true;
+        }
+
+        void DashcamRecorder::detach()
+        {
+          if (thread_.joinable())
+          {
+            stopping_ = true;
+            const uint64_t one = 1;
+            if (::write(wakeFd_, &one, sizeof(one)) < 0)
+            {
+              // The thread is leaving anyway
+            }
+            thread_.join();
+          }
+          if (wakeFd_ >= 0)
+          {
+            close(wakeFd_);
+            wakeFd_ = -1;
+          }
+          if (encoderFd_ >= 0)
+          {
+            this->closeEncoder();
+            this->releaseHeld();
+          }
+        }
+
+        bool DashcamRecorder::openEncoder(const CaptureFormat &format)
+        {
+          // The camera is a /dev/video node too: tell it apart by device number
+          struct stat camera = {};
+          stat(configuration_->getRearCameraDevice().c_str(), &camera);
+
+          for (int i = 0; i < 64; i++)
+          {
+            const std::string device = "/dev/video" + std::to_string(i);
+            struct stat info;
+            if (stat(device.c_str(), &info) != 0)
+            {
+              continue;
+            }
+            if (info.st_rdev == camera.st_rdev)
+            {
+              continue;
+            }
+            if (this->tryEncoder(device, format))
+            {
+              return true;
+            }
+          }
+          OPENAUTO_LOG(error) << "[DashcamRecorder] No V4L2 H.264 encoder takes "
+                              << std::string(reinterpret_cast<const char *>(&format.pixelFormat), 4) << " "
+                              << format.width << "x" << format.height
+                              << " DMA-BUFs; software encoding is not attempted, recording disabled";
+          return false;
+        }
+
+        bool DashcamRecorder::tryEncoder(const std::string &device, const CaptureFormat &format)
+        {
+          encoderFd_ = ::open(device.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+          if (encoderFd_ < 0)
+          {
+            return false;
+          }
+
+          struct v4l2_capability cap = {};
+          const uint32_t caps = xioctl(encoderFd_, VIDIOC_QUERYCAP, &cap) < 0 ? 0
+                                : (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps
+                                                                            : cap.capabilities;
+          if (caps & V4L2_CAP_VIDEO_M2M_MPLANE)
+          {
+            outputType_ = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+            captureType_ = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+          }
+          else if (caps & V4L2_CAP_VIDEO_M2M)
+          {
+            outputType_ = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+            captureType_ = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+          }
+
+          // Decoders are mem2mem as well: H.264 has to come out, the camera
+          // format go in
+          if (outputType_ == 0 || !offersFormat(encoderFd_, captureType_, V4L2_PIX_FMT_H264) ||
+              !offersFormat(encoderFd_, outputType_, format.pixelFormat))
+          {
+            close(encoderFd_);
+            encoderFd_ = -1;
+            outputType_ = 0;
+            captureType_ = 0;
+            return false;
+          }
+
+          if (!this->configureEncoder(format))
+          {
+            this->closeEncoder();
+            return false;
+          }
+          OPENAUTO_LOG(info) << "[DashcamRecorder] Encoding on " << device << " (" << cap.card << "), "
+                             << width_ << "x" << height_ << " at " << format.fps << " fps, "
+                             << configuration_->getDashcamBitrateKbps() << " kbps";
+          return true;
+        }
+
+        bool DashcamRecorder::configureEncoder(const CaptureFormat &format)
+        {
+          const bool mplane = outputType_ == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+          width_ = format.width;
+          height_ = format.height;
+
+          // Coded format first, as the stateful encoder interface wants
+          struct v4l2_format coded = {};
+          coded.type = captureType_;
+          if (mplane)
+          {
+            coded.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_H264;
+            coded.fmt.pix_mp.width = width_;
+            coded.fmt.pix_mp.height = height_;
+            coded.fmt.pix_mp.num_planes = 1;
+            coded.fmt.pix_mp.plane_fmt[0].sizeimage = width_ * height_;
+          }
+          else
+          {
+            coded.fmt.pix.pixelformat = V4L2_PIX_FMT_H264;
+            coded.fmt.pix.width = width_;
+            coded.fmt.pix.height = height_;
+            coded.fmt.pix.sizeimage = width_ * height_;
+          }
+          if (xioctl(encoderFd_, VIDIOC_S_FMT, &coded) < 0)
+          {
+            return false;
+          }
+
+          struct v4l2_format raw = {};
+          raw.type = outputType_;
+          uint32_t pitch = 0;
+          if (mplane)
+          {
+            raw.fmt.pix_mp.pixelformat = format.pixelFormat;
+            raw.fmt.pix_mp.width = width_;
+            raw.fmt.pix_mp.height = height_;
+            raw.fmt.pix_mp.num_planes = 1;
+            raw.fmt.pix_mp.plane_fmt[0].bytesperline = format.bytesPerLine;
+            if (xioctl(encoderFd_, VIDIOC_S_FMT, &raw) < 0 || raw.fmt.pix_mp.num_planes != 1)
+            {
+              return false;
+            }
+            pitch = raw.fmt.pix_mp.plane_fmt[0].bytesperline;
+            frameBytes_ = raw.fmt.pix_mp.plane_fmt[0].sizeimage;
+          }
+          else
+          {
+            raw.fmt.pix.pixelformat = format.pixelFormat;
+            raw.fmt.pix.width = width_;
+            raw.fmt.pix.height = height_;
+            raw.fmt.pix.bytesperline = format.bytesPerLine;
+            if (xioctl(encoderFd_, VIDIOC_S_FMT, &raw) < 0)
+            {
+              return false;
+            }
+            pitch = raw.fmt.pix.bytesperline;
+            frameBytes_ = raw.fmt.pix.sizeimage;
+          }
+
+          // The encoder reads the grabber's buffers as they are, or not at all
+          if (pitch != format.bytesPerLine ||
+              frameBytes_ > *std::min_element(format.sizes.begin(), format.sizes.end()))
+          {
+            OPENAUTO_LOG(warning) << "[DashcamRecorder] Encoder wants a " << pitch << " byte pitch and "
+                                  << frameBytes_ << " byte frames, the camera has " << format.bytesPerLine;
+            return false;
+          }
+
+          struct v4l2_streamparm parm = {};
+          parm.type = outputType_;
+          parm.parm.output.timeperframe.numerator = 1;
+          parm.parm.output.timeperframe.denominator = format.fps;
+          xioctl(encoderFd_, VIDIOC_S_PARM, &parm);
+
+          // A keyframe a second: segments cut and fragments close on one
+          setControl(encoderFd_, V4L2_CID_MPEG_VIDEO_BITRATE_MODE, V4L2_MPEG_VIDEO_BITRATE_MODE_CBR, "CBR");
+          setControl(encoderFd_, V4L2_CID_MPEG_VIDEO_BITRATE,
+                     static_cast<int32_t>(configuration_->getDashcamBitrateKbps() * 1000), "bitrate");
+          setControl(encoderFd_, V4L2_CID_MPEG_VIDEO_GOP_SIZE, static_cast<int32_t>(format.fps), "GOP size");
+          setControl(encoderFd_, V4L2_CID_MPEG_VIDEO_H264_I_PERIOD, static_cast<int32_t>(format.fps), "I period");
+          setControl(encoderFd_, V4L2_CID_MPEG_VIDEO_REPEAT_SEQ_HEADER, 1, "repeated SPS/PPS");
+          setControl(encoderFd_, V4L2_CID_MPEG_VIDEO_H264_PROFILE, V4L2_MPEG_VIDEO_H264_PROFILE_MAIN, "profile");
+
+          struct v4l2_requestbuffers request = {};
+          request.count = static_cast<uint32_t>(format.fds.size());
+          request.type = outputType_;
+          request.memory = V4L2_MEMORY_DMABUF;
+          if (xioctl(encoderFd_, VIDIOC_REQBUFS, &request) < 0 || request.count < format.fds.size())
+          {
+            OPENAUTO_LOG(warning) << "[DashcamRecorder] Encoder does not import DMA-BUFs";
+            return false;
+          }
+
+          request = {};
+          request.count = cBitstreamBuffers;
+          request.type = captureType_;
+          request.memory = V4L2_MEMORY_MMAP;
+          if (xioctl(encoderFd_, VIDIOC_REQBUFS, &request) < 0 || request.count == 0)
+          {
+            return false;
+          }
+          for (uint32_t i = 0; i < request.count; i++)
+          {
+            struct v4l2_plane plane = {};
+            struct v4l2_buffer buffer = {};
+            buffer.type = captureType_;
+            buffer.memory = V4L2_MEMORY_MMAP;
+            buffer.index = i;
+            if (mplane)
+            {
+              buffer.m.planes = &plane;
+              buffer.length = 1;
+            }
+            if (xioctl(encoderFd_, VIDIOC_QUERYBUF, &buffer) < 0)
+            {
+              return false;
+            }
+            const size_t length = mplane ? plane.length : buffer.length;
+            const off_t offset = mplane ? plane.m.mem_offset : buffer.m.offset;
+            void *data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, encoderFd_, offset);
+            if (data == MAP_FAILED)
+            {
+              return false;
+            }
+            bitstream_.push_back(data);
+            bitstreamSizes_.push_back(length);
+            if (xioctl(encoderFd_, VIDIOC_QBUF, &buffer) < 0)
+            {
+              return false;
+            }
+          }
+
+          uint32_t type = captureType_;
+          if (xioctl(encoderFd_, VIDIOC_STREAMON, &type) < 0)
+          {
+            return false;
+          }
+          type = outputType_;
+          return xioctl(encoderFd_, VIDIOC_STREAMON, &type) == 0;
+        }
+
+        void DashcamRecorder::closeEncoder()
+        {
+          // Returns every queued buffer, the camera's included
+          for (uint32_t type : {outputType_, captureType_})
+          {
+            xioctl(encoderFd_, VIDIOC_STREAMOFF, &type);
+          }
+          for (size_t i = 0; i < bitstream_.size(); i++)
+          {
+            munmap(bitstream_[i], bitstreamSizes_[i]);
+          }
+          bitstream_.clear();
+          bitstreamSizes_.clear();
+          close(encoderFd_);
+          encoderFd_ = -1;
+          outputType_ = 0;
+          captureType_ = 0;
+        }
+
+        bool DashcamRecorder::submit(int index, int64_t timestampUs)
+        {
+          std::lock_guard<std::mutex> lock(heldMutex_);
+          if (encoderFd_ < 0 || stopping_.load() || held_[index])
+          {
+            return false;
+          }
+          if (heldCount_ >= maxHeld_)
+          {
+            metrics().droppedFrames.add();
+            return false;
+          }
+
+          struct v4l2_plane plane = {};
+          struct v4l2_buffer buffer = {};
+          buffer.type = outputType_;
+          buffer.memory = V4L2_MEMORY_DMABUF;
+          buffer.index = static_cast<uint32_t>(index);
+          buffer.timestamp.tv_sec = timestampUs / 1000000;
+          buffer.timestamp.tv_usec = timestampUs % 1000000;
+          if (outputType_ == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE)
+          {
+            plane.m.fd = fds_[index];
+            plane.length = static_cast<uint32_t>(sizes_[index]);
+            plane.bytesused = frameBytes_;
+            buffer.m.planes = &plane;
+            buffer.length = 1;
+          }
+          else
+          {
+            buffer.m.fd = fds_[index];
+            buffer.length = static_cast<uint32_t>(sizes_[index]);
+            buffer.bytesused = frameBytes_;
+          }
+          if (xioctl(encoderFd_, VIDIOC_QBUF, &buffer) < 0)
+          {
+            OPENAUTO_LOG_EVERY_MS(warning, 10000) << "[DashcamRecorder] Queueing a frame failed: " << strerror(errno);
+            return false;
+          }
+          held_[index] = true;
+          heldCount_++;
+          return true;
+        }
+
+        void DashcamRecorder::releaseHeld()
+        {
+          std::vector<int> indices;
+          {
+            std::lock_guard<std::mutex> lock(heldMutex_);
+            for (size_t i = 0; i < held_.size(); i++)
+            {
+              if (held_[i])
+              {
+                held_[i] = false;
+                indices.push_back(static_cast<int>(i));
+              }
+            }
+            heldCount_ = 0;
+          }
+          for (int index : indices)
+          {
+            release_(index);
+          }
+        }
+
+        void DashcamRecorder::drainOutput()
+        {
+          while (true)
+          {
+            struct v4l2_plane plane = {};
+            struct v4l2_buffer buffer = {};
+            buffer.type = outputType_;
+            buffer.memory = V4L2_MEMORY_DMABUF;
+            if (outputType_ == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE)
+            {
+              buffer.m.planes = &plane;
+              buffer.length = 1;
+            }
+            if (xioctl(encoderFd_, VIDIOC_DQBUF, &buffer) < 0)
+            {
+              return;
+            }
+            {
+              std::lock_guard<std::mutex> lock(heldMutex_);
+              if (!held_[buffer.index])
+              {
+                continue;
+              }
+              held_[buffer.index] = false;
+              heldCount_--;
+            }
+            release_(static_cast<int>(buffer.index));
+          }
+        }
+
+        void DashcamRecorder::drainCapture()
+        {
+          const bool mplane = captureType_ == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+          while (true)
+          {
+            struct v4l2_plane plane = {};
+            struct v4l2_buffer buffer = {};
+            buffer.type = captureType_;
+            buffer.memory = V4L2_MEMORY_MMAP;
+            if (mplane)
+            {
+              buffer.m.planes = &plane;
+              buffer.length = 1;
+            }
+            if (xioctl(encoderFd_, VIDIOC_DQBUF, &buffer) < 0)
+            {
+              return;
+            }
+
+            const size_t used = mplane ? plane.bytesused - plane.data_offset : buffer.bytesused;
+            const uint8_t *data = static_cast<const uint8_t *>(bitstream_[buffer.index]) +
+                                  (mplane ? plane.data_offset : 0);
+            const int64_t timestampUs =
+                static_cast<int64_t>(buffer.timestamp.tv_sec) * 1000000 + buffer.timestamp.tv_usec;
+            const bool keyframe = (buffer.flags & V4L2_BUF_FLAG_KEYFRAME) != 0;
+
+            if (used > 0 && !(buffer.flags & V4L2_BUF_FLAG_ERROR))
+            {
+              // Segments start on a keyframe, the first one after they are due
+              if (keyframe && (!writer_ || !writer_->isOpen() ||
+                               writer_->durationUs() >=
+                                   static_cast<int64_t>(configuration_->getDashcamSegmentSeconds()) * 1000000))
+              {
+                this->rotate();
+              }
+              if (writer_ && writer_->isOpen() && !writer_->write(data, used, timestampUs, keyframe))
+              {
+                // Card full or pulled: drop this segment, retry on the next keyframe
+                metrics().writeErrors.add();
+                this->finishSegment();
+              }
+              metrics().frames.add();
+            }
+            xioctl(encoderFd_, VIDIOC_QBUF, &buffer);
+          }
+        }
+
+        bool DashcamRecorder::rotate()
+        {
+          this->finishSegment();
+          if (!writer_)
+          {
+            writer_ = std::make_shared<Mp4SegmentWriter>();
+          }
+          segments_.makeRoom(segmentBytes_);
+          const std::string path = segments_.nextPath(std::time(nullptr));
+          if (!writer_->open(path, segmentBytes_, width_, height_))
+          {
+            return false;
+          }
+          metrics().segments.add();
+          // The flag the dashcam scripts used to raise, still shown by the UI
+          if (!StateBus::instance().isSet(StateFlag::DashcamRecording))
+          {
+            StateBus::instance().set(StateFlag::DashcamRecording);
+          }
+          OPENAUTO_LOG(info) << "[DashcamRecorder] Recording " << path;
+          return true;
+        }
+
+        void DashcamRecorder::finishSegment()
+        {
+          if (writer_ && writer_->isOpen())
+          {
+            writer_->close();
+          }
+        }
+
+        void DashcamRecorder::run()
+        {
+          ThreadTopology::instance().apply(ThreadRole::Background, "oa-dashcam");
+
+          while (!stopping_.load())
+          {
+            struct pollfd fds[2] = {{wakeFd_, POLLIN, 0}, {encoderFd_, POLLIN | POLLOUT, 0}};
+            if (poll(fds, 2, -1) < 0 && errno != EINTR)
+            {
+              break;
+            }
+            if (fds[1].revents & POLLERR)
+            {
+              // Give the camera its buffers back now, not at detach()
+              OPENAUTO_LOG(error) << "[DashcamRecorder] Encoder error, recording stopped";
+              {
+                std::lock_guard<std::mutex> lock(heldMutex_);
+                stopping_ = true;
+              }
+              this->closeEncoder();
+              this->releaseHeld();
+              break;
+            }
+            if (fds[1].revents & POLLOUT)
+            {
+              this->drainOutput();
+            }
+            if (fds[1].revents & POLLIN)
+            {
+              this->drainCapture();
+            }
+          }
+
+          this->finishSegment();
+          StateBus::instance().clear(StateFlag::DashcamRecording);
+        }
+
+#else
+
+        DashcamRecorder::DashcamRecorder(configuration::IConfiguration::Pointer configuration)
+            : configuration_(std::move(configuration)),
+              segments_(configuration_->getDashcamDirectory(), 0), stopping_(false), wakeFd_(-1), encoderFd_(-1),
+              outputType_(0), captureType_(0), frameBytes_(0), width_(0), height_(0), heldCount_(0), maxHeld_(0),
+              segmentBytes_(0)
+        {
+        }
+
+        DashcamRecorder::~DashcamRecorder() = default;
+
+        bool DashcamRecorder::attach(const CaptureFormat &, size_t, ReleaseHandler)
+        {
+          return false;
+        }
+
+        void DashcamRecorder::detach() {}
+
+        bool DashcamRecorder::submit(int, int64_t)
+        {
+          return false;
+        }
+
+#endif
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
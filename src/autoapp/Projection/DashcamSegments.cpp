@@ -0,0 +1,182 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Projection/DashcamSegments.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          constexpr char cPrefix[] = "dashcam-";
+          constexpr char cSuffix[] = ".mp4";
+        }
+
+        DashcamSegments::DashcamSegments(std::string directory, uint64_t maxBytes)
+            : directory_(std::move(directory)), maxBytes_(maxBytes)
+        {
+        }
+
+        bool DashcamSegments::prepare() const
+        {
+          // One level: the mount point itself has to exist already
+          if (mkdir(directory_.c_str(), 0755) < 0 && errno != EEXIST)
+          {
+            OPENAUTO_LOG(error) << "[DashcamSegments] Cannot create " << directory_ << ": " << strerror(errno);
+            return false;
+          }
+          if (access(directory_.c_str(), W_OK) < 0)
+          {
+            OPENAUTO_LOG(error) << "[DashcamSegments] " << directory_ << " is not writable";
+            return false;
+          }
+          return true;
+        }
+
+        bool DashcamSegments::parseName(const std::string &name, uint64_t &sequence)
+        {
+          const size_t prefixLength = sizeof(cPrefix) - 1;
+          const size_t suffixLength = sizeof(cSuffix) - 1;
+          if (name.size() <= prefixLength + suffixLength || name.compare(0, prefixLength, cPrefix) != 0 ||
+              name.compare(name.size() - suffixLength, suffixLength, cSuffix) != 0)
+          {
+            return false;
+          }
+
+          size_t pos = prefixLength;
+          sequence = 0;
+          while (pos < name.size() && name[pos] >= '0' && name[pos] <= '9')
+          {
+            sequence = sequence * 10 + static_cast<uint64_t>(name[pos] - '0');
+            pos++;
+          }
+          return pos > prefixLength && name[pos] == '-';
+        }
+
+        std::vector<DashcamSegments::Segment> DashcamSegments::list() const
+        {
+          std::vector<Segment> segments;
+          DIR *dir = opendir(directory_.c_str());
+          if (!dir)
+          {
+            return segments;
+          }
+          while (struct dirent *entry = readdir(dir))
+          {
+            Segment segment;
+            if (!parseName(entry->d_name, segment.sequence))
+            {
+              continue;
+            }
+            segment.path = directory_ + "/" + entry->d_name;
+            struct stat info;
+            if (stat(segment.path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+            {
+              continue;
+            }
+            segment.bytes = static_cast<uint64_t>(info.st_blocks) * 512;
+            segments.push_back(std::move(segment));
+          }
+          closedir(dir);
+
+          std::sort(segments.begin(), segments.end(),
+                    [](const Segment &a, const Segment &b) { return a.sequence < b.sequence; });
+          return segments;
+        }
+
+        std::string DashcamSegments::nextPath(std::time_t now) const
+        {
+          const auto segments = this->list();
+          const uint64_t sequence = segments.empty() ? 1 : segments.back().sequence + 1;
+
+          struct tm local;
+          localtime_r(&now, &local);
+          char name[64];
+          const size_t length = strftime(name, sizeof(name), "%Y%m%d-%H%M%S", &local);
+          name[length] = '\0';
+
+          char sequenceText[24];
+          snprintf(sequenceText, sizeof(sequenceText), "%06llu", static_cast<unsigned long long>(sequence));
+          return directory_ + "/" + cPrefix + sequenceText + "-" + name + cSuffix;
+        }
+
+        uint64_t DashcamSegments::makeRoom(uint64_t reserveBytes, const std::string &keep) const
+        {
+          auto segments = this->list();
+          uint64_t used = 0;
+          for (const auto &segment : segments)
+          {
+            used += segment.bytes;
+          }
+
+          // A card shared with other files can fill up before the limit
+          uint64_t available = std::numeric_limits<uint64_t>::max() / 2;
+          struct statvfs fs;
+          if (statvfs(directory_.c_str(), &fs) == 0)
+          {
+            available = static_cast<uint64_t>(fs.f_bavail) * fs.f_frsize;
+          }
+
+          uint64_t freed = 0;
+          for (const auto &segment : segments)
+          {
+            if (used + reserveBytes <= maxBytes_ && available >= reserveBytes)
+            {
+              break;
+            }
+            if (segment.path == keep)
+            {
+              continue;
+            }
+            if (unlink(segment.path.c_str()) == 0)
+            {
+              OPENAUTO_LOG(debug) << "[DashcamSegments] Removed " << segment.path;
+              used -= segment.bytes;
+              available += segment.bytes;
+              freed += segment.bytes;
+            }
+            else
+            {
+              OPENAUTO_LOG(warning) << "[DashcamSegments] Cannot remove " << segment.path << ": "
+                                    << strerror(errno);
+            }
+          }
+          return freed;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,106 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/autoapp/Projection/DecoderWatchdog.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        DecoderWatchdog::DecoderWatchdog(int64_t hangUs, uint32_t minPackets)
+            : hangUs_(hangUs), minPackets_(minPackets), firstUnansweredUs_(0), unanswered_(0),
+              hangStartUs_(0), lastStep_(DecoderRecovery::None)
+        {
+        }
+
+        void DecoderWatchdog::packetSent(int64_t nowUs)
+        {
+          if (unanswered_++ == 0)
+          {
+            firstUnansweredUs_ = nowUs;
+          }
+        }
+
+        int64_t DecoderWatchdog::frameDecoded(int64_t nowUs)
+        {
+          unanswered_ = 0;
+          if (hangStartUs_ == 0)
+          {
+            return 0;
+          }
+
+          const int64_t recoveryUs = nowUs - hangStartUs_;
+          hangStartUs_ = 0;
+          lastStep_ = DecoderRecovery::None;
+          return recoveryUs > 0 ? recoveryUs : 1;
+        }
+
+        DecoderRecovery DecoderWatchdog::poll(int64_t nowUs)
+        {
+          if (unanswered_ < minPackets_ || nowUs - firstUnansweredUs_ < hangUs_)
+          {
+            return DecoderRecovery::None;
+          }
+
+          if (hangStartUs_ == 0)
+          {
+            // Counted from the first unanswered packet, which is when the
+            // screen froze
+            hangStartUs_ = firstUnansweredUs_ > 0 ? firstUnansweredUs_ : nowUs;
+          }
+          switch (lastStep_)
+          {
+          case DecoderRecovery::None:
+            lastStep_ = DecoderRecovery::Flush;
+            break;
+          case DecoderRecovery::Flush:
+            lastStep_ = DecoderRecovery::Reopen;
+            break;
+          case DecoderRecovery::Reopen:
+          case DecoderRecovery::RecreateDevice:
+            lastStep_ = DecoderRecovery::RecreateDevice;
+            break;
+          }
+
+          // The step gets its own window, starting with the next packet
+          unanswered_ = 0;
+          return lastStep_;
+        }
+
+        void DecoderWatchdog::reset()
+        {
+          firstUnansweredUs_ = 0;
+          unanswered_ = 0;
+          hangStartUs_ = 0;
+          lastStep_ = DecoderRecovery::None;
+        }
+
+        bool DecoderWatchdog::recovering() const
+        {
+          return hangStartUs_ != 0;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
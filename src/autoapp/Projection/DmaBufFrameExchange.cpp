@@ -0,0 +1,135 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifdef USE_FFMPEG_DRM
+
+#include <f1x/openauto/autoapp/Projection/DmaBufFrameExchange.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        DmaBufFrameExchange &DmaBufFrameExchange::instance()
+        {
+          static DmaBufFrameExchange exchange;
+          return exchange;
+        }
+
+        DmaBufFrameExchange::~DmaBufFrameExchange()
+        {
+          av_frame_free(&pending_);
+        }
+
+        bool DmaBufFrameExchange::publish(const AVFrame *frame,
+                                          const VideoFrameTiming &timing)
+        {
+          AVFrame *ref = av_frame_clone(frame);
+          if (!ref)
+          {
+            return false;
+          }
+
+          {
+            std::lock_guard<decltype(mutex_)> lock(mutex_);
+            if (pending_)
+            {
+              av_frame_free(&pending_);
+              superseded_++;
+            }
+            pending_ = ref;
+            pendingTiming_ = timing;
+          }
+
+          notify();
+          return true;
+        }
+
+        AVFrame *DmaBufFrameExchange::take(VideoFrameTiming &timing)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          AVFrame *frame = pending_;
+          pending_ = nullptr;
+          timing = pendingTiming_;
+          return frame;
+        }
+
+        void DmaBufFrameExchange::clear()
+        {
+          {
+            std::lock_guard<decltype(mutex_)> lock(mutex_);
+            av_frame_free(&pending_);
+            cleared_ = true;
+          }
+
+          notify();
+        }
+
+        bool DmaBufFrameExchange::takeCleared()
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          bool cleared = cleared_;
+          cleared_ = false;
+          return cleared;
+        }
+
+        void DmaBufFrameExchange::setFrameAvailableHandler(FrameAvailableHandler handler)
+        {
+          std::lock_guard<decltype(handlerMutex_)> lock(handlerMutex_);
+          handler_ = std::move(handler);
+        }
+
+        uint64_t DmaBufFrameExchange::supersededFrames() const
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          return superseded_;
+        }
+
+        void DmaBufFrameExchange::setGeometry(const ProjectionGeometry &geometry)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          geometry_ = geometry;
+        }
+
+        ProjectionGeometry DmaBufFrameExchange::geometry() const
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          return geometry_;
+        }
+
+        void DmaBufFrameExchange::notify()
+        {
+          // Held across the call so the consumer cannot be destroyed under it
+          std::lock_guard<decltype(handlerMutex_)> lock(handlerMutex_);
+          if (handler_)
+          {
+            handler_();
+          }
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
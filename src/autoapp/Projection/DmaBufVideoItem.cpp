@@ -0,0 +1,506 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifdef USE_FFMPEG_DRM
+
+#include <f1x/openauto/autoapp/Projection/DmaBufVideoItem.hpp>
+#include <f1x/openauto/autoapp/Projection/DmaBufFrameExchange.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+extern "C"
+{
+#include <libavutil/hwcontext_drm.h>
+#include <libavutil/pixfmt.h>
+}
+
+#include <drm_fourcc.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QSGGeometryNode>
+#include <QSGMaterial>
+#include <QtQml>
+
+#include <cstring>
+#include <vector>
+
+#ifndef GL_TEXTURE_EXTERNAL_OES
+#define GL_TEXTURE_EXTERNAL_OES 0x8D65
+#endif
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+
+          // glEGLImageTargetTexture2DOES; declared here so the GLES2 headers do not
+          // clash with Qt's own GL declarations
+          typedef void (*ImageTargetTexture2DFn)(GLenum target, void *image);
+
+          // ============================================================================
+          // EGL entry points for DMA-BUF import
+          // ============================================================================
+
+          struct EglDmaBufImport
+          {
+            EGLDisplay display = EGL_NO_DISPLAY;
+            PFNEGLCREATEIMAGEKHRPROC createImage = nullptr;
+            PFNEGLDESTROYIMAGEKHRPROC destroyImage = nullptr;
+            ImageTargetTexture2DFn imageTargetTexture2D = nullptr;
+            bool modifiers = false;
+
+            // Resolved on the render thread, where the scene graph's EGL context
+            // is current
+            bool resolve()
+            {
+              if (createImage)
+              {
+                return true;
+              }
+
+              display = eglGetCurrentDisplay();
+              const char *extensions =
+                  display != EGL_NO_DISPLAY ? eglQueryString(display, EGL_EXTENSIONS) : nullptr;
+              if (!extensions || !strstr(extensions, "EGL_EXT_image_dma_buf_import"))
+              {
+                OPENAUTO_LOG(error) << "[DmaBufVideoItem] EGL_EXT_image_dma_buf_import "
+                                       "is not supported by this EGL display";
+                return false;
+              }
+
+              QOpenGLContext *context = QOpenGLContext::currentContext();
+              if (!context || !context->hasExtension("GL_OES_EGL_image_external"))
+              {
+                OPENAUTO_LOG(error)
+                    << "[DmaBufVideoItem] GL_OES_EGL_image_external is not supported";
+                return false;
+              }
+
+              modifiers = strstr(extensions, "EGL_EXT_image_dma_buf_import_modifiers") != nullptr;
+              destroyImage = reinterpret_cast<PFNEGLDESTROYIMAGEKHRPROC>(
+                  eglGetProcAddress("eglDestroyImageKHR"));
+              imageTargetTexture2D = reinterpret_cast<ImageTargetTexture2DFn>(
+                  eglGetProcAddress("glEGLImageTargetTexture2DOES"));
+              createImage = reinterpret_cast<PFNEGLCREATEIMAGEKHRPROC>(
+                  eglGetProcAddress("eglCreateImageKHR"));
+
+              if (!createImage || !destroyImage || !imageTargetTexture2D)
+              {
+                OPENAUTO_LOG(error) << "[DmaBufVideoItem] EGLImage entry points missing";
+                createImage = nullptr;
+                return false;
+              }
+
+              OPENAUTO_LOG(info) << "[DmaBufVideoItem] DMA-BUF import ready (modifiers: "
+                                 << (modifiers ? "yes" : "no") << ")";
+              return true;
+            }
+
+            // Wraps the frame's DMA-BUF planes in an EGLImage; no pixels are copied
+            EGLImageKHR import(const AVFrame *frame) const
+            {
+              const AVDRMFrameDescriptor *desc =
+                  reinterpret_cast<const AVDRMFrameDescriptor *>(frame->data[0]);
+              if (!desc || desc->nb_layers != 1 || desc->layers[0].nb_planes < 1 ||
+                  desc->layers[0].nb_planes > 3)
+              {
+                return EGL_NO_IMAGE_KHR;
+              }
+
+              static const EGLint planeAttribs[3][5] = {
+                  {EGL_DMA_BUF_PLANE0_FD_EXT, EGL_DMA_BUF_PLANE0_OFFSET_EXT,
+                   EGL_DMA_BUF_PLANE0_PITCH_EXT, EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT,
+                   EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT},
+                  {EGL_DMA_BUF_PLANE1_FD_EXT, EGL_DMA_BUF_PLANE1_OFFSET_EXT,
+                   EGL_DMA_BUF_PLANE1_PITCH_EXT, EGL_DMA_BUF_PLANE1_MODIFIER_LO_EXT,
+                   EGL_DMA_BUF_PLANE1_MODIFIER_HI_EXT},
+                  {EGL_DMA_BUF_PLANE2_FD_EXT, EGL_DMA_BUF_PLANE2_OFFSET_EXT,
+                   EGL_DMA_BUF_PLANE2_PITCH_EXT, EGL_DMA_BUF_PLANE2_MODIFIER_LO_EXT,
+                   EGL_DMA_BUF_PLANE2_MODIFIER_HI_EXT}};
+
+              const AVDRMLayerDescriptor &layer = desc->layers[0];
+              std::vector<EGLint> attribs = {
+                  EGL_WIDTH, frame->width,
+                  EGL_HEIGHT, frame->height,
+                  EGL_LINUX_DRM_FOURCC_EXT, static_cast<EGLint>(layer.format),
+                  EGL_YUV_COLOR_SPACE_HINT_EXT,
+                  frame->colorspace == AVCOL_SPC_BT709 ? EGL_ITU_REC709_EXT : EGL_ITU_REC601_EXT,
+                  EGL_SAMPLE_RANGE_HINT_EXT,
+                  frame->color_range == AVCOL_RANGE_JPEG ? EGL_YUV_FULL_RANGE_EXT
+                                                         : EGL_YUV_NARROW_RANGE_EXT};
+
+              for (int i = 0; i < layer.nb_planes; i++)
+              {
+                const AVDRMPlaneDescriptor &plane = layer.planes[i];
+                const AVDRMObjectDescriptor &object = desc->objects[plane.object_index];
+                attribs.insert(attribs.end(),
+                               {planeAttribs[i][0], object.fd,
+                                planeAttribs[i][1], static_cast<EGLint>(plane.offset),
+                                planeAttribs[i][2], static_cast<EGLint>(plane.pitch)});
+                if (modifiers && object.format_modifier != DRM_FORMAT_MOD_INVALID)
+                {
+                  attribs.insert(attribs.end(),
+                                 {planeAttribs[i][3],
+                                  static_cast<EGLint>(object.format_modifier & 0xffffffff),
+                                  planeAttribs[i][4],
+                                  static_cast<EGLint>(object.format_modifier >> 32)});
+                }
+              }
+              attribs.push_back(EGL_NONE);
+
+              return createImage(display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, nullptr,
+                                 attribs.data());
+            }
+          };
+
+          // ============================================================================
+          // External OES material
+          // ============================================================================
+
+          class ExternalOesMaterial : public QSGMaterial
+          {
+          public:
+            GLuint texture = 0;
+
+            QSGMaterialType *type() const override
+            {
+              static QSGMaterialType materialType;
+              return &materialType;
+            }
+
+            QSGMaterialShader *createShader() const override;
+
+            int compare(const QSGMaterial *other) const override
+            {
+              const auto *material = static_cast<const ExternalOesMaterial *>(other);
+              return static_cast<int>(texture) - static_cast<int>(material->texture);
+            }
+          };
+
+          class ExternalOesShader : public QSGMaterialShader
+          {
+          public:
+            const char *vertexShader() const override
+            {
+              return "attribute highp vec4 vertex;\n"
+                     "attribute highp vec2 texcoord;\n"
+                     "uniform highp mat4 qt_Matrix;\n"
+                     "varying highp vec2 texCoord;\n"
+                     "void main() {\n"
+                     "  texCoord = texcoord;\n"
+                     "  gl_Position = qt_Matrix * vertex;\n"
+                     "}\n";
+            }
+
+            const char *fragmentShader() const override
+            {
+              // The driver does the YUV -> RGB conversion when sampling
+              return "#extension GL_OES_EGL_image_external : require\n"
+                     "uniform samplerExternalOES tex;\n"
+                     "uniform lowp float opacity;\n"
+                     "varying highp vec2 texCoord;\n"
+                     "void main() {\n"
+                     "  gl_FragColor = texture2D(tex, texCoord) * opacity;\n"
+                     "}\n";
+            }
+
+            char const *const *attributeNames() const override
+            {
+              static const char *const names[] = {"vertex", "texcoord", nullptr};
+              return names;
+            }
+
+            void updateState(const RenderState &state, QSGMaterial *newMaterial,
+                             QSGMaterial * /*oldMaterial*/) override
+            {
+              if (state.isMatrixDirty())
+              {
+                program()->setUniformValue(matrixId_, state.combinedMatrix());
+              }
+              if (state.isOpacityDirty())
+              {
+                program()->setUniformValue(opacityId_, state.opacity());
+              }
+
+              QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+              gl->glActiveTexture(GL_TEXTURE0);
+              gl->glBindTexture(GL_TEXTURE_EXTERNAL_OES,
+                                static_cast<ExternalOesMaterial *>(newMaterial)->texture);
+            }
+
+          protected:
+            void initialize() override
+            {
+              matrixId_ = program()->uniformLocation("qt_Matrix");
+              opacityId_ = program()->uniformLocation("opacity");
+              program()->setUniformValue("tex", 0);
+            }
+
+          private:
+            int matrixId_ = -1;
+            int opacityId_ = -1;
+          };
+
+          QSGMaterialShader *ExternalOesMaterial::createShader() const
+          {
+            return new ExternalOesShader();
+          }
+
+          // ============================================================================
+          // DmaBufVideoNode - Scene graph node owning the imported frames
+          // ============================================================================
+          // Lives on the render thread. The frame on screen and the one it replaced
+          // are both kept: the GPU may still be sampling the older one while the
+          // next scene graph frame is being prepared.
+
+          class DmaBufVideoNode : public QSGGeometryNode
+          {
+          public:
+            DmaBufVideoNode()
+                : geometry_(QSGGeometry::defaultAttributes_TexturedPoint2D(), 4)
+            {
+              setGeometry(&geometry_);
+              setMaterial(&material_);
+            }
+
+            ~DmaBufVideoNode() override
+            {
+              releaseFrames();
+              if (material_.texture != 0 && QOpenGLContext::currentContext())
+              {
+                QOpenGLContext::currentContext()->functions()->glDeleteTextures(
+                    1, &material_.texture);
+              }
+            }
+
+            bool hasFrame() const { return current_.frame != nullptr; }
+
+            /**
+             * Takes ownership of the frame and binds it to the texture.
+             */
+            bool setFrame(AVFrame *frame)
+            {
+              if (frame->format != AV_PIX_FMT_DRM_PRIME || !frame->data[0] || !egl_.resolve())
+              {
+                av_frame_free(&frame);
+                return false;
+              }
+
+              EGLImageKHR image = egl_.import(frame);
+              if (image == EGL_NO_IMAGE_KHR)
+              {
+                OPENAUTO_LOG_EVERY_MS(warning, 1000) << "[DmaBufVideoItem] EGLImage import failed: 0x" << std::hex
+                                                     << eglGetError() << std::dec << " (x" << OPENAUTO_LOG_OCCURRENCES << ")";
+                av_frame_free(&frame);
+                return false;
+              }
+
+              QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+              if (material_.texture == 0)
+              {
+                gl->glGenTextures(1, &material_.texture);
+                gl->glBindTexture(GL_TEXTURE_EXTERNAL_OES, material_.texture);
+                gl->glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                gl->glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                gl->glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S,
+                                    GL_CLAMP_TO_EDGE);
+                gl->glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T,
+                                    GL_CLAMP_TO_EDGE);
+              }
+              gl->glBindTexture(GL_TEXTURE_EXTERNAL_OES, material_.texture);
+              egl_.imageTargetTexture2D(GL_TEXTURE_EXTERNAL_OES, image);
+
+              release(retired_);
+              retired_ = current_;
+              current_ = Imported{frame, image};
+              markDirty(QSGNode::DirtyMaterial);
+              return true;
+            }
+
+            void releaseFrames()
+            {
+              release(retired_);
+              release(current_);
+            }
+
+            /**
+             * Crops the margins and letterboxes the current frame into the item,
+             * recomputed only when one of the inputs changes.
+             */
+            void layout(const ProjectionGeometry &session, const QRectF &bounds)
+            {
+              const QSize frameSize(current_.frame->width, current_.frame->height);
+              if (session == session_ && bounds == bounds_ && frameSize == frameSize_)
+              {
+                return;
+              }
+              session_ = session;
+              bounds_ = bounds;
+              frameSize_ = frameSize;
+
+              QRectF rect = bounds;
+              QRectF texture(0, 0, 1, 1);
+              ProjectionGeometry geometry;
+              if (!session.videoSize().isEmpty())
+              {
+                geometry = session.withDisplaySize(bounds.size().toSize());
+                if (geometry.videoSize() != frameSize)
+                {
+                  geometry = geometry.withVideoSize(frameSize);
+                }
+                if (!geometry.isNull())
+                {
+                  const QRect &src = geometry.sourceRect();
+                  rect = QRectF(geometry.destinationRect()).translated(bounds.topLeft());
+                  texture = QRectF(static_cast<qreal>(src.x()) / frameSize.width(),
+                                   static_cast<qreal>(src.y()) / frameSize.height(),
+                                   static_cast<qreal>(src.width()) / frameSize.width(),
+                                   static_cast<qreal>(src.height()) / frameSize.height());
+                }
+              }
+
+              QSGGeometry::updateTexturedRectGeometry(&geometry_, rect, texture);
+
+              // A rotated or mirrored panel only permutes the texture corners
+              if (!geometry.isNull() && !geometry.orientation().isIdentity())
+              {
+                const QRectF panel(geometry.destinationRect());
+                const QPointF corners[4] = {panel.topLeft(), panel.bottomLeft(),
+                                            panel.topRight(), panel.bottomRight()};
+                QSGGeometry::TexturedPoint2D *vertices = geometry_.vertexDataAsTexturedPoint2D();
+                for (int i = 0; i < 4; i++)
+                {
+                  const QPointF source = geometry.mapToSource(corners[i]);
+                  vertices[i].tx = static_cast<float>(source.x() / frameSize.width());
+                  vertices[i].ty = static_cast<float>(source.y() / frameSize.height());
+                }
+              }
+              markDirty(QSGNode::DirtyGeometry);
+            }
+
+          private:
+            struct Imported
+            {
+              AVFrame *frame = nullptr;
+              EGLImageKHR image = EGL_NO_IMAGE_KHR;
+            };
+
+            void release(Imported &imported)
+            {
+              if (imported.image != EGL_NO_IMAGE_KHR)
+              {
+                egl_.destroyImage(egl_.display, imported.image);
+              }
+              av_frame_free(&imported.frame);
+              imported = Imported{};
+            }
+
+            QSGGeometry geometry_;
+            ExternalOesMaterial material_;
+            ProjectionGeometry session_;
+            QRectF bounds_;
+            QSize frameSize_;
+            Imported current_;
+            Imported retired_;
+
+            static EglDmaBufImport egl_;
+          };
+
+          EglDmaBufImport DmaBufVideoNode::egl_;
+
+        } // namespace
+
+        // ============================================================================
+        // DmaBufVideoItem
+        // ============================================================================
+
+        DmaBufVideoItem::DmaBufVideoItem(QQuickItem *parent)
+            : QQuickItem(parent)
+        {
+          setFlag(ItemHasContents, true);
+
+          // Called from the decode thread; the exchange holds its handler lock
+          // across the call, so this cannot race the destructor
+          DmaBufFrameExchange::instance().setFrameAvailableHandler(
+              [this]()
+              { QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection); });
+        }
+
+        DmaBufVideoItem::~DmaBufVideoItem()
+        {
+          DmaBufFrameExchange::instance().setFrameAvailableHandler(nullptr);
+        }
+
+        void DmaBufVideoItem::registerQmlType()
+        {
+          qmlRegisterType<DmaBufVideoItem>("OpenAuto.Video", 1, 0, "DmaBufVideoItem");
+        }
+
+        QSGNode *DmaBufVideoItem::updatePaintNode(QSGNode *oldNode,
+                                                  UpdatePaintNodeData * /*data*/)
+        {
+          auto *node = static_cast<DmaBufVideoNode *>(oldNode);
+          if (!node)
+          {
+            node = new DmaBufVideoNode();
+          }
+
+          DmaBufFrameExchange &exchange = DmaBufFrameExchange::instance();
+          if (exchange.takeCleared())
+          {
+            node->releaseFrames();
+          }
+
+          VideoFrameTiming timing;
+          AVFrame *frame = exchange.take(timing);
+          if (frame && node->setFrame(frame))
+          {
+            // Scene graph sync is the last point before the swap that the item
+            // sees, so it stands in for the plane commit and page flip
+            timing.commitUs = VideoTelemetry::nowUs();
+            timing.flipUs = timing.commitUs;
+            VideoTelemetry::instance().recordFrame(timing);
+          }
+
+          if (!node->hasFrame())
+          {
+            delete node;
+            return nullptr;
+          }
+
+          node->layout(exchange.geometry(), boundingRect());
+          return node;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
@@ -0,0 +1,192 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifdef USE_FFMPEG_DRM
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <xf86drm.h>
+#include <f1x/openauto/autoapp/Projection/DrmDevice.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+        namespace drmdevice
+        {
+
+          int openShared()
+          {
+            int fd = -1;
+            if (DIR *dir = opendir("/proc/self/fd"))
+            {
+              while (struct dirent *entry = readdir(dir))
+              {
+                char linkPath[280];
+                char targetPath[280];
+                snprintf(linkPath, sizeof(linkPath), "/proc/self/fd/%s", entry->d_name);
+                const ssize_t len = readlink(linkPath, targetPath, sizeof(targetPath) - 1);
+                if (len <= 0)
+                {
+                  continue;
+                }
+                targetPath[len] = '\0';
+                if (strstr(targetPath, "/dev/dri/card0") != nullptr)
+                {
+                  fd = fcntl(atoi(entry->d_name), F_DUPFD_CLOEXEC, 0);
+                  if (fd >= 0)
+                  {
+                    break;
+                  }
+                }
+              }
+              closedir(dir);
+            }
+            if (fd < 0)
+            {
+              fd = ::open("/dev/dri/card0", O_RDWR | O_CLOEXEC);
+            }
+            if (fd >= 0)
+            {
+              drmSetClientCap(fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1);
+            }
+            return fd;
+          }
+
+          uint64_t planeType(int fd, uint32_t planeId)
+          {
+            uint64_t type = DRM_PLANE_TYPE_OVERLAY;
+            drmModeObjectPropertiesPtr props = drmModeObjectGetProperties(fd, planeId, DRM_MODE_OBJECT_PLANE);
+            if (!props)
+            {
+              return type;
+            }
+            for (uint32_t i = 0; i < props->count_props; i++)
+            {
+              drmModePropertyPtr prop = drmModeGetProperty(fd, props->props[i]);
+              if (prop && strcmp(prop->name, "type") == 0)
+              {
+                type = props->prop_values[i];
+              }
+              drmModeFreeProperty(prop);
+            }
+            drmModeFreeObjectProperties(props);
+            return type;
+          }
+
+          bool planeSupports(drmModePlanePtr plane, uint32_t format)
+          {
+            return std::find(plane->formats, plane->formats + plane->count_formats, format) !=
+                   plane->formats + plane->count_formats;
+          }
+
+          std::string connectorName(drmModeConnectorPtr connector)
+          {
+            // drmModeGetConnectorTypeName() is newer than the libdrm we build against
+            static const char *const names[] = {"Unknown", "VGA", "DVI-I", "DVI-D", "DVI-A", "Composite",
+                                                "SVIDEO", "LVDS", "Component", "DIN", "DP", "HDMI-A",
+                                                "HDMI-B", "TV", "eDP", "Virtual", "DSI", "DPI", "Writeback",
+                                                "SPI", "USB"};
+            const uint32_t type = connector->connector_type;
+            const char *name = type < sizeof(names) / sizeof(names[0]) ? names[type] : "Unknown";
+            return std::string(name) + "-" + std::to_string(connector->connector_type_id);
+          }
+
+          uint32_t crtcMask(int fd, uint32_t crtcId)
+          {
+            uint32_t mask = 0;
+            drmModeRes *resources = drmModeGetResources(fd);
+            if (!resources)
+            {
+              return mask;
+            }
+            for (int i = 0; i < resources->count_crtcs; i++)
+            {
+              if (resources->crtcs[i] == crtcId)
+              {
+                mask = 1u << i;
+              }
+            }
+            drmModeFreeResources(resources);
+            return mask;
+          }
+
+          uint32_t propertyId(int fd, uint32_t objectId, uint32_t objectType, const char *name)
+          {
+            uint32_t id = 0;
+            drmModeObjectPropertiesPtr props = drmModeObjectGetProperties(fd, objectId, objectType);
+            if (!props)
+            {
+              return id;
+            }
+            for (uint32_t i = 0; i < props->count_props && id == 0; i++)
+            {
+              drmModePropertyPtr prop = drmModeGetProperty(fd, props->props[i]);
+              if (prop)
+              {
+                if (strcmp(prop->name, name) == 0)
+                {
+                  id = prop->prop_id;
+                }
+                drmModeFreeProperty(prop);
+              }
+            }
+            drmModeFreeObjectProperties(props);
+            return id;
+          }
+
+          uint32_t refreshMilliHz(const drmModeModeInfo &mode)
+          {
+            uint64_t pixels = static_cast<uint64_t>(mode.htotal) * mode.vtotal;
+            if (mode.flags & DRM_MODE_FLAG_INTERLACE)
+            {
+              pixels /= 2;
+            }
+            if (mode.flags & DRM_MODE_FLAG_DBLSCAN)
+            {
+              pixels *= 2;
+            }
+            if (mode.vscan > 1)
+            {
+              pixels *= mode.vscan;
+            }
+            if (pixels == 0)
+            {
+              return mode.vrefresh * 1000;
+            }
+            // clock is in kHz
+            return static_cast<uint32_t>((static_cast<uint64_t>(mode.clock) * 1000000 + pixels / 2) / pixels);
+          }
+
+        } // namespace drmdevice
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
@@ -0,0 +1,398 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
+#include <f1x/openauto/autoapp/Projection/DuplexAudioStream.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+#include <cstring>
+#include <thread>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        constexpr uint32_t DuplexAudioStream::cSampleRate;
+        constexpr uint32_t DuplexAudioStream::cPeriodFrames;
+
+        // ============================================================================
+        // DuplexAudioStream
+        // ============================================================================
+
+        DuplexAudioStream::DuplexAudioStream(uint32_t outputDeviceId, uint32_t inputDeviceId,
+                                             uint32_t jitterBufferMs)
+            : outputDeviceId_(outputDeviceId), inputDeviceId_(inputDeviceId), jitterBufferMs_(jitterBufferMs),
+              echoReference_(std::make_shared<EchoReference>(cSampleRate)), users_(0), output_(nullptr),
+              input_(nullptr), processing_(false), xruns_(0)
+        {
+        }
+
+        DuplexAudioStream::~DuplexAudioStream()
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (users_ > 0)
+          {
+            this->closeStream();
+          }
+        }
+
+        IAudioOutput::Pointer DuplexAudioStream::createOutput()
+        {
+          return std::make_shared<DuplexAudioOutput>(this->shared_from_this(), jitterBufferMs_);
+        }
+
+        std::shared_ptr<RtAudioInput> DuplexAudioStream::createInput(boost::asio::io_service &ioService,
+                                                                     configuration::IConfiguration::Pointer configuration)
+        {
+          return std::make_shared<DuplexAudioInput>(ioService, this->shared_from_this(), std::move(configuration));
+        }
+
+        uint32_t DuplexAudioStream::getOutputDeviceId() const
+        {
+          return outputDeviceId_;
+        }
+
+        uint32_t DuplexAudioStream::getInputDeviceId() const
+        {
+          return inputDeviceId_;
+        }
+
+        EchoReference::Pointer DuplexAudioStream::getEchoReference() const
+        {
+          return echoReference_;
+        }
+
+        bool DuplexAudioStream::acquire()
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (users_ == 0 && !this->openStream())
+          {
+            return false;
+          }
+          users_++;
+          return true;
+        }
+
+        void DuplexAudioStream::release()
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (users_ > 0 && --users_ == 0)
+          {
+            this->closeStream();
+          }
+        }
+
+        bool DuplexAudioStream::openStream()
+        {
+          // mutex_ held
+          if (!dac_)
+          {
+            try
+            {
+              dac_ = std::make_unique<RtAudio>(RtAudio::LINUX_ALSA);
+            }
+            catch (const RtAudioError &e)
+            {
+              OPENAUTO_LOG(error) << "[DuplexAudioStream] Failed to create RtAudio instance: " << e.what();
+              return false;
+            }
+          }
+
+          RtAudio::StreamParameters output;
+          output.deviceId = outputDeviceId_ != 0 ? outputDeviceId_ : dac_->getDefaultOutputDevice();
+          output.nChannels = 1;
+          output.firstChannel = 0;
+          RtAudio::StreamParameters input;
+          input.deviceId = inputDeviceId_ != 0 ? inputDeviceId_ : dac_->getDefaultInputDevice();
+          input.nChannels = 1;
+          input.firstChannel = 0;
+
+          // Both directions on one callback thread, so one placement
+          RtAudio::StreamOptions options;
+          const auto &placement = ThreadTopology::instance().placement(ThreadRole::AudioOutput);
+          options.flags = RTAUDIO_MINIMIZE_LATENCY;
+          if (placement.fifoPriority > 0)
+          {
+            options.flags |= RTAUDIO_SCHEDULE_REALTIME;
+            options.priority = placement.fifoPriority;
+          }
+          options.numberOfBuffers = 2;
+
+          unsigned int bufferFrames = cPeriodFrames;
+#if defined(OA_RTAUDIO_V6)
+          const RtAudioErrorType err = dac_->openStream(&output, &input, RTAUDIO_SINT16, cSampleRate, &bufferFrames,
+                                                        &DuplexAudioStream::rtAudioCallback, this, &options);
+          if (err != RTAUDIO_NO_ERROR || dac_->startStream() != RTAUDIO_NO_ERROR)
+          {
+            OPENAUTO_LOG(error) << "[DuplexAudioStream] Failed to open duplex stream: " << dac_->getErrorText();
+            this->closeStream();
+            return false;
+          }
+#else
+          try
+          {
+            dac_->openStream(&output, &input, RTAUDIO_SINT16, cSampleRate, &bufferFrames,
+                             &DuplexAudioStream::rtAudioCallback, this, &options);
+            dac_->startStream();
+          }
+          catch (const RtAudioError &e)
+          {
+            OPENAUTO_LOG(error) << "[DuplexAudioStream] Failed to open duplex stream: " << e.what();
+            this->closeStream();
+            return false;
+          }
+#endif
+
+          xruns_.store(0);
+          OPENAUTO_LOG(info) << "[DuplexAudioStream] Started on devices " << output.deviceId << "/" << input.deviceId
+                             << ", period: " << bufferFrames << " frames";
+          return true;
+        }
+
+        void DuplexAudioStream::closeStream()
+        {
+          // mutex_ held
+          if (!dac_)
+          {
+            return;
+          }
+          try
+          {
+            if (dac_->isStreamRunning())
+            {
+              dac_->stopStream();
+            }
+            if (dac_->isStreamOpen())
+            {
+              dac_->closeStream();
+            }
+          }
+          catch (...)
+          {
+            OPENAUTO_LOG(warning) << "[DuplexAudioStream] Exception closing stream";
+          }
+
+          const uint32_t xruns = xruns_.exchange(0);
+          if (xruns > 0)
+          {
+            OPENAUTO_LOG(warning) << "[DuplexAudioStream] " << xruns << " xruns since start";
+          }
+        }
+
+        void DuplexAudioStream::waitForProcess() const
+        {
+          while (processing_.load())
+          {
+            std::this_thread::yield();
+          }
+        }
+
+        void DuplexAudioStream::process(int16_t *output, const int16_t *input, unsigned int frames,
+                                        bool overflowed)
+        {
+          // Paired with the pointer stores in stop()/stopDevice(), as in
+          // AudioMixer::render()
+          processing_.store(true);
+
+          if (output != nullptr)
+          {
+            DuplexAudioOutput *call = output_.load();
+            if (call == nullptr)
+            {
+              memset(output, 0, frames * sizeof(int16_t));
+            }
+            else if (call->active_.load(std::memory_order_acquire))
+            {
+              call->buffer_.pull(output, frames);
+            }
+            else
+            {
+              call->buffer_.drain(output, frames);
+            }
+
+            if (echoReference_->isAttached())
+            {
+              echoReference_->write(output, frames, 1);
+            }
+          }
+
+          if (input != nullptr)
+          {
+            if (RtAudioInput *microphone = input_.load())
+            {
+              microphone->capture(input, frames, overflowed);
+            }
+          }
+
+          processing_.store(false);
+        }
+
+        int DuplexAudioStream::rtAudioCallback(void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames,
+                                               double, RtAudioStreamStatus status, void *userData)
+        {
+          thread_local bool placed = false;
+          if (!placed)
+          {
+            placed = true;
+            ThreadTopology::instance().apply(ThreadRole::AudioOutput, "oa-audio-call");
+          }
+
+          auto *self = static_cast<DuplexAudioStream *>(userData);
+          if (status & RTAUDIO_OUTPUT_UNDERFLOW)
+          {
+            self->xruns_.fetch_add(1, std::memory_order_relaxed);
+            FlightRecorder::instance().record(FlightEvent::AudioXrun, 1);
+          }
+          self->process(static_cast<int16_t *>(outputBuffer), static_cast<const int16_t *>(inputBuffer),
+                        nBufferFrames, (status & RTAUDIO_INPUT_OVERFLOW) != 0);
+          return 0;
+        }
+
+        // ============================================================================
+        // DuplexAudioOutput
+        // ============================================================================
+
+        DuplexAudioOutput::DuplexAudioOutput(std::shared_ptr<DuplexAudioStream> stream, uint32_t jitterBufferMs)
+            : stream_(std::move(stream)), buffer_(sizeof(int16_t), DuplexAudioStream::cSampleRate, jitterBufferMs),
+              active_(false), opened_(false)
+        {
+        }
+
+        DuplexAudioOutput::~DuplexAudioOutput()
+        {
+          this->stop();
+        }
+
+        bool DuplexAudioOutput::open()
+        {
+          if (!opened_)
+          {
+            opened_ = stream_->acquire();
+            if (opened_)
+            {
+              stream_->output_.store(this);
+            }
+          }
+          return opened_;
+        }
+
+        void DuplexAudioOutput::write(aasdk::messenger::Timestamp::ValueType timestamp,
+                                      const aasdk::common::DataConstBuffer &buffer)
+        {
+          if (opened_)
+          {
+            buffer_.push(timestamp, buffer.cdata, buffer.size);
+          }
+        }
+
+        void DuplexAudioOutput::start()
+        {
+          // On the channel strand, like write()
+          buffer_.restartTimeline();
+          active_.store(true, std::memory_order_release);
+        }
+
+        void DuplexAudioOutput::suspend()
+        {
+          active_.store(false, std::memory_order_release);
+        }
+
+        void DuplexAudioOutput::stop()
+        {
+          active_.store(false);
+          if (!opened_)
+          {
+            return;
+          }
+
+          DuplexAudioOutput *self = this;
+          stream_->output_.compare_exchange_strong(self, nullptr);
+          stream_->waitForProcess();
+
+          const auto stats = buffer_.stats();
+          OPENAUTO_LOG(info) << "[DuplexAudioStream] Call audio: underruns " << stats.underruns << ", overruns "
+                             << stats.overruns << ", gaps " << stats.gaps << ", drift -" << stats.droppedFrames
+                             << "/+" << stats.insertedFrames << " frames";
+
+          buffer_.clear();
+          opened_ = false;
+          stream_->release();
+        }
+
+        uint32_t DuplexAudioOutput::getSampleSize() const { return 16; }
+
+        uint32_t DuplexAudioOutput::getChannelCount() const { return 1; }
+
+        uint32_t DuplexAudioOutput::getSampleRate() const { return DuplexAudioStream::cSampleRate; }
+
+        AudioJitterStats DuplexAudioOutput::getJitterStats() const { return buffer_.stats(); }
+
+        // ============================================================================
+        // DuplexAudioInput
+        // ============================================================================
+
+        DuplexAudioInput::DuplexAudioInput(boost::asio::io_service &ioService,
+                                           std::shared_ptr<DuplexAudioStream> stream,
+                                           configuration::IConfiguration::Pointer configuration)
+            : RtAudioInput(ioService, 1, 16, DuplexAudioStream::cSampleRate, std::move(configuration)),
+              stream_(std::move(stream)), attached_(false)
+        {
+        }
+
+        DuplexAudioInput::~DuplexAudioInput()
+        {
+          // stopDevice() would otherwise run once this part is already gone
+          this->close();
+        }
+
+        bool DuplexAudioInput::startDevice()
+        {
+          if (!stream_->acquire())
+          {
+            OPENAUTO_LOG(warning) << "[DuplexAudioStream] Capturing the microphone on its own stream";
+            return RtAudioInput::startDevice();
+          }
+          stream_->input_.store(this);
+          attached_ = true;
+          return true;
+        }
+
+        void DuplexAudioInput::stopDevice()
+        {
+          if (!attached_)
+          {
+            RtAudioInput::stopDevice();
+            return;
+          }
+          RtAudioInput *self = this;
+          stream_->input_.compare_exchange_strong(self, nullptr);
+          stream_->waitForProcess();
+          attached_ = false;
+          stream_->release();
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,104 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <f1x/openauto/autoapp/Projection/EchoReference.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        EchoReference::EchoReference(uint32_t sampleRate)
+            : sampleRate_(sampleRate),
+              ring_(MemoryFootprint::instance().bufferBytes(sampleRate * sizeof(int16_t), cRingMs,
+                                                            cLowMemoryRingMs) /
+                    sizeof(int16_t)),
+              memory_(MemoryPool::Audio, ring_.memoryBytes()), attached_(false), dropped_(0)
+        {
+        }
+
+        void EchoReference::write(const int16_t *samples, size_t frames, uint32_t channels)
+        {
+          while (frames > 0)
+          {
+            const size_t count = std::min(frames, cScratchSamples);
+            for (size_t i = 0; i < count; i++)
+            {
+              int32_t sum = 0;
+              for (uint32_t c = 0; c < channels; c++)
+              {
+                sum += samples[i * channels + c];
+              }
+              scratch_[i] = static_cast<int16_t>(sum / static_cast<int32_t>(channels));
+            }
+
+            const size_t written = ring_.write(scratch_, count);
+            if (written < count)
+            {
+              dropped_.fetch_add(count - written, std::memory_order_relaxed);
+            }
+
+            samples += count * channels;
+            frames -= count;
+          }
+        }
+
+        void EchoReference::attach()
+        {
+          // Consumer-side discard; clear() would race a write still in flight
+          // from before the last detach()
+          ring_.commitRead(ring_.available());
+          dropped_.store(0, std::memory_order_relaxed);
+          attached_.store(true);
+        }
+
+        void EchoReference::detach()
+        {
+          attached_.store(false);
+        }
+
+        bool EchoReference::isAttached() const
+        {
+          return attached_.load(std::memory_order_relaxed);
+        }
+
+        EchoReference::Ring &EchoReference::ring()
+        {
+          return ring_;
+        }
+
+        uint32_t EchoReference::getSampleRate() const
+        {
+          return sampleRate_;
+        }
+
+        uint64_t EchoReference::droppedSamples() const
+        {
+          return dropped_.load(std::memory_order_relaxed);
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
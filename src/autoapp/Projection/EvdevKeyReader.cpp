@@ -0,0 +1,396 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Projection/EvdevKeyReader.hpp>
+#include <f1x/openauto/autoapp/Projection/IInputDeviceEventHandler.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          using aap_protobuf::service::media::sink::message::KeyCode;
+
+#define OPENAUTO_LINUX_KEY(key) {#key, key}
+          const std::map<std::string, uint16_t> cLinuxKeyNames = {
+              OPENAUTO_LINUX_KEY(KEY_ENTER), OPENAUTO_LINUX_KEY(KEY_OK), OPENAUTO_LINUX_KEY(KEY_SELECT),
+              OPENAUTO_LINUX_KEY(KEY_ESC), OPENAUTO_LINUX_KEY(KEY_BACK), OPENAUTO_LINUX_KEY(KEY_MENU),
+              OPENAUTO_LINUX_KEY(KEY_HOME), OPENAUTO_LINUX_KEY(KEY_HOMEPAGE),
+              OPENAUTO_LINUX_KEY(KEY_UP), OPENAUTO_LINUX_KEY(KEY_DOWN), OPENAUTO_LINUX_KEY(KEY_LEFT), OPENAUTO_LINUX_KEY(KEY_RIGHT),
+              OPENAUTO_LINUX_KEY(KEY_PHONE), OPENAUTO_LINUX_KEY(KEY_SEARCH), OPENAUTO_LINUX_KEY(KEY_VOICECOMMAND),
+              OPENAUTO_LINUX_KEY(KEY_PLAY), OPENAUTO_LINUX_KEY(KEY_PAUSE), OPENAUTO_LINUX_KEY(KEY_PLAYPAUSE),
+              OPENAUTO_LINUX_KEY(KEY_PLAYCD), OPENAUTO_LINUX_KEY(KEY_PAUSECD), OPENAUTO_LINUX_KEY(KEY_STOPCD),
+              OPENAUTO_LINUX_KEY(KEY_NEXTSONG), OPENAUTO_LINUX_KEY(KEY_PREVIOUSSONG),
+              OPENAUTO_LINUX_KEY(KEY_VOLUMEUP), OPENAUTO_LINUX_KEY(KEY_VOLUMEDOWN), OPENAUTO_LINUX_KEY(KEY_MUTE),
+              OPENAUTO_LINUX_KEY(KEY_F1), OPENAUTO_LINUX_KEY(KEY_F2), OPENAUTO_LINUX_KEY(KEY_F3), OPENAUTO_LINUX_KEY(KEY_F4),
+              OPENAUTO_LINUX_KEY(KEY_F5), OPENAUTO_LINUX_KEY(KEY_F6), OPENAUTO_LINUX_KEY(KEY_F7), OPENAUTO_LINUX_KEY(KEY_F8)};
+#undef OPENAUTO_LINUX_KEY
+
+          std::string trimmed(const std::string &text)
+          {
+            const auto first = text.find_first_not_of(" \t");
+            if (first == std::string::npos)
+            {
+              return std::string();
+            }
+            return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+          }
+
+          bool parseNumber(const std::string &text, long &value)
+          {
+            char *end = nullptr;
+            errno = 0;
+            value = std::strtol(text.c_str(), &end, 0);
+            return !text.empty() && errno == 0 && *end == '\0';
+          }
+
+          bool parseLinuxKey(const std::string &text, uint16_t &key)
+          {
+            const auto named = cLinuxKeyNames.find(text);
+            if (named != cLinuxKeyNames.end())
+            {
+              key = named->second;
+              return true;
+            }
+            long value;
+            if (!parseNumber(text, value) || value <= 0 || value > KEY_MAX)
+            {
+              return false;
+            }
+            key = static_cast<uint16_t>(value);
+            return true;
+          }
+
+          bool parseAaKey(const std::string &text, KeyCode &code)
+          {
+            long value;
+            if (parseNumber(text, value))
+            {
+              if (!aap_protobuf::service::media::sink::message::KeyCode_IsValid(static_cast<int>(value)))
+              {
+                return false;
+              }
+              code = static_cast<KeyCode>(value);
+              return true;
+            }
+            return aap_protobuf::service::media::sink::message::KeyCode_Parse(text, &code);
+          }
+
+          bool isRotaryAxis(uint16_t code)
+          {
+            return code == REL_DIAL || code == REL_WHEEL || code == REL_HWHEEL || code == REL_X;
+          }
+        }
+
+        EvdevKeyDecoder::EvdevKeyDecoder(KeyMap keyMap, IInputDevice::ButtonCodes supportedCodes, uint32_t accelerationDetents, Sink sink)
+            : keyMap_(std::move(keyMap)), supportedCodes_(std::move(supportedCodes)), accelerationDetents_(accelerationDetents),
+              sink_(std::move(sink)), pendingDetents_(0), pendingTimestamp_(0), lastRotary_(0)
+        {
+        }
+
+        EvdevKeyDecoder::KeyMap EvdevKeyDecoder::defaultKeyMap()
+        {
+          return {
+              {KEY_ENTER, KeyCode::KEYCODE_DPAD_CENTER},
+              {KEY_OK, KeyCode::KEYCODE_DPAD_CENTER},
+              {KEY_SELECT, KeyCode::KEYCODE_DPAD_CENTER},
+              {KEY_LEFT, KeyCode::KEYCODE_DPAD_LEFT},
+              {KEY_RIGHT, KeyCode::KEYCODE_DPAD_RIGHT},
+              {KEY_UP, KeyCode::KEYCODE_DPAD_UP},
+              {KEY_DOWN, KeyCode::KEYCODE_DPAD_DOWN},
+              {KEY_ESC, KeyCode::KEYCODE_BACK},
+              {KEY_BACK, KeyCode::KEYCODE_BACK},
+              {KEY_HOME, KeyCode::KEYCODE_HOME},
+              {KEY_HOMEPAGE, KeyCode::KEYCODE_HOME},
+              {KEY_PHONE, KeyCode::KEYCODE_CALL},
+              {KEY_SEARCH, KeyCode::KEYCODE_SEARCH},
+              {KEY_VOICECOMMAND, KeyCode::KEYCODE_SEARCH},
+              {KEY_PLAY, KeyCode::KEYCODE_MEDIA_PLAY},
+              {KEY_PLAYCD, KeyCode::KEYCODE_MEDIA_PLAY},
+              {KEY_PAUSE, KeyCode::KEYCODE_MEDIA_PAUSE},
+              {KEY_PAUSECD, KeyCode::KEYCODE_MEDIA_PAUSE},
+              {KEY_PLAYPAUSE, KeyCode::KEYCODE_MEDIA_PLAY_PAUSE},
+              {KEY_NEXTSONG, KeyCode::KEYCODE_MEDIA_NEXT},
+              {KEY_PREVIOUSSONG, KeyCode::KEYCODE_MEDIA_PREVIOUS}};
+        }
+
+        bool EvdevKeyDecoder::parseKeyMap(const std::string &spec, KeyMap &keyMap)
+        {
+          size_t start = 0;
+          while (start <= spec.size())
+          {
+            const size_t end = std::min(spec.find(',', start), spec.size());
+            const std::string entry = trimmed(spec.substr(start, end - start));
+            start = end + 1;
+            if (entry.empty())
+            {
+              continue;
+            }
+
+            const size_t separator = entry.find('=');
+            uint16_t key;
+            KeyCode code;
+            if (separator == std::string::npos ||
+                !parseLinuxKey(trimmed(entry.substr(0, separator)), key) ||
+                !parseAaKey(trimmed(entry.substr(separator + 1)), code))
+            {
+              OPENAUTO_LOG(warning) << "[EvdevKeyDecoder] Malformed key map entry: " << entry;
+              return false;
+            }
+            keyMap[key] = code;
+          }
+          return true;
+        }
+
+        bool EvdevKeyDecoder::supports(KeyCode code) const
+        {
+          return std::find(supportedCodes_.begin(), supportedCodes_.end(), code) != supportedCodes_.end();
+        }
+
+        void EvdevKeyDecoder::feed(const input_event &event, InputTimestamp timestamp)
+        {
+          if (event.type == EV_KEY)
+          {
+            // Autorepeat (value 2) is left to the phone
+            const auto mapped = keyMap_.find(event.code);
+            if (event.value != 2 && mapped != keyMap_.end() && this->supports(mapped->second))
+            {
+              sink_({event.value != 0 ? ButtonEventType::PRESS : ButtonEventType::RELEASE, WheelDirection::NONE,
+                     mapped->second, timestamp});
+            }
+          }
+          else if (event.type == EV_REL && isRotaryAxis(event.code) && event.value != 0)
+          {
+            // Turning back sends what was summed for the old direction first
+            if (pendingDetents_ != 0 && (pendingDetents_ < 0) != (event.value < 0))
+            {
+              this->sendRotary(timestamp);
+            }
+            pendingDetents_ += event.value;
+            pendingTimestamp_ = timestamp;
+          }
+          else if (event.type == EV_SYN && event.code == SYN_REPORT)
+          {
+            // The first detent after a pause goes out at once
+            this->flush(timestamp);
+          }
+        }
+
+        void EvdevKeyDecoder::flush(InputTimestamp now)
+        {
+          if (pendingDetents_ != 0 && now >= lastRotary_ + cRotaryWindow)
+          {
+            this->sendRotary(now);
+          }
+        }
+
+        InputTimestamp EvdevKeyDecoder::nextFlush() const
+        {
+          return pendingDetents_ != 0 ? lastRotary_ + cRotaryWindow : InputTimestamp(0);
+        }
+
+        void EvdevKeyDecoder::sendRotary(InputTimestamp now)
+        {
+          uint32_t steps = static_cast<uint32_t>(std::abs(pendingDetents_));
+          if (accelerationDetents_ > 0 && steps >= accelerationDetents_)
+          {
+            steps *= 2;
+          }
+
+          if (this->supports(KeyCode::KEYCODE_ROTARY_CONTROLLER))
+          {
+            ButtonEvent event{ButtonEventType::NONE, pendingDetents_ < 0 ? WheelDirection::LEFT : WheelDirection::RIGHT,
+                              KeyCode::KEYCODE_ROTARY_CONTROLLER, pendingTimestamp_};
+            event.wheelSteps = steps;
+            sink_(event);
+          }
+          pendingDetents_ = 0;
+          lastRotary_ = now;
+        }
+
+        EvdevKeyReader::EvdevKeyReader(std::vector<std::string> devicePaths, EvdevKeyDecoder::KeyMap keyMap, uint32_t accelerationDetents)
+            : devicePaths_(std::move(devicePaths)), keyMap_(std::move(keyMap)), accelerationDetents_(accelerationDetents),
+              wakeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), stopping_(false)
+        {
+          if (wakeFd_ < 0)
+          {
+            OPENAUTO_LOG(error) << "[EvdevKeyReader] eventfd failed: " << std::strerror(errno);
+          }
+        }
+
+        EvdevKeyReader::~EvdevKeyReader()
+        {
+          this->stop();
+          if (wakeFd_ >= 0)
+          {
+            close(wakeFd_);
+          }
+        }
+
+        bool EvdevKeyReader::start(IInputDeviceEventHandler &eventHandler, const IInputDevice::ButtonCodes &supportedCodes)
+        {
+          if (thread_.joinable())
+          {
+            return true;
+          }
+          if (wakeFd_ < 0)
+          {
+            return false;
+          }
+
+          for (const auto &path : devicePaths_)
+          {
+            const int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            if (fd < 0)
+            {
+              OPENAUTO_LOG(warning) << "[EvdevKeyReader] Cannot open " << path << ": " << std::strerror(errno);
+              continue;
+            }
+
+            int clock = CLOCK_MONOTONIC;
+            const bool monotonicTimes = ioctl(fd, EVIOCSCLOCKID, &clock) == 0;
+            if (ioctl(fd, EVIOCGRAB, 1) < 0)
+            {
+              OPENAUTO_LOG(warning) << "[EvdevKeyReader] Cannot grab " << path << ": " << std::strerror(errno);
+            }
+            OPENAUTO_LOG(info) << "[EvdevKeyReader] Reading " << path;
+            devices_.push_back({fd, monotonicTimes});
+          }
+
+          if (devices_.empty())
+          {
+            return false;
+          }
+
+          stopping_ = false;
+          EvdevKeyDecoder decoder(keyMap_, supportedCodes, accelerationDetents_, [handler = &eventHandler](const ButtonEvent &event)
+                                  { handler->onButtonEvent(event); });
+          thread_ = std::thread(&EvdevKeyReader::run, this, std::move(decoder));
+          return true;
+        }
+
+        void EvdevKeyReader::stop()
+        {
+          if (thread_.joinable())
+          {
+            stopping_ = true;
+            const uint64_t one = 1;
+            (void)write(wakeFd_, &one, sizeof(one));
+            thread_.join();
+          }
+          this->closeDevices();
+        }
+
+        void EvdevKeyReader::closeDevices()
+        {
+          for (const auto &device : devices_)
+          {
+            ioctl(device.fd, EVIOCGRAB, 0);
+            close(device.fd);
+          }
+          devices_.clear();
+        }
+
+        void EvdevKeyReader::run(EvdevKeyDecoder decoder)
+        {
+          ThreadTopology::instance().apply(ThreadRole::Input, "oa-keys");
+
+          std::vector<pollfd> fds;
+          fds.push_back({wakeFd_, POLLIN, 0});
+          for (const auto &device : devices_)
+          {
+            fds.push_back({device.fd, POLLIN, 0});
+          }
+          std::array<input_event, 32> events;
+
+          while (!stopping_)
+          {
+            int timeoutMs = -1;
+            if (decoder.nextFlush().count() != 0)
+            {
+              const auto wait = decoder.nextFlush() - inputTimestampNow();
+              timeoutMs = static_cast<int>(std::max<int64_t>(0, (wait.count() + 999) / 1000));
+            }
+
+            if (poll(fds.data(), fds.size(), timeoutMs) < 0 && errno != EINTR)
+            {
+              OPENAUTO_LOG(error) << "[EvdevKeyReader] poll failed: " << std::strerror(errno);
+              break;
+            }
+
+            if (fds[0].revents & POLLIN)
+            {
+              uint64_t count;
+              (void)read(wakeFd_, &count, sizeof(count));
+            }
+
+            for (size_t i = 1; i < fds.size(); ++i)
+            {
+              if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+              {
+                // Unplugged; a negative fd makes poll() skip the entry
+                OPENAUTO_LOG(warning) << "[EvdevKeyReader] A key device went away";
+                fds[i].fd = -1;
+                continue;
+              }
+              if (!(fds[i].revents & POLLIN))
+              {
+                continue;
+              }
+
+              const bool monotonicTimes = devices_[i - 1].monotonicTimes;
+              ssize_t bytes;
+              while ((bytes = read(fds[i].fd, events.data(), sizeof(events))) > 0)
+              {
+                for (size_t e = 0; e < static_cast<size_t>(bytes) / sizeof(input_event); ++e)
+                {
+                  const auto &event = events[e];
+                  decoder.feed(event, monotonicTimes ? InputTimestamp(event.time.tv_sec * 1000000LL + event.time.tv_usec)
+                                                     : inputTimestampNow());
+                }
+              }
+            }
+
+            decoder.flush(inputTimestampNow());
+          }
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
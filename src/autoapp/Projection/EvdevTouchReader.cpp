@@ -0,0 +1,377 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Projection/EvdevTouchReader.hpp>
+#include <f1x/openauto/autoapp/Projection/IInputDeviceEventHandler.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          using aap_protobuf::service::inputsource::message::PointerAction;
+
+          constexpr size_t cLongBits = sizeof(unsigned long) * CHAR_BIT;
+
+          bool hasAbsAxis(int fd, int axis)
+          {
+            unsigned long bits[(ABS_MAX + cLongBits) / cLongBits] = {};
+            if (ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(bits)), bits) < 0)
+            {
+              return false;
+            }
+            return (bits[axis / cLongBits] >> (axis % cLongBits)) & 1UL;
+          }
+
+          double axisScale(int32_t min, int32_t max, int pixels)
+          {
+            return max > min ? static_cast<double>(pixels) / (max - min) : 1.0;
+          }
+        }
+
+        EvdevTouchDecoder::EvdevTouchDecoder(const EvdevTouchAxes &axes, const ProjectionGeometry &geometry, bool multiTouch,
+                                             bool monotonicTimes, Sink sink)
+            : geometry_(geometry), multiTouch_(multiTouch), monotonicTimes_(monotonicTimes), sink_(std::move(sink)),
+              xScale_(axisScale(axes.xMin, axes.xMax, geometry.displaySize().width())),
+              yScale_(axisScale(axes.yMin, axes.yMax, geometry.displaySize().height())),
+              xMin_(axes.xMin), yMin_(axes.yMin), currentSlot_(0), dropping_(false)
+        {
+          event_.pointers.reserve(cMaxSlots);
+        }
+
+        void EvdevTouchDecoder::feed(const input_event &event)
+        {
+          if (dropping_)
+          {
+            // The kernel discarded events; what is still down is unknown
+            if (event.type == EV_SYN && event.code == SYN_REPORT)
+            {
+              dropping_ = false;
+              this->releaseAll();
+            }
+            return;
+          }
+
+          Slot *slot = currentSlot_ < cMaxSlots ? &slots_[currentSlot_] : nullptr;
+          switch (event.type)
+          {
+          case EV_SYN:
+            if (event.code == SYN_REPORT)
+            {
+              // The kernel stamps the frame when the panel reported it
+              this->commit(monotonicTimes_ ? InputTimestamp(event.time.tv_sec * 1000000LL + event.time.tv_usec)
+                                           : inputTimestampNow());
+            }
+            else if (event.code == SYN_DROPPED)
+            {
+              dropping_ = true;
+            }
+            break;
+
+          case EV_ABS:
+            if (multiTouch_)
+            {
+              if (event.code == ABS_MT_SLOT)
+              {
+                // Slots beyond our table are ignored until the next ABS_MT_SLOT
+                currentSlot_ = event.value >= 0 ? static_cast<size_t>(event.value) : cMaxSlots;
+              }
+              else if (slot != nullptr && event.code == ABS_MT_TRACKING_ID)
+              {
+                slot->trackingId = event.value;
+              }
+              else if (slot != nullptr && event.code == ABS_MT_POSITION_X)
+              {
+                slot->x = event.value;
+                slot->moved = true;
+              }
+              else if (slot != nullptr && event.code == ABS_MT_POSITION_Y)
+              {
+                slot->y = event.value;
+                slot->moved = true;
+              }
+            }
+            else if (event.code == ABS_X)
+            {
+              slots_[0].x = event.value;
+              slots_[0].moved = true;
+            }
+            else if (event.code == ABS_Y)
+            {
+              slots_[0].y = event.value;
+              slots_[0].moved = true;
+            }
+            break;
+
+          case EV_KEY:
+            if (!multiTouch_ && event.code == BTN_TOUCH)
+            {
+              slots_[0].trackingId = event.value != 0 ? 0 : -1;
+            }
+            break;
+
+          default:
+            break;
+          }
+        }
+
+        void EvdevTouchDecoder::releaseAll()
+        {
+          for (auto &slot : slots_)
+          {
+            slot.trackingId = -1;
+          }
+          this->commit(inputTimestampNow());
+        }
+
+        void EvdevTouchDecoder::commit(InputTimestamp timestamp)
+        {
+          event_.timestamp = timestamp;
+          bool moved = false;
+          for (const auto &slot : slots_)
+          {
+            moved = moved || (slot.down && slot.trackingId >= 0 && slot.moved);
+          }
+          if (moved)
+          {
+            this->emitEvent(PointerAction::ACTION_MOVED, cMaxSlots);
+          }
+
+          for (size_t i = 0; i < cMaxSlots; ++i)
+          {
+            if (slots_[i].down && slots_[i].trackingId < 0)
+            {
+              const bool last = std::count_if(slots_.begin(), slots_.end(), [](const Slot &s)
+                                               { return s.down; }) == 1;
+              this->emitEvent(last ? PointerAction::ACTION_UP : PointerAction::ACTION_POINTER_UP, i);
+              slots_[i].down = false;
+            }
+          }
+
+          for (size_t i = 0; i < cMaxSlots; ++i)
+          {
+            if (!slots_[i].down && slots_[i].trackingId >= 0)
+            {
+              slots_[i].down = true;
+              const bool first = std::count_if(slots_.begin(), slots_.end(), [](const Slot &s)
+                                                { return s.down; }) == 1;
+              this->emitEvent(first ? PointerAction::ACTION_DOWN : PointerAction::ACTION_POINTER_DOWN, i);
+            }
+          }
+
+          for (auto &slot : slots_)
+          {
+            slot.moved = false;
+          }
+        }
+
+        void EvdevTouchDecoder::emitEvent(PointerAction action, size_t changedSlot)
+        {
+          event_.type = action;
+          event_.actionIndex = 0;
+          event_.pointers.clear();
+          for (size_t i = 0; i < cMaxSlots; ++i)
+          {
+            if (!slots_[i].down)
+            {
+              continue;
+            }
+            if (i == changedSlot)
+            {
+              event_.actionIndex = static_cast<uint32_t>(event_.pointers.size());
+            }
+            event_.pointers.push_back(this->toVideo(i));
+          }
+          sink_(event_);
+        }
+
+        TouchPoint EvdevTouchDecoder::toVideo(size_t slot) const
+        {
+          const QPointF display((slots_[slot].x - xMin_) * xScale_, (slots_[slot].y - yMin_) * yScale_);
+          const QPoint video = geometry_.mapToVideo(display);
+          return {static_cast<uint32_t>(video.x()), static_cast<uint32_t>(video.y()), static_cast<uint32_t>(slot)};
+        }
+
+        EvdevTouchReader::EvdevTouchReader(std::string devicePath, const ProjectionGeometry &geometry)
+            : devicePath_(std::move(devicePath)), geometry_(geometry), deviceFd_(-1),
+              wakeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), stopping_(false)
+        {
+          if (wakeFd_ < 0)
+          {
+            OPENAUTO_LOG(error) << "[EvdevTouchReader] eventfd failed: " << std::strerror(errno);
+          }
+        }
+
+        EvdevTouchReader::~EvdevTouchReader()
+        {
+          this->stop();
+          if (wakeFd_ >= 0)
+          {
+            close(wakeFd_);
+          }
+        }
+
+        bool EvdevTouchReader::start(IInputDeviceEventHandler &eventHandler)
+        {
+          if (thread_.joinable())
+          {
+            return true;
+          }
+          if (wakeFd_ < 0)
+          {
+            return false;
+          }
+
+          deviceFd_ = open(devicePath_.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+          if (deviceFd_ < 0)
+          {
+            OPENAUTO_LOG(warning) << "[EvdevTouchReader] Cannot open " << devicePath_ << ": " << std::strerror(errno);
+            return false;
+          }
+
+          const bool multiTouch = hasAbsAxis(deviceFd_, ABS_MT_SLOT) && hasAbsAxis(deviceFd_, ABS_MT_POSITION_X);
+          input_absinfo xInfo{};
+          input_absinfo yInfo{};
+          if (ioctl(deviceFd_, EVIOCGABS(multiTouch ? ABS_MT_POSITION_X : ABS_X), &xInfo) < 0 ||
+              ioctl(deviceFd_, EVIOCGABS(multiTouch ? ABS_MT_POSITION_Y : ABS_Y), &yInfo) < 0)
+          {
+            OPENAUTO_LOG(warning) << "[EvdevTouchReader] " << devicePath_ << " has no touch axes";
+            close(deviceFd_);
+            deviceFd_ = -1;
+            return false;
+          }
+
+          int clock = CLOCK_MONOTONIC;
+          const bool monotonicTimes = ioctl(deviceFd_, EVIOCSCLOCKID, &clock) == 0;
+
+          if (ioctl(deviceFd_, EVIOCGRAB, 1) < 0)
+          {
+            OPENAUTO_LOG(warning) << "[EvdevTouchReader] Cannot grab " << devicePath_ << ": " << std::strerror(errno)
+                                  << ", Qt will see the touches too";
+          }
+
+          const EvdevTouchAxes axes{xInfo.minimum, xInfo.maximum, yInfo.minimum, yInfo.maximum};
+          OPENAUTO_LOG(info) << "[EvdevTouchReader] Reading " << devicePath_ << (multiTouch ? " (multitouch)" : " (single touch)")
+                             << ", x " << axes.xMin << "-" << axes.xMax << ", y " << axes.yMin << "-" << axes.yMax;
+
+          stopping_ = false;
+          thread_ = std::thread(&EvdevTouchReader::run, this, &eventHandler, axes, multiTouch, monotonicTimes);
+          return true;
+        }
+
+        void EvdevTouchReader::stop()
+        {
+          if (thread_.joinable())
+          {
+            stopping_ = true;
+            const uint64_t one = 1;
+            (void)write(wakeFd_, &one, sizeof(one));
+            thread_.join();
+          }
+
+          if (deviceFd_ >= 0)
+          {
+            ioctl(deviceFd_, EVIOCGRAB, 0);
+            close(deviceFd_);
+            deviceFd_ = -1;
+          }
+        }
+
+        void EvdevTouchReader::run(IInputDeviceEventHandler *eventHandler, EvdevTouchAxes axes, bool multiTouch,
+                                   bool monotonicTimes)
+        {
+          ThreadTopology::instance().apply(ThreadRole::Input, "oa-touch");
+
+          EvdevTouchDecoder decoder(axes, geometry_, multiTouch, monotonicTimes, [eventHandler](const TouchEvent &event)
+                                    { eventHandler->onTouchEvent(event); });
+
+          std::array<input_event, 64> events;
+          pollfd fds[2] = {{deviceFd_, POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+          bool deviceAlive = true;
+
+          while (!stopping_ && deviceAlive)
+          {
+            if (poll(fds, 2, -1) < 0)
+            {
+              if (errno == EINTR)
+              {
+                continue;
+              }
+              OPENAUTO_LOG(error) << "[EvdevTouchReader] poll failed: " << std::strerror(errno);
+              break;
+            }
+
+            if (fds[1].revents & POLLIN)
+            {
+              uint64_t count;
+              (void)read(wakeFd_, &count, sizeof(count));
+            }
+
+            if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+            {
+              deviceAlive = false;
+            }
+            else if (fds[0].revents & POLLIN)
+            {
+              // Drain everything queued; a frame may span several reads
+              for (;;)
+              {
+                const ssize_t bytes = read(deviceFd_, events.data(), sizeof(events));
+                if (bytes < 0)
+                {
+                  deviceAlive = errno == EAGAIN || errno == EINTR;
+                  break;
+                }
+                for (size_t i = 0; i < static_cast<size_t>(bytes) / sizeof(input_event); ++i)
+                {
+                  decoder.feed(events[i]);
+                }
+              }
+            }
+          }
+
+          if (!deviceAlive)
+          {
+            OPENAUTO_LOG(warning) << "[EvdevTouchReader] " << devicePath_ << " went away";
+          }
+          decoder.releaseAll();
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
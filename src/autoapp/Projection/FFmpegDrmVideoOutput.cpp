@@ -39,9 +39,9 @@
  * └──────────────┘    └────────────────────┘    └─────────────────┘
  *
  * Key Optimizations for Low Latency:
- * 1. No frame buffering - decode and display immediately
+ * 1. No frame buffering - a small bounded queue feeds a dedicated decode thread
  * 2. Zero-copy via DRM Prime (DMABUF from decoder to display)
- * 3. Direct KMS atomic modesetting for minimal display latency
+ * 3. Vsync-paced atomic page flips, always showing the newest decoded frame
  * 4. Decoder configured for low-latency operation
  *
  * Requirements:
@@ -50,6 +50,7 @@
  * - libdrm for KMS display
  *
  * Tested: 248 FPS (4.18x speed) on 720p60 H.264 stream
+ * (reproduce with the video_bench target on a recorded session)
  */
 
 #ifdef USE_FFMPEG_DRM
@@ -72,16 +73,21 @@ extern "C"
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 #include <dirent.h>
+#include <linux/dma-buf.h>
+#include <linux/videodev2.h>
+#include <poll.h>
 
 // Signal handling for clean shutdown
 #include <atomic>
 #include <signal.h>
 
 // Standard library
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <cstdlib>
@@ -89,7 +95,19 @@ extern "C"
 // OpenAuto includes
 #include <aasdk/Common/Data.hpp>
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Allocation.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
+#include <f1x/openauto/autoapp/LinkQuality.hpp>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/PipelineTrace.hpp>
+#include <f1x/openauto/autoapp/Projection/CmaBudget.hpp>
+#include <f1x/openauto/autoapp/Projection/DrmDevice.hpp>
 #include <f1x/openauto/autoapp/Projection/FFmpegDrmVideoOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/FrameGrabber.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+#include <f1x/openauto/autoapp/Projection/TouchLatencyProbe.hpp>
+#include <f1x/openauto/autoapp/Projection/YuvCopy.hpp>
 
 // ============================================================================
 // Rockchip VOP Hardware Constants
@@ -115,6 +133,39 @@ namespace f1x
     {
       namespace projection
       {
+        namespace
+        {
+          struct DecoderMetrics
+          {
+            MetricCounter &packets = Metrics::instance().counter(
+                "openauto_video_packets_total", "Video packets received from the phone");
+            MetricCounter &dropped = Metrics::instance().counter(
+                "openauto_video_packets_dropped_total", "Video packets dropped on decoder backlog");
+            MetricCounter &superseded = Metrics::instance().counter(
+                "openauto_video_frames_superseded_total", "Decoded frames replaced before reaching the screen");
+            MetricCounter &recoverySteps = Metrics::instance().counter(
+                "openauto_video_decoder_recovery_steps_total", "Flushes, reopens and device resets of a hung decoder");
+            MetricHistogram &recovery = Metrics::instance().histogram(
+                "openauto_video_decoder_recovery_ms", "Decoder hang to its next frame",
+                {250, 500, 750, 1000, 2000, 5000});
+            MetricHistogram &firstFrame = Metrics::instance().histogram(
+                "openauto_video_first_frame_ms", "First IDR of a session to its decoded frame",
+                {10, 25, 50, 100, 250, 500, 1000});
+            MetricGauge &retained = Metrics::instance().gauge(
+                "openauto_video_decoder_retained_frames", "Packets the decoder held when it returned the last frame");
+            MetricCounter &skipped = Metrics::instance().counter(
+                "openauto_video_packets_skipped_total", "Non-reference packets the decoder skipped while behind");
+            MetricCounter &offCadence = Metrics::instance().counter(
+                "openauto_video_frames_off_cadence_total", "Frames held for more or fewer vblanks than the stream's cadence");
+          };
+
+          DecoderMetrics &metrics()
+          {
+            static DecoderMetrics instance;
+            return instance;
+          }
+        }
+
         // ============================================================================
         // Signal Handler for Clean Shutdown
         // ============================================================================
@@ -130,6 +181,7 @@ namespace f1x
             return;
           }
 
+          FlightRecorder::instance().record(FlightEvent::Signal, signum);
           OPENAUTO_LOG(warning)
               << "[FFmpegDrmVideoOutput] Received signal " << signum
               << ", performing emergency cleanup to prevent CMA leaks";
@@ -190,15 +242,104 @@ namespace f1x
         uint32_t FFmpegDrmVideoOutput::cursorPlaneId_ = 0; // Set dynamically during init
         uint32_t FFmpegDrmVideoOutput::cursorBufferHandle_ = 0;
         uint32_t FFmpegDrmVideoOutput::cursorFbId_ = 0;
-        int FFmpegDrmVideoOutput::cursorX_ = 0;
-        int FFmpegDrmVideoOutput::cursorY_ = 0;
         int FFmpegDrmVideoOutput::cursorWidth_ = 64;
         int FFmpegDrmVideoOutput::cursorHeight_ = 64;
         bool FFmpegDrmVideoOutput::cursorInitialized_ = false;
         bool FFmpegDrmVideoOutput::cursorVisible_ = false;
-        bool FFmpegDrmVideoOutput::cursorEnabled_ =
-            false; // Set from configuration in init()
+        std::atomic<bool> FFmpegDrmVideoOutput::cursorEnabled_{
+            false}; // Set from configuration in init()
+        std::atomic<uint64_t> FFmpegDrmVideoOutput::cursorTarget_{0};
+        std::atomic<bool> FFmpegDrmVideoOutput::cursorShown_{false};
+        std::atomic<bool> FFmpegDrmVideoOutput::cursorDirty_{false};
+        std::atomic<bool> FFmpegDrmVideoOutput::planeLent_{false};
         std::mutex FFmpegDrmVideoOutput::cursorMutex_;
+        std::atomic<bool> FFmpegDrmVideoOutput::uiAboveVideo_{false};
+        std::function<void(bool)> FFmpegDrmVideoOutput::stackingHandler_;
+        std::mutex FFmpegDrmVideoOutput::stackingMutex_;
+
+        namespace
+        {
+          uint64_t packCursorPosition(int x, int y)
+          {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) |
+                   static_cast<uint32_t>(y);
+          }
+
+          int cursorPositionX(uint64_t packed)
+          {
+            return static_cast<int32_t>(static_cast<uint32_t>(packed >> 32));
+          }
+
+          int cursorPositionY(uint64_t packed)
+          {
+            return static_cast<int32_t>(static_cast<uint32_t>(packed));
+          }
+
+          // Packet buffers come from the tagged allocator, 64-byte aligned as
+          // av_malloc would, and count as video memory until FFmpeg drops the
+          // last reference; opaque carries the allocated size
+          constexpr size_t cPacketAlignment = 64;
+
+          void freePacketBuffer(void *opaque, uint8_t *data)
+          {
+            const size_t allocated = reinterpret_cast<uintptr_t>(opaque);
+            MemoryFootprint::instance().release(MemoryPool::Video, static_cast<int64_t>(allocated));
+            AllocationAccounting::instance().deallocate(AllocationTag::FFmpeg, data, allocated);
+          }
+
+          // Mean luma of the latency probe's square in a decoded frame, or -1.
+          // DRM PRIME frames are read through a mapping of just the rows needed
+          int probeLuma(const AVFrame *frame)
+          {
+            const QRect region = TouchLatencyProbe::instance().region(frame->width, frame->height);
+            if (region.isEmpty())
+            {
+              return -1;
+            }
+
+            // Software frames (YUV420P, NV12) start with a full-size Y plane
+            if (frame->format != AV_PIX_FMT_DRM_PRIME)
+            {
+              return TouchLatencyProbe::meanLuma(frame->data[0] + static_cast<ptrdiff_t>(region.top()) * frame->linesize[0],
+                                                 frame->linesize[0], region.translated(0, -region.top()));
+            }
+
+            const auto *desc = reinterpret_cast<const AVDRMFrameDescriptor *>(frame->data[0]);
+            if (desc == nullptr || desc->nb_layers < 1 || desc->layers[0].nb_planes < 1)
+            {
+              return -1;
+            }
+            const AVDRMPlaneDescriptor &plane = desc->layers[0].planes[0];
+            const AVDRMObjectDescriptor &object = desc->objects[plane.object_index];
+            if (object.format_modifier != DRM_FORMAT_MOD_LINEAR && object.format_modifier != DRM_FORMAT_MOD_INVALID)
+            {
+              OPENAUTO_LOG_EVERY_MS(warning, 10000)
+                  << "[FFmpegDrmVideoOutput] Latency probe cannot read tiled frames (modifier 0x" << std::hex
+                  << object.format_modifier << std::dec << ")";
+              return -1;
+            }
+
+            const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            const size_t first = static_cast<size_t>(plane.offset) + static_cast<size_t>(region.top()) * plane.pitch;
+            const size_t end = static_cast<size_t>(plane.offset) + static_cast<size_t>(region.bottom() + 1) * plane.pitch;
+            const size_t mapStart = first / page * page;
+            void *map = mmap(nullptr, end - mapStart, PROT_READ, MAP_SHARED, object.fd, static_cast<off_t>(mapStart));
+            if (map == MAP_FAILED)
+            {
+              return -1;
+            }
+
+            // Make the decoder's writes visible to the CPU for the read
+            struct dma_buf_sync sync = {DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ};
+            ioctl(object.fd, DMA_BUF_IOCTL_SYNC, &sync);
+            const int luma = TouchLatencyProbe::meanLuma(static_cast<const uint8_t *>(map) + (first - mapStart),
+                                                         static_cast<int>(plane.pitch), region.translated(0, -region.top()));
+            sync.flags = DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ;
+            ioctl(object.fd, DMA_BUF_IOCTL_SYNC, &sync);
+            munmap(map, end - mapStart);
+            return luma;
+          }
+        } // namespace
 
         // ============================================================================
         // Constructor
@@ -206,20 +347,32 @@ namespace f1x
 
         FFmpegDrmVideoOutput::FFmpegDrmVideoOutput(
             configuration::IConfiguration::Pointer configuration)
-            : VideoOutput(std::move(configuration)), isActive_(false), frameCount_(0),
-              droppedFrames_(0), codec_(nullptr), codecCtx_(nullptr), parser_(nullptr),
-              packet_(nullptr), frame_(nullptr), hwDeviceCtx_(nullptr),
-              displayedFrame_(nullptr), previousDisplayedFrame_(nullptr),
-              swsCtx_(nullptr), swDumbHandle_(0), swDumbFbId_(0), swDumbMap_(nullptr),
-              swDumbSize_(0), swDumbPitch_(0), drmFd_(-1), ownsDrmFd_(false), connectorId_(0), crtcId_(0),
-              planeId_(0), drmInitialized_(false), usingHwAccel_(false),
-              currentFbId_(0), previousFbId_(0), currentHandle_(0), previousHandle_(0),
+            : VideoOutput(std::move(configuration)),
+              lastKeyframeRequestUs_(0), frameQueueDepth_(1), requestedQueueDepth_(1),
+              nextFrameSequence_(0), scanoutSlot_(-1), retiringSlot_(-1),
+              flipPending_(false), frameRate_(30), pacer_(), grabSource_(false), supersededFrames_(0), isActive_(false), inBackground_(false), frameCount_(0), softwareFrames_(0),
+              droppedFrames_(0), parserMode_(false), currentArrivalUs_(0),
+              baselineStream_(false), firstKeyframeUs_(0), firstFrameShown_(false), codec_(nullptr), codecCtx_(nullptr), parser_(nullptr),
+              packet_(nullptr), frame_(nullptr), hwDeviceCtx_(nullptr), nativeRequested_(false),
+              connectorName_(), vpuStream_(VpuStream::Main),
+              requestDecoder_(), nativeDecoding_(false), parameterSets_(), parameterSetsSize_(0),
+              decoderWidth_(0), decoderHeight_(0),
+              swsCtx_(nullptr), swBuffers_(), swBufferIndex_(0), swFormat_(0),
+              swWidth_(0), swHeight_(0), drmFd_(-1), ownsDrmFd_(false), connectorId_(0), crtcId_(0),
+              planeId_(0), primaryPlaneId_(0), connectorModes_(), modeReplaced_(false), drmInitialized_(false), usingHwAccel_(false), codecId_(AV_CODEC_ID_H264), compositorImport_(false),
+              benchmark_(), currentFbId_(0), previousFbId_(0), fbCacheWidth_(0), fbCacheHeight_(0),
               planePropFbId_(0), planePropCrtcId_(0), planePropCrtcX_(0),
               planePropCrtcY_(0), planePropCrtcW_(0), planePropCrtcH_(0),
               planePropSrcX_(0), planePropSrcY_(0), planePropSrcW_(0),
-              planePropSrcH_(0), atomicSupported_(false)
+              planePropSrcH_(0), atomicSupported_(false), planePropRotation_(0),
+              planeRotations_(0), orientationPath_(OrientationPath::None), orientation_(),
+              planeRotation_(DRM_MODE_ROTATE_0), planeRotationRejected_(false),
+              legacyRotationSet_(false), rgaOperation_(), rgaScaling_(false),
+              rgaConversion_(false), rgaProbed_(false), cursorAtomic_(false),
+              cursorOnlyFlip_(false)
         {
           memset(&mode_, 0, sizeof(mode_));
+          memset(&replacedMode_, 0, sizeof(replacedMode_));
 
           // Install signal handlers for clean shutdown
           // This prevents CMA memory leaks during phone replugs
@@ -246,8 +399,12 @@ namespace f1x
           signal(SIGINT, SIG_DFL);
           signal(SIGTERM, SIG_DFL);
           g_instance.store(nullptr, std::memory_order_release);
+          if (grabSource_)
+          {
+            FrameGrabber::instance().setSource(nullptr);
+          }
 
-          stop();
+          shutdown();
         }
 
         // ============================================================================
@@ -259,52 +416,37 @@ namespace f1x
           // This is called from signal handler context
           // Only perform minimal, signal-safe operations
 
-          // Release displayed frame references to free DRM Prime buffers
-          if (displayedFrame_)
-          {
-            av_frame_free(&displayedFrame_);
-            displayedFrame_ = nullptr;
-          }
-
-          if (previousDisplayedFrame_)
+          // Release frame references to free DRM Prime buffers
+          for (auto &slot : frameSlots_)
           {
-            av_frame_free(&previousDisplayedFrame_);
-            previousDisplayedFrame_ = nullptr;
+            if (slot.frame)
+            {
+              av_frame_unref(slot.frame);
+            }
+            slot.state = FrameSlotState::Released;
           }
 
-          // Close GEM handles to prevent CMA leaks
+          // Remove cached framebuffers and close their GEM handles to prevent
+          // CMA leaks
           if (drmFd_ >= 0)
           {
-            if (currentHandle_ != 0)
-            {
-              struct drm_gem_close closeReq = {};
-              closeReq.handle = currentHandle_;
-              ioctl(drmFd_, DRM_IOCTL_GEM_CLOSE, &closeReq);
-              currentHandle_ = 0;
-            }
-
-            if (previousHandle_ != 0)
-            {
-              struct drm_gem_close closeReq = {};
-              closeReq.handle = previousHandle_;
-              ioctl(drmFd_, DRM_IOCTL_GEM_CLOSE, &closeReq);
-              previousHandle_ = 0;
-            }
-
-            // Remove framebuffers
-            if (currentFbId_ != 0)
+            for (auto &entry : fbCache_)
             {
-              drmModeRmFB(drmFd_, currentFbId_);
-              currentFbId_ = 0;
-            }
-
-            if (previousFbId_ != 0)
-            {
-              drmModeRmFB(drmFd_, previousFbId_);
-              previousFbId_ = 0;
+              drmModeRmFB(drmFd_, entry.second.fbId);
+              for (uint32_t handle : entry.second.handles)
+              {
+                struct drm_gem_close closeReq = {};
+                closeReq.handle = handle;
+                ioctl(drmFd_, DRM_IOCTL_GEM_CLOSE, &closeReq);
+              }
             }
+            fbCache_.clear();
+            currentFbId_ = 0;
+            previousFbId_ = 0;
           }
 
+          // The ring is already in the page cache; this starts its write-back
+          FlightRecorder::instance().flush();
           OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Emergency cleanup completed";
         }
 
@@ -319,8 +461,35 @@ namespace f1x
           OPENAUTO_LOG(info)
               << "[FFmpegDrmVideoOutput] open() - Initializing FFmpeg + DRM pipeline";
 
-          // Step 1: Initialize the DRM display first (needed for hardware context)
-          if (!initDrmDisplay())
+          // A warm software decoder already showed the compositor can't be used
+          compositorImport_ = configuration_->getVideoCompositorImport() &&
+                              (!codecCtx_ || usingHwAccel_ || requestDecoder_) && !benchmark_.headless;
+
+          // A previous session leaves the DRM display and decoder warm; only
+          // rebuild what the current configuration invalidates
+          if (displayReady() && codecCtx_ && decoderMatchesConfiguration())
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Reusing warm pipeline from "
+                                  "previous session";
+            // The last session may have handed its stream to libavcodec
+            if (usingHwAccel_ && !requestDecoder_)
+            {
+              initNativeDecoder(true);
+            }
+            return true;
+          }
+
+          if (codecCtx_)
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Video configuration changed, "
+                                  "reopening decoder";
+            cleanupDecoder();
+          }
+
+          // Step 1: Initialize the DRM display first (needed for hardware context).
+          // In compositor mode Qt keeps the display to itself.
+          if (!compositorImport_ && !benchmark_.headless && !drmInitialized_ &&
+              !initDrmDisplay())
           {
             OPENAUTO_LOG(error)
                 << "[FFmpegDrmVideoOutput] Failed to initialize DRM display";
@@ -334,11 +503,37 @@ namespace f1x
             OPENAUTO_LOG(error)
                 << "[FFmpegDrmVideoOutput] Failed to initialize FFmpeg decoder";
             cleanupDecoder();
+            cleanupHwDevice();
             cleanupDrm();
             return false;
           }
 
-          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Pipeline created successfully";
+          // EGL can only import DMA-BUFs; software frames go through the plane
+          if (compositorImport_ && !usingHwAccel_ && !requestDecoder_)
+          {
+            OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Compositor import needs "
+                                     "DRM Prime frames, using the overlay plane";
+            compositorImport_ = false;
+            if (!drmInitialized_ && !initDrmDisplay())
+            {
+              OPENAUTO_LOG(error)
+                  << "[FFmpegDrmVideoOutput] Failed to initialize DRM display";
+              cleanupDecoder();
+              cleanupHwDevice();
+              cleanupDrm();
+              return false;
+            }
+          }
+
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Pipeline created successfully"
+                             << (compositorImport_ ? " (compositor import)" : "");
+          // Snapshots show the main display; a cluster output stays out of it
+          if (vpuStream_ == VpuStream::Main && !grabSource_)
+          {
+            FrameGrabber::instance().setSource([this](GrabbedFrame &grabbed)
+                                               { return grabDisplayedFrame(grabbed); });
+            grabSource_ = true;
+          }
           return true;
         }
 
@@ -346,7 +541,7 @@ namespace f1x
         // initDecoder() - Initialize FFmpeg with DRM hardware acceleration
         // ============================================================================
 
-        bool FFmpegDrmVideoOutput::initDecoder()
+        bool FFmpegDrmVideoOutput::initDecoder(bool allowNative)
         {
           OPENAUTO_LOG(info)
               << "[FFmpegDrmVideoOutput] Initializing FFmpeg decoder with DRM hwaccel";
@@ -365,15 +560,16 @@ namespace f1x
           // - FFmpeg's DRM hwaccel framework handles negotiation with rkvdec VPU
           // - v4l2_request probe errors during init are benign and expected
 
-          // Use native h264 decoder - DRM hwaccel framework handles HW acceleration
-          codec_ = avcodec_find_decoder(AV_CODEC_ID_H264);
+          // Use native h264/hevc decoder - DRM hwaccel framework handles HW acceleration
+          codec_ = avcodec_find_decoder(codecId_);
           if (!codec_)
           {
-            OPENAUTO_LOG(error) << "[FFmpegDrmVideoOutput] No H.264 decoder available";
+            OPENAUTO_LOG(error) << "[FFmpegDrmVideoOutput] No "
+                                << avcodec_get_name(codecId_) << " decoder available";
             return false;
           }
 
-          const char *decoderName = (codec_ && codec_->name) ? codec_->name : "h264";
+          const char *decoderName = (codec_ && codec_->name) ? codec_->name : avcodec_get_name(codecId_);
           OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Using decoder: " << decoderName
                              << " with DRM hwaccel";
 
@@ -393,6 +589,33 @@ namespace f1x
           codecCtx_->thread_type = 0;                  // Disable threading
           codecCtx_->flags |= AV_CODEC_FLAG_LOW_DELAY; // Low delay mode
           codecCtx_->flags2 |= AV_CODEC_FLAG2_FAST;    // Fast decoding
+          // No reorder delay to begin with, so the first IDR comes out of the
+          // packet that carried it; an SPS with bitstream_restriction raises it
+          codecCtx_->has_b_frames = 0;
+
+          // Frame ring depth: 1 = newest frame only (lowest latency), 2-3 = queue
+          // frames FIFO for smoother pacing of bursty 1080p streams. The depth is
+          // capped by what is actually free in CMA right now.
+          CmaBudget &cma = CmaBudget::instance();
+          cma.refresh();
+          requestedQueueDepth_ = configuredFrameQueueDepth();
+          const CmaPlan cmaPlan = cma.planFor(width, height, requestedQueueDepth_);
+          frameQueueDepth_ = cmaPlan.frameQueueDepth;
+          decoderWidth_ = width;
+          decoderHeight_ = height;
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] " << cma.summary();
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] " << MemoryFootprint::instance().summary();
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Frame queue depth: "
+                             << frameQueueDepth_;
+          if (frameQueueDepth_ < requestedQueueDepth_)
+          {
+            OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Frame queue depth reduced from "
+                                  << requestedQueueDepth_ << " to fit free CMA";
+          }
+
+          // The presentation stage holds the queued frames plus the one on screen
+          // and the one it is replacing, on top of the decoder's own references
+          codecCtx_->extra_hw_frames = static_cast<int>(frameQueueDepth_ + 2);
 
           // CRITICAL: Error resilience for VPU driver negotiation
           // The RK3229 v4l2_request driver may fail initial buffer allocation (ENOBUFS)
@@ -408,7 +631,32 @@ namespace f1x
           // Set up DRM hardware device context for HW acceleration
           // This enables the DRM hwaccel path: -hwaccel drm -hwaccel_output_format
           // drm_prime The DRM framework negotiates with rkvdec VPU for hardware
-          // decoding
+          // decoding. The context outlives the decoder, so the device probe only
+          // runs once per process.
+          // rkvdec would run out of capture buffers mid-session; the software
+          // path only needs two scanout buffers. VideoModeSelector picks a
+          // resolution that fits for the next session.
+          if (benchmark_.softwareDecode)
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Software decoding requested";
+            usingHwAccel_ = false;
+          }
+          else if (!cmaPlan.hardwareFits)
+          {
+            OPENAUTO_LOG(warning)
+                << "[FFmpegDrmVideoOutput] Decoder pool of "
+                << CmaBudget::hardwareBytes(width, height, frameQueueDepth_) / (1024 * 1024)
+                << " MB does not fit into free CMA, decoding in software";
+            usingHwAccel_ = false;
+          }
+          else if (hwDeviceCtx_)
+          {
+            codecCtx_->hw_device_ctx = av_buffer_ref(hwDeviceCtx_);
+            usingHwAccel_ = true;
+            OPENAUTO_LOG(info)
+                << "[FFmpegDrmVideoOutput] Reusing DRM hardware device context";
+          }
+          else
           {
             // Create hardware device context for DRM
             // Try renderD128 first (render node), then card0 (primary node)
@@ -452,15 +700,24 @@ namespace f1x
             }
           }
 
+          // CRITICAL: Disable threading during VPU driver negotiation phase
+          // The RK3229 v4l2_request driver can crash during multi-threaded init.
+          // Without a VPU the decoder is CPU-bound, so spread it over the idle
+          // cores with slice threading; LOW_DELAY keeps frame threading (and its
+          // extra frames of latency) off.
+          int decodeThreads = 1;
+          if (!usingHwAccel_)
+          {
+            decodeThreads = softwareDecodeThreadCount();
+            codecCtx_->thread_count = decodeThreads;
+            codecCtx_->thread_type = FF_THREAD_SLICE;
+          }
+
           // Open the decoder
           // Set options for low latency
           AVDictionary *opts = nullptr;
           av_dict_set(&opts, "refcounted_frames", "1", 0);
-
-          // CRITICAL: Disable threading during VPU driver negotiation phase
-          // The RK3229 v4l2_request driver can crash during multi-threaded init
-          // We'll enable threading after first successful frame decode
-          av_dict_set(&opts, "threads", "1", 0);
+          av_dict_set_int(&opts, "threads", decodeThreads, 0);
 
           int ret = avcodec_open2(codecCtx_, codec_, &opts);
           av_dict_free(&opts);
@@ -474,15 +731,25 @@ namespace f1x
             return false;
           }
 
-          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Codec opened successfully "
-                                "(single-threaded for init)";
+          if (usingHwAccel_)
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Codec opened successfully "
+                                  "(single-threaded for init)";
+          }
+          else
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Codec opened successfully "
+                                  "(software, "
+                               << codecCtx_->thread_count << " slice threads)";
+          }
 
-          // Create H.264 parser for NAL unit framing
-          parser_ = av_parser_init(AV_CODEC_ID_H264);
+          // Create H.264/HEVC parser for NAL unit framing
+          parser_ = av_parser_init(codecId_);
           if (!parser_)
           {
             OPENAUTO_LOG(error)
-                << "[FFmpegDrmVideoOutput] Failed to initialize H.264 parser";
+                << "[FFmpegDrmVideoOutput] Failed to initialize "
+                << avcodec_get_name(codecId_) << " parser";
             return false;
           }
           // Configure parser for low latency
@@ -506,9 +773,54 @@ namespace f1x
 
           OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Decoder initialized: "
                              << codecName << ", pixel format: " << pixFmtName;
+
+          initNativeDecoder(allowNative && cmaPlan.hardwareFits && !benchmark_.softwareDecode);
           return true;
         }
 
+        // ============================================================================
+        // initNativeDecoder() - Open the V4L2 stateless decoder next to libavcodec
+        // ============================================================================
+        // The request API decoder needs no hwaccel patches in FFmpeg. libavcodec
+        // stays open for what it cannot decode (HEVC, interlaced or 10-bit H.264,
+        // no NV12 output), so a stream can move over mid-session.
+
+        void FFmpegDrmVideoOutput::initNativeDecoder(bool hardwareFits)
+        {
+          if (!nativeRequested_ || codecId_ != AV_CODEC_ID_H264 || !hardwareFits)
+          {
+            return;
+          }
+
+          // Same budget as the hwaccel pool: the queue, the picture on screen
+          // and the one it replaces, on top of the DPB
+          auto decoder = std::make_unique<V4l2RequestDecoder>(frameQueueDepth_ + 2);
+          if (!decoder->open())
+          {
+            OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Native decoder unavailable, "
+                                     "using the FFmpeg hwaccel";
+            return;
+          }
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Native V4L2 request decoder on "
+                             << decoder->deviceName();
+          requestDecoder_ = std::move(decoder);
+        }
+
+        // ============================================================================
+        // softwareDecodeThreadCount() - Size slice threading to the spare cores
+        // ============================================================================
+
+        int FFmpegDrmVideoOutput::softwareDecodeThreadCount()
+        {
+          // hardware_concurrency() may return 0 when the count is unknown
+          const unsigned cores = std::thread::hardware_concurrency();
+          if (cores <= cReservedDecodeCores)
+          {
+            return 1;
+          }
+          return static_cast<int>(cores - cReservedDecodeCores);
+        }
+
         // ============================================================================
         // initDrmDisplay() - Initialize DRM/KMS for direct display output
         // ============================================================================
@@ -605,7 +917,7 @@ namespace f1x
             return false;
           }
 
-          // Find a connected connector (prefer HDMI)
+          // The configured connector, or the first connected one
           drmModeConnector *connector = nullptr;
           for (int i = 0; i < resources->count_connectors; i++)
           {
@@ -613,7 +925,8 @@ namespace f1x
                 drmModeGetConnector(drmFd_, resources->connectors[i]);
             if (conn)
             {
-              if (conn->connection == DRM_MODE_CONNECTED)
+              if (conn->connection == DRM_MODE_CONNECTED &&
+                  (connectorName_.empty() || drmdevice::connectorName(conn) == connectorName_))
               {
                 connector = conn;
                 connectorId_ = conn->connector_id;
@@ -628,7 +941,8 @@ namespace f1x
 
           if (!connector)
           {
-            OPENAUTO_LOG(error) << "[FFmpegDrmVideoOutput] No connected display found";
+            OPENAUTO_LOG(error) << "[FFmpegDrmVideoOutput] No connected display found"
+                                << (connectorName_.empty() ? std::string() : " on " + connectorName_);
             drmModeFreeResources(resources);
             return false;
           }
@@ -650,6 +964,8 @@ namespace f1x
             OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Display mode: "
                                << mode_.hdisplay << "x" << mode_.vdisplay << "@"
                                << mode_.vrefresh << "Hz";
+            // Candidates for a refresh that suits the stream, see setupPresentationCadence()
+            connectorModes_.assign(connector->modes, connector->modes + connector->count_modes);
           }
           else
           {
@@ -700,6 +1016,8 @@ namespace f1x
           uint32_t foundPrimaryPlane = 0;
           uint32_t foundCursorPlane = 0;
 
+          // CRTC index 0 when the mask cannot be read
+          const uint32_t crtcMask = std::max<uint32_t>(1, drmdevice::crtcMask(drmFd_, crtcId_));
           drmModePlaneResPtr planeRes = drmModeGetPlaneResources(drmFd_);
           if (planeRes)
           {
@@ -712,7 +1030,7 @@ namespace f1x
                 continue;
 
               // Check if this plane can be used with our CRTC
-              if (!(plane->possible_crtcs & (1 << 0))) // Assuming CRTC index 0
+              if (!(plane->possible_crtcs & crtcMask))
               {
                 drmModeFreePlane(plane);
                 continue;
@@ -790,6 +1108,8 @@ namespace f1x
             return false;
           }
 
+          primaryPlaneId_ = foundPrimaryPlane;
+
           // Set cursor plane (static member for cursor API)
           if (foundCursorPlane != 0)
           {
@@ -805,6 +1125,12 @@ namespace f1x
           // Setup BT.709 color encoding on the plane to prevent purple/green tint
           setupColorEncoding();
 
+          // Resolve plane property IDs so presentation can use atomic page flips
+          setupAtomicProperties();
+
+          // Qt's plane above the video lets QML overlays show over the projection
+          publishStacking(planeId_ != primaryPlaneId_ && setupPlaneStacking());
+
           drmInitialized_ = true;
           OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] DRM initialized - connector: "
                              << connectorId_ << ", CRTC: " << crtcId_
@@ -905,7 +1231,7 @@ namespace f1x
                                      "COLOR_ENCODING enum";
           }
 
-          // Note: We use legacy drmModeSetPlane API (not atomic) since we take DRM master
+          // Note: COLOR_ENCODING is set once here; per-frame updates go through commitPlane()
         }
 
         // ============================================================================
@@ -976,6 +1302,17 @@ namespace f1x
                 break;
               }
             }
+
+            // Optional: which turns and mirrors the VOP can do at scanout
+            if (strcmp(prop->name, "rotation") == 0 && (prop->flags & DRM_MODE_PROP_BITMASK))
+            {
+              planePropRotation_ = prop->prop_id;
+              planeRotations_ = 0;
+              for (int e = 0; e < prop->count_enums; e++)
+              {
+                planeRotations_ |= 1ull << prop->enums[e].value;
+              }
+            }
             drmModeFreeProperty(prop);
           }
 
@@ -1000,172 +1337,1960 @@ namespace f1x
         }
 
         // ============================================================================
-        // init() - Start the pipeline
+        // setupPlaneStacking() - Put Qt's primary plane above the video plane
+        // ============================================================================
+        // By default the VOP stacks the overlay plane, and so the video, above
+        // the primary plane Qt eglfs renders into, which leaves every QML
+        // overlay hidden during projection. With the video plane moved below
+        // and per-pixel alpha on the primary, a transparent QML window lets
+        // the video through and the VOP blends the overlays at scanout, with no
+        // GPU work for the video itself. zpos is mutable on some Rockchip
+        // kernels only, so every step checks what the driver allows.
         // ============================================================================
 
-        bool FFmpegDrmVideoOutput::init()
+        bool FFmpegDrmVideoOutput::setupPlaneStacking()
         {
-          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          if (drmFd_ < 0 || planeId_ == 0 || primaryPlaneId_ == 0)
+          {
+            return false;
+          }
 
-          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] init() - Starting pipeline";
+          struct PlaneBlending
+          {
+            uint32_t blendModePropId = 0;
+            uint64_t premultiplied = 0;
+            bool hasPremultiplied = false;
+            uint32_t alphaPropId = 0;
+            uint64_t alphaMax = 0;
+          };
 
-          if (!codecCtx_ || !drmInitialized_)
+          auto readPlane = [this](uint32_t plane, PlaneZpos &zpos, PlaneBlending *blending)
           {
-            OPENAUTO_LOG(error)
-                << "[FFmpegDrmVideoOutput] Cannot init - not properly opened";
+            zpos = PlaneZpos();
+            drmModeObjectPropertiesPtr props =
+                drmModeObjectGetProperties(drmFd_, plane, DRM_MODE_OBJECT_PLANE);
+            if (!props)
+            {
+              return;
+            }
+
+            for (uint32_t i = 0; i < props->count_props; i++)
+            {
+              drmModePropertyPtr prop = drmModeGetProperty(drmFd_, props->props[i]);
+              if (!prop)
+                continue;
+
+              if (strcmp(prop->name, "zpos") == 0 && prop->count_values >= 2)
+              {
+                zpos.propId = prop->prop_id;
+                zpos.value = props->prop_values[i];
+                zpos.min = prop->values[0];
+                zpos.max = prop->values[1];
+                zpos.immutable = (prop->flags & DRM_MODE_PROP_IMMUTABLE) != 0;
+              }
+              else if (blending && strcmp(prop->name, "pixel blend mode") == 0)
+              {
+                blending->blendModePropId = prop->prop_id;
+                for (int j = 0; j < prop->count_enums; j++)
+                {
+                  if (strcmp(prop->enums[j].name, "Pre-multiplied") == 0)
+                  {
+                    blending->premultiplied = prop->enums[j].value;
+                    blending->hasPremultiplied = true;
+                  }
+                }
+              }
+              else if (blending && strcmp(prop->name, "alpha") == 0 && prop->count_values >= 2)
+              {
+                blending->alphaPropId = prop->prop_id;
+                blending->alphaMax = prop->values[1];
+              }
+              drmModeFreeProperty(prop);
+            }
+            drmModeFreeObjectProperties(props);
+          };
+
+          PlaneBlending blending;
+          readPlane(planeId_, videoZpos_, nullptr);
+          readPlane(primaryPlaneId_, primaryZpos_, &blending);
+
+          if (videoZpos_.propId == 0 || primaryZpos_.propId == 0)
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Planes have no zpos property, "
+                                  "QML overlays stay below the video";
             return false;
           }
 
-          if (isActive_.load())
+          // An opaque primary above the video would black it out entirely
+          drmModePlanePtr primary = drmModeGetPlane(drmFd_, primaryPlaneId_);
+          uint32_t primaryFormat = 0;
+          if (primary)
           {
-            OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Already active";
-            return true;
+            if (primary->fb_id != 0)
+            {
+              drmModeFB2Ptr fb = drmModeGetFB2(drmFd_, primary->fb_id);
+              if (fb)
+              {
+                primaryFormat = fb->pixel_format;
+                drmModeFreeFB2(fb);
+              }
+            }
+            drmModeFreePlane(primary);
+          }
+          if (primaryFormat != DRM_FORMAT_ARGB8888 && primaryFormat != DRM_FORMAT_ABGR8888)
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Qt's framebuffer has no alpha "
+                                  "(set \"format\": \"argb8888\" in eglfs.json), "
+                                  "QML overlays stay below the video";
+            return false;
           }
 
-          isActive_.store(true);
-          frameCount_ = 0;
+          // Lowest zpos for the video, then the primary strictly above it;
+          // either may be fixed by the driver
+          uint64_t videoZ = videoZpos_.immutable ? videoZpos_.value : videoZpos_.min;
+          uint64_t primaryZ = primaryZpos_.value;
+          if (!primaryZpos_.immutable && primaryZ <= videoZ)
+          {
+            primaryZ = std::min(std::max(videoZ + 1, primaryZpos_.min), primaryZpos_.max);
+          }
+          if (primaryZ <= videoZ)
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] zpos of plane " << planeId_
+                               << " (" << videoZpos_.min << "-" << videoZpos_.max
+                               << (videoZpos_.immutable ? ", fixed" : "") << ") and plane "
+                               << primaryPlaneId_ << " (" << primaryZpos_.min << "-"
+                               << primaryZpos_.max << (primaryZpos_.immutable ? ", fixed" : "")
+                               << ") can't be reordered, QML overlays stay below the video";
+            return false;
+          }
 
-          // Initialize cursor based on configuration
-          // cursorEnabled_ controls whether DRM hardware cursor is active
-          cursorEnabled_ = configuration_->showCursor();
-          if (cursorEnabled_)
+          auto setZpos = [this](uint32_t plane, PlaneZpos &zpos, uint64_t value)
           {
-            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Cursor enabled in "
-                                  "configuration, initializing DRM cursor";
-            initCursor();
+            if (zpos.value == value)
+            {
+              return true;
+            }
+            int ret = drmModeObjectSetProperty(drmFd_, plane, DRM_MODE_OBJECT_PLANE,
+                                               zpos.propId, value);
+            if (ret != 0)
+            {
+              OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Failed to set zpos "
+                                    << value << " on plane " << plane << ": " << strerror(-ret);
+              return false;
+            }
+            zpos.changed = true;
+            return true;
+          };
+
+          if (!setZpos(planeId_, videoZpos_, videoZ) ||
+              !setZpos(primaryPlaneId_, primaryZpos_, primaryZ))
+          {
+            restorePlaneStacking();
+            return false;
           }
-          else
+
+          // Qt Quick renders premultiplied; "Coverage" would darken the edges
+          if (blending.blendModePropId != 0 && blending.hasPremultiplied)
           {
-            OPENAUTO_LOG(info)
-                << "[FFmpegDrmVideoOutput] Cursor disabled in configuration";
+            drmModeObjectSetProperty(drmFd_, primaryPlaneId_, DRM_MODE_OBJECT_PLANE,
+                                     blending.blendModePropId, blending.premultiplied);
+          }
+          if (blending.alphaPropId != 0)
+          {
+            drmModeObjectSetProperty(drmFd_, primaryPlaneId_, DRM_MODE_OBJECT_PLANE,
+                                     blending.alphaPropId, blending.alphaMax);
           }
 
-          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Pipeline started successfully";
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Video plane " << planeId_
+                             << " at zpos " << videoZ << " below Qt plane "
+                             << primaryPlaneId_ << " at zpos " << primaryZ;
           return true;
         }
 
-        // ============================================================================
-        // write() - Decode and display H.264 frame
-        // ============================================================================
-
-        void FFmpegDrmVideoOutput::write(uint64_t timestamp,
-                                         const aasdk::common::DataConstBuffer &buffer)
+        void FFmpegDrmVideoOutput::restorePlaneStacking()
         {
-          std::lock_guard<decltype(mutex_)> lock(mutex_);
-
-          if (!isActive_.load() || !codecCtx_)
+          if (drmFd_ < 0)
           {
             return;
           }
 
-          if (buffer.size == 0 || buffer.cdata == nullptr)
+          for (auto plane : {std::make_pair(primaryPlaneId_, &primaryZpos_),
+                             std::make_pair(planeId_, &videoZpos_)})
           {
-            OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Received empty buffer";
-            return;
+            PlaneZpos &zpos = *plane.second;
+            if (zpos.changed)
+            {
+              drmModeObjectSetProperty(drmFd_, plane.first, DRM_MODE_OBJECT_PLANE,
+                                       zpos.propId, zpos.value);
+              zpos.changed = false;
+            }
           }
+        }
 
-          // Debug logging for first frames
-          if (frameCount_ < 5)
+        void FFmpegDrmVideoOutput::setupPresentationCadence()
+        {
+          // What the CRTC scans out now; Qt may not have set the preferred mode
+          drmModeModeInfo current = mode_;
+          drmModeCrtcPtr crtc = drmModeGetCrtc(drmFd_, crtcId_);
+          if (crtc)
           {
-            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Frame " << frameCount_
-                               << " - size: " << buffer.size << " bytes";
+            if (crtc->mode_valid)
+            {
+              current = crtc->mode;
+            }
+            drmModeFreeCrtc(crtc);
           }
 
-          // Parse and decode the H.264 data
-          const uint8_t *data = buffer.cdata;
-          int dataSize = static_cast<int>(buffer.size);
-
-          while (dataSize > 0)
+          if (!modeReplaced_ && atomicSupported_ &&
+              PresentationPacer::cadenceFor(frameRate_, drmdevice::refreshMilliHz(current)) == 0)
           {
-            // Parse NAL units
-            int parsedLen =
-                av_parser_parse2(parser_, codecCtx_, &packet_->data, &packet_->size,
-                                 data, dataSize, AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0);
-            if (parsedLen < 0)
+            // Only modes of the same size: Qt's framebuffer stays on the primary plane
+            std::vector<drmModeModeInfo> candidates{current};
+            for (const auto &mode : connectorModes_)
             {
-              OPENAUTO_LOG(error) << "[FFmpegDrmVideoOutput] Parser error";
-              break;
+              if (mode.hdisplay == current.hdisplay && mode.vdisplay == current.vdisplay &&
+                  !(mode.flags & DRM_MODE_FLAG_INTERLACE))
+              {
+                candidates.push_back(mode);
+              }
             }
 
-            data += parsedLen;
-            dataSize -= parsedLen;
+            std::vector<uint32_t> refresh;
+            for (const auto &mode : candidates)
+            {
+              refresh.push_back(drmdevice::refreshMilliHz(mode));
+            }
 
-            if (packet_->size > 0)
+            const size_t chosen = PresentationPacer::chooseRefresh(refresh, 0, frameRate_);
+            if (chosen != 0)
             {
-              // Send packet to decoder
-              int ret = avcodec_send_packet(codecCtx_, packet_);
-              if (ret < 0)
+              if (commitCrtcMode(candidates[chosen]))
               {
-                if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
-                {
-                  char errBuf[256];
-                  av_strerror(ret, errBuf, sizeof(errBuf));
-                  OPENAUTO_LOG(warning)
-                      << "[FFmpegDrmVideoOutput] Send packet error: " << errBuf;
-                }
-                continue;
+                OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Switched CRTC " << crtcId_ << " from "
+                                   << refresh[0] / 1000.0 << " Hz to " << refresh[chosen] / 1000.0
+                                   << " Hz for " << frameRate_ << " fps";
+                replacedMode_ = current;
+                modeReplaced_ = true;
+                current = candidates[chosen];
               }
+            }
+          }
 
-              // Receive decoded frames
-              while (true)
-              {
-                ret = avcodec_receive_frame(codecCtx_, frame_);
+          pacer_.configure(frameRate_, drmdevice::refreshMilliHz(current));
+          if (pacer_.cadence() != 0 && atomicSupported_)
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Presenting " << frameRate_ << " fps at "
+                               << pacer_.cadence() << " vblank(s) per frame";
+          }
+          else
+          {
+            // Legacy SetPlane has no flip events to measure the vblank clock from
+            pacer_.configure(frameRate_, 0);
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] " << frameRate_ << " fps at "
+                               << drmdevice::refreshMilliHz(current) / 1000.0
+                               << " Hz presented unpaced";
+          }
+        }
 
-                // VPU driver negotiation phase: EAGAIN and ENOBUFS are expected during
-                // init These are NOT errors - the driver is still setting up the format
-                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ||
-                    ret == AVERROR(ENOBUFS) || ret == -105)
-                {
-                  // Silently break and wait for next packet (normal behavior during
-                  // negotiation)
-                  break;
-                }
+        bool FFmpegDrmVideoOutput::commitCrtcMode(const drmModeModeInfo &mode)
+        {
+          const uint32_t modeIdProp = drmdevice::propertyId(drmFd_, crtcId_, DRM_MODE_OBJECT_CRTC, "MODE_ID");
+          const uint32_t activeProp = drmdevice::propertyId(drmFd_, crtcId_, DRM_MODE_OBJECT_CRTC, "ACTIVE");
+          if (modeIdProp == 0 || activeProp == 0)
+          {
+            return false;
+          }
 
-                if (ret < 0)
-                {
-                  char errBuf[256];
-                  av_strerror(ret, errBuf, sizeof(errBuf));
-                  OPENAUTO_LOG(warning)
-                      << "[FFmpegDrmVideoOutput] Receive frame error: " << errBuf;
-                  break;
-                }
+          uint32_t blobId = 0;
+          if (drmModeCreatePropertyBlob(drmFd_, &mode, sizeof(mode), &blobId) != 0)
+          {
+            return false;
+          }
 
-                // Validate frame dimensions before attempting to display
-                // This prevents crashes when driver hasn't fully negotiated format yet
-                if (frame_->width <= 0 || frame_->height <= 0)
-                {
-                  if (frameCount_ < 5)
-                  {
-                    OPENAUTO_LOG(warning)
-                        << "[FFmpegDrmVideoOutput] Invalid frame dimensions: "
-                        << frame_->width << "x" << frame_->height;
-                  }
-                  av_frame_unref(frame_);
-                  break;
+          int ret = -ENOMEM;
+          drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+          if (req)
+          {
+            drmModeAtomicAddProperty(req, crtcId_, modeIdProp, blobId);
+            drmModeAtomicAddProperty(req, crtcId_, activeProp, 1);
+            ret = drmModeAtomicCommit(drmFd_, req, DRM_MODE_ATOMIC_ALLOW_MODESET, nullptr);
+            drmModeAtomicFree(req);
+          }
+          // The CRTC state holds its own reference to the blob
+          drmModeDestroyPropertyBlob(drmFd_, blobId);
+
+          if (ret != 0)
+          {
+            OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Modeset of CRTC " << crtcId_ << " to "
+                                  << mode.hdisplay << "x" << mode.vdisplay << "@" << mode.vrefresh
+                                  << " failed: " << strerror(-ret);
+            return false;
+          }
+          return true;
+        }
+
+        void FFmpegDrmVideoOutput::restoreCrtcMode()
+        {
+          if (!modeReplaced_ || drmFd_ < 0)
+          {
+            return;
+          }
+
+          modeReplaced_ = false;
+          if (commitCrtcMode(replacedMode_))
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Restored CRTC " << crtcId_ << " to "
+                               << drmdevice::refreshMilliHz(replacedMode_) / 1000.0 << " Hz";
+          }
+        }
+
+        bool FFmpegDrmVideoOutput::uiAboveVideo()
+        {
+          return uiAboveVideo_.load(std::memory_order_acquire);
+        }
+
+        void FFmpegDrmVideoOutput::setStackingHandler(std::function<void(bool uiAboveVideo)> handler)
+        {
+          std::lock_guard<std::mutex> lock(stackingMutex_);
+          stackingHandler_ = std::move(handler);
+        }
+
+        void FFmpegDrmVideoOutput::publishStacking(bool uiAboveVideo)
+        {
+          if (uiAboveVideo_.exchange(uiAboveVideo, std::memory_order_acq_rel) == uiAboveVideo)
+          {
+            return;
+          }
+
+          std::lock_guard<std::mutex> lock(stackingMutex_);
+          if (stackingHandler_)
+          {
+            stackingHandler_(uiAboveVideo);
+          }
+        }
+
+        // ============================================================================
+        // init() - Start the pipeline
+        // ============================================================================
+
+        bool FFmpegDrmVideoOutput::init()
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] init() - Starting pipeline";
+
+          if (!codecCtx_ || !displayReady())
+          {
+            OPENAUTO_LOG(error)
+                << "[FFmpegDrmVideoOutput] Cannot init - not properly opened";
+            return false;
+          }
+
+          if (isActive_.load())
+          {
+            OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Already active";
+            return true;
+          }
+
+          // Frame ring: queued frames + the one on screen + the one it replaces
+          releaseAllFrameSlots();
+          for (size_t i = 0; i < frameQueueDepth_ + 2; i++)
+          {
+            AVFrame *slotFrame = av_frame_alloc();
+            if (!slotFrame)
+            {
+              OPENAUTO_LOG(error) << "[FFmpegDrmVideoOutput] Failed to allocate frame ring";
+              releaseAllFrameSlots();
+              return false;
+            }
+            frameSlots_.push_back(FrameSlot{slotFrame, FrameSlotState::Released, 0, {}});
+          }
+          flipPending_ = false;
+          supersededFrames_ = 0;
+          nextFrameSequence_ = 0;
+
+          isActive_.store(true);
+          frameCount_ = 0;
+          softwareFrames_ = 0;
+          nativeDecoding_ = false;
+          droppedFrames_ = 0;
+          parserMode_ = false;
+          dropPolicy_.reset();
+          inFlightPackets_.clear();
+          watchdog_.reset();
+          baselineStream_ = false;
+          firstKeyframeUs_ = 0;
+          firstFrameShown_ = false;
+          VideoTelemetry::instance().reset();
+
+          // Initialize cursor based on configuration
+          // cursorEnabled_ controls whether DRM hardware cursor is active
+          // (Qt draws its own cursor over the video in compositor mode)
+          cursorEnabled_ = configuration_->showCursor() && !compositorImport_ &&
+                           !benchmark_.headless;
+          if (cursorEnabled_)
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Cursor enabled in "
+                                  "configuration, initializing DRM cursor";
+            initCursor();
+          }
+          else
+          {
+            OPENAUTO_LOG(info)
+                << "[FFmpegDrmVideoOutput] Cursor disabled in configuration";
+          }
+
+          // Decoding and presentation run on their own threads from here on;
+          // write() only queues. The scene graph paces itself in compositor mode.
+          if (!compositorImport_ && !benchmark_.headless)
+          {
+            setupPresentationCadence();
+            presentThread_ = std::thread(&FFmpegDrmVideoOutput::presentLoop, this);
+          }
+          VpuScheduler::instance().attach(vpuStream_);
+          decodeThread_ = std::thread(&FFmpegDrmVideoOutput::decodeLoop, this);
+
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Pipeline started successfully";
+          return true;
+        }
+
+        // ============================================================================
+        // write() - Queue H.264 frame for the decode thread
+        // ============================================================================
+        // Called on the aasdk strand. We only copy the buffer and wake the decode
+        // thread, so the media ACK goes back to the phone without waiting for
+        // rkvdec or the display.
+
+        void FFmpegDrmVideoOutput::write(uint64_t timestamp,
+                                         const aasdk::common::DataConstBuffer &buffer)
+        {
+          OPENAUTO_TRACE_SCOPE("video.write");
+          // Every frame that is not queued hands its credit straight back
+          if (!isActive_.load())
+          {
+            notifyFramesConsumed(1);
+            return;
+          }
+
+          if (buffer.size == 0 || buffer.cdata == nullptr)
+          {
+            OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Received empty buffer";
+            notifyFramesConsumed(1);
+            return;
+          }
+
+          // Single copy out of the aasdk buffer, padded as the decoder requires. The
+          // decode thread passes this buffer to FFmpeg by reference.
+          const int64_t arrivalUs = VideoTelemetry::nowUs();
+          const size_t allocated = buffer.size + AV_INPUT_BUFFER_PADDING_SIZE;
+          uint8_t *data = static_cast<uint8_t *>(
+              AllocationAccounting::instance().allocate(AllocationTag::FFmpeg, allocated, cPacketAlignment));
+          AVBufferRef *ref = data ? av_buffer_create(data, allocated, freePacketBuffer,
+                                                     reinterpret_cast<void *>(allocated), 0)
+                                  : nullptr;
+          if (!ref)
+          {
+            AllocationAccounting::instance().deallocate(AllocationTag::FFmpeg, data, allocated);
+            OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Failed to allocate packet buffer";
+            notifyFramesConsumed(1);
+            return;
+          }
+          MemoryFootprint::instance().add(MemoryPool::Video, static_cast<int64_t>(allocated));
+          memcpy(ref->data, buffer.cdata, buffer.size);
+          memset(ref->data + buffer.size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+          const AccessUnitInfo info = inspectAccessUnit(buffer.cdata, buffer.size, codecId_ == AV_CODEC_ID_HEVC);
+          BufferRefPtr packetBuffer(ref);
+
+          size_t dropped = 0;
+          bool requestKeyframe = false;
+          KeyframeRequestHandler keyframeHandler;
+          {
+            std::lock_guard<decltype(queueMutex_)> lock(queueMutex_);
+
+            const LinkState link = LinkQuality::instance().state();
+            if (dropPolicy_.admit(packetQueue_, info, link == LinkState::Degraded || link == LinkState::Poor,
+                                  dropped, requestKeyframe))
+            {
+              packetQueue_.push_back(PendingPacket{timestamp, std::move(packetBuffer),
+                                                   static_cast<int>(buffer.size),
+                                                   arrivalUs, info});
+            }
+            else
+            {
+              dropped++;
+            }
+
+            if (dropped > 0)
+            {
+              const uint64_t before = droppedFrames_;
+              droppedFrames_ += dropped;
+              metrics().dropped.add(dropped);
+              for (size_t i = 0; i < dropped; i++)
+              {
+                VideoTelemetry::instance().recordDroppedPacket();
+              }
+              // Log the first drop and then about every 30
+              if (before == 0 || before / 30 != droppedFrames_ / 30)
+              {
+                OPENAUTO_LOG(warning)
+                    << "[FFmpegDrmVideoOutput] Decoder backlog, dropped "
+                    << droppedFrames_ << " packets so far";
+              }
+            }
+
+            if (requestKeyframe && arrivalUs - lastKeyframeRequestUs_ >= cKeyframeRequestIntervalUs)
+            {
+              lastKeyframeRequestUs_ = arrivalUs;
+              keyframeHandler = keyframeRequestHandler_;
+            }
+          }
+
+          queueCondition_.notify_one();
+          notifyFramesConsumed(dropped);
+
+          if (keyframeHandler)
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Requesting keyframe from phone";
+            keyframeHandler();
+          }
+        }
+
+        // ============================================================================
+        // hevcHardwareAvailable() - Is there a VPU that decodes H.265?
+        // ============================================================================
+
+        bool FFmpegDrmVideoOutput::hevcHardwareAvailable()
+        {
+          static const bool available = []()
+          {
+            // FFmpeg must route hevc through the DRM hwaccel (v4l2_request)...
+            const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_HEVC);
+            bool hwaccel = false;
+            for (int i = 0; codec != nullptr && !hwaccel; i++)
+            {
+              const AVCodecHWConfig *config = avcodec_get_hw_config(codec, i);
+              if (config == nullptr)
+              {
+                break;
+              }
+              hwaccel = config->device_type == AV_HWDEVICE_TYPE_DRM &&
+                        (config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) != 0;
+            }
+            if (!hwaccel)
+            {
+              OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] HEVC: no DRM hwaccel in this FFmpeg";
+              return false;
+            }
+
+            // ...and the kernel must expose a stateless decoder taking HEVC
+            // slices (rkvdec on RK3328/RK3399, hantro, cedrus)
+#ifndef V4L2_PIX_FMT_HEVC_SLICE
+#define V4L2_PIX_FMT_HEVC_SLICE v4l2_fourcc('S', '2', '6', '5')
+#endif
+            for (int index = 0; index < 16; index++)
+            {
+              const std::string path = "/dev/video" + std::to_string(index);
+              const int fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+              if (fd < 0)
+              {
+                continue;
+              }
+
+              bool found = false;
+              v4l2_fmtdesc format = {};
+              format.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+              while (!found && ioctl(fd, VIDIOC_ENUM_FMT, &format) == 0)
+              {
+                found = format.pixelformat == V4L2_PIX_FMT_HEVC_SLICE;
+                format.index++;
+              }
+              ::close(fd);
+
+              if (found)
+              {
+                OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] HEVC hardware decode on " << path;
+                return true;
+              }
+            }
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] HEVC: no V4L2 stateless HEVC decoder";
+            return false;
+          }();
+          return available;
+        }
+
+        bool FFmpegDrmVideoOutput::supportsCodec(
+            aap_protobuf::service::media::shared::message::MediaCodecType codec) const
+        {
+          using aap_protobuf::service::media::shared::message::MediaCodecType;
+          return codec == MediaCodecType::MEDIA_CODEC_VIDEO_H264_BP ||
+                 (codec == MediaCodecType::MEDIA_CODEC_VIDEO_H265 && hevcHardwareAvailable());
+        }
+
+        bool FFmpegDrmVideoOutput::setCodec(aap_protobuf::service::media::shared::message::MediaCodecType codec)
+        {
+          if (!supportsCodec(codec))
+          {
+            return false;
+          }
+
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          const AVCodecID codecId =
+              codec == aap_protobuf::service::media::shared::message::MediaCodecType::MEDIA_CODEC_VIDEO_H265
+                  ? AV_CODEC_ID_HEVC
+                  : AV_CODEC_ID_H264;
+          if (codecId == codecId_)
+          {
+            return true;
+          }
+
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Switching decoder to "
+                             << avcodec_get_name(codecId);
+          codecId_ = codecId;
+          // open() ran before the phone picked the codec; the decode thread
+          // only starts in init(), so the decoder can be swapped here
+          if (codecCtx_)
+          {
+            cleanupDecoder();
+            if (!initDecoder())
+            {
+              OPENAUTO_LOG(error) << "[FFmpegDrmVideoOutput] Failed to initialize "
+                                  << avcodec_get_name(codecId) << " decoder";
+              cleanupDecoder();
+              return false;
+            }
+          }
+          return true;
+        }
+
+        void FFmpegDrmVideoOutput::setKeyframeRequestHandler(KeyframeRequestHandler handler)
+        {
+          std::lock_guard<decltype(queueMutex_)> lock(queueMutex_);
+          keyframeRequestHandler_ = std::move(handler);
+        }
+
+        void FFmpegDrmVideoOutput::setBenchmarkOptions(const BenchmarkOptions &options)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          benchmark_ = options;
+        }
+
+        void FFmpegDrmVideoOutput::setNativeDecoder(bool enabled)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          nativeRequested_ = enabled;
+        }
+
+        void FFmpegDrmVideoOutput::setDisplay(const std::string &connector, VpuStream stream)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          connectorName_ = connector;
+          vpuStream_ = stream;
+        }
+
+        bool FFmpegDrmVideoOutput::isHardwareDecoding() const
+        {
+          return (usingHwAccel_ || nativeDecoding_.load()) && softwareFrames_.load() == 0;
+        }
+
+        bool FFmpegDrmVideoOutput::isNativeDecoding() const
+        {
+          return nativeDecoding_.load() && softwareFrames_.load() == 0 && requestDecoder_ != nullptr;
+        }
+
+        void FFmpegDrmVideoOutput::setProjectionGeometry(const ProjectionGeometry &geometry)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          geometry_ = geometry;
+          planeRects_ = PlaneRects{};
+          rgaScaling_ = false;
+          DmaBufFrameExchange::instance().setGeometry(geometry);
+        }
+
+        void FFmpegDrmVideoOutput::setFrameRate(uint32_t fps)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          frameRate_ = fps;
+        }
+
+        // ============================================================================
+        // setFrameConsumedHandler() - Release media credits from queue depth
+        // ============================================================================
+
+        bool FFmpegDrmVideoOutput::setFrameConsumedHandler(FrameConsumedHandler handler)
+        {
+          std::lock_guard<decltype(queueMutex_)> lock(queueMutex_);
+          frameConsumedHandler_ = std::move(handler);
+          return true;
+        }
+
+        void FFmpegDrmVideoOutput::notifyFramesConsumed(size_t count)
+        {
+          if (count == 0)
+          {
+            return;
+          }
+
+          FrameConsumedHandler handler;
+          {
+            std::lock_guard<decltype(queueMutex_)> lock(queueMutex_);
+            handler = frameConsumedHandler_;
+          }
+
+          if (handler)
+          {
+            for (size_t i = 0; i < count; i++)
+            {
+              handler();
+            }
+          }
+        }
+
+        // ============================================================================
+        // decodeLoop() - Decode thread body
+        // ============================================================================
+
+        void FFmpegDrmVideoOutput::decodeLoop()
+        {
+          ThreadTopology::instance().apply(ThreadRole::VideoDecode, "oa-vdecode");
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Decode thread started";
+
+          while (true)
+          {
+            PendingPacket packet;
+            bool behind = false;
+            {
+              std::unique_lock<decltype(queueMutex_)> lock(queueMutex_);
+              queueCondition_.wait(lock, [this]()
+                                   { return !isActive_.load() || !packetQueue_.empty(); });
+
+              if (!isActive_.load())
+              {
+                break;
+              }
+
+              packet = std::move(packetQueue_.front());
+              packetQueue_.pop_front();
+              behind = packetQueue_.size() >= cSkipBacklogPackets;
+            }
+
+            // The queue slot is free again, so the phone may send the next frame
+            // while this one decodes
+            notifyFramesConsumed(1);
+
+            // Behind, non-reference pictures stay out of the decoder altogether;
+            // skip_frame is honoured before a hwaccel sees the slice
+            if (codecCtx_)
+            {
+              codecCtx_->skip_frame = behind ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+              if (behind && packet.info.hasSlices && !packet.info.reference)
+              {
+                metrics().skipped.add();
+              }
+            }
+
+            // Parameter sets always go through; pictures share rkvdec with the
+            // other streams
+            if (!packet.info.hasSlices)
+            {
+              decodePacket(packet);
+            }
+            else if (VpuScheduler::instance().admit(vpuStream_, packet.info.keyframe, packet.info.reference,
+                                                    VideoTelemetry::nowUs()))
+            {
+              decodePacket(packet);
+              VpuScheduler::instance().finished(vpuStream_, VideoTelemetry::nowUs());
+            }
+          }
+
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Decode thread exiting";
+        }
+
+        // ============================================================================
+        // stopDecodeThread() - Wake and join the decode thread
+        // ============================================================================
+
+        void FFmpegDrmVideoOutput::stopDecodeThread()
+        {
+          {
+            std::lock_guard<decltype(queueMutex_)> lock(queueMutex_);
+            isActive_.store(false);
+            packetQueue_.clear();
+          }
+          queueCondition_.notify_all();
+
+          if (decodeThread_.joinable())
+          {
+            decodeThread_.join();
+            VpuScheduler::instance().detach(vpuStream_);
+          }
+        }
+
+        // ============================================================================
+        // queueFrameForPresentation() - Publish a decoded frame to the frame ring
+        // ============================================================================
+
+        void FFmpegDrmVideoOutput::queueFrameForPresentation(AVFrame *frame,
+                                                             VideoFrameTiming timing)
+        {
+          if (TouchLatencyProbe::instance().isActive())
+          {
+            timing.probeLuma = probeLuma(frame);
+          }
+
+          if (frame->format != AV_PIX_FMT_DRM_PRIME)
+          {
+            softwareFrames_++;
+          }
+
+          if (!firstFrameShown_ && firstKeyframeUs_ != 0)
+          {
+            firstFrameShown_ = true;
+            const int64_t firstFrameUs = timing.receiveUs - firstKeyframeUs_;
+            metrics().firstFrame.observe(static_cast<double>(firstFrameUs) / 1000.0);
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] First frame " << firstFrameUs / 1000
+                               << " ms after the first IDR";
+          }
+
+          if (benchmark_.headless)
+          {
+            // Count the frame as shown the moment it is decoded
+            VideoFrameTiming shown = timing;
+            shown.commitUs = shown.receiveUs;
+            shown.flipUs = shown.receiveUs;
+            VideoTelemetry::instance().recordFrame(shown);
+            return;
+          }
+
+          if (compositorImport_)
+          {
+            // DmaBufVideoItem takes the newest frame at its next scene graph sync
+            if (!DmaBufFrameExchange::instance().publish(frame, timing))
+            {
+              OPENAUTO_LOG(warning)
+                  << "[FFmpegDrmVideoOutput] Failed to reference decoded frame";
+            }
+            return;
+          }
+
+          {
+            std::lock_guard<decltype(presentMutex_)> lock(presentMutex_);
+
+            size_t queued = 0;
+            int freeSlot = -1;
+            for (size_t i = 0; i < frameSlots_.size(); i++)
+            {
+              if (frameSlots_[i].state == FrameSlotState::Queued)
+              {
+                queued++;
+              }
+              else if (frameSlots_[i].state == FrameSlotState::Released && freeSlot < 0)
+              {
+                freeSlot = static_cast<int>(i);
+              }
+            }
+
+            // Decoder is ahead of the display by more than the configured depth -
+            // drop the oldest waiting frame and reuse its slot
+            if (queued >= frameQueueDepth_ || freeSlot < 0)
+            {
+              int oldest = oldestQueuedSlot();
+              if (oldest < 0)
+              {
+                OPENAUTO_LOG(warning)
+                    << "[FFmpegDrmVideoOutput] No free frame slot, dropping frame";
+                return;
+              }
+              releaseFrameSlot(oldest);
+              supersededFrames_++;
+              metrics().superseded.add();
+              freeSlot = oldest;
+            }
+
+            FrameSlot &slot = frameSlots_[freeSlot];
+            slot.state = FrameSlotState::Decoded;
+            if (av_frame_ref(slot.frame, frame) < 0)
+            {
+              OPENAUTO_LOG(warning)
+                  << "[FFmpegDrmVideoOutput] Failed to reference decoded frame";
+              slot.state = FrameSlotState::Released;
+              return;
+            }
+            slot.sequence = nextFrameSequence_++;
+            slot.timing = timing;
+            slot.state = FrameSlotState::Queued;
+          }
+
+          presentCondition_.notify_one();
+        }
+
+        int FFmpegDrmVideoOutput::oldestQueuedSlot() const
+        {
+          int oldest = -1;
+          for (size_t i = 0; i < frameSlots_.size(); i++)
+          {
+            if (frameSlots_[i].state == FrameSlotState::Queued &&
+                (oldest < 0 || frameSlots_[i].sequence < frameSlots_[oldest].sequence))
+            {
+              oldest = static_cast<int>(i);
+            }
+          }
+          return oldest;
+        }
+
+        void FFmpegDrmVideoOutput::releaseFrameSlot(int index)
+        {
+          if (index < 0 || static_cast<size_t>(index) >= frameSlots_.size())
+          {
+            return;
+          }
+
+          FrameSlot &slot = frameSlots_[index];
+          if (slot.frame)
+          {
+            av_frame_unref(slot.frame);
+          }
+          slot.state = FrameSlotState::Released;
+        }
+
+        void FFmpegDrmVideoOutput::releaseAllFrameSlots()
+        {
+          std::lock_guard<decltype(presentMutex_)> lock(presentMutex_);
+
+          for (auto &slot : frameSlots_)
+          {
+            if (slot.frame)
+            {
+              av_frame_free(&slot.frame);
+            }
+          }
+          frameSlots_.clear();
+          scanoutSlot_ = -1;
+          retiringSlot_ = -1;
+        }
+
+        bool FFmpegDrmVideoOutput::grabDisplayedFrame(GrabbedFrame &grabbed)
+        {
+          AVFrame *frame = nullptr;
+          {
+            // The only cost to the display path: one more reference on the buffer
+            std::lock_guard<decltype(presentMutex_)> lock(presentMutex_);
+            if (scanoutSlot_ >= 0 && static_cast<size_t>(scanoutSlot_) < frameSlots_.size())
+            {
+              const AVFrame *shown = frameSlots_[scanoutSlot_].frame;
+              if (shown != nullptr && shown->format == AV_PIX_FMT_DRM_PRIME)
+              {
+                frame = av_frame_clone(shown);
+              }
+            }
+          }
+          if (frame == nullptr)
+          {
+            return false;
+          }
+          grabbed.hold = std::shared_ptr<void>(frame, [](void *held)
+                                               {
+                                                 AVFrame *owned = static_cast<AVFrame *>(held);
+                                                 av_frame_free(&owned); });
+
+          const auto *desc = reinterpret_cast<const AVDRMFrameDescriptor *>(frame->data[0]);
+          if (desc == nullptr || desc->nb_objects != 1 || desc->nb_layers < 1 ||
+              desc->layers[0].format != DRM_FORMAT_NV12 || desc->layers[0].nb_planes < 1)
+          {
+            OPENAUTO_LOG_EVERY_MS(warning, 10000) << "[FFmpegDrmVideoOutput] Snapshots only read single-object NV12 frames";
+            return false;
+          }
+          const AVDRMLayerDescriptor &layer = desc->layers[0];
+          const AVDRMObjectDescriptor &object = desc->objects[0];
+          grabbed.fd = object.fd;
+          grabbed.linear = object.format_modifier == DRM_FORMAT_MOD_LINEAR ||
+                           object.format_modifier == DRM_FORMAT_MOD_INVALID;
+          grabbed.width = static_cast<uint32_t>(frame->width);
+          grabbed.height = static_cast<uint32_t>(frame->height);
+          grabbed.lumaOffset = static_cast<uint32_t>(layer.planes[0].offset);
+          grabbed.lumaPitch = static_cast<uint32_t>(layer.planes[0].pitch);
+          // Some decoders describe NV12 as one plane with the chroma right after the luma
+          grabbed.chromaOffset = layer.nb_planes > 1 ? static_cast<uint32_t>(layer.planes[1].offset)
+                                                     : grabbed.lumaOffset + grabbed.lumaPitch * grabbed.height;
+          grabbed.chromaPitch = layer.nb_planes > 1 ? static_cast<uint32_t>(layer.planes[1].pitch) : grabbed.lumaPitch;
+          grabbed.fullRange = frame->color_range == AVCOL_RANGE_JPEG;
+          return true;
+        }
+
+        // ============================================================================
+        // presentLoop() - Presentation thread body
+        // ============================================================================
+        // At most one atomic commit is in flight. While it is, we wait for its
+        // page-flip event; once the flip lands, the oldest queued frame (if any)
+        // is committed for the next vblank.
+        //
+        // Slot lifecycle: Decoded -> Queued -> ScanningOut -> Released. A slot
+        // stays ScanningOut until the frame after it has flipped in (atomic), or
+        // until the next commit (legacy SetPlane has no flip event).
+
+        void FFmpegDrmVideoOutput::presentLoop()
+        {
+          ThreadTopology::instance().apply(ThreadRole::VideoPresent, "oa-vpresent");
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Presentation thread started";
+
+          bool cursorDeferred = false; // CRTC was busy, retry on the next poll
+
+          while (isActive_.load())
+          {
+            if (flipPending_)
+            {
+              waitForPageFlip(100);
+              continue;
+            }
+
+            int slotIndex = -1;
+            AVFrame *frame = nullptr;
+            {
+              std::unique_lock<decltype(presentMutex_)> lock(presentMutex_);
+              auto ready = [this, cursorDeferred]()
+              {
+                return !isActive_.load() || oldestQueuedSlot() >= 0 ||
+                       (!cursorDeferred && cursorDirty_.load());
+              };
+
+              // Pointer moves do not signal the condition (the input thread must
+              // not block on presentMutex_), so poll for them while the cursor is on
+              if (cursorEnabled_.load())
+              {
+                presentCondition_.wait_for(lock, cCursorPollInterval, ready);
+              }
+              else
+              {
+                presentCondition_.wait(lock, ready);
+              }
+
+              if (!isActive_.load())
+              {
+                break;
+              }
+
+              // Claim the slot so the decode thread can no longer drop it
+              slotIndex = oldestQueuedSlot();
+              if (slotIndex >= 0)
+              {
+                frameSlots_[slotIndex].state = FrameSlotState::ScanningOut;
+                frame = frameSlots_[slotIndex].frame;
+
+                // Hold it until its vblank comes round; a frame decoded behind
+                // it means we are late and it goes now
+                const size_t queuedFrames = oldestQueuedSlot() >= 0 ? 2 : 1;
+                const int64_t notBeforeUs = pacer_.commitNotBeforeUs(frame->pts, queuedFrames);
+                const int64_t holdUs = notBeforeUs - VideoTelemetry::nowUs();
+                if (notBeforeUs != 0 && holdUs > 0)
+                {
+                  presentCondition_.wait_for(lock, std::chrono::microseconds(holdUs), [this]()
+                                             { return !isActive_.load() || oldestQueuedSlot() >= 0; });
                 }
+              }
+            }
+
+            // No video frame this vblank - move the cursor on its own
+            cursorDeferred = false;
+            if (slotIndex < 0)
+            {
+              cursorDeferred = !commitCursor();
+              continue;
+            }
+
+            // Reversing: the camera is on the plane, drop the frame unseen
+            if (planeLent_.load(std::memory_order_acquire))
+            {
+              std::lock_guard<decltype(presentMutex_)> lock(presentMutex_);
+              releaseFrameSlot(slotIndex);
+              continue;
+            }
+
+            bool shown = displayFrame(frame);
+            if (!shown)
+            {
+              OPENAUTO_LOG_EVERY_MS(warning, cErrorLogIntervalMs)
+                  << "[FFmpegDrmVideoOutput] Failed to display " << OPENAUTO_LOG_OCCURRENCES << " frame(s)";
+            }
+
+            std::lock_guard<decltype(presentMutex_)> lock(presentMutex_);
+            if (shown)
+            {
+              // Anything still retiring from an earlier commit is off screen now
+              releaseFrameSlot(retiringSlot_);
+              retiringSlot_ = scanoutSlot_;
+              scanoutSlot_ = slotIndex;
+
+              // Legacy SetPlane has latched the frame on return; atomic commits
+              // are recorded when their flip event arrives
+              VideoFrameTiming &timing = frameSlots_[slotIndex].timing;
+              timing.commitUs = VideoTelemetry::nowUs();
+              if (!flipPending_)
+              {
+                timing.flipUs = timing.commitUs;
+                VideoTelemetry::instance().recordFrame(timing);
+              }
+              pacer_.onCommit(frame->pts);
+            }
+            else
+            {
+              releaseFrameSlot(slotIndex);
+            }
+          }
+
+          // Let the last flip land before the caller releases framebuffers
+          if (flipPending_)
+          {
+            waitForPageFlip(100);
+          }
+
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Presentation thread exiting";
+        }
+
+        // ============================================================================
+        // stopPresentThread() - Wake and join the presentation thread
+        // ============================================================================
+
+        void FFmpegDrmVideoOutput::stopPresentThread()
+        {
+          {
+            std::lock_guard<decltype(presentMutex_)> lock(presentMutex_);
+            isActive_.store(false);
+          }
+          presentCondition_.notify_all();
+
+          if (presentThread_.joinable())
+          {
+            presentThread_.join();
+          }
+
+          // Frames that never reached the screen can go now; the slot on screen is
+          // kept until cleanupDecoder()
+          std::lock_guard<decltype(presentMutex_)> lock(presentMutex_);
+          for (size_t i = 0; i < frameSlots_.size(); i++)
+          {
+            if (frameSlots_[i].state == FrameSlotState::Queued ||
+                frameSlots_[i].state == FrameSlotState::Decoded)
+            {
+              releaseFrameSlot(static_cast<int>(i));
+            }
+          }
+        }
+
+        // ============================================================================
+        // commitPlane() - Put a framebuffer on the video plane
+        // ============================================================================
+
+        void FFmpegDrmVideoOutput::updatePlaneRects(uint32_t frameWidth, uint32_t frameHeight)
+        {
+          const QSize frameSize(static_cast<int>(frameWidth), static_cast<int>(frameHeight));
+          const QSize displaySize(mode_.hdisplay, mode_.vdisplay);
+
+          setupOrientation(geometry_.orientation());
+
+          // Without a session geometry, stretch the whole frame as before
+          QRect src(QPoint(0, 0), frameSize);
+          QRect dst(QPoint(0, 0), displaySize);
+          if (!geometry_.videoSize().isEmpty())
+          {
+            ProjectionGeometry geometry = geometry_.withDisplaySize(displaySize);
+            if (geometry.videoSize() != frameSize)
+            {
+              geometry = geometry.withVideoSize(frameSize);
+            }
+            if (!geometry.isNull())
+            {
+              src = geometry.sourceRect();
+              dst = geometry.destinationRect();
+            }
+          }
+
+          // What the RGA does before the plane: turn the frame, and crop and
+          // scale it too if the plane cannot scale this stream
+          rgaOperation_ = RgaTransform::Operation();
+          if (orientationPath_ == OrientationPath::Rga)
+          {
+            rgaOperation_.rotation = orientation_.rotation();
+            rgaOperation_.mirrored = orientation_.mirrored();
+          }
+          if (rgaScaling_)
+          {
+            rgaOperation_.cropX = static_cast<uint32_t>(src.x());
+            rgaOperation_.cropY = static_cast<uint32_t>(src.y());
+            rgaOperation_.cropWidth = static_cast<uint32_t>(src.width());
+            rgaOperation_.cropHeight = static_cast<uint32_t>(src.height());
+            rgaOperation_.width = static_cast<uint32_t>(dst.width());
+            rgaOperation_.height = static_cast<uint32_t>(dst.height());
+            src = QRect(QPoint(0, 0), dst.size());
+          }
+          else if (orientationPath_ == OrientationPath::Rga)
+          {
+            // The RGA's framebuffer holds the turned frame, so the crop turns
+            // with it; the plane crops the frame as decoded
+            src = orientation_.toPanel(src, frameSize);
+          }
+
+          planeRects_.frameWidth = frameWidth;
+          planeRects_.frameHeight = frameHeight;
+          planeRects_.srcX = static_cast<uint64_t>(src.x()) << 16;
+          planeRects_.srcY = static_cast<uint64_t>(src.y()) << 16;
+          planeRects_.srcW = static_cast<uint64_t>(src.width()) << 16;
+          planeRects_.srcH = static_cast<uint64_t>(src.height()) << 16;
+          planeRects_.crtcX = dst.x();
+          planeRects_.crtcY = dst.y();
+          planeRects_.crtcW = static_cast<uint32_t>(dst.width());
+          planeRects_.crtcH = static_cast<uint32_t>(dst.height());
+
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Plane geometry: src " << src.x() << ","
+                             << src.y() << " " << src.width() << "x" << src.height()
+                             << " -> crtc " << dst.x() << "," << dst.y() << " " << dst.width()
+                             << "x" << dst.height();
+        }
+
+        // ============================================================================
+        // setupOrientation() - Turn and mirror the video for the panel
+        // ============================================================================
+        // DRM's rotation property turns counter-clockwise after the reflection,
+        // while DisplayOrientation turns clockwise and then mirrors. A
+        // clockwise turn by r followed by a left-right mirror is the mirror
+        // followed by a counter-clockwise turn by r, and rotate-180 is both
+        // reflections, so each orientation has two spellings. Rockchip VOPs
+        // commonly offer the reflections only; the RGA does 90 and 270 there.
+        // ============================================================================
+
+        void FFmpegDrmVideoOutput::setupOrientation(const DisplayOrientation &orientation)
+        {
+          if (orientation == orientation_)
+          {
+            return;
+          }
+          orientation_ = orientation;
+          planeRotation_ = DRM_MODE_ROTATE_0;
+          legacyRotationSet_ = false;
+
+          if (orientation.isIdentity())
+          {
+            orientationPath_ = OrientationPath::None;
+            return;
+          }
+
+          const int turn = orientation.mirrored() ? orientation.rotation()
+                                                  : (360 - orientation.rotation()) % 360;
+          const uint64_t reflect = orientation.mirrored() ? DRM_MODE_REFLECT_X : 0;
+          const uint64_t candidates[2] = {
+              (uint64_t(DRM_MODE_ROTATE_0) << (turn / 90)) | reflect,
+              (uint64_t(DRM_MODE_ROTATE_0) << (((turn + 180) % 360) / 90)) |
+                  (reflect ^ (DRM_MODE_REFLECT_X | DRM_MODE_REFLECT_Y))};
+          if (planePropRotation_ != 0 && !planeRotationRejected_)
+          {
+            for (uint64_t candidate : candidates)
+            {
+              if ((candidate & planeRotations_) == candidate)
+              {
+                planeRotation_ = candidate;
+                orientationPath_ = OrientationPath::Plane;
+                OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Plane rotation 0x" << std::hex
+                                   << planeRotation_ << std::dec << " for "
+                                   << orientation.rotation() << " degrees"
+                                   << (orientation.mirrored() ? ", mirrored" : "");
+                return;
+              }
+            }
+          }
+
+          if (openRga())
+          {
+            orientationPath_ = OrientationPath::Rga;
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] The plane cannot turn the video by "
+                               << orientation.rotation() << " degrees"
+                               << (orientation.mirrored() ? " mirrored" : "")
+                               << ", the RGA blits each frame";
+            return;
+          }
+
+          orientationPath_ = OrientationPath::Unsupported;
+          OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Neither the plane nor an RGA can turn "
+                                   "the video by "
+                                << orientation.rotation() << " degrees"
+                                << (orientation.mirrored() ? " mirrored" : "")
+                                << "; it is shown upright while touches follow the "
+                                   "configured orientation";
+        }
+
+        // ============================================================================
+        // RGA stage - Blit what the plane cannot show as is
+        // ============================================================================
+
+        bool FFmpegDrmVideoOutput::openRga()
+        {
+          if (!rgaProbed_)
+          {
+            rgaProbed_ = true;
+            rga_.reset(new RgaTransform(drmFd_));
+            rga_->open();
+          }
+          return rga_ && rga_->isOpen();
+        }
+
+        bool FFmpegDrmVideoOutput::needsRga() const
+        {
+          return orientationPath_ == OrientationPath::Rga || rgaScaling_ || rgaConversion_;
+        }
+
+        uint32_t FFmpegDrmVideoOutput::blitFramebuffer(uint32_t fbId,
+                                                       const RgaTransform::Source &source)
+        {
+          if (!needsRga())
+          {
+            return fbId;
+          }
+          if (!rga_ || !rga_->isOpen())
+          {
+            return 0;
+          }
+          return rga_->transform(source, rgaOperation_);
+        }
+
+        bool FFmpegDrmVideoOutput::scaleWithRga(int ret)
+        {
+          // Only scaling the RGA can take over: not a busy CRTC, nor a 1:1 plane
+          const PlaneRects &rects = planeRects_;
+          const bool scaled = (rects.srcW >> 16) != rects.crtcW || (rects.srcH >> 16) != rects.crtcH;
+          if (ret == -EBUSY || (ret != -EINVAL && ret != -ERANGE) || rgaScaling_ || !scaled ||
+              !openRga())
+          {
+            return false;
+          }
+
+          OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Plane refused to scale "
+                                << (rects.srcW >> 16) << "x" << (rects.srcH >> 16) << " to "
+                                << rects.crtcW << "x" << rects.crtcH << " (" << strerror(-ret)
+                                << "), the RGA scales instead";
+          rgaScaling_ = true;
+          if (orientationPath_ == OrientationPath::Plane)
+          {
+            // One blit turns the frame as well, rather than the plane turning
+            // what the RGA sized for the panel
+            planeRotationRejected_ = true;
+            orientation_ = DisplayOrientation();
+            orientationPath_ = OrientationPath::None;
+          }
+          planeRects_ = PlaneRects{};
+          return true;
+        }
+
+        int FFmpegDrmVideoOutput::commitPlane(uint32_t fbId, uint32_t srcWidth,
+                                              uint32_t srcHeight)
+        {
+          if (srcWidth != planeRects_.frameWidth || srcHeight != planeRects_.frameHeight)
+          {
+            updatePlaneRects(srcWidth, srcHeight);
+          }
+          const PlaneRects &rects = planeRects_;
+
+          if (atomicSupported_)
+          {
+            drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+            if (req)
+            {
+              drmModeAtomicAddProperty(req, planeId_, planePropFbId_, fbId);
+              drmModeAtomicAddProperty(req, planeId_, planePropCrtcId_, crtcId_);
+              drmModeAtomicAddProperty(req, planeId_, planePropCrtcX_, rects.crtcX);
+              drmModeAtomicAddProperty(req, planeId_, planePropCrtcY_, rects.crtcY);
+              drmModeAtomicAddProperty(req, planeId_, planePropCrtcW_, rects.crtcW);
+              drmModeAtomicAddProperty(req, planeId_, planePropCrtcH_, rects.crtcH);
+              drmModeAtomicAddProperty(req, planeId_, planePropSrcX_, rects.srcX);
+              drmModeAtomicAddProperty(req, planeId_, planePropSrcY_, rects.srcY);
+              drmModeAtomicAddProperty(req, planeId_, planePropSrcW_, rects.srcW);
+              drmModeAtomicAddProperty(req, planeId_, planePropSrcH_, rects.srcH);
+              if (planePropRotation_ != 0)
+              {
+                drmModeAtomicAddProperty(req, planeId_, planePropRotation_, planeRotation_);
+              }
+
+              // The latest cursor position goes out in the same vblank
+              const bool withCursor = addCursorToRequest(req);
+
+              int ret = drmModeAtomicCommit(
+                  drmFd_, req, DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT, this);
+              drmModeAtomicFree(req);
+
+              if (ret == 0)
+              {
+                flipPending_ = true;
+                return 0;
+              }
+
+              if (withCursor)
+              {
+                cursorDirty_.store(true, std::memory_order_release);
+              }
+
+              if (ret != -EBUSY && withCursor)
+              {
+                // Keep video on atomic; the cursor plane falls back to SetPlane
+                OPENAUTO_LOG(warning)
+                    << "[FFmpegDrmVideoOutput] Atomic commit with cursor failed ("
+                    << strerror(-ret) << "), moving cursor with legacy SetPlane";
+                cursorAtomic_ = false;
+                return commitPlane(fbId, srcWidth, srcHeight);
+              }
+
+              if (ret != -EBUSY && orientationPath_ == OrientationPath::Plane)
+              {
+                // Advertised, but not for this format or scaling: the next
+                // frame is blitted by the RGA instead
+                OPENAUTO_LOG(warning)
+                    << "[FFmpegDrmVideoOutput] Atomic commit with rotation failed ("
+                    << strerror(-ret) << "), turning the video with the RGA";
+                planeRotationRejected_ = true;
+                orientation_ = DisplayOrientation();
+                orientationPath_ = OrientationPath::None;
+                planeRects_ = PlaneRects{};
+                return ret;
+              }
+
+              // The next frame arrives at the CRTC size
+              if (scaleWithRga(ret))
+              {
+                return ret;
+              }
+
+              if (ret != -EBUSY)
+              {
+                // Not just a busy CRTC - stop trying atomic for this session
+                OPENAUTO_LOG(warning)
+                    << "[FFmpegDrmVideoOutput] Atomic commit failed ("
+                    << strerror(-ret) << "), falling back to legacy SetPlane";
+                atomicSupported_ = false;
+              }
+            }
+          }
+
+          // Legacy API - blocks until the plane update has been latched
+          if (planePropRotation_ != 0 && !legacyRotationSet_)
+          {
+            legacyRotationSet_ = drmModeObjectSetProperty(drmFd_, planeId_, DRM_MODE_OBJECT_PLANE,
+                                                          planePropRotation_, planeRotation_) == 0;
+          }
+          int ret = drmModeSetPlane(drmFd_, planeId_, crtcId_, fbId, 0, rects.crtcX, rects.crtcY,
+                                    rects.crtcW, rects.crtcH, // Display area (letterboxed)
+                                    static_cast<uint32_t>(rects.srcX),
+                                    static_cast<uint32_t>(rects.srcY),
+                                    static_cast<uint32_t>(rects.srcW),
+                                    static_cast<uint32_t>(rects.srcH)); // Source area (16.16)
+          if (ret < 0 && scaleWithRga(ret))
+          {
+            return ret;
+          }
+          commitCursorLegacy();
+          return ret;
+        }
+
+        // ============================================================================
+        // waitForPageFlip() - Wait for the in-flight atomic commit to complete
+        // ============================================================================
+
+        void FFmpegDrmVideoOutput::onPageFlip(int /*fd*/, unsigned int sequence,
+                                              unsigned int tvSec, unsigned int tvUsec,
+                                              void *userData)
+        {
+          auto *self = static_cast<FFmpegDrmVideoOutput *>(userData);
+          if (self)
+          {
+            self->flipPending_ = false;
+
+            // A cursor-only commit leaves the video slots as they were
+            if (self->cursorOnlyFlip_)
+            {
+              self->cursorOnlyFlip_ = false;
+              return;
+            }
+
+            // The new frame is on screen, so the one it replaced can go back to
+            // the decoder's pool
+            std::lock_guard<decltype(self->presentMutex_)> lock(self->presentMutex_);
+
+            // The event carries the CLOCK_MONOTONIC vblank time
+            const int64_t vblankUs = static_cast<int64_t>(tvSec) * 1000000 + tvUsec;
+            if (self->scanoutSlot_ >= 0 &&
+                static_cast<size_t>(self->scanoutSlot_) < self->frameSlots_.size())
+            {
+              VideoFrameTiming &timing = self->frameSlots_[self->scanoutSlot_].timing;
+              timing.flipUs = vblankUs;
+              VideoTelemetry::instance().recordFrame(timing);
+            }
+            if (!self->pacer_.onFlip(sequence, vblankUs))
+            {
+              metrics().offCadence.add();
+            }
+
+            self->releaseFrameSlot(self->retiringSlot_);
+            self->retiringSlot_ = -1;
+          }
+        }
+
+        void FFmpegDrmVideoOutput::waitForPageFlip(int timeoutMs)
+        {
+          if (!flipPending_ || drmFd_ < 0)
+          {
+            flipPending_ = false;
+            cursorOnlyFlip_ = false;
+            return;
+          }
+
+          struct pollfd pfd = {};
+          pfd.fd = drmFd_;
+          pfd.events = POLLIN;
+
+          int ret = poll(&pfd, 1, timeoutMs);
+          if (ret > 0 && (pfd.revents & POLLIN))
+          {
+            drmEventContext evctx = {};
+            evctx.version = 2;
+            evctx.page_flip_handler = &FFmpegDrmVideoOutput::onPageFlip;
+            drmHandleEvent(drmFd_, &evctx);
+          }
+          else if (ret == 0)
+          {
+            // No event within the timeout - don't stall presentation forever
+            OPENAUTO_LOG(warning)
+                << "[FFmpegDrmVideoOutput] Page flip event timed out";
+            flipPending_ = false;
+            cursorOnlyFlip_ = false;
+          }
+          else if (ret < 0 && errno != EINTR)
+          {
+            flipPending_ = false;
+            cursorOnlyFlip_ = false;
+          }
+        }
+
+        // ============================================================================
+        // decodePacket() - Decode and display H.264 frame (decode thread)
+        // ============================================================================
+        // Android Auto delivers one complete Annex-B access unit per media message,
+        // so by default the queued buffer is handed to the decoder as-is (AU
+        // passthrough). Buffers that do not start with a start code are fragments;
+        // from the first one on, the session falls back to av_parser_parse2.
+
+        void FFmpegDrmVideoOutput::decodePacket(const PendingPacket &packet)
+        {
+          OPENAUTO_TRACE_SCOPE("video.decode");
+          if (!codecCtx_ || !packet.buffer)
+          {
+            return;
+          }
+
+          OPENAUTO_LOG_FIRST_N(info, 5) << "[FFmpegDrmVideoOutput] Frame " << frameCount_
+                                        << " - size: " << packet.size << " bytes";
+
+          currentArrivalUs_ = packet.arrivalUs;
+
+          const uint8_t *data = packet.buffer->data;
+          int dataSize = packet.size;
+          int64_t pts = packet.timestamp != 0 ? static_cast<int64_t>(packet.timestamp)
+                                              : AV_NOPTS_VALUE;
+
+          if (!parserMode_ && !hasAnnexBStartCode(data, static_cast<size_t>(dataSize)))
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Fragmented H.264 input, "
+                                  "switching to parser mode";
+            parserMode_ = true;
+          }
+
+          // Kept for a decoder opened mid-stream: libavcodec taking over from
+          // requestDecoder_, or one reopened by the watchdog
+          if (packet.info.parameterSets && !packet.info.hasSlices)
+          {
+            parameterSets_.reset(av_buffer_ref(packet.buffer.get()));
+            parameterSetsSize_ = packet.size;
+          }
+
+          // Baseline has no B slices, so the decoder's reorder guesses only add
+          // delay; keep it outputting each picture as it is decoded
+          if (packet.info.profileIdc != 0)
+          {
+            baselineStream_ = packet.info.profileIdc == 66;
+          }
+          if (baselineStream_)
+          {
+            codecCtx_->has_b_frames = 0;
+          }
+          if (packet.info.keyframe && firstKeyframeUs_ == 0)
+          {
+            firstKeyframeUs_ = packet.arrivalUs;
+          }
+
+          if (requestDecoder_ && !parserMode_ && decodeNative(packet))
+          {
+            frameCount_++;
+            metrics().packets.add();
+            return;
+          }
+
+          if (packet.info.hasSlices)
+          {
+            watchdog_.packetSent(VideoTelemetry::nowUs());
+          }
+
+          if (!parserMode_)
+          {
+            // AU passthrough: reference the queued buffer, no parse and no copy
+            packet_->buf = av_buffer_ref(packet.buffer.get());
+            if (packet_->buf)
+            {
+              packet_->data = packet_->buf->data;
+              packet_->size = dataSize;
+              packet_->pts = pts;
+              packet_->dts = pts;
+              sendPacketToDecoder();
+            }
+            av_packet_unref(packet_);
+          }
+          else
+          {
+            while (dataSize > 0)
+            {
+              // Parse NAL units
+              int parsedLen =
+                  av_parser_parse2(parser_, codecCtx_, &packet_->data, &packet_->size,
+                                   data, dataSize, pts, pts, 0);
+              if (parsedLen < 0)
+              {
+                OPENAUTO_LOG(error) << "[FFmpegDrmVideoOutput] Parser error";
+                break;
+              }
+
+              data += parsedLen;
+              dataSize -= parsedLen;
+
+              if (packet_->size > 0)
+              {
+                packet_->pts = parser_->pts;
+                packet_->dts = parser_->dts;
+                sendPacketToDecoder();
+              }
+            }
+          }
+
+          const DecoderRecovery step = watchdog_.poll(VideoTelemetry::nowUs());
+          if (step != DecoderRecovery::None)
+          {
+            recoverDecoder(step);
+          }
+
+          frameCount_++;
+          metrics().packets.add();
+          OPENAUTO_LOG_EVERY_N(info, 300) << "[FFmpegDrmVideoOutput] Processed " << frameCount_
+                                          << " frames: " << VideoTelemetry::instance().summary();
+        }
+
+        // ============================================================================
+        // decodeNative() - Decode one access unit on the V4L2 request decoder
+        // ============================================================================
+
+        bool FFmpegDrmVideoOutput::decodeNative(const PendingPacket &packet)
+        {
+          VideoFrameTiming timing;
+          timing.arrivalUs = packet.arrivalUs;
+          timing.sendUs = VideoTelemetry::nowUs();
+          const int64_t pts = packet.timestamp != 0 ? static_cast<int64_t>(packet.timestamp) : AV_NOPTS_VALUE;
+
+          const auto status = requestDecoder_->decode(
+              packet.buffer->data, static_cast<size_t>(packet.size), pts,
+              [this, &timing](const V4l2RequestDecoder::Picture &picture)
+              {
+                timing.receiveUs = VideoTelemetry::nowUs();
+                queueNativePicture(picture, timing);
+              });
+
+          switch (status)
+          {
+          case V4l2RequestDecoder::Status::Decoded:
+          case V4l2RequestDecoder::Status::NoPicture:
+            return true;
+          case V4l2RequestDecoder::Status::Dropped:
+            if (requestDecoder_->awaitingIdr())
+            {
+              // The decoder skips to the next IDR by itself; ask the phone for
+              // one and stop queueing what would be skipped
+              std::lock_guard<decltype(queueMutex_)> lock(queueMutex_);
+              dropPolicy_.awaitKeyframe();
+            }
+            return true;
+          case V4l2RequestDecoder::Status::Unsupported:
+            break;
+          }
+
+          OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Stream not decodable on "
+                                << requestDecoder_->deviceName() << ", switching to libavcodec";
+          requestDecoder_.reset();
+          if (parameterSets_)
+          {
+            packet_->buf = av_buffer_ref(parameterSets_.get());
+            if (packet_->buf)
+            {
+              packet_->data = packet_->buf->data;
+              packet_->size = parameterSetsSize_;
+              packet_->pts = AV_NOPTS_VALUE;
+              packet_->dts = AV_NOPTS_VALUE;
+              sendPacketToDecoder();
+            }
+            av_packet_unref(packet_);
+          }
+          return false;
+        }
+
+        // ============================================================================
+        // queueNativePicture() - Present a native picture as a DRM PRIME frame
+        // ============================================================================
+
+        void FFmpegDrmVideoOutput::queueNativePicture(const V4l2RequestDecoder::Picture &picture,
+                                                      const VideoFrameTiming &timing)
+        {
+          auto *desc = static_cast<AVDRMFrameDescriptor *>(av_mallocz(sizeof(AVDRMFrameDescriptor)));
+          if (!desc)
+          {
+            return;
+          }
+          desc->nb_objects = 1;
+          desc->objects[0].fd = picture.fd;
+          desc->objects[0].size = picture.size;
+          desc->objects[0].format_modifier = DRM_FORMAT_MOD_LINEAR;
+          desc->nb_layers = 1;
+          desc->layers[0].format = DRM_FORMAT_NV12;
+          desc->layers[0].nb_planes = 2;
+          desc->layers[0].planes[0].object_index = 0;
+          desc->layers[0].planes[0].offset = 0;
+          desc->layers[0].planes[0].pitch = picture.pitch;
+          desc->layers[0].planes[1].object_index = 0;
+          desc->layers[0].planes[1].offset = picture.chromaOffset;
+          desc->layers[0].planes[1].pitch = picture.pitch;
+
+          // The capture buffer goes back to the decoder with the last reference
+          // to this frame, whichever thread drops it
+          auto *hold = new std::shared_ptr<void>(picture.hold);
+          AVBufferRef *ref = av_buffer_create(
+              reinterpret_cast<uint8_t *>(desc), sizeof(*desc),
+              [](void *opaque, uint8_t *data)
+              {
+                delete static_cast<std::shared_ptr<void> *>(opaque);
+                av_free(data);
+              },
+              hold, AV_BUFFER_FLAG_READONLY);
+          if (!ref)
+          {
+            delete hold;
+            av_free(desc);
+            return;
+          }
+
+          frame_->buf[0] = ref;
+          frame_->data[0] = ref->data;
+          frame_->format = AV_PIX_FMT_DRM_PRIME;
+          frame_->width = static_cast<int>(picture.width);
+          frame_->height = static_cast<int>(picture.height);
+          frame_->pts = picture.pts;
+          frame_->color_range = picture.fullRange ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+          frame_->colorspace = static_cast<AVColorSpace>(picture.matrixCoefficients);
+
+          nativeDecoding_ = true;
+          queueFrameForPresentation(frame_, timing);
+          av_frame_unref(frame_);
+        }
+
+          return size >= 4 && data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 1;
+        }
+
+        // ============================================================================
+        // sendPacketToDecoder() - Feed packet_ and drain decoded frames
+        // ============================================================================
+
+        void FFmpegDrmVideoOutput::sendPacketToDecoder()
+        {
+          // Send packet to decoder
+          const int64_t sendUs = VideoTelemetry::nowUs();
+          int ret = avcodec_send_packet(codecCtx_, packet_);
+          if (ret < 0)
+          {
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            {
+              FlightRecorder::instance().record(FlightEvent::DecoderError, ret);
+              char errBuf[256];
+              av_strerror(ret, errBuf, sizeof(errBuf));
+              OPENAUTO_LOG_EVERY_MS(warning, cErrorLogIntervalMs)
+                  << "[FFmpegDrmVideoOutput] Send packet error: " << errBuf << " (x" << OPENAUTO_LOG_OCCURRENCES << ")";
+            }
+            return;
+          }
+
+          if (inFlightPackets_.size() >= cMaxInFlightPackets)
+          {
+            inFlightPackets_.pop_front();
+          }
+          inFlightPackets_.push_back(InFlightPacket{packet_->pts, currentArrivalUs_, sendUs});
+
+          // Receive decoded frames
+          while (true)
+          {
+            ret = avcodec_receive_frame(codecCtx_, frame_);
+
+            // VPU driver negotiation phase: EAGAIN and ENOBUFS are expected during
+            // init These are NOT errors - the driver is still setting up the format
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ||
+                ret == AVERROR(ENOBUFS) || ret == -105)
+            {
+              // Silently break and wait for next packet (normal behavior during
+              // negotiation)
+              break;
+            }
+
+            if (ret < 0)
+            {
+              FlightRecorder::instance().record(FlightEvent::DecoderError, ret);
+              char errBuf[256];
+              av_strerror(ret, errBuf, sizeof(errBuf));
+              OPENAUTO_LOG_EVERY_MS(warning, cErrorLogIntervalMs)
+                  << "[FFmpegDrmVideoOutput] Receive frame error: " << errBuf << " (x" << OPENAUTO_LOG_OCCURRENCES << ")";
+              break;
+            }
+
+            // Validate frame dimensions before attempting to display
+            // This prevents crashes when driver hasn't fully negotiated format yet
+            if (frame_->width <= 0 || frame_->height <= 0)
+            {
+              OPENAUTO_LOG_EVERY_MS(warning, cErrorLogIntervalMs)
+                  << "[FFmpegDrmVideoOutput] Invalid frame dimensions: "
+                  << frame_->width << "x" << frame_->height << " (x" << OPENAUTO_LOG_OCCURRENCES << ")";
+              av_frame_unref(frame_);
+              break;
+            }
+
+            // Hand the decoded frame to the presentation thread
+            VideoFrameTiming timing = takeInFlightTiming(frame_->pts);
+            timing.receiveUs = VideoTelemetry::nowUs();
+            metrics().retained.set(static_cast<int64_t>(inFlightPackets_.size()));
+            const int64_t recoveryUs = watchdog_.frameDecoded(timing.receiveUs);
+            if (recoveryUs > 0)
+            {
+              metrics().recovery.observe(static_cast<double>(recoveryUs) / 1000.0);
+              OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Decoder recovered after "
+                                 << recoveryUs / 1000 << " ms";
+            }
+            queueFrameForPresentation(frame_, timing);
+
+            av_frame_unref(frame_);
+          }
+        }
+
+        // ============================================================================
+        // recoverDecoder() - Staged recovery of a decoder that returns no frames
+        // ============================================================================
+        // Each step is cheap enough to keep the session: a flush drops what the
+        // driver holds, a reopen gets a fresh v4l2_request context, and a new
+        // hw device context reopens the media and video devices. The plane keeps
+        // showing the last frame throughout, and the phone is asked for an IDR
+        // so the next step starts from a clean reference.
+        // ============================================================================
 
-                // Display the decoded frame
-                if (!displayFrame(frame_))
-                {
-                  if (frameCount_ < 5)
-                  {
-                    OPENAUTO_LOG(warning)
-                        << "[FFmpegDrmVideoOutput] Failed to display frame "
-                        << frameCount_;
-                  }
-                }
+        void FFmpegDrmVideoOutput::recoverDecoder(DecoderRecovery step)
+        {
+          metrics().recoverySteps.add();
+          FlightRecorder::instance().record(FlightEvent::DecoderRecovery, static_cast<int64_t>(step));
+          const int64_t startUs = VideoTelemetry::nowUs();
+
+          if (step == DecoderRecovery::Flush)
+          {
+            OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Decoder returns no frames, flushing it";
+            avcodec_flush_buffers(codecCtx_);
+          }
+          else
+          {
+            const bool recreate = step == DecoderRecovery::RecreateDevice;
+            OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Decoder still returns no frames, "
+                                  << (recreate ? "recreating the hw device" : "reopening it");
+
+            std::lock_guard<decltype(mutex_)> lock(mutex_);
+            const size_t depth = frameQueueDepth_;
+            releaseCodec();
+            if (recreate)
+            {
+              cleanupHwDevice();
+            }
+            if (!initDecoder(false))
+            {
+              OPENAUTO_LOG(error) << "[FFmpegDrmVideoOutput] Cannot reopen the decoder, "
+                                     "video stays frozen until the next session";
+              releaseCodec();
+              return;
+            }
+            // The frame ring was sized for the old depth
+            frameQueueDepth_ = std::min(frameQueueDepth_, depth);
 
-                av_frame_unref(frame_);
+            // The phone sent its SPS and PPS once, at the start of the stream
+            if (parameterSets_)
+            {
+              packet_->buf = av_buffer_ref(parameterSets_.get());
+              if (packet_->buf)
+              {
+                packet_->data = packet_->buf->data;
+                packet_->size = parameterSetsSize_;
+                packet_->pts = AV_NOPTS_VALUE;
+                packet_->dts = AV_NOPTS_VALUE;
+                avcodec_send_packet(codecCtx_, packet_);
               }
+              av_packet_unref(packet_);
             }
           }
 
-          frameCount_++;
-          if (frameCount_ % 300 == 0)
+          inFlightPackets_.clear();
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Recovery step took "
+                             << (VideoTelemetry::nowUs() - startUs) / 1000 << " ms";
+          requestKeyframeNow();
+        }
+
+        void FFmpegDrmVideoOutput::requestKeyframeNow()
+        {
+          KeyframeRequestHandler keyframeHandler;
+          {
+            std::lock_guard<decltype(queueMutex_)> lock(queueMutex_);
+            dropPolicy_.awaitKeyframe();
+            lastKeyframeRequestUs_ = VideoTelemetry::nowUs();
+            keyframeHandler = keyframeRequestHandler_;
+          }
+
+          if (keyframeHandler)
+          {
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Requesting keyframe from phone";
+            keyframeHandler();
+          }
+        }
+
+        // ============================================================================
+        // takeInFlightTiming() - Match a decoded frame to its packet's timestamps
+        // ============================================================================
+
+        VideoFrameTiming FFmpegDrmVideoOutput::takeInFlightTiming(int64_t pts)
+        {
+          VideoFrameTiming timing;
+
+          // Low-delay H.264 returns frames in packet order, so without a usable
+          // pts the oldest packet is the one that produced this frame
+          auto match = inFlightPackets_.begin();
+          if (pts != AV_NOPTS_VALUE)
+          {
+            match = std::find_if(inFlightPackets_.begin(), inFlightPackets_.end(),
+                                 [pts](const InFlightPacket &p)
+                                 { return p.pts == pts; });
+          }
+
+          if (match != inFlightPackets_.end())
           {
-            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Processed " << frameCount_
-                               << " frames";
+            timing.arrivalUs = match->arrivalUs;
+            timing.sendUs = match->sendUs;
+            inFlightPackets_.erase(inFlightPackets_.begin(), match + 1);
           }
+          return timing;
         }
 
         // ============================================================================
@@ -1174,6 +3299,7 @@ namespace f1x
 
         bool FFmpegDrmVideoOutput::displayFrame(AVFrame *frame)
         {
+          OPENAUTO_TRACE_SCOPE("video.display");
           if (!frame || !drmInitialized_)
           {
             return false;
@@ -1210,171 +3336,422 @@ namespace f1x
               return false;
             }
 
-            // Import the DMA-BUF into a DRM framebuffer
-            uint32_t handles[4] = {0};
-            uint32_t pitches[4] = {0};
-            uint32_t offsets[4] = {0};
-            uint64_t modifiers[4] = {0};
+            const AVDRMLayerDescriptor &layer = desc->layers[0];
+            if (rgaConversion_ && (static_cast<uint32_t>(frame->width) != fbCacheWidth_ ||
+                                   static_cast<uint32_t>(frame->height) != fbCacheHeight_))
+            {
+              rgaConversion_ = false;
+            }
 
-            // Map DRM objects to handles
-            for (int i = 0; i < desc->nb_objects && i < 4; i++)
+            // Look up (or import once) the framebuffer for this DMA-BUF
+            uint32_t fbId = rgaConversion_ ? 0 : getFramebuffer(frame);
+            if (fbId == 0 && !rgaConversion_)
             {
-              int ret = drmPrimeFDToHandle(drmFd_, desc->objects[i].fd, &handles[i]);
-              if (ret < 0)
+              // A layout the plane rejects, like an unaligned pitch or a
+              // format it cannot fetch: the RGA rewrites it in one blit
+              if (desc->nb_objects != 1 || !RgaTransform::canRead(layer.format) || !openRga())
               {
-                OPENAUTO_LOG(warning)
-                    << "[FFmpegDrmVideoOutput] Failed to get handle from FD: "
-                    << strerror(errno);
                 return false;
               }
+              OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Plane cannot import "
+                                    << frame->width << "x" << frame->height << " frames (pitch "
+                                    << layer.planes[0].pitch
+                                    << "), the RGA converts them for scanout";
+              rgaConversion_ = true;
             }
 
-            // Set up plane parameters from layer info
-            const AVDRMLayerDescriptor *layer = &desc->layers[0];
-            uint32_t drmFormat = layer->format;
-            uint32_t primaryHandle = handles[0]; // Save for cleanup
-
-            for (int i = 0; i < layer->nb_planes && i < 4; i++)
+            if (static_cast<uint32_t>(frame->width) != planeRects_.frameWidth ||
+                static_cast<uint32_t>(frame->height) != planeRects_.frameHeight)
             {
-              int objIdx = layer->planes[i].object_index;
-              handles[i] = handles[objIdx];
-              pitches[i] = layer->planes[i].pitch;
-              offsets[i] = layer->planes[i].offset;
-              modifiers[i] = desc->objects[objIdx].format_modifier;
+              updatePlaneRects(frame->width, frame->height);
             }
+            if (needsRga())
+            {
+              RgaTransform::Source source;
+              source.fd = desc->objects[0].fd;
+              source.size = desc->objects[0].size;
+              source.drmFormat = layer.format;
+              source.width = static_cast<uint32_t>(frame->width);
+              source.height = static_cast<uint32_t>(frame->height);
+              source.pitch = static_cast<uint32_t>(layer.planes[0].pitch);
+              source.chromaOffset =
+                  layer.nb_planes > 1 ? static_cast<uint32_t>(layer.planes[1].offset) : 0;
+              fbId = blitFramebuffer(fbId, source);
+              if (fbId == 0)
+              {
+                return false;
+              }
+            }
+
+            // Set the plane to display the framebuffer (scaled to display).
+            // With atomic this only queues the flip for the next vblank.
+            int ret = commitPlane(fbId, frame->width, frame->height);
 
-            // Create framebuffer
-            uint32_t fbId = 0;
-            int ret = drmModeAddFB2WithModifiers(
-                drmFd_, frame->width, frame->height, drmFormat, handles, pitches,
-                offsets, modifiers, &fbId, DRM_MODE_FB_MODIFIERS);
             if (ret < 0)
             {
-              // Try without modifiers
-              ret = drmModeAddFB2(drmFd_, frame->width, frame->height, drmFormat,
-                                  handles, pitches, offsets, &fbId, 0);
+              OPENAUTO_LOG_EVERY_MS(warning, cErrorLogIntervalMs)
+                  << "[FFmpegDrmVideoOutput] Failed to set plane: " << strerror(-ret)
+                  << " (x" << OPENAUTO_LOG_OCCURRENCES << ")";
+              return false;
             }
 
-            if (ret < 0)
+            // Buffer lifetime is handled by the frame ring in presentLoop(): the
+            // slot holding this frame keeps its DRM Prime buffer referenced until
+            // the next frame has replaced it on the plane.
+
+            // Framebuffers stay in fbCache_ for reuse; only track what is on screen
+            previousFbId_ = currentFbId_;
+            currentFbId_ = fbId;
+
+            OPENAUTO_LOG_FIRST_N(info, 5) << "[FFmpegDrmVideoOutput] Displayed DRM Prime frame "
+                                          << frameCount_ << " (" << frame->width << "x"
+                                          << frame->height << ")";
+
+            return true;
+          }
+          else
+          {
+            // ================================================================
+            // SOFTWARE FALLBACK PATH (YUV -> RGB conversion)
+            // ================================================================
+            return displaySoftwareFrame(frame);
+          }
+        }
+
+        // ============================================================================
+        // getFramebuffer() - DMA-BUF to framebuffer cache lookup
+        // ============================================================================
+        // rkvdec decodes into a small fixed pool of capture buffers, so the same
+        // handful of DMA-BUFs come back over and over. Importing each one once and
+        // keeping the framebuffer saves drmPrimeFDToHandle + AddFB2 + RmFB +
+        // GEM_CLOSE on every frame.
+
+        uint32_t FFmpegDrmVideoOutput::getFramebuffer(AVFrame *frame)
+        {
+          const AVDRMFrameDescriptor *desc =
+              reinterpret_cast<const AVDRMFrameDescriptor *>(frame->data[0]);
+          const AVDRMLayerDescriptor *layer = &desc->layers[0];
+
+          // Resolution change invalidates every cached framebuffer
+          if (static_cast<uint32_t>(frame->width) != fbCacheWidth_ ||
+              static_cast<uint32_t>(frame->height) != fbCacheHeight_)
+          {
+            if (!fbCache_.empty())
+            {
+              OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Frame size changed to "
+                                 << frame->width << "x" << frame->height
+                                 << ", flushing framebuffer cache";
+            }
+            clearFramebufferCache();
+            fbCacheWidth_ = frame->width;
+            fbCacheHeight_ = frame->height;
+          }
+
+          struct stat st = {};
+          if (fstat(desc->objects[0].fd, &st) < 0)
+          {
+            OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] fstat on DMA-BUF failed: "
+                                  << strerror(errno);
+            return 0;
+          }
+
+          FramebufferKey key{static_cast<uint64_t>(st.st_ino),
+                             layer->format,
+                             static_cast<uint32_t>(frame->width),
+                             static_cast<uint32_t>(frame->height),
+                             static_cast<uint32_t>(layer->planes[0].pitch),
+                             layer->nb_planes > 1
+                                 ? static_cast<uint32_t>(layer->planes[1].offset)
+                                 : 0u};
+
+          auto it = fbCache_.find(key);
+          if (it != fbCache_.end())
+          {
+            return it->second.fbId;
+          }
+
+          // Pool was reallocated behind our back - drop everything not on screen
+          if (fbCache_.size() >= cMaxCachedFramebuffers)
+          {
+            for (auto entry = fbCache_.begin(); entry != fbCache_.end();)
             {
-              if (frameCount_ < 5)
+              if (entry->second.fbId != currentFbId_ &&
+                  entry->second.fbId != previousFbId_)
               {
-                OPENAUTO_LOG(warning)
-                    << "[FFmpegDrmVideoOutput] Failed to create framebuffer: "
-                    << strerror(-ret);
+                releaseCachedFramebuffer(entry->second);
+                entry = fbCache_.erase(entry);
+              }
+              else
+              {
+                ++entry;
               }
-              return false;
             }
+          }
 
-            // Set the plane to display the framebuffer (scaled to display)
-            // Use legacy API - we have DRM master after stealing from Qt
-            ret = drmModeSetPlane(
-                drmFd_, planeId_, crtcId_, fbId, 0, 0, 0, mode_.hdisplay,
-                mode_.vdisplay, // Display area (full screen)
-                0, 0, frame->width << 16,
-                frame->height << 16); // Source area (16.16 fixed point)
+          // Import the DMA-BUF into a DRM framebuffer
+          uint32_t objectHandles[4] = {0};
+          uint32_t handles[4] = {0};
+          uint32_t pitches[4] = {0};
+          uint32_t offsets[4] = {0};
+          uint64_t modifiers[4] = {0};
+          CachedFramebuffer entry{0, {}, 0};
 
+          // Map DRM objects to handles
+          for (int i = 0; i < desc->nb_objects && i < 4; i++)
+          {
+            int ret = drmPrimeFDToHandle(drmFd_, desc->objects[i].fd, &objectHandles[i]);
             if (ret < 0)
             {
-              if (frameCount_ < 5)
-              {
-                OPENAUTO_LOG(warning)
-                    << "[FFmpegDrmVideoOutput] Failed to set plane: " << strerror(-ret);
-              }
-              drmModeRmFB(drmFd_, fbId);
-              return false;
+              OPENAUTO_LOG(warning)
+                  << "[FFmpegDrmVideoOutput] Failed to get handle from FD: "
+                  << strerror(errno);
+              releaseCachedFramebuffer(entry);
+              return 0;
             }
+            entry.handles.push_back(objectHandles[i]);
+            entry.bytes += static_cast<int64_t>(desc->objects[i].size);
+          }
 
-            // ================================================================
-            // BUFFER LIFECYCLE MANAGEMENT
-            // ================================================================
-            // The DRM Prime buffer is owned by FFmpeg's buffer pool.
-            // We must keep a reference to the AVFrame until the DRM plane
-            // is no longer using it (i.e., after the NEXT frame is displayed).
-            // This prevents tearing and memory corruption.
+          // Set up plane parameters from layer info
+          for (int i = 0; i < layer->nb_planes && i < 4; i++)
+          {
+            int objIdx = layer->planes[i].object_index;
+            handles[i] = objectHandles[objIdx];
+            pitches[i] = layer->planes[i].pitch;
+            offsets[i] = layer->planes[i].offset;
+            modifiers[i] = desc->objects[objIdx].format_modifier;
+          }
+
+          int ret = drmModeAddFB2WithModifiers(
+              drmFd_, frame->width, frame->height, layer->format, handles, pitches,
+              offsets, modifiers, &entry.fbId, DRM_MODE_FB_MODIFIERS);
+          if (ret < 0)
+          {
+            // Try without modifiers
+            ret = drmModeAddFB2(drmFd_, frame->width, frame->height, layer->format,
+                                handles, pitches, offsets, &entry.fbId, 0);
+          }
+
+          if (ret < 0)
+          {
+            OPENAUTO_LOG_EVERY_MS(warning, cErrorLogIntervalMs)
+                << "[FFmpegDrmVideoOutput] Failed to create framebuffer: "
+                << strerror(-ret) << " (x" << OPENAUTO_LOG_OCCURRENCES << ")";
+            entry.fbId = 0;
+            releaseCachedFramebuffer(entry);
+            return 0;
+          }
+
+          fbCache_.emplace(key, entry);
+          CmaBudget::instance().add(CmaPool::PrimeImport, entry.bytes);
+          OPENAUTO_LOG(debug) << "[FFmpegDrmVideoOutput] Cached framebuffer "
+                              << entry.fbId << " (" << fbCache_.size() << " total)";
+          return entry.fbId;
+        }
+
+        void FFmpegDrmVideoOutput::releaseCachedFramebuffer(const CachedFramebuffer &entry)
+        {
+          if (drmFd_ < 0)
+          {
+            return;
+          }
+
+          if (entry.fbId != 0)
+          {
+            drmModeRmFB(drmFd_, entry.fbId);
+            CmaBudget::instance().release(CmaPool::PrimeImport, entry.bytes);
+          }
 
-            // Release the frame from 2 frames ago (safe to free now)
-            if (previousDisplayedFrame_ != nullptr)
+          // drmPrimeFDToHandle returns the same handle for every object of one BO,
+          // so close each distinct handle once
+          std::vector<uint32_t> closed;
+          for (uint32_t handle : entry.handles)
+          {
+            if (handle == 0 ||
+                std::find(closed.begin(), closed.end(), handle) != closed.end())
             {
-              av_frame_free(&previousDisplayedFrame_);
+              continue;
             }
+            struct drm_gem_close closeReq = {};
+            closeReq.handle = handle;
+            ioctl(drmFd_, DRM_IOCTL_GEM_CLOSE, &closeReq);
+            closed.push_back(handle);
+          }
+        }
+
+        void FFmpegDrmVideoOutput::clearFramebufferCache()
+        {
+          for (auto &entry : fbCache_)
+          {
+            releaseCachedFramebuffer(entry.second);
+          }
+          fbCache_.clear();
+          fbCacheWidth_ = 0;
+          fbCacheHeight_ = 0;
+          currentFbId_ = 0;
+          previousFbId_ = 0;
+        }
 
-            // Rotate frame references
-            previousDisplayedFrame_ = displayedFrame_;
+        // ============================================================================
+        // displaySoftwareFrame() - Display software-decoded frame via DRM
+        // ============================================================================
 
-            // Clone current frame to keep its buffer alive
-            displayedFrame_ = av_frame_clone(frame);
-            if (!displayedFrame_)
+        bool FFmpegDrmVideoOutput::displaySoftwareFrame(AVFrame *frame)
+        {
+          const AVPixelFormat swFormat = static_cast<AVPixelFormat>(frame->format);
+
+          OPENAUTO_LOG_FIRST_N(info, 5) << "[FFmpegDrmVideoOutput] Software decode path: "
+                                        << (av_get_pix_fmt_name(swFormat) ? av_get_pix_fmt_name(swFormat) : "unknown")
+                                        << " " << frame->width << "x" << frame->height;
+
+          // 4:2:0 frames go to the overlay as NV12 and the VOP converts them;
+          // anything else still needs swscale to XRGB8888
+          const bool isYuv420p =
+              swFormat == AV_PIX_FMT_YUV420P || swFormat == AV_PIX_FMT_YUVJ420P;
+          const bool isNv12 = swFormat == AV_PIX_FMT_NV12;
+          const uint32_t drmFormat =
+              (isYuv420p || isNv12) ? DRM_FORMAT_NV12 : DRM_FORMAT_XRGB8888;
+
+          // (Re)create the dumb buffer pair on first use or when the stream changes
+          if (swBuffers_[0].handle == 0 || swFormat_ != drmFormat ||
+              swWidth_ != frame->width || swHeight_ != frame->height)
+          {
+            destroySoftwareBuffers();
+            if (!createSoftwareBuffers(frame->width, frame->height, drmFormat))
             {
-              OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Failed to clone frame "
-                                       "for buffer retention";
-              // Continue anyway - may cause minor artifacts
+              destroySoftwareBuffers();
+              return false;
             }
+          }
+
+          // Write into the buffer that is not on screen
+          DumbBuffer &target = swBuffers_[swBufferIndex_];
+          uint8_t *dst = static_cast<uint8_t *>(target.map);
+
+          if (drmFormat == DRM_FORMAT_NV12)
+          {
+            const int chromaWidth = (frame->width + 1) / 2;
+            const int chromaHeight = (frame->height + 1) / 2;
+            uint8_t *dstUV = dst + target.chromaOffset;
 
-            // Clean up previous framebuffer (DRM layer is done with it after SetPlane)
-            if (previousFbId_ != 0)
+            copyPlane(dst, target.pitch, frame->data[0], frame->linesize[0],
+                      frame->width, frame->height);
+            if (isNv12)
             {
-              drmModeRmFB(drmFd_, previousFbId_);
+              copyPlane(dstUV, target.pitch, frame->data[1], frame->linesize[1],
+                        chromaWidth * 2, chromaHeight);
             }
-            if (previousHandle_ != 0)
+            else
+            {
+              interleaveChroma(dstUV, target.pitch, frame->data[1], frame->linesize[1],
+                               frame->data[2], frame->linesize[2], chromaWidth,
+                               chromaHeight);
+            }
+          }
+          else
+          {
+            // Create swscale context for YUV->RGB conversion if needed
+            swsCtx_ = sws_getCachedContext(
+                swsCtx_, frame->width, frame->height, swFormat, // Source
+                frame->width, frame->height, AV_PIX_FMT_BGRA,   // Dest (ARGB for DRM)
+                SWS_BILINEAR, nullptr, nullptr, nullptr);
+            if (!swsCtx_)
             {
-              // Close the GEM handle to avoid leaking
-              struct drm_gem_close closeReq = {};
-              closeReq.handle = previousHandle_;
-              ioctl(drmFd_, DRM_IOCTL_GEM_CLOSE, &closeReq);
+              OPENAUTO_LOG(error)
+                  << "[FFmpegDrmVideoOutput] Failed to create swscale context";
+              return false;
             }
 
-            previousFbId_ = currentFbId_;
-            previousHandle_ = currentHandle_;
-            currentFbId_ = fbId;
-            currentHandle_ = primaryHandle;
+            // Convert directly into the dumb buffer, honouring its aligned pitch
+            uint8_t *dstData[4] = {dst, nullptr, nullptr, nullptr};
+            int dstLinesize[4] = {static_cast<int>(target.pitch), 0, 0, 0};
 
-            if (frameCount_ < 5)
+            int ret = sws_scale(swsCtx_, frame->data, frame->linesize, 0,
+                                frame->height, dstData, dstLinesize);
+            if (ret < 0)
             {
-              OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Displayed DRM Prime frame "
-                                 << frameCount_ << " (" << frame->width << "x"
-                                 << frame->height << ")";
+              OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] swscale failed";
+              return false;
             }
+          }
 
-            return true;
+          uint32_t fbId = target.fbId;
+          if (static_cast<uint32_t>(frame->width) != planeRects_.frameWidth ||
+              static_cast<uint32_t>(frame->height) != planeRects_.frameHeight)
+          {
+            updatePlaneRects(frame->width, frame->height);
           }
-          else
+          if (needsRga())
           {
-            // ================================================================
-            // SOFTWARE FALLBACK PATH (YUV -> RGB conversion)
-            // ================================================================
-            return displaySoftwareFrame(frame);
+            if (target.primeFd < 0 &&
+                drmPrimeHandleToFD(drmFd_, target.handle, DRM_CLOEXEC | DRM_RDWR,
+                                   &target.primeFd) != 0)
+            {
+              target.primeFd = -1;
+              OPENAUTO_LOG_EVERY_MS(warning, cErrorLogIntervalMs)
+                  << "[FFmpegDrmVideoOutput] Cannot export dumb buffer for the RGA: "
+                  << strerror(errno) << " (x" << OPENAUTO_LOG_OCCURRENCES << ")";
+              return false;
+            }
+            RgaTransform::Source source;
+            source.fd = target.primeFd;
+            source.size = target.size;
+            source.drmFormat = drmFormat;
+            source.width = static_cast<uint32_t>(frame->width);
+            source.height = static_cast<uint32_t>(frame->height);
+            source.pitch = target.pitch;
+            source.chromaOffset = target.chromaOffset;
+            fbId = blitFramebuffer(fbId, source);
+            if (fbId == 0)
+            {
+              return false;
+            }
+          }
+
+          // Display the framebuffer
+          int ret = commitPlane(fbId, frame->width, frame->height);
+
+          if (ret < 0)
+          {
+            OPENAUTO_LOG_EVERY_MS(warning, cErrorLogIntervalMs)
+                << "[FFmpegDrmVideoOutput] Failed to set plane (SW): "
+                << strerror(-ret) << " (x" << OPENAUTO_LOG_OCCURRENCES << ")";
+            return false;
           }
+
+          swBufferIndex_ = (swBufferIndex_ + 1) % cSoftwareBufferCount;
+          return true;
         }
 
         // ============================================================================
-        // displaySoftwareFrame() - Display software-decoded frame via DRM
+        // createSoftwareBuffers() - Allocate the software fallback dumb buffers
         // ============================================================================
 
-        bool FFmpegDrmVideoOutput::displaySoftwareFrame(AVFrame *frame)
+        bool FFmpegDrmVideoOutput::createSoftwareBuffers(int width, int height,
+                                                         uint32_t drmFormat)
         {
-          if (frameCount_ < 5)
-          {
-            const char *swPixFmt = av_get_pix_fmt_name((AVPixelFormat)frame->format);
-            if (!swPixFmt)
-              swPixFmt = "unknown";
-            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Software decode path: "
-                               << swPixFmt << " " << frame->width << "x"
-                               << frame->height;
-          }
+          const bool nv12 = drmFormat == DRM_FORMAT_NV12;
 
-          // Create persistent dumb buffer if not already created
-          if (swDumbHandle_ == 0)
+          for (size_t i = 0; i < cSoftwareBufferCount; i++)
           {
-            // Calculate aligned width for Rockchip VOP requirements
-            // The VOP requires 64-byte stride alignment for DMA transfers
-            uint32_t alignedWidth = (frame->width + (RK_VOP_STRIDE_ALIGNMENT / 4) - 1) &
-                                    ~((RK_VOP_STRIDE_ALIGNMENT / 4) - 1);
+            DumbBuffer &buffer = swBuffers_[i];
 
+            // The VOP requires 64-byte stride alignment for DMA transfers. NV12 is
+            // allocated as an 8 bpp buffer with room for the half-height UV plane.
             struct drm_mode_create_dumb createReq = {};
-            createReq.width = alignedWidth; // Use aligned width for proper stride
-            createReq.height = frame->height;
-            createReq.bpp = 32; // ARGB8888
+            if (nv12)
+            {
+              createReq.width = alignStride(width, 1);
+              createReq.height = height + (height + 1) / 2;
+              createReq.bpp = 8;
+            }
+            else
+            {
+              createReq.width = (width + (RK_VOP_STRIDE_ALIGNMENT / 4) - 1) &
+                                ~((RK_VOP_STRIDE_ALIGNMENT / 4) - 1);
+              createReq.height = height;
+              createReq.bpp = 32;
+            }
 
             if (ioctl(drmFd_, DRM_IOCTL_MODE_CREATE_DUMB, &createReq) < 0)
             {
@@ -1392,125 +3769,237 @@ namespace f1x
                   << " not " << RK_VOP_STRIDE_ALIGNMENT << "-byte aligned";
             }
 
-            swDumbHandle_ = createReq.handle;
-            swDumbSize_ = createReq.size;
-            swDumbPitch_ = createReq.pitch; // Store pitch for swscale
+            buffer.handle = createReq.handle;
+            buffer.size = createReq.size;
+            CmaBudget::instance().add(CmaPool::DumbBuffer, static_cast<int64_t>(buffer.size));
+            buffer.pitch = createReq.pitch;
+            buffer.chromaOffset = nv12 ? createReq.pitch * height : 0;
 
             // Map the buffer
             struct drm_mode_map_dumb mapReq = {};
-            mapReq.handle = swDumbHandle_;
+            mapReq.handle = buffer.handle;
 
             if (ioctl(drmFd_, DRM_IOCTL_MODE_MAP_DUMB, &mapReq) < 0)
             {
               OPENAUTO_LOG(error) << "[FFmpegDrmVideoOutput] Failed to map dumb buffer";
-              struct drm_mode_destroy_dumb destroyReq = {swDumbHandle_};
-              ioctl(drmFd_, DRM_IOCTL_MODE_DESTROY_DUMB, &destroyReq);
-              swDumbHandle_ = 0;
               return false;
             }
 
-            swDumbMap_ = mmap(0, createReq.size, PROT_READ | PROT_WRITE, MAP_SHARED,
-                              drmFd_, mapReq.offset);
-            if (swDumbMap_ == MAP_FAILED)
+            void *map = mmap(0, createReq.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                             drmFd_, mapReq.offset);
+            if (map == MAP_FAILED)
             {
               OPENAUTO_LOG(error)
                   << "[FFmpegDrmVideoOutput] Failed to mmap dumb buffer";
-              struct drm_mode_destroy_dumb destroyReq = {swDumbHandle_};
-              ioctl(drmFd_, DRM_IOCTL_MODE_DESTROY_DUMB, &destroyReq);
-              swDumbHandle_ = 0;
-              swDumbMap_ = nullptr;
               return false;
             }
+            buffer.map = map;
 
             // Create framebuffer for the dumb buffer
             // Use actual video width (not aligned width) for display
-            if (drmModeAddFB(drmFd_, frame->width, frame->height, 24, 32,
-                             createReq.pitch, swDumbHandle_, &swDumbFbId_) < 0)
+            uint32_t handles[4] = {buffer.handle, nv12 ? buffer.handle : 0, 0, 0};
+            uint32_t pitches[4] = {buffer.pitch, nv12 ? buffer.pitch : 0, 0, 0};
+            uint32_t offsets[4] = {0, buffer.chromaOffset, 0, 0};
+
+            if (drmModeAddFB2(drmFd_, width, height, drmFormat, handles, pitches,
+                              offsets, &buffer.fbId, 0) < 0)
             {
               OPENAUTO_LOG(error) << "[FFmpegDrmVideoOutput] Failed to create "
                                      "framebuffer for dumb buffer";
-              munmap(swDumbMap_, swDumbSize_);
-              struct drm_mode_destroy_dumb destroyReq = {swDumbHandle_};
-              ioctl(drmFd_, DRM_IOCTL_MODE_DESTROY_DUMB, &destroyReq);
-              swDumbHandle_ = 0;
-              swDumbMap_ = nullptr;
+              buffer.fbId = 0;
               return false;
             }
+          }
 
-            OPENAUTO_LOG(info)
-                << "[FFmpegDrmVideoOutput] Created software fallback buffer: "
-                << frame->width << "x" << frame->height << " (pitch=" << createReq.pitch
-                << ", aligned to " << RK_VOP_STRIDE_ALIGNMENT << " bytes)";
+          swFormat_ = drmFormat;
+          swWidth_ = width;
+          swHeight_ = height;
+          swBufferIndex_ = 0;
+
+          OPENAUTO_LOG(info)
+              << "[FFmpegDrmVideoOutput] Created software fallback buffers: "
+              << cSoftwareBufferCount << "x " << (nv12 ? "NV12 " : "XRGB8888 ")
+              << width << "x" << height << " (pitch=" << swBuffers_[0].pitch
+              << ", aligned to " << RK_VOP_STRIDE_ALIGNMENT << " bytes)";
+          return true;
+        }
+
+        // ============================================================================
+        // destroySoftwareBuffers() - Release the software fallback dumb buffers
+        // ============================================================================
+
+        void FFmpegDrmVideoOutput::destroySoftwareBuffers()
+        {
+          for (size_t i = 0; i < cSoftwareBufferCount; i++)
+          {
+            DumbBuffer &buffer = swBuffers_[i];
+
+            if (drmFd_ >= 0 && buffer.fbId != 0)
+            {
+              drmModeRmFB(drmFd_, buffer.fbId);
+            }
+
+            if (buffer.map != nullptr && buffer.size > 0)
+            {
+              munmap(buffer.map, buffer.size);
+            }
+
+            if (buffer.primeFd >= 0)
+            {
+              close(buffer.primeFd);
+            }
+
+            if (drmFd_ >= 0 && buffer.handle != 0)
+            {
+              struct drm_mode_destroy_dumb destroyReq = {buffer.handle};
+              ioctl(drmFd_, DRM_IOCTL_MODE_DESTROY_DUMB, &destroyReq);
+            }
+
+            if (buffer.handle != 0)
+            {
+              CmaBudget::instance().release(CmaPool::DumbBuffer,
+                                            static_cast<int64_t>(buffer.size));
+            }
+
+            buffer = DumbBuffer{};
+          }
+
+          swFormat_ = 0;
+          swWidth_ = 0;
+          swHeight_ = 0;
+          swBufferIndex_ = 0;
+        }
+
+        // ============================================================================
+        // stop() - End the session, keep the pipeline warm
+        // ============================================================================
+
+        void FFmpegDrmVideoOutput::stop()
+        {
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] stop() called";
+
+          // Join the decode and presentation threads first so nothing touches the
+          // decoder or the plane below
+          stopDecodeThread();
+          stopPresentThread();
+
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          inBackground_ = false;
+
+          if (!codecCtx_ && !displayReady())
+          {
+            OPENAUTO_LOG(debug) << "[FFmpegDrmVideoOutput] Already stopped";
+            return;
           }
 
-          // Create swscale context for YUV->RGB conversion if needed
-          if (swsCtx_ == nullptr)
+          // Drop decoder state from this session; the next phone starts with SPS
+          // and PPS again. The hw frames pool survives the flush.
+          if (codecCtx_)
           {
-            swsCtx_ = sws_getContext(
-                frame->width, frame->height, (AVPixelFormat)frame->format, // Source
-                frame->width, frame->height, AV_PIX_FMT_BGRA,              // Dest (ARGB for DRM)
-                SWS_BILINEAR, nullptr, nullptr, nullptr);
-            if (!swsCtx_)
+            avcodec_flush_buffers(codecCtx_);
+          }
+          if (requestDecoder_)
+          {
+            requestDecoder_->flush();
+          }
+          parameterSets_.reset();
+
+          // The parser may hold a partial access unit from the old stream
+          if (parser_)
+          {
+            av_parser_close(parser_);
+            parser_ = av_parser_init(codecId_);
+            if (parser_)
             {
-              OPENAUTO_LOG(error)
-                  << "[FFmpegDrmVideoOutput] Failed to create swscale context";
-              return false;
+              parser_->flags |= PARSER_FLAG_COMPLETE_FRAMES;
             }
-            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Created swscale context for "
-                                  "format conversion";
           }
 
-          // Convert YUV to BGRA directly into the dumb buffer
-          // Use actual buffer pitch (swDumbPitch_) for proper stride alignment
-          uint8_t *dstData[4] = {(uint8_t *)swDumbMap_, nullptr, nullptr, nullptr};
-          int dstLinesize[4] = {(int)swDumbPitch_, 0, 0,
-                                0}; // Use stored pitch, not width*4
+          releaseAllFrameSlots();
+          DmaBufFrameExchange::instance().clear();
+          disablePlane();
+          restoreCrtcMode();
+          currentFbId_ = 0;
+          previousFbId_ = 0;
+          cleanupCursor();
 
-          int ret = sws_scale(swsCtx_, frame->data, frame->linesize, 0, frame->height,
-                              dstData, dstLinesize);
-          if (ret < 0)
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Session ended. Total frames: "
+                             << frameCount_ << ", dropped: " << droppedFrames_
+                             << ", superseded: " << supersededFrames_;
+        }
+
+        // ============================================================================
+        // setBackground() - Release or restore the pipeline of a hidden projection
+        // ============================================================================
+        // The hw device context is kept, so coming back costs one decoder open
+        // and the phone's IDR rather than the device probe.
+
+        void FFmpegDrmVideoOutput::setBackground(bool background)
+        {
+          if (background == inBackground_)
           {
-            OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] swscale failed";
-            return false;
+            return;
           }
 
-          // Display the framebuffer using legacy API (we have DRM master)
-          ret = drmModeSetPlane(drmFd_, planeId_, crtcId_, swDumbFbId_, 0, 0, 0,
-                                mode_.hdisplay, mode_.vdisplay, 0, 0,
-                                frame->width << 16, frame->height << 16);
-
-          if (ret < 0)
+          if (background)
           {
-            if (frameCount_ < 5)
+            if (!isActive_.load())
             {
-              OPENAUTO_LOG(warning)
-                  << "[FFmpegDrmVideoOutput] Failed to set plane (SW): "
-                  << strerror(-ret);
+              return;
             }
-            return false;
+
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Projection hidden, releasing the decoder";
+            stop();
+
+            std::lock_guard<decltype(mutex_)> lock(mutex_);
+            cleanupDecoder();
+            clearFramebufferCache();
+            destroySoftwareBuffers();
+            rga_.reset();
+            rgaProbed_ = false;
+            inBackground_ = true;
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] " << CmaBudget::instance().summary();
+            return;
           }
 
-          return true;
+          inBackground_ = false;
+          const int64_t startUs = VideoTelemetry::nowUs();
+          if (!open() || !init())
+          {
+            OPENAUTO_LOG(error) << "[FFmpegDrmVideoOutput] Cannot restart the pipeline, "
+                                   "video stays off until the next session";
+            return;
+          }
+
+          // The phone restarts with an IDR; anything older references frames
+          // the new decoder never saw
+          {
+            std::lock_guard<decltype(queueMutex_)> lock(queueMutex_);
+            dropPolicy_.awaitKeyframe();
+          }
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Projection shown again, pipeline back in "
+                             << (VideoTelemetry::nowUs() - startUs) / 1000 << " ms";
         }
 
         // ============================================================================
-        // stop() - Stop pipeline and release resources
+        // shutdown() - Stop pipeline and release resources
         // ============================================================================
 
-        void FFmpegDrmVideoOutput::stop()
+        void FFmpegDrmVideoOutput::shutdown()
         {
-          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] stop() called";
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] shutdown() called";
+
+          stopDecodeThread();
+          stopPresentThread();
 
           std::lock_guard<decltype(mutex_)> lock(mutex_);
 
-          if (!isActive_.load() && !codecCtx_)
+          if (!codecCtx_ && !displayReady())
           {
-            OPENAUTO_LOG(debug) << "[FFmpegDrmVideoOutput] Already stopped";
+            OPENAUTO_LOG(debug) << "[FFmpegDrmVideoOutput] Already shut down";
             return;
           }
 
-          isActive_.store(false);
-
           // Flush decoder
           if (codecCtx_)
           {
@@ -1522,11 +4011,17 @@ namespace f1x
           }
 
           cleanupDecoder();
+          cleanupHwDevice();
           cleanupDrm();
           cleanupCursor();
 
           OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Stopped. Total frames: "
-                             << frameCount_;
+                             << frameCount_ << ", dropped: " << droppedFrames_
+                             << ", superseded: " << supersededFrames_;
+          // Everything is released here; anything still held is a leak
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] " << CmaBudget::instance().summary();
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] " << MemoryFootprint::instance().summary();
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] " << AllocationAccounting::instance().summary();
         }
 
         // ============================================================================
@@ -1535,18 +4030,9 @@ namespace f1x
 
         void FFmpegDrmVideoOutput::cleanupDecoder()
         {
-          // Release displayed frame references (buffer pooling cleanup)
-          if (displayedFrame_)
-          {
-            av_frame_free(&displayedFrame_);
-            displayedFrame_ = nullptr;
-          }
-
-          if (previousDisplayedFrame_)
-          {
-            av_frame_free(&previousDisplayedFrame_);
-            previousDisplayedFrame_ = nullptr;
-          }
+          // Release frame ring references (buffer pooling cleanup)
+          releaseAllFrameSlots();
+          DmaBufFrameExchange::instance().clear();
 
           // Release swscale context
           if (swsCtx_)
@@ -1555,6 +4041,17 @@ namespace f1x
             swsCtx_ = nullptr;
           }
 
+          releaseCodec();
+
+          // Pictures still referenced keep their buffers; see V4l2RequestDecoder
+          requestDecoder_.reset();
+          parameterSets_.reset();
+
+          OPENAUTO_LOG(debug) << "[FFmpegDrmVideoOutput] Decoder cleaned up";
+        }
+
+        void FFmpegDrmVideoOutput::releaseCodec()
+        {
           if (frame_)
           {
             av_frame_free(&frame_);
@@ -1579,15 +4076,46 @@ namespace f1x
             codecCtx_ = nullptr;
           }
 
+          codec_ = nullptr;
+          usingHwAccel_ = false;
+          decoderWidth_ = 0;
+          decoderHeight_ = 0;
+        }
+
+        // ============================================================================
+        // cleanupHwDevice() - Release the DRM hw device context
+        // ============================================================================
+
+        void FFmpegDrmVideoOutput::cleanupHwDevice()
+        {
           if (hwDeviceCtx_)
           {
             av_buffer_unref(&hwDeviceCtx_);
             hwDeviceCtx_ = nullptr;
           }
+        }
 
-          codec_ = nullptr;
-          usingHwAccel_ = false;
-          OPENAUTO_LOG(debug) << "[FFmpegDrmVideoOutput] Decoder cleaned up";
+        // ============================================================================
+        // decoderMatchesConfiguration() - Can the warm decoder serve this session?
+        // ============================================================================
+
+        bool FFmpegDrmVideoOutput::decoderMatchesConfiguration() const
+        {
+          return codec_ != nullptr && codec_->id == codecId_ &&
+                 decoderWidth_ == getVideoWidth() &&
+                 decoderHeight_ == getVideoHeight() &&
+                 requestedQueueDepth_ == configuredFrameQueueDepth();
+        }
+
+        size_t FFmpegDrmVideoOutput::configuredFrameQueueDepth() const
+        {
+          return std::max<size_t>(
+              1, std::min(configuration_->getVideoFrameQueueDepth(), cMaxFrameQueueDepth));
+        }
+
+        bool FFmpegDrmVideoOutput::displayReady() const
+        {
+          return compositorImport_ || drmInitialized_ || benchmark_.headless;
         }
 
         // ============================================================================
@@ -1597,70 +4125,28 @@ namespace f1x
         void FFmpegDrmVideoOutput::cleanupDrm()
         {
           // First, disable the overlay plane to avoid atomic errors when Qt resumes
-          if (drmFd_ >= 0 && planeId_ != 0 && crtcId_ != 0)
-          {
-            // Disable the plane by setting FB_ID to 0
-            int ret = drmModeSetPlane(drmFd_, planeId_, 0, 0, 0,
-                                      0, 0, 0, 0, 0, 0, 0, 0);
-            if (ret == 0)
-            {
-              OPENAUTO_LOG(debug) << "[FFmpegDrmVideoOutput] Disabled overlay plane " << planeId_;
-            }
-            else
-            {
-              OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Failed to disable plane: " << strerror(-ret);
-            }
-          }
-
-          // Clean up software fallback dumb buffer
-          if (swDumbFbId_ != 0)
-          {
-            drmModeRmFB(drmFd_, swDumbFbId_);
-            swDumbFbId_ = 0;
-          }
-
-          if (swDumbMap_ != nullptr && swDumbSize_ > 0)
-          {
-            munmap(swDumbMap_, swDumbSize_);
-            swDumbMap_ = nullptr;
-            swDumbSize_ = 0;
-          }
-
-          if (swDumbHandle_ != 0)
-          {
-            struct drm_mode_destroy_dumb destroyReq = {swDumbHandle_};
-            ioctl(drmFd_, DRM_IOCTL_MODE_DESTROY_DUMB, &destroyReq);
-            swDumbHandle_ = 0;
-          }
+          disablePlane();
 
-          // Clean up GEM handles
-          if (currentHandle_ != 0)
-          {
-            struct drm_gem_close closeReq = {};
-            closeReq.handle = currentHandle_;
-            ioctl(drmFd_, DRM_IOCTL_GEM_CLOSE, &closeReq);
-            currentHandle_ = 0;
-          }
+          restorePlaneStacking();
+          restoreCrtcMode();
+          publishStacking(false);
 
-          if (previousHandle_ != 0)
-          {
-            struct drm_gem_close closeReq = {};
-            closeReq.handle = previousHandle_;
-            ioctl(drmFd_, DRM_IOCTL_GEM_CLOSE, &closeReq);
-            previousHandle_ = 0;
-          }
+          // The RGA's framebuffers belong to this fd
+          rga_.reset();
+          rgaProbed_ = false;
+          rgaScaling_ = false;
+          rgaConversion_ = false;
+          orientationPath_ = OrientationPath::None;
+          orientation_ = DisplayOrientation();
+          planeRotation_ = DRM_MODE_ROTATE_0;
+          planeRotationRejected_ = false;
+          legacyRotationSet_ = false;
 
-          if (currentFbId_ != 0)
-          {
-            drmModeRmFB(drmFd_, currentFbId_);
-            currentFbId_ = 0;
-          }
+          // Clean up software fallback dumb buffers
+          destroySoftwareBuffers();
 
-          if (previousFbId_ != 0)
-          {
-            drmModeRmFB(drmFd_, previousFbId_);
-            previousFbId_ = 0;
-          }
+          // Release cached framebuffers and their GEM handles
+          clearFramebufferCache();
 
           if (drmFd_ >= 0)
           {
@@ -1683,6 +4169,28 @@ namespace f1x
           OPENAUTO_LOG(debug) << "[FFmpegDrmVideoOutput] DRM cleaned up";
         }
 
+        // ============================================================================
+        // disablePlane() - Hide the video plane
+        // ============================================================================
+
+        void FFmpegDrmVideoOutput::disablePlane()
+        {
+          if (drmFd_ >= 0 && planeId_ != 0 && crtcId_ != 0)
+          {
+            // Disable the plane by setting FB_ID to 0
+            int ret = drmModeSetPlane(drmFd_, planeId_, 0, 0, 0,
+                                      0, 0, 0, 0, 0, 0, 0, 0);
+            if (ret == 0)
+            {
+              OPENAUTO_LOG(debug) << "[FFmpegDrmVideoOutput] Disabled overlay plane " << planeId_;
+            }
+            else
+            {
+              OPENAUTO_LOG(warning) << "[FFmpegDrmVideoOutput] Failed to disable plane: " << strerror(-ret);
+            }
+          }
+        }
+
         // ============================================================================
         // Helper methods
         // ============================================================================
@@ -1748,6 +4256,13 @@ namespace f1x
             return false;
           }
 
+          if (cursorPlaneId_ == 0)
+          {
+            OPENAUTO_LOG(warning)
+                << "[FFmpegDrmVideoOutput] Cannot init cursor - no cursor plane";
+            return false;
+          }
+
           OPENAUTO_LOG(info)
               << "[FFmpegDrmVideoOutput] Initializing DRM plane-based cursor (plane "
               << cursorPlaneId_ << ")";
@@ -1869,10 +4384,16 @@ namespace f1x
 
           munmap(cursorData, createReq.size);
 
+          setupCursorAtomicProperties();
+
+          // 64x64 ARGB8888, released again in cleanupCursor()
+          CmaBudget::instance().add(CmaPool::Cursor,
+                                    static_cast<int64_t>(cursorWidth_) * cursorHeight_ * 4);
           cursorInitialized_ = true;
           cursorVisible_ = false;
-          cursorX_ = 0;
-          cursorY_ = 0;
+          cursorTarget_.store(packCursorPosition(0, 0));
+          cursorShown_.store(false);
+          cursorDirty_.store(false);
 
           OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Cursor initialized on plane "
                              << cursorPlaneId_ << ", CRTC: " << cursorCrtcId_
@@ -1913,87 +4434,261 @@ namespace f1x
             }
           }
 
+          CmaBudget::instance().release(CmaPool::Cursor,
+                                        static_cast<int64_t>(cursorWidth_) * cursorHeight_ * 4);
+
           cursorDrmFdPtr_ = nullptr;
           cursorInitialized_ = false;
           cursorVisible_ = false;
+          cursorAtomic_ = false;
+          cursorDirty_.store(false);
           OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Cursor cleaned up";
         }
 
         void FFmpegDrmVideoOutput::updateCursorPosition(int x, int y)
         {
-          std::lock_guard<std::mutex> lock(cursorMutex_);
+          // Called for every pointer move on the input thread: record the
+          // target and let the presentation thread apply it once per vblank
+          if (!cursorEnabled_.load(std::memory_order_relaxed))
+          {
+            return;
+          }
+
+          cursorTarget_.store(packCursorPosition(x, y), std::memory_order_relaxed);
+          cursorShown_.store(true, std::memory_order_relaxed);
+          cursorDirty_.store(true, std::memory_order_release);
+        }
 
-          // Check if cursor is enabled in configuration
-          if (!cursorEnabled_)
+        void FFmpegDrmVideoOutput::setCursorVisible(bool visible)
+        {
+          if (!cursorEnabled_.load(std::memory_order_relaxed))
           {
             return;
           }
 
-          if (!cursorInitialized_ || !cursorDrmFdPtr_ || *cursorDrmFdPtr_ < 0)
+          cursorShown_.store(visible, std::memory_order_relaxed);
+          cursorDirty_.store(true, std::memory_order_release);
+        }
+
+        void FFmpegDrmVideoOutput::lendPlane(bool lent)
+        {
+          planeLent_.store(lent, std::memory_order_release);
+        }
+
+        void FFmpegDrmVideoOutput::setupCursorAtomicProperties()
+        {
+          cursorProps_ = CursorPlaneProperties();
+          cursorAtomic_ = false;
+
+          if (!atomicSupported_)
           {
             return;
           }
 
-          // Store position
-          cursorX_ = x;
-          cursorY_ = y;
+          drmModeObjectPropertiesPtr props =
+              drmModeObjectGetProperties(drmFd_, cursorPlaneId_, DRM_MODE_OBJECT_PLANE);
+          if (!props)
+          {
+            OPENAUTO_LOG(warning)
+                << "[FFmpegDrmVideoOutput] Could not get cursor plane properties, "
+                   "using legacy SetPlane for the cursor";
+            return;
+          }
 
-          // Set cursor plane position using drmModeSetPlane
-          // This sets the cursor framebuffer at position (x, y) on the screen
-          int ret = drmModeSetPlane(
-              *cursorDrmFdPtr_, cursorPlaneId_, cursorCrtcId_, cursorFbId_, 0, x, y,
-              cursorWidth_, cursorHeight_, // dest x, y, w, h
-              0, 0, cursorWidth_ << 16,
-              cursorHeight_ << 16); // src x, y, w, h (16.16 fixed point)
+          struct PropMapping
+          {
+            const char *name;
+            uint32_t *dest;
+          };
+          PropMapping mappings[] = {
+              {"FB_ID", &cursorProps_.fbId},
+              {"CRTC_ID", &cursorProps_.crtcId},
+              {"CRTC_X", &cursorProps_.crtcX},
+              {"CRTC_Y", &cursorProps_.crtcY},
+              {"CRTC_W", &cursorProps_.crtcW},
+              {"CRTC_H", &cursorProps_.crtcH},
+              {"SRC_X", &cursorProps_.srcX},
+              {"SRC_Y", &cursorProps_.srcY},
+              {"SRC_W", &cursorProps_.srcW},
+              {"SRC_H", &cursorProps_.srcH}};
 
-          if (ret == 0)
+          for (uint32_t i = 0; i < props->count_props; i++)
           {
-            if (!cursorVisible_)
+            drmModePropertyPtr prop = drmModeGetProperty(drmFd_, props->props[i]);
+            if (!prop)
+              continue;
+
+            for (auto &m : mappings)
             {
-              cursorVisible_ = true;
-              OPENAUTO_LOG(info)
-                  << "[FFmpegDrmVideoOutput] Cursor now visible on plane "
-                  << cursorPlaneId_;
+              if (strcmp(prop->name, m.name) == 0)
+              {
+                *m.dest = prop->prop_id;
+                break;
+              }
             }
+            drmModeFreeProperty(prop);
           }
-          else if (!cursorVisible_)
+
+          drmModeFreeObjectProperties(props);
+
+          cursorAtomic_ = true;
+          for (const auto &m : mappings)
+          {
+            cursorAtomic_ = cursorAtomic_ && *m.dest != 0;
+          }
+
+          OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Cursor plane " << cursorPlaneId_
+                             << (cursorAtomic_ ? " moves with the video commit"
+                                               : " uses legacy SetPlane");
+        }
+
+        bool FFmpegDrmVideoOutput::addCursorToRequest(drmModeAtomicReqPtr req)
+        {
+          if (!cursorAtomic_ || !cursorInitialized_)
+          {
+            return false;
+          }
+
+          // Only the newest target matters; everything before it is coalesced
+          if (!cursorDirty_.exchange(false, std::memory_order_acquire))
+          {
+            return false;
+          }
+
+          const bool shown = cursorShown_.load(std::memory_order_relaxed);
+          if (shown)
+          {
+            const uint64_t target = cursorTarget_.load(std::memory_order_relaxed);
+            // CRTC_X/Y are signed; the kernel reads the value back as int64
+            const auto x = static_cast<uint64_t>(static_cast<int64_t>(cursorPositionX(target)));
+            const auto y = static_cast<uint64_t>(static_cast<int64_t>(cursorPositionY(target)));
+
+            drmModeAtomicAddProperty(req, cursorPlaneId_, cursorProps_.fbId, cursorFbId_);
+            drmModeAtomicAddProperty(req, cursorPlaneId_, cursorProps_.crtcId, cursorCrtcId_);
+            drmModeAtomicAddProperty(req, cursorPlaneId_, cursorProps_.crtcX, x);
+            drmModeAtomicAddProperty(req, cursorPlaneId_, cursorProps_.crtcY, y);
+            drmModeAtomicAddProperty(req, cursorPlaneId_, cursorProps_.crtcW, cursorWidth_);
+            drmModeAtomicAddProperty(req, cursorPlaneId_, cursorProps_.crtcH, cursorHeight_);
+            drmModeAtomicAddProperty(req, cursorPlaneId_, cursorProps_.srcX, 0);
+            drmModeAtomicAddProperty(req, cursorPlaneId_, cursorProps_.srcY, 0);
+            drmModeAtomicAddProperty(req, cursorPlaneId_, cursorProps_.srcW,
+                                     static_cast<uint64_t>(cursorWidth_) << 16);
+            drmModeAtomicAddProperty(req, cursorPlaneId_, cursorProps_.srcH,
+                                     static_cast<uint64_t>(cursorHeight_) << 16);
+          }
+          else
+          {
+            drmModeAtomicAddProperty(req, cursorPlaneId_, cursorProps_.fbId, 0);
+            drmModeAtomicAddProperty(req, cursorPlaneId_, cursorProps_.crtcId, 0);
+          }
+
+          if (shown != cursorVisible_)
+          {
+            cursorVisible_ = shown;
+            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Cursor "
+                               << (shown ? "shown" : "hidden") << " on plane "
+                               << cursorPlaneId_;
+          }
+          return true;
+        }
+
+        bool FFmpegDrmVideoOutput::commitCursor()
+        {
+          if (!cursorDirty_.load(std::memory_order_acquire))
+          {
+            return true;
+          }
+
+          if (!cursorAtomic_)
+          {
+            commitCursorLegacy();
+            return true;
+          }
+
+          drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+          if (!req)
+          {
+            return false;
+          }
+
+          if (!addCursorToRequest(req))
+          {
+            drmModeAtomicFree(req);
+            return true;
+          }
+
+          int ret = drmModeAtomicCommit(
+              drmFd_, req, DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT, this);
+          drmModeAtomicFree(req);
+
+          if (ret == 0)
+          {
+            cursorOnlyFlip_ = true;
+            flipPending_ = true;
+            return true;
+          }
+
+          // Retry with the next frame or poll
+          cursorDirty_.store(true, std::memory_order_release);
+          if (ret != -EBUSY)
           {
-            // Only log error once
             OPENAUTO_LOG(warning)
-                << "[FFmpegDrmVideoOutput] Failed to set cursor plane: "
-                << strerror(-ret);
+                << "[FFmpegDrmVideoOutput] Atomic cursor commit failed ("
+                << strerror(-ret) << "), moving cursor with legacy SetPlane";
+            cursorAtomic_ = false;
+            return true;
           }
+          return false;
         }
 
-        void FFmpegDrmVideoOutput::setCursorVisible(bool visible)
+        void FFmpegDrmVideoOutput::commitCursorLegacy()
         {
-          std::lock_guard<std::mutex> lock(cursorMutex_);
+          if (!cursorInitialized_ || drmFd_ < 0)
+          {
+            return;
+          }
 
-          if (!cursorInitialized_ || !cursorDrmFdPtr_ || *cursorDrmFdPtr_ < 0)
+          if (!cursorDirty_.exchange(false, std::memory_order_acquire))
           {
             return;
           }
 
-          if (visible && !cursorVisible_)
+          if (!cursorShown_.load(std::memory_order_relaxed))
           {
-            // Enable cursor plane at current position
-            int ret = drmModeSetPlane(*cursorDrmFdPtr_, cursorPlaneId_, cursorCrtcId_,
-                                      cursorFbId_, 0, cursorX_, cursorY_, cursorWidth_,
-                                      cursorHeight_, 0, 0, cursorWidth_ << 16,
-                                      cursorHeight_ << 16);
-            if (ret == 0)
+            // Disable cursor plane by setting FB to 0
+            drmModeSetPlane(drmFd_, cursorPlaneId_, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+            if (cursorVisible_)
+            {
+              cursorVisible_ = false;
+              OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Cursor hidden";
+            }
+            return;
+          }
+
+          const uint64_t target = cursorTarget_.load(std::memory_order_relaxed);
+          int ret = drmModeSetPlane(
+              drmFd_, cursorPlaneId_, cursorCrtcId_, cursorFbId_, 0,
+              cursorPositionX(target), cursorPositionY(target),
+              cursorWidth_, cursorHeight_, // dest x, y, w, h
+              0, 0, cursorWidth_ << 16,
+              cursorHeight_ << 16); // src x, y, w, h (16.16 fixed point)
+
+          if (ret == 0)
+          {
+            if (!cursorVisible_)
             {
               cursorVisible_ = true;
-              OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Cursor shown";
+              OPENAUTO_LOG(info)
+                  << "[FFmpegDrmVideoOutput] Cursor now visible on plane "
+                  << cursorPlaneId_;
             }
           }
-          else if (!visible && cursorVisible_)
+          else if (!cursorVisible_)
           {
-            // Disable cursor plane by setting FB to 0
-            drmModeSetPlane(*cursorDrmFdPtr_, cursorPlaneId_, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-                            0, 0);
-            cursorVisible_ = false;
-            OPENAUTO_LOG(info) << "[FFmpegDrmVideoOutput] Cursor hidden";
+            // Stays hidden, so this only logs until the first success
+            OPENAUTO_LOG(warning)
+                << "[FFmpegDrmVideoOutput] Failed to set cursor plane: "
+                << strerror(-ret);
           }
         }
 
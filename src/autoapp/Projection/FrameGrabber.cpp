@@ -0,0 +1,191 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <QBuffer>
+#include <QByteArray>
+#include <QImage>
+#include <linux/dma-buf.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Projection/FrameGrabber.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+#include <f1x/openauto/autoapp/Projection/YuvCopy.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        FrameGrabber &FrameGrabber::instance()
+        {
+          // Leaked: the thread must not be torn down by static destructors
+          static FrameGrabber *grabber = new FrameGrabber();
+          return *grabber;
+        }
+
+        void FrameGrabber::setSource(Source source)
+        {
+          std::lock_guard<std::mutex> lock(sourceMutex_);
+          source_ = std::move(source);
+        }
+
+        bool FrameGrabber::grab(Handler handler, uint32_t maxWidth)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (requests_.size() >= cMaxPending)
+          {
+            return false;
+          }
+          requests_.push_back({std::move(handler), std::max<uint32_t>(maxWidth, 16)});
+          if (!thread_.joinable())
+          {
+            thread_ = std::thread(&FrameGrabber::run, this);
+          }
+          wake_.notify_one();
+          return true;
+        }
+
+        bool FrameGrabber::grabToFile(const std::string &path, uint32_t maxWidth)
+        {
+          return grab([path](const Snapshot &snapshot)
+                      {
+                        if (snapshot.jpeg.empty())
+                        {
+                          OPENAUTO_LOG(warning) << "[FrameGrabber] No snapshot for " << path << ": " << snapshot.error;
+                          return;
+                        }
+                        const std::string temporary = path + ".tmp";
+                        {
+                          std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+                          out.write(reinterpret_cast<const char *>(snapshot.jpeg.data()),
+                                    static_cast<std::streamsize>(snapshot.jpeg.size()));
+                          if (!out.flush())
+                          {
+                            std::remove(temporary.c_str());
+                            return;
+                          }
+                        }
+                        if (std::rename(temporary.c_str(), path.c_str()) != 0)
+                        {
+                          std::remove(temporary.c_str());
+                        }
+                      },
+                      maxWidth);
+        }
+
+        void FrameGrabber::run()
+        {
+          ThreadTopology::instance().apply(ThreadRole::Background, "oa-framegrab");
+
+          std::unique_lock<std::mutex> lock(mutex_);
+          while (true)
+          {
+            wake_.wait(lock, [this]()
+                       { return !requests_.empty(); });
+            Request request = std::move(requests_.front());
+            requests_.pop_front();
+            lock.unlock();
+
+            const Snapshot snapshot = capture(request.maxWidth);
+            if (request.handler)
+            {
+              request.handler(snapshot);
+            }
+            lock.lock();
+          }
+        }
+
+        FrameGrabber::Snapshot FrameGrabber::capture(uint32_t maxWidth)
+        {
+          Snapshot snapshot;
+          GrabbedFrame frame;
+          {
+            std::lock_guard<std::mutex> lock(sourceMutex_);
+            if (!source_ || !source_(frame))
+            {
+              snapshot.error = "no frame on screen";
+              return snapshot;
+            }
+          }
+          snapshot.sourceWidth = frame.width;
+          snapshot.sourceHeight = frame.height;
+          if (!frame.linear)
+          {
+            snapshot.error = "tiled frame";
+            return snapshot;
+          }
+          if (frame.width < 2 || frame.height < 2)
+          {
+            snapshot.error = "empty frame";
+            return snapshot;
+          }
+
+          const size_t lumaEnd = frame.lumaOffset + static_cast<size_t>(frame.lumaPitch) * frame.height;
+          const size_t chromaEnd = frame.chromaOffset + static_cast<size_t>(frame.chromaPitch) * (frame.height / 2);
+          const size_t length = std::max(lumaEnd, chromaEnd);
+          void *map = mmap(nullptr, length, PROT_READ, MAP_SHARED, frame.fd, 0);
+          if (map == MAP_FAILED)
+          {
+            snapshot.error = "cannot map the frame";
+            return snapshot;
+          }
+
+          snapshot.width = std::min(maxWidth, frame.width) & ~1u;
+          snapshot.height = std::max<uint32_t>(2, static_cast<uint32_t>(static_cast<uint64_t>(frame.height) * snapshot.width / frame.width) & ~1u);
+          std::vector<uint8_t> rgb(static_cast<size_t>(snapshot.width) * snapshot.height * 3);
+
+          // The decoder wrote it through the VPU; make that visible to the CPU
+          struct dma_buf_sync sync = {DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ};
+          ioctl(frame.fd, DMA_BUF_IOCTL_SYNC, &sync);
+          const auto *base = static_cast<const uint8_t *>(map);
+          downscaleNv12ToRgb(rgb.data(), static_cast<int>(snapshot.width), static_cast<int>(snapshot.height),
+                             base + frame.lumaOffset, static_cast<int>(frame.lumaPitch),
+                             base + frame.chromaOffset, static_cast<int>(frame.chromaPitch),
+                             static_cast<int>(frame.width), static_cast<int>(frame.height), frame.fullRange);
+          sync.flags = DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ;
+          ioctl(frame.fd, DMA_BUF_IOCTL_SYNC, &sync);
+          munmap(map, length);
+          // Back to the decoder's pool before encoding
+          frame.hold.reset();
+
+          const QImage image(rgb.data(), static_cast<int>(snapshot.width), static_cast<int>(snapshot.height),
+                             static_cast<int>(snapshot.width) * 3, QImage::Format_RGB888);
+          QByteArray jpeg;
+          QBuffer buffer(&jpeg);
+          buffer.open(QIODevice::WriteOnly);
+          if (!image.save(&buffer, "JPG", cJpegQuality))
+          {
+            snapshot.error = "JPEG encoding failed";
+            return snapshot;
+          }
+          snapshot.jpeg.assign(jpeg.constBegin(), jpeg.constEnd());
+          return snapshot;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,343 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef USE_GSTREAMER
+
+#include <cstdlib>
+#include <cstring>
+#include <aasdk/Common/Data.hpp>
+#include <f1x/openauto/autoapp/Projection/GstVideoOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x
+{
+namespace openauto
+{
+namespace autoapp
+{
+namespace projection
+{
+
+GstVideoOutput::GstVideoOutput(configuration::IConfiguration::Pointer configuration)
+    : VideoOutput(std::move(configuration))
+    , pipeline_(nullptr)
+    , appsrc_(nullptr)
+    , hardwareDecoding_(false)
+{
+}
+
+GstVideoOutput::~GstVideoOutput()
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    // Going to NULL frees every buffer still in the pipeline, so all chunks
+    // are back in the pool before it is deleted
+    this->destroyPipeline();
+
+    std::lock_guard<decltype(chunksMutex_)> chunksLock(chunksMutex_);
+    for(auto* chunk : freeChunks_)
+    {
+        delete chunk;
+    }
+}
+
+GstElement* GstVideoOutput::makeElement(const char* factory, const char* name) const
+{
+    GstElement* element = gst_element_factory_make(factory, name);
+    if(element == nullptr)
+    {
+        OPENAUTO_LOG(error) << "[GstVideoOutput] missing element " << factory << ".";
+    }
+    return element;
+}
+
+GstElement* GstVideoOutput::makeDecoder()
+{
+    // V4L2 stateless (rkvdec, hantro, cedrus), then stateful (Pi 4, Amlogic)
+    // decoders when the kernel exposes one, libav in software otherwise
+    for(const char* name : {"v4l2slh264dec", "v4l2h264dec"})
+    {
+        if(GstElementFactory* factory = gst_element_factory_find(name))
+        {
+            gst_object_unref(factory);
+            hardwareDecoding_ = true;
+            OPENAUTO_LOG(info) << "[GstVideoOutput] decoder: " << name << ".";
+            return this->makeElement(name, "decoder");
+        }
+    }
+
+    hardwareDecoding_ = false;
+    OPENAUTO_LOG(info) << "[GstVideoOutput] decoder: avdec_h264.";
+    return this->makeElement("avdec_h264", "decoder");
+}
+
+GstElement* GstVideoOutput::makeSink() const
+{
+    // Without a display server the planes are ours: scan out directly
+    const bool windowed = std::getenv("DISPLAY") != nullptr || std::getenv("WAYLAND_DISPLAY") != nullptr;
+    const char* factory = benchmark_.headless ? "fakesink" : windowed ? "glimagesink" : "kmssink";
+    OPENAUTO_LOG(info) << "[GstVideoOutput] sink: " << factory << ".";
+
+    GstElement* sink = this->makeElement(factory, "sink");
+    if(sink != nullptr)
+    {
+        g_object_set(sink, "sync", FALSE, "async", FALSE, "qos", FALSE, nullptr);
+    }
+    return sink;
+}
+
+bool GstVideoOutput::open()
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+
+    OPENAUTO_LOG(debug) << "[GstVideoOutput] open.";
+
+    if(!gst_is_initialized())
+    {
+        GError* error = nullptr;
+        if(!gst_init_check(nullptr, nullptr, &error))
+        {
+            OPENAUTO_LOG(error) << "[GstVideoOutput] gstreamer init failed: " << (error != nullptr ? error->message : "unknown");
+            g_clear_error(&error);
+            return false;
+        }
+    }
+
+    this->destroyPipeline();
+
+    pipeline_ = gst_pipeline_new("openauto-video");
+    GstElement* source = this->makeElement("appsrc", "source");
+    GstElement* parser = this->makeElement("h264parse", "parser");
+    GstElement* decoder = this->makeDecoder();
+    GstElement* queue = this->makeElement("queue", "queue");
+    GstElement* sink = this->makeSink();
+
+    if(source == nullptr || parser == nullptr || decoder == nullptr || queue == nullptr || sink == nullptr)
+    {
+        for(GstElement* element : {source, parser, decoder, queue, sink})
+        {
+            if(element != nullptr)
+            {
+                gst_object_unref(element);
+            }
+        }
+        gst_object_unref(pipeline_);
+        pipeline_ = nullptr;
+        return false;
+    }
+
+    GstCaps* caps = gst_caps_new_simple("video/x-h264", "stream-format", G_TYPE_STRING, "byte-stream", nullptr);
+    // write() stamps each buffer with its arrival time, so the decoded frame
+    // tells how long it spent in the pipeline
+    g_object_set(source, "caps", caps, "is-live", TRUE, "format", GST_FORMAT_TIME, "do-timestamp", FALSE, "block", FALSE, nullptr);
+    gst_caps_unref(caps);
+
+    // Decoded frames past the target are stale: drop the oldest instead of
+    // letting the backlog grow behind a slow sink
+    g_object_set(queue, "leaky", 2, "max-size-buffers", 0u, "max-size-bytes", 0u,
+                 "max-size-time", static_cast<guint64>(cLatencyTargetMs * GST_MSECOND), nullptr);
+    g_object_set(parser, "config-interval", -1, nullptr);
+
+    gst_bin_add_many(GST_BIN(pipeline_), source, parser, decoder, queue, sink, nullptr);
+    if(!gst_element_link_many(source, parser, decoder, queue, sink, nullptr))
+    {
+        OPENAUTO_LOG(error) << "[GstVideoOutput] could not link the pipeline.";
+        gst_object_unref(pipeline_);
+        pipeline_ = nullptr;
+        return false;
+    }
+
+    GstPad* sinkPad = gst_element_get_static_pad(sink, "sink");
+    gst_pad_add_probe(sinkPad, GST_PAD_PROBE_TYPE_BUFFER, &GstVideoOutput::onFrameDecoded, nullptr, nullptr);
+    gst_object_unref(sinkPad);
+
+    GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+    gst_bus_set_sync_handler(bus, &GstVideoOutput::onBusMessage, this, nullptr);
+    gst_object_unref(bus);
+
+    appsrc_ = GST_APP_SRC(source);
+    return true;
+}
+
+bool GstVideoOutput::init()
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+
+    OPENAUTO_LOG(debug) << "[GstVideoOutput] init.";
+
+    if(pipeline_ == nullptr)
+    {
+        return false;
+    }
+
+    if(gst_element_set_state(pipeline_, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    {
+        OPENAUTO_LOG(error) << "[GstVideoOutput] pipeline failed to start.";
+        return false;
+    }
+    VideoTelemetry::instance().reset();
+    return true;
+}
+
+void GstVideoOutput::write(uint64_t, const aasdk::common::DataConstBuffer& buffer)
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+
+    if(appsrc_ == nullptr)
+    {
+        return;
+    }
+
+    // aasdk lends the frame only until write() returns: it is copied once
+    // into a pooled chunk that the pipeline hands back when it is done
+    Chunk* chunk = this->acquireChunk(buffer.size);
+    std::memcpy(chunk->data(), buffer.cdata, buffer.size);
+
+    auto* release = new ChunkRelease{this, chunk};
+    GstBuffer* frame = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, chunk->data(), chunk->size(), 0, buffer.size,
+                                                   release, &GstVideoOutput::onChunkReleased);
+    GST_BUFFER_PTS(frame) = static_cast<GstClockTime>(VideoTelemetry::nowUs()) * GST_USECOND;
+
+    if(gst_app_src_push_buffer(appsrc_, frame) != GST_FLOW_OK)
+    {
+        OPENAUTO_LOG(warning) << "[GstVideoOutput] appsrc refused a frame.";
+    }
+}
+
+void GstVideoOutput::stop()
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+
+    OPENAUTO_LOG(debug) << "[GstVideoOutput] stop.";
+
+    this->destroyPipeline();
+}
+
+void GstVideoOutput::setBenchmarkOptions(const BenchmarkOptions& options)
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    benchmark_ = options;
+}
+
+bool GstVideoOutput::isHardwareDecoding() const
+{
+    return hardwareDecoding_;
+}
+
+void GstVideoOutput::destroyPipeline()
+{
+    if(pipeline_ == nullptr)
+    {
+        return;
+    }
+
+    gst_element_set_state(pipeline_, GST_STATE_NULL);
+    gst_object_unref(pipeline_);
+    pipeline_ = nullptr;
+    appsrc_ = nullptr;
+}
+
+GstVideoOutput::Chunk* GstVideoOutput::acquireChunk(size_t size)
+{
+    Chunk* chunk = nullptr;
+    {
+        std::lock_guard<decltype(chunksMutex_)> lock(chunksMutex_);
+        if(!freeChunks_.empty())
+        {
+            chunk = freeChunks_.back();
+            freeChunks_.pop_back();
+        }
+    }
+
+    if(chunk == nullptr)
+    {
+        chunk = new Chunk();
+    }
+    // Grows to the largest frame seen, so keyframes stop allocating after
+    // the first few
+    if(chunk->size() < size)
+    {
+        chunk->resize(size);
+    }
+    return chunk;
+}
+
+void GstVideoOutput::releaseChunk(Chunk* chunk)
+{
+    {
+        std::lock_guard<decltype(chunksMutex_)> lock(chunksMutex_);
+        if(freeChunks_.size() < cChunkPoolSize)
+        {
+            freeChunks_.push_back(chunk);
+            return;
+        }
+    }
+    delete chunk;
+}
+
+void GstVideoOutput::onChunkReleased(gpointer data)
+{
+    auto* release = static_cast<ChunkRelease*>(data);
+    release->owner->releaseChunk(release->chunk);
+    delete release;
+}
+
+GstPadProbeReturn GstVideoOutput::onFrameDecoded(GstPad*, GstPadProbeInfo* info, gpointer)
+{
+    // Runs on the sink's streaming thread, as the frame is handed to it
+    const GstBuffer* frame = GST_PAD_PROBE_INFO_BUFFER(info);
+    VideoFrameTiming timing;
+    timing.flipUs = VideoTelemetry::nowUs();
+    if(frame != nullptr && GST_BUFFER_PTS_IS_VALID(frame))
+    {
+        timing.arrivalUs = static_cast<int64_t>(GST_BUFFER_PTS(frame) / GST_USECOND);
+    }
+    VideoTelemetry::instance().recordFrame(timing);
+    return GST_PAD_PROBE_OK;
+}
+
+GstBusSyncReply GstVideoOutput::onBusMessage(GstBus*, GstMessage* message, gpointer)
+{
+    if(GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR || GST_MESSAGE_TYPE(message) == GST_MESSAGE_WARNING)
+    {
+        GError* error = nullptr;
+        gchar* debug = nullptr;
+        if(GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR)
+        {
+            gst_message_parse_error(message, &error, &debug);
+            OPENAUTO_LOG(error) << "[GstVideoOutput] " << GST_OBJECT_NAME(GST_MESSAGE_SRC(message)) << ": " << error->message;
+        }
+        else
+        {
+            gst_message_parse_warning(message, &error, &debug);
+            OPENAUTO_LOG(warning) << "[GstVideoOutput] " << GST_OBJECT_NAME(GST_MESSAGE_SRC(message)) << ": " << error->message;
+        }
+        g_clear_error(&error);
+        g_free(debug);
+    }
+
+    // Nobody polls this bus: drop everything once it has been logged
+    return GST_BUS_DROP;
+}
+
+}
+}
+}
+}
+
+#endif
@@ -0,0 +1,842 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/autoapp/Projection/H264HeaderParser.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          // Scan position -> raster position (frame scan, 8.5.6)
+          constexpr uint8_t cZigzag4x4[16] = {0, 1, 4, 8, 5, 2, 3, 6, 9, 12, 13, 10, 7, 11, 14, 15};
+          constexpr uint8_t cZigzag8x8[64] = {
+              0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+              12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+              35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+              58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+          // Table 7-3 and 7-4, in scan order
+          constexpr uint8_t cDefault4x4Intra[16] = {6, 13, 13, 20, 20, 20, 28, 28, 28, 28, 32, 32, 32, 37, 37, 42};
+          constexpr uint8_t cDefault4x4Inter[16] = {10, 14, 14, 20, 20, 20, 24, 24, 24, 24, 27, 27, 27, 30, 30, 34};
+          constexpr uint8_t cDefault8x8Intra[64] = {
+              6, 10, 10, 13, 11, 13, 16, 16, 16, 16, 18, 18, 18, 18, 18, 23,
+              23, 23, 23, 23, 23, 25, 25, 25, 25, 25, 25, 25, 27, 27, 27, 27,
+              27, 27, 27, 27, 29, 29, 29, 29, 29, 29, 29, 31, 31, 31, 31, 31,
+              31, 33, 33, 33, 33, 33, 36, 36, 36, 36, 38, 38, 38, 40, 40, 42};
+          constexpr uint8_t cDefault8x8Inter[64] = {
+              9, 13, 13, 15, 13, 15, 17, 17, 17, 17, 19, 19, 19, 19, 19, 21,
+              21, 21, 21, 21, 21, 22, 22, 22, 22, 22, 22, 22, 24, 24, 24, 24,
+              24, 24, 24, 24, 25, 25, 25, 25, 25, 25, 25, 27, 27, 27, 27, 27,
+              27, 28, 28, 28, 28, 28, 30, 30, 30, 30, 32, 32, 32, 33, 33, 35};
+
+          // Default lists per list index in raster order: 4x4 Intra Y/Cb/Cr,
+          // Inter Y/Cb/Cr; 8x8 Intra Y, Inter Y, Intra Cb, Inter Cb, ...
+          struct DefaultScalingLists
+          {
+            uint8_t list4x4[6][16];
+            uint8_t list8x8[6][64];
+
+            DefaultScalingLists()
+            {
+              for (size_t i = 0; i < 6; i++)
+              {
+                for (size_t j = 0; j < 16; j++)
+                {
+                  list4x4[i][cZigzag4x4[j]] = i < 3 ? cDefault4x4Intra[j] : cDefault4x4Inter[j];
+                }
+                for (size_t j = 0; j < 64; j++)
+                {
+                  list8x8[i][cZigzag8x8[j]] = i % 2 == 0 ? cDefault8x8Intra[j] : cDefault8x8Inter[j];
+                }
+              }
+            }
+          };
+
+          const DefaultScalingLists &defaultScalingLists()
+          {
+            static const DefaultScalingLists lists;
+            return lists;
+          }
+
+          bool hasChromaFormat(uint8_t profileIdc)
+          {
+            switch (profileIdc)
+            {
+            case 100:
+            case 110:
+            case 122:
+            case 244:
+            case 44:
+            case 83:
+            case 86:
+            case 118:
+            case 128:
+            case 138:
+            case 139:
+            case 134:
+            case 135:
+              return true;
+            default:
+              return false;
+            }
+          }
+
+          // Upper bounds on repeated syntax, so a corrupt header cannot spin
+          constexpr size_t cMaxListModifications = 33;
+          constexpr size_t cMaxMemoryManagementOps = 66;
+        }
+
+        uint32_t H264Sps::codedWidth() const
+        {
+          return (picWidthInMbsMinus1 + 1) * 16;
+        }
+
+        uint32_t H264Sps::codedHeight() const
+        {
+          return (picHeightInMapUnitsMinus1 + 1) * 16 * (frameMbsOnly ? 1 : 2);
+        }
+
+        uint32_t H264Sps::width() const
+        {
+          return codedWidth() - cropLeft - cropRight;
+        }
+
+        uint32_t H264Sps::height() const
+        {
+          return codedHeight() - cropTop - cropBottom;
+        }
+
+        uint32_t H264Sps::maxFrameNum() const
+        {
+          return 1u << (log2MaxFrameNumMinus4 + 4);
+        }
+
+        H264HeaderParser::BitReader::BitReader(const std::vector<uint8_t> &bytes, size_t startBit)
+            : bytes_(bytes), position_(startBit)
+        {
+        }
+
+        uint32_t H264HeaderParser::BitReader::u(int count)
+        {
+          uint32_t value = 0;
+          for (int i = 0; i < count; i++, position_++)
+          {
+            if (position_ >= bytes_.size() * 8)
+            {
+              failed_ = true;
+              return 0;
+            }
+            value = (value << 1) | ((bytes_[position_ / 8] >> (7 - position_ % 8)) & 1);
+          }
+          return value;
+        }
+
+        uint32_t H264HeaderParser::BitReader::ue()
+        {
+          int zeros = 0;
+          while (u(1) == 0)
+          {
+            if (failed_ || ++zeros > 31)
+            {
+              failed_ = true;
+              return 0;
+            }
+          }
+          return static_cast<uint32_t>((uint64_t(1) << zeros) - 1 + u(zeros));
+        }
+
+        int32_t H264HeaderParser::BitReader::se()
+        {
+          const uint32_t code = ue();
+          return code & 1 ? static_cast<int32_t>((code + 1) / 2) : -static_cast<int32_t>(code / 2);
+        }
+
+        bool H264HeaderParser::BitReader::moreRbspData() const
+        {
+          // Everything before the rbsp_stop_one_bit is syntax
+          for (size_t i = bytes_.size(); i > 0; i--)
+          {
+            const uint8_t byte = bytes_[i - 1];
+            if (byte != 0)
+            {
+              int trailing = 0;
+              while (((byte >> trailing) & 1) == 0)
+              {
+                trailing++;
+              }
+              return position_ < (i - 1) * 8 + static_cast<size_t>(7 - trailing);
+            }
+          }
+          return false;
+        }
+
+        std::vector<H264NalUnit> H264HeaderParser::splitAnnexB(const uint8_t *data, size_t size)
+        {
+          std::vector<H264NalUnit> units;
+          size_t start = SIZE_MAX;
+          size_t i = 0;
+          while (i + 2 < size)
+          {
+            if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1)
+            {
+              if (start != SIZE_MAX)
+              {
+                // A 4-byte start code leaves its leading zero on the previous unit
+                size_t end = i;
+                while (end > start && data[end - 1] == 0)
+                {
+                  end--;
+                }
+                units.push_back(H264NalUnit{data + start, end - start, 0, 0});
+              }
+              i += 3;
+              start = i;
+            }
+            else
+            {
+              i++;
+            }
+          }
+          if (start != SIZE_MAX && start < size)
+          {
+            units.push_back(H264NalUnit{data + start, size - start, 0, 0});
+          }
+
+          units.erase(std::remove_if(units.begin(), units.end(), [](const H264NalUnit &unit)
+                                     { return unit.size == 0; }),
+                      units.end());
+          for (auto &unit : units)
+          {
+            unit.type = unit.data[0] & 0x1f;
+            unit.refIdc = (unit.data[0] >> 5) & 0x03;
+          }
+          return units;
+        }
+
+        void H264HeaderParser::unescape(const uint8_t *data, size_t size, std::vector<uint8_t> &rbsp,
+                                        size_t limit)
+        {
+          rbsp.clear();
+          rbsp.reserve(std::min(size, limit));
+          int zeros = 0;
+          for (size_t i = 0; i < size && rbsp.size() < limit; i++)
+          {
+            if (zeros == 2 && data[i] == 3)
+            {
+              zeros = 0;
+              continue;
+            }
+            rbsp.push_back(data[i]);
+            zeros = data[i] == 0 ? zeros + 1 : 0;
+          }
+        }
+
+        void H264HeaderParser::scalingList(BitReader &reader, uint8_t *list, size_t size,
+                                           const uint8_t *defaultList, const uint8_t *fallback)
+        {
+          if (!reader.flag())
+          {
+            std::memcpy(list, fallback, size);
+            return;
+          }
+
+          const uint8_t *scan = size == 16 ? cZigzag4x4 : cZigzag8x8;
+          int32_t last = 8;
+          int32_t next = 8;
+          for (size_t j = 0; j < size; j++)
+          {
+            if (next != 0)
+            {
+              next = (last + reader.se() + 256) % 256;
+              if (j == 0 && next == 0)
+              {
+                // useDefaultScalingMatrixFlag
+                std::memcpy(list, defaultList, size);
+                return;
+              }
+            }
+            const int32_t value = next == 0 ? last : next;
+            list[scan[j]] = static_cast<uint8_t>(value);
+            last = value;
+          }
+        }
+
+        void H264HeaderParser::scalingMatrix(BitReader &reader, size_t count8x8, uint8_t list4x4[6][16],
+                                             uint8_t list8x8[6][64], const uint8_t fallback4x4[6][16],
+                                             const uint8_t fallback8x8[6][64])
+        {
+          // Fall-back rules of Table 7-2: the first Intra and Inter lists fall
+          // back to fallback*, later ones to the list before them
+          const DefaultScalingLists &defaults = defaultScalingLists();
+          for (size_t i = 0; i < 6; i++)
+          {
+            const uint8_t *fallback = i == 0 || i == 3 ? fallback4x4[i] : list4x4[i - 1];
+            scalingList(reader, list4x4[i], 16, defaults.list4x4[i], fallback);
+          }
+          for (size_t i = 0; i < 6; i++)
+          {
+            const uint8_t *fallback = i < 2 ? fallback8x8[i] : list8x8[i - 2];
+            if (i < count8x8)
+            {
+              scalingList(reader, list8x8[i], 64, defaults.list8x8[i], fallback);
+            }
+            else
+            {
+              std::memcpy(list8x8[i], fallback, 64);
+            }
+          }
+        }
+
+        void H264HeaderParser::parseVui(BitReader &reader, H264Sps &sps)
+        {
+          // Only the colour description is used; the rest of the VUI is skipped
+          if (reader.flag()) // aspect_ratio_info_present_flag
+          {
+            if (reader.u(8) == 255) // Extended_SAR
+            {
+              reader.u(16);
+              reader.u(16);
+            }
+          }
+          if (reader.flag()) // overscan_info_present_flag
+          {
+            reader.u(1);
+          }
+          if (reader.flag()) // video_signal_type_present_flag
+          {
+            reader.u(3);
+            sps.fullRange = reader.flag();
+            if (reader.flag()) // colour_description_present_flag
+            {
+              reader.u(8);
+              reader.u(8);
+              sps.matrixCoefficients = reader.u(8);
+            }
+          }
+        }
+
+        bool H264HeaderParser::parseSps(const H264NalUnit &nal)
+        {
+          unescape(nal.data, nal.size, rbsp_);
+          BitReader reader(rbsp_, 8);
+          auto sps = std::make_unique<H264Sps>();
+
+          sps->profileIdc = static_cast<uint8_t>(reader.u(8));
+          const uint32_t constraints = reader.u(8);
+          for (int i = 0; i < 6; i++)
+          {
+            if (constraints & (0x80u >> i))
+            {
+              sps->constraintSetFlags |= static_cast<uint8_t>(1u << i);
+            }
+          }
+          sps->levelIdc = static_cast<uint8_t>(reader.u(8));
+          sps->id = reader.ue();
+          if (reader.failed() || sps->id >= cMaxSps)
+          {
+            return false;
+          }
+
+          const DefaultScalingLists &defaults = defaultScalingLists();
+          std::memset(sps->scalingList4x4, 16, sizeof(sps->scalingList4x4));
+          std::memset(sps->scalingList8x8, 16, sizeof(sps->scalingList8x8));
+          if (hasChromaFormat(sps->profileIdc))
+          {
+            sps->chromaFormatIdc = reader.ue();
+            if (sps->chromaFormatIdc > 3)
+            {
+              return false;
+            }
+            if (sps->chromaFormatIdc == 3)
+            {
+              sps->separateColourPlane = reader.flag();
+            }
+            sps->bitDepthLumaMinus8 = reader.ue();
+            sps->bitDepthChromaMinus8 = reader.ue();
+            sps->qpprimeYZeroTransformBypass = reader.flag();
+            sps->scalingMatrixPresent = reader.flag();
+            if (sps->scalingMatrixPresent)
+            {
+              scalingMatrix(reader, sps->chromaFormatIdc != 3 ? 2 : 6, sps->scalingList4x4,
+                            sps->scalingList8x8, defaults.list4x4, defaults.list8x8);
+            }
+          }
+
+          sps->log2MaxFrameNumMinus4 = reader.ue();
+          sps->picOrderCntType = reader.ue();
+          if (sps->log2MaxFrameNumMinus4 > 12 || sps->picOrderCntType > 2)
+          {
+            return false;
+          }
+          if (sps->picOrderCntType == 0)
+          {
+            sps->log2MaxPicOrderCntLsbMinus4 = reader.ue();
+            if (sps->log2MaxPicOrderCntLsbMinus4 > 12)
+            {
+              return false;
+            }
+          }
+          else if (sps->picOrderCntType == 1)
+          {
+            sps->deltaPicOrderAlwaysZero = reader.flag();
+            sps->offsetForNonRefPic = reader.se();
+            sps->offsetForTopToBottomField = reader.se();
+            sps->numRefFramesInPicOrderCntCycle = reader.ue();
+            if (sps->numRefFramesInPicOrderCntCycle > 255)
+            {
+              return false;
+            }
+            for (uint32_t i = 0; i < sps->numRefFramesInPicOrderCntCycle; i++)
+            {
+              sps->offsetForRefFrame[i] = reader.se();
+            }
+          }
+
+          sps->maxNumRefFrames = reader.ue();
+          sps->gapsInFrameNumAllowed = reader.flag();
+          sps->picWidthInMbsMinus1 = reader.ue();
+          sps->picHeightInMapUnitsMinus1 = reader.ue();
+          sps->frameMbsOnly = reader.flag();
+          if (!sps->frameMbsOnly)
+          {
+            sps->mbAdaptiveFrameField = reader.flag();
+          }
+          sps->direct8x8Inference = reader.flag();
+          if (sps->maxNumRefFrames > 16 || sps->picWidthInMbsMinus1 > 1023 ||
+              sps->picHeightInMapUnitsMinus1 > 1023)
+          {
+            return false;
+          }
+
+          if (reader.flag()) // frame_cropping_flag
+          {
+            const uint32_t chromaArrayType = sps->separateColourPlane ? 0 : sps->chromaFormatIdc;
+            const uint32_t cropUnitX = chromaArrayType == 1 || chromaArrayType == 2 ? 2 : 1;
+            const uint32_t cropUnitY = (chromaArrayType == 1 ? 2 : 1) * (sps->frameMbsOnly ? 1 : 2);
+            sps->cropLeft = reader.ue() * cropUnitX;
+            sps->cropRight = reader.ue() * cropUnitX;
+            sps->cropTop = reader.ue() * cropUnitY;
+            sps->cropBottom = reader.ue() * cropUnitY;
+            if (sps->cropLeft + sps->cropRight >= sps->codedWidth() ||
+                sps->cropTop + sps->cropBottom >= sps->codedHeight())
+            {
+              return false;
+            }
+          }
+
+          if (reader.failed())
+          {
+            return false;
+          }
+          if (reader.flag()) // vui_parameters_present_flag
+          {
+            // A truncated VUI still leaves a usable SPS
+            H264Sps vui = *sps;
+            parseVui(reader, vui);
+            if (!reader.failed())
+            {
+              sps->fullRange = vui.fullRange;
+              sps->matrixCoefficients = vui.matrixCoefficients;
+            }
+          }
+
+          const uint32_t id = sps->id;
+          sps_[id] = std::move(sps);
+          return true;
+        }
+
+        bool H264HeaderParser::parsePps(const H264NalUnit &nal)
+        {
+          unescape(nal.data, nal.size, rbsp_);
+          BitReader reader(rbsp_, 8);
+          auto pps = std::make_unique<H264Pps>();
+
+          pps->id = reader.ue();
+          pps->spsId = reader.ue();
+          if (reader.failed() || pps->id >= cMaxPps || pps->spsId >= cMaxSps || !sps_[pps->spsId])
+          {
+            return false;
+          }
+          const H264Sps &sps = *sps_[pps->spsId];
+
+          pps->entropyCodingMode = reader.flag();
+          pps->bottomFieldPicOrderInFramePresent = reader.flag();
+          pps->numSliceGroupsMinus1 = reader.ue();
+          if (pps->numSliceGroupsMinus1 > 7)
+          {
+            return false;
+          }
+          if (pps->numSliceGroupsMinus1 > 0)
+          {
+            pps->sliceGroupMapType = reader.ue();
+            if (pps->sliceGroupMapType == 0)
+            {
+              for (uint32_t group = 0; group <= pps->numSliceGroupsMinus1; group++)
+              {
+                reader.ue(); // run_length_minus1
+              }
+            }
+            else if (pps->sliceGroupMapType == 2)
+            {
+              for (uint32_t group = 0; group < pps->numSliceGroupsMinus1; group++)
+              {
+                reader.ue(); // top_left
+                reader.ue(); // bottom_right
+              }
+            }
+            else if (pps->sliceGroupMapType >= 3 && pps->sliceGroupMapType <= 5)
+            {
+              reader.u(1); // slice_group_change_direction_flag
+              pps->sliceGroupChangeRateMinus1 = reader.ue();
+            }
+            else if (pps->sliceGroupMapType == 6)
+            {
+              int idBits = 0;
+              while ((1u << idBits) < pps->numSliceGroupsMinus1 + 1)
+              {
+                idBits++;
+              }
+              const uint32_t mapUnits = reader.ue() + 1;
+              if (mapUnits > (sps.picWidthInMbsMinus1 + 1) * (sps.picHeightInMapUnitsMinus1 + 1))
+              {
+                return false;
+              }
+              for (uint32_t i = 0; i < mapUnits && !reader.failed(); i++)
+              {
+                reader.u(idBits);
+              }
+            }
+            else if (pps->sliceGroupMapType > 6)
+            {
+              return false;
+            }
+          }
+
+          pps->numRefIdxL0DefaultActiveMinus1 = reader.ue();
+          pps->numRefIdxL1DefaultActiveMinus1 = reader.ue();
+          pps->weightedPred = reader.flag();
+          pps->weightedBipredIdc = reader.u(2);
+          pps->picInitQpMinus26 = reader.se();
+          pps->picInitQsMinus26 = reader.se();
+          pps->chromaQpIndexOffset = reader.se();
+          pps->deblockingFilterControlPresent = reader.flag();
+          pps->constrainedIntraPred = reader.flag();
+          pps->redundantPicCntPresent = reader.flag();
+          pps->secondChromaQpIndexOffset = pps->chromaQpIndexOffset;
+          if (pps->numRefIdxL0DefaultActiveMinus1 > 31 || pps->numRefIdxL1DefaultActiveMinus1 > 31 ||
+              pps->weightedBipredIdc > 2)
+          {
+            return false;
+          }
+
+          // Without its own lists the PPS uses the sequence's; fall-back rule B
+          // applies to lists it leaves out, rule A if the SPS has none either
+          std::memcpy(pps->scalingList4x4, sps.scalingList4x4, sizeof(pps->scalingList4x4));
+          std::memcpy(pps->scalingList8x8, sps.scalingList8x8, sizeof(pps->scalingList8x8));
+          pps->scalingMatrixPresent = sps.scalingMatrixPresent;
+          if (!reader.failed() && reader.moreRbspData())
+          {
+            pps->transform8x8Mode = reader.flag();
+            if (reader.flag()) // pic_scaling_matrix_present_flag
+            {
+              const DefaultScalingLists &defaults = defaultScalingLists();
+              const size_t count8x8 = pps->transform8x8Mode ? (sps.chromaFormatIdc != 3 ? 2 : 6) : 0;
+              scalingMatrix(reader, count8x8, pps->scalingList4x4, pps->scalingList8x8,
+                            sps.scalingMatrixPresent ? sps.scalingList4x4 : defaults.list4x4,
+                            sps.scalingMatrixPresent ? sps.scalingList8x8 : defaults.list8x8);
+              pps->scalingMatrixPresent = true;
+            }
+            pps->secondChromaQpIndexOffset = reader.se();
+          }
+
+          if (reader.failed())
+          {
+            return false;
+          }
+          pps_[pps->id] = std::move(pps);
+          return true;
+        }
+
+        bool H264HeaderParser::parseSliceHeader(const H264NalUnit &nal, H264SliceHeader &header) const
+        {
+          if (nal.size < 2 || (nal.type != cNalSlice && nal.type != cNalIdr))
+          {
+            return false;
+          }
+
+          // Unescape only what a header can possibly span
+          unescape(nal.data, nal.size, rbsp_, cSliceHeaderBytes);
+          BitReader reader(rbsp_, 8);
+
+          header = H264SliceHeader();
+          header.nalUnitType = nal.type;
+          header.nalRefIdc = nal.refIdc;
+          header.firstMbInSlice = reader.ue();
+          const uint32_t sliceType = reader.ue();
+          header.ppsId = reader.ue();
+          if (reader.failed() || sliceType > 9 || header.ppsId >= cMaxPps || !pps_[header.ppsId])
+          {
+            return false;
+          }
+          header.sliceType = sliceType % 5;
+
+          const H264Pps &pps = *pps_[header.ppsId];
+          if (!sps_[pps.spsId])
+          {
+            return false;
+          }
+          return parseSliceHeader(reader, *sps_[pps.spsId], pps, header);
+        }
+
+        bool H264HeaderParser::parseSliceHeader(BitReader &reader, const H264Sps &sps, const H264Pps &pps,
+                                                H264SliceHeader &header)
+        {
+          const uint32_t type = header.sliceType;
+          const bool intra = type == H264SliceHeader::cSliceI || type == H264SliceHeader::cSliceSi;
+          const bool bidirectional = type == H264SliceHeader::cSliceB;
+
+          if (sps.separateColourPlane)
+          {
+            header.colourPlaneId = reader.u(2);
+          }
+          header.frameNum = reader.u(static_cast<int>(sps.log2MaxFrameNumMinus4 + 4));
+          if (!sps.frameMbsOnly)
+          {
+            header.fieldPic = reader.flag();
+            if (header.fieldPic)
+            {
+              header.bottomField = reader.flag();
+            }
+          }
+          if (header.idr())
+          {
+            header.idrPicId = reader.ue();
+          }
+
+          const size_t picOrderCntStart = reader.position();
+          if (sps.picOrderCntType == 0)
+          {
+            header.picOrderCntLsb = reader.u(static_cast<int>(sps.log2MaxPicOrderCntLsbMinus4 + 4));
+            if (pps.bottomFieldPicOrderInFramePresent && !header.fieldPic)
+            {
+              header.deltaPicOrderCntBottom = reader.se();
+            }
+          }
+          if (sps.picOrderCntType == 1 && !sps.deltaPicOrderAlwaysZero)
+          {
+            header.deltaPicOrderCnt[0] = reader.se();
+            if (pps.bottomFieldPicOrderInFramePresent && !header.fieldPic)
+            {
+              header.deltaPicOrderCnt[1] = reader.se();
+            }
+          }
+          header.picOrderCntBitSize = static_cast<uint32_t>(reader.position() - picOrderCntStart);
+
+          if (pps.redundantPicCntPresent)
+          {
+            header.redundantPicCnt = reader.ue();
+          }
+          if (bidirectional)
+          {
+            header.directSpatialMvPred = reader.flag();
+          }
+
+          header.numRefIdxL0ActiveMinus1 = pps.numRefIdxL0DefaultActiveMinus1;
+          header.numRefIdxL1ActiveMinus1 = pps.numRefIdxL1DefaultActiveMinus1;
+          if (!intra && reader.flag()) // num_ref_idx_active_override_flag
+          {
+            header.numRefIdxL0ActiveMinus1 = reader.ue();
+            if (bidirectional)
+            {
+              header.numRefIdxL1ActiveMinus1 = reader.ue();
+            }
+          }
+          if (header.numRefIdxL0ActiveMinus1 > 31 || header.numRefIdxL1ActiveMinus1 > 31)
+          {
+            return false;
+          }
+
+          // ref_pic_list_modification(): the hardware builds the lists itself
+          for (int list = 0; list < (intra ? 0 : bidirectional ? 2 : 1); list++)
+          {
+            if (!reader.flag())
+            {
+              continue;
+            }
+            size_t count = 0;
+            for (uint32_t idc = reader.ue(); idc != 3; idc = reader.ue())
+            {
+              if (idc > 5 || ++count > cMaxListModifications || reader.failed())
+              {
+                return false;
+              }
+              reader.ue(); // abs_diff_pic_num_minus1 / long_term_pic_num
+            }
+          }
+
+          // pred_weight_table()
+          if ((pps.weightedPred && (type == H264SliceHeader::cSliceP || type == H264SliceHeader::cSliceSp)) ||
+              (pps.weightedBipredIdc == 1 && bidirectional))
+          {
+            const bool chroma = !sps.separateColourPlane && sps.chromaFormatIdc != 0;
+            reader.ue(); // luma_log2_weight_denom
+            if (chroma)
+            {
+              reader.ue(); // chroma_log2_weight_denom
+            }
+            for (int list = 0; list < (bidirectional ? 2 : 1); list++)
+            {
+              const uint32_t count = (list == 0 ? header.numRefIdxL0ActiveMinus1 : header.numRefIdxL1ActiveMinus1) + 1;
+              for (uint32_t i = 0; i < count; i++)
+              {
+                if (reader.flag())
+                {
+                  reader.se();
+                  reader.se();
+                }
+                if (chroma && reader.flag())
+                {
+                  reader.se();
+                  reader.se();
+                  reader.se();
+                  reader.se();
+                }
+              }
+            }
+          }
+
+          if (header.nalRefIdc != 0)
+          {
+            const size_t markingStart = reader.position();
+            if (header.idr())
+            {
+              header.noOutputOfPriorPics = reader.flag();
+              header.longTermReference = reader.flag();
+            }
+            else
+            {
+              header.adaptiveRefPicMarking = reader.flag();
+              if (header.adaptiveRefPicMarking)
+              {
+                for (uint32_t operation = reader.ue(); operation != 0; operation = reader.ue())
+                {
+                  if (operation > 6 || header.memoryManagementOps.size() >= cMaxMemoryManagementOps ||
+                      reader.failed())
+                  {
+                    return false;
+                  }
+                  H264MemoryManagementOp op;
+                  op.operation = operation;
+                  if (operation == 1 || operation == 3)
+                  {
+                    op.differenceOfPicNumsMinus1 = reader.ue();
+                  }
+                  if (operation == 2)
+                  {
+                    op.longTermPicNum = reader.ue();
+                  }
+                  if (operation == 3 || operation == 6)
+                  {
+                    op.longTermFrameIdx = reader.ue();
+                  }
+                  if (operation == 4)
+                  {
+                    op.maxLongTermFrameIdxPlus1 = reader.ue();
+                  }
+                  header.memoryManagementOps.push_back(op);
+                }
+              }
+            }
+            header.decRefPicMarkingBitSize = static_cast<uint32_t>(reader.position() - markingStart);
+          }
+
+          if (pps.entropyCodingMode && !intra)
+          {
+            header.cabacInitIdc = reader.ue();
+          }
+          header.sliceQpDelta = reader.se();
+          if (type == H264SliceHeader::cSliceSp || type == H264SliceHeader::cSliceSi)
+          {
+            if (type == H264SliceHeader::cSliceSp)
+            {
+              reader.u(1); // sp_for_switch_flag
+            }
+            header.sliceQsDelta = reader.se();
+          }
+          if (pps.deblockingFilterControlPresent)
+          {
+            header.disableDeblockingFilterIdc = reader.ue();
+            if (header.disableDeblockingFilterIdc != 1)
+            {
+              header.sliceAlphaC0OffsetDiv2 = reader.se();
+              header.sliceBetaOffsetDiv2 = reader.se();
+            }
+          }
+          if (pps.numSliceGroupsMinus1 > 0 && pps.sliceGroupMapType >= 3 && pps.sliceGroupMapType <= 5)
+          {
+            // Ceil(Log2(PicSizeInMapUnits / SliceGroupChangeRate + 1))
+            const uint64_t mapUnits = uint64_t(sps.picWidthInMbsMinus1 + 1) * (sps.picHeightInMapUnitsMinus1 + 1);
+            const uint64_t rate = pps.sliceGroupChangeRateMinus1 + 1;
+            int bits = 0;
+            while ((rate << bits) < mapUnits + rate)
+            {
+              bits++;
+            }
+            header.sliceGroupChangeCycle = reader.u(bits);
+          }
+
+          header.headerBitSize = static_cast<uint32_t>(reader.position());
+          return !reader.failed() && header.cabacInitIdc <= 2 && header.disableDeblockingFilterIdc <= 2;
+        }
+
+        const H264Sps *H264HeaderParser::sps(uint32_t id) const
+        {
+          return id < cMaxSps ? sps_[id].get() : nullptr;
+        }
+
+        const H264Pps *H264HeaderParser::pps(uint32_t id) const
+        {
+          return id < cMaxPps ? pps_[id].get() : nullptr;
+        }
+
+        void H264HeaderParser::reset()
+        {
+          for (auto &sps : sps_)
+          {
+            sps.reset();
+          }
+          for (auto &pps : pps_)
+          {
+            pps.reset();
+          }
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
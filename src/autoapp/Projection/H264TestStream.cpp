@@ -0,0 +1,257 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/autoapp/Projection/H264TestStream.hpp>
+
+#include <algorithm>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          constexpr uint8_t cNalSps = 0x67;      // nal_ref_idc 3, type 7
+          constexpr uint8_t cNalPps = 0x68;      // nal_ref_idc 3, type 8
+          constexpr uint8_t cNalIdr = 0x65;      // nal_ref_idc 3, type 5
+          constexpr uint8_t cNalSlice = 0x41;    // nal_ref_idc 2, type 1
+          constexpr uint32_t cLog2MaxFrameNum = 4;
+          constexpr uint32_t cMbTypeIPcm = 25;
+          constexpr uint32_t cSliceTypeP = 5;    // All slices of the picture are P
+          constexpr uint32_t cSliceTypeI = 7;    // All slices of the picture are I
+        }
+
+        void H264TestStream::BitWriter::bits(uint32_t value, int count)
+        {
+          for (int bit = count - 1; bit >= 0; bit--)
+          {
+            current_ = static_cast<uint8_t>((current_ << 1) | ((value >> bit) & 1));
+            if (++used_ == 8)
+            {
+              bytes_.push_back(current_);
+              current_ = 0;
+              used_ = 0;
+            }
+          }
+        }
+
+        void H264TestStream::BitWriter::ue(uint32_t value)
+        {
+          const uint64_t coded = static_cast<uint64_t>(value) + 1;
+          int length = 0;
+          while ((coded >> length) > 1)
+          {
+            length++;
+          }
+          bits(0, length);
+          bits(static_cast<uint32_t>(coded), length + 1);
+        }
+
+        void H264TestStream::BitWriter::se(int32_t value)
+        {
+          ue(value > 0 ? static_cast<uint32_t>(value) * 2 - 1 : static_cast<uint32_t>(-value) * 2);
+        }
+
+        void H264TestStream::BitWriter::alignZero()
+        {
+          while (used_ != 0)
+          {
+            bits(0, 1);
+          }
+        }
+
+        void H264TestStream::BitWriter::trailing()
+        {
+          bits(1, 1);
+          alignZero();
+        }
+
+        const std::vector<uint8_t> &H264TestStream::BitWriter::bytes() const
+        {
+          return bytes_;
+        }
+
+        H264TestStream::H264TestStream(uint32_t width, uint32_t height, size_t frames)
+            : width_(std::max<uint32_t>(width, 16)), height_(std::max<uint32_t>(height, 16)),
+              widthMbs_((width_ + 15) / 16), heightMbs_((height_ + 15) / 16)
+        {
+          aasdk::common::Data config;
+          writeParameterSets(config);
+          units_.push_back(std::move(config));
+
+          for (size_t frame = 0; frame < std::max<size_t>(frames, 1); frame++)
+          {
+            aasdk::common::Data unit;
+            if (frame == 0)
+            {
+              writeIdr(unit);
+            }
+            else
+            {
+              writeSkip(unit, static_cast<uint32_t>(frame % (1u << cLog2MaxFrameNum)));
+            }
+            units_.push_back(std::move(unit));
+          }
+        }
+
+        const std::vector<aasdk::common::Data> &H264TestStream::units() const
+        {
+          return units_;
+        }
+
+        size_t H264TestStream::pictureCount() const
+        {
+          return units_.size() - 1;
+        }
+
+        void H264TestStream::appendNal(aasdk::common::Data &unit, uint8_t header, const std::vector<uint8_t> &rbsp)
+        {
+          static const uint8_t startCode[] = {0, 0, 0, 1};
+          unit.insert(unit.end(), std::begin(startCode), std::end(startCode));
+          unit.push_back(header);
+
+          // Emulation prevention: no 00 00 0x (x <= 3) may appear in the payload
+          int zeros = 0;
+          for (const uint8_t byte : rbsp)
+          {
+            if (zeros == 2 && byte <= 3)
+            {
+              unit.push_back(3);
+              zeros = 0;
+            }
+            unit.push_back(byte);
+            zeros = byte == 0 ? zeros + 1 : 0;
+          }
+        }
+
+        void H264TestStream::writeParameterSets(aasdk::common::Data &unit) const
+        {
+          BitWriter sps;
+          sps.bits(66, 8);                  // profile_idc: Baseline
+          sps.bits(0xC0, 8);                // constraint_set0/1: Constrained Baseline
+          sps.bits(40, 8);                  // level_idc 4.0 covers 1080p
+          sps.ue(0);                        // seq_parameter_set_id
+          sps.ue(cLog2MaxFrameNum - 4);     // log2_max_frame_num_minus4
+          sps.ue(2);                        // pic_order_cnt_type: output order = decode order
+          sps.ue(1);                        // max_num_ref_frames
+          sps.bits(0, 1);                   // gaps_in_frame_num_value_allowed_flag
+          sps.ue(widthMbs_ - 1);            // pic_width_in_mbs_minus1
+          sps.ue(heightMbs_ - 1);           // pic_height_in_map_units_minus1
+          sps.bits(1, 1);                   // frame_mbs_only_flag
+          sps.bits(1, 1);                   // direct_8x8_inference_flag
+
+          // Cropping is counted in chroma samples (2 luma pixels) for 4:2:0
+          const uint32_t cropRight = (widthMbs_ * 16 - width_) / 2;
+          const uint32_t cropBottom = (heightMbs_ * 16 - height_) / 2;
+          const bool cropped = cropRight != 0 || cropBottom != 0;
+          sps.bits(cropped ? 1 : 0, 1);     // frame_cropping_flag
+          if (cropped)
+          {
+            sps.ue(0);
+            sps.ue(cropRight);
+            sps.ue(0);
+            sps.ue(cropBottom);
+          }
+          sps.bits(0, 1);                   // vui_parameters_present_flag
+          sps.trailing();
+          appendNal(unit, cNalSps, sps.bytes());
+
+          BitWriter pps;
+          pps.ue(0);                        // pic_parameter_set_id
+          pps.ue(0);                        // seq_parameter_set_id
+          pps.bits(0, 1);                   // entropy_coding_mode_flag: CAVLC
+          pps.bits(0, 1);                   // bottom_field_pic_order_in_frame_present_flag
+          pps.ue(0);                        // num_slice_groups_minus1
+          pps.ue(0);                        // num_ref_idx_l0_default_active_minus1
+          pps.ue(0);                        // num_ref_idx_l1_default_active_minus1
+          pps.bits(0, 1);                   // weighted_pred_flag
+          pps.bits(0, 2);                   // weighted_bipred_idc
+          pps.se(0);                        // pic_init_qp_minus26
+          pps.se(0);                        // pic_init_qs_minus26
+          pps.se(0);                        // chroma_qp_index_offset
+          pps.bits(1, 1);                   // deblocking_filter_control_present_flag
+          pps.bits(0, 1);                   // constrained_intra_pred_flag
+          pps.bits(0, 1);                   // redundant_pic_cnt_present_flag
+          pps.trailing();
+          appendNal(unit, cNalPps, pps.bytes());
+        }
+
+        void H264TestStream::writeIdr(aasdk::common::Data &unit) const
+        {
+          BitWriter slice;
+          slice.ue(0);                      // first_mb_in_slice
+          slice.ue(cSliceTypeI);
+          slice.ue(0);                      // pic_parameter_set_id
+          slice.bits(0, cLog2MaxFrameNum);  // frame_num
+          slice.ue(0);                      // idr_pic_id
+          slice.bits(0, 1);                 // no_output_of_prior_pics_flag
+          slice.bits(0, 1);                 // long_term_reference_flag
+          slice.se(0);                      // slice_qp_delta
+          slice.ue(1);                      // disable_deblocking_filter_idc
+
+          // I_PCM stores samples verbatim: nothing to predict or transform.
+          // Samples stay non-zero, which early decoders required of PCM.
+          for (uint32_t mbY = 0; mbY < heightMbs_; mbY++)
+          {
+            for (uint32_t mbX = 0; mbX < widthMbs_; mbX++)
+            {
+              slice.ue(cMbTypeIPcm);
+              slice.alignZero();
+              for (uint32_t y = 0; y < 16; y++)
+              {
+                for (uint32_t x = 0; x < 16; x++)
+                {
+                  slice.bits(16 + ((mbX * 16 + x + mbY * 16 + y) % 220), 8);
+                }
+              }
+              for (int sample = 0; sample < 2 * 64; sample++)
+              {
+                slice.bits(128, 8);
+              }
+            }
+          }
+          slice.trailing();
+          appendNal(unit, cNalIdr, slice.bytes());
+        }
+
+        void H264TestStream::writeSkip(aasdk::common::Data &unit, uint32_t frameNum) const
+        {
+          BitWriter slice;
+          slice.ue(0);                      // first_mb_in_slice
+          slice.ue(cSliceTypeP);
+          slice.ue(0);                      // pic_parameter_set_id
+          slice.bits(frameNum, cLog2MaxFrameNum);
+          slice.bits(0, 1);                 // num_ref_idx_active_override_flag
+          slice.bits(0, 1);                 // ref_pic_list_modification_flag_l0
+          slice.bits(0, 1);                 // adaptive_ref_pic_marking_mode_flag
+          slice.se(0);                      // slice_qp_delta
+          slice.ue(1);                      // disable_deblocking_filter_idc
+          slice.ue(widthMbs_ * heightMbs_); // mb_skip_run: the whole picture
+          slice.trailing();
+          appendNal(unit, cNalSlice, slice.bytes());
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
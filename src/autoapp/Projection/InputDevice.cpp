@@ -19,6 +19,9 @@
 #include <f1x/openauto/Common/Log.hpp>
 #include <f1x/openauto/autoapp/Projection/IInputDeviceEventHandler.hpp>
 #include <f1x/openauto/autoapp/Projection/InputDevice.hpp>
+#include <f1x/openauto/autoapp/Projection/TouchLatencyProbe.hpp>
+#include <map>
+#include <boost/algorithm/string.hpp>
 
 // Include for DRM cursor support when using FFmpeg DRM backend
 #ifdef USE_FFMPEG_DRM
@@ -34,10 +37,59 @@ namespace f1x
             namespace projection
             {
 
-                InputDevice::InputDevice(QObject &parent, configuration::IConfiguration::Pointer configuration, const QRect &touchscreenGeometry, const QRect &displayGeometry)
-                    : parent_(parent), configuration_(std::move(configuration)), touchscreenGeometry_(touchscreenGeometry), displayGeometry_(displayGeometry), eventHandler_(nullptr), nextTouchPointId_(0)
+                namespace
                 {
+                    using aap_protobuf::service::media::sink::message::KeyCode;
+
+                    // Keyboard keys; Key_1/Key_2 turn the rotary controller
+                    const std::map<int, KeyCode> cQtKeyMap = {
+                        {Qt::Key_Return, KeyCode::KEYCODE_DPAD_CENTER},
+                        {Qt::Key_Enter, KeyCode::KEYCODE_DPAD_CENTER},
+                        {Qt::Key_Left, KeyCode::KEYCODE_DPAD_LEFT},
+                        {Qt::Key_Right, KeyCode::KEYCODE_DPAD_RIGHT},
+                        {Qt::Key_Up, KeyCode::KEYCODE_DPAD_UP},
+                        {Qt::Key_Down, KeyCode::KEYCODE_DPAD_DOWN},
+                        {Qt::Key_Escape, KeyCode::KEYCODE_BACK},
+                        {Qt::Key_H, KeyCode::KEYCODE_HOME},
+                        {Qt::Key_P, KeyCode::KEYCODE_CALL},
+                        {Qt::Key_O, KeyCode::KEYCODE_ENDCALL},
+                        {Qt::Key_MediaPlay, KeyCode::KEYCODE_MEDIA_PLAY},
+                        {Qt::Key_X, KeyCode::KEYCODE_MEDIA_PLAY},
+                        {Qt::Key_MediaPause, KeyCode::KEYCODE_MEDIA_PAUSE},
+                        {Qt::Key_C, KeyCode::KEYCODE_MEDIA_PAUSE},
+                        {Qt::Key_MediaPrevious, KeyCode::KEYCODE_MEDIA_PREVIOUS},
+                        {Qt::Key_V, KeyCode::KEYCODE_MEDIA_PREVIOUS},
+                        {Qt::Key_MediaTogglePlayPause, KeyCode::KEYCODE_MEDIA_PLAY_PAUSE},
+                        {Qt::Key_B, KeyCode::KEYCODE_MEDIA_PLAY_PAUSE},
+                        {Qt::Key_MediaNext, KeyCode::KEYCODE_MEDIA_NEXT},
+                        {Qt::Key_N, KeyCode::KEYCODE_MEDIA_NEXT},
+                        {Qt::Key_M, KeyCode::KEYCODE_SEARCH},
+                        {Qt::Key_F, KeyCode::KEYCODE_NAVIGATION}};
+                }
+
+                InputDevice::InputDevice(QObject &parent, configuration::IConfiguration::Pointer configuration, const ProjectionGeometry &geometry)
+                    : parent_(parent), configuration_(std::move(configuration)), geometry_(geometry), eventHandler_(nullptr),
+                      touchTransform_(geometry), directTouch_(false)
+                {
+                    touchEvent_.pointers.reserve(TouchPointerTable::cMaxPointers);
                     this->moveToThread(parent.thread());
+
+                    const auto touchscreenDevice = configuration_->getTouchscreenDevice();
+                    if (configuration_->getTouchscreenEnabled() && !touchscreenDevice.empty())
+                    {
+                        touchReader_ = std::make_unique<EvdevTouchReader>(touchscreenDevice, geometry_);
+                    }
+
+                    std::vector<std::string> keyDevices;
+                    boost::split(keyDevices, configuration_->getKeyDevices(), boost::is_any_of(","), boost::token_compress_on);
+                    keyDevices.erase(std::remove(keyDevices.begin(), keyDevices.end(), std::string()), keyDevices.end());
+                    if (!keyDevices.empty())
+                    {
+                        auto keyMap = EvdevKeyDecoder::defaultKeyMap();
+                        EvdevKeyDecoder::parseKeyMap(configuration_->getKeyMap(), keyMap);
+                        keyReader_ = std::make_unique<EvdevKeyReader>(std::move(keyDevices), std::move(keyMap),
+                                                                      configuration_->getRotaryAccelerationDetents());
+                    }
                     // Note: Touch events are accepted automatically when we install the event filter
                     // No need to set WA_AcceptTouchEvents on QApplication parent
                 }
@@ -48,7 +100,18 @@ namespace f1x
 
                     OPENAUTO_LOG(info) << "[InputDevice] start()";
                     eventHandler_ = &eventHandler;
+                    directTouch_ = touchReader_ != nullptr && touchReader_->start(eventHandler);
+                    if (keyReader_ != nullptr)
+                    {
+                        keyReader_->start(eventHandler, this->getSupportedButtonCodes());
+                    }
                     parent_.installEventFilter(this);
+
+                    TouchLatencyProbe::Options probeOptions;
+                    if (TouchLatencyProbe::optionsFromEnvironment(probeOptions))
+                    {
+                        TouchLatencyProbe::instance().start(probeOptions, eventHandler);
+                    }
                 }
 
                 void InputDevice::stop()
@@ -56,12 +119,41 @@ namespace f1x
                     std::lock_guard<decltype(mutex_)> lock(mutex_);
 
                     OPENAUTO_LOG(info) << "[InputDevice] stop()";
+                    TouchLatencyProbe::instance().stop();
                     parent_.removeEventFilter(this);
+                    // Joined before the handler goes away; it may still be lifting contacts
+                    if (touchReader_ != nullptr)
+                    {
+                        touchReader_->stop();
+                    }
+                    if (keyReader_ != nullptr)
+                    {
+                        keyReader_->stop();
+                    }
+                    directTouch_ = false;
                     eventHandler_ = nullptr;
                 }
 
                 bool InputDevice::eventFilter(QObject *obj, QEvent *event)
                 {
+                    // Filters every event of the application: timers, update
+                    // requests and QML bindings pass without taking the lock
+                    switch (event->type())
+                    {
+                    case QEvent::KeyPress:
+                    case QEvent::KeyRelease:
+                    case QEvent::TouchBegin:
+                    case QEvent::TouchUpdate:
+                    case QEvent::TouchEnd:
+                    case QEvent::TouchCancel:
+                    case QEvent::MouseButtonPress:
+                    case QEvent::MouseButtonRelease:
+                    case QEvent::MouseMove:
+                        break;
+                    default:
+                        return QObject::eventFilter(obj, event);
+                    }
+
                     std::lock_guard<decltype(mutex_)> lock(mutex_);
 
                     if (eventHandler_ != nullptr)
@@ -79,12 +171,12 @@ namespace f1x
                                  event->type() == QEvent::TouchEnd ||
                                  event->type() == QEvent::TouchCancel)
                         {
-                            return this->handleMultiTouchEvent(static_cast<QTouchEvent *>(event));
+                            return directTouch_ || this->handleMultiTouchEvent(static_cast<QTouchEvent *>(event));
                         }
                         else if (event->type() == QEvent::MouseButtonPress || event->type() == QEvent::MouseButtonRelease || event->type() == QEvent::MouseMove)
                         {
                             // Fallback to mouse events if touch events are not available
-                            return this->handleTouchEvent(event);
+                            return directTouch_ || this->handleTouchEvent(event);
                         }
                     }
 
@@ -97,92 +189,20 @@ namespace f1x
                     aap_protobuf::service::media::sink::message::KeyCode buttonCode;
                     WheelDirection wheelDirection = WheelDirection::NONE;
 
-                    switch (key->key())
+                    if (key->key() == Qt::Key_1 || key->key() == Qt::Key_2)
                     {
-                    case Qt::Key_Return:
-                    case Qt::Key_Enter:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_DPAD_CENTER;
-                        break;
-
-                    case Qt::Key_Left:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_DPAD_LEFT;
-                        break;
-
-                    case Qt::Key_Right:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_DPAD_RIGHT;
-                        break;
-
-                    case Qt::Key_Up:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_DPAD_UP;
-                        break;
-
-                    case Qt::Key_Down:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_DPAD_DOWN;
-                        break;
-
-                    case Qt::Key_Escape:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_BACK;
-                        break;
-
-                    case Qt::Key_H:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_HOME;
-                        break;
-
-                    case Qt::Key_P:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_CALL;
-                        break;
-
-                    case Qt::Key_O:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_ENDCALL;
-                        break;
-
-                    case Qt::Key_MediaPlay:
-                    case Qt::Key_X:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_MEDIA_PLAY;
-                        break;
-
-                    case Qt::Key_MediaPause:
-                    case Qt::Key_C:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_MEDIA_PAUSE;
-                        break;
-
-                    case Qt::Key_MediaPrevious:
-                    case Qt::Key_V:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_MEDIA_PREVIOUS;
-                        break;
-
-                    case Qt::Key_MediaTogglePlayPause:
-                    case Qt::Key_B:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_MEDIA_PLAY_PAUSE;
-                        break;
-
-                    case Qt::Key_MediaNext:
-                    case Qt::Key_N:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_MEDIA_NEXT;
-                        break;
-
-                    case Qt::Key_M:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_SEARCH;
-                        break;
-
-                    case Qt::Key_1:
-                        wheelDirection = WheelDirection::LEFT;
-                        eventType = ButtonEventType::NONE;
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_ROTARY_CONTROLLER;
-                        break;
-
-                    case Qt::Key_2:
-                        wheelDirection = WheelDirection::RIGHT;
+                        wheelDirection = key->key() == Qt::Key_1 ? WheelDirection::LEFT : WheelDirection::RIGHT;
                         eventType = ButtonEventType::NONE;
                         buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_ROTARY_CONTROLLER;
-                        break;
-
-                    case Qt::Key_F:
-                        buttonCode = aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_NAVIGATION;
-                        break;
-
-                    default:
-                        return true;
+                    }
+                    else
+                    {
+                        const auto mapped = cQtKeyMap.find(key->key());
+                        if (mapped == cQtKeyMap.end())
+                        {
+                            return true;
+                        }
+                        buttonCode = mapped->second;
                     }
 
                     const auto &buttonCodes = this->getSupportedButtonCodes();
@@ -190,7 +210,7 @@ namespace f1x
                     {
                         if (buttonCode != aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_ROTARY_CONTROLLER || event->type() == QEvent::KeyRelease)
                         {
-                            eventHandler_->onButtonEvent({eventType, wheelDirection, buttonCode});
+                            eventHandler_->onButtonEvent({eventType, wheelDirection, buttonCode, inputTimestampNow()});
                         }
                     }
 
@@ -230,14 +250,17 @@ namespace f1x
 
                     if (event->type() == QEvent::MouseButtonRelease || mouse->buttons().testFlag(Qt::LeftButton))
                     {
-                        const uint32_t x = (static_cast<float>(mouse->pos().x()) / touchscreenGeometry_.width()) * displayGeometry_.width();
-                        const uint32_t y = (static_cast<float>(mouse->pos().y()) / touchscreenGeometry_.height()) * displayGeometry_.height();
+                        const QPoint position = touchTransform_.map(mouse->localPos());
+                        const uint32_t x = static_cast<uint32_t>(position.x());
+                        const uint32_t y = static_cast<uint32_t>(position.y());
 
                         // Create single-touch event for mouse fallback
-                        TouchEvent event;
+                        TouchEvent &event = touchEvent_;
                         event.type = type;
                         event.actionIndex = 0;
+                        event.pointers.clear();
                         event.pointers.push_back({x, y, 0});
+                        event.timestamp = inputTimestampNow();
 
                         eventHandler_->onTouchEvent(event);
                     }
@@ -252,7 +275,8 @@ namespace f1x
 
                 QRect InputDevice::getTouchscreenGeometry() const
                 {
-                    return touchscreenGeometry_;
+                    // Touch coordinates are reported in video frame pixels
+                    return QRect(QPoint(0, 0), geometry_.videoSize());
                 }
 
                 IInputDevice::ButtonCodes InputDevice::getSupportedButtonCodes() const
@@ -267,11 +291,12 @@ namespace f1x
                         return true;
                     }
 
-                    OPENAUTO_LOG(debug) << "[InputDevice] handleMultiTouchEvent: type=" << touchEvent->type()
-                                        << " touchPointCount=" << touchEvent->touchPoints().size();
-
-                    TouchEvent event;
+                    // Stamped on arrival: Qt's own event times are not on the
+                    // monotonic base, and this is still ahead of any queueing
+                    TouchEvent &event = touchEvent_;
                     event.actionIndex = 0; // Will be updated based on which pointer changed state
+                    event.timestamp = inputTimestampNow();
+                    event.pointers.clear();
 
                     // Determine the action type and which pointer triggered it
                     const auto &touchPoints = touchEvent->touchPoints();
@@ -300,17 +325,18 @@ namespace f1x
                     if (touchEvent->type() == QEvent::TouchBegin)
                     {
                         event.type = aap_protobuf::service::inputsource::message::PointerAction::ACTION_DOWN;
-                        event.actionIndex = 0;
+                        changedPointIndex = 0;
                     }
                     else if (touchEvent->type() == QEvent::TouchEnd)
                     {
                         event.type = aap_protobuf::service::inputsource::message::PointerAction::ACTION_UP;
                         // Find the released pointer index
+                        changedPointIndex = 0;
                         for (int i = 0; i < touchPoints.size(); ++i)
                         {
                             if (touchPoints[i].state() == Qt::TouchPointReleased)
                             {
-                                event.actionIndex = i;
+                                changedPointIndex = i;
                                 break;
                             }
                         }
@@ -321,28 +347,24 @@ namespace f1x
                         {
                             // Additional finger went down
                             event.type = aap_protobuf::service::inputsource::message::PointerAction::ACTION_POINTER_DOWN;
-                            event.actionIndex = changedPointIndex;
                         }
                         else if (changedState == Qt::TouchPointReleased)
                         {
                             // One finger lifted while others remain
                             event.type = aap_protobuf::service::inputsource::message::PointerAction::ACTION_POINTER_UP;
-                            event.actionIndex = changedPointIndex;
                         }
                         else
                         {
                             // Movement only
                             event.type = aap_protobuf::service::inputsource::message::PointerAction::ACTION_MOVED;
-                            event.actionIndex = 0;
+                            changedPointIndex = -1;
                         }
                     }
                     else if (touchEvent->type() == QEvent::TouchCancel)
                     {
                         // Android Auto protocol doesn't support ACTION_CANCEL, treat as ACTION_UP (all fingers lifted)
                         event.type = aap_protobuf::service::inputsource::message::PointerAction::ACTION_UP;
-                        event.actionIndex = 0;
-                        touchPointIdMap_.clear();
-                        nextTouchPointId_ = 0;
+                        changedPointIndex = -1;
                     }
                     else
                     {
@@ -350,8 +372,10 @@ namespace f1x
                     }
 
                     // Translate all touch points
-                    for (const auto &qtPoint : touchPoints)
+                    bool changedSent = changedPointIndex < 0;
+                    for (int i = 0; i < touchPoints.size(); ++i)
                     {
+                        const auto &qtPoint = touchPoints[i];
                         // Skip released points except for UP actions
                         if (qtPoint.state() == Qt::TouchPointReleased &&
                             event.type != aap_protobuf::service::inputsource::message::PointerAction::ACTION_UP &&
@@ -361,46 +385,55 @@ namespace f1x
                         }
 
                         TouchPoint ourPoint;
-                        translateTouchPoint(qtPoint, ourPoint);
+                        if (!translateTouchPoint(qtPoint, ourPoint))
+                        {
+                            continue;
+                        }
+                        // An index into what is sent, not into Qt's list
+                        if (i == changedPointIndex)
+                        {
+                            event.actionIndex = static_cast<uint32_t>(event.pointers.size());
+                            changedSent = true;
+                        }
                         event.pointers.push_back(ourPoint);
 
-                        // Clean up released touch points from map
+                        // A lifted finger's id is free for the next one down
                         if (qtPoint.state() == Qt::TouchPointReleased)
                         {
-                            touchPointIdMap_.erase(qtPoint.id());
+                            pointerTable_.release(qtPoint.id());
                         }
                     }
 
-                    if (!event.pointers.empty())
+                    // A finger past the table's capacity going down or up is not reported at all
+                    if (!event.pointers.empty() && changedSent)
                     {
-                        OPENAUTO_LOG(debug) << "[InputDevice] Sending touch event: action=" << event.type
-                                            << " actionIndex=" << event.actionIndex
-                                            << " pointerCount=" << event.pointers.size();
                         eventHandler_->onTouchEvent(event);
                     }
+                    // Every finger is up after a cancel, whatever Qt reported
+                    if (touchEvent->type() == QEvent::TouchCancel)
+                    {
+                        pointerTable_.clear();
+                    }
 
                     return true;
                 }
 
-                void InputDevice::translateTouchPoint(const QTouchEvent::TouchPoint &qtPoint, TouchPoint &ourPoint)
+                bool InputDevice::translateTouchPoint(const QTouchEvent::TouchPoint &qtPoint, TouchPoint &ourPoint)
                 {
-                    // Map Qt touch point ID to our sequential ID
-                    int qtId = qtPoint.id();
-                    if (touchPointIdMap_.find(qtId) == touchPointIdMap_.end())
+                    // A lifted finger never gets an id; it was not reported going down
+                    const int pointerId = qtPoint.state() == Qt::TouchPointReleased ? pointerTable_.find(qtPoint.id())
+                                                                                    : pointerTable_.acquire(qtPoint.id());
+                    if (pointerId < 0)
                     {
-                        touchPointIdMap_[qtId] = nextTouchPointId_++;
+                        return false;
                     }
-                    ourPoint.pointerId = touchPointIdMap_[qtId];
+                    ourPoint.pointerId = static_cast<uint32_t>(pointerId);
 
-                    // Scale coordinates from touchscreen geometry to display geometry
-                    QPointF pos = qtPoint.pos();
-                    ourPoint.x = static_cast<uint32_t>((pos.x() / touchscreenGeometry_.width()) * displayGeometry_.width());
-                    ourPoint.y = static_cast<uint32_t>((pos.y() / touchscreenGeometry_.height()) * displayGeometry_.height());
-
-                    OPENAUTO_LOG(debug) << "[InputDevice] Touch point: qtId=" << qtId
-                                        << " ourId=" << ourPoint.pointerId
-                                        << " pos=(" << ourPoint.x << "," << ourPoint.y << ")"
-                                        << " state=" << qtPoint.state();
+                    // Undo the letterboxing and margin crop the video is shown with
+                    const QPoint pos = touchTransform_.map(qtPoint.pos());
+                    ourPoint.x = static_cast<uint32_t>(pos.x());
+                    ourPoint.y = static_cast<uint32_t>(pos.y());
+                    return true;
                 }
 
             }
@@ -0,0 +1,348 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+ * MediaDsp.cpp
+ *
+ * EQ, loudness and limiter for the media streams. The conversion and the
+ * biquad are SimdKernels; the NEON biquad keeps a stereo frame in one
+ * float32x2 register.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDsp.hpp>
+#include <f1x/openauto/autoapp/Projection/SimdKernels.hpp>
+#include <f1x/openauto/autoapp/ThermalGovernor.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          constexpr float cPi = 3.14159265358979f;
+          constexpr float cPeakingQ = 0.9f;
+          // Bass and treble lift of the loudness contour at 100 percent
+          constexpr float cLoudnessBassDb = 10.0f;
+          constexpr float cLoudnessTrebleDb = 4.0f;
+          constexpr float cLoudnessBassHz = 100.0f;
+          constexpr float cLoudnessTrebleHz = 10000.0f;
+          // Gains this close to 0 dB skip their band
+          constexpr float cFlatDb = 0.05f;
+          // Limiter: -1 dBFS, instant attack, 100 ms release
+          constexpr float cCeiling = 0.891f;
+          constexpr float cReleaseSeconds = 0.1f;
+          // Filter state below this is flushed, as x86 and VFP slow down on
+          // denormals while a stream decays into silence
+          constexpr float cDenormal = 1e-20f;
+
+          typedef MediaDspPreset::Biquad Biquad;
+
+          Biquad normalise(float b0, float b1, float b2, float a0, float a1, float a2)
+          {
+            return {b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0};
+          }
+
+          // RBJ Audio EQ Cookbook, shelves with a slope of 1
+          Biquad peaking(float frequency, float gainDb)
+          {
+            const float a = std::pow(10.0f, gainDb / 40.0f);
+            const float w0 = 2.0f * cPi * frequency / MediaDspPreset::cSampleRate;
+            const float alpha = std::sin(w0) / (2.0f * cPeakingQ);
+            const float cosW0 = std::cos(w0);
+            return normalise(1.0f + alpha * a, -2.0f * cosW0, 1.0f - alpha * a, 1.0f + alpha / a, -2.0f * cosW0,
+                             1.0f - alpha / a);
+          }
+
+          Biquad lowShelf(float frequency, float gainDb)
+          {
+            const float a = std::pow(10.0f, gainDb / 40.0f);
+            const float w0 = 2.0f * cPi * frequency / MediaDspPreset::cSampleRate;
+            const float cosW0 = std::cos(w0);
+            const float twoSqrtAAlpha = std::sqrt(a) * std::sin(w0) * std::sqrt(2.0f);
+            return normalise(a * ((a + 1) - (a - 1) * cosW0 + twoSqrtAAlpha), 2 * a * ((a - 1) - (a + 1) * cosW0),
+                             a * ((a + 1) - (a - 1) * cosW0 - twoSqrtAAlpha), (a + 1) + (a - 1) * cosW0 + twoSqrtAAlpha,
+                             -2 * ((a - 1) + (a + 1) * cosW0), (a + 1) + (a - 1) * cosW0 - twoSqrtAAlpha);
+          }
+
+          Biquad highShelf(float frequency, float gainDb)
+          {
+            const float a = std::pow(10.0f, gainDb / 40.0f);
+            const float w0 = 2.0f * cPi * frequency / MediaDspPreset::cSampleRate;
+            const float cosW0 = std::cos(w0);
+            const float twoSqrtAAlpha = std::sqrt(a) * std::sin(w0) * std::sqrt(2.0f);
+            return normalise(a * ((a + 1) + (a - 1) * cosW0 + twoSqrtAAlpha), -2 * a * ((a - 1) + (a + 1) * cosW0),
+                             a * ((a + 1) + (a - 1) * cosW0 - twoSqrtAAlpha), (a + 1) - (a - 1) * cosW0 + twoSqrtAAlpha,
+                             2 * ((a - 1) - (a + 1) * cosW0), (a + 1) - (a - 1) * cosW0 - twoSqrtAAlpha);
+          }
+
+          // Transposed direct form II over interleaved stereo, in place
+          void runBiquad(float *samples, size_t frames, const Biquad &q, std::array<float, 4> &state)
+          {
+            const float coefficients[] = {q.b0, q.b1, q.b2, q.a1, q.a2};
+            simdKernels().biquadStereo(samples, frames, coefficients, state.data());
+            for (auto &z : state)
+            {
+              if (std::fabs(z) < cDenormal)
+              {
+                z = 0.0f;
+              }
+            }
+          }
+
+          int16_t toSample(float value)
+          {
+            const long sample = std::lrint(value * 32768.0f);
+            return static_cast<int16_t>(std::min<long>(std::max<long>(sample, -32768), 32767));
+          }
+
+          MetricCounter &shedCounter()
+          {
+            static MetricCounter &counter = Metrics::instance().counter(
+                "openauto_audio_dsp_shed_total", "Media streams whose EQ went over the DSP CPU budget");
+            return counter;
+          }
+        }
+
+        constexpr size_t MediaDspSettings::cEqBands;
+        constexpr std::array<float, MediaDspSettings::cEqBands> MediaDspSettings::cEqFrequencies;
+        constexpr uint32_t MediaDspPreset::cSampleRate;
+        constexpr size_t MediaDsp::cChannelCount;
+
+        bool MediaDspSettings::parseEqGains(const std::string &text, std::array<float, cEqBands> &gains)
+        {
+          std::array<float, cEqBands> parsed{};
+          std::istringstream stream(text);
+          std::string item;
+          size_t count = 0;
+          while (std::getline(stream, item, ','))
+          {
+            char *end = nullptr;
+            const float gain = std::strtof(item.c_str(), &end);
+            if (count == cEqBands || end == item.c_str())
+            {
+              return false;
+            }
+            parsed[count++] = std::min(std::max(gain, -cMaxEqGainDb), cMaxEqGainDb);
+          }
+          if (count != cEqBands)
+          {
+            return false;
+          }
+          gains = parsed;
+          return true;
+        }
+
+        // ============================================================================
+        // MediaDspPreset
+        // ============================================================================
+
+        MediaDspPreset::MediaDspPreset(const MediaDspSettings &settings)
+            : design_(design(settings)), version_(1), enabled_(settings.enabled)
+        {
+        }
+
+        void MediaDspPreset::set(const MediaDspSettings &settings)
+        {
+          const Design next = design(settings);
+          std::lock_guard<std::mutex> lock(mutex_);
+          design_ = next;
+          enabled_.store(settings.enabled, std::memory_order_relaxed);
+          version_.fetch_add(1, std::memory_order_release);
+        }
+
+        bool MediaDspPreset::isEnabled() const
+        {
+          return enabled_.load(std::memory_order_relaxed);
+        }
+
+        MediaDspPreset::Design MediaDspPreset::design(const MediaDspSettings &settings)
+        {
+          Design result;
+          result.enabled = settings.enabled;
+          result.cpuBudgetPercent = std::max<uint32_t>(settings.cpuBudgetPercent, 1);
+
+          for (size_t band = 0; band < MediaDspSettings::cEqBands; band++)
+          {
+            const float gain = settings.eqGainsDb[band];
+            if (std::fabs(gain) < cFlatDb)
+            {
+              continue;
+            }
+            const float frequency = MediaDspSettings::cEqFrequencies[band];
+            result.stages[result.stageCount++] = band == 0 ? lowShelf(frequency, gain)
+                                                 : band == MediaDspSettings::cEqBands - 1 ? highShelf(frequency, gain)
+                                                                                           : peaking(frequency, gain);
+          }
+
+          const float loudness = std::min<uint32_t>(settings.loudnessPercent, 100) / 100.0f;
+          if (loudness > 0.0f)
+          {
+            result.stages[result.stageCount++] = lowShelf(cLoudnessBassHz, cLoudnessBassDb * loudness);
+            result.stages[result.stageCount++] = highShelf(cLoudnessTrebleHz, cLoudnessTrebleDb * loudness);
+          }
+          return result;
+        }
+
+        // ============================================================================
+        // MediaDsp
+        // ============================================================================
+
+        MediaDsp::MediaDsp(MediaDspPreset::Pointer preset)
+            : preset_(std::move(preset)), shedCounter_(shedCounter()), version_(0), active_(false),
+              work_(cChunkFrames * cChannelCount),
+              releaseStep_(1.0f - std::exp(-1.0f / (cReleaseSeconds * MediaDspPreset::cSampleRate))),
+              thermalShed_(false), shedding_(false)
+        {
+          this->reset();
+        }
+
+        MediaDsp::~MediaDsp()
+        {
+          if (shedding_.load())
+          {
+            OPENAUTO_LOG(warning) << "[MediaDsp] EQ was over its " << design_.cpuBudgetPercent
+                                  << "% CPU budget, only the limiter ran";
+          }
+        }
+
+        bool MediaDsp::prepare()
+        {
+          const uint64_t version = preset_->version_.load(std::memory_order_acquire);
+          if (version != version_)
+          {
+            std::unique_lock<std::mutex> lock(preset_->mutex_, std::try_to_lock);
+            if (lock.owns_lock())
+            {
+              design_ = preset_->design_;
+              version_ = version;
+              // A new design gets a new chance at the budget
+              shedding_.store(false, std::memory_order_relaxed);
+              windowBusyNs_ = 0;
+              windowFrames_ = 0;
+            }
+          }
+          // A hot head unit keeps only the limiter, until it cools down
+          const bool thermalShed = ThermalGovernor::instance().level() == ThermalLevel::Hot;
+          if ((design_.enabled && !active_) || (thermalShed_ && !thermalShed))
+          {
+            // State left from before a bypass would ring
+            this->reset();
+          }
+          thermalShed_ = thermalShed;
+          active_ = design_.enabled;
+          return active_;
+        }
+
+        void MediaDsp::process(int16_t *samples, size_t frames)
+        {
+          if (!active_)
+          {
+            return;
+          }
+
+          const auto started = std::chrono::steady_clock::now();
+          while (frames > 0)
+          {
+            const size_t chunk = std::min(frames, cChunkFrames);
+            this->processChunk(samples, chunk);
+            samples += chunk * cChannelCount;
+            frames -= chunk;
+            windowFrames_ += chunk;
+          }
+          const auto busy = std::chrono::steady_clock::now() - started;
+          this->account(std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count());
+        }
+
+        bool MediaDsp::isShedding() const
+        {
+          return shedding_.load(std::memory_order_relaxed);
+        }
+
+        void MediaDsp::reset()
+        {
+          for (auto &stage : state_)
+          {
+            stage.fill(0.0f);
+          }
+          limiterGain_ = 1.0f;
+        }
+
+        void MediaDsp::processChunk(int16_t *samples, size_t frames)
+        {
+          float *work = work_.data();
+          simdKernels().toFloat(samples, work, frames * cChannelCount);
+
+          if (!shedding_.load(std::memory_order_relaxed) && !thermalShed_)
+          {
+            for (size_t stage = 0; stage < design_.stageCount; stage++)
+            {
+              runBiquad(work, frames, design_.stages[stage], state_[stage]);
+            }
+          }
+
+          // Both channels share one gain so the stereo image holds
+          float gain = limiterGain_;
+          for (size_t i = 0; i < frames; i++)
+          {
+            const float left = work[2 * i];
+            const float right = work[2 * i + 1];
+            const float peak = std::max(std::fabs(left), std::fabs(right));
+            const float target = peak > cCeiling ? cCeiling / peak : 1.0f;
+            gain = std::min(gain + (1.0f - gain) * releaseStep_, target);
+            samples[2 * i] = toSample(left * gain);
+            samples[2 * i + 1] = toSample(right * gain);
+          }
+          limiterGain_ = gain;
+        }
+
+        void MediaDsp::account(int64_t busyNs)
+        {
+          windowBusyNs_ += busyNs;
+          if (windowFrames_ < MediaDspPreset::cSampleRate)
+          {
+            return;
+          }
+
+          const int64_t windowNs = static_cast<int64_t>(windowFrames_) * 1000000000 / MediaDspPreset::cSampleRate;
+          if (windowBusyNs_ * 100 > windowNs * design_.cpuBudgetPercent && design_.stageCount > 0 &&
+              !shedding_.load(std::memory_order_relaxed))
+          {
+            shedding_.store(true, std::memory_order_relaxed);
+            shedCounter_.add();
+          }
+          windowBusyNs_ = 0;
+          windowFrames_ = 0;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,287 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/autoapp/Projection/MediaDump.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+#include <cstring>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        constexpr char MediaDumpFormat::cMagic[4];
+        constexpr size_t MediaDumpWriter::cMaxBacklogBytes;
+
+        namespace
+        {
+          uint64_t readLittleEndian(const uint8_t *data, size_t size)
+          {
+            uint64_t value = 0;
+            for (size_t i = 0; i < size; i++)
+            {
+              value |= static_cast<uint64_t>(data[i]) << (8 * i);
+            }
+            return value;
+          }
+
+          void writeLittleEndian(uint8_t *data, size_t size, uint64_t value)
+          {
+            for (size_t i = 0; i < size; i++)
+            {
+              data[i] = static_cast<uint8_t>(value >> (8 * i));
+            }
+          }
+
+          // Keeps a handful of payload buffers around so a steady stream of
+          // video frames does not allocate on every append()
+          constexpr size_t cMaxFreeBuffers = 16;
+        }
+
+        MediaDumpReader::MediaDumpReader(const std::string &path)
+            : in_(path, std::ios::binary), open_(false)
+        {
+          rewind();
+        }
+
+        bool MediaDumpReader::isOpen() const
+        {
+          return open_;
+        }
+
+        void MediaDumpReader::rewind()
+        {
+          open_ = false;
+          if (!in_.is_open())
+          {
+            return;
+          }
+
+          in_.clear();
+          in_.seekg(0);
+
+          uint8_t header[MediaDumpFormat::cFileHeaderSize];
+          if (!in_.read(reinterpret_cast<char *>(header), sizeof(header)))
+          {
+            return;
+          }
+
+          open_ = memcmp(header, MediaDumpFormat::cMagic, sizeof(MediaDumpFormat::cMagic)) == 0 &&
+                  readLittleEndian(header + 4, 4) == MediaDumpFormat::cVersion;
+        }
+
+        bool MediaDumpReader::next(MediaDumpRecord &record)
+        {
+          if (!open_)
+          {
+            return false;
+          }
+
+          uint8_t header[MediaDumpFormat::cRecordHeaderSize];
+          if (!in_.read(reinterpret_cast<char *>(header), sizeof(header)))
+          {
+            return false;
+          }
+
+          const auto size = static_cast<uint32_t>(readLittleEndian(header, 4));
+          if (size > MediaDumpFormat::cMaxPayloadSize)
+          {
+            open_ = false;
+            return false;
+          }
+
+          record.channel = static_cast<uint16_t>(readLittleEndian(header + 4, 2));
+          record.flags = static_cast<uint16_t>(readLittleEndian(header + 6, 2));
+          record.timestamp = readLittleEndian(header + 8, 8);
+          record.arrivalUs = static_cast<int64_t>(readLittleEndian(header + 16, 8));
+          record.payload.resize(size);
+          return size == 0 ||
+                 static_cast<bool>(in_.read(reinterpret_cast<char *>(record.payload.data()), size));
+        }
+
+        MediaDumpWriter::MediaDumpWriter(const std::string &path)
+            : out_(path, std::ios::binary | std::ios::trunc), open_(false),
+              startTime_(std::chrono::steady_clock::now()), queuedBytes_(0), closing_(false), failed_(false),
+              records_(0), dropped_(0)
+        {
+          if (!out_.is_open())
+          {
+            OPENAUTO_LOG(error) << "[MediaDumpWriter] Cannot create " << path;
+            return;
+          }
+
+          uint8_t header[MediaDumpFormat::cFileHeaderSize];
+          memcpy(header, MediaDumpFormat::cMagic, sizeof(MediaDumpFormat::cMagic));
+          writeLittleEndian(header + 4, 4, MediaDumpFormat::cVersion);
+          open_ = static_cast<bool>(out_.write(reinterpret_cast<const char *>(header), sizeof(header)));
+          if (!open_)
+          {
+            OPENAUTO_LOG(error) << "[MediaDumpWriter] Cannot write " << path;
+            return;
+          }
+
+          OPENAUTO_LOG(info) << "[MediaDumpWriter] Recording session to " << path;
+          thread_ = std::thread(&MediaDumpWriter::writerLoop, this);
+        }
+
+        MediaDumpWriter::~MediaDumpWriter()
+        {
+          close();
+        }
+
+        bool MediaDumpWriter::isOpen() const
+        {
+          return open_;
+        }
+
+        void MediaDumpWriter::append(uint16_t channel, uint64_t timestamp, const uint8_t *data, size_t size)
+        {
+          if (!open_ || size > MediaDumpFormat::cMaxPayloadSize)
+          {
+            return;
+          }
+
+          const auto arrival = std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - startTime_).count();
+
+          std::vector<uint8_t> payload;
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closing_)
+            {
+              return;
+            }
+            if (failed_ || queuedBytes_ + size > cMaxBacklogBytes)
+            {
+              dropped_++;
+              return;
+            }
+            if (!freeBuffers_.empty())
+            {
+              payload = std::move(freeBuffers_.back());
+              freeBuffers_.pop_back();
+            }
+            queuedBytes_ += size;
+          }
+
+          // The copy happens outside the lock; the writer only ever waits on
+          // the handoff below
+          payload.assign(data, data + size);
+
+          MediaDumpRecord record;
+          record.channel = channel;
+          record.timestamp = timestamp;
+          record.arrivalUs = arrival;
+          record.payload = std::move(payload);
+
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(record));
+          }
+          cond_.notify_one();
+        }
+
+        void MediaDumpWriter::close()
+        {
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closing_)
+            {
+              return;
+            }
+            closing_ = true;
+          }
+          cond_.notify_one();
+
+          if (thread_.joinable())
+          {
+            thread_.join();
+          }
+          if (open_)
+          {
+            out_.close();
+            OPENAUTO_LOG(info) << "[MediaDumpWriter] Recorded " << records_ << " records, dropped " << dropped_;
+          }
+        }
+
+        uint64_t MediaDumpWriter::recordCount() const
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          return records_;
+        }
+
+        uint64_t MediaDumpWriter::droppedCount() const
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          return dropped_;
+        }
+
+        void MediaDumpWriter::writerLoop()
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          while (true)
+          {
+            cond_.wait(lock, [this]() { return closing_ || !queue_.empty(); });
+            if (queue_.empty())
+            {
+              break;
+            }
+
+            auto record = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+
+            uint8_t header[MediaDumpFormat::cRecordHeaderSize];
+            writeLittleEndian(header, 4, record.payload.size());
+            writeLittleEndian(header + 4, 2, record.channel);
+            writeLittleEndian(header + 6, 2, record.flags);
+            writeLittleEndian(header + 8, 8, record.timestamp);
+            writeLittleEndian(header + 16, 8, static_cast<uint64_t>(record.arrivalUs));
+            out_.write(reinterpret_cast<const char *>(header), sizeof(header));
+            out_.write(reinterpret_cast<const char *>(record.payload.data()), record.payload.size());
+
+            lock.lock();
+            queuedBytes_ -= record.payload.size();
+            records_++;
+            if (freeBuffers_.size() < cMaxFreeBuffers)
+            {
+              freeBuffers_.push_back(std::move(record.payload));
+            }
+            if (!out_)
+            {
+              // Disk full or card pulled; keep accepting appends as drops
+              // rather than blocking the channels
+              OPENAUTO_LOG(error) << "[MediaDumpWriter] Write failed, recording stopped";
+              dropped_ += queue_.size();
+              queue_.clear();
+              queuedBytes_ = 0;
+              failed_ = true;
+              break;
+            }
+          }
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,121 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/Projection/MediaDumpReplayer.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+#include <chrono>
+#include <thread>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        MediaDumpReplayer::MediaDumpReplayer(const std::string &path)
+            : reader_(path), stopRequested_(false)
+        {
+        }
+
+        bool MediaDumpReplayer::isOpen() const
+        {
+          return reader_.isOpen();
+        }
+
+        void MediaDumpReplayer::setVideoOutput(IVideoOutput::Pointer videoOutput)
+        {
+          videoOutput_ = std::move(videoOutput);
+        }
+
+        void MediaDumpReplayer::setAudioOutput(aasdk::messenger::ChannelId channel, IAudioOutput::Pointer audioOutput)
+        {
+          audioOutputs_[static_cast<uint16_t>(channel)] = std::move(audioOutput);
+        }
+
+        void MediaDumpReplayer::stop()
+        {
+          stopRequested_ = true;
+        }
+
+        uint64_t MediaDumpReplayer::run(double speed)
+        {
+          stopRequested_ = false;
+          reader_.rewind();
+
+          const auto videoChannel = static_cast<uint16_t>(aasdk::messenger::ChannelId::MEDIA_SINK_VIDEO);
+          const auto startTime = std::chrono::steady_clock::now();
+          int64_t firstArrivalUs = -1;
+          uint64_t replayed = 0;
+
+          MediaDumpRecord record;
+          while (!stopRequested_ && reader_.next(record))
+          {
+            IVideoOutput *videoOutput = nullptr;
+            IAudioOutput *audioOutput = nullptr;
+            if (record.channel == videoChannel)
+            {
+              videoOutput = videoOutput_.get();
+            }
+            else
+            {
+              auto it = audioOutputs_.find(record.channel);
+              if (it != audioOutputs_.end())
+              {
+                audioOutput = it->second.get();
+              }
+            }
+            if (videoOutput == nullptr && audioOutput == nullptr)
+            {
+              continue;
+            }
+
+            if (firstArrivalUs < 0)
+            {
+              firstArrivalUs = record.arrivalUs;
+            }
+            if (speed > 0)
+            {
+              const auto offsetUs = static_cast<int64_t>((record.arrivalUs - firstArrivalUs) / speed);
+              std::this_thread::sleep_until(startTime + std::chrono::microseconds(offsetUs));
+            }
+
+            const aasdk::common::DataConstBuffer buffer(record.payload);
+            if (videoOutput != nullptr)
+            {
+              videoOutput->write(record.timestamp, buffer);
+            }
+            else
+            {
+              audioOutput->write(record.timestamp, buffer);
+            }
+            replayed++;
+          }
+
+          OPENAUTO_LOG(info) << "[MediaDumpReplayer] Replayed " << replayed << " records";
+          return replayed;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,295 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifdef USE_FFMPEG_DRM
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Projection/H264HeaderParser.hpp>
+#include <f1x/openauto/autoapp/Projection/Mp4SegmentWriter.hpp>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavutil/mem.h>
+}
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          constexpr int cIoBufferSize = 64 * 1024;
+          const uint8_t cStartCode[] = {0, 0, 0, 1};
+        }
+
+        Mp4SegmentWriter::Mp4SegmentWriter()
+            : fd_(-1), width_(0), height_(0), context_(nullptr), io_(nullptr), packet_(nullptr),
+              headerWritten_(false), failed_(false), firstUs_(0), lastUs_(0), written_(0), flushed_(0)
+        {
+        }
+
+        Mp4SegmentWriter::~Mp4SegmentWriter()
+        {
+          this->close();
+        }
+
+        bool Mp4SegmentWriter::open(const std::string &path, uint64_t preallocateBytes, uint32_t width,
+                                    uint32_t height)
+        {
+          this->close();
+          fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+          if (fd_ < 0)
+          {
+            OPENAUTO_LOG(error) << "[Mp4SegmentWriter] Cannot create " << path << ": " << strerror(errno);
+            return false;
+          }
+
+          // KEEP_SIZE: the file length stays what was written, so a segment
+          // cut short by a power loss still ends at its last fragment. vfat
+          // and ext4 both do this without writing zeros
+          if (preallocateBytes > 0 &&
+              fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(preallocateBytes)) < 0)
+          {
+            OPENAUTO_LOG_FIRST_N(info, 1) << "[Mp4SegmentWriter] No preallocation on this filesystem: "
+                                          << strerror(errno);
+          }
+
+          path_ = path;
+          width_ = width;
+          height_ = height;
+          headerWritten_ = false;
+          failed_ = false;
+          firstUs_ = 0;
+          lastUs_ = 0;
+          written_ = 0;
+          flushed_ = 0;
+          return true;
+        }
+
+        bool Mp4SegmentWriter::writeHeader(const uint8_t *data, size_t size)
+        {
+          // The muxer takes Annex B parameter sets and converts them to avcC
+          std::vector<uint8_t> extradata;
+          for (const auto &nal : H264HeaderParser::splitAnnexB(data, size))
+          {
+            if (nal.type == H264HeaderParser::cNalSps || nal.type == H264HeaderParser::cNalPps)
+            {
+              extradata.insert(extradata.end(), std::begin(cStartCode), std::end(cStartCode));
+              extradata.insert(extradata.end(), nal.data, nal.data + nal.size);
+            }
+          }
+          if (extradata.empty())
+          {
+            OPENAUTO_LOG(warning) << "[Mp4SegmentWriter] Keyframe without SPS/PPS, waiting for the next";
+            return false;
+          }
+
+          if (avformat_alloc_output_context2(&context_, nullptr, "mp4", nullptr) < 0)
+          {
+            failed_ = true;
+            return false;
+          }
+          auto *buffer = static_cast<unsigned char *>(av_malloc(cIoBufferSize));
+          io_ = avio_alloc_context(buffer, cIoBufferSize, 1, this, nullptr, &Mp4SegmentWriter::writePacket, nullptr);
+          context_->pb = io_;
+
+          AVStream *stream = avformat_new_stream(context_, nullptr);
+          stream->time_base = AVRational{1, 1000000};
+          stream->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+          stream->codecpar->codec_id = AV_CODEC_ID_H264;
+          stream->codecpar->width = static_cast<int>(width_);
+          stream->codecpar->height = static_cast<int>(height_);
+          stream->codecpar->extradata =
+              static_cast<uint8_t *>(av_mallocz(extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+          memcpy(stream->codecpar->extradata, extradata.data(), extradata.size());
+          stream->codecpar->extradata_size = static_cast<int>(extradata.size());
+
+          AVDictionary *options = nullptr;
+          av_dict_set(&options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+          const int ret = avformat_write_header(context_, &options);
+          av_dict_free(&options);
+          if (ret < 0)
+          {
+            OPENAUTO_LOG(error) << "[Mp4SegmentWriter] Writing the MP4 header failed: " << ret;
+            failed_ = true;
+            return false;
+          }
+
+          packet_ = av_packet_alloc();
+          headerWritten_ = true;
+          return true;
+        }
+
+        bool Mp4SegmentWriter::write(const uint8_t *data, size_t size, int64_t timestampUs, bool keyframe)
+        {
+          if (fd_ < 0 || failed_)
+          {
+            return false;
+          }
+          if (!headerWritten_)
+          {
+            if (!keyframe)
+            {
+              return true;
+            }
+            if (!this->writeHeader(data, size))
+            {
+              return !failed_;
+            }
+            firstUs_ = timestampUs;
+          }
+
+          // Never seen with a hardware encoder, but the muxer rejects it
+          if (timestampUs <= lastUs_ && written_ > 0)
+          {
+            timestampUs = lastUs_ + 1;
+          }
+          lastUs_ = timestampUs;
+
+          AVStream *stream = context_->streams[0];
+          packet_->data = const_cast<uint8_t *>(data);
+          packet_->size = static_cast<int>(size);
+          packet_->pts = av_rescale_q(timestampUs - firstUs_, AVRational{1, 1000000}, stream->time_base);
+          packet_->dts = packet_->pts;
+          packet_->flags = keyframe ? AV_PKT_FLAG_KEY : 0;
+          packet_->stream_index = 0;
+          if (av_write_frame(context_, packet_) < 0)
+          {
+            failed_ = true;
+          }
+          // A keyframe closes the previous fragment: get it out of the AVIO
+          // buffer and into the file
+          if (keyframe && !failed_)
+          {
+            avio_flush(io_);
+          }
+          return !failed_;
+        }
+
+        int64_t Mp4SegmentWriter::durationUs() const
+        {
+          return headerWritten_ ? lastUs_ - firstUs_ : 0;
+        }
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+        int Mp4SegmentWriter::writePacket(void *opaque, const uint8_t *data, int size)
+#else
+        int Mp4SegmentWriter::writePacket(void *opaque, uint8_t *data, int size)
+#endif
+        {
+          return static_cast<Mp4SegmentWriter *>(opaque)->writeFile(data, size);
+        }
+
+        int Mp4SegmentWriter::writeFile(const uint8_t *data, int size)
+        {
+          int done = 0;
+          while (done < size)
+          {
+            const ssize_t n = ::write(fd_, data + done, static_cast<size_t>(size - done));
+            if (n < 0)
+            {
+              if (errno == EINTR)
+              {
+                continue;
+              }
+              OPENAUTO_LOG_EVERY_MS(error, 10000) << "[Mp4SegmentWriter] Write to " << path_
+                                                  << " failed: " << strerror(errno);
+              failed_ = true;
+              return AVERROR(errno);
+            }
+            done += static_cast<int>(n);
+          }
+          written_ += static_cast<uint64_t>(size);
+          this->flushToCard(false);
+          return size;
+        }
+
+        void Mp4SegmentWriter::flushToCard(bool all)
+        {
+          if (written_ - flushed_ < cFlushBytes && !all)
+          {
+            return;
+          }
+          // Start writeback of this stretch without waiting for it, and drop
+          // the previous one, written by now, from the page cache: recordings
+          // are never read back here and would push the app out of it
+          sync_file_range(fd_, static_cast<off_t>(flushed_), static_cast<off_t>(written_ - flushed_),
+                          SYNC_FILE_RANGE_WRITE);
+          if (flushed_ >= cFlushBytes)
+          {
+            posix_fadvise(fd_, static_cast<off_t>(flushed_ - cFlushBytes), static_cast<off_t>(cFlushBytes),
+                          POSIX_FADV_DONTNEED);
+          }
+          flushed_ = written_;
+        }
+
+        void Mp4SegmentWriter::close()
+        {
+          if (fd_ < 0)
+          {
+            return;
+          }
+          if (headerWritten_ && !failed_)
+          {
+            av_write_trailer(context_);
+          }
+          if (io_ != nullptr)
+          {
+            avio_flush(io_);
+            av_freep(&io_->buffer);
+            avio_context_free(&io_);
+          }
+          if (context_ != nullptr)
+          {
+            avformat_free_context(context_);
+            context_ = nullptr;
+          }
+          av_packet_free(&packet_);
+
+          // Gives back the preallocated space that was not used
+          if (ftruncate(fd_, static_cast<off_t>(written_)) < 0)
+          {
+            OPENAUTO_LOG(warning) << "[Mp4SegmentWriter] Trimming " << path_ << " failed: " << strerror(errno);
+          }
+          this->flushToCard(true);
+          ::close(fd_);
+          fd_ = -1;
+
+          if (written_ == 0)
+          {
+            unlink(path_.c_str());
+          }
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
@@ -25,8 +25,15 @@ extern "C"
 #endif
 }
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <aasdk/Common/Data.hpp>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/Projection/H264HeaderParser.hpp>
 #include <f1x/openauto/autoapp/Projection/OMXVideoOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
 #include <f1x/openauto/Common/Log.hpp>
 
 namespace f1x
@@ -46,11 +53,43 @@ namespace VideoComponent
     static constexpr uint32_t SCHEDULER = 3;
 }
 
+namespace
+{
+
+constexpr int cDecoderInputPort = 130;
+
+MetricCounter& droppedFrames()
+{
+    static MetricCounter& counter = Metrics::instance().counter(
+        "openauto_omx_frames_dropped_total", "Frames dropped because the OMX decoder had no free input buffer");
+    return counter;
+}
+
+bool containsIdr(const aasdk::common::DataConstBuffer& buffer)
+{
+    for(const auto& nal : H264HeaderParser::splitAnnexB(buffer.cdata, buffer.size))
+    {
+        if(nal.type == H264HeaderParser::cNalIdr)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
 OMXVideoOutput::OMXVideoOutput(configuration::IConfiguration::Pointer configuration)
     : VideoOutput(std::move(configuration))
     , isActive_(false)
     , portSettingsChanged_(false)
     , client_(nullptr)
+    , inputPool_(nullptr)
+    , inputPoolBytes_(0)
+    , inputPoolUsed_(0)
+    , inputSlabBytes_(0)
+    , waitForKeyframe_(false)
+    , feeding_(false)
 {
     memset(components_, 0, sizeof(components_));
     memset(tunnels_, 0, sizeof(tunnels_));
@@ -98,6 +137,18 @@ bool OMXVideoOutput::open()
         return false;
     }
 
+    // The slabs start out on ilclient's free list
+    while(OMX_BUFFERHEADERTYPE* header = ilclient_get_input_buffer(components_[VideoComponent::DECODER], cDecoderInputPort, 0))
+    {
+        freeInput_.push_back(header);
+    }
+    OPENAUTO_LOG(info) << "[OMXVideoOutput] " << freeInput_.size() << " input buffers of " << inputSlabBytes_ << " bytes.";
+
+    portSettingsChanged_ = false;
+    waitForKeyframe_ = false;
+    feeding_ = true;
+    feeder_ = std::thread(&OMXVideoOutput::feedLoop, this);
+
     isActive_ = true;
     return true;
 }
@@ -130,54 +181,202 @@ void OMXVideoOutput::write(uint64_t timestamp, const aasdk::common::DataConstBuf
 {
     std::lock_guard<decltype(mutex_)> lock(mutex_);
 
-    size_t writeSize = 0;
+    if(!isActive_ || buffer.size == 0)
+    {
+        return;
+    }
+
+    const bool keyframe = containsIdr(buffer);
+    if(waitForKeyframe_ && !keyframe)
+    {
+        droppedFrames().add(1);
+        this->frameConsumed(1);
+        return;
+    }
+
+    std::unique_lock<std::mutex> feedLock(feedMutex_);
+    const size_t needed = (buffer.size + inputSlabBytes_ - 1) / inputSlabBytes_;
+    if(freeInput_.size() < needed)
+    {
+        // The decoder is a pool behind; catch up at the next IDR frame
+        const bool firstDrop = !waitForKeyframe_;
+        waitForKeyframe_ = true;
+        const KeyframeRequestHandler requestKeyframe = keyframeRequestHandler_;
+        feedLock.unlock();
+
+        droppedFrames().add(1);
+        this->frameConsumed(1);
+        if(firstDrop)
+        {
+            OPENAUTO_LOG(warning) << "[OMXVideoOutput] decoder input full, dropping until the next IDR frame.";
+            if(requestKeyframe)
+            {
+                requestKeyframe();
+            }
+        }
+        return;
+    }
+    waitForKeyframe_ = false;
 
-    while(isActive_ && writeSize < buffer.size)
+    size_t offset = 0;
+    while(offset < buffer.size)
     {
-        OMX_BUFFERHEADERTYPE* buf = ilclient_get_input_buffer(components_[VideoComponent::DECODER], 130, 1);
+        OMX_BUFFERHEADERTYPE* header = freeInput_.front();
+        freeInput_.pop_front();
+
+        header->nFilledLen = std::min<size_t>(header->nAllocLen, buffer.size - offset);
+        memcpy(header->pBuffer, buffer.cdata + offset, header->nFilledLen);
+        header->nTimeStamp = omx_ticks_from_s64(timestamp / 1000000);
+        header->nOffset = 0;
+        header->nFlags = timestamp == 0 && offset == 0 ? OMX_BUFFERFLAG_STARTTIME : 0;
 
-        if(buf == nullptr)
+        offset += header->nFilledLen;
+        if(offset == buffer.size)
+        {
+            header->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
+        }
+        filledInput_.push_back(header);
+    }
+    feedCondition_.notify_one();
+}
+
+void OMXVideoOutput::feedLoop()
+{
+    ThreadTopology::instance().apply(ThreadRole::VideoDecode, "oa-omx-feed");
+
+    std::unique_lock<std::mutex> lock(feedMutex_);
+    while(true)
+    {
+        feedCondition_.wait(lock, [this]() { return !feeding_ || !filledInput_.empty(); });
+        if(!feeding_)
         {
             break;
         }
-        else
+
+        OMX_BUFFERHEADERTYPE* header = filledInput_.front();
+        filledInput_.pop_front();
+        const bool endOfFrame = (header->nFlags & OMX_BUFFERFLAG_ENDOFFRAME) != 0;
+        // Before the decoder has it: it can be given back before EmptyThisBuffer returns
+        inDecoder_.push_back(endOfFrame);
+        lock.unlock();
+
+        if(!portSettingsChanged_ && ilclient_remove_event(components_[VideoComponent::DECODER], OMX_EventPortSettingsChanged, 131, 0, 0, 1) == 0)
         {
-            aasdk::common::DataConstBuffer currentBuffer(buffer.cdata, buffer.size, writeSize);
-            buf->nFilledLen = std::min<size_t>(buf->nAllocLen, currentBuffer.size);
-            memcpy(buf->pBuffer, &currentBuffer.cdata[0], buf->nFilledLen);
-            buf->nTimeStamp = omx_ticks_from_s64(timestamp / 1000000);
-            buf->nOffset = 0;           
-            
-            writeSize += buf->nFilledLen;
-            
-            if(timestamp == 0)
+            portSettingsChanged_ = true;
+            if(!this->setupOutputTunnels())
             {
-              buf->nFlags = OMX_BUFFERFLAG_STARTTIME;
+                OPENAUTO_LOG(error) << "[OMXVideoOutput] output tunnel setup failed.";
             }
+        }
+
+        const bool accepted = OMX_EmptyThisBuffer(ILC_GET_HANDLE(components_[VideoComponent::DECODER]), header) == OMX_ErrorNone;
 
-            if(!portSettingsChanged_ && ilclient_remove_event(components_[VideoComponent::DECODER], OMX_EventPortSettingsChanged, 131, 0, 0, 1) == 0)
+        lock.lock();
+        if(!accepted)
+        {
+            OPENAUTO_LOG(error) << "[OMXVideoOutput] empty this buffer failed.";
+            inDecoder_.pop_back();
+            freeInput_.push_back(header);
+            if(endOfFrame)
             {
-                portSettingsChanged_ = true;
+                lock.unlock();
+                this->frameConsumed(1);
+                lock.lock();
+            }
+        }
+    }
+}
 
-                if(ilclient_setup_tunnel(&tunnels_[0], 0, 0) != 0)
-                {
-                    break;
-                }
+bool OMXVideoOutput::setupOutputTunnels()
+{
+    if(ilclient_setup_tunnel(&tunnels_[0], 0, 0) != 0)
+    {
+        return false;
+    }
 
-                ilclient_change_component_state(components_[VideoComponent::SCHEDULER], OMX_StateExecuting);
-                if(ilclient_setup_tunnel(&tunnels_[1], 0, 1000) != 0)
-                {
-                    break;
-                }
+    ilclient_change_component_state(components_[VideoComponent::SCHEDULER], OMX_StateExecuting);
+    if(ilclient_setup_tunnel(&tunnels_[1], 0, 1000) != 0)
+    {
+        return false;
+    }
 
-                ilclient_change_component_state(components_[VideoComponent::RENDERER], OMX_StateExecuting);
-            }
+    ilclient_change_component_state(components_[VideoComponent::RENDERER], OMX_StateExecuting);
+    return true;
+}
 
-            if(OMX_EmptyThisBuffer(ILC_GET_HANDLE(components_[VideoComponent::DECODER]), buf) != OMX_ErrorNone)
-            {
-                break;
-            }
+void OMXVideoOutput::frameConsumed(size_t frames)
+{
+    FrameConsumedHandler handler;
+    {
+        std::lock_guard<std::mutex> lock(feedMutex_);
+        handler = frameConsumedHandler_;
+    }
+    for(size_t i = 0; handler && i < frames; i++)
+    {
+        handler();
+    }
+}
+
+bool OMXVideoOutput::setFrameConsumedHandler(FrameConsumedHandler handler)
+{
+    std::lock_guard<std::mutex> lock(feedMutex_);
+    frameConsumedHandler_ = std::move(handler);
+    return true;
+}
+
+void OMXVideoOutput::setKeyframeRequestHandler(KeyframeRequestHandler handler)
+{
+    std::lock_guard<std::mutex> lock(feedMutex_);
+    keyframeRequestHandler_ = std::move(handler);
+}
+
+void* OMXVideoOutput::allocateInputBuffer(void* userdata, VCOS_UNSIGNED size, VCOS_UNSIGNED, const char*)
+{
+    auto* self = static_cast<OMXVideoOutput*>(userdata);
+    if(size > self->inputSlabBytes_ || self->inputPoolUsed_ + self->inputSlabBytes_ > self->inputPoolBytes_)
+    {
+        return nullptr;
+    }
+    uint8_t* slab = self->inputPool_ + self->inputPoolUsed_;
+    self->inputPoolUsed_ += self->inputSlabBytes_;
+    return slab;
+}
+
+void OMXVideoOutput::freeInputBuffer(void*, void*)
+{
+    // The pool goes as a whole in stop()
+}
+
+void OMXVideoOutput::onInputBufferDone(void* userdata, COMPONENT_T* component)
+{
+    auto* self = static_cast<OMXVideoOutput*>(userdata);
+    if(component != self->components_[VideoComponent::DECODER])
+    {
+        return;
+    }
+
+    // ilclient put the header back on its own list. Once stop() has begun it
+    // stays there for ilclient_disable_port_buffers() to find
+    bool endOfFrame = false;
+    {
+        std::lock_guard<std::mutex> lock(self->feedMutex_);
+        if(!self->feeding_)
+        {
+            return;
+        }
+        while(OMX_BUFFERHEADERTYPE* header = ilclient_get_input_buffer(component, cDecoderInputPort, 0))
+        {
+            self->freeInput_.push_back(header);
         }
+        if(!self->inDecoder_.empty())
+        {
+            endOfFrame = self->inDecoder_.front();
+            self->inDecoder_.pop_front();
+        }
+    }
+    if(endOfFrame)
+    {
+        self->frameConsumed(1);
     }
 }
 
@@ -191,10 +390,40 @@ void OMXVideoOutput::stop()
     {
         isActive_ = false;
 
+        {
+            std::lock_guard<std::mutex> feedLock(feedMutex_);
+            feeding_ = false;
+        }
+        feedCondition_.notify_one();
+        if(feeder_.joinable())
+        {
+            feeder_.join();
+        }
+
+        // Slabs we hold go back to ilclient linked through pAppPrivate, the
+        // rest come back from the decoder as the port is disabled
+        OMX_BUFFERHEADERTYPE* held = nullptr;
+        {
+            std::lock_guard<std::mutex> feedLock(feedMutex_);
+            for(auto* header : filledInput_)
+            {
+                header->pAppPrivate = held;
+                held = header;
+            }
+            for(auto* header : freeInput_)
+            {
+                header->pAppPrivate = held;
+                held = header;
+            }
+            filledInput_.clear();
+            freeInput_.clear();
+        }
+
         ilclient_disable_tunnel(&tunnels_[0]);
         ilclient_disable_tunnel(&tunnels_[1]);
         ilclient_disable_tunnel(&tunnels_[2]);
-        ilclient_disable_port_buffers(components_[VideoComponent::DECODER], 130, NULL, NULL, NULL);
+        ilclient_set_empty_buffer_done_callback(client_, NULL, NULL);
+        ilclient_disable_port_buffers(components_[VideoComponent::DECODER], cDecoderInputPort, held, &OMXVideoOutput::freeInputBuffer, this);
         ilclient_teardown_tunnels(tunnels_);
 
         ilclient_state_transition(components_, OMX_StateIdle);
@@ -203,6 +432,16 @@ void OMXVideoOutput::stop()
         ilclient_cleanup_components(components_);
         OMX_Deinit();
         ilclient_destroy(client_);
+
+        {
+            std::lock_guard<std::mutex> feedLock(feedMutex_);
+            inDecoder_.clear();
+        }
+        std::free(inputPool_);
+        MemoryFootprint::instance().release(MemoryPool::Video, static_cast<int64_t>(inputPoolBytes_));
+        inputPool_ = nullptr;
+        inputPoolBytes_ = 0;
+        inputPoolUsed_ = 0;
     }
 }
 
@@ -271,8 +510,46 @@ bool OMXVideoOutput::enablePortBuffers()
     format.nPortIndex = 130;
     format.eCompressionFormat = OMX_VIDEO_CodingAVC;
 
-    return OMX_SetParameter(ILC_GET_HANDLE(components_[VideoComponent::DECODER]), OMX_IndexParamVideoPortFormat, &format) == OMX_ErrorNone &&
-           ilclient_enable_port_buffers(components_[VideoComponent::DECODER], 130, NULL, NULL, NULL) == 0;
+    const OMX_HANDLETYPE decoder = ILC_GET_HANDLE(components_[VideoComponent::DECODER]);
+    if(OMX_SetParameter(decoder, OMX_IndexParamVideoPortFormat, &format) != OMX_ErrorNone)
+    {
+        return false;
+    }
+
+    OMX_PARAM_PORTDEFINITIONTYPE port;
+    memset(&port, 0, sizeof(OMX_PARAM_PORTDEFINITIONTYPE));
+    port.nSize = sizeof(OMX_PARAM_PORTDEFINITIONTYPE);
+    port.nVersion.nVersion = OMX_VERSION;
+    port.nPortIndex = cDecoderInputPort;
+    if(OMX_GetParameter(decoder, OMX_IndexParamPortDefinition, &port) != OMX_ErrorNone)
+    {
+        return false;
+    }
+    port.nBufferCountActual = std::max<OMX_U32>(port.nBufferCountMin, cInputBuffers);
+    port.nBufferSize = std::max<OMX_U32>(port.nBufferSize, cInputBufferBytes);
+    if(OMX_SetParameter(decoder, OMX_IndexParamPortDefinition, &port) != OMX_ErrorNone ||
+       OMX_GetParameter(decoder, OMX_IndexParamPortDefinition, &port) != OMX_ErrorNone)
+    {
+        return false;
+    }
+
+    // One block for every slab, each rounded up to the port's alignment
+    const size_t alignment = std::max<size_t>(port.nBufferAlignment, sizeof(void*));
+    inputSlabBytes_ = (port.nBufferSize + alignment - 1) / alignment * alignment;
+    inputPoolBytes_ = inputSlabBytes_ * port.nBufferCountActual;
+    inputPoolUsed_ = 0;
+    void* pool = nullptr;
+    if(posix_memalign(&pool, alignment, inputPoolBytes_) != 0)
+    {
+        inputPoolBytes_ = 0;
+        return false;
+    }
+    inputPool_ = static_cast<uint8_t*>(pool);
+    MemoryFootprint::instance().add(MemoryPool::Video, static_cast<int64_t>(inputPoolBytes_));
+
+    ilclient_set_empty_buffer_done_callback(client_, &OMXVideoOutput::onInputBufferDone, this);
+    return ilclient_enable_port_buffers(components_[VideoComponent::DECODER], cDecoderInputPort,
+                                        &OMXVideoOutput::allocateInputBuffer, &OMXVideoOutput::freeInputBuffer, this) == 0;
 }
 
 }
@@ -0,0 +1,131 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/autoapp/Projection/PacketDropPolicy.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        bool hasAnnexBStartCode(const uint8_t *data, size_t size)
+        {
+          if (size >= 3 && data[0] == 0 && data[1] == 0 && data[2] == 1)
+          {
+            return true;
+          }
+          return size >= 4 && data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 1;
+        }
+
+        AccessUnitInfo inspectAccessUnit(const uint8_t *data, size_t size, bool hevc)
+        {
+          AccessUnitInfo info;
+
+          // Fragments (parser mode) cannot be classified, so the drop policy
+          // gives one up only when nothing else is left to drop
+          if (!hasAnnexBStartCode(data, size))
+          {
+            return info;
+          }
+
+          // Each NAL unit starts after 00 00 01 (a 4-byte start code ends the same).
+          // Parameter sets come first; the first slice decides the frame type,
+          // so the slice payload itself is not scanned.
+          for (size_t i = 0; i + 3 < size && !info.hasSlices; i++)
+          {
+            if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1)
+            {
+              continue;
+            }
+
+            const uint8_t header = data[i + 3];
+            if (hevc)
+            {
+              // Two-byte header, type in bits 1..6. Slice types 0..9 are
+              // sub-layer non-reference when even; 16..21 are random access points.
+              const uint8_t nalType = (header >> 1) & 0x3f;
+              if (nalType >= 16 && nalType <= 21)
+              {
+                info.keyframe = true;
+                info.hasSlices = true;
+                info.reference = true;
+              }
+              else if (nalType <= 9)
+              {
+                info.hasSlices = true;
+                info.reference = nalType % 2 != 0;
+              }
+              else if (nalType >= 32 && nalType <= 34)
+              {
+                info.parameterSets = true;
+              }
+              i += 3;
+              continue;
+            }
+
+            const uint8_t nalType = header & 0x1f;
+            const uint8_t refIdc = (header >> 5) & 0x03;
+
+            if (nalType == 5)
+            {
+              info.keyframe = true;
+              info.hasSlices = true;
+              info.reference = true;
+            }
+            else if (nalType == 1)
+            {
+              info.hasSlices = true;
+              info.reference = refIdc != 0;
+            }
+            else if (nalType == 7 || nalType == 8)
+            {
+              info.parameterSets = true;
+              if (nalType == 7 && i + 4 < size)
+              {
+                info.profileIdc = data[i + 4];
+              }
+            }
+            i += 3;
+          }
+
+          return info;
+        }
+
+        void PacketDropPolicy::awaitKeyframe()
+        {
+          awaitingKeyframe_ = true;
+        }
+
+        bool PacketDropPolicy::awaitingKeyframe() const
+        {
+          return awaitingKeyframe_;
+        }
+
+        void PacketDropPolicy::reset()
+        {
+          awaitingKeyframe_ = false;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,181 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <f1x/openauto/autoapp/Projection/PresentationPacer.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          // Flip intervals further apart than this say nothing about the period
+          constexpr uint32_t cMaxMeasuredVblanks = 8;
+          // ... and neither do ones more than a tenth off the mode's refresh
+          constexpr int64_t cPeriodTolerancePercent = 10;
+          // Weight of each new measurement in the averaged period
+          constexpr double cPeriodSmoothing = 1.0 / 16.0;
+        }
+
+        PresentationPacer::PresentationPacer()
+            : cadence_(0), framePeriodUs_(0), vblankPeriodUs_(0.0), nominalPeriodUs_(0),
+              lastFlipUs_(0), lastSequence_(0), lastPtsUs_(0), expectedHold_(0)
+        {
+        }
+
+        void PresentationPacer::configure(uint32_t fps, uint32_t refreshMilliHz)
+        {
+          cadence_ = cadenceFor(fps, refreshMilliHz);
+          framePeriodUs_ = fps > 0 ? 1000000 / fps : 0;
+          nominalPeriodUs_ = refreshMilliHz > 0 ? static_cast<int64_t>(1000000000ull / refreshMilliHz) : 0;
+          vblankPeriodUs_ = static_cast<double>(nominalPeriodUs_);
+          lastFlipUs_ = 0;
+          lastSequence_ = 0;
+          lastPtsUs_ = 0;
+          expectedHold_ = 0;
+        }
+
+        uint32_t PresentationPacer::cadence() const
+        {
+          return cadence_;
+        }
+
+        int64_t PresentationPacer::vblankPeriodUs() const
+        {
+          return static_cast<int64_t>(vblankPeriodUs_ + 0.5);
+        }
+
+        bool PresentationPacer::onFlip(uint32_t sequence, int64_t vblankUs)
+        {
+          bool onCadence = true;
+          if (lastFlipUs_ != 0)
+          {
+            const uint32_t vblanks = sequence - lastSequence_;
+            if (vblanks > 0 && vblanks <= cMaxMeasuredVblanks && vblankUs > lastFlipUs_)
+            {
+              const int64_t measuredUs = (vblankUs - lastFlipUs_) / vblanks;
+              if (std::llabs(measuredUs - nominalPeriodUs_) * 100 <= nominalPeriodUs_ * cPeriodTolerancePercent)
+              {
+                vblankPeriodUs_ += (static_cast<double>(measuredUs) - vblankPeriodUs_) * cPeriodSmoothing;
+              }
+            }
+            onCadence = expectedHold_ == 0 || vblanks == expectedHold_;
+          }
+
+          lastFlipUs_ = vblankUs;
+          lastSequence_ = sequence;
+          expectedHold_ = 0;
+          return onCadence;
+        }
+
+        int64_t PresentationPacer::commitNotBeforeUs(int64_t ptsUs, size_t queuedFrames) const
+        {
+          // Behind: catch up rather than hold
+          if (cadence_ == 0 || lastFlipUs_ == 0 || queuedFrames > 1)
+          {
+            return 0;
+          }
+
+          const uint32_t hold = holdFor(ptsUs);
+          if (hold <= 1)
+          {
+            return 0;
+          }
+
+          // Past the vblank before the target one, so the commit latches on
+          // the target; a quarter period clear of it
+          const double periodUs = vblankPeriodUs_;
+          return lastFlipUs_ + static_cast<int64_t>(periodUs * (hold - 1) + periodUs / 4);
+        }
+
+        void PresentationPacer::onCommit(int64_t ptsUs)
+        {
+          expectedHold_ = lastFlipUs_ != 0 ? holdFor(ptsUs) : 0;
+          lastPtsUs_ = ptsUs > 0 ? ptsUs : 0;
+        }
+
+        uint32_t PresentationPacer::holdFor(int64_t ptsUs) const
+        {
+          if (cadence_ == 0)
+          {
+            return 0;
+          }
+          if (lastPtsUs_ == 0 || ptsUs <= lastPtsUs_)
+          {
+            return cadence_;
+          }
+
+          int64_t frames = (ptsUs - lastPtsUs_ + framePeriodUs_ / 2) / framePeriodUs_;
+          if (frames > cMaxHeldFrames)
+          {
+            return 0;
+          }
+          frames = frames < 1 ? 1 : frames;
+          return cadence_ * static_cast<uint32_t>(frames);
+        }
+
+        uint32_t PresentationPacer::cadenceFor(uint32_t fps, uint32_t refreshMilliHz)
+        {
+          if (fps == 0 || refreshMilliHz == 0)
+          {
+            return 0;
+          }
+
+          const uint64_t frameMilliHz = static_cast<uint64_t>(fps) * 1000;
+          const uint64_t vblanks = (refreshMilliHz + frameMilliHz / 2) / frameMilliHz;
+          if (vblanks == 0)
+          {
+            return 0;
+          }
+          const uint64_t exact = vblanks * frameMilliHz;
+          const uint64_t error = exact > refreshMilliHz ? exact - refreshMilliHz : refreshMilliHz - exact;
+          return error * 1000 <= static_cast<uint64_t>(refreshMilliHz) * cCadenceTolerancePermille
+                     ? static_cast<uint32_t>(vblanks)
+                     : 0;
+        }
+
+        size_t PresentationPacer::chooseRefresh(const std::vector<uint32_t> &refreshMilliHz, size_t current,
+                                                uint32_t fps)
+        {
+          if (current >= refreshMilliHz.size() || cadenceFor(fps, refreshMilliHz[current]) != 0)
+          {
+            return current;
+          }
+
+          size_t chosen = current;
+          for (size_t i = 0; i < refreshMilliHz.size(); i++)
+          {
+            if (cadenceFor(fps, refreshMilliHz[i]) != 0 &&
+                (chosen == current || refreshMilliHz[i] > refreshMilliHz[chosen]))
+            {
+              chosen = i;
+            }
+          }
+          return chosen;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
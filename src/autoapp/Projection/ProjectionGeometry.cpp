@@ -0,0 +1,371 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/Projection/ProjectionGeometry.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        DisplayOrientation::DisplayOrientation()
+            : rotation_(0), mirrored_(false)
+        {
+        }
+
+        DisplayOrientation::DisplayOrientation(int rotation, bool mirrored)
+            : rotation_(((rotation % 360) + 360) % 360), mirrored_(mirrored)
+        {
+          if (rotation_ % 90 != 0)
+          {
+            rotation_ = 0;
+          }
+        }
+
+        int DisplayOrientation::rotation() const
+        {
+          return rotation_;
+        }
+
+        bool DisplayOrientation::mirrored() const
+        {
+          return mirrored_;
+        }
+
+        bool DisplayOrientation::isIdentity() const
+        {
+          return rotation_ == 0 && !mirrored_;
+        }
+
+        bool DisplayOrientation::swapsAxes() const
+        {
+          return rotation_ == 90 || rotation_ == 270;
+        }
+
+        QSize DisplayOrientation::viewSize(const QSize &panelSize) const
+        {
+          return swapsAxes() ? panelSize.transposed() : panelSize;
+        }
+
+        QPointF DisplayOrientation::toPanel(const QPointF &viewPoint, const QSize &viewSize) const
+        {
+          const double w = viewSize.width();
+          const double h = viewSize.height();
+          QPointF panel = viewPoint;
+          switch (rotation_)
+          {
+          case 90:
+            panel = QPointF(h - viewPoint.y(), viewPoint.x());
+            break;
+          case 180:
+            panel = QPointF(w - viewPoint.x(), h - viewPoint.y());
+            break;
+          case 270:
+            panel = QPointF(viewPoint.y(), w - viewPoint.x());
+            break;
+          default:
+            break;
+          }
+          if (mirrored_)
+          {
+            panel.setX((swapsAxes() ? h : w) - panel.x());
+          }
+          return panel;
+        }
+
+        QPointF DisplayOrientation::toView(const QPointF &panelPoint, const QSize &panelSize) const
+        {
+          const double w = panelSize.width();
+          const double h = panelSize.height();
+          const double x = mirrored_ ? w - panelPoint.x() : panelPoint.x();
+          const double y = panelPoint.y();
+          switch (rotation_)
+          {
+          case 90:
+            return QPointF(y, w - x);
+          case 180:
+            return QPointF(w - x, h - y);
+          case 270:
+            return QPointF(h - y, x);
+          default:
+            return QPointF(x, y);
+          }
+        }
+
+        QRect DisplayOrientation::toPanel(const QRect &viewRect, const QSize &viewSize) const
+        {
+          const QPointF a = toPanel(QPointF(viewRect.x(), viewRect.y()), viewSize);
+          const QPointF b = toPanel(QPointF(viewRect.x() + viewRect.width(),
+                                            viewRect.y() + viewRect.height()),
+                                    viewSize);
+          const QPoint topLeft(static_cast<int>(std::lround(std::min(a.x(), b.x()))),
+                               static_cast<int>(std::lround(std::min(a.y(), b.y()))));
+          const QPoint bottomRight(static_cast<int>(std::lround(std::max(a.x(), b.x()))),
+                                   static_cast<int>(std::lround(std::max(a.y(), b.y()))));
+          return QRect(topLeft, QSize(bottomRight.x() - topLeft.x(), bottomRight.y() - topLeft.y()));
+        }
+
+        bool DisplayOrientation::operator==(const DisplayOrientation &other) const
+        {
+          return rotation_ == other.rotation_ && mirrored_ == other.mirrored_;
+        }
+
+        bool DisplayOrientation::operator!=(const DisplayOrientation &other) const
+        {
+          return !(*this == other);
+        }
+
+        ProjectionGeometry::ProjectionGeometry()
+            : scaleX_(1.0), scaleY_(1.0)
+        {
+        }
+
+        ProjectionGeometry::ProjectionGeometry(const QSize &videoSize, const QSize &margins,
+                                               const QSize &displaySize,
+                                               const DisplayOrientation &orientation)
+            : videoSize_(videoSize), displaySize_(displaySize), orientation_(orientation),
+              scaleX_(1.0), scaleY_(1.0)
+        {
+          if (videoSize_.isEmpty())
+          {
+            return;
+          }
+
+          // The phone UI is fitted to what the driver sees, not to the panel
+          const QSize view = orientation_.viewSize(displaySize_);
+          QSize requested = margins;
+          if (requested.width() <= 0 && requested.height() <= 0 && !view.isEmpty())
+          {
+            requested = fittedMargins(videoSize_, view);
+          }
+
+          // Leave at least a 2x2 pixel UI however large the margins are set
+          margins_ = QSize(std::clamp(requested.width(), 0, videoSize_.width() - 2),
+                           std::clamp(requested.height(), 0, videoSize_.height() - 2));
+          sourceRect_ = QRect(margins_.width() / 2, margins_.height() / 2,
+                              videoSize_.width() - margins_.width(),
+                              videoSize_.height() - margins_.height());
+
+          if (view.isEmpty())
+          {
+            return;
+          }
+
+          // Fit the UI into the display without distorting it
+          const int64_t srcW = sourceRect_.width();
+          const int64_t srcH = sourceRect_.height();
+          int dstW = view.width();
+          int dstH = view.height();
+          if (srcW * dstH > srcH * dstW)
+          {
+            dstH = static_cast<int>((dstW * srcH + srcW / 2) / srcW);
+          }
+          else
+          {
+            dstW = static_cast<int>((dstH * srcW + srcH / 2) / srcH);
+          }
+          // Margins are whole, even pixels, so a fitted UI can come out a pixel
+          // short; stretch that last pixel rather than leave a sliver of bar
+          if (view.width() - dstW <= cSnapPixels)
+          {
+            dstW = view.width();
+          }
+          if (view.height() - dstH <= cSnapPixels)
+          {
+            dstH = view.height();
+          }
+          dstW = std::max(dstW, 1);
+          dstH = std::max(dstH, 1);
+          viewRect_ = QRect((view.width() - dstW) / 2, (view.height() - dstH) / 2, dstW, dstH);
+          destinationRect_ = orientation_.toPanel(viewRect_, view);
+
+          scaleX_ = static_cast<double>(srcW) / dstW;
+          scaleY_ = static_cast<double>(srcH) / dstH;
+        }
+
+        QSize ProjectionGeometry::fittedMargins(const QSize &videoSize, const QSize &displaySize)
+        {
+          const int64_t videoW = videoSize.width();
+          const int64_t videoH = videoSize.height();
+          const int64_t displayW = displaySize.width();
+          const int64_t displayH = displaySize.height();
+
+          // Trim whichever axis is too long for the display aspect; even totals
+          // split into whole pixels on both sides
+          if (videoW * displayH > videoH * displayW)
+          {
+            const int64_t uiW = (videoH * displayW + displayH / 2) / displayH;
+            return QSize(static_cast<int>((videoW - uiW + 1) & ~int64_t(1)), 0);
+          }
+
+          const int64_t uiH = (videoW * displayH + displayW / 2) / displayW;
+          return QSize(0, static_cast<int>((videoH - uiH + 1) & ~int64_t(1)));
+        }
+
+        bool ProjectionGeometry::isNull() const
+        {
+          return sourceRect_.isEmpty() || destinationRect_.isEmpty();
+        }
+
+        const QSize &ProjectionGeometry::videoSize() const
+        {
+          return videoSize_;
+        }
+
+        const QSize &ProjectionGeometry::margins() const
+        {
+          return margins_;
+        }
+
+        const QSize &ProjectionGeometry::displaySize() const
+        {
+          return displaySize_;
+        }
+
+        const DisplayOrientation &ProjectionGeometry::orientation() const
+        {
+          return orientation_;
+        }
+
+        const QRect &ProjectionGeometry::sourceRect() const
+        {
+          return sourceRect_;
+        }
+
+        const QRect &ProjectionGeometry::destinationRect() const
+        {
+          return destinationRect_;
+        }
+
+        ProjectionGeometry ProjectionGeometry::withDisplaySize(const QSize &displaySize) const
+        {
+          return ProjectionGeometry(videoSize_, margins_, displaySize, orientation_);
+        }
+
+        ProjectionGeometry ProjectionGeometry::withVideoSize(const QSize &videoSize) const
+        {
+          if (videoSize_.isEmpty())
+          {
+            return ProjectionGeometry(videoSize, QSize(), displaySize_, orientation_);
+          }
+
+          return ProjectionGeometry(
+              videoSize,
+              QSize(margins_.width() * videoSize.width() / videoSize_.width(),
+                    margins_.height() * videoSize.height() / videoSize_.height()),
+              displaySize_, orientation_);
+        }
+
+        QPoint ProjectionGeometry::mapToVideo(const QPointF &displayPoint) const
+        {
+          if (isNull())
+          {
+            return displayPoint.toPoint();
+          }
+
+          const QPointF source = mapToSource(displayPoint);
+          return QPoint(std::clamp(static_cast<int>(std::lround(source.x())), sourceRect_.left(),
+                                   sourceRect_.right()),
+                        std::clamp(static_cast<int>(std::lround(source.y())), sourceRect_.top(),
+                                   sourceRect_.bottom()));
+        }
+
+        QPointF ProjectionGeometry::mapToSource(const QPointF &displayPoint) const
+        {
+          if (isNull())
+          {
+            return displayPoint;
+          }
+
+          const QPointF view = orientation_.toView(displayPoint, displaySize_);
+          return QPointF(sourceRect_.x() + (view.x() - viewRect_.x()) * scaleX_,
+                         sourceRect_.y() + (view.y() - viewRect_.y()) * scaleY_);
+        }
+
+        bool ProjectionGeometry::operator==(const ProjectionGeometry &other) const
+        {
+          return videoSize_ == other.videoSize_ && margins_ == other.margins_ &&
+                 displaySize_ == other.displaySize_ && orientation_ == other.orientation_;
+        }
+
+        bool ProjectionGeometry::operator!=(const ProjectionGeometry &other) const
+        {
+          return !(*this == other);
+        }
+
+        TouchTransform::TouchTransform()
+            : matrix_{int64_t(1) << cFractionBits, 0, 0, 0, int64_t(1) << cFractionBits, 0}, clamp_(false)
+        {
+        }
+
+        TouchTransform::TouchTransform(const ProjectionGeometry &geometry)
+            : TouchTransform()
+        {
+          if (geometry.isNull())
+          {
+            return;
+          }
+
+          // mapToSource() is affine, so three points give the whole matrix
+          const double width = geometry.displaySize().width();
+          const double height = geometry.displaySize().height();
+          const QPointF origin = geometry.mapToSource(QPointF(0, 0));
+          const QPointF alongX = geometry.mapToSource(QPointF(width, 0));
+          const QPointF alongY = geometry.mapToSource(QPointF(0, height));
+          const double one = static_cast<double>(int64_t(1) << cFractionBits);
+          matrix_ = {std::llround((alongX.x() - origin.x()) / width * one),
+                     std::llround((alongY.x() - origin.x()) / height * one),
+                     std::llround(origin.x() * one),
+                     std::llround((alongX.y() - origin.y()) / width * one),
+                     std::llround((alongY.y() - origin.y()) / height * one),
+                     std::llround(origin.y() * one)};
+          clamp_ = true;
+          bounds_ = geometry.sourceRect();
+        }
+
+        QPoint TouchTransform::map(const QPointF &displayPoint) const
+        {
+          const int64_t x = std::llround(displayPoint.x() * (1 << cInputShift));
+          const int64_t y = std::llround(displayPoint.y() * (1 << cInputShift));
+          // Round to nearest; the arithmetic shift floors negative values too
+          const int64_t half = int64_t(1) << (cFractionBits - 1);
+          const int videoX = static_cast<int>(
+              (((matrix_[0] * x + matrix_[1] * y) >> cInputShift) + matrix_[2] + half) >> cFractionBits);
+          const int videoY = static_cast<int>(
+              (((matrix_[3] * x + matrix_[4] * y) >> cInputShift) + matrix_[5] + half) >> cFractionBits);
+          if (!clamp_)
+          {
+            return QPoint(videoX, videoY);
+          }
+          return QPoint(std::clamp(videoX, bounds_.left(), bounds_.right()),
+                        std::clamp(videoY, bounds_.top(), bounds_.bottom()));
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
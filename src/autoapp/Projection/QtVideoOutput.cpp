@@ -19,7 +19,6 @@
 #include <QApplication>
 #include <QGuiApplication>
 #include <QScreen>
-#include <mutex>
 #include <f1x/openauto/autoapp/Projection/QtVideoOutput.hpp>
 #include <f1x/openauto/Common/Log.hpp>
 
@@ -63,7 +62,9 @@ void QtVideoOutput::createVideoOutput()
 
 bool QtVideoOutput::open()
 {
-    return videoBuffer_.open(QIODevice::ReadWrite);
+    // Unbuffered: the player reads straight from the chunk ring rather
+    // than through QIODevice's own copy of it
+    return videoBuffer_.open(QIODevice::ReadWrite | QIODevice::Unbuffered);
 }
 
 bool QtVideoOutput::init()
@@ -79,22 +80,19 @@ void QtVideoOutput::stop()
 
 void QtVideoOutput::write(uint64_t, const aasdk::common::DataConstBuffer& buffer)
 {
-    std::lock_guard<std::mutex> lock(writeMutex_);
-    
     // Skip writes if player is not ready or was stopped
-    if (!playerReady_) {
+    if (!playerReady_.load(std::memory_order_acquire)) {
         return;
     }
     
     // Write data to buffer - the SequentialBuffer will handle the buffering
     videoBuffer_.write(reinterpret_cast<const char*>(buffer.cdata), buffer.size);
-    bytesWritten_ += buffer.size;
+    const size_t bytesWritten = bytesWritten_.fetch_add(buffer.size, std::memory_order_relaxed) + buffer.size;
     
     // Log initial buffering milestone
-    if (!initialBufferingDone_ && bytesWritten_ >= INITIAL_BUFFER_SIZE)
+    if (bytesWritten >= INITIAL_BUFFER_SIZE && !initialBufferingDone_.exchange(true))
     {
-        initialBufferingDone_ = true;
-        OPENAUTO_LOG(info) << "[QtVideoOutput] Initial buffering complete (" << bytesWritten_ << " bytes written)";
+        OPENAUTO_LOG(info) << "[QtVideoOutput] Initial buffering complete (" << bytesWritten << " bytes written)";
     }
 }
 
@@ -137,10 +135,7 @@ void QtVideoOutput::onStartPlayback()
     mediaPlayer_->play();
     
     // Mark as ready immediately after calling play() since we're using blocking connection
-    {
-        std::lock_guard<std::mutex> lock(writeMutex_);
-        playerReady_ = true;
-    }
+    playerReady_.store(true, std::memory_order_release);
 
     OPENAUTO_LOG(info) << "[QtVideoOutput] Player started and marked ready";
     OPENAUTO_LOG(debug) << "[QtVideoOutput] Player error state -> " << mediaPlayer_->errorString().toStdString();
@@ -166,8 +161,7 @@ void QtVideoOutput::onStopPlayback()
 {
     OPENAUTO_LOG(info) << "[QtVideoOutput] onStopPlayback()";
     
-    std::lock_guard<std::mutex> lock(writeMutex_);
-    playerReady_ = false;
+    playerReady_.store(false, std::memory_order_release);
     initialBufferingDone_ = false;
     bytesWritten_ = 0;
     
@@ -183,8 +177,7 @@ void QtVideoOutput::onMediaStatusChanged(QMediaPlayer::MediaStatus status)
     // Mark player as ready when buffering or buffered
     if (status == QMediaPlayer::BufferingMedia || status == QMediaPlayer::BufferedMedia)
     {
-        std::lock_guard<std::mutex> lock(writeMutex_);
-        playerReady_ = true;
+        playerReady_.store(true, std::memory_order_release);
         OPENAUTO_LOG(info) << "[QtVideoOutput] Player is now ready to receive data";
     }
 }
@@ -196,14 +189,12 @@ void QtVideoOutput::onStateChanged(QMediaPlayer::State state)
     // Mark player as ready when playing state is reached
     if (state == QMediaPlayer::PlayingState)
     {
-        std::lock_guard<std::mutex> lock(writeMutex_);
-        playerReady_ = true;
+        playerReady_.store(true, std::memory_order_release);
         OPENAUTO_LOG(info) << "[QtVideoOutput] Player entered PLAYING state";
     }
     else if (state == QMediaPlayer::StoppedState)
     {
-        std::lock_guard<std::mutex> lock(writeMutex_);
-        playerReady_ = false;
+        playerReady_.store(false, std::memory_order_release);
         OPENAUTO_LOG(info) << "[QtVideoOutput] Player stopped";
     }
 }
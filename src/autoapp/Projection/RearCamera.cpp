@@ -0,0 +1,1031 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/Projection/RearCamera.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef USE_FFMPEG_DRM
+#include <drm_fourcc.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/Projection/CmaBudget.hpp>
+#include <f1x/openauto/autoapp/Projection/DashcamRecorder.hpp>
+#include <f1x/openauto/autoapp/Projection/DrmDevice.hpp>
+#include <f1x/openauto/autoapp/Projection/FFmpegDrmVideoOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
+#endif
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          constexpr uint32_t cGuidelineRed = 0xffe53935;
+          constexpr uint32_t cGuidelineYellow = 0xfffdd835;
+          constexpr uint32_t cGuidelineGreen = 0xff43a047;
+
+#ifdef USE_FFMPEG_DRM
+          struct CameraMetrics
+          {
+            MetricHistogram &firstFrame = Metrics::instance().histogram(
+                "openauto_rearcam_first_frame_ms", "Reverse engaged to the first camera frame on the plane",
+                {50, 100, 150, 200, 300, 500, 1000, 2000});
+            MetricCounter &droppedFrames = Metrics::instance().counter(
+                "openauto_rearcam_dropped_frames_total", "Camera frames replaced by a newer one before being shown");
+          };
+
+          CameraMetrics &metrics()
+          {
+            static CameraMetrics instance;
+            return instance;
+          }
+
+          int xioctl(int fd, unsigned long request, void *arg)
+          {
+            int ret;
+            do
+            {
+              ret = ioctl(fd, request, arg);
+            } while (ret < 0 && errno == EINTR);
+            return ret;
+          }
+
+          // Capture formats a plane can scan out as they are, best first
+          struct FormatPair
+          {
+            uint32_t v4l2;
+            uint32_t drm;
+          };
+          const FormatPair cFormats[] = {{V4L2_PIX_FMT_NV12, DRM_FORMAT_NV12},
+                                         {V4L2_PIX_FMT_YUYV, DRM_FORMAT_YUYV},
+                                         {V4L2_PIX_FMT_UYVY, DRM_FORMAT_UYVY}};
+#endif
+
+          // One segment of a guideline, clipped to the image
+          void fillSpan(uint32_t *pixels, uint32_t pitch, uint32_t width, uint32_t height, int x0, int x1,
+                        int y, uint32_t color)
+          {
+            if (y < 0 || y >= static_cast<int>(height))
+            {
+              return;
+            }
+            x0 = std::max(x0, 0);
+            x1 = std::min(x1, static_cast<int>(width) - 1);
+            for (int x = x0; x <= x1; x++)
+            {
+              pixels[static_cast<size_t>(y) * pitch + x] = color;
+            }
+          }
+        }
+
+        void RearCamera::drawGuidelines(uint32_t *pixels, uint32_t pitch, uint32_t width, uint32_t height)
+        {
+          for (uint32_t y = 0; y < height; y++)
+          {
+            std::fill(pixels + static_cast<size_t>(y) * pitch, pixels + static_cast<size_t>(y) * pitch + width, 0u);
+          }
+          if (width < 16 || height < 16)
+          {
+            return;
+          }
+
+          // The lines run from near the bottom corners up to 45% of the height;
+          // t is the distance along them, 0 at the bumper
+          const int thickness = std::max(2, static_cast<int>(height / 120));
+          const double bottom = height - 1;
+          const double top = height * 0.45;
+          const double center = width / 2.0;
+          auto halfWidth = [width](double t) { return width * (0.30 - 0.16 * t); };
+          auto colorAt = [](double t) {
+            return t < 0.33 ? cGuidelineRed : t < 0.66 ? cGuidelineYellow : cGuidelineGreen;
+          };
+
+          for (int y = static_cast<int>(top); y <= static_cast<int>(bottom); y++)
+          {
+            const double t = (bottom - y) / (bottom - top);
+            const int left = static_cast<int>(std::lround(center - halfWidth(t)));
+            const int right = static_cast<int>(std::lround(center + halfWidth(t)));
+            fillSpan(pixels, pitch, width, height, left, left + thickness - 1, y, colorAt(t));
+            fillSpan(pixels, pitch, width, height, right - thickness + 1, right, y, colorAt(t));
+          }
+
+          // Distance marks reaching a quarter of the way in from each line
+          for (const double t : {0.15, 0.5, 0.85})
+          {
+            const int y = static_cast<int>(std::lround(bottom - t * (bottom - top)));
+            const double half = halfWidth(t);
+            const int reach = static_cast<int>(half / 2);
+            const int left = static_cast<int>(std::lround(center - half));
+            const int right = static_cast<int>(std::lround(center + half));
+            for (int row = 0; row < thickness; row++)
+            {
+              fillSpan(pixels, pitch, width, height, left, left + reach, y - row, colorAt(t));
+              fillSpan(pixels, pitch, width, height, right - reach, right, y - row, colorAt(t));
+            }
+          }
+        }
+
+        RearCamera::RearCamera(configuration::IConfiguration::Pointer configuration)
+            : configuration_(std::move(configuration)), stopping_(false), wantShown_(false), wakeFd_(-1),
+              drmFd_(-1), crtcId_(0), displayWidth_(0), displayHeight_(0), planeId_(0),
+              guidelinesPlaneId_(0), sharesVideoPlane_(false), videoFd_(-1), bufferType_(0),
+              pixelFormat_(0), drmFormat_(0), width_(0), height_(0), bytesPerLine_(0),
+              dmabufImport_(false), streaming_(false), shown_(false), onScreen_(-1), engagedUs_(0),
+              fps_(30), recording_(false)
+        {
+        }
+
+        void RearCamera::setRecorder(std::shared_ptr<DashcamRecorder> recorder)
+        {
+          recorder_ = std::move(recorder);
+        }
+
+        void RearCamera::setShown(bool shown)
+        {
+          if (wantShown_.exchange(shown) != shown)
+          {
+            OPENAUTO_LOG(info) << "[RearCamera] Reverse " << (shown ? "engaged" : "released");
+            this->wake();
+          }
+        }
+
+        bool RearCamera::isShown() const
+        {
+          return wantShown_.load();
+        }
+
+#ifndef USE_FFMPEG_DRM
+
+        RearCamera::~RearCamera() = default;
+
+        bool RearCamera::prepare()
+        {
+          if (!configuration_->getRearCameraDevice().empty())
+          {
+            OPENAUTO_LOG(warning) << "[RearCamera] Needs a build with USE_FFMPEG_DRM, camera disabled";
+          }
+          return false;
+        }
+
+        void RearCamera::wake() {}
+
+#else
+
+        RearCamera::~RearCamera()
+        {
+          if (thread_.joinable())
+          {
+            stopping_ = true;
+            this->wake();
+            thread_.join();
+          }
+          if (wakeFd_ >= 0)
+          {
+            close(wakeFd_);
+          }
+          if (drmFd_ >= 0)
+          {
+            close(drmFd_);
+          }
+        }
+
+        bool RearCamera::prepare()
+        {
+          if (thread_.joinable())
+          {
+            return true;
+          }
+          if (configuration_->getRearCameraDevice().empty())
+          {
+            OPENAUTO_LOG(info) << "[RearCamera] No Video/RearCameraDevice configured";
+            return false;
+          }
+          if (!this->openDisplay())
+          {
+            return false;
+          }
+
+          wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+          if (wakeFd_ < 0)
+          {
+            OPENAUTO_LOG(error) << "[RearCamera] eventfd failed: " << strerror(errno);
+            return false;
+          }
+
+          // Registered here: the first lookup allocates
+          metrics();
+
+          // The capture device is opened on the camera thread, off the boot path
+          thread_ = std::thread(&RearCamera::run, this);
+          return true;
+        }
+
+        void RearCamera::wake()
+        {
+          if (wakeFd_ >= 0)
+          {
+            const uint64_t one = 1;
+            if (::write(wakeFd_, &one, sizeof(one)) < 0)
+            {
+              // Already signalled
+            }
+          }
+        }
+
+        bool RearCamera::openDisplay()
+        {
+          drmFd_ = drmdevice::openShared();
+          if (drmFd_ < 0)
+          {
+            OPENAUTO_LOG(error) << "[RearCamera] Failed to open /dev/dri/card0: " << strerror(errno);
+            return false;
+          }
+
+          drmModeRes *resources = drmModeGetResources(drmFd_);
+          if (!resources)
+          {
+            OPENAUTO_LOG(error) << "[RearCamera] Failed to get DRM resources";
+            return false;
+          }
+
+          for (int i = 0; i < resources->count_connectors && crtcId_ == 0; i++)
+          {
+            drmModeConnector *connector = drmModeGetConnector(drmFd_, resources->connectors[i]);
+            if (connector && connector->connection == DRM_MODE_CONNECTED && connector->encoder_id)
+            {
+              if (drmModeEncoder *encoder = drmModeGetEncoder(drmFd_, connector->encoder_id))
+              {
+                crtcId_ = encoder->crtc_id;
+                drmModeFreeEncoder(encoder);
+              }
+            }
+            drmModeFreeConnector(connector);
+          }
+          drmModeFreeResources(resources);
+
+          // The mode Qt set up, which the camera is scaled to
+          drmModeCrtc *crtc = crtcId_ ? drmModeGetCrtc(drmFd_, crtcId_) : nullptr;
+          if (!crtc || !crtc->mode_valid)
+          {
+            OPENAUTO_LOG(error) << "[RearCamera] No active display";
+            drmModeFreeCrtc(crtc);
+            return false;
+          }
+          displayWidth_ = crtc->mode.hdisplay;
+          displayHeight_ = crtc->mode.vdisplay;
+          drmModeFreeCrtc(crtc);
+          return true;
+        }
+
+        bool RearCamera::openCapture()
+        {
+          const std::string device = configuration_->getRearCameraDevice();
+          videoFd_ = ::open(device.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+          if (videoFd_ < 0)
+          {
+            return false;
+          }
+
+          struct v4l2_capability cap = {};
+          const uint32_t caps = xioctl(videoFd_, VIDIOC_QUERYCAP, &cap) < 0 ? 0
+                                : (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps
+                                                                            : cap.capabilities;
+          if (!(caps & V4L2_CAP_STREAMING) ||
+              !(caps & (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_CAPTURE_MPLANE)))
+          {
+            OPENAUTO_LOG(error) << "[RearCamera] " << device << " is not a streaming capture device";
+            this->closeCapture();
+            return false;
+          }
+          bufferType_ = (caps & V4L2_CAP_VIDEO_CAPTURE) ? V4L2_BUF_TYPE_VIDEO_CAPTURE
+                                                        : V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+
+          // What the grabber offers, in the order a plane is likeliest to take it
+          std::vector<FormatPair> offered;
+          struct v4l2_fmtdesc desc = {};
+          desc.type = bufferType_;
+          for (desc.index = 0; xioctl(videoFd_, VIDIOC_ENUM_FMT, &desc) == 0; desc.index++)
+          {
+            for (const auto &pair : cFormats)
+            {
+              if (pair.v4l2 == desc.pixelformat)
+              {
+                offered.push_back(pair);
+              }
+            }
+          }
+          std::sort(offered.begin(), offered.end(), [](const FormatPair &a, const FormatPair &b) {
+            return std::find_if(std::begin(cFormats), std::end(cFormats),
+                                [&a](const FormatPair &f) { return f.v4l2 == a.v4l2; }) <
+                   std::find_if(std::begin(cFormats), std::end(cFormats),
+                                [&b](const FormatPair &f) { return f.v4l2 == b.v4l2; });
+          });
+
+          for (const auto &pair : offered)
+          {
+            drmFormat_ = pair.drm;
+            if (this->findPlanes())
+            {
+              pixelFormat_ = pair.v4l2;
+              break;
+            }
+          }
+          if (pixelFormat_ == 0)
+          {
+            // MJPEG and RGB would need a CPU pass, which this path never makes
+            OPENAUTO_LOG(error) << "[RearCamera] " << device
+                                << " offers no NV12, YUYV or UYVY format an overlay plane can show";
+            this->closeCapture();
+            return false;
+          }
+
+          // The driver's current size is kept: grabbers report the signal's
+          struct v4l2_format format = {};
+          format.type = bufferType_;
+          if (xioctl(videoFd_, VIDIOC_G_FMT, &format) < 0)
+          {
+            this->closeCapture();
+            return false;
+          }
+          if (bufferType_ == V4L2_BUF_TYPE_VIDEO_CAPTURE)
+          {
+            format.fmt.pix.pixelformat = pixelFormat_;
+            format.fmt.pix.field = V4L2_FIELD_ANY;
+          }
+          else
+          {
+            format.fmt.pix_mp.pixelformat = pixelFormat_;
+            format.fmt.pix_mp.field = V4L2_FIELD_ANY;
+            format.fmt.pix_mp.num_planes = 1;
+          }
+          if (xioctl(videoFd_, VIDIOC_S_FMT, &format) < 0)
+          {
+            OPENAUTO_LOG(error) << "[RearCamera] Setting the capture format failed: " << strerror(errno);
+            this->closeCapture();
+            return false;
+          }
+
+          if (bufferType_ == V4L2_BUF_TYPE_VIDEO_CAPTURE)
+          {
+            width_ = format.fmt.pix.width;
+            height_ = format.fmt.pix.height;
+            bytesPerLine_ = format.fmt.pix.bytesperline;
+          }
+          else
+          {
+            width_ = format.fmt.pix_mp.width;
+            height_ = format.fmt.pix_mp.height;
+            bytesPerLine_ = format.fmt.pix_mp.plane_fmt[0].bytesperline;
+            if (format.fmt.pix_mp.num_planes != 1)
+            {
+              OPENAUTO_LOG(error) << "[RearCamera] Only single-plane capture buffers are supported";
+              this->closeCapture();
+              return false;
+            }
+          }
+
+          if (!this->allocateBuffers())
+          {
+            this->closeCapture();
+            return false;
+          }
+
+          struct v4l2_streamparm parm = {};
+          parm.type = bufferType_;
+          if (xioctl(videoFd_, VIDIOC_G_PARM, &parm) == 0 && parm.parm.capture.timeperframe.numerator != 0)
+          {
+            fps_ = parm.parm.capture.timeperframe.denominator / parm.parm.capture.timeperframe.numerator;
+          }
+          fps_ = std::max(fps_, 1u);
+          this->attachRecorder();
+
+          OPENAUTO_LOG(info) << "[RearCamera] " << device << ": " << width_ << "x" << height_ << " "
+                             << std::string(reinterpret_cast<const char *>(&pixelFormat_), 4) << " on plane "
+                             << planeId_ << (dmabufImport_ ? ", dumb buffers imported" : ", buffers exported")
+                             << (guidelinesPlaneId_ ? ", guidelines on plane " + std::to_string(guidelinesPlaneId_)
+                                                    : std::string(", no guidelines plane"));
+          return true;
+        }
+
+        bool RearCamera::findPlanes()
+        {
+          planeId_ = 0;
+          guidelinesPlaneId_ = 0;
+
+          drmModeRes *resources = drmModeGetResources(drmFd_);
+          drmModePlaneResPtr planeRes = drmModeGetPlaneResources(drmFd_);
+          if (!resources || !planeRes)
+          {
+            drmModeFreeResources(resources);
+            drmModeFreePlaneResources(planeRes);
+            return false;
+          }
+
+          uint32_t crtcMask = 0;
+          for (int i = 0; i < resources->count_crtcs; i++)
+          {
+            if (resources->crtcs[i] == crtcId_)
+            {
+              crtcMask = 1u << i;
+            }
+          }
+
+          // The video output takes the first overlay plane that fits, so the
+          // camera takes the last one and shares only when there is no other
+          std::vector<uint32_t> overlays;
+          std::vector<uint32_t> argbOverlays;
+          for (uint32_t i = 0; i < planeRes->count_planes; i++)
+          {
+            drmModePlanePtr plane = drmModeGetPlane(drmFd_, planeRes->planes[i]);
+            if (!plane)
+            {
+              continue;
+            }
+            if ((plane->possible_crtcs & crtcMask) &&
+                drmdevice::planeType(drmFd_, plane->plane_id) == DRM_PLANE_TYPE_OVERLAY)
+            {
+              if (drmdevice::planeSupports(plane, drmFormat_))
+              {
+                overlays.push_back(plane->plane_id);
+              }
+              if (drmdevice::planeSupports(plane, DRM_FORMAT_ARGB8888))
+              {
+                argbOverlays.push_back(plane->plane_id);
+              }
+            }
+            drmModeFreePlane(plane);
+          }
+          drmModeFreePlaneResources(planeRes);
+          drmModeFreeResources(resources);
+
+          if (overlays.empty())
+          {
+            return false;
+          }
+          planeId_ = overlays.back();
+          sharesVideoPlane_ = overlays.size() == 1;
+
+          // Planes stack by id unless the driver says otherwise: the guidelines
+          // need one above the camera
+          for (const uint32_t id : argbOverlays)
+          {
+            if (id > planeId_)
+            {
+              guidelinesPlaneId_ = id;
+              break;
+            }
+          }
+          return true;
+        }
+
+        bool RearCamera::allocateBuffers()
+        {
+          const bool nv12 = drmFormat_ == DRM_FORMAT_NV12;
+          // NV12 carries its half-height chroma in the same buffer
+          const uint32_t lines = nv12 ? height_ + (height_ + 1) / 2 : height_;
+
+          // Dumb buffers are contiguous, so anything the VOP can scan out; the
+          // grabber writes into them directly
+          struct v4l2_requestbuffers request = {};
+          request.count = cBufferCount;
+          request.type = bufferType_;
+          request.memory = V4L2_MEMORY_DMABUF;
+          dmabufImport_ = xioctl(videoFd_, VIDIOC_REQBUFS, &request) == 0 && request.count >= 2;
+          if (!dmabufImport_)
+          {
+            request = {};
+            request.count = cBufferCount;
+            request.type = bufferType_;
+            request.memory = V4L2_MEMORY_MMAP;
+            if (xioctl(videoFd_, VIDIOC_REQBUFS, &request) < 0 || request.count < 2)
+            {
+              OPENAUTO_LOG(error) << "[RearCamera] Capture buffer allocation failed: " << strerror(errno);
+              return false;
+            }
+          }
+
+          buffers_.resize(request.count);
+          for (size_t i = 0; i < buffers_.size(); i++)
+          {
+            Buffer &buffer = buffers_[i];
+            if (dmabufImport_)
+            {
+              struct drm_mode_create_dumb create = {};
+              create.width = bytesPerLine_;
+              create.height = lines;
+              create.bpp = 8;
+              if (ioctl(drmFd_, DRM_IOCTL_MODE_CREATE_DUMB, &create) < 0 ||
+                  drmPrimeHandleToFD(drmFd_, create.handle, DRM_CLOEXEC | DRM_RDWR, &buffer.fd) < 0)
+              {
+                OPENAUTO_LOG(error) << "[RearCamera] Dumb buffer allocation failed: " << strerror(errno);
+                buffer.handle = create.handle;
+                this->releaseBuffers();
+                return false;
+              }
+              buffer.handle = create.handle;
+              buffer.size = create.size;
+              CmaBudget::instance().add(CmaPool::Camera, static_cast<int64_t>(buffer.size));
+            }
+            else
+            {
+              struct v4l2_exportbuffer expbuf = {};
+              expbuf.type = bufferType_;
+              expbuf.index = static_cast<uint32_t>(i);
+              expbuf.flags = O_RDONLY | O_CLOEXEC;
+              if (xioctl(videoFd_, VIDIOC_EXPBUF, &expbuf) < 0 ||
+                  drmPrimeFDToHandle(drmFd_, expbuf.fd, &buffer.handle) < 0)
+              {
+                OPENAUTO_LOG(error) << "[RearCamera] Capture buffers cannot be exported to DRM: " << strerror(errno);
+                buffer.fd = expbuf.fd > 0 ? expbuf.fd : -1;
+                this->releaseBuffers();
+                return false;
+              }
+              buffer.fd = expbuf.fd;
+              buffer.size = static_cast<size_t>(bytesPerLine_) * lines;
+            }
+
+            uint32_t handles[4] = {buffer.handle, nv12 ? buffer.handle : 0, 0, 0};
+            uint32_t pitches[4] = {bytesPerLine_, nv12 ? bytesPerLine_ : 0, 0, 0};
+            uint32_t offsets[4] = {0, nv12 ? bytesPerLine_ * height_ : 0, 0, 0};
+            if (drmModeAddFB2(drmFd_, width_, height_, drmFormat_, handles, pitches, offsets, &buffer.fbId, 0) < 0)
+            {
+              // Usually a pitch the display controller cannot fetch: no
+              // copying fallback, by design
+              OPENAUTO_LOG(error) << "[RearCamera] " << width_ << "x" << height_ << " with a " << bytesPerLine_
+                                  << " byte pitch cannot be scanned out: " << strerror(errno);
+              buffer.fbId = 0;
+              this->releaseBuffers();
+              return false;
+            }
+          }
+
+          if (configuration_->getRearCameraGuidelines() && guidelinesPlaneId_ != 0 && guidelines_.fbId == 0 &&
+              !this->createGuidelines())
+          {
+            guidelinesPlaneId_ = 0;
+          }
+          return true;
+        }
+
+        void RearCamera::releaseBuffers()
+        {
+          for (auto &buffer : buffers_)
+          {
+            if (buffer.fbId)
+            {
+              drmModeRmFB(drmFd_, buffer.fbId);
+            }
+            if (buffer.fd >= 0)
+            {
+              close(buffer.fd);
+            }
+            if (buffer.handle && dmabufImport_)
+            {
+              struct drm_mode_destroy_dumb destroy = {};
+              destroy.handle = buffer.handle;
+              ioctl(drmFd_, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+              CmaBudget::instance().release(CmaPool::Camera, static_cast<int64_t>(buffer.size));
+            }
+            else if (buffer.handle)
+            {
+              struct drm_gem_close closeReq = {};
+              closeReq.handle = buffer.handle;
+              ioctl(drmFd_, DRM_IOCTL_GEM_CLOSE, &closeReq);
+            }
+          }
+          buffers_.clear();
+
+          if (videoFd_ >= 0)
+          {
+            struct v4l2_requestbuffers request = {};
+            request.type = bufferType_;
+            request.memory = dmabufImport_ ? V4L2_MEMORY_DMABUF : V4L2_MEMORY_MMAP;
+            xioctl(videoFd_, VIDIOC_REQBUFS, &request);
+          }
+        }
+
+        bool RearCamera::createGuidelines()
+        {
+          struct drm_mode_create_dumb create = {};
+          create.width = displayWidth_;
+          create.height = displayHeight_;
+          create.bpp = 32;
+          if (ioctl(drmFd_, DRM_IOCTL_MODE_CREATE_DUMB, &create) < 0)
+          {
+            return false;
+          }
+          guidelines_.handle = create.handle;
+          guidelines_.size = create.size;
+          CmaBudget::instance().add(CmaPool::Camera, static_cast<int64_t>(create.size));
+
+          // Drawn once: the lines are static, nothing touches them per frame
+          struct drm_mode_map_dumb map = {};
+          map.handle = create.handle;
+          void *pixels = ioctl(drmFd_, DRM_IOCTL_MODE_MAP_DUMB, &map) < 0
+                             ? MAP_FAILED
+                             : mmap(nullptr, create.size, PROT_READ | PROT_WRITE, MAP_SHARED, drmFd_, map.offset);
+          if (pixels != MAP_FAILED)
+          {
+            drawGuidelines(static_cast<uint32_t *>(pixels), create.pitch / 4, displayWidth_, displayHeight_);
+            munmap(pixels, create.size);
+
+            uint32_t handles[4] = {create.handle, 0, 0, 0};
+            uint32_t pitches[4] = {create.pitch, 0, 0, 0};
+            uint32_t offsets[4] = {0, 0, 0, 0};
+            if (drmModeAddFB2(drmFd_, displayWidth_, displayHeight_, DRM_FORMAT_ARGB8888, handles, pitches, offsets,
+                              &guidelines_.fbId, 0) == 0)
+            {
+              return true;
+            }
+          }
+
+          struct drm_mode_destroy_dumb destroy = {};
+          destroy.handle = create.handle;
+          ioctl(drmFd_, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+          CmaBudget::instance().release(CmaPool::Camera, static_cast<int64_t>(create.size));
+          guidelines_ = DumbImage();
+          return false;
+        }
+
+        void RearCamera::attachRecorder()
+        {
+          if (!recorder_)
+          {
+            return;
+          }
+          DashcamRecorder::CaptureFormat format;
+          format.pixelFormat = pixelFormat_;
+          format.width = width_;
+          format.height = height_;
+          format.bytesPerLine = bytesPerLine_;
+          format.fps = fps_;
+          for (const auto &buffer : buffers_)
+          {
+            format.fds.push_back(buffer.fd);
+            format.sizes.push_back(buffer.size);
+          }
+          // One buffer on the plane and one filling stay the camera's
+          const size_t maxHeld = buffers_.size() > 2 ? buffers_.size() - 2 : 0;
+          recording_ = maxHeld > 0 && recorder_->attach(format, maxHeld, [this](int index) {
+            {
+              std::lock_guard<std::mutex> lock(releasedMutex_);
+              released_.push_back(index);
+            }
+            this->wake();
+          });
+        }
+
+        void RearCamera::collectReleased()
+        {
+          std::vector<int> released;
+          {
+            std::lock_guard<std::mutex> lock(releasedMutex_);
+            released.swap(released_);
+          }
+          for (int index : released)
+          {
+            if (index < static_cast<int>(buffers_.size()))
+            {
+              buffers_[index].encoding = false;
+              this->returnBuffer(index);
+            }
+          }
+        }
+
+        void RearCamera::closeCapture()
+        {
+          if (recording_)
+          {
+            // Takes the buffers back from the encoder before they go
+            recorder_->detach();
+            recording_ = false;
+            std::lock_guard<std::mutex> lock(releasedMutex_);
+            released_.clear();
+          }
+          if (streaming_)
+          {
+            this->stopStreaming();
+          }
+          this->releaseBuffers();
+          if (videoFd_ >= 0)
+          {
+            close(videoFd_);
+            videoFd_ = -1;
+          }
+          pixelFormat_ = 0;
+        }
+
+        void RearCamera::describeBuffer(int index, struct v4l2_buffer &buffer, struct v4l2_plane &plane) const
+        {
+          buffer = {};
+          plane = {};
+          buffer.type = bufferType_;
+          buffer.memory = dmabufImport_ ? V4L2_MEMORY_DMABUF : V4L2_MEMORY_MMAP;
+          buffer.index = static_cast<uint32_t>(index);
+          if (bufferType_ == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+          {
+            buffer.m.planes = &plane;
+            buffer.length = 1;
+            if (dmabufImport_)
+            {
+              plane.m.fd = buffers_[index].fd;
+              plane.length = static_cast<uint32_t>(buffers_[index].size);
+            }
+          }
+          else if (dmabufImport_)
+          {
+            buffer.m.fd = buffers_[index].fd;
+            buffer.length = static_cast<uint32_t>(buffers_[index].size);
+          }
+        }
+
+        bool RearCamera::queueBuffer(int index)
+        {
+          struct v4l2_buffer buffer;
+          struct v4l2_plane plane;
+          this->describeBuffer(index, buffer, plane);
+          return xioctl(videoFd_, VIDIOC_QBUF, &buffer) == 0;
+        }
+
+        void RearCamera::returnBuffer(int index)
+        {
+          // Back to the grabber once neither the plane nor the encoder reads it
+          if (streaming_ && index >= 0 && index != onScreen_ && !buffers_[index].encoding)
+          {
+            this->queueBuffer(index);
+          }
+        }
+
+        int RearCamera::dequeueNewest()
+        {
+          // Only the newest frame is worth showing; older ones go straight back
+          int newest = -1;
+          while (true)
+          {
+            struct v4l2_buffer buffer;
+            struct v4l2_plane plane;
+            this->describeBuffer(0, buffer, plane);
+            if (xioctl(videoFd_, VIDIOC_DQBUF, &buffer) < 0)
+            {
+              break;
+            }
+            if (buffer.flags & V4L2_BUF_FLAG_ERROR)
+            {
+              this->queueBuffer(static_cast<int>(buffer.index));
+              continue;
+            }
+            if (newest >= 0)
+            {
+              this->queueBuffer(newest);
+              metrics().droppedFrames.add();
+            }
+            newest = static_cast<int>(buffer.index);
+          }
+          return newest;
+        }
+
+        bool RearCamera::startStreaming()
+        {
+          for (size_t i = 0; i < buffers_.size(); i++)
+          {
+            if (buffers_[i].encoding)
+            {
+              continue;
+            }
+            if (!this->queueBuffer(static_cast<int>(i)))
+            {
+              OPENAUTO_LOG(error) << "[RearCamera] Queueing capture buffer " << i << " failed: " << strerror(errno);
+              return false;
+            }
+          }
+          uint32_t type = bufferType_;
+          if (xioctl(videoFd_, VIDIOC_STREAMON, &type) < 0)
+          {
+            OPENAUTO_LOG(error) << "[RearCamera] STREAMON failed: " << strerror(errno);
+            return false;
+          }
+          streaming_ = true;
+          onScreen_ = -1;
+          return true;
+        }
+
+        void RearCamera::stopStreaming()
+        {
+          // Returns every buffer, the one on the plane too: take it off first
+          uint32_t type = bufferType_;
+          xioctl(videoFd_, VIDIOC_STREAMOFF, &type);
+          streaming_ = false;
+          onScreen_ = -1;
+        }
+
+        void RearCamera::engage()
+        {
+          shown_ = true;
+          engagedUs_ = VideoTelemetry::nowUs();
+          if (sharesVideoPlane_)
+          {
+            FFmpegDrmVideoOutput::lendPlane(true);
+          }
+          if (videoFd_ >= 0 && !streaming_)
+          {
+            this->startStreaming();
+          }
+          if (guidelines_.fbId != 0 &&
+              drmModeSetPlane(drmFd_, guidelinesPlaneId_, crtcId_, guidelines_.fbId, 0, 0, 0, displayWidth_,
+                              displayHeight_, 0, 0, displayWidth_ << 16, displayHeight_ << 16) != 0)
+          {
+            OPENAUTO_LOG(warning) << "[RearCamera] Guidelines plane " << guidelinesPlaneId_ << " rejected the overlay";
+          }
+        }
+
+        void RearCamera::disengage()
+        {
+          shown_ = false;
+          engagedUs_ = 0;
+          this->disablePlanes();
+          const int previous = onScreen_;
+          onScreen_ = -1;
+          this->returnBuffer(previous);
+          if (streaming_ && !recording_ && !configuration_->getRearCameraHotStandby())
+          {
+            this->stopStreaming();
+          }
+          if (sharesVideoPlane_)
+          {
+            FFmpegDrmVideoOutput::lendPlane(false);
+          }
+        }
+
+        bool RearCamera::showBuffer(int index)
+        {
+          // SetPlane returns once the new framebuffer is latched, so the one it
+          // replaced is off screen and can be captured into again
+          const int ret = drmModeSetPlane(drmFd_, planeId_, crtcId_, buffers_[index].fbId, 0, 0, 0, displayWidth_,
+                                          displayHeight_, 0, 0, width_ << 16, height_ << 16);
+          if (ret != 0)
+          {
+            OPENAUTO_LOG_EVERY_MS(warning, 5000) << "[RearCamera] Showing " << OPENAUTO_LOG_OCCURRENCES
+                                                 << " frame(s) failed: " << strerror(-ret);
+            return false;
+          }
+          const int previous = onScreen_;
+          onScreen_ = index;
+          this->returnBuffer(previous);
+
+          if (engagedUs_ != 0)
+          {
+            const double ms = (VideoTelemetry::nowUs() - engagedUs_) / 1000.0;
+            metrics().firstFrame.observe(ms);
+            OPENAUTO_LOG(info) << "[RearCamera] First frame " << ms << " ms after reverse was engaged";
+            engagedUs_ = 0;
+          }
+          return true;
+        }
+
+        void RearCamera::disablePlanes()
+        {
+          drmModeSetPlane(drmFd_, planeId_, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+          if (guidelines_.fbId != 0)
+          {
+            drmModeSetPlane(drmFd_, guidelinesPlaneId_, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+          }
+        }
+
+        void RearCamera::run()
+        {
+          ThreadTopology::instance().apply(ThreadRole::VideoPresent, "oa-rearcam");
+          int64_t lastFrameUs = 0;
+
+          while (!stopping_.load())
+          {
+            if (videoFd_ < 0 && !this->openCapture())
+            {
+              OPENAUTO_LOG_EVERY_MS(info, 60000) << "[RearCamera] Waiting for " << configuration_->getRearCameraDevice();
+            }
+            else if (!streaming_ && videoFd_ >= 0 && (shown_ || recording_ || configuration_->getRearCameraHotStandby()))
+            {
+              // Back after an unplug, standing by for reverse, or recording
+              this->startStreaming();
+            }
+
+            const bool want = wantShown_.load();
+            if (want && !shown_)
+            {
+              this->engage();
+              lastFrameUs = VideoTelemetry::nowUs();
+            }
+            else if (!want && shown_)
+            {
+              this->disengage();
+            }
+
+            struct pollfd fds[2] = {{wakeFd_, POLLIN, 0}, {streaming_ ? videoFd_ : -1, POLLIN, 0}};
+            const int timeoutMs = videoFd_ < 0 ? cReopenIntervalMs : shown_ ? 1000 : -1;
+            if (poll(fds, 2, timeoutMs) < 0 && errno != EINTR)
+            {
+              break;
+            }
+
+            if (fds[0].revents & POLLIN)
+            {
+              uint64_t count;
+              if (::read(wakeFd_, &count, sizeof(count)) < 0)
+              {
+                // Spurious wakeup
+              }
+              this->collectReleased();
+            }
+
+            if (fds[1].revents & (POLLERR | POLLHUP))
+            {
+              // Unplugged: show nothing rather than a frozen frame
+              OPENAUTO_LOG(warning) << "[RearCamera] Capture device lost";
+              if (shown_)
+              {
+                this->disablePlanes();
+                onScreen_ = -1;
+                engagedUs_ = VideoTelemetry::nowUs();
+              }
+              this->closeCapture();
+              continue;
+            }
+
+            if (fds[1].revents & POLLIN)
+            {
+              const int index = this->dequeueNewest();
+              if (index >= 0)
+              {
+                if (recording_ && recorder_->submit(index, VideoTelemetry::nowUs()))
+                {
+                  buffers_[index].encoding = true;
+                }
+                if (!(shown_ && this->showBuffer(index)))
+                {
+                  this->returnBuffer(index);
+                }
+              }
+              lastFrameUs = VideoTelemetry::nowUs();
+            }
+            else if (shown_ && VideoTelemetry::nowUs() - lastFrameUs > 1000000)
+            {
+              OPENAUTO_LOG_EVERY_MS(warning, 10000) << "[RearCamera] No frames from the grabber, is a camera signal present?";
+            }
+          }
+
+          if (shown_)
+          {
+            this->disengage();
+          }
+          this->closeCapture();
+          if (guidelines_.fbId != 0)
+          {
+            drmModeRmFB(drmFd_, guidelines_.fbId);
+            struct drm_mode_destroy_dumb destroy = {};
+            destroy.handle = guidelines_.handle;
+            ioctl(drmFd_, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+            CmaBudget::instance().release(CmaPool::Camera, static_cast<int64_t>(guidelines_.size));
+            guidelines_ = DumbImage();
+          }
+        }
+
+#endif
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,513 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef USE_FFMPEG_DRM
+
+#include <f1x/openauto/autoapp/Projection/RgaTransform.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+#include <drm_fourcc.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          // VOP planes fetch whole 64-byte bursts per line
+          constexpr uint32_t cScanoutPitchAlignment = 64;
+
+          int xioctl(int fd, unsigned long request, void *arg)
+          {
+            int ret;
+            do
+            {
+              ret = ioctl(fd, request, arg);
+            } while (ret < 0 && errno == EINTR);
+            return ret;
+          }
+
+          struct FormatInfo
+          {
+            uint32_t drmFormat;
+            uint32_t v4l2Format;
+            uint32_t bytesPerPixel; // Of the first plane
+            bool semiPlanar;
+          };
+
+          // DRM names formats by the little-endian word, V4L2 by the bytes in
+          // memory: DRM XRGB8888 is B, G, R, X, which V4L2 calls XBGR32
+          constexpr FormatInfo cFormats[] = {
+              {DRM_FORMAT_NV12, V4L2_PIX_FMT_NV12, 1, true},
+              {DRM_FORMAT_NV21, V4L2_PIX_FMT_NV21, 1, true},
+              {DRM_FORMAT_NV16, V4L2_PIX_FMT_NV16, 1, true},
+              {DRM_FORMAT_NV61, V4L2_PIX_FMT_NV61, 1, true},
+              {DRM_FORMAT_XRGB8888, V4L2_PIX_FMT_XBGR32, 4, false},
+              {DRM_FORMAT_ARGB8888, V4L2_PIX_FMT_ABGR32, 4, false},
+              {DRM_FORMAT_RGB888, V4L2_PIX_FMT_BGR24, 3, false},
+              {DRM_FORMAT_RGB565, V4L2_PIX_FMT_RGB565, 2, false}};
+
+          const FormatInfo *findFormat(uint32_t drmFormat)
+          {
+            for (const FormatInfo &format : cFormats)
+            {
+              if (format.drmFormat == drmFormat)
+              {
+                return &format;
+              }
+            }
+            return nullptr;
+          }
+
+          bool setControl(int fd, uint32_t id, int32_t value)
+          {
+            v4l2_control control = {};
+            control.id = id;
+            control.value = value;
+            return xioctl(fd, VIDIOC_S_CTRL, &control) == 0;
+          }
+        }
+
+        bool RgaTransform::canRead(uint32_t drmFormat)
+        {
+          return findFormat(drmFormat) != nullptr;
+        }
+
+        uint32_t RgaTransform::scanoutFormat(uint32_t drmFormat)
+        {
+          const FormatInfo *format = findFormat(drmFormat);
+          return format && !format->semiPlanar ? DRM_FORMAT_XRGB8888 : DRM_FORMAT_NV12;
+        }
+
+        RgaTransform::RgaTransform(int drmFd)
+            : drmFd_(drmFd), videoFd_(-1), configured_(), operation_(), streaming_(false),
+              outputBytes_(0), next_(0)
+        {
+        }
+
+        RgaTransform::~RgaTransform()
+        {
+          close();
+        }
+
+        bool RgaTransform::open()
+        {
+          if (videoFd_ >= 0)
+          {
+            return true;
+          }
+
+          for (size_t i = 0; i < cMaxDevices; i++)
+          {
+            const std::string path = "/dev/video" + std::to_string(i);
+            const int fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+            if (fd < 0)
+            {
+              continue;
+            }
+
+            v4l2_capability cap = {};
+            const uint32_t caps = xioctl(fd, VIDIOC_QUERYCAP, &cap) < 0 ? 0
+                                  : (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps
+                                                                               : cap.capabilities;
+            if ((caps & V4L2_CAP_VIDEO_M2M) && (caps & V4L2_CAP_STREAMING) &&
+                strcmp(reinterpret_cast<const char *>(cap.driver), "rockchip-rga") == 0)
+            {
+              videoFd_ = fd;
+              deviceName_ = path;
+              OPENAUTO_LOG(info) << "[RgaTransform] Using " << deviceName_;
+              return true;
+            }
+            ::close(fd);
+          }
+
+          OPENAUTO_LOG(warning) << "[RgaTransform] No rockchip-rga device found";
+          return false;
+        }
+
+        void RgaTransform::close()
+        {
+          if (videoFd_ < 0)
+          {
+            return;
+          }
+          releaseBuffers();
+          ::close(videoFd_);
+          videoFd_ = -1;
+        }
+
+        bool RgaTransform::isOpen() const
+        {
+          return videoFd_ >= 0;
+        }
+
+        void RgaTransform::releaseBuffers()
+        {
+          if (streaming_)
+          {
+            int type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+            xioctl(videoFd_, VIDIOC_STREAMOFF, &type);
+            type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            xioctl(videoFd_, VIDIOC_STREAMOFF, &type);
+            streaming_ = false;
+          }
+
+          for (Capture &capture : captures_)
+          {
+            if (capture.fbId != 0)
+            {
+              drmModeRmFB(drmFd_, capture.fbId);
+            }
+            if (capture.handle != 0)
+            {
+              drmCloseBufferHandle(drmFd_, capture.handle);
+            }
+            if (capture.fd >= 0)
+            {
+              ::close(capture.fd);
+            }
+          }
+          captures_.clear();
+
+          v4l2_requestbuffers request = {};
+          request.count = 0;
+          request.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+          request.memory = V4L2_MEMORY_DMABUF;
+          xioctl(videoFd_, VIDIOC_REQBUFS, &request);
+          request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+          request.memory = V4L2_MEMORY_MMAP;
+          xioctl(videoFd_, VIDIOC_REQBUFS, &request);
+
+          configured_ = Source();
+          operation_ = Operation();
+          next_ = 0;
+        }
+
+        RgaTransform::Operation RgaTransform::resolve(const Source &source,
+                                                      const Operation &operation)
+        {
+          Operation resolved = operation;
+          if (resolved.cropWidth == 0 || resolved.cropHeight == 0)
+          {
+            resolved.cropX = 0;
+            resolved.cropY = 0;
+            resolved.cropWidth = source.width;
+            resolved.cropHeight = source.height;
+          }
+
+          const bool swapsAxes = resolved.rotation == 90 || resolved.rotation == 270;
+          if (resolved.width == 0 || resolved.height == 0)
+          {
+            resolved.width = swapsAxes ? resolved.cropHeight : resolved.cropWidth;
+            resolved.height = swapsAxes ? resolved.cropWidth : resolved.cropHeight;
+          }
+
+          if (resolved.drmFormat == 0)
+          {
+            resolved.drmFormat = scanoutFormat(source.drmFormat);
+          }
+          return resolved;
+        }
+
+        bool RgaTransform::sameSource(const Source &a, const Source &b)
+        {
+          return a.drmFormat == b.drmFormat && a.width == b.width && a.height == b.height &&
+                 a.pitch == b.pitch && a.chromaOffset == b.chromaOffset;
+        }
+
+        bool RgaTransform::sameOperation(const Operation &a, const Operation &b)
+        {
+          return a.rotation == b.rotation && a.mirrored == b.mirrored && a.cropX == b.cropX &&
+                 a.cropY == b.cropY && a.cropWidth == b.cropWidth &&
+                 a.cropHeight == b.cropHeight && a.width == b.width && a.height == b.height &&
+                 a.drmFormat == b.drmFormat;
+        }
+
+        bool RgaTransform::configure(const Source &source, const Operation &operation)
+        {
+          if (!captures_.empty() && sameSource(source, configured_) &&
+              sameOperation(operation, operation_))
+          {
+            return true;
+          }
+          releaseBuffers();
+
+          const FormatInfo *input = findFormat(source.drmFormat);
+          const FormatInfo *output = findFormat(operation.drmFormat);
+          if (!input || !output ||
+              (operation.drmFormat != DRM_FORMAT_NV12 &&
+               operation.drmFormat != DRM_FORMAT_XRGB8888))
+          {
+            OPENAUTO_LOG(warning) << "[RgaTransform] Unsupported conversion";
+            return false;
+          }
+
+          // The frame's pitch and chroma offset become the V4L2 buffer size;
+          // the crop selects the picture inside it
+          const uint32_t bufferHeight =
+              input->semiPlanar && source.pitch > 0 ? source.chromaOffset / source.pitch
+                                                    : source.height;
+          if (source.pitch % input->bytesPerPixel != 0 || bufferHeight < source.height ||
+              (input->semiPlanar && source.chromaOffset % source.pitch != 0) ||
+              operation.cropX + operation.cropWidth > source.width ||
+              operation.cropY + operation.cropHeight > source.height)
+          {
+            OPENAUTO_LOG(warning) << "[RgaTransform] Frame layout " << source.pitch << "/"
+                                  << source.chromaOffset << " does not fit a V4L2 buffer";
+            return false;
+          }
+
+          v4l2_format sourceFormat = {};
+          sourceFormat.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+          sourceFormat.fmt.pix.width = source.pitch / input->bytesPerPixel;
+          sourceFormat.fmt.pix.height = bufferHeight;
+          sourceFormat.fmt.pix.pixelformat = input->v4l2Format;
+          sourceFormat.fmt.pix.field = V4L2_FIELD_NONE;
+          if (xioctl(videoFd_, VIDIOC_S_FMT, &sourceFormat) < 0 ||
+              sourceFormat.fmt.pix.pixelformat != input->v4l2Format ||
+              sourceFormat.fmt.pix.bytesperline != source.pitch ||
+              sourceFormat.fmt.pix.height != bufferHeight ||
+              sourceFormat.fmt.pix.sizeimage > source.size)
+          {
+            OPENAUTO_LOG(warning) << "[RgaTransform] " << deviceName_
+                                  << " rejected the frame format: " << strerror(errno);
+            return false;
+          }
+          outputBytes_ = sourceFormat.fmt.pix.sizeimage;
+
+          v4l2_selection crop = {};
+          crop.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+          crop.target = V4L2_SEL_TGT_CROP;
+          crop.r.left = static_cast<int32_t>(operation.cropX);
+          crop.r.top = static_cast<int32_t>(operation.cropY);
+          crop.r.width = operation.cropWidth;
+          crop.r.height = operation.cropHeight;
+          if (xioctl(videoFd_, VIDIOC_S_SELECTION, &crop) < 0 ||
+              crop.r.width != operation.cropWidth || crop.r.height != operation.cropHeight)
+          {
+            OPENAUTO_LOG(warning) << "[RgaTransform] " << deviceName_ << " cannot crop to "
+                                  << operation.cropWidth << "x" << operation.cropHeight;
+            return false;
+          }
+
+          // Padded to a scanout pitch; the compose rectangle keeps the picture
+          // at its size so the padding is never drawn
+          const uint32_t alignPixels = cScanoutPitchAlignment / output->bytesPerPixel;
+          v4l2_format capture = {};
+          capture.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+          capture.fmt.pix.width = (operation.width + alignPixels - 1) / alignPixels * alignPixels;
+          capture.fmt.pix.height = operation.height;
+          capture.fmt.pix.pixelformat = output->v4l2Format;
+          capture.fmt.pix.field = V4L2_FIELD_NONE;
+          if (xioctl(videoFd_, VIDIOC_S_FMT, &capture) < 0 ||
+              capture.fmt.pix.pixelformat != output->v4l2Format ||
+              capture.fmt.pix.width < operation.width || capture.fmt.pix.height < operation.height)
+          {
+            OPENAUTO_LOG(warning) << "[RgaTransform] " << deviceName_
+                                  << " rejected the output format: " << strerror(errno);
+            return false;
+          }
+          const uint32_t pitch = capture.fmt.pix.bytesperline;
+          const uint32_t bufferLines = capture.fmt.pix.height;
+
+          v4l2_selection compose = {};
+          compose.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+          compose.target = V4L2_SEL_TGT_COMPOSE;
+          compose.r.width = operation.width;
+          compose.r.height = operation.height;
+          if (xioctl(videoFd_, VIDIOC_S_SELECTION, &compose) < 0 ||
+              compose.r.width != operation.width || compose.r.height != operation.height)
+          {
+            OPENAUTO_LOG(warning) << "[RgaTransform] " << deviceName_ << " cannot scale to "
+                                  << operation.width << "x" << operation.height;
+            return false;
+          }
+
+          // The RGA mirrors the source before rotating it, where a left-right
+          // flip on the panel is an up-down flip of a frame turned on its side
+          const bool swapsAxes = operation.rotation == 90 || operation.rotation == 270;
+          if (!setControl(videoFd_, V4L2_CID_ROTATE, operation.rotation) ||
+              !setControl(videoFd_, V4L2_CID_HFLIP, operation.mirrored && !swapsAxes) ||
+              !setControl(videoFd_, V4L2_CID_VFLIP, operation.mirrored && swapsAxes))
+          {
+            OPENAUTO_LOG(warning) << "[RgaTransform] " << deviceName_ << " cannot rotate by "
+                                  << operation.rotation;
+            return false;
+          }
+
+          v4l2_requestbuffers request = {};
+          request.count = 1;
+          request.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+          request.memory = V4L2_MEMORY_DMABUF;
+          if (xioctl(videoFd_, VIDIOC_REQBUFS, &request) < 0)
+          {
+            OPENAUTO_LOG(warning) << "[RgaTransform] Cannot import DMA-BUFs: " << strerror(errno);
+            return false;
+          }
+
+          request = {};
+          request.count = cCaptureBuffers;
+          request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+          request.memory = V4L2_MEMORY_MMAP;
+          if (xioctl(videoFd_, VIDIOC_REQBUFS, &request) < 0 || request.count < 2)
+          {
+            OPENAUTO_LOG(warning) << "[RgaTransform] Cannot allocate output buffers: "
+                                  << strerror(errno);
+            return false;
+          }
+
+          // Export every capture buffer and scan it out from where it is
+          const bool nv12 = operation.drmFormat == DRM_FORMAT_NV12;
+          for (uint32_t i = 0; i < request.count; i++)
+          {
+            captures_.emplace_back();
+            Capture &entry = captures_.back();
+
+            v4l2_exportbuffer exported = {};
+            exported.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            exported.index = i;
+            exported.flags = O_RDWR | O_CLOEXEC;
+            if (xioctl(videoFd_, VIDIOC_EXPBUF, &exported) == 0)
+            {
+              entry.fd = exported.fd;
+            }
+            if (entry.fd < 0 || drmPrimeFDToHandle(drmFd_, entry.fd, &entry.handle) != 0)
+            {
+              OPENAUTO_LOG(warning) << "[RgaTransform] Cannot export output buffer " << i
+                                    << ": " << strerror(errno);
+              releaseBuffers();
+              return false;
+            }
+
+            uint32_t handles[4] = {entry.handle, nv12 ? entry.handle : 0u, 0, 0};
+            uint32_t pitches[4] = {pitch, nv12 ? pitch : 0u, 0, 0};
+            uint32_t offsets[4] = {0, nv12 ? pitch * bufferLines : 0u, 0, 0};
+            if (drmModeAddFB2(drmFd_, operation.width, operation.height, operation.drmFormat,
+                              handles, pitches, offsets, &entry.fbId, 0) != 0)
+            {
+              OPENAUTO_LOG(warning) << "[RgaTransform] Cannot scan out output buffer " << i
+                                    << ": " << strerror(errno);
+              entry.fbId = 0;
+              releaseBuffers();
+              return false;
+            }
+          }
+
+          int type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+          const bool outputOn = xioctl(videoFd_, VIDIOC_STREAMON, &type) == 0;
+          type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+          streaming_ = outputOn;
+          if (!outputOn || xioctl(videoFd_, VIDIOC_STREAMON, &type) < 0)
+          {
+            OPENAUTO_LOG(warning) << "[RgaTransform] Cannot start " << deviceName_ << ": "
+                                  << strerror(errno);
+            releaseBuffers();
+            return false;
+          }
+
+          configured_ = source;
+          operation_ = operation;
+          OPENAUTO_LOG(info) << "[RgaTransform] " << operation.cropWidth << "x"
+                             << operation.cropHeight << " -> " << operation.width << "x"
+                             << operation.height << (nv12 ? " NV12" : " XRGB8888")
+                             << ", rotated " << operation.rotation
+                             << (operation.mirrored ? ", mirrored" : "") << ", "
+                             << captures_.size() << " buffers";
+          return true;
+        }
+
+        uint32_t RgaTransform::transform(const Source &source, const Operation &operation)
+        {
+          if (videoFd_ < 0 || !configure(source, resolve(source, operation)))
+          {
+            return 0;
+          }
+
+          v4l2_buffer capture = {};
+          capture.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+          capture.memory = V4L2_MEMORY_MMAP;
+          capture.index = static_cast<uint32_t>(next_);
+
+          v4l2_buffer frame = {};
+          frame.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+          frame.memory = V4L2_MEMORY_DMABUF;
+          frame.index = 0;
+          frame.m.fd = source.fd;
+          frame.length = static_cast<uint32_t>(source.size);
+          frame.bytesused = outputBytes_;
+
+          if (xioctl(videoFd_, VIDIOC_QBUF, &capture) < 0 ||
+              xioctl(videoFd_, VIDIOC_QBUF, &frame) < 0)
+          {
+            OPENAUTO_LOG(warning) << "[RgaTransform] Cannot queue the blit: " << strerror(errno);
+            releaseBuffers();
+            return 0;
+          }
+
+          pollfd pfd = {};
+          pfd.fd = videoFd_;
+          pfd.events = POLLIN;
+          if (poll(&pfd, 1, cTimeoutMs) <= 0)
+          {
+            // Both queues are flushed by the restart
+            OPENAUTO_LOG(warning) << "[RgaTransform] Blit timed out";
+            releaseBuffers();
+            return 0;
+          }
+
+          v4l2_buffer done = {};
+          done.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+          done.memory = V4L2_MEMORY_MMAP;
+          const bool captured = xioctl(videoFd_, VIDIOC_DQBUF, &done) == 0;
+          const bool failed = !captured || (done.flags & V4L2_BUF_FLAG_ERROR);
+          v4l2_buffer consumed = {};
+          consumed.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+          consumed.memory = V4L2_MEMORY_DMABUF;
+          xioctl(videoFd_, VIDIOC_DQBUF, &consumed);
+
+          if (failed || done.index >= captures_.size())
+          {
+            OPENAUTO_LOG(warning) << "[RgaTransform] Blit failed";
+            return 0;
+          }
+
+          next_ = (next_ + 1) % captures_.size();
+          return captures_[done.index].fbId;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
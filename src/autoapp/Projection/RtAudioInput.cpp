@@ -1,8 +1,13 @@
 #include <algorithm>
 #include <cstring>
+#include <thread>
+#include <sys/eventfd.h>
+#include <unistd.h>
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
 #include <f1x/openauto/autoapp/Projection/AudioDeviceList.hpp>
 #include <f1x/openauto/autoapp/Projection/RtAudioInput.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
 
 namespace f1x
 {
@@ -13,16 +18,76 @@ namespace f1x
       namespace projection
       {
 
-        RtAudioInput::RtAudioInput(uint32_t channelCount, uint32_t sampleSize,
+        namespace
+        {
+          MetricCounter &overflowCounter()
+          {
+            static MetricCounter &counter = Metrics::instance().counter(
+                "openauto_audio_input_overflows_total", "Capture callbacks reporting an ALSA overflow");
+            return counter;
+          }
+        }
+
+        RtAudioInput::RtAudioInput(boost::asio::io_service &ioService,
+                                   uint32_t channelCount, uint32_t sampleSize,
                                    uint32_t sampleRate,
                                    configuration::IConfiguration::Pointer configuration)
             : channelCount_(channelCount), sampleSize_(sampleSize),
               sampleRate_(sampleRate), configuration_(std::move(configuration)),
-              isActive_(false), isStopping_(false) {}
+              buffer_(MemoryFootprint::instance().bufferBytes(
+                  static_cast<uint64_t>(sampleRate) * channelCount * sampleSize / 8, cRingMs,
+                  cLowMemoryRingMs)),
+              memory_(MemoryPool::Audio, buffer_.memoryBytes()), isActive_(false), isStopping_(false),
+              wakeupFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), wakeup_(ioService),
+              wakeupCount_(0)
+        {
+          // Registered here: the first lookup allocates, which the RT callback must not
+          overflowCounter();
+
+          if (wakeupFd_ < 0)
+          {
+            OPENAUTO_LOG(error) << "[RtAudioInput] eventfd failed, microphone disabled";
+          }
+          else
+          {
+            // The descriptor owns the fd from here on and closes it
+            wakeup_.assign(wakeupFd_);
+          }
+
+          freeChunks_.reserve(cChunkPoolSize);
+          for (size_t i = 0; i < cChunkPoolSize; i++)
+          {
+            aasdk::common::Data chunk;
+            chunk.reserve(cChunkSize);
+            freeChunks_.push_back(std::move(chunk));
+          }
+        }
 
-        RtAudioInput::~RtAudioInput() { stop(); }
+        RtAudioInput::~RtAudioInput() { this->stopCapture(false); }
 
         bool RtAudioInput::open()
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (preRoll_.empty() || deviceRunning_)
+          {
+            return rtAudio_ || this->createRtAudio();
+          }
+
+          // Capture from now until close(), so a mic request opens no device
+          isStopping_ = false;
+          prerolling_ = true;
+          deviceRunning_ = this->startDevice();
+          if (!deviceRunning_)
+          {
+            prerolling_ = false;
+            OPENAUTO_LOG(warning) << "[RtAudioInput] Pre-roll capture failed to start";
+            return false;
+          }
+          OPENAUTO_LOG(info) << "[RtAudioInput] Capturing " << preRoll_.size() << " bytes of pre-roll";
+          return true;
+        }
+
+        bool RtAudioInput::createRtAudio()
         {
           try
           {
@@ -57,76 +122,205 @@ namespace f1x
           }
 
           // Check if we have enough data in the lock-free buffer
-          if (buffer_.available() >= cChunkSize)
+          if (this->source().available() >= cChunkSize)
           {
             // We have enough data, fulfill immediately
-            aasdk::common::Data data(cChunkSize);
-            buffer_.read(data.data(), cChunkSize);
-            promise->resolve(std::move(data));
+            promise->resolve(this->takeChunk());
           }
           else
           {
-            // Wait for more data - store promise for later fulfillment
+            // Wait for more data - the producer wakes us through the
+            // eventfd once a chunk is queued
             readPromise_ = std::move(promise);
+            readWaiting_.store(true);
+
+            // A chunk completed between the check above and the flag
+            if (this->source().available() >= cChunkSize && readWaiting_.exchange(false))
+            {
+              this->fulfillPendingRead();
+            }
           }
         }
 
-        void RtAudioInput::start(StartPromise::Pointer promise)
+        void RtAudioInput::fulfillPendingRead()
+        {
+          if (readPromise_ && this->source().available() >= cChunkSize)
+          {
+            readPromise_->resolve(this->takeChunk());
+            readPromise_.reset();
+          }
+        }
+
+        void RtAudioInput::armWakeup()
+        {
+          wakeup_.async_read_some(
+              boost::asio::buffer(&wakeupCount_, sizeof(wakeupCount_)),
+              [this](const boost::system::error_code &error, size_t) {
+                // Cancelled by stop() or the destructor; this may be gone
+                if (error == boost::asio::error::operation_aborted)
+                {
+                  return;
+                }
+
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!isActive_ || error)
+                {
+                  return;
+                }
+                this->fulfillPendingRead();
+                this->armWakeup();
+              });
+        }
+
+        void RtAudioInput::recycle(aasdk::common::Data data)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (freeChunks_.size() < cChunkPoolSize && data.capacity() >= cChunkSize)
+          {
+            data.clear();
+            freeChunks_.push_back(std::move(data));
+          }
+        }
+
+        void RtAudioInput::setPreRoll(uint32_t ms)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (deviceRunning_)
+          {
+            OPENAUTO_LOG(warning) << "[RtAudioInput] Pre-roll can only be set while stopped";
+            return;
+          }
+          const size_t frameBytes = channelCount_ * 2;
+          preRoll_.assign(static_cast<size_t>(sampleRate_) * ms / 1000 * frameBytes, 0);
+          preRollMemory_ = preRoll_.empty() ? nullptr
+                                            : std::make_unique<MemoryCharge>(MemoryPool::Audio, preRoll_.size());
+          preRollWrite_ = 0;
+          preRollFill_ = 0;
+        }
+
+        void RtAudioInput::setVoiceProcessing(VoiceProcessingStage::Pointer stage)
         {
           std::lock_guard<std::mutex> lock(mutex_);
           if (isActive_)
           {
-            promise->resolve();
+            OPENAUTO_LOG(warning) << "[RtAudioInput] Voice processing can only be set while stopped";
             return;
           }
+          voiceProcessing_ = std::move(stage);
+        }
 
-          if (!rtAudio_)
+        VoiceProcessingStage::Ring &RtAudioInput::source()
+        {
+          return voiceProcessing_ ? voiceProcessing_->output() : buffer_;
+        }
+
+        void RtAudioInput::signalChunk()
+        {
+          if (this->source().available() >= cChunkSize && readWaiting_.load() &&
+              readWaiting_.exchange(false))
           {
-            if (!open())
+            const uint64_t one = 1;
+            if (::write(wakeupFd_, &one, sizeof(one)) < 0)
             {
-              promise->reject();
-              return;
+              readWaiting_.store(true);
             }
           }
+        }
 
-          std::string deviceName = configuration_->getAudioInputDeviceName();
-          unsigned int deviceId = 0;
-          bool deviceFound = false;
-
-          if (deviceName.empty())
+        aasdk::common::Data RtAudioInput::takeChunk()
+        {
+          auto &source = this->source();
+          // Built straight from ring memory (at most two spans around the
+          // wrap point) into a pooled chunk when the send path handed one back
+          aasdk::common::Data data;
+          if (!freeChunks_.empty())
           {
-            deviceId = rtAudio_->getDefaultInputDevice();
-            deviceFound = true;
+            data = std::move(freeChunks_.back());
+            freeChunks_.pop_back();
           }
-          else
+          data.reserve(cChunkSize);
+          while (data.size() < cChunkSize)
           {
-            AudioDeviceList deviceList;
-            auto devices = deviceList.getInputDevices();
-            for (const auto &device : devices)
+            const auto span = source.peekContiguous();
+            const size_t size = std::min(span.size, cChunkSize - data.size());
+            if (size == 0)
             {
-              if (device.name == deviceName)
-              {
-                deviceId = device.id;
-                deviceFound = true;
-                break;
-              }
+              break;
             }
-            if (!deviceFound)
+            data.insert(data.end(), span.data, span.data + size);
+            source.commitRead(size);
+          }
+          return data;
+        }
+
+        void RtAudioInput::start(StartPromise::Pointer promise)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (isActive_)
+          {
+            promise->resolve();
+            return;
+          }
+
+          isStopping_ = false;
+          // The stage thread calls back into signalChunk(), which only
+          // touches atomics and the eventfd
+          if (voiceProcessing_ && !voiceProcessing_->start([this]() { this->signalChunk(); }))
+          {
+            OPENAUTO_LOG(warning) << "[RtAudioInput] Voice processing failed to start, "
+                                     "capturing unprocessed";
+            voiceProcessing_.reset();
+          }
+
+          isActive_ = true;
+          if (deviceRunning_)
+          {
+            // Pre-rolling: the next callback delivers the ring, then goes live
+            preRollPending_ = true;
+            prerolling_ = false;
+          }
+          else if (!(deviceRunning_ = this->startDevice()))
+          {
+            isActive_ = false;
+            if (voiceProcessing_)
             {
-              OPENAUTO_LOG(warning) << "[RtAudioInput] Configured device '"
-                                    << deviceName << "' not found. Using default.";
-              deviceId = rtAudio_->getDefaultInputDevice();
+              voiceProcessing_->stop();
             }
+            promise->reject();
+            return;
+          }
+
+          if (wakeup_.is_open())
+          {
+            this->armWakeup();
+          }
+          promise->resolve();
+        }
+
+        bool RtAudioInput::startDevice()
+        {
+          if (!rtAudio_ && !this->createRtAudio())
+          {
+            return false;
           }
 
+          // Answered from the device registry, not by probing every card again
+          const unsigned int deviceId =
+              AudioDeviceList::findInputDeviceByName(configuration_->getAudioInputDeviceName());
+
           RtAudio::StreamParameters parameters;
           parameters.deviceId = deviceId;
           parameters.nChannels = channelCount_;
           parameters.firstChannel = 0;
 
           unsigned int bufferFrames = 512; // Adjust as needed
+          const auto &placement = ThreadTopology::instance().placement(ThreadRole::AudioInput);
           RtAudio::StreamOptions options;
-          options.flags = RTAUDIO_SCHEDULE_REALTIME;
+          if (placement.fifoPriority > 0)
+          {
+            options.flags = RTAUDIO_SCHEDULE_REALTIME;
+            options.priority = placement.fifoPriority;
+          }
 
           try
           {
@@ -134,46 +328,87 @@ namespace f1x
                                  &bufferFrames, &RtAudioInput::rtAudioCallback, this,
                                  &options);
             rtAudio_->startStream();
-            isActive_ = true;
-            isStopping_ = false;
             OPENAUTO_LOG(info) << "[RtAudioInput] Started stream on device ID "
                                << deviceId;
-            promise->resolve();
+            return true;
           }
           catch (RtAudioError &error)
           {
             OPENAUTO_LOG(error) << "[RtAudioInput] Failed to start stream: "
                                 << error.getMessage();
-            promise->reject();
+            return false;
           }
         }
 
-        void RtAudioInput::stop()
+        void RtAudioInput::stopDevice()
+        {
+          if (!rtAudio_)
+          {
+            return;
+          }
+          try
+          {
+            if (rtAudio_->isStreamRunning())
+            {
+              rtAudio_->stopStream();
+            }
+            if (rtAudio_->isStreamOpen())
+            {
+              rtAudio_->closeStream();
+            }
+          }
+          catch (RtAudioError &error)
+          {
+            OPENAUTO_LOG(error) << "[RtAudioInput] Error stopping stream: "
+                                << error.getMessage();
+          }
+        }
+
+        void RtAudioInput::stop() { this->stopCapture(!preRoll_.empty()); }
+
+        void RtAudioInput::close() { this->stopCapture(false); }
+
+        void RtAudioInput::stopCapture(bool keepDevice)
         {
           std::lock_guard<std::mutex> lock(mutex_);
-          isStopping_ = true;
-          if (isActive_ && rtAudio_)
+          if (keepDevice && deviceRunning_)
           {
-            try
+            // Back to the pre-roll; once the callback in flight is done
+            // nothing but the RT thread touches buffer_ or the stage
+            prerolling_ = true;
+            while (capturing_)
             {
-              if (rtAudio_->isStreamRunning())
-              {
-                rtAudio_->stopStream();
-              }
-              if (rtAudio_->isStreamOpen())
-              {
-                rtAudio_->closeStream();
-              }
+              std::this_thread::yield();
             }
-            catch (RtAudioError &error)
+          }
+          else
+          {
+            isStopping_ = true;
+            if (deviceRunning_)
             {
-              OPENAUTO_LOG(error) << "[RtAudioInput] Error stopping stream: "
-                                  << error.getMessage();
+              this->stopDevice();
             }
+            deviceRunning_ = false;
+            prerolling_ = false;
+          }
+          preRollPending_ = false;
+          // Stream closed: nothing feeds the stage any more
+          if (voiceProcessing_)
+          {
+            voiceProcessing_->stop();
           }
           isActive_ = false;
           buffer_.clear();
-          dataAvailable_.store(false, std::memory_order_relaxed);
+          readWaiting_.store(false);
+          boost::system::error_code error;
+          wakeup_.cancel(error);
+
+          const uint32_t overflows = overflows_.exchange(0);
+          if (overflows > 0)
+          {
+            OPENAUTO_LOG(warning) << "[RtAudioInput] " << overflows
+                                  << " capture overflows since start";
+          }
 
           if (readPromise_)
           {
@@ -193,38 +428,93 @@ namespace f1x
                                           RtAudioStreamStatus status, void *userData)
         {
           RtAudioInput *audioInput = static_cast<RtAudioInput *>(userData);
-          if (!audioInput || audioInput->isStopping_)
-            return 0;
 
-          if (status)
+          // First callback on a new RtAudio thread: name and pin it once
+          thread_local bool placed = false;
+          if (!placed)
+          {
+            placed = true;
+            ThreadTopology::instance().apply(ThreadRole::AudioInput, "oa-audio-in");
+          }
+          if (audioInput)
+          {
+            audioInput->capture(inputBuffer, nBufferFrames, status != 0);
+          }
+          return 0;
+        }
+
+        void RtAudioInput::capture(const void *input, unsigned int frames, bool overflowed)
+        {
+          if (isStopping_)
+          {
+            return;
+          }
+
+          // Counted here, logged by stop(): no logging or locks on the RT thread
+          if (overflowed)
           {
-            OPENAUTO_LOG(warning)
-                << "[RtAudioInput] Stream overflow/underflow detected.";
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            overflowCounter().add();
           }
 
           // Calculate total bytes (RTAUDIO_SINT16 = 2 bytes per sample)
-          size_t bytes = nBufferFrames * audioInput->channelCount_ * 2;
-          uint8_t *srcBytes = static_cast<uint8_t *>(inputBuffer);
+          const size_t bytes = frames * channelCount_ * 2;
 
+          capturing_ = true;
+          if (prerolling_)
+          {
+            this->keepPreRoll(static_cast<const uint8_t *>(input), bytes);
+            capturing_ = false;
+            return;
+          }
+          if (preRollPending_.exchange(false) && preRollFill_ > 0)
+          {
+            // Oldest first, in the two spans either side of the write point
+            const size_t begin = (preRollWrite_ + preRoll_.size() - preRollFill_) % preRoll_.size();
+            const size_t first = std::min(preRollFill_, preRoll_.size() - begin);
+            this->deliver(preRoll_.data() + begin, first);
+            this->deliver(preRoll_.data(), preRollFill_ - first);
+            preRollFill_ = 0;
+          }
+          this->deliver(input, bytes);
+          capturing_ = false;
+        }
+
+        void RtAudioInput::deliver(const void *data, size_t bytes)
+        {
+          if (bytes == 0)
+          {
+            return;
+          }
           // Write to lock-free ring buffer - NO MUTEX (RT-safe)
-          audioInput->buffer_.write(srcBytes, bytes);
+          if (voiceProcessing_)
+          {
+            // Processed on the stage thread, which signals the read itself
+            voiceProcessing_->input().write(data, bytes);
+            voiceProcessing_->notify();
+            return;
+          }
+          buffer_.write(data, bytes);
 
-          // Signal that data is available
-          audioInput->dataAvailable_.store(true, std::memory_order_release);
+          // Hand a completed chunk to the io thread, which resolves the read
+          this->signalChunk();
+        }
 
-          // Try to fulfill pending promise without blocking
-          // Use try_lock to avoid blocking the RT thread
-          std::unique_lock<std::mutex> lock(audioInput->mutex_, std::try_to_lock);
-          if (lock.owns_lock() && audioInput->readPromise_ &&
-              audioInput->buffer_.available() >= cChunkSize)
+        void RtAudioInput::keepPreRoll(const uint8_t *data, size_t bytes)
+        {
+          const size_t size = preRoll_.size();
+          if (bytes >= size)
           {
-            aasdk::common::Data data(cChunkSize);
-            audioInput->buffer_.read(data.data(), cChunkSize);
-            audioInput->readPromise_->resolve(std::move(data));
-            audioInput->readPromise_.reset();
+            memcpy(preRoll_.data(), data + bytes - size, size);
+            preRollWrite_ = 0;
+            preRollFill_ = size;
+            return;
           }
-
-          return 0;
+          const size_t first = std::min(bytes, size - preRollWrite_);
+          memcpy(preRoll_.data() + preRollWrite_, data, first);
+          memcpy(preRoll_.data(), data + first, bytes - first);
+          preRollWrite_ = (preRollWrite_ + bytes) % size;
+          preRollFill_ = std::min(size, preRollFill_ + bytes);
         }
 
       } // namespace projection
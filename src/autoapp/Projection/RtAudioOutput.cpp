@@ -16,9 +16,17 @@
 *  along with openauto. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <chrono>
 #include <cstring> // for memset
+#include <map>
+#include <thread>
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/PipelineTrace.hpp>
 #include <f1x/openauto/autoapp/Projection/RtAudioOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
 
 #if defined(RTAUDIO_VERSION_MAJOR) && (RTAUDIO_VERSION_MAJOR >= 6)
 #define OA_RTAUDIO_V6 1
@@ -33,10 +41,63 @@ namespace f1x
       namespace projection
       {
 
+        namespace
+        {
+          struct OutputMetrics
+          {
+            MetricCounter &xruns = Metrics::instance().counter(
+                "openauto_audio_output_xruns_total", "ALSA output underflows reported to the callback");
+            MetricCounter &periodGrows = Metrics::instance().counter(
+                "openauto_audio_output_period_grows_total", "Streams reopened with a larger period after underruns");
+            MetricCounter &jitterUnderruns = Metrics::instance().counter(
+                "openauto_audio_jitter_underruns_total", "Jitter buffer reads that found too little audio");
+            MetricCounter &jitterOverruns = Metrics::instance().counter(
+                "openauto_audio_jitter_overruns_total", "Jitter buffer writes that found no room");
+            MetricCounter &deviceSwitches = Metrics::instance().counter(
+                "openauto_audio_output_device_switches_total", "Open streams moved to another device");
+          };
+
+          OutputMetrics &metrics()
+          {
+            static OutputMetrics instance;
+            return instance;
+          }
+
+          // Every output in the process, for switchAllDevices()
+          std::mutex outputsMutex;
+          std::vector<RtAudioOutput *> outputs;
+
+          // How long the old stream gets to hand over before it is stopped
+          constexpr auto cHandoffTimeout = std::chrono::milliseconds(250);
+        }
+
         RtAudioOutput::RtAudioOutput(uint32_t channelCount, uint32_t sampleSize,
-                                     uint32_t sampleRate, uint32_t deviceId)
+                                     uint32_t sampleRate, uint32_t deviceId,
+                                     bool lowLatency, uint32_t jitterBufferMs)
             : channelCount_(channelCount), sampleSize_(sampleSize),
-              sampleRate_(sampleRate), deviceId_(deviceId)
+              sampleRate_(sampleRate), deviceId_(deviceId), lowLatency_(lowLatency),
+              periodFrames_(0), xrunsHandled_(0),
+              audioBuffer_(channelCount * (sampleSize / 8), sampleRate, jitterBufferMs),
+              keepRunning_(false), keepOpen_(false)
+        {
+          // Registered here: the first lookup allocates, which the RT callback must not
+          metrics();
+
+          dac_ = createDac();
+          context_ = std::make_unique<StreamContext>(StreamContext{this, dac_.get()});
+          activeDac_ = dac_.get();
+
+          std::lock_guard<std::mutex> lock(outputsMutex);
+          outputs.push_back(this);
+        }
+
+        RtAudioOutput::~RtAudioOutput()
+        {
+          std::lock_guard<std::mutex> lock(outputsMutex);
+          outputs.erase(std::remove(outputs.begin(), outputs.end(), this), outputs.end());
+        }
+
+        std::unique_ptr<RtAudio> RtAudioOutput::createDac()
         {
           std::vector<RtAudio::Api> apis;
           RtAudio::getCompiledApi(apis);
@@ -46,26 +107,83 @@ namespace f1x
           if (std::find(apis.begin(), apis.end(), RtAudio::LINUX_ALSA) != apis.end())
           {
             OPENAUTO_LOG(info) << "[RtAudioOutput] Using ALSA backend";
-            dac_ = std::make_unique<RtAudio>(RtAudio::LINUX_ALSA);
+            return std::make_unique<RtAudio>(RtAudio::LINUX_ALSA);
           }
           else if (std::find(apis.begin(), apis.end(), RtAudio::LINUX_PULSE) !=
                    apis.end())
           {
             OPENAUTO_LOG(info) << "[RtAudioOutput] Using PulseAudio backend";
-            dac_ = std::make_unique<RtAudio>(RtAudio::LINUX_PULSE);
-          }
-          else
-          {
-            OPENAUTO_LOG(info) << "[RtAudioOutput] Using default audio backend";
-            dac_ = std::make_unique<RtAudio>();
+            return std::make_unique<RtAudio>(RtAudio::LINUX_PULSE);
           }
+          OPENAUTO_LOG(info) << "[RtAudioOutput] Using default audio backend";
+          return std::make_unique<RtAudio>();
+        }
+
+        namespace
+        {
+          // Low-latency mode starts around 10-16 ms per period with two
+          // periods queued, and doubles the period on underruns
+          constexpr uint32_t cLowLatencyBuffers = 2;
+          constexpr uint32_t cFallbackBuffers = 4; // More buffers = less underruns on RK3229
+          constexpr uint32_t cXrunsBeforeGrow = 2;
+
+          // Period a device ended up needing, per sample rate, so the next
+          // phone connection does not have to rediscover it through xruns
+          std::mutex learnedPeriodMutex;
+          std::map<uint32_t, uint32_t> learnedPeriodFrames;
         }
 
         bool RtAudioOutput::open()
         {
           std::lock_guard<decltype(mutex_)> lock(mutex_);
+          isStopping_.store(false, std::memory_order_release);
+          gateOpen_.store(!keepRunning_, std::memory_order_release);
 
-          if (dac_->getDeviceCount() <= 0)
+          // Kept open since the last session: period and device as they were
+          if (keepOpen_ && dac_->isStreamOpen())
+          {
+            OPENAUTO_LOG(info) << "[RtAudioOutput] Reusing open " << sampleRate_ << " Hz stream";
+            if (keepRunning_)
+            {
+              this->doStart(*dac_);
+            }
+            return true;
+          }
+
+          uint32_t bufferFrames = fallbackPeriodFrames();
+          if (lowLatency_)
+          {
+            bufferFrames = sampleRate_ == 16000 ? 256 : 512;
+            std::lock_guard<std::mutex> learnedLock(learnedPeriodMutex);
+            auto learned = learnedPeriodFrames.find(sampleRate_);
+            if (learned != learnedPeriodFrames.end())
+            {
+              bufferFrames = learned->second;
+            }
+          }
+          if (!this->openStream(bufferFrames,
+                                bufferFrames >= fallbackPeriodFrames() ? cFallbackBuffers
+                                                                       : cLowLatencyBuffers))
+          {
+            return false;
+          }
+
+          if (keepRunning_)
+          {
+            this->doStart(*dac_);
+          }
+          return true;
+        }
+
+        bool RtAudioOutput::openStream(uint32_t bufferFrames, uint32_t numberOfBuffers)
+        {
+          return this->openStream(*dac_, *context_, deviceId_, bufferFrames, numberOfBuffers);
+        }
+
+        bool RtAudioOutput::openStream(RtAudio &dac, StreamContext &context, uint32_t deviceId,
+                                       uint32_t bufferFrames, uint32_t numberOfBuffers)
+        {
+          if (dac.getDeviceCount() <= 0)
           {
             OPENAUTO_LOG(error) << "[RtAudioOutput] No output devices found.";
             return false;
@@ -73,47 +191,55 @@ namespace f1x
 
           RtAudio::StreamParameters parameters;
           // Use specified device ID, fall back to default if 0 or invalid
+#ifdef OA_RTAUDIO_V6
+          // RtAudio 6 IDs are stable handles rather than indices
+          const auto deviceIds = dac.getDeviceIds();
+          const bool knownDevice = std::find(deviceIds.begin(), deviceIds.end(), deviceId) != deviceIds.end();
+#else
+          const bool knownDevice = deviceId < dac.getDeviceCount();
+#endif
           uint32_t selectedDevice =
-              (deviceId_ != 0 && deviceId_ < dac_->getDeviceCount())
-                  ? deviceId_
-                  : dac_->getDefaultOutputDevice();
+              (deviceId != 0 && knownDevice)
+                  ? deviceId
+                  : dac.getDefaultOutputDevice();
           parameters.deviceId = selectedDevice;
           parameters.nChannels = channelCount_;
           parameters.firstChannel = 0;
 
           OPENAUTO_LOG(info) << "[RtAudioOutput] Using device ID: " << selectedDevice;
 
+          // RtAudio owns the callback thread: it applies the priority, the
+          // callback itself the affinity
+          const auto &placement = ThreadTopology::instance().placement(ThreadRole::AudioOutput);
           RtAudio::StreamOptions streamOptions;
-          streamOptions.flags = RTAUDIO_SCHEDULE_REALTIME; // Try RT scheduling, fallback is fine
-          streamOptions.numberOfBuffers = 4;               // More buffers = less underruns on RK3229
-
-          // Larger buffers to prevent crackling on embedded systems
-          // Trade-off: slightly higher latency but no audio glitches
-          uint32_t bufferFrames =
-              sampleRate_ == 16000 ? 2048
-                                   : 4096;
+          if (placement.fifoPriority > 0)
+          {
+            streamOptions.flags = RTAUDIO_SCHEDULE_REALTIME; // Try RT scheduling, fallback is fine
+            streamOptions.priority = placement.fifoPriority;
+          }
+          streamOptions.numberOfBuffers = numberOfBuffers;
 
 #if defined(OA_RTAUDIO_V6)
           // RtAudio 6+: methods return RtAudioErrorType instead of throwing.
-          RtAudioErrorType err = dac_->openStream(
+          RtAudioErrorType err = dac.openStream(
               &parameters, /*input*/ nullptr, RTAUDIO_SINT16, sampleRate_,
               &bufferFrames, &RtAudioOutput::audioBufferReadHandler,
-              static_cast<void *>(this), &streamOptions);
+              static_cast<void *>(&context), &streamOptions);
 
           if (err != RTAUDIO_NO_ERROR)
           {
             OPENAUTO_LOG(error) << "[RtAudioOutput] openStream failed, code="
                                 << static_cast<int>(err)
-                                << " msg=" << dac_->getErrorText();
+                                << " msg=" << dac.getErrorText();
             return false;
           }
 #else
           try
           {
-            dac_->openStream(&parameters, /*input*/ nullptr, RTAUDIO_SINT16,
+            dac.openStream(&parameters, /*input*/ nullptr, RTAUDIO_SINT16,
                              sampleRate_, &bufferFrames,
                              &RtAudioOutput::audioBufferReadHandler,
-                             static_cast<void *>(this), &streamOptions);
+                             static_cast<void *>(&context), &streamOptions);
           }
           catch (const RtAudioError &e)
           {
@@ -124,10 +250,77 @@ namespace f1x
           }
 #endif
 
-          OPENAUTO_LOG(info) << "[RtAudioOutput] Sample Rate: " << sampleRate_;
+          periodFrames_ = bufferFrames;
+          xrunsHandled_ = xruns_.load(std::memory_order_relaxed);
+
+          OPENAUTO_LOG(info) << "[RtAudioOutput] Sample Rate: " << sampleRate_
+                             << ", period: " << periodFrames_ << " frames x "
+                             << numberOfBuffers;
           return true; // Lock-free buffer is always ready
         }
 
+        void RtAudioOutput::closeStream(RtAudio &dac)
+        {
+          try
+          {
+            if (dac.isStreamOpen())
+            {
+              dac.closeStream();
+            }
+          }
+          catch (...)
+          {
+            OPENAUTO_LOG(warning)
+                << "[RtAudioOutput] Exception during closeStream";
+          }
+        }
+
+        uint32_t RtAudioOutput::fallbackPeriodFrames() const
+        {
+          // Large periods prevent crackling on embedded systems at the cost
+          // of latency; this is where low-latency mode gives up growing
+          return sampleRate_ == 16000 ? 2048 : 4096;
+        }
+
+        void RtAudioOutput::growPeriod()
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+
+          if (isStopping_.load(std::memory_order_acquire) || !dac_->isStreamOpen())
+          {
+            return;
+          }
+
+          const uint32_t bufferFrames = std::min(periodFrames_ * 2, fallbackPeriodFrames());
+          OPENAUTO_LOG(warning) << "[RtAudioOutput] " << (xruns_.load() - xrunsHandled_)
+                                << " underruns at " << periodFrames_ << " frames, reopening with "
+                                << bufferFrames;
+
+          metrics().periodGrows.add();
+
+          const bool wasRunning = dac_->isStreamRunning();
+          this->doSuspend(*dac_);
+          this->closeStream(*dac_);
+
+          if (!this->openStream(bufferFrames,
+                                bufferFrames >= fallbackPeriodFrames() ? cFallbackBuffers
+                                                                       : cLowLatencyBuffers) &&
+              !this->openStream(fallbackPeriodFrames(), cFallbackBuffers))
+          {
+            return;
+          }
+
+          {
+            std::lock_guard<std::mutex> learnedLock(learnedPeriodMutex);
+            learnedPeriodFrames[sampleRate_] = periodFrames_;
+          }
+
+          if (wasRunning)
+          {
+            this->doStart(*dac_);
+          }
+        }
+
         void RtAudioOutput::write(aasdk::messenger::Timestamp::ValueType timestamp,
                                   const aasdk::common::DataConstBuffer &buffer)
         {
@@ -138,29 +331,85 @@ namespace f1x
             return;
           }
 
-          // Write to lock-free ring buffer - no mutex needed
+          // Lock-free jitter buffer - no mutex needed
           // Producer: main thread, Consumer: RT audio callback
-          audioBuffer_.write(buffer.cdata, buffer.size);
+          audioBuffer_.push(timestamp, buffer.cdata, buffer.size);
+          this->adaptPeriod();
+        }
+
+        void RtAudioOutput::adaptPeriod()
+        {
+          // Reopening drops nothing already queued in the ring, so it is done
+          // on the producer side rather than in the RT callback that saw the
+          // underruns
+          if (lowLatency_ && periodFrames_ < fallbackPeriodFrames() &&
+              xruns_.load(std::memory_order_relaxed) - xrunsHandled_ >= cXrunsBeforeGrow)
+          {
+            this->growPeriod();
+          }
+        }
+
+        void RtAudioOutput::render(void *output, unsigned int frames)
+        {
+          // Paired with the store in setMediaDsp(): either it sees this pass
+          // under way or this pass sees the new stage
+          renderPasses_.fetch_add(1);
+
+          // Fills the whole period, with silence while prebuffering - NO MUTEX (RT-safe)
+          if (gateOpen_.load(std::memory_order_acquire))
+          {
+            audioBuffer_.pull(output, frames);
+          }
+          else
+          {
+            audioBuffer_.drain(output, frames);
+          }
+          MediaDsp *mediaDsp = mediaDsp_.load();
+          if (mediaDsp && mediaDsp->prepare())
+          {
+            mediaDsp->process(static_cast<int16_t *>(output), frames);
+          }
+
+          renderPasses_.fetch_add(1);
+        }
+
+        void RtAudioOutput::waitForRender() const
+        {
+          // Only the pass under way: a callback straight after it sees the
+          // new stage already
+          const uint32_t pass = renderPasses_.load();
+          while ((pass & 1) != 0 && renderPasses_.load() == pass)
+          {
+            std::this_thread::yield();
+          }
         }
 
         void RtAudioOutput::start()
         {
           std::lock_guard<decltype(mutex_)> lock(mutex_);
+          // Called on the channel strand, like write()
+          audioBuffer_.restartTimeline();
+          gateOpen_.store(true, std::memory_order_release);
+          // A no-op for a stream kept running
+          this->doStart(*dac_);
+        }
 
-          if (dac_->isStreamOpen() && !dac_->isStreamRunning())
+        void RtAudioOutput::doStart(RtAudio &dac)
+        {
+          if (dac.isStreamOpen() && !dac.isStreamRunning())
           {
 #if defined(OA_RTAUDIO_V6)
-            RtAudioErrorType err = dac_->startStream();
+            RtAudioErrorType err = dac.startStream();
             if (err != RTAUDIO_NO_ERROR)
             {
               OPENAUTO_LOG(error) << "[RtAudioOutput] startStream failed, code="
                                   << static_cast<int>(err)
-                                  << " msg=" << dac_->getErrorText();
+                                  << " msg=" << dac.getErrorText();
             }
 #else
             try
             {
-              dac_->startStream();
+              dac.startStream();
             }
             catch (const RtAudioError &e)
             {
@@ -180,7 +429,7 @@ namespace f1x
 
           try
           {
-            this->doSuspend();
+            this->doSuspend(*dac_);
           }
           catch (...)
           {
@@ -188,26 +437,30 @@ namespace f1x
                 << "[RtAudioOutput] Exception during suspend in stop()";
           }
 
-          try
+          if (!keepOpen_)
           {
-            if (dac_ && dac_->isStreamOpen())
-            {
-              dac_->closeStream();
-            }
-          }
-          catch (...)
-          {
-            OPENAUTO_LOG(warning)
-                << "[RtAudioOutput] Exception during closeStream in stop()";
+            this->closeStream(*dac_);
           }
 
+          const auto stats = audioBuffer_.stats();
+          OPENAUTO_LOG(info) << "[RtAudioOutput] Jitter buffer (" << sampleRate_
+                             << " Hz): underruns " << stats.underruns << ", overruns "
+                             << stats.overruns << ", gaps " << stats.gaps << ", drift -"
+                             << stats.droppedFrames << "/+" << stats.insertedFrames << " frames";
+          metrics().jitterUnderruns.add(stats.underruns);
+          metrics().jitterOverruns.add(stats.overruns);
+
           // Clear the audio buffer to prevent stale data on restart
           audioBuffer_.clear();
         }
 
         void RtAudioOutput::suspend()
         {
-          // not needed
+          // Otherwise the stream keeps running and plays out what is queued
+          if (keepRunning_)
+          {
+            gateOpen_.store(false, std::memory_order_release);
+          }
         }
 
         uint32_t RtAudioOutput::getSampleSize() const { return sampleSize_; }
@@ -216,22 +469,130 @@ namespace f1x
 
         uint32_t RtAudioOutput::getSampleRate() const { return sampleRate_; }
 
-        void RtAudioOutput::doSuspend()
+        AudioJitterStats RtAudioOutput::getJitterStats() const { return audioBuffer_.stats(); }
+
+        size_t RtAudioOutput::getQueuedFrames() const { return audioBuffer_.queuedFrames(); }
+
+        uint32_t RtAudioOutput::getDeviceId() const { return deviceId_; }
+
+        void RtAudioOutput::setKeepRunning(bool keepRunning)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          keepRunning_ = keepRunning;
+        }
+
+        void RtAudioOutput::setKeepOpen(bool keepOpen)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          keepOpen_ = keepOpen;
+        }
+
+        void RtAudioOutput::setMediaDsp(MediaDspPreset::Pointer preset)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          if (preset == mediaPreset_)
+          {
+            return;
+          }
+          if (channelCount_ != MediaDsp::cChannelCount || sampleSize_ != 16 ||
+              sampleRate_ != MediaDspPreset::cSampleRate)
+          {
+            OPENAUTO_LOG(warning) << "[RtAudioOutput] Media DSP needs 48 kHz stereo, not " << sampleRate_ << " Hz";
+            return;
+          }
+          mediaPreset_ = preset;
+          auto mediaStage = preset ? std::make_unique<MediaDsp>(std::move(preset)) : nullptr;
+          mediaDsp_.store(mediaStage.get());
+          // A running stream may still be inside the old stage
+          this->waitForRender();
+          mediaStage_ = std::move(mediaStage);
+        }
+
+        bool RtAudioOutput::switchDevice(uint32_t deviceId)
         {
-          if (dac_->isStreamOpen() && dac_->isStreamRunning())
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          if (deviceId == deviceId_)
+          {
+            return true;
+          }
+          if (isStopping_.load(std::memory_order_acquire) || !dac_->isStreamOpen())
+          {
+            // A stream kept open between sessions is stopped: nothing to hand over
+            this->closeStream(*dac_);
+            deviceId_ = deviceId;
+            return true;
+          }
+
+          // Same period as the stream it replaces, so latency stays as it was
+          auto dac = createDac();
+          auto context = std::make_unique<StreamContext>(StreamContext{this, dac.get()});
+          const uint32_t bufferFrames = periodFrames_;
+          if (!this->openStream(*dac, *context, deviceId, bufferFrames,
+                                bufferFrames >= fallbackPeriodFrames() ? cFallbackBuffers
+                                                                       : cLowLatencyBuffers))
+          {
+            OPENAUTO_LOG(error) << "[RtAudioOutput] Could not open device " << deviceId
+                                << ", staying on " << deviceId_;
+            return false;
+          }
+
+          if (dac_->isStreamRunning())
+          {
+            // Plays silence until the old stream hands over at its next period
+            this->doStart(*dac);
+            nextDac_.store(dac.get(), std::memory_order_release);
+            const auto deadline = std::chrono::steady_clock::now() + cHandoffTimeout;
+            while (activeDac_.load(std::memory_order_acquire) != dac.get() &&
+                   std::chrono::steady_clock::now() < deadline)
+            {
+              std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+          }
+
+          if (activeDac_.load(std::memory_order_acquire) != dac.get())
+          {
+            // Not running, or its device is gone: once stopped its callback
+            // cannot run again, so the new stream can take over directly
+            this->doSuspend(*dac_);
+            nextDac_.store(nullptr, std::memory_order_release);
+            activeDac_.store(dac.get(), std::memory_order_release);
+          }
+
+          this->closeStream(*dac_);
+          dac_ = std::move(dac);
+          context_ = std::move(context);
+          OPENAUTO_LOG(info) << "[RtAudioOutput] Switched " << sampleRate_ << " Hz output from device "
+                             << deviceId_ << " to " << deviceId;
+          deviceId_ = deviceId;
+          metrics().deviceSwitches.add();
+          return true;
+        }
+
+        void RtAudioOutput::switchAllDevices(uint32_t deviceId)
+        {
+          std::lock_guard<std::mutex> lock(outputsMutex);
+          for (auto *output : outputs)
+          {
+            output->switchDevice(deviceId);
+          }
+        }
+
+        void RtAudioOutput::doSuspend(RtAudio &dac)
+        {
+          if (dac.isStreamOpen() && dac.isStreamRunning())
           {
 #if defined(OA_RTAUDIO_V6)
-            RtAudioErrorType err = dac_->stopStream();
+            RtAudioErrorType err = dac.stopStream();
             if (err != RTAUDIO_NO_ERROR)
             {
               OPENAUTO_LOG(error) << "[RtAudioOutput] stopStream failed, code="
                                   << static_cast<int>(err)
-                                  << " msg=" << dac_->getErrorText();
+                                  << " msg=" << dac.getErrorText();
             }
 #else
             try
             {
-              dac_->stopStream();
+              dac.stopStream();
             }
             catch (const RtAudioError &e)
             {
@@ -249,7 +610,17 @@ namespace f1x
                                                   RtAudioStreamStatus status,
                                                   void *userData)
         {
-          RtAudioOutput *self = static_cast<RtAudioOutput *>(userData);
+          auto *context = static_cast<StreamContext *>(userData);
+          RtAudioOutput *self = context ? context->owner : nullptr;
+
+          // First callback on a new RtAudio thread: name and pin it once
+          thread_local bool placed = false;
+          if (!placed)
+          {
+            placed = true;
+            ThreadTopology::instance().apply(ThreadRole::AudioOutput, "oa-audio-out");
+          }
+          OPENAUTO_TRACE_SCOPE("audio.callback");
 
           // Check if we're stopping before doing anything
           if (!self || self->isStopping_.load(std::memory_order_acquire))
@@ -263,19 +634,35 @@ namespace f1x
             return 1; // Non-zero return tells RtAudio to stop the stream
           }
 
-          // Calculate buffer size needed
-          const auto bufferSize =
-              nBufferFrames * (self->sampleSize_ / 8) * self->channelCount_;
-
-          // Read from lock-free ring buffer - NO MUTEX (RT-safe)
-          size_t bytesRead = self->audioBuffer_.read(outputBuffer, bufferSize);
+          if (status & RTAUDIO_OUTPUT_UNDERFLOW)
+          {
+            self->xruns_.fetch_add(1, std::memory_order_relaxed);
+            metrics().xruns.add();
+            FlightRecorder::instance().record(FlightEvent::AudioXrun, self->channelCount_);
+          }
 
-          // Zero-fill any remaining bytes if underrun
-          if (bytesRead < bufferSize)
+          // During switchDevice() the stream draining the jitter buffer hands
+          // it over between two of its periods, so two streams never read it
+          // at once; the other one plays silence
+          RtAudio *active = self->activeDac_.load(std::memory_order_acquire);
+          if (context->dac == active)
           {
-            memset(static_cast<char *>(outputBuffer) + bytesRead, 0,
-                   bufferSize - bytesRead);
+            if (RtAudio *next = self->nextDac_.exchange(nullptr, std::memory_order_acq_rel))
+            {
+              self->activeDac_.store(next, std::memory_order_release);
+              active = next;
+            }
           }
+          if (context->dac != active)
+          {
+            if (outputBuffer)
+            {
+              memset(outputBuffer, 0, nBufferFrames * self->channelCount_ * sizeof(int16_t));
+            }
+            return 0;
+          }
+
+          self->render(outputBuffer, nBufferFrames);
 
           return 0;
         }
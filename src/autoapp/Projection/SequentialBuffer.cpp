@@ -16,7 +16,10 @@
 *  along with openauto. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
 #include <f1x/openauto/autoapp/Projection/SequentialBuffer.hpp>
+#include <f1x/openauto/Common/Log.hpp>
 
 namespace f1x
 {
@@ -28,10 +31,22 @@ namespace projection
 {
 
 SequentialBuffer::SequentialBuffer()
-    : data_(aasdk::common::cStaticDataSize)
+    : head_(0)
+    , tail_(0)
+    , queuedBytes_(0)
+    , readerWaiting_(true)
+    , readOffset_(0)
+    , dropped_(0)
+    , slotBytes_(0)
+    , trimSlots_(MemoryFootprint::instance().lowMemory())
 {
 }
 
+SequentialBuffer::~SequentialBuffer()
+{
+    MemoryFootprint::instance().release(MemoryPool::Video, slotBytes_);
+}
+
 bool SequentialBuffer::isSequential() const
 {
     return true;
@@ -39,33 +54,80 @@ bool SequentialBuffer::isSequential() const
 
 bool SequentialBuffer::open(OpenMode mode)
 {
-    std::lock_guard<decltype(mutex_)> lock(mutex_);
-
     return QIODevice::open(mode);
 }
 
 qint64 SequentialBuffer::readData(char *data, qint64 maxlen)
 {
-    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    qint64 read = 0;
+    size_t tail = tail_.load(std::memory_order_relaxed);
 
-    if(data_.empty())
+    while(read < maxlen)
     {
-        return 0;
+        if(tail == head_.load(std::memory_order_acquire))
+        {
+            // Ask for a readyRead, then look again: a chunk published in
+            // between would otherwise be signalled to nobody
+            readerWaiting_.store(true);
+            if(tail == head_.load())
+            {
+                break;
+            }
+            readerWaiting_.store(false);
+        }
+
+        const auto &chunk = chunks_[tail % cChunkSlots];
+        const auto len = std::min<size_t>(maxlen - read, chunk.size() - readOffset_);
+        std::copy(chunk.begin() + readOffset_, chunk.begin() + readOffset_ + len, data + read);
+        read += len;
+        readOffset_ += len;
+
+        if(readOffset_ == chunk.size())
+        {
+            // The slot's memory goes back to the writer
+            readOffset_ = 0;
+            tail_.store(++tail, std::memory_order_release);
+        }
     }
 
-    const auto len = std::min<size_t>(maxlen, data_.size());
-    std::copy(data_.begin(), data_.begin() + len, data);
-    data_.erase_begin(len);
-
-    return len;
+    queuedBytes_.fetch_sub(read, std::memory_order_relaxed);
+    return read;
 }
 
 qint64 SequentialBuffer::writeData(const char *data, qint64 len)
 {
-    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if(head - tail_.load(std::memory_order_acquire) == cChunkSlots)
+    {
+        // The player stopped reading; the decoder recovers at the next key frame
+        if(dropped_++ % cChunkSlots == 0)
+        {
+            OPENAUTO_LOG(warning) << "[SequentialBuffer] Reader is " << cChunkSlots
+                                  << " chunks behind, " << dropped_ << " dropped so far";
+        }
+        return len;
+    }
+
+    // assign() keeps the slot's capacity: no allocation once the ring warmed up
+    auto &chunk = chunks_[head % cChunkSlots];
+    const size_t capacity = chunk.capacity();
+    if(trimSlots_ && capacity > cTrimSlotBytes && capacity / 4 > static_cast<size_t>(len))
+    {
+        aasdk::common::Data().swap(chunk);
+    }
+    chunk.assign(data, data + len);
+    if(chunk.capacity() != capacity)
+    {
+        slotBytes_ += chunk.capacity() - capacity;
+        MemoryFootprint::instance().add(MemoryPool::Video, static_cast<int64_t>(chunk.capacity()) - static_cast<int64_t>(capacity));
+    }
+    queuedBytes_.fetch_add(len, std::memory_order_relaxed);
+    head_.store(head + 1);
 
-    data_.insert(data_.end(), data, data + len);
-    emit readyRead();
+    if(readerWaiting_.exchange(false))
+    {
+        emit readyRead();
+    }
     return len;
 }
 
@@ -92,15 +154,23 @@ bool SequentialBuffer::atEnd() const
 
 bool SequentialBuffer::reset()
 {
-    data_.clear();
+    // Reader side: skip whatever is queued
+    const size_t head = head_.load(std::memory_order_acquire);
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t skipped = 0;
+    for(; tail != head; ++tail)
+    {
+        skipped += chunks_[tail % cChunkSlots].size();
+    }
+    queuedBytes_.fetch_sub(skipped - readOffset_, std::memory_order_relaxed);
+    readOffset_ = 0;
+    tail_.store(tail, std::memory_order_release);
     return true;
 }
 
 qint64 SequentialBuffer::bytesAvailable() const
 {
-    std::lock_guard<decltype(mutex_)> lock(mutex_);
-
-    return QIODevice::bytesAvailable() + std::max<qint64>(1, data_.size());
+    return QIODevice::bytesAvailable() + std::max<qint64>(1, queuedBytes_.load(std::memory_order_relaxed));
 }
 
 bool SequentialBuffer::canReadLine() const
@@ -0,0 +1,350 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+ * SimdKernels.cpp
+ *
+ * Scalar references of the vector kernels, and the binding of each to the
+ * build this CPU runs. Built without -mfpu=neon: nothing here may assume
+ * NEON, even on armv7.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <f1x/openauto/Common/CpuFeatures.hpp>
+#include <f1x/openauto/autoapp/Projection/SimdKernels.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          int16_t saturate(int32_t sample)
+          {
+            return static_cast<int16_t>(std::min<int32_t>(std::max<int32_t>(sample, -32768), 32767));
+          }
+
+          // Same rounding as vqrdmulhq_s16 so both builds agree bit for bit
+          int16_t mulQ15(int16_t sample, int16_t gain)
+          {
+            return saturate((2 * static_cast<int32_t>(sample) * gain + (1 << 15)) >> 16);
+          }
+
+          void mixSaturate(int16_t *dst, const int16_t *src, size_t samples)
+          {
+            for (size_t i = 0; i < samples; i++)
+            {
+              dst[i] = saturate(static_cast<int32_t>(dst[i]) + src[i]);
+            }
+          }
+
+          void applyGainQ15(int16_t *samples, size_t frames, uint32_t channels, int16_t startGain,
+                            int16_t endGain)
+          {
+            const size_t count = frames * channels;
+            const int32_t delta = static_cast<int32_t>(endGain) - startGain;
+            for (size_t i = 0; i < count; i++)
+            {
+              const auto frame = static_cast<int64_t>(i / channels);
+              samples[i] = mulQ15(samples[i],
+                                  static_cast<int16_t>(startGain + delta * frame / static_cast<int64_t>(frames)));
+            }
+          }
+
+          void upmixMonoToStereo(int16_t *dst, const int16_t *src, size_t frames)
+          {
+            for (size_t i = 0; i < frames; i++)
+            {
+              dst[2 * i] = src[i];
+              dst[2 * i + 1] = src[i];
+            }
+          }
+
+          int32_t dotProduct8(const int16_t *a, const int16_t *b)
+          {
+            int32_t acc = 0;
+            for (size_t i = 0; i < 8; i++)
+            {
+              acc += static_cast<int32_t>(a[i]) * b[i];
+            }
+            return acc;
+          }
+
+          void interleaveChromaRow(uint8_t *dst, const uint8_t *u, const uint8_t *v, int width)
+          {
+            for (int x = 0; x < width; x++)
+            {
+              dst[2 * x] = u[x];
+              dst[2 * x + 1] = v[x];
+            }
+          }
+
+          void toFloat(const int16_t *src, float *dst, size_t samples)
+          {
+            constexpr float scale = 1.0f / 32768.0f;
+            for (size_t i = 0; i < samples; i++)
+            {
+              dst[i] = src[i] * scale;
+            }
+          }
+
+          void biquadStereo(float *samples, size_t frames, const float *coefficients, float *state)
+          {
+            const float b0 = coefficients[0], b1 = coefficients[1], b2 = coefficients[2];
+            const float a1 = coefficients[3], a2 = coefficients[4];
+            for (size_t channel = 0; channel < 2; channel++)
+            {
+              float z1 = state[channel];
+              float z2 = state[2 + channel];
+              for (size_t i = channel; i < frames * 2; i += 2)
+              {
+                const float x = samples[i];
+                const float y = z1 + x * b0;
+                z1 = (z2 + x * b1) - y * a1;
+                z2 = x * b2 - y * a2;
+                samples[i] = y;
+              }
+              state[channel] = z1;
+              state[2 + channel] = z2;
+            }
+          }
+
+          float dotF32(const float *a, const float *b, size_t count)
+          {
+            float sum = 0.0f;
+            for (size_t i = 0; i < count; i++)
+            {
+              sum += a[i] * b[i];
+            }
+            return sum;
+          }
+
+          void axpyF32(float *y, const float *x, float scale, size_t count)
+          {
+            for (size_t i = 0; i < count; i++)
+            {
+              y[i] += scale * x[i];
+            }
+          }
+
+          template <typename Fn>
+          Fn pick(Fn scalar, const SimdKernels *neon, Fn SimdKernels::*kernel, const common::CpuFeatures &features)
+          {
+            common::KernelVariants<Fn> variants;
+            variants.scalar = scalar;
+            variants.neon = neon != nullptr ? neon->*kernel : nullptr;
+            return variants.select(features);
+          }
+
+          // ==========================================================================
+          // Self-test: the bound kernels against the references on the same input
+          // ==========================================================================
+
+          // Two vector blocks of every kernel and a tail
+          constexpr size_t cTestLength = 37;
+
+          template <typename T>
+          std::vector<T> testInput(size_t count, uint32_t seed, int32_t low, int32_t high)
+          {
+            std::vector<T> values(count);
+            uint32_t state = seed;
+            for (auto &value : values)
+            {
+              state = state * 1664525u + 1013904223u;
+              value = static_cast<T>(low + static_cast<int64_t>(state >> 8) % (high - low + 1));
+            }
+            return values;
+          }
+
+          std::vector<float> testSignal(size_t count, uint32_t seed)
+          {
+            std::vector<float> values(count);
+            const auto raw = testInput<int16_t>(count, seed, -32768, 32767);
+            std::transform(raw.begin(), raw.end(), values.begin(), [](int16_t v) { return v / 32768.0f; });
+            return values;
+          }
+
+          // Vector builds sum in a different order, and may fuse
+          bool close(const std::vector<float> &a, const std::vector<float> &b)
+          {
+            for (size_t i = 0; i < a.size(); i++)
+            {
+              if (std::fabs(a[i] - b[i]) > 1e-4f * std::max(1.0f, std::fabs(b[i])))
+              {
+                return false;
+              }
+            }
+            return true;
+          }
+
+          bool checkMixSaturate()
+          {
+            const auto src = testInput<int16_t>(cTestLength, 1, -32768, 32767);
+            auto expected = testInput<int16_t>(cTestLength, 2, -32768, 32767);
+            auto actual = expected;
+            scalarKernels().mixSaturate(expected.data(), src.data(), cTestLength);
+            simdKernels().mixSaturate(actual.data(), src.data(), cTestLength);
+            return actual == expected;
+          }
+
+          bool checkApplyGainQ15()
+          {
+            for (const int16_t endGain : {int16_t{12000}, int16_t{30000}})
+            {
+              auto expected = testInput<int16_t>(cTestLength * 2, 3, -32768, 32767);
+              auto actual = expected;
+              scalarKernels().applyGainQ15(expected.data(), cTestLength, 2, 12000, endGain);
+              simdKernels().applyGainQ15(actual.data(), cTestLength, 2, 12000, endGain);
+              if (actual != expected)
+              {
+                return false;
+              }
+            }
+            return true;
+          }
+
+          bool checkUpmixMonoToStereo()
+          {
+            const auto src = testInput<int16_t>(cTestLength, 4, -32768, 32767);
+            std::vector<int16_t> expected(cTestLength * 2), actual(cTestLength * 2);
+            scalarKernels().upmixMonoToStereo(expected.data(), src.data(), cTestLength);
+            simdKernels().upmixMonoToStereo(actual.data(), src.data(), cTestLength);
+            return actual == expected;
+          }
+
+          bool checkDotProduct8()
+          {
+            const auto a = testInput<int16_t>(8, 5, -32768, 32767);
+            const auto b = testInput<int16_t>(8, 6, -4096, 4096);
+            return simdKernels().dotProduct8(a.data(), b.data()) == scalarKernels().dotProduct8(a.data(), b.data());
+          }
+
+          bool checkInterleaveChromaRow()
+          {
+            const auto u = testInput<uint8_t>(cTestLength, 7, 0, 255);
+            const auto v = testInput<uint8_t>(cTestLength, 8, 0, 255);
+            std::vector<uint8_t> expected(cTestLength * 2), actual(cTestLength * 2);
+            scalarKernels().interleaveChromaRow(expected.data(), u.data(), v.data(), cTestLength);
+            simdKernels().interleaveChromaRow(actual.data(), u.data(), v.data(), cTestLength);
+            return actual == expected;
+          }
+
+          bool checkToFloat()
+          {
+            const auto src = testInput<int16_t>(cTestLength, 9, -32768, 32767);
+            std::vector<float> expected(cTestLength), actual(cTestLength);
+            scalarKernels().toFloat(src.data(), expected.data(), cTestLength);
+            simdKernels().toFloat(src.data(), actual.data(), cTestLength);
+            return actual == expected;
+          }
+
+          bool checkBiquadStereo()
+          {
+            // A 1 kHz peaking band at 48 kHz
+            const float coefficients[] = {1.02f, -1.93f, 0.92f, -1.93f, 0.94f};
+            float expectedState[] = {0.1f, -0.1f, 0.05f, -0.05f};
+            float actualState[] = {0.1f, -0.1f, 0.05f, -0.05f};
+            auto expected = testSignal(cTestLength * 2, 10);
+            auto actual = expected;
+            scalarKernels().biquadStereo(expected.data(), cTestLength, coefficients, expectedState);
+            simdKernels().biquadStereo(actual.data(), cTestLength, coefficients, actualState);
+            return close(actual, expected) &&
+                   close(std::vector<float>(actualState, actualState + 4),
+                         std::vector<float>(expectedState, expectedState + 4));
+          }
+
+          bool checkDotF32()
+          {
+            const auto a = testSignal(cTestLength, 11);
+            const auto b = testSignal(cTestLength, 12);
+            return close({simdKernels().dotF32(a.data(), b.data(), cTestLength)},
+                         {scalarKernels().dotF32(a.data(), b.data(), cTestLength)});
+          }
+
+          bool checkAxpyF32()
+          {
+            const auto x = testSignal(cTestLength, 13);
+            auto expected = testSignal(cTestLength, 14);
+            auto actual = expected;
+            scalarKernels().axpyF32(expected.data(), x.data(), 0.37f, cTestLength);
+            simdKernels().axpyF32(actual.data(), x.data(), 0.37f, cTestLength);
+            return close(actual, expected);
+          }
+
+          bool registerSelfTests()
+          {
+            auto &selfTest = common::KernelSelfTest::instance();
+            selfTest.add("mixSaturate", checkMixSaturate);
+            selfTest.add("applyGainQ15", checkApplyGainQ15);
+            selfTest.add("upmixMonoToStereo", checkUpmixMonoToStereo);
+            selfTest.add("dotProduct8", checkDotProduct8);
+            selfTest.add("interleaveChromaRow", checkInterleaveChromaRow);
+            selfTest.add("toFloat", checkToFloat);
+            selfTest.add("biquadStereo", checkBiquadStereo);
+            selfTest.add("dotF32", checkDotF32);
+            selfTest.add("axpyF32", checkAxpyF32);
+            return true;
+          }
+
+          const bool cSelfTestsRegistered = registerSelfTests();
+        }
+
+        const SimdKernels &scalarKernels()
+        {
+          static const SimdKernels kernels = {mixSaturate, applyGainQ15, upmixMonoToStereo, dotProduct8,
+                                              interleaveChromaRow, toFloat, biquadStereo, dotF32, axpyF32};
+          return kernels;
+        }
+
+        SimdKernels bindSimdKernels(const common::CpuFeatures &features)
+        {
+          const SimdKernels &scalar = scalarKernels();
+          const SimdKernels *neon = neonKernels();
+          SimdKernels kernels;
+          kernels.mixSaturate = pick(scalar.mixSaturate, neon, &SimdKernels::mixSaturate, features);
+          kernels.applyGainQ15 = pick(scalar.applyGainQ15, neon, &SimdKernels::applyGainQ15, features);
+          kernels.upmixMonoToStereo = pick(scalar.upmixMonoToStereo, neon, &SimdKernels::upmixMonoToStereo, features);
+          kernels.dotProduct8 = pick(scalar.dotProduct8, neon, &SimdKernels::dotProduct8, features);
+          kernels.interleaveChromaRow =
+              pick(scalar.interleaveChromaRow, neon, &SimdKernels::interleaveChromaRow, features);
+          kernels.toFloat = pick(scalar.toFloat, neon, &SimdKernels::toFloat, features);
+          kernels.biquadStereo = pick(scalar.biquadStereo, neon, &SimdKernels::biquadStereo, features);
+          kernels.dotF32 = pick(scalar.dotF32, neon, &SimdKernels::dotF32, features);
+          kernels.axpyF32 = pick(scalar.axpyF32, neon, &SimdKernels::axpyF32, features);
+          return kernels;
+        }
+
+        const SimdKernels &simdKernels()
+        {
+          static const SimdKernels kernels = bindSimdKernels(common::CpuFeatures::host());
+          return kernels;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
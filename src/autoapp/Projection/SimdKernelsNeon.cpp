@@ -0,0 +1,240 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+ * SimdKernelsNeon.cpp
+ *
+ * NEON builds of the kernels in SimdKernels.hpp: a vector body for the bulk
+ * and a scalar loop for the tail, bit-exact with the references where the
+ * arithmetic is integer.
+ *
+ * On armv7 this is the one file built with -mfpu=neon (see CMakeLists.txt)
+ * and only reached when AT_HWCAP has NEON. It includes no library headers:
+ * an inline function instantiated here would carry NEON code into every
+ * caller the linker merges it with.
+ */
+
+#include <f1x/openauto/autoapp/Projection/SimdKernels.hpp>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OPENAUTO_SIMD_NEON 1
+#endif
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+#ifdef OPENAUTO_SIMD_NEON
+        namespace
+        {
+          inline int16_t saturate(int32_t sample)
+          {
+            return static_cast<int16_t>(sample < -32768 ? -32768 : (sample > 32767 ? 32767 : sample));
+          }
+
+          inline int16_t mulQ15(int16_t sample, int16_t gain)
+          {
+            return saturate((2 * static_cast<int32_t>(sample) * gain + (1 << 15)) >> 16);
+          }
+
+          void mixSaturate(int16_t *dst, const int16_t *src, size_t samples)
+          {
+            size_t i = 0;
+            for (; i + 8 <= samples; i += 8)
+            {
+              vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), vld1q_s16(src + i)));
+            }
+            for (; i < samples; i++)
+            {
+              dst[i] = saturate(static_cast<int32_t>(dst[i]) + src[i]);
+            }
+          }
+
+          void applyGainQ15(int16_t *samples, size_t frames, uint32_t channels, int16_t startGain,
+                            int16_t endGain)
+          {
+            const size_t count = frames * channels;
+            const int32_t delta = static_cast<int32_t>(endGain) - startGain;
+            auto gainAt = [&](size_t sample) {
+              const auto frame = static_cast<int64_t>(sample / channels);
+              return static_cast<int16_t>(startGain + delta * frame / static_cast<int64_t>(frames));
+            };
+
+            size_t i = 0;
+            if (delta == 0)
+            {
+              const int16x8_t gain = vdupq_n_s16(startGain);
+              for (; i + 8 <= count; i += 8)
+              {
+                vst1q_s16(samples + i, vqrdmulhq_s16(vld1q_s16(samples + i), gain));
+              }
+            }
+            else
+            {
+              int16_t gains[8];
+              for (; i + 8 <= count; i += 8)
+              {
+                for (size_t lane = 0; lane < 8; lane++)
+                {
+                  gains[lane] = gainAt(i + lane);
+                }
+                vst1q_s16(samples + i, vqrdmulhq_s16(vld1q_s16(samples + i), vld1q_s16(gains)));
+              }
+            }
+            for (; i < count; i++)
+            {
+              samples[i] = mulQ15(samples[i], gainAt(i));
+            }
+          }
+
+          void upmixMonoToStereo(int16_t *dst, const int16_t *src, size_t frames)
+          {
+            size_t i = 0;
+            for (; i + 8 <= frames; i += 8)
+            {
+              int16x8x2_t stereo;
+              stereo.val[0] = vld1q_s16(src + i);
+              stereo.val[1] = stereo.val[0];
+              vst2q_s16(dst + 2 * i, stereo);
+            }
+            for (; i < frames; i++)
+            {
+              dst[2 * i] = src[i];
+              dst[2 * i + 1] = src[i];
+            }
+          }
+
+          int32_t dotProduct8(const int16_t *a, const int16_t *b)
+          {
+            const int16x8_t va = vld1q_s16(a);
+            const int16x8_t vb = vld1q_s16(b);
+            int32x4_t acc = vmull_s16(vget_low_s16(va), vget_low_s16(vb));
+            acc = vmlal_s16(acc, vget_high_s16(va), vget_high_s16(vb));
+            const int32x2_t sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+            return vget_lane_s32(vpadd_s32(sum, sum), 0);
+          }
+
+          void interleaveChromaRow(uint8_t *dst, const uint8_t *u, const uint8_t *v, int width)
+          {
+            int x = 0;
+            // 16 U + 16 V samples -> 32 interleaved bytes per iteration
+            for (; x + 16 <= width; x += 16)
+            {
+              uint8x16x2_t uv;
+              uv.val[0] = vld1q_u8(u + x);
+              uv.val[1] = vld1q_u8(v + x);
+              vst2q_u8(dst + 2 * x, uv);
+            }
+            for (; x < width; x++)
+            {
+              dst[2 * x] = u[x];
+              dst[2 * x + 1] = v[x];
+            }
+          }
+
+          void toFloat(const int16_t *src, float *dst, size_t samples)
+          {
+            constexpr float scale = 1.0f / 32768.0f;
+            size_t i = 0;
+            for (; i + 8 <= samples; i += 8)
+            {
+              const int16x8_t in = vld1q_s16(src + i);
+              vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(in))), scale));
+              vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(in))), scale));
+            }
+            for (; i < samples; i++)
+            {
+              dst[i] = src[i] * scale;
+            }
+          }
+
+          // A stereo frame per float32x2 register
+          void biquadStereo(float *samples, size_t frames, const float *coefficients, float *state)
+          {
+            const float b0 = coefficients[0], b1 = coefficients[1], b2 = coefficients[2];
+            const float a1 = coefficients[3], a2 = coefficients[4];
+            float32x2_t z1 = vld1_f32(state);
+            float32x2_t z2 = vld1_f32(state + 2);
+            for (size_t i = 0; i < frames; i++)
+            {
+              const float32x2_t x = vld1_f32(samples + 2 * i);
+              const float32x2_t y = vmla_n_f32(z1, x, b0);
+              z1 = vmls_n_f32(vmla_n_f32(z2, x, b1), y, a1);
+              z2 = vmls_n_f32(vmul_n_f32(x, b2), y, a2);
+              vst1_f32(samples + 2 * i, y);
+            }
+            vst1_f32(state, z1);
+            vst1_f32(state + 2, z2);
+          }
+
+          float dotF32(const float *a, const float *b, size_t count)
+          {
+            size_t i = 0;
+            float32x4_t acc = vdupq_n_f32(0.0f);
+            for (; i + 4 <= count; i += 4)
+            {
+              acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+            }
+            const float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+            float sum = vget_lane_f32(vpadd_f32(pair, pair), 0);
+            for (; i < count; i++)
+            {
+              sum += a[i] * b[i];
+            }
+            return sum;
+          }
+
+          void axpyF32(float *y, const float *x, float scale, size_t count)
+          {
+            size_t i = 0;
+            const float32x4_t vscale = vdupq_n_f32(scale);
+            for (; i + 4 <= count; i += 4)
+            {
+              vst1q_f32(y + i, vmlaq_f32(vld1q_f32(y + i), vld1q_f32(x + i), vscale));
+            }
+            for (; i < count; i++)
+            {
+              y[i] += scale * x[i];
+            }
+          }
+        }
+#endif
+
+        const SimdKernels *neonKernels()
+        {
+#ifdef OPENAUTO_SIMD_NEON
+          static const SimdKernels kernels = {mixSaturate, applyGainQ15, upmixMonoToStereo, dotProduct8,
+                                              interleaveChromaRow, toFloat, biquadStereo, dotF32, axpyF32};
+          return &kernels;
+#else
+          return nullptr;
+#endif
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
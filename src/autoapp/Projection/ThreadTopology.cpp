@@ -0,0 +1,312 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          std::vector<int> cpuRange(int first, int last)
+          {
+            std::vector<int> cpus;
+            for (int cpu = first; cpu <= last; ++cpu)
+            {
+              cpus.push_back(cpu);
+            }
+            return cpus;
+          }
+
+          const char *roleName(ThreadRole role)
+          {
+            switch (role)
+            {
+            case ThreadRole::UsbEvents:
+              return "usb";
+            case ThreadRole::IoService:
+              return "io";
+            case ThreadRole::MediaLane:
+              return "media-lane";
+            case ThreadRole::Input:
+              return "input";
+            case ThreadRole::VideoDecode:
+              return "video-decode";
+            case ThreadRole::VideoPresent:
+              return "video-present";
+            case ThreadRole::AudioOutput:
+              return "audio-out";
+            case ThreadRole::AudioInput:
+              return "audio-in";
+            case ThreadRole::Background:
+              return "background";
+            default:
+              return "?";
+            }
+          }
+        }
+
+        ThreadTopology::ThreadTopology(const ThreadTopologySettings &settings, unsigned cores)
+        {
+          this->plan(settings, cores);
+        }
+
+        ThreadTopology &ThreadTopology::current()
+        {
+          static ThreadTopology topology(ThreadTopologySettings(), std::thread::hardware_concurrency());
+          return topology;
+        }
+
+        const ThreadTopology &ThreadTopology::instance()
+        {
+          return current();
+        }
+
+        void ThreadTopology::configure(const ThreadTopologySettings &settings)
+        {
+          current().plan(settings, std::thread::hardware_concurrency());
+          OPENAUTO_LOG(info) << "[ThreadTopology] " << instance().summary();
+        }
+
+        bool ThreadTopology::parseCpuList(const std::string &list, unsigned cores, std::vector<int> &cpus)
+        {
+          cpus.clear();
+          if (list.empty() || list == "none")
+          {
+            return true;
+          }
+
+          std::stringstream stream(list);
+          std::string item;
+          while (std::getline(stream, item, ','))
+          {
+            int first = 0;
+            int last = 0;
+            char dash = 0;
+            std::istringstream range(item);
+            if (!(range >> first))
+            {
+              return false;
+            }
+            last = first;
+            if (range >> dash)
+            {
+              if (dash != '-' || !(range >> last))
+              {
+                return false;
+              }
+            }
+            if (first < 0 || last < first || static_cast<unsigned>(last) >= cores)
+            {
+              return false;
+            }
+            for (int cpu = first; cpu <= last; ++cpu)
+            {
+              if (std::find(cpus.begin(), cpus.end(), cpu) == cpus.end())
+              {
+                cpus.push_back(cpu);
+              }
+            }
+          }
+          std::sort(cpus.begin(), cpus.end());
+          return !cpus.empty();
+        }
+
+        void ThreadTopology::plan(const ThreadTopologySettings &settings, unsigned cores)
+        {
+          // hardware_concurrency() may return 0 when the count is unknown
+          cores_ = std::max(cores, 1u);
+          const int n = static_cast<int>(cores_);
+
+          ioWorkers_ = settings.ioWorkers > 0 ? settings.ioWorkers : std::max(cores_, 2u);
+
+          // Last core for video, the one before it for audio when there are
+          // enough; the pools get whatever remains
+          std::vector<int> video;
+          std::vector<int> audio;
+          std::vector<int> workers;
+          if (n >= 4)
+          {
+            video = {n - 1};
+            audio = {n - 2};
+            workers = cpuRange(0, n - 3);
+          }
+          else if (n >= 2)
+          {
+            video = {n - 1};
+            workers = cpuRange(0, n - 2);
+          }
+
+          const auto resolve = [this](const std::string &list, std::vector<int> automatic, const char *key)
+          {
+            if (list == "auto")
+            {
+              return automatic;
+            }
+            std::vector<int> cpus;
+            if (!parseCpuList(list, cores_, cpus))
+            {
+              OPENAUTO_LOG(warning) << "[ThreadTopology] Invalid " << key << " '" << list
+                                    << "', using the default";
+              return automatic;
+            }
+            return cpus;
+          };
+
+          ThreadPlacement pool;
+          pool.cpus = resolve(settings.workerCpus, workers, "WorkerCpus");
+
+          ThreadPlacement videoPlacement;
+          videoPlacement.cpus = resolve(settings.videoCpus, video, "VideoCpus");
+          videoPlacement.fifoPriority = settings.videoPriority < 0 ? cDefaultVideoPriority : settings.videoPriority;
+
+          ThreadPlacement audioPlacement;
+          audioPlacement.cpus = resolve(settings.audioCpus, audio, "AudioCpus");
+          audioPlacement.fifoPriority = settings.audioPriority < 0 ? cDefaultAudioPriority : settings.audioPriority;
+
+          const int maxPriority = sched_get_priority_max(SCHED_FIFO);
+          for (auto *placement : {&videoPlacement, &audioPlacement})
+          {
+            placement->fifoPriority = std::min(placement->fifoPriority, maxPriority);
+          }
+
+          placements_[static_cast<size_t>(ThreadRole::UsbEvents)] = pool;
+          placements_[static_cast<size_t>(ThreadRole::IoService)] = pool;
+
+          // Media handlers share the pool's cores but preempt its protocol work;
+          // they stay on SCHED_OTHER when video does
+          ThreadPlacement lane = pool;
+          lane.fifoPriority = std::min(cDefaultMediaLanePriority, videoPlacement.fifoPriority);
+          placements_[static_cast<size_t>(ThreadRole::MediaLane)] = lane;
+          // Input feeds the media lane; waiting behind pool work would undo
+          // reading it off the GUI thread
+          placements_[static_cast<size_t>(ThreadRole::Input)] = lane;
+          placements_[static_cast<size_t>(ThreadRole::VideoDecode)] = videoPlacement;
+          placements_[static_cast<size_t>(ThreadRole::VideoPresent)] = videoPlacement;
+          placements_[static_cast<size_t>(ThreadRole::AudioOutput)] = audioPlacement;
+          placements_[static_cast<size_t>(ThreadRole::AudioInput)] = audioPlacement;
+
+          // Recording must never cost projection a frame: pool cores, and only
+          // their idle time
+          ThreadPlacement background = pool;
+          background.idle = true;
+          placements_[static_cast<size_t>(ThreadRole::Background)] = background;
+        }
+
+        const ThreadPlacement &ThreadTopology::placement(ThreadRole role) const
+        {
+          return placements_[static_cast<size_t>(role)];
+        }
+
+        void ThreadTopology::apply(ThreadRole role, const char *name) const
+        {
+          // Names longer than 15 characters are rejected, not truncated
+          char shortName[16];
+          std::strncpy(shortName, name, sizeof(shortName) - 1);
+          shortName[sizeof(shortName) - 1] = '\0';
+          pthread_setname_np(pthread_self(), shortName);
+
+          const ThreadPlacement &target = this->placement(role);
+          bool failed = false;
+
+          if (!target.cpus.empty())
+          {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : target.cpus)
+            {
+              CPU_SET(cpu, &set);
+            }
+            failed |= pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0;
+          }
+
+          if (target.fifoPriority > 0)
+          {
+            sched_param param{};
+            param.sched_priority = target.fifoPriority;
+            failed |= pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0;
+          }
+          else if (target.idle)
+          {
+            sched_param param{};
+            failed |= pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0;
+            // ioprio_set has no glibc wrapper: IOPRIO_WHO_PROCESS of this
+            // thread, IOPRIO_CLASS_IDLE
+            constexpr int cWhoProcess = 1;
+            constexpr int cClassIdle = 3;
+            failed |= syscall(SYS_ioprio_set, cWhoProcess, 0, cClassIdle << 13) != 0;
+          }
+
+          if (failed && !warned_[static_cast<size_t>(role)].exchange(true))
+          {
+            OPENAUTO_LOG(warning) << "[ThreadTopology] Could not fully place " << roleName(role)
+                                  << " thread (affinity or SCHED_FIFO " << target.fifoPriority
+                                  << " refused; needs CAP_SYS_NICE or an rtprio limit)";
+          }
+        }
+
+        std::string ThreadTopology::summary() const
+        {
+          std::ostringstream out;
+          out << cores_ << " cores, " << ioWorkers_ << " io workers";
+          for (size_t i = 0; i < placements_.size(); ++i)
+          {
+            const ThreadPlacement &placement = placements_[i];
+            out << ", " << roleName(static_cast<ThreadRole>(i)) << "=";
+            if (placement.cpus.empty())
+            {
+              out << "any";
+            }
+            else
+            {
+              for (size_t c = 0; c < placement.cpus.size(); ++c)
+              {
+                out << (c ? "," : "") << placement.cpus[c];
+              }
+            }
+            if (placement.fifoPriority > 0)
+            {
+              out << "/fifo" << placement.fifoPriority;
+            }
+            else if (placement.idle)
+            {
+              out << "/idle";
+            }
+          }
+          return out.str();
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,324 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/Projection/FrameGrabber.hpp>
+#include <f1x/openauto/autoapp/Projection/IInputDeviceEventHandler.hpp>
+#include <f1x/openauto/autoapp/Projection/TouchLatencyProbe.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          using aap_protobuf::service::inputsource::message::PointerAction;
+
+          // Registered on first use: only processes running the probe list them
+          struct ProbeMetrics
+          {
+            MetricHistogram &touchToPhoton = Metrics::instance().histogram(
+                "openauto_touch_to_photon_ms", "Injected tap to the first flipped frame reacting to it",
+                {25, 50, 75, 100, 150, 200, 300, 500, 1000});
+            MetricHistogram &arrivalToPhoton = Metrics::instance().histogram(
+                "openauto_flash_arrival_to_photon_ms", "Test pattern flash from AAP arrival to page flip",
+                {5, 10, 20, 30, 50, 75, 100, 200});
+            MetricCounter &missedTaps = Metrics::instance().counter(
+                "openauto_touch_probe_missed_total", "Injected taps with no visible reaction within a second");
+          };
+
+          ProbeMetrics &metrics()
+          {
+            static ProbeMetrics instance;
+            return instance;
+          }
+
+          TouchEvent tapEvent(PointerAction action, const QPoint &position)
+          {
+            TouchEvent event;
+            event.type = action;
+            event.actionIndex = 0;
+            event.pointers.push_back({static_cast<uint32_t>(position.x()), static_cast<uint32_t>(position.y()), 0});
+            return event;
+          }
+        }
+
+        TouchLatencyProbe &TouchLatencyProbe::instance()
+        {
+          static TouchLatencyProbe probe;
+          return probe;
+        }
+
+        bool TouchLatencyProbe::parseOptions(const std::string &value, Options &options)
+        {
+          std::istringstream list(value);
+          std::string field;
+          int values[3] = {0, 0, options.intervalMs};
+          int count = 0;
+          while (std::getline(list, field, ','))
+          {
+            char *end = nullptr;
+            const long parsed = std::strtol(field.c_str(), &end, 10);
+            if (count == 3 || field.empty() || *end != '\0' || parsed < 0)
+            {
+              return false;
+            }
+            values[count++] = static_cast<int>(parsed);
+          }
+          // Faster than this, a reaction could be mistaken for the next tap's
+          if (count < 2 || values[2] < 500)
+          {
+            return false;
+          }
+          options.position = QPoint(values[0], values[1]);
+          options.intervalMs = values[2];
+          return true;
+        }
+
+        bool TouchLatencyProbe::optionsFromEnvironment(Options &options)
+        {
+          const char *value = std::getenv("OPENAUTO_LATENCY_PROBE");
+          if (value == nullptr || *value == '\0')
+          {
+            return false;
+          }
+          if (!parseOptions(value, options))
+          {
+            OPENAUTO_LOG(warning) << "[TouchLatencyProbe] Ignoring OPENAUTO_LATENCY_PROBE=" << value
+                                  << ", expected x,y[,intervalMs]";
+            return false;
+          }
+          return true;
+        }
+
+        int TouchLatencyProbe::meanLuma(const uint8_t *plane, int pitch, const QRect &region)
+        {
+          uint64_t sum = 0;
+          uint32_t samples = 0;
+          for (int y = region.top(); y <= region.bottom(); y += 2)
+          {
+            const uint8_t *row = plane + static_cast<ptrdiff_t>(y) * pitch;
+            for (int x = region.left(); x <= region.right(); x += 2)
+            {
+              sum += row[x];
+              samples++;
+            }
+          }
+          return samples != 0 ? static_cast<int>(sum / samples) : -1;
+        }
+
+        TouchLatencyProbe::TouchLatencyProbe()
+            : active_(false), stopping_(false), lastLuma_(-1), tapLuma_(-1), pendingTapUs_(0), lastTapUs_(0),
+              missedTaps_(0)
+        {
+        }
+
+        TouchLatencyProbe::~TouchLatencyProbe()
+        {
+          stop();
+        }
+
+        void TouchLatencyProbe::start(const Options &options, IInputDeviceEventHandler &eventHandler)
+        {
+          stop();
+          metrics();
+
+          {
+            std::lock_guard<decltype(mutex_)> lock(mutex_);
+            options_ = options;
+            stopping_ = false;
+            lastLuma_ = -1;
+            pendingTapUs_ = 0;
+          }
+          active_.store(true, std::memory_order_relaxed);
+          thread_ = std::thread(&TouchLatencyProbe::run, this, &eventHandler);
+
+          OPENAUTO_LOG(info) << "[TouchLatencyProbe] Tapping at " << options.position.x() << "," << options.position.y()
+                             << " every " << options.intervalMs << " ms";
+        }
+
+        void TouchLatencyProbe::stop()
+        {
+          {
+            std::lock_guard<decltype(mutex_)> lock(mutex_);
+            stopping_ = true;
+          }
+          wake_.notify_all();
+          if (thread_.joinable())
+          {
+            thread_.join();
+            OPENAUTO_LOG(info) << "[TouchLatencyProbe] Stopped, touch-to-photon p50 "
+                               << touchToPhoton().p50Us / 1000 << " ms p99 " << touchToPhoton().p99Us / 1000
+                               << " ms over " << touchToPhoton().samples << " taps, " << missedTaps() << " missed";
+          }
+          active_.store(false, std::memory_order_relaxed);
+        }
+
+        bool TouchLatencyProbe::isActive() const
+        {
+          return active_.load(std::memory_order_relaxed);
+        }
+
+        QRect TouchLatencyProbe::region(int frameWidth, int frameHeight) const
+        {
+          if (!isActive())
+          {
+            return QRect();
+          }
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          const int half = options_.regionSize / 2;
+          const QRect square(options_.position.x() - half, options_.position.y() - half, options_.regionSize,
+                             options_.regionSize);
+          return square.intersected(QRect(0, 0, frameWidth, frameHeight));
+        }
+
+        void TouchLatencyProbe::run(IInputDeviceEventHandler *eventHandler)
+        {
+          std::unique_lock<decltype(mutex_)> lock(mutex_);
+          while (!stopping_)
+          {
+            wake_.wait_for(lock, std::chrono::milliseconds(options_.intervalMs), [this]()
+                           { return stopping_; });
+            if (stopping_)
+            {
+              break;
+            }
+
+            expirePendingTap(VideoTelemetry::nowUs());
+            // Nothing to compare against until video is on screen
+            if (lastLuma_ < 0 || pendingTapUs_ != 0)
+            {
+              continue;
+            }
+
+            const QPoint position = options_.position;
+            lock.unlock();
+            const int64_t tapUs = VideoTelemetry::nowUs();
+            tapped(tapUs);
+            eventHandler->onTouchEvent(tapEvent(PointerAction::ACTION_DOWN, position));
+            lock.lock();
+
+            // Lift even when stopping, so the phone is not left with a contact down
+            wake_.wait_for(lock, std::chrono::milliseconds(cTapHoldMs), [this]()
+                           { return stopping_; });
+            lock.unlock();
+            eventHandler->onTouchEvent(tapEvent(PointerAction::ACTION_UP, position));
+            lock.lock();
+          }
+        }
+
+        void TouchLatencyProbe::tapped(int64_t tapUs)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          tapLuma_ = lastLuma_;
+          pendingTapUs_ = tapUs;
+          lastTapUs_ = tapUs;
+        }
+
+        void TouchLatencyProbe::expirePendingTap(int64_t nowUs)
+        {
+          if (pendingTapUs_ != 0 && nowUs - pendingTapUs_ > cReactionTimeoutUs)
+          {
+            pendingTapUs_ = 0;
+            missedTaps_++;
+            metrics().missedTaps.add();
+            OPENAUTO_LOG(warning) << "[TouchLatencyProbe] No visible reaction to the tap, " << missedTaps_ << " missed";
+            // What the phone showed instead, usually a page without the test patch
+            FrameGrabber::instance().grabToFile(cMissedTapFramePath);
+          }
+        }
+
+        void TouchLatencyProbe::frameShown(const VideoFrameTiming &timing)
+        {
+          if (timing.probeLuma < 0 || timing.flipUs <= 0)
+          {
+            return;
+          }
+
+          std::unique_lock<decltype(mutex_)> lock(mutex_);
+          expirePendingTap(timing.flipUs);
+
+          const int previous = lastLuma_;
+          lastLuma_ = timing.probeLuma;
+
+          if (pendingTapUs_ != 0)
+          {
+            if (timing.flipUs < pendingTapUs_ || std::abs(timing.probeLuma - tapLuma_) < options_.threshold)
+            {
+              return;
+            }
+            const int64_t latencyUs = timing.flipUs - pendingTapUs_;
+            pendingTapUs_ = 0;
+            touchToPhoton_.add(latencyUs);
+            const LatencyStats stats = touchToPhoton_.stats();
+            lock.unlock();
+
+            metrics().touchToPhoton.observe(latencyUs / 1000.0);
+            OPENAUTO_LOG(info) << "[TouchLatencyProbe] Touch to photon " << latencyUs / 1000 << " ms (p50 "
+                               << stats.p50Us / 1000 << " ms, p99 " << stats.p99Us / 1000 << " ms, " << stats.samples
+                               << " taps)";
+            return;
+          }
+
+          // The tail of a tap reaction (release ripple, fade) is not a flash
+          const bool afterTap = lastTapUs_ != 0 && timing.flipUs - lastTapUs_ < cReactionTimeoutUs;
+          if (previous < 0 || afterTap || timing.arrivalUs <= 0 ||
+              std::abs(timing.probeLuma - previous) < options_.threshold)
+          {
+            return;
+          }
+          const int64_t latencyUs = timing.flipUs - timing.arrivalUs;
+          arrivalToPhoton_.add(latencyUs);
+          lock.unlock();
+          metrics().arrivalToPhoton.observe(latencyUs / 1000.0);
+          OPENAUTO_LOG(debug) << "[TouchLatencyProbe] Flash arrival to photon " << latencyUs / 1000.0 << " ms";
+        }
+
+        LatencyStats TouchLatencyProbe::touchToPhoton() const
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          return touchToPhoton_.stats();
+        }
+
+        LatencyStats TouchLatencyProbe::arrivalToPhoton() const
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          return arrivalToPhoton_.stats();
+        }
+
+        uint64_t TouchLatencyProbe::missedTaps() const
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          return missedTaps_;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
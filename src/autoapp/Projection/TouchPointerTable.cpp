@@ -0,0 +1,92 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/Projection/TouchPointerTable.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        int TouchPointerTable::acquire(int sourceId)
+        {
+          int lowestFree = -1;
+          for (size_t i = 0; i < cMaxPointers; ++i)
+          {
+            if (slots_[i].used && slots_[i].sourceId == sourceId)
+            {
+              return static_cast<int>(i);
+            }
+            if (!slots_[i].used && lowestFree < 0)
+            {
+              lowestFree = static_cast<int>(i);
+            }
+          }
+          if (lowestFree >= 0)
+          {
+            slots_[lowestFree].used = true;
+            slots_[lowestFree].sourceId = sourceId;
+          }
+          return lowestFree;
+        }
+
+        int TouchPointerTable::find(int sourceId) const
+        {
+          for (size_t i = 0; i < cMaxPointers; ++i)
+          {
+            if (slots_[i].used && slots_[i].sourceId == sourceId)
+            {
+              return static_cast<int>(i);
+            }
+          }
+          return -1;
+        }
+
+        void TouchPointerTable::release(int sourceId)
+        {
+          const int pointerId = this->find(sourceId);
+          if (pointerId >= 0)
+          {
+            slots_[pointerId].used = false;
+          }
+        }
+
+        void TouchPointerTable::clear()
+        {
+          slots_.fill(Slot());
+        }
+
+        size_t TouchPointerTable::size() const
+        {
+          size_t used = 0;
+          for (const auto &slot : slots_)
+          {
+            used += slot.used ? 1 : 0;
+          }
+          return used;
+        }
+
+      }
+    }
+  }
+}
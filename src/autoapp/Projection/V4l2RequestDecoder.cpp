@@ -0,0 +1,1106 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef USE_FFMPEG_DRM
+
+#include <f1x/openauto/autoapp/Projection/V4l2RequestDecoder.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+#include <fcntl.h>
+#include <linux/media.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          int xioctl(int fd, unsigned long request, void *arg)
+          {
+            int ret;
+            do
+            {
+              ret = ioctl(fd, request, arg);
+            } while (ret < 0 && errno == EINTR);
+            return ret;
+          }
+
+          std::string fourcc(uint32_t format)
+          {
+            std::string name;
+            for (int i = 0; i < 4; i++)
+            {
+              name += static_cast<char>((format >> (8 * i)) & 0xff);
+            }
+            return name;
+          }
+
+          bool hasFormat(int fd, uint32_t type, uint32_t pixelFormat, std::string *seen = nullptr)
+          {
+            v4l2_fmtdesc desc = {};
+            desc.type = type;
+            for (desc.index = 0; xioctl(fd, VIDIOC_ENUM_FMT, &desc) == 0; desc.index++)
+            {
+              if (desc.pixelformat == pixelFormat)
+              {
+                return true;
+              }
+              if (seen)
+              {
+                *seen += (seen->empty() ? "" : " ") + fourcc(desc.pixelformat);
+              }
+            }
+            return false;
+          }
+
+          constexpr uint8_t cStartCode[3] = {0, 0, 1};
+          constexpr size_t cMinOutputBufferSize = 1024 * 1024;
+        }
+
+        V4l2RequestDecoder::CapturePool::~CapturePool()
+        {
+          for (auto &buffer : buffers)
+          {
+            if (buffer.fd >= 0)
+            {
+              close(buffer.fd);
+            }
+          }
+        }
+
+        V4l2RequestDecoder::V4l2RequestDecoder(size_t extraPictures)
+            : extraPictures_(extraPictures), videoFd_(-1), mediaFd_(-1), scalingMatrixControl_(false),
+              streaming_(false), codedWidth_(0), codedHeight_(0), maxNumRefFrames_(0), capturePitch_(0),
+              captureHeight_(0), nextOutput_(0), sequence_(0), awaitingIdr_(true), maxLongTermFrameIdxPlus1_(0),
+              spsControl_(), ppsControl_(), scalingControl_(), decodeControl_()
+        {
+        }
+
+        V4l2RequestDecoder::~V4l2RequestDecoder()
+        {
+          teardown();
+          if (videoFd_ >= 0)
+          {
+            close(videoFd_);
+          }
+          if (mediaFd_ >= 0)
+          {
+            close(mediaFd_);
+          }
+        }
+
+        const std::string &V4l2RequestDecoder::deviceName() const
+        {
+          return deviceName_;
+        }
+
+        bool V4l2RequestDecoder::awaitingIdr() const
+        {
+          return awaitingIdr_;
+        }
+
+        bool V4l2RequestDecoder::open()
+        {
+          if (videoFd_ >= 0)
+          {
+            return true;
+          }
+          if (!findDevice())
+          {
+            OPENAUTO_LOG(info) << "[V4l2RequestDecoder] No V4L2 stateless H.264 decoder found";
+            return false;
+          }
+
+          // The whole access unit goes into one request, slices with their
+          // start codes; the hardware parses the slice headers again itself
+          if (!setControl(V4L2_CID_STATELESS_H264_DECODE_MODE, V4L2_STATELESS_H264_DECODE_MODE_FRAME_BASED) ||
+              !setControl(V4L2_CID_STATELESS_H264_START_CODE, V4L2_STATELESS_H264_START_CODE_ANNEX_B))
+          {
+            OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] " << deviceName_
+                                  << " only decodes slice by slice, not supported";
+            close(videoFd_);
+            close(mediaFd_);
+            videoFd_ = -1;
+            mediaFd_ = -1;
+            return false;
+          }
+          scalingMatrixControl_ = hasControl(V4L2_CID_STATELESS_H264_SCALING_MATRIX);
+
+          OPENAUTO_LOG(info) << "[V4l2RequestDecoder] Using " << deviceName_;
+          return true;
+        }
+
+        bool V4l2RequestDecoder::findDevice()
+        {
+          for (size_t i = 0; i < cMaxDevices; i++)
+          {
+            const std::string path = "/dev/video" + std::to_string(i);
+            const int fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+            if (fd < 0)
+            {
+              continue;
+            }
+
+            v4l2_capability cap = {};
+            const uint32_t caps = xioctl(fd, VIDIOC_QUERYCAP, &cap) < 0 ? 0
+                                  : (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps
+                                                                               : cap.capabilities;
+            if ((caps & V4L2_CAP_VIDEO_M2M_MPLANE) && (caps & V4L2_CAP_STREAMING) &&
+                hasFormat(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_PIX_FMT_H264_SLICE) &&
+                findMediaDevice(reinterpret_cast<const char *>(cap.bus_info)))
+            {
+              videoFd_ = fd;
+              deviceName_ = path + " (" + reinterpret_cast<const char *>(cap.card) + ")";
+              return true;
+            }
+            close(fd);
+          }
+          return false;
+        }
+
+        bool V4l2RequestDecoder::findMediaDevice(const std::string &busInfo)
+        {
+          // Requests are allocated on the media device sharing the decoder's bus
+          for (size_t i = 0; i < cMaxDevices; i++)
+          {
+            const std::string path = "/dev/media" + std::to_string(i);
+            const int fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+            if (fd < 0)
+            {
+              continue;
+            }
+
+            media_device_info info = {};
+            if (xioctl(fd, MEDIA_IOC_DEVICE_INFO, &info) == 0 &&
+                busInfo == std::string(info.bus_info, strnlen(info.bus_info, sizeof(info.bus_info))))
+            {
+              mediaFd_ = fd;
+              return true;
+            }
+            close(fd);
+          }
+          return false;
+        }
+
+        bool V4l2RequestDecoder::setControl(uint32_t id, int32_t value)
+        {
+          v4l2_ext_control control = {};
+          control.id = id;
+          control.value = value;
+          v4l2_ext_controls controls = {};
+          controls.which = V4L2_CTRL_WHICH_CUR_VAL;
+          controls.count = 1;
+          controls.controls = &control;
+          return xioctl(videoFd_, VIDIOC_S_EXT_CTRLS, &controls) == 0;
+        }
+
+        bool V4l2RequestDecoder::hasControl(uint32_t id)
+        {
+          v4l2_query_ext_ctrl query = {};
+          query.id = id;
+          return xioctl(videoFd_, VIDIOC_QUERY_EXT_CTRL, &query) == 0;
+        }
+
+        bool V4l2RequestDecoder::configure(const H264Sps &sps)
+        {
+          teardown();
+
+          const uint32_t width = sps.codedWidth();
+          const uint32_t height = sps.codedHeight();
+
+          v4l2_format format = {};
+          format.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+          format.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_H264_SLICE;
+          format.fmt.pix_mp.width = width;
+          format.fmt.pix_mp.height = height;
+          format.fmt.pix_mp.field = V4L2_FIELD_NONE;
+          format.fmt.pix_mp.num_planes = 1;
+          format.fmt.pix_mp.plane_fmt[0].sizeimage =
+              static_cast<uint32_t>(std::max<size_t>(cMinOutputBufferSize, size_t(width) * height * 3 / 4));
+          if (xioctl(videoFd_, VIDIOC_S_FMT, &format) < 0)
+          {
+            OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] Bitstream format rejected: " << strerror(errno);
+            return false;
+          }
+
+          // The capture formats on offer depend on the SPS (bit depth, chroma)
+          v4l2_ext_control control = {};
+          control.id = V4L2_CID_STATELESS_H264_SPS;
+          control.size = sizeof(spsControl_);
+          control.ptr = &spsControl_;
+          v4l2_ext_controls controls = {};
+          controls.which = V4L2_CTRL_WHICH_CUR_VAL;
+          controls.count = 1;
+          controls.controls = &control;
+          if (xioctl(videoFd_, VIDIOC_S_EXT_CTRLS, &controls) < 0)
+          {
+            OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] SPS rejected: " << strerror(errno);
+            return false;
+          }
+
+          // Linear NV12 is what both the KMS plane and EGL import take
+          std::string offered;
+          if (!hasFormat(videoFd_, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, V4L2_PIX_FMT_NV12, &offered))
+          {
+            OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] No linear NV12 output, decoder offers: " << offered;
+            return false;
+          }
+          format = {};
+          format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+          format.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_NV12;
+          format.fmt.pix_mp.width = width;
+          format.fmt.pix_mp.height = height;
+          format.fmt.pix_mp.num_planes = 1;
+          if (xioctl(videoFd_, VIDIOC_S_FMT, &format) < 0 || format.fmt.pix_mp.pixelformat != V4L2_PIX_FMT_NV12 ||
+              format.fmt.pix_mp.num_planes != 1)
+          {
+            OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] NV12 picture format rejected";
+            return false;
+          }
+          capturePitch_ = format.fmt.pix_mp.plane_fmt[0].bytesperline;
+          captureHeight_ = format.fmt.pix_mp.height;
+
+          v4l2_requestbuffers request = {};
+          request.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+          request.memory = V4L2_MEMORY_MMAP;
+          request.count = cOutputBuffers;
+          if (xioctl(videoFd_, VIDIOC_REQBUFS, &request) < 0 || request.count < cOutputBuffers ||
+              !(request.capabilities & V4L2_BUF_CAP_SUPPORTS_REQUESTS))
+          {
+            OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] Bitstream buffers with requests unavailable";
+            teardown();
+            return false;
+          }
+          for (size_t i = 0; i < cOutputBuffers; i++)
+          {
+            v4l2_plane plane = {};
+            v4l2_buffer buffer = {};
+            buffer.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+            buffer.memory = V4L2_MEMORY_MMAP;
+            buffer.index = static_cast<uint32_t>(i);
+            buffer.m.planes = &plane;
+            buffer.length = 1;
+            if (xioctl(videoFd_, VIDIOC_QUERYBUF, &buffer) < 0)
+            {
+              teardown();
+              return false;
+            }
+            void *map = mmap(nullptr, plane.length, PROT_READ | PROT_WRITE, MAP_SHARED, videoFd_,
+                             plane.m.mem_offset);
+            int requestFd = -1;
+            if (map == MAP_FAILED || xioctl(mediaFd_, MEDIA_IOC_REQUEST_ALLOC, &requestFd) < 0)
+            {
+              OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] Bitstream buffer setup failed: " << strerror(errno);
+              if (map != MAP_FAILED)
+              {
+                munmap(map, plane.length);
+              }
+              teardown();
+              return false;
+            }
+            output_[i] = OutputBuffer{map, plane.length, requestFd};
+          }
+
+          // DPB, the picture being decoded and what the caller may hold
+          maxNumRefFrames_ = std::max<uint32_t>(sps.maxNumRefFrames, 1);
+          request = {};
+          request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+          request.memory = V4L2_MEMORY_MMAP;
+          request.count = static_cast<uint32_t>(maxNumRefFrames_ + 1 + extraPictures_);
+          if (xioctl(videoFd_, VIDIOC_REQBUFS, &request) < 0 || request.count == 0)
+          {
+            OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] Picture buffers unavailable: " << strerror(errno);
+            teardown();
+            return false;
+          }
+          pool_ = std::make_shared<CapturePool>();
+          for (uint32_t i = 0; i < request.count; i++)
+          {
+            v4l2_plane plane = {};
+            v4l2_buffer buffer = {};
+            buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+            buffer.memory = V4L2_MEMORY_MMAP;
+            buffer.index = i;
+            buffer.m.planes = &plane;
+            buffer.length = 1;
+            v4l2_exportbuffer exported = {};
+            exported.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+            exported.index = i;
+            exported.flags = O_RDONLY | O_CLOEXEC;
+            if (xioctl(videoFd_, VIDIOC_QUERYBUF, &buffer) < 0 || xioctl(videoFd_, VIDIOC_EXPBUF, &exported) < 0)
+            {
+              OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] Picture buffer export failed: " << strerror(errno);
+              teardown();
+              return false;
+            }
+            CaptureBuffer capture;
+            capture.fd = exported.fd;
+            capture.size = plane.length;
+            pool_->buffers.push_back(capture);
+          }
+
+          int type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+          int captureType = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+          if (xioctl(videoFd_, VIDIOC_STREAMON, &type) < 0 || xioctl(videoFd_, VIDIOC_STREAMON, &captureType) < 0)
+          {
+            OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] Stream on failed: " << strerror(errno);
+            teardown();
+            return false;
+          }
+
+          streaming_ = true;
+          codedWidth_ = width;
+          codedHeight_ = height;
+          OPENAUTO_LOG(info) << "[V4l2RequestDecoder] Decoding " << sps.width() << "x" << sps.height() << " into "
+                             << pool_->buffers.size() << " NV12 buffers, pitch " << capturePitch_;
+          return true;
+        }
+
+        void V4l2RequestDecoder::teardown()
+        {
+          clearDpb();
+          awaitingIdr_ = true;
+          if (videoFd_ < 0)
+          {
+            return;
+          }
+
+          if (streaming_)
+          {
+            int type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+            xioctl(videoFd_, VIDIOC_STREAMOFF, &type);
+            type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+            xioctl(videoFd_, VIDIOC_STREAMOFF, &type);
+            streaming_ = false;
+          }
+
+          for (auto &output : output_)
+          {
+            if (output.map)
+            {
+              munmap(output.map, output.length);
+            }
+            if (output.requestFd >= 0)
+            {
+              close(output.requestFd);
+            }
+            output = OutputBuffer();
+          }
+
+          // Pictures still on screen keep their DMA-BUFs; the kernel orphans
+          // the buffers instead of freeing them under the display
+          for (const uint32_t type : {V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE})
+          {
+            v4l2_requestbuffers request = {};
+            request.type = type;
+            request.memory = V4L2_MEMORY_MMAP;
+            xioctl(videoFd_, VIDIOC_REQBUFS, &request);
+          }
+          pool_.reset();
+          codedWidth_ = 0;
+          codedHeight_ = 0;
+          maxNumRefFrames_ = 0;
+        }
+
+        void V4l2RequestDecoder::flush()
+        {
+          parser_.reset();
+          clearDpb();
+          poc_ = PocState();
+          awaitingIdr_ = true;
+        }
+
+        int V4l2RequestDecoder::takeCaptureBuffer()
+        {
+          std::unique_lock<std::mutex> lock(pool_->mutex);
+          int index = -1;
+          const auto findFree = [this, &index]()
+          {
+            for (size_t i = 0; i < pool_->buffers.size(); i++)
+            {
+              const CaptureBuffer &buffer = pool_->buffers[i];
+              if (!buffer.queued && !buffer.reference && !buffer.displayed)
+              {
+                index = static_cast<int>(i);
+                return true;
+              }
+            }
+            return false;
+          };
+
+          // The display gives its oldest picture back at the next vblank
+          if (!pool_->released.wait_for(lock, std::chrono::milliseconds(cBufferWaitMs), findFree))
+          {
+            return -1;
+          }
+          pool_->buffers[index].queued = true;
+          return index;
+        }
+
+        V4l2RequestDecoder::Status V4l2RequestDecoder::decode(const uint8_t *data, size_t size, int64_t pts,
+                                                              const PictureHandler &handler)
+        {
+          if (videoFd_ < 0)
+          {
+            return Status::Unsupported;
+          }
+
+          const std::vector<H264NalUnit> units = H264HeaderParser::splitAnnexB(data, size);
+          const H264NalUnit *first = nullptr;
+          size_t sliceBytes = 0;
+          for (const auto &unit : units)
+          {
+            if (unit.type == H264HeaderParser::cNalSps && !parser_.parseSps(unit))
+            {
+              OPENAUTO_LOG_EVERY_MS(warning, 1000) << "[V4l2RequestDecoder] Unusable SPS ignored";
+            }
+            else if (unit.type == H264HeaderParser::cNalPps && !parser_.parsePps(unit))
+            {
+              OPENAUTO_LOG_EVERY_MS(warning, 1000) << "[V4l2RequestDecoder] Unusable PPS ignored";
+            }
+            else if (unit.type == H264HeaderParser::cNalSlice || unit.type == H264HeaderParser::cNalIdr)
+            {
+              first = first ? first : &unit;
+              sliceBytes += sizeof(cStartCode) + unit.size;
+            }
+          }
+          if (!first)
+          {
+            return Status::NoPicture;
+          }
+
+          H264SliceHeader slice;
+          if (!parser_.parseSliceHeader(*first, slice))
+          {
+            OPENAUTO_LOG_EVERY_MS(warning, 1000) << "[V4l2RequestDecoder] Undecodable slice header (x"
+                                                 << OPENAUTO_LOG_OCCURRENCES << ")";
+            awaitingIdr_ = awaitingIdr_ || first->refIdc != 0;
+            return Status::Dropped;
+          }
+          const H264Pps &pps = *parser_.pps(slice.ppsId);
+          const H264Sps &sps = *parser_.sps(pps.spsId);
+          if (!sps.frameMbsOnly || sps.chromaFormatIdc != 1 || sps.bitDepthLumaMinus8 != 0 ||
+              sps.bitDepthChromaMinus8 != 0)
+          {
+            OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] Interlaced, 4:2:2/4:4:4 or high bit depth stream, "
+                                     "not supported";
+            return Status::Unsupported;
+          }
+
+          // Fill the SPS control first: configure() passes it to the driver
+          fillControls(sps, pps, slice, PictureOrder());
+          if (!streaming_ || sps.codedWidth() != codedWidth_ || sps.codedHeight() != codedHeight_ ||
+              std::max<uint32_t>(sps.maxNumRefFrames, 1) > maxNumRefFrames_)
+          {
+            if (!configure(sps))
+            {
+              return Status::Unsupported;
+            }
+          }
+
+          if (awaitingIdr_ && !slice.idr())
+          {
+            return Status::Dropped;
+          }
+          awaitingIdr_ = false;
+
+          OutputBuffer &output = output_[nextOutput_];
+          if (sliceBytes > output.length)
+          {
+            OPENAUTO_LOG_EVERY_MS(warning, 1000) << "[V4l2RequestDecoder] Access unit of " << sliceBytes
+                                                 << " bytes does not fit the bitstream buffer";
+            awaitingIdr_ = slice.nalRefIdc != 0;
+            return Status::Dropped;
+          }
+          uint8_t *bitstream = static_cast<uint8_t *>(output.map);
+          for (const auto &unit : units)
+          {
+            if (unit.type == H264HeaderParser::cNalSlice || unit.type == H264HeaderParser::cNalIdr)
+            {
+              std::memcpy(bitstream, cStartCode, sizeof(cStartCode));
+              std::memcpy(bitstream + sizeof(cStartCode), unit.data, unit.size);
+              bitstream += sizeof(cStartCode) + unit.size;
+            }
+          }
+
+          int capture = takeCaptureBuffer();
+          if (capture < 0)
+          {
+            OPENAUTO_LOG_EVERY_MS(warning, 1000) << "[V4l2RequestDecoder] No free picture buffer, frame dropped (x"
+                                                 << OPENAUTO_LOG_OCCURRENCES << ")";
+            awaitingIdr_ = slice.nalRefIdc != 0;
+            return Status::Dropped;
+          }
+
+          const PictureOrder order = computePoc(sps, slice);
+          fillControls(sps, pps, slice, order);
+          // Unique per picture; the DPB refers to pictures by this timestamp
+          const uint64_t timestampNs = ++sequence_ * 1000;
+          const size_t outputIndex = nextOutput_;
+          nextOutput_ = (nextOutput_ + 1) % cOutputBuffers;
+
+          const bool decoded = submit(outputIndex, sliceBytes, timestampNs, capture);
+          if (capture < 0)
+          {
+            // The driver state is unknown; rebuild it at the next IDR
+            OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] Decode request failed, restarting the decoder";
+            teardown();
+            return Status::Dropped;
+          }
+
+          // A picture decoded with errors still takes its place in the DPB, so
+          // frame numbers and POCs stay consistent for the pictures after it
+          const bool mmco5 = slice.nalRefIdc != 0 && markReferences(sps, slice, order, timestampNs, capture);
+          updatePocState(slice, order, mmco5);
+
+          std::shared_ptr<CapturePool> pool = pool_;
+          if (!decoded)
+          {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->buffers[capture].queued = false;
+            OPENAUTO_LOG_EVERY_MS(warning, 1000) << "[V4l2RequestDecoder] Picture decoded with errors (x"
+                                                 << OPENAUTO_LOG_OCCURRENCES << ")";
+            return Status::Dropped;
+          }
+
+          Picture picture;
+          {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            CaptureBuffer &buffer = pool->buffers[capture];
+            buffer.queued = false;
+            buffer.displayed = true;
+            picture.fd = buffer.fd;
+            picture.size = buffer.size;
+          }
+          picture.width = sps.width();
+          picture.height = sps.height();
+          picture.pitch = capturePitch_;
+          picture.chromaOffset = capturePitch_ * captureHeight_;
+          picture.fullRange = sps.fullRange;
+          picture.matrixCoefficients = sps.matrixCoefficients;
+          picture.pts = pts;
+          picture.hold = std::shared_ptr<void>(pool.get(), [pool, capture](void *)
+                                               {
+                                                 std::lock_guard<std::mutex> lock(pool->mutex);
+                                                 pool->buffers[capture].displayed = false;
+                                                 pool->released.notify_all(); });
+          handler(picture);
+          return Status::Decoded;
+        }
+
+        bool V4l2RequestDecoder::submit(size_t outputIndex, size_t bytes, uint64_t timestampNs, int &captureIndex)
+        {
+          const OutputBuffer &output = output_[outputIndex];
+
+          v4l2_plane plane = {};
+          v4l2_buffer buffer = {};
+          buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+          buffer.memory = V4L2_MEMORY_MMAP;
+          buffer.index = static_cast<uint32_t>(captureIndex);
+          buffer.m.planes = &plane;
+          buffer.length = 1;
+          if (xioctl(videoFd_, VIDIOC_QBUF, &buffer) < 0)
+          {
+            OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] Queueing picture buffer failed: " << strerror(errno);
+            captureIndex = -1;
+            return false;
+          }
+
+          v4l2_ext_control controls[4] = {};
+          uint32_t count = 0;
+          controls[count].id = V4L2_CID_STATELESS_H264_SPS;
+          controls[count].size = sizeof(spsControl_);
+          controls[count++].ptr = &spsControl_;
+          controls[count].id = V4L2_CID_STATELESS_H264_PPS;
+          controls[count].size = sizeof(ppsControl_);
+          controls[count++].ptr = &ppsControl_;
+          if (scalingMatrixControl_)
+          {
+            controls[count].id = V4L2_CID_STATELESS_H264_SCALING_MATRIX;
+            controls[count].size = sizeof(scalingControl_);
+            controls[count++].ptr = &scalingControl_;
+          }
+          controls[count].id = V4L2_CID_STATELESS_H264_DECODE_PARAMS;
+          controls[count].size = sizeof(decodeControl_);
+          controls[count++].ptr = &decodeControl_;
+
+          v4l2_ext_controls request = {};
+          request.which = V4L2_CTRL_WHICH_REQUEST_VAL;
+          request.request_fd = output.requestFd;
+          request.count = count;
+          request.controls = controls;
+
+          plane = {};
+          plane.bytesused = static_cast<uint32_t>(bytes);
+          buffer = {};
+          buffer.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+          buffer.memory = V4L2_MEMORY_MMAP;
+          buffer.index = static_cast<uint32_t>(outputIndex);
+          buffer.m.planes = &plane;
+          buffer.length = 1;
+          buffer.flags = V4L2_BUF_FLAG_REQUEST_FD;
+          buffer.request_fd = output.requestFd;
+          buffer.timestamp.tv_sec = static_cast<time_t>(timestampNs / 1000000000);
+          buffer.timestamp.tv_usec = static_cast<suseconds_t>((timestampNs % 1000000000) / 1000);
+
+          int requestFd = output.requestFd;
+          if (xioctl(videoFd_, VIDIOC_S_EXT_CTRLS, &request) < 0 || xioctl(videoFd_, VIDIOC_QBUF, &buffer) < 0 ||
+              xioctl(requestFd, MEDIA_REQUEST_IOC_QUEUE, nullptr) < 0)
+          {
+            OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] Submitting request failed: " << strerror(errno);
+            captureIndex = -1;
+            return false;
+          }
+
+          pollfd done = {requestFd, POLLPRI, 0};
+          int ready;
+          do
+          {
+            ready = poll(&done, 1, cDecodeTimeoutMs);
+          } while (ready < 0 && errno == EINTR);
+          if (ready <= 0)
+          {
+            OPENAUTO_LOG(warning) << "[V4l2RequestDecoder] Decoder did not complete the request";
+            captureIndex = -1;
+            return false;
+          }
+
+          plane = {};
+          buffer = {};
+          buffer.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+          buffer.memory = V4L2_MEMORY_MMAP;
+          buffer.m.planes = &plane;
+          buffer.length = 1;
+          const bool outputDone = xioctl(videoFd_, VIDIOC_DQBUF, &buffer) == 0;
+
+          plane = {};
+          buffer = {};
+          buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+          buffer.memory = V4L2_MEMORY_MMAP;
+          buffer.m.planes = &plane;
+          buffer.length = 1;
+          bool captureDone = xioctl(videoFd_, VIDIOC_DQBUF, &buffer) == 0;
+          if (!captureDone && errno == EAGAIN)
+          {
+            // The request can complete just before the picture is marked done
+            pollfd picture = {videoFd_, POLLIN, 0};
+            captureDone = poll(&picture, 1, cDecodeTimeoutMs) > 0 && xioctl(videoFd_, VIDIOC_DQBUF, &buffer) == 0;
+          }
+          xioctl(requestFd, MEDIA_REQUEST_IOC_REINIT, nullptr);
+
+          if (!outputDone || !captureDone || buffer.index != static_cast<uint32_t>(captureIndex))
+          {
+            captureIndex = -1;
+            return false;
+          }
+          return !(buffer.flags & V4L2_BUF_FLAG_ERROR);
+        }
+
+        V4l2RequestDecoder::PictureOrder V4l2RequestDecoder::computePoc(const H264Sps &sps,
+                                                                        const H264SliceHeader &slice) const
+        {
+          PictureOrder order;
+          if (sps.picOrderCntType == 0)
+          {
+            int32_t prevPocMsb = poc_.prevPocMsb;
+            int32_t prevPocLsb = static_cast<int32_t>(poc_.prevPocLsb);
+            if (slice.idr())
+            {
+              prevPocMsb = 0;
+              prevPocLsb = 0;
+            }
+            else if (poc_.prevMmco5Reference)
+            {
+              prevPocMsb = 0;
+              prevPocLsb = poc_.prevTopPoc;
+            }
+
+            const int32_t maxPocLsb = 1 << (sps.log2MaxPicOrderCntLsbMinus4 + 4);
+            const int32_t pocLsb = static_cast<int32_t>(slice.picOrderCntLsb);
+            order.pocMsb = prevPocMsb;
+            if (pocLsb < prevPocLsb && prevPocLsb - pocLsb >= maxPocLsb / 2)
+            {
+              order.pocMsb = prevPocMsb + maxPocLsb;
+            }
+            else if (pocLsb > prevPocLsb && pocLsb - prevPocLsb > maxPocLsb / 2)
+            {
+              order.pocMsb = prevPocMsb - maxPocLsb;
+            }
+            order.topPoc = order.pocMsb + pocLsb;
+            order.bottomPoc = order.topPoc + slice.deltaPicOrderCntBottom;
+            return order;
+          }
+
+          const int32_t maxFrameNum = static_cast<int32_t>(sps.maxFrameNum());
+          const int32_t prevFrameNumOffset = poc_.prevMmco5 ? 0 : poc_.prevFrameNumOffset;
+          if (!slice.idr())
+          {
+            order.frameNumOffset =
+                poc_.prevFrameNum > slice.frameNum ? prevFrameNumOffset + maxFrameNum : prevFrameNumOffset;
+          }
+          const int32_t frameNum = static_cast<int32_t>(slice.frameNum);
+
+          if (sps.picOrderCntType == 1)
+          {
+            const int32_t cycle = static_cast<int32_t>(sps.numRefFramesInPicOrderCntCycle);
+            int32_t absFrameNum = cycle != 0 ? order.frameNumOffset + frameNum : 0;
+            if (slice.nalRefIdc == 0 && absFrameNum > 0)
+            {
+              absFrameNum--;
+            }
+
+            int32_t expectedPoc = 0;
+            if (absFrameNum > 0)
+            {
+              int32_t expectedDeltaPerCycle = 0;
+              for (int32_t i = 0; i < cycle; i++)
+              {
+                expectedDeltaPerCycle += sps.offsetForRefFrame[i];
+              }
+              const int32_t cycleCount = (absFrameNum - 1) / cycle;
+              const int32_t inCycle = (absFrameNum - 1) % cycle;
+              expectedPoc = cycleCount * expectedDeltaPerCycle;
+              for (int32_t i = 0; i <= inCycle; i++)
+              {
+                expectedPoc += sps.offsetForRefFrame[i];
+              }
+            }
+            if (slice.nalRefIdc == 0)
+            {
+              expectedPoc += sps.offsetForNonRefPic;
+            }
+            order.topPoc = expectedPoc + slice.deltaPicOrderCnt[0];
+            order.bottomPoc = order.topPoc + sps.offsetForTopToBottomField + slice.deltaPicOrderCnt[1];
+            return order;
+          }
+
+          // Type 2: output order is decode order
+          int32_t poc = 0;
+          if (!slice.idr())
+          {
+            poc = 2 * (order.frameNumOffset + frameNum) - (slice.nalRefIdc == 0 ? 1 : 0);
+          }
+          order.topPoc = poc;
+          order.bottomPoc = poc;
+          return order;
+        }
+
+        void V4l2RequestDecoder::updatePocState(const H264SliceHeader &slice, const PictureOrder &order, bool mmco5)
+        {
+          // After MMCO 5 the picture counts as frame_num 0 with its POC rebased to 0
+          poc_.prevFrameNum = mmco5 ? 0 : slice.frameNum;
+          poc_.prevFrameNumOffset = order.frameNumOffset;
+          poc_.prevMmco5 = mmco5;
+          if (slice.nalRefIdc != 0)
+          {
+            poc_.prevMmco5Reference = mmco5;
+            poc_.prevTopPoc = order.topPoc - std::min(order.topPoc, order.bottomPoc);
+            poc_.prevPocMsb = order.pocMsb;
+            poc_.prevPocLsb = slice.picOrderCntLsb;
+          }
+        }
+
+        void V4l2RequestDecoder::fillControls(const H264Sps &sps, const H264Pps &pps, const H264SliceHeader &slice,
+                                              const PictureOrder &order)
+        {
+          spsControl_ = {};
+          spsControl_.profile_idc = sps.profileIdc;
+          spsControl_.constraint_set_flags = sps.constraintSetFlags;
+          spsControl_.level_idc = sps.levelIdc;
+          spsControl_.seq_parameter_set_id = static_cast<uint8_t>(sps.id);
+          spsControl_.chroma_format_idc = static_cast<uint8_t>(sps.chromaFormatIdc);
+          spsControl_.bit_depth_luma_minus8 = static_cast<uint8_t>(sps.bitDepthLumaMinus8);
+          spsControl_.bit_depth_chroma_minus8 = static_cast<uint8_t>(sps.bitDepthChromaMinus8);
+          spsControl_.log2_max_frame_num_minus4 = static_cast<uint8_t>(sps.log2MaxFrameNumMinus4);
+          spsControl_.pic_order_cnt_type = static_cast<uint8_t>(sps.picOrderCntType);
+          spsControl_.log2_max_pic_order_cnt_lsb_minus4 = static_cast<uint8_t>(sps.log2MaxPicOrderCntLsbMinus4);
+          spsControl_.max_num_ref_frames = static_cast<uint8_t>(sps.maxNumRefFrames);
+          spsControl_.num_ref_frames_in_pic_order_cnt_cycle = static_cast<uint8_t>(sps.numRefFramesInPicOrderCntCycle);
+          std::copy(std::begin(sps.offsetForRefFrame), std::end(sps.offsetForRefFrame),
+                    std::begin(spsControl_.offset_for_ref_frame));
+          spsControl_.offset_for_non_ref_pic = sps.offsetForNonRefPic;
+          spsControl_.offset_for_top_to_bottom_field = sps.offsetForTopToBottomField;
+          spsControl_.pic_width_in_mbs_minus1 = static_cast<uint16_t>(sps.picWidthInMbsMinus1);
+          spsControl_.pic_height_in_map_units_minus1 = static_cast<uint16_t>(sps.picHeightInMapUnitsMinus1);
+          spsControl_.flags = (sps.separateColourPlane ? V4L2_H264_SPS_FLAG_SEPARATE_COLOUR_PLANE : 0) |
+                              (sps.qpprimeYZeroTransformBypass ? V4L2_H264_SPS_FLAG_QPPRIME_Y_ZERO_TRANSFORM_BYPASS : 0) |
+                              (sps.deltaPicOrderAlwaysZero ? V4L2_H264_SPS_FLAG_DELTA_PIC_ORDER_ALWAYS_ZERO : 0) |
+                              (sps.gapsInFrameNumAllowed ? V4L2_H264_SPS_FLAG_GAPS_IN_FRAME_NUM_VALUE_ALLOWED : 0) |
+                              (sps.frameMbsOnly ? V4L2_H264_SPS_FLAG_FRAME_MBS_ONLY : 0) |
+                              (sps.mbAdaptiveFrameField ? V4L2_H264_SPS_FLAG_MB_ADAPTIVE_FRAME_FIELD : 0) |
+                              (sps.direct8x8Inference ? V4L2_H264_SPS_FLAG_DIRECT_8X8_INFERENCE : 0);
+
+          ppsControl_ = {};
+          ppsControl_.pic_parameter_set_id = static_cast<uint8_t>(pps.id);
+          ppsControl_.seq_parameter_set_id = static_cast<uint8_t>(pps.spsId);
+          ppsControl_.num_slice_groups_minus1 = static_cast<uint8_t>(pps.numSliceGroupsMinus1);
+          ppsControl_.num_ref_idx_l0_default_active_minus1 = static_cast<uint8_t>(pps.numRefIdxL0DefaultActiveMinus1);
+          ppsControl_.num_ref_idx_l1_default_active_minus1 = static_cast<uint8_t>(pps.numRefIdxL1DefaultActiveMinus1);
+          ppsControl_.weighted_bipred_idc = static_cast<uint8_t>(pps.weightedBipredIdc);
+          ppsControl_.pic_init_qp_minus26 = static_cast<int8_t>(pps.picInitQpMinus26);
+          ppsControl_.pic_init_qs_minus26 = static_cast<int8_t>(pps.picInitQsMinus26);
+          ppsControl_.chroma_qp_index_offset = static_cast<int8_t>(pps.chromaQpIndexOffset);
+          ppsControl_.second_chroma_qp_index_offset = static_cast<int8_t>(pps.secondChromaQpIndexOffset);
+          ppsControl_.flags =
+              (pps.entropyCodingMode ? V4L2_H264_PPS_FLAG_ENTROPY_CODING_MODE : 0) |
+              (pps.bottomFieldPicOrderInFramePresent ? V4L2_H264_PPS_FLAG_BOTTOM_FIELD_PIC_ORDER_IN_FRAME_PRESENT : 0) |
+              (pps.weightedPred ? V4L2_H264_PPS_FLAG_WEIGHTED_PRED : 0) |
+              (pps.deblockingFilterControlPresent ? V4L2_H264_PPS_FLAG_DEBLOCKING_FILTER_CONTROL_PRESENT : 0) |
+              (pps.constrainedIntraPred ? V4L2_H264_PPS_FLAG_CONSTRAINED_INTRA_PRED : 0) |
+              (pps.redundantPicCntPresent ? V4L2_H264_PPS_FLAG_REDUNDANT_PIC_CNT_PRESENT : 0) |
+              (pps.transform8x8Mode ? V4L2_H264_PPS_FLAG_TRANSFORM_8X8_MODE : 0) |
+              (pps.scalingMatrixPresent && scalingMatrixControl_ ? V4L2_H264_PPS_FLAG_SCALING_MATRIX_PRESENT : 0);
+
+          std::memcpy(scalingControl_.scaling_list_4x4, pps.scalingList4x4, sizeof(scalingControl_.scaling_list_4x4));
+          std::memcpy(scalingControl_.scaling_list_8x8, pps.scalingList8x8, sizeof(scalingControl_.scaling_list_8x8));
+
+          decodeControl_ = {};
+          for (size_t i = 0; i < dpb_.size(); i++)
+          {
+            const DpbEntry &entry = dpb_[i];
+            if (!entry.used)
+            {
+              continue;
+            }
+            v4l2_h264_dpb_entry &out = decodeControl_.dpb[i];
+            out.reference_ts = entry.timestampNs;
+            out.pic_num = entry.longTerm ? entry.longTermFrameIdx
+                                         : static_cast<uint32_t>(frameNumWrap(entry, slice.frameNum, sps.maxFrameNum()));
+            out.frame_num = static_cast<uint16_t>(entry.longTerm ? entry.longTermFrameIdx : entry.frameNum);
+            out.fields = V4L2_H264_FRAME_REF;
+            out.top_field_order_cnt = entry.topPoc;
+            out.bottom_field_order_cnt = entry.bottomPoc;
+            out.flags = V4L2_H264_DPB_ENTRY_FLAG_VALID | V4L2_H264_DPB_ENTRY_FLAG_ACTIVE |
+                        (entry.longTerm ? V4L2_H264_DPB_ENTRY_FLAG_LONG_TERM : 0);
+          }
+          decodeControl_.nal_ref_idc = slice.nalRefIdc;
+          decodeControl_.frame_num = static_cast<uint16_t>(slice.frameNum);
+          decodeControl_.top_field_order_cnt = order.topPoc;
+          decodeControl_.bottom_field_order_cnt = order.bottomPoc;
+          decodeControl_.idr_pic_id = static_cast<uint16_t>(slice.idrPicId);
+          decodeControl_.pic_order_cnt_lsb = static_cast<uint16_t>(slice.picOrderCntLsb);
+          decodeControl_.delta_pic_order_cnt_bottom = slice.deltaPicOrderCntBottom;
+          decodeControl_.delta_pic_order_cnt0 = slice.deltaPicOrderCnt[0];
+          decodeControl_.delta_pic_order_cnt1 = slice.deltaPicOrderCnt[1];
+          decodeControl_.dec_ref_pic_marking_bit_size = slice.decRefPicMarkingBitSize;
+          decodeControl_.pic_order_cnt_bit_size = slice.picOrderCntBitSize;
+          decodeControl_.slice_group_change_cycle = slice.sliceGroupChangeCycle;
+          decodeControl_.flags =
+              (slice.idr() ? V4L2_H264_DECODE_PARAM_FLAG_IDR_PIC : 0) |
+              (slice.sliceType == H264SliceHeader::cSliceP || slice.sliceType == H264SliceHeader::cSliceSp
+                   ? V4L2_H264_DECODE_PARAM_FLAG_PFRAME
+                   : 0) |
+              (slice.sliceType == H264SliceHeader::cSliceB ? V4L2_H264_DECODE_PARAM_FLAG_BFRAME : 0);
+        }
+
+        int32_t V4l2RequestDecoder::frameNumWrap(const DpbEntry &entry, uint32_t currentFrameNum, uint32_t maxFrameNum)
+        {
+          return entry.frameNum > currentFrameNum ? static_cast<int32_t>(entry.frameNum) - static_cast<int32_t>(maxFrameNum)
+                                                  : static_cast<int32_t>(entry.frameNum);
+        }
+
+        void V4l2RequestDecoder::dropReference(DpbEntry &entry)
+        {
+          if (entry.used && entry.buffer >= 0 && pool_)
+          {
+            std::lock_guard<std::mutex> lock(pool_->mutex);
+            pool_->buffers[entry.buffer].reference = false;
+            pool_->released.notify_all();
+          }
+          entry = DpbEntry();
+        }
+
+        void V4l2RequestDecoder::clearDpb()
+        {
+          for (auto &entry : dpb_)
+          {
+            dropReference(entry);
+          }
+          maxLongTermFrameIdxPlus1_ = 0;
+        }
+
+        bool V4l2RequestDecoder::markReferences(const H264Sps &sps, const H264SliceHeader &slice, PictureOrder order,
+                                                uint64_t timestampNs, int buffer)
+        {
+          const uint32_t maxFrameNum = sps.maxFrameNum();
+          const int32_t currPicNum = static_cast<int32_t>(slice.frameNum);
+          bool mmco5 = false;
+          bool longTerm = false;
+          uint32_t longTermFrameIdx = 0;
+
+          const auto shortTerm = [this, &slice, maxFrameNum](int32_t picNum) -> DpbEntry *
+          {
+            for (auto &entry : dpb_)
+            {
+              if (entry.used && !entry.longTerm && frameNumWrap(entry, slice.frameNum, maxFrameNum) == picNum)
+              {
+                return &entry;
+              }
+            }
+            return nullptr;
+          };
+          const auto dropLongTerm = [this](uint32_t idx, const DpbEntry *keep)
+          {
+            for (auto &entry : dpb_)
+            {
+              if (entry.used && entry.longTerm && entry.longTermFrameIdx == idx && &entry != keep)
+              {
+                dropReference(entry);
+              }
+            }
+          };
+
+          if (slice.idr())
+          {
+            clearDpb();
+            longTerm = slice.longTermReference;
+            maxLongTermFrameIdxPlus1_ = longTerm ? 1 : 0;
+          }
+          else if (slice.adaptiveRefPicMarking)
+          {
+            for (const auto &op : slice.memoryManagementOps)
+            {
+              switch (op.operation)
+              {
+              case 1:
+                if (DpbEntry *entry = shortTerm(currPicNum - static_cast<int32_t>(op.differenceOfPicNumsMinus1 + 1)))
+                {
+                  dropReference(*entry);
+                }
+                break;
+              case 2:
+                for (auto &entry : dpb_)
+                {
+                  if (entry.used && entry.longTerm && entry.longTermFrameIdx == op.longTermPicNum)
+                  {
+                    dropReference(entry);
+                  }
+                }
+                break;
+              case 3:
+                if (DpbEntry *entry = shortTerm(currPicNum - static_cast<int32_t>(op.differenceOfPicNumsMinus1 + 1)))
+                {
+                  dropLongTerm(op.longTermFrameIdx, entry);
+                  entry->longTerm = true;
+                  entry->longTermFrameIdx = op.longTermFrameIdx;
+                }
+                break;
+              case 4:
+                maxLongTermFrameIdxPlus1_ = op.maxLongTermFrameIdxPlus1;
+                for (auto &entry : dpb_)
+                {
+                  if (entry.used && entry.longTerm && entry.longTermFrameIdx >= maxLongTermFrameIdxPlus1_)
+                  {
+                    dropReference(entry);
+                  }
+                }
+                break;
+              case 5:
+                clearDpb();
+                mmco5 = true;
+                break;
+              case 6:
+                dropLongTerm(op.longTermFrameIdx, nullptr);
+                longTerm = true;
+                longTermFrameIdx = op.longTermFrameIdx;
+                break;
+              default:
+                break;
+              }
+            }
+          }
+
+          // Sliding window (8.2.5.3), also the backstop for streams that never
+          // free enough references themselves
+          const uint32_t maxReferences = std::min<uint32_t>(maxNumRefFrames_, V4L2_H264_NUM_DPB_ENTRIES - 1);
+          while (true)
+          {
+            uint32_t used = 0;
+            DpbEntry *oldest = nullptr;
+            for (auto &entry : dpb_)
+            {
+              if (!entry.used)
+              {
+                continue;
+              }
+              used++;
+              if (!entry.longTerm && (!oldest || frameNumWrap(entry, slice.frameNum, maxFrameNum) <
+                                                     frameNumWrap(*oldest, slice.frameNum, maxFrameNum)))
+              {
+                oldest = &entry;
+              }
+            }
+            if (used < maxReferences || !oldest)
+            {
+              break;
+            }
+            dropReference(*oldest);
+          }
+
+          auto slot = std::find_if(dpb_.begin(), dpb_.end(), [](const DpbEntry &entry)
+                                   { return !entry.used; });
+          if (slot == dpb_.end())
+          {
+            // Only long-term frames left and no room; the oldest index goes
+            slot = dpb_.begin();
+            dropReference(*slot);
+          }
+
+          if (mmco5)
+          {
+            const int32_t tempPoc = std::min(order.topPoc, order.bottomPoc);
+            order.topPoc -= tempPoc;
+            order.bottomPoc -= tempPoc;
+          }
+          slot->used = true;
+          slot->longTerm = longTerm;
+          slot->longTermFrameIdx = longTermFrameIdx;
+          slot->frameNum = mmco5 ? 0 : slice.frameNum;
+          slot->topPoc = order.topPoc;
+          slot->bottomPoc = order.bottomPoc;
+          slot->timestampNs = timestampNs;
+          slot->buffer = buffer;
+          {
+            std::lock_guard<std::mutex> lock(pool_->mutex);
+            pool_->buffers[buffer].reference = true;
+          }
+          return mmco5;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
+
+#endif // USE_FFMPEG_DRM
@@ -0,0 +1,304 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/autoapp/Projection/VideoBackendProbe.hpp>
+#include <f1x/openauto/autoapp/Projection/H264TestStream.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#ifdef USE_FFMPEG_DRM
+#include <f1x/openauto/autoapp/Projection/FFmpegDrmVideoOutput.hpp>
+#endif
+#ifdef USE_GSTREAMER
+#include <f1x/openauto/autoapp/Projection/GstVideoOutput.hpp>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          typedef std::chrono::steady_clock Clock;
+
+          // Waits until @p frames pictures came out of the decoder. Gives up once
+          // none came out for @p timeout.
+          bool waitForFrames(uint64_t frames, std::chrono::milliseconds timeout)
+          {
+            const auto &telemetry = VideoTelemetry::instance();
+            uint64_t seen = telemetry.framesDisplayed();
+            auto deadline = Clock::now() + timeout;
+            while (seen < frames)
+            {
+              if (Clock::now() >= deadline)
+              {
+                return false;
+              }
+              std::this_thread::sleep_for(std::chrono::microseconds(200));
+              const uint64_t now = telemetry.framesDisplayed();
+              if (now != seen)
+              {
+                seen = now;
+                deadline = Clock::now() + timeout;
+              }
+            }
+            return true;
+          }
+        }
+
+        std::vector<VideoBackend> VideoBackendProbe::compiledBackends()
+        {
+          std::vector<VideoBackend> backends;
+#ifdef USE_FFMPEG_DRM
+          backends.push_back(VideoBackend::V4l2Request);
+          backends.push_back(VideoBackend::FFmpegDrm);
+#endif
+#ifdef USE_GSTREAMER
+          backends.push_back(VideoBackend::GStreamer);
+#endif
+#ifdef USE_OMX
+          backends.push_back(VideoBackend::Omx);
+#endif
+          backends.push_back(VideoBackend::Qt);
+          return backends;
+        }
+
+        std::string VideoBackendProbe::name(VideoBackend backend)
+        {
+          switch (backend)
+          {
+          case VideoBackend::V4l2Request:
+            return "v4l2-request";
+          case VideoBackend::FFmpegDrm:
+            return "ffmpeg-drm";
+          case VideoBackend::GStreamer:
+            return "gstreamer";
+          case VideoBackend::Omx:
+            return "omx";
+          case VideoBackend::Qt:
+            break;
+          }
+          return "qt";
+        }
+
+        bool VideoBackendProbe::parse(const std::string &name, VideoBackend &backend)
+        {
+          for (const VideoBackend candidate : {VideoBackend::V4l2Request, VideoBackend::FFmpegDrm,
+                                               VideoBackend::GStreamer, VideoBackend::Omx, VideoBackend::Qt})
+          {
+            if (name == VideoBackendProbe::name(candidate))
+            {
+              backend = candidate;
+              return true;
+            }
+          }
+          return false;
+        }
+
+        bool VideoBackendProbe::stored(const configuration::IConfiguration &configuration, VideoBackend &backend)
+        {
+          // A choice made by a build with other backends does not count
+          const auto backends = compiledBackends();
+          return parse(configuration.getVideoBackend(), backend) &&
+                 std::find(backends.begin(), backends.end(), backend) != backends.end();
+        }
+
+        VideoBackend VideoBackendProbe::configured(const configuration::IConfiguration &configuration)
+        {
+          VideoBackend backend;
+          return stored(configuration, backend) ? backend : compiledBackends().front();
+        }
+
+        VideoBackendProbe::VideoBackendProbe(configuration::IConfiguration::Pointer configuration)
+            : configuration_(std::move(configuration))
+        {
+        }
+
+        VideoBackend VideoBackendProbe::select()
+        {
+          VideoBackend backend;
+          if (stored(*configuration_, backend))
+          {
+            OPENAUTO_LOG(info) << "[VideoBackendProbe] Using stored video backend " << name(backend);
+            return backend;
+          }
+
+          results_.clear();
+          for (const VideoBackend candidate : compiledBackends())
+          {
+            if (candidate == VideoBackend::Omx || candidate == VideoBackend::Qt)
+            {
+              continue;
+            }
+
+            const VideoBackendProbeResult result = probe(candidate);
+            OPENAUTO_LOG(info) << "[VideoBackendProbe] " << name(candidate) << ": "
+                               << (!result.decoded ? "failed" : result.hardware ? "hardware" : "software")
+                               << ", " << static_cast<int>(result.fps) << " fps, "
+                               << result.latencyUs / 1000.0 << " ms";
+            results_.push_back(result);
+          }
+
+          backend = choose();
+          OPENAUTO_LOG(info) << "[VideoBackendProbe] Selected video backend " << name(backend);
+          configuration_->setVideoBackend(name(backend));
+          configuration_->save();
+          return backend;
+        }
+
+        const std::vector<VideoBackendProbeResult> &VideoBackendProbe::results() const
+        {
+          return results_;
+        }
+
+        VideoBackendProbeResult VideoBackendProbe::probe(VideoBackend backend) const
+        {
+          VideoBackendProbeResult result;
+          result.backend = backend;
+
+          IVideoOutput::Pointer output;
+          std::function<bool()> hardware;
+          switch (backend)
+          {
+#ifdef USE_FFMPEG_DRM
+          case VideoBackend::V4l2Request:
+          case VideoBackend::FFmpegDrm:
+          {
+            auto drm = std::make_shared<FFmpegDrmVideoOutput>(configuration_);
+            FFmpegDrmVideoOutput::BenchmarkOptions options;
+            options.headless = true;
+            drm->setBenchmarkOptions(options);
+            drm->setNativeDecoder(backend == VideoBackend::V4l2Request);
+            if (backend == VideoBackend::V4l2Request)
+            {
+              // Without a usable request decoder this is the hwaccel; that
+              // result belongs to FFmpegDrm
+              hardware = [drm]() { return drm->isNativeDecoding(); };
+            }
+            else
+            {
+              hardware = [drm]() { return drm->isHardwareDecoding(); };
+            }
+            output = drm;
+            break;
+          }
+#endif
+#ifdef USE_GSTREAMER
+          case VideoBackend::GStreamer:
+          {
+            auto gst = std::make_shared<GstVideoOutput>(configuration_);
+            GstVideoOutput::BenchmarkOptions options;
+            options.headless = true;
+            gst->setBenchmarkOptions(options);
+            hardware = [gst]() { return gst->isHardwareDecoding(); };
+            output = gst;
+            break;
+          }
+#endif
+          default:
+            return result;
+          }
+
+          if (!output->open() || !output->init())
+          {
+            OPENAUTO_LOG(warning) << "[VideoBackendProbe] " << name(backend) << " failed to start";
+            output->stop();
+            return result;
+          }
+
+          // Fed like the phone does, never more than the unacked window ahead
+          const H264TestStream stream(cStreamWidth, cStreamHeight, cStreamFrames);
+          const uint64_t window = output->getMaxUnackedFrames() + cHeldBackFrames;
+          const std::chrono::milliseconds timeout(cFrameTimeoutMs);
+          const auto &units = stream.units();
+          const auto start = Clock::now();
+
+          bool stalled = false;
+          uint64_t pictures = 0;
+          for (size_t unit = 0; unit < units.size() && !stalled; unit++)
+          {
+            if (pictures >= window)
+            {
+              stalled = !waitForFrames(pictures - window + 1, timeout);
+            }
+            if (!stalled)
+            {
+              const uint64_t timestamp = static_cast<uint64_t>(unit) * 1000000 / 30;
+              output->write(timestamp, aasdk::common::DataConstBuffer(units[unit]));
+              pictures += unit > 0 ? 1 : 0;
+            }
+          }
+          if (!stalled)
+          {
+            stalled = !waitForFrames(pictures > cHeldBackFrames ? pictures - cHeldBackFrames : 0, timeout);
+          }
+
+          const auto elapsed = Clock::now() - start;
+          const VideoTelemetrySnapshot snapshot = VideoTelemetry::instance().snapshot();
+          output->stop();
+          VideoTelemetry::instance().reset();
+
+          const double seconds = std::max(std::chrono::duration<double>(elapsed).count(), 1e-3);
+          result.decoded = !stalled && snapshot.framesDisplayed + cHeldBackFrames >= stream.pictureCount();
+          result.hardware = result.decoded && hardware();
+          result.fps = snapshot.framesDisplayed / seconds;
+          result.latencyUs = snapshot.endToEnd.p50Us;
+          return result;
+        }
+
+        VideoBackend VideoBackendProbe::choose() const
+        {
+          // results_ follows priority order
+          for (const auto &result : results_)
+          {
+            if (result.hardware)
+            {
+              return result.backend;
+            }
+          }
+
+          const auto backends = compiledBackends();
+          if (std::find(backends.begin(), backends.end(), VideoBackend::Omx) != backends.end())
+          {
+            return VideoBackend::Omx;
+          }
+
+          const VideoBackendProbeResult *fastest = nullptr;
+          for (const auto &result : results_)
+          {
+            if (result.decoded && (fastest == nullptr || result.fps > fastest->fps))
+            {
+              fastest = &result;
+            }
+          }
+          return fastest != nullptr ? fastest->backend : VideoBackend::Qt;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,382 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/HotspotLink.hpp>
+#include <f1x/openauto/autoapp/LinkQuality.hpp>
+#include <f1x/openauto/autoapp/Projection/CmaBudget.hpp>
+#include <f1x/openauto/autoapp/ThermalGovernor.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoModeSelector.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          using aap_protobuf::service::media::sink::message::VideoCodecResolutionType;
+          using aap_protobuf::service::media::sink::message::VideoFrameRateType;
+
+          // Modes the RK3229 pipeline can scan out, in descending pixel rate
+          const VideoMode cModeLadder[] = {
+              {VideoCodecResolutionType::VIDEO_1920x1080, VideoFrameRateType::VIDEO_FPS_60},
+              {VideoCodecResolutionType::VIDEO_1920x1080, VideoFrameRateType::VIDEO_FPS_30},
+              {VideoCodecResolutionType::VIDEO_1280x720, VideoFrameRateType::VIDEO_FPS_60},
+              {VideoCodecResolutionType::VIDEO_1280x720, VideoFrameRateType::VIDEO_FPS_30},
+              {VideoCodecResolutionType::VIDEO_800x480, VideoFrameRateType::VIDEO_FPS_60},
+              {VideoCodecResolutionType::VIDEO_800x480, VideoFrameRateType::VIDEO_FPS_30}};
+
+          double pixelsPerFrame(VideoCodecResolutionType resolution)
+          {
+            return static_cast<double>(VideoModeSelector::videoWidth(resolution)) *
+                   VideoModeSelector::videoHeight(resolution);
+          }
+
+          const char *modeName(const VideoMode &mode)
+          {
+            switch (mode.resolution)
+            {
+            case VideoCodecResolutionType::VIDEO_1920x1080:
+              return mode.fps == VideoFrameRateType::VIDEO_FPS_60 ? "1080p60" : "1080p30";
+            case VideoCodecResolutionType::VIDEO_1280x720:
+              return mode.fps == VideoFrameRateType::VIDEO_FPS_60 ? "720p60" : "720p30";
+            default:
+              return mode.fps == VideoFrameRateType::VIDEO_FPS_60 ? "480p60" : "480p30";
+            }
+          }
+        }
+
+        VideoModeSelector::VideoModeSelector(
+            configuration::IConfiguration::Pointer configuration, const QSize &displaySize)
+            : configuration_(std::move(configuration)), displaySize_(displaySize),
+              selectedIndex_(0), servedIndex_(0), served_(false), maxUnacked_(0), outputWindow_(0)
+        {
+          // First reading before any decoder exists; the video output refreshes
+          // it each time it opens one
+          CmaBudget::instance().refresh();
+        }
+
+        int VideoModeSelector::videoWidth(VideoCodecResolutionType resolution)
+        {
+          switch (resolution)
+          {
+          case VideoCodecResolutionType::VIDEO_1920x1080:
+            return 1920;
+          case VideoCodecResolutionType::VIDEO_1280x720:
+            return 1280;
+          default:
+            return 800;
+          }
+        }
+
+        int VideoModeSelector::videoHeight(VideoCodecResolutionType resolution)
+        {
+          switch (resolution)
+          {
+          case VideoCodecResolutionType::VIDEO_1920x1080:
+            return 1080;
+          case VideoCodecResolutionType::VIDEO_1280x720:
+            return 720;
+          default:
+            return 480;
+          }
+        }
+
+        double VideoModeSelector::pixelRate(const VideoMode &mode)
+        {
+          return pixelsPerFrame(mode.resolution) *
+                 (mode.fps == VideoFrameRateType::VIDEO_FPS_60 ? 60.0 : 30.0);
+        }
+
+        int64_t VideoModeSelector::frameIntervalUs(const VideoMode &mode)
+        {
+          return mode.fps == VideoFrameRateType::VIDEO_FPS_60 ? 16667 : 33333;
+        }
+
+        std::vector<VideoMode> VideoModeSelector::modes() const
+        {
+          const VideoMode configured{configuration_->getVideoResolution(),
+                                     configuration_->getVideoFPS()};
+
+          std::vector<VideoMode> result{configured};
+          if (!configuration_->getVideoAdaptiveMode())
+          {
+            return result;
+          }
+
+          const double configuredRate = pixelRate(configured);
+          for (const auto &mode : cModeLadder)
+          {
+            if (pixelRate(mode) < configuredRate)
+            {
+              result.push_back(mode);
+            }
+          }
+          return result;
+        }
+
+        size_t VideoModeSelector::selectedIndex() const
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          // The configuration may have changed since the last session
+          return this->ceilingIndex(modes());
+        }
+
+        size_t VideoModeSelector::serveSession()
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          servedIndex_ = this->ceilingIndex(modes());
+          served_ = true;
+          return servedIndex_;
+        }
+
+        size_t VideoModeSelector::ceilingIndex(const std::vector<VideoMode> &available) const
+        {
+          // A hot head unit asks for one cheaper mode per level, and gets the
+          // learned one back once it has cooled down
+          return applyCeilings(available, selectedIndex_,
+                               static_cast<size_t>(ThermalGovernor::instance().level()),
+                               CmaBudget::instance().lastMeminfo().freeBytes,
+                               HotspotLink::instance().usableKbps());
+        }
+
+        size_t VideoModeSelector::applyCeilings(const std::vector<VideoMode> &available, size_t learned,
+                                                size_t thermalSteps, int64_t cmaFreeBytes, int64_t usableKbps)
+        {
+          size_t index = std::min(learned + thermalSteps, available.size() - 1);
+
+          // Resolution ceiling: skip modes whose decoder pool no longer fits
+          // into free CMA, rather than failing after the session has started
+          while (index + 1 < available.size() &&
+                 !CmaBudget::plan(cmaFreeBytes, videoWidth(available[index].resolution),
+                                  videoHeight(available[index].resolution), 1)
+                      .hardwareFits)
+          {
+            index++;
+          }
+
+          // Over WiFi, modes the measured link cannot carry; unknown allows all
+          while (usableKbps > 0 && index + 1 < available.size() &&
+                 streamKbps(available[index]) > usableKbps)
+          {
+            index++;
+          }
+          return index;
+        }
+
+        int64_t VideoModeSelector::streamKbps(const VideoMode &mode)
+        {
+          return static_cast<int64_t>(pixelRate(mode) * cStreamBitsPerPixel / 1000);
+        }
+
+        ProjectionGeometry VideoModeSelector::geometry(const VideoMode &mode) const
+        {
+          const auto configuredResolution = configuration_->getVideoResolution();
+          const QRect margins = configuration_->getVideoMargins();
+          const ProjectionGeometry configured(
+              QSize(videoWidth(configuredResolution), videoHeight(configuredResolution)),
+              margins.size(), displaySize_,
+              DisplayOrientation(configuration_->getVideoDisplayRotation(),
+                                 configuration_->getVideoDisplayMirror()));
+          return configured.withVideoSize(
+              QSize(videoWidth(mode.resolution), videoHeight(mode.resolution)));
+        }
+
+        ProjectionGeometry VideoModeSelector::selectedGeometry() const
+        {
+          return geometry(modes()[selectedIndex()]);
+        }
+
+        void VideoModeSelector::endSession(const VideoTelemetrySnapshot &snapshot)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+
+          const std::vector<VideoMode> available = modes();
+          selectedIndex_ = std::min(selectedIndex_, available.size() - 1);
+          // The ceilings may have served a cheaper mode than the learned one;
+          // the telemetry is that mode's
+          const size_t served = served_ ? std::min(servedIndex_, available.size() - 1) : selectedIndex_;
+          served_ = false;
+          if (snapshot.decode.samples < cMinSamples)
+          {
+            return;
+          }
+
+          this->adapt(snapshot, available, served);
+          this->learn(snapshot, available[selectedIndex_]);
+        }
+
+        void VideoModeSelector::adapt(const VideoTelemetrySnapshot &snapshot,
+                                      const std::vector<VideoMode> &available, size_t served)
+        {
+          if (available.size() < 2)
+          {
+            return;
+          }
+
+          // Throttled clocks say nothing about the mode; selectedIndex()
+          // already steps down for them
+          if (ThermalGovernor::instance().level() != ThermalLevel::Normal)
+          {
+            return;
+          }
+
+          const VideoMode &current = available[served];
+          const double budgetUs = static_cast<double>(frameIntervalUs(current));
+          const double p99Us = static_cast<double>(snapshot.decode.p99Us);
+
+          // More than 1% of packets dropped before decode also means overload
+          const bool dropping = snapshot.packetsDropped * 100 > snapshot.framesDisplayed;
+
+          if ((p99Us > cOverloadShare * budgetUs || dropping) && served + 1 < available.size())
+          {
+            // No mode costlier than the one that ran keeps up either
+            selectedIndex_ = std::max(selectedIndex_, served + 1);
+            OPENAUTO_LOG(info) << "[VideoModeSelector] Decode p99 " << snapshot.decode.p99Us
+                               << " us, dropped " << snapshot.packetsDropped
+                               << " - stepping down from " << modeName(current) << " to "
+                               << modeName(available[served + 1]);
+            return;
+          }
+
+          // Headroom below a ceiling says nothing about the learned mode above it
+          if (!dropping && served > 0 && served == selectedIndex_)
+          {
+            // Assume decode time scales with pixels per frame
+            const VideoMode &better = available[served - 1];
+            const double scaledP99Us =
+                p99Us * pixelsPerFrame(better.resolution) / pixelsPerFrame(current.resolution);
+            if (scaledP99Us < cHeadroomShare * frameIntervalUs(better))
+            {
+              selectedIndex_--;
+              OPENAUTO_LOG(info) << "[VideoModeSelector] Decode p99 " << snapshot.decode.p99Us
+                                 << " us leaves headroom - stepping up from "
+                                 << modeName(current) << " to " << modeName(better);
+            }
+          }
+        }
+
+        void VideoModeSelector::learn(const VideoTelemetrySnapshot &snapshot, const VideoMode &mode)
+        {
+          if (!profiles_ || phone_.empty())
+          {
+            return;
+          }
+
+          configuration::PhoneProfile profile;
+          profiles_->find(phone_, profile);
+          profile.phone = phone_;
+          profile.videoResolution = mode.resolution;
+          profile.videoFps = mode.fps;
+
+          // Drops mean the phone sent more than the decoder kept up with: the
+          // next session gets a frame less in flight. A window the link's
+          // round trip keeps full grows back towards the output's.
+          const uint64_t packets = snapshot.framesDisplayed + snapshot.packetsDropped;
+          const bool dropping = snapshot.packetsDropped * 100 > snapshot.framesDisplayed;
+          const double seconds = snapshot.receivingUs / 1e6;
+          const double fps = seconds > 0 ? snapshot.framesDisplayed / seconds : 0.0;
+          const double rttMs = LinkQuality::instance().rttUs() / 1000.0;
+          if (maxUnacked_ > 0)
+          {
+            size_t window = maxUnacked_;
+            if (dropping)
+            {
+              window = std::max<size_t>(1, window - 1);
+            }
+            else if (window < outputWindow_ && rttMs * fps / 1000.0 >= window)
+            {
+              window++;
+            }
+            profile.videoMaxUnacked = static_cast<uint32_t>(window);
+          }
+
+          const double weight = profile.sessions == 0 ? 1.0 : cProfileWeight;
+          auto average = [weight](double &value, double sample) { value += weight * (sample - value); };
+          average(profile.decodeFps, fps);
+          average(profile.droppedPermille, packets > 0 ? snapshot.packetsDropped * 1000.0 / packets : 0.0);
+          average(profile.streamKbps, seconds > 0 ? snapshot.bytesReceived * 8 / 1000.0 / seconds : 0.0);
+          average(profile.rttMs, rttMs);
+          profile.sessions++;
+          profiles_->remember(profile);
+
+          OPENAUTO_LOG(info) << "[VideoModeSelector] " << phone_ << ": " << modeName(mode) << ", window "
+                             << profile.videoMaxUnacked << ", " << static_cast<int>(profile.decodeFps) << " fps, "
+                             << static_cast<int>(profile.streamKbps) << " kbit/s over "
+                             << profile.sessions << " sessions";
+        }
+
+        void VideoModeSelector::setPhoneProfiles(configuration::IPhoneProfilesList::Pointer profiles)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          profiles_ = std::move(profiles);
+        }
+
+        void VideoModeSelector::beginSession(const std::string &phone)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          phone_ = phone;
+          served_ = false;
+          maxUnacked_ = 0;
+          outputWindow_ = 0;
+
+          configuration::PhoneProfile profile;
+          if (!profiles_ || phone.empty() || !profiles_->find(phone, profile))
+          {
+            return;
+          }
+          // The configuration may have changed since; an unknown mode keeps
+          // the current selection
+          const std::vector<VideoMode> available = modes();
+          for (size_t i = 0; i < available.size(); i++)
+          {
+            if (available[i].resolution == profile.videoResolution && available[i].fps == profile.videoFps)
+            {
+              selectedIndex_ = i;
+              OPENAUTO_LOG(info) << "[VideoModeSelector] " << phone << " starts in " << modeName(available[i])
+                                 << ", learned over " << profile.sessions << " sessions";
+              break;
+            }
+          }
+        }
+
+        size_t VideoModeSelector::maxUnacked(size_t outputWindow)
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          size_t window = outputWindow;
+          configuration::PhoneProfile profile;
+          if (profiles_ && !phone_.empty() && profiles_->find(phone_, profile) && profile.videoMaxUnacked > 0)
+          {
+            window = std::min<size_t>(profile.videoMaxUnacked, outputWindow);
+          }
+          maxUnacked_ = window;
+          outputWindow_ = outputWindow;
+          return window;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -16,6 +16,7 @@
 *  along with openauto. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <f1x/openauto/Common/Log.hpp>
 #include <f1x/openauto/autoapp/Projection/VideoOutput.hpp>
 
@@ -45,6 +46,11 @@ namespace f1x {
           return configuration_->getVideoMargins();
         }
 
+        size_t VideoOutput::getMaxUnackedFrames() const {
+          // A window of 0 would stall the phone
+          return std::max<size_t>(1, configuration_->getVideoMaxUnacked());
+        }
+
       }
     }
   }
@@ -0,0 +1,270 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/StartupTrace.hpp>
+#include <f1x/openauto/autoapp/Projection/TouchLatencyProbe.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <time.h>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          // Fleet-wide view of the same latencies the windows below keep
+          struct LatencyHistograms
+          {
+            const std::vector<double> bounds{2, 4, 8, 12, 16, 25, 33, 50, 75, 100, 150, 250};
+            MetricHistogram &decode = Metrics::instance().histogram(
+                "openauto_video_decode_ms", "Time from decoder input to decoded frame", bounds);
+            MetricHistogram &display = Metrics::instance().histogram(
+                "openauto_video_display_ms", "Time from decoded frame to scanout", bounds);
+            MetricHistogram &endToEnd = Metrics::instance().histogram(
+                "openauto_video_end_to_end_ms", "Time from packet arrival to scanout", bounds);
+          };
+
+          LatencyHistograms &histograms()
+          {
+            static LatencyHistograms instance;
+            return instance;
+          }
+        }
+
+        // ============================================================================
+        // LatencyWindow
+        // ============================================================================
+
+        LatencyWindow::LatencyWindow(size_t capacity)
+            : samples_(std::max<size_t>(capacity, 1), 0), next_(0), count_(0)
+        {
+        }
+
+        void LatencyWindow::add(int64_t valueUs)
+        {
+          samples_[next_] = valueUs;
+          next_ = (next_ + 1) % samples_.size();
+          count_ = std::min(count_ + 1, samples_.size());
+        }
+
+        void LatencyWindow::clear()
+        {
+          next_ = 0;
+          count_ = 0;
+        }
+
+        size_t LatencyWindow::count() const
+        {
+          return count_;
+        }
+
+        int64_t LatencyWindow::percentile(double percent) const
+        {
+          if (count_ == 0)
+          {
+            return 0;
+          }
+
+          // Only the first count_ entries are valid until the window has wrapped
+          std::vector<int64_t> sorted(samples_.begin(), samples_.begin() + count_);
+          percent = std::max(0.0, std::min(percent, 100.0));
+          size_t rank = static_cast<size_t>(std::ceil(percent / 100.0 * count_));
+          size_t index = rank == 0 ? 0 : rank - 1;
+          std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+          return sorted[index];
+        }
+
+        LatencyStats LatencyWindow::stats() const
+        {
+          LatencyStats stats;
+          stats.p50Us = percentile(50.0);
+          stats.p99Us = percentile(99.0);
+          stats.samples = count_;
+          return stats;
+        }
+
+        // ============================================================================
+        // VideoTelemetry
+        // ============================================================================
+
+        VideoTelemetry &VideoTelemetry::instance()
+        {
+          static VideoTelemetry telemetry;
+          return telemetry;
+        }
+
+        int64_t VideoTelemetry::nowUs()
+        {
+          struct timespec ts;
+          clock_gettime(CLOCK_MONOTONIC, &ts);
+          return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+        }
+
+        void VideoTelemetry::recordFrame(const VideoFrameTiming &timing)
+        {
+          if (timing.probeLuma >= 0)
+          {
+            TouchLatencyProbe::instance().frameShown(timing);
+          }
+
+          auto &metrics = histograms();
+          std::unique_lock<decltype(mutex_)> lock(mutex_);
+
+          if (framesDisplayed_++ == 0)
+          {
+            // First frame since reset(), i.e. of this session
+            lock.unlock();
+            StartupTrace::connectionProjected();
+            lock.lock();
+          }
+          if (timing.sendUs > 0 && timing.receiveUs >= timing.sendUs)
+          {
+            decode_.add(timing.receiveUs - timing.sendUs);
+            metrics.decode.observe((timing.receiveUs - timing.sendUs) / 1000.0);
+          }
+          if (timing.receiveUs > 0 && timing.flipUs >= timing.receiveUs)
+          {
+            display_.add(timing.flipUs - timing.receiveUs);
+            metrics.display.observe((timing.flipUs - timing.receiveUs) / 1000.0);
+          }
+          if (timing.arrivalUs > 0 && timing.flipUs >= timing.arrivalUs)
+          {
+            endToEnd_.add(timing.flipUs - timing.arrivalUs);
+            metrics.endToEnd.observe((timing.flipUs - timing.arrivalUs) / 1000.0);
+          }
+        }
+
+        void VideoTelemetry::recordDroppedPacket()
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          packetsDropped_++;
+        }
+
+        void VideoTelemetry::recordPacket(size_t bytes)
+        {
+          const int64_t now = nowUs();
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          if (bytesReceived_ == 0)
+          {
+            firstPacketUs_ = now;
+          }
+          bytesReceived_ += bytes;
+          lastPacketUs_ = now;
+        }
+
+        void VideoTelemetry::reset()
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          decode_.clear();
+          display_.clear();
+          endToEnd_.clear();
+          framesDisplayed_ = 0;
+          packetsDropped_ = 0;
+          bytesReceived_ = 0;
+          firstPacketUs_ = 0;
+          lastPacketUs_ = 0;
+        }
+
+        VideoTelemetrySnapshot VideoTelemetry::snapshot() const
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+
+          VideoTelemetrySnapshot snapshot;
+          snapshot.decode = decode_.stats();
+          snapshot.display = display_.stats();
+          snapshot.endToEnd = endToEnd_.stats();
+          snapshot.framesDisplayed = framesDisplayed_;
+          snapshot.packetsDropped = packetsDropped_;
+          snapshot.bytesReceived = bytesReceived_;
+          snapshot.receivingUs = lastPacketUs_ - firstPacketUs_;
+          return snapshot;
+        }
+
+        uint64_t VideoTelemetry::framesDisplayed() const
+        {
+          std::lock_guard<decltype(mutex_)> lock(mutex_);
+          return framesDisplayed_;
+        }
+
+        std::string VideoTelemetry::summary() const
+        {
+          const VideoTelemetrySnapshot s = snapshot();
+
+          // Milliseconds with one decimal are enough to spot a 16.7 ms vblank miss
+          auto ms = [](int64_t us)
+          {
+            std::ostringstream out;
+            out.setf(std::ios::fixed);
+            out.precision(1);
+            out << us / 1000.0;
+            return out.str();
+          };
+
+          std::ostringstream out;
+          out << "decode " << ms(s.decode.p50Us) << "/" << ms(s.decode.p99Us)
+              << " ms, display " << ms(s.display.p50Us) << "/" << ms(s.display.p99Us)
+              << " ms, e2e " << ms(s.endToEnd.p50Us) << "/" << ms(s.endToEnd.p99Us)
+              << " ms (p50/p99), frames " << s.framesDisplayed << ", dropped "
+              << s.packetsDropped;
+          return out.str();
+        }
+
+        std::string VideoTelemetry::exportText() const
+        {
+          const VideoTelemetrySnapshot s = snapshot();
+
+          std::ostringstream out;
+          auto summaryMetric = [&out](const char *name, const char *help,
+                                      const LatencyStats &stats)
+          {
+            out << "# HELP " << name << " " << help << "\n"
+                << "# TYPE " << name << " summary\n"
+                << name << "{quantile=\"0.5\"} " << stats.p50Us / 1e6 << "\n"
+                << name << "{quantile=\"0.99\"} " << stats.p99Us / 1e6 << "\n"
+                << name << "_count " << stats.samples << "\n";
+          };
+
+          summaryMetric("openauto_video_decode_latency_seconds",
+                        "send_packet to receive_frame", s.decode);
+          summaryMetric("openauto_video_display_latency_seconds",
+                        "receive_frame to page flip", s.display);
+          summaryMetric("openauto_video_end_to_end_latency_seconds",
+                        "AAP arrival to page flip", s.endToEnd);
+
+          out << "# TYPE openauto_video_frames_displayed_total counter\n"
+              << "openauto_video_frames_displayed_total " << s.framesDisplayed << "\n"
+              << "# TYPE openauto_video_packets_dropped_total counter\n"
+              << "openauto_video_packets_dropped_total " << s.packetsDropped << "\n";
+          return out.str();
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
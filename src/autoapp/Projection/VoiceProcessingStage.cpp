@@ -0,0 +1,296 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <cerrno>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Projection/VoiceProcessingStage.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        VoiceProcessingStage::VoiceProcessingStage(uint32_t sampleRate, VoiceProcessingMode mode,
+                                                   EchoReference::Pointer reference,
+                                                   int32_t cpu)
+            : processor_(sampleRate, mode), reference_(std::move(reference)),
+              referenceRatio_(0), cpu_(cpu),
+              input_(MemoryFootprint::instance().bufferBytes(sampleRate * sizeof(int16_t), cRingMs,
+                                                             cLowMemoryRingMs)),
+              output_(input_.capacity()),
+              memory_(MemoryPool::Audio, input_.memoryBytes() + output_.memoryBytes()),
+              wakeupFd_(eventfd(0, EFD_CLOEXEC)),
+              running_(false), busy_(0), budgetFrames_(0), frames_(0),
+              referenceUnderruns_(0), outputOverruns_(0)
+        {
+          const size_t frameSamples = processor_.frameSamples();
+          microphone_.resize(frameSamples);
+          processed_.resize(frameSamples);
+          referenceFrame_.resize(frameSamples);
+
+          if (reference_ && reference_->getSampleRate() % sampleRate == 0)
+          {
+            referenceRatio_ = reference_->getSampleRate() / sampleRate;
+            referenceInput_.resize(frameSamples * referenceRatio_);
+          }
+          else if (reference_)
+          {
+            OPENAUTO_LOG(warning) << "[VoiceProcessingStage] Reference rate "
+                                  << reference_->getSampleRate()
+                                  << " Hz is not a multiple of " << sampleRate
+                                  << " Hz, echo cancellation disabled";
+            reference_.reset();
+          }
+        }
+
+        VoiceProcessingStage::~VoiceProcessingStage()
+        {
+          this->stop();
+          if (wakeupFd_ >= 0)
+          {
+            close(wakeupFd_);
+          }
+        }
+
+        bool VoiceProcessingStage::start(std::function<void()> onOutput)
+        {
+          if (thread_.joinable())
+          {
+            return true;
+          }
+          if (wakeupFd_ < 0)
+          {
+            OPENAUTO_LOG(error) << "[VoiceProcessingStage] eventfd failed";
+            return false;
+          }
+
+          // Both rings are idle here: capture has not started and the io
+          // thread only reads after start
+          input_.clear();
+          output_.clear();
+          onOutput_ = std::move(onOutput);
+          frames_ = 0;
+          referenceUnderruns_ = 0;
+          outputOverruns_ = 0;
+          if (reference_)
+          {
+            reference_->attach();
+          }
+
+          running_ = true;
+          thread_ = std::thread(&VoiceProcessingStage::processLoop, this);
+          OPENAUTO_LOG(info) << "[VoiceProcessingStage] Started ("
+                             << (processor_.getMode() == VoiceProcessingMode::Full ? "full"
+                                                                                   : "low CPU")
+                             << (reference_ ? ", echo cancellation" : ", noise suppression only")
+                             << ")";
+          return true;
+        }
+
+        void VoiceProcessingStage::stop()
+        {
+          if (!thread_.joinable())
+          {
+            return;
+          }
+
+          running_ = false;
+          this->notify();
+          thread_.join();
+          if (reference_)
+          {
+            reference_->detach();
+          }
+
+          OPENAUTO_LOG(info) << "[VoiceProcessingStage] Stopped after " << frames_
+                             << " frames, " << referenceUnderruns_ << " reference underruns, "
+                             << outputOverruns_ << " output overruns";
+          if (reference_ && reference_->droppedSamples() > 0)
+          {
+            OPENAUTO_LOG(warning) << "[VoiceProcessingStage] Mixer dropped "
+                                  << reference_->droppedSamples()
+                                  << " reference samples; the thread fell behind";
+          }
+        }
+
+        VoiceProcessingStage::Ring &VoiceProcessingStage::input()
+        {
+          return input_;
+        }
+
+        VoiceProcessingStage::Ring &VoiceProcessingStage::output()
+        {
+          return output_;
+        }
+
+        void VoiceProcessingStage::notify()
+        {
+          // Can only fail with the counter saturated, i.e. wakeups pending
+          const uint64_t one = 1;
+          const ssize_t result = ::write(wakeupFd_, &one, sizeof(one));
+          (void)result;
+        }
+
+        void VoiceProcessingStage::processLoop()
+        {
+          this->pinThread();
+          pthread_setname_np(pthread_self(), "oa-voice");
+
+          const size_t frameBytes = microphone_.size() * sizeof(int16_t);
+          while (running_)
+          {
+            uint64_t count = 0;
+            if (::read(wakeupFd_, &count, sizeof(count)) < 0 && errno != EINTR)
+            {
+              OPENAUTO_LOG(error) << "[VoiceProcessingStage] eventfd read failed";
+              break;
+            }
+
+            bool produced = false;
+            while (running_ && input_.available() >= frameBytes)
+            {
+              input_.read(microphone_.data(), frameBytes);
+              const int16_t *reference = this->takeReference();
+
+              const auto begin = std::chrono::steady_clock::now();
+              processor_.process(microphone_.data(), reference, processed_.data());
+              this->checkBudget(std::chrono::steady_clock::now() - begin);
+
+              if (output_.space() < frameBytes)
+              {
+                outputOverruns_++;
+              }
+              else
+              {
+                output_.write(processed_.data(), frameBytes);
+                produced = true;
+              }
+              frames_++;
+            }
+
+            if (produced && onOutput_)
+            {
+              onOutput_();
+            }
+          }
+        }
+
+        const int16_t *VoiceProcessingStage::takeReference()
+        {
+          if (!reference_)
+          {
+            return nullptr;
+          }
+
+          auto &ring = reference_->ring();
+          const size_t rate = reference_->getSampleRate();
+          const size_t needed = referenceInput_.size();
+          size_t available = ring.available();
+          if (available == 0)
+          {
+            // Mixer idle: nothing is playing, so there is no echo to cancel
+            return nullptr;
+          }
+
+          // Bursty writers on both sides make the lead wander; only a backlog
+          // well past the echo tail is cut back, keeping the alignment stable
+          const size_t maxLead = rate * cReferenceMaxLeadMs / 1000;
+          if (available > needed + maxLead)
+          {
+            const size_t keep = needed + rate * cReferenceLeadMs / 1000;
+            ring.commitRead(available - keep);
+            available = keep;
+          }
+
+          const size_t taken = std::min(available, needed);
+          ring.read(referenceInput_.data(), taken);
+          if (taken < needed)
+          {
+            std::fill(referenceInput_.begin() + taken, referenceInput_.end(), 0);
+            referenceUnderruns_++;
+          }
+
+          // Box-filter decimation; the canceller models whatever response
+          // the reference path has, so it only has to be linear
+          for (size_t i = 0; i < referenceFrame_.size(); i++)
+          {
+            int32_t sum = 0;
+            for (uint32_t j = 0; j < referenceRatio_; j++)
+            {
+              sum += referenceInput_[i * referenceRatio_ + j];
+            }
+            referenceFrame_[i] = static_cast<int16_t>(sum / static_cast<int32_t>(referenceRatio_));
+          }
+          return referenceFrame_.data();
+        }
+
+        void VoiceProcessingStage::checkBudget(std::chrono::steady_clock::duration busy)
+        {
+          constexpr uint32_t cBudgetWindowFrames = 100;
+
+          busy_ += busy;
+          if (++budgetFrames_ < cBudgetWindowFrames)
+          {
+            return;
+          }
+
+          const auto window = std::chrono::milliseconds(VoiceProcessor::cFrameMs * cBudgetWindowFrames);
+          const double load = std::chrono::duration<double>(busy_).count() /
+                              std::chrono::duration<double>(window).count();
+          if (processor_.getMode() == VoiceProcessingMode::Full && load > cCpuBudget)
+          {
+            OPENAUTO_LOG(warning) << "[VoiceProcessingStage] Using " << static_cast<int>(load * 100)
+                                  << "% of a core, switching to low CPU mode";
+            processor_.setMode(VoiceProcessingMode::LowCpu);
+          }
+          busy_ = std::chrono::steady_clock::duration(0);
+          budgetFrames_ = 0;
+        }
+
+        void VoiceProcessingStage::pinThread()
+        {
+          const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+          if (cores < 2)
+          {
+            return;
+          }
+
+          const long cpu = cpu_ < 0 ? cores - 1 : std::min<long>(cpu_, cores - 1);
+          cpu_set_t set;
+          CPU_ZERO(&set);
+          CPU_SET(cpu, &set);
+          if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+          {
+            OPENAUTO_LOG(warning) << "[VoiceProcessingStage] Could not pin to CPU " << cpu;
+          }
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
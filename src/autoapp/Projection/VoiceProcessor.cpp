@@ -0,0 +1,343 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+/*
+ * VoiceProcessor.cpp
+ *
+ * Microphone echo cancellation and noise suppression. The NLMS filter is
+ * the only per-sample work that scales with the echo tail; its dot
+ * product and weight update are SimdKernels.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <f1x/openauto/autoapp/Projection/SimdKernels.hpp>
+#include <f1x/openauto/autoapp/Projection/VoiceProcessor.hpp>
+
+#ifdef USE_SPEEXDSP
+#include <speex/speex_echo.h>
+#include <speex/speex_preprocess.h>
+#endif
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        namespace
+        {
+          constexpr uint32_t cFullTailMs = 64;
+          constexpr uint32_t cLowCpuTailMs = 48;
+          constexpr float cHighPassHz = 100.0f;
+          // NLMS step size and regulariser (per tap, in full-scale units)
+          constexpr float cStepSize = 0.5f;
+          constexpr float cRegularization = 1e-4f;
+          // Geigel-style test: the near-end peak more than twice what the
+          // learned echo return predicts is double talk. The estimate creeps
+          // up while blocked so a louder echo path is eventually accepted
+          constexpr float cDoubleTalkRatio = 2.0f;
+          constexpr float cEchoReturnCreep = 1.01f;
+          constexpr uint32_t cDoubleTalkHoldFrames = 5;
+          // About -50 dBFS; quieter playback is not worth adapting on
+          constexpr float cFarEndThreshold = 0.003f;
+          constexpr float cMinEchoGain = 0.1f;
+          constexpr float cNoiseRise = 1.01f;
+          constexpr float cOverSubtraction = 2.0f;
+
+          int16_t toSample(float value)
+          {
+            const float scaled = std::round(value * 32768.0f);
+            return static_cast<int16_t>(std::min(std::max(scaled, -32768.0f), 32767.0f));
+          }
+
+          size_t tailSamples(uint32_t sampleRate, uint32_t tailMs)
+          {
+            return static_cast<size_t>(sampleRate) * tailMs / 1000;
+          }
+        }
+
+        VoiceProcessor::VoiceProcessor(uint32_t sampleRate, VoiceProcessingMode mode)
+            : sampleRate_(sampleRate), frameSamples_(sampleRate * cFrameMs / 1000),
+              maxTaps_(tailSamples(sampleRate, cFullTailMs)), mode_(mode), taps_(0),
+              adaptStride_(1), historyPos_(0), historyEnergy_(0.0f), peakPos_(0),
+              doubleTalkHold_(0), echoReturn_(1.0f), echoGain_(1.0f), noiseFloor_(-1.0f), noiseGain_(1.0f),
+              appliedGain_(1.0f)
+        {
+          // RBJ Butterworth high-pass
+          const float w0 = 2.0f * static_cast<float>(M_PI) * cHighPassHz / sampleRate_;
+          const float alpha = std::sin(w0) / (2.0f * static_cast<float>(M_SQRT1_2));
+          const float cosW0 = std::cos(w0);
+          const float a0 = 1.0f + alpha;
+          hpB_[0] = (1.0f + cosW0) / 2.0f / a0;
+          hpB_[1] = -(1.0f + cosW0) / a0;
+          hpB_[2] = hpB_[0];
+          hpA_[0] = -2.0f * cosW0 / a0;
+          hpA_[1] = (1.0f - alpha) / a0;
+
+          weights_.resize(maxTaps_);
+          history_.resize(2 * maxTaps_);
+          referencePeaks_.resize((maxTaps_ + frameSamples_ - 1) / frameSamples_);
+          error_.resize(frameSamples_);
+
+#ifdef USE_SPEEXDSP
+          echoState_ = nullptr;
+          preprocessState_ = nullptr;
+          filtered_.resize(frameSamples_);
+          silence_.assign(frameSamples_, 0);
+#endif
+          this->setMode(mode);
+          this->reset();
+        }
+
+        VoiceProcessor::~VoiceProcessor()
+        {
+#ifdef USE_SPEEXDSP
+          speex_preprocess_state_destroy(preprocessState_);
+          speex_echo_state_destroy(echoState_);
+#endif
+        }
+
+        size_t VoiceProcessor::frameSamples() const
+        {
+          return frameSamples_;
+        }
+
+        uint32_t VoiceProcessor::getSampleRate() const
+        {
+          return sampleRate_;
+        }
+
+        void VoiceProcessor::setMode(VoiceProcessingMode mode)
+        {
+          const size_t taps = mode == VoiceProcessingMode::Full
+                                  ? maxTaps_
+                                  : tailSamples(sampleRate_, cLowCpuTailMs);
+          if (taps < taps_)
+          {
+            // Weights are newest-last; drop the part of the tail now unused
+            std::fill(weights_.begin(), weights_.begin() + (maxTaps_ - taps), 0.0f);
+          }
+          mode_ = mode;
+          taps_ = taps;
+          adaptStride_ = mode == VoiceProcessingMode::Full ? 1 : 2;
+
+#ifdef USE_SPEEXDSP
+          // The MDF filter length is fixed at creation
+          if (preprocessState_ != nullptr)
+          {
+            speex_preprocess_state_destroy(preprocessState_);
+            speex_echo_state_destroy(echoState_);
+          }
+          const int frameSize = static_cast<int>(frameSamples_);
+          int rate = static_cast<int>(sampleRate_);
+          echoState_ = speex_echo_state_init(frameSize, static_cast<int>(taps_));
+          speex_echo_ctl(echoState_, SPEEX_ECHO_SET_SAMPLING_RATE, &rate);
+          preprocessState_ = speex_preprocess_state_init(frameSize, rate);
+          int enabled = 1;
+          int suppressDb = -static_cast<int>(cMaxSuppressionDb);
+          speex_preprocess_ctl(preprocessState_, SPEEX_PREPROCESS_SET_DENOISE, &enabled);
+          speex_preprocess_ctl(preprocessState_, SPEEX_PREPROCESS_SET_NOISE_SUPPRESS, &suppressDb);
+          speex_preprocess_ctl(preprocessState_, SPEEX_PREPROCESS_SET_ECHO_STATE, echoState_);
+#endif
+        }
+
+        VoiceProcessingMode VoiceProcessor::getMode() const
+        {
+          return mode_;
+        }
+
+        void VoiceProcessor::reset()
+        {
+          std::fill(hpX_, hpX_ + 2, 0.0f);
+          std::fill(hpY_, hpY_ + 2, 0.0f);
+          std::fill(weights_.begin(), weights_.end(), 0.0f);
+          std::fill(history_.begin(), history_.end(), 0.0f);
+          std::fill(referencePeaks_.begin(), referencePeaks_.end(), 0.0f);
+          historyPos_ = 0;
+          historyEnergy_ = 0.0f;
+          peakPos_ = 0;
+          doubleTalkHold_ = 0;
+          echoReturn_ = 1.0f;
+          echoGain_ = 1.0f;
+          noiseFloor_ = -1.0f;
+          noiseGain_ = 1.0f;
+          appliedGain_ = 1.0f;
+#ifdef USE_SPEEXDSP
+          speex_echo_state_reset(echoState_);
+#endif
+        }
+
+        void VoiceProcessor::process(const int16_t *microphone, const int16_t *reference,
+                                     int16_t *output)
+        {
+          this->highPass(microphone, error_.data());
+
+#ifdef USE_SPEEXDSP
+          for (size_t i = 0; i < frameSamples_; i++)
+          {
+            filtered_[i] = toSample(error_[i]);
+          }
+          // Silence keeps the canceller's frame clock running while idle
+          speex_echo_cancellation(echoState_, filtered_.data(),
+                                  reference != nullptr ? reference : silence_.data(), output);
+          speex_preprocess_run(preprocessState_, output);
+#else
+          if (reference != nullptr)
+          {
+            this->cancelEcho(reference);
+          }
+          else
+          {
+            echoGain_ = 1.0f;
+          }
+          this->suppressNoise();
+
+          // Ramp from the last frame's gain so gain changes do not click
+          const float gain = echoGain_ * noiseGain_;
+          const float step = (gain - appliedGain_) / frameSamples_;
+          for (size_t i = 0; i < frameSamples_; i++)
+          {
+            appliedGain_ += step;
+            output[i] = toSample(error_[i] * appliedGain_);
+          }
+          appliedGain_ = gain;
+#endif
+        }
+
+        void VoiceProcessor::highPass(const int16_t *input, float *output)
+        {
+          for (size_t i = 0; i < frameSamples_; i++)
+          {
+            const float x = input[i] / 32768.0f;
+            const float y = hpB_[0] * x + hpB_[1] * hpX_[0] + hpB_[2] * hpX_[1] -
+                            hpA_[0] * hpY_[0] - hpA_[1] * hpY_[1];
+            hpX_[1] = hpX_[0];
+            hpX_[0] = x;
+            hpY_[1] = hpY_[0];
+            hpY_[0] = y;
+            output[i] = y;
+          }
+        }
+
+        void VoiceProcessor::cancelEcho(const int16_t *reference)
+        {
+          // Double-talk test against the far-end peak over the tail
+          float nearPeak = 0.0f;
+          float farPeak = 0.0f;
+          for (size_t i = 0; i < frameSamples_; i++)
+          {
+            nearPeak = std::max(nearPeak, std::fabs(error_[i]));
+            farPeak = std::max<float>(farPeak, std::abs(reference[i]) / 32768.0f);
+          }
+          referencePeaks_[peakPos_] = farPeak;
+          peakPos_ = (peakPos_ + 1) % referencePeaks_.size();
+          const float tailPeak = *std::max_element(referencePeaks_.begin(), referencePeaks_.end());
+          const bool farEnd = tailPeak > cFarEndThreshold;
+          const float ratio = nearPeak / std::max(tailPeak, 1e-6f);
+          if (farEnd && ratio > cDoubleTalkRatio * echoReturn_)
+          {
+            doubleTalkHold_ = cDoubleTalkHoldFrames;
+            echoReturn_ *= cEchoReturnCreep;
+          }
+          else if (doubleTalkHold_ > 0)
+          {
+            doubleTalkHold_--;
+          }
+          else if (farEnd)
+          {
+            echoReturn_ += 0.05f * (ratio - echoReturn_);
+          }
+          const bool adapt = farEnd && doubleTalkHold_ == 0;
+
+          const SimdKernels &kernels = simdKernels();
+          // Window energy recomputed once a frame so the running sum cannot drift
+          float *weights = weights_.data() + (maxTaps_ - taps_);
+          historyEnergy_ = kernels.dotF32(history_.data() + historyPos_ + maxTaps_ - taps_ + 1,
+                                           history_.data() + historyPos_ + maxTaps_ - taps_ + 1, taps_);
+
+          float echoEnergy = 0.0f;
+          float errorEnergy = 0.0f;
+          for (size_t i = 0; i < frameSamples_; i++)
+          {
+            const float leaving = history_[historyPos_ + maxTaps_ - taps_ + 1];
+            historyPos_ = (historyPos_ + 1) % maxTaps_;
+            const float x = reference[i] / 32768.0f;
+            history_[historyPos_] = x;
+            history_[historyPos_ + maxTaps_] = x;
+            historyEnergy_ = std::max(0.0f, historyEnergy_ + x * x - leaving * leaving);
+
+            const float *window = history_.data() + historyPos_ + maxTaps_ - taps_ + 1;
+            const float estimate = kernels.dotF32(weights, window, taps_);
+            const float error = error_[i] - estimate;
+            if (adapt && i % adaptStride_ == 0)
+            {
+              const float scale =
+                  cStepSize * error / (historyEnergy_ + cRegularization * taps_);
+              kernels.axpyF32(weights, window, scale, taps_);
+            }
+
+            echoEnergy += estimate * estimate;
+            errorEnergy += error * error;
+            error_[i] = error;
+          }
+
+          // Residual echo: what the filter explains but could not remove.
+          // Attack at once, release over a few frames
+          float target = 1.0f;
+          if (adapt)
+          {
+            target = std::max(cMinEchoGain, errorEnergy / (errorEnergy + echoEnergy + 1e-9f));
+          }
+          echoGain_ = target < echoGain_ ? target : echoGain_ + 0.3f * (target - echoGain_);
+        }
+
+        void VoiceProcessor::suppressNoise()
+        {
+          float energy = 1e-10f;
+          for (size_t i = 0; i < frameSamples_; i++)
+          {
+            energy += error_[i] * error_[i];
+          }
+          energy /= frameSamples_;
+
+          // Minimum tracking: follows dips quickly, creeps up through speech
+          if (noiseFloor_ < 0.0f || energy < noiseFloor_)
+          {
+            noiseFloor_ = noiseFloor_ < 0.0f ? energy : 0.7f * noiseFloor_ + 0.3f * energy;
+          }
+          else
+          {
+            noiseFloor_ *= cNoiseRise;
+          }
+
+          // Opens at once on speech onsets, closes slowly over word tails
+          static const float minGain = std::pow(10.0f, -cMaxSuppressionDb / 20.0f);
+          const float target = std::max(minGain, 1.0f - cOverSubtraction * noiseFloor_ / energy);
+          noiseGain_ = target > noiseGain_ ? target : 0.9f * noiseGain_ + 0.1f * target;
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
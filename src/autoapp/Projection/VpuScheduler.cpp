@@ -0,0 +1,223 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/Projection/VpuScheduler.hpp>
+
+#include <algorithm>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        constexpr int64_t VpuScheduler::cWindowUs;
+
+        namespace
+        {
+          struct VpuMetrics
+          {
+            MetricCounter &rearCameraDropped = Metrics::instance().counter(
+                "openauto_vpu_rear_camera_dropped_total", "Rear camera pictures refused the decoder");
+            MetricCounter &clusterDropped = Metrics::instance().counter(
+                "openauto_vpu_cluster_dropped_total", "Cluster pictures refused the decoder");
+            MetricGauge &mainShare = Metrics::instance().gauge(
+                "openauto_vpu_main_share_permille", "Decoder time of the main display per 1000");
+            MetricGauge &clusterShare = Metrics::instance().gauge(
+                "openauto_vpu_cluster_share_permille", "Decoder time of the cluster display per 1000");
+          };
+
+          VpuMetrics &metrics()
+          {
+            static VpuMetrics instance;
+            return instance;
+          }
+        }
+
+        VpuScheduler &VpuScheduler::instance()
+        {
+          static VpuScheduler scheduler;
+          return scheduler;
+        }
+
+        VpuStreamPolicy VpuScheduler::defaultPolicy(VpuStream stream)
+        {
+          VpuStreamPolicy policy;
+          switch (stream)
+          {
+          case VpuStream::Main:
+            policy.priority = 0;
+            policy.drop = VpuDropPolicy::Never;
+            break;
+          case VpuStream::RearCamera:
+            policy.priority = 1;
+            break;
+          default:
+            policy.priority = 2;
+            policy.maxSharePermille = 250;
+            break;
+          }
+          return policy;
+        }
+
+        VpuScheduler::VpuScheduler()
+        {
+          for (size_t i = 0; i < streams_.size(); i++)
+          {
+            streams_[i].policy = defaultPolicy(static_cast<VpuStream>(i));
+          }
+        }
+
+        void VpuScheduler::setPolicy(VpuStream stream, const VpuStreamPolicy &policy)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          streams_[static_cast<size_t>(stream)].policy = policy;
+        }
+
+        void VpuScheduler::attach(VpuStream stream)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          StreamState &state = streams_[static_cast<size_t>(stream)];
+          const VpuStreamPolicy policy = state.policy;
+          state = StreamState();
+          state.policy = policy;
+          state.attached = true;
+        }
+
+        void VpuScheduler::detach(VpuStream stream)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          StreamState &state = streams_[static_cast<size_t>(stream)];
+          const VpuStreamPolicy policy = state.policy;
+          state = StreamState();
+          state.policy = policy;
+        }
+
+        bool VpuScheduler::admit(VpuStream stream, bool keyFrame, bool reference, int64_t nowUs)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          StreamState &state = streams_[static_cast<size_t>(stream)];
+          roll(state, nowUs);
+
+          bool admitted = true;
+          if (state.policy.drop != VpuDropPolicy::Never && !keyFrame)
+          {
+            bool higherDecoding = false;
+            for (const auto &other : streams_)
+            {
+              higherDecoding = higherDecoding || (&other != &state && other.attached && other.decoding &&
+                                                  other.policy.priority < state.policy.priority);
+            }
+            if (state.awaitingKeyFrame)
+            {
+              admitted = false;
+            }
+            else if (higherDecoding || share(state, nowUs) >= state.policy.maxSharePermille)
+            {
+              admitted = false;
+              state.awaitingKeyFrame = reference;
+            }
+          }
+
+          if (!admitted)
+          {
+            if (stream == VpuStream::RearCamera)
+            {
+              metrics().rearCameraDropped.add();
+            }
+            else if (stream == VpuStream::Cluster)
+            {
+              metrics().clusterDropped.add();
+            }
+            return false;
+          }
+          state.awaitingKeyFrame = false;
+          state.decoding = true;
+          state.decodeStartUs = nowUs;
+          return true;
+        }
+
+        void VpuScheduler::finished(VpuStream stream, int64_t nowUs)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          StreamState &state = streams_[static_cast<size_t>(stream)];
+          if (!state.decoding)
+          {
+            return;
+          }
+          roll(state, nowUs);
+          // Only the part of a decode inside the current window is charged
+          state.busyUs += std::max<int64_t>(0, nowUs - std::max(state.decodeStartUs, state.windowStartUs));
+          state.decoding = false;
+
+          if (stream == VpuStream::Main)
+          {
+            metrics().mainShare.set(share(state, nowUs));
+          }
+          else if (stream == VpuStream::Cluster)
+          {
+            metrics().clusterShare.set(share(state, nowUs));
+          }
+        }
+
+        uint32_t VpuScheduler::sharePermille(VpuStream stream, int64_t nowUs) const
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          StreamState state = streams_[static_cast<size_t>(stream)];
+          roll(state, nowUs);
+          return share(state, nowUs);
+        }
+
+        void VpuScheduler::roll(StreamState &state, int64_t nowUs)
+        {
+          const int64_t elapsed = nowUs - state.windowStartUs;
+          if (state.windowStartUs == 0 || elapsed >= 2 * cWindowUs)
+          {
+            state.previousBusyUs = 0;
+            state.busyUs = 0;
+            state.windowStartUs = nowUs;
+          }
+          else if (elapsed >= cWindowUs)
+          {
+            state.previousBusyUs = state.busyUs;
+            state.busyUs = 0;
+            state.windowStartUs += cWindowUs;
+          }
+        }
+
+        uint32_t VpuScheduler::share(const StreamState &state, int64_t nowUs)
+        {
+          // The previous window counts for the part of it still inside the last cWindowUs
+          const int64_t elapsed = std::min(cWindowUs, std::max<int64_t>(0, nowUs - state.windowStartUs));
+          int64_t busy = state.busyUs + state.previousBusyUs * (cWindowUs - elapsed) / cWindowUs;
+          if (state.decoding)
+          {
+            busy += std::max<int64_t>(0, nowUs - std::max(state.decodeStartUs, state.windowStartUs));
+          }
+          return static_cast<uint32_t>(std::min<int64_t>(1000, busy * 1000 / cWindowUs));
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,139 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * YuvCopy.cpp
+ *
+ * Plane copy helpers for the FFmpegDrmVideoOutput software fallback. When
+ * rkvdec is unavailable the frame is still displayed as NV12 on the overlay
+ * plane, so the CPU only moves bytes and the VOP does YUV->RGB and scaling.
+ * The one CPU conversion here is for FrameGrabber's snapshots.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <f1x/openauto/autoapp/Projection/SimdKernels.hpp>
+#include <f1x/openauto/autoapp/Projection/YuvCopy.hpp>
+
+namespace f1x
+{
+  namespace openauto
+  {
+    namespace autoapp
+    {
+      namespace projection
+      {
+
+        void copyPlane(uint8_t *dst, int dstPitch, const uint8_t *src, int srcPitch,
+                       int widthBytes, int height)
+        {
+          if (dstPitch == srcPitch && dstPitch == widthBytes)
+          {
+            std::memcpy(dst, src, static_cast<size_t>(widthBytes) * height);
+            return;
+          }
+
+          // glibc memcpy is already NEON-optimised on armhf
+          for (int y = 0; y < height; y++)
+          {
+            std::memcpy(dst + y * dstPitch, src + y * srcPitch, widthBytes);
+          }
+        }
+
+        void interleaveChroma(uint8_t *dst, int dstPitch, const uint8_t *srcU,
+                              int srcUPitch, const uint8_t *srcV, int srcVPitch,
+                              int chromaWidth, int chromaHeight)
+        {
+          const auto interleaveRow = simdKernels().interleaveChromaRow;
+          for (int y = 0; y < chromaHeight; y++)
+          {
+            interleaveRow(dst + y * dstPitch, srcU + y * srcUPitch, srcV + y * srcVPitch, chromaWidth);
+          }
+        }
+
+        namespace
+        {
+          uint8_t clampByte(int value)
+          {
+            return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+          }
+        } // namespace
+
+        void downscaleNv12ToRgb(uint8_t *dst, int dstWidth, int dstHeight,
+                                const uint8_t *luma, int lumaPitch,
+                                const uint8_t *chroma, int chromaPitch,
+                                int width, int height, bool fullRange)
+        {
+          // 8.8 fixed point: limited range expands Y by 255/219 and the chroma
+          // by 255/224 on top of the BT.709 matrix
+          const int yScale = fullRange ? 256 : 298;
+          const int yOffset = fullRange ? 0 : 16;
+          const int vToR = fullRange ? 403 : 459;
+          const int uToG = fullRange ? 48 : 55;
+          const int vToG = fullRange ? 120 : 136;
+          const int uToB = fullRange ? 475 : 541;
+
+          for (int y = 0; y < dstHeight; y++)
+          {
+            // Each output pixel averages the chroma-aligned box it covers
+            const int top = y * height / dstHeight / 2 * 2;
+            const int bottom = std::max(top + 2, (y + 1) * height / dstHeight / 2 * 2);
+            uint8_t *out = dst + static_cast<ptrdiff_t>(y) * dstWidth * 3;
+            for (int x = 0; x < dstWidth; x++)
+            {
+              const int left = x * width / dstWidth / 2 * 2;
+              const int right = std::max(left + 2, (x + 1) * width / dstWidth / 2 * 2);
+
+              int sumY = 0;
+              for (int row = top; row < bottom; row++)
+              {
+                const uint8_t *line = luma + static_cast<ptrdiff_t>(row) * lumaPitch;
+                for (int column = left; column < right; column++)
+                {
+                  sumY += line[column];
+                }
+              }
+              int sumU = 0;
+              int sumV = 0;
+              for (int row = top / 2; row < bottom / 2; row++)
+              {
+                const uint8_t *line = chroma + static_cast<ptrdiff_t>(row) * chromaPitch;
+                for (int column = left; column < right; column += 2)
+                {
+                  sumU += line[column];
+                  sumV += line[column + 1];
+                }
+              }
+
+              const int lumaCount = (bottom - top) * (right - left);
+              const int chromaCount = lumaCount / 4;
+              const int c = yScale * ((sumY + lumaCount / 2) / lumaCount - yOffset);
+              const int d = (sumU + chromaCount / 2) / chromaCount - 128;
+              const int e = (sumV + chromaCount / 2) / chromaCount - 128;
+              out[0] = clampByte((c + vToR * e + 128) >> 8);
+              out[1] = clampByte((c - uToG * d - vToG * e + 128) >> 8);
+              out[2] = clampByte((c + uToB * d + 128) >> 8);
+              out += 3;
+            }
+          }
+        }
+
+      } // namespace projection
+    } // namespace autoapp
+  } // namespace openauto
+} // namespace f1x
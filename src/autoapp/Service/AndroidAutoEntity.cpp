@@ -16,8 +16,15 @@
 *  along with openauto. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <chrono>
 #include <aasdk/Channel/Control/ControlServiceChannel.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/PhoneStatus.hpp>
+#include <f1x/openauto/autoapp/Player/PhoneMedia.hpp>
 #include <f1x/openauto/autoapp/Service/AndroidAutoEntity.hpp>
+#include <f1x/openauto/autoapp/Service/ShutdownCoordinator.hpp>
+#include <f1x/openauto/autoapp/StrandMonitor.hpp>
 #include <f1x/openauto/Common/Log.hpp>
 
 namespace f1x {
@@ -25,6 +32,22 @@ namespace f1x {
     namespace autoapp {
       namespace service {
 
+        namespace {
+          struct EntityMetrics {
+            MetricCounter &sessions = Metrics::instance().counter(
+                "openauto_sessions_total", "Android Auto sessions started");
+            MetricGauge &active = Metrics::instance().gauge(
+                "openauto_sessions_active", "Android Auto sessions currently running");
+            MetricCounter &channelErrors = Metrics::instance().counter(
+                "openauto_channel_errors_total", "Control channel errors that ended a session");
+          };
+
+          EntityMetrics &metrics() {
+            static EntityMetrics instance;
+            return instance;
+          }
+        }
+
         AndroidAutoEntity::AndroidAutoEntity(boost::asio::io_service &ioService,
                                              aasdk::messenger::ICryptor::Pointer cryptor,
                                              aasdk::transport::ITransport::Pointer transport,
@@ -43,11 +66,21 @@ namespace f1x {
           OPENAUTO_LOG(debug) << "[AndroidAutoEntity] destroy.";
         }
 
+        void AndroidAutoEntity::setAudioFocusHandler(AudioFocusHandler handler) {
+          audioFocusHandler_ = std::move(handler);
+        }
+
+        void AndroidAutoEntity::setPhoneIdentityHandler(PhoneIdentityHandler handler) {
+          phoneIdentityHandler_ = std::move(handler);
+        }
+
         void AndroidAutoEntity::start(IAndroidAutoEntityEventHandler &eventHandler) {
-          strand_.dispatch([this, self = this->shared_from_this(), eventHandler = &eventHandler]() {
+          strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("entity.start"), [this, self = this->shared_from_this(), eventHandler = &eventHandler]() {
             OPENAUTO_LOG(info) << "[AndroidAutoEntity] start()";
 
             eventHandler_ = eventHandler;
+            metrics().sessions.add();
+            metrics().active.add(1);
             std::for_each(serviceList_.begin(), serviceList_.end(), std::bind(&IService::start, std::placeholders::_1));
 
             auto versionRequestPromise = aasdk::channel::SendPromise::defer(strand_);
@@ -57,31 +90,68 @@ namespace f1x {
             OPENAUTO_LOG(debug) << "[AndroidAutoEntity] Send Version Request.";
             controlServiceChannel_->sendVersionRequest(std::move(versionRequestPromise));
             controlServiceChannel_->receive(this->shared_from_this());
-          });
+          }));
         }
 
         void AndroidAutoEntity::stop() {
           // Mark stopping early to suppress error-triggered quits during teardown
           stopping_.store(true, std::memory_order_relaxed);
-          strand_.dispatch([this, self = this->shared_from_this()]() {
+          strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("entity.stop"), [this, self = this->shared_from_this()]() {
             OPENAUTO_LOG(info) << "[AndroidAutoEntity] stop()";
 
+            // A second stop() while the first is under way adds nothing
+            if (shutdown_ != nullptr) {
+              return;
+            }
+
+            // Only a started entity counts as active
+            if (eventHandler_ != nullptr) {
+              metrics().active.add(-1);
+            }
+
             try {
               eventHandler_ = nullptr;
-              std::for_each(serviceList_.begin(), serviceList_.end(),
-                            std::bind(&IService::stop, std::placeholders::_1));
-
-              messenger_->stop();
-              transport_->stop();
-              cryptor_->deinit();
+              // In parallel and off this strand, each bounded by its deadline:
+              // a stuck sensor source no longer holds the display and audio
+              // devices, nor the workers of the io_service
+              const auto started = std::chrono::steady_clock::now();
+              shutdown_ = std::make_unique<ShutdownCoordinator>();
+              shutdown_->stopServices(serviceList_, [this, self, started](std::vector<std::string> overran) {
+                strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("entity.stopped"),
+                                           [this, self, started, overran = std::move(overran)]() {
+                  this->onServicesStopped(started, overran);
+                }));
+              });
             } catch (...) {
               OPENAUTO_LOG(error) << "[AndroidAutoEntity] stop() - exception when stopping.";
             }
-          });
+          }));
+        }
+
+        void AndroidAutoEntity::onServicesStopped(std::chrono::steady_clock::time_point started,
+                                                  const std::vector<std::string> &overran) {
+          OPENAUTO_LOG(info) << "[AndroidAutoEntity] services stopped in "
+                             << std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    std::chrono::steady_clock::now() - started).count()
+                             << " ms, " << overran.size() << " past their deadline";
+
+          try {
+            PhoneStatus::reset();
+            // A phone that is gone holds no focus
+            if (audioFocusHandler_) {
+              audioFocusHandler_(aap_protobuf::service::control::message::AudioFocusRequestType::AUDIO_FOCUS_RELEASE);
+            }
+
+            messenger_->stop();
+            transport_->stop();
+            cryptor_->deinit();
+          } catch (...) {
+            OPENAUTO_LOG(error) << "[AndroidAutoEntity] stop() - exception when stopping.";
+          }
         }
 
         void AndroidAutoEntity::pause() {
-          strand_.dispatch([this, self = this->shared_from_this()]() {
+          strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("entity.pause"), [this, self = this->shared_from_this()]() {
             OPENAUTO_LOG(info) << "[AndroidAutoEntity] pause()";
 
             try {
@@ -90,11 +160,11 @@ namespace f1x {
             } catch (...) {
               OPENAUTO_LOG(error) << "[AndroidAutoEntity] pause() - exception when pausing.";
             }
-          });
+          }));
         }
 
         void AndroidAutoEntity::resume() {
-          strand_.dispatch([this, self = this->shared_from_this()]() {
+          strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("entity.resume"), [this, self = this->shared_from_this()]() {
             OPENAUTO_LOG(info) << "[AndroidAutoEntity] resume()";
 
             try {
@@ -103,7 +173,7 @@ namespace f1x {
             } catch (...) {
               OPENAUTO_LOG(error) << "[AndroidAutoEntity] resume() exception when resuming.";
             }
-          });
+          }));
         }
 
         void AndroidAutoEntity::onVersionResponse(uint16_t majorCode, uint16_t minorCode,
@@ -203,6 +273,11 @@ namespace f1x {
           headUnitInfo->set_head_unit_software_build("1");
           headUnitInfo->set_head_unit_software_version("1.0");
 
+          // Per-phone learned settings apply to the configs advertised below
+          if (phoneIdentityHandler_) {
+            phoneIdentityHandler_(request.device_name());
+          }
+
           std::for_each(serviceList_.begin(), serviceList_.end(),
                         std::bind(&IService::fillFeatures, std::placeholders::_1, std::ref(serviceDiscoveryResponse)));
 
@@ -242,6 +317,16 @@ namespace f1x {
           OPENAUTO_LOG(debug) << "[AndroidAutoEntity] AudioFocusStateType determined: "
                              << AudioFocusStateType_Name(audioFocusStateType);
 
+          // Transient requests (guidance, calls) duck local playback in the
+          // mixer; the phone's own player starting pauses it
+          if (request.audio_focus_type() ==
+              aap_protobuf::service::control::message::AudioFocusRequestType::AUDIO_FOCUS_GAIN) {
+            player::PhoneMedia::instance().requestFocus();
+          }
+          if (audioFocusHandler_) {
+            audioFocusHandler_(request.audio_focus_type());
+          }
+
           aap_protobuf::service::control::message::AudioFocusNotification response;
           response.set_focus_state(audioFocusStateType);
 
@@ -295,6 +380,12 @@ namespace f1x {
 
         void AndroidAutoEntity::onBatteryStatusNotification(const aap_protobuf::service::control::message::BatteryStatusNotification &notification) {
           OPENAUTO_LOG(info) << "[AndroidAutoEntity] onBatteryStatusNotification()";
+
+          PhoneStatus battery;
+          battery.batteryLevel = static_cast<int32_t>(notification.battery_level());
+          battery.batteryCritical = notification.critical_battery();
+          PhoneStatus::update(PhoneStatus::Battery, battery);
+
           controlServiceChannel_->receive(this->shared_from_this());
         }
 
@@ -312,7 +403,8 @@ namespace f1x {
         void AndroidAutoEntity::onPingResponse(const aap_protobuf::service::control::message::PingResponse &response) {
           OPENAUTO_LOG(info) << "[AndroidAutoEntity] onPingResponse()";
           OPENAUTO_LOG(debug) << "[AndroidAutoEntity] Timestamp: " << response.timestamp();
-          pinger_->pong();
+          // The phone echoes the timestamp sendPing() put in the request
+          pinger_->pong(response.timestamp());
           controlServiceChannel_->receive(this->shared_from_this());
         }
 
@@ -322,6 +414,7 @@ namespace f1x {
             OPENAUTO_LOG(debug) << "[AndroidAutoEntity] onChannelError(): " << e.what() << " (expected during stop)";
             return;
           }
+          FlightRecorder::instance().record(FlightEvent::ChannelError, 0, static_cast<int32_t>(e.getCode()));
           
           // Ignore other errors if we're already stopping to prevent re-entrant quit
           if (stopping_.load(std::memory_order_relaxed)) {
@@ -330,6 +423,7 @@ namespace f1x {
           }
           
           OPENAUTO_LOG(fatal) << "[AndroidAutoEntity] onChannelError(): " << e.what();
+          metrics().channelErrors.add();
           this->triggerQuit();
         }
 
@@ -369,6 +463,7 @@ namespace f1x {
               std::chrono::high_resolution_clock::now().time_since_epoch());
           request.set_timestamp(timestamp.count());
           controlServiceChannel_->sendPingRequest(request, std::move(promise));
+          pinger_->pingSent(timestamp.count());
         }
       }
     }
@@ -16,6 +16,7 @@
 *  along with openauto. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <aasdk/USB/AOAPDevice.hpp>
 #include <aasdk/Transport/SSLWrapper.hpp>
 #include <aasdk/Transport/USBTransport.hpp>
@@ -26,7 +27,13 @@
 #include <aasdk/Messenger/Messenger.hpp>
 #include <f1x/openauto/autoapp/Service/AndroidAutoEntityFactory.hpp>
 #include <f1x/openauto/autoapp/Service/AndroidAutoEntity.hpp>
+#include <f1x/openauto/autoapp/Service/CachingSSLWrapper.hpp>
 #include <f1x/openauto/autoapp/Service/Pinger.hpp>
+#include <f1x/openauto/autoapp/Service/PipelinedUSBTransport.hpp>
+#include <f1x/openauto/autoapp/Service/PooledMessageInStream.hpp>
+#include <f1x/openauto/autoapp/Service/PriorityMessenger.hpp>
+#include <f1x/openauto/autoapp/Service/TlsCipherPolicy.hpp>
+#include <f1x/openauto/Common/Log.hpp>
 
 namespace f1x {
   namespace openauto {
@@ -36,36 +43,79 @@ namespace f1x {
         AndroidAutoEntityFactory::AndroidAutoEntityFactory(boost::asio::io_service &ioService,
                                                            configuration::IConfiguration::Pointer configuration,
                                                            IServiceFactory &serviceFactory)
-            : ioService_(ioService), configuration_(std::move(configuration)), serviceFactory_(serviceFactory) {
+            : ioService_(ioService), configuration_(std::move(configuration)), serviceFactory_(serviceFactory),
+              preferChaCha_(prefersChaCha(*configuration_)) {
+        }
+
+        void AndroidAutoEntityFactory::prepareTls(const configuration::IConfiguration &configuration) {
+          try {
+            aasdk::messenger::Cryptor warmup(std::make_shared<CachingSSLWrapper>(std::string(), false, prefersChaCha(configuration)));
+            warmup.init();
+            warmup.deinit();
+          } catch (const aasdk::error::Error &error) {
+            OPENAUTO_LOG(error) << "[AndroidAutoEntityFactory] TLS setup failed: " << error.what();
+          }
+        }
 
+        bool AndroidAutoEntityFactory::prefersChaCha(const configuration::IConfiguration &configuration) {
+          return configuration.getTlsCipherPreference() == "chacha" ||
+                 (configuration.getTlsCipherPreference() != "aes" && !cpuHasAesInstructions());
         }
 
         IAndroidAutoEntity::Pointer AndroidAutoEntityFactory::create(aasdk::usb::IAOAPDevice::Pointer aoapDevice) {
-          auto transport(std::make_shared<aasdk::transport::USBTransport>(ioService_, std::move(aoapDevice)));
-          return create(std::move(transport));
+          // UsbInTransfers 1 is aasdk's own transport, one IN transfer at a time
+          const int32_t transfers = configuration_->getUsbInTransfers();
+          aasdk::transport::ITransport::Pointer transport;
+          if (transfers > 1) {
+            const size_t transferSize = static_cast<size_t>(std::max(configuration_->getUsbInTransferKb(), 16)) * 1024;
+            transport = std::make_shared<PipelinedUSBTransport>(ioService_, std::move(aoapDevice),
+                                                                static_cast<size_t>(transfers), transferSize);
+          } else {
+            transport = std::make_shared<aasdk::transport::USBTransport>(ioService_, std::move(aoapDevice));
+          }
+          return create(std::move(transport), "usb");
         }
 
         IAndroidAutoEntity::Pointer AndroidAutoEntityFactory::create(aasdk::tcp::ITCPEndpoint::Pointer tcpEndpoint) {
           auto transport(std::make_shared<aasdk::transport::TCPTransport>(ioService_, std::move(tcpEndpoint)));
-          return create(std::move(transport));
+          return create(std::move(transport), "wifi");
         }
 
-        IAndroidAutoEntity::Pointer AndroidAutoEntityFactory::create(aasdk::transport::ITransport::Pointer transport) {
-          auto sslWrapper(std::make_shared<aasdk::transport::SSLWrapper>());
+        IAndroidAutoEntity::Pointer AndroidAutoEntityFactory::create(aasdk::transport::ITransport::Pointer transport,
+                                                                     const std::string &sessionKey) {
+          // aasdk tells us nothing about the phone before the handshake, so the
+          // last session per transport is offered; another phone just declines it
+          auto sslWrapper(std::make_shared<CachingSSLWrapper>(sessionKey, configuration_->getTlsSessionResumption(), preferChaCha_));
           auto cryptor(std::make_shared<aasdk::messenger::Cryptor>(std::move(sslWrapper)));
           cryptor->init();
 
-          auto messenger(std::make_shared<aasdk::messenger::Messenger>(ioService_,
-                                                                       std::make_shared<aasdk::messenger::MessageInStream>(
-                                                                           ioService_, transport, cryptor),
-                                                                       std::make_shared<aasdk::messenger::MessageOutStream>(
-                                                                           ioService_, transport, cryptor)));
+          aasdk::messenger::IMessageInStream::Pointer inStream;
+          if (configuration_->getMessageBufferPool()) {
+            inStream = std::make_shared<PooledMessageInStream>(ioService_, transport, cryptor);
+          } else {
+            inStream = std::make_shared<aasdk::messenger::MessageInStream>(ioService_, transport, cryptor);
+          }
+          aasdk::messenger::IMessenger::Pointer messenger(std::make_shared<aasdk::messenger::Messenger>(
+              ioService_, std::move(inStream),
+              std::make_shared<aasdk::messenger::MessageOutStream>(ioService_, transport, cryptor)));
+          if (configuration_->getOutboundPriority()) {
+            messenger = std::make_shared<PriorityMessenger>(ioService_, std::move(messenger));
+          }
 
           auto serviceList = serviceFactory_.create(messenger);
           auto pinger(std::make_shared<Pinger>(ioService_, 5000));
-          return std::make_shared<AndroidAutoEntity>(ioService_, std::move(cryptor), std::move(transport),
-                                                     std::move(messenger), configuration_, std::move(serviceList),
-                                                     std::move(pinger));
+          auto entity = std::make_shared<AndroidAutoEntity>(ioService_, std::move(cryptor), std::move(transport),
+                                                            std::move(messenger), configuration_,
+                                                            std::move(serviceList), std::move(pinger));
+          // The service factory outlives every entity it builds services for
+          IServiceFactory *serviceFactory = &serviceFactory_;
+          entity->setAudioFocusHandler(
+              [serviceFactory](aap_protobuf::service::control::message::AudioFocusRequestType type) {
+                serviceFactory->onPhoneAudioFocus(type);
+              });
+          entity->setPhoneIdentityHandler(
+              [serviceFactory](const std::string &phone) { serviceFactory->onPhoneIdentified(phone); });
+          return entity;
         }
 
       }
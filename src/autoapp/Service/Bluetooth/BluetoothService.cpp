@@ -17,6 +17,7 @@
 */
 
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
 #include <f1x/openauto/autoapp/Service/Bluetooth/BluetoothService.hpp>
 
 namespace f1x::openauto::autoapp::service::bluetooth {
@@ -86,6 +87,7 @@ namespace f1x::openauto::autoapp::service::bluetooth {
 
   void
   BluetoothService::onChannelOpenRequest(const aap_protobuf::service::control::message::ChannelOpenRequest &request) {
+    FlightRecorder::instance().record(FlightEvent::ChannelOpened, request.service_id());
     OPENAUTO_LOG(info) << "[BluetoothService] onChannelOpenRequest()";
     OPENAUTO_LOG(debug) << "[BluetoothService] Channel Id: " << request.service_id() << ", Priority: "
                         << request.priority();
@@ -0,0 +1,194 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <map>
+#include <mutex>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/Service/CachingSSLWrapper.hpp>
+#include <f1x/openauto/autoapp/Service/TlsCipherPolicy.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x::openauto::autoapp::service {
+
+  namespace {
+    // Parsed once, referenced by every connection for the life of the process
+    struct SharedTlsState {
+      std::mutex mutex;
+      X509 *certificate = nullptr;
+      EVP_PKEY *privateKey = nullptr;
+      SSL_CTX *context = nullptr;
+      bool certificateSet = false;
+      bool privateKeySet = false;
+      std::map<std::string, SSL_SESSION *> sessions;
+      int exDataIndex = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    };
+
+    SharedTlsState &shared() {
+      static SharedTlsState state;
+      return state;
+    }
+
+    struct TlsMetrics {
+      MetricCounter &handshakes = Metrics::instance().counter(
+          "openauto_tls_handshakes_total", "TLS handshakes completed with a phone");
+      MetricCounter &resumed = Metrics::instance().counter(
+          "openauto_tls_resumed_total", "TLS handshakes that resumed a cached session");
+      MetricHistogram &duration = Metrics::instance().histogram(
+          "openauto_tls_handshake_ms", "Time from the first handshake record to completion",
+          {10, 25, 50, 100, 200, 400, 800, 1600, 3200});
+    };
+
+    TlsMetrics &metrics() {
+      static TlsMetrics instance;
+      return instance;
+    }
+  }
+
+  CachingSSLWrapper::CachingSSLWrapper(std::string sessionKey, bool resumeSessions, bool preferChaCha)
+      : sessionKey_(std::move(sessionKey)), resumeSessions_(resumeSessions), preferChaCha_(preferChaCha),
+        handshakeDone_(false) {
+  }
+
+  X509 *CachingSSLWrapper::readCertificate(const std::string &certificate) {
+    auto &state = shared();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.certificate == nullptr) {
+      state.certificate = SSLWrapper::readCertificate(certificate);
+    }
+    if (state.certificate != nullptr) {
+      X509_up_ref(state.certificate);
+    }
+    return state.certificate;
+  }
+
+  EVP_PKEY *CachingSSLWrapper::readPrivateKey(const std::string &privateKey) {
+    auto &state = shared();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.privateKey == nullptr) {
+      state.privateKey = SSLWrapper::readPrivateKey(privateKey);
+    }
+    if (state.privateKey != nullptr) {
+      EVP_PKEY_up_ref(state.privateKey);
+    }
+    return state.privateKey;
+  }
+
+  SSL_CTX *CachingSSLWrapper::createContext(const SSL_METHOD *method) {
+    auto &state = shared();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.context == nullptr) {
+      state.context = SSLWrapper::createContext(method);
+      if (state.context == nullptr) {
+        return nullptr;
+      }
+      // Sessions are stored here, per phone, not in OpenSSL's server-side cache;
+      // the callback also catches TLS 1.3 tickets that arrive after the handshake
+      SSL_CTX_set_session_cache_mode(state.context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+      SSL_CTX_sess_set_new_cb(state.context, &CachingSSLWrapper::onNewSession);
+      OPENAUTO_LOG(info) << "[CachingSSLWrapper] Cipher order: " << applyCipherPreference(state.context, preferChaCha_);
+    }
+    SSL_CTX_up_ref(state.context);
+    return state.context;
+  }
+
+  bool CachingSSLWrapper::useCertificate(SSL_CTX *context, X509 *certificate) {
+    auto &state = shared();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.certificateSet) {
+      state.certificateSet = SSLWrapper::useCertificate(context, certificate);
+    }
+    return state.certificateSet;
+  }
+
+  bool CachingSSLWrapper::usePrivateKey(SSL_CTX *context, EVP_PKEY *privateKey) {
+    auto &state = shared();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.privateKeySet) {
+      state.privateKeySet = SSLWrapper::usePrivateKey(context, privateKey);
+    }
+    return state.privateKeySet;
+  }
+
+  SSL *CachingSSLWrapper::createInstance(SSL_CTX *context) {
+    SSL *ssl = SSLWrapper::createInstance(context);
+    if (ssl == nullptr) {
+      return nullptr;
+    }
+
+    auto &state = shared();
+    SSL_set_ex_data(ssl, state.exDataIndex, this);
+    handshakeStart_ = std::chrono::steady_clock::time_point();
+    handshakeDone_ = false;
+
+    if (resumeSessions_) {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      auto it = state.sessions.find(sessionKey_);
+      if (it != state.sessions.end() && SSL_set_session(ssl, it->second) != 1) {
+        OPENAUTO_LOG(warning) << "[CachingSSLWrapper] Cached " << sessionKey_ << " session unusable, dropping it";
+        SSL_SESSION_free(it->second);
+        state.sessions.erase(it);
+      }
+    }
+    return ssl;
+  }
+
+  int CachingSSLWrapper::doHandshake(SSL *ssl) {
+    if (handshakeStart_ == std::chrono::steady_clock::time_point()) {
+      handshakeStart_ = std::chrono::steady_clock::now();
+    }
+
+    const int result = SSLWrapper::doHandshake(ssl);
+    if (result == 1 && !handshakeDone_) {
+      handshakeDone_ = true;
+      const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - handshakeStart_);
+      const bool resumed = SSL_session_reused(ssl) == 1;
+
+      auto &m = metrics();
+      m.handshakes.add();
+      if (resumed) {
+        m.resumed.add();
+      }
+      m.duration.observe(elapsed.count() / 1000.0);
+      OPENAUTO_LOG(info) << "[CachingSSLWrapper] " << (resumed ? "Resumed" : "Full") << " handshake over "
+                         << sessionKey_ << " in " << elapsed.count() / 1000 << " ms, " << SSL_get_cipher_name(ssl);
+    }
+    return result;
+  }
+
+  int CachingSSLWrapper::onNewSession(SSL *ssl, SSL_SESSION *session) {
+    auto &state = shared();
+    auto *self = static_cast<CachingSSLWrapper *>(SSL_get_ex_data(ssl, state.exDataIndex));
+    if (self == nullptr || !self->resumeSessions_) {
+      return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    auto &slot = state.sessions[self->sessionKey_];
+    if (slot != nullptr) {
+      SSL_SESSION_free(slot);
+    }
+    // Returning 1 hands our reference to the cache
+    slot = session;
+    return 1;
+  }
+
+}
@@ -0,0 +1,113 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <f1x/openauto/autoapp/Service/DeferredService.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x::openauto::autoapp::service {
+
+  DeferredService::DeferredService(boost::asio::io_service &ioService, std::string name, Factory factory)
+      : ioService_(ioService), name_(std::move(name)), factory_(std::move(factory)), started_(false) {
+
+  }
+
+  IService::Pointer DeferredService::get() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (service_ == nullptr && factory_) {
+      const auto begin = std::chrono::steady_clock::now();
+      service_ = factory_();
+      factory_ = nullptr;
+      OPENAUTO_LOG(info) << "[DeferredService] " << name_ << " built in "
+                         << std::chrono::duration_cast<std::chrono::milliseconds>(
+                                std::chrono::steady_clock::now() - begin).count()
+                         << " ms";
+      if (service_ != nullptr && started_) {
+        service_->start();
+      }
+    }
+    return service_;
+  }
+
+  void DeferredService::start() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      started_ = true;
+      if (service_ != nullptr) {
+        service_->start();
+        return;
+      }
+    }
+
+    // Behind the entity's own start-up work on the io_service
+    ioService_.post([this, self = this->shared_from_this()]() {
+      bool started;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        started = started_;
+      }
+      if (started) {
+        this->get();
+      }
+    });
+  }
+
+  void DeferredService::stop() {
+    this->shutdown(nullptr);
+  }
+
+  void DeferredService::shutdown(std::function<void()> done) {
+    IService::Pointer service;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      started_ = false;
+      service = service_;
+    }
+    if (service != nullptr) {
+      service->shutdown(std::move(done));
+    } else if (done) {
+      done();
+    }
+  }
+
+  bool DeferredService::holdsDevices() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return service_ != nullptr && service_->holdsDevices();
+  }
+
+  void DeferredService::pause() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (service_ != nullptr) {
+      service_->pause();
+    }
+  }
+
+  void DeferredService::resume() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (service_ != nullptr) {
+      service_->resume();
+    }
+  }
+
+  void DeferredService::fillFeatures(aap_protobuf::service::control::message::ServiceDiscoveryResponse &response) {
+    if (auto service = this->get()) {
+      service->fillFeatures(response);
+    }
+  }
+
+}
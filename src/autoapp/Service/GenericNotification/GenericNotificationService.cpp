@@ -17,7 +17,9 @@
 */
 
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
 #include <f1x/openauto/autoapp/Service/GenericNotification/GenericNotificationService.hpp>
+#include <f1x/openauto/autoapp/UI/NotificationModel.hpp>
 #include <fstream>
 #include <QString>
 
@@ -35,12 +37,21 @@ namespace f1x::openauto::autoapp::service::genericnotification {
   void GenericNotificationService::start() {
     strand_.dispatch([this, self = this->shared_from_this()]() {
       OPENAUTO_LOG(info) << "[GenericNotificationService] start()";
+      this->running_ = true;
     });
   }
 
   void GenericNotificationService::stop() {
     strand_.dispatch([this, self = this->shared_from_this()]() {
       OPENAUTO_LOG(info) << "[GenericNotificationService] stop()";
+      this->running_ = false;
+
+      boost::system::error_code ec;
+      this->timer_.cancel(ec);
+      this->flushAt_ = NotificationQueue::Clock::time_point::max();
+      if (this->queue_.clear()) {
+        this->publish();
+      }
     });
   }
 
@@ -69,6 +80,7 @@ namespace f1x::openauto::autoapp::service::genericnotification {
 
   void GenericNotificationService::onChannelOpenRequest(
       const aap_protobuf::service::control::message::ChannelOpenRequest &request) {
+    FlightRecorder::instance().record(FlightEvent::ChannelOpened, request.service_id());
     OPENAUTO_LOG(info) << "[GenericNotificationService] onChannelOpenRequest()";
     OPENAUTO_LOG(debug) << "[GenericNotificationService] Channel Id: " << request.service_id() << ", Priority: "
                         << request.priority();
@@ -88,6 +100,69 @@ namespace f1x::openauto::autoapp::service::genericnotification {
   void GenericNotificationService::onChannelError(const aasdk::error::Error &e) {
     OPENAUTO_LOG(error) << "[GenericNotificationService] onChannelError(): " << e.what();
   }
+
+  void GenericNotificationService::post(Notification notification) {
+    strand_.dispatch([this, self = this->shared_from_this(), notification = std::move(notification)]() mutable {
+      if (!this->running_) {
+        return;
+      }
+      const uint64_t dropped = this->queue_.dropped();
+      this->queue_.offer(std::move(notification));
+      if (this->queue_.dropped() != dropped) {
+        OPENAUTO_LOG_EVERY_MS(debug, 10000) << "[GenericNotificationService] Burst of new notifications, dropped "
+                                            << this->queue_.dropped() << " so far";
+      }
+      this->flush();
+    });
+  }
+
+  void GenericNotificationService::dismiss(const std::string &id) {
+    strand_.dispatch([this, self = this->shared_from_this(), id]() {
+      if (this->queue_.dismiss(id)) {
+        this->publish();
+      }
+    });
+  }
+
+  void GenericNotificationService::flush() {
+    if (!this->running_) {
+      return;
+    }
+
+    const auto now = NotificationQueue::Clock::now();
+    if (this->queue_.collect(now)) {
+      this->publish();
+    }
+
+    // Held notifications and toast expiry share one timer, armed only while
+    // something is on screen or waiting
+    const auto next = this->queue_.nextDue();
+    if (next == NotificationQueue::Clock::time_point::max() || next >= this->flushAt_) {
+      return;
+    }
+    this->flushAt_ = next;
+    this->timer_.expires_at(std::max(next, now));
+    this->timer_.async_wait(strand_.wrap([this, self = this->shared_from_this()](
+                                             const boost::system::error_code &error) {
+      // Aborted only when re-armed earlier, and that wait is still pending
+      if (error != boost::asio::error::operation_aborted) {
+        this->flushAt_ = NotificationQueue::Clock::time_point::max();
+        this->flush();
+      }
+    }));
+  }
+
+  void GenericNotificationService::publish() {
+    QVector<ui::NotificationModel::Toast> toasts;
+    toasts.reserve(static_cast<int>(this->queue_.shown().size()));
+    for (const auto &entry : this->queue_.shown()) {
+      toasts.push_back({QString::fromStdString(entry.notification.id),
+                        QString::fromStdString(entry.notification.title),
+                        QString::fromStdString(entry.notification.text),
+                        static_cast<int>(entry.count)});
+    }
+    ui::NotificationModel::instance().publish(std::move(toasts));
+  }
 }
 
 
@@ -0,0 +1,136 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <f1x/openauto/autoapp/Service/GenericNotification/NotificationQueue.hpp>
+
+namespace f1x::openauto::autoapp::service::genericnotification {
+
+  NotificationQueue::NotificationQueue(size_t capacity, size_t burst, Clock::duration window,
+                                       Clock::duration lifetime)
+      : capacity_(std::max<size_t>(capacity, 1)),
+        burst_(std::max<size_t>(burst, 1)),
+        window_(window),
+        lifetime_(lifetime) {
+
+  }
+
+  void NotificationQueue::offer(Notification notification) {
+    auto held = std::find_if(held_.begin(), held_.end(), [&notification](const Held &h) {
+      return h.notification.id == notification.id;
+    });
+    if (held != held_.end()) {
+      held->notification = std::move(notification);
+      held->count++;
+      return;
+    }
+
+    held_.push_back({std::move(notification), 1});
+    // More new ids than fit on screen: the oldest would be pushed off anyway
+    if (held_.size() > capacity_) {
+      held_.erase(held_.begin());
+      dropped_++;
+    }
+  }
+
+  bool NotificationQueue::dismiss(const std::string &id) {
+    held_.erase(std::remove_if(held_.begin(), held_.end(), [&id](const Held &h) {
+      return h.notification.id == id;
+    }), held_.end());
+
+    const size_t before = shown_.size();
+    shown_.erase(std::remove_if(shown_.begin(), shown_.end(), [&id](const Entry &e) {
+      return e.notification.id == id;
+    }), shown_.end());
+    return shown_.size() != before;
+  }
+
+  bool NotificationQueue::clear() {
+    held_.clear();
+    if (shown_.empty()) {
+      return false;
+    }
+    shown_.clear();
+    return true;
+  }
+
+  bool NotificationQueue::collect(Clock::time_point now) {
+    bool changed = expire(now);
+
+    while (!published_.empty() && now - published_.front() >= window_) {
+      published_.pop_front();
+    }
+    if (held_.empty() || published_.size() >= burst_) {
+      return changed;
+    }
+
+    // Everything held goes out as one update
+    for (auto &held : held_) {
+      show(std::move(held), now);
+    }
+    held_.clear();
+    published_.push_back(now);
+    return true;
+  }
+
+  NotificationQueue::Clock::time_point NotificationQueue::nextDue() const {
+    auto next = Clock::time_point::max();
+    for (const auto &entry : shown_) {
+      next = std::min(next, entry.shownAt + lifetime_);
+    }
+    if (!held_.empty()) {
+      next = std::min(next, published_.size() < burst_ ? Clock::time_point::min() : published_.front() + window_);
+    }
+    return next;
+  }
+
+  const std::vector<NotificationQueue::Entry> &NotificationQueue::shown() const {
+    return shown_;
+  }
+
+  uint64_t NotificationQueue::dropped() const {
+    return dropped_;
+  }
+
+  bool NotificationQueue::expire(Clock::time_point now) {
+    const size_t before = shown_.size();
+    shown_.erase(std::remove_if(shown_.begin(), shown_.end(), [this, now](const Entry &e) {
+      return now - e.shownAt >= lifetime_;
+    }), shown_.end());
+    return shown_.size() != before;
+  }
+
+  void NotificationQueue::show(Held held, Clock::time_point now) {
+    auto entry = std::find_if(shown_.begin(), shown_.end(), [&held](const Entry &e) {
+      return e.notification.id == held.notification.id;
+    });
+    if (entry != shown_.end()) {
+      // Updated in place, so the toasts around it do not move
+      entry->notification = std::move(held.notification);
+      entry->count += held.count;
+      entry->shownAt = now;
+      return;
+    }
+
+    shown_.push_back({std::move(held.notification), held.count, now});
+    if (shown_.size() > capacity_) {
+      shown_.erase(shown_.begin());
+    }
+  }
+
+}
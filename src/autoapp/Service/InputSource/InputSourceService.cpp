@@ -17,20 +17,47 @@
 */
 
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
 #include <f1x/openauto/autoapp/Service/InputSource/InputSourceService.hpp>
+#include <f1x/openauto/autoapp/PipelineTrace.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
+#include <f1x/openauto/autoapp/StrandMonitor.hpp>
 
 namespace f1x {
   namespace openauto {
     namespace autoapp {
       namespace service {
         namespace inputsource {
+          namespace {
+            // The phone derives fling velocity from these, so they must say when
+            // the input happened, not when the strand got to it
+            std::chrono::microseconds eventTimestamp(projection::InputTimestamp timestamp) {
+              return timestamp.count() != 0 ? timestamp : projection::inputTimestampNow();
+            }
+          }
+
           InputSourceService::InputSourceService(boost::asio::io_service &ioService,
                                                  aasdk::messenger::IMessenger::Pointer messenger,
-                                                 projection::IInputDevice::Pointer inputDevice)
+                                                 projection::IInputDevice::Pointer inputDevice,
+                                                 std::chrono::microseconds touchCoalesceWindow,
+                                                 std::chrono::microseconds touchPrediction)
               : strand_(ioService),
                 channel_(std::make_shared<aasdk::channel::inputsource::InputSourceService>(strand_, std::move(messenger))),
-                inputDevice_(std::move(inputDevice)) {
-
+                inputDevice_(std::move(inputDevice)),
+                touchCoalesceWindow_(touchCoalesceWindow),
+                moveTimer_(ioService),
+                pendingTimestamp_(0),
+                movePending_(false),
+                autoPrediction_(touchPrediction.count() < 0),
+                settleTimer_(ioService) {
+            const auto surface = inputDevice_->getTouchscreenGeometry();
+            predictor_.setBounds(static_cast<uint32_t>(surface.width()), static_cast<uint32_t>(surface.height()));
+            if (autoPrediction_) {
+              this->updatePredictionHorizon();
+            } else {
+              predictor_.setHorizon(touchPrediction);
+            }
+            realMove_.pointers.reserve(TouchPredictor::cMaxPointers);
           }
 
           void InputSourceService::start() {
@@ -44,6 +71,8 @@ namespace f1x {
             strand_.dispatch([this, self = this->shared_from_this()]() {
               OPENAUTO_LOG(info) << "[InputSourceService] stop()";
               inputDevice_->stop();
+              moveTimer_.cancel();
+              settleTimer_.cancel();
             });
           }
 
@@ -84,6 +113,7 @@ namespace f1x {
           }
 
           void InputSourceService::onChannelOpenRequest(const aap_protobuf::service::control::message::ChannelOpenRequest &request) {
+            FlightRecorder::instance().record(FlightEvent::ChannelOpened, request.service_id());
             OPENAUTO_LOG(info) << "[InputSourceService] onChannelOpenRequest()";
             OPENAUTO_LOG(debug) << "[InputSourceService] Channel Id: " << request.service_id() << ", Priority: " << request.priority();
 
@@ -142,8 +172,7 @@ namespace f1x {
 
           void InputSourceService::onButtonEvent(const projection::ButtonEvent &event) {
             OPENAUTO_LOG(error) << "[InputSourceService] onButtonEvent()";
-            auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
-                std::chrono::high_resolution_clock::now().time_since_epoch());
+            const auto timestamp = eventTimestamp(event.timestamp);
 
             strand_.dispatch(
                 [this, self = this->shared_from_this(), event = std::move(event), timestamp = std::move(timestamp)]() {
@@ -152,7 +181,8 @@ namespace f1x {
 
                   if (event.code == aap_protobuf::service::media::sink::message::KeyCode::KEYCODE_ROTARY_CONTROLLER) {
                     auto relativeEvent = inputReport.mutable_relative_event()->add_data();
-                    relativeEvent->set_delta(event.wheelDirection == projection::WheelDirection::LEFT ? -1 : 1);
+                    const int32_t steps = static_cast<int32_t>(event.wheelSteps);
+                    relativeEvent->set_delta(event.wheelDirection == projection::WheelDirection::LEFT ? -steps : steps);
                     relativeEvent->set_keycode(event.code);
                   } else {
                     auto buttonEvent = inputReport.mutable_key_event()->add_keys();
@@ -170,37 +200,142 @@ namespace f1x {
           }
 
           void InputSourceService::onTouchEvent(const projection::TouchEvent &event) {
-            OPENAUTO_LOG(debug) << "[InputSourceService] onTouchEvent: action=" << event.type 
-                                << " pointerCount=" << event.pointers.size() 
-                                << " actionIndex=" << event.actionIndex;
-            
-            auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
-                std::chrono::high_resolution_clock::now().time_since_epoch());
+            OPENAUTO_TRACE_SCOPE("touch.event");
+            FlightRecorder::instance().record(FlightEvent::Touch, static_cast<int64_t>(event.type),
+                                              static_cast<int32_t>(event.pointers.size()));
+            const auto timestamp = eventTimestamp(event.timestamp);
+
+            if (event.type == aap_protobuf::service::inputsource::message::PointerAction::ACTION_MOVED &&
+                touchCoalesceWindow_ > std::chrono::microseconds::zero()) {
+              // Every move carries all pointers, so the newest one supersedes
+              // whatever is still waiting; only the first of a burst wakes the strand
+              bool schedule;
+              {
+                std::lock_guard<std::mutex> lock(pendingMutex_);
+                schedule = !movePending_;
+                pendingMove_.type = event.type;
+                pendingMove_.actionIndex = event.actionIndex;
+                pendingMove_.pointers.assign(event.pointers.begin(), event.pointers.end());
+                pendingTimestamp_ = timestamp;
+                movePending_ = true;
+              }
 
-            strand_.dispatch(
-                [this, self = this->shared_from_this(), event = std::move(event), timestamp = std::move(timestamp)]() {
-                  aap_protobuf::service::inputsource::message::InputReport inputReport;
-                  inputReport.set_timestamp(timestamp.count());
+              if (schedule) {
+                strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("input.move"), [this, self = this->shared_from_this()]() {
+                  this->scheduleMoveFlush();
+                }));
+              }
+              return;
+            }
+
+            // Down and up go out at once, after the move that preceded them
+            strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("input.touch"), [this, self = this->shared_from_this(), event, timestamp]() {
+              this->flushPendingMove();
+              this->sendTouchEvent(event, timestamp);
+            }));
+          }
+
+          void InputSourceService::scheduleMoveFlush() {
+            // The first move after a pause goes out immediately, later ones at
+            // most once per window
+            const auto due = lastMoveSent_ + touchCoalesceWindow_;
+            if (due <= std::chrono::steady_clock::now()) {
+              this->flushPendingMove();
+              return;
+            }
 
-                  auto touchEvent = inputReport.mutable_touch_event();
-                  touchEvent->set_action(event.type);
-                  touchEvent->set_action_index(event.actionIndex);
-                  
-                  // Add all touch points
-                  for(const auto& pointer : event.pointers)
-                  {
-                      auto touchLocation = touchEvent->add_pointer_data();
-                      touchLocation->set_x(pointer.x);
-                      touchLocation->set_y(pointer.y);
-                      touchLocation->set_pointer_id(pointer.pointerId);
+            moveTimer_.expires_at(due);
+            moveTimer_.async_wait(strand_.wrap(monitoredCompletion(
+                OPENAUTO_STRAND_SITE("input.move_timer"), [this, self = this->shared_from_this()](const boost::system::error_code &ec) {
+                  if (ec != boost::asio::error::operation_aborted) {
+                    this->flushPendingMove();
                   }
+                })));
+          }
 
-                  auto promise = aasdk::channel::SendPromise::defer(strand_);
-                  promise->then([]() {}, std::bind(&InputSourceService::onChannelError, this->shared_from_this(),
-                                                   std::placeholders::_1));
-                  channel_->sendInputReport(inputReport, std::move(promise));
-                });
+          void InputSourceService::flushPendingMove() {
+            std::chrono::microseconds timestamp;
+            {
+              std::lock_guard<std::mutex> lock(pendingMutex_);
+              if (!movePending_) {
+                return;
+              }
+              // Swapping keeps both pointer vectors' capacity for the next burst
+              std::swap(sendingMove_, pendingMove_);
+              timestamp = pendingTimestamp_;
+              movePending_ = false;
+            }
+
+            lastMoveSent_ = std::chrono::steady_clock::now();
+            this->sendTouchEvent(sendingMove_, timestamp);
           }
+
+          void InputSourceService::sendTouchEvent(const projection::TouchEvent &event,
+                                                  std::chrono::microseconds timestamp, bool mayPredict) {
+            OPENAUTO_TRACE_SCOPE("touch.send");
+            if (autoPrediction_ && event.type == aap_protobuf::service::inputsource::message::PointerAction::ACTION_DOWN) {
+              this->updatePredictionHorizon();
+            }
+            const bool predict = mayPredict && predictor_.enabled() &&
+                                 event.type == aap_protobuf::service::inputsource::message::PointerAction::ACTION_MOVED;
+            if (predictor_.enabled()) {
+              predictor_.observe(event, timestamp);
+              if (predict) {
+                realMove_.type = event.type;
+                realMove_.actionIndex = event.actionIndex;
+                realMove_.pointers.assign(event.pointers.begin(), event.pointers.end());
+                this->scheduleSettle();
+              } else {
+                settleTimer_.cancel();
+              }
+            }
+
+            // Clear() keeps the pointer_data elements allocated; the report is
+            // serialized by sendInputReport before it returns
+            touchReport_.Clear();
+            touchReport_.set_timestamp(timestamp.count());
+
+            auto touchEvent = touchReport_.mutable_touch_event();
+            touchEvent->set_action(event.type);
+            touchEvent->set_action_index(event.actionIndex);
+
+            for (const auto &pointer: event.pointers) {
+              const auto point = predict ? predictor_.predict(pointer) : pointer;
+              auto touchLocation = touchEvent->add_pointer_data();
+              touchLocation->set_x(point.x);
+              touchLocation->set_y(point.y);
+              touchLocation->set_pointer_id(point.pointerId);
+            }
+
+            auto promise = aasdk::channel::SendPromise::defer(strand_);
+            promise->then([]() {}, std::bind(&InputSourceService::onChannelError, this->shared_from_this(),
+                                             std::placeholders::_1));
+            channel_->sendInputReport(touchReport_, std::move(promise));
+          }
+
+          void InputSourceService::updatePredictionHorizon() {
+            const auto latency = projection::VideoTelemetry::instance().snapshot().endToEnd;
+            // Until frames have been measured, one frame or coalescing window
+            const auto previous = predictor_.horizon();
+            predictor_.setHorizon(latency.samples >= cMinLatencySamples
+                                      ? std::chrono::microseconds(latency.p50Us)
+                                      : std::max(touchCoalesceWindow_, std::chrono::microseconds(16667)));
+            if (predictor_.horizon() != previous) {
+              OPENAUTO_LOG(debug) << "[InputSourceService] Predicting drags "
+                                  << predictor_.horizon().count() / 1000.0 << " ms ahead";
+            }
+          }
+
+          void InputSourceService::scheduleSettle() {
+            settleTimer_.expires_from_now(cSettleDelay);
+            settleTimer_.async_wait(strand_.wrap(monitoredCompletion(
+                OPENAUTO_STRAND_SITE("input.settle_timer"), [this, self = this->shared_from_this()](const boost::system::error_code &ec) {
+                  if (ec != boost::asio::error::operation_aborted) {
+                    this->sendTouchEvent(realMove_, projection::inputTimestampNow(), false);
+                  }
+                })));
+          }
+
         }
       }
     }
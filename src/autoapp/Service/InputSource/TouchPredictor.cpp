@@ -0,0 +1,160 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <f1x/openauto/autoapp/Service/InputSource/TouchPredictor.hpp>
+
+namespace f1x {
+  namespace openauto {
+    namespace autoapp {
+      namespace service {
+        namespace inputsource {
+
+          using aap_protobuf::service::inputsource::message::PointerAction;
+
+          void TouchPredictor::setHorizon(std::chrono::microseconds horizon) {
+            horizon_ = std::clamp(horizon, std::chrono::microseconds::zero(), std::chrono::microseconds(cMaxHorizonUs));
+          }
+
+          void TouchPredictor::setBounds(uint32_t width, uint32_t height) {
+            width_ = width;
+            height_ = height;
+          }
+
+          void TouchPredictor::observe(const projection::TouchEvent &event, std::chrono::microseconds timestamp) {
+            const int64_t atUs = timestamp.count();
+            const uint32_t changedId =
+                event.actionIndex < event.pointers.size() ? event.pointers[event.actionIndex].pointerId : cMaxPointers;
+
+            switch (event.type) {
+              case PointerAction::ACTION_DOWN:
+                for (uint32_t id = 0; id < cMaxPointers; ++id) {
+                  this->reset(id);
+                }
+                break;
+              case PointerAction::ACTION_POINTER_DOWN:
+                this->reset(changedId);
+                break;
+              case PointerAction::ACTION_POINTER_UP:
+                this->reset(changedId);
+                break;
+              case PointerAction::ACTION_UP:
+                for (uint32_t id = 0; id < cMaxPointers; ++id) {
+                  this->reset(id);
+                }
+                return;
+              default:
+                break;
+            }
+
+            for (const auto &pointer: event.pointers) {
+              if (event.type != PointerAction::ACTION_POINTER_UP || pointer.pointerId != changedId) {
+                this->add(pointer.pointerId, pointer, atUs);
+              }
+            }
+          }
+
+          projection::TouchPoint TouchPredictor::predict(const projection::TouchPoint &pointer) const {
+            if (!this->enabled() || pointer.pointerId >= cMaxPointers) {
+              return pointer;
+            }
+            const Track &track = tracks_[pointer.pointerId];
+            if (track.count < cMinSamples) {
+              return pointer;
+            }
+
+            // Least-squares velocity over the track, relative to its mean
+            double meanT = 0.0;
+            double meanX = 0.0;
+            double meanY = 0.0;
+            const Sample &newest = track.samples[(track.next + cHistory - 1) % cHistory];
+            for (size_t i = 0; i < track.count; ++i) {
+              const Sample &sample = track.samples[(track.next + cHistory - 1 - i) % cHistory];
+              meanT += static_cast<double>(sample.atUs - newest.atUs);
+              meanX += sample.x;
+              meanY += sample.y;
+            }
+            meanT /= track.count;
+            meanX /= track.count;
+            meanY /= track.count;
+            double tt = 0.0;
+            double tx = 0.0;
+            double ty = 0.0;
+            for (size_t i = 0; i < track.count; ++i) {
+              const Sample &sample = track.samples[(track.next + cHistory - 1 - i) % cHistory];
+              const double t = static_cast<double>(sample.atUs - newest.atUs) - meanT;
+              tt += t * t;
+              tx += t * (sample.x - meanX);
+              ty += t * (sample.y - meanY);
+            }
+            if (tt <= 0.0) {
+              return pointer;
+            }
+
+            const double horizonUs = static_cast<double>(horizon_.count());
+            double leadX = tx / tt * horizonUs;
+            double leadY = ty / tt * horizonUs;
+            const double lead = std::hypot(leadX, leadY);
+            if (lead > cMaxLeadPx) {
+              leadX *= cMaxLeadPx / lead;
+              leadY *= cMaxLeadPx / lead;
+            }
+
+            projection::TouchPoint predicted = pointer;
+            const auto clampTo = [](double value, uint32_t size) {
+              const double limit = size > 0 ? static_cast<double>(size - 1) : value;
+              return static_cast<uint32_t>(std::lround(std::clamp(value, 0.0, std::max(limit, 0.0))));
+            };
+            predicted.x = clampTo(pointer.x + leadX, width_);
+            predicted.y = clampTo(pointer.y + leadY, height_);
+            return predicted;
+          }
+
+          void TouchPredictor::add(uint32_t pointerId, const projection::TouchPoint &point, int64_t atUs) {
+            if (pointerId >= cMaxPointers) {
+              return;
+            }
+            Track &track = tracks_[pointerId];
+            // A report no newer than the last one replaces it
+            if (track.count > 0 && track.samples[(track.next + cHistory - 1) % cHistory].atUs >= atUs) {
+              track.next = (track.next + cHistory - 1) % cHistory;
+              track.count--;
+            }
+            track.samples[track.next] = {atUs, static_cast<double>(point.x), static_cast<double>(point.y)};
+            track.next = (track.next + 1) % cHistory;
+            track.count = std::min(track.count + 1, cHistory);
+
+            // A finger that rested and moves again starts a fresh line
+            while (track.count > 1 &&
+                   atUs - track.samples[(track.next + cHistory - track.count) % cHistory].atUs > cMaxSampleAgeUs) {
+              track.count--;
+            }
+          }
+
+          void TouchPredictor::reset(uint32_t pointerId) {
+            if (pointerId < cMaxPointers) {
+              tracks_[pointerId] = Track();
+            }
+          }
+
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,442 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Service/MediaBrowser/BrowseCache.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+namespace f1x::openauto::autoapp::service::mediabrowser {
+
+  namespace {
+    constexpr char cMagic[4] = {'O', 'A', 'B', 'N'};
+    constexpr uint32_t cFormat = 1;
+    constexpr char cSuffix[] = ".node";
+
+    uint64_t fnv(uint64_t hash, const void *data, size_t size) {
+      const auto *bytes = static_cast<const unsigned char *>(data);
+      for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+      }
+      return hash;
+    }
+
+    uint64_t fnv(uint64_t hash, const std::string &text) {
+      // The length keeps "ab" + "c" apart from "a" + "bc"
+      const uint64_t size = text.size();
+      return fnv(fnv(hash, &size, sizeof(size)), text.data(), text.size());
+    }
+
+    std::string hex(uint64_t value) {
+      char text[17];
+      std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+      return text;
+    }
+
+    // Native byte order: the files never leave the head unit
+    template<typename T>
+    void put(std::string &out, T value) {
+      out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void put(std::string &out, const std::string &text) {
+      put<uint32_t>(out, static_cast<uint32_t>(text.size()));
+      out += text;
+    }
+
+    struct Reader {
+      const std::string &data;
+      size_t pos = 0;
+      bool ok = true;
+
+      template<typename T>
+      T get() {
+        T value{};
+        if (!ok || data.size() - pos < sizeof(value)) {
+          ok = false;
+          return value;
+        }
+        std::memcpy(&value, data.data() + pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+      }
+
+      std::string text() {
+        const uint32_t size = get<uint32_t>();
+        if (!ok || data.size() - pos < size) {
+          ok = false;
+          return std::string();
+        }
+        pos += size;
+        return data.substr(pos - size, size);
+      }
+    };
+
+    void makePath(const std::string &directory) {
+      for (size_t slash = directory.find('/', 1); slash != std::string::npos; slash = directory.find('/', slash + 1)) {
+        mkdir(directory.substr(0, slash).c_str(), 0755);
+      }
+      mkdir(directory.c_str(), 0755);
+    }
+  }
+
+  BrowseCache::BrowseCache(std::string directory, size_t capacity, size_t diskCapacity)
+      : directory_(std::move(directory)),
+        capacity_(std::max<size_t>(capacity, 1)),
+        diskCapacity_(std::max<size_t>(diskCapacity, 1)) {
+
+  }
+
+  void BrowseCache::setPhone(const std::string &phone) {
+    if (phone == phone_) {
+      return;
+    }
+    entries_.clear();
+    index_.clear();
+    phone_ = phone;
+    // Device names may hold anything a path may not
+    phoneDirectory_ = directory_.empty() || phone_.empty()
+                          ? std::string()
+                          : directory_ + "/" + hex(fnv(14695981039346656037ull, phone_));
+    scanDisk();
+  }
+
+  const std::string &BrowseCache::phone() const {
+    return phone_;
+  }
+
+  const BrowseNode *BrowseCache::find(const std::string &path) {
+    auto indexed = index_.find(path);
+    if (indexed != index_.end()) {
+      entries_.splice(entries_.begin(), entries_, indexed->second);
+      return &entries_.front().node;
+    }
+
+    BrowseNode node;
+    if (!readDisk(path, node)) {
+      return nullptr;
+    }
+    return &insert(std::move(node), false).node;
+  }
+
+  bool BrowseCache::stale(const std::string &path) const {
+    auto indexed = index_.find(path);
+    return indexed != index_.end() && indexed->second->stale;
+  }
+
+  std::vector<std::string> BrowseCache::store(BrowseNode node) {
+    std::vector<std::string> paths;
+    std::unordered_set<std::string> visited{node.path};
+
+    // What the previous listing said about each child
+    bool known = false;
+    bool changed = false;
+    std::unordered_map<std::string, uint64_t> before;
+    std::vector<uint64_t> order;
+    auto remember = [&](const BrowseNode &previous) {
+      known = true;
+      changed = previous.version != node.version;
+      for (const auto &item : previous.items) {
+        const uint64_t print = fingerprint(item);
+        before.emplace(item.path, print);
+        order.push_back(print);
+      }
+    };
+    if (Entry *entry = peek(node.path)) {
+      remember(entry->node);
+      changed = changed || entry->stale;
+    } else {
+      BrowseNode previous;
+      if (readDisk(node.path, previous)) {
+        remember(previous);
+      }
+    }
+
+    changed = changed || !known || order.size() != node.items.size();
+    for (size_t i = 0; i < node.items.size(); i++) {
+      const BrowseItem &item = node.items[i];
+      const uint64_t print = fingerprint(item);
+      changed = changed || i >= order.size() || order[i] != print;
+
+      auto previous = before.find(item.path);
+      if (previous != before.end() && previous->second != print && item.browsable) {
+        markStale(item.path, visited, paths);
+      }
+    }
+
+    const bool onDisk = diskIndex_.count(nodeFile(node.path)) != 0;
+    const Entry &entry = insert(std::move(node), false);
+    if (changed || !onDisk) {
+      writeDisk(entry.node);
+    }
+    return paths;
+  }
+
+  std::vector<std::string> BrowseCache::invalidate(const std::string &path) {
+    std::vector<std::string> paths;
+    std::unordered_set<std::string> visited;
+    markStale(path, visited, paths);
+    return paths;
+  }
+
+  void BrowseCache::clear() {
+    entries_.clear();
+    index_.clear();
+    for (const auto &file : diskOrder_) {
+      std::remove((phoneDirectory_ + "/" + file).c_str());
+    }
+    diskOrder_.clear();
+    diskIndex_.clear();
+    if (hasDisk()) {
+      rmdir(phoneDirectory_.c_str());
+    }
+  }
+
+  size_t BrowseCache::size() const {
+    return entries_.size();
+  }
+
+  size_t BrowseCache::diskSize() const {
+    return diskOrder_.size();
+  }
+
+  uint64_t BrowseCache::fingerprint(const BrowseItem &item) {
+    uint64_t hash = 14695981039346656037ull;
+    hash = fnv(hash, item.path);
+    hash = fnv(hash, item.title);
+    hash = fnv(hash, item.subtitle);
+    hash = fnv(hash, item.artKey);
+    const uint8_t flags = (item.browsable ? 1 : 0) | (item.playable ? 2 : 0);
+    hash = fnv(hash, &flags, sizeof(flags));
+    return fnv(hash, &item.version, sizeof(item.version));
+  }
+
+  BrowseCache::Entry *BrowseCache::peek(const std::string &path) {
+    auto indexed = index_.find(path);
+    return indexed == index_.end() ? nullptr : &*indexed->second;
+  }
+
+  BrowseCache::Entry &BrowseCache::insert(BrowseNode node, bool stale) {
+    auto indexed = index_.find(node.path);
+    if (indexed != index_.end()) {
+      entries_.splice(entries_.begin(), entries_, indexed->second);
+      entries_.front().node = std::move(node);
+      entries_.front().stale = stale;
+      return entries_.front();
+    }
+
+    entries_.push_front({std::move(node), stale});
+    index_.emplace(entries_.front().node.path, entries_.begin());
+    // Fresh nodes are on disk already, stale ones are requested again anyway
+    if (entries_.size() > capacity_) {
+      index_.erase(entries_.back().node.path);
+      entries_.pop_back();
+    }
+    return entries_.front();
+  }
+
+  void BrowseCache::markStale(const std::string &path, std::unordered_set<std::string> &visited,
+                              std::vector<std::string> &paths) {
+    // The tree is only as acyclic as the phone makes it
+    if (!visited.insert(path).second) {
+      return;
+    }
+
+    BrowseNode fromDisk;
+    const BrowseNode *node = nullptr;
+    if (Entry *entry = peek(path)) {
+      entry->stale = true;
+      node = &entry->node;
+      // Shown or about to be: worth requesting now. Nodes only on disk are
+      // dropped below and requested when visited
+      paths.push_back(path);
+    } else if (readDisk(path, fromDisk)) {
+      node = &fromDisk;
+    } else {
+      return;
+    }
+
+    eraseDisk(path);
+    for (const auto &item : node->items) {
+      if (item.browsable) {
+        markStale(item.path, visited, paths);
+      }
+    }
+  }
+
+  bool BrowseCache::hasDisk() const {
+    return !phoneDirectory_.empty();
+  }
+
+  std::string BrowseCache::nodeFile(const std::string &path) const {
+    return hex(fnv(14695981039346656037ull, path)) + cSuffix;
+  }
+
+  void BrowseCache::scanDisk() {
+    diskOrder_.clear();
+    diskIndex_.clear();
+    if (!hasDisk()) {
+      return;
+    }
+
+    std::vector<std::pair<time_t, std::string>> files;
+    if (DIR *dir = opendir(phoneDirectory_.c_str())) {
+      const size_t suffix = std::strlen(cSuffix);
+      while (dirent *entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        struct stat info{};
+        if (name.size() > suffix && name.compare(name.size() - suffix, suffix, cSuffix) == 0 &&
+            stat((phoneDirectory_ + "/" + name).c_str(), &info) == 0) {
+          files.emplace_back(info.st_mtime, name);
+        }
+      }
+      closedir(dir);
+    }
+    // Reads touch their file, so the modification time is the last use
+    std::sort(files.begin(), files.end());
+    for (auto &file : files) {
+      diskOrder_.push_back(std::move(file.second));
+      diskIndex_.emplace(diskOrder_.back(), std::prev(diskOrder_.end()));
+    }
+    OPENAUTO_LOG(debug) << "[BrowseCache] " << diskOrder_.size() << " nodes on disk for " << phone_;
+  }
+
+  bool BrowseCache::readDisk(const std::string &path, BrowseNode &node) {
+    const std::string file = nodeFile(path);
+    if (!hasDisk() || diskIndex_.count(file) == 0) {
+      return false;
+    }
+
+    std::ifstream stream(phoneDirectory_ + "/" + file, std::ios::binary);
+    const std::string data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    Reader reader{data};
+    char magic[sizeof(cMagic)];
+    for (char &c : magic) {
+      c = reader.get<char>();
+    }
+    const bool valid = reader.ok && std::memcmp(magic, cMagic, sizeof(cMagic)) == 0 &&
+                       reader.get<uint32_t>() == cFormat;
+
+    node.path = reader.text();
+    node.version = reader.get<uint64_t>();
+    const uint32_t count = reader.get<uint32_t>();
+    node.items.clear();
+    for (uint32_t i = 0; i < count && reader.ok; i++) {
+      BrowseItem item;
+      item.path = reader.text();
+      item.title = reader.text();
+      item.subtitle = reader.text();
+      const uint8_t flags = reader.get<uint8_t>();
+      item.browsable = (flags & 1) != 0;
+      item.playable = (flags & 2) != 0;
+      item.version = reader.get<uint64_t>();
+      item.artKey = reader.text();
+      node.items.push_back(std::move(item));
+    }
+
+    // A torn write, an older format or another path with the same hash
+    if (!valid || !reader.ok || reader.pos != data.size() || node.path != path) {
+      eraseDisk(path);
+      node = BrowseNode();
+      return false;
+    }
+    touchDisk(file);
+    return true;
+  }
+
+  void BrowseCache::writeDisk(const BrowseNode &node) {
+    if (!hasDisk()) {
+      return;
+    }
+    if (diskOrder_.empty()) {
+      makePath(phoneDirectory_);
+    }
+
+    std::string data(cMagic, sizeof(cMagic));
+    put<uint32_t>(data, cFormat);
+    put(data, node.path);
+    put<uint64_t>(data, node.version);
+    put<uint32_t>(data, static_cast<uint32_t>(node.items.size()));
+    for (const auto &item : node.items) {
+      put(data, item.path);
+      put(data, item.title);
+      put(data, item.subtitle);
+      put<uint8_t>(data, (item.browsable ? 1 : 0) | (item.playable ? 2 : 0));
+      put<uint64_t>(data, item.version);
+      put(data, item.artKey);
+    }
+
+    // Written aside and renamed, so a power cut leaves the old listing
+    const std::string file = nodeFile(node.path);
+    const std::string path = phoneDirectory_ + "/" + file;
+    const std::string temporary = path + ".tmp";
+    {
+      std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+      stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+      if (!stream.flush()) {
+        OPENAUTO_LOG_EVERY_MS(warning, 60000) << "[BrowseCache] Cannot write " << temporary;
+        std::remove(temporary.c_str());
+        return;
+      }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+      std::remove(temporary.c_str());
+      return;
+    }
+
+    auto indexed = diskIndex_.find(file);
+    if (indexed != diskIndex_.end()) {
+      diskOrder_.splice(diskOrder_.end(), diskOrder_, indexed->second);
+      return;
+    }
+    diskOrder_.push_back(file);
+    diskIndex_.emplace(file, std::prev(diskOrder_.end()));
+    while (diskOrder_.size() > diskCapacity_) {
+      std::remove((phoneDirectory_ + "/" + diskOrder_.front()).c_str());
+      diskIndex_.erase(diskOrder_.front());
+      diskOrder_.pop_front();
+    }
+  }
+
+  void BrowseCache::eraseDisk(const std::string &path) {
+    auto indexed = diskIndex_.find(nodeFile(path));
+    if (indexed == diskIndex_.end()) {
+      return;
+    }
+    std::remove((phoneDirectory_ + "/" + indexed->first).c_str());
+    diskOrder_.erase(indexed->second);
+    diskIndex_.erase(indexed);
+  }
+
+  void BrowseCache::touchDisk(const std::string &file) {
+    auto indexed = diskIndex_.find(file);
+    if (indexed == diskIndex_.end()) {
+      return;
+    }
+    utime((phoneDirectory_ + "/" + file).c_str(), nullptr);
+    diskOrder_.splice(diskOrder_.end(), diskOrder_, indexed->second);
+  }
+
+}
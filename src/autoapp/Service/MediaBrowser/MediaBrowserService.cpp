@@ -17,8 +17,12 @@
 */
 
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
+#include <f1x/openauto/autoapp/Player/ArtCache.hpp>
 #include <f1x/openauto/autoapp/Service/MediaBrowser/MediaBrowserService.hpp>
 #include <fstream>
+#include <QCryptographicHash>
+#include <QStandardPaths>
 #include <QString>
 
 namespace f1x {
@@ -31,19 +35,47 @@ namespace f1x {
                                                        aasdk::messenger::IMessenger::Pointer messenger)
               : strand_(ioService),
                 timer_(ioService),
-                channel_(std::make_shared<aasdk::channel::mediabrowser::MediaBrowserService>(strand_, std::move(messenger))) {
+                channel_(std::make_shared<aasdk::channel::mediabrowser::MediaBrowserService>(strand_, std::move(messenger))),
+                cache_(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString() + "/browse") {
 
           }
 
           void MediaBrowserService::start() {
             strand_.dispatch([this, self = this->shared_from_this()]() {
               OPENAUTO_LOG(info) << "[MediaBrowserService] start()";
+              this->running_ = true;
+
+              if (this->artCache_ != nullptr && !this->artConnection_) {
+                // Emitted on the art cache's worker thread, for every ticket
+                std::weak_ptr<MediaBrowserService> weak = this->shared_from_this();
+                this->artConnection_ = QObject::connect(
+                    this->artCache_, &player::ArtCache::pictureStored, this->artCache_,
+                    [weak](quint64 ticket, const QString &key) {
+                      auto service = weak.lock();
+                      if (ticket < cTicketBase || !service) {
+                        return;
+                      }
+                      service->strand_.dispatch([service, ticket, key]() {
+                        service->onPictureStored(ticket, key);
+                      });
+                    },
+                    Qt::DirectConnection);
+              }
             });
           }
 
           void MediaBrowserService::stop() {
             strand_.dispatch([this, self = this->shared_from_this()]() {
               OPENAUTO_LOG(info) << "[MediaBrowserService] stop()";
+              this->running_ = false;
+
+              QObject::disconnect(this->artConnection_);
+              this->artConnection_ = QMetaObject::Connection();
+              this->waiting_.clear();
+              this->artRequests_.clear();
+              this->heldArt_.clear();
+              this->heldOrder_.clear();
+              this->heldBytes_ = 0;
             });
           }
 
@@ -71,6 +103,7 @@ namespace f1x {
           }
 
           void MediaBrowserService::onChannelOpenRequest(const aap_protobuf::service::control::message::ChannelOpenRequest &request) {
+            FlightRecorder::instance().record(FlightEvent::ChannelOpened, request.service_id());
             OPENAUTO_LOG(info) << "[MediaBrowserService] onChannelOpenRequest()";
             OPENAUTO_LOG(info) << "[MediaBrowserService] Channel Id: " << request.service_id() << ", Priority: " << request.priority();
 
@@ -89,6 +122,176 @@ namespace f1x {
           void MediaBrowserService::onChannelError(const aasdk::error::Error &e) {
             OPENAUTO_LOG(error) << "[MediaBrowserService] onChannelError(): " << e.what();
           }
+
+          void MediaBrowserService::setArtCache(player::ArtCache *artCache) {
+            strand_.dispatch([this, self = this->shared_from_this(), artCache]() {
+              this->artCache_ = artCache;
+            });
+          }
+
+          void MediaBrowserService::setRequestHandler(RequestHandler handler) {
+            strand_.dispatch([this, self = this->shared_from_this(), handler = std::move(handler)]() mutable {
+              this->requestHandler_ = std::move(handler);
+            });
+          }
+
+          void MediaBrowserService::setPhone(std::string phone) {
+            strand_.dispatch([this, self = this->shared_from_this(), phone = std::move(phone)]() {
+              if (phone == this->cache_.phone()) {
+                return;
+              }
+              // Answers for the previous phone's paths will not come
+              this->waiting_.clear();
+              this->cache_.setPhone(phone);
+            });
+          }
+
+          void MediaBrowserService::post(BrowseNode node, std::unordered_map<std::string, std::string> art) {
+            strand_.dispatch([this, self = this->shared_from_this(), node = std::move(node),
+                              art = std::move(art)]() mutable {
+              if (!this->running_) {
+                return;
+              }
+
+              // Keyed like ArtCache::store(), so a thumbnail made on an earlier
+              // visit is found without holding the picture again
+              for (auto &item : node.items) {
+                auto picture = art.find(item.path);
+                if (picture == art.end() || picture->second.empty()) {
+                  continue;
+                }
+                const QByteArray image = QByteArray::fromRawData(picture->second.data(),
+                                                                 static_cast<int>(picture->second.size()));
+                const QString key = QString::fromLatin1(
+                    QCryptographicHash::hash(image, QCryptographicHash::Sha1).toHex());
+                item.artKey = key.toStdString();
+                if (this->artCache_ == nullptr || this->artCache_->url(key, player::ArtCache::cListSize).isEmpty()) {
+                  this->holdArt(item.artKey, std::move(picture->second));
+                }
+              }
+
+              const std::string path = node.path;
+              const auto changed = this->cache_.store(std::move(node));
+              OPENAUTO_LOG(debug) << "[MediaBrowserService] Listing of " << path << ", " << changed.size()
+                                  << " changed below it";
+
+              auto waiting = this->waiting_.find(path);
+              if (waiting != this->waiting_.end()) {
+                const auto handlers = std::move(waiting->second);
+                this->waiting_.erase(waiting);
+                if (const BrowseNode *stored = this->cache_.find(path)) {
+                  for (const auto &handler : handlers) {
+                    handler(*stored, false);
+                  }
+                }
+              }
+              for (const auto &stale : changed) {
+                this->request(stale);
+              }
+            });
+          }
+
+          void MediaBrowserService::browse(std::string path, BrowseHandler handler) {
+            strand_.dispatch([this, self = this->shared_from_this(), path = std::move(path),
+                              handler = std::move(handler)]() mutable {
+              const BrowseNode *node = this->cache_.find(path);
+              const bool stale = node != nullptr && this->cache_.stale(path);
+              if (node != nullptr) {
+                handler(*node, stale);
+                if (!stale) {
+                  return;
+                }
+              }
+              if (!this->running_) {
+                return;
+              }
+              this->request(path);
+              this->waiting_[path].push_back(std::move(handler));
+            });
+          }
+
+          void MediaBrowserService::fetchArt(std::string artKey, int size, ArtHandler handler) {
+            strand_.dispatch([this, self = this->shared_from_this(), artKey = std::move(artKey), size,
+                              handler = std::move(handler)]() mutable {
+              if (this->artCache_ == nullptr || artKey.empty()) {
+                handler(QString());
+                return;
+              }
+              const QString url = this->artCache_->url(QString::fromStdString(artKey), size);
+              if (!url.isEmpty()) {
+                handler(url);
+                return;
+              }
+
+              for (auto &pending : this->artRequests_) {
+                if (pending.second.key == artKey && pending.second.size == size) {
+                  pending.second.handlers.push_back(std::move(handler));
+                  return;
+                }
+              }
+              auto held = this->heldArt_.find(artKey);
+              if (held == this->heldArt_.end()) {
+                // Pushed out by newer listings; revisiting the node brings it back
+                handler(QString());
+                return;
+              }
+              const quint64 ticket = this->nextTicket_++;
+              this->artRequests_[ticket] = {artKey, size, {std::move(handler)}};
+              this->artCache_->storeLater(QByteArray(held->second.data(), static_cast<int>(held->second.size())),
+                                          ticket);
+            });
+          }
+
+          void MediaBrowserService::request(const std::string &path) {
+            if (!this->waiting_.emplace(path, std::vector<BrowseHandler>()).second) {
+              return;
+            }
+            OPENAUTO_LOG(debug) << "[MediaBrowserService] Requesting " << path;
+            if (this->requestHandler_) {
+              this->requestHandler_(path);
+            }
+          }
+
+          void MediaBrowserService::holdArt(const std::string &key, std::string image) {
+            if (image.size() > cMaxHeldArtBytes || this->heldArt_.count(key) != 0) {
+              return;
+            }
+            this->heldBytes_ += image.size();
+            this->heldArt_.emplace(key, std::move(image));
+            this->heldOrder_.push_back(key);
+            while (this->heldBytes_ > cMaxHeldArtBytes && !this->heldOrder_.empty()) {
+              // Keys of art stored since are already gone from the map
+              auto oldest = this->heldArt_.find(this->heldOrder_.front());
+              if (oldest != this->heldArt_.end()) {
+                this->heldBytes_ -= oldest->second.size();
+                this->heldArt_.erase(oldest);
+              }
+              this->heldOrder_.pop_front();
+            }
+          }
+
+          void MediaBrowserService::onPictureStored(quint64 ticket, const QString &key) {
+            auto pending = this->artRequests_.find(ticket);
+            if (pending == this->artRequests_.end()) {
+              return;
+            }
+            const ArtRequest request = std::move(pending->second);
+            this->artRequests_.erase(pending);
+
+            // On disk now in every size, so the picture itself is not needed
+            auto held = this->heldArt_.find(request.key);
+            if (held != this->heldArt_.end()) {
+              this->heldBytes_ -= held->second.size();
+              this->heldArt_.erase(held);
+            }
+
+            const QString url = key.isEmpty() || this->artCache_ == nullptr
+                                    ? QString()
+                                    : this->artCache_->url(key, request.size);
+            for (const auto &handler : request.handlers) {
+              handler(url);
+            }
+          }
         }
       }
     }
@@ -17,7 +17,9 @@
 */
 
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
 #include <f1x/openauto/autoapp/Service/MediaPlaybackStatus/MediaPlaybackStatusService.hpp>
+#include <f1x/openauto/autoapp/Player/PhoneMedia.hpp>
 #include <fstream>
 #include <QString>
 
@@ -44,6 +46,7 @@ namespace f1x {
           void MediaPlaybackStatusService::stop() {
             strand_.dispatch([this, self = this->shared_from_this()]() {
               OPENAUTO_LOG(info) << "[MediaPlaybackStatusService] stop()";
+              player::PhoneMedia::instance().clear();
             });
           }
 
@@ -71,6 +74,7 @@ namespace f1x {
           }
 
           void MediaPlaybackStatusService::onChannelOpenRequest(const aap_protobuf::service::control::message::ChannelOpenRequest &request) {
+            FlightRecorder::instance().record(FlightEvent::ChannelOpened, request.service_id());
             OPENAUTO_LOG(info) << "[MediaPlaybackStatusService] onChannelOpenRequest()";
             OPENAUTO_LOG(info) << "[MediaPlaybackStatusService] Channel Id: " << request.service_id() << ", Priority: " << request.priority();
 
@@ -86,6 +90,31 @@ namespace f1x {
             channel_->receive(this->shared_from_this());
           }
 
+          void MediaPlaybackStatusService::onMetadataUpdate(
+              const aap_protobuf::service::mediaplayback::message::MediaPlaybackMetadata &metadata) {
+            OPENAUTO_LOG(debug) << "[MediaPlaybackStatusService] Metadata: " << metadata.song() << " by " << metadata.artist()
+                                << ", " << metadata.album_art().size() << " bytes of art";
+
+            // Art is only copied here; decoding and scaling happen on the art cache's worker
+            player::PhoneMedia::Metadata update;
+            update.title = QString::fromStdString(metadata.song());
+            update.artist = QString::fromStdString(metadata.artist());
+            update.album = QString::fromStdString(metadata.album());
+            update.durationSeconds = static_cast<int>(metadata.duration_seconds());
+            update.art = QByteArray(metadata.album_art().data(), static_cast<int>(metadata.album_art().size()));
+            player::PhoneMedia::instance().setMetadata(std::move(update));
+
+            channel_->receive(this->shared_from_this());
+          }
+
+          void MediaPlaybackStatusService::onPlaybackUpdate(
+              const aap_protobuf::service::mediaplayback::message::MediaPlaybackStatus &playback) {
+            // State 2 is PLAYING; STOPPED and PAUSED show the same on screen
+            player::PhoneMedia::instance().setPlayback(static_cast<int>(playback.state()) == 2,
+                                                       static_cast<int>(playback.playback_seconds()));
+
+            channel_->receive(this->shared_from_this());
+          }
 
           void MediaPlaybackStatusService::onChannelError(const aasdk::error::Error &e) {
             OPENAUTO_LOG(error) << "[MediaPlaybackStatusService] onChannelError(): " << e.what();
@@ -17,7 +17,10 @@
 */
 
 #include <f1x/openauto/Common/Log.hpp>
+#include <algorithm>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
 #include <f1x/openauto/autoapp/Service/MediaSink/AudioMediaSinkService.hpp>
+#include <f1x/openauto/autoapp/StrandMonitor.hpp>
 
 namespace f1x {
   namespace openauto {
@@ -28,7 +31,11 @@ namespace f1x {
           AudioMediaSinkService::AudioMediaSinkService(boost::asio::io_service &ioService,
                                                        aasdk::channel::mediasink::audio::IAudioMediaSinkService::Pointer channel,
                                                        projection::IAudioOutput::Pointer audioOutput)
-              : strand_(ioService), channel_(std::move(channel)), audioOutput_(std::move(audioOutput)), session_(-1) {
+              : strand_(ioService), channel_(std::move(channel)), audioOutput_(std::move(audioOutput)), session_(-1),
+                ackSender_(strand_, [this](const aasdk::error::Error &e) { this->onChannelError(e); }),
+                ackBatch_(1), unacked_(0),
+                codec_(aap_protobuf::service::media::shared::message::MediaCodecType::MEDIA_CODEC_AUDIO_PCM),
+                ackTimer_(ioService) {
 
           }
 
@@ -41,13 +48,23 @@ namespace f1x {
           }
 
           void AudioMediaSinkService::stop() {
-            strand_.dispatch([this, self = this->shared_from_this()]() {
+            this->shutdown(nullptr);
+          }
+
+          void AudioMediaSinkService::shutdown(std::function<void()> done) {
+            strand_.dispatch([this, self = this->shared_from_this(), done = std::move(done)]() {
               OPENAUTO_LOG(info) << "[AudioMediaSinkService] stop()";
               OPENAUTO_LOG(info) << "[AudioMediaSinkService] Channel " << aasdk::messenger::channelIdToString(channel_->getId());
+              this->cancelAcks();
               audioOutput_->stop();
+              if (done) done();
             });
           }
 
+          std::string AudioMediaSinkService::name() const {
+            return aasdk::messenger::channelIdToString(channel_->getId());
+          }
+
           void AudioMediaSinkService::pause() {
             strand_.dispatch([this, self = this->shared_from_this()]() {
               OPENAUTO_LOG(info) << "[AudioMediaSinkService] pause()";
@@ -78,8 +95,7 @@ namespace f1x {
 
             auto audioChannel = service->mutable_media_sink_service();
 
-            audioChannel->set_available_type(
-                aap_protobuf::service::media::shared::message::MediaCodecType::MEDIA_CODEC_AUDIO_PCM);
+            audioChannel->set_available_type(codec_);
 
             switch (channel_->getId()) {
               case aasdk::messenger::ChannelId::MEDIA_SINK_SYSTEM_AUDIO:
@@ -127,6 +143,7 @@ namespace f1x {
            */
 
           void AudioMediaSinkService::onChannelOpenRequest(const aap_protobuf::service::control::message::ChannelOpenRequest &request) {
+            FlightRecorder::instance().record(FlightEvent::ChannelOpened, request.service_id());
             OPENAUTO_LOG(info) << "[AudioMediaSinkService] onChannelOpenRequest()";
             OPENAUTO_LOG(info) << "[AudioMediaSinkService] Channel Id: " << request.service_id() << ", Priority: " << request.priority();
 
@@ -171,7 +188,7 @@ namespace f1x {
             aap_protobuf::service::media::shared::message::Config response;
             auto status = aap_protobuf::service::media::shared::message::Config::STATUS_READY;
             response.set_status(status);
-            response.set_max_unacked(1);
+            response.set_max_unacked(ackBatch_ > 1 ? ackBatch_ * 2 : 1);
             response.add_configuration_indices(0);
 
             auto promise = aasdk::channel::SendPromise::defer(strand_);
@@ -187,6 +204,7 @@ namespace f1x {
             OPENAUTO_LOG(info) << "[AudioMediaSinkService] onMediaChannelStartIndication()";
             OPENAUTO_LOG(info) << "[AudioMediaSinkService] Channel Id: " << aasdk::messenger::channelIdToString(channel_->getId()) << ", session: " << indication.session_id();
             session_ = indication.session_id();
+            ackSender_.setSession(session_);
             audioOutput_->start();
             channel_->receive(this->shared_from_this());
           }
@@ -195,7 +213,9 @@ namespace f1x {
             OPENAUTO_LOG(info) << "[AudioMediaSinkService] onMediaChannelStopIndication()";
             OPENAUTO_LOG(info) << "[AudioMediaSinkService] Channel Id: " << aasdk::messenger::channelIdToString(channel_->getId()) << ", session: " << session_;
 
+            this->cancelAcks();
             session_ = -1;
+            ackSender_.setSession(session_);
             audioOutput_->suspend();
 
             channel_->receive(this->shared_from_this());
@@ -203,22 +223,61 @@ namespace f1x {
 
           void AudioMediaSinkService::onMediaWithTimestampIndication(aasdk::messenger::Timestamp::ValueType timestamp,
                                                                      const aasdk::common::DataConstBuffer &buffer) {
+            StrandTask task(OPENAUTO_STRAND_SITE("audio.media"));
             OPENAUTO_LOG(debug) << "[AudioMediaSinkService] onMediaWithTimestampIndication()";
             OPENAUTO_LOG(debug) << "[AudioMediaSinkService] Channel Id: " << aasdk::messenger::channelIdToString(channel_->getId()) << ", session: " << session_;
 
+            if (recorder_) {
+              recorder_->append(static_cast<uint16_t>(channel_->getId()), timestamp, buffer.cdata, buffer.size);
+            }
             audioOutput_->write(timestamp, buffer);
 
-            aap_protobuf::service::media::source::message::Ack indication;
-            indication.set_session_id(session_);
-            indication.set_ack(1);
-
-            auto promise = aasdk::channel::SendPromise::defer(strand_);
-            promise->then([]() {}, std::bind(&AudioMediaSinkService::onChannelError, this->shared_from_this(),
-                                             std::placeholders::_1));
-            channel_->sendMediaAckIndication(indication, std::move(promise));
+            if (++unacked_ >= ackBatch_) {
+              this->flushAcks();
+            } else if (unacked_ == 1) {
+              ackTimer_.expires_from_now(boost::posix_time::milliseconds(cAckFlushMs));
+              ackTimer_.async_wait(strand_.wrap(monitoredCompletion(
+                  OPENAUTO_STRAND_SITE("audio.ack_timer"), [this, self = this->shared_from_this()](const boost::system::error_code &error) {
+                    if (error != boost::asio::error::operation_aborted) {
+                      this->flushAcks();
+                    }
+                  })));
+            }
             channel_->receive(this->shared_from_this());
           }
 
+          void AudioMediaSinkService::flushAcks() {
+            if (unacked_ == 0) {
+              return;
+            }
+            if (ackBatch_ > 1) {
+              ackTimer_.cancel();
+            }
+
+            // One ACK covers every packet since the last one
+            ackSender_.setCount(unacked_);
+            unacked_ = 0;
+            auto promise = ackSender_.promise(this->shared_from_this());
+            channel_->sendMediaAckIndication(ackSender_.message(), std::move(promise));
+          }
+
+          void AudioMediaSinkService::cancelAcks() {
+            ackTimer_.cancel();
+            unacked_ = 0;
+          }
+
+          void AudioMediaSinkService::setRecorder(projection::MediaDumpWriter::Pointer recorder) {
+            recorder_ = std::move(recorder);
+          }
+
+          void AudioMediaSinkService::setAckBatch(uint32_t batch) {
+            ackBatch_ = std::min(std::max(batch, 1u), cMaxAckBatch);
+          }
+
+          void AudioMediaSinkService::setCodec(aap_protobuf::service::media::shared::message::MediaCodecType codec) {
+            codec_ = codec;
+          }
+
           void AudioMediaSinkService::onMediaIndication(const aasdk::common::DataConstBuffer &buffer) {
             OPENAUTO_LOG(info) << "[AudioMediaSinkService] onMediaIndication()";
 
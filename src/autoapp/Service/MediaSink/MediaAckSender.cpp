@@ -0,0 +1,71 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/autoapp/Service/MediaSink/MediaAckSender.hpp>
+
+namespace f1x {
+  namespace openauto {
+    namespace autoapp {
+      namespace service {
+        namespace mediasink {
+
+          MediaAckSender::MediaAckSender(boost::asio::io_service::strand &strand, ErrorHandler errorHandler)
+              : strand_(strand), errorHandler_(std::move(errorHandler)), inFlight_(0) {
+            message_.set_session_id(-1);
+            message_.set_ack(1);
+          }
+
+          void MediaAckSender::setSession(int32_t session) {
+            message_.set_session_id(session);
+          }
+
+          void MediaAckSender::setCount(uint32_t count) {
+            message_.set_ack(count);
+          }
+
+          const aap_protobuf::service::media::source::message::Ack &MediaAckSender::message() const {
+            return message_;
+          }
+
+          aasdk::channel::SendPromise::Pointer MediaAckSender::promise(std::shared_ptr<void> owner) {
+            if (inFlight_++ == 0) {
+              owner_ = std::move(owner);
+            }
+
+            auto promise = aasdk::channel::SendPromise::defer(strand_);
+            promise->then([this]() { this->settle(); },
+                          [this](const aasdk::error::Error &e) {
+                            errorHandler_(e);
+                            this->settle();
+                          });
+            return promise;
+          }
+
+          void MediaAckSender::settle() {
+            if (--inFlight_ == 0) {
+              // May be the last reference to the service that owns this sender:
+              // released on return, after which nothing here is touched
+              auto owner = std::move(owner_);
+            }
+          }
+
+        }
+      }
+    }
+  }
+}
@@ -16,8 +16,10 @@
 *  along with openauto. If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <fstream>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
 #include <f1x/openauto/autoapp/Service/MediaSink/VideoMediaSinkService.hpp>
+#include <f1x/openauto/autoapp/StateBus.hpp>
+#include <f1x/openauto/autoapp/StrandMonitor.hpp>
 
 namespace f1x {
   namespace openauto {
@@ -26,8 +28,11 @@ namespace f1x {
         namespace mediasink {
           VideoMediaSinkService::VideoMediaSinkService(boost::asio::io_service &ioService,
                                                        aasdk::channel::mediasink::video::IVideoMediaSinkService::Pointer channel,
-                                                       projection::IVideoOutput::Pointer videoOutput)
-              : strand_(ioService), channel_(std::move(channel)), videoOutput_(std::move(videoOutput)), session_(-1) {
+                                                       projection::IVideoOutput::Pointer videoOutput,
+                                                       projection::VideoModeSelector::Pointer videoModeSelector)
+              : strand_(ioService), channel_(std::move(channel)), videoOutput_(std::move(videoOutput)),
+                videoModeSelector_(std::move(videoModeSelector)), session_(-1), deferredAck_(false),
+                hevcConfigs_(false), background_(false), ackSender_(strand_, [this](const aasdk::error::Error &e) { this->onChannelError(e); }) {
 
           }
 
@@ -41,11 +46,23 @@ namespace f1x {
           }
 
           void VideoMediaSinkService::stop() {
-            strand_.dispatch([this, self = this->shared_from_this()]() {
+            this->shutdown(nullptr);
+          }
+
+          void VideoMediaSinkService::shutdown(std::function<void()> done) {
+            strand_.dispatch([this, self = this->shared_from_this(), done = std::move(done)]() {
               OPENAUTO_LOG(info) << "[VideoMediaSinkService] stop()";
               OPENAUTO_LOG(info) << "[VideoMediaSinkService] Channel "
                                  << aasdk::messenger::channelIdToString(channel_->getId());
+              // Let this session's decode load pick the mode for the next one
+              videoModeSelector_->endSession(projection::VideoTelemetry::instance().snapshot());
+              // The output outlives this service; stop it calling back into us
+              videoOutput_->setFrameConsumedHandler(nullptr);
+              videoOutput_->setKeyframeRequestHandler(nullptr);
+              deferredAck_ = false;
+              background_ = false;
               videoOutput_->stop();
+              if (done) done();
             });
           }
 
@@ -54,6 +71,7 @@ namespace f1x {
               OPENAUTO_LOG(info) << "[VideoMediaSinkService] pause()";
               OPENAUTO_LOG(info) << "[VideoMediaSinkService] Channel "
                                  << aasdk::messenger::channelIdToString(channel_->getId());
+              this->enterBackground(true);
             });
           }
 
@@ -62,7 +80,7 @@ namespace f1x {
               OPENAUTO_LOG(info) << "[VideoMediaSinkService] resume()";
               OPENAUTO_LOG(info) << "[VideoMediaSinkService] Channel "
                                  << aasdk::messenger::channelIdToString(channel_->getId());
-
+              this->leaveBackground(true);
             });
           }
 
@@ -82,14 +100,36 @@ namespace f1x {
             videoChannel->set_available_while_in_call(true);
 
 
-            auto *videoConfig1 = videoChannel->add_video_configs();
-            videoConfig1->set_codec_resolution(videoOutput_->getVideoResolution());
-            videoConfig1->set_frame_rate(videoOutput_->getVideoFPS());
+            // Configured mode first, then cheaper fallbacks; the setup response
+            // picks one of them by index. With an HEVC decoder every mode is
+            // listed as H.265 first and again as H.264 for phones without it.
+            using aap_protobuf::service::media::shared::message::MediaCodecType;
+            hevcConfigs_ = videoOutput_->supportsCodec(MediaCodecType::MEDIA_CODEC_VIDEO_H265);
+            std::vector<MediaCodecType> codecs;
+            if (hevcConfigs_) {
+              codecs.push_back(MediaCodecType::MEDIA_CODEC_VIDEO_H265);
+            }
+            codecs.push_back(MediaCodecType::MEDIA_CODEC_VIDEO_H264_BP);
 
             const auto &videoMargins = videoOutput_->getVideoMargins();
-            videoConfig1->set_height_margin(videoMargins.height());
-            videoConfig1->set_width_margin(videoMargins.width());
-            videoConfig1->set_density(videoOutput_->getScreenDPI());
+            for (const auto codec : codecs) {
+              for (const auto &mode : videoModeSelector_->modes()) {
+                auto *videoConfig = videoChannel->add_video_configs();
+                videoConfig->set_codec_resolution(mode.resolution);
+                videoConfig->set_frame_rate(mode.fps);
+                videoConfig->set_video_codec_type(codec);
+
+                const auto geometry = videoModeSelector_->geometry(mode);
+                videoConfig->set_height_margin(geometry.margins().height());
+                videoConfig->set_width_margin(geometry.margins().width());
+                videoConfig->set_density(videoOutput_->getScreenDPI());
+
+                OPENAUTO_LOG(info) << "[VideoMediaSinkService] video config "
+                                   << MediaCodecType_Name(codec) << " "
+                                   << VideoCodecResolutionType_Name(mode.resolution) << " "
+                                   << VideoFrameRateType_Name(mode.fps);
+              }
+            }
 
             OPENAUTO_LOG(info) << "[VideoMediaSinkService] getVideoResolution " << VideoCodecResolutionType_Name(videoOutput_->getVideoResolution());
             OPENAUTO_LOG(info) << "[VideoMediaSinkService] getVideoFPS " << VideoFrameRateType_Name(videoOutput_->getVideoFPS());
@@ -106,16 +146,63 @@ namespace f1x {
                                << MediaCodecType_Name(request.type());
 
 
-            auto status = videoOutput_->init()
+            // Credit-based flow control: each ACK returns one of max_unacked
+            // credits when the output's decode queue takes the frame, so USB
+            // transfer overlaps decode while the frame ring bounds latency
+            std::weak_ptr<VideoMediaSinkService> weakSelf = this->shared_from_this();
+            deferredAck_ = videoOutput_->setFrameConsumedHandler([weakSelf]() {
+              if (auto self = weakSelf.lock()) {
+                self->strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("video.ack"), [self]() { self->sendMediaAck(); }));
+              }
+            });
+
+            // A new video focus indication makes the phone restart its stream
+            // with an IDR frame, which the output's drop policy waits for
+            videoOutput_->setKeyframeRequestHandler([weakSelf]() {
+              if (auto self = weakSelf.lock()) {
+                self->strand_.dispatch(
+                    monitored(OPENAUTO_STRAND_SITE("video.focus"), [self]() { self->sendVideoFocusIndication(); }));
+              }
+            });
+
+            // One index for the whole response, kept for the end of the session
+            const size_t modeIndex = videoModeSelector_->serveSession();
+            const std::vector<projection::VideoMode> modes = videoModeSelector_->modes();
+            const projection::VideoMode &mode = modes.at(modeIndex);
+
+            // The plane rectangles follow the mode the phone is about to send
+            videoOutput_->setProjectionGeometry(videoModeSelector_->geometry(mode));
+            // ... and the presentation cadence its frame rate
+            const bool fps60 = mode.fps ==
+                               aap_protobuf::service::media::sink::message::VideoFrameRateType::VIDEO_FPS_60;
+            videoOutput_->setFrameRate(fps60 ? 60 : 30);
+
+            // The phone names the codec it will send; the decoder follows it
+            using aap_protobuf::service::media::shared::message::MediaCodecType;
+            const bool hevc = request.type() == MediaCodecType::MEDIA_CODEC_VIDEO_H265;
+            const bool codecReady = videoOutput_->setCodec(request.type());
+            if (!codecReady) {
+              OPENAUTO_LOG(error) << "[VideoMediaSinkService] Output cannot decode "
+                                  << MediaCodecType_Name(request.type());
+            }
+
+            auto status = codecReady && videoOutput_->init()
                           ? aap_protobuf::service::media::shared::message::Config::STATUS_READY
                           : aap_protobuf::service::media::shared::message::Config::STATUS_WAIT;
 
+            // A phone that overran the decoder before gets the window it kept up with
+            const size_t maxUnacked = videoModeSelector_->maxUnacked(videoOutput_->getMaxUnackedFrames());
             OPENAUTO_LOG(debug) << "[VideoMediaSinkService] setup status: " << Config_Status_Name(status);
+            OPENAUTO_LOG(info) << "[VideoMediaSinkService] max_unacked " << maxUnacked
+                               << (deferredAck_ ? ", ACK on dequeue" : ", ACK after write");
 
             aap_protobuf::service::media::shared::message::Config response;
             response.set_status(status);
-            response.set_max_unacked(1);
-            response.add_configuration_indices(0);
+            response.set_max_unacked(static_cast<uint32_t>(maxUnacked));
+            // H.264 configs follow the H.265 ones when both were listed
+            const size_t configIndex = modeIndex + (hevcConfigs_ && !hevc ? modes.size() : 0);
+            response.add_configuration_indices(static_cast<uint32_t>(configIndex));
+            OPENAUTO_LOG(info) << "[VideoMediaSinkService] Selected video config index " << configIndex;
 
             auto promise = aasdk::channel::SendPromise::defer(strand_);
             promise->then(std::bind(&VideoMediaSinkService::sendVideoFocusIndication, this->shared_from_this()),
@@ -127,6 +214,7 @@ namespace f1x {
           }
 
           void VideoMediaSinkService::onChannelOpenRequest(const aap_protobuf::service::control::message::ChannelOpenRequest &request) {
+            FlightRecorder::instance().record(FlightEvent::ChannelOpened, request.service_id());
             OPENAUTO_LOG(info) << "[VideoMediaSinkService] onChannelOpenRequest()";
             OPENAUTO_LOG(info) << "[VideoMediaSinkService] Channel Id: " << request.service_id() << ", Priority: "
                                << request.priority();
@@ -156,6 +244,7 @@ namespace f1x {
                                << indication.session_id();
 
             session_ = indication.session_id();
+            ackSender_.setSession(session_);
             channel_->receive(this->shared_from_this());
           }
 
@@ -170,23 +259,27 @@ namespace f1x {
 
           void VideoMediaSinkService::onMediaWithTimestampIndication(aasdk::messenger::Timestamp::ValueType timestamp,
                                                                      const aasdk::common::DataConstBuffer &buffer) {
+            StrandTask task(OPENAUTO_STRAND_SITE("video.media"));
             OPENAUTO_LOG(debug) << "[VideoMediaSinkService] onMediaWithTimestampIndication()";
             OPENAUTO_LOG(debug) << "[VideoMediaSinkService] Channel Id: "
                                << aasdk::messenger::channelIdToString(channel_->getId()) << ", session: " << session_;
 
+            if (recorder_) {
+              recorder_->append(static_cast<uint16_t>(channel_->getId()), timestamp, buffer.cdata, buffer.size);
+            }
+            projection::VideoTelemetry::instance().recordPacket(buffer.size);
             videoOutput_->write(timestamp, buffer);
 
-            aap_protobuf::service::media::source::message::Ack indication;
-            indication.set_session_id(session_);
-            indication.set_ack(1);
-
-            auto promise = aasdk::channel::SendPromise::defer(strand_);
-            promise->then([]() {}, std::bind(&VideoMediaSinkService::onChannelError, this->shared_from_this(),
-                                             std::placeholders::_1));
-            channel_->sendMediaAckIndication(indication, std::move(promise));
+            if (!deferredAck_) {
+              this->sendMediaAck();
+            }
             channel_->receive(this->shared_from_this());
           }
 
+          void VideoMediaSinkService::setRecorder(projection::MediaDumpWriter::Pointer recorder) {
+            recorder_ = std::move(recorder);
+          }
+
           void VideoMediaSinkService::onMediaIndication(const aasdk::common::DataConstBuffer &buffer) {
             OPENAUTO_LOG(debug) << "[VideoMediaSinkService] onMediaIndication()";
             this->onMediaWithTimestampIndication(0, buffer);
@@ -217,26 +310,60 @@ namespace f1x {
                 aap_protobuf::service::media::video::message::VideoFocusMode::VIDEO_FOCUS_NATIVE) {
               // Return to OS
               OPENAUTO_LOG(info) << "[VideoMediaSinkService] Returning to OS.";
-              try {
-                if (!std::ifstream("/tmp/entityexit")) {
-                  std::ofstream("/tmp/entityexit");
-                }
-              } catch (...) {
-                OPENAUTO_LOG(error) << "[VideoMediaSinkService] Error in creating /tmp/entityexit";
-              }
+              StateBus::instance().set(StateFlag::EntityExit);
+              this->enterBackground(false);
+            } else if (background_) {
+              this->leaveBackground(false);
+            } else {
+              this->sendVideoFocusIndication();
             }
-
-            this->sendVideoFocusIndication();
             channel_->receive(this->shared_from_this());
           }
 
+          void VideoMediaSinkService::enterBackground(bool unsolicited) {
+            if (background_) {
+              return;
+            }
+            OPENAUTO_LOG(info) << "[VideoMediaSinkService] Video in background";
+            background_ = true;
+            // Frames already on the wire are ACKed and dropped by the output
+            this->sendVideoFocus(aap_protobuf::service::media::video::message::VideoFocusMode::VIDEO_FOCUS_NATIVE, unsolicited);
+            videoOutput_->setBackground(true);
+          }
+
+          void VideoMediaSinkService::leaveBackground(bool unsolicited) {
+            if (!background_) {
+              return;
+            }
+            OPENAUTO_LOG(info) << "[VideoMediaSinkService] Video in foreground";
+            background_ = false;
+            // The output is ready before the phone's IDR arrives
+            videoOutput_->setBackground(false);
+            this->sendVideoFocus(aap_protobuf::service::media::video::message::VideoFocusMode::VIDEO_FOCUS_PROJECTED, unsolicited);
+          }
+
+          void VideoMediaSinkService::sendMediaAck() {
+            auto promise = ackSender_.promise(this->shared_from_this());
+            channel_->sendMediaAckIndication(ackSender_.message(), std::move(promise));
+          }
+
           void VideoMediaSinkService::sendVideoFocusIndication() {
             OPENAUTO_LOG(info) << "[VideoMediaSinkService] sendVideoFocusIndication()";
+            // Keyframe requests from a released output must not bring the video back
+            if (background_) {
+              return;
+            }
+            this->sendVideoFocus(aap_protobuf::service::media::video::message::VideoFocusMode::VIDEO_FOCUS_PROJECTED, false);
+          }
 
+          void VideoMediaSinkService::sendVideoFocus(aap_protobuf::service::media::video::message::VideoFocusMode focus,
+                                                     bool unsolicited) {
+            FlightRecorder::instance().record(
+                FlightEvent::VideoFocus,
+                focus == aap_protobuf::service::media::video::message::VideoFocusMode::VIDEO_FOCUS_PROJECTED ? 1 : 0);
             aap_protobuf::service::media::video::message::VideoFocusNotification videoFocusIndication;
-            videoFocusIndication.set_focus(
-                aap_protobuf::service::media::video::message::VideoFocusMode::VIDEO_FOCUS_PROJECTED);
-            videoFocusIndication.set_unsolicited(false);
+            videoFocusIndication.set_focus(focus);
+            videoFocusIndication.set_unsolicited(unsolicited);
 
             auto promise = aasdk::channel::SendPromise::defer(strand_);
             promise->then([]() { }, std::bind(&VideoMediaSinkService::onChannelError, this->shared_from_this(),
@@ -26,11 +26,12 @@ namespace f1x {
         namespace mediasink {
           VideoService::VideoService(boost::asio::io_service &ioService,
                                                aasdk::messenger::IMessenger::Pointer messenger,
-                                               projection::IVideoOutput::Pointer videoOutput)
+                                               projection::IVideoOutput::Pointer videoOutput,
+                                               projection::VideoModeSelector::Pointer videoModeSelector)
               : VideoMediaSinkService(ioService, std::make_shared<aasdk::channel::mediasink::video::channel::VideoChannel>(strand_,
                                                                                                                        std::move(
                                                                                                                            messenger)),
-                                      std::move(videoOutput)) {
+                                      std::move(videoOutput), std::move(videoModeSelector)) {
 
           }
         }
@@ -17,6 +17,7 @@
 */
 
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
 #include <f1x/openauto/autoapp/Service/MediaSource/MediaSourceService.hpp>
 
 
@@ -40,6 +41,7 @@ namespace f1x::openauto::autoapp::service::mediasource {
     strand_.dispatch([this, self = this->shared_from_this()]() {
       OPENAUTO_LOG(info) << "[MediaSourceService] stop()";
       audioInput_->stop();
+      audioInput_->close();
     });
   }
 
@@ -90,6 +92,7 @@ namespace f1x::openauto::autoapp::service::mediasource {
    */
   void
   MediaSourceService::onChannelOpenRequest(const aap_protobuf::service::control::message::ChannelOpenRequest &request) {
+    FlightRecorder::instance().record(FlightEvent::ChannelOpened, request.service_id());
     OPENAUTO_LOG(info) << "[MediaSourceService] onChannelOpenRequest()";
     OPENAUTO_LOG(info) << "[MediaSourceService] Channel Id: " << request.service_id() << ", Priority: "
                        << request.priority();
@@ -251,7 +254,10 @@ namespace f1x::openauto::autoapp::service::mediasource {
 
     auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
         std::chrono::high_resolution_clock::now().time_since_epoch());
-    channel_->sendMediaSourceWithTimestampIndication(timestamp.count(), std::move(data), std::move(sendPromise));
+    // The channel serialises the payload before returning, so the chunk can
+    // go straight back to the capture pool
+    channel_->sendMediaSourceWithTimestampIndication(timestamp.count(), data, std::move(sendPromise));
+    audioInput_->recycle(std::move(data));
   }
 
   /**
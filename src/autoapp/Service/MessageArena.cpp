@@ -0,0 +1,58 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <f1x/openauto/autoapp/Allocation.hpp>
+#include <f1x/openauto/autoapp/Service/MessageArena.hpp>
+
+namespace f1x {
+  namespace openauto {
+    namespace autoapp {
+      namespace service {
+
+        namespace {
+          void *allocateBlock(size_t bytes) {
+            return AllocationAccounting::instance().allocate(AllocationTag::Protobuf, bytes);
+          }
+
+          void deallocateBlock(void *block, size_t bytes) {
+            AllocationAccounting::instance().deallocate(AllocationTag::Protobuf, block, bytes);
+          }
+        }
+
+        MessageArena::MessageArena() : arena_(options()) {}
+
+        google::protobuf::ArenaOptions MessageArena::options() {
+          google::protobuf::ArenaOptions options;
+          options.initial_block = initial_;
+          options.initial_block_size = sizeof(initial_);
+          options.start_block_size = cInitialBytes;
+          options.max_block_size = cMaxBlockBytes;
+          options.block_alloc = &allocateBlock;
+          options.block_dealloc = &deallocateBlock;
+          return options;
+        }
+
+        void MessageArena::reset() {
+          arena_.Reset();
+        }
+
+      }
+    }
+  }
+}
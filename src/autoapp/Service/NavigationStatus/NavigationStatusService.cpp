@@ -17,7 +17,9 @@
 */
 
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
 #include <f1x/openauto/autoapp/Service/NavigationStatus/NavigationStatusService.hpp>
+#include <f1x/openauto/autoapp/StateBus.hpp>
 #include <fstream>
 #include <QString>
 
@@ -41,6 +43,8 @@ namespace f1x::openauto::autoapp::service::navigationstatus {
   void NavigationStatusService::stop() {
     strand_.dispatch([this, self = this->shared_from_this()]() {
       OPENAUTO_LOG(info) << "[NavigationStatusService] stop()";
+      state_ = NavigationState();
+      this->publish();
     });
   }
 
@@ -69,6 +73,7 @@ namespace f1x::openauto::autoapp::service::navigationstatus {
 
   void NavigationStatusService::onChannelOpenRequest(
       const aap_protobuf::service::control::message::ChannelOpenRequest &request) {
+    FlightRecorder::instance().record(FlightEvent::ChannelOpened, request.service_id());
     OPENAUTO_LOG(info) << "[NavigationStatusService] onChannelOpenRequest()";
     OPENAUTO_LOG(info) << "[NavigationStatusService] Channel Id: " << request.service_id() << ", Priority: "
                        << request.priority();
@@ -87,20 +92,75 @@ namespace f1x::openauto::autoapp::service::navigationstatus {
 
   void NavigationStatusService::onStatusUpdate(
       const aap_protobuf::service::navigationstatus::message::NavigationStatus &navStatus) {
+    const auto status = static_cast<NavigationState::Status>(navStatus.status());
+    OPENAUTO_LOG(debug) << "[NavigationStatusService] Status " << static_cast<int>(status);
+    if (status != state_.status) {
+      // A new route starts without the last one's manoeuvre
+      if (!state_.isActive()) {
+        state_ = NavigationState();
+      }
+      state_.status = status;
+      this->publish();
+    }
     channel_->receive(this->shared_from_this());
   }
 
-
   void NavigationStatusService::onTurnEvent(
       const aap_protobuf::service::navigationstatus::message::NavigationNextTurnEvent &turnEvent) {
+    state_.maneuver = static_cast<NavigationState::Maneuver>(turnEvent.event());
+    switch (static_cast<int>(turnEvent.turn_side())) {
+      case static_cast<int>(NavigationState::Side::Left):
+        state_.side = NavigationState::Side::Left;
+        break;
+      case static_cast<int>(NavigationState::Side::Right):
+        state_.side = NavigationState::Side::Right;
+        break;
+      default:
+        state_.side = NavigationState::Side::Unspecified;
+        break;
+    }
+    state_.roundaboutExit = turnEvent.turn_number();
+    state_.turnAngle = turnEvent.turn_angle();
+    state_.road = turnEvent.road();
+    // Turn events arrive without a status on some phones: they mean a route
+    if (!state_.isActive()) {
+      state_.status = NavigationState::Status::Active;
+    }
+    OPENAUTO_LOG(debug) << "[NavigationStatusService] Turn " << static_cast<int>(state_.maneuver) << " side "
+                        << static_cast<int>(state_.side) << " onto " << state_.road;
+    this->publish();
     channel_->receive(this->shared_from_this());
   }
 
   void NavigationStatusService::onDistanceEvent(
       const aap_protobuf::service::navigationstatus::message::NavigationNextTurnDistanceEvent &distanceEvent) {
+    state_.distanceMeters = distanceEvent.distance_meters();
+    state_.timeToTurnSeconds = distanceEvent.time_to_turn_seconds();
+    if (distanceEvent.has_display_distance_e3()) {
+      state_.displayDistanceE3 = distanceEvent.display_distance_e3();
+      state_.displayUnit = static_cast<NavigationState::Unit>(distanceEvent.display_distance_unit());
+    } else {
+      state_.displayDistanceE3 = -1;
+      state_.displayUnit = NavigationState::Unit::Unknown;
+    }
+    this->publish();
     channel_->receive(this->shared_from_this());
   }
 
+  void NavigationStatusService::publish() {
+    // The bus drops unchanged values, but each set() still writes the file
+    const std::string line = state_.isActive() ? state_.serialize() : std::string();
+    if (line == published_) {
+      return;
+    }
+    published_ = line;
+    if (line.empty()) {
+      StateBus::instance().clear(StateFlag::Navigation);
+    } else {
+      StateBus::instance().set(StateFlag::Navigation, line);
+    }
+  }
+
 
   void NavigationStatusService::onChannelError(const aasdk::error::Error &e) {
     OPENAUTO_LOG(error) << "[NavigationStatusService] onChannelError(): " << e.what();
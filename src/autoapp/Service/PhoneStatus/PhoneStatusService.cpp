@@ -17,6 +17,7 @@
 */
 
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
 #include <f1x/openauto/autoapp/Service/PhoneStatus/PhoneStatusService.hpp>
 #include <fstream>
 #include <QString>
@@ -44,6 +45,8 @@ namespace f1x {
           void PhoneStatusService::stop() {
             strand_.dispatch([this, self = this->shared_from_this()]() {
               OPENAUTO_LOG(info) << "[PhoneStatusService] stop()";
+              // A call shown after the phone left would never end
+              PhoneStatus::update(PhoneStatus::Signal | PhoneStatus::CallState, PhoneStatus());
             });
           }
 
@@ -71,6 +74,7 @@ namespace f1x {
           }
 
           void PhoneStatusService::onChannelOpenRequest(const aap_protobuf::service::control::message::ChannelOpenRequest &request) {
+            FlightRecorder::instance().record(FlightEvent::ChannelOpened, request.service_id());
             OPENAUTO_LOG(info) << "[PhoneStatusService] onChannelOpenRequest()";
             OPENAUTO_LOG(debug) << "[PhoneStatusService] Channel Id: " << request.service_id() << ", Priority: " << request.priority();
 
@@ -90,6 +94,12 @@ namespace f1x {
           void PhoneStatusService::onChannelError(const aasdk::error::Error &e) {
             OPENAUTO_LOG(error) << "[PhoneStatusService] onChannelError(): " << e.what();
           }
+
+          void PhoneStatusService::onPhoneStatus(const PhoneStatus &status) {
+            OPENAUTO_LOG(debug) << "[PhoneStatusService] Signal: " << status.signalStrength
+                                << ", call: " << static_cast<int>(status.call);
+            PhoneStatus::update(PhoneStatus::Signal | PhoneStatus::CallState, status);
+          }
         }
       }
     }
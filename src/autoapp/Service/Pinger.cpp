@@ -16,13 +16,36 @@
 *  along with openauto. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <f1x/openauto/autoapp/LinkQuality.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
 #include <f1x/openauto/autoapp/Service/Pinger.hpp>
 #include <f1x/openauto/Common/Log.hpp>
 
 namespace f1x::openauto::autoapp::service {
 
+  namespace {
+    struct PingerMetrics {
+      MetricGauge &unanswered = Metrics::instance().gauge(
+          "openauto_ping_unanswered", "Pings sent without a pong in the current session");
+      MetricCounter &timeouts = Metrics::instance().counter(
+          "openauto_ping_timeouts_total", "Sessions ended because pongs stopped arriving");
+      MetricHistogram &rtt = Metrics::instance().histogram(
+          "openauto_ping_rtt_ms", "Round trip of control channel pings",
+          {5, 10, 20, 50, 100, 200, 500, 1000, 2000});
+      MetricCounter &spikes = Metrics::instance().counter(
+          "openauto_ping_rtt_spikes_total", "Pongs far slower than the smoothed round trip");
+    };
+
+    PingerMetrics &metrics() {
+      static PingerMetrics instance;
+      return instance;
+    }
+  }
+
   Pinger::Pinger(boost::asio::io_service &ioService, time_t duration)
-      : strand_(ioService), timer_(ioService), duration_(duration), cancelled_(false), pingsCount_(0), pongsCount_(0) {
+      : strand_(ioService), timer_(ioService), duration_(duration), cancelled_(false), pingsCount_(0), pongsCount_(0),
+        interval_(duration) {
 
   }
 
@@ -34,29 +57,88 @@ namespace f1x::openauto::autoapp::service {
         promise_->reject(aasdk::error::Error(aasdk::error::ErrorCode::OPERATION_IN_PROGRESS));
       } else {
         ++pingsCount_;
+        metrics().unanswered.set(pingsCount_ - pongsCount_);
         OPENAUTO_LOG(debug) << "[Pinger] Ping counter: " << pingsCount_;
 
         promise_ = std::move(promise);
-        timer_.expires_from_now(boost::posix_time::milliseconds(duration_));
+        timer_.expires_from_now(boost::posix_time::milliseconds(interval_));
         timer_.async_wait(
             strand_.wrap(std::bind(&Pinger::onTimerExceeded, this->shared_from_this(), std::placeholders::_1)));
       }
     });
   }
 
-  void Pinger::pong() {
-    strand_.dispatch([this, self = this->shared_from_this()]() {
+  void Pinger::pingSent(int64_t timestamp) {
+    const auto sentAt = Clock::now();
+    strand_.dispatch([this, self = this->shared_from_this(), timestamp, sentAt]() {
+      // Once this many are unanswered the link is failing anyway; keeping the
+      // oldest lets hasTimedOut() see how long it has been silent
+      if (inFlight_.size() < cMaxTrackedPings) {
+        inFlight_.emplace_back(timestamp, sentAt);
+      }
+    });
+  }
+
+  void Pinger::pong(int64_t timestamp) {
+    const auto receivedAt = Clock::now();
+    strand_.dispatch([this, self = this->shared_from_this(), timestamp, receivedAt]() {
       ++pongsCount_;
+      metrics().unanswered.set(pingsCount_ - pongsCount_);
       OPENAUTO_LOG(debug) << "[Pinger] Pong counter: " << pongsCount_;
+
+      if (inFlight_.empty()) {
+        return;
+      }
+
+      // Pongs come back in order: anything sent before the echoed request
+      // was lost. A phone that echoes no timestamp answers the oldest.
+      auto match = std::find_if(inFlight_.begin(), inFlight_.end(),
+                                [timestamp](const auto &ping) { return ping.first == timestamp; });
+      if (match == inFlight_.end()) {
+        match = inFlight_.begin();
+      }
+      const auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(receivedAt - match->second).count();
+      inFlight_.erase(inFlight_.begin(), match + 1);
+
+      metrics().rtt.observe(rtt / 1000.0);
+      auto &link = LinkQuality::instance();
+      const bool spike = link.addSample(rtt);
+      if (spike) {
+        metrics().spikes.add();
+        OPENAUTO_LOG(info) << "[Pinger] RTT spike: " << rtt / 1000 << " ms, smoothed "
+                           << link.rttUs() / 1000 << " ms";
+      }
+
+      const time_t fast = std::min(duration_, std::max(cMinInterval, duration_ / 4));
+      const auto state = link.state();
+      if (spike || state == LinkState::Degraded || state == LinkState::Poor) {
+        if (interval_ != fast) {
+          OPENAUTO_LOG(info) << "[Pinger] Link " << linkStateName(state) << ", probing every " << fast << " ms";
+        }
+        interval_ = fast;
+      } else {
+        // Back off gradually, so one good pong after a spike does not end the probing
+        interval_ = std::min(duration_, interval_ * 2);
+      }
     });
   }
 
+  bool Pinger::hasTimedOut() const {
+    if (pingsCount_ - pongsCount_ <= 4) {
+      return false;
+    }
+    // Faster probing must not shorten how long a silent link is tolerated
+    return inFlight_.empty() ||
+           Clock::now() - inFlight_.front().second >= std::chrono::milliseconds(4 * duration_);
+  }
+
   void Pinger::onTimerExceeded(const boost::system::error_code &error) {
     if (promise_ == nullptr) {
       return;
     } else if (error == boost::asio::error::operation_aborted || cancelled_) {
       promise_->reject(aasdk::error::Error(aasdk::error::ErrorCode::OPERATION_ABORTED));
-    } else if (pingsCount_ - pongsCount_ > 4) {
+    } else if (hasTimedOut()) {
+      metrics().timeouts.add();
       promise_->reject(aasdk::error::Error());
     } else {
       promise_->resolve();
@@ -69,6 +151,8 @@ namespace f1x::openauto::autoapp::service {
     strand_.dispatch([this, self = this->shared_from_this()]() {
       cancelled_ = true;
       timer_.cancel();
+      inFlight_.clear();
+      LinkQuality::instance().reset();
     });
   }
 
@@ -0,0 +1,243 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <aasdk/USB/IUSBEndpoint.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/Service/PipelinedUSBTransport.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x {
+  namespace openauto {
+    namespace autoapp {
+      namespace service {
+
+        namespace {
+          struct UsbMetrics {
+            MetricCounter &bytes = Metrics::instance().counter(
+                "openauto_usb_in_bytes_total", "Bytes received from the phone over USB");
+            MetricCounter &transfers = Metrics::instance().counter(
+                "openauto_usb_in_transfers_total", "Bulk IN transfers completed");
+            MetricCounter &heldBack = Metrics::instance().counter(
+                "openauto_usb_in_held_back_total", "Times the IN transfers were held back because the reader lagged");
+            MetricGauge &kbps = Metrics::instance().gauge(
+                "openauto_usb_in_kbps", "USB receive throughput over the last second");
+            MetricGauge &inFlight = Metrics::instance().gauge(
+                "openauto_usb_in_flight", "Bulk IN transfers queued at the phone");
+            MetricHistogram &gapMs = Metrics::instance().histogram(
+                "openauto_usb_in_gap_ms", "Time with no IN transfer queued at the phone",
+                {0.05, 0.1, 0.25, 0.5, 1, 2, 5, 10, 50});
+          };
+
+          UsbMetrics &metrics() {
+            static UsbMetrics instance;
+            return instance;
+          }
+
+          constexpr uint32_t cReceiveTimeoutMs = 0;
+        }
+
+        PipelinedUSBTransport::PipelinedUSBTransport(boost::asio::io_service &ioService,
+                                                     aasdk::usb::IAOAPDevice::Pointer aoapDevice,
+                                                     size_t transfers, size_t transferSize)
+            : receiveStrand_(ioService), sendStrand_(ioService), aoapDevice_(std::move(aoapDevice)),
+              transferSize_(transferSize),
+              memory_(MemoryPool::Video, static_cast<int64_t>(std::max<size_t>(transfers, 1) * transferSize)),
+              slots_(std::max<size_t>(transfers, 1)), nextSubmit_(0), nextDrain_(0), inFlight_(0),
+              windowBytes_(0), pendingOffset_(0), heldBack_(false), receiveFailed_(false), sendOffset_(0) {
+          for (auto &slot : slots_) {
+            slot.buffer.resize(transferSize_);
+          }
+          pending_.reserve(slots_.size() * transferSize_ * 2);
+          windowStart_ = Clock::now();
+        }
+
+        void PipelinedUSBTransport::receive(size_t size, ReceivePromise::Pointer promise) {
+          receiveStrand_.dispatch([this, self = this->shared_from_this(), size, promise = std::move(promise)]() mutable {
+            receiveQueue_.emplace_back(size, std::move(promise));
+            this->distribute();
+            this->submitIdle();
+          });
+        }
+
+        void PipelinedUSBTransport::submitIdle() {
+          while (!receiveFailed_ && slots_[nextSubmit_].state == SlotState::Idle) {
+            // Held until the reader catches up, so a stalled one bounds the memory
+            if (available() >= slots_.size() * transferSize_) {
+              if (!heldBack_) {
+                metrics().heldBack.add();
+              }
+              heldBack_ = true;
+              break;
+            }
+            heldBack_ = false;
+            if (inFlight_ == 0 && idleSince_ != Clock::time_point()) {
+              metrics().gapMs.observe(std::chrono::duration<double, std::milli>(Clock::now() - idleSince_).count());
+            }
+
+            const size_t index = nextSubmit_;
+            nextSubmit_ = (nextSubmit_ + 1) % slots_.size();
+            auto &slot = slots_[index];
+            slot.state = SlotState::InFlight;
+            ++inFlight_;
+
+            auto promise = aasdk::usb::IUSBEndpoint::Promise::defer(receiveStrand_);
+            promise->then([this, self = this->shared_from_this(), index](size_t bytes) {
+                            this->onReceived(index, bytes);
+                          },
+                          [this, self = this->shared_from_this()](const aasdk::error::Error &error) {
+                            this->onReceiveError(error);
+                          });
+            aoapDevice_->getInEndpoint().bulkTransfer(aasdk::common::DataBuffer(slot.buffer), cReceiveTimeoutMs,
+                                                      std::move(promise));
+          }
+          metrics().inFlight.set(static_cast<int64_t>(inFlight_));
+        }
+
+        void PipelinedUSBTransport::onReceived(size_t slot, size_t bytes) {
+          slots_[slot].received = std::min(bytes, transferSize_);
+          slots_[slot].state = SlotState::Done;
+          if (--inFlight_ == 0) {
+            idleSince_ = Clock::now();
+          }
+
+          auto &m = metrics();
+          m.transfers.add();
+          m.bytes.add(bytes);
+          windowBytes_ += bytes;
+          const auto now = Clock::now();
+          if (now - windowStart_ >= std::chrono::seconds(1)) {
+            const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - windowStart_).count();
+            m.kbps.set(static_cast<int64_t>(windowBytes_ * 8 / static_cast<uint64_t>(elapsedMs)));
+            windowStart_ = now;
+            windowBytes_ = 0;
+          }
+
+          // Consumed bytes are dropped only when the copy would reallocate
+          if (pendingOffset_ > 0 && pending_.size() + transferSize_ > pending_.capacity()) {
+            pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(pendingOffset_));
+            pendingOffset_ = 0;
+          }
+          while (slots_[nextDrain_].state == SlotState::Done) {
+            auto &done = slots_[nextDrain_];
+            pending_.insert(pending_.end(), done.buffer.begin(),
+                            done.buffer.begin() + static_cast<std::ptrdiff_t>(done.received));
+            done.state = SlotState::Idle;
+            nextDrain_ = (nextDrain_ + 1) % slots_.size();
+          }
+
+          this->distribute();
+          this->submitIdle();
+        }
+
+        void PipelinedUSBTransport::onReceiveError(const aasdk::error::Error &error) {
+          --inFlight_;
+          metrics().inFlight.set(static_cast<int64_t>(inFlight_));
+          if (!receiveFailed_) {
+            if (error != aasdk::error::ErrorCode::OPERATION_ABORTED) {
+              OPENAUTO_LOG(error) << "[PipelinedUSBTransport] Receive failed: " << error.what();
+            }
+            receiveFailed_ = true;
+            receiveError_ = error;
+          }
+          this->distribute();
+        }
+
+        void PipelinedUSBTransport::distribute() {
+          while (!receiveQueue_.empty() && receiveQueue_.front().first <= available()) {
+            const size_t size = receiveQueue_.front().first;
+            const auto first = pending_.begin() + static_cast<std::ptrdiff_t>(pendingOffset_);
+            aasdk::common::Data data(first, first + static_cast<std::ptrdiff_t>(size));
+            pendingOffset_ += size;
+            if (pendingOffset_ == pending_.size()) {
+              pending_.clear();
+              pendingOffset_ = 0;
+            }
+            auto promise = std::move(receiveQueue_.front().second);
+            receiveQueue_.pop_front();
+            promise->resolve(std::move(data));
+          }
+
+          if (receiveFailed_) {
+            while (!receiveQueue_.empty()) {
+              auto promise = std::move(receiveQueue_.front().second);
+              receiveQueue_.pop_front();
+              promise->reject(receiveError_);
+            }
+          }
+        }
+
+        void PipelinedUSBTransport::send(aasdk::common::Data data, SendPromise::Pointer promise) {
+          sendStrand_.dispatch([this, self = this->shared_from_this(), data = std::move(data),
+                                promise = std::move(promise)]() mutable {
+            sendQueue_.emplace_back(std::move(data), std::move(promise));
+            if (sendQueue_.size() == 1) {
+              this->sendFront();
+            }
+          });
+        }
+
+        void PipelinedUSBTransport::sendFront() {
+          auto promise = aasdk::usb::IUSBEndpoint::Promise::defer(sendStrand_);
+          promise->then([this, self = this->shared_from_this()](size_t bytes) {
+                          sendOffset_ += bytes;
+                          if (sendOffset_ < sendQueue_.front().first.size()) {
+                            this->sendFront();
+                            return;
+                          }
+                          sendOffset_ = 0;
+                          auto sent = std::move(sendQueue_.front().second);
+                          sendQueue_.pop_front();
+                          sent->resolve();
+                          if (!sendQueue_.empty()) {
+                            this->sendFront();
+                          }
+                        },
+                        [this, self = this->shared_from_this()](const aasdk::error::Error &error) {
+                          this->onSendError(error);
+                        });
+          aoapDevice_->getOutEndpoint().bulkTransfer(aasdk::common::DataBuffer(sendQueue_.front().first, sendOffset_),
+                                                     cSendTimeoutMs, std::move(promise));
+        }
+
+        void PipelinedUSBTransport::onSendError(const aasdk::error::Error &error) {
+          sendOffset_ = 0;
+          while (!sendQueue_.empty()) {
+            auto promise = std::move(sendQueue_.front().second);
+            sendQueue_.pop_front();
+            promise->reject(error);
+          }
+        }
+
+        void PipelinedUSBTransport::stop() {
+          // A transfer completing after the cancel must not be resubmitted
+          receiveStrand_.dispatch([this, self = this->shared_from_this()]() {
+            if (!receiveFailed_) {
+              receiveFailed_ = true;
+              receiveError_ = aasdk::error::Error(aasdk::error::ErrorCode::OPERATION_ABORTED);
+            }
+            this->distribute();
+          });
+          aoapDevice_->getInEndpoint().cancelTransfers();
+          aoapDevice_->getOutEndpoint().cancelTransfers();
+        }
+
+      }
+    }
+  }
+}
@@ -0,0 +1,243 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <aasdk/Error/Error.hpp>
+#include <aasdk/Messenger/FrameHeader.hpp>
+#include <aasdk/Messenger/FrameSize.hpp>
+#include <aasdk/Messenger/FrameSizeType.hpp>
+#include <f1x/openauto/autoapp/Allocation.hpp>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/Service/PooledMessageInStream.hpp>
+
+namespace f1x {
+  namespace openauto {
+    namespace autoapp {
+      namespace service {
+
+        namespace {
+          struct BufferPoolMetrics {
+            MetricCounter &reused = Metrics::instance().counter(
+                "openauto_message_buffers_reused_total", "Reassembly buffers taken from the pool");
+            MetricCounter &allocated = Metrics::instance().counter(
+                "openauto_message_buffers_allocated_total", "Reassembly buffers of poolable size allocated");
+          };
+
+          BufferPoolMetrics &metrics() {
+            static BufferPoolMetrics instance;
+            return instance;
+          }
+
+          size_t classBytes(size_t index) {
+            return MessageBufferPool::cMinBytes << (2 * index);
+          }
+        }
+
+        MessageBufferPool::~MessageBufferPool() {
+          for (const auto &buffers : free_) {
+            for (const auto &buffer : buffers) {
+              MemoryFootprint::instance().release(MemoryPool::Video, static_cast<int64_t>(buffer.capacity()));
+            }
+          }
+        }
+
+        aasdk::common::Data MessageBufferPool::acquire(size_t bytes) {
+          aasdk::common::Data buffer;
+          if (bytes < cMinBytes) {
+            AllocationAccounting::instance().countTransient(AllocationTag::MessageBuffers, bytes);
+            buffer.reserve(bytes);
+            return buffer;
+          }
+          size_t index = 0;
+          while (index < cClasses && classBytes(index) < bytes) {
+            ++index;
+          }
+          if (index == cClasses) {
+            metrics().allocated.add();
+            AllocationAccounting::instance().countTransient(AllocationTag::MessageBuffers, bytes);
+            buffer.reserve(bytes);
+            return buffer;
+          }
+
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto &buffers = free_[index];
+            if (!buffers.empty()) {
+              buffer.swap(buffers.back());
+              buffers.pop_back();
+            }
+          }
+          if (buffer.capacity() > 0) {
+            MemoryFootprint::instance().release(MemoryPool::Video, static_cast<int64_t>(buffer.capacity()));
+            metrics().reused.add();
+          } else {
+            metrics().allocated.add();
+            AllocationAccounting::instance().countTransient(AllocationTag::MessageBuffers, classBytes(index));
+            buffer.reserve(classBytes(index));
+          }
+          return buffer;
+        }
+
+        void MessageBufferPool::release(aasdk::common::Data buffer) {
+          const size_t capacity = buffer.capacity();
+          if (capacity < cMinBytes || capacity > 2 * cMaxBytes) {
+            return;
+          }
+          // A buffer that outgrew its class still serves the class it fills
+          size_t index = 0;
+          while (index + 1 < cClasses && classBytes(index + 1) <= capacity) {
+            ++index;
+          }
+
+          buffer.clear();
+          std::lock_guard<std::mutex> lock(mutex_);
+          auto &buffers = free_[index];
+          if (buffers.size() < cPerClass) {
+            MemoryFootprint::instance().add(MemoryPool::Video, static_cast<int64_t>(capacity));
+            buffers.push_back(std::move(buffer));
+          }
+        }
+
+        PooledMessageInStream::PooledMessageInStream(boost::asio::io_service &ioService,
+                                                     aasdk::transport::ITransport::Pointer transport,
+                                                     aasdk::messenger::ICryptor::Pointer cryptor)
+            : strand_(ioService), transport_(std::move(transport)), cryptor_(std::move(cryptor)),
+              pool_(std::make_shared<MessageBufferPool>()), frameType_(aasdk::messenger::FrameType::BULK),
+              frameSize_(0), validFrame_(false) {
+          metrics();
+        }
+
+        void PooledMessageInStream::startReceive(aasdk::messenger::ReceivePromise::Pointer promise) {
+          strand_.dispatch([this, self = this->shared_from_this(), promise = std::move(promise)]() mutable {
+            if (promise_ != nullptr) {
+              promise->reject(aasdk::error::Error(aasdk::error::ErrorCode::OPERATION_IN_PROGRESS));
+              return;
+            }
+            promise_ = std::move(promise);
+            this->receiveFrameHeader();
+          });
+        }
+
+        aasdk::messenger::Message::Pointer PooledMessageInStream::createMessage(
+            aasdk::messenger::ChannelId channelId, aasdk::messenger::EncryptionType encryptionType,
+            aasdk::messenger::MessageType messageType) {
+          // The deleter holds the pool, which may outlive this stream
+          return aasdk::messenger::Message::Pointer(
+              new aasdk::messenger::Message(channelId, encryptionType, messageType),
+              [pool = pool_](aasdk::messenger::Message *message) {
+                pool->release(std::move(message->getPayload()));
+                delete message;
+              });
+        }
+
+        void PooledMessageInStream::receiveFrameHeader() {
+          auto promise = aasdk::transport::ITransport::ReceivePromise::defer(strand_);
+          promise->then([this, self = this->shared_from_this()](aasdk::common::Data data) { this->onFrameHeader(data); },
+                        [this, self = this->shared_from_this()](const aasdk::error::Error &error) { this->onError(error); });
+          transport_->receive(aasdk::messenger::FrameHeader::getSizeOf(), std::move(promise));
+        }
+
+        void PooledMessageInStream::onFrameHeader(const aasdk::common::Data &data) {
+          const aasdk::messenger::FrameHeader header{aasdk::common::DataConstBuffer(data)};
+          frameType_ = header.getType();
+          const bool first = frameType_ == aasdk::messenger::FrameType::FIRST;
+
+          auto pending = pending_.find(header.getChannelId());
+          if (pending != pending_.end()) {
+            // A new message drops the unfinished one of its channel
+            if (!first && frameType_ != aasdk::messenger::FrameType::BULK) {
+              message_ = std::move(pending->second);
+            }
+            pending_.erase(pending);
+          }
+          validFrame_ = message_ != nullptr || first || frameType_ == aasdk::messenger::FrameType::BULK;
+          if (message_ == nullptr && validFrame_) {
+            message_ = this->createMessage(header.getChannelId(), header.getEncryptionType(), header.getMessageType());
+          }
+
+          auto promise = aasdk::transport::ITransport::ReceivePromise::defer(strand_);
+          promise->then([this, self = this->shared_from_this()](aasdk::common::Data data) { this->onFrameSize(data); },
+                        [this, self = this->shared_from_this()](const aasdk::error::Error &error) { this->onError(error); });
+          transport_->receive(aasdk::messenger::FrameSize::getSizeOf(first ? aasdk::messenger::FrameSizeType::EXTENDED
+                                                                          : aasdk::messenger::FrameSizeType::SHORT),
+                              std::move(promise));
+        }
+
+        void PooledMessageInStream::onFrameSize(const aasdk::common::Data &data) {
+          const aasdk::messenger::FrameSize size{aasdk::common::DataConstBuffer(data)};
+          frameSize_ = size.getFrameSize();
+
+          // Room for the whole message before the first fragment lands in it
+          if (message_ != nullptr && message_->getPayload().empty()) {
+            const size_t total =
+                frameType_ == aasdk::messenger::FrameType::FIRST ? size.getTotalSize() : frameSize_;
+            auto buffer = pool_->acquire(total);
+            message_->getPayload().swap(buffer);
+          }
+
+          auto promise = aasdk::transport::ITransport::ReceivePromise::defer(strand_);
+          promise->then([this, self = this->shared_from_this()](aasdk::common::Data data) { this->onFramePayload(data); },
+                        [this, self = this->shared_from_this()](const aasdk::error::Error &error) { this->onError(error); });
+          transport_->receive(frameSize_, std::move(promise));
+        }
+
+        void PooledMessageInStream::onFramePayload(const aasdk::common::Data &data) {
+          if (!validFrame_) {
+            this->receiveFrameHeader();
+            return;
+          }
+
+          const aasdk::common::DataConstBuffer buffer(data);
+          if (message_->getEncryptionType() == aasdk::messenger::EncryptionType::ENCRYPTED) {
+            try {
+              cryptor_->decrypt(message_->getPayload(), buffer);
+            } catch (const aasdk::error::Error &error) {
+              this->onError(error);
+              return;
+            }
+          } else {
+            message_->insertPayload(buffer);
+          }
+
+          if (frameType_ == aasdk::messenger::FrameType::LAST || frameType_ == aasdk::messenger::FrameType::BULK) {
+            auto promise = std::move(promise_);
+            promise_.reset();
+            auto message = std::move(message_);
+            message_.reset();
+            promise->resolve(std::move(message));
+            return;
+          }
+
+          const auto channelId = message_->getChannelId();
+          pending_[channelId] = std::move(message_);
+          message_.reset();
+          this->receiveFrameHeader();
+        }
+
+        void PooledMessageInStream::onError(const aasdk::error::Error &error) {
+          message_.reset();
+          if (promise_ != nullptr) {
+            promise_->reject(error);
+            promise_.reset();
+          }
+        }
+
+      }
+    }
+  }
+}
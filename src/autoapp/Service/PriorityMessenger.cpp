@@ -0,0 +1,205 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <aasdk/Error/Error.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/Service/PriorityMessenger.hpp>
+
+namespace f1x {
+  namespace openauto {
+    namespace autoapp {
+      namespace service {
+
+        namespace {
+          constexpr size_t cClassCount = static_cast<size_t>(OutboundClass::Count);
+
+          struct OutboundMetrics {
+            std::array<MetricHistogram *, cClassCount> queueMs{};
+            MetricCounter &aged = Metrics::instance().counter(
+                "openauto_outbound_aged_total", "Messages sent ahead of a more urgent class after waiting");
+
+            OutboundMetrics() {
+              for (size_t i = 0; i < cClassCount; ++i) {
+                const std::string name = outboundClassName(static_cast<OutboundClass>(i));
+                queueMs[i] = &Metrics::instance().histogram(
+                    "openauto_outbound_" + name + "_queue_ms", "Wait of " + name + " messages for the out stream",
+                    {0.1, 0.5, 1, 2, 5, 10, 20, 50, 100});
+              }
+            }
+          };
+
+          OutboundMetrics &metrics() {
+            static OutboundMetrics instance;
+            return instance;
+          }
+        }
+
+        const char *outboundClassName(OutboundClass outboundClass) {
+          switch (outboundClass) {
+            case OutboundClass::Input:
+              return "input";
+            case OutboundClass::Control:
+              return "control";
+            case OutboundClass::Video:
+              return "video";
+            case OutboundClass::Audio:
+              return "audio";
+            case OutboundClass::Sensor:
+              return "sensor";
+            default:
+              return "status";
+          }
+        }
+
+        OutboundClass outboundClassOf(aasdk::messenger::ChannelId channelId) {
+          switch (channelId) {
+            case aasdk::messenger::ChannelId::INPUT_SOURCE:
+              return OutboundClass::Input;
+            case aasdk::messenger::ChannelId::CONTROL:
+              return OutboundClass::Control;
+            case aasdk::messenger::ChannelId::MEDIA_SINK_VIDEO:
+              return OutboundClass::Video;
+            case aasdk::messenger::ChannelId::MEDIA_SINK_MEDIA_AUDIO:
+            case aasdk::messenger::ChannelId::MEDIA_SINK_GUIDANCE_AUDIO:
+            case aasdk::messenger::ChannelId::MEDIA_SINK_SYSTEM_AUDIO:
+            case aasdk::messenger::ChannelId::MEDIA_SINK_TELEPHONY_AUDIO:
+            case aasdk::messenger::ChannelId::MEDIA_SOURCE_MICROPHONE:
+              return OutboundClass::Audio;
+            case aasdk::messenger::ChannelId::SENSOR:
+              return OutboundClass::Sensor;
+            default:
+              return OutboundClass::Status;
+          }
+        }
+
+        PriorityMessenger::PriorityMessenger(boost::asio::io_service &ioService,
+                                             aasdk::messenger::IMessenger::Pointer messenger)
+            : strand_(ioService), messenger_(std::move(messenger)), sending_(false) {
+          metrics();
+        }
+
+        void PriorityMessenger::enqueueReceive(aasdk::messenger::ReceivePromise::Pointer promise) {
+          messenger_->enqueueReceive(std::move(promise));
+        }
+
+        void PriorityMessenger::enqueueSend(aasdk::messenger::Message message,
+                                            aasdk::messenger::SendPromise::Pointer promise) {
+          const OutboundClass outboundClass = outboundClassOf(message.getChannelId());
+          Pending pending;
+          pending.message.emplace(std::move(message));
+          pending.promise = std::move(promise);
+          this->enqueue(outboundClass, std::move(pending));
+        }
+
+        void PriorityMessenger::enqueueSend(aasdk::common::Data data, aasdk::messenger::SendPromise::Pointer promise) {
+          Pending pending;
+          pending.data = std::move(data);
+          pending.promise = std::move(promise);
+          this->enqueue(OutboundClass::Control, std::move(pending));
+        }
+
+        void PriorityMessenger::enqueue(OutboundClass outboundClass, Pending pending) {
+          pending.queued = Clock::now();
+          strand_.dispatch([this, self = this->shared_from_this(), outboundClass,
+                            pending = std::make_shared<Pending>(std::move(pending))]() {
+            queues_[static_cast<size_t>(outboundClass)].push_back(std::move(*pending));
+            this->sendNext();
+          });
+        }
+
+        void PriorityMessenger::sendNext() {
+          if (sending_) {
+            return;
+          }
+
+          // Lowest class index minus one class per cAgingStepMs waited; ties
+          // go to the more urgent class
+          const auto now = Clock::now();
+          size_t next = cClassCount;
+          size_t mostUrgent = cClassCount;
+          int64_t nextScore = 0;
+          for (size_t i = 0; i < cClassCount; ++i) {
+            if (queues_[i].empty()) {
+              continue;
+            }
+            const int64_t waitedMs =
+                std::chrono::duration_cast<std::chrono::milliseconds>(now - queues_[i].front().queued).count();
+            const int64_t score = static_cast<int64_t>(i) * cAgingStepMs - waitedMs;
+            if (next == cClassCount || score < nextScore) {
+              next = i;
+              nextScore = score;
+            }
+            if (mostUrgent == cClassCount) {
+              mostUrgent = i;
+            }
+          }
+          if (next == cClassCount) {
+            return;
+          }
+
+          auto &m = metrics();
+          if (next != mostUrgent) {
+            m.aged.add();
+          }
+          Pending pending = std::move(queues_[next].front());
+          queues_[next].pop_front();
+          m.queueMs[next]->observe(std::chrono::duration<double, std::milli>(now - pending.queued).count());
+
+          sending_ = true;
+          auto sent = aasdk::messenger::SendPromise::defer(strand_);
+          sent->then([this, self = this->shared_from_this(), promise = pending.promise]() {
+                       sending_ = false;
+                       promise->resolve();
+                       this->sendNext();
+                     },
+                     [this, self = this->shared_from_this(), promise = pending.promise](const aasdk::error::Error &error) {
+                       sending_ = false;
+                       promise->reject(error);
+                       this->sendNext();
+                     });
+          if (pending.message) {
+            messenger_->enqueueSend(std::move(*pending.message), std::move(sent));
+          } else {
+            messenger_->enqueueSend(std::move(pending.data), std::move(sent));
+          }
+        }
+
+        void PriorityMessenger::rejectQueued() {
+          for (auto &queue : queues_) {
+            while (!queue.empty()) {
+              auto promise = std::move(queue.front().promise);
+              queue.pop_front();
+              promise->reject(aasdk::error::Error(aasdk::error::ErrorCode::OPERATION_ABORTED));
+            }
+          }
+        }
+
+        void PriorityMessenger::cancelActiveTransfers() {
+          strand_.dispatch([this, self = this->shared_from_this()]() { this->rejectQueued(); });
+          messenger_->cancelActiveTransfers();
+        }
+
+        void PriorityMessenger::stop() {
+          strand_.dispatch([this, self = this->shared_from_this()]() { this->rejectQueued(); });
+          messenger_->stop();
+        }
+
+      }
+    }
+  }
+}
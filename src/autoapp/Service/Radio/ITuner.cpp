@@ -0,0 +1,48 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/autoapp/Service/Radio/ITuner.hpp>
+#include <algorithm>
+#include <cctype>
+
+namespace f1x::openauto::autoapp::service::radio {
+
+  bool RadioBand::forRegion(const std::string &region, RadioBand &band) {
+    std::string code;
+    for (const char c : region) {
+      code += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+    if (code == "EU" || code.empty()) {
+      band = {87500, 108000, 100};
+    } else if (code == "US") {
+      band = {87900, 107900, 200};
+    } else if (code == "JP") {
+      band = {76000, 95000, 100};
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  uint32_t RadioBand::snap(uint32_t khz) const {
+    const uint32_t clamped = std::min(std::max(khz, minKhz), maxKhz);
+    const uint32_t channel = (clamped - minKhz + spacingKhz / 2) / spacingKhz;
+    return std::min(minKhz + channel * spacingKhz, maxKhz);
+  }
+
+}
@@ -0,0 +1,238 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Projection/AudioDeviceList.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+#include <f1x/openauto/autoapp/Service/Radio/RadioReceiver.hpp>
+#include <f1x/openauto/autoapp/Service/Radio/StationScanner.hpp>
+#include <algorithm>
+
+namespace f1x::openauto::autoapp::service::radio {
+
+  RadioReceiver::RadioReceiver(ITuner::Pointer tuner, RadioBand band, std::string cachePath,
+                               std::string audioDevice, projection::IAudioOutput::Pointer output)
+      : tuner_(std::move(tuner)),
+        band_(band),
+        cachePath_(std::move(cachePath)),
+        audioDevice_(std::move(audioDevice)),
+        output_(std::move(output)),
+        frequencyKhz_(0),
+        started_(false),
+        scanCancelled_(false) {
+
+  }
+
+  RadioReceiver::~RadioReceiver() {
+    this->stop();
+  }
+
+  bool RadioReceiver::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (started_) {
+      return true;
+    }
+    if (!tuner_->open()) {
+      return false;
+    }
+    started_ = true;
+
+    if (stations_.empty() && StationScanner::load(cachePath_, stations_)) {
+      OPENAUTO_LOG(info) << "[RadioReceiver] " << stations_.size() << " stations from " << cachePath_;
+    }
+    if (frequencyKhz_ == 0 && !stations_.empty()) {
+      frequencyKhz_ = stations_.front().frequencyKhz;
+    }
+    if (frequencyKhz_ != 0) {
+      tuner_->tune(frequencyKhz_);
+    }
+    tuner_->setMuted(false);
+    this->startAudio();
+
+    if (stations_.empty()) {
+      this->startScan();
+    }
+    return true;
+  }
+
+  void RadioReceiver::stop() {
+    this->cancelScan();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!started_) {
+      return;
+    }
+    started_ = false;
+    this->stopAudio();
+    tuner_->setMuted(true);
+    tuner_->close();
+  }
+
+  bool RadioReceiver::tune(uint32_t khz) {
+    // Whoever tunes by hand wants that station now, not the rest of a scan
+    this->cancelScan();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint32_t snapped = band_.snap(khz);
+    if (!started_ || !tuner_->tune(snapped)) {
+      return false;
+    }
+    frequencyKhz_ = snapped;
+    return true;
+  }
+
+  bool RadioReceiver::step(bool upward) {
+    uint32_t target = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stations_.empty()) {
+        return false;
+      }
+      auto next = std::find_if(stations_.begin(), stations_.end(), [this](const RadioStation &station) {
+        return station.frequencyKhz > frequencyKhz_;
+      });
+      if (upward) {
+        target = next == stations_.end() ? stations_.front().frequencyKhz : next->frequencyKhz;
+      } else {
+        auto previous = std::find_if(stations_.rbegin(), stations_.rend(), [this](const RadioStation &station) {
+          return station.frequencyKhz < frequencyKhz_;
+        });
+        target = previous == stations_.rend() ? stations_.back().frequencyKhz : previous->frequencyKhz;
+      }
+    }
+    return this->tune(target);
+  }
+
+  void RadioReceiver::rescan() {
+    this->cancelScan();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (started_) {
+      this->startScan();
+    }
+  }
+
+  std::vector<RadioStation> RadioReceiver::stations() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stations_;
+  }
+
+  uint32_t RadioReceiver::frequencyKhz() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return frequencyKhz_;
+  }
+
+  void RadioReceiver::startScan() {
+    // mutex_ held; any previous scan was joined by cancelScan()
+    scanCancelled_.store(false);
+    scanThread_ = std::thread(&RadioReceiver::runScan, this);
+  }
+
+  void RadioReceiver::cancelScan() {
+    scanCancelled_.store(true);
+    if (scanThread_.joinable()) {
+      scanThread_.join();
+    }
+  }
+
+  void RadioReceiver::runScan() {
+    projection::ThreadTopology::instance().apply(projection::ThreadRole::Background, "oa-radioscan");
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    OPENAUTO_LOG(info) << "[RadioReceiver] Scanning " << band_.minKhz << "-" << band_.maxKhz << " kHz on "
+                       << tuner_->name();
+
+    // Nobody wants to hear the sweep
+    tuner_->setMuted(true);
+    auto found = StationScanner::scan(*tuner_, band_, scanCancelled_);
+    const bool complete = !scanCancelled_.load();
+    if (complete || stations_.empty()) {
+      stations_ = std::move(found);
+    }
+    if (complete && StationScanner::save(cachePath_, stations_)) {
+      OPENAUTO_LOG(info) << "[RadioReceiver] Found " << stations_.size() << " stations";
+    }
+
+    // Back to what was playing, or to the first station found
+    if (frequencyKhz_ == 0 && !stations_.empty()) {
+      frequencyKhz_ = stations_.front().frequencyKhz;
+    }
+    if (frequencyKhz_ != 0) {
+      tuner_->tune(frequencyKhz_);
+    }
+    tuner_->setMuted(false);
+  }
+
+  bool RadioReceiver::startAudio() {
+    // mutex_ held
+    if (audioDevice_.empty() || !output_ || !output_->open()) {
+      return false;
+    }
+
+    try {
+      capture_ = std::make_unique<RtAudio>(RtAudio::LINUX_ALSA);
+      RtAudio::StreamParameters parameters;
+      parameters.deviceId = projection::AudioDeviceList::findInputDeviceByName(audioDevice_);
+      parameters.nChannels = cChannelCount;
+      parameters.firstChannel = 0;
+      unsigned int bufferFrames = 1024;
+      capture_->openStream(nullptr, &parameters, RTAUDIO_SINT16, cSampleRate, &bufferFrames,
+                           &RadioReceiver::captureCallback, this, nullptr);
+      output_->start();
+      capture_->startStream();
+      OPENAUTO_LOG(info) << "[RadioReceiver] Playing " << audioDevice_ << " through the mixer";
+      return true;
+    } catch (RtAudioError &error) {
+      OPENAUTO_LOG(error) << "[RadioReceiver] Cannot capture " << audioDevice_ << ": " << error.getMessage();
+      capture_.reset();
+      output_->stop();
+      return false;
+    }
+  }
+
+  void RadioReceiver::stopAudio() {
+    // mutex_ held
+    if (!capture_) {
+      return;
+    }
+    try {
+      if (capture_->isStreamRunning()) {
+        capture_->stopStream();
+      }
+      if (capture_->isStreamOpen()) {
+        capture_->closeStream();
+      }
+    } catch (RtAudioError &error) {
+      OPENAUTO_LOG(error) << "[RadioReceiver] Error stopping capture: " << error.getMessage();
+    }
+    capture_.reset();
+    output_->stop();
+  }
+
+  int RadioReceiver::captureCallback(void *, void *inputBuffer, unsigned int frames, double,
+                                     RtAudioStreamStatus, void *userData) {
+    auto *receiver = static_cast<RadioReceiver *>(userData);
+    // Handed over as a phone channel's strand would: the output's jitter
+    // buffer absorbs the drift between the tuner's clock and the DAC's
+    if (inputBuffer != nullptr) {
+      receiver->output_->write(0, aasdk::common::DataConstBuffer(inputBuffer, frames * cChannelCount * sizeof(int16_t)));
+    }
+    return 0;
+  }
+
+}
@@ -17,6 +17,7 @@
 */
 
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
 #include <f1x/openauto/autoapp/Service/Radio/RadioService.hpp>
 #include <fstream>
 #include <QString>
@@ -24,22 +25,29 @@
 namespace f1x::openauto::autoapp::service::radio {
 
   RadioService::RadioService(boost::asio::io_service &ioService,
-                             aasdk::messenger::IMessenger::Pointer messenger)
+                             aasdk::messenger::IMessenger::Pointer messenger, RadioReceiver::Pointer receiver)
       : strand_(ioService),
         timer_(ioService),
-        channel_(std::make_shared<aasdk::channel::radio::RadioService>(strand_, std::move(messenger))) {
+        channel_(std::make_shared<aasdk::channel::radio::RadioService>(strand_, std::move(messenger))),
+        receiver_(std::move(receiver)) {
 
   }
 
   void RadioService::start() {
     strand_.dispatch([this, self = this->shared_from_this()]() {
       OPENAUTO_LOG(debug) << "[RadioService] start()";
+      // Opening the tuner and its capture stream blocks briefly; a first
+      // scan runs on the receiver's own thread
+      if (!receiver_->start()) {
+        OPENAUTO_LOG(error) << "[RadioService] Radio tuner unavailable";
+      }
     });
   }
 
   void RadioService::stop() {
     strand_.dispatch([this, self = this->shared_from_this()]() {
       OPENAUTO_LOG(debug) << "[RadioService] stop()";
+      receiver_->stop();
     });
   }
 
@@ -67,6 +75,7 @@ namespace f1x::openauto::autoapp::service::radio {
   }
 
   void RadioService::onChannelOpenRequest(const aap_protobuf::service::control::message::ChannelOpenRequest &request) {
+    FlightRecorder::instance().record(FlightEvent::ChannelOpened, request.service_id());
     OPENAUTO_LOG(info) << "[RadioService] onChannelOpenRequest()";
     OPENAUTO_LOG(debug) << "[RadioService] Channel Id: " << request.service_id() << ", Priority: "
                         << request.priority();
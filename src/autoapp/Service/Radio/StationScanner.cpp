@@ -0,0 +1,133 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Service/Radio/StationScanner.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <sys/stat.h>
+
+namespace f1x::openauto::autoapp::service::radio {
+
+  std::vector<RadioStation> StationScanner::pick(const std::vector<RadioStation> &sweep, uint32_t spacingKhz,
+                                                 uint32_t minSignal) {
+    std::vector<RadioStation> stations;
+    for (size_t i = 0; i < sweep.size(); i++) {
+      const RadioStation &reading = sweep[i];
+      if (reading.signal < minSignal) {
+        continue;
+      }
+      // On a plateau the lowest channel wins
+      const bool hasBefore = i > 0 && reading.frequencyKhz - sweep[i - 1].frequencyKhz <= spacingKhz;
+      const bool hasAfter = i + 1 < sweep.size() && sweep[i + 1].frequencyKhz - reading.frequencyKhz <= spacingKhz;
+      if ((hasBefore && sweep[i - 1].signal >= reading.signal) ||
+          (hasAfter && sweep[i + 1].signal > reading.signal)) {
+        continue;
+      }
+      stations.push_back(reading);
+    }
+    return stations;
+  }
+
+  std::vector<RadioStation> StationScanner::scan(ITuner &tuner, const RadioBand &band,
+                                                 const std::atomic<bool> &cancel) {
+    std::vector<RadioStation> stations;
+
+    if (tuner.canSeek() && tuner.tune(band.minKhz)) {
+      uint32_t last = 0;
+      uint32_t khz = 0;
+      // Seeking starts after the current channel: the band edge itself is stepped onto
+      const int32_t edge = tuner.signal();
+      if (edge >= static_cast<int32_t>(cMinSignal)) {
+        stations.push_back({band.minKhz, static_cast<uint32_t>(edge)});
+      }
+      while (!cancel.load(std::memory_order_relaxed) && tuner.seek(true, band, khz) && khz > last) {
+        last = khz;
+        const int32_t level = tuner.signal();
+        stations.push_back({band.snap(khz), static_cast<uint32_t>(std::max(level, 0))});
+      }
+      return stations;
+    }
+
+    std::vector<RadioStation> sweep;
+    for (uint32_t khz = band.minKhz; khz <= band.maxKhz && !cancel.load(std::memory_order_relaxed);
+         khz += band.spacingKhz) {
+      if (!tuner.tune(khz)) {
+        continue;
+      }
+      std::this_thread::sleep_for(cSettleTime);
+      const int32_t level = tuner.signal();
+      if (level >= 0) {
+        sweep.push_back({khz, static_cast<uint32_t>(level)});
+      }
+    }
+    return pick(sweep, band.spacingKhz);
+  }
+
+  std::string StationScanner::cachePath(const std::string &directory, const std::string &region) {
+    std::string code;
+    for (const char c : region.empty() ? std::string("EU") : region) {
+      if (std::isalnum(static_cast<unsigned char>(c))) {
+        code += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+      }
+    }
+    return directory + "/stations-" + code + ".txt";
+  }
+
+  bool StationScanner::load(const std::string &path, std::vector<RadioStation> &stations) {
+    std::ifstream file(path);
+    if (!file) {
+      return false;
+    }
+    stations.clear();
+    RadioStation station;
+    while (file >> station.frequencyKhz >> station.signal) {
+      stations.push_back(station);
+    }
+    return file.eof();
+  }
+
+  bool StationScanner::save(const std::string &path, const std::vector<RadioStation> &stations) {
+    // The cache directory may not exist yet on a fresh image
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+      mkdir(path.substr(0, slash).c_str(), 0755);
+    }
+
+    // Written aside and renamed, so a power cut leaves the old list
+    const std::string temporary = path + ".tmp";
+    {
+      std::ofstream file(temporary, std::ios::trunc);
+      for (const auto &station : stations) {
+        file << station.frequencyKhz << ' ' << station.signal << '\n';
+      }
+      if (!file.flush()) {
+        return false;
+      }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+      OPENAUTO_LOG(warning) << "[StationScanner] Cannot write " << path;
+      std::remove(temporary.c_str());
+      return false;
+    }
+    return true;
+  }
+
+}
@@ -0,0 +1,185 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Service/Radio/V4l2RadioTuner.hpp>
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace f1x::openauto::autoapp::service::radio {
+
+  namespace {
+    int xioctl(int fd, unsigned long request, void *arg) {
+      int ret;
+      do {
+        ret = ioctl(fd, request, arg);
+      } while (ret < 0 && errno == EINTR);
+      return ret;
+    }
+  }
+
+  V4l2RadioTuner::V4l2RadioTuner(std::string device)
+      : device_(std::move(device)),
+        fd_(-1),
+        capability_(0),
+        hardwareSeek_(false) {
+
+  }
+
+  V4l2RadioTuner::~V4l2RadioTuner() {
+    this->close();
+  }
+
+  bool V4l2RadioTuner::open() {
+    if (fd_ >= 0) {
+      return true;
+    }
+
+    fd_ = ::open(device_.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd_ < 0) {
+      OPENAUTO_LOG(error) << "[V4l2RadioTuner] Cannot open " << device_ << ": " << strerror(errno);
+      return false;
+    }
+
+    v4l2_capability cap{};
+    const uint32_t caps = xioctl(fd_, VIDIOC_QUERYCAP, &cap) < 0 ? 0
+                          : (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps
+                                                                      : cap.capabilities;
+    v4l2_tuner tuner{};
+    if (!(caps & V4L2_CAP_TUNER) || xioctl(fd_, VIDIOC_G_TUNER, &tuner) < 0 || tuner.type != V4L2_TUNER_RADIO) {
+      OPENAUTO_LOG(error) << "[V4l2RadioTuner] " << device_ << " is not a radio tuner";
+      this->close();
+      return false;
+    }
+
+    name_.assign(reinterpret_cast<const char *>(cap.card), strnlen(reinterpret_cast<const char *>(cap.card), sizeof(cap.card)));
+    capability_ = tuner.capability;
+    hardwareSeek_ = (caps & V4L2_CAP_HW_FREQ_SEEK) != 0 && (tuner.capability & V4L2_TUNER_CAP_HWSEEK_BOUNDED) != 0;
+
+    OPENAUTO_LOG(info) << "[V4l2RadioTuner] " << name_ << " on " << device_ << ", " << toKhz(tuner.rangelow)
+                       << "-" << toKhz(tuner.rangehigh) << " kHz" << (hardwareSeek_ ? ", hardware seek" : "");
+    return true;
+  }
+
+  void V4l2RadioTuner::close() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  std::string V4l2RadioTuner::name() const {
+    return name_.empty() ? device_ : name_;
+  }
+
+  bool V4l2RadioTuner::tune(uint32_t khz) {
+    v4l2_frequency frequency{};
+    frequency.tuner = 0;
+    frequency.type = V4L2_TUNER_RADIO;
+    frequency.frequency = toUnits(khz);
+    if (fd_ < 0 || xioctl(fd_, VIDIOC_S_FREQUENCY, &frequency) < 0) {
+      OPENAUTO_LOG(warning) << "[V4l2RadioTuner] Cannot tune to " << khz << " kHz: " << strerror(errno);
+      return false;
+    }
+    return true;
+  }
+
+  uint32_t V4l2RadioTuner::frequencyKhz() const {
+    v4l2_frequency frequency{};
+    frequency.tuner = 0;
+    if (fd_ < 0 || xioctl(fd_, VIDIOC_G_FREQUENCY, &frequency) < 0) {
+      return 0;
+    }
+    return toKhz(frequency.frequency);
+  }
+
+  int32_t V4l2RadioTuner::signal() {
+    v4l2_tuner tuner{};
+    tuner.index = 0;
+    if (fd_ < 0 || xioctl(fd_, VIDIOC_G_TUNER, &tuner) < 0) {
+      return -1;
+    }
+    // 0-65535 by the V4L2 spec, whatever the chip's own RSSI scale
+    return static_cast<int32_t>((static_cast<int64_t>(tuner.signal) * 100 + 32767) / 65535);
+  }
+
+  void V4l2RadioTuner::setMuted(bool muted) {
+    v4l2_control control{};
+    control.id = V4L2_CID_AUDIO_MUTE;
+    control.value = muted ? 1 : 0;
+    if (fd_ >= 0 && xioctl(fd_, VIDIOC_S_CTRL, &control) < 0) {
+      OPENAUTO_LOG(debug) << "[V4l2RadioTuner] No mute control: " << strerror(errno);
+    }
+  }
+
+  bool V4l2RadioTuner::seek(bool upward, const RadioBand &band, uint32_t &khz) {
+    if (fd_ < 0 || !hardwareSeek_) {
+      return false;
+    }
+
+    v4l2_hw_freq_seek seek{};
+    seek.tuner = 0;
+    seek.type = V4L2_TUNER_RADIO;
+    seek.seek_upward = upward ? 1 : 0;
+    seek.wrap_around = 0;
+    seek.spacing = band.spacingKhz * 1000;
+    if (capability_ & V4L2_TUNER_CAP_HWSEEK_PROG_LIM) {
+      seek.rangelow = toUnits(band.minKhz);
+      seek.rangehigh = toUnits(band.maxKhz);
+    }
+    // ENODATA: nothing found before the band edge
+    if (xioctl(fd_, VIDIOC_S_HW_FREQ_SEEK, &seek) < 0) {
+      if (errno != ENODATA && errno != EAGAIN) {
+        OPENAUTO_LOG(warning) << "[V4l2RadioTuner] Seek failed: " << strerror(errno);
+      }
+      return false;
+    }
+    khz = this->frequencyKhz();
+    return khz != 0;
+  }
+
+  bool V4l2RadioTuner::canSeek() const {
+    return hardwareSeek_;
+  }
+
+  uint32_t V4l2RadioTuner::toUnits(uint32_t khz) const {
+    // 62.5 Hz units with CAP_LOW, 1 Hz with CAP_1HZ, 62.5 kHz otherwise
+    if (capability_ & V4L2_TUNER_CAP_1HZ) {
+      return khz * 1000;
+    }
+    if (capability_ & V4L2_TUNER_CAP_LOW) {
+      return khz * 16;
+    }
+    return khz * 2 / 125;
+  }
+
+  uint32_t V4l2RadioTuner::toKhz(uint32_t units) const {
+    if (capability_ & V4L2_TUNER_CAP_1HZ) {
+      return units / 1000;
+    }
+    if (capability_ & V4L2_TUNER_CAP_LOW) {
+      return units / 16;
+    }
+    return units * 125 / 2;
+  }
+
+}
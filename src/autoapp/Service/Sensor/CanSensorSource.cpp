@@ -0,0 +1,236 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <f1x/openauto/autoapp/Service/Sensor/CanSensorSource.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x::openauto::autoapp::service::sensor {
+
+  namespace {
+    // Reconnect delay while the interface is down or missing
+    constexpr int cRetryMs = 5000;
+
+    bool sensorFromName(const std::string &name, VehicleSensor &sensor) {
+      for (size_t i = 0; i < static_cast<size_t>(VehicleSensor::Count); ++i) {
+        if (name == vehicleSensorName(static_cast<VehicleSensor>(i))) {
+          sensor = static_cast<VehicleSensor>(i);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    bool parseSignal(const std::string &entry, CanSignal &signal) {
+      const auto at = entry.find('@');
+      if (at == std::string::npos || !sensorFromName(entry.substr(0, at), signal.sensor)) {
+        return false;
+      }
+      // Accelerometer and gyroscope come from IIO, not the bus
+      if (signal.sensor == VehicleSensor::Accelerometer || signal.sensor == VehicleSensor::Gyroscope) {
+        return false;
+      }
+
+      std::vector<std::string> fields;
+      std::stringstream rest(entry.substr(at + 1));
+      std::string field;
+      while (std::getline(rest, field, ':')) {
+        fields.push_back(field);
+      }
+      if (fields.size() < 3 || fields.size() > 5) {
+        return false;
+      }
+
+      try {
+        size_t used = 0;
+        const unsigned long id = std::stoul(fields[0], &used, 0);
+        if (used != fields[0].size() || id > CAN_EFF_MASK) {
+          return false;
+        }
+        const int byte = std::stoi(fields[1]);
+        const int length = std::stoi(fields[2]);
+        if (byte < 0 || length < 1 || length > 4 || byte + length > CAN_MAX_DLEN) {
+          return false;
+        }
+        signal.id = static_cast<uint32_t>(id);
+        signal.byte = static_cast<uint8_t>(byte);
+        signal.length = static_cast<uint8_t>(length);
+        signal.scale = fields.size() > 3 ? std::stod(fields[3]) : 1.0;
+        signal.offset = fields.size() > 4 ? std::stod(fields[4]) : 0.0;
+      } catch (const std::exception &) {
+        return false;
+      }
+      return true;
+    }
+  }
+
+  CanSensorSource::CanSensorSource(std::string interfaceName, std::vector<CanSignal> signals)
+      : VehicleSensorSource("oa-sensor-can"), interfaceName_(std::move(interfaceName)), signals_(std::move(signals)) {
+  }
+
+  CanSensorSource::~CanSensorSource() {
+    this->stop();
+  }
+
+  bool CanSensorSource::parseSignals(const std::string &spec, std::vector<CanSignal> &signals) {
+    signals.clear();
+    std::string normalized = spec;
+    std::replace(normalized.begin(), normalized.end(), ',', ' ');
+    std::stringstream entries(normalized);
+    std::string entry;
+    bool valid = true;
+    while (entries >> entry) {
+      CanSignal signal;
+      if (parseSignal(entry, signal)) {
+        signals.push_back(signal);
+      } else {
+        OPENAUTO_LOG(warning) << "[CanSensorSource] Ignoring malformed signal '" << entry << "'";
+        valid = false;
+      }
+    }
+    return valid;
+  }
+
+  bool CanSensorSource::decode(const CanSignal &signal, const uint8_t *data, size_t size, VehicleReading &reading) {
+    if (signal.byte + signal.length > size) {
+      return false;
+    }
+    uint32_t raw = 0;
+    for (uint8_t i = 0; i < signal.length; ++i) {
+      raw = (raw << 8) | data[signal.byte + i];
+    }
+    const double value = raw * signal.scale + signal.offset;
+
+    reading = VehicleReading();
+    reading.sensor = signal.sensor;
+    switch (signal.sensor) {
+      case VehicleSensor::Speed:
+        reading.values[0] = static_cast<int32_t>(std::lround(value / 3.6 * 1e3));
+        break;
+      case VehicleSensor::Gear:
+        reading.values[0] = static_cast<int32_t>(std::lround(value));
+        break;
+      case VehicleSensor::ParkingBrake:
+        reading.values[0] = value != 0.0 ? 1 : 0;
+        break;
+      case VehicleSensor::Fuel:
+        reading.values[0] = static_cast<int32_t>(std::lround(std::min(std::max(value, 0.0), 100.0)));
+        reading.values[1] = reading.values[0] < 10 ? 1 : 0;
+        break;
+      case VehicleSensor::Compass:
+        reading.values[0] = static_cast<int32_t>(std::lround(std::fmod(value, 360.0) * 1e6));
+        break;
+      default:
+        return false;
+    }
+    return true;
+  }
+
+  std::vector<VehicleSensor> CanSensorSource::sensors() const {
+    std::vector<VehicleSensor> sensors;
+    for (const auto &signal : signals_) {
+      if (std::find(sensors.begin(), sensors.end(), signal.sensor) == sensors.end()) {
+        sensors.push_back(signal.sensor);
+      }
+    }
+    return sensors;
+  }
+
+  int CanSensorSource::openSocket() const {
+    const int fd = socket(PF_CAN, SOCK_RAW | SOCK_CLOEXEC, CAN_RAW);
+    if (fd < 0) {
+      return -1;
+    }
+
+    ifreq request{};
+    std::strncpy(request.ifr_name, interfaceName_.c_str(), IFNAMSIZ - 1);
+    sockaddr_can address{};
+    address.can_family = AF_CAN;
+    if (ioctl(fd, SIOCGIFINDEX, &request) < 0) {
+      close(fd);
+      return -1;
+    }
+    address.can_ifindex = request.ifr_ifindex;
+
+    // Only the mapped ids reach us; the rest of the bus stays in the kernel
+    std::vector<can_filter> filters;
+    for (const auto &signal : signals_) {
+      const bool extended = signal.id > CAN_SFF_MASK;
+      can_filter filter{};
+      filter.can_id = signal.id | (extended ? CAN_EFF_FLAG : 0);
+      filter.can_mask = (extended ? CAN_EFF_MASK : CAN_SFF_MASK) | CAN_EFF_FLAG | CAN_RTR_FLAG;
+      filters.push_back(filter);
+    }
+    setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, filters.data(), filters.size() * sizeof(can_filter));
+
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  void CanSensorSource::run() {
+    bool warned = false;
+    while (!this->stopping()) {
+      const int fd = this->openSocket();
+      if (fd < 0) {
+        if (!warned) {
+          OPENAUTO_LOG(warning) << "[CanSensorSource] Cannot open " << interfaceName_ << ": " << std::strerror(errno)
+                                << "; retrying";
+          warned = true;
+        }
+        this->wait(-1, cRetryMs);
+        continue;
+      }
+      OPENAUTO_LOG(info) << "[CanSensorSource] Reading " << signals_.size() << " signals on " << interfaceName_;
+      warned = false;
+
+      while (this->wait(fd, -1) == WaitResult::Readable) {
+        can_frame frame{};
+        const ssize_t size = read(fd, &frame, sizeof(frame));
+        if (size < 0 && (errno == EAGAIN || errno == EINTR)) {
+          continue;
+        }
+        if (size != static_cast<ssize_t>(sizeof(frame))) {
+          OPENAUTO_LOG(warning) << "[CanSensorSource] " << interfaceName_ << " went away";
+          break;
+        }
+        const uint32_t id = frame.can_id & (frame.can_id & CAN_EFF_FLAG ? CAN_EFF_MASK : CAN_SFF_MASK);
+        for (const auto &signal : signals_) {
+          VehicleReading reading;
+          if (signal.id == id && decode(signal, frame.data, frame.can_dlc, reading)) {
+            this->publish(reading);
+          }
+        }
+      }
+      close(fd);
+    }
+  }
+
+}
@@ -0,0 +1,161 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <f1x/openauto/autoapp/Service/Sensor/IioSensorSource.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x::openauto::autoapp::service::sensor {
+
+  namespace {
+    const std::string cIioRoot = "/sys/bus/iio/devices/";
+
+    bool readNumber(int fd, double &value) {
+      char buffer[32];
+      const ssize_t size = pread(fd, buffer, sizeof(buffer) - 1, 0);
+      if (size <= 0) {
+        return false;
+      }
+      buffer[size] = '\0';
+      char *end = nullptr;
+      value = std::strtod(buffer, &end);
+      return end != buffer;
+    }
+
+    bool readNumber(const std::string &path, double &value) {
+      const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return false;
+      }
+      const bool ok = readNumber(fd, value);
+      close(fd);
+      return ok;
+    }
+  }
+
+  IioSensorSource::IioSensorSource(std::string device)
+      : VehicleSensorSource("oa-sensor-iio"), directory_(resolve(device)) {
+    if (directory_.empty()) {
+      OPENAUTO_LOG(warning) << "[IioSensorSource] No IIO device '" << device << "'";
+      return;
+    }
+    this->openChannel("in_accel", VehicleSensor::Accelerometer);
+    this->openChannel("in_anglvel", VehicleSensor::Gyroscope);
+    OPENAUTO_LOG(info) << "[IioSensorSource] " << directory_ << " provides " << channels_.size() << " channel(s)";
+  }
+
+  IioSensorSource::~IioSensorSource() {
+    this->stop();
+    this->closeChannels();
+  }
+
+  std::string IioSensorSource::resolve(const std::string &device) {
+    if (device != "auto") {
+      const std::string directory = device.find('/') == std::string::npos ? cIioRoot + device : device;
+      return access(directory.c_str(), R_OK) == 0 ? directory : std::string();
+    }
+
+    DIR *root = opendir(cIioRoot.c_str());
+    if (root == nullptr) {
+      return std::string();
+    }
+    std::string found;
+    while (dirent *entry = readdir(root)) {
+      const std::string directory = cIioRoot + entry->d_name;
+      if (entry->d_name[0] != '.' && access((directory + "/in_accel_x_raw").c_str(), R_OK) == 0) {
+        found = directory;
+        break;
+      }
+    }
+    closedir(root);
+    return found;
+  }
+
+  void IioSensorSource::openChannel(const std::string &prefix, VehicleSensor sensor) {
+    Channel channel;
+    channel.sensor = sensor;
+    const char axes[3] = {'x', 'y', 'z'};
+    for (size_t i = 0; i < 3; ++i) {
+      const std::string path = directory_ + "/" + prefix + "_" + axes[i] + "_raw";
+      channel.fds[i] = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (channel.fds[i] < 0) {
+        for (int fd : channel.fds) {
+          if (fd >= 0) {
+            close(fd);
+          }
+        }
+        return;
+      }
+    }
+    // The scale is shared as in_accel_scale on most drivers, per axis on some
+    if (!readNumber(directory_ + "/" + prefix + "_scale", channel.scale)) {
+      readNumber(directory_ + "/" + prefix + "_x_scale", channel.scale);
+    }
+    channels_.push_back(channel);
+  }
+
+  void IioSensorSource::closeChannels() {
+    for (auto &channel : channels_) {
+      for (int fd : channel.fds) {
+        close(fd);
+      }
+    }
+    channels_.clear();
+  }
+
+  std::vector<VehicleSensor> IioSensorSource::sensors() const {
+    std::vector<VehicleSensor> sensors;
+    for (const auto &channel : channels_) {
+      sensors.push_back(channel.sensor);
+    }
+    return sensors;
+  }
+
+  bool IioSensorSource::sample(const Channel &channel, VehicleReading &reading) const {
+    reading = VehicleReading();
+    reading.sensor = channel.sensor;
+    for (size_t i = 0; i < 3; ++i) {
+      double raw = 0;
+      if (!readNumber(channel.fds[i], raw)) {
+        return false;
+      }
+      // m/s^2 and rad/s, scaled to the e3 fixed point the phone expects
+      reading.values[i] = static_cast<int32_t>(std::lround(raw * channel.scale * 1e3));
+    }
+    return true;
+  }
+
+  void IioSensorSource::run() {
+    if (channels_.empty()) {
+      return;
+    }
+    while (this->wait(-1, cSamplePeriodMs) == WaitResult::Timeout) {
+      for (const auto &channel : channels_) {
+        VehicleReading reading;
+        if (this->sample(channel, reading)) {
+          this->publish(reading);
+        }
+      }
+    }
+  }
+
+}
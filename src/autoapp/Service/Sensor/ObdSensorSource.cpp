@@ -0,0 +1,184 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <f1x/openauto/autoapp/Service/Sensor/ObdSensorSource.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x::openauto::autoapp::service::sensor {
+
+  namespace {
+    constexpr uint8_t cPidSpeed = 0x0D;
+    constexpr uint8_t cPidFuelLevel = 0x2F;
+  }
+
+  ObdSensorSource::ObdSensorSource(std::string device)
+      : VehicleSensorSource("oa-sensor-obd"), device_(std::move(device)) {
+  }
+
+  ObdSensorSource::~ObdSensorSource() {
+    this->stop();
+  }
+
+  std::vector<VehicleSensor> ObdSensorSource::sensors() const {
+    return {VehicleSensor::Speed, VehicleSensor::Fuel};
+  }
+
+  bool ObdSensorSource::parseResponse(const std::string &reply, uint8_t pid, std::vector<uint8_t> &data) {
+    std::string hex;
+    for (char c : reply) {
+      if (std::isxdigit(static_cast<unsigned char>(c))) {
+        hex += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+      } else if (c == '\r' || c == '\n') {
+        hex += '\n';
+      }
+    }
+
+    char header[5];
+    std::snprintf(header, sizeof(header), "41%02X", pid);
+    // Each line is one ECU's answer; the first one carrying our pid wins
+    size_t start = 0;
+    while (start < hex.size()) {
+      size_t end = hex.find('\n', start);
+      if (end == std::string::npos) {
+        end = hex.size();
+      }
+      const std::string line = hex.substr(start, end - start);
+      if (line.compare(0, 4, header) == 0 && line.size() >= 6 && line.size() % 2 == 0) {
+        data.clear();
+        for (size_t i = 4; i < line.size(); i += 2) {
+          data.push_back(static_cast<uint8_t>(std::stoi(line.substr(i, 2), nullptr, 16)));
+        }
+        return true;
+      }
+      start = end + 1;
+    }
+    return false;
+  }
+
+  int ObdSensorSource::openDevice() const {
+    const int fd = open(device_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+      return -1;
+    }
+    termios tty{};
+    if (tcgetattr(fd, &tty) == 0) {
+      cfmakeraw(&tty);
+      cfsetispeed(&tty, B38400);
+      cfsetospeed(&tty, B38400);
+      tty.c_cflag |= CLOCAL | CREAD;
+      tcsetattr(fd, TCSANOW, &tty);
+    }
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+  }
+
+  bool ObdSensorSource::query(int fd, const std::string &command, std::string &reply) {
+    const std::string line = command + "\r";
+    if (write(fd, line.data(), line.size()) != static_cast<ssize_t>(line.size())) {
+      return false;
+    }
+
+    reply.clear();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(cReplyTimeoutMs);
+    while (true) {
+      const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+      if (left.count() <= 0 || this->wait(fd, static_cast<int>(left.count())) != WaitResult::Readable) {
+        return false;
+      }
+      char buffer[128];
+      const ssize_t size = read(fd, buffer, sizeof(buffer));
+      if (size < 0 && (errno == EAGAIN || errno == EINTR)) {
+        continue;
+      }
+      if (size <= 0) {
+        return false;
+      }
+      reply.append(buffer, static_cast<size_t>(size));
+      const auto prompt = reply.find('>');
+      if (prompt != std::string::npos) {
+        reply.resize(prompt);
+        return true;
+      }
+    }
+  }
+
+  void ObdSensorSource::run() {
+    bool warned = false;
+    while (!this->stopping()) {
+      const int fd = this->openDevice();
+      std::string reply;
+      // Reset, no echo, no linefeeds, no spaces, no headers, automatic protocol
+      bool ready = fd >= 0;
+      for (const char *command : {"ATZ", "ATE0", "ATL0", "ATS0", "ATH0", "ATSP0"}) {
+        ready = ready && this->query(fd, command, reply);
+      }
+      if (!ready) {
+        if (!this->stopping() && !warned) {
+          OPENAUTO_LOG(warning) << "[ObdSensorSource] No ELM327 answering on " << device_ << "; retrying";
+          warned = true;
+        }
+        if (fd >= 0) {
+          close(fd);
+        }
+        this->wait(-1, cRetryMs);
+        continue;
+      }
+      OPENAUTO_LOG(info) << "[ObdSensorSource] ELM327 ready on " << device_;
+      warned = false;
+
+      std::vector<uint8_t> data;
+      int failures = 0;
+      for (int round = 0; !this->stopping() && failures < 5; ++round) {
+        if (this->query(fd, "010D", reply) && parseResponse(reply, cPidSpeed, data) && !data.empty()) {
+          VehicleReading speed;
+          speed.sensor = VehicleSensor::Speed;
+          speed.values[0] = static_cast<int32_t>(data[0] * 1000 / 3.6);
+          this->publish(speed);
+          failures = 0;
+        } else {
+          ++failures;
+        }
+
+        if (round % cFuelEvery == 0 && this->query(fd, "012F", reply) && parseResponse(reply, cPidFuelLevel, data) &&
+            !data.empty()) {
+          VehicleReading fuel;
+          fuel.sensor = VehicleSensor::Fuel;
+          fuel.values[0] = data[0] * 100 / 255;
+          fuel.values[1] = fuel.values[0] < 10 ? 1 : 0;
+          this->publish(fuel);
+        }
+
+        this->wait(-1, cSpeedPeriodMs);
+      }
+      close(fd);
+      if (!this->stopping()) {
+        // Usual with the ignition off, so not worth a warning each time
+        OPENAUTO_LOG(debug) << "[ObdSensorSource] Adapter on " << device_ << " stopped answering";
+      }
+    }
+  }
+
+}
@@ -0,0 +1,109 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <f1x/openauto/autoapp/Service/Sensor/SensorRateLimiter.hpp>
+
+namespace f1x::openauto::autoapp::service::sensor {
+
+  void SensorRateLimiter::request(VehicleSensor sensor, std::chrono::milliseconds period) {
+    Slot &slot = slots_[static_cast<size_t>(sensor)];
+    slot.requested = true;
+    slot.period = std::max(period, std::chrono::milliseconds(0));
+    // A (re)start wants the current value, even an unchanged one
+    if (slot.hasSent && !slot.hasPending) {
+      slot.pending = slot.sent;
+      slot.hasPending = true;
+    }
+    slot.hasSent = false;
+  }
+
+  bool SensorRateLimiter::isRequested(VehicleSensor sensor) const {
+    return slots_[static_cast<size_t>(sensor)].requested;
+  }
+
+  void SensorRateLimiter::offer(const VehicleReading &reading, Clock::time_point) {
+    if (reading.sensor >= VehicleSensor::Count) {
+      return;
+    }
+    Slot &slot = slots_[static_cast<size_t>(reading.sensor)];
+    if (slot.hasSent && !differs(reading, slot.sent)) {
+      // Back within the dead band of what the phone already has
+      slot.hasPending = false;
+      return;
+    }
+    slot.pending = reading;
+    slot.hasPending = true;
+  }
+
+  std::vector<VehicleReading> SensorRateLimiter::collect(Clock::time_point now) {
+    std::vector<VehicleReading> due;
+    for (auto &slot : slots_) {
+      if (!slot.requested || !slot.hasPending) {
+        continue;
+      }
+      if (slot.hasSent && now - slot.sentAt < slot.period) {
+        continue;
+      }
+      due.push_back(slot.pending);
+      slot.sent = slot.pending;
+      slot.sentAt = now;
+      slot.hasSent = true;
+      slot.hasPending = false;
+    }
+    return due;
+  }
+
+  SensorRateLimiter::Clock::time_point SensorRateLimiter::nextDue() const {
+    auto next = Clock::time_point::max();
+    for (const auto &slot : slots_) {
+      if (!slot.requested || !slot.hasPending) {
+        continue;
+      }
+      next = std::min(next, slot.hasSent ? slot.sentAt + slot.period : Clock::time_point::min());
+    }
+    return next;
+  }
+
+  int32_t SensorRateLimiter::deadBand(VehicleSensor sensor) {
+    switch (sensor) {
+      case VehicleSensor::Speed:
+        return 100; // 0.1 m/s
+      case VehicleSensor::Compass:
+        return 500000; // half a degree
+      case VehicleSensor::Accelerometer:
+        return 50; // 0.05 m/s^2
+      case VehicleSensor::Gyroscope:
+        return 10; // 0.01 rad/s
+      default:
+        return 0;
+    }
+  }
+
+  bool SensorRateLimiter::differs(const VehicleReading &a, const VehicleReading &b) {
+    const int32_t band = deadBand(a.sensor);
+    for (size_t i = 0; i < a.values.size(); ++i) {
+      if (std::abs(static_cast<int64_t>(a.values[i]) - b.values[i]) > band) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+}
@@ -18,59 +18,99 @@
 
 
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
 #include <f1x/openauto/autoapp/Service/Sensor/SensorService.hpp>
-#include <fstream>
+#include <f1x/openauto/autoapp/StateBus.hpp>
+#include <f1x/openauto/autoapp/StrandMonitor.hpp>
+#include <algorithm>
 #include <cmath>
+#include <ctime>
 #include <gps.h>
 
 namespace f1x::openauto::autoapp::service::sensor {
   SensorService::SensorService(boost::asio::io_service &ioService,
-                               aasdk::messenger::IMessenger::Pointer messenger)
+                               aasdk::messenger::IMessenger::Pointer messenger,
+                               std::vector<IVehicleSensorSource::Pointer> vehicleSources,
+                               bool restrictWhileMoving,
+                               bool nightFromGps)
       : strand_(ioService),
-        timer_(ioService),
-        channel_(std::make_shared<aasdk::channel::sensorsource::SensorSourceService>(strand_, std::move(messenger))) {
+        gpsDescriptor_(ioService),
+        channel_(std::make_shared<aasdk::channel::sensorsource::SensorSourceService>(strand_, std::move(messenger))),
+        vehicleSources_(std::move(vehicleSources)),
+        flushTimer_(ioService),
+        restrictWhileMoving_(restrictWhileMoving),
+        nightFromGps_(nightFromGps),
+        sunTimer_(ioService) {
 
   }
 
   void SensorService::start() {
     strand_.dispatch([this, self = this->shared_from_this()]() {
-      if (gps_open("127.0.0.1", "2947", &this->gpsData_)) {
-        OPENAUTO_LOG(warning) << "[SensorService] can't connect to GPSD.";
-      } else {
-        OPENAUTO_LOG(info) << "[SensorService] Connected to GPSD.";
-        gps_stream(&this->gpsData_, WATCH_ENABLE | WATCH_JSON, NULL);
-        this->gpsEnabled_ = true;
-      }
-
-      if (is_file_exist("/tmp/night_mode_enabled")) {
-        this->isNight = true;
-      }
-      this->sensorPolling();
-
       OPENAUTO_LOG(info) << "[SensorService] start()";
       channel_->receive(this->shared_from_this());
     });
+  }
 
+  void SensorService::activate() {
+    // Once per session, and never after stop() has joined the sources
+    if (this->activated_ || this->stopPolling.load(std::memory_order_acquire)) {
+      return;
+    }
+    this->activated_ = true;
+
+    if (gps_open("127.0.0.1", "2947", &this->gpsData_)) {
+      OPENAUTO_LOG(warning) << "[SensorService] can't connect to GPSD.";
+    } else {
+      OPENAUTO_LOG(info) << "[SensorService] Connected to GPSD.";
+      gps_stream(&this->gpsData_, WATCH_ENABLE | WATCH_JSON, NULL);
+      this->gpsEnabled_ = true;
+      this->gpsDescriptor_.assign(this->gpsData_.gps_fd);
+      this->waitForGPS();
+    }
+
+    // Day/night arrives from the state bus
+    this->isNight = StateBus::instance().isSet(StateFlag::NightMode);
+    std::weak_ptr<SensorService> weakSelf = this->shared_from_this();
+    this->nightModeSubscription_ = StateBus::instance().subscribe(
+        StateFlag::NightMode, [weakSelf](StateFlag, bool night) {
+          if (auto service = weakSelf.lock()) {
+            service->strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("sensor.night"),
+                                                 std::bind(&SensorService::onNightModeChanged, service, night)));
+          }
+        });
+
+    for (const auto &source : this->vehicleSources_) {
+      source->start([weakSelf](const VehicleReading &reading) {
+        if (auto service = weakSelf.lock()) {
+          service->strand_.dispatch(monitored(OPENAUTO_STRAND_SITE("sensor.vehicle"),
+                                               std::bind(&SensorService::onVehicleReading, service, reading)));
+        }
+      });
+    }
   }
 
   void SensorService::stop() {
-    // Set atomic flag first to prevent new timer callbacks from being scheduled
+    this->shutdown(nullptr);
+  }
+
+  void SensorService::shutdown(std::function<void()> done) {
+    // Set atomic flag first so no GPS wait is armed again
     this->stopPolling.store(true, std::memory_order_release);
 
-    strand_.dispatch([this, self = this->shared_from_this()]() {
-      // Cancel any pending timers to stop scheduling further polling callbacks immediately
+    StateBus::instance().unsubscribe(this->nightModeSubscription_);
+    // Joins the source threads; readings they already posted see stopPolling
+    for (const auto &source : this->vehicleSources_) {
+      source->stop();
+    }
+
+    strand_.dispatch([this, self = this->shared_from_this(), done = std::move(done)]() {
+      this->closeGPS();
       boost::system::error_code ec;
-      this->timer_.cancel(ec);
-      if (ec) {
-        OPENAUTO_LOG(warning) << "[SensorService] timer cancel error: " << ec.message();
-      }
-      if (this->gpsEnabled_) {
-        gps_stream(&this->gpsData_, WATCH_DISABLE, NULL);
-        gps_close(&this->gpsData_);
-        this->gpsEnabled_ = false;
-      }
+      this->flushTimer_.cancel(ec);
+      this->sunTimer_.cancel(ec);
 
       OPENAUTO_LOG(info) << "[SensorService] stop()";
+      if (done) done();
     });
   }
 
@@ -100,9 +140,26 @@ namespace f1x::openauto::autoapp::service::sensor {
         aap_protobuf::service::sensorsource::message::SensorType::SENSOR_LOCATION);
     sensorChannel->add_sensors()->set_sensor_type(
         aap_protobuf::service::sensorsource::message::SensorType::SENSOR_NIGHT_MODE);
+
+    bool advertised[static_cast<size_t>(VehicleSensor::Count)] = {};
+    for (const auto &source : this->vehicleSources_) {
+      for (const auto sensor : source->sensors()) {
+        advertised[static_cast<size_t>(sensor)] = true;
+      }
+    }
+    for (int type = aap_protobuf::service::sensorsource::message::SensorType_MIN; type <= aap_protobuf::service::sensorsource::message::SensorType_MAX; ++type) {
+      VehicleSensor sensor;
+      if (aap_protobuf::service::sensorsource::message::SensorType_IsValid(type) &&
+          toVehicleSensor(static_cast<aap_protobuf::service::sensorsource::message::SensorType>(type), sensor) &&
+          advertised[static_cast<size_t>(sensor)]) {
+        OPENAUTO_LOG(info) << "[SensorService] Advertising " << vehicleSensorName(sensor);
+        sensorChannel->add_sensors()->set_sensor_type(static_cast<aap_protobuf::service::sensorsource::message::SensorType>(type));
+      }
+    }
   }
 
   void SensorService::onChannelOpenRequest(const aap_protobuf::service::control::message::ChannelOpenRequest &request) {
+    FlightRecorder::instance().record(FlightEvent::ChannelOpened, request.service_id());
     OPENAUTO_LOG(info) << "[SensorService] onChannelOpenRequest()";
     OPENAUTO_LOG(debug) << "[SensorService] Channel Id: " << request.service_id() << ", Priority: "
                         << request.priority();
@@ -116,6 +173,9 @@ namespace f1x::openauto::autoapp::service::sensor {
                   std::bind(&SensorService::onChannelError, this->shared_from_this(), std::placeholders::_1));
     channel_->sendChannelOpenResponse(response, std::move(promise));
 
+    // GPSD and the vehicle buses are only worth opening once the phone uses
+    // the channel; session start stays free of their connect delays
+    this->activate();
     channel_->receive(this->shared_from_this());
   }
 
@@ -129,12 +189,20 @@ namespace f1x::openauto::autoapp::service::sensor {
 
     auto promise = aasdk::channel::SendPromise::defer(strand_);
 
+    VehicleSensor sensor;
     if (request.type() == aap_protobuf::service::sensorsource::message::SENSOR_DRIVING_STATUS_DATA) {
-      promise->then(std::bind(&SensorService::sendDrivingStatusUnrestricted, this->shared_from_this()),
+      this->drivingStatusRequested_ = true;
+      promise->then(std::bind(&SensorService::sendDrivingStatus, this->shared_from_this()),
                     std::bind(&SensorService::onChannelError, this->shared_from_this(), std::placeholders::_1));
     } else if (request.type() == aap_protobuf::service::sensorsource::message::SensorType::SENSOR_NIGHT_MODE) {
       promise->then(std::bind(&SensorService::sendNightData, this->shared_from_this()),
                     std::bind(&SensorService::onChannelError, this->shared_from_this(), std::placeholders::_1));
+    } else if (toVehicleSensor(request.type(), sensor)) {
+      OPENAUTO_LOG(info) << "[SensorService] " << vehicleSensorName(sensor) << " every "
+                         << request.min_update_period() << " ms";
+      this->rateLimiter_.request(sensor, std::chrono::milliseconds(request.min_update_period()));
+      promise->then(std::bind(&SensorService::flushVehicleReadings, this->shared_from_this()),
+                    std::bind(&SensorService::onChannelError, this->shared_from_this(), std::placeholders::_1));
     } else {
       promise->then([]() {},
                     std::bind(&SensorService::onChannelError, this->shared_from_this(), std::placeholders::_1));
@@ -144,11 +212,13 @@ namespace f1x::openauto::autoapp::service::sensor {
     channel_->receive(this->shared_from_this());
   }
 
-  void SensorService::sendDrivingStatusUnrestricted() {
-    OPENAUTO_LOG(info) << "[SensorService] sendDrivingStatusUnrestricted()";
+  void SensorService::sendDrivingStatus() {
+    const bool restricted = this->restrictWhileMoving_ && this->moving_;
+    OPENAUTO_LOG(info) << "[SensorService] sendDrivingStatus(): " << (restricted ? "moving" : "unrestricted");
     aap_protobuf::service::sensorsource::message::SensorBatch indication;
     indication.add_driving_status_data()->set_status(
-        aap_protobuf::service::sensorsource::message::DrivingStatus::DRIVE_STATUS_UNRESTRICTED);
+        restricted ? aap_protobuf::service::sensorsource::message::DrivingStatus::DRIVE_STATUS_NO_KEYBOARD_INPUT
+                   : aap_protobuf::service::sensorsource::message::DrivingStatus::DRIVE_STATUS_UNRESTRICTED);
 
     auto promise = aasdk::channel::SendPromise::defer(strand_);
     promise->then([]() {},
@@ -178,11 +248,14 @@ namespace f1x::openauto::autoapp::service::sensor {
     }
   }
 
-  void SensorService::sendGPSLocationData() {
-    OPENAUTO_LOG(info) << "[SensorService] sendGPSLocationData()";
-    aap_protobuf::service::sensorsource::message::SensorBatch indication;
+  bool SensorService::addGPSLocation(aap_protobuf::service::sensorsource::message::SensorBatch &batch) {
+    if ((this->gpsData_.fix.mode != MODE_2D && this->gpsData_.fix.mode != MODE_3D) ||
+        !(this->gpsData_.set & TIME_SET) ||
+        !(this->gpsData_.set & LATLON_SET)) {
+      return false;
+    }
 
-    auto *locInd = indication.add_location_data();
+    auto *locInd = batch.add_location_data();
 
     // epoch seconds
     // Note: set_timestamp() is deprecated but still needed for compatibility
@@ -213,63 +286,261 @@ namespace f1x::openauto::autoapp::service::sensor {
       // degrees
       locInd->set_bearing_e6(this->gpsData_.fix.track * 1e6);
     }
+    return true;
+  }
 
-    auto promise = aasdk::channel::SendPromise::defer(strand_);
-    promise->then([]() {},
-                  std::bind(&SensorService::onChannelError, this->shared_from_this(), std::placeholders::_1));
-    channel_->sendSensorEventIndication(indication, std::move(promise));
+  void SensorService::waitForGPS() {
+    if (!this->gpsEnabled_ || this->stopPolling.load(std::memory_order_acquire)) {
+      return;
+    }
+    this->gpsDescriptor_.async_wait(
+        boost::asio::posix::stream_descriptor::wait_read,
+        strand_.wrap(monitoredCompletion(
+            OPENAUTO_STRAND_SITE("sensor.gps"),
+            std::bind(&SensorService::onGPSReadable, this->shared_from_this(), std::placeholders::_1))));
   }
 
-  void SensorService::sensorPolling() {
-    OPENAUTO_LOG(info) << "[SensorService] sensorPolling()";
-    if (!this->stopPolling.load(std::memory_order_acquire)) {
-      strand_.dispatch([this, self = this->shared_from_this()]() {
-        // Check stopPolling again inside the dispatched handler to catch late stop() calls
-        if (this->stopPolling.load(std::memory_order_acquire)) {
-          OPENAUTO_LOG(info) << "[SensorService] sensorPolling() aborted due to stop.";
-          return;
-        }
-        
-        this->isNight = is_file_exist("/tmp/night_mode_enabled");
-        if (this->previous != this->isNight && !this->firstRun) {
-          this->previous = this->isNight;
-          this->sendNightData();
-        }
-        bool gpsDataAvailable = false;
+  void SensorService::onGPSReadable(const boost::system::error_code &error) {
+    if (error || !this->gpsEnabled_ || this->stopPolling.load(std::memory_order_acquire)) {
+      return;
+    }
+
+    // Drain what gpsd has sent: a fix is forwarded as soon as it arrives, and
+    // a burst of them shares one SensorBatch
+    auto &indication = *this->arena_.create<aap_protobuf::service::sensorsource::message::SensorBatch>();
+    int reads = 0;
+    do {
 #if GPSD_API_MAJOR_VERSION >= 7
-        if (gps_read (&this->gpsData_, NULL, 0) != -1) {
-          gpsDataAvailable = true;
-        }
+      const int result = gps_read(&this->gpsData_, NULL, 0);
 #else
-        if (gps_read (&this->gpsData_) != -1) {
-                    gpsDataAvailable = true;
-                }
+      const int result = gps_read(&this->gpsData_);
 #endif
-        if ((this->gpsEnabled_) &&
-            (gps_waiting(&this->gpsData_, 0)) &&
-            (gpsDataAvailable == true) &&
-            (this->gpsData_.fix.mode == MODE_2D || this->gpsData_.fix.mode == MODE_3D) &&
-            (this->gpsData_.set & TIME_SET) &&
-            (this->gpsData_.set & LATLON_SET))
-        {
-          this->sendGPSLocationData();
-        }
+      if (result == -1) {
+        OPENAUTO_LOG(warning) << "[SensorService] Lost the GPSD connection.";
+        this->closeGPS();
+        break;
+      }
+      this->addGPSLocation(indication);
+    } while (++reads < cMaxFixesPerBatch && gps_waiting(&this->gpsData_, 0));
 
-        // Final check before rescheduling to prevent race with stop()
-        if (!this->stopPolling.load(std::memory_order_acquire)) {
-          timer_.expires_from_now(boost::posix_time::milliseconds(250));
-          timer_.async_wait(strand_.wrap(std::bind(&SensorService::sensorPolling, this->shared_from_this())));
-        } else {
-          OPENAUTO_LOG(info) << "[SensorService] sensorPolling() stopped, timer not rescheduled.";
-        }
-      });
+    if (indication.location_data_size() > 0) {
+      auto promise = aasdk::channel::SendPromise::defer(strand_);
+      promise->then([]() {},
+                    std::bind(&SensorService::onChannelError, this->shared_from_this(), std::placeholders::_1));
+      channel_->sendSensorEventIndication(indication, std::move(promise));
+      if (this->nightFromGps_) {
+        this->onSunPosition(this->gpsData_.fix.latitude, this->gpsData_.fix.longitude);
+      }
+    }
+    // Serialized by the send
+    this->arena_.reset();
+
+    // Whatever libgps already buffered will not make the socket readable again
+    if (this->gpsEnabled_ && gps_waiting(&this->gpsData_, 0)) {
+      strand_.post(monitored(
+          OPENAUTO_STRAND_SITE("sensor.gps"),
+          std::bind(&SensorService::onGPSReadable, this->shared_from_this(), boost::system::error_code())));
+    } else {
+      this->waitForGPS();
+    }
+  }
+
+  void SensorService::closeGPS() {
+    if (!this->gpsEnabled_) {
+      return;
+    }
+    boost::system::error_code ec;
+    this->gpsDescriptor_.cancel(ec);
+    this->gpsDescriptor_.release();
+    gps_stream(&this->gpsData_, WATCH_DISABLE, NULL);
+    gps_close(&this->gpsData_);
+    this->gpsEnabled_ = false;
+  }
+
+  void SensorService::onSunPosition(double latitude, double longitude) {
+    this->sunLatitude_ = latitude;
+    this->sunLongitude_ = longitude;
+    if (this->sunSchedule_.update(latitude, longitude, std::time(nullptr))) {
+      this->scheduleSun();
+    }
+  }
+
+  void SensorService::scheduleSun() {
+    const std::time_t now = std::time(nullptr);
+    const bool night = this->sunSchedule_.night(now);
+    // The flag change comes back through onNightModeChanged to the phone
+    auto &stateBus = StateBus::instance();
+    if (stateBus.isSet(StateFlag::NightMode) != night) {
+      OPENAUTO_LOG(info) << "[SensorService] Civil twilight: " << (night ? "night" : "day") << " mode";
+      if (night) {
+        stateBus.set(StateFlag::NightMode);
+      } else {
+        stateBus.clear(StateFlag::NightMode);
+      }
+    }
+
+    // A second past it, so the wakeup never lands just before the transition
+    const std::time_t next = this->sunSchedule_.nextTransition(now);
+    this->sunTimer_.expires_from_now(next != 0 ? std::chrono::seconds(next - now + 1)
+                                               : std::chrono::hours(cSunRecheckHours));
+    this->sunTimer_.async_wait(strand_.wrap(monitoredCompletion(
+        OPENAUTO_STRAND_SITE("sensor.sun_timer"),
+        [this, self = this->shared_from_this()](const boost::system::error_code &error) {
+          if (error == boost::asio::error::operation_aborted || this->stopPolling.load(std::memory_order_acquire)) {
+            return;
+          }
+          // The new day's transitions come from the last position, GPS or not
+          this->sunSchedule_.update(this->sunLatitude_, this->sunLongitude_, std::time(nullptr));
+          this->scheduleSun();
+        })));
+  }
+
+  bool SensorService::toVehicleSensor(aap_protobuf::service::sensorsource::message::SensorType type, VehicleSensor &sensor) {
+    switch (type) {
+      case aap_protobuf::service::sensorsource::message::SENSOR_SPEED:
+        sensor = VehicleSensor::Speed;
+        return true;
+      case aap_protobuf::service::sensorsource::message::SENSOR_GEAR:
+        sensor = VehicleSensor::Gear;
+        return true;
+      case aap_protobuf::service::sensorsource::message::SENSOR_PARKING_BRAKE:
+        sensor = VehicleSensor::ParkingBrake;
+        return true;
+      case aap_protobuf::service::sensorsource::message::SENSOR_FUEL:
+        sensor = VehicleSensor::Fuel;
+        return true;
+      case aap_protobuf::service::sensorsource::message::SENSOR_COMPASS:
+        sensor = VehicleSensor::Compass;
+        return true;
+      case aap_protobuf::service::sensorsource::message::SENSOR_ACCELEROMETER_DATA:
+        sensor = VehicleSensor::Accelerometer;
+        return true;
+      case aap_protobuf::service::sensorsource::message::SENSOR_GYROSCOPE_DATA:
+        sensor = VehicleSensor::Gyroscope;
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  void SensorService::addVehicleReading(aap_protobuf::service::sensorsource::message::SensorBatch &batch,
+                                        const VehicleReading &reading) {
+    const auto &v = reading.values;
+    switch (reading.sensor) {
+      case VehicleSensor::Speed:
+        batch.add_speed_data()->set_speed_e3(v[0]);
+        break;
+      case VehicleSensor::Gear:
+        batch.add_gear_data()->set_gear(static_cast<aap_protobuf::service::sensorsource::message::Gear>(v[0]));
+        break;
+      case VehicleSensor::ParkingBrake:
+        batch.add_parking_brake_data()->set_parking_brake(v[0] != 0);
+        break;
+      case VehicleSensor::Fuel: {
+        auto *fuel = batch.add_fuel_data();
+        fuel->set_fuel_level(v[0]);
+        fuel->set_low_fuel_warning(v[1] != 0);
+        break;
+      }
+      case VehicleSensor::Compass:
+        batch.add_compass_data()->set_bearing_e6(v[0]);
+        break;
+      case VehicleSensor::Accelerometer: {
+        auto *accel = batch.add_accelerometer_data();
+        accel->set_acceleration_x_e3(v[0]);
+        accel->set_acceleration_y_e3(v[1]);
+        accel->set_acceleration_z_e3(v[2]);
+        break;
+      }
+      case VehicleSensor::Gyroscope: {
+        auto *gyro = batch.add_gyroscope_data();
+        gyro->set_rotation_speed_x_e3(v[0]);
+        gyro->set_rotation_speed_y_e3(v[1]);
+        gyro->set_rotation_speed_z_e3(v[2]);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  void SensorService::onVehicleReading(const VehicleReading &reading) {
+    if (this->stopPolling.load(std::memory_order_acquire)) {
+      return;
+    }
+
+    switch (reading.sensor) {
+      case VehicleSensor::Speed:
+        this->speedE3_ = reading.values[0];
+        break;
+      case VehicleSensor::Gear:
+        this->inPark_ = reading.values[0] == aap_protobuf::service::sensorsource::message::GEAR_PARK;
+        break;
+      case VehicleSensor::ParkingBrake:
+        this->parkingBrake_ = reading.values[0] != 0;
+        break;
+      default:
+        break;
+    }
+    const bool moving = this->speedE3_ >= cMovingSpeedE3 && !this->inPark_ && !this->parkingBrake_;
+    if (moving != this->moving_) {
+      this->moving_ = moving;
+      if (this->restrictWhileMoving_ && this->drivingStatusRequested_) {
+        this->sendDrivingStatus();
+      }
     }
+
+    this->rateLimiter_.offer(reading, SensorRateLimiter::Clock::now());
+    this->flushVehicleReadings();
   }
 
-  bool SensorService::is_file_exist(const char *fileName) {
-    OPENAUTO_LOG(info) << "[SensorService] is_file_exist()";
-    std::ifstream ifile(fileName, std::ios::in);
-    return ifile.good();
+  void SensorService::flushVehicleReadings() {
+    if (this->stopPolling.load(std::memory_order_acquire)) {
+      return;
+    }
+
+    const auto now = SensorRateLimiter::Clock::now();
+    const auto due = this->rateLimiter_.collect(now);
+    if (!due.empty()) {
+      auto &indication = *this->arena_.create<aap_protobuf::service::sensorsource::message::SensorBatch>();
+      for (const auto &reading : due) {
+        addVehicleReading(indication, reading);
+      }
+      auto promise = aasdk::channel::SendPromise::defer(strand_);
+      promise->then([]() {},
+                    std::bind(&SensorService::onChannelError, this->shared_from_this(), std::placeholders::_1));
+      channel_->sendSensorEventIndication(indication, std::move(promise));
+      this->arena_.reset();
+    }
+
+    // Held readings wait out their sensor's period on one timer, armed only
+    // while something is pending
+    const auto next = this->rateLimiter_.nextDue();
+    if (next == SensorRateLimiter::Clock::time_point::max() || next >= this->flushAt_) {
+      return;
+    }
+    this->flushAt_ = next;
+    this->flushTimer_.expires_at(std::max(next, now));
+    this->flushTimer_.async_wait(strand_.wrap(monitoredCompletion(
+        OPENAUTO_STRAND_SITE("sensor.flush_timer"),
+        [this, self = this->shared_from_this()](const boost::system::error_code &error) {
+          // Aborted only when re-armed earlier, and that wait is still pending
+          if (error != boost::asio::error::operation_aborted) {
+            this->flushAt_ = SensorRateLimiter::Clock::time_point::max();
+            this->flushVehicleReadings();
+          }
+        })));
+  }
+
+  void SensorService::onNightModeChanged(bool night) {
+    if (this->stopPolling.load(std::memory_order_acquire)) {
+      return;
+    }
+    this->isNight = night;
+    if (this->previous != this->isNight && !this->firstRun) {
+      this->previous = this->isNight;
+      this->sendNightData();
+    }
   }
 
   void SensorService::onChannelError(const aasdk::error::Error &e) {
@@ -0,0 +1,113 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <f1x/openauto/autoapp/Service/Sensor/SunSchedule.hpp>
+
+namespace f1x::openauto::autoapp::service::sensor {
+
+  namespace {
+    constexpr double cPi = 3.14159265358979323846;
+    constexpr double cUnixEpochJulian = 2440587.5;
+    constexpr double cJ2000 = 2451545.0;
+
+    double radians(double degrees) { return degrees * cPi / 180.0; }
+    double degrees(double radians) { return radians * 180.0 / cPi; }
+  }
+
+  bool SunSchedule::update(double latitude, double longitude, std::time_t now) {
+    const long day = solarDay(longitude, now);
+    if (hasPosition_ && day == day_ && distanceKm(latitude_, longitude_, latitude, longitude) <= cRecomputeKm) {
+      return false;
+    }
+    hasPosition_ = true;
+    latitude_ = latitude;
+    longitude_ = longitude;
+    day_ = day;
+
+    transitions_.clear();
+    for (long d = day - 1; d <= day + 1; d++) {
+      std::time_t dawn = 0;
+      std::time_t dusk = 0;
+      bool alwaysNight = false;
+      if (twilight(d, latitude, longitude, dawn, dusk, alwaysNight)) {
+        transitions_.push_back({dawn, false});
+        transitions_.push_back({dusk, true});
+      } else if (d == day) {
+        alwaysNight_ = alwaysNight;
+      }
+    }
+    std::sort(transitions_.begin(), transitions_.end(),
+              [](const Transition &a, const Transition &b) { return a.at < b.at; });
+    return true;
+  }
+
+  bool SunSchedule::night(std::time_t now) const {
+    const auto next = std::upper_bound(transitions_.begin(), transitions_.end(), now,
+                                       [](std::time_t at, const Transition &t) { return at < t.at; });
+    if (next != transitions_.begin()) {
+      return std::prev(next)->night;
+    }
+    // Before the first one: the opposite of what it brings
+    return next != transitions_.end() ? !next->night : alwaysNight_;
+  }
+
+  std::time_t SunSchedule::nextTransition(std::time_t now) const {
+    const auto next = std::upper_bound(transitions_.begin(), transitions_.end(), now,
+                                       [](std::time_t at, const Transition &t) { return at < t.at; });
+    return next != transitions_.end() && next->at - now <= 24 * 3600 ? next->at : 0;
+  }
+
+  bool SunSchedule::twilight(long day, double latitude, double longitude, std::time_t &dawn, std::time_t &dusk,
+                             bool &alwaysNight) {
+    // The sunrise equation, to about a minute away from the poles; east positive
+    const double noon = cUnixEpochJulian + day + 0.5 - longitude / 360.0 - cJ2000;
+    const double anomaly = std::fmod(357.5291 + 0.98560028 * noon, 360.0);
+    const double m = radians(anomaly);
+    const double center = 1.9148 * std::sin(m) + 0.0200 * std::sin(2 * m) + 0.0003 * std::sin(3 * m);
+    const double ecliptic = radians(std::fmod(anomaly + center + 180.0 + 102.9372, 360.0));
+    const double transit = noon + 0.0053 * std::sin(m) - 0.0069 * std::sin(2 * ecliptic);
+    const double declination = std::asin(std::sin(ecliptic) * std::sin(radians(23.4397)));
+
+    const double phi = radians(latitude);
+    const double cosHourAngle = (std::sin(radians(cTwilightDegrees)) - std::sin(phi) * std::sin(declination)) /
+                                (std::cos(phi) * std::cos(declination));
+    if (!(std::fabs(cosHourAngle) <= 1.0)) {
+      alwaysNight = !(cosHourAngle < -1.0);
+      return false;
+    }
+    const double halfDay = degrees(std::acos(cosHourAngle)) / 360.0;
+    dawn = static_cast<std::time_t>(std::llround((transit - halfDay + cJ2000 - cUnixEpochJulian) * 86400.0));
+    dusk = static_cast<std::time_t>(std::llround((transit + halfDay + cJ2000 - cUnixEpochJulian) * 86400.0));
+    return true;
+  }
+
+  long SunSchedule::solarDay(double longitude, std::time_t now) {
+    return static_cast<long>(std::floor(now / 86400.0 + longitude / 360.0));
+  }
+
+  double SunSchedule::distanceKm(double latitudeA, double longitudeA, double latitudeB, double longitudeB) {
+    const double dLat = radians(latitudeB - latitudeA);
+    const double dLon = radians(longitudeB - longitudeA);
+    const double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
+                     std::cos(radians(latitudeA)) * std::cos(radians(latitudeB)) * std::sin(dLon / 2) * std::sin(dLon / 2);
+    return 6371.0 * 2 * std::atan2(std::sqrt(a), std::sqrt(1 - a));
+  }
+
+}
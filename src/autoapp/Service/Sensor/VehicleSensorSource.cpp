@@ -0,0 +1,129 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <f1x/openauto/autoapp/Service/Sensor/VehicleSensorSource.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x::openauto::autoapp::service::sensor {
+
+  const char *vehicleSensorName(VehicleSensor sensor) {
+    switch (sensor) {
+      case VehicleSensor::Speed:
+        return "speed";
+      case VehicleSensor::Gear:
+        return "gear";
+      case VehicleSensor::ParkingBrake:
+        return "parkingbrake";
+      case VehicleSensor::Fuel:
+        return "fuel";
+      case VehicleSensor::Compass:
+        return "compass";
+      case VehicleSensor::Accelerometer:
+        return "accelerometer";
+      case VehicleSensor::Gyroscope:
+        return "gyroscope";
+      default:
+        return "unknown";
+    }
+  }
+
+  VehicleSensorSource::VehicleSensorSource(std::string threadName)
+      : threadName_(std::move(threadName)), wakeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), stopping_(false) {
+  }
+
+  VehicleSensorSource::~VehicleSensorSource() {
+    if (wakeFd_ >= 0) {
+      close(wakeFd_);
+    }
+  }
+
+  void VehicleSensorSource::start(ReadingHandler handler) {
+    if (thread_.joinable()) {
+      return;
+    }
+    handler_ = std::move(handler);
+    hasPublished_.fill(false);
+    stopping_ = false;
+    thread_ = std::thread([this]() {
+      pthread_setname_np(pthread_self(), threadName_.substr(0, 15).c_str());
+      this->run();
+    });
+  }
+
+  void VehicleSensorSource::stop() {
+    if (!thread_.joinable()) {
+      return;
+    }
+    stopping_ = true;
+    const uint64_t one = 1;
+    (void)write(wakeFd_, &one, sizeof(one));
+    thread_.join();
+
+    uint64_t count;
+    (void)read(wakeFd_, &count, sizeof(count));
+    handler_ = nullptr;
+  }
+
+  bool VehicleSensorSource::stopping() const {
+    return stopping_;
+  }
+
+  VehicleSensorSource::WaitResult VehicleSensorSource::wait(int fd, int timeoutMs) {
+    pollfd fds[2] = {{wakeFd_, POLLIN, 0}, {fd, POLLIN, 0}};
+    const nfds_t count = fd >= 0 ? 2 : 1;
+    while (!stopping_) {
+      const int ready = poll(fds, count, timeoutMs);
+      if (ready < 0 && errno == EINTR) {
+        continue;
+      }
+      if (ready < 0) {
+        OPENAUTO_LOG(error) << "[VehicleSensorSource] poll failed: " << std::strerror(errno);
+        return WaitResult::Stopped;
+      }
+      if (ready == 0) {
+        return WaitResult::Timeout;
+      }
+      if (count == 2 && fds[1].revents != 0) {
+        return WaitResult::Readable;
+      }
+    }
+    return WaitResult::Stopped;
+  }
+
+  void VehicleSensorSource::publish(const VehicleReading &reading) {
+    const size_t index = static_cast<size_t>(reading.sensor);
+    if (index >= published_.size()) {
+      return;
+    }
+    if (hasPublished_[index] && published_[index].values == reading.values) {
+      return;
+    }
+    published_[index] = reading;
+    hasPublished_[index] = true;
+    if (handler_) {
+      handler_(reading);
+    }
+  }
+
+}
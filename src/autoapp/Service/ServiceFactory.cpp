@@ -17,13 +17,17 @@
 */
 
 #include <QApplication>
+#include <QDir>
 #include <QScreen>
+#include <QStandardPaths>
 
 #include <aasdk/Channel/MediaSink/Audio/Channel/GuidanceAudioChannel.hpp>
 #include <aasdk/Channel/MediaSink/Audio/Channel/MediaAudioChannel.hpp>
 #include <aasdk/Channel/MediaSink/Audio/Channel/SystemAudioChannel.hpp>
 #include <aasdk/Channel/MediaSink/Audio/Channel/TelephonyAudioChannel.hpp>
 
+#include <f1x/openauto/autoapp/Configuration/PhoneProfilesList.hpp>
+#include <f1x/openauto/autoapp/Service/DeferredService.hpp>
 #include <f1x/openauto/autoapp/Service/ServiceFactory.hpp>
 
 #include <f1x/openauto/autoapp/Service/MediaSink/GuidanceAudioService.hpp>
@@ -34,39 +38,134 @@
 
 #include <f1x/openauto/autoapp/Service/MediaSource/MicrophoneMediaSourceService.hpp>
 
+#include <f1x/openauto/autoapp/Projection/AacAudioOutput.hpp>
 #include <f1x/openauto/autoapp/Projection/OMXVideoOutput.hpp>
 #include <f1x/openauto/autoapp/Projection/QtVideoOutput.hpp>
 #include <f1x/openauto/autoapp/Projection/RtAudioInput.hpp>
 
 #include <f1x/openauto/autoapp/Service/Bluetooth/BluetoothService.hpp>
 #include <f1x/openauto/autoapp/Service/InputSource/InputSourceService.hpp>
+#include <f1x/openauto/autoapp/Service/MediaPlaybackStatus/MediaPlaybackStatusService.hpp>
+#include <f1x/openauto/autoapp/Service/NavigationStatus/NavigationStatusService.hpp>
+#include <f1x/openauto/autoapp/Service/Radio/RadioService.hpp>
+#include <f1x/openauto/autoapp/Service/Radio/StationScanner.hpp>
+#include <f1x/openauto/autoapp/Service/Radio/V4l2RadioTuner.hpp>
+#include <f1x/openauto/autoapp/Service/Sensor/CanSensorSource.hpp>
+#include <f1x/openauto/autoapp/Service/Sensor/IioSensorSource.hpp>
+#include <f1x/openauto/autoapp/Service/Sensor/ObdSensorSource.hpp>
 #include <f1x/openauto/autoapp/Service/Sensor/SensorService.hpp>
 #include <f1x/openauto/autoapp/Service/WifiProjection/WifiProjectionService.hpp>
 #ifdef USE_FFMPEG_DRM
 #include <f1x/openauto/autoapp/Projection/FFmpegDrmVideoOutput.hpp>
 #endif
+#ifdef USE_GSTREAMER
+#include <f1x/openauto/autoapp/Projection/GstVideoOutput.hpp>
+#endif
 #include <f1x/openauto/autoapp/Projection/AudioDeviceList.hpp>
+#include <f1x/openauto/autoapp/Projection/AudioMixer.hpp>
 #include <f1x/openauto/autoapp/Projection/DummyBluetoothDevice.hpp>
+#include <f1x/openauto/autoapp/Projection/DuplexAudioStream.hpp>
 #include <f1x/openauto/autoapp/Projection/InputDevice.hpp>
 #include <f1x/openauto/autoapp/Projection/LocalBluetoothDevice.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDsp.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDump.hpp>
 #include <f1x/openauto/autoapp/Projection/RtAudioOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoBackendProbe.hpp>
+#include <f1x/openauto/autoapp/Projection/VoiceProcessingStage.hpp>
+#include <ctime>
 
 namespace f1x::openauto::autoapp::service {
 
+namespace {
+
+projection::MediaDspSettings
+mediaDspSettings(const configuration::IConfiguration &configuration) {
+  projection::MediaDspSettings settings;
+  settings.enabled = configuration.getAudioDspEnabled();
+  if (!projection::MediaDspSettings::parseEqGains(
+          configuration.getAudioEqualizerGains(), settings.eqGainsDb)) {
+    OPENAUTO_LOG(warning) << "[ServiceFactory] AudioEqualizerGains needs "
+                          << projection::MediaDspSettings::cEqBands
+                          << " gains in dB, EQ left flat";
+  }
+  settings.loudnessPercent = configuration.getAudioLoudnessPercent();
+  settings.cpuBudgetPercent = configuration.getAudioDspCpuBudgetPercent();
+  return settings;
+}
+
+} // namespace
+
 ServiceFactory::ServiceFactory(
-    boost::asio::io_service &ioService,
+    boost::asio::io_service &ioService, boost::asio::io_service &mediaIoService,
     configuration::IConfiguration::Pointer configuration)
-    : ioService_(ioService), configuration_(std::move(configuration)) {}
+    : ioService_(ioService), mediaIoService_(mediaIoService),
+      configuration_(std::move(configuration)) {
+  QScreen *screen = QGuiApplication::primaryScreen();
+  const QSize screenSize =
+      screen == nullptr ? QSize(1, 1) : screen->geometry().size();
+  videoModeSelector_ = std::make_shared<projection::VideoModeSelector>(
+      configuration_, screenSize);
+  auto phoneProfiles = std::make_shared<configuration::PhoneProfilesList>(16);
+  phoneProfiles->read();
+  videoModeSelector_->setPhoneProfiles(std::move(phoneProfiles));
+
+  // Every media stream follows this one preset, so EQ changes from the
+  // settings pages are heard at the next period
+  mediaDsp_ = std::make_shared<projection::MediaDspPreset>(
+      mediaDspSettings(*configuration_));
+  std::weak_ptr<projection::MediaDspPreset> preset = mediaDsp_;
+  auto *config = configuration_.get();
+  dspSubscription_ = configuration_->subscribe([preset, config]() {
+    if (auto current = preset.lock()) {
+      current->set(mediaDspSettings(*config));
+    }
+  });
+}
+
+ServiceFactory::~ServiceFactory() {
+  if (mixerSubscription_ != 0) {
+    configuration_->unsubscribe(mixerSubscription_);
+  }
+  configuration_->unsubscribe(dspSubscription_);
+}
 
 ServiceList
 ServiceFactory::create(aasdk::messenger::IMessenger::Pointer messenger) {
   OPENAUTO_LOG(info) << "[ServiceFactory] create()";
   ServiceList serviceList;
 
-  this->createMediaSinkServices(serviceList, messenger);
-  this->createMediaSourceServices(serviceList, messenger);
-  serviceList.emplace_back(this->createSensorService(messenger));
+  // Critical: what the first frame, first touch and main audio depend on
+  auto recorder = this->createSessionRecorder();
+  this->createMediaSinkServices(serviceList, messenger, recorder);
   serviceList.emplace_back(this->createInputService(messenger));
+
+  // Deferred: built off the connection's critical path (see DeferredService)
+  auto defer = [&](const char *name, DeferredService::Factory factory) {
+    serviceList.emplace_back(
+        std::make_shared<DeferredService>(ioService_, name, std::move(factory)));
+  };
+  if (configuration_->guidanceAudioChannelEnabled()) {
+    defer("guidance audio", [this, messenger, recorder]() {
+      return this->createGuidanceAudioService(messenger, recorder);
+    });
+  }
+  defer("microphone", [this, messenger]() {
+    return this->createMicrophoneService(messenger);
+  });
+  defer("sensors", [this, messenger]() {
+    return this->createSensorService(messenger);
+  });
+  defer("navigation status", [this, messenger]() {
+    return this->createNavigationStatusService(messenger);
+  });
+  defer("media playback status", [this, messenger]() {
+    return this->createMediaPlaybackStatusService(messenger);
+  });
+  if (!configuration_->getRadioDevice().empty()) {
+    defer("radio", [this, messenger]() {
+      return this->createRadioService(messenger);
+    });
+  }
   if (configuration_->getWirelessProjectionEnabled()) {
     // TODO: What is WiFi Projection Service?
     /*
@@ -75,7 +174,9 @@ ServiceFactory::create(aasdk::messenger::IMessenger::Pointer messenger) {
      * legitimate service, then it seems clear it is not what we think it
      * actually is.
      */
-    serviceList.emplace_back(this->createBluetoothService(messenger));
+    defer("bluetooth", [this, messenger]() {
+      return this->createBluetoothService(messenger);
+    });
     // serviceList.emplace_back(this->createWifiProjectionService(messenger));
   }
 
@@ -103,79 +204,162 @@ IService::Pointer ServiceFactory::createBluetoothService(
 IService::Pointer ServiceFactory::createInputService(
     aasdk::messenger::IMessenger::Pointer messenger) {
   OPENAUTO_LOG(info) << "[ServiceFactory] createInputService()";
-  QRect videoGeometry;
-  switch (configuration_->getVideoResolution()) {
-  case aap_protobuf::service::media::sink::message::VideoCodecResolutionType::
-      VIDEO_1280x720:
-    OPENAUTO_LOG(info) << "[ServiceFactory] Resolution 1280x720";
-    videoGeometry = QRect(0, 0, 1280, 720);
-    break;
-  case aap_protobuf::service::media::sink::message::VideoCodecResolutionType::
-      VIDEO_1920x1080:
-    OPENAUTO_LOG(info) << "[ServiceFactory] Resolution 1920x1080";
-    videoGeometry = QRect(0, 0, 1920, 1080);
-    break;
-  default:
-    OPENAUTO_LOG(info) << "[ServiceFactory] Resolution 800x480";
-    videoGeometry = QRect(0, 0, 800, 480);
-    break;
-  }
 
-  QScreen *screen = QGuiApplication::primaryScreen();
-  QRect screenGeometry =
-      screen == nullptr ? QRect(0, 0, 1, 1) : screen->geometry();
+  // Same mode the video channel will request, so touches follow the picture
+  const auto geometry = videoModeSelector_->selectedGeometry();
+  OPENAUTO_LOG(info) << "[ServiceFactory] Touch mapped to "
+                     << geometry.videoSize().width() << "x"
+                     << geometry.videoSize().height();
+
   projection::IInputDevice::Pointer inputDevice(
-      std::make_shared<projection::InputDevice>(
-          *QApplication::instance(), configuration_, std::move(screenGeometry),
-          std::move(videoGeometry)));
+      std::make_shared<projection::InputDevice>(*QApplication::instance(),
+                                                configuration_, geometry));
+
+  // Negative means one frame of the requested mode: the phone cannot show
+  // touch feedback any faster than that
+  const auto coalesceMs = configuration_->getTouchCoalesceMs();
+  const auto coalesceWindow =
+      coalesceMs < 0
+          ? std::chrono::microseconds(projection::VideoModeSelector::frameIntervalUs(
+                videoModeSelector_->modes().at(videoModeSelector_->selectedIndex())))
+          : std::chrono::microseconds(std::chrono::milliseconds(coalesceMs));
+
+  // Zero leaves drags where the finger is; negative follows the measured latency
+  const auto predictionMs = configuration_->getTouchPredictionMs();
+  const auto prediction =
+      predictionMs < 0 ? std::chrono::microseconds(-1)
+                       : std::chrono::microseconds(std::chrono::milliseconds(predictionMs));
 
   return std::make_shared<inputsource::InputSourceService>(
-      ioService_, messenger, std::move(inputDevice));
+      mediaIoService_, messenger, std::move(inputDevice), coalesceWindow,
+      prediction);
+}
+
+projection::MediaDumpWriter::Pointer ServiceFactory::createSessionRecorder() {
+  const auto directory = configuration_->getSessionRecordingPath();
+  if (directory.empty()) {
+    return nullptr;
+  }
+
+  QDir().mkpath(QString::fromStdString(directory));
+  char name[64];
+  const std::time_t now = std::time(nullptr);
+  std::strftime(name, sizeof(name), "session-%Y%m%d-%H%M%S.oamd",
+                std::localtime(&now));
+
+  // Shared by every media sink of this session; the file is finished once
+  // the last of them is gone
+  auto recorder =
+      std::make_shared<projection::MediaDumpWriter>(directory + "/" + name);
+  return recorder->isOpen() ? recorder : nullptr;
 }
 
 void ServiceFactory::createMediaSinkServices(
-    ServiceList &serviceList, aasdk::messenger::IMessenger::Pointer messenger) {
+    ServiceList &serviceList, aasdk::messenger::IMessenger::Pointer messenger,
+    projection::MediaDumpWriter::Pointer recorder) {
   OPENAUTO_LOG(info) << "[ServiceFactory] createMediaSinkServices()";
 
-  // Get configured audio output device ID
+  // Get configured audio output device ID; the deferred guidance channel
+  // reuses it rather than probing the devices again
   std::string configuredDeviceName = configuration_->getAudioOutputDeviceName();
-  uint32_t audioDeviceId =
+  audioDeviceId_ =
       projection::AudioDeviceList::findOutputDeviceByName(configuredDeviceName);
 
   OPENAUTO_LOG(info) << "[ServiceFactory] Using audio device: "
                      << (configuredDeviceName.empty() ? "(default)"
                                                       : configuredDeviceName)
-                     << " (ID: " << audioDeviceId << ")";
+                     << " (ID: " << audioDeviceId_ << ")";
+  projection::AudioDeviceInfo deviceInfo;
+  const bool deviceKnown =
+      projection::AudioDeviceList::findDevice(audioDeviceId_, deviceInfo);
+  if (deviceKnown && !deviceInfo.sampleRates.empty() &&
+      !deviceInfo.supportsSampleRate(48000)) {
+    OPENAUTO_LOG(warning) << "[ServiceFactory] " << deviceInfo.name
+                          << " has no native 48 kHz mode, ALSA will resample";
+  }
+
+  // Guidance and system audio may be 16 or 48 kHz on the link. Ask for the
+  // rate the device (or the mixer's 48 kHz stream, if the device plays that)
+  // takes as is; otherwise 16 kHz, and the mixer's resampler converts it once
+  const std::vector<uint32_t> promptRates =
+      configuration_->getAudioMixerEnabled()
+          ? std::vector<uint32_t>{projection::AudioMixer::cSampleRate}
+          : std::vector<uint32_t>{48000, 16000};
+  promptSampleRate_ = deviceKnown ? deviceInfo.nativeSampleRate(promptRates, 16000) : 16000;
+  OPENAUTO_LOG(info) << "[ServiceFactory] Guidance and system audio at "
+                     << promptSampleRate_ << " Hz";
+
+  // One mixed device stream for all channels, or one RtAudioOutput each
+  if (configuration_->getAudioMixerEnabled() &&
+      (!audioMixer_ || audioMixer_->getDeviceId() != audioDeviceId_)) {
+    // Unmixed outputs kept from earlier connections would hold the device
+    audioOutputs_.releaseIdle();
+    auto mixer = std::make_shared<projection::AudioMixer>(
+        audioDeviceId_, configuration_->getAudioLowLatency(),
+        configuration_->getAudioDuckingPercent());
+    mixer->setMediaDsp(mediaDsp_);
+    {
+      std::lock_guard<std::mutex> lock(mixerMutex_);
+      audioMixer_ = std::move(mixer);
+    }
+
+    // Runs on the thread that saved the settings: only the mixer's atomic
+    // gain is touched, and the raw pointer cannot outlive the subscription
+    if (mixerSubscription_ != 0) {
+      configuration_->unsubscribe(mixerSubscription_);
+    }
+    std::weak_ptr<projection::AudioMixer> mixer = audioMixer_;
+    auto *configuration = configuration_.get();
+    mixerSubscription_ = configuration_->subscribe([mixer, configuration]() {
+      if (auto current = mixer.lock()) {
+        current->setDuckingPercent(configuration->getAudioDuckingPercent());
+      }
+    });
+  }
 
   if (configuration_->musicAudioChannelEnabled()) {
     OPENAUTO_LOG(info) << "[ServiceFactory] Media Audio Channel enabled";
-    auto mediaAudioOutput = std::make_shared<projection::RtAudioOutput>(
-        2, 16, 48000, audioDeviceId);
-
-    serviceList.emplace_back(std::make_shared<mediasink::MediaAudioService>(
-        ioService_, messenger, std::move(mediaAudioOutput)));
+    auto mediaAudioOutput =
+        this->createAudioOutput(projection::AudioMixerRole::Media, 2, 48000);
+    // AAC-LC is a tenth of the PCM bitrate on the link and through the Cryptor
+    const bool mediaAac = configuration_->getAudioMediaAac() && projection::AacAudioOutput::isSupported();
+    if (mediaAac) {
+      mediaAudioOutput = std::make_shared<projection::AacAudioOutput>(std::move(mediaAudioOutput));
+    } else if (configuration_->getAudioMediaAac()) {
+      OPENAUTO_LOG(warning) << "[ServiceFactory] AAC media audio needs an FFmpeg build, using PCM";
+    }
+
+    auto mediaAudioService = std::make_shared<mediasink::MediaAudioService>(
+        mediaIoService_, messenger, std::move(mediaAudioOutput));
+    if (mediaAac) {
+      mediaAudioService->setCodec(aap_protobuf::service::media::shared::message::MediaCodecType::MEDIA_CODEC_AUDIO_AAC_LC);
+    }
+    mediaAudioService->setAckBatch(configuration_->getAudioAckBatch());
+    mediaAudioService->setRecorder(recorder);
+    serviceList.emplace_back(std::move(mediaAudioService));
   }
 
-  if (configuration_->guidanceAudioChannelEnabled()) {
-    OPENAUTO_LOG(info) << "[ServiceFactory] Guidance Audio Channel enabled";
-    auto guidanceAudioOutput = std::make_shared<projection::RtAudioOutput>(
-        1, 16, 16000, audioDeviceId);
-
-    serviceList.emplace_back(std::make_shared<mediasink::GuidanceAudioService>(
-        ioService_, messenger, std::move(guidanceAudioOutput)));
+  if (configuration_->telephonyAudioChannelEnabled()) {
+    // Calls and the microphone share one 10 ms duplex stream, kept across
+    // connections like the mixer; rebuilt when either device changes
+    const uint32_t inputDeviceId = projection::AudioDeviceList::findInputDeviceByName(
+        configuration_->getAudioInputDeviceName());
+    if (!duplexStream_ || duplexStream_->getOutputDeviceId() != audioDeviceId_ ||
+        duplexStream_->getInputDeviceId() != inputDeviceId) {
+      duplexStream_ = std::make_shared<projection::DuplexAudioStream>(
+          audioDeviceId_, inputDeviceId, configuration_->getAudioJitterBufferMs());
+    }
+
+    OPENAUTO_LOG(info) << "[ServiceFactory] Telephony Audio Channel enabled";
+    auto telephonyAudioService = std::make_shared<mediasink::TelephonyAudioService>(
+        mediaIoService_, messenger, duplexStream_->createOutput());
+    telephonyAudioService->setAckBatch(configuration_->getAudioAckBatch());
+    telephonyAudioService->setRecorder(recorder);
+    serviceList.emplace_back(std::move(telephonyAudioService));
+  } else {
+    duplexStream_.reset();
   }
 
-  /* TODO: This also causes a problem - suspect not actually enabled yet in AA,
-  or removed due to preference of Bluetooth. if
-  (configuration_->telephonyAudioChannelEnabled()) { OPENAUTO_LOG(info) <<
-  "[ServiceFactory] Telephony Audio Channel enabled"; auto telephonyAudioOutput
-  = std::make_shared<projection::RtAudioOutput>(1, 16, 16000, audioDeviceId);
-
-    serviceList.emplace_back(
-        std::make_shared<mediasink::TelephonyAudioService>(ioService_,
-  messenger, std::move(telephonyAudioOutput)));
-  }
-*/
   /*
    * No Need to Check for systemAudioChannelEnabled - MUST be enabled by
    * default.
@@ -183,48 +367,244 @@ void ServiceFactory::createMediaSinkServices(
 
   OPENAUTO_LOG(info) << "[ServiceFactory] System Audio Channel enabled";
   auto systemAudioOutput =
-      std::make_shared<projection::RtAudioOutput>(1, 16, 16000, audioDeviceId);
+      this->createAudioOutput(projection::AudioMixerRole::System, 1, promptSampleRate_);
+
+  auto systemAudioService = std::make_shared<mediasink::SystemAudioService>(
+      mediaIoService_, messenger, std::move(systemAudioOutput));
+  systemAudioService->setAckBatch(configuration_->getAudioAckBatch());
+  systemAudioService->setRecorder(recorder);
+  serviceList.emplace_back(std::move(systemAudioService));
+
+  auto videoOutput = createVideoOutput();
+
+  OPENAUTO_LOG(info) << "[ServiceFactory] Video Channel enabled";
+  auto videoService = std::make_shared<mediasink::VideoService>(
+      mediaIoService_, messenger, std::move(videoOutput), videoModeSelector_);
+  videoService->setRecorder(std::move(recorder));
+  serviceList.emplace_back(std::move(videoService));
+}
+
+projection::IAudioOutput::Pointer
+ServiceFactory::createAudioOutput(projection::AudioMixerRole role,
+                                  uint32_t channelCount, uint32_t sampleRate) {
+  const uint32_t jitterBufferMs = configuration_->getAudioJitterBufferMs();
+  if (configuration_->getAudioMixerEnabled() && audioMixer_) {
+    if (auto channel = audioMixer_->createChannel(role, channelCount,
+                                                  sampleRate, jitterBufferMs)) {
+      return channel;
+    }
+  }
+  // Prompts and clicks are short enough to lose their start to ALSA, and
+  // their streams are cheap to keep running through the session
+  const bool keepRunning = (role == projection::AudioMixerRole::Guidance ||
+                            role == projection::AudioMixerRole::System) &&
+                           configuration_->getAudioWarmStreams();
+  // Reconnects get the previous session's stream back, still open
+  auto output = audioOutputs_.acquire({channelCount, sampleRate, audioDeviceId_,
+                                       configuration_->getAudioLowLatency(),
+                                       jitterBufferMs, keepRunning});
+  if (role == projection::AudioMixerRole::Media ||
+      role == projection::AudioMixerRole::LocalMedia) {
+    output->setMediaDsp(mediaDsp_);
+  }
+  return output;
+}
+
+void ServiceFactory::onPhoneAudioFocus(
+    aap_protobuf::service::control::message::AudioFocusRequestType type) {
+  using aap_protobuf::service::control::message::AudioFocusRequestType;
+  // Lasting focus pauses the local player through PhoneMedia instead
+  auto focus = projection::LocalMediaFocus::Full;
+  if (type == AudioFocusRequestType::AUDIO_FOCUS_GAIN_TRANSIENT) {
+    focus = projection::LocalMediaFocus::Muted;
+  } else if (type == AudioFocusRequestType::AUDIO_FOCUS_GAIN_TRANSIENT_MAY_DUCK) {
+    focus = projection::LocalMediaFocus::Ducked;
+  }
+  std::lock_guard<std::mutex> lock(mixerMutex_);
+  if (audioMixer_) {
+    audioMixer_->setLocalMediaFocus(focus);
+  }
+}
 
-  serviceList.emplace_back(std::make_shared<mediasink::SystemAudioService>(
-      ioService_, messenger, std::move(systemAudioOutput)));
+void ServiceFactory::onPhoneIdentified(const std::string &phone) {
+  videoModeSelector_->beginSession(phone);
+}
 
-  // Video output backend selection (priority: FFMPEG_DRM > OMX > Qt)
+projection::AudioMixerChannel::Pointer
+ServiceFactory::createLocalPlaybackOutput() {
+  // Asked for by the local player's decode thread
+  std::lock_guard<std::mutex> lock(mixerMutex_);
+  if (!configuration_->getAudioMixerEnabled() || !audioMixer_) {
+    return nullptr;
+  }
+  return audioMixer_->createChannel(projection::AudioMixerRole::LocalMedia, 2,
+                                    projection::AudioMixer::cSampleRate,
+                                    configuration_->getAudioJitterBufferMs());
+}
+
+projection::IVideoOutput::Pointer ServiceFactory::createVideoOutput() {
+  // VideoBackendProbe chose among the compiled-in backends at startup
+  const auto backend = projection::VideoBackendProbe::configured(*configuration_);
+  switch (backend) {
 #ifdef USE_FFMPEG_DRM
-  OPENAUTO_LOG(info) << "[ServiceFactory] Using FFmpeg DRM hwaccel + DRM Prime "
-                        "video output (lowest latency)";
-  auto videoOutput(
-      std::make_shared<projection::FFmpegDrmVideoOutput>(configuration_));
-#elif defined(USE_OMX)
-  OPENAUTO_LOG(info) << "[ServiceFactory] Using OMX video output";
-  auto videoOutput(
-      std::make_shared<projection::OMXVideoOutput>(configuration_));
-#else
+  case projection::VideoBackend::V4l2Request:
+  case projection::VideoBackend::FFmpegDrm:
+    OPENAUTO_LOG(info) << "[ServiceFactory] Using "
+                       << (backend == projection::VideoBackend::V4l2Request
+                               ? "V4L2 request decoder"
+                               : "FFmpeg DRM hwaccel")
+                       << " + DRM Prime video output (lowest latency)";
+    if (!videoOutput_) {
+      auto drm =
+          std::make_shared<projection::FFmpegDrmVideoOutput>(configuration_);
+      drm->setNativeDecoder(backend == projection::VideoBackend::V4l2Request);
+      videoOutput_ = drm;
+    }
+    return videoOutput_;
+#endif
+#ifdef USE_GSTREAMER
+  case projection::VideoBackend::GStreamer:
+    OPENAUTO_LOG(info) << "[ServiceFactory] Using GStreamer appsrc video output";
+    return std::make_shared<projection::GstVideoOutput>(configuration_);
+#endif
+#ifdef USE_OMX
+  case projection::VideoBackend::Omx:
+    OPENAUTO_LOG(info) << "[ServiceFactory] Using OMX video output";
+    return std::make_shared<projection::OMXVideoOutput>(configuration_);
+#endif
+  default:
+    break;
+  }
+
   OPENAUTO_LOG(info) << "[ServiceFactory] Using Qt video output";
-  projection::IVideoOutput::Pointer videoOutput(
+  return projection::IVideoOutput::Pointer(
       new projection::QtVideoOutput(configuration_),
       std::bind(&QObject::deleteLater, std::placeholders::_1));
-#endif
+}
 
-  OPENAUTO_LOG(info) << "[ServiceFactory] Video Channel enabled";
-  serviceList.emplace_back(std::make_shared<mediasink::VideoService>(
-      ioService_, messenger, std::move(videoOutput)));
+IService::Pointer ServiceFactory::createGuidanceAudioService(
+    aasdk::messenger::IMessenger::Pointer messenger,
+    projection::MediaDumpWriter::Pointer recorder) {
+  OPENAUTO_LOG(info) << "[ServiceFactory] Guidance Audio Channel enabled";
+  auto guidanceAudioOutput =
+      this->createAudioOutput(projection::AudioMixerRole::Guidance, 1, promptSampleRate_);
+
+  auto guidanceAudioService = std::make_shared<mediasink::GuidanceAudioService>(
+      mediaIoService_, messenger, std::move(guidanceAudioOutput));
+  guidanceAudioService->setAckBatch(configuration_->getAudioAckBatch());
+  guidanceAudioService->setRecorder(std::move(recorder));
+  return guidanceAudioService;
 }
 
-void ServiceFactory::createMediaSourceServices(
-    f1x::openauto::autoapp::service::ServiceList &serviceList,
+IService::Pointer ServiceFactory::createMicrophoneService(
     aasdk::messenger::IMessenger::Pointer messenger) {
-  OPENAUTO_LOG(info) << "[ServiceFactory] createMediaSourceServices()";
+  OPENAUTO_LOG(info) << "[ServiceFactory] createMicrophoneService()";
   auto audioInput =
-      std::make_shared<projection::RtAudioInput>(1, 16, 16000, configuration_);
-  serviceList.emplace_back(
-      std::make_shared<mediasource::MicrophoneMediaSourceService>(
-          ioService_, messenger, std::move(audioInput)));
+      duplexStream_
+          ? duplexStream_->createInput(mediaIoService_, configuration_)
+          : std::make_shared<projection::RtAudioInput>(mediaIoService_, 1, 16, 16000, configuration_);
+  // The start of "Hey Google" is in the ring before the phone asks for it
+  audioInput->setPreRoll(configuration_->getAudioMicPreRollMs());
+  if (configuration_->getAudioVoiceProcessing()) {
+    // The call's or else the mixer's output is the echo reference; without
+    // either only noise is suppressed
+    projection::EchoReference::Pointer reference;
+    if (duplexStream_) {
+      reference = duplexStream_->getEchoReference();
+    } else if (configuration_->getAudioMixerEnabled() && audioMixer_) {
+      reference = audioMixer_->getEchoReference();
+    }
+    const auto mode = configuration_->getAudioVoiceProcessingLowCpu()
+                          ? projection::VoiceProcessingMode::LowCpu
+                          : projection::VoiceProcessingMode::Full;
+    audioInput->setVoiceProcessing(std::make_shared<projection::VoiceProcessingStage>(
+        16000, mode, std::move(reference),
+        configuration_->getAudioVoiceProcessingCpu()));
+  }
+  return std::make_shared<mediasource::MicrophoneMediaSourceService>(
+      mediaIoService_, messenger, std::move(audioInput));
+}
+
+IService::Pointer ServiceFactory::createMediaPlaybackStatusService(
+    aasdk::messenger::IMessenger::Pointer messenger) {
+  OPENAUTO_LOG(info) << "[ServiceFactory] createMediaPlaybackStatusService()";
+  return std::make_shared<mediaplaybackstatus::MediaPlaybackStatusService>(
+      ioService_, messenger);
+}
+
+IService::Pointer ServiceFactory::createNavigationStatusService(
+    aasdk::messenger::IMessenger::Pointer messenger) {
+  OPENAUTO_LOG(info) << "[ServiceFactory] createNavigationStatusService()";
+  return std::make_shared<navigationstatus::NavigationStatusService>(
+      ioService_, messenger);
+}
+
+IService::Pointer ServiceFactory::createRadioService(
+    aasdk::messenger::IMessenger::Pointer messenger) {
+  OPENAUTO_LOG(info) << "[ServiceFactory] createRadioService()";
+
+  if (!radioReceiver_ || radioMixer_ != audioMixer_) {
+    const auto region = configuration_->getRadioRegion();
+    radio::RadioBand band;
+    if (!radio::RadioBand::forRegion(region, band)) {
+      OPENAUTO_LOG(warning) << "[ServiceFactory] Unknown RadioRegion " << region
+                            << ", using the European band";
+    }
+    const auto cacheDir =
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+        "/radio";
+    // Radio is local media to the mixer: guidance, calls and the phone's
+    // focus duck it
+    auto output =
+        this->createAudioOutput(projection::AudioMixerRole::LocalMedia, 2, 48000);
+    radioReceiver_ = std::make_shared<radio::RadioReceiver>(
+        std::make_shared<radio::V4l2RadioTuner>(configuration_->getRadioDevice()),
+        band,
+        radio::StationScanner::cachePath(cacheDir.toStdString(),
+                                         region.empty() ? "EU" : region),
+        configuration_->getRadioAudioDevice(), std::move(output));
+    radioMixer_ = audioMixer_;
+  }
+  return std::make_shared<radio::RadioService>(ioService_, messenger,
+                                               radioReceiver_);
 }
 
 IService::Pointer ServiceFactory::createSensorService(
     aasdk::messenger::IMessenger::Pointer messenger) {
   OPENAUTO_LOG(info) << "[ServiceFactory] createSensorService()";
-  return std::make_shared<sensor::SensorService>(ioService_, messenger);
+
+  // Vehicle sources from [Sensors]; each is off while its device is unset
+  std::vector<sensor::IVehicleSensorSource::Pointer> vehicleSources;
+  const auto canInterface = configuration_->getSensorCanInterface();
+  if (!canInterface.empty()) {
+    std::vector<sensor::CanSignal> signals;
+    sensor::CanSensorSource::parseSignals(configuration_->getSensorCanSignals(),
+                                          signals);
+    if (signals.empty()) {
+      OPENAUTO_LOG(warning)
+          << "[ServiceFactory] CanInterface set without any CanSignals";
+    } else {
+      vehicleSources.emplace_back(std::make_shared<sensor::CanSensorSource>(
+          canInterface, std::move(signals)));
+    }
+  }
+  const auto obdDevice = configuration_->getSensorObdDevice();
+  if (!obdDevice.empty()) {
+    vehicleSources.emplace_back(
+        std::make_shared<sensor::ObdSensorSource>(obdDevice));
+  }
+  const auto iioDevice = configuration_->getSensorIioDevice();
+  if (!iioDevice.empty()) {
+    vehicleSources.emplace_back(
+        std::make_shared<sensor::IioSensorSource>(iioDevice));
+  }
+
+  // A light sensor, when there is one, knows better than the sun's position
+  const bool nightFromGps = configuration_->getSensorGpsNightMode() &&
+                            configuration_->getSensorLightDevice().empty();
+  return std::make_shared<sensor::SensorService>(
+      ioService_, messenger, std::move(vehicleSources),
+      configuration_->getSensorRestrictWhileMoving(), nightFromGps);
 }
 
 IService::Pointer ServiceFactory::createWifiProjectionService(
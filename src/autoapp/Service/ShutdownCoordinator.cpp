@@ -0,0 +1,180 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <condition_variable>
+#include <cxxabi.h>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <typeinfo>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/Service/ShutdownCoordinator.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x {
+  namespace openauto {
+    namespace autoapp {
+      namespace service {
+
+        namespace {
+          typedef std::chrono::steady_clock Clock;
+
+          struct ShutdownMetrics {
+            MetricCounter &overruns = Metrics::instance().counter(
+                "openauto_shutdown_overruns_total", "Components still stopping at their shutdown deadline");
+            MetricHistogram &stageMs = Metrics::instance().histogram(
+                "openauto_shutdown_stage_ms", "Time for one group of components to stop",
+                {5, 10, 25, 50, 100, 200, 300, 500, 1000});
+          };
+
+          ShutdownMetrics &metrics() {
+            static ShutdownMetrics instance;
+            return instance;
+          }
+
+          struct Completion {
+            std::mutex mutex;
+            std::condition_variable finished;
+            std::vector<bool> done;
+          };
+        }
+
+        ShutdownCoordinator::~ShutdownCoordinator() {
+          if (supervisor_.joinable()) {
+            // The handler may drop the last reference to this on the
+            // supervisor itself, which has joined the steps by then
+            if (supervisor_.get_id() == std::this_thread::get_id()) {
+              supervisor_.detach();
+            } else {
+              supervisor_.join();
+            }
+          }
+          this->joinSteps();
+        }
+
+        void ShutdownCoordinator::joinSteps() {
+          for (auto &step : steps_) {
+            if (step.joinable()) {
+              step.join();
+            }
+          }
+        }
+
+        std::vector<std::string> ShutdownCoordinator::run(const std::vector<ShutdownStep> &steps) {
+          std::vector<std::string> overran;
+          if (steps.empty()) {
+            return overran;
+          }
+
+          const auto started = Clock::now();
+          auto completion = std::make_shared<Completion>();
+          completion->done.assign(steps.size(), false);
+          for (size_t i = 0; i < steps.size(); ++i) {
+            // Joined later: an overrunning step keeps what it stops alive until it returns
+            steps_.emplace_back([completion, i, step = steps[i]]() {
+              auto done = [completion, i]() {
+                std::lock_guard<std::mutex> lock(completion->mutex);
+                completion->done[i] = true;
+                completion->finished.notify_all();
+              };
+              try {
+                step.run(done);
+              } catch (...) {
+                OPENAUTO_LOG(error) << "[ShutdownCoordinator] " << step.name << " threw while stopping";
+                done();
+              }
+            });
+          }
+
+          std::vector<bool> late(steps.size(), false);
+          std::unique_lock<std::mutex> lock(completion->mutex);
+          while (true) {
+            const auto now = Clock::now();
+            auto wake = Clock::time_point::max();
+            for (size_t i = 0; i < steps.size(); ++i) {
+              if (completion->done[i] || late[i]) {
+                continue;
+              }
+              const auto deadline = started + std::chrono::milliseconds(steps[i].deadlineMs);
+              if (now >= deadline) {
+                late[i] = true;
+                overran.push_back(steps[i].name);
+                metrics().overruns.add();
+                OPENAUTO_LOG(warning) << "[ShutdownCoordinator] " << steps[i].name << " still stopping after "
+                                      << steps[i].deadlineMs << " ms";
+              } else if (deadline < wake) {
+                wake = deadline;
+              }
+            }
+            if (wake == Clock::time_point::max()) {
+              break;
+            }
+            completion->finished.wait_until(lock, wake);
+          }
+
+          metrics().stageMs.observe(std::chrono::duration<double, std::milli>(Clock::now() - started).count());
+          return overran;
+        }
+
+        void ShutdownCoordinator::stopServices(const ServiceList &services, Handler handler) {
+          if (supervisor_.joinable()) {
+            OPENAUTO_LOG(warning) << "[ShutdownCoordinator] Already stopping";
+            return;
+          }
+
+          std::vector<ShutdownStep> devices;
+          std::vector<ShutdownStep> others;
+          for (const auto &service : services) {
+            const bool holdsDevices = service->holdsDevices();
+            (holdsDevices ? devices : others)
+                .push_back({serviceName(*service), holdsDevices ? cDeviceDeadlineMs : cServiceDeadlineMs,
+                            [service](std::function<void()> done) { service->shutdown(std::move(done)); }});
+          }
+
+          supervisor_ = std::thread([this, devices = std::move(devices), others = std::move(others),
+                                     handler = std::move(handler)]() mutable {
+            auto overran = this->run(devices);
+            const auto rest = this->run(others);
+            overran.insert(overran.end(), rest.begin(), rest.end());
+            handler(std::move(overran));
+
+            // The handler's owner, and so this, stays until the late steps return
+            this->joinSteps();
+            handler = nullptr;
+          });
+        }
+
+        std::string ShutdownCoordinator::serviceName(const IService &service) {
+          std::string name = service.name();
+          if (!name.empty()) {
+            return name;
+          }
+          int status = 0;
+          char *demangled = abi::__cxa_demangle(typeid(service).name(), nullptr, nullptr, &status);
+          name = status == 0 && demangled != nullptr ? demangled : typeid(service).name();
+          std::free(demangled);
+          const auto scope = name.rfind("::");
+          return scope == std::string::npos ? name : name.substr(scope + 2);
+        }
+
+      }
+    }
+  }
+}
@@ -0,0 +1,59 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <sys/auxv.h>
+#include <f1x/openauto/autoapp/Service/TlsCipherPolicy.hpp>
+
+#if defined(__arm__) || defined(__aarch64__)
+#include <asm/hwcap.h>
+#endif
+
+namespace f1x::openauto::autoapp::service {
+
+  const char *const cChaChaFirstCipherList = "ECDHE+CHACHA20:DEFAULT";
+  const char *const cChaChaFirstCipherSuites =
+      "TLS_CHACHA20_POLY1305_SHA256:TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384";
+  const char *const cAesFirstCipherList = "DEFAULT";
+  const char *const cAesFirstCipherSuites =
+      "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256";
+
+  bool cpuHasAesInstructions() {
+#if defined(__arm__)
+    return (getauxval(AT_HWCAP2) & HWCAP2_AES) != 0;
+#elif defined(__aarch64__)
+    return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#elif defined(__x86_64__) || defined(__i386__)
+    return __builtin_cpu_supports("aes");
+#else
+    return false;
+#endif
+  }
+
+  const char *applyCipherPreference(SSL_CTX *context, bool preferChaCha) {
+    if (preferChaCha) {
+      SSL_CTX_set_cipher_list(context, cChaChaFirstCipherList);
+      SSL_CTX_set_ciphersuites(context, cChaChaFirstCipherSuites);
+      return "ChaCha20-Poly1305 first";
+    }
+    SSL_CTX_set_cipher_list(context, cAesFirstCipherList);
+    SSL_CTX_set_ciphersuites(context, cAesFirstCipherSuites);
+    return "AES-GCM first";
+  }
+
+}
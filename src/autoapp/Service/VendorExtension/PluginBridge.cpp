@@ -0,0 +1,293 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Service/VendorExtension/PluginBridge.hpp>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace f1x::openauto::autoapp::service::vendorextension {
+
+  namespace {
+    constexpr char cHelloPrefix[] = "openauto-vendor";
+    constexpr size_t cDescriptors = 3;
+
+    bool fillAddress(const std::string &path, sockaddr_un &address) {
+      address = sockaddr_un{};
+      address.sun_family = AF_UNIX;
+      if (path.size() >= sizeof(address.sun_path)) {
+        return false;
+      }
+      std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+      return true;
+    }
+  }
+
+  PluginBridge::PluginBridge(std::string socketPath, std::string channelName)
+      : socketPath_(std::move(socketPath)),
+        channelName_(std::move(channelName)),
+        wakeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+  }
+
+  PluginBridge::~PluginBridge() {
+    stop();
+    if (wakeFd_ >= 0) {
+      close(wakeFd_);
+    }
+  }
+
+  bool PluginBridge::start(MessageHandler handler) {
+    if (thread_.joinable()) {
+      return true;
+    }
+
+    sockaddr_un address;
+    if (wakeFd_ < 0 || !fillAddress(socketPath_, address)) {
+      OPENAUTO_LOG(error) << "[PluginBridge] Cannot listen on " << socketPath_;
+      return false;
+    }
+    // Message boundaries keep the hello apart from anything a plugin sends
+    listenFd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(socketPath_.c_str());
+    if (listenFd_ < 0 || bind(listenFd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(listenFd_, 1) != 0) {
+      OPENAUTO_LOG(error) << "[PluginBridge] Cannot listen on " << socketPath_ << ": " << std::strerror(errno);
+      if (listenFd_ >= 0) {
+        close(listenFd_);
+        listenFd_ = -1;
+      }
+      return false;
+    }
+
+    handler_ = std::move(handler);
+    dropped_ = 0;
+    stopping_ = false;
+    thread_ = std::thread([this]() {
+      pthread_setname_np(pthread_self(), "oa-vendor");
+      this->run();
+    });
+    OPENAUTO_LOG(info) << "[PluginBridge] Waiting for a " << channelName_ << " plugin on " << socketPath_;
+    return true;
+  }
+
+  void PluginBridge::stop() {
+    if (!thread_.joinable()) {
+      return;
+    }
+    stopping_ = true;
+    const uint64_t one = 1;
+    (void)write(wakeFd_, &one, sizeof(one));
+    thread_.join();
+
+    uint64_t count;
+    (void)read(wakeFd_, &count, sizeof(count));
+    detach();
+    close(listenFd_);
+    listenFd_ = -1;
+    unlink(socketPath_.c_str());
+    handler_ = nullptr;
+  }
+
+  bool PluginBridge::send(const void *data, size_t size) {
+    std::lock_guard<std::mutex> lock(channelMutex_);
+    if (!channel_ || !channel_->send(data, size)) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  bool PluginBridge::attached() const {
+    std::lock_guard<std::mutex> lock(channelMutex_);
+    return channel_ != nullptr;
+  }
+
+  uint64_t PluginBridge::dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  void PluginBridge::run() {
+    std::vector<uint8_t> message;
+    while (!stopping_) {
+      // Only this thread replaces the channel, so it reads it unlocked
+      const int channelFd = channel_ ? channel_->wakeFd() : -1;
+      pollfd fds[4] = {{wakeFd_, POLLIN, 0}, {listenFd_, POLLIN, 0}, {peerFd_, POLLIN, 0}, {channelFd, POLLIN, 0}};
+      const int ready = poll(fds, 4, -1);
+      if (ready < 0 && errno == EINTR) {
+        continue;
+      }
+      if (ready < 0) {
+        OPENAUTO_LOG(error) << "[PluginBridge] poll failed: " << std::strerror(errno);
+        return;
+      }
+
+      if (fds[3].revents != 0) {
+        channel_->drain();
+        while (channel_->receive(message)) {
+          if (handler_) {
+            handler_(std::move(message));
+          }
+          message.clear();
+        }
+        if (channel_->broken()) {
+          OPENAUTO_LOG(warning) << "[PluginBridge] The " << channelName_ << " plugin corrupted its ring";
+          detach();
+          continue;
+        }
+      }
+      if (fds[2].revents != 0) {
+        // Nothing is expected on the socket after the hello: this is the hang-up
+        char byte;
+        const ssize_t size = recv(peerFd_, &byte, sizeof(byte), MSG_DONTWAIT);
+        if (size == 0 || (size < 0 && errno != EAGAIN && errno != EINTR)) {
+          OPENAUTO_LOG(info) << "[PluginBridge] The " << channelName_ << " plugin went away";
+          detach();
+        }
+      }
+      if (fds[1].revents != 0) {
+        this->accept();
+      }
+    }
+  }
+
+  void PluginBridge::accept() {
+    const int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    if (peerFd_ >= 0) {
+      OPENAUTO_LOG(warning) << "[PluginBridge] Refusing a second " << channelName_ << " plugin";
+      close(fd);
+      return;
+    }
+
+    auto channel = std::make_unique<SharedChannel>();
+    if (!channel->create()) {
+      close(fd);
+      return;
+    }
+
+    const std::string hello = std::string(cHelloPrefix) + " " + std::to_string(cVersion) + " " + channelName_;
+    iovec data{const_cast<char *>(hello.data()), hello.size()};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * cDescriptors)] = {};
+    msghdr header{};
+    header.msg_iov = &data;
+    header.msg_iovlen = 1;
+    header.msg_control = control;
+    header.msg_controllen = sizeof(control);
+    cmsghdr *rights = CMSG_FIRSTHDR(&header);
+    rights->cmsg_level = SOL_SOCKET;
+    rights->cmsg_type = SCM_RIGHTS;
+    rights->cmsg_len = CMSG_LEN(sizeof(int) * cDescriptors);
+    const auto descriptors = channel->descriptors();
+    std::memcpy(CMSG_DATA(rights), descriptors.data(), sizeof(int) * cDescriptors);
+    if (sendmsg(fd, &header, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+      OPENAUTO_LOG(warning) << "[PluginBridge] Cannot hand the rings over: " << std::strerror(errno);
+      close(fd);
+      return;
+    }
+
+    peerFd_ = fd;
+    {
+      std::lock_guard<std::mutex> lock(channelMutex_);
+      channel_ = std::move(channel);
+    }
+    OPENAUTO_LOG(info) << "[PluginBridge] A " << channelName_ << " plugin attached";
+  }
+
+  void PluginBridge::detach() {
+    {
+      std::lock_guard<std::mutex> lock(channelMutex_);
+      channel_.reset();
+    }
+    if (peerFd_ >= 0) {
+      close(peerFd_);
+      peerFd_ = -1;
+    }
+  }
+
+  int PluginBridge::connect(const std::string &socketPath, SharedChannel &channel, std::string *channelName) {
+    sockaddr_un address;
+    if (!fillAddress(socketPath, address)) {
+      return -1;
+    }
+    const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+      return -1;
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+      close(fd);
+      return -1;
+    }
+
+    char hello[256];
+    iovec data{hello, sizeof(hello) - 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * cDescriptors)] = {};
+    msghdr header{};
+    header.msg_iov = &data;
+    header.msg_iovlen = 1;
+    header.msg_control = control;
+    header.msg_controllen = sizeof(control);
+    const ssize_t size = recvmsg(fd, &header, MSG_CMSG_CLOEXEC);
+
+    int descriptors[cDescriptors] = {-1, -1, -1};
+    cmsghdr *rights = size > 0 ? CMSG_FIRSTHDR(&header) : nullptr;
+    if (rights != nullptr && rights->cmsg_level == SOL_SOCKET && rights->cmsg_type == SCM_RIGHTS &&
+        rights->cmsg_len == CMSG_LEN(sizeof(int) * cDescriptors)) {
+      std::memcpy(descriptors, CMSG_DATA(rights), sizeof(descriptors));
+    }
+
+    int version = 0;
+    char name[200] = {};
+    hello[size > 0 ? size : 0] = '\0';
+    const std::string format = std::string(cHelloPrefix) + " %d %199s";
+    const bool understood = std::sscanf(hello, format.c_str(), &version, name) >= 1 && version == cVersion;
+    // attach() takes the descriptors over whatever happens
+    if (!channel.attach(understood ? descriptors[0] : -1, descriptors[1], descriptors[2])) {
+      if (!understood && descriptors[0] >= 0) {
+        close(descriptors[0]);
+      }
+      close(fd);
+      return -1;
+    }
+    if (channelName != nullptr) {
+      *channelName = name;
+    }
+    return fd;
+  }
+
+  std::string PluginBridge::socketPath(const std::string &channelName) {
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    std::string name;
+    for (const char c : channelName.empty() ? std::string("extension") : channelName) {
+      name += std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.' ? c : '_';
+    }
+    return std::string(runtime != nullptr && runtime[0] != '\0' ? runtime : "/tmp") + "/openauto-vendor-" + name +
+           ".sock";
+  }
+
+}
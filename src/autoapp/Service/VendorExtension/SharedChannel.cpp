@@ -0,0 +1,219 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Service/VendorExtension/SharedChannel.hpp>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace f1x::openauto::autoapp::service::vendorextension {
+
+  // Both processes must see the same indices at the same addresses
+  static_assert(std::atomic<size_t>::is_always_lock_free, "ring indices must be address-free");
+  static_assert(SharedChannel::cRingBytes % 4 == 0, "frames are 4-byte aligned");
+
+  struct SharedChannel::Layout {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ringBytes;
+    uint32_t layoutBytes;
+    Ring toPlugin;
+    Ring toHost;
+  };
+
+  namespace {
+    constexpr uint32_t cMagic = 0x4f415643;  // "OAVC"
+    constexpr uint32_t cVersion = 1;
+    constexpr uint32_t cHeaderBytes = sizeof(uint32_t);
+
+    size_t padded(size_t size) {
+      return (size + 3) & ~size_t(3);
+    }
+
+    void closeFd(int &fd) {
+      if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+      }
+    }
+  }
+
+  SharedChannel::~SharedChannel() {
+    close();
+  }
+
+  bool SharedChannel::create() {
+    close();
+    side_ = Side::Host;
+
+    memoryFd_ = memfd_create("openauto-vendor", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    hostWakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pluginWakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (memoryFd_ < 0 || hostWakeFd_ < 0 || pluginWakeFd_ < 0 || ftruncate(memoryFd_, sizeof(Layout)) != 0) {
+      OPENAUTO_LOG(error) << "[SharedChannel] Cannot create the rings: " << std::strerror(errno);
+      close();
+      return false;
+    }
+    // A plugin that truncated the memory would take us down with SIGBUS
+    if (fcntl(memoryFd_, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+      OPENAUTO_LOG(error) << "[SharedChannel] Cannot seal the rings: " << std::strerror(errno);
+      close();
+      return false;
+    }
+
+    void *memory = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd_, 0);
+    if (memory == MAP_FAILED) {
+      OPENAUTO_LOG(error) << "[SharedChannel] Cannot map the rings: " << std::strerror(errno);
+      close();
+      return false;
+    }
+    // Fresh memfd pages read as zero; only what is written gets faulted in
+    layout_ = new (memory) Layout;
+    layout_->magic = cMagic;
+    layout_->version = cVersion;
+    layout_->ringBytes = cRingBytes;
+    layout_->layoutBytes = sizeof(Layout);
+    return true;
+  }
+
+  bool SharedChannel::attach(int memoryFd, int hostWakeFd, int pluginWakeFd) {
+    close();
+    side_ = Side::Plugin;
+    memoryFd_ = memoryFd;
+    hostWakeFd_ = hostWakeFd;
+    pluginWakeFd_ = pluginWakeFd;
+
+    struct stat info{};
+    if (memoryFd_ < 0 || hostWakeFd_ < 0 || pluginWakeFd_ < 0 || fstat(memoryFd_, &info) != 0 ||
+        static_cast<size_t>(info.st_size) < sizeof(Layout)) {
+      close();
+      return false;
+    }
+    void *memory = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd_, 0);
+    if (memory == MAP_FAILED) {
+      close();
+      return false;
+    }
+    // Constructed by the host; both sides are built from this header
+    layout_ = static_cast<Layout *>(memory);
+    if (layout_->magic != cMagic || layout_->version != cVersion || layout_->ringBytes != cRingBytes ||
+        layout_->layoutBytes != sizeof(Layout)) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void SharedChannel::close() {
+    if (layout_ != nullptr) {
+      // The rings are plain memory: nothing to destroy, only to unmap
+      munmap(layout_, sizeof(Layout));
+      layout_ = nullptr;
+    }
+    closeFd(memoryFd_);
+    closeFd(hostWakeFd_);
+    closeFd(pluginWakeFd_);
+    broken_ = false;
+  }
+
+  bool SharedChannel::valid() const {
+    return layout_ != nullptr;
+  }
+
+  bool SharedChannel::broken() const {
+    return broken_;
+  }
+
+  std::array<int, 3> SharedChannel::descriptors() const {
+    return {memoryFd_, hostWakeFd_, pluginWakeFd_};
+  }
+
+  int SharedChannel::wakeFd() const {
+    return side_ == Side::Host ? hostWakeFd_ : pluginWakeFd_;
+  }
+
+  void SharedChannel::drain() {
+    uint64_t count;
+    (void)read(wakeFd(), &count, sizeof(count));
+  }
+
+  bool SharedChannel::send(const void *data, size_t size) {
+    if (layout_ == nullptr || broken_ || size > cMaxMessageBytes) {
+      return false;
+    }
+    Ring &ring = outgoing();
+    const size_t frame = cHeaderBytes + padded(size);
+    if (ring.space() < frame) {
+      return false;
+    }
+
+    // The reader waits for the whole frame, so it may be published in parts
+    const uint32_t header = static_cast<uint32_t>(size);
+    ring.write(&header, sizeof(header));
+    ring.write(data, size);
+    static const uint8_t zeros[3] = {};
+    ring.write(zeros, padded(size) - size);
+
+    const uint64_t one = 1;
+    (void)write(side_ == Side::Host ? pluginWakeFd_ : hostWakeFd_, &one, sizeof(one));
+    return true;
+  }
+
+  bool SharedChannel::receive(std::vector<uint8_t> &message) {
+    if (layout_ == nullptr || broken_) {
+      return false;
+    }
+    Ring &ring = incoming();
+    const auto span = ring.peekContiguous();
+    if (span.size < cHeaderBytes) {
+      return false;
+    }
+    uint32_t size;
+    std::memcpy(&size, span.data, sizeof(size));
+    if (size > cMaxMessageBytes) {
+      OPENAUTO_LOG(warning) << "[SharedChannel] Malformed frame of " << size << " bytes";
+      broken_ = true;
+      return false;
+    }
+    if (ring.available() < cHeaderBytes + padded(size)) {
+      return false;
+    }
+
+    ring.commitRead(cHeaderBytes);
+    message.resize(size);
+    ring.read(message.data(), size);
+    uint8_t pad[3];
+    ring.read(pad, padded(size) - size);
+    return true;
+  }
+
+  SharedChannel::Ring &SharedChannel::outgoing() {
+    return side_ == Side::Host ? layout_->toPlugin : layout_->toHost;
+  }
+
+  SharedChannel::Ring &SharedChannel::incoming() {
+    return side_ == Side::Host ? layout_->toHost : layout_->toPlugin;
+  }
+
+}
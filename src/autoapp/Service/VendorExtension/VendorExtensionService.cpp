@@ -17,6 +17,7 @@
 */
 
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
 #include <f1x/openauto/autoapp/Service/VendorExtension/VendorExtensionService.hpp>
 #include <fstream>
 #include <QString>
@@ -24,23 +25,44 @@
 namespace f1x::openauto::autoapp::service::vendorextension {
 
   VendorExtensionService::VendorExtensionService(boost::asio::io_service &ioService,
-                                                 aasdk::messenger::IMessenger::Pointer messenger)
+                                                 aasdk::messenger::IMessenger::Pointer messenger,
+                                                 std::string serviceName)
       : strand_(ioService),
         timer_(ioService),
         channel_(
-            std::make_shared<aasdk::channel::vendorextension::VendorExtensionService>(strand_, std::move(messenger))) {
+            std::make_shared<aasdk::channel::vendorextension::VendorExtensionService>(strand_, std::move(messenger))),
+        serviceName_(std::move(serviceName)),
+        bridge_(PluginBridge::socketPath(serviceName_), serviceName_) {
 
   }
 
   void VendorExtensionService::start() {
     strand_.dispatch([this, self = this->shared_from_this()]() {
       OPENAUTO_LOG(info) << "[VendorExtensionService] start()";
+
+      // The bridge's thread only queues onto the strand; a burst from the
+      // plugin never reaches further than that
+      std::weak_ptr<VendorExtensionService> weak = this->shared_from_this();
+      this->bridge_.start([weak](std::vector<uint8_t> payload) {
+        if (auto service = weak.lock()) {
+          service->strand_.post([service, payload = std::move(payload)]() {
+            if (service->payloadHandler_) {
+              service->payloadHandler_(payload);
+            }
+          });
+        }
+      });
     });
   }
 
   void VendorExtensionService::stop() {
     strand_.dispatch([this, self = this->shared_from_this()]() {
       OPENAUTO_LOG(info) << "[VendorExtensionService] stop()";
+      this->bridge_.stop();
+      if (this->bridge_.dropped() > 0) {
+        OPENAUTO_LOG(info) << "[VendorExtensionService] " << this->bridge_.dropped()
+                           << " payloads dropped while no plugin kept up";
+      }
     });
   }
 
@@ -64,7 +86,7 @@ namespace f1x::openauto::autoapp::service::vendorextension {
     service->set_id(static_cast<uint32_t>(channel_->getId()));
 
     auto *vendorExtension = service->mutable_vendor_extension_service();
-    (void)vendorExtension; // Suppress unused variable warning
+    vendorExtension->set_service_name(serviceName_);
   }
 
   void VendorExtensionService::onChannelError(const aasdk::error::Error &e) {
@@ -73,6 +95,7 @@ namespace f1x::openauto::autoapp::service::vendorextension {
 
   void VendorExtensionService::onChannelOpenRequest(
       const aap_protobuf::service::control::message::ChannelOpenRequest &request) {
+    FlightRecorder::instance().record(FlightEvent::ChannelOpened, request.service_id());
     OPENAUTO_LOG(info) << "[VendorExtensionService] onChannelOpenRequest()";
     OPENAUTO_LOG(info) << "[VendorExtensionService] Channel Id: " << request.service_id() << ", Priority: "
                        << request.priority();
@@ -87,6 +110,20 @@ namespace f1x::openauto::autoapp::service::vendorextension {
     channel_->sendChannelOpenResponse(response, std::move(promise));
     channel_->receive(this->shared_from_this());
   }
+
+  void VendorExtensionService::setPayloadHandler(PayloadHandler handler) {
+    strand_.dispatch([this, self = this->shared_from_this(), handler = std::move(handler)]() mutable {
+      this->payloadHandler_ = std::move(handler);
+    });
+  }
+
+  void VendorExtensionService::deliver(const std::string &payload) {
+    // Straight into the ring: no strand hop and no wait on the plugin
+    if (!bridge_.send(payload.data(), payload.size())) {
+      OPENAUTO_LOG_EVERY_MS(debug, 10000) << "[VendorExtensionService] No plugin took a payload, "
+                                          << bridge_.dropped() << " dropped so far";
+    }
+  }
 }
 
 
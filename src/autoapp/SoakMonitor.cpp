@@ -0,0 +1,480 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <malloc.h>
+#include <sstream>
+#include <unistd.h>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/Projection/CmaBudget.hpp>
+#include <f1x/openauto/autoapp/Projection/FrameGrabber.hpp>
+#include <f1x/openauto/autoapp/SoakMonitor.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    struct SoakMetrics
+    {
+      MetricGauge &heapInUse = Metrics::instance().gauge(
+          "openauto_heap_in_use_bytes", "Heap and mmap'd chunks allocated, last soak sample");
+      MetricGauge &fragmentation = Metrics::instance().gauge(
+          "openauto_heap_fragmentation_permille", "Free bytes the heap keeps per 1000 bytes of heap");
+      MetricGauge &openFds = Metrics::instance().gauge(
+          "openauto_open_fds", "File descriptors open, last soak sample");
+      MetricGauge &framebuffers = Metrics::instance().gauge(
+          "openauto_drm_framebuffers", "DRM framebuffers this process holds, -1 without debugfs");
+      MetricGauge &drmBuffers = Metrics::instance().gauge(
+          "openauto_drm_buffer_bytes", "GEM memory of this process' DRM clients, -1 unknown");
+      MetricCounter &disconnects = Metrics::instance().counter(
+          "openauto_soak_disconnects_total", "Sessions the soak run ended from our side");
+    };
+
+    SoakMetrics &metrics()
+    {
+      static SoakMetrics instance;
+      return instance;
+    }
+
+    constexpr double cMsPerHour = 3600.0 * 1000.0;
+    // A session ends no sooner than this, so it gets past setup first
+    constexpr int cMinSessionSeconds = 10;
+
+    std::string trim(const std::string &value)
+    {
+      const size_t begin = value.find_first_not_of(" \t\r\n");
+      if (begin == std::string::npos)
+        return std::string();
+      return value.substr(begin, value.find_last_not_of(" \t\r\n") - begin + 1);
+    }
+
+    std::string megabytes(int64_t bytes)
+    {
+      if (bytes < 0)
+        return "unknown";
+      std::ostringstream out;
+      out << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0) << " MB";
+      return out.str();
+    }
+
+    // fd numbers in /proc/self/fd, without the one reading the directory
+    std::vector<int> openFds()
+    {
+      std::vector<int> fds;
+      DIR *dir = opendir("/proc/self/fd");
+      if (dir == nullptr)
+        return fds;
+      const int own = dirfd(dir);
+      while (struct dirent *entry = readdir(dir))
+      {
+        if (entry->d_name[0] == '.')
+          continue;
+        const int fd = std::atoi(entry->d_name);
+        if (fd != own)
+          fds.push_back(fd);
+      }
+      closedir(dir);
+      return fds;
+    }
+
+    std::set<std::string> threadNames()
+    {
+      std::set<std::string> names;
+      DIR *dir = opendir("/proc/self/task");
+      if (dir == nullptr)
+        return names;
+      while (struct dirent *entry = readdir(dir))
+      {
+        if (entry->d_name[0] == '.')
+          continue;
+        std::ifstream comm(std::string("/proc/self/task/") + entry->d_name + "/comm");
+        std::string name;
+        if (std::getline(comm, name))
+          names.insert(trim(name));
+      }
+      closedir(dir);
+      return names;
+    }
+
+    // Sum over the primary nodes' debugfs listings, -1 when none is readable
+    int64_t framebuffers()
+    {
+      const std::set<std::string> names = threadNames();
+      int64_t total = -1;
+      for (int minor = 0; minor < 8; minor++)
+      {
+        std::ifstream listing("/sys/kernel/debug/dri/" + std::to_string(minor) + "/framebuffer");
+        if (!listing)
+          continue;
+        total = std::max<int64_t>(total, 0) + SoakMonitor::parseFramebuffers(listing, names);
+      }
+      return total;
+    }
+
+    // One count per DRM client: dup'd fds share the client and its buffers
+    int64_t drmBuffers(const std::vector<int> &fds)
+    {
+      std::set<std::string> clients;
+      int64_t total = -1;
+      char target[256];
+      for (int fd : fds)
+      {
+        const std::string path = "/proc/self/fd/" + std::to_string(fd);
+        const ssize_t length = readlink(path.c_str(), target, sizeof(target) - 1);
+        if (length <= 0 || std::strncmp(target, "/dev/dri/", 9) != 0)
+          continue;
+        std::ifstream fdinfo("/proc/self/fdinfo/" + std::to_string(fd));
+        std::string clientId;
+        const int64_t bytes = fdinfo ? SoakMonitor::parseDrmFdinfo(fdinfo, clientId) : -1;
+        if (bytes < 0 || !clients.insert(clientId).second)
+          continue;
+        total = std::max<int64_t>(total, 0) + bytes;
+      }
+      return total;
+    }
+
+    int64_t median(std::vector<int64_t> values)
+    {
+      std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+      return values[values.size() / 2];
+    }
+  }
+
+  bool SoakMonitor::parseSpec(const std::string &spec, SoakSettings &settings)
+  {
+    std::istringstream in(spec);
+    std::string field;
+    std::vector<double> values;
+    while (std::getline(in, field, ','))
+    {
+      char *end = nullptr;
+      const double value = std::strtod(field.c_str(), &end);
+      if (field.empty() || *end != '\0' || value < 0)
+        return false;
+      values.push_back(value);
+    }
+    if (values.empty() || values.size() > 3 || values[0] <= 0)
+      return false;
+
+    settings.hours = values[0];
+    if (values.size() > 1)
+      settings.disconnectMinutes = static_cast<int>(values[1]);
+    if (values.size() > 2)
+      settings.warmupMinutes = static_cast<int>(values[2]);
+    return true;
+  }
+
+  SoakMonitor::SoakMonitor(boost::asio::io_service &ioService, SoakSettings settings)
+      : strand_(ioService), sampleTimer_(ioService), disconnectTimer_(ioService), settings_(std::move(settings)),
+        random_(std::random_device()())
+  {
+  }
+
+  void SoakMonitor::start(DisconnectHandler disconnectHandler, FinishedHandler finishedHandler)
+  {
+    strand_.dispatch([this, self = this->shared_from_this(), disconnectHandler = std::move(disconnectHandler),
+                      finishedHandler = std::move(finishedHandler)]() mutable
+                     {
+      disconnectHandler_ = std::move(disconnectHandler);
+      finishedHandler_ = std::move(finishedHandler);
+      started_ = std::chrono::steady_clock::now();
+      stopped_ = false;
+      OPENAUTO_LOG(info) << "[SoakMonitor] Soak run for " << settings_.hours << " h, sampling every "
+                         << settings_.sampleIntervalMs / 1000 << " s"
+                         << (settings_.disconnectMinutes > 0
+                                 ? ", sessions end within " + std::to_string(settings_.disconnectMinutes) + " min"
+                                 : std::string());
+      this->scheduleSample(); });
+  }
+
+  void SoakMonitor::stop()
+  {
+    strand_.dispatch([this, self = this->shared_from_this()]()
+                     {
+      stopped_ = true;
+      sampleTimer_.cancel();
+      disconnectTimer_.cancel(); });
+  }
+
+  void SoakMonitor::onSessionStarted()
+  {
+    strand_.dispatch([this, self = this->shared_from_this()]()
+                     {
+      if (stopped_ || inSession_)
+        return;
+      inSession_ = true;
+      sessions_++;
+      this->scheduleDisconnect(); });
+  }
+
+  void SoakMonitor::onSessionStopped()
+  {
+    strand_.dispatch([this, self = this->shared_from_this()]()
+                     {
+      inSession_ = false;
+      disconnectTimer_.cancel(); });
+  }
+
+  void SoakMonitor::scheduleSample()
+  {
+    sampleTimer_.expires_from_now(std::chrono::milliseconds(settings_.sampleIntervalMs));
+    sampleTimer_.async_wait(strand_.wrap([this, self = this->shared_from_this()](const boost::system::error_code &error)
+                                         {
+      if (error || stopped_)
+        return;
+
+      SoakSample reading = sample();
+      reading.atMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started_)
+                         .count();
+      reading.sessions = sessions_;
+      samples_.push_back(reading);
+      OPENAUTO_LOG(info) << "[SoakMonitor] " << reading.atMs / 60000 << " min: resident "
+                         << megabytes(reading.residentBytes) << ", heap " << megabytes(reading.heapInUseBytes)
+                         << " (" << reading.heapFragmentationPermille / 10.0 << "% free), CMA free "
+                         << megabytes(reading.cmaFreeBytes) << ", " << reading.openFds << " fds, "
+                         << reading.drmFramebuffers << " framebuffers, DRM " << megabytes(reading.drmBufferBytes)
+                         << ", " << sessions_ << " sessions";
+      if (inSession_ && !settings_.framePath.empty())
+        projection::FrameGrabber::instance().grabToFile(settings_.framePath);
+
+      if (reading.atMs >= settings_.hours * cMsPerHour)
+        this->finish();
+      else
+        this->scheduleSample(); }));
+  }
+
+  void SoakMonitor::scheduleDisconnect()
+  {
+    if (settings_.disconnectMinutes <= 0)
+      return;
+    std::uniform_int_distribution<int> seconds(cMinSessionSeconds,
+                                               std::max(cMinSessionSeconds, settings_.disconnectMinutes * 60));
+    disconnectTimer_.expires_from_now(std::chrono::seconds(seconds(random_)));
+    disconnectTimer_.async_wait(strand_.wrap([this, self = this->shared_from_this()](const boost::system::error_code &error)
+                                             {
+      if (error || stopped_ || !inSession_)
+        return;
+      OPENAUTO_LOG(info) << "[SoakMonitor] Ending session " << sessions_;
+      metrics().disconnects.add();
+      inSession_ = false;
+      if (disconnectHandler_)
+        disconnectHandler_(); }));
+  }
+
+  void SoakMonitor::finish()
+  {
+    stopped_ = true;
+    disconnectTimer_.cancel();
+
+    const std::vector<SoakFinding> findings = evaluate(samples_, settings_);
+    for (const auto &finding : findings)
+    {
+      OPENAUTO_LOG(error) << "[SoakMonitor] " << finding.resource << " grew by " << finding.perHour
+                          << " per hour, limit " << finding.limitPerHour;
+    }
+    OPENAUTO_LOG(info) << "[SoakMonitor] Soak run " << (findings.empty() ? "passed" : "failed") << " after "
+                       << sessions_ << " sessions, report in " << settings_.reportPath;
+    this->writeReport(findings);
+    if (finishedHandler_)
+      finishedHandler_(findings.empty());
+  }
+
+  void SoakMonitor::writeReport(const std::vector<SoakFinding> &findings) const
+  {
+    std::ofstream out(settings_.reportPath);
+    if (!out)
+    {
+      OPENAUTO_LOG(warning) << "[SoakMonitor] Cannot write " << settings_.reportPath;
+      return;
+    }
+    out << "{\"passed\": " << (findings.empty() ? "true" : "false") << ", \"hours\": " << settings_.hours
+        << ", \"sessions\": " << sessions_ << ", \"findings\": [";
+    for (size_t i = 0; i < findings.size(); i++)
+    {
+      out << (i == 0 ? "" : ", ") << "{\"resource\": \"" << findings[i].resource
+          << "\", \"per_hour\": " << findings[i].perHour << ", \"limit_per_hour\": " << findings[i].limitPerHour
+          << "}";
+    }
+    out << "], \"samples\": [";
+    for (size_t i = 0; i < samples_.size(); i++)
+    {
+      const SoakSample &s = samples_[i];
+      out << (i == 0 ? "" : ",") << "\n  {\"at_ms\": " << s.atMs << ", \"resident_bytes\": " << s.residentBytes
+          << ", \"heap_in_use_bytes\": " << s.heapInUseBytes
+          << ", \"heap_fragmentation_permille\": " << s.heapFragmentationPermille
+          << ", \"cma_free_bytes\": " << s.cmaFreeBytes << ", \"open_fds\": " << s.openFds
+          << ", \"drm_framebuffers\": " << s.drmFramebuffers << ", \"drm_buffer_bytes\": " << s.drmBufferBytes
+          << ", \"sessions\": " << s.sessions << "}";
+    }
+    out << "]}\n";
+  }
+
+  SoakSample SoakMonitor::sample()
+  {
+    SoakSample reading;
+    reading.residentBytes = MemoryFootprint::instance().process().residentBytes;
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const struct mallinfo2 heap = mallinfo2();
+#else
+    const struct mallinfo heap = mallinfo();
+#endif
+    reading.heapInUseBytes = static_cast<int64_t>(heap.uordblks) + static_cast<int64_t>(heap.hblkhd);
+    const int64_t heapBytes = static_cast<int64_t>(heap.arena) + static_cast<int64_t>(heap.hblkhd);
+    if (heapBytes > 0)
+      reading.heapFragmentationPermille = static_cast<int64_t>(heap.fordblks) * 1000 / heapBytes;
+
+    reading.cmaFreeBytes = projection::CmaBudget::instance().refresh().freeBytes;
+    const std::vector<int> fds = openFds();
+    reading.openFds = static_cast<int64_t>(fds.size());
+    reading.drmFramebuffers = framebuffers();
+    reading.drmBufferBytes = drmBuffers(fds);
+
+    metrics().heapInUse.set(reading.heapInUseBytes);
+    metrics().fragmentation.set(reading.heapFragmentationPermille);
+    metrics().openFds.set(reading.openFds);
+    metrics().framebuffers.set(reading.drmFramebuffers);
+    metrics().drmBuffers.set(reading.drmBufferBytes);
+    return reading;
+  }
+
+  double SoakMonitor::slopePerHour(const std::vector<SoakSample> &samples, int64_t SoakSample::*field)
+  {
+    double n = 0, sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for (const auto &s : samples)
+    {
+      if (s.*field < 0)
+        continue;
+      const double x = s.atMs / cMsPerHour;
+      const double y = static_cast<double>(s.*field);
+      n++;
+      sumX += x;
+      sumY += y;
+      sumXX += x * x;
+      sumXY += x * y;
+    }
+    const double denominator = n * sumXX - sumX * sumX;
+    if (n < 2 || denominator <= 0)
+      return 0.0;
+    return (n * sumXY - sumX * sumY) / denominator;
+  }
+
+  std::vector<SoakFinding> SoakMonitor::evaluate(const std::vector<SoakSample> &samples, const SoakSettings &settings)
+  {
+    std::vector<SoakSample> trend;
+    std::copy_if(samples.begin(), samples.end(), std::back_inserter(trend), [&settings](const SoakSample &s)
+                 { return s.atMs >= static_cast<int64_t>(settings.warmupMinutes) * 60 * 1000; });
+
+    std::vector<SoakFinding> findings;
+    // @p direction -1 for a resource that leaks by shrinking, like CMA free
+    auto check = [&trend, &findings](const char *resource, int64_t SoakSample::*field, double limit, double direction)
+    {
+      std::vector<int64_t> known;
+      for (const auto &s : trend)
+      {
+        if (s.*field >= 0)
+          known.push_back(s.*field);
+      }
+      if (known.size() < cMinTrendSamples)
+        return;
+      const double perHour = direction * slopePerHour(trend, field);
+      // A steady climb, not one spike: the last quarter sits above the first
+      const size_t quarter = known.size() / 4;
+      const int64_t first = median(std::vector<int64_t>(known.begin(), known.begin() + quarter));
+      const int64_t last = median(std::vector<int64_t>(known.end() - quarter, known.end()));
+      if (perHour > limit && direction * static_cast<double>(last - first) > 0)
+        findings.push_back({resource, perHour, limit});
+    };
+
+    check("resident bytes", &SoakSample::residentBytes, static_cast<double>(settings.residentBytesPerHour), 1);
+    check("heap bytes", &SoakSample::heapInUseBytes, static_cast<double>(settings.heapBytesPerHour), 1);
+    check("heap fragmentation permille", &SoakSample::heapFragmentationPermille,
+          static_cast<double>(settings.fragmentationPermillePerHour), 1);
+    check("CMA free bytes", &SoakSample::cmaFreeBytes, static_cast<double>(settings.cmaLossBytesPerHour), -1);
+    check("open fds", &SoakSample::openFds, settings.fdsPerHour, 1);
+    check("DRM framebuffers", &SoakSample::drmFramebuffers, settings.framebuffersPerHour, 1);
+    check("DRM buffer bytes", &SoakSample::drmBufferBytes, static_cast<double>(settings.drmBytesPerHour), 1);
+    return findings;
+  }
+
+  int64_t SoakMonitor::parseFramebuffers(std::istream &in, const std::set<std::string> &comms)
+  {
+    static const std::string cAllocatedBy = "allocated by =";
+    int64_t count = 0;
+    std::string line;
+    while (std::getline(in, line))
+    {
+      const std::string field = trim(line);
+      if (field.compare(0, cAllocatedBy.size(), cAllocatedBy) == 0 &&
+          comms.count(trim(field.substr(cAllocatedBy.size()))) > 0)
+      {
+        count++;
+      }
+    }
+    return count;
+  }
+
+  int64_t SoakMonitor::parseDrmFdinfo(std::istream &in, std::string &clientId)
+  {
+    int64_t total = -1;
+    int64_t memory = -1;
+    std::string line;
+    while (std::getline(in, line))
+    {
+      const size_t colon = line.find(':');
+      if (colon == std::string::npos)
+        continue;
+      const std::string key = line.substr(0, colon);
+      std::istringstream value(line.substr(colon + 1));
+      if (key == "drm-client-id")
+      {
+        value >> clientId;
+        continue;
+      }
+      const bool isTotal = key.compare(0, 10, "drm-total-") == 0;
+      if (!isTotal && key.compare(0, 11, "drm-memory-") != 0)
+        continue;
+
+      int64_t amount = 0;
+      std::string unit;
+      if (!(value >> amount))
+        continue;
+      value >> unit;
+      if (unit == "KiB")
+        amount *= 1024;
+      else if (unit == "MiB")
+        amount *= 1024 * 1024;
+      else if (unit == "GiB")
+        amount *= 1024LL * 1024 * 1024;
+      int64_t &sum = isTotal ? total : memory;
+      sum = std::max<int64_t>(sum, 0) + amount;
+    }
+    // Kernels before drm-total-* only report drm-memory-*
+    return total >= 0 ? total : memory;
+  }
+
+}
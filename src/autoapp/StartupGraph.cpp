@@ -0,0 +1,243 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <exception>
+#include <sstream>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/StartupGraph.hpp>
+#include <f1x/openauto/autoapp/StartupTrace.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  StartupGraph::StartupGraph(boost::asio::io_service &ioService, size_t concurrency)
+      : ioService_(ioService), concurrency_(std::max<size_t>(concurrency, 1)), running_(0), executing_(0), finished_(0),
+        started_(false)
+  {
+  }
+
+  StartupGraph::~StartupGraph()
+  {
+    // Posted tasks the pool never ran do not hold anything
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]()
+               { return executing_ == 0; });
+  }
+
+  bool StartupGraph::add(std::string name, std::vector<std::string> after, Task task)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (started_)
+      return false;
+
+    auto find = [this](const std::string &wanted)
+    {
+      return std::find_if(nodes_.begin(), nodes_.end(), [&wanted](const Node &node)
+                          { return node.timing.name == wanted; });
+    };
+    if (find(name) != nodes_.end())
+      return false;
+    std::vector<size_t> before;
+    for (const auto &dependency : after)
+    {
+      const auto node = find(dependency);
+      if (node == nodes_.end())
+        return false;
+      before.push_back(static_cast<size_t>(node - nodes_.begin()));
+    }
+
+    // Dependencies must exist already, so there can be no cycle
+    const size_t index = nodes_.size();
+    nodes_.emplace_back();
+    nodes_.back().timing.name = std::move(name);
+    nodes_.back().task = std::move(task);
+    nodes_.back().pending = before.size();
+    for (size_t dependency : before)
+      nodes_[dependency].next.push_back(index);
+    return true;
+  }
+
+  void StartupGraph::start()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (started_)
+      return;
+    started_ = true;
+    startedAt_ = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < nodes_.size(); ++i)
+    {
+      if (nodes_[i].pending == 0)
+      {
+        nodes_[i].state = State::Ready;
+        nodes_[i].timing.readyMs = 0;
+        ready_.push_back(i);
+      }
+    }
+    if (nodes_.empty())
+      done_.notify_all();
+    this->dispatch();
+  }
+
+  bool StartupGraph::wait(std::chrono::milliseconds timeout)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return done_.wait_for(lock, timeout, [this]()
+                          { return !started_ || finished_ == nodes_.size(); });
+  }
+
+  std::vector<StartupGraph::Timing> StartupGraph::timings() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Timing> timings;
+    for (const auto &node : nodes_)
+      timings.push_back(node.timing);
+    return timings;
+  }
+
+  std::string StartupGraph::report() const
+  {
+    std::ostringstream report;
+    for (const auto &timing : this->timings())
+    {
+      report << timing.name << ": ";
+      if (timing.durationMs < 0)
+        report << "skipped";
+      else
+        report << "ready +" << timing.readyMs << " ms, waited " << timing.startedMs - timing.readyMs
+               << " ms, ran " << timing.durationMs << " ms" << (timing.failed ? ", failed" : "");
+      report << "; ";
+    }
+    return report.str();
+  }
+
+  int64_t StartupGraph::sinceStart() const
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startedAt_)
+        .count();
+  }
+
+  void StartupGraph::dispatch()
+  {
+    // Oldest ready first: callers add tasks in order of importance
+    while (running_ < concurrency_ && !ready_.empty())
+    {
+      const size_t index = ready_.front();
+      ready_.erase(ready_.begin());
+      nodes_[index].state = State::Running;
+      ++running_;
+      ioService_.post([this, index]()
+                      { this->run(index); });
+    }
+  }
+
+  void StartupGraph::run(size_t index)
+  {
+    Task task;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++executing_;
+      nodes_[index].timing.startedMs = this->sinceStart();
+      task = std::move(nodes_[index].task);
+    }
+
+    State state = State::Done;
+    try
+    {
+      task();
+    }
+    catch (const std::exception &error)
+    {
+      OPENAUTO_LOG(error) << "[StartupGraph] " << nodes_[index].timing.name << " failed: " << error.what();
+      state = State::Failed;
+    }
+    catch (...)
+    {
+      OPENAUTO_LOG(error) << "[StartupGraph] " << nodes_[index].timing.name << " failed";
+      state = State::Failed;
+    }
+    this->finish(index, state);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    --executing_;
+    done_.notify_all();
+  }
+
+  void StartupGraph::finish(size_t index, State state)
+  {
+    bool last;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto &node = nodes_[index];
+      node.state = state;
+      node.timing.durationMs = this->sinceStart() - node.timing.startedMs;
+      node.timing.failed = state == State::Failed;
+      --running_;
+      ++finished_;
+
+      // Whatever comes after a failed task is skipped, transitively
+      std::vector<size_t> skipped;
+      for (size_t next : node.next)
+      {
+        if (state == State::Failed)
+        {
+          skipped.push_back(next);
+          continue;
+        }
+        if (--nodes_[next].pending == 0 && nodes_[next].state == State::Waiting)
+        {
+          nodes_[next].state = State::Ready;
+          nodes_[next].timing.readyMs = this->sinceStart();
+          ready_.push_back(next);
+        }
+      }
+      while (!skipped.empty())
+      {
+        const size_t next = skipped.back();
+        skipped.pop_back();
+        if (nodes_[next].state != State::Waiting)
+          continue;
+        nodes_[next].state = State::Skipped;
+        nodes_[next].timing.failed = true;
+        ++finished_;
+        skipped.insert(skipped.end(), nodes_[next].next.begin(), nodes_[next].next.end());
+      }
+
+      this->dispatch();
+      last = finished_ == nodes_.size();
+      done_.notify_all();
+    }
+    if (last)
+      this->publish();
+  }
+
+  void StartupGraph::publish()
+  {
+    for (const auto &timing : this->timings())
+    {
+      if (timing.durationMs >= 0)
+        Metrics::instance()
+            .gauge("openauto_startup_" + timing.name + "_ms", "Time the " + timing.name + " startup task ran")
+            .set(timing.durationMs);
+    }
+    StartupTrace::mark("startup tasks done");
+    OPENAUTO_LOG(info) << "[StartupGraph] " << this->report();
+  }
+
+}
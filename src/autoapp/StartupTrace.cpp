@@ -0,0 +1,125 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <string>
+#include <time.h>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/StartupTrace.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    long long bootTimeMs()
+    {
+      // CLOCK_BOOTTIME: counts from power-on, which is what ignition-to-AA means
+      timespec now{};
+      clock_gettime(CLOCK_BOOTTIME, &now);
+      return static_cast<long long>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+    }
+
+    // The first mark (the top of main()) defines process start
+    const std::chrono::steady_clock::time_point &processStart()
+    {
+      static const auto start = std::chrono::steady_clock::now();
+      return start;
+    }
+
+    // Beyond this, a pending connection was a device that never projected
+    constexpr auto cConnectionWindow = std::chrono::seconds(60);
+
+    struct PendingConnection
+    {
+      std::mutex mutex;
+      const char *source = nullptr;
+      std::chrono::steady_clock::time_point startedAt;
+    };
+
+    PendingConnection &pending()
+    {
+      static PendingConnection instance;
+      return instance;
+    }
+
+    MetricHistogram &timeToProjection()
+    {
+      static MetricHistogram &histogram = Metrics::instance().histogram(
+          "openauto_time_to_projection_ms", "From phone connection to the first projected frame",
+          {500, 1000, 2000, 3000, 5000, 8000, 13000, 20000, 30000, 60000});
+      return histogram;
+    }
+  }
+
+  void StartupTrace::mark(const char *phase)
+  {
+    const auto sinceStart = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                std::chrono::steady_clock::now() - processStart())
+                                .count();
+    OPENAUTO_LOG(info) << "[Startup] " << phase << ": +" << sinceStart << " ms ("
+                       << bootTimeMs() << " ms since boot)";
+  }
+
+  void StartupTrace::markOnce(const char *phase)
+  {
+    static std::mutex mutex;
+    static std::set<std::string> reached;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!reached.insert(phase).second)
+        return;
+    }
+    mark(phase);
+  }
+
+  void StartupTrace::beginConnection(const char *source)
+  {
+    const auto now = std::chrono::steady_clock::now();
+    auto &connection = pending();
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    if (connection.source != nullptr && now - connection.startedAt < cConnectionWindow)
+      return;
+    connection.source = source;
+    connection.startedAt = now;
+  }
+
+  void StartupTrace::connectionProjected()
+  {
+    const auto now = std::chrono::steady_clock::now();
+    const char *source;
+    std::chrono::steady_clock::duration elapsed;
+    {
+      auto &connection = pending();
+      std::lock_guard<std::mutex> lock(connection.mutex);
+      source = connection.source;
+      elapsed = now - connection.startedAt;
+      connection.source = nullptr;
+    }
+    if (source == nullptr || elapsed >= cConnectionWindow)
+      return;
+
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    timeToProjection().observe(static_cast<double>(ms));
+    OPENAUTO_LOG(info) << "[Startup] " << source << " to first projected frame: " << ms << " ms";
+  }
+
+}
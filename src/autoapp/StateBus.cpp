@@ -0,0 +1,259 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <f1x/openauto/autoapp/StateBus.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    const char *fileName(StateFlag flag)
+    {
+      switch (flag)
+      {
+      case StateFlag::NightMode:
+        return "night_mode_enabled";
+      case StateFlag::EntityExit:
+        return "entityexit";
+      case StateFlag::BluetoothDevice:
+        return "btdevice";
+      case StateFlag::HotspotActive:
+        return "hotspot_active";
+      case StateFlag::DashcamRecording:
+        return "dashcam_is_recording";
+      case StateFlag::ReverseGear:
+        return "rearcam_enabled";
+      case StateFlag::Navigation:
+        return "navigation_state";
+      case StateFlag::PhoneStatus:
+        return "phone_status";
+      default:
+        return "";
+      }
+    }
+
+    std::string trimmed(const std::string &text)
+    {
+      const auto first = text.find_first_not_of(" \t\r\n");
+      if (first == std::string::npos)
+      {
+        return std::string();
+      }
+      const auto last = text.find_last_not_of(" \t\r\n");
+      return text.substr(first, last - first + 1);
+    }
+  }
+
+  StateBus::StateBus(std::string directory)
+      : directory_(std::move(directory)), nextHandlerId_(1),
+        inotifyFd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)), wakeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+        stopping_(false)
+  {
+    // Watch before the first read, so a change in between is not lost
+    if (inotifyFd_ < 0 ||
+        inotify_add_watch(inotifyFd_, directory_.c_str(),
+                          IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM) < 0)
+    {
+      OPENAUTO_LOG(error) << "[StateBus] Cannot watch " << directory_ << ": " << std::strerror(errno)
+                          << "; flags will only follow changes made in this process";
+    }
+
+    for (size_t i = 0; i < cFlagCount; ++i)
+    {
+      this->refresh(static_cast<StateFlag>(i));
+    }
+
+    if (inotifyFd_ >= 0 && wakeFd_ >= 0)
+    {
+      thread_ = std::thread(&StateBus::run, this);
+    }
+  }
+
+  StateBus::~StateBus()
+  {
+    stopping_ = true;
+    if (thread_.joinable())
+    {
+      const uint64_t one = 1;
+      (void)write(wakeFd_, &one, sizeof(one));
+      thread_.join();
+    }
+    for (int fd : {inotifyFd_, wakeFd_})
+    {
+      if (fd >= 0)
+      {
+        close(fd);
+      }
+    }
+  }
+
+  StateBus &StateBus::instance()
+  {
+    static StateBus bus("/tmp");
+    return bus;
+  }
+
+  std::string StateBus::path(StateFlag flag) const
+  {
+    return directory_ + "/" + fileName(flag);
+  }
+
+  bool StateBus::isSet(StateFlag flag) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_[static_cast<size_t>(flag)].isSet;
+  }
+
+  std::string StateBus::value(StateFlag flag) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_[static_cast<size_t>(flag)].value;
+  }
+
+  void StateBus::set(StateFlag flag, const std::string &value)
+  {
+    std::ofstream file(this->path(flag), std::ios::trunc);
+    file << value;
+    if (!file)
+    {
+      OPENAUTO_LOG(error) << "[StateBus] Cannot write " << this->path(flag);
+    }
+    file.close();
+    // Subscribers hear of it now rather than after the inotify round trip
+    this->update(flag, true, trimmed(value));
+  }
+
+  void StateBus::clear(StateFlag flag)
+  {
+    std::remove(this->path(flag).c_str());
+    this->update(flag, false, std::string());
+  }
+
+  int StateBus::subscribe(StateFlag flag, Handler handler)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int id = nextHandlerId_++;
+    handlers_.emplace(id, std::make_pair(flag, std::move(handler)));
+    return id;
+  }
+
+  void StateBus::unsubscribe(int id)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    handlers_.erase(id);
+  }
+
+  void StateBus::refresh(StateFlag flag)
+  {
+    std::ifstream file(this->path(flag));
+    if (!file)
+    {
+      this->update(flag, false, std::string());
+      return;
+    }
+    std::string content(cMaxValueSize, '\0');
+    file.read(&content[0], content.size());
+    content.resize(static_cast<size_t>(file.gcount()));
+    this->update(flag, true, trimmed(content));
+  }
+
+  void StateBus::update(StateFlag flag, bool isSet, std::string value)
+  {
+    std::vector<Handler> handlers;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      Entry &entry = entries_[static_cast<size_t>(flag)];
+      if (entry.isSet == isSet && entry.value == value)
+      {
+        return;
+      }
+      entry.isSet = isSet;
+      entry.value = std::move(value);
+      for (const auto &handler : handlers_)
+      {
+        if (handler.second.first == flag)
+        {
+          handlers.push_back(handler.second.second);
+        }
+      }
+    }
+
+    // Outside the lock: handlers may read the bus or unsubscribe
+    for (const auto &handler : handlers)
+    {
+      handler(flag, isSet);
+    }
+  }
+
+  void StateBus::run()
+  {
+    pollfd fds[2] = {{inotifyFd_, POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+    alignas(inotify_event) char buffer[4096];
+
+    while (!stopping_)
+    {
+      if (poll(fds, 2, -1) < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        OPENAUTO_LOG(error) << "[StateBus] poll failed: " << std::strerror(errno);
+        return;
+      }
+      if (!(fds[0].revents & POLLIN))
+      {
+        continue;
+      }
+
+      ssize_t length;
+      while ((length = read(inotifyFd_, buffer, sizeof(buffer))) > 0)
+      {
+        for (char *cursor = buffer; cursor < buffer + length;)
+        {
+          const auto *event = reinterpret_cast<const inotify_event *>(cursor);
+          cursor += sizeof(inotify_event) + event->len;
+          if (event->len == 0)
+          {
+            continue;
+          }
+          for (size_t i = 0; i < cFlagCount; ++i)
+          {
+            if (std::strcmp(event->name, fileName(static_cast<StateFlag>(i))) == 0)
+            {
+              this->refresh(static_cast<StateFlag>(i));
+              break;
+            }
+          }
+        }
+      }
+    }
+  }
+
+}
@@ -0,0 +1,127 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/PipelineTrace.hpp>
+#include <f1x/openauto/autoapp/StrandMonitor.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    const std::vector<double> cBoundsMs = {0.1, 0.5, 1, 2, 5, 10, 20, 50, 100, 250, 1000};
+
+    // Metric names take [a-z0-9_] only
+    std::string metricName(const char *name)
+    {
+      std::string result = "openauto_strand_";
+      for (const char *c = name; *c != '\0'; ++c)
+        result += (std::isalnum(static_cast<unsigned char>(*c)) != 0)
+                      ? static_cast<char>(std::tolower(static_cast<unsigned char>(*c)))
+                      : '_';
+      return result;
+    }
+
+    double ms(StrandMonitor::Clock::duration duration)
+    {
+      return std::chrono::duration<double, std::milli>(duration).count();
+    }
+  }
+
+  StrandMonitor &StrandMonitor::instance()
+  {
+    static StrandMonitor monitor;
+    return monitor;
+  }
+
+  StrandMonitor::StrandMonitor()
+      : longTasks_(Metrics::instance().counter("openauto_strand_long_tasks_total",
+                                               "Strand handlers that ran past StrandLongTaskMs"))
+  {
+  }
+
+  void StrandMonitor::configure(bool enabled, int longTaskMs)
+  {
+    longTaskUs_.store(static_cast<int64_t>(std::max(longTaskMs, 1)) * 1000, std::memory_order_relaxed);
+    enabled_.store(enabled, std::memory_order_relaxed);
+    if (enabled)
+      OPENAUTO_LOG(info) << "[StrandMonitor] Timing strand handlers, long tasks over " << longTaskMs << " ms";
+  }
+
+  StrandSite &StrandMonitor::site(const char *name)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &site = sites_[name];
+    if (!site)
+    {
+      const std::string metric = metricName(name);
+      auto &metrics = Metrics::instance();
+      site.reset(new StrandSite{
+          name,
+          metrics.histogram(metric + "_queue_ms", std::string("Wait for the strand before ") + name, cBoundsMs),
+          metrics.histogram(metric + "_run_ms", std::string("Run time of ") + name, cBoundsMs),
+          metrics.counter(metric + "_long_tasks_total", std::string("Runs of ") + name + " past StrandLongTaskMs")});
+    }
+    return *site;
+  }
+
+  void StrandMonitor::ran(StrandSite &site, Clock::time_point queued, Clock::time_point started,
+                          Clock::time_point finished)
+  {
+    const bool knowQueue = queued != Clock::time_point();
+    if (knowQueue)
+      site.queueMs.observe(ms(started - queued));
+    site.runMs.observe(ms(finished - started));
+
+    const int64_t runUs = std::chrono::duration_cast<std::chrono::microseconds>(finished - started).count();
+    if (runUs < longTaskUs_.load(std::memory_order_relaxed))
+      return;
+    site.longTasks.add();
+    longTasks_.add();
+
+    // One line per site and interval, counting the runs it stands for
+    const uint64_t runs = site.log.everyMs(cLogIntervalMs);
+    if (runs == 0)
+      return;
+    OPENAUTO_LOG(warning) << "[StrandMonitor] " << site.name << " ran " << runUs / 1000 << " ms"
+                          << (knowQueue ? " after " + std::to_string(static_cast<int64_t>(ms(started - queued))) +
+                                              " ms queued"
+                                        : std::string())
+                          << (runs > 1 ? " (" + std::to_string(runs) + " long runs since the last report)"
+                                       : std::string());
+  }
+
+  StrandTask::StrandTask(StrandSite &site, StrandMonitor::Clock::time_point queued)
+      : site_(site), timed_(StrandMonitor::instance().enabled()), queued_(queued),
+        started_(timed_ ? StrandMonitor::Clock::now() : StrandMonitor::Clock::time_point()),
+        traceStartNs_(PipelineTrace::instance().enabled() ? PipelineTrace::nowNs() : 0)
+  {
+  }
+
+  StrandTask::~StrandTask()
+  {
+    if (traceStartNs_ != 0)
+      PipelineTrace::instance().record(site_.name, traceStartNs_, PipelineTrace::nowNs());
+    if (timed_)
+      StrandMonitor::instance().ran(site_, queued_, started_, StrandMonitor::Clock::now());
+  }
+
+}
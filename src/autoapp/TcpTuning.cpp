@@ -0,0 +1,189 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/TcpTuning.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    struct TcpMetrics
+    {
+      MetricCounter &refused = Metrics::instance().counter(
+          "openauto_tcp_options_refused_total", "Wireless socket options the kernel refused");
+      MetricGauge &noDelay = Metrics::instance().gauge(
+          "openauto_tcp_nodelay", "TCP_NODELAY on the wireless client: 1 set, 0 not");
+      MetricGauge &quickAck = Metrics::instance().gauge(
+          "openauto_tcp_quickack", "TCP_QUICKACK on the wireless client: 1 set, 0 not");
+      MetricGauge &receiveBuffer = Metrics::instance().gauge(
+          "openauto_tcp_rcvbuf_bytes", "Receive buffer the kernel granted the wireless client");
+      MetricGauge &sendBuffer = Metrics::instance().gauge(
+          "openauto_tcp_sndbuf_bytes", "Send buffer the kernel granted the wireless client");
+      MetricGauge &dscp = Metrics::instance().gauge(
+          "openauto_tcp_dscp", "DSCP of the wireless client's packets");
+      MetricGauge &busyPoll = Metrics::instance().gauge(
+          "openauto_tcp_busy_poll_us", "SO_BUSY_POLL of the wireless client, 0 off");
+      MetricGauge &rtt = Metrics::instance().gauge(
+          "openauto_tcp_rtt_us", "Kernel smoothed RTT of the wireless connection");
+      MetricGauge &rttVar = Metrics::instance().gauge(
+          "openauto_tcp_rttvar_us", "Kernel RTT variation of the wireless connection");
+      MetricGauge &receiveRtt = Metrics::instance().gauge(
+          "openauto_tcp_rcv_rtt_us", "Kernel receive-side RTT estimate of the wireless connection");
+      MetricGauge &retransmits = Metrics::instance().gauge(
+          "openauto_tcp_retransmits", "Segments retransmitted on the wireless connection");
+      MetricGauge &lost = Metrics::instance().gauge(
+          "openauto_tcp_lost", "Segments the kernel presumes lost on the wireless connection");
+    };
+
+    TcpMetrics &metrics()
+    {
+      static TcpMetrics instance;
+      return instance;
+    }
+
+    bool setOption(int fd, int level, int option, int value, const char *name)
+    {
+      if (setsockopt(fd, level, option, &value, sizeof(value)) == 0)
+        return true;
+      OPENAUTO_LOG(warning) << "[TcpTuning] " << name << " = " << value << " refused: " << std::strerror(errno);
+      metrics().refused.add();
+      return false;
+    }
+
+    int getOption(int fd, int level, int option)
+    {
+      int value = 0;
+      socklen_t length = sizeof(value);
+      return getsockopt(fd, level, option, &value, &length) == 0 ? value : 0;
+    }
+
+    // Returns the refused count
+    int applyBuffers(int fd, const TcpTuningSettings &settings)
+    {
+      int refused = 0;
+      if (settings.receiveBufferBytes > 0 &&
+          !setOption(fd, SOL_SOCKET, SO_RCVBUF, settings.receiveBufferBytes, "SO_RCVBUF"))
+        ++refused;
+      if (settings.sendBufferBytes > 0 &&
+          !setOption(fd, SOL_SOCKET, SO_SNDBUF, settings.sendBufferBytes, "SO_SNDBUF"))
+        ++refused;
+      return refused;
+    }
+  }
+
+  TcpTuning &TcpTuning::instance()
+  {
+    static TcpTuning instance;
+    return instance;
+  }
+
+  TcpTuning::TcpTuning()
+  {
+    // Listed by the exporter before the first wireless client
+    metrics();
+  }
+
+  void TcpTuning::configure(const TcpTuningSettings &settings)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    settings_ = settings;
+  }
+
+  TcpTuningSettings TcpTuning::settings() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return settings_;
+  }
+
+  void TcpTuning::applyListener(int fd)
+  {
+    applyBuffers(fd, settings());
+  }
+
+  int TcpTuning::apply(int fd)
+  {
+    const TcpTuningSettings settings = this->settings();
+    auto &m = metrics();
+
+    // Inherited from the listener; set again in case that one was refused
+    int refused = applyBuffers(fd, settings);
+
+    const bool noDelay = settings.noDelay && setOption(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+    refused += settings.noDelay && !noDelay ? 1 : 0;
+    m.noDelay.set(noDelay ? 1 : 0);
+
+    const bool quickAck = settings.quickAck && setOption(fd, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+    refused += settings.quickAck && !quickAck ? 1 : 0;
+    m.quickAck.set(quickAck ? 1 : 0);
+
+    // Linux takes the socket priority, and with it the WMM queue, from the TOS
+    if (settings.dscp >= 0 && !setOption(fd, IPPROTO_IP, IP_TOS, (settings.dscp & 0x3f) << 2, "IP_TOS"))
+      ++refused;
+    m.dscp.set(getOption(fd, IPPROTO_IP, IP_TOS) >> 2);
+
+#ifdef SO_BUSY_POLL
+    if (settings.busyPollUs > 0 && !setOption(fd, SOL_SOCKET, SO_BUSY_POLL, settings.busyPollUs, "SO_BUSY_POLL"))
+      ++refused;
+    m.busyPoll.set(getOption(fd, SOL_SOCKET, SO_BUSY_POLL));
+#endif
+
+    m.receiveBuffer.set(getOption(fd, SOL_SOCKET, SO_RCVBUF));
+    m.sendBuffer.set(getOption(fd, SOL_SOCKET, SO_SNDBUF));
+
+    OPENAUTO_LOG(info) << "[TcpTuning] Wireless client: nodelay " << noDelay << ", quickack " << quickAck
+                       << ", rcvbuf " << m.receiveBuffer.value() << ", sndbuf " << m.sendBuffer.value()
+                       << ", dscp " << m.dscp.value() << ", " << refused << " options refused";
+    return refused;
+  }
+
+  bool TcpTuning::sample(int fd)
+  {
+    const TcpTuningSettings settings = this->settings();
+    // Not counted as refused: apply() already reported whether it sticks
+    if (settings.quickAck)
+    {
+      const int on = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+    }
+    if (!settings.linkStats)
+      return true;
+
+    tcp_info info;
+    socklen_t length = sizeof(info);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &length) != 0)
+      return false;
+
+    auto &m = metrics();
+    m.rtt.set(info.tcpi_rtt);
+    m.rttVar.set(info.tcpi_rttvar);
+    m.receiveRtt.set(info.tcpi_rcv_rtt);
+    m.retransmits.set(info.tcpi_total_retrans);
+    m.lost.set(info.tcpi_lost);
+    return true;
+  }
+
+}
@@ -0,0 +1,184 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <dirent.h>
+#include <fstream>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/ThermalGovernor.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    struct ThermalMetrics
+    {
+      MetricGauge &temperature = Metrics::instance().gauge(
+          "openauto_thermal_hottest_millicelsius", "Hottest thermal zone");
+      MetricGauge &level = Metrics::instance().gauge(
+          "openauto_thermal_level", "Quality level: 0 normal, 1 warm, 2 hot");
+      MetricCounter &throttles = Metrics::instance().counter(
+          "openauto_thermal_throttles_total", "Steps up to a warmer quality level");
+    };
+
+    ThermalMetrics &metrics()
+    {
+      static ThermalMetrics instance;
+      return instance;
+    }
+
+    bool readValue(const std::string &path, long &value)
+    {
+      std::ifstream in(path);
+      return static_cast<bool>(in >> value);
+    }
+
+    // Entries of @p directory whose name starts with @p prefix
+    std::vector<std::string> entries(const std::string &directory, const std::string &prefix)
+    {
+      std::vector<std::string> result;
+      if (DIR *dir = opendir(directory.c_str()))
+      {
+        while (const dirent *entry = readdir(dir))
+        {
+          const std::string name = entry->d_name;
+          if (name[0] != '.' && name.compare(0, prefix.size(), prefix) == 0)
+            result.push_back(directory + "/" + name);
+        }
+        closedir(dir);
+      }
+      return result;
+    }
+
+    int thresholdOf(ThermalLevel level)
+    {
+      return level == ThermalLevel::Hot ? ThermalGovernor::cHotMilliC : ThermalGovernor::cWarmMilliC;
+    }
+  }
+
+  const char *thermalLevelName(ThermalLevel level)
+  {
+    switch (level)
+    {
+    case ThermalLevel::Warm:
+      return "warm";
+    case ThermalLevel::Hot:
+      return "hot";
+    default:
+      return "normal";
+    }
+  }
+
+  ThermalGovernor &ThermalGovernor::instance()
+  {
+    static ThermalGovernor instance;
+    return instance;
+  }
+
+  ThermalGovernor::ThermalGovernor(std::string sysfsRoot)
+      : sysfsRoot_(std::move(sysfsRoot))
+  {
+  }
+
+  bool ThermalGovernor::capped(const std::string &path)
+  {
+    long value = 0;
+    if (!readValue(path, value))
+      return false;
+    // The first reading is the configured ceiling, cool or not
+    const auto ceiling = ceilings_.emplace(path, value).first;
+    return value < ceiling->second;
+  }
+
+  ThermalReading ThermalGovernor::read()
+  {
+    ThermalReading reading;
+    for (const auto &zone : entries(sysfsRoot_ + "/class/thermal", "thermal_zone"))
+    {
+      long milliC = 0;
+      if (readValue(zone + "/temp", milliC) && milliC > reading.hottestMilliC)
+        reading.hottestMilliC = static_cast<int>(milliC);
+    }
+
+    for (const auto &policy : entries(sysfsRoot_ + "/devices/system/cpu/cpufreq", "policy"))
+      reading.clocksCapped |= capped(policy + "/scaling_max_freq");
+    for (const auto &device : entries(sysfsRoot_ + "/class/devfreq", ""))
+      reading.clocksCapped |= capped(device + "/max_freq");
+    return reading;
+  }
+
+  ThermalLevel ThermalGovernor::update(const ThermalReading &reading)
+  {
+    ThermalLevel wanted = ThermalLevel::Normal;
+    if (reading.hottestMilliC >= cHotMilliC)
+      wanted = ThermalLevel::Hot;
+    else if (reading.hottestMilliC >= cWarmMilliC || reading.clocksCapped)
+      wanted = ThermalLevel::Warm;
+
+    const ThermalLevel current = level();
+    metrics().temperature.set(reading.hottestMilliC);
+    if (wanted > current)
+    {
+      coolSamples_ = 0;
+      metrics().throttles.add();
+      metrics().level.set(static_cast<int64_t>(wanted));
+      level_.store(wanted, std::memory_order_relaxed);
+      return wanted;
+    }
+
+    const bool cool = current != ThermalLevel::Normal && !reading.clocksCapped &&
+                      reading.hottestMilliC < thresholdOf(current) - cHysteresisMilliC;
+    coolSamples_ = cool ? coolSamples_ + 1 : 0;
+    if (coolSamples_ < cRecoverySamples)
+      return current;
+
+    coolSamples_ = 0;
+    const auto cooler = static_cast<ThermalLevel>(static_cast<int>(current) - 1);
+    metrics().level.set(static_cast<int64_t>(cooler));
+    level_.store(cooler, std::memory_order_relaxed);
+    return cooler;
+  }
+
+  void ThermalGovernor::sample()
+  {
+    const ThermalLevel before = level();
+    const ThermalReading reading = read();
+    const ThermalLevel after = update(reading);
+    if (after == before)
+      return;
+
+    OPENAUTO_LOG(info) << "[ThermalGovernor] " << thermalLevelName(before) << " -> "
+                       << thermalLevelName(after) << " at " << reading.hottestMilliC / 1000 << " C"
+                       << (reading.clocksCapped ? ", clocks capped" : "");
+    Handler handler;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      handler = handler_;
+    }
+    if (handler)
+      handler(after);
+  }
+
+  void ThermalGovernor::setHandler(Handler handler)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    handler_ = std::move(handler);
+  }
+
+}
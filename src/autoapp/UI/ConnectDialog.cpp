@@ -21,6 +21,7 @@ ConnectDialog::ConnectDialog(boost::asio::io_service& ioService, aasdk::tcp::ITC
     , tcpWrapper_(tcpWrapper)
     , recentAddressesList_(recentAddressesList)
     , ui_(new Ui::ConnectDialog)
+    , connector_(std::make_shared<WifiConnector>(ioService, 5277))
 {
     qRegisterMetaType<aasdk::tcp::ITCPEndpoint::SocketPointer>("aasdk::tcp::ITCPEndpoint::SocketPointer");
     qRegisterMetaType<std::string>("std::string");
@@ -40,6 +41,7 @@ ConnectDialog::ConnectDialog(boost::asio::io_service& ioService, aasdk::tcp::ITC
 
 ConnectDialog::~ConnectDialog()
 {
+    connector_->cancel();
     delete ui_;
 }
 
@@ -47,17 +49,26 @@ void ConnectDialog::onConnectButtonClicked()
 {
     this->setControlsEnabledStatus(false);
 
-    const auto& ipAddress = ui_->lineEditIPAddress->text().toStdString();
-    auto socket = std::make_shared<boost::asio::ip::tcp::socket>(ioService_);
-    ui_->progressBarConnect->show();
-    try
-    {
-        tcpWrapper_.asyncConnect(*socket, ipAddress, 5277, std::bind(&ConnectDialog::connectHandler, this, std::placeholders::_1, ipAddress, socket));
-    }
-    catch(const boost::system::system_error& se)
-    {
-        emit connectionFailed(QString(se.what()));
+    this->connectToPhone(ui_->lineEditIPAddress->text().toStdString());
+}
+
+void ConnectDialog::connectToPhone(const std::string& first)
+{
+    std::vector<std::string> addresses{first};
+    const auto& recentAddresses = recentAddressesList_.getList();
+    addresses.insert(addresses.end(), recentAddresses.begin(), recentAddresses.end());
+    if (std::ifstream("/tmp/hotspot_active")) {
+        const auto leases = WifiConnector::hotspotLeases();
+        addresses.insert(addresses.end(), leases.begin(), leases.end());
     }
+
+    ui_->progressBarConnect->show();
+    connector_->connect(addresses, [this](const boost::system::error_code& ec, aasdk::tcp::ITCPEndpoint::SocketPointer socket, const std::string& ipAddress) {
+        // Aborted only by the destructor
+        if (ec != boost::asio::error::operation_aborted) {
+            this->connectHandler(ec, ipAddress, std::move(socket));
+        }
+    });
 }
 
 void ConnectDialog::onUpdateButtonClicked()
@@ -82,7 +93,7 @@ void ConnectDialog::connectHandler(const boost::system::error_code& ec, const st
 void ConnectDialog::onConnectionSucceed(aasdk::tcp::ITCPEndpoint::SocketPointer, const std::string& ipAddress)
 {
     ui_->progressBarConnect->hide();
-    //this->insertIpAddress(ipAddress);
+    this->insertIpAddress(ipAddress);
     this->setControlsEnabledStatus(true);
 }
 
@@ -148,17 +159,7 @@ void ConnectDialog::loadClientList()
             versionFile.close();
             if (ui_->listWidgetClients->count() == 1) {
                 this->setControlsEnabledStatus(false);
-                const auto& ipAddress = ui_->lineEditIPAddress->text().toStdString();
-                auto socket = std::make_shared<boost::asio::ip::tcp::socket>(ioService_);
-                ui_->progressBarConnect->show();
-                try
-                {
-                    tcpWrapper_.asyncConnect(*socket, ipAddress, 5277, std::bind(&ConnectDialog::connectHandler, this, std::placeholders::_1, ipAddress, socket));
-                }
-                catch(const boost::system::system_error& se)
-                {
-                    emit connectionFailed(QString(se.what()));
-                }
+                this->connectToPhone(ui_->lineEditIPAddress->text().toStdString());
             }
         } else {
             ui_->lineEditIPAddress->setText("");
@@ -177,17 +178,7 @@ void ConnectDialog::loadClientList()
                 ui_->listWidgetClients->addItem(linedate.simplified());
                 if (ui_->listWidgetClients->count() == 1) {
                     this->setControlsEnabledStatus(false);
-                    const auto& ipAddress = ui_->lineEditIPAddress->text().toStdString();
-                    auto socket = std::make_shared<boost::asio::ip::tcp::socket>(ioService_);
-                    ui_->progressBarConnect->show();
-                    try
-                    {
-                        tcpWrapper_.asyncConnect(*socket, ipAddress, 5277, std::bind(&ConnectDialog::connectHandler, this, std::placeholders::_1, ipAddress, socket));
-                    }
-                    catch(const boost::system::system_error& se)
-                    {
-                        emit connectionFailed(QString(se.what()));
-                    }
+                    this->connectToPhone(ui_->lineEditIPAddress->text().toStdString());
                 }
             }
         } else {
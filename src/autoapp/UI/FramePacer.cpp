@@ -0,0 +1,190 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QScreen>
+#include <f1x/openauto/autoapp/UI/FramePacer.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace ui
+            {
+
+                namespace
+                {
+                    // eglfs reports 0 on some KMS drivers
+                    constexpr int64_t cDefaultRefreshPeriodUs = 16667;
+
+                    int64_t nowUs()
+                    {
+                        return std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                            .count();
+                    }
+                }
+
+                FramePacer::FramePacer(QObject *parent)
+                    : QObject(parent), hudTimer_(new QTimer(this)), frameCap_(0),
+                      refreshPeriodUs_(cDefaultRefreshPeriodUs), hudEnabled_(false), lastSwapUs_(0),
+                      renderStartUs_(0)
+                {
+                    hudTimer_->setInterval(cHudIntervalMs);
+                    connect(hudTimer_, &QTimer::timeout, this, &FramePacer::publishStats);
+                }
+
+                void FramePacer::attach(QQuickWindow *window)
+                {
+                    if (window_ != nullptr || window == nullptr)
+                        return;
+
+                    window_ = window;
+                    if (QScreen *screen = window->screen())
+                    {
+                        const qreal refreshHz = screen->refreshRate();
+                        if (refreshHz >= 1.0 && refreshHz <= 240.0)
+                            refreshPeriodUs_.store(static_cast<int64_t>(1000000.0 / refreshHz));
+                    }
+
+                    // Emitted on the render thread; the sync is over by then, so the
+                    // GUI thread is already back to its events while we hold
+                    connect(window, &QQuickWindow::beforeRendering, this, &FramePacer::beforeRendering,
+                            Qt::DirectConnection);
+                    connect(window, &QQuickWindow::frameSwapped, this, &FramePacer::frameSwapped,
+                            Qt::DirectConnection);
+
+                    OPENAUTO_LOG(info) << "[FramePacer] Pacing the QML window at "
+                                       << 1000000 / refreshPeriodUs_.load() << " Hz";
+                }
+
+                int FramePacer::frameCap() const
+                {
+                    return frameCap_.load(std::memory_order_relaxed);
+                }
+
+                void FramePacer::setFrameCap(int fps)
+                {
+                    fps = std::max(fps, 0);
+                    if (frameCap_.exchange(fps, std::memory_order_relaxed) == fps)
+                        return;
+                    emit frameCapChanged();
+                }
+
+                bool FramePacer::hudEnabled() const
+                {
+                    return hudEnabled_.load(std::memory_order_relaxed);
+                }
+
+                void FramePacer::setHudEnabled(bool enabled)
+                {
+                    if (hudEnabled_.exchange(enabled, std::memory_order_relaxed) == enabled)
+                        return;
+
+                    {
+                        std::lock_guard<std::mutex> lock(countersMutex_);
+                        counters_ = FrameCounters();
+                    }
+                    if (enabled)
+                    {
+                        hudTimer_->start();
+                    }
+                    else
+                    {
+                        hudTimer_->stop();
+                        frameStats_.clear();
+                        emit frameStatsChanged();
+                    }
+                    emit hudEnabledChanged();
+                }
+
+                QString FramePacer::frameStats() const
+                {
+                    return frameStats_;
+                }
+
+                int64_t FramePacer::holdUs(int64_t sinceSwapUs, int capFps, int64_t refreshPeriodUs)
+                {
+                    if (capFps <= 0 || refreshPeriodUs <= 0)
+                        return 0;
+
+                    const int64_t capIntervalUs = 1000000 / capFps;
+                    if (capIntervalUs <= refreshPeriodUs)
+                        return 0;
+
+                    // Rendering starts just after the vblank before the one the
+                    // frame is due on, so it has a whole period to be ready
+                    const int64_t startUs = capIntervalUs - refreshPeriodUs + refreshPeriodUs / 8;
+                    return std::max<int64_t>(startUs - sinceSwapUs, 0);
+                }
+
+                void FramePacer::beforeRendering()
+                {
+                    if (lastSwapUs_ != 0)
+                    {
+                        const int64_t hold = holdUs(nowUs() - lastSwapUs_, frameCap_.load(std::memory_order_relaxed),
+                                                    refreshPeriodUs_.load(std::memory_order_relaxed));
+                        if (hold > 0)
+                            std::this_thread::sleep_for(std::chrono::microseconds(hold));
+                    }
+                    renderStartUs_ = nowUs();
+                }
+
+                void FramePacer::frameSwapped()
+                {
+                    lastSwapUs_ = nowUs();
+                    if (!hudEnabled_.load(std::memory_order_relaxed) || renderStartUs_ == 0)
+                        return;
+
+                    const int64_t renderUs = lastSwapUs_ - renderStartUs_;
+                    std::lock_guard<std::mutex> lock(countersMutex_);
+                    counters_.frames++;
+                    counters_.renderTotalUs += renderUs;
+                    counters_.renderWorstUs = std::max(counters_.renderWorstUs, renderUs);
+                }
+
+                void FramePacer::publishStats()
+                {
+                    FrameCounters counters;
+                    {
+                        std::lock_guard<std::mutex> lock(countersMutex_);
+                        std::swap(counters, counters_);
+                    }
+
+                    // Render time runs to the end of the swap, so it includes the vsync wait
+                    const double averageMs = counters.frames > 0
+                                                 ? counters.renderTotalUs / 1000.0 / counters.frames
+                                                 : 0.0;
+                    const int cap = frameCap();
+                    frameStats_ = QString("UI %1 fps (%2) | frame %3 ms, max %4 ms")
+                                      .arg(counters.frames * 1000 / cHudIntervalMs)
+                                      .arg(cap > 0 ? QString("cap %1").arg(cap) : QString("uncapped"))
+                                      .arg(averageMs, 0, 'f', 1)
+                                      .arg(counters.renderWorstUs / 1000.0, 0, 'f', 1);
+                    emit frameStatsChanged();
+                }
+
+            } // namespace ui
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,136 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QFile>
+#include <QResource>
+#include <QTextStream>
+#include <QtEndian>
+#include <f1x/openauto/autoapp/UI/IconAtlas.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#include <cstring>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace ui
+            {
+
+                namespace
+                {
+                    constexpr quint32 cAtlasMagic = 0x4149414f; // "OAIA"
+                    constexpr quint32 cAtlasVersion = 1;
+                    constexpr int cHeaderBytes = 16;
+                    // As in scripts/pack_icons.py
+                    constexpr int cNightLevelPercent = 72;
+                    const QString cNightPrefix = QStringLiteral("night/");
+
+                    // An icon the atlas has no night variant of, dimmed here
+                    QImage nightVariant(QImage image)
+                    {
+                        image = image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+                        for (int y = 0; y < image.height(); ++y)
+                        {
+                            uchar *pixel = image.scanLine(y);
+                            for (int x = 0; x < image.width(); ++x, pixel += 4)
+                                for (int c = 0; c < 3; ++c)
+                                    pixel[c] = static_cast<uchar>((pixel[c] * cNightLevelPercent + 50) / 100);
+                        }
+                        return image;
+                    }
+                }
+
+                IconAtlas::IconAtlas()
+                    : QQuickImageProvider(QQuickImageProvider::Image),
+                      atlas_(std::async(std::launch::async, &IconAtlas::load).share())
+                {
+                }
+
+                IconAtlas::~IconAtlas() = default;
+
+                IconAtlas::Atlas IconAtlas::load()
+                {
+                    Atlas atlas;
+                    QFile index(":/atlas/icons.txt");
+                    QFile data(":/atlas/icons.rgba");
+                    if (!index.open(QIODevice::ReadOnly) || !data.open(QIODevice::ReadOnly))
+                        return atlas;
+
+                    // rcc stores it deflated: a few hundred KB for MB of pixels
+                    const QByteArray bytes = data.readAll();
+                    const uchar *header = reinterpret_cast<const uchar *>(bytes.constData());
+                    if (bytes.size() < cHeaderBytes || qFromLittleEndian<quint32>(header) != cAtlasMagic ||
+                        qFromLittleEndian<quint32>(header + 4) != cAtlasVersion)
+                    {
+                        OPENAUTO_LOG(warning) << "[IconAtlas] Ignoring an atlas from another build";
+                        return atlas;
+                    }
+                    const int width = static_cast<int>(qFromLittleEndian<quint32>(header + 8));
+                    const int height = static_cast<int>(qFromLittleEndian<quint32>(header + 12));
+                    if (width <= 0 || height <= 0 || bytes.size() != cHeaderBytes + qint64(width) * height * 4)
+                        return atlas;
+
+                    QImage pixels(width, height, QImage::Format_RGBA8888_Premultiplied);
+                    for (int y = 0; y < height; ++y)
+                        std::memcpy(pixels.scanLine(y), bytes.constData() + cHeaderBytes + qint64(y) * width * 4, size_t(width) * 4);
+
+                    QTextStream lines(&index);
+                    while (!lines.atEnd())
+                    {
+                        const QStringList fields = lines.readLine().split(' ', QString::SkipEmptyParts);
+                        if (fields.size() != 5)
+                            continue;
+                        const QRect rect(fields[1].toInt(), fields[2].toInt(), fields[3].toInt(), fields[4].toInt());
+                        if (pixels.rect().contains(rect))
+                            atlas.icons.insert(fields[0], rect);
+                    }
+                    atlas.pixels = pixels;
+                    OPENAUTO_LOG(info) << "[IconAtlas] " << atlas.icons.size() << " icons in a " << width << "x" << height << " atlas";
+                    return atlas;
+                }
+
+                QImage IconAtlas::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+                {
+                    const Atlas &atlas = atlas_.get();
+                    const auto it = atlas.icons.constFind(id);
+                    QImage image;
+                    if (it != atlas.icons.cend())
+                        image = atlas.pixels.copy(*it);
+                    else if (id.startsWith(cNightPrefix))
+                        image = nightVariant(QImage(":/" + id.mid(cNightPrefix.size())));
+                    else
+                        image = QImage(":/" + id);
+                    if (image.isNull())
+                    {
+                        OPENAUTO_LOG(warning) << "[IconAtlas] No icon " << id.toStdString();
+                        return image;
+                    }
+                    if (size)
+                        *size = image.size();
+
+                    if (requestedSize.isValid() && requestedSize != image.size())
+                        image = image.scaled(requestedSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+                    return image;
+                }
+
+            } // namespace ui
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -22,6 +22,8 @@
 #include <QFile>
 #include "ui_mainwindow.h"
 #include <QTimer>
+#include <QShowEvent>
+#include <QHideEvent>
 #include <QDateTime>
 #include <QMessageBox>
 #include <QTextStream>
@@ -37,6 +39,7 @@
 #include <cstdio>
 #include <unistd.h>
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/StateBus.hpp>
 
 namespace f1x
 {
@@ -62,7 +65,7 @@ namespace f1x
                     this->configuration_ = configuration;
 
                     // trigger files
-                    this->nightModeEnabled = check_file_exist(this->nightModeFile);
+                    this->nightModeEnabled = f1x::openauto::autoapp::StateBus::instance().isSet(f1x::openauto::autoapp::StateFlag::NightMode);
                     this->devModeEnabled = check_file_exist(this->devModeFile);
                     this->wifiButtonForce = check_file_exist(this->wifiButtonFile);
                     this->cameraButtonForce = check_file_exist(this->cameraButtonFile);
@@ -180,9 +183,9 @@ namespace f1x
                         }
                     }
 
-                    QTimer *timer = new QTimer(this);
-                    connect(timer, SIGNAL(timeout()), this, SLOT(showTime()));
-                    timer->start(1000);
+                    // Started while the window is on screen, see showEvent()
+                    clockTimer_ = new QTimer(this);
+                    connect(clockTimer_, SIGNAL(timeout()), this, SLOT(showTime()));
 
                     // enable connects while cam is enabled
                     if (this->cameraButtonForce)
@@ -222,11 +225,11 @@ namespace f1x
                     ui_->btDevice->hide();
 
                     // check if a device is connected via bluetooth
-                    if (std::ifstream("/tmp/btdevice"))
+                    if (f1x::openauto::autoapp::StateBus::instance().isSet(f1x::openauto::autoapp::StateFlag::BluetoothDevice))
                     {
                         if (ui_->btDevice->isVisible() == false || ui_->btDevice->text().simplified() == "")
                         {
-                            QString btdevicename = configuration_->readFileContent("/tmp/btdevice");
+                            QString btdevicename = QString::fromStdString(f1x::openauto::autoapp::StateBus::instance().value(f1x::openauto::autoapp::StateFlag::BluetoothDevice));
                             ui_->btDevice->setText(btdevicename);
                             ui_->btDevice->show();
                         }
@@ -617,6 +620,48 @@ namespace f1x
                     ui_->comboBoxAlbum->hide();
                     ui_->pushButtonAlbum->hide();
 
+                    // Experimental test code
+                    // Note: localDevice was already initialized in member initializer list
+                    // Setting parent here for proper Qt ownership
+                    localDevice->setParent(this);
+
+                    connect(localDevice, SIGNAL(hostModeStateChanged(QBluetoothLocalDevice::HostMode)),
+                            this, SLOT(hostModeStateChanged(QBluetoothLocalDevice::HostMode)));
+
+                    hostModeStateChanged(localDevice->hostMode());
+                    updateNetworkInfo();
+                }
+
+                MainWindow::~MainWindow()
+                {
+                    delete ui_;
+                }
+
+                void MainWindow::showEvent(QShowEvent *event)
+                {
+                    QMainWindow::showEvent(event);
+
+                    // Constructing the window scans and watches nothing: the music
+                    // folders and the /tmp and USB watchers wait for its first show
+                    if (!mediaInitialised_)
+                    {
+                        mediaInitialised_ = true;
+                        initMedia();
+                    }
+                    showTime();
+                    clockTimer_->start(1000);
+                }
+
+                void MainWindow::hideEvent(QHideEvent *event)
+                {
+                    QMainWindow::hideEvent(event);
+                    clockTimer_->stop();
+                }
+
+                void MainWindow::initMedia()
+                {
+                    const configuration::IConfiguration::Pointer &configuration = configuration_;
+
                     MainWindow::scanFolders();
                     ui_->comboBoxAlbum->setCurrentText(QString::fromStdString(configuration->getMp3SubFolder()));
                     MainWindow::scanFiles();
@@ -642,22 +687,6 @@ namespace f1x
                     watcher_tmp = new QFileSystemWatcher(this);
                     watcher_tmp->addPath("/tmp");
                     connect(watcher_tmp, &QFileSystemWatcher::directoryChanged, this, &MainWindow::tmpChanged);
-
-                    // Experimental test code
-                    // Note: localDevice was already initialized in member initializer list
-                    // Setting parent here for proper Qt ownership
-                    localDevice->setParent(this);
-
-                    connect(localDevice, SIGNAL(hostModeStateChanged(QBluetoothLocalDevice::HostMode)),
-                            this, SLOT(hostModeStateChanged(QBluetoothLocalDevice::HostMode)));
-
-                    hostModeStateChanged(localDevice->hostMode());
-                    updateNetworkInfo();
-                }
-
-                MainWindow::~MainWindow()
-                {
-                    delete ui_;
                 }
 
             }
@@ -701,7 +730,7 @@ void f1x::openauto::autoapp::ui::MainWindow::updateNetworkInfo()
             // qDebug() << "wlan0: " << wlan0.ip();
             ui_->value_ip->setText(wlan0.ip().toString().simplified());
             ui_->value_mask->setText(wlan0.netmask().toString().simplified());
-            if (std::ifstream("/tmp/hotspot_active"))
+            if (f1x::openauto::autoapp::StateBus::instance().isSet(f1x::openauto::autoapp::StateFlag::HotspotActive))
             {
                 ui_->value_ssid->setText(configuration_->getParamFromFile("/etc/hostapd/hostapd.conf", "ssid"));
             }
@@ -1024,7 +1053,7 @@ void f1x::openauto::autoapp::ui::MainWindow::cameraControlShow()
         ui_->cameraWidget->show();
 
         // check if dashcam is recording
-        if (std::ifstream("/tmp/dashcam_is_recording"))
+        if (f1x::openauto::autoapp::StateBus::instance().isSet(f1x::openauto::autoapp::StateFlag::DashcamRecording))
         {
             if (ui_->pushButtonRecordActive->isVisible() == false)
             {
@@ -1356,9 +1385,9 @@ void f1x::openauto::autoapp::ui::MainWindow::showTime()
             {
                 ui_->btDevice->show();
             }
-            if (std::ifstream("/tmp/btdevice"))
+            if (f1x::openauto::autoapp::StateBus::instance().isSet(f1x::openauto::autoapp::StateFlag::BluetoothDevice))
             {
-                ui_->btDevice->setText(configuration_->readFileContent("/tmp/btdevice"));
+                ui_->btDevice->setText(QString::fromStdString(f1x::openauto::autoapp::StateBus::instance().value(f1x::openauto::autoapp::StateFlag::BluetoothDevice)));
             }
         }
         else
@@ -2074,10 +2103,10 @@ void f1x::openauto::autoapp::ui::MainWindow::tmpChanged()
 {
     try
     {
-        if (std::ifstream("/tmp/entityexit"))
+        if (f1x::openauto::autoapp::StateBus::instance().isSet(f1x::openauto::autoapp::StateFlag::EntityExit))
         {
             MainWindow::TriggerAppStop();
-            std::remove("/tmp/entityexit");
+            f1x::openauto::autoapp::StateBus::instance().clear(f1x::openauto::autoapp::StateFlag::EntityExit);
         }
     }
     catch (...)
@@ -2323,7 +2352,7 @@ void f1x::openauto::autoapp::ui::MainWindow::tmpChanged()
     }
 
     // update day/night state
-    this->nightModeEnabled = check_file_exist("/tmp/night_mode_enabled");
+    this->nightModeEnabled = f1x::openauto::autoapp::StateBus::instance().isSet(f1x::openauto::autoapp::StateFlag::NightMode);
 
     if (this->nightModeEnabled)
     {
@@ -2347,7 +2376,7 @@ void f1x::openauto::autoapp::ui::MainWindow::tmpChanged()
     {
 
         // check if dashcam is recording
-        this->dashCamRecording = check_file_exist("/tmp/dashcam_is_recording");
+        this->dashCamRecording = f1x::openauto::autoapp::StateBus::instance().isSet(f1x::openauto::autoapp::StateFlag::DashcamRecording);
 
         if (this->dashCamRecording)
         {
@@ -2392,7 +2421,7 @@ void f1x::openauto::autoapp::ui::MainWindow::tmpChanged()
         f1x::openauto::autoapp::ui::MainWindow::MainWindow::exit();
     }
 
-    this->hotspotActive = check_file_exist("/tmp/hotspot_active");
+    this->hotspotActive = f1x::openauto::autoapp::StateBus::instance().isSet(f1x::openauto::autoapp::StateFlag::HotspotActive);
 
     // hide wifi if hotspot disabled and force wifi unselected
     if (!this->hotspotActive && !std::ifstream("/tmp/mobile_hotspot_detected"))
@@ -2649,7 +2678,7 @@ void f1x::openauto::autoapp::ui::MainWindow::tmpChanged()
         }
     }
 
-    if (std::ifstream("/tmp/btdevice") || std::ifstream("/tmp/media_playing") || std::ifstream("/tmp/dev_mode_enabled") || std::ifstream("/tmp/android_device"))
+    if (f1x::openauto::autoapp::StateBus::instance().isSet(f1x::openauto::autoapp::StateFlag::BluetoothDevice) || std::ifstream("/tmp/media_playing") || std::ifstream("/tmp/dev_mode_enabled") || std::ifstream("/tmp/android_device"))
     {
         if (ui_->labelLock->isVisible() == false)
         {
@@ -0,0 +1,145 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QCoreApplication>
+#include <algorithm>
+#include <f1x/openauto/autoapp/UI/NotificationModel.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace ui
+            {
+
+                bool NotificationModel::Toast::operator==(const Toast &other) const
+                {
+                    return id == other.id && title == other.title && text == other.text && count == other.count;
+                }
+
+                NotificationModel &NotificationModel::instance()
+                {
+                    static NotificationModel model;
+                    return model;
+                }
+
+                NotificationModel::NotificationModel()
+                {
+                    if (QCoreApplication::instance() && thread() != QCoreApplication::instance()->thread())
+                        moveToThread(QCoreApplication::instance()->thread());
+                }
+
+                int NotificationModel::rowCount(const QModelIndex &parent) const
+                {
+                    return parent.isValid() ? 0 : toasts_.size();
+                }
+
+                QVariant NotificationModel::data(const QModelIndex &index, int role) const
+                {
+                    if (!index.isValid() || index.row() >= toasts_.size())
+                        return QVariant();
+
+                    const Toast &toast = toasts_.at(index.row());
+                    switch (role)
+                    {
+                    case IdRole:
+                        return toast.id;
+                    case TitleRole:
+                        return toast.title;
+                    case TextRole:
+                        return toast.text;
+                    case CountRole:
+                        return toast.count;
+                    default:
+                        return QVariant();
+                    }
+                }
+
+                QHash<int, QByteArray> NotificationModel::roleNames() const
+                {
+                    return {
+                        {IdRole, "notificationId"},
+                        {TitleRole, "title"},
+                        {TextRole, "text"},
+                        {CountRole, "count"}};
+                }
+
+                int NotificationModel::count() const
+                {
+                    return toasts_.size();
+                }
+
+                void NotificationModel::publish(QVector<Toast> toasts)
+                {
+                    QMetaObject::invokeMethod(this, [this, toasts = std::move(toasts)]()
+                                              { apply(toasts); }, Qt::QueuedConnection);
+                }
+
+                void NotificationModel::apply(const QVector<Toast> &toasts)
+                {
+                    const int before = toasts_.size();
+
+                    // Gone first, from the end so the rows above keep their index
+                    for (int row = toasts_.size() - 1; row >= 0; --row)
+                    {
+                        const QString &id = toasts_.at(row).id;
+                        const bool kept = std::any_of(toasts.begin(), toasts.end(), [&id](const Toast &t)
+                                                      { return t.id == id; });
+                        if (!kept)
+                        {
+                            beginRemoveRows(QModelIndex(), row, row);
+                            toasts_.removeAt(row);
+                            endRemoveRows();
+                        }
+                    }
+
+                    // What is left is a prefix of the snapshot; only changed rows are signalled
+                    for (int row = 0; row < toasts_.size(); ++row)
+                    {
+                        if (toasts_.at(row).id != toasts.at(row).id)
+                        {
+                            // Reordered, which the service does not do: start over
+                            beginResetModel();
+                            toasts_ = toasts;
+                            endResetModel();
+                            break;
+                        }
+                        if (toasts_.at(row) == toasts.at(row))
+                            continue;
+                        toasts_[row] = toasts.at(row);
+                        const QModelIndex changed = index(row);
+                        emit dataChanged(changed, changed, {TitleRole, TextRole, CountRole});
+                    }
+
+                    if (toasts.size() > toasts_.size())
+                    {
+                        beginInsertRows(QModelIndex(), toasts_.size(), toasts.size() - 1);
+                        toasts_ += toasts.mid(toasts_.size());
+                        endInsertRows();
+                    }
+
+                    if (toasts_.size() != before)
+                        emit countChanged();
+                }
+
+            } // namespace ui
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -34,6 +34,7 @@
 #include <QTextStream>
 #include <QTimer>
 #include <f1x/openauto/autoapp/Projection/AudioDeviceList.hpp>
+#include <f1x/openauto/autoapp/Projection/RtAudioOutput.hpp>
 #include <f1x/openauto/autoapp/UI/SettingsWindow.hpp>
 #include <fstream>
 #include <string>
@@ -144,16 +145,12 @@ namespace f1x::openauto::autoapp::ui
     connect(ui_->pushButtonRefreshAudioInputDevices, &QPushButton::clicked, this,
             &SettingsWindow::onRefreshAudioInputDevices);
 
-    // Initialize audio device list
-    populateAudioDeviceComboBox();
-    populateAudioInputDeviceComboBox();
-
-    // Initialize audio level metering
+    // Audio devices are listed on the first show, and the timers only run
+    // while the window is shown: see showEvent()
     audioLevelProcess_ = nullptr;
     audioMeterTimer_ = new QTimer(this);
     connect(audioMeterTimer_, &QTimer::timeout, this,
             &SettingsWindow::updateAudioLevels);
-    audioMeterTimer_->start(200); // Update every 200ms
 
     // Hide meter progress bars initially
     ui_->labelTestInProgress->setVisible(false);
@@ -275,9 +272,8 @@ namespace f1x::openauto::autoapp::ui
       ui_->pushButtonSambaStart->show();
     }
 
-    QTimer *refresh = new QTimer(this);
-    connect(refresh, SIGNAL(timeout()), this, SLOT(updateInfo()));
-    refresh->start(5000);
+    refreshTimer_ = new QTimer(this);
+    connect(refreshTimer_, SIGNAL(timeout()), this, SLOT(updateInfo()));
   }
 
   SettingsWindow::~SettingsWindow() { delete ui_; }
@@ -511,9 +507,15 @@ namespace f1x::openauto::autoapp::ui
     //  TODO: Add CheckBox In
     configuration_->setTelephonyAudioChannelEnabled(true);
 
-    // Save selected audio output device
+    // Save selected audio output device, moving a session's streams over
     QString selectedDeviceName =
         ui_->comboBoxAudioOutputDevice->currentData().toString();
+    if (selectedDeviceName.toStdString() !=
+        configuration_->getAudioOutputDeviceName()) {
+      projection::RtAudioOutput::switchAllDevices(
+          projection::AudioDeviceList::findOutputDeviceByName(
+              selectedDeviceName.toStdString()));
+    }
     configuration_->setAudioOutputDeviceName(selectedDeviceName.toStdString());
 
     // Save selected audio input device
@@ -818,7 +820,23 @@ namespace f1x::openauto::autoapp::ui
   void SettingsWindow::showEvent(QShowEvent *event)
   {
     QWidget::showEvent(event);
+    if (!audioDevicesListed_)
+    {
+      // RtAudio probes every device to list them; load() selects from the lists
+      populateAudioDeviceComboBox();
+      populateAudioInputDeviceComboBox();
+      audioDevicesListed_ = true;
+    }
     this->load();
+    audioMeterTimer_->start(200); // Update every 200ms
+    refreshTimer_->start(5000);
+  }
+
+  void SettingsWindow::hideEvent(QHideEvent *event)
+  {
+    QWidget::hideEvent(event);
+    audioMeterTimer_->stop();
+    refreshTimer_->stop();
   }
 
   void SettingsWindow::load()
@@ -2264,6 +2282,10 @@ void f1x::openauto::autoapp::ui::SettingsWindow::onRefreshAudioInputDevices()
 
 void f1x::openauto::autoapp::ui::SettingsWindow::updateAudioLevels()
 {
+  // Each sample holds the microphone for a second: only for the audio page
+  if (!ui_->tab3->isVisible())
+    return;
+
   // Update input level using arecord to sample microphone
   // We use a quick sample and analyze peak level
   static int inputDecayLevel = 0;
@@ -0,0 +1,166 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QSocketNotifier>
+#include <f1x/openauto/autoapp/UI/SystemVolume.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#include <alsa/asoundlib.h>
+#include <algorithm>
+#include <cmath>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace ui
+            {
+
+                SystemVolume::SystemVolume(const QString &control, QObject *parent)
+                    : QObject(parent), mixer_(nullptr), element_(nullptr), min_(0), max_(0), percent_(-1)
+                {
+                    if (snd_mixer_open(&mixer_, 0) < 0)
+                    {
+                        mixer_ = nullptr;
+                        OPENAUTO_LOG(warning) << "[SystemVolume] Could not open the ALSA mixer";
+                        return;
+                    }
+
+                    snd_mixer_selem_id_t *id;
+                    snd_mixer_selem_id_alloca(&id);
+                    snd_mixer_selem_id_set_name(id, control.toUtf8().constData());
+
+                    if (snd_mixer_attach(mixer_, "default") < 0 ||
+                        snd_mixer_selem_register(mixer_, nullptr, nullptr) < 0 ||
+                        snd_mixer_load(mixer_) < 0 ||
+                        (element_ = snd_mixer_find_selem(mixer_, id)) == nullptr ||
+                        !snd_mixer_selem_has_playback_volume(element_))
+                    {
+                        OPENAUTO_LOG(warning) << "[SystemVolume] No playback control '" << control.toStdString() << "'";
+                        close();
+                        return;
+                    }
+
+                    snd_mixer_selem_get_playback_volume_range(element_, &min_, &max_);
+                    snd_mixer_elem_set_callback_private(element_, this);
+                    snd_mixer_elem_set_callback(element_, &SystemVolume::onElementEvent);
+
+                    // The event loop wakes only when the control actually changes
+                    const int count = snd_mixer_poll_descriptors_count(mixer_);
+                    std::vector<pollfd> fds(std::max(count, 0));
+                    const int filled = snd_mixer_poll_descriptors(mixer_, fds.data(), fds.size());
+                    for (int i = 0; i < filled; ++i)
+                    {
+                        auto *notifier = new QSocketNotifier(fds[i].fd, QSocketNotifier::Read, this);
+                        connect(notifier, &QSocketNotifier::activated, this, &SystemVolume::onMixerEvent);
+                        notifiers_.push_back(notifier);
+                    }
+
+                    percent_ = readPercent();
+                    OPENAUTO_LOG(info) << "[SystemVolume] " << control.toStdString() << " at " << percent_ << "%";
+                }
+
+                SystemVolume::~SystemVolume()
+                {
+                    close();
+                }
+
+                void SystemVolume::close()
+                {
+                    for (auto *notifier : notifiers_)
+                        delete notifier;
+                    notifiers_.clear();
+
+                    element_ = nullptr;
+                    if (mixer_)
+                    {
+                        snd_mixer_close(mixer_);
+                        mixer_ = nullptr;
+                    }
+                }
+
+                bool SystemVolume::isAvailable() const
+                {
+                    return element_ != nullptr;
+                }
+
+                int SystemVolume::percent() const
+                {
+                    return percent_;
+                }
+
+                void SystemVolume::setPercent(int percent)
+                {
+                    if (!element_ || max_ <= min_)
+                        return;
+
+                    percent = std::clamp(percent, 0, 100);
+                    const long raw = min_ + std::lround((max_ - min_) * percent / 100.0);
+                    if (snd_mixer_selem_set_playback_volume_all(element_, raw) < 0)
+                    {
+                        OPENAUTO_LOG(warning) << "[SystemVolume] Could not set volume to " << percent << "%";
+                        return;
+                    }
+                    // The echo of this write comes back as an event; it then matches
+                    percent_ = percent;
+                }
+
+                int SystemVolume::onElementEvent(snd_mixer_elem_t *element, unsigned int mask)
+                {
+                    auto *self = static_cast<SystemVolume *>(snd_mixer_elem_get_callback_private(element));
+                    if (mask == SND_CTL_EVENT_MASK_REMOVE)
+                    {
+                        // Card unplugged; the element is freed after this returns
+                        OPENAUTO_LOG(warning) << "[SystemVolume] Mixer control removed";
+                        self->element_ = nullptr;
+                        return 0;
+                    }
+                    if (mask & SND_CTL_EVENT_MASK_VALUE)
+                        self->refresh();
+                    return 0;
+                }
+
+                void SystemVolume::onMixerEvent()
+                {
+                    if (mixer_)
+                        snd_mixer_handle_events(mixer_);
+                }
+
+                void SystemVolume::refresh()
+                {
+                    const int current = readPercent();
+                    if (current < 0 || current == percent_)
+                        return;
+                    percent_ = current;
+                    emit percentChanged(percent_);
+                }
+
+                int SystemVolume::readPercent() const
+                {
+                    long value = 0;
+                    if (!element_ || max_ <= min_ ||
+                        snd_mixer_selem_get_playback_volume(element_, SND_MIXER_SCHN_FRONT_LEFT, &value) < 0)
+                        return -1;
+                    return static_cast<int>(std::lround((value - min_) * 100.0 / (max_ - min_)));
+                }
+
+            } // namespace ui
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -17,14 +17,28 @@
 */
 
 #include <QDateTime>
+#include <QEvent>
 #include <QFile>
-#include <QProcess>
+#include <QFileSystemWatcher>
 #include <QCoreApplication>
 #include <QGuiApplication>
 #include <QNetworkInterface>
+#include <QPointer>
 #include <QCursor>
 #include <sys/sysinfo.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/PipelineTrace.hpp>
+#include <f1x/openauto/autoapp/StateBus.hpp>
 #include <f1x/openauto/autoapp/UI/UIBackend.hpp>
+#include <f1x/openauto/autoapp/UI/SystemVolume.hpp>
+#include <f1x/openauto/autoapp/UI/WifiStatus.hpp>
+#include <f1x/openauto/autoapp/Projection/AudioDeviceList.hpp>
+#include <f1x/openauto/autoapp/Projection/FrameGrabber.hpp>
+#include <f1x/openauto/autoapp/Projection/RtAudioOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
 #include <f1x/openauto/Common/Log.hpp>
 
 namespace f1x
@@ -38,7 +52,7 @@ namespace f1x
 
                 UIBackend::UIBackend(configuration::IConfiguration::Pointer configuration,
                                      QObject *parent)
-                    : QObject(parent), configuration_(std::move(configuration)), clockTimer_(new QTimer(this)), systemInfoTimer_(new QTimer(this)), currentTime_("00:00"), networkSSID_(""), networkConnectionType_("Not Connected"), wifiIP_(""), bluetoothConnected_(false), wifiConnected_(false), volume_(80), use24HourFormat_(true), freeMemory_("N/A"), cpuFrequency_("N/A"), cpuTemperature_("N/A"), disconnectTimeout_(60), shutdownTimeout_(0), disableShutdown_(false), disableScreenOff_(false), debugMode_(false), hotspotEnabled_(false), bluetoothAutoPair_(false), trackTitle_(""), albumName_(""), artistName_(""), albumArtPath_(""), isPlaying_(false)
+                    : QObject(parent), configuration_(std::move(configuration)), clockTimer_(new QTimer(this)), systemInfoTimer_(new QTimer(this)), systemVolume_(new SystemVolume("Master", this)), wifiStatus_(new WifiStatus("wlan0", this)), audioRescanTimer_(new QTimer(this)), audioScanThread_(new QThread(this)), audioScanContext_(new QObject()), metricsTimer_(new QTimer(this)), currentTime_("00:00"), networkSSID_(""), networkConnectionType_("Not Connected"), wifiIP_(""), bluetoothConnected_(false), wifiConnected_(false), phoneStatusSubscription_(0), nightModeSubscription_(0), volume_(80), use24HourFormat_(true), freeMemory_("N/A"), cpuFrequency_("N/A"), cpuTemperature_("N/A"), videoStats_("N/A"), cpuFreqFd_(openSysfs("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_cur_freq")), thermalFd_(openSysfs("/sys/class/thermal/thermal_zone0/temp")), freeMemoryMB_(-1), cpuFrequencyMHz_(-1), cpuTemperatureC_(-1), telemetrySubscribers_(0), projecting_(false), uiAboveVideo_(false), nightMode_(StateBus::instance().isSet(StateFlag::NightMode)), idle_(false), disconnectTimeout_(60), shutdownTimeout_(0), disableShutdown_(false), disableScreenOff_(false), debugMode_(false), hotspotEnabled_(false), bluetoothAutoPair_(false), trackTitle_(""), albumName_(""), artistName_(""), albumArtPath_(""), isPlaying_(false)
                 {
                     // Load persisted clock format preference
                     QFile clockFmtFile("/tmp/.openauto_clockformat");
@@ -49,31 +63,58 @@ namespace f1x
                         use24HourFormat_ = (val != "12");
                     }
 
-                    // Read initial system volume from amixer
-                    QProcess amixerRead;
-                    amixerRead.start("amixer", QStringList() << "get" << "Master");
-                    if (amixerRead.waitForFinished(1000))
+                    // Mixer events keep volume_ in step with other ALSA clients
+                    if (systemVolume_->isAvailable())
                     {
-                        QString output = QString::fromUtf8(amixerRead.readAllStandardOutput());
-                        // Parse "[XX%]" from output
-                        int pctStart = output.indexOf('[');
-                        int pctEnd = output.indexOf("%]");
-                        if (pctStart >= 0 && pctEnd > pctStart)
-                        {
-                            QString pctStr = output.mid(pctStart + 1, pctEnd - pctStart - 1);
-                            volume_ = pctStr.toInt();
-                            OPENAUTO_LOG(info) << "[UIBackend] Initial system volume: " << volume_ << "%";
-                        }
+                        volume_ = systemVolume_->percent();
+                        OPENAUTO_LOG(info) << "[UIBackend] Initial system volume: " << volume_ << "%";
                     }
-                    // Update clock every second
+                    connect(systemVolume_, &SystemVolume::percentChanged, this, [this](int percent)
+                            {
+                        if (volume_ == percent)
+                            return;
+                        volume_ = percent;
+                        emit volumeChanged(); });
+
+                    connect(wifiStatus_, &WifiStatus::ssidChanged, this, &UIBackend::updateNetwork);
+
+                    // The phone's status changes on the bus thread; it is applied here
+                    phoneStatusSubscription_ = StateBus::instance().subscribe(StateFlag::PhoneStatus, [this](StateFlag, bool)
+                                                                              { QMetaObject::invokeMethod(this, &UIBackend::updatePhoneStatus, Qt::QueuedConnection); });
+                    updatePhoneStatus();
+
+                    // Set from the light sensor, GPS or scripts, on their threads
+                    nightModeSubscription_ = StateBus::instance().subscribe(StateFlag::NightMode, [this](StateFlag, bool night)
+                                                                            { QMetaObject::invokeMethod(this, [this, night]()
+                                                                                                        {
+                        if (nightMode_ == night)
+                            return;
+                        nightMode_ = night;
+                        emit nightModeChanged(); }, Qt::QueuedConnection); });
+
+                    // The clock shows minutes: wake once per minute, on the boundary
+                    clockTimer_->setSingleShot(true);
+                    clockTimer_->setTimerType(Qt::PreciseTimer);
                     connect(clockTimer_, &QTimer::timeout, this, &UIBackend::updateClock);
-                    clockTimer_->start(1000);
                     updateClock();
 
-                    // Update system info every 5 seconds
+                    // System info is sampled only while a page shows it, and not
+                    // at all while the projection covers the UI
+                    systemInfoTimer_->setInterval(cSystemInfoIntervalMs);
                     connect(systemInfoTimer_, &QTimer::timeout, this, &UIBackend::updateSystemInfo);
-                    systemInfoTimer_->start(5000);
-                    updateSystemInfo();
+                    connect(this, &UIBackend::androidAutoStarted, this, [this]()
+                            { setProjectionActive(true); });
+                    connect(this, &UIBackend::androidAutoStopped, this, [this]()
+                            { setProjectionActive(false); });
+
+                    // The overlay is a debugging aid: without it nothing is formatted
+                    metricsTimer_->setInterval(cMetricsIntervalMs);
+                    connect(metricsTimer_, &QTimer::timeout, this, &UIBackend::updateMetrics);
+                    if (metricsOverlay())
+                    {
+                        metricsTimer_->start();
+                        updateMetrics();
+                    }
 
                     // Load crankshaft environment values if available
                     if (configuration_)
@@ -104,14 +145,36 @@ namespace f1x
 
                     OPENAUTO_LOG(info) << "[UIBackend] Initialized with full property support";
 
-                    // Enumerate audio devices
+                    // Enumerate audio devices now and whenever cards come or go
+                    audioOutputDevices_ << "Default";
+                    audioInputDevices_ << "Default";
+                    audioScanContext_->moveToThread(audioScanThread_);
+                    audioScanThread_->setObjectName("oa-audiodevices");
+                    audioScanThread_->start(QThread::LowPriority);
+
+                    audioRescanTimer_->setSingleShot(true);
+                    audioRescanTimer_->setInterval(cAudioRescanDelayMs);
+                    connect(audioRescanTimer_, &QTimer::timeout, this, &UIBackend::enumerateAudioDevices);
+                    auto *sndWatcher = new QFileSystemWatcher(QStringList() << "/dev/snd", this);
+                    connect(sndWatcher, &QFileSystemWatcher::directoryChanged, audioRescanTimer_, QOverload<>::of(&QTimer::start));
+
                     enumerateAudioDevices();
                 }
 
                 UIBackend::~UIBackend()
                 {
+                    StateBus::instance().unsubscribe(phoneStatusSubscription_);
+                    StateBus::instance().unsubscribe(nightModeSubscription_);
                     clockTimer_->stop();
                     systemInfoTimer_->stop();
+                    audioScanThread_->quit();
+                    audioScanThread_->wait();
+                    delete audioScanContext_;
+
+                    if (cpuFreqFd_ >= 0)
+                        ::close(cpuFreqFd_);
+                    if (thermalFd_ >= 0)
+                        ::close(thermalFd_);
                 }
 
                 // ========== Clock/Time Getters ==========
@@ -177,6 +240,31 @@ namespace f1x
                     return "N/A";
                 }
 
+                int UIBackend::phoneSignal() const
+                {
+                    return phoneStatus_.signalStrength;
+                }
+
+                int UIBackend::phoneBattery() const
+                {
+                    return phoneStatus_.batteryLevel;
+                }
+
+                bool UIBackend::phoneBatteryCritical() const
+                {
+                    return phoneStatus_.batteryCritical;
+                }
+
+                bool UIBackend::phoneInCall() const
+                {
+                    return phoneStatus_.inCall();
+                }
+
+                QString UIBackend::phoneCaller() const
+                {
+                    return QString::fromStdString(phoneStatus_.caller);
+                }
+
                 // ========== General Settings Getters ==========
                 bool UIBackend::showClock() const
                 {
@@ -286,6 +374,11 @@ namespace f1x
                     return configuration_ ? configuration_->getOMXLayerIndex() : 0;
                 }
 
+                bool UIBackend::videoCompositorImport() const
+                {
+                    return configuration_ ? configuration_->getVideoCompositorImport() : false;
+                }
+
                 // ========== Audio Settings Getters ==========
                 QString UIBackend::audioOutputDevice() const
                 {
@@ -395,6 +488,48 @@ namespace f1x
                     return cpuTemperature_;
                 }
 
+                QString UIBackend::videoStats() const
+                {
+                    return videoStats_;
+                }
+
+                bool UIBackend::metricsOverlay() const
+                {
+                    return configuration_ != nullptr && configuration_->getMetricsOverlay();
+                }
+
+                QString UIBackend::metricsSummary() const
+                {
+                    return metricsSummary_;
+                }
+
+                void UIBackend::updateMetrics()
+                {
+                    const QString summary = QString::fromStdString(Metrics::instance().summary()).trimmed();
+                    if (summary == metricsSummary_)
+                        return;
+                    metricsSummary_ = summary;
+                    emit metricsChanged();
+                }
+
+                void UIBackend::updatePhoneStatus()
+                {
+                    // Cleared when the phone goes away, which reads as all unknown
+                    PhoneStatus status;
+                    const std::string line = StateBus::instance().value(StateFlag::PhoneStatus);
+                    if (!line.empty() && !PhoneStatus::parse(line, status))
+                        return;
+
+                    const uint32_t changed = status.diff(phoneStatus_);
+                    phoneStatus_ = std::move(status);
+                    if (changed & PhoneStatus::Signal)
+                        emit phoneSignalChanged();
+                    if (changed & PhoneStatus::Battery)
+                        emit phoneBatteryChanged();
+                    if (changed & PhoneStatus::CallState)
+                        emit phoneCallChanged();
+                }
+
                 int UIBackend::disconnectTimeout() const
                 {
                     return disconnectTimeout_;
@@ -420,6 +555,16 @@ namespace f1x
                     return debugMode_;
                 }
 
+                bool UIBackend::pipelineTracing() const
+                {
+                    return PipelineTrace::instance().enabled();
+                }
+
+                QString UIBackend::traceFile() const
+                {
+                    return traceFile_;
+                }
+
                 // ========== About Getters ==========
                 QString UIBackend::versionString() const
                 {
@@ -661,6 +806,12 @@ namespace f1x
                         configuration_->save();
                         emit settingsChanged();
                         OPENAUTO_LOG(info) << "[UIBackend] Audio output device set to: " << device.toStdString();
+
+                        // Moves a session's streams over at once; opening them
+                        // blocks, so off the GUI thread with the device scans
+                        QMetaObject::invokeMethod(audioScanContext_, [name = device.toStdString()]()
+                                                  { projection::RtAudioOutput::switchAllDevices(
+                                                        projection::AudioDeviceList::findOutputDeviceByName(name)); }, Qt::QueuedConnection);
                     }
                 }
 
@@ -744,27 +895,44 @@ namespace f1x
                 void UIBackend::setDebugMode(bool value)
                 {
                     debugMode_ = value;
+                    if (!debugMode_)
+                        setPipelineTracing(false);
                     emit settingsChanged();
                 }
 
+                void UIBackend::setPipelineTracing(bool value)
+                {
+                    auto &trace = PipelineTrace::instance();
+                    if (value == trace.enabled() || (value && !debugMode_))
+                        return;
+#ifndef OPENAUTO_PIPELINE_TRACE
+                    OPENAUTO_LOG(warning) << "[UIBackend] Built without PIPELINE_TRACE, nothing to record";
+                    return;
+#endif
+
+                    if (value)
+                    {
+                        trace.start();
+                    }
+                    else
+                    {
+                        trace.stop();
+                        const QString path = "/tmp/openauto-trace-" +
+                                             QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".json";
+                        if (trace.dump(path.toStdString()))
+                            traceFile_ = path;
+                    }
+                    emit pipelineTracingChanged();
+                }
+
                 void UIBackend::setVolume(int value)
                 {
                     if (volume_ != value)
                     {
                         volume_ = value;
 
-                        // Map 0-100 percentage to 0-255 raw value for ALSA Master control
-                        int rawValue = static_cast<int>(value * 255.0 / 100.0 + 0.5);
-                        if (rawValue > 255)
-                            rawValue = 255;
-                        if (rawValue < 0)
-                            rawValue = 0;
-
-                        // Set system volume via amixer using raw value
-                        QProcess *proc = new QProcess();
-                        proc->start("amixer", QStringList() << "set" << "Master" << QString::number(rawValue));
-                        QObject::connect(proc, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-                                         proc, &QProcess::deleteLater);
+                        // Scaled over the control's own range, not a fixed 0-255
+                        systemVolume_->setPercent(value);
 
                         emit volumeChanged();
                     }
@@ -813,6 +981,33 @@ namespace f1x
                     emit requestGoBack();
                 }
 
+                void UIBackend::saveVideoFrame()
+                {
+                    const QString path = "/tmp/openauto_frame_" + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + ".jpg";
+                    QPointer<UIBackend> self(this);
+                    const auto saved = [self, path](const projection::FrameGrabber::Snapshot &snapshot)
+                    {
+                        QString result;
+                        QFile file(path);
+                        if (!snapshot.jpeg.empty() && file.open(QIODevice::WriteOnly) &&
+                            file.write(reinterpret_cast<const char *>(snapshot.jpeg.data()), static_cast<qint64>(snapshot.jpeg.size())) ==
+                                static_cast<qint64>(snapshot.jpeg.size()))
+                        {
+                            result = path;
+                        }
+                        OPENAUTO_LOG(info) << "[UIBackend] Video frame " << (result.isEmpty() ? "not saved: " + snapshot.error : "saved to " + path.toStdString());
+                        QMetaObject::invokeMethod(QCoreApplication::instance(), [self, result]()
+                                                  {
+                                                      if (self)
+                                                          emit self->videoFrameSaved(result); }, Qt::QueuedConnection);
+                    };
+                    // Full size: this is for looking at colours, not for a thumbnail
+                    if (!projection::FrameGrabber::instance().grab(saved, 1920))
+                    {
+                        emit videoFrameSaved(QString());
+                    }
+                }
+
                 void UIBackend::saveSettings()
                 {
                     OPENAUTO_LOG(info) << "[UIBackend] Save settings requested";
@@ -836,6 +1031,12 @@ namespace f1x
                     emit requestUnpairAll();
                 }
 
+                void UIBackend::pairNewPhone()
+                {
+                    OPENAUTO_LOG(info) << "[UIBackend] Pairing window requested";
+                    emit requestPairing();
+                }
+
                 // ========== Music Control Methods ==========
                 void UIBackend::previousTrack()
                 {
@@ -941,46 +1142,221 @@ namespace f1x
                 // ========== Timer Slots ==========
                 void UIBackend::updateClock()
                 {
+                    const QDateTime now = QDateTime::currentDateTime();
                     QString newTime = use24HourFormat_
-                                          ? QDateTime::currentDateTime().toString("HH:mm")
-                                          : QDateTime::currentDateTime().toString("h:mm");
+                                          ? now.toString("HH:mm")
+                                          : now.toString("h:mm");
                     if (currentTime_ != newTime)
                     {
                         currentTime_ = newTime;
                         emit currentTimeChanged();
                     }
+
+                    // Re-armed for just past the next minute, which also covers
+                    // the date and AM/PM rolling over
+                    const QTime time = now.time();
+                    clockTimer_->start(60000 - (time.second() * 1000 + time.msec()) + 50);
+                }
+
+                int UIBackend::openSysfs(const char *path)
+                {
+                    // Kept open for the process lifetime and re-read with pread
+                    return ::open(path, O_RDONLY | O_CLOEXEC);
+                }
+
+                bool UIBackend::readSysfs(int fd, long &value)
+                {
+                    if (fd < 0)
+                        return false;
+
+                    char buffer[32];
+                    // sysfs regenerates the attribute on every read at offset 0
+                    const ssize_t bytes = ::pread(fd, buffer, sizeof(buffer) - 1, 0);
+                    if (bytes <= 0)
+                        return false;
+                    buffer[bytes] = '\0';
+                    value = std::strtol(buffer, nullptr, 10);
+                    return true;
+                }
+
+                void UIBackend::subscribeTelemetry()
+                {
+                    ++telemetrySubscribers_;
+                    updateTelemetryTimer();
+                }
+
+                void UIBackend::unsubscribeTelemetry()
+                {
+                    if (telemetrySubscribers_ > 0)
+                        --telemetrySubscribers_;
+                    updateTelemetryTimer();
+                }
+
+                bool UIBackend::projectionActive() const
+                {
+                    return projecting_;
+                }
+
+                void UIBackend::setProjectionActive(bool active)
+                {
+                    if (projecting_ == active)
+                        return;
+                    projecting_ = active;
+                    OPENAUTO_LOG(info) << "[UIBackend] Projection " << (active ? "active: pausing UI timers" : "ended: resuming UI timers");
+
+                    // Nothing the clock drives is on screen under the video
+                    if (active)
+                        clockTimer_->stop();
+                    else
+                        updateClock();
+
+                    updateTelemetryTimer();
+                    emit projectionActiveChanged();
+                }
+
+                bool UIBackend::uiAboveVideo() const
+                {
+                    return uiAboveVideo_;
+                }
+
+                void UIBackend::setUiAboveVideo(bool above)
+                {
+                    if (uiAboveVideo_ == above)
+                        return;
+                    uiAboveVideo_ = above;
+                    OPENAUTO_LOG(info) << "[UIBackend] Overlays " << (above ? "above" : "below") << " the video plane";
+                    emit uiAboveVideoChanged();
+                }
+
+                bool UIBackend::nightMode() const
+                {
+                    return nightMode_;
+                }
+
+                void UIBackend::setThermalLevel(ThermalLevel level)
+                {
+                    const int stretch = 1 << static_cast<int>(level);
+                    systemInfoTimer_->setInterval(cSystemInfoIntervalMs * stretch);
+                    metricsTimer_->setInterval(cMetricsIntervalMs * stretch);
+                }
+
+                void UIBackend::setIdle(bool idle)
+                {
+                    if (idle_ == idle)
+                        return;
+                    idle_ = idle;
+
+                    if (idle)
+                    {
+                        clockTimer_->stop();
+                        metricsTimer_->stop();
+                    }
+                    else
+                    {
+                        // Catch up on the minutes missed while the screen was off
+                        if (!projecting_)
+                            updateClock();
+                        if (metricsOverlay())
+                            metricsTimer_->start();
+                    }
+                    updateTelemetryTimer();
+                }
+
+                bool UIBackend::eventFilter(QObject *watched, QEvent *event)
+                {
+                    // Once per press, at the window, not again for each item it reaches
+                    if (!watched->isWindowType())
+                        return QObject::eventFilter(watched, event);
+
+                    switch (event->type())
+                    {
+                    case QEvent::TouchBegin:
+                    case QEvent::MouseButtonPress:
+                    case QEvent::KeyPress:
+                        emit userActivity();
+                        // The screen was dark: this press was not aimed at anything
+                        return idle_;
+                    default:
+                        return QObject::eventFilter(watched, event);
+                    }
+                }
+
+                void UIBackend::updateTelemetryTimer()
+                {
+                    const bool wanted = telemetrySubscribers_ > 0 && !projecting_ && !idle_;
+                    if (wanted == systemInfoTimer_->isActive())
+                        return;
+
+                    if (wanted)
+                    {
+                        systemInfoTimer_->start();
+                        // Fresh values for the page that just appeared
+                        updateSystemInfo();
+                    }
+                    else
+                    {
+                        systemInfoTimer_->stop();
+                    }
                 }
 
                 void UIBackend::updateSystemInfo()
                 {
+                    bool changed = false;
+
                     // Free memory
                     struct sysinfo info;
                     if (sysinfo(&info) == 0)
                     {
-                        long freeMB = info.freeram / 1024 / 1024;
-                        freeMemory_ = QString::number(freeMB) + " MB";
+                        const long freeMB = static_cast<long>(static_cast<quint64>(info.freeram) * info.mem_unit / 1024 / 1024);
+                        if (freeMB != freeMemoryMB_)
+                        {
+                            freeMemoryMB_ = freeMB;
+                            freeMemory_ = QString::number(freeMB) + " MB";
+                            changed = true;
+                        }
                     }
 
                     // CPU frequency
-                    QFile freqFile("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_cur_freq");
-                    if (freqFile.open(QIODevice::ReadOnly))
+                    long value = 0;
+                    if (readSysfs(cpuFreqFd_, value) && value / 1000 != cpuFrequencyMHz_)
                     {
-                        QString freqStr = QString::fromUtf8(freqFile.readAll()).trimmed();
-                        int freqKHz = freqStr.toInt();
-                        cpuFrequency_ = QString::number(freqKHz / 1000) + " MHz";
-                        freqFile.close();
+                        cpuFrequencyMHz_ = value / 1000;
+                        cpuFrequency_ = QString::number(cpuFrequencyMHz_) + " MHz";
+                        changed = true;
                     }
 
                     // CPU temperature
-                    QFile tempFile("/sys/class/thermal/thermal_zone0/temp");
-                    if (tempFile.open(QIODevice::ReadOnly))
+                    if (readSysfs(thermalFd_, value) && value / 1000 != cpuTemperatureC_)
                     {
-                        QString tempStr = QString::fromUtf8(tempFile.readAll()).trimmed();
-                        int tempMilliC = tempStr.toInt();
-                        cpuTemperature_ = QString::number(tempMilliC / 1000) + " °C";
-                        tempFile.close();
+                        cpuTemperatureC_ = value / 1000;
+                        cpuTemperature_ = QString::number(cpuTemperatureC_) + " °C";
+                        changed = true;
                     }
 
+                    // Video pipeline latency (computing percentiles is not free, so
+                    // only while the debug overlay can show it)
+                    if (debugMode_)
+                    {
+                        const QString stats = QString::fromStdString(
+                            projection::VideoTelemetry::instance().summary());
+                        if (stats != videoStats_)
+                        {
+                            videoStats_ = stats;
+                            changed = true;
+                        }
+                    }
+
+                    if (changed)
+                        emit systemInfoChanged();
+
+                    updateNetwork();
+                }
+
+                void UIBackend::updateNetwork()
+                {
+                    if (telemetrySubscribers_ == 0)
+                        return;
+
                     // Network status polling
                     QString newConnectionType = "Not Connected";
                     QString newIP = "N/A";
@@ -1034,12 +1410,7 @@ namespace f1x
                             ssidFile.close();
                         }
                         if (newSSID.isEmpty())
-                        {
-                            QProcess iwgetid;
-                            iwgetid.start("iwgetid", QStringList() << "-r");
-                            if (iwgetid.waitForFinished(500))
-                                newSSID = QString::fromUtf8(iwgetid.readAllStandardOutput()).trimmed();
-                        }
+                            newSSID = wifiStatus_->ssid();
                     }
 
                     bool networkChanged = false;
@@ -1064,65 +1435,44 @@ namespace f1x
                         networkChanged = true;
                     }
 
-                    emit systemInfoChanged();
                     if (networkChanged)
                         emit this->networkChanged();
                 }
 
                 void UIBackend::enumerateAudioDevices()
                 {
-                    audioOutputDevices_.clear();
-                    audioInputDevices_.clear();
-                    audioOutputDevices_ << "Default";
-                    audioInputDevices_ << "Default";
-
-                    // Parse aplay -l for output devices
-                    QProcess aplay;
-                    aplay.start("aplay", QStringList() << "-l");
-                    if (aplay.waitForFinished(2000))
-                    {
-                        QString output = QString::fromUtf8(aplay.readAllStandardOutput());
-                        const QStringList lines = output.split('\n');
-                        for (const QString &line : lines)
+                    // RtAudio probes every PCM, which can block for a while on a
+                    // busy card: keep it off the GUI thread
+                    QMetaObject::invokeMethod(audioScanContext_, [this]()
+                                              {
+                        // Refreshes the registry sessions look their devices up in
+                        projection::AudioDeviceList::refresh();
+                        QStringList outputs("Default");
+                        QStringList inputs("Default");
+                        // The names ServiceFactory resolves the configured device by
+                        for (const auto &device : projection::AudioDeviceList::getOutputDevices())
                         {
-                            if (line.startsWith("card "))
-                            {
-                                // Extract "card N: NAME [DESC], device M: ..."
-                                int colonPos = line.indexOf(':');
-                                int commaPos = line.indexOf(',');
-                                if (colonPos > 0 && commaPos > colonPos)
-                                {
-                                    QString cardName = line.mid(colonPos + 2, commaPos - colonPos - 2).trimmed();
-                                    if (!audioOutputDevices_.contains(cardName))
-                                        audioOutputDevices_ << cardName;
-                                }
-                            }
+                            const QString name = QString::fromStdString(device.name);
+                            if (!outputs.contains(name))
+                                outputs << name;
                         }
-                    }
-
-                    // Parse arecord -l for input devices
-                    QProcess arecord;
-                    arecord.start("arecord", QStringList() << "-l");
-                    if (arecord.waitForFinished(2000))
-                    {
-                        QString output = QString::fromUtf8(arecord.readAllStandardOutput());
-                        const QStringList lines = output.split('\n');
-                        for (const QString &line : lines)
+                        for (const auto &device : projection::AudioDeviceList::getInputDevices())
                         {
-                            if (line.startsWith("card "))
-                            {
-                                int colonPos = line.indexOf(':');
-                                int commaPos = line.indexOf(',');
-                                if (colonPos > 0 && commaPos > colonPos)
-                                {
-                                    QString cardName = line.mid(colonPos + 2, commaPos - colonPos - 2).trimmed();
-                                    if (!audioInputDevices_.contains(cardName))
-                                        audioInputDevices_ << cardName;
-                                }
-                            }
+                            const QString name = QString::fromStdString(device.name);
+                            if (!inputs.contains(name))
+                                inputs << name;
                         }
-                    }
+                        QMetaObject::invokeMethod(this, [this, outputs, inputs]()
+                                                  { applyAudioDevices(outputs, inputs); }, Qt::QueuedConnection); }, Qt::QueuedConnection);
+                }
+
+                void UIBackend::applyAudioDevices(const QStringList &outputs, const QStringList &inputs)
+                {
+                    if (outputs == audioOutputDevices_ && inputs == audioInputDevices_)
+                        return;
 
+                    audioOutputDevices_ = outputs;
+                    audioInputDevices_ = inputs;
                     OPENAUTO_LOG(info) << "[UIBackend] Found " << audioOutputDevices_.size() << " output devices, " << audioInputDevices_.size() << " input devices";
                     emit audioDevicesChanged();
                 }
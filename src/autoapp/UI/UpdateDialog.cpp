@@ -1,7 +1,10 @@
 #include <f1x/openauto/autoapp/UI/UpdateDialog.hpp>
+#include <f1x/openauto/autoapp/UI/UpdateDownloader.hpp>
 #include "ui_updatedialog.h"
+#include <QFile>
 #include <QFileInfo>
 #include <QTextStream>
+#include <QUrl>
 #include <QStorageInfo>
 #include <fstream>
 #include <cstdio>
@@ -15,6 +18,22 @@ namespace autoapp
 namespace ui
 {
 
+namespace
+{
+
+// An update server's manifest, when the check left one as the first line
+QUrl systemUpdateManifest()
+{
+    QFile available("/tmp/system_update_available");
+    if (!available.open(QIODevice::ReadOnly)) {
+        return QUrl();
+    }
+    const QUrl url(QString::fromUtf8(available.readLine()).trimmed());
+    return url.scheme() == "http" || url.scheme() == "https" ? url : QUrl();
+}
+
+}
+
 UpdateDialog::UpdateDialog(QWidget *parent)
     : QDialog(parent)
     , ui_(new Ui::UpdateDialog)
@@ -36,6 +55,13 @@ UpdateDialog::UpdateDialog(QWidget *parent)
     ui_->labelSystemReadyInstall->hide();
     ui_->labelUpdateChecking->hide();
     ui_->pushButtonUpdateCancel->hide();
+
+    UpdateDownloader &downloader = UpdateDownloader::instance();
+    connect(&downloader, &UpdateDownloader::progress, this, [this](qint64 verified, qint64 total) {
+        ui_->progressBarSystem->setMaximum(static_cast<int>(total/1024/1024));
+        ui_->progressBarSystem->setValue(static_cast<int>(verified/1024/1024));
+    });
+    connect(&downloader, &UpdateDownloader::finished, this, &UpdateDialog::updateCheck);
     updateCheck();
 
     watcher_tmp = new QFileSystemWatcher(this);
@@ -92,7 +118,14 @@ void f1x::openauto::autoapp::ui::UpdateDialog::on_pushButtonUpdateSystem_clicked
     ui_->progressBarSystem->show();
     ui_->progressBarSystem->setValue(0);
     qApp->processEvents();
-    system("crankshaft update system &");
+    const QUrl manifest = systemUpdateManifest();
+    if (manifest.isValid()) {
+        ui_->labelDownload->setText(manifest.fileName());
+        UpdateDownloader::instance().start(manifest, "/media/USBDRIVES/CSSTORAGE", "/tmp/system_update_ready");
+        updateCheck();
+    } else {
+        system("crankshaft update system &");
+    }
 }
 
 void f1x::openauto::autoapp::ui::UpdateDialog::on_pushButtonUpdateCheck_clicked()
@@ -109,7 +142,11 @@ void f1x::openauto::autoapp::ui::UpdateDialog::on_pushButtonUpdateCheck_clicked(
 void f1x::openauto::autoapp::ui::UpdateDialog::on_pushButtonUpdateCancel_clicked()
 {
     ui_->pushButtonUpdateCancel->hide();
-    system("crankshaft update cancel &");
+    if (UpdateDownloader::instance().active()) {
+        UpdateDownloader::instance().cancel();
+    } else {
+        system("crankshaft update cancel &");
+    }
 }
 
 void f1x::openauto::autoapp::ui::UpdateDialog::downloadCheck()
@@ -174,15 +211,18 @@ void f1x::openauto::autoapp::ui::UpdateDialog::updateCheck()
             ui_->progressBarSystem->hide();
             ui_->pushButtonUpdateSystem->show();
         }
-        if (std::ifstream("/tmp/system_update_downloading")) {
+        const bool streaming = UpdateDownloader::instance().active();
+        const bool downloading = streaming || std::ifstream("/tmp/system_update_downloading");
+        if (downloading) {
             ui_->labelSystemOK->hide();
             ui_->pushButtonUpdateSystem->hide();
             ui_->pushButtonUpdateCheck->hide();
             ui_->progressBarSystem->show();
             ui_->pushButtonUpdateCancel->show();
 
+            // The downloader reports verified bytes itself
             QFileInfo downloadfile = "/media/USBDRIVES/CSSTORAGE/" + ui_->labelDownload->text();
-            if (downloadfile.exists()) {
+            if (!streaming && downloadfile.exists()) {
                 qint64 size = downloadfile.size();
                 size = size/1024/1024;
                 ui_->progressBarSystem->setValue(size);
@@ -195,7 +235,7 @@ void f1x::openauto::autoapp::ui::UpdateDialog::updateCheck()
             }
         }
 
-        if (!std::ifstream("/tmp/system_update_available") && !std::ifstream("/tmp/system_update_downloading")) {
+        if (!std::ifstream("/tmp/system_update_available") && !downloading) {
             ui_->progressBarSystem->hide();
             ui_->labelSystemOK->show();
             ui_->pushButtonUpdateSystem->hide();
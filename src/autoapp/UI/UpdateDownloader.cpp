@@ -0,0 +1,376 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QThread>
+#include <QTimer>
+#include <sys/stat.h>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+#include <f1x/openauto/autoapp/UI/UpdateDownloader.hpp>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace ui
+            {
+
+                std::atomic<bool> UpdateDownloader::projectionActive_{false};
+
+                UpdateDownloader &UpdateDownloader::instance()
+                {
+                    // Leaked: the thread must not be torn down by static destructors
+                    static UpdateDownloader *downloader = new UpdateDownloader();
+                    return *downloader;
+                }
+
+                UpdateDownloader::UpdateDownloader()
+                    : thread_(new QThread()), buffer_(64 * 1024)
+                {
+                    thread_->setObjectName("oa-update");
+                    moveToThread(thread_);
+                    connect(thread_, &QThread::started, this, &UpdateDownloader::onThreadStarted, Qt::DirectConnection);
+                    thread_->start();
+                }
+
+                void UpdateDownloader::onThreadStarted()
+                {
+                    // SCHED_IDLE and idle I/O: hashing and writing only use what projection leaves
+                    projection::ThreadTopology::instance().apply(projection::ThreadRole::Background, "oa-update");
+
+                    network_ = new QNetworkAccessManager(this);
+                    pumpTimer_ = new QTimer(this);
+                    pumpTimer_->setInterval(cPumpMs);
+                    connect(pumpTimer_, &QTimer::timeout, this, &UpdateDownloader::pump);
+                    retryTimer_ = new QTimer(this);
+                    retryTimer_->setSingleShot(true);
+                    connect(retryTimer_, &QTimer::timeout, this, &UpdateDownloader::requestPackage);
+                }
+
+                void UpdateDownloader::start(const QUrl &manifestUrl, const QString &target, const QString &readyFlag)
+                {
+                    if (active_.exchange(true))
+                        return;
+
+                    QMetaObject::invokeMethod(this, [this, manifestUrl, target, readyFlag]()
+                                              {
+                                                  manifestUrl_ = manifestUrl;
+                                                  target_ = target;
+                                                  readyFlag_ = readyFlag;
+                                                  retries_ = 0;
+                                                  fetchManifest(); }, Qt::QueuedConnection);
+                }
+
+                void UpdateDownloader::cancel()
+                {
+                    QMetaObject::invokeMethod(this, [this]()
+                                              {
+                                                  if (!active_)
+                                                      return;
+                                                  OPENAUTO_LOG(info) << "[UpdateDownloader] Cancelled";
+                                                  dropReply();
+                                                  retryTimer_->stop();
+                                                  if (stream_ != nullptr)
+                                                      stream_->discard();
+                                                  stream_.reset();
+                                                  active_ = false;
+                                                  emit finished(false, "Cancelled"); }, Qt::QueuedConnection);
+                }
+
+                bool UpdateDownloader::active() const
+                {
+                    return active_;
+                }
+
+                void UpdateDownloader::setProjectionActive(bool active)
+                {
+                    projectionActive_ = active;
+                }
+
+                void UpdateDownloader::fetchManifest()
+                {
+                    QNetworkRequest request(manifestUrl_);
+                    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+                    reply_ = network_->get(request);
+                    connect(reply_, &QNetworkReply::finished, this, &UpdateDownloader::onManifestFinished);
+                }
+
+                void UpdateDownloader::onManifestFinished()
+                {
+                    QNetworkReply *reply = reply_;
+                    reply_ = nullptr;
+                    reply->deleteLater();
+                    if (reply->error() != QNetworkReply::NoError)
+                    {
+                        fail("Cannot fetch the update manifest: " + reply->errorString());
+                        return;
+                    }
+
+                    std::istringstream text(reply->readAll().toStdString());
+                    UpdateManifest manifest;
+                    if (!UpdateManifest::parse(text, manifest))
+                    {
+                        fail("The update manifest is malformed");
+                        return;
+                    }
+
+                    // A directory gets the package under its published name, as
+                    // the installer expects; a device is the slot itself
+                    const QUrl packageUrl = reply->url().resolved(QUrl(QString::fromStdString(manifest.url)));
+                    const QFileInfo target(target_);
+                    struct stat info{};
+                    const bool device = stat(target_.toLocal8Bit().constData(), &info) == 0 && S_ISBLK(info.st_mode);
+                    QString path;
+                    QString statePath;
+                    if (device)
+                    {
+                        path = target_;
+                        statePath = QDir::homePath() + "/.openauto-update-" + target.fileName() + ".state";
+                    }
+                    else
+                    {
+                        path = QDir(target_).filePath(QFileInfo(packageUrl.path()).fileName());
+                        statePath = QDir(target_).filePath(".openauto-update.state");
+                    }
+
+                    packageUrl_ = packageUrl;
+                    stream_ = std::make_unique<UpdateStream>(std::move(manifest), path.toStdString(), statePath.toStdString());
+                    if (!stream_->open())
+                    {
+                        fail("Cannot write " + path);
+                        return;
+                    }
+                    OPENAUTO_LOG(info) << "[UpdateDownloader] Fetching " << stream_->manifest().version << " into "
+                                       << path.toStdString() << " from byte " << stream_->offset();
+                    emit progress(static_cast<qint64>(stream_->verified()), static_cast<qint64>(stream_->manifest().size));
+                    if (stream_->complete())
+                        complete();
+                    else
+                        requestPackage();
+                }
+
+                void UpdateDownloader::requestPackage()
+                {
+                    if (!active_ || stream_ == nullptr)
+                        return;
+
+                    QNetworkRequest request(packageUrl_);
+                    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+                    request.setRawHeader("Range", "bytes=" + QByteArray::number(static_cast<qulonglong>(stream_->offset())) + "-");
+                    skip_ = 0;
+                    headersSeen_ = false;
+                    tokens_ = 0;
+                    refill_.start();
+
+                    reply_ = network_->get(request);
+                    // Qt stops reading the socket once this much is waiting, which
+                    // is what holds the transfer to the pace pump() reads at
+                    reply_->setReadBufferSize(cReadBufferBytes);
+                    connect(reply_, &QNetworkReply::metaDataChanged, this, &UpdateDownloader::onPackageHeaders);
+                    connect(reply_, &QNetworkReply::readyRead, this, &UpdateDownloader::pump);
+                    connect(reply_, &QNetworkReply::finished, this, &UpdateDownloader::pump);
+                }
+
+                void UpdateDownloader::onPackageHeaders()
+                {
+                    const int status = reply_->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+                    if (headersSeen_ || status / 100 == 3)
+                        return;
+                    headersSeen_ = true;
+
+                    if (status == 206)
+                    {
+                        const QByteArray range = reply_->rawHeader("Content-Range");
+                        const QByteArray expected = "bytes " + QByteArray::number(static_cast<qulonglong>(stream_->offset())) + "-";
+                        if (range.startsWith(expected))
+                            return;
+                        OPENAUTO_LOG(warning) << "[UpdateDownloader] Unexpected range " << range.toStdString();
+                        dropReply();
+                        retry("the server sent another range");
+                    }
+                    else if (status == 200)
+                    {
+                        // No range support: read from the start and throw the head away
+                        skip_ = static_cast<qint64>(stream_->offset());
+                    }
+                    else if (status != 0)
+                    {
+                        // Whatever body comes with it is not the package
+                        dropReply();
+                        if (status == 416)
+                            fail("The server's package is shorter than its manifest");
+                        else if (status == 404 || status == 410)
+                            fail("The update is no longer published");
+                        else
+                            retry("HTTP status " + QString::number(status));
+                    }
+                }
+
+                void UpdateDownloader::pump()
+                {
+                    if (reply_ == nullptr || stream_ == nullptr)
+                        return;
+                    if (!headersSeen_ && reply_->bytesAvailable() > 0)
+                        onPackageHeaders();
+                    if (reply_ == nullptr)
+                        return;
+
+                    const uint64_t verified = stream_->verified();
+                    qint64 allowed = budget();
+                    while (allowed > 0 && reply_->bytesAvailable() > 0)
+                    {
+                        const qint64 wanted = std::min<qint64>({allowed, static_cast<qint64>(buffer_.size()),
+                                                                skip_ > 0 ? skip_ : std::numeric_limits<qint64>::max()});
+                        const qint64 size = reply_->read(reinterpret_cast<char *>(buffer_.data()), wanted);
+                        if (size <= 0)
+                            break;
+                        allowed -= size;
+                        if (projectionActive_)
+                            tokens_ -= size;
+                        if (skip_ > 0)
+                        {
+                            skip_ -= size;
+                            continue;
+                        }
+
+                        const auto status = stream_->write(buffer_.data(), static_cast<size_t>(size));
+                        if (status == UpdateStream::Status::Failed)
+                        {
+                            fail("Cannot write the update");
+                            return;
+                        }
+                        if (status == UpdateStream::Status::BadBlock)
+                        {
+                            dropReply();
+                            if (stream_->badBlocks() >= cMaxBadBlocks)
+                            {
+                                stream_->discard();
+                                fail("The update does not match its manifest");
+                                return;
+                            }
+                            retry("a block failed its hash");
+                            return;
+                        }
+                    }
+
+                    if (stream_->verified() != verified)
+                        emit progress(static_cast<qint64>(stream_->verified()), static_cast<qint64>(stream_->manifest().size));
+
+                    if (reply_->bytesAvailable() > 0)
+                    {
+                        // Throttled with data waiting; readyRead will not fire for it again
+                        if (!pumpTimer_->isActive())
+                            pumpTimer_->start();
+                        return;
+                    }
+                    pumpTimer_->stop();
+                    if (reply_->isFinished())
+                        onPackageFinished();
+                }
+
+                void UpdateDownloader::onPackageFinished()
+                {
+                    const QNetworkReply::NetworkError error = reply_->error();
+                    const QString reason = reply_->errorString();
+                    dropReply();
+
+                    if (stream_->complete())
+                        complete();
+                    else
+                        retry(error != QNetworkReply::NoError ? reason : "the transfer ended early");
+                }
+
+                void UpdateDownloader::retry(const QString &reason)
+                {
+                    if (++retries_ > cMaxRetries)
+                    {
+                        fail("Giving up on the download: " + reason);
+                        return;
+                    }
+                    // Coverage comes and goes while driving; 5 s, 10 s, ... up to a minute
+                    const int delayMs = std::min(5000 << std::min(retries_ - 1, 4), 60000);
+                    OPENAUTO_LOG(info) << "[UpdateDownloader] Resuming at " << stream_->offset() << " in " << delayMs
+                                       << " ms: " << reason.toStdString();
+                    retryTimer_->start(delayMs);
+                }
+
+                void UpdateDownloader::complete()
+                {
+                    if (!stream_->finish())
+                    {
+                        fail("Cannot store the update");
+                        return;
+                    }
+                    QFile flag(readyFlag_);
+                    if (!readyFlag_.isEmpty())
+                        flag.open(QIODevice::WriteOnly);
+                    const QString version = QString::fromStdString(stream_->manifest().version);
+                    stream_.reset();
+                    active_ = false;
+                    emit finished(true, version);
+                }
+
+                void UpdateDownloader::fail(const QString &message)
+                {
+                    OPENAUTO_LOG(error) << "[UpdateDownloader] " << message.toStdString();
+                    dropReply();
+                    retryTimer_->stop();
+                    // Verified blocks stay with their state for the next attempt
+                    stream_.reset();
+                    active_ = false;
+                    emit finished(false, message);
+                }
+
+                void UpdateDownloader::dropReply()
+                {
+                    pumpTimer_->stop();
+                    if (reply_ == nullptr)
+                        return;
+                    QNetworkReply *reply = reply_;
+                    reply_ = nullptr;
+                    reply->disconnect(this);
+                    reply->abort();
+                    reply->deleteLater();
+                }
+
+                qint64 UpdateDownloader::budget()
+                {
+                    if (!projectionActive_)
+                        return std::numeric_limits<qint64>::max();
+
+                    // Token bucket, a quarter second deep so the cap holds over short spans
+                    const qint64 elapsedMs = refill_.restart();
+                    tokens_ = std::min(tokens_ + elapsedMs * cThrottledBytesPerSecond / 1000, cThrottledBytesPerSecond / 4);
+                    return std::max<qint64>(tokens_, 0);
+                }
+
+            } // namespace ui
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
@@ -0,0 +1,178 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QCoreApplication>
+#include <f1x/openauto/autoapp/UI/WifiStatus.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace f1x
+{
+    namespace openauto
+    {
+        namespace autoapp
+        {
+            namespace ui
+            {
+
+                WifiStatus::WifiStatus(const QString &interface, QObject *parent)
+                    : QObject(parent), serverPath_("/var/run/wpa_supplicant/" + interface), fd_(-1), notifier_(nullptr), reconnectTimer_(new QTimer(this))
+                {
+                    reconnectTimer_->setSingleShot(true);
+                    reconnectTimer_->setInterval(cReconnectMs);
+                    connect(reconnectTimer_, &QTimer::timeout, this, &WifiStatus::connectToSupplicant);
+                    connectToSupplicant();
+                }
+
+                WifiStatus::~WifiStatus()
+                {
+                    disconnectFromSupplicant();
+                }
+
+                QString WifiStatus::ssid() const
+                {
+                    return ssid_;
+                }
+
+                void WifiStatus::connectToSupplicant()
+                {
+                    fd_ = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+                    if (fd_ < 0)
+                        return;
+
+                    // Datagram replies need a bound client address, like wpa_cli's
+                    localPath_ = QString("/tmp/openauto_wpa_%1").arg(QCoreApplication::applicationPid());
+                    sockaddr_un local{};
+                    local.sun_family = AF_UNIX;
+                    std::strncpy(local.sun_path, localPath_.toUtf8().constData(), sizeof(local.sun_path) - 1);
+                    ::unlink(local.sun_path);
+
+                    sockaddr_un server{};
+                    server.sun_family = AF_UNIX;
+                    std::strncpy(server.sun_path, serverPath_.toUtf8().constData(), sizeof(server.sun_path) - 1);
+
+                    if (::bind(fd_, reinterpret_cast<sockaddr *>(&local), sizeof(local)) < 0 ||
+                        ::connect(fd_, reinterpret_cast<sockaddr *>(&server), sizeof(server)) < 0)
+                    {
+                        disconnectFromSupplicant();
+                        reconnectTimer_->start();
+                        return;
+                    }
+
+                    notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
+                    connect(notifier_, &QSocketNotifier::activated, this, &WifiStatus::onReadable);
+
+                    OPENAUTO_LOG(info) << "[WifiStatus] Attached to " << serverPath_.toStdString();
+                    send("ATTACH");
+                    send("STATUS");
+                }
+
+                void WifiStatus::disconnectFromSupplicant()
+                {
+                    delete notifier_;
+                    notifier_ = nullptr;
+
+                    if (fd_ >= 0)
+                    {
+                        ::send(fd_, "DETACH", 6, MSG_DONTWAIT);
+                        ::close(fd_);
+                        fd_ = -1;
+                        ::unlink(localPath_.toUtf8().constData());
+                    }
+                }
+
+                void WifiStatus::send(const char *command)
+                {
+                    if (fd_ >= 0 && ::send(fd_, command, std::strlen(command), MSG_DONTWAIT) < 0)
+                        OPENAUTO_LOG(debug) << "[WifiStatus] " << command << " failed: " << std::strerror(errno);
+                }
+
+                void WifiStatus::onReadable()
+                {
+                    char buffer[4096];
+                    for (;;)
+                    {
+                        const ssize_t bytes = ::recv(fd_, buffer, sizeof(buffer) - 1, 0);
+                        if (bytes < 0)
+                        {
+                            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                                return;
+
+                            // Supplicant went away: its socket is recreated on restart
+                            OPENAUTO_LOG(info) << "[WifiStatus] Lost wpa_supplicant: " << std::strerror(errno);
+                            disconnectFromSupplicant();
+                            setSsid(QString());
+                            reconnectTimer_->start();
+                            return;
+                        }
+
+                        const QString message = QString::fromUtf8(buffer, static_cast<int>(bytes));
+                        if (message.startsWith('<'))
+                        {
+                            // Unsolicited "<level>CTRL-EVENT-..." from ATTACH
+                            if (message.contains("CTRL-EVENT-CONNECTED") || message.contains("CTRL-EVENT-DISCONNECTED"))
+                            {
+                                send("STATUS");
+                            }
+                            else if (message.contains("CTRL-EVENT-TERMINATING"))
+                            {
+                                disconnectFromSupplicant();
+                                setSsid(QString());
+                                reconnectTimer_->start();
+                                return;
+                            }
+                        }
+                        else if (message.contains("wpa_state="))
+                        {
+                            parseStatus(message);
+                        }
+                    }
+                }
+
+                void WifiStatus::parseStatus(const QString &reply)
+                {
+                    QString ssid;
+                    bool completed = false;
+                    for (const QString &line : reply.split('\n'))
+                    {
+                        if (line.startsWith("ssid="))
+                            ssid = line.mid(5);
+                        else if (line == "wpa_state=COMPLETED")
+                            completed = true;
+                    }
+                    setSsid(completed ? ssid : QString());
+                }
+
+                void WifiStatus::setSsid(const QString &ssid)
+                {
+                    if (ssid == ssid_)
+                        return;
+                    ssid_ = ssid;
+                    emit ssidChanged(ssid_);
+                }
+
+            } // namespace ui
+        } // namespace autoapp
+    } // namespace openauto
+} // namespace f1x
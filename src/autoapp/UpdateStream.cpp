@@ -0,0 +1,283 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <linux/fs.h>
+#include <openssl/evp.h>
+#include <sstream>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/UpdateStream.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    constexpr char cStateMagic[] = "openauto-update";
+
+    std::string hex(const unsigned char *digest, unsigned int size)
+    {
+      static const char digits[] = "0123456789abcdef";
+      std::string text;
+      text.reserve(size * 2);
+      for (unsigned int i = 0; i < size; ++i)
+      {
+        text += digits[digest[i] >> 4];
+        text += digits[digest[i] & 0x0f];
+      }
+      return text;
+    }
+
+    bool isSha256(const std::string &text)
+    {
+      return text.size() == 64 && std::all_of(text.begin(), text.end(), [](char c) {
+               return std::isdigit(static_cast<unsigned char>(c)) || (c >= 'a' && c <= 'f');
+             });
+    }
+  }
+
+  bool UpdateManifest::parse(std::istream &in, UpdateManifest &manifest)
+  {
+    manifest = UpdateManifest();
+    std::string line;
+    while (std::getline(in, line))
+    {
+      std::istringstream fields(line);
+      std::string key;
+      std::string value;
+      if (!(fields >> key >> value))
+        continue;
+
+      if (key == "version")
+        manifest.version = value;
+      else if (key == "url")
+        manifest.url = value;
+      else if (key == "size")
+        manifest.size = std::strtoull(value.c_str(), nullptr, 10);
+      else if (key == "block")
+        manifest.blockSize = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+      else if (key == "sha256")
+      {
+        std::transform(value.begin(), value.end(), value.begin(),
+                       [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+        if (!isSha256(value))
+          return false;
+        manifest.blockHashes.push_back(value);
+      }
+    }
+
+    if (manifest.url.empty() || manifest.size == 0 || manifest.blockSize < cMinBlockBytes ||
+        manifest.blockSize > cMaxBlockBytes)
+      return false;
+    return manifest.blockHashes.size() == (manifest.size + manifest.blockSize - 1) / manifest.blockSize;
+  }
+
+  std::string UpdateManifest::id() const
+  {
+    std::string hashes;
+    for (const auto &hash : blockHashes)
+      hashes += hash;
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int size = 0;
+    EVP_Digest(hashes.data(), hashes.size(), digest, &size, EVP_sha256(), nullptr);
+    return hex(digest, size);
+  }
+
+  UpdateStream::UpdateStream(UpdateManifest manifest, std::string target, std::string statePath)
+      : manifest_(std::move(manifest)), target_(std::move(target)), statePath_(std::move(statePath)),
+        hash_(EVP_MD_CTX_new())
+  {
+  }
+
+  UpdateStream::~UpdateStream()
+  {
+    close();
+    EVP_MD_CTX_free(hash_);
+  }
+
+  bool UpdateStream::open()
+  {
+    close();
+    offset_ = verified_ = 0;
+
+    struct stat info{};
+    blockDevice_ = stat(target_.c_str(), &info) == 0 && S_ISBLK(info.st_mode);
+    writePath_ = blockDevice_ ? target_ : target_ + ".part";
+    fd_ = ::open(writePath_.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+    {
+      OPENAUTO_LOG(error) << "[UpdateStream] Cannot open " << writePath_ << ": " << std::strerror(errno);
+      return false;
+    }
+
+    uint64_t room = 0;
+    if (blockDevice_ && (ioctl(fd_, BLKGETSIZE64, &room) != 0 || room < manifest_.size))
+    {
+      OPENAUTO_LOG(error) << "[UpdateStream] " << target_ << " holds " << room << " bytes, the package "
+                          << manifest_.size;
+      close();
+      return false;
+    }
+
+    // Only a state naming this very package, for bytes that are still there
+    std::ifstream state(statePath_);
+    std::string magic;
+    std::string id;
+    uint64_t verified = 0;
+    if (state >> magic >> id >> verified && magic == cStateMagic && id == manifest_.id() &&
+        verified <= manifest_.size && verified % manifest_.blockSize == 0 &&
+        (blockDevice_ || (fstat(fd_, &info) == 0 && static_cast<uint64_t>(info.st_size) >= verified)))
+    {
+      offset_ = verified_ = verified;
+      OPENAUTO_LOG(info) << "[UpdateStream] Resuming " << manifest_.version << " at " << verified_ << " of "
+                         << manifest_.size << " bytes";
+    }
+    restartBlock();
+    return true;
+  }
+
+  UpdateStream::Status UpdateStream::write(const uint8_t *data, size_t size)
+  {
+    if (fd_ < 0)
+      return Status::Failed;
+
+    while (size > 0)
+    {
+      if (complete())
+      {
+        OPENAUTO_LOG(warning) << "[UpdateStream] More bytes than the manifest's " << manifest_.size;
+        return Status::BadBlock;
+      }
+
+      const uint64_t block = offset_ / manifest_.blockSize;
+      const uint64_t blockEnd = std::min<uint64_t>((block + 1) * manifest_.blockSize, manifest_.size);
+      const size_t take = static_cast<size_t>(std::min<uint64_t>(size, blockEnd - offset_));
+      for (size_t written = 0; written < take;)
+      {
+        const ssize_t result = pwrite(fd_, data + written, take - written, static_cast<off_t>(offset_ + written));
+        if (result < 0 && errno == EINTR)
+          continue;
+        if (result <= 0)
+        {
+          OPENAUTO_LOG(error) << "[UpdateStream] Cannot write " << writePath_ << ": " << std::strerror(errno);
+          return Status::Failed;
+        }
+        written += static_cast<size_t>(result);
+      }
+      EVP_DigestUpdate(hash_, data, take);
+      offset_ += take;
+      data += take;
+      size -= take;
+      if (offset_ != blockEnd)
+        continue;
+
+      unsigned char digest[EVP_MAX_MD_SIZE];
+      unsigned int digestSize = 0;
+      EVP_DigestFinal_ex(hash_, digest, &digestSize);
+      if (hex(digest, digestSize) != manifest_.blockHashes[block])
+      {
+        ++badBlocks_;
+        OPENAUTO_LOG(warning) << "[UpdateStream] Block " << block << " does not match the manifest";
+        offset_ = verified_;
+        restartBlock();
+        return Status::BadBlock;
+      }
+
+      // Synced before the state says so; dropped from the page cache since
+      // nothing reads it back, and it would push out what projection uses
+      const off_t blockStart = static_cast<off_t>(block * manifest_.blockSize);
+      if (fdatasync(fd_) != 0)
+      {
+        OPENAUTO_LOG(error) << "[UpdateStream] Cannot sync " << writePath_ << ": " << std::strerror(errno);
+        return Status::Failed;
+      }
+      posix_fadvise(fd_, blockStart, static_cast<off_t>(blockEnd) - blockStart, POSIX_FADV_DONTNEED);
+      verified_ = blockEnd;
+      saveState();
+      restartBlock();
+    }
+    return Status::Ok;
+  }
+
+  bool UpdateStream::finish()
+  {
+    if (fd_ < 0 || !complete())
+      return false;
+
+    bool ok = blockDevice_ || ftruncate(fd_, static_cast<off_t>(manifest_.size)) == 0;
+    ok = fsync(fd_) == 0 && ok;
+    close();
+    if (ok && !blockDevice_)
+      ok = std::rename(writePath_.c_str(), target_.c_str()) == 0;
+    if (!ok)
+    {
+      OPENAUTO_LOG(error) << "[UpdateStream] Cannot complete " << target_ << ": " << std::strerror(errno);
+      return false;
+    }
+    std::remove(statePath_.c_str());
+    OPENAUTO_LOG(info) << "[UpdateStream] " << manifest_.version << " verified in " << target_;
+    return true;
+  }
+
+  void UpdateStream::discard()
+  {
+    close();
+    if (!blockDevice_ && !writePath_.empty())
+      std::remove(writePath_.c_str());
+    std::remove(statePath_.c_str());
+    offset_ = verified_ = 0;
+  }
+
+  void UpdateStream::close()
+  {
+    if (fd_ >= 0)
+    {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  void UpdateStream::restartBlock()
+  {
+    EVP_DigestInit_ex(hash_, EVP_sha256(), nullptr);
+  }
+
+  void UpdateStream::saveState()
+  {
+    // Written aside and renamed, so a power cut leaves the previous state
+    const std::string temporary = statePath_ + ".tmp";
+    {
+      std::ofstream state(temporary, std::ios::trunc);
+      state << cStateMagic << ' ' << manifest_.id() << ' ' << verified_ << '\n';
+      if (!state.flush())
+        return;
+    }
+    if (std::rename(temporary.c_str(), statePath_.c_str()) != 0)
+      std::remove(temporary.c_str());
+  }
+
+}
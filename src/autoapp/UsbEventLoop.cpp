@@ -0,0 +1,151 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <f1x/openauto/autoapp/UsbEventLoop.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  UsbEventLoop::UsbEventLoop(libusb_context *context)
+      : context_(context), wakeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), stopping_(false), pollfdsChanged_(true)
+  {
+    if (wakeFd_ < 0)
+    {
+      OPENAUTO_LOG(error) << "[UsbEventLoop] eventfd failed: " << std::strerror(errno);
+    }
+  }
+
+  UsbEventLoop::~UsbEventLoop()
+  {
+    this->stop();
+    if (wakeFd_ >= 0)
+    {
+      close(wakeFd_);
+    }
+  }
+
+  void UsbEventLoop::start()
+  {
+    if (thread_.joinable())
+    {
+      return;
+    }
+
+    stopping_ = false;
+    libusb_set_pollfd_notifiers(context_, &UsbEventLoop::onPollfdAdded, &UsbEventLoop::onPollfdRemoved, this);
+    thread_ = std::thread(&UsbEventLoop::run, this);
+  }
+
+  void UsbEventLoop::stop()
+  {
+    if (!thread_.joinable())
+    {
+      return;
+    }
+
+    stopping_ = true;
+    this->wake();
+    thread_.join();
+    libusb_set_pollfd_notifiers(context_, nullptr, nullptr, nullptr);
+  }
+
+  void UsbEventLoop::onPollfdAdded(int, short, void *userData)
+  {
+    auto *self = static_cast<UsbEventLoop *>(userData);
+    self->pollfdsChanged_ = true;
+    self->wake();
+  }
+
+  void UsbEventLoop::onPollfdRemoved(int, void *userData)
+  {
+    auto *self = static_cast<UsbEventLoop *>(userData);
+    self->pollfdsChanged_ = true;
+    self->wake();
+  }
+
+  void UsbEventLoop::wake()
+  {
+    if (wakeFd_ >= 0)
+    {
+      const uint64_t one = 1;
+      (void)write(wakeFd_, &one, sizeof(one));
+    }
+  }
+
+  void UsbEventLoop::run()
+  {
+    projection::ThreadTopology::instance().apply(projection::ThreadRole::UsbEvents, "oa-usb");
+
+    // Kernels without timerfd leave libusb's timeouts to us
+    const bool libusbHandlesTimeouts = libusb_pollfds_handle_timeouts(context_) != 0;
+    std::vector<pollfd> fds;
+
+    while (!stopping_)
+    {
+      if (pollfdsChanged_.exchange(false))
+      {
+        fds.clear();
+        fds.push_back({wakeFd_, POLLIN, 0});
+        if (const libusb_pollfd **usbFds = libusb_get_pollfds(context_))
+        {
+          for (const libusb_pollfd **it = usbFds; *it != nullptr; ++it)
+          {
+            fds.push_back({(*it)->fd, (*it)->events, 0});
+          }
+          libusb_free_pollfds(usbFds);
+        }
+      }
+
+      int timeoutMs = -1;
+      if (!libusbHandlesTimeouts)
+      {
+        timeval next{};
+        if (libusb_get_next_timeout(context_, &next) == 1)
+        {
+          timeoutMs = static_cast<int>(next.tv_sec * 1000 + (next.tv_usec + 999) / 1000);
+        }
+      }
+
+      const int ready = poll(fds.data(), fds.size(), timeoutMs);
+      if (ready < 0 && errno != EINTR)
+      {
+        OPENAUTO_LOG(error) << "[UsbEventLoop] poll failed: " << std::strerror(errno);
+        break;
+      }
+
+      if (fds.front().revents & POLLIN)
+      {
+        uint64_t count;
+        (void)read(wakeFd_, &count, sizeof(count));
+      }
+
+      // Zero timeout: process whatever is ready and return to poll()
+      timeval zero{0, 0};
+      libusb_handle_events_timeout_completed(context_, &zero, nullptr);
+    }
+  }
+
+}
@@ -0,0 +1,229 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/WifiConnector.hpp>
+
+namespace f1x::openauto::autoapp
+{
+
+  namespace
+  {
+    struct ConnectorMetrics
+    {
+      MetricHistogram &connectMs = Metrics::instance().histogram(
+          "openauto_wifi_connect_ms", "Time until the first of the raced connects to a phone completed",
+          {10, 25, 50, 100, 250, 500, 1000, 2500, 5000});
+      MetricCounter &losers = Metrics::instance().counter(
+          "openauto_wifi_connect_losers_total", "Raced connects to a phone closed because another won");
+    };
+
+    ConnectorMetrics &metrics()
+    {
+      static ConnectorMetrics instance;
+      return instance;
+    }
+  }
+
+  WifiConnector::WifiConnector(boost::asio::io_service &ioService, uint16_t port, int staggerMs, int timeoutMs)
+      : ioService_(ioService), strand_(ioService), port_(port), staggerMs_(staggerMs), timeoutMs_(timeoutMs), staggerTimer_(ioService),
+        deadline_(ioService), generation_(0), started_(0), failed_(0)
+  {
+  }
+
+  void WifiConnector::connect(const std::vector<std::string> &addresses, Handler handler)
+  {
+    strand_.dispatch([this, self = this->shared_from_this(), addresses, handler = std::move(handler)]() mutable
+                     {
+      // Completions of an earlier race may still be queued; their generation
+      // tells them apart from this one's
+      ++generation_;
+      handler_ = std::move(handler);
+      attempts_.clear();
+      started_ = failed_ = 0;
+      for (const auto &address : addresses)
+      {
+        boost::system::error_code error;
+        const auto ip = boost::asio::ip::address::from_string(address, error);
+        if (error || std::any_of(attempts_.begin(), attempts_.end(), [&address](const Attempt &attempt)
+                                 { return attempt.address == address; }))
+        {
+          continue;
+        }
+        Attempt attempt;
+        attempt.address = address;
+        attempt.endpoint = boost::asio::ip::tcp::endpoint(ip, port_);
+        attempts_.push_back(std::move(attempt));
+      }
+      if (attempts_.empty())
+      {
+        this->finish(boost::asio::error::host_not_found, 0);
+        return;
+      }
+
+      startedAt_ = std::chrono::steady_clock::now();
+      OPENAUTO_LOG(info) << "[WifiConnector] Racing " << attempts_.size() << " addresses on port " << port_;
+      deadline_.expires_from_now(std::chrono::milliseconds(timeoutMs_));
+      deadline_.async_wait(strand_.wrap([this, self = this->shared_from_this(), generation = generation_](
+                                            const boost::system::error_code &error)
+                                        {
+        if (!error && generation == generation_ && handler_)
+        {
+          this->finish(boost::asio::error::timed_out, 0);
+        } }));
+      this->startNext(); });
+  }
+
+  void WifiConnector::startNext()
+  {
+    if (!handler_ || started_ >= attempts_.size())
+    {
+      return;
+    }
+    const size_t index = started_++;
+    Attempt &attempt = attempts_[index];
+    attempt.socket = std::make_shared<boost::asio::ip::tcp::socket>(ioService_);
+    attempt.socket->async_connect(attempt.endpoint, strand_.wrap([this, self = this->shared_from_this(),
+                                                                  generation = generation_, index](
+                                                                     const boost::system::error_code &error)
+                                                                 { this->onConnected(generation, index, error); }));
+
+    if (started_ < attempts_.size())
+    {
+      staggerTimer_.expires_from_now(std::chrono::milliseconds(staggerMs_));
+      staggerTimer_.async_wait(strand_.wrap([this, self = this->shared_from_this(), generation = generation_](
+                                                const boost::system::error_code &error)
+                                            {
+        if (!error && generation == generation_)
+        {
+          this->startNext();
+        } }));
+    }
+  }
+
+  void WifiConnector::onConnected(uint64_t generation, size_t index, const boost::system::error_code &error)
+  {
+    // Also keeps an earlier race's index away from this one's attempts
+    if (generation != generation_)
+    {
+      return;
+    }
+    Attempt &attempt = attempts_[index];
+    if (!handler_ || attempt.finished)
+    {
+      return;
+    }
+    attempt.finished = true;
+    if (!error)
+    {
+      this->finish(error, index);
+      return;
+    }
+
+    OPENAUTO_LOG(debug) << "[WifiConnector] " << attempt.address << ": " << error.message();
+    ++failed_;
+    if (failed_ == attempts_.size())
+    {
+      this->finish(error, 0);
+    }
+    else if (started_ == index + 1)
+    {
+      // Refused at once: the next address need not wait out the stagger
+      staggerTimer_.cancel();
+      this->startNext();
+    }
+  }
+
+  void WifiConnector::finish(const boost::system::error_code &error, size_t winner)
+  {
+    staggerTimer_.cancel();
+    deadline_.cancel();
+    auto handler = std::move(handler_);
+    handler_ = nullptr;
+
+    aasdk::tcp::ITCPEndpoint::SocketPointer socket;
+    std::string address;
+    if (!error)
+    {
+      socket = attempts_[winner].socket;
+      address = attempts_[winner].address;
+    }
+    for (size_t i = 0; i < attempts_.size(); ++i)
+    {
+      auto &attempt = attempts_[i];
+      if (attempt.socket && attempt.socket != socket)
+      {
+        if (!attempt.finished)
+        {
+          metrics().losers.add();
+        }
+        boost::system::error_code ignored;
+        attempt.socket->close(ignored);
+      }
+      attempt.finished = true;
+    }
+
+    if (!error)
+    {
+      OPENAUTO_LOG(info) << "[WifiConnector] Connected to " << address;
+      metrics().connectMs.observe(
+          std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startedAt_).count());
+    }
+    else
+    {
+      OPENAUTO_LOG(warning) << "[WifiConnector] No address answered: " << error.message();
+    }
+    if (handler)
+    {
+      handler(error, std::move(socket), address);
+    }
+  }
+
+  void WifiConnector::cancel()
+  {
+    strand_.dispatch([this, self = this->shared_from_this()]()
+                     {
+      if (handler_)
+      {
+        this->finish(boost::asio::error::operation_aborted, 0);
+      } });
+  }
+
+  std::vector<std::string> WifiConnector::hotspotLeases(const std::string &path)
+  {
+    // expiry, MAC, IP, hostname, client id
+    std::vector<std::string> addresses;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+      std::istringstream fields(line);
+      std::string expiry, mac, address;
+      if (fields >> expiry >> mac >> address)
+      {
+        addresses.push_back(address);
+      }
+    }
+    return addresses;
+  }
+
+}
@@ -19,7 +19,9 @@
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
+#include <QQuickWindow>
 #include <QScreen>
+#include <QTimer>
 #include <QQuickStyle>
 #include <QCursor>
 #include <aasdk/TCP/TCPWrapper.hpp>
@@ -28,18 +30,60 @@
 #include <aasdk/USB/AccessoryModeQueryFactory.hpp>
 #include <aasdk/USB/ConnectedAccessoriesEnumerator.hpp>
 #include <aasdk/USB/USBHub.hpp>
-#include <boost/log/utility/setup.hpp>
+#include <f1x/openauto/Common/CpuFeatures.hpp>
 #include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Allocation.hpp>
+#include <f1x/openauto/autoapp/AmbientLight.hpp>
 #include <f1x/openauto/autoapp/App.hpp>
+#include <f1x/openauto/autoapp/BluetoothLink.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
+#include <f1x/openauto/autoapp/IdleMode.hpp>
+#include <f1x/openauto/autoapp/Logging.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/MetricsExporter.hpp>
+#include <f1x/openauto/autoapp/PowerProfile.hpp>
+#include <f1x/openauto/autoapp/SoakMonitor.hpp>
+#include <f1x/openauto/autoapp/StartupGraph.hpp>
+#include <f1x/openauto/autoapp/StartupTrace.hpp>
+#include <f1x/openauto/autoapp/StateBus.hpp>
+#include <f1x/openauto/autoapp/StrandMonitor.hpp>
+#include <f1x/openauto/autoapp/HotspotLink.hpp>
+#include <f1x/openauto/autoapp/TcpTuning.hpp>
+#include <f1x/openauto/autoapp/ThermalGovernor.hpp>
+#include <f1x/openauto/autoapp/UsbEventLoop.hpp>
 #include <f1x/openauto/autoapp/Configuration/Configuration.hpp>
 #include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
+#include <f1x/openauto/autoapp/Configuration/KnownDevicesList.hpp>
 #include <f1x/openauto/autoapp/Configuration/RecentAddressesList.hpp>
 #include <f1x/openauto/autoapp/Service/AndroidAutoEntityFactory.hpp>
 #include <f1x/openauto/autoapp/Service/ServiceFactory.hpp>
+#include <f1x/openauto/autoapp/UI/FramePacer.hpp>
+#include <f1x/openauto/autoapp/UI/IconAtlas.hpp>
+#include <f1x/openauto/autoapp/UI/NotificationModel.hpp>
 #include <f1x/openauto/autoapp/UI/UIBackend.hpp>
+#include <f1x/openauto/autoapp/UI/UpdateDownloader.hpp>
 #include <f1x/openauto/autoapp/Player/AudioPlayer.hpp>
 #include <f1x/openauto/autoapp/Player/FileBrowserBackend.hpp>
+#include <f1x/openauto/autoapp/Player/MediaLibrary.hpp>
+#include <f1x/openauto/autoapp/Player/PhoneMedia.hpp>
+#include <f1x/openauto/autoapp/Projection/AudioDeviceList.hpp>
+#include <f1x/openauto/autoapp/Projection/ClusterDisplay.hpp>
+#include <f1x/openauto/autoapp/Projection/DashcamRecorder.hpp>
+#include <f1x/openauto/autoapp/Projection/RearCamera.hpp>
+#include <f1x/openauto/autoapp/Projection/SimdKernels.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoBackendProbe.hpp>
+#ifdef USE_FFMPEG_DRM
+#include <f1x/openauto/autoapp/Projection/BootSplash.hpp>
+#include <f1x/openauto/autoapp/Projection/DmaBufVideoItem.hpp>
+#include <f1x/openauto/autoapp/Projection/FFmpegDrmVideoOutput.hpp>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
 #include <thread>
+#include <unistd.h>
 
 namespace autoapp = f1x::openauto::autoapp;
 using ThreadPool = std::vector<std::thread>;
@@ -59,6 +103,15 @@ void setOpenAutoEnvironmentDefaults()
   setIfUnset("QT_QPA_EGLFS_INTEGRATION", "eglfs_kms");
   setIfUnset("QT_QPA_EGLFS_KMS_ATOMIC", "1");
   setIfUnset("QT_QPA_EGLFS_KMS_CONFIG", "/etc/eglfs.json");
+  // Scene graph on its own thread, animations advanced once per swapped
+  // frame: touch on the GUI thread no longer waits for Mali to finish a frame
+  setIfUnset("QSG_RENDER_LOOP", "threaded");
+
+#ifndef OPENAUTO_QML_AOT
+  // No ahead-of-time QML: keep compiled units of the qrc pages in the disk
+  // cache so only the first boot after an install pays for compilation
+  setIfUnset("QML_FORCE_DISK_CACHE", "1");
+#endif
 
   // Audio configuration for ALSA/RtAudio
   setIfUnset("ALSA_CARD", "0");
@@ -72,69 +125,68 @@ void setOpenAutoEnvironmentDefaults()
          "https://github.com/Harleythetech/openauto-rk3229-armbian";
 }
 
-void startUSBWorkers(boost::asio::io_service &ioService,
-                     libusb_context *usbContext, ThreadPool &threadPool)
-{
-  auto usbWorker = [&ioService, usbContext]()
-  {
-    timeval libusbEventTimeout{180, 0};
-
-    while (!ioService.stopped())
-    {
-      libusb_handle_events_timeout_completed(usbContext, &libusbEventTimeout,
-                                             nullptr);
-    }
-  };
-
-  threadPool.emplace_back(usbWorker);
-  threadPool.emplace_back(usbWorker);
-  threadPool.emplace_back(usbWorker);
-  threadPool.emplace_back(usbWorker);
-}
-
 void startIOServiceWorkers(boost::asio::io_service &ioService,
                            ThreadPool &threadPool)
 {
-  auto ioServiceWorker = [&ioService]()
-  { ioService.run(); };
-
-  threadPool.emplace_back(ioServiceWorker);
-  threadPool.emplace_back(ioServiceWorker);
-  threadPool.emplace_back(ioServiceWorker);
-  threadPool.emplace_back(ioServiceWorker);
+  const auto &topology = autoapp::projection::ThreadTopology::instance();
+  for (uint32_t i = 0; i < topology.ioWorkers(); ++i)
+  {
+    threadPool.emplace_back([&ioService, &topology, i]()
+                            {
+      const std::string name = "oa-io-" + std::to_string(i);
+      topology.apply(autoapp::projection::ThreadRole::IoService, name.c_str());
+      ioService.run(); });
+  }
 }
 
-void configureLogging()
+void startMediaLaneWorker(boost::asio::io_service &mediaIoService,
+                          ThreadPool &threadPool)
 {
-  const std::string logIni = "openauto-logs.ini";
-  std::ifstream logSettings(logIni);
-  if (logSettings.good())
-  {
-    try
-    {
-      // For boost < 1.71 the severity types are not automatically parsed so
-      // lets register them.
-      boost::log::register_simple_filter_factory<
-          boost::log::trivial::severity_level>("Severity");
-      boost::log::register_simple_formatter_factory<
-          boost::log::trivial::severity_level, char>("Severity");
-      boost::log::init_from_stream(logSettings);
-    }
-    catch (std::exception const &e)
-    {
-      OPENAUTO_LOG(warning)
-          << "[OpenAuto] " << logIni << " was provided but was not valid.";
-    }
-  }
+  // One thread: the media services each keep their own strand, and a second
+  // worker would only compete with the decoder for a core
+  threadPool.emplace_back([&mediaIoService]()
+                          {
+    autoapp::projection::ThreadTopology::instance().apply(
+        autoapp::projection::ThreadRole::MediaLane, "oa-media");
+    mediaIoService.run(); });
 }
 
 int main(int argc, char *argv[])
 {
-  configureLogging();
+  autoapp::StartupTrace::mark("main");
+  autoapp::Logging::configure("openauto-logs.ini");
   setOpenAutoEnvironmentDefaults();
 
+#ifdef USE_FFMPEG_DRM
+  // The previous exit's home screen, on the panel until Qt's first frame
+  if (autoapp::projection::BootSplash::instance().show())
+    autoapp::StartupTrace::mark("boot splash");
+#endif
+
   OPENAUTO_LOG(info) << "[AutoApp] Starting OpenAuto with QML UI...";
 
+  // Before anything is allocated through it
+  if (const char *allocator = std::getenv("OPENAUTO_ALLOCATOR"))
+  {
+    if (autoapp::AllocationAccounting::instance().selectBackend(allocator))
+      OPENAUTO_LOG(info) << "[AutoApp] Tagged allocations use " << allocator;
+    else
+      OPENAUTO_LOG(warning) << "[AutoApp] Ignoring OPENAUTO_ALLOCATOR=" << allocator
+                            << ", expected system, or mimalloc in USE_MIMALLOC builds";
+  }
+
+  // Bound before the audio and video threads first reach a kernel
+  autoapp::projection::simdKernels();
+  OPENAUTO_LOG(info) << "[AutoApp] SIMD kernels: " << f1x::openauto::common::CpuFeatures::host().describe();
+#ifndef NDEBUG
+  if (f1x::openauto::common::KernelSelfTest::instance().run() > 0)
+    OPENAUTO_LOG(error) << "[AutoApp] SIMD kernel self-test failed, OPENAUTO_SIMD=off runs the scalar references";
+#endif
+
+  // Logs what the last run recorded if it crashed, then records this one
+  if (autoapp::FlightRecorder::instance().open())
+    autoapp::FlightRecorder::instance().record(autoapp::FlightEvent::ProcessStarted, getpid());
+
   libusb_context *usbContext;
   if (libusb_init(&usbContext) != 0)
   {
@@ -142,18 +194,18 @@ int main(int argc, char *argv[])
     return 1;
   }
 
-  boost::asio::io_service ioService;
-  boost::asio::io_service::work work(ioService);
-  std::vector<std::thread> threadPool;
-  startUSBWorkers(ioService, usbContext, threadPool);
-  startIOServiceWorkers(ioService, threadPool);
-
   // Use QGuiApplication for QML-based UI
   QGuiApplication qApplication(argc, argv);
 
   // Set Qt Quick Controls 2 style
   QQuickStyle::setStyle("Basic");
 
+#ifdef USE_FFMPEG_DRM
+  // Only cleared to transparent over the projection, but the buffer format
+  // has to match eglfs.json's argb8888 from the first frame
+  QQuickWindow::setDefaultAlphaBuffer(true);
+#endif
+
   QScreen *primaryScreen = QGuiApplication::primaryScreen();
   int width = 800;
   int height = 480;
@@ -176,6 +228,124 @@ int main(int argc, char *argv[])
 
   auto configuration =
       std::make_shared<autoapp::configuration::Configuration>();
+  autoapp::StartupTrace::mark("configuration loaded");
+
+  // Worker counts and placement come from [Threads] in openauto.ini
+  autoapp::projection::ThreadTopologySettings threadSettings;
+  threadSettings.ioWorkers = configuration->getThreadIoWorkers();
+  threadSettings.workerCpus = configuration->getThreadWorkerCpus();
+  threadSettings.videoCpus = configuration->getThreadVideoCpus();
+  threadSettings.audioCpus = configuration->getThreadAudioCpus();
+  threadSettings.videoPriority = configuration->getThreadVideoPriority();
+  threadSettings.audioPriority = configuration->getThreadAudioPriority();
+  autoapp::projection::ThreadTopology::configure(threadSettings);
+  autoapp::StrandMonitor::instance().configure(configuration->getThreadStrandMonitor(),
+                                              configuration->getThreadStrandLongTaskMs());
+
+  // Wireless projection socket options, from [Wireless]; before App opens the listener
+  autoapp::TcpTuningSettings tcpSettings;
+  tcpSettings.noDelay = configuration->getWirelessTcpNoDelay();
+  tcpSettings.receiveBufferBytes = std::max(configuration->getWirelessTcpReceiveBufferKb(), 0) * 1024;
+  tcpSettings.sendBufferBytes = std::max(configuration->getWirelessTcpSendBufferKb(), 0) * 1024;
+  tcpSettings.quickAck = configuration->getWirelessTcpQuickAck();
+  tcpSettings.dscp = configuration->getWirelessTcpDscp();
+  tcpSettings.busyPollUs = configuration->getWirelessTcpBusyPollUs();
+  tcpSettings.linkStats = configuration->getWirelessTcpLinkStats();
+  autoapp::TcpTuning::instance().configure(tcpSettings);
+
+  // The radio under it; the channel scan is a startup task
+  autoapp::HotspotSettings hotspotSettings;
+  hotspotSettings.interface = configuration->getWirelessHotspotInterface();
+  hotspotSettings.autoChannel = configuration->getWirelessHotspotAutoChannel();
+  hotspotSettings.channelWidthMhz = configuration->getWirelessHotspotChannelWidthMhz();
+  hotspotSettings.powerSaveOff = configuration->getWirelessHotspotPowerSaveOff();
+  autoapp::HotspotLink::instance().configure(hotspotSettings);
+
+  // Clocks for projection and for the rest of the time, also from [Threads]
+  autoapp::PowerProfileMode projectionPower;
+  autoapp::PowerProfileMode idlePower;
+  if (!autoapp::parsePowerProfile(configuration->getThreadPowerProfileProjection(), projectionPower) ||
+      !autoapp::parsePowerProfile(configuration->getThreadPowerProfileIdle(), idlePower))
+  {
+    OPENAUTO_LOG(warning) << "[AutoApp] Unknown power profile, expected default, performance, "
+                             "floor or powersave";
+  }
+  autoapp::PowerProfile powerProfile(configuration->getThreadPowerDevfreqDevices());
+  powerProfile.apply(idlePower);
+
+  // Decodes a test stream with each video backend on the first boot only;
+  // the choice is stored in openauto.ini
+  autoapp::projection::VideoBackendProbe(configuration).select();
+  autoapp::StartupTrace::mark("video backend selected");
+
+  boost::asio::io_service ioService;
+  boost::asio::io_service::work work(ioService);
+  // Real-time lane for audio, video and input channel handlers
+  boost::asio::io_service mediaIoService;
+  boost::asio::io_service::work mediaWork(mediaIoService);
+  std::vector<std::thread> threadPool;
+  autoapp::UsbEventLoop usbEventLoop(usbContext);
+  usbEventLoop.start();
+  startIOServiceWorkers(ioService, threadPool);
+  startMediaLaneWorker(mediaIoService, threadPool);
+
+  // Without a phone the screen goes dark after DISCONNECTION_SCREEN_POWEROFF_SECS
+  // and the periodic work stops; the first press only turns it back on
+  auto idleMode = std::make_shared<autoapp::IdleMode>(ioService);
+
+  // Reverse camera on its own plane, driven by the reverse gear flag; buffers
+  // and planes are set up ahead so engaging reverse only starts streaming
+  autoapp::projection::RearCamera rearCamera(configuration);
+  if (configuration->getDashcamEnabled())
+  {
+    rearCamera.setRecorder(
+        std::make_shared<autoapp::projection::DashcamRecorder>(configuration));
+  }
+  std::atomic<int> reverseSubscription{0};
+
+  // Turn-by-turn on a second display or an overlay panel, from the
+  // navigation flag NavigationStatusService publishes
+  autoapp::projection::ClusterDisplay clusterDisplay(configuration);
+
+  // Steps that block on files or devices run on the pool while the window
+  // is created and QML loads; with two workers or more, one stays free for
+  // a phone plugged in meanwhile
+  autoapp::StartupGraph startupGraph(
+      ioService, std::max<uint32_t>(autoapp::projection::ThreadTopology::instance().ioWorkers(), 2) - 1);
+  startupGraph.add("tls_context", {}, [configuration]()
+                   { autoapp::service::AndroidAutoEntityFactory::prepareTls(*configuration); });
+  // Probed once; the session's audio outputs and the settings page use the snapshot
+  startupGraph.add("audio_devices", {}, []()
+                   { autoapp::projection::AudioDeviceList::getOutputDevices(); });
+#ifdef USE_FFMPEG_DRM
+  // Service discovery asks for it while the phone waits
+  startupGraph.add("video_decoders", {}, []()
+                   { autoapp::projection::FFmpegDrmVideoOutput::hevcHardwareAvailable(); });
+#endif
+  startupGraph.add("rear_camera", {}, [&rearCamera, &reverseSubscription, idleMode]()
+                   {
+    if (!rearCamera.prepare())
+      return;
+    auto &stateBus = autoapp::StateBus::instance();
+    rearCamera.setShown(stateBus.isSet(autoapp::StateFlag::ReverseGear));
+    reverseSubscription = stateBus.subscribe(
+        autoapp::StateFlag::ReverseGear,
+        [&rearCamera, idleMode](autoapp::StateFlag, bool reversing)
+        {
+          if (reversing)
+            idleMode->activity("reverse gear");
+          rearCamera.setShown(reversing);
+        }); });
+  // Picks its planes after the camera has taken its own
+  startupGraph.add("cluster_display", {"rear_camera"}, [&clusterDisplay]()
+                   { clusterDisplay.start(); });
+  // Last, as the scan holds its worker for seconds; nothing waits for it
+  if (hotspotSettings.autoChannel && configuration->getCSValue("ENABLE_HOTSPOT") == "1")
+  {
+    startupGraph.add("wifi_channel", {}, []()
+                     { autoapp::HotspotLink::instance().selectChannel(); });
+  }
+  startupGraph.start();
 
   // Hide cursor if configured
   if (configuration->showCursor() == false)
@@ -190,51 +360,39 @@ int main(int argc, char *argv[])
   // Create UI backend for QML
   auto uiBackend = new autoapp::ui::UIBackend(configuration);
 
-  // Create music player and file browser
-  auto audioPlayer = new autoapp::player::AudioPlayer();
-  auto fileBrowser = new autoapp::player::FileBrowserBackend();
-
-  // Connect audioPlayer state to UIBackend music properties
-  QObject::connect(audioPlayer, &autoapp::player::AudioPlayer::trackChanged,
-                   [uiBackend, audioPlayer]()
+  qApplication.installEventFilter(uiBackend);
+  QObject::connect(uiBackend, &autoapp::ui::UIBackend::userActivity, [idleMode]()
+                   { idleMode->activity("touch"); });
+
+  // Phone pairing and RFCOMM state pushed by btservice, instead of polled
+  auto &bluetoothLink = autoapp::BluetoothLink::instance();
+  const int bluetoothSubscription = bluetoothLink.subscribe(
+      [uiBackend, &bluetoothLink, idleMode](const f1x::openauto::common::BtLinkEvent &event)
+      {
+        if (event.type == f1x::openauto::common::BtLinkMessage::WifiOffered)
+          autoapp::StartupTrace::markOnce("hotspot offered over bluetooth");
+        // btservice's startup, stage by stage; replayed after a Hello
+        if (event.type == f1x::openauto::common::BtLinkMessage::ServiceStage &&
+            f1x::openauto::common::isBtServiceStage(event.name))
+        {
+          autoapp::Metrics::instance()
+              .gauge("openauto_btservice_" + event.name + "_ms", "btservice startup: ms in this stage, or in all of them for ready")
+              .set(event.value);
+          if (bluetoothLink.serviceReady())
+            autoapp::StartupTrace::markOnce("btservice ready");
+        }
+        // The wireless session is on its way
+        if (event.type == f1x::openauto::common::BtLinkMessage::PhoneConnected)
+          idleMode->activity("bluetooth");
+        QMetaObject::invokeMethod(uiBackend, [uiBackend, &bluetoothLink]()
+                                  { uiBackend->setBluetoothConnected(bluetoothLink.phoneConnected()); }, Qt::QueuedConnection);
+      });
+  uiBackend->setBluetoothConnected(bluetoothLink.phoneConnected());
+  // btservice stays connectable only once a phone is known; discoverable on request
+  QObject::connect(uiBackend, &autoapp::ui::UIBackend::requestPairing, [&bluetoothLink]()
                    {
-                     uiBackend->setTrackTitle(audioPlayer->trackTitle());
-                     uiBackend->setAlbumName(audioPlayer->albumName());
-                     uiBackend->setArtistName(audioPlayer->artistName());
-                     uiBackend->setAlbumArtPath(audioPlayer->albumArtPath());
-                   });
-  QObject::connect(audioPlayer, &autoapp::player::AudioPlayer::playbackStateChanged,
-                   [uiBackend, audioPlayer]()
-                   {
-                     uiBackend->setIsPlaying(audioPlayer->isPlaying());
-                   });
-
-  // Create QML engine
-  QQmlApplicationEngine engine;
-
-  // Expose backend to QML
-  engine.rootContext()->setContextProperty("backend", uiBackend);
-  engine.rootContext()->setContextProperty("audioPlayer", audioPlayer);
-  engine.rootContext()->setContextProperty("fileBrowser", fileBrowser);
-  engine.rootContext()->setContextProperty("screenWidth", width);
-  engine.rootContext()->setContextProperty("screenHeight", height);
-
-  // Add import path for custom QML modules
-  engine.addImportPath("qrc:/qml");
-
-  // Load main QML file
-  const QUrl url("qrc:/qml/Main.qml");
-  QObject::connect(&engine, &QQmlApplicationEngine::objectCreated, &qApplication, [url](QObject *obj, const QUrl &objUrl)
-                   {
-    if (!obj && url == objUrl)
-    {
-      OPENAUTO_LOG(error) << "[AutoApp] Failed to load QML UI.";
-      QCoreApplication::exit(-1);
-    } }, Qt::QueuedConnection);
-
-  engine.load(url);
-
-  OPENAUTO_LOG(info) << "[AutoApp] QML UI loaded successfully.";
+    if (!bluetoothLink.requestPairing(120))
+      OPENAUTO_LOG(warning) << "[AutoApp] btservice is not running, cannot open a pairing window"; });
 
   // Create USB/WiFi Android Auto infrastructure
   aasdk::tcp::TCPWrapper tcpWrapper;
@@ -242,7 +400,8 @@ int main(int argc, char *argv[])
   aasdk::usb::AccessoryModeQueryFactory queryFactory(usbWrapper, ioService);
   aasdk::usb::AccessoryModeQueryChainFactory queryChainFactory(
       usbWrapper, ioService, queryFactory);
-  autoapp::service::ServiceFactory serviceFactory(ioService, configuration);
+  autoapp::service::ServiceFactory serviceFactory(ioService, mediaIoService,
+                                                configuration);
   autoapp::service::AndroidAutoEntityFactory androidAutoEntityFactory(
       ioService, configuration, serviceFactory);
 
@@ -251,9 +410,43 @@ int main(int argc, char *argv[])
   auto connectedAccessoriesEnumerator(
       std::make_shared<aasdk::usb::ConnectedAccessoriesEnumerator>(
           usbWrapper, ioService, queryChainFactory));
+  // Phones seen in accessory mode before, reopened without the AOAP query chain
+  autoapp::configuration::IKnownDevicesList::Pointer knownDevices;
+  if (configuration->getUsbFastReconnect())
+  {
+    knownDevices = std::make_shared<autoapp::configuration::KnownDevicesList>(8);
+    knownDevices->read();
+  }
   auto app = std::make_shared<autoapp::App>(
       ioService, usbWrapper, tcpWrapper, androidAutoEntityFactory,
-      std::move(usbHub), std::move(connectedAccessoriesEnumerator));
+      std::move(usbHub), std::move(connectedAccessoriesEnumerator),
+      std::move(knownDevices));
+
+  // Off unless [Metrics] names an HTTP port or a StatsD target
+  autoapp::MetricsExporter::Pointer metricsExporter;
+  if (configuration->getMetricsHttpPort() != 0 ||
+      !configuration->getMetricsStatsdTarget().empty())
+  {
+    metricsExporter = std::make_shared<autoapp::MetricsExporter>(
+        ioService, static_cast<uint16_t>(configuration->getMetricsHttpPort()),
+        configuration->getMetricsStatsdTarget());
+    metricsExporter->start();
+  }
+
+  // Night mode and the backlight follow the light sensor when [Sensors]
+  // names one; otherwise the NightMode flag stays with external scripts
+  std::unique_ptr<autoapp::AmbientLight> ambientLight;
+  if (!configuration->getSensorLightDevice().empty())
+  {
+    autoapp::AmbientLightSettings lightSettings;
+    lightSettings.device = configuration->getSensorLightDevice();
+    lightSettings.nightLux = configuration->getSensorLightNightLux();
+    lightSettings.dayLux = configuration->getSensorLightDayLux();
+    lightSettings.backlight = configuration->getSensorLightBacklight();
+    ambientLight = std::make_unique<autoapp::AmbientLight>(lightSettings);
+    if (!ambientLight->start())
+      ambientLight.reset();
+  }
 
   // Connect UIBackend signals to Android Auto functionality
   QObject::connect(uiBackend, &autoapp::ui::UIBackend::requestAndroidAuto,
@@ -276,24 +469,213 @@ int main(int argc, char *argv[])
                      }
                    });
 
+  // Unattended run, usually against tests/bench/soak_bench: resources are
+  // sampled every minute and the exit status is 1 if any kept growing
+  autoapp::SoakMonitor::Pointer soakMonitor;
+  if (const char *soak = std::getenv("OPENAUTO_SOAK"))
+  {
+    autoapp::SoakSettings soakSettings;
+    if (autoapp::SoakMonitor::parseSpec(soak, soakSettings))
+      soakMonitor = std::make_shared<autoapp::SoakMonitor>(ioService, soakSettings);
+    else
+      OPENAUTO_LOG(warning) << "[AutoApp] Ignoring OPENAUTO_SOAK=" << soak
+                            << ", expected hours[,disconnectMinutes[,warmupMinutes]]";
+  }
+
   // Bridge App lifecycle callbacks to UIBackend Qt signals
   // These run on the boost strand, so use QMetaObject::invokeMethod for thread safety
-  app->onAAStarted = [uiBackend]()
+  app->onAAStarted = [uiBackend, &powerProfile, projectionPower, soakMonitor, idleMode]()
   {
     OPENAUTO_LOG(info) << "[AutoApp] Android Auto entity started.";
+    idleMode->onSessionStarted();
+    if (soakMonitor != nullptr)
+      soakMonitor->onSessionStarted();
+    powerProfile.apply(projectionPower);
+    autoapp::ui::UpdateDownloader::setProjectionActive(true);
+    autoapp::StartupTrace::markOnce("android auto started");
     QMetaObject::invokeMethod(uiBackend, [uiBackend]()
                               { emit uiBackend->androidAutoStarted(); }, Qt::QueuedConnection);
   };
 
-  app->onAAStopped = [uiBackend, &app]()
+  app->onAAStopped = [uiBackend, &app, &powerProfile, idlePower, soakMonitor, idleMode]()
   {
     OPENAUTO_LOG(info) << "[AutoApp] Android Auto entity stopped — auto-resume enabled.";
+    idleMode->onSessionStopped();
+    if (soakMonitor != nullptr)
+      soakMonitor->onSessionStopped();
+    powerProfile.apply(idlePower);
+    autoapp::ui::UpdateDownloader::setProjectionActive(false);
     // Keep autostart enabled so next USB connection auto-starts AA
     app->disableAutostartEntity = false;
     QMetaObject::invokeMethod(uiBackend, [uiBackend]()
                               { emit uiBackend->androidAutoStopped(); }, Qt::QueuedConnection);
   };
 
+#ifdef USE_FFMPEG_DRM
+  // Tells Main.qml whether it can stay up, transparent, above the video plane
+  autoapp::projection::FFmpegDrmVideoOutput::setStackingHandler(
+      [uiBackend](bool uiAboveVideo)
+      {
+        QMetaObject::invokeMethod(uiBackend, [uiBackend, uiAboveVideo]()
+                                  { uiBackend->setUiAboveVideo(uiAboveVideo); }, Qt::QueuedConnection);
+      });
+  uiBackend->setUiAboveVideo(autoapp::projection::FFmpegDrmVideoOutput::uiAboveVideo());
+#endif
+
+  // Heat steps the next session's video mode down and sheds the media EQ on
+  // its own; the UI only refreshes less often. Sampled on this thread.
+  auto &thermalGovernor = autoapp::ThermalGovernor::instance();
+  thermalGovernor.setHandler([uiBackend](autoapp::ThermalLevel level)
+                             { uiBackend->setThermalLevel(level); });
+  QTimer thermalTimer;
+  thermalTimer.setInterval(autoapp::ThermalGovernor::cSampleIntervalMs);
+  QObject::connect(&thermalTimer, &QTimer::timeout, [&thermalGovernor]()
+                   { thermalGovernor.sample(); });
+  // The first reading also records the clock ceilings, before anything heats up
+  thermalGovernor.sample();
+  thermalTimer.start();
+
+  auto idleSettings = [uiBackend]()
+  {
+    autoapp::IdleSettings settings;
+    settings.timeoutMs = uiBackend->disconnectTimeout() * 1000;
+    settings.screenOff = !uiBackend->disableScreenOff();
+    return settings;
+  };
+  idleMode->start(idleSettings(),
+                  [uiBackend, &thermalTimer](bool idle)
+                  {
+                    QMetaObject::invokeMethod(uiBackend, [uiBackend, &thermalTimer, idle]()
+                                              {
+                      // Nothing heats up with the screen off and no session
+                      if (idle)
+                        thermalTimer.stop();
+                      else
+                        thermalTimer.start();
+                      uiBackend->setIdle(idle); }, Qt::QueuedConnection);
+                  });
+  QObject::connect(uiBackend, &autoapp::ui::UIBackend::settingsChanged, [idleMode, idleSettings]()
+                   { idleMode->configure(idleSettings()); });
+
+  // Listen for phones before building any UI: the AOAP switch and handshake
+  // overlap with QML loading instead of following it
+  app->waitForUSBDevice();
+  autoapp::StartupTrace::mark("usb listener started");
+
+  // Create music player and file browser
+  auto audioPlayer = new autoapp::player::AudioPlayer();
+  auto fileBrowser = new autoapp::player::FileBrowserBackend();
+  audioPlayer->setLibrary(fileBrowser->library());
+  // Track gains are measured by the indexer, only when they will be used
+  audioPlayer->setReplayGainEnabled(configuration->getPlayerReplayGain());
+  fileBrowser->setLoudnessAnalysis(configuration->getPlayerReplayGain());
+
+  // UIBackend music properties follow the phone while it reports what it
+  // plays, and the local player otherwise
+  auto &phoneMedia = autoapp::player::PhoneMedia::instance();
+  phoneMedia.setArtCache(fileBrowser->library()->artCache());
+  auto updateMusic = [uiBackend, audioPlayer, &phoneMedia]()
+  {
+    const bool phone = phoneMedia.active();
+    uiBackend->setTrackTitle(phone ? phoneMedia.title() : audioPlayer->trackTitle());
+    uiBackend->setAlbumName(phone ? phoneMedia.album() : audioPlayer->albumName());
+    uiBackend->setArtistName(phone ? phoneMedia.artist() : audioPlayer->artistName());
+    uiBackend->setAlbumArtPath(phone ? phoneMedia.artUrl() : audioPlayer->albumArtPath());
+    uiBackend->setIsPlaying(phone ? phoneMedia.playing() : audioPlayer->isPlaying());
+  };
+  QObject::connect(audioPlayer, &autoapp::player::AudioPlayer::trackChanged, updateMusic);
+  QObject::connect(audioPlayer, &autoapp::player::AudioPlayer::playbackStateChanged, updateMusic);
+  QObject::connect(&phoneMedia, &autoapp::player::PhoneMedia::changed, updateMusic);
+  // During a session local playback is a source of the session's mixer,
+  // and gives way when the phone starts its own player
+  QObject::connect(uiBackend, &autoapp::ui::UIBackend::androidAutoStarted, audioPlayer,
+                   [audioPlayer, configuration, &serviceFactory]()
+                   {
+                     if (configuration->getAudioMixerEnabled())
+                       audioPlayer->setSharedOutput([&serviceFactory]()
+                                                    { return serviceFactory.createLocalPlaybackOutput(); });
+                   });
+  QObject::connect(uiBackend, &autoapp::ui::UIBackend::androidAutoStopped, audioPlayer,
+                   [audioPlayer]()
+                   { audioPlayer->setSharedOutput(nullptr); });
+  QObject::connect(&phoneMedia, &autoapp::player::PhoneMedia::focusRequested, audioPlayer,
+                   [audioPlayer]()
+                   {
+                     if (audioPlayer->isPlaying())
+                       audioPlayer->pause();
+                   });
+  // The progress bar is hidden under the projection: stop waking QML for it
+  QObject::connect(uiBackend, &autoapp::ui::UIBackend::projectionActiveChanged,
+                   [uiBackend, audioPlayer]()
+                   {
+                     audioPlayer->setPositionUpdatesEnabled(!uiBackend->projectionActive());
+                   });
+
+  // Main.qml binds the cap and the HUD; it paces the window once there is
+  // one. Outlives the engine, so the render thread never signals a dead pacer
+  autoapp::ui::FramePacer framePacer;
+
+  // Create QML engine
+  QQmlApplicationEngine engine;
+  // Owned by the engine; the atlas inflates while the QML below compiles
+  engine.addImageProvider(autoapp::ui::IconAtlas::cProviderId, new autoapp::ui::IconAtlas());
+
+#ifdef USE_FFMPEG_DRM
+  // Compositor-mode video (OpenAuto.Video/DmaBufVideoItem)
+  autoapp::projection::DmaBufVideoItem::registerQmlType();
+#endif
+
+  // Expose backend to QML
+  engine.rootContext()->setContextProperty("backend", uiBackend);
+  engine.rootContext()->setContextProperty("audioPlayer", audioPlayer);
+  engine.rootContext()->setContextProperty("fileBrowser", fileBrowser);
+  engine.rootContext()->setContextProperty("notifications", &autoapp::ui::NotificationModel::instance());
+  engine.rootContext()->setContextProperty("framePacer", &framePacer);
+  engine.rootContext()->setContextProperty("screenWidth", width);
+  engine.rootContext()->setContextProperty("screenHeight", height);
+
+  // Add import path for custom QML modules
+  engine.addImportPath("qrc:/qml");
+
+  // Load main QML file
+  const QUrl url("qrc:/qml/Main.qml");
+  QObject::connect(&engine, &QQmlApplicationEngine::objectCreated, &qApplication, [url](QObject *obj, const QUrl &objUrl)
+                   {
+    if (!obj && url == objUrl)
+    {
+      OPENAUTO_LOG(error) << "[AutoApp] Failed to load QML UI.";
+      QCoreApplication::exit(-1);
+    } }, Qt::QueuedConnection);
+
+  engine.load(url);
+
+  OPENAUTO_LOG(info) << "[AutoApp] QML UI loaded successfully.";
+  autoapp::StartupTrace::mark("qml shell loaded");
+  if (!engine.rootObjects().isEmpty())
+  {
+    if (auto *window = qobject_cast<QQuickWindow *>(engine.rootObjects().first()))
+    {
+      framePacer.attach(window);
+      QObject::connect(window, &QQuickWindow::frameSwapped, window, []()
+                       { autoapp::StartupTrace::markOnce("first frame"); });
+#ifdef USE_FFMPEG_DRM
+      // Queued to this thread; a little later still, so the flip to Qt's
+      // buffer has landed before the splash framebuffer goes
+      auto splashShown = std::make_shared<QMetaObject::Connection>();
+      *splashShown = QObject::connect(window, &QQuickWindow::frameSwapped, &qApplication, [splashShown]()
+                                      {
+        QObject::disconnect(*splashShown);
+        QTimer::singleShot(100, []()
+                           { autoapp::projection::BootSplash::instance().release(); }); });
+      // The home screen only: under the projection the UI is a transparent hole
+      QObject::connect(&qApplication, &QCoreApplication::aboutToQuit, window, [window, uiBackend]()
+                       {
+        if (!uiBackend->projectionActive())
+          autoapp::projection::BootSplash::instance().saveFrame(window->grabWindow()); });
+#endif
+    }
+  }
+
   QObject::connect(uiBackend, &autoapp::ui::UIBackend::exitRequested,
                    [&qApplication]()
                    {
@@ -302,18 +684,48 @@ int main(int argc, char *argv[])
                      qApplication.quit();
                    });
 
-  // Start waiting for USB device
-  app->waitForUSBDevice();
+  if (soakMonitor != nullptr)
+  {
+    // Random disconnects take the path of a phone that quit
+    soakMonitor->start([app]()
+                       { app->onAndroidAutoQuit(); },
+                       [&qApplication](bool passed)
+                       {
+                         QMetaObject::invokeMethod(&qApplication, [&qApplication, passed]()
+                                                   { qApplication.exit(passed ? 0 : 1); }, Qt::QueuedConnection);
+                       });
+  }
 
   auto result = qApplication.exec();
 
-  // Cleanup
+  // Cleanup: the work guard keeps run() alive, so stop the pool explicitly.
+  // Startup tasks first, as they run on it
+  if (!startupGraph.wait())
+    OPENAUTO_LOG(warning) << "[AutoApp] Startup tasks still running at exit: " << startupGraph.report();
+  if (reverseSubscription != 0)
+    autoapp::StateBus::instance().unsubscribe(reverseSubscription);
+  bluetoothLink.unsubscribe(bluetoothSubscription);
+  if (metricsExporter != nullptr)
+    metricsExporter->stop();
+  if (soakMonitor != nullptr)
+    soakMonitor->stop();
+  if (ambientLight != nullptr)
+    ambientLight->stop();
+  idleMode->stop();
+  ioService.stop();
+  mediaIoService.stop();
+  usbEventLoop.stop();
   std::for_each(threadPool.begin(), threadPool.end(),
                 std::bind(&std::thread::join, std::placeholders::_1));
 
-  delete fileBrowser;
+#ifdef USE_FFMPEG_DRM
+  autoapp::projection::FFmpegDrmVideoOutput::setStackingHandler(nullptr);
+#endif
   delete audioPlayer;
+  delete fileBrowser;
   delete uiBackend;
   libusb_exit(usbContext);
+  autoapp::FlightRecorder::instance().close();
+  autoapp::Logging::shutdown();
   return result;
 }
@@ -0,0 +1,78 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Deliberately includes no header that declares ioctl(): glibc's prototype is
+// noexcept, which this definition could not match.
+#include <dlfcn.h>
+#include <asm/ioctl.h>
+#include <atomic>
+#include <cstdarg>
+#include <f1x/openauto/bench/IoctlCounter.hpp>
+
+namespace {
+
+std::atomic<uint64_t> g_total{0};
+std::atomic<uint64_t> g_drm{0};
+std::atomic<uint64_t> g_v4l2{0};
+
+}  // namespace
+
+extern "C" int ioctl(int fd, unsigned long request, ...) {
+  using IoctlFunction = int (*)(int, unsigned long, ...);
+  static const auto libcIoctl = reinterpret_cast<IoctlFunction>(dlsym(RTLD_NEXT, "ioctl"));
+
+  va_list args;
+  va_start(args, request);
+  void *argument = va_arg(args, void *);
+  va_end(args);
+
+  g_total.fetch_add(1, std::memory_order_relaxed);
+  switch (_IOC_TYPE(request)) {
+    case 'd':
+      g_drm.fetch_add(1, std::memory_order_relaxed);
+      break;
+    case 'V':
+    case '|':
+      g_v4l2.fetch_add(1, std::memory_order_relaxed);
+      break;
+    default:
+      break;
+  }
+
+  return libcIoctl(fd, request, argument);
+}
+
+namespace f1x::openauto::bench {
+
+IoctlCounts ioctlCounts() {
+  IoctlCounts counts;
+  counts.total = g_total.load(std::memory_order_relaxed);
+  counts.drm = g_drm.load(std::memory_order_relaxed);
+  counts.v4l2 = g_v4l2.load(std::memory_order_relaxed);
+  return counts;
+}
+
+IoctlCounts operator-(const IoctlCounts &lhs, const IoctlCounts &rhs) {
+  IoctlCounts counts;
+  counts.total = lhs.total - rhs.total;
+  counts.drm = lhs.drm - rhs.drm;
+  counts.v4l2 = lhs.v4l2 - rhs.v4l2;
+  return counts;
+}
+
+}  // namespace f1x::openauto::bench
@@ -0,0 +1,239 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// crypto_bench - measures what the AAP TLS record layer costs per byte for
+// each cipher the headunit can negotiate, on this CPU.
+//
+//   crypto_bench [--seconds N] [--sizes 256,16384,65536]
+//
+// Each case runs a TLS 1.2 session over memory BIOs in one thread: the
+// "phone" side encrypts messages of the given size and the headunit side
+// decrypts them, which is the work the io_service threads do for every
+// media frame.
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <f1x/openauto/autoapp/Service/TlsCipherPolicy.hpp>
+
+namespace service = f1x::openauto::autoapp::service;
+
+namespace {
+
+struct Options {
+  double seconds = 2.0;
+  std::vector<size_t> sizes{256, 16384, 65536};
+};
+
+struct Cipher {
+  const char *label;
+  const char *name;  // TLS 1.2 suite; ECDSA only because the bench key is EC
+};
+
+const Cipher cCiphers[] = {
+    {"AES-128-GCM", "ECDHE-ECDSA-AES128-GCM-SHA256"},
+    {"AES-256-GCM", "ECDHE-ECDSA-AES256-GCM-SHA384"},
+    {"ChaCha20-Poly1305", "ECDHE-ECDSA-CHACHA20-POLY1305"},
+};
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--seconds" && hasValue) {
+      options.seconds = std::max(0.1, std::atof(argv[++i]));
+    } else if (arg == "--sizes" && hasValue) {
+      options.sizes.clear();
+      std::istringstream list(argv[++i]);
+      std::string size;
+      while (std::getline(list, size, ',')) {
+        const long value = std::atol(size.c_str());
+        if (value <= 0) {
+          return false;
+        }
+        options.sizes.push_back(static_cast<size_t>(value));
+      }
+    } else {
+      return false;
+    }
+  }
+  return !options.sizes.empty();
+}
+
+// Throwaway P-256 identity for the "phone" side
+bool makeIdentity(EVP_PKEY *&key, X509 *&certificate) {
+  EVP_PKEY_CTX *keyContext = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+  key = nullptr;
+  const bool keyMade = keyContext != nullptr && EVP_PKEY_keygen_init(keyContext) == 1 &&
+                       EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyContext, NID_X9_62_prime256v1) == 1 &&
+                       EVP_PKEY_keygen(keyContext, &key) == 1;
+  EVP_PKEY_CTX_free(keyContext);
+  if (!keyMade) {
+    return false;
+  }
+
+  certificate = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+  X509_gmtime_adj(X509_getm_notBefore(certificate), 0);
+  X509_gmtime_adj(X509_getm_notAfter(certificate), 3600);
+  X509_NAME *name = X509_get_subject_name(certificate);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *>("crypto_bench"), -1,
+                             -1, 0);
+  X509_set_issuer_name(certificate, name);
+  X509_set_pubkey(certificate, key);
+  return X509_sign(certificate, key, EVP_sha256()) > 0;
+}
+
+struct Session {
+  SSL *phone = nullptr;
+  SSL *headunit = nullptr;
+
+  ~Session() {
+    SSL_free(phone);
+    SSL_free(headunit);
+  }
+};
+
+BIO *memoryBio() {
+  BIO *bio = BIO_new(BIO_s_mem());
+  // Empty means "retry later", not end of stream
+  BIO_set_mem_eof_return(bio, -1);
+  return bio;
+}
+
+bool connect(SSL_CTX *phoneContext, SSL_CTX *headunitContext, Session &session) {
+  session.phone = SSL_new(phoneContext);
+  session.headunit = SSL_new(headunitContext);
+
+  BIO *toHeadunit = memoryBio();
+  BIO *toPhone = memoryBio();
+  BIO_up_ref(toHeadunit);
+  BIO_up_ref(toPhone);
+  SSL_set_bio(session.phone, toPhone, toHeadunit);
+  SSL_set_bio(session.headunit, toHeadunit, toPhone);
+  SSL_set_accept_state(session.phone);
+  SSL_set_connect_state(session.headunit);
+
+  for (int round = 0; round < 16; round++) {
+    const int headunit = SSL_do_handshake(session.headunit);
+    const int phone = SSL_do_handshake(session.phone);
+    if (headunit == 1 && phone == 1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void runCase(const Options &options, SSL_CTX *phoneContext, const Cipher &cipher, size_t size) {
+  SSL_CTX *headunitContext = SSL_CTX_new(TLS_client_method());
+  SSL_CTX_set_max_proto_version(headunitContext, TLS1_2_VERSION);
+  if (SSL_CTX_set_cipher_list(headunitContext, cipher.name) != 1) {
+    std::cout << std::left << std::setw(20) << cipher.label << " not supported by this OpenSSL" << std::endl;
+    SSL_CTX_free(headunitContext);
+    return;
+  }
+
+  Session session;
+  if (!connect(phoneContext, headunitContext, session)) {
+    std::cout << std::left << std::setw(20) << cipher.label << " handshake failed" << std::endl;
+    SSL_CTX_free(headunitContext);
+    return;
+  }
+
+  std::vector<unsigned char> message(size, 0x5a);
+  std::vector<unsigned char> received(size);
+  typedef std::chrono::steady_clock Clock;
+  Clock::duration encrypt{0}, decrypt{0};
+  uint64_t bytes = 0;
+  const auto deadline = Clock::now() + std::chrono::duration<double>(options.seconds);
+
+  while (Clock::now() < deadline) {
+    const auto written = Clock::now();
+    SSL_write(session.phone, message.data(), static_cast<int>(size));
+    const auto read = Clock::now();
+    size_t total = 0;
+    while (total < size) {
+      const int n = SSL_read(session.headunit, received.data() + total, static_cast<int>(size - total));
+      if (n <= 0) {
+        break;
+      }
+      total += static_cast<size_t>(n);
+    }
+    const auto done = Clock::now();
+    encrypt += read - written;
+    decrypt += done - read;
+    bytes += total;
+  }
+
+  const auto rate = [bytes](Clock::duration spent) {
+    const double seconds = std::chrono::duration<double>(spent).count();
+    return seconds > 0 ? bytes / seconds / (1024 * 1024) : 0.0;
+  };
+  std::cout << std::left << std::setw(20) << cipher.label << std::right << std::setw(8) << size << std::fixed
+            << std::setprecision(1) << std::setw(12) << rate(decrypt) << std::setw(12) << rate(encrypt)
+            << std::endl;
+  SSL_CTX_free(headunitContext);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    std::cerr << "Usage: " << argv[0] << " [--seconds N] [--sizes 256,16384,65536]" << std::endl;
+    return 2;
+  }
+
+  EVP_PKEY *key = nullptr;
+  X509 *certificate = nullptr;
+  if (!makeIdentity(key, certificate)) {
+    std::cerr << "Could not create the bench certificate" << std::endl;
+    return 1;
+  }
+
+  SSL_CTX *phoneContext = SSL_CTX_new(TLS_server_method());
+  SSL_CTX_use_certificate(phoneContext, certificate);
+  SSL_CTX_use_PrivateKey(phoneContext, key);
+
+  const bool hasAes = service::cpuHasAesInstructions();
+  std::cout << "AES instructions: " << (hasAes ? "yes" : "no") << ", autoapp offers "
+            << (hasAes ? "AES-GCM" : "ChaCha20-Poly1305") << " first" << std::endl;
+  std::cout << std::left << std::setw(20) << "cipher" << std::right << std::setw(8) << "bytes" << std::setw(12)
+            << "dec MB/s" << std::setw(12) << "enc MB/s" << std::endl;
+
+  for (const size_t size : options.sizes) {
+    for (const auto &cipher : cCiphers) {
+      runCase(options, phoneContext, cipher, size);
+    }
+  }
+
+  SSL_CTX_free(phoneContext);
+  X509_free(certificate);
+  EVP_PKEY_free(key);
+  return 0;
+}
@@ -0,0 +1,284 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// video_bench - replays a recorded Android Auto session (see MediaDump.hpp)
+// through FFmpegDrmVideoOutput::write() and reports decode throughput.
+//
+//   video_bench [--mode display,decode,software,native] [--realtime] [--speed X]
+//               [--loops N] [--resolution 480|720|1080] [--depth N] session.oamd
+//
+// display  - DRM hwaccel decode shown on the overlay plane (needs the display)
+// decode   - DRM hwaccel decode only, frames released as they come out
+// software - software decode shown through the dumb buffer fallback
+// native   - V4l2RequestDecoder decode shown on the overlay plane
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <aasdk/Messenger/ChannelId.hpp>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/autoapp/Configuration/Configuration.hpp>
+#include <f1x/openauto/autoapp/Projection/FFmpegDrmVideoOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDump.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
+#include <f1x/openauto/bench/IoctlCounter.hpp>
+
+namespace bench = f1x::openauto::bench;
+namespace projection = f1x::openauto::autoapp::projection;
+namespace configuration = f1x::openauto::autoapp::configuration;
+using aap_protobuf::service::media::sink::message::VideoCodecResolutionType;
+
+namespace {
+
+struct Options {
+  std::vector<std::string> modes{"display", "decode", "software"};
+  std::string path;
+  bool realtime = false;
+  double speed = 1.0;
+  int loops = 1;
+  VideoCodecResolutionType resolution = VideoCodecResolutionType::VIDEO_1280x720;
+  size_t depth = 1;
+};
+
+struct Stream {
+  std::vector<projection::MediaDumpRecord> frames;
+  double fps = 0.0;  // Rate the phone sent at, from the recorded arrival times
+};
+
+int64_t cpuTimeUs() {
+  struct rusage usage = {};
+  getrusage(RUSAGE_SELF, &usage);
+  return (static_cast<int64_t>(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000 +
+         usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+std::string ms(int64_t us) {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(1) << us / 1000.0;
+  return out.str();
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--mode" && hasValue) {
+      options.modes.clear();
+      std::istringstream list(argv[++i]);
+      std::string mode;
+      while (std::getline(list, mode, ',')) {
+        if (mode != "display" && mode != "decode" && mode != "software" && mode != "native") {
+          std::cerr << "Unknown mode " << mode << std::endl;
+          return false;
+        }
+        options.modes.push_back(mode);
+      }
+    } else if (arg == "--realtime") {
+      options.realtime = true;
+    } else if (arg == "--speed" && hasValue) {
+      options.realtime = true;
+      options.speed = std::max(0.01, std::atof(argv[++i]));
+    } else if (arg == "--loops" && hasValue) {
+      options.loops = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--resolution" && hasValue) {
+      const std::string value = argv[++i];
+      options.resolution = value == "1080"  ? VideoCodecResolutionType::VIDEO_1920x1080
+                           : value == "480" ? VideoCodecResolutionType::VIDEO_800x480
+                                            : VideoCodecResolutionType::VIDEO_1280x720;
+    } else if (arg == "--depth" && hasValue) {
+      options.depth = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+    } else if (!arg.empty() && arg[0] != '-' && options.path.empty()) {
+      options.path = arg;
+    } else {
+      return false;
+    }
+  }
+  return !options.path.empty() && !options.modes.empty();
+}
+
+bool loadStream(const std::string &path, Stream &stream) {
+  projection::MediaDumpReader reader(path);
+  if (!reader.isOpen()) {
+    std::cerr << "Not a session recording: " << path << std::endl;
+    return false;
+  }
+
+  const auto videoChannel = static_cast<uint16_t>(aasdk::messenger::ChannelId::MEDIA_SINK_VIDEO);
+  projection::MediaDumpRecord record;
+  while (reader.next(record)) {
+    if (record.channel == videoChannel && !record.payload.empty()) {
+      stream.frames.push_back(record);
+    }
+  }
+
+  if (stream.frames.size() < 2) {
+    std::cerr << "Recording has no video: " << path << std::endl;
+    return false;
+  }
+
+  const int64_t spanUs = stream.frames.back().arrivalUs - stream.frames.front().arrivalUs;
+  stream.fps = spanUs > 0 ? (stream.frames.size() - 1) * 1000000.0 / spanUs : 0.0;
+  return true;
+}
+
+// Feeds the recording like the phone does: never more than the output's unacked
+// window in flight, optionally at the recorded pace
+bool runMode(const std::string &mode, const Options &options, const Stream &stream) {
+  auto config = std::make_shared<configuration::Configuration>();
+  config->setVideoResolution(options.resolution);
+  config->setVideoFrameQueueDepth(options.depth);
+  config->setVideoCompositorImport(false);
+  config->showCursor(false);
+
+  auto output = std::make_shared<projection::FFmpegDrmVideoOutput>(config);
+  projection::FFmpegDrmVideoOutput::BenchmarkOptions benchmark;
+  benchmark.headless = mode == "decode";
+  benchmark.softwareDecode = mode == "software";
+  output->setBenchmarkOptions(benchmark);
+  output->setNativeDecoder(mode == "native");
+
+  std::mutex mutex;
+  std::condition_variable consumedCondition;
+  uint64_t consumed = 0;
+  output->setFrameConsumedHandler([&]() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      consumed++;
+    }
+    consumedCondition.notify_one();
+  });
+
+  if (!output->open() || !output->init()) {
+    std::cerr << "[" << mode << "] pipeline failed to start, skipped" << std::endl;
+    return false;
+  }
+
+  const size_t window = std::max<size_t>(output->getMaxUnackedFrames(), 1);
+  const bench::IoctlCounts ioctlsBefore = bench::ioctlCounts();
+  const int64_t cpuBefore = cpuTimeUs();
+  const auto start = std::chrono::steady_clock::now();
+
+  uint64_t written = 0;
+  const int64_t loopUs = stream.frames.back().arrivalUs - stream.frames.front().arrivalUs +
+                        (stream.fps > 0.0 ? static_cast<int64_t>(1000000 / stream.fps) : 0);
+  for (int loop = 0; loop < options.loops; loop++) {
+    for (const auto &frame : stream.frames) {
+      if (options.realtime) {
+        // Later loops continue one frame interval after the previous one ended
+        const int64_t offsetUs = frame.arrivalUs - stream.frames.front().arrivalUs + loop * loopUs;
+        std::this_thread::sleep_until(
+            start + std::chrono::microseconds(static_cast<int64_t>(offsetUs / options.speed)));
+      }
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        consumedCondition.wait(lock, [&]() { return written - consumed < window; });
+      }
+      output->write(frame.timestamp, aasdk::common::DataConstBuffer(frame.payload));
+      written++;
+    }
+  }
+
+  // Let the decoder empty its queue, then wait for the last frames to come out
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    consumedCondition.wait(lock, [&]() { return consumed >= written; });
+  }
+  auto &telemetry = projection::VideoTelemetry::instance();
+  uint64_t shown = telemetry.snapshot().framesDisplayed;
+  auto end = std::chrono::steady_clock::now();
+  for (int idle = 0; idle < 4;) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const uint64_t now = telemetry.snapshot().framesDisplayed;
+    if (now != shown) {
+      // The idle polls after the last frame are not part of the run
+      end = std::chrono::steady_clock::now();
+      idle = 0;
+    } else {
+      idle++;
+    }
+    shown = now;
+  }
+  const int64_t cpuUs = cpuTimeUs() - cpuBefore;
+  const bench::IoctlCounts ioctls = bench::ioctlCounts() - ioctlsBefore;
+  const projection::VideoTelemetrySnapshot snapshot = telemetry.snapshot();
+  output->stop();
+
+  const double wallS =
+      std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), 1) /
+      1000000.0;
+  const double fps = snapshot.framesDisplayed / wallS;
+  const double perFrame = snapshot.framesDisplayed > 0
+                              ? static_cast<double>(ioctls.total) / snapshot.framesDisplayed
+                              : 0.0;
+
+  // Percentiles cover the telemetry window (the most recent frames)
+  std::cout << std::fixed << std::setprecision(1) << "[" << mode << "] "
+            << snapshot.framesDisplayed << "/" << written << " frames in " << std::setprecision(2)
+            << wallS << " s: " << std::setprecision(1) << fps << " fps";
+  if (stream.fps > 0.0) {
+    std::cout << " (" << std::setprecision(2) << fps / stream.fps << "x of " << std::setprecision(1)
+              << stream.fps << " fps recording)";
+  }
+  std::cout << ", CPU " << std::setprecision(2) << cpuUs / 1000000.0 << " s ("
+            << std::setprecision(0) << 100.0 * cpuUs / 1000000.0 / wallS << "%)"
+            << ", decode " << ms(snapshot.decode.p50Us) << "/" << ms(snapshot.decode.p99Us)
+            << " ms, display " << ms(snapshot.display.p50Us) << "/" << ms(snapshot.display.p99Us)
+            << " ms, e2e " << ms(snapshot.endToEnd.p50Us) << "/" << ms(snapshot.endToEnd.p99Us)
+            << " ms (p50/p99), ioctl " << ioctls.total << " (drm " << ioctls.drm << ", v4l2 "
+            << ioctls.v4l2 << ", " << std::setprecision(1) << perFrame << "/frame), dropped "
+            << snapshot.packetsDropped << std::endl;
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--mode display,decode,software] [--realtime] [--speed X] [--loops N]"
+                 " [--resolution 480|720|1080] [--depth N] session.oamd"
+              << std::endl;
+    return 2;
+  }
+
+  Stream stream;
+  if (!loadStream(options.path, stream)) {
+    return 1;
+  }
+
+  OPENAUTO_LOG(info) << "[video_bench] " << stream.frames.size() << " video frames, "
+                     << stream.fps << " fps recording";
+
+  bool anyRan = false;
+  for (const auto &mode : options.modes) {
+    anyRan = runMode(mode, options, stream) || anyRan;
+  }
+  return anyRan ? 0 : 1;
+}
@@ -21,9 +21,15 @@
 #include <f1x/openauto/autoapp/Configuration/IConfiguration.hpp>
 #include <f1x/openauto/btservice/AndroidBluetoothServer.hpp>
 #include <QString>
+#include <QBluetoothSocket>
+#include <QFileInfo>
 #include <QtCore/QDataStream>
+#include <QtEndian>
 #include <QNetworkInterface>
+#include <time.h>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/unknown_field_set.h>
@@ -36,11 +42,31 @@ using namespace google::protobuf::io;
 namespace f1x::openauto::btservice
 {
 
-  AndroidBluetoothServer::AndroidBluetoothServer(autoapp::configuration::IConfiguration::Pointer configuration)
+  namespace
+  {
+    const QString cHostapdConfig = "/etc/hostapd/hostapd.conf";
+    // The service we register, which phones that ran Android Auto wireless
+    // against us answer on as well
+    const QBluetoothUuid cAndroidAutoUuid(QLatin1String("4de17a00-52cb-11e6-bdf4-0800200c9a66"));
+    constexpr size_t cKnownPhones = 4;
+
+    // Logged against boot like autoapp's StartupTrace, so the two
+    // processes' logs line up into one ignition-to-projection timeline
+    long long bootTimeMs()
+    {
+      timespec now{};
+      clock_gettime(CLOCK_BOOTTIME, &now);
+      return static_cast<long long>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+    }
+  }
+
+  AndroidBluetoothServer::AndroidBluetoothServer(autoapp::configuration::IConfiguration::Pointer configuration,
+                                                 BtLinkPublisher *link)
       : rfcommServer_(std::make_unique<QBluetoothServer>(QBluetoothServiceInfo::RfcommProtocol, this)),
-        configuration_(std::move(configuration))
+        configuration_(std::move(configuration)), link_(link), knownPhones_(cKnownPhones)
   {
     OPENAUTO_LOG(info) << "[AndroidBluetoothServer::AndroidBluetoothServer] Initialising";
+    knownPhones_.read();
 
     connect(rfcommServer_.get(), &QBluetoothServer::newConnection, this,
             &AndroidBluetoothServer::onClientConnected);
@@ -53,12 +79,27 @@ namespace f1x::openauto::btservice
     rfcommServer_->close(); // Close should always be called before listen.
     if (rfcommServer_->listen(address))
     {
-
+      // Read the hotspot credentials now, not while the phone waits for them
+      wifiInfo();
+      markStage("rfcomm listening");
       return rfcommServer_->serverPort();
     }
     return 0;
   }
 
+  void AndroidBluetoothServer::markStage(const char *stage)
+  {
+    if (connectTimer_.isValid())
+    {
+      OPENAUTO_LOG(info) << "[Startup] " << stage << ": +" << connectTimer_.elapsed() << " ms since rfcomm connect ("
+                         << bootTimeMs() << " ms since boot)";
+    }
+    else
+    {
+      OPENAUTO_LOG(info) << "[Startup] " << stage << " (" << bootTimeMs() << " ms since boot)";
+    }
+  }
+
   void AndroidBluetoothServer::onError(QBluetoothServer::Error error)
   {
     OPENAUTO_LOG(debug) << "[AndroidBluetoothServer::onError]";
@@ -74,155 +115,288 @@ namespace f1x::openauto::btservice
       socket = nullptr; // Prevent race condition with quick reconnects
     }
 
-    socket = rfcommServer_->nextPendingConnection();
-
-    if (socket != nullptr)
+    QBluetoothSocket *connected = rfcommServer_->nextPendingConnection();
+    if (connected == nullptr)
     {
-      OPENAUTO_LOG(debug) << "[AndroidBluetoothServer] rfcomm client connected, peer name: "
-                          << socket->peerName().toStdString();
+      OPENAUTO_LOG(error) << "[AndroidBluetoothServer] received null socket during client connection.";
+      return;
+    }
+    // The phone was quicker than our call to it
+    this->dropOutgoing();
+    knownPhones_.remember(connected->peerAddress().toString().toStdString(), 0);
+    connectTimer_.start();
+    markStage("rfcomm connected");
+    this->attachSocket(connected);
+  }
 
-      connect(socket, &QBluetoothSocket::readyRead, this, &AndroidBluetoothServer::readSocket);
+  bool AndroidBluetoothServer::reconnectKnownPhone()
+  {
+    const auto phones = knownPhones_.getList();
+    if (phones.empty())
+    {
+      return false;
+    }
+    connectTimer_.start();
+    markStage("calling known phone");
+    this->connectToPhone(QBluetoothAddress(QString::fromStdString(phones.front().address)), phones.front().channel);
+    return true;
+  }
 
-      aap_protobuf::aaw::WifiVersionRequest versionRequest;
-      aap_protobuf::aaw::WifiStartRequest startRequest;
-      startRequest.set_ip_address(getIP4_("wlan0"));
-      startRequest.set_port(5000);
+  void AndroidBluetoothServer::connectToPhone(const QBluetoothAddress &address, quint16 channel)
+  {
+    if (socket != nullptr)
+    {
+      return;
+    }
+    this->dropOutgoing();
+    auto *outgoing = new QBluetoothSocket(QBluetoothServiceInfo::RfcommProtocol, this);
+    outgoing_ = outgoing;
+
+    connect(outgoing, &QBluetoothSocket::connected, this, [this, outgoing, address]()
+            {
+      outgoing_ = nullptr;
+      if (socket != nullptr)
+      {
+        outgoing->deleteLater();
+        return;
+      }
+      // Cached for the next boot, which then skips the SDP lookup
+      knownPhones_.remember(address.toString().toStdString(), outgoing->peerPort());
+      markStage("known phone answered");
+      this->attachSocket(outgoing); });
+    connect(outgoing, QOverload<QBluetoothSocket::SocketError>::of(&QBluetoothSocket::error), this,
+            [this, outgoing, address, channel](QBluetoothSocket::SocketError error)
+            {
+      outgoing_ = nullptr;
+      outgoing->deleteLater();
+      if (channel != 0)
+      {
+        // The phone may have moved its service: look it up once
+        OPENAUTO_LOG(info) << "[AndroidBluetoothServer] Cached channel " << channel << " on "
+                           << address.toString().toStdString() << " failed, trying SDP";
+        knownPhones_.forgetChannel(address.toString().toStdString());
+        this->connectToPhone(address, 0);
+        return;
+      }
+      OPENAUTO_LOG(info) << "[AndroidBluetoothServer] " << address.toString().toStdString()
+                         << " did not answer (" << error << "), waiting for it to connect"; });
 
-      sendMessage(versionRequest, aap_protobuf::aaw::MessageId::WIFI_VERSION_REQUEST);
-      sendMessage(startRequest, aap_protobuf::aaw::MessageId::WIFI_START_REQUEST);
+    if (channel != 0)
+    {
+      outgoing->connectToService(address, channel);
     }
     else
     {
-      OPENAUTO_LOG(error) << "[AndroidBluetoothServer] received null socket during client connection.";
+      outgoing->connectToService(address, cAndroidAutoUuid);
     }
   }
 
-  /// Read data from Bluetooth Socket
-  void AndroidBluetoothServer::readSocket()
+  void AndroidBluetoothServer::dropOutgoing()
   {
-    buffer += socket->readAll();
+    if (outgoing_ != nullptr)
+    {
+      // Signals first, so the abort does not count as a failed call
+      outgoing_->disconnect(this);
+      outgoing_->abort();
+      outgoing_->deleteLater();
+      outgoing_ = nullptr;
+    }
+  }
 
-    OPENAUTO_LOG(debug) << "[AndroidBluetoothServer::readSocket] Reading from socket.";
+  void AndroidBluetoothServer::attachSocket(QBluetoothSocket *connected)
+  {
+    socket = connected;
+    bufferStart_ = bufferEnd_ = 0; // a partial frame from the old peer is stale
+    OPENAUTO_LOG(debug) << "[AndroidBluetoothServer] rfcomm client connected, peer name: "
+                        << socket->peerName().toStdString();
 
-    if (buffer.length() < 4)
+    connect(socket, &QBluetoothSocket::readyRead, this, &AndroidBluetoothServer::readSocket);
+    if (link_ != nullptr)
     {
-      OPENAUTO_LOG(debug) << "[AndroidBluetoothServer::readSocket] Not enough data, waiting for more.";
-      return;
+      const QString address = socket->peerAddress().toString();
+      link_->phoneConnected(address, socket->peerName());
+      connect(socket, &QBluetoothSocket::disconnected, link_, [link = link_, address]()
+              { link->phoneDisconnected(address); });
     }
 
-    QDataStream stream(buffer);
-    uint16_t length;
-    stream >> length;
+    aap_protobuf::aaw::WifiVersionRequest versionRequest;
+    aap_protobuf::aaw::WifiStartRequest startRequest;
+    startRequest.set_ip_address(getIP4_("wlan0"));
+    startRequest.set_port(5000);
+
+    sendMessage(versionRequest, aap_protobuf::aaw::MessageId::WIFI_VERSION_REQUEST);
+    sendMessage(startRequest, aap_protobuf::aaw::MessageId::WIFI_START_REQUEST);
+  }
 
-    if (buffer.length() < length + 4)
+  /// Read data from Bluetooth Socket
+  void AndroidBluetoothServer::readSocket()
+  {
+    const qint64 available = socket->bytesAvailable();
+    if (available <= 0)
     {
-      OPENAUTO_LOG(debug) << "[AndroidBluetoothServer::readSocket] Not enough data, waiting for more: " << buffer.length();
       return;
     }
 
-    quint16 rawMessageId;
-    stream >> rawMessageId;
+    // Frames are parsed where they lie; the consumed prefix is only moved
+    // out of the way when the free tail cannot take the new bytes
+    if (bufferEnd_ + available > buffer.size())
+    {
+      const int pending = bufferEnd_ - bufferStart_;
+      if (bufferStart_ > 0)
+      {
+        std::memmove(buffer.data(), buffer.constData() + bufferStart_, pending);
+        bufferStart_ = 0;
+        bufferEnd_ = pending;
+      }
+      if (pending + available > buffer.size())
+      {
+        buffer.resize(static_cast<int>(pending + available));
+      }
+    }
+
+    const qint64 received = socket->read(buffer.data() + bufferEnd_, available);
+    if (received > 0)
+    {
+      bufferEnd_ += static_cast<int>(received);
+    }
 
-    aap_protobuf::aaw::MessageId messageId;
-    messageId = static_cast<aap_protobuf::aaw::MessageId>(rawMessageId);
+    // The phone sends its replies back to back: handle every complete frame
+    // now rather than one per readyRead
+    while (bufferEnd_ - bufferStart_ >= cFrameHeaderSize)
+    {
+      const auto *header = reinterpret_cast<const uchar *>(buffer.constData() + bufferStart_);
+      const uint16_t length = qFromBigEndian<quint16>(header);
+      if (bufferEnd_ - bufferStart_ < cFrameHeaderSize + length)
+      {
+        OPENAUTO_LOG(debug) << "[AndroidBluetoothServer::readSocket] Not enough data, waiting for more: " << bufferEnd_ - bufferStart_;
+        break;
+      }
 
-    OPENAUTO_LOG(debug) << "[AndroidBluetoothServer::readSocket] Message length: " << length << " MessageId: " << messageId;
+      const auto messageId = static_cast<aap_protobuf::aaw::MessageId>(qFromBigEndian<quint16>(header + 2));
+      handleMessage(messageId, buffer.constData() + bufferStart_ + cFrameHeaderSize, length);
+      bufferStart_ += cFrameHeaderSize + length;
+    }
+
+    if (bufferStart_ == bufferEnd_)
+    {
+      bufferStart_ = bufferEnd_ = 0;
+    }
+  }
+
+  /// Dispatches one complete frame
+  /// \param messageId
+  /// \param data payload, valid only for the duration of the call
+  /// \param length payload size
+  void AndroidBluetoothServer::handleMessage(aap_protobuf::aaw::MessageId messageId, const char *data, uint16_t length)
+  {
+    OPENAUTO_LOG(debug) << "[AndroidBluetoothServer::handleMessage] Message length: " << length << " MessageId: " << messageId;
 
     switch (messageId)
     {
 
     case aap_protobuf::aaw::MessageId::WIFI_INFO_REQUEST: // WifiInfoRequest - Respond with a WifiInfoResponse
-      handleWifiInfoRequest(buffer, length);
+      handleWifiInfoRequest(data, length);
       break;
     case aap_protobuf::aaw::MessageId::WIFI_VERSION_RESPONSE: // WifiVersionRequest - Send a Version Request
-      handleWifiVersionResponse(buffer, length);              // do something
+      handleWifiVersionResponse(data, length);                // do something
       break;
     case aap_protobuf::aaw::MessageId::WIFI_CONNECTION_STATUS: // WifiStartResponse  - Receive a confirmation
-      handleWifiConnectionStatus(buffer, length);
+      handleWifiConnectionStatus(data, length);
       break;
     case aap_protobuf::aaw::MessageId::WIFI_START_RESPONSE: // WifiStartResponse  - Receive a confirmation
-      handleWifiStartResponse(buffer, length);
+      handleWifiStartResponse(data, length);
       break;
     case aap_protobuf::aaw::MessageId::WIFI_START_REQUEST:   // These are not received from the MD.
     case aap_protobuf::aaw::MessageId::WIFI_INFO_RESPONSE:   // These are not received from the MD.
     case aap_protobuf::aaw::MessageId::WIFI_VERSION_REQUEST: // These are not received from the MD.
     default:
-      QByteArray messageData = buffer.mid(stream.device()->pos(), length - 2);
-
-      // Convert QByteArray to std::string
-      std::string protoData = messageData.toStdString();
+      OPENAUTO_LOG(debug) << "[AndroidBluetoothServer::handleMessage] Unknown message: " << messageId;
+      this->DecodeProtoMessage(data, length);
 
-      // Pass it to your function
-      this->DecodeProtoMessage(protoData);
-
-      std::stringstream ss;
-      ss << std::hex << std::setfill('0');
-      for (auto &&val : buffer)
-      {
-        ss << std::setw(2) << static_cast<unsigned>(val);
-      }
-      OPENAUTO_LOG(debug) << "[AndroidBluetoothServer::readSocket] Unknown message: " << messageId;
-      OPENAUTO_LOG(debug) << "[AndroidBluetoothServer::readSocket] Data " << ss.str();
+      std::string hex;
+      hex.reserve(length * 2);
+      boost::algorithm::hex_lower(data, data + length, std::back_inserter(hex));
+      OPENAUTO_LOG(debug) << "[AndroidBluetoothServer::handleMessage] Data " << hex;
 
       break;
     }
-
-    buffer = buffer.mid(length + 4);
   }
 
   /// Handles request for WifiInfoRequest by sending a WifiInfoResponse
-  /// \param buffer
+  /// \param data
   /// \param length
-  void AndroidBluetoothServer::handleWifiInfoRequest(QByteArray &buffer, uint16_t length)
+  void AndroidBluetoothServer::handleWifiInfoRequest(const char *data, uint16_t length)
   {
     OPENAUTO_LOG(info) << "[AndroidBluetoothServer::handleWifiInfoRequest] Handling wifi info request";
 
-    aap_protobuf::aaw::WifiInfoResponse response;
+    sendMessage(wifiInfo(), aap_protobuf::aaw::MessageId::WIFI_INFO_RESPONSE);
+    markStage("wifi info sent");
+    if (link_ != nullptr)
+    {
+      link_->wifiOffered(QString::fromStdString(wifiInfo_.ssid()));
+    }
+  }
 
-    response.set_ssid(configuration_->getParamFromFile("/etc/hostapd/hostapd.conf", "ssid").toStdString());
-    response.set_password(
-        configuration_->getParamFromFile("/etc/hostapd/hostapd.conf", "wpa_passphrase").toStdString());
-    response.set_bssid(QNetworkInterface::interfaceFromName("wlan0").hardwareAddress().toStdString());
+  /// The WifiInfoResponse for our hotspot, rebuilt only when hostapd.conf changes
+  const aap_protobuf::aaw::WifiInfoResponse &AndroidBluetoothServer::wifiInfo()
+  {
+    const QDateTime modified = QFileInfo(cHostapdConfig).lastModified();
+    // wlan0 may still be coming up at boot: keep asking until it has a MAC
+    if (!wifiInfo_.bssid().empty() && modified == wifiInfoModified_)
+    {
+      return wifiInfo_;
+    }
+
+    wifiInfoModified_ = modified;
+    wifiInfo_.set_ssid(configuration_->getParamFromFile(cHostapdConfig, "ssid").toStdString());
+    wifiInfo_.set_password(configuration_->getParamFromFile(cHostapdConfig, "wpa_passphrase").toStdString());
+    wifiInfo_.set_bssid(QNetworkInterface::interfaceFromName("wlan0").hardwareAddress().toStdString());
     // TODO: AAP uses different values than WiFiProjection....
-    response.set_security_mode(
+    wifiInfo_.set_security_mode(
         aap_protobuf::service::wifiprojection::message::WifiSecurityMode::WPA2_ENTERPRISE);
-    response.set_access_point_type(aap_protobuf::service::wifiprojection::message::AccessPointType::STATIC);
-
-    sendMessage(response, 3);
+    wifiInfo_.set_access_point_type(aap_protobuf::service::wifiprojection::message::AccessPointType::STATIC);
+    OPENAUTO_LOG(info) << "[AndroidBluetoothServer::wifiInfo] Hotspot " << wifiInfo_.ssid() << ", bssid " << wifiInfo_.bssid();
+    return wifiInfo_;
   }
 
   /// Listens for a WifiVersionResponse from the MD - usually just a notification
-  /// \param buffer
+  /// \param data
   /// \param length
-  void AndroidBluetoothServer::handleWifiVersionResponse(QByteArray &buffer, uint16_t length)
+  void AndroidBluetoothServer::handleWifiVersionResponse(const char *data, uint16_t length)
   {
     OPENAUTO_LOG(info) << "[AndroidBluetoothServer::handleWifiVersionResponse] Handling wifi version response";
 
     aap_protobuf::aaw::WifiVersionResponse response;
-    response.ParseFromArray(buffer.data() + 4, length);
+    response.ParseFromArray(data, length);
     OPENAUTO_LOG(debug) << "[AndroidBluetoothServer::handleWifiVersionResponse] Unknown Param 1: " << response.unknown_value_a() << " Unknown Param 2: " << response.unknown_value_b();
   }
 
   /// Listens for WifiStartResponse from MD - usually just a notification with a status
-  /// \param buffer
+  /// \param data
   /// \param length
-  void AndroidBluetoothServer::handleWifiStartResponse(QByteArray &buffer, uint16_t length)
+  void AndroidBluetoothServer::handleWifiStartResponse(const char *data, uint16_t length)
   {
     OPENAUTO_LOG(info) << "[AndroidBluetoothServer::handleWifiStartResponse] Handling wifi start response";
 
     aap_protobuf::aaw::WifiStartResponse response;
-    response.ParseFromArray(buffer.data() + 4, length);
+    response.ParseFromArray(data, length);
+    markStage("wifi start response");
     OPENAUTO_LOG(debug) << "[AndroidBluetoothServer::handleWifiStartResponse] " << response.ip_address() << " port " << response.port() << " status " << Status_Name(response.status());
   }
 
   /// Handles request for WifiStartRequest by sending a WifiStartResponse
-  /// \param buffer
+  /// \param data
   /// \param length
-  void AndroidBluetoothServer::handleWifiConnectionStatus(QByteArray &buffer, uint16_t length)
+  void AndroidBluetoothServer::handleWifiConnectionStatus(const char *data, uint16_t length)
   {
     aap_protobuf::aaw::WifiConnectionStatus status;
-    status.ParseFromArray(buffer.data() + 4, length);
+    status.ParseFromArray(data, length);
+    markStage("wifi connection status");
     OPENAUTO_LOG(info) << "[AndroidBluetoothServer::handleWifiConnectionStatus] Handle wifi connection status, received: " << Status_Name(status.status());
+    if (link_ != nullptr)
+    {
+      link_->wifiStatus(status.status());
+    }
   }
 
   void AndroidBluetoothServer::sendMessage(const google::protobuf::Message &message, uint16_t type)
@@ -236,13 +410,6 @@ namespace f1x::openauto::btservice
     ds << type;
     message.SerializeToArray(out.data() + 4, byteSize);
 
-    std::stringstream ss;
-    ss << std::hex << std::setfill('0');
-    for (auto &&val : out)
-    {
-      ss << std::setw(2) << static_cast<unsigned>(val);
-    }
-
     OPENAUTO_LOG(debug) << message.GetTypeName() << " - " + message.DebugString();
 
     auto written = socket->write(out);
@@ -267,13 +434,14 @@ namespace f1x::openauto::btservice
   }
 
   /// Decode Proto Messages to their constituent components
-  /// \param proto_data
-  void AndroidBluetoothServer::DecodeProtoMessage(const std::string &proto_data)
+  /// \param data
+  /// \param length
+  void AndroidBluetoothServer::DecodeProtoMessage(const char *data, int length)
   {
     UnknownFieldSet set;
 
     // Create streams
-    ArrayInputStream raw_input(proto_data.data(), proto_data.size());
+    ArrayInputStream raw_input(data, length);
     CodedInputStream input(&raw_input);
 
     // Decode the message
@@ -2,6 +2,9 @@
 // Created by Simon Dean on 26/11/2024.
 //
 
+#include <algorithm>
+#include <string>
+#include <f1x/openauto/Common/BtLink.hpp>
 #include <f1x/openauto/btservice/BluetoothHandler.hpp>
 #include <f1x/openauto/btservice/AndroidBluetoothService.hpp>
 #include <f1x/openauto/btservice/AndroidBluetoothServer.hpp>
@@ -12,55 +15,171 @@ namespace f1x::openauto::btservice {
                                      autoapp::configuration::IConfiguration::Pointer configuration)
   : configuration_(std::move(configuration)),
     androidBluetoothService_(std::move(androidBluetoothService)),
-    androidBluetoothServer_(std::make_unique<btservice::AndroidBluetoothServer>(configuration_)) {
+    link_(std::make_unique<BtLinkPublisher>()),
+    androidBluetoothServer_(std::make_unique<btservice::AndroidBluetoothServer>(configuration_, link_.get())),
+    alwaysDiscoverable_(configuration_->getCSValue("ENABLE_PAIRABLE") == "1"),
+    address_(QString::fromStdString(configuration_->getBluetoothAdapterAddress())),
+    portNumber_(0),
+    stage_(Stage::Adapter),
+    poweringOn_(false),
+    attempts_(0),
+    retryMs_(cFirstRetryMs) {
 
     OPENAUTO_LOG(info) << "[BluetoothHandler::BluetoothHandler] Starting Up...";
+    startup_.start();
+    stageClock_.start();
+
+    pairingTimer_.setSingleShot(true);
+    QObject::connect(&pairingTimer_, &QTimer::timeout, this, [this]() {
+      if (!alwaysDiscoverable_) {
+        OPENAUTO_LOG(info) << "[BluetoothHandler] Pairing window closed";
+        localDevice_->setHostMode(QBluetoothLocalDevice::HostConnectable);
+      }
+    });
+    QObject::connect(link_.get(), &BtLinkPublisher::pairingRequested, this, &BluetoothHandler::onPairingRequested);
+
+    // Nothing talks to BlueZ before the event loop runs
+    stageTimer_.setSingleShot(true);
+    QObject::connect(&stageTimer_, &QTimer::timeout, this, &BluetoothHandler::runStage);
+    stageTimer_.start(0);
+  }
+
+  void BluetoothHandler::runStage() {
+    switch (stage_) {
+      case Stage::Adapter:
+        this->openAdapter();
+        break;
+
+      case Stage::Listen:
+        portNumber_ = androidBluetoothServer_->start(address_);
+        if (portNumber_ == 0) {
+          this->retry("server start failed");
+          return;
+        }
+        OPENAUTO_LOG(info) << "[BluetoothHandler::runStage] Listening for connections, address: "
+                           << address_.toString().toStdString() << ", port: " << portNumber_;
+        this->advance();
+        break;
+
+      case Stage::Register:
+        if (!androidBluetoothService_->registerService(portNumber_, address_)) {
+          this->retry("service registration failed");
+          return;
+        }
+        OPENAUTO_LOG(info) << "[BluetoothHandler::runStage] Service registered, port: " << portNumber_;
+        this->advance();
+        break;
+
+      case Stage::Announce:
+        this->announce();
+        this->advance();
+        break;
+
+      case Stage::Ready:
+        break;
+    }
+  }
 
-    QString adapterAddress = QString::fromStdString(configuration_->getBluetoothAdapterAddress());
-    QBluetoothAddress address(adapterAddress);
-    localDevice_ = std::make_unique<QBluetoothLocalDevice>(QBluetoothAddress());
+  void BluetoothHandler::openAdapter() {
+    if (poweringOn_) {
+      // The timeout, with the adapter still off
+      poweringOn_ = false;
+      this->retry("adapter did not power on");
+      return;
+    }
 
-    if (!localDevice_->isValid()) {
-      OPENAUTO_LOG(error) << "[BluetoothHandler] Bluetooth adapter is not valid.";
-    } else {
+    // Made here rather than at startup: with the adapter still coming up
+    // the object is invalid and is made again on the next attempt
+    if (!localDevice_ || !localDevice_->isValid()) {
+      localDevice_ = std::make_unique<QBluetoothLocalDevice>(QBluetoothAddress());
+      if (!localDevice_->isValid()) {
+        this->retry("bluetooth adapter is not valid");
+        return;
+      }
       OPENAUTO_LOG(info) << "[BluetoothHandler] Bluetooth adapter is valid.";
+
+      QObject::connect(localDevice_.get(), &QBluetoothLocalDevice::pairingDisplayPinCode, this, &BluetoothHandler::onPairingDisplayPinCode);
+      QObject::connect(localDevice_.get(), &QBluetoothLocalDevice::pairingDisplayConfirmation, this, &BluetoothHandler::onPairingDisplayConfirmation);
+      QObject::connect(localDevice_.get(), &QBluetoothLocalDevice::pairingFinished, this, &BluetoothHandler::onPairingFinished);
+      QObject::connect(localDevice_.get(), &QBluetoothLocalDevice::hostModeStateChanged, this, &BluetoothHandler::onHostModeStateChanged);
+      QObject::connect(localDevice_.get(), &QBluetoothLocalDevice::error, this, &BluetoothHandler::onError);
     }
 
-    QObject::connect(localDevice_.get(), &QBluetoothLocalDevice::pairingDisplayPinCode, this, &BluetoothHandler::onPairingDisplayPinCode);
-    QObject::connect(localDevice_.get(), &QBluetoothLocalDevice::pairingDisplayConfirmation, this, &BluetoothHandler::onPairingDisplayConfirmation);
-    QObject::connect(localDevice_.get(), &QBluetoothLocalDevice::pairingFinished, this, &BluetoothHandler::onPairingFinished);
-    QObject::connect(localDevice_.get(), &QBluetoothLocalDevice::hostModeStateChanged, this, &BluetoothHandler::onHostModeStateChanged);
-    QObject::connect(localDevice_.get(), &QBluetoothLocalDevice::error, this, &BluetoothHandler::onError);
+    if (localDevice_->hostMode() != QBluetoothLocalDevice::HostPoweredOff) {
+      this->advance();
+      return;
+    }
 
-    // Turn Bluetooth on
+    // Turn Bluetooth on; onHostModeStateChanged() moves on once it is
+    poweringOn_ = true;
     localDevice_->powerOn();
+    stageTimer_.start(cPowerOnTimeoutMs);
+  }
 
-    // Make it visible to others
-    localDevice_->setHostMode(QBluetoothLocalDevice::HostDiscoverable);
+  void BluetoothHandler::announce() {
+    // A known phone is called back straight away, with its channel cached
+    // from the last time, rather than waiting for it to find us. Discovery
+    // is then only needed to pair another phone
+    if (!androidBluetoothServer_->reconnectKnownPhone()) {
+      alwaysDiscoverable_ = true;
+    }
 
-    uint16_t portNumber = androidBluetoothServer_->start(address);
+    // Only become discoverable once the RFCOMM service can answer: a paired
+    // phone connecting straight away no longer races the SDP registration
+    localDevice_->setHostMode(alwaysDiscoverable_ ? QBluetoothLocalDevice::HostDiscoverable
+                                                  : QBluetoothLocalDevice::HostConnectable);
+    link_->adapterStateChanged(localDevice_->hostMode());
+  }
 
-    if (portNumber == 0) {
-      OPENAUTO_LOG(error) << "[BluetoothHandler::BluetoothHandler] Server start failed.";
-      throw std::runtime_error("Unable to start bluetooth server");
+  void BluetoothHandler::advance() {
+    const char *name = common::cBtServiceStages[static_cast<int>(stage_)];
+    const qint64 ms = stageClock_.restart();
+    OPENAUTO_LOG(info) << "[BluetoothHandler::advance] Stage " << name << " done in " << ms << " ms"
+                       << (attempts_ > 0 ? ", after " + std::to_string(attempts_) + " retries" : std::string());
+    link_->serviceStage(QString::fromLatin1(name), static_cast<int>(ms));
+
+    stage_ = static_cast<Stage>(static_cast<int>(stage_) + 1);
+    attempts_ = 0;
+    retryMs_ = cFirstRetryMs;
+    if (stage_ != Stage::Ready) {
+      stageTimer_.start(0);
+      return;
     }
 
-    OPENAUTO_LOG(info) << "[BluetoothHandler::BluetoothHandler] Listening for connections, address: " << address.toString().toStdString()
-                       << ", port: " << portNumber;
+    const qint64 total = startup_.elapsed();
+    OPENAUTO_LOG(info) << "[BluetoothHandler::advance] Ready for phones " << total << " ms after start";
+    link_->serviceStage(QString::fromLatin1(common::cBtServiceReady), static_cast<int>(total));
+  }
 
-   if (!androidBluetoothService_->registerService(portNumber, address)) {
-      OPENAUTO_LOG(error) << "[BluetoothHandler::BluetoothHandler] Service registration failed.";
-      throw std::runtime_error("Unable to register btservice");
-    } else {
-      OPENAUTO_LOG(info) << "[BluetoothHandler::BluetoothHandler] Service registered, port: " << portNumber;
-    }
+  void BluetoothHandler::retry(const char *reason) {
+    ++attempts_;
+    OPENAUTO_LOG(warning) << "[BluetoothHandler::retry] Stage " << common::cBtServiceStages[static_cast<int>(stage_)]
+                          << ": " << reason << ", attempt " << attempts_ << ", retrying in " << retryMs_ << " ms";
+    stageTimer_.start(retryMs_);
+    retryMs_ = std::min(retryMs_ * 2, cMaxRetryMs);
+  }
+
+  bool BluetoothHandler::ready() const {
+    return stage_ == Stage::Ready;
+  }
 
-    // TODO: Connect to any previously paired devices
+  void BluetoothHandler::onPairingRequested(int seconds) {
+    if (!this->ready()) {
+      // Discoverable anyway once up if no phone is known yet
+      OPENAUTO_LOG(warning) << "[BluetoothHandler::onPairingRequested] Not ready yet, ignoring";
+      return;
+    }
+    OPENAUTO_LOG(info) << "[BluetoothHandler::onPairingRequested] Discoverable for " << seconds << " s";
+    localDevice_->setHostMode(QBluetoothLocalDevice::HostDiscoverable);
+    pairingTimer_.start(std::max(seconds, 1) * 1000);
   }
 
   void BluetoothHandler::shutdownService() {
     OPENAUTO_LOG(info) << "[BluetoothHandler::shutdownService] Shutdown initiated";
-    androidBluetoothService_->unregisterService();
+    stageTimer_.stop();
+    if (stage_ > Stage::Register) {
+      androidBluetoothService_->unregisterService();
+    }
   }
 
   void BluetoothHandler::onPairingDisplayPinCode(const QBluetoothAddress &address, QString pin) {
@@ -77,6 +196,11 @@ namespace f1x::openauto::btservice {
   void BluetoothHandler::onPairingFinished(const QBluetoothAddress &address, QBluetoothLocalDevice::Pairing pairing) {
     OPENAUTO_LOG(info) << "[BluetoothHandler::onPairingFinished] pairingFinished, address: " << address.toString().toStdString()
                        << ", pairing: " << pairing;
+    link_->pairingFinished(address.toString(), pairing != QBluetoothLocalDevice::Unpaired);
+    // Paired: no need to stay visible for the rest of the window
+    if (pairing != QBluetoothLocalDevice::Unpaired && pairingTimer_.isActive()) {
+      pairingTimer_.start(0);
+    }
   }
 
   void BluetoothHandler::onError(QBluetoothLocalDevice::Error error) {
@@ -86,6 +210,12 @@ namespace f1x::openauto::btservice {
 
   void BluetoothHandler::onHostModeStateChanged(QBluetoothLocalDevice::HostMode state) {
     OPENAUTO_LOG(info) << "[BluetoothHandler::onHostModeStateChanged] Host mode state changed: " << state;
+    link_->adapterStateChanged(state);
+    if (poweringOn_ && state != QBluetoothLocalDevice::HostPoweredOff) {
+      poweringOn_ = false;
+      stageTimer_.stop();
+      this->advance();
+    }
     // ... your logic to handle the state change ...
   }
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+/*
+*  This file is part of openauto project.
+*  Copyright (C) 2018 f1x.studio (Michal Szwaj)
+*
+*  openauto is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation; either version 3 of the License, or
+*  (at your option) any later version.
+
+*  openauto is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with openauto. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <f1x/openauto/Common/Log.hpp>
+#include <f1x/openauto/btservice/BtLinkPublisher.hpp>
+
+namespace f1x::openauto::btservice {
+
+  BtLinkPublisher::BtLinkPublisher(QObject *parent)
+      : QObject(parent), fd_(common::openBtLinkSocket(common::cBtLinkBtserviceSocket)),
+        wifiStatusKnown_(false) {
+    if (fd_ < 0) {
+      OPENAUTO_LOG(warning) << "[BtLinkPublisher] Cannot open the autoapp link: " << std::strerror(errno);
+      return;
+    }
+    adapter_.type = common::BtLinkMessage::AdapterState;
+    phone_.type = common::BtLinkMessage::PhoneDisconnected;
+    wifi_.type = common::BtLinkMessage::WifiOffered;
+    wifiStatus_.type = common::BtLinkMessage::WifiStatus;
+    notifier_ = std::make_unique<QSocketNotifier>(fd_, QSocketNotifier::Read);
+    connect(notifier_.get(), &QSocketNotifier::activated, this, &BtLinkPublisher::onReadable);
+  }
+
+  BtLinkPublisher::~BtLinkPublisher() {
+    notifier_.reset();
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  void BtLinkPublisher::onReadable() {
+    char packet[common::cBtLinkMaxSize];
+    ssize_t size;
+    while ((size = recv(fd_, packet, sizeof(packet), 0)) > 0) {
+      common::BtLinkEvent event;
+      if (!common::decodeBtLinkEvent(packet, static_cast<size_t>(size), event)) {
+        continue;
+      }
+      if (event.type == common::BtLinkMessage::Hello) {
+        OPENAUTO_LOG(debug) << "[BtLinkPublisher] autoapp started, replaying state";
+        this->replay();
+      } else if (event.type == common::BtLinkMessage::PairingRequested) {
+        emit pairingRequested(event.value);
+      }
+    }
+  }
+
+  void BtLinkPublisher::publish(const common::BtLinkEvent &event) {
+    // Dropped while autoapp is not running: Hello brings it up to date
+    if (fd_ >= 0) {
+      common::sendBtLinkEvent(fd_, common::cBtLinkAutoappSocket, event);
+    }
+  }
+
+  void BtLinkPublisher::replay() {
+    for (const auto &stage : stages_) {
+      this->publish(stage);
+    }
+    this->publish(adapter_);
+    this->publish(phone_);
+    if (!wifi_.name.empty()) {
+      this->publish(wifi_);
+    }
+    if (wifiStatusKnown_) {
+      this->publish(wifiStatus_);
+    }
+  }
+
+  void BtLinkPublisher::adapterStateChanged(int hostMode) {
+    adapter_.value = hostMode;
+    this->publish(adapter_);
+  }
+
+  void BtLinkPublisher::pairingFinished(const QString &address, bool paired) {
+    common::BtLinkEvent event;
+    event.type = common::BtLinkMessage::PairingFinished;
+    event.value = paired ? 1 : 0;
+    event.address = address.toStdString();
+    this->publish(event);
+  }
+
+  void BtLinkPublisher::phoneConnected(const QString &address, const QString &name) {
+    phone_.type = common::BtLinkMessage::PhoneConnected;
+    phone_.address = address.toStdString();
+    phone_.name = name.toStdString();
+    // A new phone has yet to join the hotspot
+    wifiStatusKnown_ = false;
+    this->publish(phone_);
+  }
+
+  void BtLinkPublisher::phoneDisconnected(const QString &address) {
+    phone_.type = common::BtLinkMessage::PhoneDisconnected;
+    phone_.address = address.toStdString();
+    phone_.name.clear();
+    this->publish(phone_);
+  }
+
+  void BtLinkPublisher::wifiOffered(const QString &ssid) {
+    wifi_.name = ssid.toStdString();
+    this->publish(wifi_);
+  }
+
+  void BtLinkPublisher::wifiStatus(int status) {
+    wifiStatus_.value = status;
+    wifiStatusKnown_ = true;
+    this->publish(wifiStatus_);
+  }
+
+  void BtLinkPublisher::serviceStage(const QString &stage, int ms) {
+    common::BtLinkEvent event;
+    event.type = common::BtLinkMessage::ServiceStage;
+    event.value = ms;
+    event.name = stage.toStdString();
+    stages_.push_back(event);
+    this->publish(event);
+  }
+
+}
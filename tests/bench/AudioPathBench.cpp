@@ -0,0 +1,519 @@
+// audio_bench - buffer fill, underruns and latency of the audio paths
+// across device period sizes, with RtAudio replaced by a simulated clock.
+//
+//   audio_bench [--seconds N] [--frames 256,512,1024] [--jitter-ms N] [--json]
+//
+// Output: phone packets arrive with network jitter and occasional stalls
+// and are written into a real RtAudioOutput; its render() is called the way
+// the RtAudio callback would be, once per period with scheduling jitter and
+// occasionally late. Latency is packet arrival to the period that plays it.
+//
+// Input: a RtAudioInput without a device is fed one period per simulated
+// callback through capture(), with a read always pending as the microphone
+// service keeps one. Latency is the first sample of a chunk to the resolved
+// read, in simulated time; the wakeup column is the real cost of the eventfd
+// handover and io_service dispatch.
+//
+// Call: a DuplexAudioStream without a device plays the telephony channel
+// and captures the microphone in one simulated 10 ms callback. What was
+// played reaches the microphone two periods later, as through the
+// speakers, and round trip is a phone packet's arrival to the microphone
+// read that carries its echo back, with voice processing off.
+//
+// Time is simulated and the random source is seeded, so two runs of the
+// same build give the same fill, underrun and latency figures.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <f1x/openauto/autoapp/Projection/DuplexAudioStream.hpp>
+#include <f1x/openauto/autoapp/Projection/RtAudioInput.hpp>
+#include <f1x/openauto/autoapp/Projection/RtAudioOutput.hpp>
+
+namespace projection = f1x::openauto::autoapp::projection;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+  std::vector<unsigned int> periods{256, 512, 1024, 2048, 4096};
+  double seconds = 60.0;
+  double jitterMs = 8.0;  // Network jitter on phone packets, uniform
+  bool json = false;
+};
+
+// Spread of the measured latencies, one sample per played packet or chunk
+struct Spread {
+  std::vector<double> samples;
+
+  void add(double value) { samples.push_back(value); }
+
+  double percentile(double p) {
+    if (samples.empty()) {
+      return 0.0;
+    }
+    const size_t index = std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+  }
+};
+
+struct OutputResult {
+  double fillMeanMs = 0.0;
+  double fillMinMs = 0.0;
+  double fillMaxMs = 0.0;
+  uint64_t underruns = 0;
+  uint64_t overruns = 0;
+  uint64_t silentPeriods = 0;  // Periods after playout started with any silence in them
+  double latencyP50Ms = 0.0;
+  double latencyP99Ms = 0.0;
+};
+
+struct CallResult {
+  unsigned int frames = 0;
+  uint64_t underruns = 0;
+  double roundTripP50Ms = 0.0;
+  double roundTripP99Ms = 0.0;
+};
+
+struct InputResult {
+  uint64_t chunks = 0;
+  double latencyP50Ms = 0.0;
+  double latencyP99Ms = 0.0;
+  double wakeupP50Us = 0.0;
+  double wakeupP99Us = 0.0;
+};
+
+// Real playback code on a simulated device: render() is what the RtAudio
+// callback runs, called here from the simulation instead
+class LoopbackAudioOutput : public projection::RtAudioOutput {
+public:
+  using projection::RtAudioOutput::RtAudioOutput;
+  using projection::RtAudioOutput::render;
+};
+
+// Microphone capture without a device: the simulation plays the callback
+class SimulatedAudioInput : public projection::RtAudioInput {
+public:
+  SimulatedAudioInput(boost::asio::io_service &ioService, uint32_t sampleRate)
+      : projection::RtAudioInput(ioService, 1, 16, sampleRate, nullptr) {}
+  // stop() would otherwise run once this part is already gone
+  ~SimulatedAudioInput() override { stop(); }
+
+protected:
+  bool startDevice() override { return true; }
+  void stopDevice() override {}
+};
+
+// Telephony and microphone on one stream; the simulation plays the callback
+class SimulatedDuplexStream : public projection::DuplexAudioStream {
+public:
+  SimulatedDuplexStream() : projection::DuplexAudioStream(0, 0, 60) {}
+
+protected:
+  bool openStream() override { return true; }
+  void closeStream() override {}
+};
+
+// When the simulated device asks for period k: on time but for scheduling
+// jitter, and once in a while a whole period late, as after a long
+// interrupt or a preempted RT thread
+class CallbackClock {
+public:
+  CallbackClock(unsigned int frames, uint32_t sampleRate, std::mt19937 &random)
+      : periodMs_(frames * 1000.0 / sampleRate), random_(random),
+        jitter_(0.0, std::min(2.0, periodMs_ * 0.1)), late_(0.005) {}
+
+  double next() {
+    index_++;
+    double at = index_ * periodMs_ + jitter_(random_);
+    if (late_(random_)) {
+      at += periodMs_;
+    }
+    // A callback never runs before the previous one finished
+    last_ = std::max(at, last_);
+    return last_;
+  }
+
+private:
+  const double periodMs_;
+  std::mt19937 &random_;
+  std::uniform_real_distribution<double> jitter_;
+  std::bernoulli_distribution late_;
+  uint64_t index_ = 0;
+  double last_ = 0.0;
+};
+
+OutputResult runOutput(unsigned int frames, const Options &options) {
+  constexpr uint32_t cSampleRate = 48000;
+  constexpr uint32_t cPacketFrames = 480;  // The phone sends 10 ms per packet
+  constexpr double cPacketMs = cPacketFrames * 1000.0 / cSampleRate;
+  const uint64_t packets = static_cast<uint64_t>(options.seconds * 1000.0 / cPacketMs);
+
+  std::mt19937 random(frames);
+  std::uniform_real_distribution<double> networkJitter(0.0, options.jitterMs);
+  std::bernoulli_distribution stall(0.002);  // Wi-Fi retries: a 40 ms hole now and then
+  CallbackClock clock(frames, cSampleRate, random);
+
+  LoopbackAudioOutput output(2, 16, cSampleRate);
+  std::vector<int16_t> packet(cPacketFrames * 2);
+  std::vector<int16_t> period(frames * 2);
+  std::vector<double> arrivals;
+  arrivals.reserve(packets);
+
+  OutputResult result;
+  result.fillMinMs = 1e9;
+  Spread latency;
+  double fillSum = 0.0;
+  uint64_t callbacks = 0;
+  bool playing = false;
+  double stalledUntil = 0.0;
+  uint64_t nextPacket = 0;
+  uint64_t lastPlayed = UINT64_MAX;
+
+  while (true) {
+    // Until the last packet played; the drain after it is not a dropout
+    const double callbackAt = clock.next();
+    if (lastPlayed + 1 == packets || (nextPacket >= packets && callbackAt > arrivals.back() + 1000.0)) {
+      break;
+    }
+
+    // Everything the phone got through before this callback, in order
+    while (nextPacket < packets) {
+      if (arrivals.size() == nextPacket) {
+        double at = nextPacket * cPacketMs + networkJitter(random);
+        if (stall(random)) {
+          stalledUntil = at + 40.0;
+        }
+        arrivals.push_back(std::max({at, stalledUntil, arrivals.empty() ? 0.0 : arrivals.back()}));
+      }
+      if (arrivals.back() > callbackAt) {
+        break;
+      }
+
+      // Each frame carries its packet number, so the rendered period says
+      // which packets it played; zero is left for silence
+      const int16_t tag = static_cast<int16_t>(nextPacket % 32767 + 1);
+      std::fill(packet.begin(), packet.end(), tag);
+      output.write(nextPacket * static_cast<uint64_t>(cPacketMs * 1000.0 + 0.5),
+                   aasdk::common::DataConstBuffer(packet.data(), packet.size() * sizeof(int16_t)));
+      nextPacket++;
+    }
+
+    const double fillMs = output.getQueuedFrames() * 1000.0 / cSampleRate;
+    fillSum += fillMs;
+    result.fillMinMs = std::min(result.fillMinMs, fillMs);
+    result.fillMaxMs = std::max(result.fillMaxMs, fillMs);
+    callbacks++;
+
+    output.render(period.data(), frames);
+
+    bool silent = false;
+    for (unsigned int i = 0; i < frames; i++) {
+      const int16_t tag = period[i * 2];
+      if (tag == 0) {
+        silent = true;
+        continue;
+      }
+      // Tags wrap every 32767 packets: pick the played packet nearest the last
+      const uint64_t base = lastPlayed == UINT64_MAX ? 0 : lastPlayed;
+      uint64_t played = base - base % 32767 + (tag - 1);
+      if (played + 16383 < base) {
+        played += 32767;
+      }
+      if (played != lastPlayed && played < arrivals.size()) {
+        latency.add(callbackAt + i * 1000.0 / cSampleRate - arrivals[played]);
+        lastPlayed = played;
+      }
+      playing = true;
+    }
+    if (playing && silent) {
+      result.silentPeriods++;
+    }
+  }
+
+  const auto stats = output.getJitterStats();
+  result.underruns = stats.underruns;
+  result.overruns = stats.overruns;
+  result.fillMeanMs = callbacks ? fillSum / callbacks : 0.0;
+  result.latencyP50Ms = latency.percentile(0.5);
+  result.latencyP99Ms = latency.percentile(0.99);
+  return result;
+}
+
+InputResult runInput(unsigned int frames, const Options &options) {
+  constexpr uint32_t cSampleRate = 16000;      // The AAP microphone channel
+  constexpr size_t cChunkFrames = 2056 / 2;    // One read, mono 16-bit
+  boost::asio::io_service ioService;
+  SimulatedAudioInput input(ioService, cSampleRate);
+
+  std::mt19937 random(frames);
+  CallbackClock clock(frames, cSampleRate, random);
+
+  InputResult result;
+  Spread latency;
+  Spread wakeup;
+  uint64_t chunksRead = 0;
+  double now = 0.0;
+  Clock::time_point capturedAt;
+
+  auto started = projection::IAudioInput::StartPromise::defer(ioService);
+  bool running = false;
+  started->then([&running]() { running = true; }, [](void) {});
+  input.start(std::move(started));
+  ioService.poll();
+  ioService.restart();
+  if (!running) {
+    return result;
+  }
+
+  // The microphone service reads again as soon as a chunk is sent
+  std::function<void()> readNext;
+  readNext = [&]() {
+    auto promise = projection::IAudioInput::ReadPromise::defer(ioService);
+    promise->then(
+        [&](aasdk::common::Data data) {
+          wakeup.add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - capturedAt).count() /
+                     1000.0);
+          // The chunk's first sample was taken when the device clock passed it
+          const double firstSampleMs = chunksRead * cChunkFrames * 1000.0 / cSampleRate;
+          latency.add(now - firstSampleMs);
+          chunksRead++;
+          input.recycle(std::move(data));
+          readNext();
+        },
+        [](void) {});
+    input.read(std::move(promise));
+  };
+  readNext();
+
+  const std::vector<int16_t> period(frames, 0x0101);
+  const double endMs = options.seconds * 1000.0;
+  while (now < endMs) {
+    // A callback delivers the period that ended just before it ran
+    now = clock.next();
+    capturedAt = Clock::now();
+    input.capture(period.data(), frames, false);
+    ioService.poll();
+    ioService.restart();
+  }
+  input.stop();
+  ioService.poll();
+
+  result.chunks = chunksRead;
+  result.latencyP50Ms = latency.percentile(0.5);
+  result.latencyP99Ms = latency.percentile(0.99);
+  result.wakeupP50Us = wakeup.percentile(0.5);
+  result.wakeupP99Us = wakeup.percentile(0.99);
+  return result;
+}
+
+CallResult runCall(const Options &options) {
+  constexpr uint32_t cSampleRate = projection::DuplexAudioStream::cSampleRate;
+  constexpr unsigned int cFrames = projection::DuplexAudioStream::cPeriodFrames;
+  constexpr uint32_t cPacketFrames = 160;  // 10 ms telephony packets
+  constexpr double cPacketMs = cPacketFrames * 1000.0 / cSampleRate;
+  constexpr size_t cEchoPeriods = 2;       // Speaker to microphone: the queued output
+  const uint64_t packets = static_cast<uint64_t>(options.seconds * 1000.0 / cPacketMs);
+
+  boost::asio::io_service ioService;
+  auto stream = std::make_shared<SimulatedDuplexStream>();
+  auto call = stream->createOutput();
+  auto microphone = stream->createInput(ioService, nullptr);
+
+  std::mt19937 random(cFrames);
+  std::uniform_real_distribution<double> networkJitter(0.0, options.jitterMs);
+  std::bernoulli_distribution stall(0.002);
+  CallbackClock clock(cFrames, cSampleRate, random);
+
+  CallResult result;
+  result.frames = cFrames;
+  Spread roundTrip;
+  std::vector<double> arrivals;
+  arrivals.reserve(packets);
+  double now = 0.0;
+  double stalledUntil = 0.0;
+  uint64_t nextPacket = 0;
+  uint64_t lastHeard = 0;
+
+  call->open();
+  call->start();
+  auto started = projection::IAudioInput::StartPromise::defer(ioService);
+  started->then([]() {}, [](void) {});
+  microphone->start(std::move(started));
+  ioService.poll();
+  ioService.restart();
+
+  // Every packet whose echo a chunk carries, at the time the chunk is sent;
+  // tags are packet numbers plus one, and zero is silence
+  std::function<void()> readNext;
+  readNext = [&]() {
+    auto promise = projection::IAudioInput::ReadPromise::defer(ioService);
+    promise->then(
+        [&](aasdk::common::Data data) {
+          const auto *samples = reinterpret_cast<const int16_t *>(data.data());
+          for (size_t i = 0; i < data.size() / sizeof(int16_t); i++) {
+            const uint64_t heard = static_cast<uint16_t>(samples[i]);
+            if (heard > lastHeard && heard <= arrivals.size()) {
+              roundTrip.add(now - arrivals[heard - 1]);
+              lastHeard = heard;
+            }
+          }
+          microphone->recycle(std::move(data));
+          readNext();
+        },
+        [](void) {});
+    microphone->read(std::move(promise));
+  };
+  readNext();
+
+  std::vector<int16_t> packet(cPacketFrames);
+  std::vector<std::vector<int16_t>> echo(cEchoPeriods + 1, std::vector<int16_t>(cFrames, 0));
+  size_t echoIndex = 0;
+  while (nextPacket < packets || now < arrivals.back() + 500.0) {
+    now = clock.next();
+    while (nextPacket < packets) {
+      if (arrivals.size() == nextPacket) {
+        double at = nextPacket * cPacketMs + networkJitter(random);
+        if (stall(random)) {
+          stalledUntil = at + 40.0;
+        }
+        arrivals.push_back(std::max({at, stalledUntil, arrivals.empty() ? 0.0 : arrivals.back()}));
+      }
+      if (arrivals.back() > now) {
+        break;
+      }
+      // Packets stay below 32768 for the tags: 327 s of call
+      std::fill(packet.begin(), packet.end(), static_cast<int16_t>(std::min<uint64_t>(nextPacket + 1, 32767)));
+      call->write(nextPacket * static_cast<uint64_t>(cPacketMs * 1000.0 + 0.5),
+                  aasdk::common::DataConstBuffer(packet.data(), packet.size() * sizeof(int16_t)));
+      nextPacket++;
+    }
+
+    // This period's speaker output is heard cEchoPeriods callbacks later
+    auto &speaker = echo[echoIndex];
+    const auto &heard = echo[(echoIndex + 1) % echo.size()];
+    stream->process(speaker.data(), heard.data(), cFrames, false);
+    echoIndex = (echoIndex + 1) % echo.size();
+    ioService.poll();
+    ioService.restart();
+  }
+  result.underruns = std::static_pointer_cast<projection::DuplexAudioOutput>(call)->getJitterStats().underruns;
+  microphone->stop();
+  call->stop();
+  ioService.poll();
+
+  result.roundTripP50Ms = roundTrip.percentile(0.5);
+  result.roundTripP99Ms = roundTrip.percentile(0.99);
+  return result;
+}
+
+std::string fixed(double value, int precision = 1) {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(precision) << value;
+  return out.str();
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--seconds" && hasValue) {
+      options.seconds = std::max(1.0, std::atof(argv[++i]));
+    } else if (arg == "--frames" && hasValue) {
+      options.periods.clear();
+      std::istringstream list(argv[++i]);
+      std::string frames;
+      while (std::getline(list, frames, ',')) {
+        const int value = std::atoi(frames.c_str());
+        if (value < 16) {
+          std::cerr << "Bad period " << frames << std::endl;
+          return false;
+        }
+        options.periods.push_back(static_cast<unsigned int>(value));
+      }
+    } else if (arg == "--jitter-ms" && hasValue) {
+      options.jitterMs = std::max(0.0, std::atof(argv[++i]));
+    } else if (arg == "--json") {
+      options.json = true;
+    } else {
+      return false;
+    }
+  }
+  return !options.periods.empty();
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    std::cerr << "Usage: " << argv[0] << " [--seconds N] [--frames 256,512,1024] [--jitter-ms N] [--json]"
+              << std::endl;
+    return 2;
+  }
+
+  if (!options.json) {
+    std::cout << "output: 48 kHz stereo, 10 ms packets, " << fixed(options.jitterMs) << " ms network jitter, "
+              << fixed(options.seconds, 0) << " s simulated\n"
+              << std::setw(7) << "frames" << std::setw(9) << "period" << std::setw(18) << "fill min/avg/max"
+              << std::setw(11) << "underruns" << std::setw(10) << "overruns" << std::setw(9) << "silent"
+              << std::setw(16) << "latency p50/p99" << "\n";
+  } else {
+    std::cout << "[";
+  }
+
+  bool first = true;
+  for (const unsigned int frames : options.periods) {
+    const OutputResult out = runOutput(frames, options);
+    const InputResult in = runInput(frames, options);
+    if (options.json) {
+      std::cout << (first ? "" : ",") << "\n  {\"frames\": " << frames << ", \"output\": {\"fill_mean_ms\": "
+                << fixed(out.fillMeanMs, 2) << ", \"fill_min_ms\": " << fixed(out.fillMinMs, 2)
+                << ", \"fill_max_ms\": " << fixed(out.fillMaxMs, 2) << ", \"underruns\": " << out.underruns
+                << ", \"overruns\": " << out.overruns << ", \"silent_periods\": " << out.silentPeriods
+                << ", \"latency_p50_ms\": " << fixed(out.latencyP50Ms, 2)
+                << ", \"latency_p99_ms\": " << fixed(out.latencyP99Ms, 2) << "}, \"input\": {\"chunks\": "
+                << in.chunks << ", \"latency_p50_ms\": " << fixed(in.latencyP50Ms, 2)
+                << ", \"latency_p99_ms\": " << fixed(in.latencyP99Ms, 2)
+                << ", \"wakeup_p50_us\": " << fixed(in.wakeupP50Us, 2)
+                << ", \"wakeup_p99_us\": " << fixed(in.wakeupP99Us, 2) << "}}";
+    } else {
+      std::cout << std::setw(7) << frames << std::setw(9) << fixed(frames * 1000.0 / 48000) + "ms"
+                << std::setw(18)
+                << fixed(out.fillMinMs, 0) + "/" + fixed(out.fillMeanMs, 0) + "/" + fixed(out.fillMaxMs, 0)
+                << std::setw(11) << out.underruns << std::setw(10) << out.overruns << std::setw(9)
+                << out.silentPeriods << std::setw(16)
+                << fixed(out.latencyP50Ms) + "/" + fixed(out.latencyP99Ms) << "\n";
+      std::cout << std::setw(7) << "" << "  input: " << in.chunks << " chunks, latency p50/p99 "
+                << fixed(in.latencyP50Ms) << "/" << fixed(in.latencyP99Ms) << " ms, wakeup p50/p99 "
+                << fixed(in.wakeupP50Us) << "/" << fixed(in.wakeupP99Us) << " us\n";
+    }
+    first = false;
+  }
+
+  const CallResult call = runCall(options);
+  if (options.json) {
+    std::cout << (first ? "" : ",") << "\n  {\"frames\": " << call.frames
+              << ", \"call\": {\"underruns\": " << call.underruns
+              << ", \"round_trip_p50_ms\": " << fixed(call.roundTripP50Ms, 2)
+              << ", \"round_trip_p99_ms\": " << fixed(call.roundTripP99Ms, 2) << "}}";
+    std::cout << "\n]\n";
+  } else {
+    std::cout << "call: 16 kHz mono duplex, " << call.frames << " frame periods: " << call.underruns
+              << " underruns, round trip p50/p99 " << fixed(call.roundTripP50Ms) << "/"
+              << fixed(call.roundTripP99Ms) << " ms\n";
+  }
+  return 0;
+}
@@ -0,0 +1,357 @@
+#include "FakePhone.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <vector>
+#include <openssl/ssl.h>
+#include <aasdk/Error/Error.hpp>
+#include <aasdk/Messenger/Cryptor.hpp>
+#include <aasdk/Messenger/MessageId.hpp>
+#include <aasdk/Messenger/MessageInStream.hpp>
+#include <aasdk/Messenger/MessageOutStream.hpp>
+#include <aasdk/Messenger/Messenger.hpp>
+#include <aasdk/TCP/TCPEndpoint.hpp>
+#include <aasdk/Transport/SSLWrapper.hpp>
+#include <aasdk/Transport/TCPTransport.hpp>
+#include <aap_protobuf/service/control/message/ChannelOpenRequest.pb.h>
+#include <aap_protobuf/service/control/message/ServiceDiscoveryRequest.pb.h>
+#include <aap_protobuf/service/control/message/ServiceDiscoveryResponse.pb.h>
+#include <aap_protobuf/service/media/shared/message/Config.pb.h>
+#include <aap_protobuf/service/media/shared/message/Setup.pb.h>
+#include <aap_protobuf/service/media/shared/message/Start.pb.h>
+#include <aap_protobuf/service/media/source/message/Ack.pb.h>
+
+namespace messenger = aasdk::messenger;
+namespace media = aap_protobuf::service::media;
+
+namespace bench {
+
+namespace {
+
+// AAP message ids, as in aap_protobuf's ControlMessageType and MediaMessageId
+const uint16_t cVersionRequest = 0x0001;
+const uint16_t cVersionResponse = 0x0002;
+const uint16_t cEncapsulatedSsl = 0x0003;
+const uint16_t cAuthComplete = 0x0004;
+const uint16_t cServiceDiscoveryRequest = 0x0005;
+const uint16_t cServiceDiscoveryResponse = 0x0006;
+const uint16_t cChannelOpenRequest = 0x0007;
+const uint16_t cChannelOpenResponse = 0x0008;
+const uint16_t cMediaData = 0x0000;
+const uint16_t cMediaSetup = 0x8000;
+const uint16_t cMediaStart = 0x8001;
+const uint16_t cMediaConfig = 0x8003;
+const uint16_t cMediaAck = 0x8004;
+
+// The phone end of TLS: the same certificate, but accepting, and at
+// TLS 1.2 like phones, where the handshake ends with the server's flight
+class PhoneSSLWrapper : public aasdk::transport::SSLWrapper {
+public:
+  const SSL_METHOD *getMethod() override { return TLS_server_method(); }
+
+  SSL_CTX *createContext(const SSL_METHOD *method) override {
+    SSL_CTX *context = aasdk::transport::SSLWrapper::createContext(method);
+    if (context != nullptr) {
+      SSL_CTX_set_max_proto_version(context, TLS1_2_VERSION);
+    }
+    return context;
+  }
+
+  void setConnectState(SSL *ssl) override { SSL_set_accept_state(ssl); }
+};
+
+}  // namespace
+
+FakePhone::FakePhone(boost::asio::io_service &ioService, aasdk::tcp::ITCPWrapper &tcpWrapper,
+                     aasdk::tcp::ITCPEndpoint::SocketPointer socket)
+    : strand_(ioService) {
+  auto endpoint = std::make_shared<aasdk::tcp::TCPEndpoint>(tcpWrapper, std::move(socket));
+  transport_ = std::make_shared<aasdk::transport::TCPTransport>(ioService, std::move(endpoint));
+  cryptor_ = std::make_shared<messenger::Cryptor>(std::make_shared<PhoneSSLWrapper>());
+  cryptor_->init();
+  messenger_ = std::make_shared<messenger::Messenger>(
+      ioService, std::make_shared<messenger::MessageInStream>(ioService, transport_, cryptor_),
+      std::make_shared<messenger::MessageOutStream>(ioService, transport_, cryptor_));
+}
+
+void FakePhone::start(Handlers handlers) {
+  strand_.dispatch([this, self = this->shared_from_this(), handlers = std::move(handlers)]() mutable {
+    handlers_ = std::move(handlers);
+    started_ = std::chrono::steady_clock::now();
+    active_ = true;
+    this->receive();
+  });
+}
+
+void FakePhone::stop() {
+  strand_.dispatch([this, self = this->shared_from_this()]() {
+    active_ = false;
+    messenger_->stop();
+    transport_->stop();
+    cryptor_->deinit();
+  });
+}
+
+void FakePhone::sendMedia(messenger::ChannelId channel, uint64_t timestamp,
+                          const aasdk::common::DataConstBuffer &data) {
+  aasdk::common::Data frame(8 + data.size);
+  for (int i = 0; i < 8; ++i) {
+    frame[i] = static_cast<uint8_t>(timestamp >> (56 - 8 * i));
+  }
+  std::copy(data.cdata, data.cdata + data.size, frame.begin() + 8);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sinks_[channel].unacked++;
+  }
+  strand_.dispatch([this, self = this->shared_from_this(), channel, frame = std::move(frame)]() {
+    if (active_) {
+      this->send(channel, messenger::EncryptionType::ENCRYPTED, messenger::MessageType::SPECIFIC, cMediaData,
+                 aasdk::common::DataConstBuffer(frame));
+    }
+  });
+}
+
+bool FakePhone::isStarted(messenger::ChannelId channel) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto sink = sinks_.find(channel);
+  return sink != sinks_.end() && sink->second.started;
+}
+
+bool FakePhone::canSend(messenger::ChannelId channel) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto sink = sinks_.find(channel);
+  return sink != sinks_.end() && sink->second.started && sink->second.unacked < sink->second.maxUnacked;
+}
+
+messenger::ChannelId FakePhone::videoChannel() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return videoChannel_;
+}
+
+std::map<std::string, double> FakePhone::channelOpenMs() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return channelOpenMs_;
+}
+
+double FakePhone::elapsedMs() const {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started_).count();
+}
+
+void FakePhone::receive() {
+  if (!active_) {
+    return;
+  }
+  auto promise = messenger::ReceivePromise::defer(strand_);
+  promise->then(
+      [this, self = this->shared_from_this()](messenger::Message::Pointer message) {
+        try {
+          this->onMessage(*message);
+        } catch (const aasdk::error::Error &error) {
+          this->fail(error.what());
+        }
+        this->receive();
+      },
+      [this, self = this->shared_from_this()](const aasdk::error::Error &error) { this->fail(error.what()); });
+  messenger_->enqueueReceive(std::move(promise));
+}
+
+void FakePhone::send(messenger::ChannelId channel, messenger::EncryptionType encryption, messenger::MessageType type,
+                     uint16_t id, const aasdk::common::DataConstBuffer &payload) {
+  messenger::Message message(channel, encryption, type);
+  message.insertPayload(messenger::MessageId(id).getData());
+  message.insertPayload(payload);
+  auto promise = messenger::SendPromise::defer(strand_);
+  promise->then([]() {}, [this, self = this->shared_from_this()](const aasdk::error::Error &error) {
+    this->fail(error.what());
+  });
+  messenger_->enqueueSend(std::move(message), std::move(promise));
+}
+
+void FakePhone::send(messenger::ChannelId channel, messenger::MessageType type, uint16_t id,
+                     const google::protobuf::Message &payload) {
+  const std::string serialized = payload.SerializeAsString();
+  this->send(channel, messenger::EncryptionType::ENCRYPTED, type, id,
+             aasdk::common::DataConstBuffer(serialized.data(), serialized.size()));
+}
+
+void FakePhone::onMessage(messenger::Message &message) {
+  const messenger::MessageId messageId(message.getPayload());
+  const aasdk::common::DataConstBuffer payload(message.getPayload(), messageId.getSizeOf());
+  const messenger::ChannelId channel = message.getChannelId();
+
+  if (channel == messenger::ChannelId::CONTROL) {
+    switch (messageId.getId()) {
+    case cVersionRequest: {
+      // major 1, minor 7, STATUS_SUCCESS, big endian
+      const uint16_t version[] = {htons(1), htons(7), htons(0)};
+      this->send(channel, messenger::EncryptionType::PLAIN, messenger::MessageType::SPECIFIC, cVersionResponse,
+                 aasdk::common::DataConstBuffer(version, sizeof(version)));
+      this->stage("version");
+      break;
+    }
+    case cEncapsulatedSsl: {
+      cryptor_->writeHandshakeBuffer(payload);
+      cryptor_->doHandshake();
+      const aasdk::common::Data reply = cryptor_->readHandshakeBuffer();
+      if (!reply.empty()) {
+        this->send(channel, messenger::EncryptionType::PLAIN, messenger::MessageType::SPECIFIC, cEncapsulatedSsl,
+                   aasdk::common::DataConstBuffer(reply));
+      }
+      break;
+    }
+    case cAuthComplete: {
+      this->stage("tls");
+      aap_protobuf::service::control::message::ServiceDiscoveryRequest request;
+      request.set_device_name("FakePhone");
+      request.set_label_text("Fake phone");
+      this->send(channel, messenger::MessageType::SPECIFIC, cServiceDiscoveryRequest, request);
+      break;
+    }
+    case cServiceDiscoveryResponse:
+      this->stage("discovery");
+      this->openChannels(payload);
+      break;
+    default:
+      break;
+    }
+    return;
+  }
+
+  switch (messageId.getId()) {
+  case cChannelOpenResponse: {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      channelOpenMs_[messenger::channelIdToString(channel)] = this->elapsedMs() - openRequestedMs_;
+    }
+    if (++openChannels_ == channelCount_) {
+      this->stage("channels");
+      this->setupSinks();
+    }
+    break;
+  }
+  case cMediaConfig:
+    this->onConfig(channel, payload);
+    break;
+  case cMediaAck:
+    this->onAck(channel, payload);
+    break;
+  default:
+    break;
+  }
+}
+
+void FakePhone::openChannels(const aasdk::common::DataConstBuffer &payload) {
+  aap_protobuf::service::control::message::ServiceDiscoveryResponse response;
+  if (!response.ParseFromArray(payload.cdata, static_cast<int>(payload.size))) {
+    this->fail("unreadable service discovery response");
+    return;
+  }
+
+  channelCount_ = static_cast<size_t>(response.channels_size());
+  openChannels_ = 0;
+  openRequestedMs_ = this->elapsedMs();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &advertised : response.channels()) {
+      if (!advertised.has_media_sink_service()) {
+        continue;
+      }
+      const auto channel = static_cast<messenger::ChannelId>(advertised.id());
+      const auto &sink = advertised.media_sink_service();
+      if (sink.video_configs_size() > 0) {
+        sinks_[channel].video = true;
+        videoChannel_ = channel;
+      } else if (sink.audio_configs_size() > 0) {
+        sinks_[channel].video = false;
+      }
+    }
+  }
+  if (this->videoChannel() == messenger::ChannelId::NONE) {
+    this->fail("no video channel advertised");
+    return;
+  }
+
+  for (const auto &advertised : response.channels()) {
+    aap_protobuf::service::control::message::ChannelOpenRequest request;
+    request.set_priority(0);
+    request.set_service_id(static_cast<int32_t>(advertised.id()));
+    this->send(static_cast<messenger::ChannelId>(advertised.id()), messenger::MessageType::CONTROL,
+               cChannelOpenRequest, request);
+  }
+}
+
+void FakePhone::setupSinks() {
+  std::map<messenger::ChannelId, bool> sinks;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &sink : sinks_) {
+      sinks[sink.first] = sink.second.video;
+    }
+  }
+  for (const auto &sink : sinks) {
+    media::shared::message::Setup setup;
+    setup.set_type(sink.second ? media::shared::message::MediaCodecType::MEDIA_CODEC_VIDEO_H264_BP
+                               : media::shared::message::MediaCodecType::MEDIA_CODEC_AUDIO_PCM);
+    this->send(sink.first, messenger::MessageType::SPECIFIC, cMediaSetup, setup);
+  }
+}
+
+void FakePhone::onConfig(messenger::ChannelId channel, const aasdk::common::DataConstBuffer &payload) {
+  media::shared::message::Config config;
+  if (!config.ParseFromArray(payload.cdata, static_cast<int>(payload.size)) ||
+      config.status() != media::shared::message::Config::STATUS_READY) {
+    this->fail(messenger::channelIdToString(channel) + " not ready");
+    return;
+  }
+  const bool video = channel == this->videoChannel();
+  if (video) {
+    this->stage("setup");
+  }
+
+  media::shared::message::Start start;
+  start.set_session_id(1);
+  start.set_configuration_index(config.configuration_indices_size() > 0 ? config.configuration_indices(0) : 0);
+  this->send(channel, messenger::MessageType::SPECIFIC, cMediaStart, start);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Sink &sink = sinks_[channel];
+    sink.started = true;
+    sink.maxUnacked = std::max<uint32_t>(1, config.max_unacked());
+  }
+  if (handlers_.onStarted) {
+    handlers_.onStarted(channel);
+  }
+}
+
+void FakePhone::onAck(messenger::ChannelId channel, const aasdk::common::DataConstBuffer &payload) {
+  media::source::message::Ack ack;
+  const uint32_t count = ack.ParseFromArray(payload.cdata, static_cast<int>(payload.size)) && ack.has_ack()
+                             ? ack.ack()
+                             : 1;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Sink &sink = sinks_[channel];
+    sink.unacked -= std::min(sink.unacked, count);
+  }
+  if (handlers_.onAck) {
+    handlers_.onAck(channel);
+  }
+}
+
+void FakePhone::stage(const char *name) {
+  if (handlers_.onStage) {
+    handlers_.onStage(name);
+  }
+}
+
+void FakePhone::fail(const std::string &error) {
+  if (!active_) {
+    return;
+  }
+  active_ = false;
+  if (handlers_.onError) {
+    handlers_.onError(error);
+  }
+}
+
+}  // namespace bench
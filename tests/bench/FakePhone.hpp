@@ -0,0 +1,106 @@
+// FakePhone - the phone end of an Android Auto session over TCP, for the
+// benches that drive a real head unit: session_bench in-process, soak_bench
+// against a running autoapp.
+//
+// It speaks AAP through aasdk's own transport, streams and messenger as a
+// TLS 1.2 server, opens every channel the head unit advertises and sets up
+// and starts its video and audio sinks. Media goes out with sendMedia(),
+// inside each channel's ACK window.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <boost/asio.hpp>
+#include <aasdk/Messenger/ChannelId.hpp>
+#include <aasdk/Messenger/ICryptor.hpp>
+#include <aasdk/Messenger/IMessenger.hpp>
+#include <aasdk/TCP/ITCPEndpoint.hpp>
+#include <aasdk/TCP/ITCPWrapper.hpp>
+#include <aasdk/Transport/ITransport.hpp>
+
+namespace google {
+namespace protobuf {
+class Message;
+}
+}  // namespace google
+
+namespace bench {
+
+class FakePhone : public std::enable_shared_from_this<FakePhone> {
+public:
+  typedef std::shared_ptr<FakePhone> Pointer;
+
+  // Called on the phone's strand
+  struct Handlers {
+    // "version", "tls", "discovery", "channels", then "setup" once the
+    // video sink is configured
+    std::function<void(const char *stage)> onStage;
+    // Start sent on a media sink; sendMedia() may be used from now on
+    std::function<void(aasdk::messenger::ChannelId channel)> onStarted;
+    std::function<void(aasdk::messenger::ChannelId channel)> onAck;
+    // The session is over: the head unit closed it or answered nonsense
+    std::function<void(const std::string &error)> onError;
+  };
+
+  FakePhone(boost::asio::io_service &ioService, aasdk::tcp::ITCPWrapper &tcpWrapper,
+            aasdk::tcp::ITCPEndpoint::SocketPointer socket);
+
+  void start(Handlers handlers);
+  void stop();
+
+  // One media message, timestamp in microseconds first; any thread
+  void sendMedia(aasdk::messenger::ChannelId channel, uint64_t timestamp, const aasdk::common::DataConstBuffer &data);
+  bool isStarted(aasdk::messenger::ChannelId channel) const;
+  // Started, and fewer frames unacknowledged than the head unit allows
+  bool canSend(aasdk::messenger::ChannelId channel) const;
+
+  aasdk::messenger::ChannelId videoChannel() const;
+  // Request to response, per channel name, once "channels" was reported
+  std::map<std::string, double> channelOpenMs() const;
+
+private:
+  struct Sink {
+    bool video = false;
+    bool started = false;
+    uint32_t maxUnacked = 1;
+    uint32_t unacked = 0;
+  };
+
+  double elapsedMs() const;
+  void receive();
+  void onMessage(aasdk::messenger::Message &message);
+  void openChannels(const aasdk::common::DataConstBuffer &payload);
+  void setupSinks();
+  void onConfig(aasdk::messenger::ChannelId channel, const aasdk::common::DataConstBuffer &payload);
+  void onAck(aasdk::messenger::ChannelId channel, const aasdk::common::DataConstBuffer &payload);
+  void send(aasdk::messenger::ChannelId channel, aasdk::messenger::EncryptionType encryption,
+            aasdk::messenger::MessageType type, uint16_t id, const aasdk::common::DataConstBuffer &payload);
+  void send(aasdk::messenger::ChannelId channel, aasdk::messenger::MessageType type, uint16_t id,
+            const google::protobuf::Message &payload);
+  void stage(const char *name);
+  void fail(const std::string &error);
+
+  boost::asio::io_service::strand strand_;
+  aasdk::transport::ITransport::Pointer transport_;
+  aasdk::messenger::ICryptor::Pointer cryptor_;
+  aasdk::messenger::IMessenger::Pointer messenger_;
+  Handlers handlers_;
+  bool active_ = false;
+  std::chrono::steady_clock::time_point started_;
+  double openRequestedMs_ = 0.0;
+  size_t channelCount_ = 0;
+  size_t openChannels_ = 0;
+
+  mutable std::mutex mutex_;
+  std::map<aasdk::messenger::ChannelId, Sink> sinks_;
+  aasdk::messenger::ChannelId videoChannel_ = aasdk::messenger::ChannelId::NONE;
+  std::map<std::string, double> channelOpenMs_;
+};
+
+}  // namespace bench
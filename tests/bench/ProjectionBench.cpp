@@ -0,0 +1,328 @@
+// projection_bench - cost of the per-packet and per-period primitives the
+// projection layer runs on the media, audio and input paths.
+//
+//   projection_bench --benchmark_out=rk3229.json --benchmark_out_format=json
+//
+// Compare two runs on the same SoC with Google Benchmark's compare.py:
+//
+//   compare.py benchmarks baseline/rk3229.json rk3229.json
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <aasdk/Messenger/IMessenger.hpp>
+#include <f1x/openauto/autoapp/PipelineTrace.hpp>
+#include <f1x/openauto/autoapp/Projection/FrameRing.hpp>
+#include <f1x/openauto/autoapp/Projection/IInputDevice.hpp>
+#include <f1x/openauto/autoapp/Projection/LockFreeRingBuffer.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDsp.hpp>
+#include <f1x/openauto/autoapp/Projection/ProjectionGeometry.hpp>
+#include <f1x/openauto/autoapp/Projection/RtAudioOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/SequentialBuffer.hpp>
+#include <f1x/openauto/autoapp/Service/InputSource/InputSourceService.hpp>
+
+namespace autoapp = f1x::openauto::autoapp;
+namespace projection = f1x::openauto::autoapp::projection;
+namespace service = f1x::openauto::autoapp::service;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Audio-sized by default: one 10 ms 48 kHz stereo packet is 1920 bytes
+void ringSpscThroughput(benchmark::State &state) {
+  const size_t block = static_cast<size_t>(state.range(0));
+  projection::LockFreeRingBuffer<65536> ring;
+  std::atomic<bool> done(false);
+
+  std::thread consumer([&ring, &done, block]() {
+    std::vector<uint8_t> out(block);
+    while (!done.load(std::memory_order_relaxed)) {
+      if (ring.read(out.data(), block) == 0) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  const std::vector<uint8_t> in(block, 0x5a);
+  size_t written = 0;
+  for (auto _ : state) {
+    size_t offset = 0;
+    while (offset < block) {
+      const size_t n = ring.write(in.data() + offset, block - offset);
+      if (n == 0) {
+        std::this_thread::yield(); // a single-core SoC must let the reader run
+      }
+      offset += n;
+    }
+    written += block;
+  }
+  done.store(true);
+  consumer.join();
+  state.SetBytesProcessed(static_cast<int64_t>(written));
+}
+BENCHMARK(ringSpscThroughput)->Arg(256)->Arg(1920)->Arg(16384)->UseRealTime();
+
+// ringSpscThroughput on a stereo 16-bit FrameRing of the same 64 KB: the
+// same block sizes in bytes, moved as whole frames with a constant mask
+void frameRingSpscThroughput(benchmark::State &state) {
+  typedef projection::FrameRing<int16_t, 2, 16384> Ring;
+  const size_t frames = static_cast<size_t>(state.range(0)) / Ring::cFrameBytes;
+  Ring ring;
+  std::atomic<bool> done(false);
+
+  std::thread consumer([&ring, &done, frames]() {
+    std::vector<int16_t> out(frames * Ring::cChannels);
+    while (!done.load(std::memory_order_relaxed)) {
+      if (ring.read(out.data(), frames) == 0) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  const std::vector<int16_t> in(frames * Ring::cChannels, 0x5a);
+  size_t written = 0;
+  for (auto _ : state) {
+    size_t offset = 0;
+    while (offset < frames) {
+      const size_t n = ring.write(in.data() + offset * Ring::cChannels, frames - offset);
+      if (n == 0) {
+        std::this_thread::yield();
+      }
+      offset += n;
+    }
+    written += frames;
+  }
+  done.store(true);
+  consumer.join();
+  state.SetBytesProcessed(static_cast<int64_t>(written * Ring::cFrameBytes));
+}
+BENCHMARK(frameRingSpscThroughput)->Arg(256)->Arg(1920)->Arg(16384)->UseRealTime();
+
+// The playback pattern: 10 ms packets in, one device period out per read,
+// byte ring against frame ring on one thread so only the copies are timed
+void ringPacketsToPeriods(benchmark::State &state) {
+  constexpr size_t cPacketFrames = 480;
+  constexpr size_t cPeriodFrames = 256;
+  const bool frames = state.range(0) != 0;
+  projection::LockFreeRingBuffer<65536> byteRing;
+  projection::FrameRing<int16_t, 2, 16384> frameRing;
+  const std::vector<int16_t> packet(cPacketFrames * 2, 0x11);
+  std::vector<int16_t> period(cPeriodFrames * 2);
+  size_t queued = 0;
+
+  for (auto _ : state) {
+    if (queued < cPeriodFrames) {
+      if (frames) {
+        frameRing.write(packet.data(), cPacketFrames);
+      } else {
+        byteRing.write(packet.data(), cPacketFrames * 4);
+      }
+      queued += cPacketFrames;
+    }
+    if (frames) {
+      frameRing.read(period.data(), cPeriodFrames);
+    } else {
+      byteRing.read(period.data(), cPeriodFrames * 4);
+    }
+    queued -= cPeriodFrames;
+    benchmark::DoNotOptimize(period.data());
+  }
+  state.SetItemsProcessed(state.iterations() * cPeriodFrames);
+}
+BENCHMARK(ringPacketsToPeriods)->ArgName("frames")->Arg(0)->Arg(1);
+
+// Time from write() on one thread to read() returning it on the other
+void ringSpscLatency(benchmark::State &state) {
+  projection::LockFreeRingBuffer<65536> ring;
+  std::atomic<bool> done(false);
+  std::atomic<int64_t> latencyNs(0);
+
+  std::thread consumer([&ring, &done, &latencyNs]() {
+    Clock::time_point sent;
+    while (!done.load(std::memory_order_relaxed)) {
+      if (ring.read(&sent, sizeof(sent)) == sizeof(sent)) {
+        latencyNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - sent).count(),
+                            std::memory_order_relaxed);
+      }
+    }
+  });
+
+  for (auto _ : state) {
+    const Clock::time_point sent = Clock::now();
+    ring.write(&sent, sizeof(sent));
+    // Wait for the reader so each sample measures an empty-ring handover
+    while (ring.space() != ring.capacity()) {
+      std::this_thread::yield();
+    }
+  }
+  done.store(true);
+  consumer.join();
+  state.counters["latency_ns"] =
+      benchmark::Counter(static_cast<double>(latencyNs.load()), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(ringSpscLatency)->UseRealTime();
+
+// Video access units: a P frame, a typical 720p IDR and a 1080p IDR
+void sequentialBufferWriteRead(benchmark::State &state) {
+  const qint64 size = state.range(0);
+  projection::SequentialBuffer buffer;
+  buffer.open(QIODevice::ReadWrite);
+  const std::vector<char> in(static_cast<size_t>(size), 0x5a);
+  std::vector<char> out(static_cast<size_t>(size));
+
+  for (auto _ : state) {
+    buffer.write(in.data(), size);
+    benchmark::DoNotOptimize(buffer.read(out.data(), size));
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(sequentialBufferWriteRead)->Arg(4096)->Arg(65536)->Arg(262144);
+
+// render() is what the RtAudio callback runs
+class CallbackAudioOutput : public projection::RtAudioOutput {
+public:
+  using projection::RtAudioOutput::RtAudioOutput;
+  using projection::RtAudioOutput::render;
+};
+
+// One period of playback: the channel strand queues a packet of that size
+// and the RT callback drains it into the device buffer. Timed together, as
+// PauseTiming() costs more than the callback itself
+void rtAudioOutputPeriod(benchmark::State &state) {
+  const unsigned int frames = static_cast<unsigned int>(state.range(0));
+  CallbackAudioOutput output(2, 16, 48000);
+  const std::vector<uint8_t> packet(frames * 4, 0x11);
+  std::vector<int16_t> period(frames * 2);
+  uint64_t timestamp = 1;
+
+  for (auto _ : state) {
+    output.write(timestamp, aasdk::common::DataConstBuffer(packet.data(), packet.size()));
+    timestamp += frames * 1000000ull / 48000;
+    output.render(period.data(), frames);
+  }
+  state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK(rtAudioOutputPeriod)->Arg(256)->Arg(480)->Arg(1024);
+
+// What a guidance or system stream kept running costs between prompts:
+// one period of silence per wakeup, at the 16 kHz mono periods it uses
+void rtAudioOutputIdlePeriod(benchmark::State &state) {
+  const unsigned int frames = static_cast<unsigned int>(state.range(0));
+  CallbackAudioOutput output(1, 16, 16000);
+  output.setKeepRunning(true);
+  output.suspend();
+  std::vector<int16_t> period(frames);
+
+  for (auto _ : state) {
+    output.render(period.data(), frames);
+    benchmark::DoNotOptimize(period.data());
+  }
+  state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK(rtAudioOutputIdlePeriod)->Arg(256)->Arg(2048);
+
+// The media EQ and limiter on one 10 ms period, with N of the five EQ
+// bands boosted and loudness on for N = 5; N = 0 is the limiter alone
+void mediaDspPeriod(benchmark::State &state) {
+  const size_t frames = 480;
+  projection::MediaDspSettings settings;
+  settings.enabled = true;
+  settings.cpuBudgetPercent = 100;
+  for (int64_t band = 0; band < state.range(0); band++) {
+    settings.eqGainsDb[static_cast<size_t>(band)] = 3.0f;
+  }
+  settings.loudnessPercent = state.range(0) == 5 ? 50 : 0;
+  projection::MediaDsp dsp(std::make_shared<projection::MediaDspPreset>(settings));
+
+  std::vector<int16_t> period(frames * 2);
+  for (size_t i = 0; i < period.size(); i++) {
+    period[i] = static_cast<int16_t>((i * 2654435761u) >> 18);
+  }
+  for (auto _ : state) {
+    dsp.prepare();
+    dsp.process(period.data(), frames);
+    benchmark::DoNotOptimize(period.data());
+  }
+  state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK(mediaDspPeriod)->Arg(0)->Arg(3)->Arg(5);
+
+// InputDevice maps every Qt touch point through the projection geometry
+void touchToVideo(benchmark::State &state) {
+  const projection::ProjectionGeometry geometry(QSize(1280, 720), QSize(0, 0), QSize(1024, 600));
+  double x = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(geometry.mapToVideo(QPointF(x, 600 - x * 0.5)));
+    x = x < 1024 ? x + 1.5 : 0;
+  }
+}
+BENCHMARK(touchToVideo);
+
+class NullMessenger : public aasdk::messenger::IMessenger {
+public:
+  void enqueueReceive(aasdk::messenger::ReceivePromise::Pointer) override {}
+  void enqueueSend(aasdk::messenger::Message, aasdk::messenger::SendPromise::Pointer promise) override {
+    promise->resolve();
+  }
+  void enqueueSend(aasdk::common::Data, aasdk::messenger::SendPromise::Pointer promise) override {
+    promise->resolve();
+  }
+  void cancelActiveTransfers() override {}
+};
+
+class NullInputDevice : public projection::IInputDevice {
+public:
+  void start(projection::IInputDeviceEventHandler &) override {}
+  void stop() override {}
+  ButtonCodes getSupportedButtonCodes() const override { return {}; }
+  bool hasTouchscreen() const override { return true; }
+  QRect getTouchscreenGeometry() const override { return QRect(0, 0, 1280, 720); }
+};
+
+// A touch down with N pointers, from onTouchEvent() to the serialized
+// report handed to the messenger
+void inputSourceTouchReport(benchmark::State &state) {
+  boost::asio::io_service ioService;
+  auto inputSource = std::make_shared<service::InputSourceService>(
+      ioService, std::make_shared<NullMessenger>(), std::make_shared<NullInputDevice>(),
+      std::chrono::microseconds::zero());
+
+  projection::TouchEvent event;
+  event.type = aap_protobuf::service::inputsource::message::PointerAction::ACTION_DOWN;
+  event.actionIndex = 0;
+  for (int64_t pointer = 0; pointer < state.range(0); pointer++) {
+    event.pointers.push_back({static_cast<uint32_t>(100 + pointer * 50), 300, static_cast<uint32_t>(pointer)});
+  }
+
+  for (auto _ : state) {
+    inputSource->onTouchEvent(event);
+    ioService.poll();
+    ioService.restart();
+  }
+}
+BENCHMARK(inputSourceTouchReport)->Arg(1)->Arg(2)->Arg(5);
+
+// What every instrumented path pays for one trace scope, with the trace
+// stopped (0) and recording (1)
+void pipelineTraceScope(benchmark::State &state) {
+  auto &trace = autoapp::PipelineTrace::instance();
+  if (state.range(0) != 0) {
+    trace.start();
+  }
+  for (auto _ : state) {
+    autoapp::TraceScope scope("bench.scope");
+  }
+  trace.stop();
+}
+BENCHMARK(pipelineTraceScope)->Arg(0)->Arg(1);
+
+}  // namespace
+
+BENCHMARK_MAIN();
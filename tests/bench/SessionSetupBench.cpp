@@ -0,0 +1,381 @@
+// session_bench - time from a phone's connection to its first video frame
+// acknowledged, step by step, against a fake phone over loopback TCP.
+//
+//   session_bench [--sessions N] [--resume] [--json] [--budget-ms N]
+//
+// The head unit end is what AndroidAutoEntityFactory builds for a WiFi
+// client: TCPTransport, a Cryptor on the caching SSL wrapper, the message
+// streams and messenger, and an AndroidAutoEntity running the real video,
+// media and system audio, input and sensor services. Only their outputs
+// are null. The phone end is FakePhone, which reports each step as it
+// sees it finish:
+//
+//   version    version request answered
+//   tls        AUTH_COMPLETE received
+//   discovery  service discovery response received
+//   channels   every advertised channel open, each also timed on its own
+//   setup      media config received for the video channel
+//   frame      first video frame acknowledged
+//
+// --resume keeps TLS session resumption on, so every session after the
+// first resumes instead of running a full handshake. With --budget-ms the
+// exit status is 1 when the median total exceeds the budget, for CI.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <aasdk/Messenger/Cryptor.hpp>
+#include <aasdk/Messenger/MessageInStream.hpp>
+#include <aasdk/Messenger/MessageOutStream.hpp>
+#include <aasdk/Messenger/Messenger.hpp>
+#include <aasdk/TCP/TCPEndpoint.hpp>
+#include <aasdk/TCP/TCPWrapper.hpp>
+#include <aasdk/Transport/TCPTransport.hpp>
+#include <f1x/openauto/autoapp/Configuration/Configuration.hpp>
+#include <f1x/openauto/autoapp/Logging.hpp>
+#include <f1x/openauto/autoapp/Projection/IAudioOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/IInputDevice.hpp>
+#include <f1x/openauto/autoapp/Projection/IVideoOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoModeSelector.hpp>
+#include <f1x/openauto/autoapp/Service/AndroidAutoEntity.hpp>
+#include <f1x/openauto/autoapp/Service/CachingSSLWrapper.hpp>
+#include <f1x/openauto/autoapp/Service/InputSource/InputSourceService.hpp>
+#include <f1x/openauto/autoapp/Service/MediaSink/MediaAudioService.hpp>
+#include <f1x/openauto/autoapp/Service/MediaSink/SystemAudioService.hpp>
+#include <f1x/openauto/autoapp/Service/MediaSink/VideoService.hpp>
+#include <f1x/openauto/autoapp/Service/Pinger.hpp>
+#include <f1x/openauto/autoapp/Service/Sensor/SensorService.hpp>
+#include <f1x/openauto/autoapp/TcpTuning.hpp>
+#include "FakePhone.hpp"
+
+namespace autoapp = f1x::openauto::autoapp;
+namespace projection = f1x::openauto::autoapp::projection;
+namespace service = f1x::openauto::autoapp::service;
+namespace messenger = aasdk::messenger;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const char *const cStages[] = {"version", "tls", "discovery", "channels", "setup", "frame"};
+
+struct Options {
+  size_t sessions = 20;
+  bool resume = false;
+  bool json = false;
+  double budgetMs = 0.0;  // 0 is no budget
+};
+
+struct Spread {
+  std::vector<double> samples;
+
+  void add(double value) { samples.push_back(value); }
+
+  double percentile(double p) {
+    if (samples.empty()) {
+      return 0.0;
+    }
+    const size_t index = std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+  }
+};
+
+// One session: ms since the head unit started, per stage and per channel open
+struct SessionResult {
+  bool ok = false;
+  std::string error;
+  std::map<std::string, double> stages;
+  std::map<std::string, double> channels;
+};
+
+class NullVideoOutput : public projection::IVideoOutput {
+public:
+  bool open() override { return true; }
+  bool init() override { return true; }
+  void write(messenger::Timestamp::ValueType, const aasdk::common::DataConstBuffer &) override {}
+  void stop() override {}
+  aap_protobuf::service::media::sink::message::VideoFrameRateType getVideoFPS() const override {
+    return aap_protobuf::service::media::sink::message::VideoFrameRateType::VIDEO_FPS_30;
+  }
+  aap_protobuf::service::media::sink::message::VideoCodecResolutionType getVideoResolution() const override {
+    return aap_protobuf::service::media::sink::message::VideoCodecResolutionType::VIDEO_1280x720;
+  }
+  size_t getScreenDPI() const override { return 140; }
+  QRect getVideoMargins() const override { return QRect(); }
+  size_t getMaxUnackedFrames() const override { return 4; }
+};
+
+class NullAudioOutput : public projection::IAudioOutput {
+public:
+  NullAudioOutput(uint32_t channelCount, uint32_t sampleRate) : channelCount_(channelCount), sampleRate_(sampleRate) {}
+  bool open() override { return true; }
+  void write(messenger::Timestamp::ValueType, const aasdk::common::DataConstBuffer &) override {}
+  void start() override {}
+  void stop() override {}
+  void suspend() override {}
+  uint32_t getSampleSize() const override { return 16; }
+  uint32_t getChannelCount() const override { return channelCount_; }
+  uint32_t getSampleRate() const override { return sampleRate_; }
+
+private:
+  uint32_t channelCount_;
+  uint32_t sampleRate_;
+};
+
+class NullInputDevice : public projection::IInputDevice {
+public:
+  void start(projection::IInputDeviceEventHandler &) override {}
+  void stop() override {}
+  ButtonCodes getSupportedButtonCodes() const override { return {}; }
+  bool hasTouchscreen() const override { return true; }
+  QRect getTouchscreenGeometry() const override { return QRect(0, 0, 1280, 720); }
+};
+
+class QuitHandler : public service::IAndroidAutoEntityEventHandler {
+public:
+  void onAndroidAutoQuit() override {}
+};
+
+// What AndroidAutoEntityFactory and ServiceFactory build, with null outputs
+service::IAndroidAutoEntity::Pointer createEntity(boost::asio::io_service &ioService,
+                                                  autoapp::configuration::IConfiguration::Pointer configuration,
+                                                  projection::VideoModeSelector::Pointer modeSelector,
+                                                  aasdk::tcp::ITCPWrapper &tcpWrapper,
+                                                  aasdk::tcp::ITCPEndpoint::SocketPointer socket, bool resume) {
+  auto endpoint = std::make_shared<aasdk::tcp::TCPEndpoint>(tcpWrapper, std::move(socket));
+  auto transport = std::make_shared<aasdk::transport::TCPTransport>(ioService, std::move(endpoint));
+  auto cryptor = std::make_shared<messenger::Cryptor>(
+      std::make_shared<service::CachingSSLWrapper>("session_bench", resume, false));
+  cryptor->init();
+  messenger::IMessenger::Pointer messenger = std::make_shared<messenger::Messenger>(
+      ioService, std::make_shared<messenger::MessageInStream>(ioService, transport, cryptor),
+      std::make_shared<messenger::MessageOutStream>(ioService, transport, cryptor));
+
+  service::ServiceList services;
+  services.emplace_back(std::make_shared<service::mediasink::MediaAudioService>(
+      ioService, messenger, std::make_shared<NullAudioOutput>(2, 48000)));
+  services.emplace_back(std::make_shared<service::mediasink::SystemAudioService>(
+      ioService, messenger, std::make_shared<NullAudioOutput>(1, 16000)));
+  services.emplace_back(std::make_shared<service::mediasink::VideoService>(
+      ioService, messenger, std::make_shared<NullVideoOutput>(), std::move(modeSelector)));
+  services.emplace_back(std::make_shared<service::inputsource::InputSourceService>(
+      ioService, messenger, std::make_shared<NullInputDevice>()));
+  services.emplace_back(std::make_shared<service::sensor::SensorService>(
+      ioService, messenger, std::vector<service::sensor::IVehicleSensorSource::Pointer>(), false));
+
+  return std::make_shared<service::AndroidAutoEntity>(ioService, std::move(cryptor), std::move(transport),
+                                                      std::move(messenger), std::move(configuration),
+                                                      std::move(services),
+                                                      std::make_shared<service::Pinger>(ioService, 5000));
+}
+
+SessionResult runSession(boost::asio::io_service &headUnitService, boost::asio::io_service &phoneService,
+                         autoapp::configuration::IConfiguration::Pointer configuration,
+                         projection::VideoModeSelector::Pointer modeSelector, bool resume) {
+  aasdk::tcp::TCPWrapper tcpWrapper;
+  boost::asio::ip::tcp::acceptor acceptor(
+      headUnitService, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+  auto headUnitSocket = std::make_shared<boost::asio::ip::tcp::socket>(headUnitService);
+  auto phoneSocket = std::make_shared<boost::asio::ip::tcp::socket>(phoneService);
+  phoneSocket->connect(acceptor.local_endpoint());
+  acceptor.accept(*headUnitSocket);
+  autoapp::TcpTuning::instance().apply(headUnitSocket->native_handle());
+  phoneSocket->set_option(boost::asio::ip::tcp::no_delay(true));
+
+  QuitHandler quitHandler;
+  const Clock::time_point started = Clock::now();
+  auto entity = createEntity(headUnitService, std::move(configuration), std::move(modeSelector), tcpWrapper,
+                             std::move(headUnitSocket), resume);
+  auto phone = std::make_shared<bench::FakePhone>(phoneService, tcpWrapper, std::move(phoneSocket));
+  std::weak_ptr<bench::FakePhone> weakPhone = phone;
+
+  // The handlers all run on the phone's strand
+  auto result = std::make_shared<SessionResult>();
+  auto done = std::make_shared<std::promise<void>>();
+  auto settled = std::make_shared<bool>(false);
+  auto finish = [result, done, settled](bool ok, const std::string &error) {
+    if (*settled) {
+      return;
+    }
+    *settled = true;
+    result->ok = ok;
+    result->error = ok ? std::string() : error;
+    done->set_value();
+  };
+  auto mark = [result, started](const char *stage) {
+    result->stages[stage] = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+  };
+
+  bench::FakePhone::Handlers handlers;
+  handlers.onStage = mark;
+  handlers.onStarted = [weakPhone](messenger::ChannelId channel) {
+    auto phone = weakPhone.lock();
+    if (phone == nullptr || channel != phone->videoChannel()) {
+      return;
+    }
+    // An Annex B SPS, PPS and IDR slice, as phones send first
+    std::vector<uint8_t> frame = {0, 0, 0, 1, 0x67, 0x42, 0xc0, 0x1f, 0, 0, 0, 1, 0x68, 0xce, 0x3c, 0x80,
+                                  0, 0, 0, 1, 0x65, 0x88, 0x84, 0x00};
+    frame.resize(frame.size() + 16 * 1024, 0x5a);
+    phone->sendMedia(channel, 0, aasdk::common::DataConstBuffer(frame.data(), frame.size()));
+  };
+  handlers.onAck = [weakPhone, mark, finish](messenger::ChannelId channel) {
+    auto phone = weakPhone.lock();
+    if (phone != nullptr && channel == phone->videoChannel()) {
+      mark("frame");
+      finish(true, std::string());
+    }
+  };
+  handlers.onError = [finish](const std::string &error) { finish(false, error); };
+
+  phone->start(std::move(handlers));
+  entity->start(quitHandler);
+
+  const bool finished = done->get_future().wait_for(std::chrono::seconds(10)) == std::future_status::ready;
+  entity->stop();
+  phone->stop();
+  // Both stops are queued on their strands; let them and the aborted reads run
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  if (!finished) {
+    SessionResult timedOut;
+    timedOut.error = "timed out";
+    return timedOut;
+  }
+  result->channels = phone->channelOpenMs();
+  return *result;
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--sessions" && i + 1 < argc) {
+      options.sessions = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+    } else if (arg == "--resume") {
+      options.resume = true;
+    } else if (arg == "--json") {
+      options.json = true;
+    } else if (arg == "--budget-ms" && i + 1 < argc) {
+      options.budgetMs = std::atof(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string fixed(double value, int precision = 1) {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(precision) << value;
+  return out.str();
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    std::cerr << "Usage: " << argv[0] << " [--sessions N] [--resume] [--json] [--budget-ms N]" << std::endl;
+    return 2;
+  }
+  // The services log every step of every session
+  setenv("OPENAUTO_LOG_LEVEL", "warning", 0);
+  autoapp::Logging::configure("");
+
+  // Head unit and phone on their own threads, as on two devices
+  boost::asio::io_service headUnitService;
+  boost::asio::io_service phoneService;
+  auto headUnitWork = std::make_unique<boost::asio::io_service::work>(headUnitService);
+  auto phoneWork = std::make_unique<boost::asio::io_service::work>(phoneService);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 2; ++i) {
+    threads.emplace_back([&headUnitService]() { headUnitService.run(); });
+  }
+  threads.emplace_back([&phoneService]() { phoneService.run(); });
+
+  auto configuration = std::make_shared<autoapp::configuration::Configuration>();
+  auto modeSelector = std::make_shared<projection::VideoModeSelector>(configuration, QSize(1280, 720));
+
+  std::map<std::string, Spread> stages;
+  std::map<std::string, Spread> channels;
+  size_t failed = 0;
+  for (size_t session = 0; session < options.sessions; ++session) {
+    SessionResult result = runSession(headUnitService, phoneService, configuration, modeSelector, options.resume);
+    if (!result.ok) {
+      ++failed;
+      std::cerr << "session " << session << " failed: " << result.error << std::endl;
+      continue;
+    }
+    // Each stage as the time since the one before it
+    double previous = 0.0;
+    for (const char *stage : cStages) {
+      const double at = result.stages[stage];
+      stages[stage].add(at - previous);
+      previous = at;
+    }
+    stages["total"].add(previous);
+    for (const auto &channel : result.channels) {
+      channels[channel.first].add(channel.second);
+    }
+  }
+
+  headUnitWork.reset();
+  phoneWork.reset();
+  headUnitService.stop();
+  phoneService.stop();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  const double totalP50 = stages["total"].percentile(0.5);
+  if (options.json) {
+    std::cout << "{\"sessions\": " << options.sessions << ", \"failed\": " << failed
+              << ", \"resume\": " << (options.resume ? "true" : "false") << ", \"stages\": {";
+    bool first = true;
+    for (const std::string stage : {"version", "tls", "discovery", "channels", "setup", "frame", "total"}) {
+      auto &spread = stages[stage];
+      std::cout << (first ? "" : ", ") << "\"" << stage << "\": {\"p50_ms\": " << fixed(spread.percentile(0.5), 2)
+                << ", \"p90_ms\": " << fixed(spread.percentile(0.9), 2) << "}";
+      first = false;
+    }
+    std::cout << "}, \"channel_open_p50_ms\": {";
+    first = true;
+    for (auto &channel : channels) {
+      std::cout << (first ? "" : ", ") << "\"" << channel.first << "\": " << fixed(channel.second.percentile(0.5), 2);
+      first = false;
+    }
+    std::cout << "}}\n";
+  } else {
+    std::cout << options.sessions << " sessions over loopback TCP, TLS " << (options.resume ? "resumed" : "full")
+              << ", " << failed << " failed\n"
+              << std::setw(10) << "stage" << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms" << "\n";
+    for (const std::string stage : {"version", "tls", "discovery", "channels", "setup", "frame", "total"}) {
+      auto &spread = stages[stage];
+      std::cout << std::setw(10) << stage << std::setw(10) << fixed(spread.percentile(0.5), 2) << std::setw(10)
+                << fixed(spread.percentile(0.9), 2) << "\n";
+    }
+    std::cout << "channel open, request to response p50:\n";
+    for (auto &channel : channels) {
+      std::cout << "  " << std::setw(24) << std::left << channel.first << std::right
+                << fixed(channel.second.percentile(0.5), 2) << " ms\n";
+    }
+  }
+
+  autoapp::Logging::shutdown();
+  if (failed == options.sessions) {
+    return 1;
+  }
+  return options.budgetMs > 0.0 && totalP50 > options.budgetMs ? 1 : 0;
+}
@@ -0,0 +1,270 @@
+// soak_bench - the phone end of a soak run: a recorded session played into
+// a running autoapp over its wireless port, over and over, for hours.
+//
+//   soak_bench --dump session.oamd [--host 127.0.0.1] [--port 5000]
+//              [--hours 24] [--speed 1] [--reconnect-ms 2000] [--json]
+//
+// Start autoapp with OPENAUTO_SOAK=hours,disconnectMinutes first. Each
+// session is a FakePhone connection that replays the dump (see
+// SessionRecordingPath) at its recorded pacing into the channels the
+// head unit started, looping at the end with timestamps carried on, and
+// inside each channel's ACK window. autoapp ends sessions at random
+// through App::onAndroidAutoQuit; the bench then reconnects as a phone
+// would, so setup and teardown are soaked along with the media paths.
+// The resource trends and the verdict are autoapp's; this reports what
+// was played and how each session ended.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <aasdk/TCP/TCPWrapper.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDump.hpp>
+#include "FakePhone.hpp"
+
+namespace projection = f1x::openauto::autoapp::projection;
+namespace messenger = aasdk::messenger;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+  std::string dump;
+  std::string host = "127.0.0.1";
+  uint16_t port = 5000;
+  double hours = 24.0;
+  double speed = 1.0;  // 0 sends records back to back, still ACK-paced
+  int reconnectMs = 2000;
+  bool json = false;
+};
+
+// A record whose channel has no free ACK slot for this long is dropped
+const std::chrono::milliseconds cWindowWait(500);
+// From connect to the video sink started
+const std::chrono::seconds cSetupTimeout(15);
+
+struct Totals {
+  uint64_t sessions = 0;
+  uint64_t failedSetups = 0;
+  uint64_t failedConnects = 0;
+  uint64_t records = 0;
+  uint64_t dropped = 0;
+  uint64_t passes = 0;
+};
+
+// How one session went, filled on the phone's strand
+struct SessionState {
+  std::atomic<bool> ready{false};
+  std::atomic<bool> over{false};
+  std::mutex mutex;
+  std::string error;
+};
+
+class Replay {
+public:
+  explicit Replay(const std::string &path) : reader_(path) {}
+
+  bool isOpen() const { return reader_.isOpen(); }
+
+  // Plays into @p phone until the session is over or @p deadline passes
+  void run(bench::FakePhone &phone, const SessionState &state, Clock::time_point deadline, double speed,
+           Totals &totals) {
+    // Pacing restarts from the next record, wherever the last session left off
+    passStart_ = Clock::time_point();
+    while (!state.over && Clock::now() < deadline) {
+      if (!reader_.next(record_)) {
+        // Next pass: the phone's clock keeps running, so do its timestamps
+        reader_.rewind();
+        timestampOffset_ += lastTimestamp_ + 33333;
+        passStart_ = Clock::time_point();
+        totals.passes++;
+        continue;
+      }
+      if (passStart_ == Clock::time_point()) {
+        passStart_ = Clock::now();
+        firstArrivalUs_ = record_.arrivalUs;
+      }
+      lastTimestamp_ = std::max(lastTimestamp_, record_.timestamp);
+
+      const auto channel = static_cast<messenger::ChannelId>(record_.channel);
+      if (!phone.isStarted(channel)) {
+        continue;
+      }
+      if (speed > 0) {
+        const auto offsetUs = static_cast<int64_t>((record_.arrivalUs - firstArrivalUs_) / speed);
+        std::this_thread::sleep_until(passStart_ + std::chrono::microseconds(offsetUs));
+      }
+      const Clock::time_point giveUp = Clock::now() + cWindowWait;
+      while (!phone.canSend(channel) && !state.over && Clock::now() < giveUp) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      if (!phone.canSend(channel)) {
+        totals.dropped++;
+        continue;
+      }
+      phone.sendMedia(channel, timestampOffset_ + record_.timestamp,
+                      aasdk::common::DataConstBuffer(record_.payload.data(), record_.payload.size()));
+      totals.records++;
+    }
+  }
+
+private:
+  projection::MediaDumpReader reader_;
+  projection::MediaDumpRecord record_;
+  Clock::time_point passStart_;
+  int64_t firstArrivalUs_ = 0;
+  uint64_t lastTimestamp_ = 0;
+  uint64_t timestampOffset_ = 0;
+};
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--dump" && hasValue) {
+      options.dump = argv[++i];
+    } else if (arg == "--host" && hasValue) {
+      options.host = argv[++i];
+    } else if (arg == "--port" && hasValue) {
+      options.port = static_cast<uint16_t>(std::atoi(argv[++i]));
+    } else if (arg == "--hours" && hasValue) {
+      options.hours = std::max(0.01, std::atof(argv[++i]));
+    } else if (arg == "--speed" && hasValue) {
+      options.speed = std::max(0.0, std::atof(argv[++i]));
+    } else if (arg == "--reconnect-ms" && hasValue) {
+      options.reconnectMs = std::max(0, std::atoi(argv[++i]));
+    } else if (arg == "--json") {
+      options.json = true;
+    } else {
+      return false;
+    }
+  }
+  return !options.dump.empty() && options.port != 0;
+}
+
+std::string fixed(double value, int precision = 1) {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(precision) << value;
+  return out.str();
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    std::cerr << "Usage: " << argv[0]
+              << " --dump session.oamd [--host 127.0.0.1] [--port 5000] [--hours 24] [--speed 1]"
+                 " [--reconnect-ms 2000] [--json]"
+              << std::endl;
+    return 2;
+  }
+  Replay replay(options.dump);
+  if (!replay.isOpen()) {
+    std::cerr << "Cannot read " << options.dump << std::endl;
+    return 2;
+  }
+
+  boost::asio::io_service phoneService;
+  auto work = std::make_unique<boost::asio::io_service::work>(phoneService);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 2; i++) {
+    threads.emplace_back([&phoneService]() { phoneService.run(); });
+  }
+
+  boost::system::error_code error;
+  const boost::asio::ip::tcp::endpoint headUnit(boost::asio::ip::address::from_string(options.host, error),
+                                                options.port);
+  if (error) {
+    std::cerr << "Bad host " << options.host << std::endl;
+    return 2;
+  }
+
+  aasdk::tcp::TCPWrapper tcpWrapper;
+  Totals totals;
+  const Clock::time_point began = Clock::now();
+  const Clock::time_point deadline = began + std::chrono::milliseconds(static_cast<int64_t>(options.hours * 3600e3));
+  while (Clock::now() < deadline) {
+    auto socket = std::make_shared<boost::asio::ip::tcp::socket>(phoneService);
+    socket->connect(headUnit, error);
+    if (error) {
+      totals.failedConnects++;
+      std::this_thread::sleep_for(std::chrono::milliseconds(options.reconnectMs));
+      continue;
+    }
+    socket->set_option(boost::asio::ip::tcp::no_delay(true));
+
+    auto phone = std::make_shared<bench::FakePhone>(phoneService, tcpWrapper, std::move(socket));
+    std::weak_ptr<bench::FakePhone> weakPhone = phone;
+    auto state = std::make_shared<SessionState>();
+    bench::FakePhone::Handlers handlers;
+    handlers.onStarted = [weakPhone, state](messenger::ChannelId channel) {
+      auto phone = weakPhone.lock();
+      if (phone != nullptr && channel == phone->videoChannel()) {
+        state->ready = true;
+      }
+    };
+    handlers.onError = [state](const std::string &message) {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->error = message;
+      state->over = true;
+    };
+    phone->start(std::move(handlers));
+
+    const Clock::time_point connected = Clock::now();
+    while (!state->ready && !state->over && Clock::now() < connected + cSetupTimeout) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    totals.sessions++;
+    const uint64_t recordsBefore = totals.records;
+    if (state->ready && !state->over) {
+      replay.run(*phone, *state, deadline, options.speed, totals);
+    } else {
+      totals.failedSetups++;
+    }
+    phone->stop();
+
+    std::string ended;
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      ended = state->over ? state->error : (state->ready ? "soak over" : "setup timed out");
+    }
+    if (!options.json) {
+      std::cout << "session " << totals.sessions << ": "
+                << fixed(std::chrono::duration<double>(Clock::now() - connected).count(), 0) << " s, "
+                << totals.records - recordsBefore << " records, ended: " << ended << std::endl;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(options.reconnectMs));
+  }
+
+  work.reset();
+  phoneService.stop();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  const double hours = std::chrono::duration<double>(Clock::now() - began).count() / 3600.0;
+  if (options.json) {
+    std::cout << "{\"hours\": " << fixed(hours, 2) << ", \"sessions\": " << totals.sessions
+              << ", \"failed_setups\": " << totals.failedSetups << ", \"failed_connects\": " << totals.failedConnects
+              << ", \"records\": " << totals.records << ", \"dropped\": " << totals.dropped
+              << ", \"passes\": " << totals.passes << "}\n";
+  } else {
+    std::cout << fixed(hours, 2) << " h: " << totals.sessions << " sessions, " << totals.failedSetups
+              << " failed setups, " << totals.failedConnects << " failed connects, " << totals.records
+              << " records played, " << totals.dropped << " dropped at a full ACK window, " << totals.passes
+              << " passes over the dump\n";
+  }
+  return totals.failedSetups > 0 ? 1 : 0;
+}
@@ -11,6 +11,8 @@ public:
   MOCK_METHOD(void, load, (), (override));
   MOCK_METHOD(void, reset, (), (override));
   MOCK_METHOD(void, save, (), (override));
+  MOCK_METHOD(size_t, subscribe, (ChangeHandler handler), (override));
+  MOCK_METHOD(void, unsubscribe, (size_t subscription), (override));
   MOCK_METHOD(bool, hasTouchScreen, (), (const, override));
 
   // Handedness
@@ -42,6 +44,22 @@ public:
   MOCK_METHOD(bool, showNetworkinfo, (), (const, override));
   MOCK_METHOD(void, hideWarning, (bool value), (override));
   MOCK_METHOD(bool, hideWarning, (), (const, override));
+  MOCK_METHOD(std::string, getSessionRecordingPath, (), (const, override));
+  MOCK_METHOD(void, setSessionRecordingPath, (const std::string &value), (override));
+  MOCK_METHOD(bool, getTlsSessionResumption, (), (const, override));
+  MOCK_METHOD(void, setTlsSessionResumption, (bool value), (override));
+  MOCK_METHOD(std::string, getTlsCipherPreference, (), (const, override));
+  MOCK_METHOD(void, setTlsCipherPreference, (const std::string &value), (override));
+  MOCK_METHOD(bool, getUsbFastReconnect, (), (const, override));
+  MOCK_METHOD(void, setUsbFastReconnect, (bool value), (override));
+  MOCK_METHOD(int32_t, getUsbInTransfers, (), (const, override));
+  MOCK_METHOD(void, setUsbInTransfers, (int32_t value), (override));
+  MOCK_METHOD(int32_t, getUsbInTransferKb, (), (const, override));
+  MOCK_METHOD(void, setUsbInTransferKb, (int32_t value), (override));
+  MOCK_METHOD(bool, getOutboundPriority, (), (const, override));
+  MOCK_METHOD(void, setOutboundPriority, (bool value), (override));
+  MOCK_METHOD(bool, getMessageBufferPool, (), (const, override));
+  MOCK_METHOD(void, setMessageBufferPool, (bool value), (override));
 
   // MP3 settings
   MOCK_METHOD(std::string, getMp3MasterPath, (), (const, override));
@@ -56,6 +74,8 @@ public:
   MOCK_METHOD(void, showAutoPlay, (bool value), (override));
   MOCK_METHOD(bool, instantPlay, (), (const, override));
   MOCK_METHOD(void, instantPlay, (bool value), (override));
+  MOCK_METHOD(bool, getPlayerReplayGain, (), (const, override));
+  MOCK_METHOD(void, setPlayerReplayGain, (bool value), (override));
 
   // File utilities
   MOCK_METHOD(QString, getCSValue, (QString searchString), (const, override));
@@ -84,6 +104,38 @@ public:
   MOCK_METHOD(int32_t, getOMXLayerIndex, (), (const, override));
   MOCK_METHOD(void, setVideoMargins, (QRect value), (override));
   MOCK_METHOD(QRect, getVideoMargins, (), (const, override));
+  MOCK_METHOD(size_t, getVideoFrameQueueDepth, (), (const, override));
+  MOCK_METHOD(void, setVideoFrameQueueDepth, (size_t value), (override));
+  MOCK_METHOD(bool, getVideoAdaptiveMode, (), (const, override));
+  MOCK_METHOD(void, setVideoAdaptiveMode, (bool value), (override));
+  MOCK_METHOD(size_t, getVideoMaxUnacked, (), (const, override));
+  MOCK_METHOD(void, setVideoMaxUnacked, (size_t value), (override));
+  MOCK_METHOD(bool, getVideoCompositorImport, (), (const, override));
+  MOCK_METHOD(void, setVideoCompositorImport, (bool value), (override));
+  MOCK_METHOD(std::string, getVideoBackend, (), (const, override));
+  MOCK_METHOD(void, setVideoBackend, (const std::string &value), (override));
+  MOCK_METHOD(std::string, getRearCameraDevice, (), (const, override));
+  MOCK_METHOD(void, setRearCameraDevice, (const std::string &value), (override));
+  MOCK_METHOD(bool, getRearCameraHotStandby, (), (const, override));
+  MOCK_METHOD(void, setRearCameraHotStandby, (bool value), (override));
+  MOCK_METHOD(bool, getRearCameraGuidelines, (), (const, override));
+  MOCK_METHOD(void, setRearCameraGuidelines, (bool value), (override));
+  MOCK_METHOD(bool, getDashcamEnabled, (), (const, override));
+  MOCK_METHOD(void, setDashcamEnabled, (bool value), (override));
+  MOCK_METHOD(std::string, getDashcamDirectory, (), (const, override));
+  MOCK_METHOD(void, setDashcamDirectory, (const std::string &value), (override));
+  MOCK_METHOD(uint32_t, getDashcamSegmentSeconds, (), (const, override));
+  MOCK_METHOD(void, setDashcamSegmentSeconds, (uint32_t value), (override));
+  MOCK_METHOD(uint32_t, getDashcamMaxDiskMb, (), (const, override));
+  MOCK_METHOD(void, setDashcamMaxDiskMb, (uint32_t value), (override));
+  MOCK_METHOD(uint32_t, getDashcamBitrateKbps, (), (const, override));
+  MOCK_METHOD(void, setDashcamBitrateKbps, (uint32_t value), (override));
+  MOCK_METHOD(std::string, getClusterOutput, (), (const, override));
+  MOCK_METHOD(void, setClusterOutput, (const std::string &value), (override));
+  MOCK_METHOD(int32_t, getVideoDisplayRotation, (), (const, override));
+  MOCK_METHOD(void, setVideoDisplayRotation, (int32_t value), (override));
+  MOCK_METHOD(bool, getVideoDisplayMirror, (), (const, override));
+  MOCK_METHOD(void, setVideoDisplayMirror, (bool value), (override));
 
   // Input settings
   MOCK_METHOD(bool, getTouchscreenEnabled, (), (const, override));
@@ -92,6 +144,18 @@ public:
   MOCK_METHOD(void, playerButtonControl, (bool value), (override));
   MOCK_METHOD(ButtonCodes, getButtonCodes, (), (const, override));
   MOCK_METHOD(void, setButtonCodes, (const ButtonCodes &value), (override));
+  MOCK_METHOD(int32_t, getTouchCoalesceMs, (), (const, override));
+  MOCK_METHOD(void, setTouchCoalesceMs, (int32_t value), (override));
+  MOCK_METHOD(int32_t, getTouchPredictionMs, (), (const, override));
+  MOCK_METHOD(void, setTouchPredictionMs, (int32_t value), (override));
+  MOCK_METHOD(std::string, getTouchscreenDevice, (), (const, override));
+  MOCK_METHOD(void, setTouchscreenDevice, (const std::string &value), (override));
+  MOCK_METHOD(std::string, getKeyDevices, (), (const, override));
+  MOCK_METHOD(void, setKeyDevices, (const std::string &value), (override));
+  MOCK_METHOD(std::string, getKeyMap, (), (const, override));
+  MOCK_METHOD(void, setKeyMap, (const std::string &value), (override));
+  MOCK_METHOD(uint32_t, getRotaryAccelerationDetents, (), (const, override));
+  MOCK_METHOD(void, setRotaryAccelerationDetents, (uint32_t value), (override));
 
   // Bluetooth settings
   MOCK_METHOD(BluetoothAdapterType, getBluetoothAdapterType, (),
@@ -103,6 +167,28 @@ public:
               (override));
   MOCK_METHOD(bool, getWirelessProjectionEnabled, (), (const, override));
   MOCK_METHOD(void, setWirelessProjectionEnabled, (bool value), (override));
+  MOCK_METHOD(bool, getWirelessTcpNoDelay, (), (const, override));
+  MOCK_METHOD(void, setWirelessTcpNoDelay, (bool value), (override));
+  MOCK_METHOD(int32_t, getWirelessTcpReceiveBufferKb, (), (const, override));
+  MOCK_METHOD(void, setWirelessTcpReceiveBufferKb, (int32_t value), (override));
+  MOCK_METHOD(int32_t, getWirelessTcpSendBufferKb, (), (const, override));
+  MOCK_METHOD(void, setWirelessTcpSendBufferKb, (int32_t value), (override));
+  MOCK_METHOD(bool, getWirelessTcpQuickAck, (), (const, override));
+  MOCK_METHOD(void, setWirelessTcpQuickAck, (bool value), (override));
+  MOCK_METHOD(int32_t, getWirelessTcpDscp, (), (const, override));
+  MOCK_METHOD(void, setWirelessTcpDscp, (int32_t value), (override));
+  MOCK_METHOD(int32_t, getWirelessTcpBusyPollUs, (), (const, override));
+  MOCK_METHOD(void, setWirelessTcpBusyPollUs, (int32_t value), (override));
+  MOCK_METHOD(bool, getWirelessTcpLinkStats, (), (const, override));
+  MOCK_METHOD(void, setWirelessTcpLinkStats, (bool value), (override));
+  MOCK_METHOD(std::string, getWirelessHotspotInterface, (), (const, override));
+  MOCK_METHOD(void, setWirelessHotspotInterface, (const std::string &value), (override));
+  MOCK_METHOD(bool, getWirelessHotspotAutoChannel, (), (const, override));
+  MOCK_METHOD(void, setWirelessHotspotAutoChannel, (bool value), (override));
+  MOCK_METHOD(int32_t, getWirelessHotspotChannelWidthMhz, (), (const, override));
+  MOCK_METHOD(void, setWirelessHotspotChannelWidthMhz, (int32_t value), (override));
+  MOCK_METHOD(bool, getWirelessHotspotPowerSaveOff, (), (const, override));
+  MOCK_METHOD(void, setWirelessHotspotPowerSaveOff, (bool value), (override));
 
   // Audio channel settings
   MOCK_METHOD(bool, musicAudioChannelEnabled, (), (const, override));
@@ -121,6 +207,93 @@ public:
   MOCK_METHOD(std::string, getAudioInputDeviceName, (), (const, override));
   MOCK_METHOD(void, setAudioInputDeviceName, (const std::string &value),
               (override));
+  MOCK_METHOD(bool, getAudioLowLatency, (), (const, override));
+  MOCK_METHOD(void, setAudioLowLatency, (bool value), (override));
+  MOCK_METHOD(uint32_t, getAudioJitterBufferMs, (), (const, override));
+  MOCK_METHOD(void, setAudioJitterBufferMs, (uint32_t value), (override));
+  MOCK_METHOD(bool, getAudioMixerEnabled, (), (const, override));
+  MOCK_METHOD(void, setAudioMixerEnabled, (bool value), (override));
+  MOCK_METHOD(uint32_t, getAudioDuckingPercent, (), (const, override));
+  MOCK_METHOD(void, setAudioDuckingPercent, (uint32_t value), (override));
+  MOCK_METHOD(bool, getAudioVoiceProcessing, (), (const, override));
+  MOCK_METHOD(void, setAudioVoiceProcessing, (bool value), (override));
+  MOCK_METHOD(bool, getAudioVoiceProcessingLowCpu, (), (const, override));
+  MOCK_METHOD(void, setAudioVoiceProcessingLowCpu, (bool value), (override));
+  MOCK_METHOD(int32_t, getAudioVoiceProcessingCpu, (), (const, override));
+  MOCK_METHOD(void, setAudioVoiceProcessingCpu, (int32_t value), (override));
+  MOCK_METHOD(uint32_t, getThreadIoWorkers, (), (const, override));
+  MOCK_METHOD(void, setThreadIoWorkers, (uint32_t value), (override));
+  MOCK_METHOD(std::string, getThreadWorkerCpus, (), (const, override));
+  MOCK_METHOD(void, setThreadWorkerCpus, (const std::string &value),
+              (override));
+  MOCK_METHOD(std::string, getThreadVideoCpus, (), (const, override));
+  MOCK_METHOD(void, setThreadVideoCpus, (const std::string &value), (override));
+  MOCK_METHOD(std::string, getThreadAudioCpus, (), (const, override));
+  MOCK_METHOD(void, setThreadAudioCpus, (const std::string &value), (override));
+  MOCK_METHOD(int32_t, getThreadVideoPriority, (), (const, override));
+  MOCK_METHOD(void, setThreadVideoPriority, (int32_t value), (override));
+  MOCK_METHOD(int32_t, getThreadAudioPriority, (), (const, override));
+  MOCK_METHOD(void, setThreadAudioPriority, (int32_t value), (override));
+  MOCK_METHOD(std::string, getSensorCanInterface, (), (const, override));
+  MOCK_METHOD(void, setSensorCanInterface, (const std::string &value),
+              (override));
+  MOCK_METHOD(std::string, getSensorCanSignals, (), (const, override));
+  MOCK_METHOD(void, setSensorCanSignals, (const std::string &value),
+              (override));
+  MOCK_METHOD(std::string, getSensorObdDevice, (), (const, override));
+  MOCK_METHOD(void, setSensorObdDevice, (const std::string &value), (override));
+  MOCK_METHOD(std::string, getSensorIioDevice, (), (const, override));
+  MOCK_METHOD(void, setSensorIioDevice, (const std::string &value), (override));
+  MOCK_METHOD(std::string, getSensorLightDevice, (), (const, override));
+  MOCK_METHOD(void, setSensorLightDevice, (const std::string &value), (override));
+  MOCK_METHOD(int32_t, getSensorLightNightLux, (), (const, override));
+  MOCK_METHOD(void, setSensorLightNightLux, (int32_t value), (override));
+  MOCK_METHOD(int32_t, getSensorLightDayLux, (), (const, override));
+  MOCK_METHOD(void, setSensorLightDayLux, (int32_t value), (override));
+  MOCK_METHOD(std::string, getSensorLightBacklight, (), (const, override));
+  MOCK_METHOD(void, setSensorLightBacklight, (const std::string &value), (override));
+  MOCK_METHOD(bool, getSensorGpsNightMode, (), (const, override));
+  MOCK_METHOD(void, setSensorGpsNightMode, (bool value), (override));
+  MOCK_METHOD(bool, getSensorRestrictWhileMoving, (), (const, override));
+  MOCK_METHOD(void, setSensorRestrictWhileMoving, (bool value), (override));
+  MOCK_METHOD(uint32_t, getMetricsHttpPort, (), (const, override));
+  MOCK_METHOD(void, setMetricsHttpPort, (uint32_t value), (override));
+  MOCK_METHOD(std::string, getMetricsStatsdTarget, (), (const, override));
+  MOCK_METHOD(void, setMetricsStatsdTarget, (const std::string &value), (override));
+  MOCK_METHOD(bool, getMetricsOverlay, (), (const, override));
+  MOCK_METHOD(void, setMetricsOverlay, (bool value), (override));
+  MOCK_METHOD(uint32_t, getAudioAckBatch, (), (const, override));
+  MOCK_METHOD(void, setAudioAckBatch, (uint32_t value), (override));
+  MOCK_METHOD(bool, getAudioMediaAac, (), (const, override));
+  MOCK_METHOD(void, setAudioMediaAac, (bool value), (override));
+  MOCK_METHOD(uint32_t, getAudioMicPreRollMs, (), (const, override));
+  MOCK_METHOD(void, setAudioMicPreRollMs, (uint32_t value), (override));
+  MOCK_METHOD(std::string, getRadioDevice, (), (const, override));
+  MOCK_METHOD(void, setRadioDevice, (const std::string &value), (override));
+  MOCK_METHOD(std::string, getRadioAudioDevice, (), (const, override));
+  MOCK_METHOD(void, setRadioAudioDevice, (const std::string &value), (override));
+  MOCK_METHOD(std::string, getRadioRegion, (), (const, override));
+  MOCK_METHOD(void, setRadioRegion, (const std::string &value), (override));
+  MOCK_METHOD(bool, getAudioWarmStreams, (), (const, override));
+  MOCK_METHOD(void, setAudioWarmStreams, (bool value), (override));
+  MOCK_METHOD(bool, getAudioDspEnabled, (), (const, override));
+  MOCK_METHOD(void, setAudioDspEnabled, (bool value), (override));
+  MOCK_METHOD(std::string, getAudioEqualizerGains, (), (const, override));
+  MOCK_METHOD(void, setAudioEqualizerGains, (const std::string &value), (override));
+  MOCK_METHOD(uint32_t, getAudioLoudnessPercent, (), (const, override));
+  MOCK_METHOD(void, setAudioLoudnessPercent, (uint32_t value), (override));
+  MOCK_METHOD(uint32_t, getAudioDspCpuBudgetPercent, (), (const, override));
+  MOCK_METHOD(void, setAudioDspCpuBudgetPercent, (uint32_t value), (override));
+  MOCK_METHOD(std::string, getThreadPowerProfileProjection, (), (const, override));
+  MOCK_METHOD(void, setThreadPowerProfileProjection, (const std::string &value), (override));
+  MOCK_METHOD(std::string, getThreadPowerProfileIdle, (), (const, override));
+  MOCK_METHOD(void, setThreadPowerProfileIdle, (const std::string &value), (override));
+  MOCK_METHOD(std::string, getThreadPowerDevfreqDevices, (), (const, override));
+  MOCK_METHOD(void, setThreadPowerDevfreqDevices, (const std::string &value), (override));
+  MOCK_METHOD(bool, getThreadStrandMonitor, (), (const, override));
+  MOCK_METHOD(void, setThreadStrandMonitor, (bool value), (override));
+  MOCK_METHOD(int32_t, getThreadStrandLongTaskMs, (), (const, override));
+  MOCK_METHOD(void, setThreadStrandLongTaskMs, (int32_t value), (override));
 };
 
 } // namespace f1x::openauto::autoapp::configuration
\ No newline at end of file
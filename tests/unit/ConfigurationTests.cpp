@@ -2,12 +2,19 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QSettings>
 #include <QTemporaryFile>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <cstdio>
 #include <memory>
+#include <thread>
 
 #include <f1x/openauto/autoapp/Configuration/Configuration.hpp>
+#include <f1x/openauto/autoapp/Configuration/KnownDevicesList.hpp>
+#include <f1x/openauto/autoapp/Configuration/KnownPhonesList.hpp>
+#include <f1x/openauto/autoapp/Configuration/PhoneProfilesList.hpp>
 
 namespace f1x::openauto::autoapp::configuration {
 
@@ -163,4 +170,159 @@ TEST_F(ConfigurationTest, InputConfiguration) {
   EXPECT_EQ(!touchscreenEnabled, configuration->getTouchscreenEnabled());
 }
 
+// TC-CONF-005 - Known USB Devices
+TEST(KnownDevicesListTest, MostRecentFirstAndPersisted) {
+  std::remove("openauto_usb_known.ini");
+  {
+    KnownDevicesList list(2);
+    list.read();
+    KnownDevice phone;
+    phone.vendorId = 0x18D1;
+    phone.productId = 0x2D01;
+    phone.serial = "A";
+    list.insertDevice(phone);
+    list.insertDevice(phone);
+    phone.serial = "B";
+    list.insertDevice(phone);
+    phone.serial = "";
+    list.insertDevice(phone); // cannot be matched on replug
+  }
+
+  KnownDevicesList list(2);
+  list.read();
+  const auto devices = list.getList();
+  ASSERT_EQ(devices.size(), 2u);
+  EXPECT_EQ(devices[0].serial, "B");
+  EXPECT_EQ(devices[1].serial, "A");
+  EXPECT_EQ(devices[1].sessions, 2u);
+  EXPECT_EQ(devices[1].productId, 0x2D01);
+  EXPECT_TRUE(list.contains("A"));
+  EXPECT_FALSE(list.contains(""));
+  std::remove("openauto_usb_known.ini");
+}
+
+// TC-CONF-006 - Snapshot And Deferred Save
+TEST_F(ConfigurationTest, SnapshotFollowsTheIni) {
+  configuration->setAlphaTrans(120);
+  configuration->setVideoBackend("drm");
+  configuration->save(); // deferred: load() waits for it
+  configuration->load();
+  EXPECT_EQ(configuration->getAlphaTrans(), 120u);
+  EXPECT_TRUE(QFile::exists(QString::fromStdString(Configuration::cSnapshotFileName)));
+
+  // Edited by hand since the snapshot was taken: the INI wins
+  {
+    QSettings settings(QString::fromStdString(Configuration::cConfigFileName),
+                       QSettings::IniFormat);
+    settings.setValue("General/AlphaTrans", 90);
+  }
+  auto edited = std::make_shared<Configuration>();
+  EXPECT_EQ(edited->getAlphaTrans(), 90u);
+  EXPECT_EQ(edited->getVideoBackend(), "drm");
+
+  edited->reset();
+  EXPECT_EQ(edited->getAlphaTrans(), 200u);
+  EXPECT_EQ(edited->getVideoBackend(), "");
+}
+
+// TC-CONF-007 - Published Values And Change Notification
+TEST_F(ConfigurationTest, ReadersSeePublishedValuesAndSubscribersRunOnSave) {
+  int changes = 0;
+  const size_t subscription =
+      configuration->subscribe([&changes]() { changes++; });
+
+  // Another thread reads while this one changes the same string
+  std::atomic<bool> done(false);
+  std::thread reader([this, &done]() {
+    while (!done.load()) {
+      const std::string name = configuration->getAudioInputDeviceName();
+      EXPECT_TRUE(name.empty() || name == "hw:1,0" || name == "hw:2,0");
+    }
+  });
+  for (int i = 0; i < 500; i++) {
+    configuration->setAudioInputDeviceName(i % 2 ? "hw:1,0" : "hw:2,0");
+  }
+  done.store(true);
+  reader.join();
+  EXPECT_EQ(configuration->getAudioInputDeviceName(), "hw:1,0");
+  EXPECT_EQ(changes, 0); // setters alone do not notify
+
+  configuration->save();
+  EXPECT_EQ(changes, 1);
+  configuration->unsubscribe(subscription);
+  configuration->reset();
+  EXPECT_EQ(changes, 1);
+}
+
+// TC-CONF-008 - Known Bluetooth Phones
+TEST(KnownPhonesListTest, LastPhoneFirstWithCachedChannel) {
+  std::remove("openauto_bt_phones.ini");
+  {
+    KnownPhonesList list(2);
+    list.read();
+    list.remember("AA:AA:AA:AA:AA:AA", 7);
+    list.remember("BB:BB:BB:BB:BB:BB", 0);
+    list.remember("AA:AA:AA:AA:AA:AA", 0); // reconnected in: channel kept
+  }
+
+  KnownPhonesList list(2);
+  list.read();
+  auto phones = list.getList();
+  ASSERT_EQ(phones.size(), 2u);
+  EXPECT_EQ(phones[0].address, "AA:AA:AA:AA:AA:AA");
+  EXPECT_EQ(phones[0].channel, 7);
+  EXPECT_EQ(phones[1].channel, 0);
+
+  list.forgetChannel("AA:AA:AA:AA:AA:AA");
+  list.remember("CC:CC:CC:CC:CC:CC", 3);
+  phones = list.getList();
+  ASSERT_EQ(phones.size(), 2u);
+  EXPECT_EQ(phones[0].address, "CC:CC:CC:CC:CC:CC");
+  EXPECT_EQ(phones[1].address, "AA:AA:AA:AA:AA:AA");
+  EXPECT_EQ(phones[1].channel, 0);
+  std::remove("openauto_bt_phones.ini");
+}
+
+// TC-CONF-009 - Learned Phone Profiles
+TEST(PhoneProfilesListTest, LastPhoneFirstAndPersisted) {
+  using aap_protobuf::service::media::sink::message::VideoCodecResolutionType;
+  using aap_protobuf::service::media::sink::message::VideoFrameRateType;
+  std::remove("openauto_phone_profiles.ini");
+  {
+    PhoneProfilesList list(2);
+    list.read();
+    PhoneProfile pixel;
+    pixel.phone = "Pixel 7";
+    pixel.sessions = 3;
+    pixel.videoResolution = VideoCodecResolutionType::VIDEO_1280x720;
+    pixel.videoFps = VideoFrameRateType::VIDEO_FPS_60;
+    pixel.videoMaxUnacked = 2;
+    pixel.streamKbps = 8000.5;
+    list.remember(pixel);
+    PhoneProfile galaxy;
+    galaxy.phone = "SM-G991B";
+    list.remember(galaxy);
+  }
+
+  PhoneProfilesList list(2);
+  list.read();
+  PhoneProfile profile;
+  ASSERT_TRUE(list.find("Pixel 7", profile));
+  EXPECT_EQ(profile.sessions, 3u);
+  EXPECT_EQ(profile.videoResolution, VideoCodecResolutionType::VIDEO_1280x720);
+  EXPECT_EQ(profile.videoFps, VideoFrameRateType::VIDEO_FPS_60);
+  EXPECT_EQ(profile.videoMaxUnacked, 2u);
+  EXPECT_DOUBLE_EQ(profile.streamKbps, 8000.5);
+  EXPECT_EQ(list.getList().front().phone, "SM-G991B");
+
+  // Remembering a full list forgets the phone seen longest ago
+  list.remember(profile);
+  PhoneProfile third;
+  third.phone = "iPhone";
+  list.remember(third);
+  EXPECT_FALSE(list.find("SM-G991B", profile));
+  EXPECT_TRUE(list.find("Pixel 7", profile));
+  std::remove("openauto_phone_profiles.ini");
+}
+
 } // namespace f1x::openauto::autoapp::configuration
\ No newline at end of file
@@ -2,8 +2,21 @@
 #include <gmock/gmock.h>
 #include <memory>
 #include <chrono>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
 
 #include <f1x/openauto/autoapp/App.hpp>
+#include <f1x/openauto/autoapp/BluetoothLink.hpp>
+#include <f1x/openauto/autoapp/ConnectionArbiter.hpp>
+#include <f1x/openauto/autoapp/HotspotLink.hpp>
+#include <f1x/openauto/autoapp/WifiConnector.hpp>
 #include "../../mocks/MockAndroidAutoEntity.hpp"
 #include "../../mocks/MockAndroidAutoEntityFactory.hpp"
 #include "../../mocks/MockConfiguration.hpp"
@@ -137,4 +150,248 @@ TEST_F(ConnectionTest, ConnectionLostRecovery) {
     ioService.stop();
 }
 
+// TC-CONN-004 - Transport Arbitration
+TEST(ConnectionArbiterTest, UsbPreferredAndHealthySessionsKept) {
+    ConnectionArbiter arbiter;
+    EXPECT_EQ(arbiter.offer(ConnectionTransport::Wifi, LinkState::Unknown), ArbiterDecision::Accept);
+
+    arbiter.started(ConnectionTransport::Usb);
+    // A stray WiFi connect never ends a USB session, however the link looks
+    EXPECT_EQ(arbiter.offer(ConnectionTransport::Wifi, LinkState::Poor), ArbiterDecision::Reject);
+    EXPECT_EQ(arbiter.offer(ConnectionTransport::Usb, LinkState::Good), ArbiterDecision::Reject);
+
+    arbiter.started(ConnectionTransport::Wifi);
+    EXPECT_EQ(arbiter.offer(ConnectionTransport::Usb, LinkState::Good), ArbiterDecision::Replace);
+    EXPECT_EQ(arbiter.offer(ConnectionTransport::Wifi, LinkState::Good), ArbiterDecision::Reject);
+    EXPECT_EQ(arbiter.offer(ConnectionTransport::Wifi, LinkState::Degraded), ArbiterDecision::Replace);
+
+    arbiter.ended();
+    EXPECT_EQ(arbiter.current(), ConnectionTransport::None);
+    EXPECT_EQ(arbiter.offer(ConnectionTransport::Usb, LinkState::Unknown), ArbiterDecision::Accept);
+}
+
+// TC-CONN-005 - Bluetooth Link
+TEST(BluetoothLinkTest, EventsRoundTrip) {
+    common::BtLinkEvent event;
+    event.type = common::BtLinkMessage::PhoneConnected;
+    event.value = -3;
+    event.address = "AA:BB:CC:DD:EE:FF";
+    event.name = "Pixel";
+    const std::string packet = common::encodeBtLinkEvent(event);
+
+    common::BtLinkEvent decoded;
+    ASSERT_TRUE(common::decodeBtLinkEvent(packet.data(), packet.size(), decoded));
+    EXPECT_EQ(decoded.type, common::BtLinkMessage::PhoneConnected);
+    EXPECT_EQ(decoded.value, -3);
+    EXPECT_EQ(decoded.address, event.address);
+    EXPECT_EQ(decoded.name, event.name);
+    // Truncated packets are rejected rather than read past
+    EXPECT_FALSE(common::decodeBtLinkEvent(packet.data(), packet.size() - 1, decoded));
+}
+
+TEST(BluetoothLinkTest, SaysHelloAndFollowsThePhone) {
+    const std::string linkName = "openauto-test-link-" + std::to_string(getpid());
+    const std::string peerName = "openauto-test-peer-" + std::to_string(getpid());
+    const int peer = common::openBtLinkSocket(peerName.c_str());
+    ASSERT_GE(peer, 0);
+
+    std::mutex mutex;
+    std::condition_variable received;
+    int events = 0;
+    {
+        BluetoothLink link(linkName, peerName);
+        link.subscribe([&](const common::BtLinkEvent &) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++events;
+            received.notify_all();
+        });
+
+        char packet[common::cBtLinkMaxSize];
+        ssize_t size = -1;
+        for (int i = 0; i < 100 && size < 0; ++i) {
+            size = recv(peer, packet, sizeof(packet), 0);
+            if (size < 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+        common::BtLinkEvent hello;
+        ASSERT_TRUE(common::decodeBtLinkEvent(packet, static_cast<size_t>(std::max<ssize_t>(size, 0)), hello));
+        EXPECT_EQ(hello.type, common::BtLinkMessage::Hello);
+
+        common::BtLinkEvent connected;
+        connected.type = common::BtLinkMessage::PhoneConnected;
+        connected.address = "AA:BB:CC:DD:EE:FF";
+        connected.name = "Pixel";
+        ASSERT_TRUE(common::sendBtLinkEvent(peer, linkName.c_str(), connected));
+
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(received.wait_for(lock, std::chrono::seconds(1), [&]() { return events == 1; }));
+        EXPECT_TRUE(link.phoneConnected());
+        EXPECT_EQ(link.phoneName(), "Pixel");
+    }
+    close(peer);
+}
+
+TEST(BluetoothLinkTest, HearsBtserviceStagesUntilReady) {
+    EXPECT_TRUE(common::isBtServiceStage("listen"));
+    EXPECT_FALSE(common::isBtServiceStage("listen_ms{}"));
+
+    const std::string linkName = "openauto-test-stages-" + std::to_string(getpid());
+    const std::string peerName = "openauto-test-btservice-" + std::to_string(getpid());
+    const int peer = common::openBtLinkSocket(peerName.c_str());
+    ASSERT_GE(peer, 0);
+
+    std::mutex mutex;
+    std::condition_variable received;
+    std::vector<std::string> stages;
+    {
+        BluetoothLink link(linkName, peerName);
+        link.subscribe([&](const common::BtLinkEvent &event) {
+            std::lock_guard<std::mutex> lock(mutex);
+            stages.push_back(event.name);
+            received.notify_all();
+        });
+        EXPECT_FALSE(link.serviceReady());
+
+        for (const char *name : {"adapter", "listen", common::cBtServiceReady}) {
+            common::BtLinkEvent stage;
+            stage.type = common::BtLinkMessage::ServiceStage;
+            stage.value = 120;
+            stage.name = name;
+            ASSERT_TRUE(common::sendBtLinkEvent(peer, linkName.c_str(), stage));
+            std::unique_lock<std::mutex> lock(mutex);
+            ASSERT_TRUE(received.wait_for(lock, std::chrono::seconds(1), [&]() { return !stages.empty() && stages.back() == name; }));
+            lock.unlock();
+            EXPECT_EQ(link.serviceReady(), name == std::string(common::cBtServiceReady));
+        }
+    }
+    close(peer);
+}
+
+// TC-CONN-006 - Raced WiFi connects
+TEST(WifiConnectorTest, AnsweringAddressBeatsStaleOne) {
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::acceptor acceptor(ioService, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    const uint16_t port = acceptor.local_endpoint().port();
+
+    // 192.0.2.1 is TEST-NET-1 and never answers, like a phone's old lease
+    auto connector = std::make_shared<WifiConnector>(ioService, port, 50, 2000);
+    boost::system::error_code result = boost::asio::error::would_block;
+    std::string winner;
+    const auto started = std::chrono::steady_clock::now();
+    connector->connect({"192.0.2.1", "not-an-address", "127.0.0.1", "192.0.2.1"},
+                       [&](const boost::system::error_code &error, aasdk::tcp::ITCPEndpoint::SocketPointer socket,
+                           const std::string &address) {
+                           result = error;
+                           winner = address;
+                           EXPECT_EQ(socket != nullptr, !error);
+                       });
+    ioService.run();
+
+    EXPECT_FALSE(result);
+    EXPECT_EQ(winner, "127.0.0.1");
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(1));
+}
+
+TEST(WifiConnectorTest, RestartedRaceIgnoresThePreviousOnesCompletions) {
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::acceptor acceptor(ioService, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    const uint16_t port = acceptor.local_endpoint().port();
+
+    // No stagger, so the stale address is in flight when the loopback one wins
+    auto connector = std::make_shared<WifiConnector>(ioService, port, 0, 2000);
+    int races = 0;
+    boost::system::error_code result = boost::asio::error::would_block;
+    std::string winner;
+    auto second = [&](const boost::system::error_code &error, aasdk::tcp::ITCPEndpoint::SocketPointer socket,
+                      const std::string &address) {
+        ++races;
+        result = error;
+        winner = address;
+        EXPECT_EQ(socket != nullptr, !error);
+    };
+    connector->connect({"192.0.2.1", "127.0.0.1"},
+                       [&](const boost::system::error_code &error, aasdk::tcp::ITCPEndpoint::SocketPointer,
+                           const std::string &) {
+                           ++races;
+                           EXPECT_FALSE(error);
+                           // The loser's aborted connect is still queued; it must
+                           // not count against the new race's first attempt
+                           connector->connect({"127.0.0.1"}, second);
+                       });
+    ioService.run();
+
+    EXPECT_EQ(races, 2);
+    EXPECT_FALSE(result) << result.message();
+    EXPECT_EQ(winner, "127.0.0.1");
+}
+
+// TC-CONN-007 - Hotspot channel and link
+TEST(HotspotLinkTest, PicksQuietChannelAndRewritesHostapd) {
+    const std::string scan =
+        "BSS 00:11:22:33:44:01(on wlan0)\n\tfreq: 5180\n\tsignal: -40.00 dBm\n"
+        "BSS 00:11:22:33:44:02(on wlan0)\n\tfreq: 5200.0\n\tsignal: -85.00 dBm\n"
+        "BSS 00:11:22:33:44:03(on wlan0)\n\tfreq: 2412\n\tsignal: -30.00 dBm\n";
+    const auto neighbours = HotspotLink::parseScan(scan);
+    ASSERT_EQ(neighbours.size(), 3u);
+    EXPECT_EQ(neighbours[1].frequencyMhz, 5200);
+    EXPECT_EQ(neighbours[0].signalDbm, -40);
+
+    // The loud 36 spoils its whole 80 MHz block; without the upper band the
+    // primary inside it goes to the channel no neighbour uses
+    EXPECT_EQ(HotspotLink::leastCongestedChannel(neighbours, 80, true), 149);
+    EXPECT_EQ(HotspotLink::leastCongestedChannel(neighbours, 80, false), 44);
+    EXPECT_EQ(HotspotLink::leastCongestedChannel({}, 20, false), 36);
+
+    const std::string path = "/tmp/openauto-test-hostapd-" + std::to_string(getpid()) + ".conf";
+    {
+        std::ofstream file(path);
+        file << "interface=wlan0\nhw_mode=g\nchannel=6\nht_capab=[SHORT-GI-20][HT40-]\ncountry_code=DE\n";
+    }
+    ASSERT_TRUE(HotspotLink::applyChannel(path, 44, 80));
+    EXPECT_FALSE(HotspotLink::applyChannel(path, 44, 80));
+    std::ifstream file(path);
+    const std::string written((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_NE(written.find("hw_mode=a\nchannel=44\n"), std::string::npos);
+    EXPECT_NE(written.find("ht_capab=[SHORT-GI-20][HT40+]\n"), std::string::npos);
+    EXPECT_NE(written.find("vht_oper_centr_freq_seg0_idx=42\n"), std::string::npos);
+    EXPECT_NE(written.find("country_code=DE\n"), std::string::npos);
+    std::remove(path.c_str());
+
+    StationStats stats;
+    ASSERT_TRUE(HotspotLink::parseStation("Station aa:bb:cc:dd:ee:ff (on wlan0)\n\ttx packets:\t1200\n"
+                                          "\ttx retries:\t60\n\tsignal:  \t-52 [-54, -55] dBm\n"
+                                          "\ttx bitrate:\t866.7 MBit/s VHT-MCS 9 80MHz short GI VHT-NSS 2\n",
+                                          stats));
+    EXPECT_EQ(stats.txBitrateKbps, 866700);
+    EXPECT_EQ(stats.txRetries, 60u);
+    EXPECT_EQ(stats.signalDbm, -52);
+    EXPECT_FALSE(HotspotLink::parseStation("Not connected.\n", stats));
+
+    // hostapd's control socket gives the rate in 100 kbit/s
+    ASSERT_TRUE(HotspotLink::parseHostapdStation("aa:bb:cc:dd:ee:ff\nflags=[AUTH][ASSOC]\ntx_packets=1500\n"
+                                                 "signal=-48\ntx_rate_info=8667 vhtmcs 9 vhtnss 2 shortGI\n"
+                                                 "tx_retry_count=30\n",
+                                                 stats));
+    EXPECT_EQ(stats.txBitrateKbps, 866700);
+    EXPECT_EQ(stats.txPackets, 1500u);
+    EXPECT_EQ(stats.txRetries, 30u);
+    EXPECT_EQ(stats.signalDbm, -48);
+    EXPECT_FALSE(HotspotLink::parseHostapdStation("FAIL\n", stats));
+}
+
+TEST(HotspotLinkTest, SamplesOnItsOwnThread) {
+    HotspotLink link;
+    std::promise<std::pair<std::thread::id, int64_t>> sampled;
+    auto result = sampled.get_future();
+
+    // Without a session there is nothing to read, but the handler still runs
+    link.sample([&sampled](int64_t usableKbps)
+                { sampled.set_value({std::this_thread::get_id(), usableKbps}); });
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    const auto answer = result.get();
+    EXPECT_NE(answer.first, std::this_thread::get_id());
+    EXPECT_EQ(answer.second, 0);
+}
+
 } // namespace f1x::openauto::autoapp
\ No newline at end of file
@@ -1,12 +1,60 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <future>
 #include <memory>
+#include <sstream>
+#include <thread>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "../../mocks/MockAudioOutput.hpp"
 #include "../../mocks/MockConfiguration.hpp"
+#include <f1x/openauto/Common/CpuFeatures.hpp>
+#include <f1x/openauto/autoapp/MemoryFootprint.hpp>
+#include <f1x/openauto/autoapp/Metrics.hpp>
+#include <f1x/openauto/autoapp/SoakMonitor.hpp>
+#include <f1x/openauto/autoapp/ThermalGovernor.hpp>
+#include <f1x/openauto/autoapp/Projection/AacAudioOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/AudioDeviceList.hpp>
+#include <f1x/openauto/autoapp/Projection/AudioDsp.hpp>
+#include <f1x/openauto/autoapp/Projection/AudioJitterBuffer.hpp>
+#include <f1x/openauto/autoapp/Projection/AudioOutputPool.hpp>
+#include <f1x/openauto/autoapp/Projection/ClusterAtlas.hpp>
+#include <f1x/openauto/autoapp/Projection/ClusterDisplay.hpp>
+#include <f1x/openauto/autoapp/Projection/CmaBudget.hpp>
+#include <f1x/openauto/autoapp/Projection/DashcamSegments.hpp>
+#include <f1x/openauto/autoapp/Projection/DecoderWatchdog.hpp>
+#include <f1x/openauto/autoapp/Projection/DuplexAudioStream.hpp>
+#include <f1x/openauto/autoapp/Projection/EvdevKeyReader.hpp>
+#include <f1x/openauto/autoapp/Projection/H264HeaderParser.hpp>
+#include <f1x/openauto/autoapp/Projection/H264TestStream.hpp>
+#include <f1x/openauto/autoapp/Projection/EvdevTouchReader.hpp>
+#include <f1x/openauto/autoapp/Projection/FrameGrabber.hpp>
+#include <f1x/openauto/autoapp/Projection/FrameRing.hpp>
 #include <f1x/openauto/autoapp/Projection/InputDevice.hpp>
+#include <f1x/openauto/autoapp/Projection/LockFreeRingBuffer.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDsp.hpp>
+#include <f1x/openauto/autoapp/Projection/MediaDumpReplayer.hpp>
+#include <f1x/openauto/autoapp/Projection/PacketDropPolicy.hpp>
+#include <f1x/openauto/autoapp/Projection/PresentationPacer.hpp>
+#include <f1x/openauto/autoapp/Projection/ProjectionGeometry.hpp>
+#include <f1x/openauto/autoapp/Projection/RearCamera.hpp>
 #include <f1x/openauto/autoapp/Projection/RtAudioOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/SequentialBuffer.hpp>
+#include <f1x/openauto/autoapp/Projection/SimdKernels.hpp>
+#include <f1x/openauto/autoapp/Projection/ThreadTopology.hpp>
+#include <f1x/openauto/autoapp/Projection/TouchLatencyProbe.hpp>
+#include <f1x/openauto/autoapp/Projection/TouchPointerTable.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoBackendProbe.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoModeSelector.hpp>
 #include <f1x/openauto/autoapp/Projection/VideoOutput.hpp>
+#include <f1x/openauto/autoapp/Projection/VideoTelemetry.hpp>
+#include <f1x/openauto/autoapp/Projection/VoiceProcessor.hpp>
+#include <f1x/openauto/autoapp/Projection/VpuScheduler.hpp>
+#include <f1x/openauto/autoapp/Projection/YuvCopy.hpp>
 
 using ::testing::_;
 using ::testing::InSequence;
@@ -117,4 +165,1926 @@ TEST_F(ProjectionTest, TouchInputHandling) {
   SUCCEED();
 }
 
-} // namespace f1x::openauto::autoapp::projection
\ No newline at end of file
+// TC-PROJ-005 - Video Latency Telemetry
+TEST(VideoTelemetryTest, LatencyWindowPercentiles) {
+  LatencyWindow window(100);
+  EXPECT_EQ(window.percentile(50.0), 0);
+
+  for (int64_t i = 1; i <= 100; i++) {
+    window.add(i);
+  }
+  EXPECT_EQ(window.count(), 100u);
+  EXPECT_EQ(window.percentile(50.0), 50);
+  EXPECT_EQ(window.percentile(99.0), 99);
+
+  // Once full, the oldest samples are replaced
+  for (int i = 0; i < 100; i++) {
+    window.add(1000);
+  }
+  EXPECT_EQ(window.count(), 100u);
+  EXPECT_EQ(window.percentile(50.0), 1000);
+}
+
+// TC-PROJ-006 - Projection Geometry
+TEST(ProjectionGeometryTest, MarginsLetterboxAndTouchMapping) {
+  // Zero margins are fitted to the display: 1280x720 on 1024x600 leaves the
+  // phone a 1228x720 UI that fills the screen
+  ProjectionGeometry fitted(QSize(1280, 720), QSize(0, 0), QSize(1024, 600));
+  EXPECT_EQ(fitted.margins(), QSize(52, 0));
+  EXPECT_EQ(fitted.sourceRect(), QRect(26, 0, 1228, 720));
+  EXPECT_EQ(fitted.destinationRect(), QRect(0, 0, 1024, 600));
+
+  // Explicit margins are kept; the UI is letterboxed instead of stretched
+  ProjectionGeometry boxed(QSize(1280, 720), QSize(0, 120), QSize(1024, 600));
+  EXPECT_EQ(boxed.sourceRect(), QRect(0, 60, 1280, 600));
+  EXPECT_EQ(boxed.destinationRect(), QRect(0, 60, 1024, 480));
+
+  // Touches land on the pixel that is displayed there
+  EXPECT_EQ(boxed.mapToVideo(QPointF(0, 60)), QPoint(0, 60));
+  EXPECT_EQ(boxed.mapToVideo(QPointF(512, 300)), QPoint(640, 360));
+  // Touches in the bars clamp to the edge of the UI
+  EXPECT_EQ(boxed.mapToVideo(QPointF(512, 10)), QPoint(640, 60));
+
+  // Scaling to a smaller mode keeps the same share of margins
+  EXPECT_EQ(boxed.withVideoSize(QSize(800, 480)).margins(), QSize(0, 80));
+}
+
+// TC-PROJ-007 - CMA Budget
+TEST(CmaBudgetTest, MeminfoAndFrameRingPlan) {
+  std::istringstream meminfo("MemTotal:        1020036 kB\n"
+                             "CmaTotal:         262144 kB\n"
+                             "CmaFree:           65536 kB\n");
+  const CmaMeminfo info = CmaBudget::parseMeminfo(meminfo);
+  EXPECT_EQ(info.totalBytes, 256ll * 1024 * 1024);
+  EXPECT_EQ(info.freeBytes, 64ll * 1024 * 1024);
+
+  // 1080p frames are padded to 1920x1088 NV12
+  EXPECT_EQ(CmaBudget::frameBytes(1920, 1080), 1920ll * 1088 * 3 / 2);
+
+  // Plenty of CMA keeps the configured depth
+  const CmaPlan roomy = CmaBudget::plan(info.freeBytes, 1280, 720, 3);
+  EXPECT_EQ(roomy.frameQueueDepth, 3u);
+  EXPECT_TRUE(roomy.hardwareFits);
+
+  // A tight budget shrinks the ring before giving up on hardware decode;
+  // a quarter of CmaFree is held back for fragmentation
+  const int64_t frame = CmaBudget::frameBytes(1920, 1080);
+  const CmaPlan tight = CmaBudget::plan(frame * 16, 1920, 1080, 3);
+  EXPECT_EQ(tight.frameQueueDepth, 2u);
+  EXPECT_TRUE(tight.hardwareFits);
+  const int64_t depthOne = CmaBudget::hardwareBytes(1920, 1080, 1);
+  EXPECT_FALSE(CmaBudget::plan(depthOne, 1920, 1080, 3).hardwareFits);
+
+  // Without a CmaFree line nothing is limited
+  EXPECT_TRUE(CmaBudget::plan(-1, 1920, 1080, 3).hardwareFits);
+}
+
+// TC-PROJ-008 - Session Recording
+TEST(MediaDumpTest, RecordAndReplayAudio) {
+  const std::string path = ::testing::TempDir() + "session.oamd";
+  const uint8_t pcm[] = {1, 2, 3, 4};
+  const auto mediaChannel =
+      static_cast<uint16_t>(aasdk::messenger::ChannelId::MEDIA_SINK_MEDIA_AUDIO);
+  {
+    MediaDumpWriter writer(path);
+    ASSERT_TRUE(writer.isOpen());
+    writer.append(mediaChannel, 1000, pcm, sizeof(pcm));
+    writer.append(mediaChannel, 2000, pcm, 2);
+    writer.close();
+    EXPECT_EQ(writer.recordCount(), 2u);
+    EXPECT_EQ(writer.droppedCount(), 0u);
+  }
+
+  MediaDumpReader reader(path);
+  ASSERT_TRUE(reader.isOpen());
+  MediaDumpRecord record;
+  ASSERT_TRUE(reader.next(record));
+  EXPECT_EQ(record.channel, mediaChannel);
+  EXPECT_EQ(record.timestamp, 1000u);
+  EXPECT_EQ(record.payload, std::vector<uint8_t>(pcm, pcm + sizeof(pcm)));
+  ASSERT_TRUE(reader.next(record));
+  EXPECT_EQ(record.payload.size(), 2u);
+  EXPECT_FALSE(reader.next(record));
+
+  auto audioOutput = std::make_shared<MockAudioOutput>();
+  EXPECT_CALL(*audioOutput, write(1000, testing::_));
+  EXPECT_CALL(*audioOutput, write(2000, testing::_));
+  MediaDumpReplayer replayer(path);
+  replayer.setAudioOutput(aasdk::messenger::ChannelId::MEDIA_SINK_MEDIA_AUDIO,
+                          audioOutput);
+  EXPECT_EQ(replayer.run(0), 2u);
+}
+
+// TC-PROJ-009 - Audio Jitter Buffer
+TEST(AudioJitterBufferTest, PrebufferUnderrunGapAndOverrun) {
+  // Mono 16-bit at 16 kHz: 10 ms = 160 frames, target 20 ms
+  AudioJitterBuffer buffer(2, 16000, 20);
+  EXPECT_EQ(buffer.targetFrames(), 320u);
+  const std::vector<uint8_t> packet(160 * 2, 0x11);
+  std::vector<uint8_t> out(160 * 2);
+
+  // Silence until the target is queued on top of the period being played
+  ASSERT_TRUE(buffer.push(1000000, packet.data(), packet.size()));
+  ASSERT_TRUE(buffer.push(1010000, packet.data(), packet.size()));
+  buffer.pull(out.data(), 160);
+  EXPECT_EQ(out[0], 0);
+  EXPECT_EQ(buffer.queuedFrames(), 320u);
+  ASSERT_TRUE(buffer.push(1020000, packet.data(), packet.size()));
+  buffer.pull(out.data(), 160);
+  EXPECT_EQ(out[0], 0x11);
+  EXPECT_EQ(buffer.queuedFrames(), 320u);
+
+  // Running dry counts one underrun and goes back to prebuffering
+  buffer.pull(out.data(), 160);
+  buffer.pull(out.data(), 160);
+  buffer.pull(out.data(), 160);
+  EXPECT_EQ(buffer.stats().underruns, 1u);
+  EXPECT_EQ(buffer.queuedFrames(), 0u);
+
+  // A 50 ms jump in the timestamps is filled with at most the target
+  ASSERT_TRUE(buffer.push(1080000, packet.data(), packet.size()));
+  EXPECT_EQ(buffer.stats().gaps, 1u);
+  EXPECT_EQ(buffer.queuedFrames(), 320u + 160u);
+
+  // Beyond the fill limit whole packets are dropped
+  size_t accepted = 0;
+  for (uint64_t ts = 1090000; ts < 2000000; ts += 10000) {
+    accepted += buffer.push(ts, packet.data(), packet.size()) ? 1 : 0;
+  }
+  EXPECT_GT(buffer.stats().overruns, 0u);
+  EXPECT_EQ(buffer.queuedFrames() % 160, 0u);
+  EXPECT_LT(accepted, 90u);
+}
+
+// TC-PROJ-010 - Audio DSP Kernels
+TEST(AudioDspTest, MixGainUpmixAndResample) {
+  // 19 samples: two NEON blocks plus a scalar tail
+  std::vector<int16_t> dst(19, 30000);
+  const std::vector<int16_t> src(19, 10000);
+  mixSaturate(dst.data(), src.data(), dst.size());
+  EXPECT_EQ(dst.front(), 32767);
+  EXPECT_EQ(dst.back(), 32767);
+
+  std::vector<int16_t> samples(19, 20000);
+  applyGainQ15(samples.data(), samples.size(), 1, gainToQ15(0.5f),
+               gainToQ15(0.5f));
+  EXPECT_EQ(samples.front(), 10000);
+  EXPECT_EQ(samples.back(), 10000);
+  applyGainQ15(samples.data(), samples.size(), 1, cUnityGainQ15,
+               cUnityGainQ15);
+  EXPECT_EQ(samples.front(), 10000);
+
+  const std::vector<int16_t> mono = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+  std::vector<int16_t> stereo(mono.size() * 2);
+  upmixMonoToStereo(stereo.data(), mono.data(), mono.size());
+  EXPECT_EQ(stereo[16], 9);
+  EXPECT_EQ(stereo[17], 9);
+
+  // 16 kHz -> 48 kHz keeps a DC level once the filter has filled
+  PolyphaseResampler resampler(3, 1, 512);
+  const std::vector<int16_t> dc(512, 8000);
+  std::vector<int16_t> out(512);
+  size_t consumed = 0;
+  for (int chunk = 0; chunk < 4; chunk++) {
+    const size_t needed = resampler.inputFramesFor(500);
+    consumed += needed;
+    resampler.process(dc.data(), out.data(), 500);
+  }
+  EXPECT_EQ(consumed, 667u); // 2000 / 3, rounded up at the first phase
+  EXPECT_NEAR(out[499], 8000, 80);
+}
+
+// TC-PROJ-011 - Ring Buffer Spans
+TEST(LockFreeRingBufferTest, ContiguousSpansAcrossWrap) {
+  LockFreeRingBuffer<16> ring;
+  const uint8_t bytes[12] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  uint8_t scratch[12];
+  ASSERT_EQ(ring.write(bytes, 12), 12u);
+  ASSERT_EQ(ring.read(scratch, 10), 10u);
+
+  // Free space wraps: 4 bytes up to the end of the ring come first
+  auto write = ring.reserveWrite();
+  ASSERT_EQ(write.size, 4u);
+  memcpy(write.data, bytes, 4);
+  ring.commitWrite(4);
+  write = ring.reserveWrite();
+  EXPECT_EQ(write.size, 9u); // one slot always stays empty
+  write.data[0] = 42;
+  ring.commitWrite(1);
+
+  auto read = ring.peekContiguous();
+  ASSERT_EQ(read.size, 6u);
+  EXPECT_EQ(read.data[0], 11);
+  EXPECT_EQ(read.data[5], 4);
+  ring.commitRead(6);
+  read = ring.peekContiguous();
+  ASSERT_EQ(read.size, 1u);
+  EXPECT_EQ(read.data[0], 42);
+  ring.commitRead(1);
+  EXPECT_EQ(ring.available(), 0u);
+}
+
+// TC-PROJ-012 - Voice Processing
+namespace {
+double frameEnergy(const std::vector<int16_t> &samples) {
+  double energy = 0.0;
+  for (int16_t sample : samples) {
+    energy += static_cast<double>(sample) * sample;
+  }
+  return energy / samples.size();
+}
+} // namespace
+
+TEST(VoiceProcessorTest, CancelsEchoAndSuppressesSteadyNoise) {
+  VoiceProcessor processor(16000, VoiceProcessingMode::LowCpu);
+  const size_t frame = processor.frameSamples();
+  ASSERT_EQ(frame, 160u);
+
+  // Echo path: half the far end, 12.5 ms late
+  constexpr size_t cDelay = 200;
+  uint32_t seed = 1;
+  auto noise = [&seed](int amplitude) {
+    seed = seed * 1664525u + 1013904223u;
+    return static_cast<int16_t>(static_cast<int32_t>((seed >> 16) % (2 * amplitude)) - amplitude);
+  };
+  std::vector<int16_t> far(cDelay, 0);
+  std::vector<int16_t> mic(frame), out(frame);
+  double micEnergy = 0.0;
+  double outEnergy = 0.0;
+  for (int n = 0; n < 400; n++) {
+    std::vector<int16_t> reference(frame);
+    for (size_t i = 0; i < frame; i++) {
+      reference[i] = noise(8000);
+      far.push_back(reference[i]);
+      mic[i] = far[far.size() - 1 - cDelay] / 2;
+    }
+    processor.process(mic.data(), reference.data(), out.data());
+    if (n >= 350) {
+      micEnergy += frameEnergy(mic);
+      outEnergy += frameEnergy(out);
+    }
+  }
+  EXPECT_LT(outEnergy, micEnergy / 100); // better than 20 dB
+
+  // Double talk: a near-end tone on top of the echo survives
+  double toneEnergy = 0.0;
+  outEnergy = 0.0;
+  for (int n = 0; n < 50; n++) {
+    std::vector<int16_t> reference(frame), tone(frame);
+    for (size_t i = 0; i < frame; i++) {
+      reference[i] = noise(8000);
+      far.push_back(reference[i]);
+      tone[i] = static_cast<int16_t>(
+          6000 * std::sin(2 * M_PI * 440 * (n * frame + i) / 16000.0));
+      mic[i] = far[far.size() - 1 - cDelay] / 2 + tone[i];
+    }
+    processor.process(mic.data(), reference.data(), out.data());
+    if (n >= 10) {
+      toneEnergy += frameEnergy(tone);
+      outEnergy += frameEnergy(out);
+    }
+  }
+  
+  EXPECT_GT(outEnergy, toneEnergy / 2);
+  EXPECT_LT(outEnergy, toneEnergy * 2);
+
+  // No far end: steady noise settles near the suppression limit
+  processor.reset();
+  for (int n = 0; n < 200; n++) {
+    for (auto &sample : mic) {
+      sample = noise(500);
+    }
+    processor.process(mic.data(), nullptr, out.data());
+    if (n == 199) {
+      micEnergy = frameEnergy(mic);
+      outEnergy = frameEnergy(out);
+    }
+  }
+  EXPECT_LT(outEnergy, micEnergy / 10);
+}
+
+// TC-PROJ-013 - Thread Topology
+TEST(ThreadTopologyTest, CoreCountDefaultsAndCpuLists) {
+  std::vector<int> cpus;
+  EXPECT_TRUE(ThreadTopology::parseCpuList("0,2-3", 4, cpus));
+  EXPECT_EQ(cpus, (std::vector<int>{0, 2, 3}));
+  EXPECT_TRUE(ThreadTopology::parseCpuList("none", 4, cpus));
+  EXPECT_TRUE(cpus.empty());
+  EXPECT_FALSE(ThreadTopology::parseCpuList("4", 4, cpus));
+  EXPECT_FALSE(ThreadTopology::parseCpuList("3-1", 4, cpus));
+  EXPECT_FALSE(ThreadTopology::parseCpuList("x", 4, cpus));
+
+  // Four cores: decode on 3, audio on 2, pools on 0-1
+  const ThreadTopology quad(ThreadTopologySettings(), 4);
+  EXPECT_EQ(quad.ioWorkers(), 4u);
+  EXPECT_EQ(quad.placement(ThreadRole::VideoDecode).cpus, (std::vector<int>{3}));
+  EXPECT_EQ(quad.placement(ThreadRole::AudioOutput).cpus, (std::vector<int>{2}));
+  EXPECT_EQ(quad.placement(ThreadRole::IoService).cpus, (std::vector<int>{0, 1}));
+  EXPECT_GT(quad.placement(ThreadRole::AudioOutput).fifoPriority,
+            quad.placement(ThreadRole::VideoDecode).fifoPriority);
+  EXPECT_GT(quad.placement(ThreadRole::VideoDecode).fifoPriority,
+            quad.placement(ThreadRole::MediaLane).fifoPriority);
+  EXPECT_GT(quad.placement(ThreadRole::MediaLane).fifoPriority, 0);
+  EXPECT_EQ(quad.placement(ThreadRole::Background).cpus, (std::vector<int>{0, 1}));
+  EXPECT_EQ(quad.placement(ThreadRole::Background).fifoPriority, 0);
+  EXPECT_TRUE(quad.placement(ThreadRole::Background).idle);
+  EXPECT_FALSE(quad.placement(ThreadRole::IoService).idle);
+
+  // A single core pins nothing
+  const ThreadTopology single(ThreadTopologySettings(), 1);
+  EXPECT_EQ(single.ioWorkers(), 2u);
+  EXPECT_TRUE(single.placement(ThreadRole::VideoDecode).cpus.empty());
+
+  // Explicit settings win; invalid lists fall back to the default
+  ThreadTopologySettings settings;
+  settings.ioWorkers = 2;
+  settings.audioCpus = "none";
+  settings.videoCpus = "7";
+  settings.videoPriority = 0;
+  const ThreadTopology custom(settings, 4);
+  EXPECT_EQ(custom.ioWorkers(), 2u);
+  EXPECT_TRUE(custom.placement(ThreadRole::AudioInput).cpus.empty());
+  EXPECT_EQ(custom.placement(ThreadRole::VideoPresent).cpus, (std::vector<int>{3}));
+  EXPECT_EQ(custom.placement(ThreadRole::VideoDecode).fifoPriority, 0);
+  EXPECT_EQ(custom.placement(ThreadRole::MediaLane).fifoPriority, 0);
+}
+
+// TC-PROJ-014 - Direct Touch Slots
+TEST(EvdevTouchDecoderTest, SlotsBecomeDownMoveAndUpEvents) {
+  using aap_protobuf::service::inputsource::message::PointerAction;
+  std::vector<TouchEvent> events;
+  // Raw panel at twice the display resolution, the UI letterboxed on it
+  const ProjectionGeometry boxed(QSize(1280, 720), QSize(0, 120), QSize(1024, 600));
+  EvdevTouchDecoder decoder({0, 2048, 0, 1200}, boxed, true, true,
+                            [&events](const TouchEvent &event) { events.push_back(event); });
+  const auto feed = [&decoder](uint16_t type, uint16_t code, int32_t value) {
+    input_event event{};
+    event.type = type;
+    event.code = code;
+    event.value = value;
+    event.time.tv_sec = 12;
+    event.time.tv_usec = 345;
+    decoder.feed(event);
+  };
+
+  feed(EV_ABS, ABS_MT_SLOT, 0);
+  feed(EV_ABS, ABS_MT_TRACKING_ID, 40);
+  feed(EV_ABS, ABS_MT_POSITION_X, 1024);
+  feed(EV_ABS, ABS_MT_POSITION_Y, 600);
+  feed(EV_SYN, SYN_REPORT, 0);
+  ASSERT_EQ(events.size(), 1u);
+  EXPECT_EQ(events[0].type, PointerAction::ACTION_DOWN);
+  EXPECT_EQ(events[0].pointers[0].x, 640u);
+  EXPECT_EQ(events[0].pointers[0].y, 360u);
+  // Stamped with the kernel's time of the frame, not of decoding
+  EXPECT_EQ(events[0].timestamp.count(), 12000345);
+
+  // One frame: the first finger moves and a second lands
+  feed(EV_ABS, ABS_MT_POSITION_X, 1100);
+  feed(EV_ABS, ABS_MT_SLOT, 1);
+  feed(EV_ABS, ABS_MT_TRACKING_ID, 41);
+  feed(EV_ABS, ABS_MT_POSITION_X, 200);
+  feed(EV_ABS, ABS_MT_POSITION_Y, 600);
+  feed(EV_SYN, SYN_REPORT, 0);
+  ASSERT_EQ(events.size(), 3u);
+  EXPECT_EQ(events[1].type, PointerAction::ACTION_MOVED);
+  EXPECT_EQ(events[1].pointers.size(), 1u);
+  EXPECT_EQ(events[2].type, PointerAction::ACTION_POINTER_DOWN);
+  EXPECT_EQ(events[2].actionIndex, 1u);
+  EXPECT_EQ(events[2].pointers[1].pointerId, 1u);
+
+  // Lifting the first finger reports it one last time
+  feed(EV_ABS, ABS_MT_SLOT, 0);
+  feed(EV_ABS, ABS_MT_TRACKING_ID, -1);
+  feed(EV_SYN, SYN_REPORT, 0);
+  ASSERT_EQ(events.size(), 4u);
+  EXPECT_EQ(events[3].type, PointerAction::ACTION_POINTER_UP);
+  EXPECT_EQ(events[3].actionIndex, 0u);
+  EXPECT_EQ(events[3].pointers.size(), 2u);
+
+  // Dropped events lift whatever is left
+  feed(EV_SYN, SYN_DROPPED, 0);
+  feed(EV_ABS, ABS_MT_POSITION_X, 10);
+  feed(EV_SYN, SYN_REPORT, 0);
+  ASSERT_EQ(events.size(), 5u);
+  EXPECT_EQ(events[4].type, PointerAction::ACTION_UP);
+  EXPECT_EQ(events[4].pointers[0].pointerId, 1u);
+}
+
+// TC-PROJ-015 - Evdev Keys and Rotary
+TEST(EvdevKeyDecoderTest, KeyMapAndDetentAggregation) {
+  using aap_protobuf::service::media::sink::message::KeyCode;
+  auto keyMap = EvdevKeyDecoder::defaultKeyMap();
+  EXPECT_TRUE(EvdevKeyDecoder::parseKeyMap("KEY_VOLUMEUP=KEYCODE_MEDIA_NEXT, 0x101=3", keyMap));
+  EXPECT_EQ(keyMap[KEY_VOLUMEUP], KeyCode::KEYCODE_MEDIA_NEXT);
+  EXPECT_EQ(keyMap[0x101], KeyCode::KEYCODE_HOME);
+  EXPECT_FALSE(EvdevKeyDecoder::parseKeyMap("KEY_VOLUMEUP", keyMap));
+
+  std::vector<ButtonEvent> events;
+  EvdevKeyDecoder decoder(keyMap, {KeyCode::KEYCODE_MEDIA_NEXT, KeyCode::KEYCODE_ROTARY_CONTROLLER}, 3,
+                          [&events](const ButtonEvent &event) { events.push_back(event); });
+  const auto feed = [&decoder](uint16_t type, uint16_t code, int32_t value, int64_t us) {
+    input_event event{};
+    event.type = type;
+    event.code = code;
+    event.value = value;
+    decoder.feed(event, InputTimestamp(us));
+  };
+
+  // Mapped and announced keys pass, autorepeat and unannounced keys do not
+  feed(EV_KEY, KEY_VOLUMEUP, 1, 1000000);
+  feed(EV_KEY, KEY_VOLUMEUP, 2, 1000100);
+  feed(EV_KEY, KEY_VOLUMEUP, 0, 1000200);
+  feed(EV_KEY, KEY_HOME, 1, 1000300);
+  ASSERT_EQ(events.size(), 2u);
+  EXPECT_EQ(events[0].type, ButtonEventType::PRESS);
+  EXPECT_EQ(events[1].type, ButtonEventType::RELEASE);
+
+  // The first detent goes out at once, a fast spin as one accelerated report
+  events.clear();
+  for (int i = 0; i < 5; ++i) {
+    feed(EV_REL, REL_DIAL, 1, 2000000 + i * 5000);
+    feed(EV_SYN, SYN_REPORT, 0, 2000000 + i * 5000);
+  }
+  ASSERT_EQ(events.size(), 1u);
+  EXPECT_EQ(events[0].wheelSteps, 1u);
+  EXPECT_EQ(decoder.nextFlush(), InputTimestamp(2000000) + EvdevKeyDecoder::cRotaryWindow);
+  decoder.flush(decoder.nextFlush());
+  ASSERT_EQ(events.size(), 2u);
+  EXPECT_EQ(events[1].wheelDirection, WheelDirection::RIGHT);
+  EXPECT_EQ(events[1].wheelSteps, 8u);
+  EXPECT_EQ(events[1].timestamp.count(), 2020000);
+}
+
+// TC-PROJ-016 - Metrics Registry
+TEST(MetricsTest, HistogramBucketsAndPrometheusText) {
+  auto &metrics = Metrics::instance();
+  auto &counter = metrics.counter("test_events_total", "Events");
+  counter.add(2);
+  EXPECT_EQ(&metrics.counter("test_events_total", "Events"), &counter);
+  EXPECT_THROW(metrics.gauge("test_events_total", "Events"), std::logic_error);
+
+  auto &histogram = metrics.histogram("test_latency_ms", "Latency", {10, 1, 5});
+  for (double value : {0.5, 1.0, 3.0, 7.0, 20.0}) {
+    histogram.observe(value);
+  }
+  EXPECT_EQ(histogram.counts(), (std::vector<uint64_t>{2, 1, 1, 1}));
+  EXPECT_DOUBLE_EQ(histogram.sum(), 31.5);
+  EXPECT_DOUBLE_EQ(histogram.quantile(0.5), 5.0);
+
+  // Buckets are cumulative in the exposition format
+  const std::string text = metrics.prometheusText();
+  EXPECT_NE(text.find("# TYPE test_events_total counter\ntest_events_total 2\n"), std::string::npos);
+  EXPECT_NE(text.find("test_latency_ms_bucket{le=\"5\"} 3\n"), std::string::npos);
+  EXPECT_NE(text.find("test_latency_ms_bucket{le=\"+Inf\"} 5\n"), std::string::npos);
+  EXPECT_NE(text.find("test_latency_ms_count 5\n"), std::string::npos);
+}
+
+
+// TC-PROJ-017 - Synthetic H.264 Probe Stream
+TEST(H264TestStreamTest, ParameterSetsThenIdrThenSkipFrames) {
+  const H264TestStream stream(1920, 1080, 5);
+  ASSERT_EQ(stream.units().size(), 6u);
+  EXPECT_EQ(stream.pictureCount(), 5u);
+
+  // NAL unit types and payloads of one unit, emulation prevention undone
+  const auto split = [](const aasdk::common::Data &unit) {
+    std::vector<std::pair<int, std::vector<uint8_t>>> nals;
+    for (size_t i = 0; i + 4 < unit.size();) {
+      EXPECT_TRUE(unit[i] == 0 && unit[i + 1] == 0 && unit[i + 2] == 0 && unit[i + 3] == 1);
+      size_t end = i + 4;
+      while (end + 3 < unit.size() && !(unit[end] == 0 && unit[end + 1] == 0 && unit[end + 2] == 0 && unit[end + 3] == 1)) {
+        end++;
+      }
+      end = end + 3 < unit.size() ? end : unit.size();
+      std::vector<uint8_t> rbsp;
+      int zeros = 0;
+      for (size_t j = i + 5; j < end; j++) {
+        EXPECT_FALSE(zeros == 2 && unit[j] < 3) << "start code emulated at byte " << j;
+        if (zeros == 2 && unit[j] == 3) {
+          zeros = 0;
+          continue;
+        }
+        rbsp.push_back(unit[j]);
+        zeros = unit[j] == 0 ? zeros + 1 : 0;
+      }
+      nals.emplace_back(unit[i + 4] & 0x1f, rbsp);
+      i = end;
+    }
+    return nals;
+  };
+
+  const auto config = split(stream.units()[0]);
+  ASSERT_EQ(config.size(), 2u);
+  EXPECT_EQ(config[0].first, 7);
+  EXPECT_EQ(config[1].first, 8);
+  const auto idr = split(stream.units()[1]);
+  ASSERT_EQ(idr.size(), 1u);
+  EXPECT_EQ(idr[0].first, 5);
+  // 120x68 I_PCM macroblocks of 384 bytes each
+  EXPECT_GT(idr[0].second.size(), 120u * 68u * 384u);
+  for (size_t unit = 2; unit < stream.units().size(); unit++) {
+    const auto skip = split(stream.units()[unit]);
+    ASSERT_EQ(skip.size(), 1u);
+    EXPECT_EQ(skip[0].first, 1);
+    EXPECT_LT(skip[0].second.size(), 16u);
+  }
+
+  // The SPS codes 1080p as 1088 lines cropped by 8
+  const std::vector<uint8_t> &sps = config[0].second;
+  size_t bit = 24;
+  const auto u = [&sps, &bit](int count) {
+    uint32_t value = 0;
+    for (int i = 0; i < count; i++, bit++) {
+      value = (value << 1) | ((sps[bit / 8] >> (7 - bit % 8)) & 1);
+    }
+    return value;
+  };
+  const auto ue = [&u]() {
+    int zeros = 0;
+    while (u(1) == 0) {
+      zeros++;
+    }
+    return (1u << zeros) - 1 + u(zeros);
+  };
+  EXPECT_EQ(sps[0], 66);
+  ue();
+  ue();
+  EXPECT_EQ(ue(), 2u);
+  ue();
+  u(1);
+  EXPECT_EQ(ue() + 1, 120u);
+  EXPECT_EQ(ue() + 1, 68u);
+  u(2);
+  ASSERT_EQ(u(1), 1u);
+  EXPECT_EQ(ue(), 0u);
+  EXPECT_EQ(ue(), 0u);
+  EXPECT_EQ(ue(), 0u);
+  EXPECT_EQ(ue(), 4u);
+}
+
+// TC-PROJ-018 - Video Backend Choice
+TEST_F(ProjectionTest, StoredVideoBackendMustBeCompiledIn) {
+  VideoBackend backend;
+  EXPECT_TRUE(VideoBackendProbe::parse("gstreamer", backend));
+  EXPECT_EQ(backend, VideoBackend::GStreamer);
+  EXPECT_FALSE(VideoBackendProbe::parse("vaapi", backend));
+  EXPECT_EQ(VideoBackendProbe::compiledBackends().back(), VideoBackend::Qt);
+
+  // Qt is always built; an unknown name falls back to the top priority
+  EXPECT_CALL(*mockConfiguration, getVideoBackend()).WillOnce(Return("qt")).WillOnce(Return("vaapi"));
+  EXPECT_EQ(VideoBackendProbe::configured(*mockConfiguration), VideoBackend::Qt);
+  EXPECT_EQ(VideoBackendProbe::configured(*mockConfiguration), VideoBackendProbe::compiledBackends().front());
+}
+
+// TC-PROJ-019 - H.264 Header Parsing
+TEST_F(ProjectionTest, HeaderParserMustReadWhatTheRequestDecoderNeeds) {
+  const H264TestStream stream(1920, 1080, 3);
+  H264HeaderParser parser;
+  std::vector<H264SliceHeader> slices;
+  for (const auto &unit : stream.units()) {
+    for (const auto &nal : H264HeaderParser::splitAnnexB(unit.data(), unit.size())) {
+      if (nal.type == H264HeaderParser::cNalSps) {
+        EXPECT_TRUE(parser.parseSps(nal));
+      } else if (nal.type == H264HeaderParser::cNalPps) {
+        EXPECT_TRUE(parser.parsePps(nal));
+      } else {
+        H264SliceHeader slice;
+        ASSERT_TRUE(parser.parseSliceHeader(nal, slice));
+        slices.push_back(slice);
+      }
+    }
+  }
+
+  // 1080 lines are coded as 68 macroblock rows and cropped back
+  const H264Sps *sps = parser.sps(0);
+  ASSERT_NE(sps, nullptr);
+  EXPECT_EQ(sps->width(), 1920u);
+  EXPECT_EQ(sps->height(), 1080u);
+  EXPECT_EQ(sps->codedHeight(), 1088u);
+  EXPECT_EQ(sps->picOrderCntType, 2u);
+  EXPECT_EQ(sps->maxNumRefFrames, 1u);
+  EXPECT_EQ(sps->scalingList4x4[0][0], 16);
+
+  ASSERT_EQ(slices.size(), 3u);
+  EXPECT_TRUE(slices[0].idr());
+  EXPECT_EQ(slices[0].sliceType, H264SliceHeader::cSliceI);
+  for (size_t i = 1; i < slices.size(); i++) {
+    EXPECT_FALSE(slices[i].idr());
+    EXPECT_EQ(slices[i].sliceType, H264SliceHeader::cSliceP);
+    EXPECT_EQ(slices[i].frameNum, i);
+    // adaptive_ref_pic_marking_mode_flag only
+    EXPECT_EQ(slices[i].decRefPicMarkingBitSize, 1u);
+  }
+
+  VideoBackend backend;
+  EXPECT_TRUE(VideoBackendProbe::parse("v4l2-request", backend));
+  EXPECT_EQ(backend, VideoBackend::V4l2Request);
+}
+
+// TC-PROJ-020 - Memory Footprint
+TEST(MemoryFootprintTest, RuntimeRingsRoundUpAndProcListingsParse) {
+  // 100 bytes asked, 128 allocated as the next power of two
+  RuntimeRingBuffer ring(100);
+  EXPECT_EQ(ring.capacity(), 127u);
+  EXPECT_EQ(ring.memoryBytes(), 128u);
+
+  std::vector<uint8_t> bytes(100);
+  for (size_t i = 0; i < bytes.size(); i++) {
+    bytes[i] = static_cast<uint8_t>(i);
+  }
+  std::vector<uint8_t> scratch(100);
+  ASSERT_EQ(ring.write(bytes.data(), 100), 100u);
+  ASSERT_EQ(ring.read(scratch.data(), 90), 90u);
+  ASSERT_EQ(ring.write(bytes.data(), 100), 100u); // wraps past the end
+  EXPECT_EQ(ring.available(), 110u);
+  ASSERT_EQ(ring.read(scratch.data(), 10), 10u);
+  EXPECT_EQ(scratch[0], 90);
+  ASSERT_EQ(ring.read(scratch.data(), 100), 100u);
+  EXPECT_EQ(scratch.front(), 0);
+  EXPECT_EQ(scratch.back(), 99);
+
+  std::istringstream meminfo("MemFree:          123456 kB\n"
+                             "MemTotal:         999424 kB\n");
+  EXPECT_EQ(MemoryFootprint::parseMemTotal(meminfo), 999424LL * 1024);
+  EXPECT_LE(999424LL * 1024, MemoryFootprint::cLowMemoryTotalBytes);
+  std::istringstream empty("");
+  EXPECT_EQ(MemoryFootprint::parseMemTotal(empty), -1);
+
+  std::istringstream status("Name:\tautoapp\n"
+                            "VmRSS:\t   81234 kB\n"
+                            "RssAnon:\t   40960 kB\n"
+                            "RssFile:\t   40274 kB\n");
+  const ProcessMemory memory = MemoryFootprint::parseStatus(status);
+  EXPECT_EQ(memory.residentBytes, 81234LL * 1024);
+  EXPECT_EQ(memory.anonymousBytes, 40960LL * 1024);
+
+  // Charges come back when their owner goes
+  const int64_t before = MemoryFootprint::instance().allocatedBytes(MemoryPool::Audio);
+  {
+    MemoryCharge charge(MemoryPool::Audio, 4096);
+    EXPECT_EQ(MemoryFootprint::instance().allocatedBytes(MemoryPool::Audio), before + 4096);
+  }
+  EXPECT_EQ(MemoryFootprint::instance().allocatedBytes(MemoryPool::Audio), before);
+}
+
+// TC-PROJ-021 - Touch Latency Probe
+TEST(TouchLatencyProbeTest, OptionsLumaAndTapToPhoton) {
+  TouchLatencyProbe::Options options;
+  ASSERT_TRUE(TouchLatencyProbe::parseOptions("640,360", options));
+  EXPECT_EQ(options.position.x(), 640);
+  EXPECT_EQ(options.position.y(), 360);
+  EXPECT_EQ(options.intervalMs, 2000);
+  ASSERT_TRUE(TouchLatencyProbe::parseOptions("10,20,750", options));
+  EXPECT_EQ(options.intervalMs, 750);
+  EXPECT_FALSE(TouchLatencyProbe::parseOptions("640", options));
+  EXPECT_FALSE(TouchLatencyProbe::parseOptions("a,b", options));
+  EXPECT_FALSE(TouchLatencyProbe::parseOptions("1,2,100", options)); // taps too close together
+  EXPECT_FALSE(TouchLatencyProbe::parseOptions("1,2,3000,4", options));
+
+  // Left half black, right half white; every other pixel is sampled
+  std::vector<uint8_t> plane(16 * 4, 0);
+  for (int y = 0; y < 4; y++) {
+    std::fill(plane.begin() + y * 16 + 4, plane.begin() + y * 16 + 8, 255);
+  }
+  EXPECT_EQ(TouchLatencyProbe::meanLuma(plane.data(), 16, QRect(0, 0, 4, 4)), 0);
+  EXPECT_EQ(TouchLatencyProbe::meanLuma(plane.data(), 16, QRect(4, 0, 4, 4)), 255);
+  EXPECT_EQ(TouchLatencyProbe::meanLuma(plane.data(), 16, QRect(2, 0, 4, 4)), 127);
+
+  TouchLatencyProbe probe;
+  VideoFrameTiming frame;
+  frame.arrivalUs = 1000;
+  frame.flipUs = 2000;
+  frame.probeLuma = 16;
+  probe.frameShown(frame);
+
+  // The first frame that changes enough after the tap is its reaction
+  probe.tapped(10000);
+  frame.flipUs = 30000;
+  frame.probeLuma = 20;
+  probe.frameShown(frame);
+  frame.flipUs = 95000;
+  frame.probeLuma = 235;
+  probe.frameShown(frame);
+  EXPECT_EQ(probe.touchToPhoton().samples, 1u);
+  EXPECT_EQ(probe.touchToPhoton().p50Us, 85000);
+
+  // A change no tap explains is a test pattern flash
+  frame.arrivalUs = 3000000;
+  frame.flipUs = 3020000;
+  frame.probeLuma = 16;
+  probe.frameShown(frame);
+  EXPECT_EQ(probe.arrivalToPhoton().samples, 1u);
+  EXPECT_EQ(probe.arrivalToPhoton().p50Us, 20000);
+
+  // An unanswered tap is counted once its reaction window has passed
+  probe.tapped(4000000);
+  frame.arrivalUs = 5100000;
+  frame.flipUs = 5200000;
+  probe.frameShown(frame);
+  EXPECT_EQ(probe.missedTaps(), 1u);
+  EXPECT_EQ(probe.touchToPhoton().samples, 1u);
+}
+
+
+// TC-PROJ-022 - Rear Camera Guidelines
+TEST(RearCameraTest, GuidelinesConvergeAndChangeColour) {
+  // Padded rows, as a dumb buffer pitch would be
+  const uint32_t width = 320, height = 240, pitch = 336;
+  std::vector<uint32_t> image(pitch * height, 0x12345678);
+  RearCamera::drawGuidelines(image.data(), pitch, width, height);
+  auto at = [&image, pitch](uint32_t x, uint32_t y) { return image[y * pitch + x]; };
+
+  // Everything but the lines is transparent, the centre and the sky too
+  EXPECT_EQ(at(160, 120), 0u);
+  EXPECT_EQ(at(160, 239), 0u);
+  EXPECT_EQ(at(10, 20), 0u);
+  EXPECT_EQ(at(330, 100), 0x12345678u); // padding is left alone
+
+  // Red at the bumper, green towards the horizon, and closer together there
+  EXPECT_EQ(at(64, 239), 0xffe53935u);
+  EXPECT_EQ(at(255, 239), 0xffe53935u);
+  EXPECT_EQ(at(115, 110), 0xff43a047u);
+  EXPECT_EQ(at(64, 110), 0u);
+  EXPECT_EQ(at(0, 60), 0u);
+}
+
+
+// TC-PROJ-023 - Dashcam Segment Ring
+TEST(DashcamSegmentsTest, OldestBySequenceMakeRoom) {
+  uint64_t sequence = 0;
+  EXPECT_TRUE(DashcamSegments::parseName("dashcam-000042-20261014-101500.mp4", sequence));
+  EXPECT_EQ(sequence, 42u);
+  EXPECT_FALSE(DashcamSegments::parseName("dashcam--20261014.mp4", sequence));
+  EXPECT_FALSE(DashcamSegments::parseName("dashcam-12-a.mkv", sequence));
+  EXPECT_FALSE(DashcamSegments::parseName("notes.txt", sequence));
+
+  char base[] = "/tmp/dashcam-test-XXXXXX";
+  ASSERT_NE(mkdtemp(base), nullptr);
+  const std::string directory(base);
+  const std::vector<char> block(8192, 1);
+  // 10 sorts before 9 as text: the sequence number decides
+  for (const char *name : {"dashcam-10-19700101-000010.mp4", "dashcam-9-20261014-101500.mp4",
+                           "dashcam-11-19700101-000100.mp4", "notes.txt"}) {
+    std::ofstream(directory + "/" + name).write(block.data(), block.size());
+  }
+
+  DashcamSegments segments(directory, 3 * 8192);
+  ASSERT_TRUE(segments.prepare());
+  auto listed = segments.list();
+  ASSERT_EQ(listed.size(), 3u);
+  EXPECT_EQ(listed.front().sequence, 9u);
+  EXPECT_EQ(listed.back().sequence, 11u);
+  EXPECT_EQ(segments.nextPath(0).rfind(directory + "/dashcam-000012-", 0), 0u);
+
+  // Room for one more segment: the oldest goes
+  const uint64_t blockBytes = listed.front().bytes;
+  ASSERT_GE(blockBytes, 8192u);
+  DashcamSegments tight(directory, 3 * blockBytes);
+  EXPECT_EQ(tight.makeRoom(blockBytes), blockBytes);
+  listed = tight.list();
+  ASSERT_EQ(listed.size(), 2u);
+  EXPECT_EQ(listed.front().sequence, 10u);
+
+  // The segment being written is never deleted, even when oldest
+  EXPECT_EQ(tight.makeRoom(2 * blockBytes, listed.front().path), blockBytes);
+  listed = tight.list();
+  ASSERT_EQ(listed.size(), 1u);
+  EXPECT_EQ(listed.front().sequence, 10u);
+
+  std::remove((directory + "/notes.txt").c_str());
+  std::remove(listed.front().path.c_str());
+  rmdir(directory.c_str());
+}
+
+// TC-PROJ-024 - Cluster Panel Rendering
+TEST(ClusterDisplayTest, DrawsManoeuvreAndDistance) {
+  NavigationState state;
+  EXPECT_EQ(ClusterAtlas::iconFor(state), ClusterAtlas::Icon::None);
+  state.status = NavigationState::Status::Active;
+  state.maneuver = NavigationState::Maneuver::Turn;
+  state.side = NavigationState::Side::Right;
+  EXPECT_EQ(ClusterAtlas::iconFor(state), ClusterAtlas::Icon::Right);
+  state.maneuver = NavigationState::Maneuver::RoundaboutEnter;
+  state.side = NavigationState::Side::Left;
+  EXPECT_EQ(ClusterAtlas::iconFor(state), ClusterAtlas::Icon::RoundaboutLeft);
+
+  const uint32_t width = 300, height = 100, pitch = 320;
+  const ClusterAtlas atlas(width, height);
+  EXPECT_EQ(atlas.iconSize(), 80u);
+  EXPECT_EQ(atlas.glyph('x'), nullptr);
+  EXPECT_GT(atlas.textWidth("12.5"), atlas.textWidth("12"));
+
+  // Not navigating: only the translucent panel, padding left alone
+  std::vector<uint32_t> image(pitch * height, 0x12345678);
+  auto at = [&image, pitch](uint32_t x, uint32_t y) { return image[y * pitch + x]; };
+  ClusterDisplay::render(atlas, NavigationState(), image.data(), pitch, width, height, false);
+  EXPECT_EQ(at(0, 0), 0xb0000000u);
+  EXPECT_EQ(at(150, 50), 0xb0000000u);
+  EXPECT_EQ(at(310, 50), 0x12345678u);
+
+  // Turn left in 250 m: the arrow's bar crosses the icon, the text follows it
+  state.maneuver = NavigationState::Maneuver::Turn;
+  state.distanceMeters = 250;
+  ClusterDisplay::render(atlas, state, image.data(), pitch, width, height, true);
+  EXPECT_EQ(at(42, 44), 0xffffffffu);
+  EXPECT_EQ(at(34, 74), 0xff000000u);
+  int textPixels = 0;
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      if (at(x, y) != 0xff000000u) {
+        // Opaque stays opaque under the anti-aliased edges
+        EXPECT_EQ(at(x, y) >> 24, 0xffu);
+        textPixels += x >= 100 ? 1 : 0;
+      }
+    }
+  }
+  EXPECT_GT(textPixels, 500);
+  EXPECT_EQ(at(299, 50), 0xff000000u);
+  EXPECT_EQ(at(310, 50), 0x12345678u);
+}
+
+// TC-PROJ-025 - Warm Audio Stream Gate
+class GatedAudioOutput : public RtAudioOutput {
+public:
+  using RtAudioOutput::RtAudioOutput;
+  using RtAudioOutput::render;
+};
+
+TEST(RtAudioOutputTest, KeptRunningStreamPlaysOutTailWhenSuspended) {
+  // Mono 16 kHz, 20 ms target: a prompt's last 100 frames never reach it
+  GatedAudioOutput output(1, 16, 16000, 0, false, 20);
+  output.setKeepRunning(true);
+  const std::vector<uint8_t> tail(100 * 2, 0x11);
+  std::vector<uint8_t> period(160 * 2, 0xff);
+
+  output.start();
+  output.write(1000000, aasdk::common::DataConstBuffer(tail.data(), tail.size()));
+  output.render(period.data(), 160);
+  EXPECT_EQ(period[0], 0);
+  EXPECT_EQ(output.getQueuedFrames(), 100u);
+
+  // The stream ended: the tail plays at once, then silence, no underrun
+  output.suspend();
+  output.render(period.data(), 160);
+  EXPECT_EQ(period[0], 0x11);
+  EXPECT_EQ(period[199], 0x11);
+  EXPECT_EQ(period[200], 0);
+  output.render(period.data(), 160);
+  EXPECT_EQ(period[0], 0);
+  EXPECT_EQ(output.getJitterStats().underruns, 0u);
+
+  // The next prompt prebuffers as usual
+  output.start();
+  const std::vector<uint8_t> packet(160 * 2, 0x22);
+  for (int i = 0; i < 3; i++) {
+    output.write(1100000 + i * 10000, aasdk::common::DataConstBuffer(packet.data(), packet.size()));
+  }
+  output.render(period.data(), 160);
+  EXPECT_EQ(period[0], 0x22);
+}
+
+// TC-PROJ-026 - Duplex Call Audio
+class LoopbackDuplexStream : public DuplexAudioStream {
+public:
+  LoopbackDuplexStream() : DuplexAudioStream(0, 0, 20) {}
+
+protected:
+  bool openStream() override { return true; }
+  void closeStream() override {}
+};
+
+TEST(DuplexAudioStreamTest, PlaysCallCapturesMicrophoneAndTapsEcho) {
+  boost::asio::io_service ioService;
+  auto stream = std::make_shared<LoopbackDuplexStream>();
+  auto reference = stream->getEchoReference();
+  reference->attach();
+
+  auto call = stream->createOutput();
+  ASSERT_TRUE(call->open());
+  call->start();
+  const std::vector<int16_t> packet(160, 1234);
+  for (uint64_t ts = 1000000; ts < 1030000; ts += 10000) {
+    call->write(ts, aasdk::common::DataConstBuffer(packet.data(), packet.size() * sizeof(int16_t)));
+  }
+
+  auto microphone = stream->createInput(ioService, nullptr);
+  bool started = false;
+  auto startPromise = IAudioInput::StartPromise::defer(ioService);
+  startPromise->then([&started]() { started = true; }, [](void) {});
+  microphone->start(std::move(startPromise));
+  ioService.poll();
+  ioService.restart();
+  ASSERT_TRUE(started);
+
+  // One callback plays the call, taps it for the canceller and captures
+  std::vector<int16_t> speaker(160);
+  const std::vector<int16_t> mic(160, 77);
+  stream->process(speaker.data(), mic.data(), 160, false);
+  EXPECT_EQ(speaker[0], 1234);
+  EXPECT_EQ(reference->ring().available(), 160u);
+
+  // Seven 10 ms periods fill one microphone chunk
+  for (int i = 0; i < 6; i++) {
+    stream->process(speaker.data(), mic.data(), 160, false);
+  }
+  aasdk::common::Data chunk;
+  auto readPromise = IAudioInput::ReadPromise::defer(ioService);
+  readPromise->then([&chunk](aasdk::common::Data data) { chunk = std::move(data); }, [](void) {});
+  microphone->read(std::move(readPromise));
+  ioService.poll();
+  ASSERT_EQ(chunk.size(), 2056u);
+  EXPECT_EQ(chunk[0], 77);
+  EXPECT_EQ(chunk[1], 0);
+
+  // Detached sides are silent and no longer captured
+  microphone->stop();
+  call->stop();
+  stream->process(speaker.data(), mic.data(), 160, false);
+  EXPECT_EQ(speaker[0], 0);
+}
+
+// TC-PROJ-027 - Audio Output Reuse Across Sessions
+TEST(AudioOutputPoolTest, HandsDetachedOutputsToTheNextSession) {
+  AudioOutputPool pool;
+  const AudioOutputFormat guidance{1, 16000, 0, false, 60, true};
+  const AudioOutputFormat media{2, 48000, 0, false, 60, false};
+
+  auto first = pool.acquire(guidance);
+  auto second = pool.acquire(guidance);
+  auto music = pool.acquire(media);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(music->getSampleRate(), 48000u);
+
+  // The session ends: its outputs come back for the next one, by format
+  RtAudioOutput *previous = first.get();
+  first.reset();
+  music.reset();
+  EXPECT_EQ(pool.acquire(guidance).get(), previous);
+  EXPECT_EQ(pool.size(), 3u);
+
+  // New settings retire what no session holds
+  const AudioOutputFormat larger{1, 16000, 0, false, 120, true};
+  auto retuned = pool.acquire(larger);
+  EXPECT_EQ(pool.size(), 2u);
+  pool.releaseIdle();
+  EXPECT_EQ(pool.size(), 2u);
+  second.reset();
+  retuned.reset();
+  pool.releaseIdle();
+  EXPECT_EQ(pool.size(), 0u);
+}
+
+// TC-PROJ-028 - Media EQ And Limiter
+namespace {
+std::vector<int16_t> stereoTone(float frequency, float amplitude, size_t frames) {
+  std::vector<int16_t> samples(frames * 2);
+  for (size_t i = 0; i < frames; i++) {
+    const float value = amplitude * std::sin(2.0f * 3.14159265f * frequency * i / 48000.0f);
+    samples[2 * i] = samples[2 * i + 1] = static_cast<int16_t>(std::lrint(value));
+  }
+  return samples;
+}
+
+int peakOf(const std::vector<int16_t> &samples, size_t fromFrame) {
+  int peak = 0;
+  for (size_t i = fromFrame * 2; i < samples.size(); i++) {
+    peak = std::max(peak, std::abs(static_cast<int>(samples[i])));
+  }
+  return peak;
+}
+
+std::vector<int16_t> processed(MediaDsp &dsp, std::vector<int16_t> samples) {
+  // In device-period sized pieces, as the RT callback would
+  for (size_t offset = 0; offset < samples.size(); offset += 480 * 2) {
+    dsp.prepare();
+    dsp.process(samples.data() + offset, std::min<size_t>(480, (samples.size() - offset) / 2));
+  }
+  return samples;
+}
+} // namespace
+
+TEST(MediaDspTest, ParsesOneGainPerBand) {
+  std::array<float, MediaDspSettings::cEqBands> gains{};
+  EXPECT_TRUE(MediaDspSettings::parseEqGains("3,0,-2.5,0,40", gains));
+  EXPECT_FLOAT_EQ(gains[0], 3.0f);
+  EXPECT_FLOAT_EQ(gains[2], -2.5f);
+  EXPECT_FLOAT_EQ(gains[4], MediaDspSettings::cMaxEqGainDb);
+
+  EXPECT_FALSE(MediaDspSettings::parseEqGains("1,2", gains));
+  EXPECT_FALSE(MediaDspSettings::parseEqGains("1,2,3,4,5,6", gains));
+  EXPECT_FALSE(MediaDspSettings::parseEqGains("1,x,3,4,5", gains));
+  EXPECT_FLOAT_EQ(gains[0], 3.0f);
+}
+
+TEST(MediaDspTest, BypassLeavesSamplesUntouched) {
+  auto preset = std::make_shared<MediaDspPreset>();
+  MediaDsp dsp(preset);
+  const auto tone = stereoTone(1000.0f, 32000.0f, 4800);
+  EXPECT_FALSE(dsp.prepare());
+  EXPECT_EQ(processed(dsp, tone), tone);
+}
+
+TEST(MediaDspTest, BoostsTheBandAndLimitsThePeak) {
+  MediaDspSettings settings;
+  settings.enabled = true;
+  settings.cpuBudgetPercent = 100;
+  auto preset = std::make_shared<MediaDspPreset>(settings);
+  MediaDsp dsp(preset);
+
+  // Flat, and below the ceiling: unchanged but for rounding
+  const auto quiet = stereoTone(1000.0f, 8000.0f, 4800);
+  const auto flat = processed(dsp, quiet);
+  for (size_t i = 0; i < quiet.size(); i++) {
+    ASSERT_NEAR(flat[i], quiet[i], 1);
+  }
+
+  // +6 dB at 1 kHz doubles a 1 kHz tone, picked up at the next period
+  settings.eqGainsDb[2] = 6.0f;
+  preset->set(settings);
+  const int boosted = peakOf(processed(dsp, stereoTone(1000.0f, 4000.0f, 9600)), 4800);
+  EXPECT_NEAR(boosted, 4000 * 1.995, 4000 * 0.05);
+  // A band two octaves away is barely touched
+  const int neighbour = peakOf(processed(dsp, stereoTone(60.0f, 4000.0f, 9600)), 4800);
+  EXPECT_NEAR(neighbour, 4000, 4000 * 0.1);
+
+  // What the boost pushes past -1 dBFS is held there instead of clipping
+  settings.eqGainsDb[2] = 12.0f;
+  preset->set(settings);
+  const int limited = peakOf(processed(dsp, stereoTone(1000.0f, 30000.0f, 9600)), 4800);
+  EXPECT_LE(limited, 29200);
+  EXPECT_GT(limited, 27000);
+  EXPECT_FALSE(dsp.isShedding());
+}
+
+TEST(MediaDspTest, PresetSwapsUnderTheRenderingCallback) {
+  MediaDspSettings settings;
+  settings.enabled = true;
+  settings.cpuBudgetPercent = 100;
+  settings.eqGainsDb[2] = 6.0f;
+  GatedAudioOutput output(2, 16, MediaDspPreset::cSampleRate, 0, false, 20);
+  output.start();
+
+  // Stands in for the RT thread; each swap frees a stage it may be inside
+  std::atomic<bool> running{true};
+  std::atomic<int> periods{0};
+  std::thread callback([&]() {
+    std::vector<int16_t> period(480 * 2, 1000);
+    while (running.load()) {
+      output.render(period.data(), 480);
+      periods++;
+    }
+  });
+  for (int i = 0; i < 200; i++) {
+    // At least one period on each stage before it goes
+    const int seen = periods.load();
+    while (periods.load() == seen) {
+      std::this_thread::yield();
+    }
+    output.setMediaDsp(i % 3 == 2 ? nullptr : std::make_shared<MediaDspPreset>(settings));
+  }
+  running = false;
+  callback.join();
+  EXPECT_GT(periods.load(), 0);
+}
+
+// TC-PROJ-029 - Display Orientation
+TEST(ProjectionGeometryTest, RotatedAndMirroredPanels) {
+  // Anything but a quarter turn is treated as upright
+  EXPECT_TRUE(DisplayOrientation(45, false).isIdentity());
+  EXPECT_EQ(DisplayOrientation(-90, false).rotation(), 270);
+
+  // A 600x1024 portrait panel turned 90 degrees shows a 1024x600 UI
+  const DisplayOrientation quarter(90, false);
+  EXPECT_EQ(quarter.viewSize(QSize(600, 1024)), QSize(1024, 600));
+  ProjectionGeometry rotated(QSize(1280, 720), QSize(0, 120), QSize(600, 1024), quarter);
+  EXPECT_EQ(rotated.sourceRect(), QRect(0, 60, 1280, 600));
+  // In panel pixels, where the video plane is placed
+  EXPECT_EQ(rotated.destinationRect(), QRect(60, 0, 480, 1024));
+
+  // The panel's top left shows the UI's bottom left
+  EXPECT_EQ(rotated.mapToVideo(QPointF(300, 512)), QPoint(640, 360));
+  EXPECT_EQ(rotated.mapToVideo(QPointF(60, 0)), QPoint(0, 659));
+  EXPECT_EQ(rotated.mapToVideo(QPointF(60, 1023)), QPoint(1279, 659));
+
+  // Mirrored: the left edge of the panel is the right edge of the UI
+  ProjectionGeometry mirrored(QSize(1280, 720), QSize(0, 120), QSize(1024, 600),
+                              DisplayOrientation(0, true));
+  EXPECT_EQ(mirrored.destinationRect(), QRect(0, 60, 1024, 480));
+  EXPECT_EQ(mirrored.mapToVideo(QPointF(0, 60)), QPoint(1279, 60));
+
+  // Mode and display changes keep the orientation
+  EXPECT_EQ(rotated.withVideoSize(QSize(800, 480)).orientation(), quarter);
+  EXPECT_EQ(rotated.withDisplaySize(QSize(1024, 600)).orientation(), quarter);
+  EXPECT_FALSE(rotated == ProjectionGeometry(QSize(1280, 720), QSize(0, 120), QSize(600, 1024)));
+}
+
+// TC-PROJ-030 - Decoder Watchdog
+TEST(DecoderWatchdogTest, EscalatesUntilAFrameComesBack) {
+  DecoderWatchdog watchdog(400000, 4);
+
+  // Three packets are decoder latency, however long they wait
+  for (int64_t us = 1000000; us < 1003000; us += 1000) {
+    watchdog.packetSent(us);
+  }
+  EXPECT_EQ(watchdog.poll(3000000), DecoderRecovery::None);
+  // A fourth, still inside the threshold
+  watchdog.packetSent(1300000);
+  EXPECT_EQ(watchdog.poll(1300000), DecoderRecovery::None);
+  EXPECT_FALSE(watchdog.recovering());
+
+  // Past it: flush, then reopen, then new devices for as long as it takes
+  EXPECT_EQ(watchdog.poll(1400000), DecoderRecovery::Flush);
+  EXPECT_TRUE(watchdog.recovering());
+  int64_t us = 1400000;
+  for (DecoderRecovery expected : {DecoderRecovery::Reopen, DecoderRecovery::RecreateDevice,
+                                   DecoderRecovery::RecreateDevice}) {
+    for (int i = 0; i < 4; i++) {
+      watchdog.packetSent(us += 33000);
+    }
+    EXPECT_EQ(watchdog.poll(us), DecoderRecovery::None);
+    EXPECT_EQ(watchdog.poll(us + 400000), expected);
+  }
+
+  // Counted from the packet the screen froze on
+  EXPECT_EQ(watchdog.frameDecoded(2500000), 1500000);
+  EXPECT_FALSE(watchdog.recovering());
+  EXPECT_EQ(watchdog.frameDecoded(2533000), 0);
+
+  // The next hang starts over at a flush
+  for (int i = 0; i < 4; i++) {
+    watchdog.packetSent(3000000 + i * 33000);
+  }
+  EXPECT_EQ(watchdog.poll(3500000), DecoderRecovery::Flush);
+  watchdog.reset();
+  EXPECT_FALSE(watchdog.recovering());
+  EXPECT_EQ(watchdog.poll(5000000), DecoderRecovery::None);
+}
+
+// TC-PROJ-031 - Soak Trends
+TEST(SoakMonitorTest, FlagsSteadyGrowthAfterTheWarmUp) {
+  SoakSettings settings;
+  EXPECT_TRUE(SoakMonitor::parseSpec("6,10", settings));
+  EXPECT_DOUBLE_EQ(settings.hours, 6.0);
+  EXPECT_EQ(settings.disconnectMinutes, 10);
+  EXPECT_EQ(settings.warmupMinutes, 30);
+  EXPECT_FALSE(SoakMonitor::parseSpec("six", settings));
+  EXPECT_FALSE(SoakMonitor::parseSpec("0", settings));
+
+  // Two hours a minute apart: flat, apart from the warm-up and one spike
+  std::vector<SoakSample> samples;
+  for (int minute = 0; minute <= 120; minute++) {
+    SoakSample sample;
+    sample.atMs = minute * 60000LL;
+    sample.residentBytes = 80LL * 1024 * 1024 + (minute < 30 ? minute * 1024 * 1024 : 30LL * 1024 * 1024);
+    sample.heapInUseBytes = 40LL * 1024 * 1024 + (minute == 90 ? 8LL * 1024 * 1024 : 0);
+    sample.heapFragmentationPermille = 120;
+    sample.cmaFreeBytes = 64LL * 1024 * 1024;
+    sample.openFds = 48;
+    sample.drmFramebuffers = 6;
+    sample.drmBufferBytes = -1;
+    samples.push_back(sample);
+  }
+  EXPECT_NEAR(SoakMonitor::slopePerHour(samples, &SoakSample::openFds), 0.0, 1e-9);
+  EXPECT_TRUE(SoakMonitor::evaluate(samples, settings).empty());
+
+  // A framebuffer every 20 minutes and CMA going with it
+  for (auto &sample : samples) {
+    sample.drmFramebuffers += sample.atMs / (20 * 60000);
+    sample.cmaFreeBytes -= sample.atMs / (20 * 60000) * 3686400;
+  }
+  EXPECT_NEAR(SoakMonitor::slopePerHour(samples, &SoakSample::drmFramebuffers), 3.0, 0.2);
+  const auto findings = SoakMonitor::evaluate(samples, settings);
+  ASSERT_EQ(findings.size(), 2u);
+  EXPECT_EQ(findings[0].resource, "CMA free bytes");
+  EXPECT_EQ(findings[1].resource, "DRM framebuffers");
+
+  // Too short a run decides nothing
+  samples.resize(35);
+  EXPECT_TRUE(SoakMonitor::evaluate(samples, settings).empty());
+
+  std::istringstream framebuffers("framebuffer[97]:\n\tallocated by = Xorg\n\trefcount=2\n"
+                                  "framebuffer[101]:\n\tallocated by = video.display\n"
+                                  "framebuffer[102]:\n\tallocated by = autoapp\n");
+  EXPECT_EQ(SoakMonitor::parseFramebuffers(framebuffers, {"autoapp", "video.display"}), 2);
+
+  std::string client;
+  std::istringstream fdinfo("pos:\t0\ndrm-driver:\trockchip\ndrm-client-id:\t12\n"
+                            "drm-total-system:\t4096 KiB\ndrm-resident-system:\t2048 KiB\n"
+                            "drm-total-cma:\t2 MiB\n");
+  EXPECT_EQ(SoakMonitor::parseDrmFdinfo(fdinfo, client), 4096LL * 1024 + 2 * 1024 * 1024);
+  EXPECT_EQ(client, "12");
+  std::istringstream older("drm-client-id:\t3\ndrm-memory-vram:\t512 KiB\n");
+  EXPECT_EQ(SoakMonitor::parseDrmFdinfo(older, client), 512 * 1024);
+  std::istringstream none("pos:\t0\nflags:\t02\n");
+  EXPECT_EQ(SoakMonitor::parseDrmFdinfo(none, client), -1);
+}
+
+// TC-PROJ-032 - Touch Pointer Table and Fixed-Point Mapping
+TEST(TouchPointerTableTest, LowestFreeIdsAndFixedPointMapping) {
+  // Android reuses the lowest free id; a finger that stays down keeps its own
+  TouchPointerTable table;
+  EXPECT_EQ(table.acquire(100), 0);
+  EXPECT_EQ(table.acquire(101), 1);
+  EXPECT_EQ(table.acquire(102), 2);
+  EXPECT_EQ(table.acquire(101), 1);
+  table.release(100);
+  EXPECT_EQ(table.find(100), -1);
+  EXPECT_EQ(table.acquire(103), 0);
+  EXPECT_EQ(table.find(102), 2);
+  table.release(101);
+  table.release(102);
+  EXPECT_EQ(table.acquire(104), 1);
+  EXPECT_EQ(table.size(), 2u);
+  for (int id = 200; table.size() < TouchPointerTable::cMaxPointers; id++) {
+    EXPECT_GE(table.acquire(id), 0);
+  }
+  EXPECT_EQ(table.acquire(999), -1);
+  table.clear();
+  EXPECT_EQ(table.acquire(999), 0);
+
+  // The fixed-point transform lands where mapToVideo() does, in every orientation
+  const ProjectionGeometry geometries[] = {
+      ProjectionGeometry(QSize(1280, 720), QSize(0, 0), QSize(800, 480)),
+      ProjectionGeometry(QSize(1920, 1080), QSize(0, 0), QSize(1024, 600)),
+      ProjectionGeometry(QSize(1280, 720), QSize(0, 120), QSize(600, 1024), DisplayOrientation(90, false)),
+      ProjectionGeometry(QSize(1280, 720), QSize(0, 120), QSize(1024, 600), DisplayOrientation(0, true)),
+      ProjectionGeometry(QSize(1280, 720), QSize(0, 0), QSize(480, 800), DisplayOrientation(270, true))};
+  for (const auto &geometry : geometries) {
+    const TouchTransform transform(geometry);
+    for (double x = 0; x < geometry.displaySize().width(); x += 37.25) {
+      for (double y = 0; y < geometry.displaySize().height(); y += 41.5) {
+        const QPoint expected = geometry.mapToVideo(QPointF(x, y));
+        const QPoint mapped = transform.map(QPointF(x, y));
+        EXPECT_LE(std::abs(mapped.x() - expected.x()), 1) << x << "," << y;
+        EXPECT_LE(std::abs(mapped.y() - expected.y()), 1) << x << "," << y;
+      }
+    }
+  }
+  const ProjectionGeometry rotated(QSize(1280, 720), QSize(0, 120), QSize(600, 1024), DisplayOrientation(90, false));
+  EXPECT_EQ(TouchTransform(rotated).map(QPointF(300, 512)), QPoint(640, 360));
+  // In the bars: clamped to the phone UI
+  EXPECT_EQ(TouchTransform(rotated).map(QPointF(0, 0)), QPoint(0, 659));
+  // Without a geometry, display pixels pass through
+  EXPECT_EQ(TouchTransform().map(QPointF(12.4, 7.6)), QPoint(12, 8));
+}
+
+
+// TC-PROJ-033 - Frame Ring
+TEST(FrameRingTest, WholeFramesAcrossWrap) {
+  FrameRing<int16_t, 2, 8> ring;
+  static_assert(FrameRing<int16_t, 2, 8>::cFrameBytes == 4, "stereo 16-bit");
+  int16_t in[16], out[16];
+  for (int16_t i = 0; i < 16; i++) {
+    in[i] = i;
+  }
+
+  // No slot is kept empty: all eight frames fit, a ninth does not
+  EXPECT_EQ(ring.write(in, 6), 6u);
+  ASSERT_EQ(ring.read(out, 5), 5u);
+  EXPECT_EQ(out[9], 9);
+  EXPECT_EQ(ring.write(in, 8), 7u);
+  EXPECT_EQ(ring.available(), 8u);
+  EXPECT_EQ(ring.space(), 0u);
+  EXPECT_EQ(ring.write(in, 1), 0u);
+
+  // Read back across the wrap with both samples of every frame in order
+  ASSERT_EQ(ring.read(out, 8), 8u);
+  EXPECT_EQ(out[0], 10);
+  EXPECT_EQ(out[1], 11);
+  EXPECT_EQ(out[2], 0);
+  EXPECT_EQ(out[15], 13);
+
+  // Spans count frames too
+  auto write = ring.reserveWrite();
+  ASSERT_EQ(write.frames, 3u); // up to the end of ring memory
+  write.data[0] = 42;
+  write.data[5] = 43;
+  ring.commitWrite(3);
+  auto read = ring.peekContiguous();
+  ASSERT_EQ(read.frames, 3u);
+  EXPECT_EQ(read.data[0], 42);
+  EXPECT_EQ(read.data[5], 43);
+  ring.commitRead(3);
+  EXPECT_EQ(ring.available(), 0u);
+
+  // A runtime capacity rounds up to a power of two frames
+  MonoFrameRing mono(300);
+  EXPECT_EQ(mono.capacity(), 512u);
+  EXPECT_EQ(mono.memoryBytes(), 1024u);
+}
+
+// TC-PROJ-034 - AAC Media Audio
+TEST(AacAudioOutputTest, ConfigAndInterleave) {
+  // AAC-LC, sampling frequency index 3, channel configuration 2
+  EXPECT_EQ(AacAudioOutput::audioSpecificConfig(48000, 2), (std::vector<uint8_t>{0x11, 0x90}));
+  EXPECT_EQ(AacAudioOutput::audioSpecificConfig(44100, 1), (std::vector<uint8_t>{0x12, 0x08}));
+  EXPECT_TRUE(AacAudioOutput::audioSpecificConfig(45000, 2).empty());
+
+  const float left[] = {0.0f, 0.5f, 2.0f};
+  const float right[] = {-1.0f, -0.25f, -3.0f};
+  const float *planes[] = {left, right};
+  int16_t out[6];
+  AacAudioOutput::interleave(planes, 2, 3, out);
+  EXPECT_EQ(out[0], 0);
+  EXPECT_EQ(out[1], -32767);
+  EXPECT_EQ(out[2], 16384);
+  EXPECT_EQ(out[3], -8192);
+  EXPECT_EQ(out[4], 32767);  // clipped
+  EXPECT_EQ(out[5], -32767);
+
+  // The format is the PCM output's, and nothing reaches it before the decoder runs
+  auto pcm = std::make_shared<NiceMock<MockAudioOutput>>();
+  ON_CALL(*pcm, getSampleRate()).WillByDefault(Return(48000));
+  EXPECT_CALL(*pcm, write(_, _)).Times(0);
+  AacAudioOutput aac(pcm);
+  EXPECT_EQ(aac.getSampleRate(), 48000u);
+  const uint8_t packet[] = {0x21, 0x10};
+  aac.write(0, aasdk::common::DataConstBuffer(packet, sizeof(packet)));
+  EXPECT_EQ(aac.decodedPackets(), 0u);
+}
+
+// TC-PROJ-035 - Native Sink Rate
+TEST(AudioDeviceInfoTest, NativeSampleRate) {
+  AudioDeviceInfo device{};
+  device.sampleRates = {16000, 44100, 48000};
+  device.preferredSampleRate = 44100;
+
+  // The preferred rate is not one the link carries; the first native one is
+  EXPECT_EQ(device.nativeSampleRate({48000, 16000}, 16000), 48000u);
+  device.preferredSampleRate = 16000;
+  EXPECT_EQ(device.nativeSampleRate({48000, 16000}, 16000), 16000u);
+
+  // Nothing native, or nothing known, falls back
+  device.sampleRates = {44100};
+  device.preferredSampleRate = 44100;
+  EXPECT_EQ(device.nativeSampleRate({48000}, 16000), 16000u);
+  device.sampleRates.clear();
+  EXPECT_EQ(device.nativeSampleRate({48000, 16000}, 16000), 16000u);
+}
+
+// TC-PROJ-036 - Microphone Pre-Roll
+class PreRollAudioInput : public RtAudioInput {
+public:
+  explicit PreRollAudioInput(boost::asio::io_service &ioService) : RtAudioInput(ioService, 1, 16, 16000, nullptr) {}
+  // stopDevice() would otherwise run once this part is already gone
+  ~PreRollAudioInput() override { close(); }
+
+  int devicesStarted = 0;
+
+protected:
+  bool startDevice() override {
+    devicesStarted++;
+    return true;
+  }
+  void stopDevice() override {}
+};
+
+TEST(RtAudioInputTest, StartsWithThePreRoll) {
+  boost::asio::io_service ioService;
+  PreRollAudioInput microphone(ioService);
+  microphone.setPreRoll(100);
+  ASSERT_TRUE(microphone.open());
+  EXPECT_EQ(microphone.devicesStarted, 1);
+  EXPECT_FALSE(microphone.isActive());
+
+  // 200 ms of 20 ms periods; only the last 100 ms are kept
+  std::vector<int16_t> period(320);
+  for (int16_t i = 0; i < 10; i++) {
+    std::fill(period.begin(), period.end(), i);
+    microphone.capture(period.data(), 320, false);
+  }
+
+  bool started = false;
+  auto startPromise = IAudioInput::StartPromise::defer(ioService);
+  startPromise->then([&started]() { started = true; }, [](void) {});
+  microphone.start(std::move(startPromise));
+  ioService.poll();
+  ioService.restart();
+  ASSERT_TRUE(started);
+  EXPECT_EQ(microphone.devicesStarted, 1);
+
+  // The first live period follows the pre-roll
+  std::fill(period.begin(), period.end(), 10);
+  microphone.capture(period.data(), 320, false);
+  aasdk::common::Data chunk;
+  auto readPromise = IAudioInput::ReadPromise::defer(ioService);
+  readPromise->then([&chunk](aasdk::common::Data data) { chunk = std::move(data); }, [](void) {});
+  microphone.read(std::move(readPromise));
+  ioService.poll();
+  ioService.restart();
+  ASSERT_EQ(chunk.size(), 2056u);
+  EXPECT_EQ(chunk[0], 5);
+  EXPECT_EQ(chunk[2 * 320 * 3], 8);
+
+  // Stopped, it captures on into the pre-roll for the next request
+  microphone.stop();
+  EXPECT_FALSE(microphone.isActive());
+  microphone.capture(period.data(), 320, false);
+  auto again = IAudioInput::StartPromise::defer(ioService);
+  again->then([]() {}, [](void) {});
+  microphone.start(std::move(again));
+  EXPECT_EQ(microphone.devicesStarted, 1);
+}
+
+// TC-PROJ-037 - Shared VPU Scheduling
+TEST(VpuSchedulerTest, ProtectsTheMainStream) {
+  VpuScheduler scheduler;
+  scheduler.attach(VpuStream::Main);
+  scheduler.attach(VpuStream::Cluster);
+  int64_t now = 1000000;
+
+  // A cluster picture waits out a main one; the skip lasts to the next IDR
+  ASSERT_TRUE(scheduler.admit(VpuStream::Main, false, true, now));
+  EXPECT_FALSE(scheduler.admit(VpuStream::Cluster, false, false, now));
+  EXPECT_FALSE(scheduler.admit(VpuStream::Cluster, false, true, now));
+  scheduler.finished(VpuStream::Main, now + 5000);
+  EXPECT_FALSE(scheduler.admit(VpuStream::Cluster, false, true, now + 6000));
+  ASSERT_TRUE(scheduler.admit(VpuStream::Cluster, true, true, now + 7000));
+  scheduler.finished(VpuStream::Cluster, now + 10000);
+  ASSERT_TRUE(scheduler.admit(VpuStream::Cluster, false, true, now + 11000));
+  scheduler.finished(VpuStream::Cluster, now + 14000);
+
+  // Main is never refused, not even while the cluster decodes
+  ASSERT_TRUE(scheduler.admit(VpuStream::Cluster, false, true, now + 15000));
+  EXPECT_TRUE(scheduler.admit(VpuStream::Main, false, true, now + 15000));
+  scheduler.finished(VpuStream::Main, now + 20000);
+  scheduler.finished(VpuStream::Cluster, now + 21000);
+}
+
+TEST(VpuSchedulerTest, CapsTheClusterShare) {
+  VpuScheduler scheduler;
+  scheduler.attach(VpuStream::Cluster);
+  int64_t now = 1000000;
+
+  // 20 ms pictures every 40 ms are half the decoder, twice the default cap
+  int admitted = 0;
+  for (int i = 0; i < 50; i++, now += 40000) {
+    if (scheduler.admit(VpuStream::Cluster, i % 10 == 0, false, now)) {
+      scheduler.finished(VpuStream::Cluster, now + 20000);
+      admitted++;
+    }
+  }
+  EXPECT_LE(scheduler.sharePermille(VpuStream::Cluster, now), 300u);
+  EXPECT_GT(admitted, 5);
+  EXPECT_LT(admitted, 40);
+
+  // Closing the stream forgets what it used
+  scheduler.detach(VpuStream::Cluster);
+  scheduler.attach(VpuStream::Cluster);
+  EXPECT_EQ(scheduler.sharePermille(VpuStream::Cluster, now), 0u);
+  EXPECT_TRUE(scheduler.admit(VpuStream::Cluster, false, true, now));
+}
+
+// TC-PROJ-038 - SIMD Kernel Dispatch
+TEST(SimdKernelsTest, BindsPerCpuFeature) {
+  const SimdKernels &scalar = scalarKernels();
+  const SimdKernels none = bindSimdKernels(common::CpuFeatures());
+  EXPECT_EQ(none.mixSaturate, scalar.mixSaturate);
+  EXPECT_EQ(none.biquadStereo, scalar.biquadStereo);
+
+  common::CpuFeatures neon;
+  neon.neon = true;
+  const SimdKernels vector = bindSimdKernels(neon);
+  if (neonKernels() != nullptr) {
+    EXPECT_EQ(vector.dotProduct8, neonKernels()->dotProduct8);
+  } else {
+    EXPECT_EQ(vector.dotProduct8, scalar.dotProduct8);
+  }
+
+  // Whatever this machine bound agrees with the references
+  EXPECT_EQ(common::KernelSelfTest::instance().run(), 0u);
+
+  common::KernelSelfTest selfTest;
+  selfTest.add("agrees", []() { return true; });
+  selfTest.add("disagrees", []() { return false; });
+  EXPECT_EQ(selfTest.run(), 1u);
+}
+
+// TC-PROJ-039 - Presentation Cadence
+TEST(PresentationPacerTest, HoldsEachFrameForItsVblanks) {
+  EXPECT_EQ(PresentationPacer::cadenceFor(30, 60000), 2u);
+  EXPECT_EQ(PresentationPacer::cadenceFor(30, 59940), 2u);
+  EXPECT_EQ(PresentationPacer::cadenceFor(60, 60000), 1u);
+  EXPECT_EQ(PresentationPacer::cadenceFor(30, 50000), 0u);
+  EXPECT_EQ(PresentationPacer::cadenceFor(30, 75000), 0u);
+
+  // A 50 Hz panel moves to its 60 Hz mode, a 60 Hz one stays
+  EXPECT_EQ(PresentationPacer::chooseRefresh({50000, 30000, 60000}, 0, 30), 2u);
+  EXPECT_EQ(PresentationPacer::chooseRefresh({60000, 30000}, 0, 30), 0u);
+  EXPECT_EQ(PresentationPacer::chooseRefresh({50000, 75000}, 0, 30), 0u);
+
+  PresentationPacer pacer;
+  pacer.configure(30, 60000);
+  ASSERT_EQ(pacer.cadence(), 2u);
+  const int64_t periodUs = 16667;
+
+  // Nothing to time against before the first flip
+  EXPECT_EQ(pacer.commitNotBeforeUs(33333, 1), 0);
+  pacer.onCommit(33333);
+  EXPECT_TRUE(pacer.onFlip(100, 1000000));
+
+  // The next frame flips two vblanks on: committed after the one in between
+  const int64_t notBeforeUs = pacer.commitNotBeforeUs(66667, 1);
+  EXPECT_GT(notBeforeUs, 1000000 + periodUs);
+  EXPECT_LT(notBeforeUs, 1000000 + 2 * periodUs);
+  // A backlog goes out at once
+  EXPECT_EQ(pacer.commitNotBeforeUs(66667, 2), 0);
+
+  pacer.onCommit(66667);
+  EXPECT_TRUE(pacer.onFlip(102, 1000000 + 2 * periodUs));
+  pacer.onCommit(100000);
+  EXPECT_FALSE(pacer.onFlip(105, 1000000 + 5 * periodUs));
+  EXPECT_NEAR(static_cast<double>(pacer.vblankPeriodUs()), periodUs, 2.0);
+
+  // No cadence, no pacing
+  pacer.configure(30, 50000);
+  pacer.onCommit(33333);
+  pacer.onFlip(10, 1000000);
+  EXPECT_EQ(pacer.commitNotBeforeUs(66667, 1), 0);
+}
+
+
+// TC-PROJ-040 - Frame Grabs
+TEST(FrameGrabberTest, ScalesTheScanoutBufferAndEncodesIt) {
+  // 64x32 NV12: white left half, BT.709 red right half, limited range
+  const int width = 64, height = 32, pitch = 64;
+  std::vector<uint8_t> nv12(static_cast<size_t>(pitch) * height * 3 / 2);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      nv12[y * pitch + x] = x < width / 2 ? 235 : 63;
+    }
+  }
+  uint8_t *chroma = nv12.data() + pitch * height;
+  for (int y = 0; y < height / 2; y++) {
+    for (int x = 0; x < width; x += 2) {
+      chroma[y * pitch + x] = x < width / 2 ? 128 : 102;
+      chroma[y * pitch + x + 1] = x < width / 2 ? 128 : 240;
+    }
+  }
+
+  std::vector<uint8_t> rgb(16 * 8 * 3);
+  downscaleNv12ToRgb(rgb.data(), 16, 8, nv12.data(), pitch, chroma, pitch, width, height, false);
+  EXPECT_EQ(rgb[0], 255);
+  EXPECT_EQ(rgb[1], 255);
+  EXPECT_EQ(rgb[2], 255);
+  const uint8_t *red = &rgb[(4 * 16 + 12) * 3];
+  EXPECT_GE(red[0], 250);
+  EXPECT_LE(red[1], 5);
+  EXPECT_LE(red[2], 5);
+
+  // No source: the handler still hears about it
+  FrameGrabber &grabber = FrameGrabber::instance();
+  std::promise<FrameGrabber::Snapshot> missing;
+  ASSERT_TRUE(grabber.grab([&](const FrameGrabber::Snapshot &snapshot) { missing.set_value(snapshot); }));
+  const FrameGrabber::Snapshot none = missing.get_future().get();
+  EXPECT_TRUE(none.jpeg.empty());
+  EXPECT_FALSE(none.error.empty());
+
+  // A memfd stands in for the decoder's DMA-BUF
+  const int fd = memfd_create("grab-test", MFD_CLOEXEC);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(write(fd, nv12.data(), nv12.size()), static_cast<ssize_t>(nv12.size()));
+  auto held = std::make_shared<int>(0);
+  grabber.setSource([&](GrabbedFrame &frame) {
+    frame.fd = fd;
+    frame.linear = true;
+    frame.width = width;
+    frame.height = height;
+    frame.lumaPitch = pitch;
+    frame.chromaOffset = pitch * height;
+    frame.chromaPitch = pitch;
+    frame.hold = held;
+    return true;
+  });
+  std::promise<FrameGrabber::Snapshot> shown;
+  ASSERT_TRUE(grabber.grab([&](const FrameGrabber::Snapshot &snapshot) { shown.set_value(snapshot); }, 32));
+  const FrameGrabber::Snapshot snapshot = shown.get_future().get();
+  grabber.setSource(nullptr);
+  close(fd);
+
+  EXPECT_EQ(snapshot.width, 32u);
+  EXPECT_EQ(snapshot.height, 16u);
+  EXPECT_EQ(snapshot.sourceWidth, 64u);
+  ASSERT_GE(snapshot.jpeg.size(), 4u);
+  EXPECT_EQ(snapshot.jpeg[0], 0xff);
+  EXPECT_EQ(snapshot.jpeg[1], 0xd8);
+  // The buffer went back before the handler ran
+  EXPECT_EQ(held.use_count(), 1);
+}
+
+// TC-PROJ-041 - Player Feed Ring
+TEST(SequentialBufferTest, WrapsDropsWhenFullResetsAndSignalsOnlyADryReader) {
+  SequentialBuffer buffer;
+  ASSERT_TRUE(buffer.open(QIODevice::ReadWrite | QIODevice::Unbuffered));
+  int readyReads = 0;
+  QObject::connect(&buffer, &QIODevice::readyRead, [&readyReads]() { ++readyReads; });
+  char out[256];
+
+  // The reader starts out waiting: the first chunk is signalled, the next
+  // one queued behind it is not
+  EXPECT_EQ(buffer.write("abcde", 5), 5);
+  EXPECT_EQ(readyReads, 1);
+  EXPECT_EQ(buffer.write("fg", 2), 2);
+  EXPECT_EQ(readyReads, 1);
+  EXPECT_EQ(buffer.bytesAvailable(), 7);
+
+  // Reads cross chunk boundaries
+  ASSERT_EQ(buffer.read(out, 3), 3);
+  EXPECT_EQ(std::string(out, 3), "abc");
+  ASSERT_EQ(buffer.read(out, 3), 3);
+  EXPECT_EQ(std::string(out, 3), "def");
+  // Taking exactly what was queued leaves the reader satisfied...
+  ASSERT_EQ(buffer.read(out, 1), 1);
+  EXPECT_EQ(out[0], 'g');
+  EXPECT_EQ(buffer.write("h", 1), 1);
+  EXPECT_EQ(readyReads, 1);
+  // ...running dry asks for the next chunk to be signalled
+  ASSERT_EQ(buffer.read(out, sizeof(out)), 1);
+  EXPECT_EQ(buffer.read(out, sizeof(out)), 0);
+  EXPECT_EQ(buffer.write("i", 1), 1);
+  EXPECT_EQ(readyReads, 2);
+  ASSERT_EQ(buffer.read(out, sizeof(out)), 1);
+
+  // Several times round the ring, one chunk at a time and two at a time
+  for (size_t i = 0; i < 3 * SequentialBuffer::cChunkSlots; ++i) {
+    const std::string chunk = "chunk " + std::to_string(i);
+    ASSERT_EQ(buffer.write(chunk.data(), chunk.size()), static_cast<qint64>(chunk.size()));
+    if (i % 2 == 1) {
+      const std::string both = "chunk " + std::to_string(i - 1) + chunk;
+      ASSERT_EQ(buffer.read(out, sizeof(out)), static_cast<qint64>(both.size()));
+      EXPECT_EQ(std::string(out, both.size()), both);
+    }
+  }
+
+  // A reader that stopped: once the ring is full later chunks are dropped,
+  // though the writer is told they went in
+  for (size_t i = 0; i < SequentialBuffer::cChunkSlots + 5; ++i) {
+    const char byte = static_cast<char>(i);
+    EXPECT_EQ(buffer.write(&byte, 1), 1);
+  }
+  EXPECT_EQ(buffer.bytesAvailable(), static_cast<qint64>(SequentialBuffer::cChunkSlots));
+  ASSERT_EQ(buffer.read(out, sizeof(out)), static_cast<qint64>(SequentialBuffer::cChunkSlots));
+  for (size_t i = 0; i < SequentialBuffer::cChunkSlots; ++i) {
+    EXPECT_EQ(out[i], static_cast<char>(i));
+  }
+
+  // reset() skips what is queued, including the rest of a part-read chunk
+  EXPECT_EQ(buffer.write("1234", 4), 4);
+  EXPECT_EQ(buffer.write("5678", 4), 4);
+  ASSERT_EQ(buffer.read(out, 2), 2);
+  EXPECT_TRUE(buffer.reset());
+  // Never reported empty, so QMediaPlayer keeps reading
+  EXPECT_EQ(buffer.bytesAvailable(), 1);
+  EXPECT_EQ(buffer.read(out, sizeof(out)), 0);
+  EXPECT_EQ(buffer.write("xyz", 3), 3);
+  ASSERT_EQ(buffer.read(out, sizeof(out)), 3);
+  EXPECT_EQ(std::string(out, 3), "xyz");
+}
+
+// TC-PROJ-042 - Keyframe-Aware Packet Dropping
+TEST(PacketDropPolicyTest, ClassifiesAccessUnits) {
+  // SPS (High profile) and PPS ahead of an IDR slice, 4-byte start codes
+  const uint8_t idr[] = {0, 0, 0, 1, 0x67, 100, 0, 40, 0, 0, 0, 1, 0x68, 0xce, 0, 0, 1, 0x65, 0x88};
+  AccessUnitInfo info = inspectAccessUnit(idr, sizeof(idr), false);
+  EXPECT_TRUE(info.keyframe);
+  EXPECT_TRUE(info.parameterSets);
+  EXPECT_TRUE(info.hasSlices);
+  EXPECT_TRUE(info.reference);
+  EXPECT_EQ(info.profileIdc, 100);
+
+  // P slice with nal_ref_idc 2, B slice with 0
+  const uint8_t p[] = {0, 0, 1, 0x41, 0x9a};
+  info = inspectAccessUnit(p, sizeof(p), false);
+  EXPECT_TRUE(info.hasSlices);
+  EXPECT_TRUE(info.reference);
+  EXPECT_FALSE(info.keyframe);
+  const uint8_t b[] = {0, 0, 1, 0x01, 0x9e};
+  info = inspectAccessUnit(b, sizeof(b), false);
+  EXPECT_TRUE(info.hasSlices);
+  EXPECT_FALSE(info.reference);
+
+  // Parameter sets alone, and a fragment without a start code
+  const uint8_t pps[] = {0, 0, 1, 0x68, 0xce};
+  info = inspectAccessUnit(pps, sizeof(pps), false);
+  EXPECT_TRUE(info.parameterSets);
+  EXPECT_FALSE(info.hasSlices);
+  EXPECT_FALSE(hasAnnexBStartCode(b + 1, sizeof(b) - 1));
+  info = inspectAccessUnit(b + 3, sizeof(b) - 3, false);
+  EXPECT_FALSE(info.hasSlices);
+  EXPECT_FALSE(info.parameterSets);
+
+  // HEVC: VPS then IDR_W_RADL, TRAIL_N, TRAIL_R
+  const uint8_t hevcIdr[] = {0, 0, 1, 0x40, 0x01, 0, 0, 1, 0x26, 0x01, 0xaf};
+  info = inspectAccessUnit(hevcIdr, sizeof(hevcIdr), true);
+  EXPECT_TRUE(info.parameterSets);
+  EXPECT_TRUE(info.keyframe);
+  const uint8_t trailN[] = {0, 0, 1, 0x00, 0x01, 0xaf};
+  EXPECT_FALSE(inspectAccessUnit(trailN, sizeof(trailN), true).reference);
+  const uint8_t trailR[] = {0, 0, 1, 0x02, 0x01, 0xaf};
+  EXPECT_TRUE(inspectAccessUnit(trailR, sizeof(trailR), true).reference);
+}
+
+namespace {
+struct QueuedUnit {
+  char kind; // I, P (reference), B (non-reference), S (parameter sets), F (fragment)
+  AccessUnitInfo info;
+};
+
+AccessUnitInfo unit(char kind) {
+  AccessUnitInfo info;
+  info.keyframe = kind == 'I';
+  info.hasSlices = kind == 'I' || kind == 'P' || kind == 'B';
+  info.reference = kind == 'I' || kind == 'P';
+  info.parameterSets = kind == 'S';
+  return info;
+}
+
+// Offers each of @p kinds in turn, queueing what is admitted
+std::string offer(PacketDropPolicy &policy, std::deque<QueuedUnit> &queue, const std::string &kinds,
+                  size_t &dropped, bool &requestKeyframe, bool degradedLink = false) {
+  for (const char kind : kinds) {
+    if (policy.admit(queue, unit(kind), degradedLink, dropped, requestKeyframe)) {
+      queue.push_back({kind, unit(kind)});
+    }
+  }
+  std::string queued;
+  for (const auto &queuedUnit : queue) {
+    queued += queuedUnit.kind;
+  }
+  return queued;
+}
+} // namespace
+
+TEST(PacketDropPolicyTest, DropsOnlyWhatNothingDependsOn) {
+  PacketDropPolicy policy;
+  std::deque<QueuedUnit> queue;
+  size_t dropped = 0;
+  bool requestKeyframe = false;
+
+  // From the backlog threshold non-reference frames are turned away
+  EXPECT_EQ(offer(policy, queue, "IPPPBP", dropped, requestKeyframe), "IPPPP");
+  EXPECT_EQ(dropped, 0u);
+  EXPECT_FALSE(requestKeyframe);
+  // A degraded link lowers the threshold
+  queue.clear();
+  EXPECT_EQ(offer(policy, queue, "IPB", dropped, requestKeyframe, true), "IP");
+
+  // An IDR under backlog replaces the queued slices but not parameter sets
+  queue.clear();
+  EXPECT_EQ(offer(policy, queue, "IPSPPI", dropped, requestKeyframe), "SI");
+  EXPECT_EQ(dropped, 4u);
+
+  // When full, the queue resumes from its newest IDR
+  queue.clear();
+  dropped = 0;
+  for (const char kind : std::string("IPSPIPPP")) {
+    queue.push_back({kind, unit(kind)});
+  }
+  EXPECT_EQ(offer(policy, queue, "P", dropped, requestKeyframe), "SIPPPP");
+  EXPECT_EQ(dropped, 3u);
+  EXPECT_FALSE(requestKeyframe);
+
+  // Without one, everything until the next IDR is dropped and one is asked for
+  queue.clear();
+  dropped = 0;
+  EXPECT_EQ(offer(policy, queue, "IPPPPPPP", dropped, requestKeyframe), "IPPPPPPP");
+  EXPECT_EQ(offer(policy, queue, "PP", dropped, requestKeyframe), "IPPPPPPP");
+  EXPECT_TRUE(requestKeyframe);
+  EXPECT_TRUE(policy.awaitingKeyframe());
+  queue.erase(queue.begin(), queue.begin() + 6);
+  EXPECT_EQ(offer(policy, queue, "PI", dropped, requestKeyframe), "PPI");
+  EXPECT_FALSE(policy.awaitingKeyframe());
+}
+
+TEST(PacketDropPolicyTest, MakesRoomForParameterSetsWithoutBreakingReferences) {
+  PacketDropPolicy policy;
+  std::deque<QueuedUnit> queue;
+  size_t dropped = 0;
+  bool requestKeyframe = false;
+
+  // A full queue gives up its oldest frame nothing refers to
+  for (const char kind : std::string("IPPBPPBP")) {
+    queue.push_back({kind, unit(kind)});
+  }
+  EXPECT_EQ(offer(policy, queue, "S", dropped, requestKeyframe), "IPPPPBPS");
+  EXPECT_EQ(dropped, 1u);
+  EXPECT_FALSE(requestKeyframe);
+  EXPECT_FALSE(policy.awaitingKeyframe());
+
+  // With only references queued the newest slice goes, and the slices after
+  // it until the next IDR
+  queue.clear();
+  dropped = 0;
+  EXPECT_EQ(offer(policy, queue, "IPPPPPPP", dropped, requestKeyframe), "IPPPPPPP");
+  EXPECT_EQ(offer(policy, queue, "S", dropped, requestKeyframe), "IPPPPPPS");
+  EXPECT_EQ(dropped, 1u);
+  EXPECT_TRUE(requestKeyframe);
+  EXPECT_TRUE(policy.awaitingKeyframe());
+  queue.erase(queue.begin(), queue.begin() + 5);
+  EXPECT_EQ(offer(policy, queue, "PI", dropped, requestKeyframe), "PPSI");
+
+  // Only fragments queued: the incoming one is given up and an IDR requested
+  queue.clear();
+  policy.reset();
+  requestKeyframe = false;
+  EXPECT_EQ(offer(policy, queue, "FFFFFFFFF", dropped, requestKeyframe), "FFFFFFFF");
+  EXPECT_TRUE(requestKeyframe);
+}
+
+// TC-PROJ-043 - Adaptive Video Mode
+TEST_F(ProjectionTest, VideoModeLadderCeilingsAndAdaptation) {
+  using aap_protobuf::service::media::sink::message::VideoCodecResolutionType;
+  using aap_protobuf::service::media::sink::message::VideoFrameRateType;
+  ON_CALL(*mockConfiguration, getVideoResolution()).WillByDefault(Return(VideoCodecResolutionType::VIDEO_1920x1080));
+  ON_CALL(*mockConfiguration, getVideoFPS()).WillByDefault(Return(VideoFrameRateType::VIDEO_FPS_60));
+  ON_CALL(*mockConfiguration, getVideoAdaptiveMode()).WillByDefault(Return(true));
+  VideoModeSelector selector(mockConfiguration, QSize(1280, 720));
+
+  // The configured mode, then every cheaper one by pixel rate
+  const std::vector<VideoMode> ladder = selector.modes();
+  ASSERT_EQ(ladder.size(), 6u);
+  EXPECT_EQ(ladder[1].resolution, VideoCodecResolutionType::VIDEO_1920x1080);
+  EXPECT_EQ(ladder[1].fps, VideoFrameRateType::VIDEO_FPS_30);
+  EXPECT_EQ(ladder[2].resolution, VideoCodecResolutionType::VIDEO_1280x720);
+  EXPECT_EQ(ladder[5].resolution, VideoCodecResolutionType::VIDEO_800x480);
+  for (size_t i = 1; i < ladder.size(); ++i) {
+    EXPECT_LT(VideoModeSelector::pixelRate(ladder[i]), VideoModeSelector::pixelRate(ladder[i - 1]));
+  }
+  ON_CALL(*mockConfiguration, getVideoResolution()).WillByDefault(Return(VideoCodecResolutionType::VIDEO_1280x720));
+  const std::vector<VideoMode> from720 = selector.modes();
+  ASSERT_EQ(from720.size(), 4u);
+  EXPECT_EQ(from720[1].fps, VideoFrameRateType::VIDEO_FPS_30);
+  ON_CALL(*mockConfiguration, getVideoAdaptiveMode()).WillByDefault(Return(false));
+  EXPECT_EQ(selector.modes().size(), 1u);
+  ON_CALL(*mockConfiguration, getVideoResolution()).WillByDefault(Return(VideoCodecResolutionType::VIDEO_1920x1080));
+  ON_CALL(*mockConfiguration, getVideoAdaptiveMode()).WillByDefault(Return(true));
+
+  // Ceilings: a mode per thermal step, then CMA, then the WiFi link
+  EXPECT_EQ(VideoModeSelector::applyCeilings(ladder, 0, 0, -1, 0), 0u);
+  EXPECT_EQ(VideoModeSelector::applyCeilings(ladder, 1, 2, -1, 0), 3u);
+  EXPECT_EQ(VideoModeSelector::applyCeilings(ladder, 4, 2, -1, 0), 5u);
+  const int64_t fits720 = CmaBudget::hardwareBytes(1280, 720, 1) * 2;
+  EXPECT_EQ(VideoModeSelector::applyCeilings(ladder, 0, 0, fits720, 0), 2u);
+  EXPECT_EQ(VideoModeSelector::applyCeilings(ladder, 0, 0, 0, 0), 5u);
+  const int64_t carries720p60 = VideoModeSelector::streamKbps(ladder[2]);
+  EXPECT_EQ(VideoModeSelector::applyCeilings(ladder, 0, 0, -1, carries720p60), 2u);
+  EXPECT_EQ(VideoModeSelector::applyCeilings(ladder, 3, 0, -1, carries720p60), 3u);
+
+  if (selector.selectedIndex() != 0) {
+    GTEST_SKIP() << "CMA or WiFi of this host caps the mode";
+  }
+  ThermalGovernor &thermal = ThermalGovernor::instance();
+  const auto coolDown = [&thermal]() {
+    for (int i = 0; i < 2 * ThermalGovernor::cRecoverySamples; ++i) {
+      thermal.update(ThermalReading{40000, false});
+    }
+  };
+  const auto session = [](int64_t p99Us) {
+    VideoTelemetrySnapshot snapshot;
+    snapshot.decode.samples = 600;
+    snapshot.decode.p99Us = p99Us;
+    snapshot.framesDisplayed = 600;
+    return snapshot;
+  };
+
+  // Overloaded 1080p60 steps down; plenty of headroom at 1080p30 steps back
+  EXPECT_EQ(selector.serveSession(), 0u);
+  selector.endSession(session(16000));
+  EXPECT_EQ(selector.selectedIndex(), 1u);
+  EXPECT_EQ(selector.serveSession(), 1u);
+  selector.endSession(session(5000));
+  EXPECT_EQ(selector.selectedIndex(), 0u);
+  // Too short to say anything
+  selector.serveSession();
+  VideoTelemetrySnapshot brief = session(30000);
+  brief.decode.samples = 10;
+  selector.endSession(brief);
+  EXPECT_EQ(selector.selectedIndex(), 0u);
+
+  // A hot session ran 720p60, two below the learned mode: the overload is
+  // judged against it and the next mode down from there is learned
+  thermal.update(ThermalReading{95000, false});
+  ASSERT_EQ(thermal.level(), ThermalLevel::Hot);
+  EXPECT_EQ(selector.serveSession(), 2u);
+  coolDown();
+  ASSERT_EQ(thermal.level(), ThermalLevel::Normal);
+  selector.endSession(session(16000));
+  EXPECT_EQ(selector.selectedIndex(), 3u);
+
+  // Headroom climbs back one mode a session, up to 1080p30. A warm session
+  // served 720p60 instead: its headroom does not lift the learned mode
+  EXPECT_EQ(selector.serveSession(), 3u);
+  selector.endSession(session(2000));
+  EXPECT_EQ(selector.serveSession(), 2u);
+  selector.endSession(session(2000));
+  EXPECT_EQ(selector.serveSession(), 1u);
+  thermal.update(ThermalReading{85000, false});
+  ASSERT_EQ(thermal.level(), ThermalLevel::Warm);
+  EXPECT_EQ(selector.serveSession(), 2u);
+  coolDown();
+  selector.endSession(session(2000));
+  EXPECT_EQ(selector.selectedIndex(), 1u);
+}
+
+} // namespace f1x::openauto::autoapp::projection
@@ -1,11 +1,60 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
 #include <memory>
+#include <sstream>
+#include <thread>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <boost/asio.hpp>
+#include <QTemporaryDir>
+#include <openssl/evp.h>
+#include <google/protobuf/struct.pb.h>
+
+#include <f1x/openauto/autoapp/Allocation.hpp>
+#include <f1x/openauto/autoapp/AmbientLight.hpp>
+#include <f1x/openauto/autoapp/FlightRecorder.hpp>
+#include <f1x/openauto/autoapp/IdleMode.hpp>
+#include <f1x/openauto/autoapp/LinkQuality.hpp>
+#include <f1x/openauto/autoapp/NavigationState.hpp>
+#include <f1x/openauto/autoapp/PipelineTrace.hpp>
+#include <f1x/openauto/autoapp/PhoneStatus.hpp>
+#include <f1x/openauto/autoapp/PowerProfile.hpp>
+#include <f1x/openauto/autoapp/StartupGraph.hpp>
+#include <f1x/openauto/autoapp/StateBus.hpp>
+#include <f1x/openauto/autoapp/StrandMonitor.hpp>
+#include <f1x/openauto/autoapp/TcpTuning.hpp>
+#include <f1x/openauto/autoapp/ThermalGovernor.hpp>
+#include <f1x/openauto/autoapp/UpdateStream.hpp>
+#include <f1x/openauto/autoapp/Player/MediaLibrary.hpp>
+#include <f1x/openauto/autoapp/Player/SearchIndex.hpp>
+#include <f1x/openauto/Common/Log.hpp>
 
 #include <f1x/openauto/autoapp/Service/AndroidAutoEntity.hpp>
 #include <f1x/openauto/autoapp/Service/ServiceFactory.hpp>
+#include <f1x/openauto/autoapp/Service/MessageArena.hpp>
 #include <f1x/openauto/autoapp/Service/Pinger.hpp>
+#include <f1x/openauto/autoapp/Service/PipelinedUSBTransport.hpp>
+#include <f1x/openauto/autoapp/Service/PooledMessageInStream.hpp>
+#include <f1x/openauto/autoapp/Service/PriorityMessenger.hpp>
+#include <f1x/openauto/autoapp/Service/ShutdownCoordinator.hpp>
+#include <f1x/openauto/autoapp/Service/GenericNotification/NotificationQueue.hpp>
+#include <f1x/openauto/autoapp/Service/InputSource/TouchPredictor.hpp>
+#include <f1x/openauto/autoapp/Service/MediaBrowser/BrowseCache.hpp>
+#include <f1x/openauto/autoapp/Service/Radio/StationScanner.hpp>
+#include <f1x/openauto/autoapp/Service/Sensor/CanSensorSource.hpp>
+#include <f1x/openauto/autoapp/Service/Sensor/ObdSensorSource.hpp>
+#include <f1x/openauto/autoapp/Service/Sensor/SensorRateLimiter.hpp>
+#include <f1x/openauto/autoapp/Service/Sensor/SunSchedule.hpp>
+#include <f1x/openauto/autoapp/Service/VendorExtension/PluginBridge.hpp>
 #include "../../mocks/MockConfiguration.hpp"
 #include "../../mocks/MockAndroidAutoEntity.hpp"
 
@@ -271,4 +320,1556 @@ TEST_F(ServiceTest, PingMechanism) {
     }
 }
 
-} // namespace f1x::openauto::autoapp::service
\ No newline at end of file
+// TC-AAP-006 - Vehicle Sensor Decoding and Pacing
+TEST(VehicleSensorTest, CanObdDecodingAndRateLimiting) {
+    using namespace sensor;
+
+    std::vector<CanSignal> signals;
+    EXPECT_TRUE(CanSensorSource::parseSignals("speed@0x3e9:0:2:0.01, gear@1008:2:1", signals));
+    ASSERT_EQ(signals.size(), 2u);
+    EXPECT_EQ(signals[0].id, 0x3e9u);
+    EXPECT_FALSE(CanSensorSource::parseSignals("speed@0x3e9:7:2 bogus@1:0:1", signals));
+    EXPECT_TRUE(signals.empty());
+
+    // 0x2710 * 0.01 = 100 km/h
+    ASSERT_TRUE(CanSensorSource::parseSignals("speed@0x3e9:0:2:0.01", signals));
+    const uint8_t frame[] = {0x27, 0x10};
+    VehicleReading reading;
+    ASSERT_TRUE(CanSensorSource::decode(signals[0], frame, sizeof(frame), reading));
+    EXPECT_EQ(reading.values[0], 27778);
+    EXPECT_FALSE(CanSensorSource::decode(signals[0], frame, 1, reading));
+
+    std::vector<uint8_t> data;
+    EXPECT_TRUE(ObdSensorSource::parseResponse("SEARCHING...\r41 0D 3C\r\r", 0x0D, data));
+    EXPECT_EQ(data, std::vector<uint8_t>{0x3C});
+    EXPECT_FALSE(ObdSensorSource::parseResponse("NO DATA\r", 0x0D, data));
+
+    // Held until requested, then paced to the period and deduplicated
+    SensorRateLimiter limiter;
+    const auto t0 = SensorRateLimiter::Clock::now();
+    VehicleReading speed;
+    speed.sensor = VehicleSensor::Speed;
+    speed.values[0] = 10000;
+    limiter.offer(speed, t0);
+    EXPECT_TRUE(limiter.collect(t0).empty());
+    limiter.request(VehicleSensor::Speed, std::chrono::milliseconds(100));
+    EXPECT_EQ(limiter.collect(t0).size(), 1u);
+
+    speed.values[0] = 12000;
+    limiter.offer(speed, t0 + std::chrono::milliseconds(10));
+    EXPECT_TRUE(limiter.collect(t0 + std::chrono::milliseconds(50)).empty());
+    EXPECT_EQ(limiter.nextDue(), t0 + std::chrono::milliseconds(100));
+    EXPECT_EQ(limiter.collect(t0 + std::chrono::milliseconds(100)).size(), 1u);
+
+    // Within the dead band of what was sent
+    speed.values[0] = 12050;
+    limiter.offer(speed, t0 + std::chrono::milliseconds(300));
+    EXPECT_TRUE(limiter.collect(t0 + std::chrono::milliseconds(300)).empty());
+    EXPECT_EQ(limiter.nextDue(), SensorRateLimiter::Clock::time_point::max());
+}
+
+// TC-AAP-007 - Link Quality Estimation
+TEST(LinkQualityTest, SmoothsRoundTripAndFlagsSpikes) {
+    LinkQuality link;
+    EXPECT_EQ(link.state(), LinkState::Unknown);
+
+    // First sample seeds srtt and rttvar = rtt / 2
+    EXPECT_FALSE(link.addSample(8000));
+    EXPECT_EQ(link.rttUs(), 8000);
+    EXPECT_EQ(link.jitterUs(), 4000);
+    EXPECT_EQ(link.state(), LinkState::Good);
+
+    for (int i = 0; i < 50; ++i) {
+        EXPECT_FALSE(link.addSample(10000));
+    }
+    EXPECT_NEAR(link.rttUs(), 10000, 100);
+    EXPECT_LT(link.jitterUs(), 1000);
+
+    // Well past srtt + 4 * rttvar, but one sample only nudges the average
+    EXPECT_TRUE(link.addSample(400000));
+    EXPECT_LT(link.rttUs(), 100000);
+    EXPECT_EQ(link.state(), LinkState::Degraded); // rttvar takes a quarter of the error
+
+    EXPECT_EQ(LinkQuality::classify(30000, 5000), LinkState::Good);
+    EXPECT_EQ(LinkQuality::classify(120000, 5000), LinkState::Degraded);
+    EXPECT_EQ(LinkQuality::classify(30000, 150000), LinkState::Poor);
+
+    link.reset();
+    EXPECT_EQ(link.state(), LinkState::Unknown);
+    EXPECT_EQ(link.rttUs(), 0);
+}
+
+// TC-AAP-008 - Navigation State Serialization
+TEST(NavigationStateTest, RoundTripsAndFormatsDistance) {
+    NavigationState state;
+    state.status = NavigationState::Status::Active;
+    state.maneuver = NavigationState::Maneuver::RoundaboutEnterAndExit;
+    state.side = NavigationState::Side::Left;
+    state.roundaboutExit = 2;
+    state.turnAngle = 135;
+    state.road = "Rue de l'\u00c9glise; A=B\\C\nnext";
+    state.distanceMeters = 1240;
+    state.timeToTurnSeconds = 75;
+    state.displayDistanceE3 = 1200;
+    state.displayUnit = NavigationState::Unit::Kilometers;
+
+    // Separators in the road name must not split the line
+    const std::string line = state.serialize();
+    EXPECT_EQ(line.find('\n'), std::string::npos);
+    NavigationState parsed;
+    ASSERT_TRUE(NavigationState::parse(line, parsed));
+    EXPECT_EQ(parsed, state);
+    EXPECT_EQ(parsed.displayDistance(), "1.2");
+    EXPECT_STREQ(parsed.displayUnitName(), "km");
+
+    // Unknown keys from newer writers are skipped; other text is rejected
+    EXPECT_TRUE(NavigationState::parse(line + ";lanes=3", parsed));
+    EXPECT_EQ(parsed, state);
+    EXPECT_FALSE(NavigationState::parse("1", parsed));
+    EXPECT_FALSE(NavigationState::parse("", parsed));
+
+    NavigationState meters;
+    meters.displayDistanceE3 = 300000;
+    meters.displayUnit = NavigationState::Unit::Meters;
+    EXPECT_EQ(meters.displayDistance(), "300");
+    EXPECT_STREQ(meters.displayUnitName(), "m");
+    meters.displayDistanceE3 = -1;
+    EXPECT_EQ(meters.displayDistance(), "");
+    meters.distanceMeters = 2550;
+    EXPECT_EQ(meters.displayDistance(), "2.5");
+    EXPECT_STREQ(meters.displayUnitName(), "km");
+
+    // Long road names are cut on a character boundary
+    state.road = std::string(NavigationState::cMaxRoadLength - 1, 'a') + "\u00e9\u00e9";
+    ASSERT_TRUE(NavigationState::parse(state.serialize(), parsed));
+    EXPECT_EQ(parsed.road, std::string(NavigationState::cMaxRoadLength - 1, 'a'));
+}
+
+// TC-AAP-009 - Notification Coalescing
+TEST(NotificationQueueTest, MergesByIdAndLimitsBursts) {
+    using namespace genericnotification;
+    using std::chrono::milliseconds;
+
+    NotificationQueue queue(3, 2, milliseconds(1000), milliseconds(5000));
+    const auto t0 = NotificationQueue::Clock::now();
+
+    queue.offer({"chat", "Family", "one"});
+    EXPECT_EQ(queue.nextDue(), NotificationQueue::Clock::time_point::min());
+    ASSERT_TRUE(queue.collect(t0));
+    ASSERT_EQ(queue.shown().size(), 1u);
+
+    // A burst from one chat folds into its toast, whatever the rate
+    for (int i = 0; i < 30; i++) {
+        queue.offer({"chat", "Family", "message " + std::to_string(i)});
+    }
+    queue.offer({"mail", "Inbox", "hello"});
+    ASSERT_TRUE(queue.collect(t0 + milliseconds(10)));
+    ASSERT_EQ(queue.shown().size(), 2u);
+    EXPECT_EQ(queue.shown()[0].notification.id, "chat");
+    EXPECT_EQ(queue.shown()[0].notification.text, "message 29");
+    EXPECT_EQ(queue.shown()[0].count, 31u);
+    EXPECT_EQ(queue.shown()[1].notification.id, "mail");
+
+    // Two publishes per second: the third waits for the window
+    queue.offer({"chat", "Family", "later"});
+    EXPECT_FALSE(queue.collect(t0 + milliseconds(20)));
+    EXPECT_EQ(queue.shown()[0].notification.text, "message 29");
+    EXPECT_EQ(queue.nextDue(), t0 + milliseconds(1000));
+    ASSERT_TRUE(queue.collect(t0 + milliseconds(1000)));
+    EXPECT_EQ(queue.shown()[0].notification.text, "later");
+
+    // Bounded: new ids push the oldest toast off, and held ones beyond that are dropped
+    for (int i = 0; i < 5; i++) {
+        queue.offer({"sms" + std::to_string(i), "", "text"});
+    }
+    EXPECT_EQ(queue.dropped(), 2u);
+    ASSERT_TRUE(queue.collect(t0 + milliseconds(1500)));
+    ASSERT_EQ(queue.shown().size(), 3u);
+    EXPECT_EQ(queue.shown()[0].notification.id, "sms2");
+
+    EXPECT_TRUE(queue.dismiss("sms3"));
+    EXPECT_FALSE(queue.dismiss("sms3"));
+    EXPECT_EQ(queue.nextDue(), t0 + milliseconds(6500));
+    EXPECT_TRUE(queue.collect(t0 + milliseconds(6500)));
+    EXPECT_TRUE(queue.shown().empty());
+    EXPECT_EQ(queue.nextDue(), NotificationQueue::Clock::time_point::max());
+}
+
+// TC-AAP-010 - Phone Status Snapshot
+TEST(PhoneStatusTest, DiffsFieldsAndRoundTrips) {
+    PhoneStatus status;
+    status.signalStrength = 3;
+    status.batteryLevel = 81;
+    status.call = PhoneStatus::Call::Incoming;
+    status.caller = "Alice, mobile";
+
+    PhoneStatus parsed;
+    ASSERT_TRUE(PhoneStatus::parse(status.serialize(), parsed));
+    EXPECT_EQ(parsed, status);
+    EXPECT_TRUE(parsed.inCall());
+    EXPECT_FALSE(PhoneStatus::parse("3,81", parsed));
+    EXPECT_FALSE(PhoneStatus::parse("", parsed));
+
+    // Only the group that changed is reported
+    PhoneStatus next = status;
+    next.batteryLevel = 80;
+    EXPECT_EQ(next.diff(status), static_cast<uint32_t>(PhoneStatus::Battery));
+    next.batteryCritical = true;
+    next.call = PhoneStatus::Call::InCall;
+    EXPECT_EQ(next.diff(status), static_cast<uint32_t>(PhoneStatus::Battery | PhoneStatus::CallState));
+    EXPECT_EQ(PhoneStatus().diff(PhoneStatus()), 0u);
+
+    // The caller ends the line: no newlines, and cut on a character boundary
+    status.caller = std::string(PhoneStatus::cMaxCallerLength - 1, 'a') + "\u00e9\nrest";
+    ASSERT_TRUE(PhoneStatus::parse(status.serialize(), parsed));
+    EXPECT_EQ(parsed.caller, std::string(PhoneStatus::cMaxCallerLength - 1, 'a'));
+}
+
+// TC-AAP-011 - Radio Station Scanning
+TEST(StationScannerTest, PicksPeaksAndCachesPerRegion) {
+    radio::RadioBand band;
+    ASSERT_TRUE(radio::RadioBand::forRegion("US", band));
+    EXPECT_EQ(band.spacingKhz, 200u);
+    EXPECT_EQ(band.snap(98050), 98100u);
+    EXPECT_EQ(band.snap(120000), band.maxKhz);
+    EXPECT_FALSE(radio::RadioBand::forRegion("XX", band));
+    ASSERT_TRUE(radio::RadioBand::forRegion("", band));
+    EXPECT_EQ(band.minKhz, 87500u);
+
+    // One transmitter bleeds into its neighbours; a plateau is listed once
+    // and weak channels not at all
+    const std::vector<radio::RadioStation> sweep = {
+        {87500, 10}, {87600, 40}, {87700, 75}, {87800, 50}, {87900, 12},
+        {88000, 60}, {88100, 60}, {88200, 20}, {88300, 25}, {88400, 29}};
+    const std::vector<radio::RadioStation> expected = {{87700, 75}, {88000, 60}};
+    EXPECT_EQ(radio::StationScanner::pick(sweep, 100), expected);
+
+    const auto path = radio::StationScanner::cachePath(
+        "/tmp/openauto-test-" + std::to_string(::getpid()) + "/radio", "US");
+    std::vector<radio::RadioStation> loaded;
+    EXPECT_FALSE(radio::StationScanner::load(path, loaded));
+    ASSERT_TRUE(radio::StationScanner::save(path, expected));
+    ASSERT_TRUE(radio::StationScanner::load(path, loaded));
+    EXPECT_EQ(loaded, expected);
+    std::remove(path.c_str());
+}
+
+// TC-AAP-012 - Thermal Governor
+TEST(ThermalGovernorTest, StepsUpAtOnceAndDownWithHysteresis) {
+    char base[] = "/tmp/thermal-test-XXXXXX";
+    ASSERT_NE(mkdtemp(base), nullptr);
+    const std::string root(base);
+    const std::vector<std::string> directories = {
+        "/class", "/class/thermal", "/class/thermal/thermal_zone0", "/class/thermal/thermal_zone1",
+        "/class/devfreq", "/class/devfreq/dmc"};
+    for (const auto &directory : directories) {
+        ASSERT_EQ(mkdir((root + directory).c_str(), 0755), 0);
+    }
+    const auto write = [&root](const std::string &file, long value) {
+        std::ofstream(root + file) << value << "\n";
+    };
+    write("/class/thermal/thermal_zone0/temp", 61000);
+    write("/class/thermal/thermal_zone1/temp", 67000);
+    write("/class/devfreq/dmc/max_freq", 600000000);
+
+    ThermalGovernor governor(root);
+    ThermalReading reading = governor.read();
+    EXPECT_EQ(reading.hottestMilliC, 67000);
+    EXPECT_FALSE(reading.clocksCapped); // the first reading is the ceiling
+
+    // DDR held below its ceiling is a warm board, whatever the zones say
+    write("/class/devfreq/dmc/max_freq", 400000000);
+    reading = governor.read();
+    EXPECT_TRUE(reading.clocksCapped);
+    EXPECT_EQ(governor.update(reading), ThermalLevel::Warm);
+
+    // Straight to hot, then down one level at a time, each after
+    // cRecoverySamples readings well below its threshold
+    EXPECT_EQ(governor.update({ThermalGovernor::cHotMilliC, false}), ThermalLevel::Hot);
+    const ThermalReading justBelow{ThermalGovernor::cHotMilliC - 1000, false};
+    for (int i = 0; i < 2 * ThermalGovernor::cRecoverySamples; ++i) {
+        EXPECT_EQ(governor.update(justBelow), ThermalLevel::Hot);
+    }
+    const ThermalReading cooler{ThermalGovernor::cWarmMilliC, false};
+    for (int i = 1; i < ThermalGovernor::cRecoverySamples; ++i) {
+        EXPECT_EQ(governor.update(cooler), ThermalLevel::Hot);
+    }
+    EXPECT_EQ(governor.update(cooler), ThermalLevel::Warm);
+    EXPECT_EQ(governor.level(), ThermalLevel::Warm);
+
+    // A capped clock in between starts the count over
+    const ThermalReading cool{50000, false};
+    for (int i = 1; i < ThermalGovernor::cRecoverySamples; ++i) {
+        governor.update(cool);
+    }
+    EXPECT_EQ(governor.update({50000, true}), ThermalLevel::Warm);
+    for (int i = 1; i < ThermalGovernor::cRecoverySamples; ++i) {
+        EXPECT_EQ(governor.update(cool), ThermalLevel::Warm);
+    }
+    EXPECT_EQ(governor.update(cool), ThermalLevel::Normal);
+
+    std::remove((root + "/class/thermal/thermal_zone0/temp").c_str());
+    std::remove((root + "/class/thermal/thermal_zone1/temp").c_str());
+    std::remove((root + "/class/devfreq/dmc/max_freq").c_str());
+    for (auto directory = directories.rbegin(); directory != directories.rend(); ++directory) {
+        rmdir((root + *directory).c_str());
+    }
+    rmdir(root.c_str());
+}
+
+// TC-AAP-013 - Power Profiles
+TEST(PowerProfileTest, SwitchesGovernorsAndFloorsAndRestoresThem) {
+    char base[] = "/tmp/power-test-XXXXXX";
+    ASSERT_NE(mkdtemp(base), nullptr);
+    const std::string root(base);
+    const std::string policy = "/devices/system/cpu/cpufreq/policy0";
+    const std::string dmc = "/class/devfreq/ff520000.dmc";
+    const std::string gpu = "/class/devfreq/ff300000.gpu";
+    const std::vector<std::string> directories = {
+        "/devices", "/devices/system", "/devices/system/cpu", "/devices/system/cpu/cpufreq",
+        policy, "/class", "/class/devfreq", dmc, gpu};
+    for (const auto &directory : directories) {
+        ASSERT_EQ(mkdir((root + directory).c_str(), 0755), 0);
+    }
+    const std::vector<std::pair<std::string, std::string>> nodes = {
+        {policy + "/scaling_governor", "schedutil"},
+        {policy + "/scaling_available_governors", "performance powersave schedutil"},
+        {policy + "/scaling_min_freq", "400000"},
+        {policy + "/scaling_available_frequencies", "400000 600000 816000 1008000 1200000"},
+        {policy + "/cpuinfo_max_freq", "1200000"},
+        {dmc + "/governor", "simple_ondemand"},
+        {dmc + "/available_governors", "simple_ondemand performance"},
+        {dmc + "/min_freq", "200000000"},
+        {dmc + "/available_frequencies", "200000000 330000000 400000000 534000000 600000000"},
+        {dmc + "/max_freq", "600000000"},
+        {gpu + "/governor", "simple_ondemand"},
+        {gpu + "/available_governors", "simple_ondemand performance"}};
+    for (const auto &node : nodes) {
+        std::ofstream(root + node.first) << node.second << "\n";
+    }
+    const auto read = [&root](const std::string &file) {
+        std::ifstream in(root + file);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    };
+
+    {
+        PowerProfile profile("dmc,vdec", root);
+        // The GPU is left to the UI
+        EXPECT_EQ(profile.domains(), (std::vector<std::string>{"policy0", "ff520000.dmc"}));
+
+        profile.apply(PowerProfileMode::Performance);
+        EXPECT_EQ(read(policy + "/scaling_governor"), "performance");
+        EXPECT_EQ(read(dmc + "/governor"), "performance");
+        EXPECT_EQ(read(gpu + "/governor"), "simple_ondemand");
+
+        // The booted governors, kept above half the top clock
+        profile.apply(PowerProfileMode::Floor);
+        EXPECT_EQ(read(policy + "/scaling_governor"), "schedutil");
+        EXPECT_EQ(read(policy + "/scaling_min_freq"), "600000");
+        EXPECT_EQ(read(dmc + "/governor"), "simple_ondemand");
+        EXPECT_EQ(read(dmc + "/min_freq"), "330000000");
+
+        // The DMC has no powersave governor and keeps its own
+        profile.apply(PowerProfileMode::Powersave);
+        EXPECT_EQ(read(policy + "/scaling_governor"), "powersave");
+        EXPECT_EQ(read(policy + "/scaling_min_freq"), "400000");
+        EXPECT_EQ(read(dmc + "/governor"), "simple_ondemand");
+        EXPECT_EQ(profile.mode(), PowerProfileMode::Powersave);
+    }
+    // Destroyed: what the board booted with
+    EXPECT_EQ(read(policy + "/scaling_governor"), "schedutil");
+    EXPECT_EQ(read(dmc + "/min_freq"), "200000000");
+
+    PowerProfileMode mode = PowerProfileMode::Performance;
+    EXPECT_TRUE(parsePowerProfile("floor", mode));
+    EXPECT_EQ(mode, PowerProfileMode::Floor);
+    EXPECT_FALSE(parsePowerProfile("turbo", mode));
+    EXPECT_EQ(mode, PowerProfileMode::Default);
+
+    for (const auto &node : nodes) {
+        std::remove((root + node.first).c_str());
+    }
+    for (auto directory = directories.rbegin(); directory != directories.rend(); ++directory) {
+        rmdir((root + *directory).c_str());
+    }
+    rmdir(root.c_str());
+}
+
+// TC-AAP-014 - Pipeline Trace
+TEST(PipelineTraceTest, RecordsScopesPerThreadOnlyWhileStarted) {
+    auto &trace = PipelineTrace::instance();
+    { TraceScope scope("before.start"); }
+
+    trace.start();
+    { TraceScope scope("main.scope"); }
+    std::thread worker([]() {
+        pthread_setname_np(pthread_self(), "trace-worker");
+        for (size_t i = 0; i < PipelineTrace::cEventsPerThread + 10; ++i) {
+            TraceScope scope("worker.scope");
+        }
+    });
+    worker.join();
+    trace.stop();
+    { TraceScope scope("after.stop"); }
+
+    std::ostringstream out;
+    // The worker's ring kept its newest events only
+    EXPECT_EQ(trace.dump(out), PipelineTrace::cEventsPerThread + 1);
+    const std::string json = out.str();
+    EXPECT_EQ(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0), 0u);
+    EXPECT_NE(json.find("\"name\":\"main.scope\""), std::string::npos);
+    EXPECT_NE(json.find("\"args\":{\"name\":\"trace-worker\"}"), std::string::npos);
+    EXPECT_EQ(json.find("before.start"), std::string::npos);
+    EXPECT_EQ(json.find("after.stop"), std::string::npos);
+
+    // A new trace starts empty, and the exited worker's ring is dropped
+    trace.start();
+    trace.stop();
+    std::ostringstream empty;
+    EXPECT_EQ(trace.dump(empty), 0u);
+    EXPECT_EQ(empty.str().find("trace-worker"), std::string::npos);
+}
+
+// TC-AAP-015 - Strand Monitor
+TEST(StrandMonitorTest, TimesQueueAndRunAndCountsLongTasks) {
+    auto &monitor = StrandMonitor::instance();
+    auto &site = monitor.site("test.handler");
+    auto &timerSite = monitor.site("test.timer");
+    const uint64_t runs = site.runMs.count();
+    const uint64_t queued = site.queueMs.count();
+    const uint64_t longTasks = site.longTasks.value();
+
+    boost::asio::io_service ioService;
+    boost::asio::io_service::strand strand(ioService);
+    boost::asio::deadline_timer timer(ioService);
+
+    // Off: the handler still runs, untimed
+    int ran = 0;
+    strand.dispatch(monitored(site, [&ran]() { ++ran; }));
+    ioService.run();
+    ioService.restart();
+    EXPECT_EQ(ran, 1);
+    EXPECT_EQ(site.runMs.count(), runs);
+
+    monitor.configure(true, 5);
+    // The second waits for the first, which is a long task
+    strand.post(monitored(site, [&ran]() {
+        ++ran;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }));
+    strand.post(monitored(site, [&ran]() { ++ran; }));
+    timer.expires_from_now(boost::posix_time::milliseconds(1));
+    timer.async_wait(strand.wrap(monitoredCompletion(timerSite, [&ran](const boost::system::error_code &error) {
+        if (!error) {
+            ++ran;
+        }
+    })));
+    ioService.run();
+    monitor.configure(false, 20);
+
+    EXPECT_EQ(ran, 4);
+    EXPECT_EQ(site.runMs.count(), runs + 2);
+    EXPECT_EQ(site.queueMs.count(), queued + 2);
+    EXPECT_EQ(site.longTasks.value(), longTasks + 1);
+    EXPECT_GE(site.queueMs.sum(), 10.0);
+    // A timer's wait is not queueing
+    EXPECT_EQ(timerSite.runMs.count(), 1u);
+    EXPECT_EQ(timerSite.queueMs.count(), 0u);
+    EXPECT_EQ(&monitor.site("test.handler"), &site);
+}
+
+// TC-AAP-016 - Flight Recorder
+TEST(FlightRecorderTest, NextOpenDecodesTheEventsOfAnUncleanRun) {
+    char path[] = "/tmp/flight-test-XXXXXX";
+    const int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    {
+        // Never closed, as if the process had died
+        FlightRecorder crashed;
+        ASSERT_TRUE(crashed.open(path));
+        EXPECT_TRUE(crashed.previousRun().empty());
+        crashed.record(FlightEvent::SessionStarted, 0);
+        for (uint32_t i = 0; i < FlightRecorder::cCapacity; ++i) {
+            crashed.record(FlightEvent::Touch, 1, static_cast<int32_t>(i));
+        }
+        crashed.record(FlightEvent::DecoderError, -11);
+        crashed.flush();
+
+        FlightRecorder next;
+        ASSERT_TRUE(next.open(path));
+        // The ring kept the newest cCapacity events
+        ASSERT_EQ(next.previousRun().size(), FlightRecorder::cCapacity);
+        EXPECT_NE(next.previousRun().front().find("touch 1 1"), std::string::npos);
+        EXPECT_NE(next.previousRun().back().find("decoder-error -11 0"), std::string::npos);
+        next.record(FlightEvent::SessionStopped);
+        next.close();
+        // Off once closed
+        next.record(FlightEvent::Signal, 11);
+    }
+
+    FlightRecorder clean;
+    ASSERT_TRUE(clean.open(path));
+    EXPECT_TRUE(clean.previousRun().empty());
+    clean.close();
+
+    std::ifstream text(std::string(path) + ".last-crash.txt");
+    std::string pid;
+    std::getline(text, pid);
+    EXPECT_EQ(pid.rfind("pid ", 0), 0u);
+    std::remove((std::string(path) + ".last-crash.txt").c_str());
+    std::remove(path);
+}
+
+// TC-AAP-017 - Wireless TCP Tuning
+TEST(TcpTuningTest, AcceptedClientGetsTheConfiguredOptions) {
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::acceptor acceptor(ioService, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    boost::asio::ip::tcp::socket client(ioService);
+    client.connect(acceptor.local_endpoint());
+    boost::asio::ip::tcp::socket server(ioService);
+    acceptor.accept(server);
+
+    TcpTuningSettings settings;
+    settings.receiveBufferBytes = 256 * 1024;
+    settings.dscp = 46;
+    auto &tuning = TcpTuning::instance();
+    tuning.configure(settings);
+    const int fd = server.native_handle();
+    EXPECT_EQ(tuning.apply(fd), 0);
+
+    int value = 0;
+    socklen_t length = sizeof(value);
+    ASSERT_EQ(getsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &value, &length), 0);
+    EXPECT_EQ(value, 1);
+    ASSERT_EQ(getsockopt(fd, IPPROTO_IP, IP_TOS, &value, &length), 0);
+    EXPECT_EQ(value >> 2, 46);
+    // The kernel doubles what it grants, for its own bookkeeping
+    ASSERT_EQ(getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &value, &length), 0);
+    EXPECT_GE(value, 256 * 1024);
+
+    EXPECT_TRUE(tuning.sample(fd));
+    server.close();
+    EXPECT_FALSE(tuning.sample(fd));
+    tuning.configure(TcpTuningSettings());
+}
+
+// TC-AAP-018 - Pipelined USB Transport
+class FakeUsbEndpoint : public aasdk::usb::IUSBEndpoint {
+public:
+    MOCK_METHOD(uint8_t, getAddress, (), (override));
+    MOCK_METHOD(void, controlTransfer, (aasdk::common::DataBuffer buffer, uint32_t timeout, Promise::Pointer promise), (override));
+    MOCK_METHOD(void, interruptTransfer, (aasdk::common::DataBuffer buffer, uint32_t timeout, Promise::Pointer promise), (override));
+    MOCK_METHOD(aasdk::usb::DeviceHandle, getDeviceHandle, (), (const, override));
+
+    void bulkTransfer(aasdk::common::DataBuffer buffer, uint32_t, Promise::Pointer promise) override {
+        transfers.emplace_back(buffer, std::move(promise));
+    }
+
+    void cancelTransfers() override {
+        for (auto &transfer : transfers) {
+            transfer.second->reject(aasdk::error::Error(aasdk::error::ErrorCode::OPERATION_ABORTED));
+        }
+        transfers.clear();
+    }
+
+    // Completes the @p index th outstanding transfer with @p text
+    void complete(size_t index, const std::string &text) {
+        auto transfer = transfers[index];
+        transfers.erase(transfers.begin() + static_cast<std::ptrdiff_t>(index));
+        std::copy(text.begin(), text.end(), transfer.first.data);
+        transfer.second->resolve(text.size());
+    }
+
+    std::vector<std::pair<aasdk::common::DataBuffer, Promise::Pointer>> transfers;
+};
+
+class FakeAOAPDevice : public aasdk::usb::IAOAPDevice {
+public:
+    aasdk::usb::IUSBEndpoint &getInEndpoint() override { return in; }
+    aasdk::usb::IUSBEndpoint &getOutEndpoint() override { return out; }
+
+    NiceMock<FakeUsbEndpoint> in;
+    NiceMock<FakeUsbEndpoint> out;
+};
+
+TEST(PipelinedUSBTransportTest, KeepsTransfersQueuedAndDeliversThemInOrder) {
+    boost::asio::io_service ioService;
+    auto device = std::make_shared<FakeAOAPDevice>();
+    auto transport = std::make_shared<PipelinedUSBTransport>(ioService, device, 3, 8);
+
+    std::vector<std::string> received;
+    bool aborted = false;
+    auto receive = [&](size_t size) {
+        auto promise = aasdk::transport::ITransport::ReceivePromise::defer(ioService);
+        promise->then([&](aasdk::common::Data data) { received.emplace_back(data.begin(), data.end()); },
+                      [&](const aasdk::error::Error &error) {
+                          aborted = error.getCode() == aasdk::error::ErrorCode::OPERATION_ABORTED;
+                      });
+        transport->receive(size, std::move(promise));
+        ioService.poll();
+        ioService.restart();
+    };
+
+    receive(4);
+    ASSERT_EQ(device->in.transfers.size(), 3u);
+
+    // The second transfer completing first waits for the first one
+    device->in.complete(1, "efgh");
+    ioService.poll();
+    ioService.restart();
+    EXPECT_TRUE(received.empty());
+    device->in.complete(0, "abcd");
+    ioService.poll();
+    ioService.restart();
+    ASSERT_EQ(received.size(), 1u);
+    EXPECT_EQ(received[0], "abcd");
+    // Both drained buffers are queued again at once
+    EXPECT_EQ(device->in.transfers.size(), 3u);
+
+    receive(4);
+    ASSERT_EQ(received.size(), 2u);
+    EXPECT_EQ(received[1], "efgh");
+
+    receive(4);
+    transport->stop();
+    ioService.poll();
+    EXPECT_TRUE(aborted);
+    EXPECT_EQ(received.size(), 2u);
+}
+
+// TC-AAP-019 - Outbound Message Priority
+TEST(PriorityMessengerTest, SendsInputAheadOfQueuedAcksAndSensorBatches) {
+    using aasdk::messenger::ChannelId;
+    boost::asio::io_service ioService;
+    auto inner = std::make_shared<NiceMock<MockMessenger>>();
+    std::vector<ChannelId> sent;
+    std::vector<aasdk::messenger::SendPromise::Pointer> inFlight;
+    ON_CALL(*inner, enqueueSend(::testing::An<aasdk::messenger::Message>(), _))
+        .WillByDefault([&](aasdk::messenger::Message message, aasdk::messenger::SendPromise::Pointer promise) {
+            sent.push_back(message.getChannelId());
+            inFlight.push_back(std::move(promise));
+        });
+    auto messenger = std::make_shared<PriorityMessenger>(ioService, inner);
+
+    int resolved = 0;
+    auto send = [&](ChannelId channelId) {
+        auto promise = aasdk::messenger::SendPromise::defer(ioService);
+        promise->then([&]() { ++resolved; }, [](const aasdk::error::Error &) {});
+        messenger->enqueueSend(aasdk::messenger::Message(channelId, aasdk::messenger::EncryptionType::ENCRYPTED,
+                                                         aasdk::messenger::MessageType::SPECIFIC),
+                               std::move(promise));
+    };
+
+    // The first goes straight out; the rest queue behind it
+    send(ChannelId::SENSOR);
+    send(ChannelId::MEDIA_SINK_MEDIA_AUDIO);
+    send(ChannelId::SENSOR);
+    send(ChannelId::INPUT_SOURCE);
+    send(ChannelId::MEDIA_SINK_VIDEO);
+    ioService.poll();
+    ioService.restart();
+    ASSERT_EQ(sent.size(), 1u);
+
+    while (inFlight.size() > static_cast<size_t>(resolved)) {
+        inFlight[static_cast<size_t>(resolved)]->resolve();
+        ioService.poll();
+        ioService.restart();
+    }
+    EXPECT_EQ(resolved, 5);
+    EXPECT_EQ(sent, (std::vector<ChannelId>{ChannelId::SENSOR, ChannelId::INPUT_SOURCE, ChannelId::MEDIA_SINK_VIDEO,
+                                            ChannelId::MEDIA_SINK_MEDIA_AUDIO, ChannelId::SENSOR}));
+    EXPECT_EQ(outboundClassOf(ChannelId::MEDIA_SINK_GUIDANCE_AUDIO), OutboundClass::Audio);
+}
+
+// TC-AAP-020 - Pooled Message Reassembly
+class ScriptedTransport : public aasdk::transport::ITransport {
+public:
+    void receive(size_t size, ReceivePromise::Pointer promise) override {
+        aasdk::common::Data data(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(size));
+        bytes.erase(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(size));
+        promise->resolve(std::move(data));
+    }
+    void send(aasdk::common::Data, SendPromise::Pointer promise) override { promise->resolve(); }
+    void stop() override {}
+
+    void frame(aasdk::messenger::ChannelId channelId, aasdk::messenger::FrameType type, size_t size, uint8_t fill,
+               size_t totalSize = 0) {
+        const auto header = aasdk::messenger::FrameHeader(channelId, type, aasdk::messenger::EncryptionType::PLAIN,
+                                                          aasdk::messenger::MessageType::SPECIFIC).getData();
+        const auto frameSize = type == aasdk::messenger::FrameType::FIRST
+                                   ? aasdk::messenger::FrameSize(size, totalSize).getData()
+                                   : aasdk::messenger::FrameSize(size).getData();
+        bytes.insert(bytes.end(), header.begin(), header.end());
+        bytes.insert(bytes.end(), frameSize.begin(), frameSize.end());
+        bytes.insert(bytes.end(), size, fill);
+    }
+
+    aasdk::common::Data bytes;
+};
+
+TEST(PooledMessageInStreamTest, ReassemblesInterleavedFramesIntoRecycledBuffers) {
+    using aasdk::messenger::ChannelId;
+    using aasdk::messenger::FrameType;
+    boost::asio::io_service ioService;
+    auto transport = std::make_shared<ScriptedTransport>();
+    auto stream = std::make_shared<PooledMessageInStream>(ioService, transport, nullptr);
+
+    auto next = [&]() {
+        aasdk::messenger::Message::Pointer received;
+        auto promise = aasdk::messenger::ReceivePromise::defer(ioService);
+        promise->then([&](aasdk::messenger::Message::Pointer message) { received = std::move(message); },
+                      [](const aasdk::error::Error &) {});
+        stream->startReceive(std::move(promise));
+        ioService.poll();
+        ioService.restart();
+        return received;
+    };
+
+    // A sensor batch between the two halves of a keyframe
+    transport->frame(ChannelId::MEDIA_SINK_VIDEO, FrameType::FIRST, 20000, 'a', 40000);
+    transport->frame(ChannelId::SENSOR, FrameType::BULK, 3, 'x');
+    transport->frame(ChannelId::MEDIA_SINK_VIDEO, FrameType::LAST, 20000, 'b');
+    transport->frame(ChannelId::MEDIA_SINK_VIDEO, FrameType::FIRST, 30000, 'c', 50000);
+    transport->frame(ChannelId::MEDIA_SINK_VIDEO, FrameType::LAST, 20000, 'd');
+
+    auto sensor = next();
+    ASSERT_NE(sensor, nullptr);
+    EXPECT_EQ(sensor->getChannelId(), ChannelId::SENSOR);
+    EXPECT_EQ(sensor->getPayload(), aasdk::common::Data(3, 'x'));
+
+    auto keyframe = next();
+    ASSERT_NE(keyframe, nullptr);
+    ASSERT_EQ(keyframe->getPayload().size(), 40000u);
+    EXPECT_EQ(keyframe->getPayload()[19999], 'a');
+    EXPECT_EQ(keyframe->getPayload()[20000], 'b');
+    const uint8_t *storage = keyframe->getPayload().data();
+    keyframe.reset();
+
+    // The next message of that size class reuses the buffer
+    auto second = next();
+    ASSERT_NE(second, nullptr);
+    EXPECT_EQ(second->getPayload().size(), 50000u);
+    EXPECT_EQ(second->getPayload().data(), storage);
+}
+
+// TC-AAP-021 - Deadline-Bounded Parallel Shutdown
+class StoppingService : public IService {
+public:
+    StoppingService(std::string name, bool devices, bool finishes)
+        : name_(std::move(name)), devices_(devices), finishes_(finishes) {}
+
+    void start() override {}
+    void stop() override {}
+    void pause() override {}
+    void resume() override {}
+    void fillFeatures(aap_protobuf::service::control::message::ServiceDiscoveryResponse &) override {}
+
+    void shutdown(std::function<void()> done) override {
+        stopped = true;
+        if (finishes_) {
+            done();
+        }
+    }
+    bool holdsDevices() const override { return devices_; }
+    std::string name() const override { return name_; }
+
+    std::atomic<bool> stopped{false};
+
+private:
+    std::string name_;
+    bool devices_;
+    bool finishes_;
+};
+
+TEST(ShutdownCoordinatorTest, ReportsOverrunsAndReturnsAtDeadline) {
+    auto video = std::make_shared<StoppingService>("video", true, true);
+    auto sensors = std::make_shared<StoppingService>("sensors", false, false);
+    auto bluetooth = std::make_shared<StoppingService>("bluetooth", false, true);
+    ServiceList services{sensors, video, bluetooth};
+
+    std::promise<std::vector<std::string>> reported;
+    auto overranFuture = reported.get_future();
+    ShutdownCoordinator coordinator;
+
+    const auto started = std::chrono::steady_clock::now();
+    coordinator.stopServices(services, [&reported](std::vector<std::string> overran) {
+        reported.set_value(std::move(overran));
+    });
+    // The caller's thread is not held while the services stop
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(100));
+
+    ASSERT_EQ(overranFuture.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+    const auto overran = overranFuture.get();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started).count();
+
+    EXPECT_TRUE(video->stopped);
+    EXPECT_TRUE(sensors->stopped);
+    EXPECT_TRUE(bluetooth->stopped);
+    ASSERT_EQ(overran.size(), 1u);
+    EXPECT_EQ(overran[0], "sensors");
+    // Devices finished at once; only the stuck service's deadline was waited out
+    EXPECT_GE(elapsed, ShutdownCoordinator::cServiceDeadlineMs);
+    EXPECT_LT(elapsed, ShutdownCoordinator::cServiceDeadlineMs + 250);
+}
+
+TEST(ShutdownCoordinatorTest, StepsRunConcurrently) {
+    std::vector<ShutdownStep> steps;
+    for (int i = 0; i < 4; ++i) {
+        steps.push_back({"step" + std::to_string(i), 1000, [](std::function<void()> done) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            done();
+        }});
+    }
+
+    ShutdownCoordinator coordinator;
+    const auto started = std::chrono::steady_clock::now();
+    EXPECT_TRUE(coordinator.run(steps).empty());
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(300));
+}
+
+TEST(ShutdownCoordinatorTest, LateStepsAreJoinedNotLeftRunning) {
+    auto finished = std::make_shared<std::atomic<bool>>(false);
+    {
+        ShutdownCoordinator coordinator;
+        const auto overran = coordinator.run({{"slow", 50, [finished](std::function<void()> done) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            finished->store(true);
+            done();
+        }}});
+        ASSERT_EQ(overran.size(), 1u);
+        EXPECT_FALSE(finished->load());
+    }
+    // Whatever a late step stops is not torn down under it
+    EXPECT_TRUE(finished->load());
+}
+
+// TC-AAP-022 - Tagged Allocations and Burst Arenas
+TEST(MessageArenaTest, SmallBurstsStayInlineAndSpilledBlocksAreTagged) {
+    auto &accounting = AllocationAccounting::instance();
+    const AllocationStats before = accounting.stats(AllocationTag::Protobuf);
+    MessageArena arena;
+
+    for (int burst = 0; burst < 3; burst++) {
+        auto *batch = arena.create<google::protobuf::ListValue>();
+        for (int i = 0; i < 8; i++) {
+            batch->add_values()->set_number_value(i);
+        }
+        arena.reset();
+    }
+    EXPECT_EQ(accounting.stats(AllocationTag::Protobuf).allocations, before.allocations);
+
+    // Past the inline block the arena takes tagged blocks, all returned by reset()
+    auto *batch = arena.create<google::protobuf::ListValue>();
+    for (int i = 0; i < 256; i++) {
+        batch->add_values()->set_number_value(i);
+    }
+    const AllocationStats spilled = accounting.stats(AllocationTag::Protobuf);
+    EXPECT_GT(spilled.allocations, before.allocations);
+    EXPECT_GT(spilled.liveBytes, before.liveBytes);
+    arena.reset();
+    EXPECT_EQ(accounting.stats(AllocationTag::Protobuf).liveBytes, before.liveBytes);
+
+    // Once memory is out the backend stays; naming it again is fine
+    EXPECT_FALSE(accounting.selectBackend("jemalloc"));
+    EXPECT_TRUE(accounting.selectBackend("system"));
+    EXPECT_STREQ(accounting.backendName(), "system");
+
+    const AllocationStats ffmpeg = accounting.stats(AllocationTag::FFmpeg);
+    void *packet = accounting.allocate(AllocationTag::FFmpeg, 1000, 64);
+    ASSERT_NE(packet, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(packet) % 64, 0u);
+    EXPECT_EQ(accounting.stats(AllocationTag::FFmpeg).liveBytes, ffmpeg.liveBytes + 1000);
+    accounting.deallocate(AllocationTag::FFmpeg, packet, 1000);
+    EXPECT_EQ(accounting.stats(AllocationTag::FFmpeg).liveBytes, ffmpeg.liveBytes);
+    EXPECT_EQ(accounting.stats(AllocationTag::FFmpeg).bytes, ffmpeg.bytes + 1000);
+
+    // A model handed to QML counts as allocated, never as live
+    const AllocationStats models = accounting.stats(AllocationTag::UiModels);
+    accounting.countTransient(AllocationTag::UiModels, 640);
+    EXPECT_EQ(accounting.stats(AllocationTag::UiModels).allocations, models.allocations + 1);
+    EXPECT_EQ(accounting.stats(AllocationTag::UiModels).liveBytes, models.liveBytes);
+    EXPECT_NE(accounting.summary().find("ui_models"), std::string::npos);
+}
+
+// TC-AAP-023 - Idle Mode Without a Phone
+TEST(IdleModeTest, DarkensTheScreenAfterTheTimeoutAndWakesOnActivityOrSession) {
+    char base[] = "/tmp/idle-test-XXXXXX";
+    ASSERT_NE(mkdtemp(base), nullptr);
+    const std::string root(base);
+    for (const auto &directory : {"/class", "/class/backlight", "/class/backlight/panel"}) {
+        ASSERT_EQ(mkdir((root + directory).c_str(), 0755), 0);
+    }
+    const std::string blPower = root + "/class/backlight/panel/bl_power";
+    std::ofstream(blPower) << "0\n";
+    const auto backlight = [&blPower]() {
+        std::ifstream in(blPower);
+        std::string value;
+        in >> value;
+        return value;
+    };
+
+    boost::asio::io_service ioService;
+    const auto runFor = [&ioService](int ms) {
+        const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        while (std::chrono::steady_clock::now() < until) {
+            ioService.run_one_for(std::chrono::milliseconds(5));
+            ioService.restart();
+        }
+    };
+
+    auto idleMode = std::make_shared<IdleMode>(ioService, root);
+    std::vector<bool> changes;
+    IdleSettings settings;
+    settings.timeoutMs = 30;
+    idleMode->start(settings, [&changes](bool idle) { changes.push_back(idle); });
+    runFor(80);
+    EXPECT_TRUE(idleMode->idle());
+    EXPECT_EQ(backlight(), "4");
+    EXPECT_EQ(changes, std::vector<bool>({true}));
+
+    // A touch wakes it and the countdown starts over
+    idleMode->activity("touch");
+    runFor(10);
+    EXPECT_FALSE(idleMode->idle());
+    EXPECT_EQ(backlight(), "0");
+    runFor(80);
+    EXPECT_TRUE(idleMode->idle());
+
+    // Never during a session; the countdown starts when it ends
+    idleMode->onSessionStarted();
+    runFor(80);
+    EXPECT_FALSE(idleMode->idle());
+    EXPECT_EQ(changes, std::vector<bool>({true, false, true, false}));
+    idleMode->onSessionStopped();
+    runFor(80);
+    EXPECT_TRUE(idleMode->idle());
+
+    // With the screen-off setting disabled the UI stays live
+    settings.screenOff = false;
+    idleMode->configure(settings);
+    runFor(80);
+    EXPECT_FALSE(idleMode->idle());
+    EXPECT_EQ(backlight(), "0");
+
+    settings.screenOff = true;
+    idleMode->configure(settings);
+    runFor(80);
+    EXPECT_TRUE(idleMode->idle());
+    idleMode->stop();
+    EXPECT_EQ(backlight(), "0");
+    runFor(10);
+
+    std::istringstream status("Name:\tautoapp\nvoluntary_ctxt_switches:\t120\nnonvoluntary_ctxt_switches:\t7\n");
+    EXPECT_EQ(IdleMode::parseContextSwitches(status), 127u);
+}
+
+// TC-AAP-024 - Ambient Light Night Mode and Backlight
+TEST(AmbientLightTest, SmoothsLuxWithHysteresisDecodesScansAndRampsTheBacklight) {
+    // Brief darkness is averaged away; night takes a sustained drop below
+    // 10 lux and day a rise above 30
+    LightFilter filter(10.0, 30.0);
+    EXPECT_TRUE(filter.update(200.0, 0));
+    EXPECT_FALSE(filter.night());
+    EXPECT_FALSE(filter.update(0.0, 500));
+    EXPECT_GT(filter.lux(), 100.0);
+    int64_t at = 500;
+    bool changed = false;
+    while (!changed && at < 60000) {
+        at += 500;
+        changed = filter.update(5.0, at);
+    }
+    EXPECT_TRUE(changed);
+    EXPECT_TRUE(filter.night());
+    EXPECT_DOUBLE_EQ(filter.brightness(), LightFilter::cMinBrightness);
+    for (int i = 0; i < 40; i++) {
+        at += 500;
+        EXPECT_FALSE(filter.update(20.0, at));
+    }
+    EXPECT_TRUE(filter.night());
+    for (int i = 0; i < 40; i++) {
+        at += 500;
+        filter.update(2000.0, at);
+    }
+    EXPECT_FALSE(filter.night());
+    EXPECT_DOUBLE_EQ(filter.brightness(), 1.0);
+
+    IioScanType type;
+    ASSERT_TRUE(AmbientLight::parseScanType("le:u16/16>>0", type));
+    const uint8_t little[] = {0x34, 0x12};
+    EXPECT_EQ(AmbientLight::decode(little, type), 0x1234);
+    ASSERT_TRUE(AmbientLight::parseScanType("be:s12/16>>4", type));
+    const uint8_t big[] = {0xff, 0xe0};
+    EXPECT_EQ(AmbientLight::decode(big, type), -2);
+    EXPECT_FALSE(AmbientLight::parseScanType("le:u16/16X2>>0", type));
+    EXPECT_FALSE(AmbientLight::parseScanType("le:u16/12>>0", type));
+
+    // A sensor without a buffer, read from sysfs, in a dark cabin
+    char base[] = "/tmp/light-test-XXXXXX";
+    ASSERT_NE(mkdtemp(base), nullptr);
+    const std::string root(base);
+    for (const auto &directory : {"/bus", "/bus/iio", "/bus/iio/devices", "/bus/iio/devices/iio:device0", "/class",
+                                  "/class/backlight", "/class/backlight/panel"}) {
+        ASSERT_EQ(mkdir((root + directory).c_str(), 0755), 0);
+    }
+    std::ofstream(root + "/bus/iio/devices/iio:device0/in_illuminance_input") << "3\n";
+    std::ofstream(root + "/class/backlight/panel/max_brightness") << "10\n";
+    const std::string brightness = root + "/class/backlight/panel/brightness";
+    // Single digits: pwrite over a regular file does not truncate like sysfs
+    std::ofstream(brightness) << "9\n";
+
+    AmbientLightSettings settings;
+    settings.device = "auto";
+    settings.backlight = "auto";
+    AmbientLight light(settings, root, root + "/dev");
+    ASSERT_TRUE(light.start());
+    std::string level;
+    const auto until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (level != "1" && std::chrono::steady_clock::now() < until) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::ifstream in(brightness);
+        in >> level;
+    }
+    light.stop();
+    EXPECT_EQ(level, "1");
+    EXPECT_TRUE(StateBus::instance().isSet(StateFlag::NightMode));
+    StateBus::instance().clear(StateFlag::NightMode);
+
+    AmbientLightSettings missing;
+    missing.device = "iio:device7";
+    EXPECT_FALSE(AmbientLight(missing, root, root + "/dev").start());
+}
+
+// TC-AAP-025 - Night Mode From Civil Twilight
+TEST(SunScheduleTest, FindsTwilightAndRecomputesOnlyOnMovesOrANewDay) {
+    using sensor::SunSchedule;
+    // London at the June solstice: civil dawn 02:55 UTC, dusk 21:09 UTC
+    const std::time_t midnight = 1718928000;  // 2024-06-21 00:00 UTC
+    std::time_t dawn = 0;
+    std::time_t dusk = 0;
+    bool alwaysNight = false;
+    ASSERT_TRUE(SunSchedule::twilight(SunSchedule::solarDay(-0.13, midnight + 43200), 51.51, -0.13, dawn, dusk,
+                                      alwaysNight));
+    EXPECT_NEAR(dawn - midnight, 2 * 3600 + 55 * 60, 180);
+    EXPECT_NEAR(dusk - midnight, 21 * 3600 + 9 * 60, 180);
+
+    SunSchedule schedule;
+    EXPECT_TRUE(schedule.update(51.51, -0.13, midnight + 12 * 3600));
+    EXPECT_FALSE(schedule.night(midnight + 12 * 3600));
+    EXPECT_TRUE(schedule.night(midnight + 1800));
+    EXPECT_TRUE(schedule.night(midnight + 22 * 3600));
+    EXPECT_NEAR(schedule.nextTransition(midnight + 12 * 3600) - midnight, dusk - midnight, 1);
+
+    // Driving across town changes nothing; the next town over, or the next day, does
+    EXPECT_FALSE(schedule.update(51.55, -0.05, midnight + 13 * 3600));
+    EXPECT_TRUE(schedule.update(52.20, 0.12, midnight + 14 * 3600));
+    EXPECT_FALSE(schedule.update(52.20, 0.12, midnight + 20 * 3600));
+    EXPECT_TRUE(schedule.update(52.20, 0.12, midnight + 26 * 3600));
+
+    // No civil night in June at Tromsø; at 80 degrees north none in June
+    // and no civil day in December
+    SunSchedule polar;
+    polar.update(69.65, 18.96, midnight);
+    EXPECT_FALSE(polar.night(midnight));
+    EXPECT_EQ(polar.nextTransition(midnight), 0);
+    EXPECT_FALSE(SunSchedule::twilight(SunSchedule::solarDay(18.96, midnight), 69.65, 18.96, dawn, dusk,
+                                       alwaysNight));
+    EXPECT_FALSE(alwaysNight);
+    EXPECT_FALSE(SunSchedule::twilight(SunSchedule::solarDay(18.96, midnight), 80.0, 18.96, dawn, dusk,
+                                       alwaysNight));
+    EXPECT_FALSE(SunSchedule::twilight(SunSchedule::solarDay(18.96, midnight) + 183, 80.0, 18.96, dawn, dusk,
+                                       alwaysNight));
+    EXPECT_TRUE(alwaysNight);
+}
+
+// TC-AAP-026 - Touch Prediction on Drags
+TEST(TouchPredictorTest, ExtrapolatesDragsAndStaysOffAtDownAndUp) {
+    using inputsource::TouchPredictor;
+    using aap_protobuf::service::inputsource::message::PointerAction;
+    const auto touch = [](PointerAction type, std::vector<projection::TouchPoint> pointers, uint32_t actionIndex = 0) {
+        projection::TouchEvent event;
+        event.type = type;
+        event.pointers = std::move(pointers);
+        event.actionIndex = actionIndex;
+        return event;
+    };
+    const auto at = [](int ms) { return std::chrono::microseconds(ms * 1000); };
+
+    TouchPredictor predictor;
+    predictor.setBounds(800, 480);
+    EXPECT_FALSE(predictor.enabled());
+    predictor.setHorizon(std::chrono::milliseconds(20));
+    ASSERT_TRUE(predictor.enabled());
+
+    // 1 px per ms to the right: 20 px ahead once the line is known
+    predictor.observe(touch(PointerAction::ACTION_DOWN, {{100, 200, 0}}), at(0));
+    EXPECT_EQ(predictor.predict({100, 200, 0}).x, 100u);
+    predictor.observe(touch(PointerAction::ACTION_MOVED, {{108, 200, 0}}), at(8));
+    EXPECT_EQ(predictor.predict({108, 200, 0}).x, 108u);
+    predictor.observe(touch(PointerAction::ACTION_MOVED, {{116, 200, 0}}), at(16));
+    predictor.observe(touch(PointerAction::ACTION_MOVED, {{124, 200, 0}}), at(24));
+    auto predicted = predictor.predict({124, 200, 0});
+    EXPECT_EQ(predicted.x, 144u);
+    EXPECT_EQ(predicted.y, 200u);
+
+    // A second finger starts its own track; the first keeps its own
+    predictor.observe(touch(PointerAction::ACTION_POINTER_DOWN, {{132, 200, 0}, {400, 300, 1}}, 1), at(32));
+    EXPECT_EQ(predictor.predict({400, 300, 1}).x, 400u);
+    EXPECT_EQ(predictor.predict({132, 200, 0}).x, 152u);
+
+    // A fast swipe leads by at most cMaxLeadPx and stays on the screen
+    predictor.observe(touch(PointerAction::ACTION_DOWN, {{100, 240, 0}}), at(100));
+    predictor.observe(touch(PointerAction::ACTION_MOVED, {{300, 240, 0}}), at(108));
+    predictor.observe(touch(PointerAction::ACTION_MOVED, {{500, 240, 0}}), at(116));
+    EXPECT_EQ(predictor.predict({500, 240, 0}).x, 500u + static_cast<uint32_t>(TouchPredictor::cMaxLeadPx));
+    predictor.observe(touch(PointerAction::ACTION_MOVED, {{760, 240, 0}}), at(124));
+    EXPECT_EQ(predictor.predict({760, 240, 0}).x, 799u);
+
+    // After a rest the old line is forgotten
+    predictor.observe(touch(PointerAction::ACTION_MOVED, {{761, 240, 0}}), at(400));
+    EXPECT_EQ(predictor.predict({761, 240, 0}).x, 761u);
+
+    // Up ends every track
+    predictor.observe(touch(PointerAction::ACTION_UP, {{761, 240, 0}}), at(410));
+    EXPECT_EQ(predictor.predict({761, 240, 0}).x, 761u);
+
+    predictor.setHorizon(std::chrono::milliseconds(500));
+    EXPECT_EQ(predictor.horizon().count(), TouchPredictor::cMaxHorizonUs);
+}
+
+// TC-AAP-027 - Audio Focus Reaches The Mixer
+TEST_F(ServiceTest, AudioFocusHandlerSeesEveryRequest) {
+    runIoServiceInBackground();
+
+    auto androidAutoEntity = std::make_shared<AndroidAutoEntity>(
+        *ioService,
+        mockCryptor,
+        mockTransport,
+        mockMessenger,
+        mockConfiguration,
+        serviceFactory->create(mockMessenger),
+        pinger
+    );
+    std::vector<aap_protobuf::service::control::message::AudioFocusRequestType> seen;
+    androidAutoEntity->setAudioFocusHandler(
+        [&seen](aap_protobuf::service::control::message::AudioFocusRequestType type) { seen.push_back(type); });
+
+    EXPECT_CALL(*mockControlServiceChannel, sendAudioFocusResponse(_, _)).Times(2);
+    EXPECT_CALL(*mockControlServiceChannel, receive(_)).Times(2);
+
+    // A prompt that lets local media duck, then its release
+    aap_protobuf::service::control::message::AudioFocusRequest request;
+    request.set_audio_focus_type(
+        aap_protobuf::service::control::message::AudioFocusRequestType::AUDIO_FOCUS_GAIN_TRANSIENT_MAY_DUCK);
+    androidAutoEntity->onAudioFocusRequest(request);
+    request.set_audio_focus_type(aap_protobuf::service::control::message::AudioFocusRequestType::AUDIO_FOCUS_RELEASE);
+    androidAutoEntity->onAudioFocusRequest(request);
+
+    ASSERT_EQ(seen.size(), 2u);
+    EXPECT_EQ(seen[0], aap_protobuf::service::control::message::AudioFocusRequestType::AUDIO_FOCUS_GAIN_TRANSIENT_MAY_DUCK);
+    EXPECT_EQ(seen[1], aap_protobuf::service::control::message::AudioFocusRequestType::AUDIO_FOCUS_RELEASE);
+
+    ioService->stop();
+}
+
+// TC-AAP-028 - Media Browse Cache
+TEST(BrowseCacheTest, ServesRevisitsAndReRequestsOnlyChangedSubtrees) {
+    using namespace mediabrowser;
+
+    char base[] = "/tmp/browse-test-XXXXXX";
+    ASSERT_NE(mkdtemp(base), nullptr);
+    const auto item = [](const std::string &path, uint64_t version) {
+        BrowseItem entry;
+        entry.path = path;
+        entry.title = path;
+        entry.browsable = true;
+        entry.version = version;
+        return entry;
+    };
+    const auto node = [](const std::string &path, std::vector<BrowseItem> items) {
+        BrowseNode listing;
+        listing.path = path;
+        listing.items = std::move(items);
+        return listing;
+    };
+
+    BrowseCache cache(base, 2, 8);
+    cache.setPhone("Pixel 7");
+    EXPECT_TRUE(cache.store(node("/", {item("/albums", 1), item("/playlists", 1)})).empty());
+    cache.store(node("/albums", {item("/albums/a", 1)}));
+    cache.store(node("/albums/a", {}));
+    cache.store(node("/playlists", {item("/playlists/p", 1)}));
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_EQ(cache.diskSize(), 4u);
+
+    // Evicted from memory, served from disk
+    const BrowseNode *root = cache.find("/");
+    ASSERT_NE(root, nullptr);
+    ASSERT_EQ(root->items.size(), 2u);
+    EXPECT_EQ(root->items[1].path, "/playlists");
+    EXPECT_EQ(cache.find("/missing"), nullptr);
+
+    // Only the playlists' stamp moved: that subtree is re-requested
+    ASSERT_NE(cache.find("/playlists"), nullptr);
+    const auto changed = cache.store(node("/", {item("/albums", 1), item("/playlists", 2)}));
+    EXPECT_EQ(changed, std::vector<std::string>({"/playlists"}));
+    EXPECT_TRUE(cache.stale("/playlists"));
+    EXPECT_FALSE(cache.stale("/albums"));
+    EXPECT_NE(cache.find("/albums/a"), nullptr);
+    cache.store(node("/playlists", {item("/playlists/p", 1), item("/playlists/q", 1)}));
+    EXPECT_FALSE(cache.stale("/playlists"));
+
+    // A restart starts from disk; another phone has its own tree
+    {
+        BrowseCache restarted(base, 2, 8);
+        restarted.setPhone("Pixel 7");
+        const BrowseNode *playlists = restarted.find("/playlists");
+        ASSERT_NE(playlists, nullptr);
+        EXPECT_EQ(playlists->items.size(), 2u);
+        ASSERT_NE(restarted.find("/albums"), nullptr);
+        EXPECT_EQ(restarted.invalidate("/albums"), std::vector<std::string>({"/albums"}));
+        EXPECT_EQ(restarted.find("/albums/a"), nullptr);
+
+        restarted.setPhone("Galaxy");
+        EXPECT_EQ(restarted.find("/"), nullptr);
+        restarted.store(node("/", {}));
+        restarted.clear();
+    }
+
+    // Bounded on disk as well
+    for (int i = 0; i < 10; i++) {
+        cache.store(node("/extra/" + std::to_string(i), {}));
+    }
+    EXPECT_EQ(cache.diskSize(), 8u);
+    cache.clear();
+    EXPECT_EQ(cache.diskSize(), 0u);
+    EXPECT_EQ(rmdir(base), 0);
+}
+
+// TC-AAP-029 - Vendor Extension Plugin Rings
+TEST(PluginBridgeTest, PassesPayloadsThroughSharedRingsAndSurvivesThePlugin) {
+    using namespace vendorextension;
+
+    const std::string path = "/tmp/vendor-test-" + std::to_string(::getpid()) + ".sock";
+    std::mutex mutex;
+    std::vector<std::string> received;
+    PluginBridge bridge(path, "canbridge");
+    ASSERT_TRUE(bridge.start([&](std::vector<uint8_t> message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.emplace_back(message.begin(), message.end());
+    }));
+    const auto waitFor = [](const std::function<bool()> &done) {
+        for (int i = 0; i < 200 && !done(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return done();
+    };
+
+    EXPECT_FALSE(bridge.send("lost", 4));
+    SharedChannel plugin;
+    std::string name;
+    const int socket = PluginBridge::connect(path, plugin, &name);
+    ASSERT_GE(socket, 0);
+    EXPECT_EQ(name, "canbridge");
+    ASSERT_TRUE(waitFor([&bridge]() { return bridge.attached(); }));
+
+    // Both ways, and across the end of the ring: odd sizes keep the padding honest
+    std::string payload(1001, 'x');
+    std::vector<uint8_t> message;
+    for (int i = 0; i < 600; i++) {
+        payload[0] = static_cast<char>('a' + i % 26);
+        ASSERT_TRUE(bridge.send(payload.data(), payload.size()));
+        ASSERT_TRUE(plugin.receive(message));
+        ASSERT_EQ(std::string(message.begin(), message.end()), payload);
+    }
+    EXPECT_FALSE(plugin.receive(message));
+    ASSERT_TRUE(plugin.send("frame", 5));
+    ASSERT_TRUE(plugin.send("", 0));
+    ASSERT_TRUE(waitFor([&]() { std::lock_guard<std::mutex> lock(mutex); return received.size() == 2; }));
+    EXPECT_EQ(received[0], "frame");
+    EXPECT_EQ(received[1], "");
+
+    // A plugin that stops reading is dropped from, never waited for
+    size_t queued = 0;
+    while (bridge.send(payload.data(), payload.size())) {
+        queued++;
+    }
+    EXPECT_EQ(queued, (SharedChannel::cRingBytes - 4) / (4 + 1004));
+    EXPECT_GE(bridge.dropped(), 2u);
+
+    // Its crash detaches it, and the next one starts from empty rings
+    ::close(socket);
+    plugin.close();
+    ASSERT_TRUE(waitFor([&bridge]() { return !bridge.attached(); }));
+    const int again = PluginBridge::connect(path, plugin);
+    ASSERT_GE(again, 0);
+    ASSERT_TRUE(waitFor([&bridge]() { return bridge.attached(); }));
+    EXPECT_FALSE(plugin.receive(message));
+    EXPECT_TRUE(bridge.send("fresh", 5));
+    ASSERT_TRUE(plugin.receive(message));
+    EXPECT_EQ(std::string(message.begin(), message.end()), "fresh");
+
+    ::close(again);
+    bridge.stop();
+    EXPECT_NE(::access(path.c_str(), F_OK), 0);
+}
+
+
+// TC-AAP-030 - Streaming Update Verification
+TEST(UpdateStreamTest, VerifiesBlocksInPlaceAndResumesAfterTheLastGoodOne) {
+    const uint32_t block = UpdateManifest::cMinBlockBytes;
+    std::vector<uint8_t> package(block * 5 / 2);
+    for (size_t i = 0; i < package.size(); i++) {
+        package[i] = static_cast<uint8_t>(i * 7 + i / 251);
+    }
+
+    std::ostringstream text;
+    text << "version 2026.10\nurl openauto.zip\nsize " << package.size() << "\nblock " << block << "\n";
+    for (size_t start = 0; start < package.size(); start += block) {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int size = 0;
+        EVP_Digest(package.data() + start, std::min<size_t>(block, package.size() - start), digest, &size,
+                   EVP_sha256(), nullptr);
+        text << "sha256 ";
+        for (unsigned int i = 0; i < size; i++) {
+            text << "0123456789ABCDEF"[digest[i] >> 4] << "0123456789ABCDEF"[digest[i] & 0x0f];
+        }
+        text << "\n";
+    }
+    UpdateManifest manifest;
+    std::istringstream in(text.str());
+    ASSERT_TRUE(UpdateManifest::parse(in, manifest));
+    EXPECT_EQ(manifest.blockHashes.size(), 3u);
+    EXPECT_EQ(manifest.id().size(), 64u);
+    std::istringstream truncated("url a.zip\nsize 200000\nblock 65536\nsha256 " + manifest.blockHashes[0] + "\n");
+    UpdateManifest rejected;
+    EXPECT_FALSE(UpdateManifest::parse(truncated, rejected));
+
+    const std::string target = "/tmp/update-test-" + std::to_string(::getpid()) + ".zip";
+    const std::string state = target + ".state";
+    {
+        UpdateStream stream(manifest, target, state);
+        ASSERT_TRUE(stream.open());
+        EXPECT_EQ(stream.offset(), 0u);
+
+        // Odd chunk sizes cross block boundaries
+        ASSERT_EQ(stream.write(package.data(), 1000), UpdateStream::Status::Ok);
+        ASSERT_EQ(stream.write(package.data() + 1000, block), UpdateStream::Status::Ok);
+        EXPECT_EQ(stream.verified(), block);
+
+        // A corrupted byte rewinds to the block's start
+        std::vector<uint8_t> corrupt(package.begin() + block, package.begin() + 2 * block);
+        corrupt[1100] ^= 0xff;
+        EXPECT_EQ(stream.write(corrupt.data() + 1000, block - 1000), UpdateStream::Status::BadBlock);
+        EXPECT_EQ(stream.offset(), block);
+        EXPECT_EQ(stream.badBlocks(), 1u);
+        EXPECT_EQ(stream.write(corrupt.data(), corrupt.size()), UpdateStream::Status::BadBlock);
+        EXPECT_EQ(stream.offset(), block);
+        EXPECT_EQ(stream.badBlocks(), 2u);
+
+        // Dropped halfway through the second block
+        ASSERT_EQ(stream.write(package.data() + block, block / 2), UpdateStream::Status::Ok);
+        EXPECT_EQ(stream.verified(), block);
+    }
+
+    // A new run picks up at the last verified block
+    UpdateStream resumed(manifest, target, state);
+    ASSERT_TRUE(resumed.open());
+    EXPECT_EQ(resumed.offset(), block);
+    ASSERT_EQ(resumed.write(package.data() + block, package.size() - block), UpdateStream::Status::Ok);
+    EXPECT_TRUE(resumed.complete());
+    EXPECT_EQ(resumed.write(package.data(), 1), UpdateStream::Status::BadBlock);
+    ASSERT_TRUE(resumed.finish());
+
+    std::ifstream written(target, std::ios::binary);
+    const std::vector<uint8_t> contents((std::istreambuf_iterator<char>(written)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(contents, package);
+    EXPECT_NE(::access((target + ".part").c_str(), F_OK), 0);
+    EXPECT_NE(::access(state.c_str(), F_OK), 0);
+
+    // Another package does not resume from this one's state
+    UpdateManifest other = manifest;
+    other.blockHashes[2] = std::string(64, '0');
+    UpdateStream stale(other, target + "-other", state);
+    ASSERT_TRUE(stale.open());
+    EXPECT_EQ(stale.offset(), 0u);
+    stale.discard();
+    EXPECT_NE(::access((target + "-other.part").c_str(), F_OK), 0);
+    std::remove(target.c_str());
+}
+
+// TC-AAP-031 - Startup Task Graph
+TEST(StartupGraphTest, RunsTasksAfterTheirDependenciesWithinTheLimit) {
+    boost::asio::io_service ioService;
+    boost::asio::io_service::work work(ioService);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 3; ++i) {
+        workers.emplace_back([&ioService]() { ioService.run(); });
+    }
+
+    std::mutex mutex;
+    std::vector<std::string> order;
+    std::atomic<int> running{0};
+    std::atomic<int> peak{0};
+    auto task = [&](const std::string &name) {
+        return [&, name]() {
+            const int now = ++running;
+            peak = std::max(peak.load(), now);
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+            --running;
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(name);
+        };
+    };
+
+    {
+        StartupGraph graph(ioService, 2);
+        EXPECT_TRUE(graph.add("tls", {}, task("tls")));
+        EXPECT_TRUE(graph.add("audio", {}, task("audio")));
+        EXPECT_TRUE(graph.add("camera", {}, task("camera")));
+        EXPECT_TRUE(graph.add("cluster", {"camera"}, task("cluster")));
+        EXPECT_TRUE(graph.add("broken", {"tls"}, []() { throw std::runtime_error("no device"); }));
+        EXPECT_TRUE(graph.add("after_broken", {"broken"}, task("after_broken")));
+        EXPECT_FALSE(graph.add("tls", {}, task("tls")));
+        EXPECT_FALSE(graph.add("orphan", {"missing"}, task("orphan")));
+
+        graph.start();
+        EXPECT_FALSE(graph.add("late", {}, task("late")));
+        ASSERT_TRUE(graph.wait(std::chrono::milliseconds(2000)));
+
+        EXPECT_LE(peak, 2);
+        ASSERT_EQ(order.size(), 4u);
+        EXPECT_LT(std::find(order.begin(), order.end(), "camera"), std::find(order.begin(), order.end(), "cluster"));
+
+        const auto timings = graph.timings();
+        ASSERT_EQ(timings.size(), 6u);
+        EXPECT_GE(timings[3].readyMs, timings[2].startedMs + timings[2].durationMs);
+        EXPECT_TRUE(timings[4].failed);
+        EXPECT_TRUE(timings[5].failed);
+        EXPECT_EQ(timings[5].durationMs, -1);
+        EXPECT_NE(graph.report().find("after_broken: skipped"), std::string::npos);
+    }
+
+    ioService.stop();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+// TC-AAP-032 - Throttled Log Statements
+TEST(LogSiteTest, ThrottlesByCountAndWindowAndCountsWhatItSuppressed) {
+    common::LogSite every;
+    std::vector<uint64_t> logged;
+    for (int i = 0; i < 7; ++i) {
+        if (const uint64_t occurrence = every.everyN(3)) {
+            logged.push_back(occurrence);
+        }
+    }
+    EXPECT_EQ(logged, (std::vector<uint64_t>{1, 4, 7}));
+
+    common::LogSite first;
+    logged.clear();
+    for (int i = 0; i < 5; ++i) {
+        if (const uint64_t occurrence = first.firstN(2)) {
+            logged.push_back(occurrence);
+        }
+    }
+    EXPECT_EQ(logged, (std::vector<uint64_t>{1, 2}));
+
+    // The first call logs at once; the calls in the window are only counted,
+    // and reported by the first call after it
+    common::LogSite window;
+    EXPECT_EQ(window.everyMs(100), 1u);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(window.everyMs(100), 0u);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    EXPECT_EQ(window.everyMs(100), 5u);
+    EXPECT_EQ(window.everyMs(100), 0u);
+
+    // A suppressed statement never evaluates its stream, and neither does
+    // one below the threshold
+    int formatted = 0;
+    const auto format = [&formatted]() { return ++formatted; };
+    for (int i = 0; i < 6; ++i) {
+        OPENAUTO_LOG_EVERY_N(debug, 3) << "[LogSiteTest] " << format() << " of " << OPENAUTO_LOG_OCCURRENCES;
+    }
+    EXPECT_EQ(formatted, 2);
+    const int threshold = common::logThreshold.exchange(boost::log::trivial::info);
+    OPENAUTO_LOG(debug) << format();
+    OPENAUTO_LOG_FIRST_N(debug, 5) << format();
+    common::logThreshold = threshold;
+    EXPECT_EQ(formatted, 2);
+}
+
+// TC-AAP-033 - Media Library Search
+TEST(SearchIndexTest, FoldsTextMatchesShortQueriesAndKeepsBrowseOrder) {
+    const auto track = [](const QString &name, const QString &title, const QString &artist, const QString &album) {
+        player::LibraryTrack out;
+        out.name = name;
+        out.title = title;
+        out.artist = artist;
+        out.album = album;
+        return out;
+    };
+    player::SearchIndex::Folders folders;
+    folders["Rock/Queen"].tracks = {track("01 Bohemian Rhapsody.mp3", "Bohemian Rhapsody", "Queen", "A Night at the Opera"),
+                                    track("02 Under Pressure.mp3", "Under Pressure", "Queen", "Hot Space")};
+    folders["jazz"].tracks = {track("Caf\u00e9.flac", "", "", "")};
+    folders["Bj\u00f6rk"].tracks = {track("J\u00f3ga.ogg", "J\u00f3ga", "Bj\u00f6rk", "Homogenic")};
+
+    // Accents, case and compatibility forms fold away
+    EXPECT_EQ(player::SearchIndex::fold(QString::fromUtf8("Bj\u00f6rk")), QByteArray("bjork"));
+    EXPECT_EQ(player::SearchIndex::fold(QString::fromUtf8("\u00c9COLE \ufb01n")), QByteArray("ecole fin"));
+
+    const player::SearchIndex::Pointer index = player::SearchIndex::build(folders);
+    ASSERT_NE(index, nullptr);
+    EXPECT_EQ(index->trackCount(), 4);
+
+    const auto found = [&index](const QString &query, int limit) {
+        std::vector<std::pair<std::string, int>> out;
+        for (const auto &match : index->search(query, limit)) {
+            out.emplace_back(match.folder.toStdString(), match.track);
+        }
+        return out;
+    };
+    typedef std::vector<std::pair<std::string, int>> Found;
+
+    // Any field, the file name without its extension, never across fields
+    EXPECT_EQ(found("BJORK", 10), (Found{{"Bj\u00f6rk", 0}}));
+    EXPECT_EQ(found("cafe", 10), (Found{{"jazz", 0}}));
+    EXPECT_EQ(found("opera", 10), (Found{{"Rock/Queen", 0}}));
+    EXPECT_TRUE(found("flac", 10).empty());
+    EXPECT_TRUE(found("pressurequeen", 10).empty());
+    EXPECT_TRUE(found("zzz", 10).empty());
+
+    // Folders in case-insensitive order, then tracks in theirs; the limit
+    // keeps the first
+    EXPECT_EQ(found(" queen ", 10), (Found{{"Rock/Queen", 0}, {"Rock/Queen", 1}}));
+    EXPECT_EQ(found("queen", 1), (Found{{"Rock/Queen", 0}}));
+
+    // Shorter than a trigram: compared against every track
+    EXPECT_EQ(found("e", 10), (Found{{"Bj\u00f6rk", 0}, {"jazz", 0}, {"Rock/Queen", 0}, {"Rock/Queen", 1}}));
+    EXPECT_EQ(found("ho", 10), (Found{{"Bj\u00f6rk", 0}, {"Rock/Queen", 1}}));
+    EXPECT_EQ(found("e", 2), (Found{{"Bj\u00f6rk", 0}, {"jazz", 0}}));
+    EXPECT_TRUE(found("", 10).empty());
+    EXPECT_TRUE(found("   ", 10).empty());
+    EXPECT_TRUE(found("e", 0).empty());
+
+    // The saved file maps back only for the library it was built from
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString file = dir.filePath("search.idx");
+    ASSERT_TRUE(index->save(file));
+    const quint64 fingerprint = player::SearchIndex::fingerprint(folders);
+    const player::SearchIndex::Pointer mapped = player::SearchIndex::map(file, fingerprint);
+    ASSERT_NE(mapped, nullptr);
+    EXPECT_EQ(mapped->search("queen", 10).size(), 2);
+    EXPECT_EQ(player::SearchIndex::map(file, fingerprint + 1), nullptr);
+}
+
+} // namespace f1x::openauto::autoapp::service